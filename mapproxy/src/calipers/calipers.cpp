@@ -104,6 +104,27 @@ inline bool valid(const OptCorners &c) {
     return c[0] && c[1] && c[2] && c[3];
 }
 
+/** Merges extents computed by one thread into global extents.
+ */
+inline void merge(math::Extents2 &extents, const math::Extents2 &local) {
+    if (!math::valid(local)) { return; }
+    math::update(extents, local.ll);
+    math::update(extents, local.ur);
+}
+
+/** Per-thread conversion context. GDAL coordinate transformation is not
+ *  thread safe, therefore every thread has its own convertor; local extents
+ *  are accumulated per thread and merged at the end.
+ */
+struct Context {
+    vts::CsConvertor ds2node;
+    math::Extents2 localExtents;
+
+    Context(const geo::SrsDefinition &srs, const std::string &nodeSrs)
+        : ds2node(srs, nodeSrs), localExtents(math::InvalidExtents{})
+    {}
+};
+
 class Node {
 public:
     typedef std::shared_ptr<Node> pointer;
@@ -111,7 +132,7 @@ public:
 
     Node(const geo::GeoDataset::Descriptor &ds
          , const vts::NodeInfo &node, const math::Size2 &steps)
-        : ds(ds), node(node), ds2node(ds.srs, node.srs())
+        : ds(ds), node(node)
         , extents(ds.extents)
         , grid(steps.width + 1, steps.height + 1, (unsigned char)(0))
         , localExtents(math::InvalidExtents{})
@@ -149,24 +170,28 @@ public:
     const std::string& srs() const { return node.srs(); }
 
 private:
-    bool convert(math::Point2 &c, double x, double y) {
+    Context context() const { return Context(ds.srs, node.srs()); }
+
+    bool convert(Context &ctx, math::Point2 &c, double x, double y) const {
         try {
             // try to convert corner
-            c = ds2node(math::Point2d(x, y));
+            c = ctx.ds2node(math::Point2d(x, y));
             // check if it is inside the node
             if (!node.inside(c)) { return true; }
 
             // update local extents
-            math::update(localExtents, c);
+            math::update(ctx.localExtents, c);
         } catch (...) {
             return true;
         }
         return false;
     }
 
-    boost::optional<math::Point2> convert(double x, double y) {
+    boost::optional<math::Point2> convert(Context &ctx, double x, double y)
+        const
+    {
         math::Point2 c;
-        if (convert(c, x, y)) { return boost::none; }
+        if (convert(ctx, c, x, y)) { return boost::none; }
         return c;
     }
 
@@ -174,15 +199,14 @@ private:
     void refine();
     void minLod();
 
-    void divideBorderBlock(math::Size2f blockPxSize
+    void divideBorderBlock(Context &ctx, math::Size2f blockPxSize
                            , const math::Extents2 &extents
-                           , const OptCorners &corners);
+                           , const OptCorners &corners) const;
 
     vts::TileRange globalRange() const;
 
     geo::GeoDataset::Descriptor ds;
     vts::NodeInfo node;
-    vts::CsConvertor ds2node;
     math::Extents2 extents;
     math::Size2f step;
     cv::Mat_<unsigned char> grid;
@@ -220,81 +244,103 @@ bool Node::sample(double invGsdScale, double tileFractionLimit)
                         , (es.height / ds.size.height));
     const math::Size2f hpx(px.width / 2.0, px.height / 2.0);
 
-    // best (local) LOD computed for this node
-    // make_optional used to get rid of "maybe uninitialized" GCC warning
-    auto bestLod(boost::make_optional<double>(false, 0.0));
+    /** Best candidate for local LOD found in one grid row.
+     */
+    struct Best {
+        // make_optional used to get rid of "maybe uninitialized" GCC warning
+        boost::optional<double> lod = boost::make_optional<double>(false, 0.0);
+        double distance = std::numeric_limits<double>::max();
+    };
 
-    double bestDistance(std::numeric_limits<double>::max());
+    // rows are sampled in parallel, each one remembers its best candidate
+    std::vector<Best> rows(grid.rows);
 
     // process whole grid
-    double y(extents.ll(1));
-    for (int j(0); j < grid.rows; ++j, y += step.height) {
-        double x(extents.ll(0));
-        for (int i(0); i < grid.cols; ++i, x += step.width) {
-
-            // try to convert grid point to node's SRS
-            if (convert(projectedGrid(j, i), x, y)) {
-                continue;
+    UTILITY_OMP(parallel)
+    {
+        auto ctx(context());
+
+        UTILITY_OMP(for schedule(dynamic))
+        for (int j = 0; j < grid.rows; ++j) {
+            auto &best(rows[j]);
+            const double y(extents.ll(1) + j * step.height);
+            for (int i(0); i < grid.cols; ++i) {
+                const double x(extents.ll(0) + i * step.width);
+
+                // try to convert grid point to node's SRS
+                if (convert(ctx, projectedGrid(j, i), x, y)) {
+                    continue;
+                }
+
+                // valid grid point, mark
+                grid(j, i) = 255;
+
+                // make point a pixel center, fix coordinates on boundary
+                math::Point2d p(x, y);
+                if (i == 0) { p(0) += hpx.width; }
+                else if (i == grid.cols) { p(0) -= hpx.width; }
+                if (j == 0) { p(1) += hpx.height; }
+                else if (j == grid.rows) { p(1) -= hpx.height; }
+
+                // convert pixel around grid point to node's SRS
+                std::array<math::Point2d, 4> corners;
+                if (convert(ctx, corners[0], p(0) - hpx.width
+                            , p(1) - hpx.height)
+                    || convert(ctx, corners[1], p(0) - hpx.width
+                               , p(1) + hpx.height)
+                    || convert(ctx, corners[2], p(0) + hpx.width
+                               , p(1) + hpx.height)
+                    || convert(ctx, corners[3], p(0) + hpx.width
+                               , p(1) - hpx.height))
+                {
+                    continue;
+                }
+
+                // we have valid quadrilateral
+
+                // calculate distance between pixel center and dataset center
+                const auto distance(ublas::norm_2(p - dsCenter));
+
+                // futher than previous best point?
+                if (distance >= best.distance) { continue; }
+
+                // calculate (approximate) projected quad area
+                const auto pxArea
+                    (vts::triangleArea(corners[0], corners[1], corners[2])
+                     + vts::triangleArea(corners[2], corners[3], corners[0]));
+
+                // calculate best lod:
+                // divide node's pane area by tiles area
+                // apply square root to get number of tiles per side
+                // and log2 to get lod
+                // NB: log2(sqrt(a)) = 0.5 * log2(a)
+                // NB: inverse GSD scale is applied to node pane area
+                // NB: calculated in two passes to overcome problem with huge
+                // numbers (area(paneSize) for webmercator is realy huge and
+                // loses precision)
+                const auto tmp((paneSize.width * invGsdScale * invGsdScale)
+                               / (pxArea * vr::BoundLayer::tileArea()));
+                const auto lod(0.5 * std::log2(tmp * paneSize.height));
+
+                // sanity check: no negative LOD
+                if (lod >= 0.0) {
+                    best.lod = lod;
+                    best.distance = distance;
+                }
             }
+        }
 
-            // valid grid point, mark
-            grid(j, i) = 255;
-
-            // make point a pixel center, fix coordinates on boundary
-            math::Point2d p(x, y);
-            if (i == 0) { p(0) += hpx.width; }
-            else if (i == grid.cols) { p(0) -= hpx.width; }
-            if (j == 0) { p(1) += hpx.height; }
-            else if (j == grid.rows) { p(1) -= hpx.height; }
-
-
-            // convert pixel around grid point to node's SRS
-            std::array<math::Point2d, 4> corners;
-            if (convert(corners[0], p(0) - hpx.width
-                                  , p(1) - hpx.height)
-                || convert(corners[1], p(0) - hpx.width
-                                     , p(1) + hpx.height)
-                || convert(corners[2], p(0) + hpx.width
-                                     , p(1) + hpx.height)
-                || convert(corners[3], p(0) + hpx.width
-                                     , p(1) - hpx.height))
-            {
-                continue;
-            }
+        UTILITY_OMP(critical(calipers_sample))
+            merge(localExtents, ctx.localExtents);
+    }
 
-            // we have valid quadrilateral
-
-            // calculate distance between pixel center and dataset center
-            const auto distance(ublas::norm_2(p - dsCenter));
-
-            // futher than previous best point?
-            if (distance >= bestDistance) { continue; }
-
-            // calculate (approximate) projected quad area
-            const auto pxArea
-                (vts::triangleArea(corners[0], corners[1], corners[2])
-                 + vts::triangleArea(corners[2], corners[3], corners[0]));
-
-            // calculate best lod:
-            // divide node's pane area by tiles area
-            // apply square root to get number of tiles per side
-            // and log2 to get lod
-            // NB: log2(sqrt(a)) = 0.5 * log2(a)
-            // NB: inverse GSD scale is applied to node pane area
-            // NB: calculated in two passes to overcome problem with huge
-            // numbers (area(paneSize) for webmercator is realy huge and loses
-            // precision)
-            const auto tmp((paneSize.width * invGsdScale * invGsdScale)
-                           / (pxArea * vr::BoundLayer::tileArea()));
-            const auto lod(0.5 * std::log2(tmp * paneSize.height));
-
-            // sanity check: no negative LOD
-            if (lod >= 0.0) {
-                bestLod = lod;
-                bestDistance = distance;
-            }
-        }
+    // best (local) LOD computed for this node; rows are merged in order so
+    // the first closest point wins exactly like in a serial scan
+    Best best;
+    for (const auto &row : rows) {
+        if (row.lod && (row.distance < best.distance)) { best = row; }
     }
+    const auto &bestLod(best.lod);
 
     if (!bestLod) { return false; }
 
@@ -324,9 +370,9 @@ bool Node::sample(double invGsdScale, double tileFractionLimit)
     return true;
 }
 
-void Node::divideBorderBlock(math::Size2f blockPxSize
+void Node::divideBorderBlock(Context &ctx, math::Size2f blockPxSize
                              , const math::Extents2 &extents
-                             , const OptCorners &corners)
+                             , const OptCorners &corners) const
 {
     if ((blockPxSize.width < sourceBlockLimit.width)
         && (blockPxSize.height < sourceBlockLimit.height))
@@ -342,18 +388,18 @@ void Node::divideBorderBlock(math::Size2f blockPxSize
     const auto ec(math::center(extents));
 
     // try to transform 5 points on the cross in the center of block
-    auto center(convert(ec(0), ec(1)));
-    auto left(convert(extents.ll(0), ec(1)));
-    auto right(convert(extents.ur(0), ec(1)));
-    auto lower(convert(ec(0), extents.ll(1)));
-    auto upper(convert(ec(0), extents.ur(1)));
+    auto center(convert(ctx, ec(0), ec(1)));
+    auto left(convert(ctx, extents.ll(0), ec(1)));
+    auto right(convert(ctx, extents.ur(0), ec(1)));
+    auto lower(convert(ctx, ec(0), extents.ll(1)));
+    auto upper(convert(ctx, ec(0), extents.ur(1)));
 
     // construct 4 sub-blocks and try again
     {
         // ll
         OptCorners c{{corners[0], left, center, lower}};
         if (partial(c)) {
-            divideBorderBlock(blockPxSize
+            divideBorderBlock(ctx, blockPxSize
                               , math::Extents2(extents.ll, ec), c);
         }
     }
@@ -362,7 +408,7 @@ void Node::divideBorderBlock(math::Size2f blockPxSize
         // ul
         OptCorners c{{left, corners[1], upper, center}};
         if (partial(c)) {
-            divideBorderBlock(blockPxSize
+            divideBorderBlock(ctx, blockPxSize
                               , math::Extents2(extents.ll(0), ec(1)
                                                , ec(0), extents.ur(1))
                               , c);
@@ -373,7 +419,7 @@ void Node::divideBorderBlock(math::Size2f blockPxSize
         // ur
         OptCorners c{{center, upper, corners[2], right}};
         if (partial(c)) {
-            divideBorderBlock(blockPxSize
+            divideBorderBlock(ctx, blockPxSize
                               , math::Extents2(ec, extents.ur), c);
         }
     }
@@ -382,7 +428,7 @@ void Node::divideBorderBlock(math::Size2f blockPxSize
         // lr
         OptCorners c{{lower, center, right, corners[3]}};
         if (partial(c)) {
-            divideBorderBlock(blockPxSize
+            divideBorderBlock(ctx, blockPxSize
                               , math::Extents2(ec(0), extents.ll(1)
                                                , extents.ur(0), ec(1))
                               , c);
@@ -392,30 +438,39 @@ void Node::divideBorderBlock(math::Size2f blockPxSize
 
 void Node::refine()
 {
-    double y(extents.ll(1));
-    for (int j = 1; j < grid.rows; ++j, y += step.height) {
-        double x(extents.ll(0));
+    /** Grid block crossing dataset border.
+     */
+    struct BorderBlock {
+        math::Extents2 extents;
+        OptCorners corners;
+    };
+    std::vector<BorderBlock> blocks;
+
+    for (int j = 1; j < grid.rows; ++j) {
+        const double y(extents.ll(1) + (j - 1) * step.height);
 
         bool ppx(grid(j - 1, 0));
         bool pcx(grid(j, 0));
-        for (int i = 1; i < grid.cols; ++i, x += step.width) {
+        for (int i = 1; i < grid.cols; ++i) {
+            const double x(extents.ll(0) + (i - 1) * step.width);
             bool px(grid(j - 1, i));
             bool cx(grid(j, i));
 
             int corners(px + cx + ppx + pcx);
             if (corners && (corners < 4)) {
                 // border block
-                math::Extents2 be(x, y, x + step.width, y + step.height);
+                blocks.emplace_back();
+                auto &block(blocks.back());
+                block.extents = math::Extents2
+                    (x, y, x + step.width, y + step.height);
 
                 // construct corners to have same order as
                 // math::vertices(extents)
-                OptCorners corners;
-                if (ppx) { corners[0] = projectedGrid(j - 1, i - 1); }
-                if (pcx) { corners[1] = projectedGrid(j, i - 1); }
-                if (cx) { corners[2] = projectedGrid(j, i); }
-                if (px) { corners[3] = projectedGrid(j - 1, i); }
-
-                divideBorderBlock(stepInPixels, be, corners);
+                auto &c(block.corners);
+                if (ppx) { c[0] = projectedGrid(j - 1, i - 1); }
+                if (pcx) { c[1] = projectedGrid(j, i - 1); }
+                if (cx) { c[2] = projectedGrid(j, i); }
+                if (px) { c[3] = projectedGrid(j - 1, i); }
             }
 
             ppx = px;
@@ -423,6 +478,21 @@ void Node::refine()
         }
     }
 
+    // subdivide border blocks in parallel; they only extend local extents
+    UTILITY_OMP(parallel)
+    {
+        auto ctx(context());
+
+        UTILITY_OMP(for schedule(dynamic))
+        for (std::size_t b = 0; b < blocks.size(); ++b) {
+            divideBorderBlock(ctx, stepInPixels, blocks[b].extents
+                              , blocks[b].corners);
+        }
+
+        UTILITY_OMP(critical(calipers_refine))
+            merge(localExtents, ctx.localExtents);
+    }
+
     const auto ts(vts::tileSize(node.extents(), localLod));
     const auto origin(math::ul(node.extents()));
 
@@ -512,9 +582,6 @@ math::Extents2 Node::navExtents() const
 void Node::updateCameraExtents(math::Matrix4 &trafo
                                , math::Extents2 &cameraExtents) const
 {
-    const vts::CsConvertor conv
-        (node.srs(), node.referenceFrame().model.physicalSrs);
-
     // division of source dataset
     const math::Size2 steps(255, 255);
 
@@ -522,15 +589,26 @@ void Node::updateCameraExtents(math::Matrix4 &trafo
     step.width /= steps.width;
     step.height /= steps.height;
 
-    math::Points3d pc;
-    double y(localExtents.ll(1));
-    for (int j(0); j <= steps.height; ++j, y += step.height) {
-        math::Point3d p(localExtents.ll(0), y);
-        for (int i(0); i <= steps.width; ++i, p(0) += step.width) {
-            auto projected(math::transform(trafo, conv(p)));
-            math::update
-                (cameraExtents, math::Point2d(projected(0), projected(1)));
+    UTILITY_OMP(parallel)
+    {
+        // own convertor and extents for each thread
+        const vts::CsConvertor conv
+            (node.srs(), node.referenceFrame().model.physicalSrs);
+        math::Extents2 local(math::InvalidExtents{});
+
+        UTILITY_OMP(for schedule(dynamic))
+        for (int j = 0; j <= steps.height; ++j) {
+            math::Point3d p(localExtents.ll(0)
+                            , localExtents.ll(1) + j * step.height);
+            for (int i(0); i <= steps.width; ++i, p(0) += step.width) {
+                auto projected(math::transform(trafo, conv(p)));
+                math::update
+                    (local, math::Point2d(projected(0), projected(1)));
+            }
         }
+
+        UTILITY_OMP(critical(calipers_camera))
+            merge(cameraExtents, local);
     }
 }
 
@@ -581,20 +659,33 @@ Measurement measure(const vtslibs::registry::ReferenceFrame &referenceFrame
     // division of source dataset
     math::Size2 steps(255, 255);
 
-    Node::list nodes;
-
     const auto rfNodes(vts::NodeInfo::nodes(referenceFrame));
 
-    UTILITY_OMP(parallel for)
+    // Nodes are measured in parallel only if there are enough of them to
+    // keep all threads busy. Otherwise they are measured one by one and
+    // each node samples its grid in parallel instead (nested parallel
+    // regions are serialized).
+    const bool parallelNodes
+        (rfNodes.size() >= std::size_t(omp_get_max_threads()));
+
+    // results are stored by node index to keep RF order regardless of
+    // scheduling
+    Node::list measured(rfNodes.size());
+
+    UTILITY_OMP(parallel for schedule(dynamic) if(parallelNodes))
     for (std::size_t nodeIndex = 0; nodeIndex < rfNodes.size(); ++nodeIndex) {
         auto node(std::make_shared<Node>(dataset, rfNodes[nodeIndex], steps));
 
         if (node->run(invGsdScale, config.tileFractionLimit)) {
-            UTILITY_OMP(critical(calipers))
-                nodes.push_back(node);
+            measured[nodeIndex] = node;
         }
     }
 
+    Node::list nodes;
+    for (auto &node : measured) {
+        if (node) { nodes.push_back(std::move(node)); }
+    }
+
     if (nodes.empty()) {
         // not feasible
         return {};
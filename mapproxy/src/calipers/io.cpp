@@ -0,0 +1,172 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <boost/filesystem.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include "dbglog/dbglog.hpp"
+
+#include "utility/streams.hpp"
+#include "utility/path.hpp"
+
+#include "jsoncpp/json.hpp"
+#include "jsoncpp/as.hpp"
+#include "jsoncpp/io.hpp"
+
+#include "vts-libs/registry/json.hpp"
+
+#include "./io.hpp"
+
+namespace fs = boost::filesystem;
+namespace vts = vtslibs::vts;
+namespace vr = vtslibs::registry;
+
+namespace calipers {
+
+namespace {
+
+Json::Value asJson(const vts::LodRange &lr)
+{
+    Json::Value value(Json::arrayValue);
+    value.append(lr.min);
+    value.append(lr.max);
+    return value;
+}
+
+Json::Value asJson(const vts::TileRange &tr)
+{
+    Json::Value value(Json::arrayValue);
+    auto &ll(value.append(Json::arrayValue));
+    ll.append(tr.ll(0));
+    ll.append(tr.ll(1));
+    auto &ur(value.append(Json::arrayValue));
+    ur.append(tr.ur(0));
+    ur.append(tr.ur(1));
+    return value;
+}
+
+vts::LodRange lodRangeFromJson(const Json::Value &value, const char *name)
+{
+    vts::LodRange lr;
+    Json::get(lr.min, value, name, 0);
+    Json::get(lr.max, value, name, 1);
+    return lr;
+}
+
+} // namespace
+
+void save(const fs::path &path, const Measurement &m)
+{
+    Json::Value value;
+    value["datasetType"] = boost::lexical_cast<std::string>(m.datasetType);
+    value["gsd"] = m.gsd;
+    value["lodRange"] = asJson(m.lodRange);
+    value["tileRange"] = asJson(m.tileRange);
+
+    auto &nodes(value["nodes"] = Json::arrayValue);
+    for (const auto &node : m.nodes) {
+        auto &jnode(nodes.append(Json::objectValue));
+        const auto lr(node.ranges.lodRange());
+        jnode["srs"] = node.srs;
+        jnode["lodRange"] = asJson(lr);
+        // bottom tile range, ranges are reconstructed from bottom
+        jnode["tileRange"] = asJson(node.ranges.tileRange(lr.max));
+    }
+
+    value["position"] = vr::asJson(m.position);
+    value["datasetSrs"] = m.datasetSrs.toString();
+
+    auto &extents(value["datasetExtents"] = Json::arrayValue);
+    extents.append(m.datasetExtents.ll(0));
+    extents.append(m.datasetExtents.ll(1));
+    extents.append(m.datasetExtents.ur(0));
+    extents.append(m.datasetExtents.ur(1));
+
+    if (m.xOverlap) { value["xOverlap"] = *m.xOverlap; }
+
+    const auto tmpPath(utility::addExtension(path, ".tmp"));
+    {
+        utility::ofstreambuf f(tmpPath.string());
+        f.exceptions(std::ios::badbit | std::ios::failbit);
+        f.precision(15);
+        Json::write(f, value);
+        f.close();
+    }
+    fs::rename(tmpPath, path);
+}
+
+Measurement load(const fs::path &path)
+{
+    utility::ifstreambuf f(path.string());
+    f.exceptions(std::ios::badbit);
+    const auto value(Json::read<std::runtime_error>
+                     (f, path, "calipers measurement"));
+
+    Measurement m;
+    try {
+        std::string s;
+        Json::get(s, value, "datasetType");
+        m.datasetType = boost::lexical_cast<DatasetType>(s);
+        Json::get(m.gsd, value, "gsd");
+        m.lodRange = lodRangeFromJson(value, "lodRange");
+        m.tileRange = vr::tileRangeFromJson(value["tileRange"]);
+
+        for (const auto &jnode : Json::check(value["nodes"]
+                                             , Json::arrayValue))
+        {
+            m.nodes.emplace_back();
+            auto &node(m.nodes.back());
+            Json::get(node.srs, jnode, "srs");
+            node.ranges = vts::Ranges
+                (lodRangeFromJson(jnode, "lodRange")
+                 , vr::tileRangeFromJson(jnode["tileRange"])
+                 , vts::Ranges::FromBottom{});
+        }
+
+        m.position = vr::positionFromJson(value["position"]);
+
+        Json::get(s, value, "datasetSrs");
+        m.datasetSrs = geo::SrsDefinition::fromString(s);
+
+        Json::get(m.datasetExtents.ll(0), value, "datasetExtents", 0);
+        Json::get(m.datasetExtents.ll(1), value, "datasetExtents", 1);
+        Json::get(m.datasetExtents.ur(0), value, "datasetExtents", 2);
+        Json::get(m.datasetExtents.ur(1), value, "datasetExtents", 3);
+
+        if (value.isMember("xOverlap")) {
+            m.xOverlap = 0;
+            Json::get(*m.xOverlap, value, "xOverlap");
+        }
+    } catch (const Json::Error &e) {
+        LOGTHROW(err1, std::runtime_error)
+            << "Invalid calipers measurement file " << path
+            << ": <" << e.what() << ">.";
+    }
+
+    return m;
+}
+
+} // namespace calipers
@@ -30,8 +30,16 @@
 #include <map>
 #include <numeric>
 #include <algorithm>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <queue>
+#include <memory>
+#include <exception>
 
 #include <boost/optional.hpp>
+#include <boost/lexical_cast.hpp>
 #include <boost/utility/in_place_factory.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/algorithm/string/predicate.hpp>
@@ -41,6 +49,7 @@
 #include <boost/range/adaptor/reversed.hpp>
 
 #include <gdal/vrtdataset.h>
+#include <gdal_utils.h>
 
 #include "cpl_minixml.h"
 
@@ -306,10 +315,19 @@ public:
                          , const OptionalRect &dstRect = boost::none);
 
 
+    /** Adds source described by band descriptor (e.g. remembered from
+     *  another VRT of the same geometry).
+     */
+    void addSource(int band, const BandDescriptor &bd);
+
     void addBackground(const fs::path &path, const Color::optional &color
                        , const boost::optional<fs::path> &localTo
                        = boost::none);
 
+    /** Maps existing background dataset created by addBackground.
+     */
+    void useBackground(const fs::path &path, const fs::path &storePath);
+
     const geo::GeoDataset& dataset() const { return ds_; }
 
     std::size_t bandCount() const { return bandCount_; };
@@ -376,8 +394,11 @@ void VrtDs::addSimpleSource(int band, const fs::path &filename
                             , const OptionalRect &srcRect
                             , const OptionalRect &dstRect)
 {
-    BandDescriptor bd(filename, ds, srcBand, srcRect, dstRect);
+    addSource(band, BandDescriptor(filename, ds, srcBand, srcRect, dstRect));
+}
 
+void VrtDs::addSource(int band, const BandDescriptor &bd)
+{
     // set source
     {
         std::ostringstream os;
@@ -457,6 +478,14 @@ void VrtDs::addBackground(const fs::path &path
     }
 }
 
+void VrtDs::useBackground(const fs::path &path, const fs::path &storePath)
+{
+    auto bg(geo::GeoDataset::open(path));
+    for (std::size_t i(0); i != bandCount_; ++i) {
+        addSimpleSource(i, storePath, bg, i);
+    }
+}
+
 void addOverview(const fs::path &vrtPath, const fs::path &ovrPath)
 {
 
@@ -505,32 +534,99 @@ fs::path symlinkSource(const Config &config, const fs::path &path
                                        , fs::absolute(base));
 }
 
-Setup buildDatasetBase(const Config &config
-                       , const fs::path &input
-                       , const fs::path &output)
+/** GDAL warp resampling name. Resamplings unknown to GDAL (our own
+ *  kernels) fall back to cubic.
+ */
+std::string warpResampling(geo::GeoDataset::Resampling resampling)
 {
-    if (config.pathToOriginalDataset == PathToOriginalDataset::copy) {
-        LOGTHROW(err2, std::runtime_error)
-            << "Support for dataset copy not implemented yet.";
-        // TODO: use dataset->driver->CopyFiles to copy files
+    const auto name(boost::lexical_cast<std::string>(resampling));
+    if (name == "nearest") { return "near"; }
+    if (name == "minimum") { return "min"; }
+    if (name == "maximum") { return "max"; }
+    if ((name == "texture") || (name == "dem")) { return "cubic"; }
+    return name;
+}
+
+/** Writes warped VRT of input in configured target grid into path.
+ */
+void buildWarpedBase(const Config &config, const fs::path &input
+                     , const fs::path &path)
+{
+    const auto &grid(*config.grid);
+    const auto &e(grid.extents);
+
+    LOG(info3) << "Creating warped base " << path << " from " << input
+               << " in grid " << e << " / " << grid.size << ".";
+
+    std::unique_ptr< ::GDALDataset> src
+        (static_cast< ::GDALDataset*>
+         (::GDALOpenEx(input.c_str(), (GDAL_OF_RASTER | GDAL_OF_READONLY)
+                       , nullptr, nullptr, nullptr)));
+    if (!src) {
+        LOGTHROW(err3, std::runtime_error)
+            << "Cannot open input dataset " << input << ".";
     }
 
-    const auto outputDataset(output / "dataset");
+    std::vector<std::string> args{
+        "-of", "VRT", "-t_srs", grid.srs.toString()
+        , "-te", boost::lexical_cast<std::string>(e.ll(0))
+        , boost::lexical_cast<std::string>(e.ll(1))
+        , boost::lexical_cast<std::string>(e.ur(0))
+        , boost::lexical_cast<std::string>(e.ur(1))
+        , "-ts", boost::lexical_cast<std::string>(grid.size.width)
+        , boost::lexical_cast<std::string>(grid.size.height)
+        , "-r", warpResampling(config.resampling)
+        , "-overwrite"
+    };
 
-    fs::path inputDataset("./original");
-    {
-        // use original file name for datasets that insist of special name
-        const auto des(geo::GeoDataset::open(input).descriptor());
-        if (des.driverName == "SRTMHGT") {
-            inputDataset = input.filename();
-        }
+    // area outside of the input must be invalid
+    geo::OptionalNodataValue nodata(config.nodata);
+    if (!nodata) {
+        int has(false);
+        const auto value(src->GetRasterBand(1)->GetNoDataValue(&has));
+        if (has) { nodata = geo::NodataValue(value); }
+    }
+    if (nodata && *nodata) {
+        args.push_back("-dstnodata");
+        args.push_back(boost::lexical_cast<std::string>(**nodata));
+    } else {
+        LOG(warn3) << "Input " << input << " has no nodata value; area "
+            "outside of it is valid in the reprojected output. Use "
+            "--nodata to set one.";
     }
 
-    fs::path inputDatasetSymlink(output / inputDataset);
+    std::vector<char*> argv;
+    for (auto &arg : args) { argv.push_back(&arg[0]); }
+    argv.push_back(nullptr);
 
-    LOG(info3) << "Creating dataset base in " << outputDataset
-               << " from " << inputDatasetSymlink << ".";
+    std::unique_ptr< ::GDALWarpAppOptions, void(*)(::GDALWarpAppOptions*)>
+        options(::GDALWarpAppOptionsNew(argv.data(), nullptr)
+                , &::GDALWarpAppOptionsFree);
+    if (!options) {
+        LOGTHROW(err3, std::runtime_error)
+            << "Invalid warp options: <" << ::CPLGetLastErrorMsg() << ">.";
+    }
+
+    boost::system::error_code ec;
+    fs::remove(path, ec);
 
+    ::GDALDatasetH srcDs(src.get());
+    int usageError(false);
+    auto *out(::GDALWarp(path.c_str(), nullptr, 1, &srcDs, options.get()
+                         , &usageError));
+    if (!out) {
+        LOGTHROW(err3, std::runtime_error)
+            << "Cannot create warped base " << path << ": <"
+            << ::CPLGetLastErrorMsg() << ">.";
+    }
+    ::GDALClose(out);
+}
+
+/** Links input dataset and its "sidecar" files into output.
+ */
+void linkInput(const Config &config, const fs::path &input
+               , const fs::path &output, const fs::path &inputDatasetSymlink)
+{
     // make a symlink, remove newpath beforehand
     auto symlink([](const fs::path &oldpath, const fs::path &newpath)
     {
@@ -561,6 +657,40 @@ Setup buildDatasetBase(const Config &config
             }
         }
     }
+}
+
+Setup buildDatasetBase(const Config &config
+                       , const fs::path &input
+                       , const fs::path &output)
+{
+    if (config.pathToOriginalDataset == PathToOriginalDataset::copy) {
+        LOGTHROW(err2, std::runtime_error)
+            << "Support for dataset copy not implemented yet.";
+        // TODO: use dataset->driver->CopyFiles to copy files
+    }
+
+    const auto outputDataset(output / "dataset");
+
+    fs::path inputDataset("./original");
+    {
+        // use original file name for datasets that insist of special name
+        const auto des(geo::GeoDataset::open(input).descriptor());
+        if (des.driverName == "SRTMHGT") {
+            inputDataset = input.filename();
+        }
+    }
+
+    fs::path inputDatasetSymlink(output / inputDataset);
+
+    LOG(info3) << "Creating dataset base in " << outputDataset
+               << " from " << inputDatasetSymlink << ".";
+
+    if (config.grid) {
+        // reprojected input
+        buildWarpedBase(config, input, inputDatasetSymlink);
+    } else {
+        linkInput(config, input, output, inputDatasetSymlink);
+    }
 
     auto in(geo::GeoDataset::open(inputDatasetSymlink));
 
@@ -793,7 +923,7 @@ void copyWithMask(const geo::GeoDataset &src, geo::GeoDataset &dst)
     }
 }
 
-void createOutputDataset(const geo::GeoDataset &original
+void createOutputDataset(const geo::GeoDataset::Format &originalFormat
                          , const geo::GeoDataset &src
                          , const fs::path &path
                          , const geo::Options &createOptions
@@ -807,7 +937,7 @@ void createOutputDataset(const geo::GeoDataset &original
     }
 
     // we need to create output dataset manually
-    auto format(original.getFormat());
+    auto format(originalFormat);
     // use custom format to prevent .tfw and .prj creation...
     format.storageType = geo::GeoDataset::Format::Storage::custom;
     format.driver = "GTiff";
@@ -823,6 +953,378 @@ void createOutputDataset(const geo::GeoDataset &original
     dst.flush();
 }
 
+/** Writes finished overview tiles in background threads so that compression
+ *  of finished tiles overlaps with warping of the next ones.
+ */
+class TileWriter {
+public:
+    struct Tile {
+        geo::GeoDataset ds;
+        fs::path name;
+        Rect drect;
+        std::string id;
+        utility::DurationMeter timer;
+        /** Tile index in its level. */
+        int index;
+
+        Tile(geo::GeoDataset &&ds, const fs::path &name, const Rect &drect
+             , const std::string &id, const utility::DurationMeter &timer
+             , int index)
+            : ds(std::move(ds)), name(name), drect(drect), id(id)
+            , timer(timer), index(index)
+        {}
+    };
+
+    typedef std::function<void(Tile&)> Write;
+
+    /** No threads means tiles are written directly by push().
+     */
+    TileWriter(std::size_t threads, const Write &write)
+        : write_(write), limit_(2 * threads), stop_(false)
+    {
+        for (std::size_t i(0); i < threads; ++i) {
+            threads_.emplace_back(&TileWriter::run, this);
+        }
+    }
+
+    ~TileWriter() { stop(); }
+
+    /** Queues tile for writing. Blocks while the queue is full.
+     */
+    void push(Tile &&tile);
+
+    /** Waits until all queued tiles are written. Rethrows first write
+     *  error.
+     */
+    void finish();
+
+private:
+    void run();
+    void stop();
+
+    const Write write_;
+    const std::size_t limit_;
+
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::deque<Tile> queue_;
+    bool stop_;
+    std::exception_ptr error_;
+
+    std::vector<std::thread> threads_;
+};
+
+void TileWriter::push(Tile &&tile)
+{
+    if (threads_.empty()) {
+        write_(tile);
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    cond_.wait(lock, [&]() { return (queue_.size() < limit_) || error_; });
+    if (error_) { return; }
+    queue_.push_back(std::move(tile));
+    cond_.notify_all();
+}
+
+void TileWriter::run()
+{
+    dbglog::thread_id("writer");
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        cond_.wait(lock, [&]() { return stop_ || !queue_.empty(); });
+        if (queue_.empty()) { return; }
+
+        auto tile(std::move(queue_.front()));
+        queue_.pop_front();
+        cond_.notify_all();
+
+        lock.unlock();
+        try {
+            write_(tile);
+        } catch (...) {
+            lock.lock();
+            if (!error_) { error_ = std::current_exception(); }
+            // drop the rest, producers are unblocked
+            queue_.clear();
+            cond_.notify_all();
+            continue;
+        }
+        lock.lock();
+    }
+}
+
+void TileWriter::stop()
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        stop_ = true;
+        cond_.notify_all();
+    }
+
+    for (auto &thread : threads_) { thread.join(); }
+    threads_.clear();
+}
+
+void TileWriter::finish()
+{
+    stop();
+    if (error_) { std::rethrow_exception(error_); }
+}
+
+/** Overview level being generated.
+ */
+struct Level {
+    typedef std::unique_ptr<Level> pointer;
+
+    int index;
+    /** Level directory (relative to output). */
+    fs::path dir;
+    /** Level VRT (relative to output). */
+    fs::path ovrName;
+    math::Size2 size;
+    math::Size2 tiled;
+    /** Tile size in pixels. */
+    math::Size2 tilePixels;
+
+    /** Create options with PREDICTOR derived from source data type. */
+    geo::Options createOptions;
+    geo::GeoDataset::Format srcFormat;
+
+    std::unique_ptr<VrtDs> ovr;
+
+    math::Extents2 extents;
+    /** Tile size in real extents. */
+    math::Size2f tileSize;
+    /** Extent's upper-left corner, origin for tile calculations. */
+    math::Point2 origin;
+    /** Size of last tile in row/column. */
+    math::Size2 lts;
+
+    /** Sources of stored tiles, indexed by tile index. */
+    std::vector<BandDescriptor::list> sources;
+
+    /** Guards ovr and sources. */
+    std::mutex mutex;
+
+    Level(const geo::GeoDataset::Format &srcFormat)
+        : index(), srcFormat(srcFormat)
+    {}
+
+    int tileCount() const { return math::area(tiled); }
+
+    math::Point2i tile(int i) const {
+        return math::Point2i(i % tiled.width, i / tiled.width);
+    }
+
+    math::Size2 pxSize(const math::Point2i &tile) const;
+
+    math::Extents2 tileExtents(const math::Point2i &tile) const;
+};
+
+math::Size2 Level::pxSize(const math::Point2i &tile) const
+{
+    const bool lastX(tile(0) == (tiled.width - 1));
+    const bool lastY(tile(1) == (tiled.height - 1));
+    return math::Size2(lastX ? lts.width : tilePixels.width
+                       , lastY ? lts.height : tilePixels.height);
+}
+
+math::Extents2 Level::tileExtents(const math::Point2i &tile) const
+{
+    const bool lastX(tile(0) == (tiled.width - 1));
+    const bool lastY(tile(1) == (tiled.height - 1));
+
+    math::Point2 ul(origin(0) + tileSize.width * tile(0)
+                    , origin(1) - tileSize.height * tile(1));
+    math::Point2 lr(lastX ? extents.ur(0) : ul(0) + tileSize.width
+                    , lastY ? extents.ll(1): ul(1) - tileSize.height);
+
+    return math::Extents2(ul(0), lr(1), lr(0), ul(1));
+}
+
+/** Prepares overview level: its VRT, background and tile geometry. Source
+ *  metadata (SRS, extents, format, nodata) are taken from metaPath.
+ */
+Level::pointer prepareLevel(const Config &config
+                            , const boost::filesystem::path &output
+                            , int ovrIndex
+                            , const fs::path &metaPath
+                            , const fs::path &dir
+                            , const math::Size2 &size
+                            , const math::Size2 &tiled
+                            , MaskType maskType)
+{
+    auto src(geo::GeoDataset::open(metaPath));
+
+    Level::pointer level(new Level(src.getFormat()));
+    level->index = ovrIndex;
+    level->dir = dir;
+    level->ovrName = dir / "ovr.vrt";
+    level->size = size;
+    level->tiled = tiled;
+    level->tilePixels = config.tileSize;
+    level->sources.resize(math::area(tiled));
+
+    const auto ovrPath(output / level->ovrName);
+    const auto &ts(config.tileSize);
+
+    // copy options so that the PREDICTOR can be possibly modified
+    level->createOptions = config.createOptions;
+
+    // If create options contain PREDICTOR, check/set its value based on
+    // original dataset type.
+    auto &opts(level->createOptions.options);
+    auto it(std::find_if( opts.begin(), opts.end()
+                         , [](const geo::Options::Option &op)
+                           {
+                                return op.first == "PREDICTOR";
+                           }));
+
+    if (it != opts.end()) {
+        // find out what the value of predictor should be
+        auto predictor([&]() -> std::string {
+            switch (src.descriptor().dataType) {
+            case ::GDT_Float32:
+            case ::GDT_Float64:
+                return "3";
+            default:
+                break;
+            }
+            return "2";
+        }());
+
+        // set predictor to optimal
+        if (it->second.empty()) {
+            it->second = predictor;
+
+        // leave it if predictor is turned off
+        } else if (it->second == "1") {
+
+        // if predictor is set, check if the value is right
+        } else if (it->second != predictor) {
+            LOGTHROW(err2, std::runtime_error)
+                << "PREDICTOR value and bandtype mismatch. Use 2 for "
+                << "integer and 3 for floating point or leave without "
+                << "value to be determined automatically.";
+        }
+    }
+
+    level->ovr.reset(new VrtDs(ovrPath, src.srs(), src.extents()
+                               , size, src.getFormat(), src.rawNodataValue()
+                               , maskType));
+
+    auto &extents(level->extents);
+    extents = level->ovr->dataset().extents();
+    level->ovr->addBackground(output / dir, config.background, fs::path());
+
+    // compute tile size in real extents
+    const auto es(math::size(extents));
+    level->tileSize = math::Size2f((es.width * ts.width) / size.width
+                                   , (es.height * ts.height) / size.height);
+    level->origin = ul(extents);
+
+    // last tile size
+    level->lts = math::Size2(size.width - (tiled.width - 1) * ts.width
+                             , size.height - (tiled.height - 1) * ts.height);
+
+    return level;
+}
+
+/** Warps single tile of given level from src. Returns null if the tile is
+ *  empty and need not be stored.
+ */
+std::unique_ptr<TileWriter::Tile>
+warpTile(const Config &config, const Level &level, int i
+         , const geo::GeoDataset &src, MaskType maskType
+         , std::atomic<int> &progress, int total)
+{
+    utility::DurationMeter timer;
+    const auto tile(level.tile(i));
+    const auto pxSize(level.pxSize(tile));
+    const auto te(level.tileExtents(tile));
+
+    const auto tileId(str(boost::format("%d-%d-%d")
+                          % level.index % tile(0) % tile(1)));
+    TIDGuard tg("tile:" + tileId);
+
+    LOG(info2)
+        << std::fixed
+        << "Processing tile " << tileId << " (size: " << pxSize
+        << ", extents: " << te << ").";
+
+    // use full dataset and disable safe-chunking
+    geo::GeoDataset::WarpOptions warpOptions;
+    warpOptions.overview = geo::GeoDataset::Overview();
+    warpOptions.safeChunks = false;
+
+    // try warp
+    auto tmp(createTmpDataset(src, te, pxSize, maskType));
+
+    src.warpInto(tmp, config.resampling, warpOptions);
+
+    // check result and skip if no need to store
+    if (emptyTile(config, tmp)) {
+        auto id(++progress);
+        LOG(info3)
+            << std::fixed
+            << "Processed tile #" << id << '/' << total << ' '
+            << tileId << " (size: " << pxSize
+            << ", extents: " << te << ") [empty]"
+            << "; duration: "
+            << utility::formatDuration(timer.duration()) << ".";
+        return {};
+    }
+
+    // strore result to file
+    fs::path tileName(str(boost::format("%d-%d.tif") % tile(0) % tile(1)));
+    const auto &ts(config.tileSize);
+    Rect drect(math::Point2i(tile(0) * ts.width, tile(1) * ts.height)
+               , pxSize);
+
+    return std::unique_ptr<TileWriter::Tile>
+        (new TileWriter::Tile(std::move(tmp), tileName, drect, tileId
+                              , timer, i));
+}
+
+/** Compresses and stores warped tile and adds it to its level's VRT.
+ */
+void storeTile(const fs::path &output, Level &level, TileWriter::Tile &tile
+               , MaskType maskType, std::atomic<int> &progress, int total)
+{
+    TIDGuard tg("tile:" + tile.id);
+
+    // make room for output file
+    const fs::path tilePath(output / level.dir / tile.name);
+    fs::remove(tilePath);
+
+    createOutputDataset(level.srcFormat, tile.ds, tilePath
+                        , level.createOptions // use modified options
+                        , maskType);
+
+    // store result
+    {
+        std::lock_guard<std::mutex> lock(level.mutex);
+        auto &sources(level.sources[tile.index]);
+        for (std::size_t b(0), eb(level.ovr->bandCount()); b != eb; ++b) {
+            sources.emplace_back(tile.name, tile.ds, b, boost::none
+                                 , tile.drect);
+            level.ovr->addSource(b, sources.back());
+        }
+    }
+
+    auto id(++progress);
+    LOG(info3)
+        << std::fixed
+        << "Processed tile #" << id << '/' << total << ' ' << tile.id
+        << " (size: " << tile.drect.size
+        << ", extents: " << tile.ds.extents() << ") [valid]"
+        << "; duration: "
+        << utility::formatDuration(tile.timer.duration()) << ".";
+}
+
 fs::path createOverview(const Config &config
                         , const boost::filesystem::path &output
                         , int ovrIndex
@@ -833,180 +1335,424 @@ fs::path createOverview(const Config &config
                         , std::atomic<int> &progress, int total
                         , MaskType maskType)
 {
-    auto ovrName(dir / "ovr.vrt");
-    auto ovrPath(output / ovrName);
-    const auto &ts(config.tileSize);
+    auto level(prepareLevel(config, output, ovrIndex, srcPath, dir, size
+                            , tiled, maskType));
 
     LOG(info3)
         << "Creating overview #" << ovrIndex
         << " of " << math::area(tiled) << " tiles in "
-        << ovrPath << " from " << srcPath << ".";
+        << (output / level->ovrName) << " from " << srcPath << ".";
 
-    // copy options so that the PREDICTOR can be possibly modified
-    geo::Options createOptions(config.createOptions);
+    const auto tc(level->tileCount());
 
-    VrtDs ovr([&]() -> VrtDs
+    // compresses and stores finished tiles while next ones are being warped
+    TileWriter writer(config.writerThreads, [&](TileWriter::Tile &tile)
     {
-        auto src(geo::GeoDataset::open(srcPath));
+        storeTile(output, *level, tile, maskType, progress, total);
+    });
 
-        // If create options contain PREDICTOR, check/set its value based on
-        // original dataset type.
-        auto &opts(createOptions.options);
-        auto it(std::find_if( opts.begin(), opts.end()
-                             , [](const geo::Options::Option &op)
-                               {
-                                    return op.first == "PREDICTOR";
-                               }));
+    UTILITY_OMP(parallel)
+    {
+        // one source dataset per thread for the whole overview level: VRT
+        // is parsed once and block cache survives between tiles
+        auto src(geo::GeoDataset::open(srcPath));
 
-        if (it != opts.end()) {
-            // find out what the value of predictor should be
-            auto predictor([&]() -> std::string {
-                switch (src.descriptor().dataType) {
-                case ::GDT_Float32:
-                case ::GDT_Float64:
-                    return "3";
-                default:
-                    break;
-                }
-                return "2";
-            }());
-
-            // set predictor to optimal
-            if (it->second.empty()) {
-                it->second = predictor;
-
-            // leave it if predictor is turned off
-            } else if (it->second == "1") {
-
-            // if predictor is set, check if the value is right
-            } else if (it->second != predictor) {
-                LOGTHROW(err2, std::runtime_error)
-                    << "PREDICTOR value and bandtype mismatch. Use 2 for "
-                    << "integer and 3 for floating point or leave without "
-                    << "value to be determined automatically.";
+        UTILITY_OMP(for schedule(dynamic))
+        for (int i = 0; i < tc; ++i) {
+            if (auto tile = warpTile(config, *level, i, src, maskType
+                                     , progress, total))
+            {
+                writer.push(std::move(*tile));
             }
         }
+    }
+
+    writer.finish();
 
-        return VrtDs(ovrPath, src.srs(), src.extents()
-                     , size, src.getFormat(), src.rawNodataValue()
-                     , maskType);
-    }());
+    level->ovr->flush();
 
-    (void) maskType;
+    return level->ovrName;
+}
 
-    auto extents(ovr.dataset().extents());
-    ovr.addBackground(output / dir, config.background, fs::path());
+/** Builds all overview levels at once. Tile of level N+1 is warped as soon
+ *  as all tiles of level N under it (plus one tile margin for the
+ *  resampling kernel) are stored; it reads them through a small VRT window
+ *  instead of the (still unfinished) whole level N VRT.
+ */
+class Wavefront {
+public:
+    Wavefront(const Config &config, const fs::path &output
+              , const fs::path &inputPath, std::vector<Level::pointer> &levels
+              , MaskType maskType, std::atomic<int> &progress, int total);
 
+    /** Worker thread body. Runs until all tiles are done or any fails.
+     */
+    void work();
 
-    // compute tile size in real extents
-    auto tileSize([&]() -> math::Size2f
-    {
-        auto es(math::size(extents));
-        return math::Size2f((es.width * ts.width) / size.width
-                            , (es.height * ts.height) / size.height);
-    }());
-    // extent's upper-left corner is origin for tile calculations
-    math::Point2 origin(ul(extents));
+    /** Rethrows first error.
+     */
+    void check() const {
+        if (error_) { std::rethrow_exception(error_); }
+    }
 
-    auto tc(math::area(tiled));
+private:
+    typedef std::pair<int, int> TileRef; // level, tile index
 
-    // last tile size
-    math::Size2 lts(size.width - (tiled.width - 1) * ts.width
-                    , size.height - (tiled.height - 1) * ts.height);
+    /** Tiles of previous level needed by given tile.
+     */
+    std::vector<int> dependencies(int level, int i) const;
 
-    // Dataset dataset(srcPath.string());
+    void process(const TileRef &ref, std::unique_ptr<geo::GeoDataset> &base);
 
-    // use full dataset and disable safe-chunking
-    geo::GeoDataset::WarpOptions warpOptions;
-    warpOptions.overview = geo::GeoDataset::Overview();
-    warpOptions.safeChunks = false;
+    /** Builds VRT window over finished tiles of previous level.
+     */
+    fs::path window(const TileRef &ref);
 
-    // UTILITY_OMP(parallel for firstprivate(dataset) schedule(dynamic))
-    UTILITY_OMP(parallel for schedule(dynamic))
-        for (int i = 0; i < tc; ++i) {
-            utility::DurationMeter timer;
-            math::Point2i tile(i % tiled.width, i / tiled.width);
-
-            bool lastX(tile(0) == (tiled.width - 1));
-            bool lastY(tile(1) == (tiled.height - 1));
-
-            math::Size2 pxSize(lastX ? lts.width : ts.width
-                               , lastY ? lts.height : ts.height);
-
-            // calculate extents
-            math::Point2 ul(origin(0) + tileSize.width * tile(0)
-                            , origin(1) - tileSize.height * tile(1));
-            math::Point2 lr(lastX ? extents.ur(0) : ul(0) + tileSize.width
-                            , lastY ? extents.ll(1): ul(1) - tileSize.height);
-
-            math::Extents2 te(ul(0), lr(1), lr(0), ul(1));
-            TIDGuard tg(str(boost::format("tile:%d-%d-%d")
-                            % ovrIndex % tile(0) % tile(1)));
-
-            LOG(info2)
-                << std::fixed
-                << "Processing tile " << ovrIndex
-                << '-' << tile(0) << '-' << tile(1) << " (size: " << pxSize
-                << ", extents: " << te << ").";
-
-            // try warp
-            auto src(geo::GeoDataset::open(srcPath));
-
-            // auto &src(dataset.ds());
-
-            // strore result to file
-            fs::path tileName(str(boost::format("%d-%d.tif")
-                                  % tile(0) % tile(1)));
-            fs::path tilePath(output / dir / tileName);
-
-            auto tmp(createTmpDataset(src, te, pxSize, maskType));
-
-            src.warpInto(tmp, config.resampling, warpOptions);
-
-            // check result and skip if no need to store
-            if (emptyTile(config, tmp)) {
-                auto id(++progress);
-                LOG(info3)
-                    << std::fixed
-                    << "Processed tile #" << id << '/' << total << ' '
-                    << ovrIndex
-                    << '-' << tile(0) << '-' << tile(1) << " (size: " << pxSize
-                    << ", extents: " << te << ") [empty]"
-                    << "; duration: "
-                    << utility::formatDuration(timer.duration()) << ".";
+    void done(const TileRef &ref);
+
+    const Config &config_;
+    const fs::path output_;
+    const fs::path inputPath_;
+    std::vector<Level::pointer> &levels_;
+    const MaskType maskType_;
+    std::atomic<int> &progress_;
+    const int total_;
+
+    /** Unfinished dependencies of each tile of each level.
+     */
+    std::vector<std::vector<int>> pending_;
+
+    /** Tiles of next level depending on each tile of each level.
+     */
+    std::vector<std::vector<std::vector<int>>> dependents_;
+
+    std::mutex mutex_;
+    std::condition_variable cond_;
+
+    /** Ready tiles, deeper (i.e. coarser) levels first so that the tiles
+     *  they read are still in the page cache.
+     */
+    std::priority_queue<TileRef> ready_;
+    std::size_t remaining_;
+    std::exception_ptr error_;
+};
+
+Wavefront::Wavefront(const Config &config, const fs::path &output
+                     , const fs::path &inputPath
+                     , std::vector<Level::pointer> &levels
+                     , MaskType maskType, std::atomic<int> &progress
+                     , int total)
+    : config_(config), output_(output), inputPath_(inputPath)
+    , levels_(levels), maskType_(maskType), progress_(progress)
+    , total_(total), pending_(levels.size()), dependents_(levels.size())
+    , remaining_()
+{
+    for (std::size_t l(0); l < levels_.size(); ++l) {
+        const auto tc(levels_[l]->tileCount());
+        pending_[l].resize(tc);
+        dependents_[l].resize(tc);
+        remaining_ += tc;
+
+        for (int i(0); i < tc; ++i) {
+            if (!l) {
+                ready_.emplace(l, i);
                 continue;
             }
 
-            // make room for output file
-            fs::remove(tilePath);
+            const auto deps(dependencies(l, i));
+            pending_[l][i] = deps.size();
+            for (auto dep : deps) { dependents_[l - 1][dep].push_back(i); }
+            if (deps.empty()) { ready_.emplace(l, i); }
+        }
+    }
+}
+
+std::vector<int> Wavefront::dependencies(int l, int i) const
+{
+    const auto &level(*levels_[l]);
+    const auto &prev(*levels_[l - 1]);
+
+    // margin of 16 pixels of previous level covers any resampling kernel
+    auto te(level.tileExtents(level.tile(i)));
+    const auto es(math::size(prev.extents));
+    const math::Size2f margin(16.0 * es.width / prev.size.width
+                              , 16.0 * es.height / prev.size.height);
+    te.ll(0) -= margin.width; te.ur(0) += margin.width;
+    te.ll(1) -= margin.height; te.ur(1) += margin.height;
+
+    const auto clamp([](double value, int max) -> int
+    {
+        return std::max(0, std::min(int(std::floor(value)), max - 1));
+    });
 
-            createOutputDataset(src, tmp, tilePath
-                                , createOptions // use modified options
-                                , maskType);
+    const int x0(clamp((te.ll(0) - prev.origin(0)) / prev.tileSize.width
+                       , prev.tiled.width));
+    const int x1(clamp((te.ur(0) - prev.origin(0)) / prev.tileSize.width
+                       , prev.tiled.width));
+    const int y0(clamp((prev.origin(1) - te.ur(1)) / prev.tileSize.height
+                       , prev.tiled.height));
+    const int y1(clamp((prev.origin(1) - te.ll(1)) / prev.tileSize.height
+                       , prev.tiled.height));
+
+    std::vector<int> deps;
+    for (int y(y0); y <= y1; ++y) {
+        for (int x(x0); x <= x1; ++x) {
+            deps.push_back(y * prev.tiled.width + x);
+        }
+    }
+    return deps;
+}
 
-            // store result
-            Rect drect(math::Point2i(tile(0) * ts.width, tile(1) * ts.height)
-                       , pxSize);
+void Wavefront::work()
+{
+    // base dataset is opened once per thread
+    std::unique_ptr<geo::GeoDataset> base;
 
-            UTILITY_OMP(critical(createOverwiew_addSimpleSource))
-                for (std::size_t b(0), eb(ovr.bandCount()); b != eb; ++b) {
-                    ovr.addSimpleSource(b, tileName, tmp, b
-                                        , boost::none, drect);
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        cond_.wait(lock, [&]()
+        {
+            return !ready_.empty() || !remaining_ || error_;
+        });
+        if (!remaining_ || error_) { return; }
+
+        const auto ref(ready_.top());
+        ready_.pop();
+
+        lock.unlock();
+        try {
+            process(ref, base);
+        } catch (...) {
+            lock.lock();
+            if (!error_) { error_ = std::current_exception(); }
+            cond_.notify_all();
+            return;
+        }
+        lock.lock();
+
+        // release dependents
+        --remaining_;
+        if (static_cast<std::size_t>(ref.first + 1) < levels_.size()) {
+            auto &pending(pending_[ref.first + 1]);
+            for (auto dependent : dependents_[ref.first][ref.second]) {
+                if (!--pending[dependent]) {
+                    ready_.emplace(ref.first + 1, dependent);
                 }
+            }
+        }
+        cond_.notify_all();
+    }
+}
+
+void Wavefront::process(const TileRef &ref
+                        , std::unique_ptr<geo::GeoDataset> &base)
+{
+    auto &level(*levels_[ref.first]);
+
+    if (!ref.first) {
+        if (!base) {
+            base.reset(new geo::GeoDataset
+                       (geo::GeoDataset::open(inputPath_)));
+        }
+        if (auto tile = warpTile(config_, level, ref.second, *base, maskType_
+                                 , progress_, total_))
+        {
+            storeTile(output_, level, *tile, maskType_, progress_, total_);
+        }
+        return;
+    }
+
+    const auto windowPath(window(ref));
+    struct Cleanup {
+        const fs::path &path;
+        ~Cleanup() { boost::system::error_code ec; fs::remove(path, ec); }
+    } cleanup{windowPath};
+
+    auto src(geo::GeoDataset::open(windowPath));
+    if (auto tile = warpTile(config_, level, ref.second, src, maskType_
+                             , progress_, total_))
+    {
+        storeTile(output_, level, *tile, maskType_, progress_, total_);
+    }
+}
+
+fs::path Wavefront::window(const TileRef &ref)
+{
+    auto &prev(*levels_[ref.first - 1]);
+
+    // window lives next to previous level's tiles, relative paths work
+    const fs::path path(output_ / prev.dir
+                        / str(boost::format("window-%d-%d.vrt")
+                              % ref.first % ref.second));
+
+    std::lock_guard<std::mutex> lock(prev.mutex);
+
+    const auto &meta(prev.ovr->dataset());
+    VrtDs window(path, meta.srs(), meta.extents(), prev.size
+                 , prev.srcFormat, meta.rawNodataValue(), maskType_);
+
+    if (config_.background) {
+        window.useBackground(output_ / prev.dir / "bg.solid", "bg.solid");
+    }
+
+    for (auto dep : dependencies(ref.first, ref.second)) {
+        const auto &sources(prev.sources[dep]);
+        for (std::size_t b(0); b < sources.size(); ++b) {
+            window.addSource(b, sources[b]);
+        }
+    }
+    window.flush();
+
+    return path;
+}
+
+std::vector<fs::path>
+generateWavefront(const Config &config, const fs::path &output
+                  , const Setup &setup, std::atomic<int> &progress
+                  , int total)
+{
+    // all levels share geometry metadata of the base dataset
+    std::vector<Level::pointer> levels;
+    for (std::size_t i(0); i != setup.ovrSizes.size(); ++i) {
+        auto dir(str(boost::format("%d") % i));
+        fs::create_directories(output / dir);
+        levels.push_back(prepareLevel(config, output, i, setup.outputDataset
+                                      , dir, setup.ovrSizes[i]
+                                      , setup.ovrTiled[i], setup.maskType));
+    }
+
+    LOG(info3) << "Creating " << levels.size()
+               << " overviews in wavefront mode.";
+
+    Wavefront wavefront(config, output, setup.outputDataset, levels
+                        , setup.maskType, progress, total);
+
+    UTILITY_OMP(parallel)
+        wavefront.work();
+
+    wavefront.check();
+
+    std::vector<fs::path> overviews;
+    for (auto &level : levels) {
+        level->ovr->flush();
+        overviews.push_back(level->ovrName);
+    }
+    return overviews;
+}
 
-            auto id(++progress);
-            LOG(info3)
-                << std::fixed
-                << "Processed tile #" << id << '/' << total << ' ' << ovrIndex
-                << '-' << tile(0) << '-' << tile(1) << " (size: " << pxSize
-                << ", extents: " << te << ") [valid]"
-                << "; duration: "
-                << utility::formatDuration(timer.duration()) << ".";
+/** Builds COG create options from tile create options. Only options
+ *  understood by the COG driver are copied.
+ */
+geo::Options cogOptions(const Config &config, bool overviews)
+{
+    geo::Options options;
+    options("BLOCKSIZE", config.cogBlockSize);
+    options("BIGTIFF", "IF_SAFER");
+    options("OVERVIEWS", overviews ? "FORCE_USE_EXISTING" : "NONE");
+
+    for (const auto &op : config.createOptions.options) {
+        if (op.first == "PREDICTOR") {
+            // let the driver choose predictor based on data type
+            options("PREDICTOR", "YES");
+        } else if ((op.first == "COMPRESS") || (op.first == "QUALITY")
+                   || (op.first == "NUM_THREADS"))
+        {
+            options(op.first, op.second);
+        } else if (op.first == "ZLEVEL") {
+            options("LEVEL", op.second);
         }
+    }
+    return options;
+}
 
-    ovr.flush();
+/** Removes tiles of converted overview.
+ */
+void removeTiles(const fs::path &output, const fs::path &ovrName)
+{
+    boost::system::error_code ec;
+    fs::remove_all(output / ovrName.parent_path(), ec);
+    if (ec) {
+        LOG(warn3) << "Unable to remove converted tiles in "
+                   << (output / ovrName.parent_path()) << ": "
+                   << ec.message() << ".";
+    }
+}
 
-    return ovrName;
+/** Converts each overview into single COG next to the dataset.
+ */
+std::vector<fs::path> cogLevels(const Config &config, const fs::path &output
+                                , const std::vector<fs::path> &overviews)
+{
+    const auto options(cogOptions(config, false));
+
+    std::vector<fs::path> cogs;
+    for (std::size_t i(0); i != overviews.size(); ++i) {
+        const fs::path cog(str(boost::format("%d.tif") % i));
+        LOG(info3) << "Converting overview #" << i << " into COG "
+                   << (output / cog) << ".";
+        geo::GeoDataset::open(output / overviews[i])
+            .copy(output / cog, "COG", options);
+        removeTiles(output, overviews[i]);
+        cogs.push_back(cog);
+    }
+    return cogs;
+}
+
+/** Converts all overviews into one COG. First overview is the main image,
+ *  the rest become its internal overviews. Internal overviews are exposed
+ *  to the dataset via small VRTs opening the COG at given overview level.
+ */
+std::vector<fs::path> cogPyramid(const Config &config, const fs::path &output
+                                 , const std::vector<fs::path> &overviews)
+{
+    const fs::path cog("pyramid.tif");
+    const auto base(output / overviews.front());
+
+    // register remaining levels as overviews of the first one
+    for (std::size_t i(1); i < overviews.size(); ++i) {
+        addOverview(base, fs::path("..") / overviews[i]);
+    }
+
+    LOG(info3) << "Converting " << overviews.size()
+               << " overviews into COG " << (output / cog) << ".";
+    geo::GeoDataset::open(base).copy(output / cog, "COG"
+                                     , cogOptions(config, true));
+
+    auto *driver(::GetGDALDriverManager()->GetDriverByName("VRT"));
+    if (!driver) {
+        LOGTHROW(err3, std::runtime_error)
+            << "Cannot find GDAL VRT driver.";
+    }
+
+    std::vector<fs::path> cogs{cog};
+    for (std::size_t i(1); i < overviews.size(); ++i) {
+        const fs::path vrt(str(boost::format("%d.vrt") % i));
+        const auto level(str(boost::format("OVERVIEW_LEVEL=%d") % (i - 1)));
+        const char *openOptions[] = { level.c_str(), nullptr };
+
+        std::unique_ptr< ::GDALDataset> src
+            (static_cast< ::GDALDataset*>
+             (::GDALOpenEx((output / cog).c_str()
+                           , (GDAL_OF_RASTER | GDAL_OF_READONLY)
+                           , nullptr, openOptions, nullptr)));
+        if (!src) {
+            LOGTHROW(err3, std::runtime_error)
+                << "Cannot open overview " << (i - 1) << " of "
+                << (output / cog) << ".";
+        }
+
+        std::unique_ptr< ::GDALDataset> dst
+            (driver->CreateCopy((output / vrt).c_str(), src.get(), false
+                                , nullptr, nullptr, nullptr));
+        if (!dst) {
+            LOGTHROW(err3, std::runtime_error)
+                << "Cannot create VRT " << (output / vrt) << ".";
+        }
+        cogs.push_back(vrt);
+    }
+
+    for (const auto &ovr : overviews) { removeTiles(output, ovr); }
+    return cogs;
 }
 
 } // namespace
@@ -1037,22 +1783,42 @@ void generate(const boost::filesystem::path &input
 
     std::atomic<int> progress(0);
 
-    // generate overviews
-    fs::path inputPath(setup.outputDataset);
-    for (std::size_t i(0); i != setup.ovrSizes.size(); ++i) {
-        auto dir(str(boost::format("%d") % i));
-        fs::create_directories(output / dir);
+    std::vector<fs::path> overviews;
+    if (config.wavefront) {
+        overviews = generateWavefront(config, output, setup, progress, total);
+    } else {
+        // generate overviews
+        fs::path inputPath(setup.outputDataset);
+        for (std::size_t i(0); i != setup.ovrSizes.size(); ++i) {
+            auto dir(str(boost::format("%d") % i));
+            fs::create_directories(output / dir);
+
+            auto path(createOverview
+                      (config, output, i, inputPath, dir, setup.ovrSizes[i]
+                       , setup.ovrTiled[i], progress, total
+                       , setup.maskType));
+            overviews.push_back(path);
+
+            // use previous level in the next round
+            inputPath = output / path;
+        }
+    }
 
-        auto path(createOverview
-                  (config, output, i, inputPath, dir, setup.ovrSizes[i]
-                   , setup.ovrTiled[i], progress, total
-                   , setup.maskType));
+    if (!overviews.empty()) {
+        switch (config.cog) {
+        case CogMode::none: break;
+        case CogMode::level:
+            overviews = cogLevels(config, output, overviews);
+            break;
+        case CogMode::pyramid:
+            overviews = cogPyramid(config, output, overviews);
+            break;
+        }
+    }
 
-        // add overview (manually by manipulating the XML)
+    // add overviews (manually by manipulating the XML)
+    for (const auto &path : overviews) {
         addOverview(setup.outputDataset, path);
-
-        // use previous level in the next round
-        inputPath = output / path;
     }
 }
 
@@ -30,6 +30,8 @@
 #include <boost/optional.hpp>
 #include <boost/filesystem/path.hpp>
 
+#include "utility/enum-io.hpp"
+
 #include "geo/geodataset.hpp"
 
 namespace vrtwo {
@@ -63,6 +65,19 @@ enum PathToOriginalDataset {
     , copy
 };
 
+/** Cloud-Optimized GeoTIFF output.
+ *
+ *  none: overviews are left as a tree of tiles glued by VRTs
+ *  level: each overview is converted to a single COG
+ *  pyramid: all overviews are converted to a single COG with internal
+ *           overviews
+ */
+UTILITY_GENERATE_ENUM_CI(CogMode,
+    ((none))
+    ((level))
+    ((pyramid))
+)
+
 struct Config {
     math::Size2 tileSize;
     geo::GeoDataset::Resampling resampling;
@@ -76,12 +91,46 @@ struct Config {
 
     geo::Options createOptions;
 
+    /** Number of threads compressing and writing finished tiles while next
+     *  tiles are being warped (0 = tiles are written by warping threads).
+     */
+    unsigned int writerThreads;
+
+    /** Build all overview levels at once: tile of a level is warped as
+     *  soon as tiles it reads from the previous level are finished.
+     */
+    bool wavefront;
+
+    /** Convert finished overviews into Cloud-Optimized GeoTIFF(s).
+     */
+    CogMode cog;
+
+    /** Internal block size of generated COGs. Tile size should be its
+     *  multiple so that tile boundaries fall onto block boundaries.
+     */
+    int cogBlockSize;
+
+    /** Target grid of reprojected output.
+     */
+    struct Grid {
+        geo::SrsDefinition srs;
+        math::Extents2 extents;
+        math::Size2 size;
+    };
+
+    /** Reproject input into given grid: base dataset is a warped VRT of
+     *  the input in the target SRS, extents and size, overviews halve it
+     *  as usual. Unset = overviews of the input in its own grid.
+     */
+    boost::optional<Grid> grid;
 
     Config()
         : tileSize(4096, 4096)
         , minOvrSize(2, 2)
         , overwrite(false)
         , pathToOriginalDataset(PathToOriginalDataset::absoluteSymlink)
+        , writerThreads(1), wavefront(false)
+        , cog(CogMode::none), cogBlockSize(512)
     {}
 };
 
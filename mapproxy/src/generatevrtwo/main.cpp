@@ -150,6 +150,34 @@ void VrtWo::configuration(po::options_description &cmdline
          , "Optional nodata value override. Can be NONE (to disable any "
          "nodata value) or a (real) number. Original input dataset's nodata "
          "value is used if not specified.")
+        ("writerThreads", po::value(&config_.writerThreads)
+         ->default_value(config_.writerThreads)->required()
+         , "Number of threads compressing and writing finished tiles while "
+         "next tiles are being warped (0 = write in warping threads).")
+        ("wavefront", po::value(&config_.wavefront)
+         ->default_value(config_.wavefront)->implicit_value(true)
+         , "Build all overview levels at once: tile of an overview is "
+         "warped as soon as tiles it reads from the previous overview are "
+         "finished.")
+        ("cog", po::value(&config_.cog)
+         ->default_value(config_.cog)->required()
+         , utility::concat
+         ("Convert generated overviews into Cloud-Optimized GeoTIFF: "
+          "none = keep tiles and VRTs, level = one COG per overview, "
+          "pyramid = one COG with internal overviews. One of ["
+          , enumerationString(config_.cog), "].").c_str())
+        ("cog.blockSize", po::value(&config_.cogBlockSize)
+         ->default_value(config_.cogBlockSize)->required()
+         , "Internal block size of generated COGs; multiple of 16. "
+         "Tile size should be its multiple.")
+        ("grid.srs", po::value<std::string>()
+         , "Reproject input into this SRS; needs grid.extents and "
+         "grid.size. Base dataset is a warped VRT, overviews are "
+         "materialized in the target grid.")
+        ("grid.extents", po::value<math::Extents2>()
+         , "Extents of reprojected output (\"llx,lly:urx,ury\").")
+        ("grid.size", po::value<math::Size2>()
+         , "Size of reprojected output (\"WxH\").")
         ;
 
     pd.add("input", 1)
@@ -205,6 +233,37 @@ void VrtWo::configure(const po::variables_map &vars)
         }
     }
 
+    if (config_.cog != vrtwo::CogMode::none) {
+        if ((config_.cogBlockSize < 16) || (config_.cogBlockSize % 16)) {
+            throw po::validation_error
+                (po::validation_error::invalid_option_value
+                 , "cog.blockSize");
+        }
+        if ((config_.tileSize.width % config_.cogBlockSize)
+            || (config_.tileSize.height % config_.cogBlockSize))
+        {
+            LOG(warn3, log_)
+                << "Tile size " << config_.tileSize
+                << " is not a multiple of COG block size "
+                << config_.cogBlockSize << "; tile boundaries will not "
+                "be aligned with COG blocks.";
+        }
+    }
+
+    if (vars.count("grid.srs")) {
+        if (!vars.count("grid.extents")) {
+            throw po::required_option("grid.extents");
+        }
+        if (!vars.count("grid.size")) {
+            throw po::required_option("grid.size");
+        }
+        config_.grid = boost::in_place();
+        config_.grid->srs = geo::SrsDefinition::fromString
+            (vars["grid.srs"].as<std::string>());
+        config_.grid->extents = vars["grid.extents"].as<math::Extents2>();
+        config_.grid->size = vars["grid.size"].as<math::Size2>();
+    }
+
     // sanitize min ovr size
     if (config_.minOvrSize.width <= 1) { config_.minOvrSize.width = 2; }
     if (config_.minOvrSize.height <= 1) { config_.minOvrSize.height = 2; }
@@ -223,6 +282,16 @@ void VrtWo::configure(const po::variables_map &vars)
             })
         << "\n\tbackground = " << config_.background
         << "\n\tco = " << utility::join(co_, ", ")
+        << "\n\twriterThreads = " << config_.writerThreads
+        << "\n\twavefront = " << config_.wavefront
+        << "\n\tcog = " << config_.cog
+        << "\n\tcog.blockSize = " << config_.cogBlockSize
+        << utility::LManip([&](std::ostream &os) -> std::ostream& {
+                if (!config_.grid) { return os; }
+                return os << "\n\tgrid.srs = " << config_.grid->srs
+                          << "\n\tgrid.extents = " << config_.grid->extents
+                          << "\n\tgrid.size = " << config_.grid->size;
+            })
         << utility::LManip([&](std::ostream &os) -> std::ostream& {
                 if (!config_.nodata) { return os; }
 
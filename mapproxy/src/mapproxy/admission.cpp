@@ -0,0 +1,100 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "admission.hpp"
+
+AdmissionControl::AdmissionControl(const Options &options)
+    : options_(options), inFlight_(0), admitted_(0), rejected_(0)
+    , shed_(0)
+{}
+
+AdmissionControl::Ticket
+AdmissionControl::admit(const std::string &resource, bool lowPriority)
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+
+        // low priority tasks are subject to both global limits
+        if ((options_.maxInFlight && (inFlight_ >= options_.maxInFlight))
+            || (lowPriority && options_.lowPriorityLimit
+                && (inFlight_ >= options_.lowPriorityLimit)))
+        {
+            ++(lowPriority ? shed_ : rejected_);
+            return {};
+        }
+
+        auto &count(perResource_[resource]);
+        if (options_.maxInFlightPerResource
+            && (count >= options_.maxInFlightPerResource))
+        {
+            ++(lowPriority ? shed_ : rejected_);
+            return {};
+        }
+
+        ++count;
+        ++inFlight_;
+        ++admitted_;
+    }
+
+    // ticket points to this instance: null ticket means refusal
+    auto self(shared_from_this());
+    return Ticket(self.get(), [self, resource](void*)
+    {
+        self->release(resource);
+    });
+}
+
+void AdmissionControl::release(const std::string &resource)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    --inFlight_;
+    auto fperResource(perResource_.find(resource));
+    if (fperResource == perResource_.end()) { return; }
+    if (!--fperResource->second) { perResource_.erase(fperResource); }
+}
+
+void AdmissionControl::stat(std::ostream &os, const std::string &prefix)
+    const
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    os << prefix << "inFlight=" << inFlight_ << '\n'
+       << prefix << "admitted=" << admitted_ << '\n'
+       << prefix << "rejected=" << rejected_ << '\n'
+       << prefix << "shed=" << shed_ << '\n';
+}
+
+void AdmissionControl::metrics(metrics::Writer &writer
+                               , const std::string &prefix) const
+{
+    writer.gauge(prefix + "in_flight", "Generator tasks in flight."
+                 , inFlight_);
+    writer.counter(prefix + "admitted", "Admitted generator tasks."
+                   , admitted_);
+    writer.counter(prefix + "rejected", "Rejected generator tasks."
+                   , rejected_);
+    writer.counter(prefix + "shed", "Shed low priority generator tasks."
+                   , shed_);
+}
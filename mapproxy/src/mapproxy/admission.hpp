@@ -0,0 +1,110 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef mapproxy_admission_hpp_included_
+#define mapproxy_admission_hpp_included_
+
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <cstdint>
+#include <ostream>
+#include <unordered_map>
+
+#include <boost/noncopyable.hpp>
+
+#include "support/metrics.hpp"
+
+/** Counts generator tasks in flight and refuses new ones over limits.
+ *  Admitted task holds a ticket; the task leaves when the ticket dies.
+ */
+class AdmissionControl
+    : public std::enable_shared_from_this<AdmissionControl>
+    , boost::noncopyable
+{
+public:
+    /** Tasks are counted from posting until they finish (i.e. both queued
+     *  and running).
+     */
+    struct Options {
+        /** Maximum number of tasks in flight (0 = unlimited).
+         */
+        std::size_t maxInFlight;
+
+        /** Maximum number of tasks in flight per resource (0 = unlimited).
+         */
+        std::size_t maxInFlightPerResource;
+
+        /** Low priority tasks (masks, debug nodes) are admitted only while
+         *  number of tasks in flight is below this limit (0 = same as
+         *  maxInFlight). Never admitted above maxInFlight.
+         */
+        std::size_t lowPriorityLimit;
+
+        Options()
+            : maxInFlight(), maxInFlightPerResource(), lowPriorityLimit()
+        {}
+    };
+
+    typedef std::shared_ptr<void> Ticket;
+
+    AdmissionControl(const Options &options);
+
+    bool enabled() const {
+        return options_.maxInFlight || options_.maxInFlightPerResource
+            || options_.lowPriorityLimit;
+    }
+
+    /** Returns non-null ticket or null ticket when the task is refused.
+     *  Must be called on an instance managed by std::shared_ptr.
+     */
+    Ticket admit(const std::string &resource, bool lowPriority);
+
+    std::size_t inFlight() const { return inFlight_; }
+
+    void stat(std::ostream &os, const std::string &prefix) const;
+
+    void metrics(metrics::Writer &writer, const std::string &prefix) const;
+
+private:
+    void release(const std::string &resource);
+
+    const Options options_;
+
+    /** Guards admission decisions; counters are atomic to be readable
+     *  without it.
+     */
+    mutable std::mutex mutex_;
+    std::atomic<std::size_t> inFlight_;
+    std::unordered_map<std::string, std::size_t> perResource_;
+
+    std::atomic<std::uint64_t> admitted_;
+    std::atomic<std::uint64_t> rejected_;
+    std::atomic<std::uint64_t> shed_;
+};
+
+#endif // mapproxy_admission_hpp_included_
@@ -0,0 +1,343 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <algorithm>
+#include <system_error>
+
+#include <boost/filesystem.hpp>
+
+#include "dbglog/dbglog.hpp"
+
+#include "utility/path.hpp"
+
+#include "gdalsupport/tilearchive.hpp"
+#include "support/hash.hpp"
+
+#include "archivewriter.hpp"
+
+namespace fs = boost::filesystem;
+
+namespace {
+
+const std::size_t HeaderSize(127);
+
+/** Root directory must fit in the first 16 KiB together with the header.
+ */
+const std::size_t MaxRootSize(16384 - HeaderSize);
+
+const std::size_t CopyBlock(1 << 20);
+
+enum Compression : int { unknown = 0, none = 1, gzip = 2 };
+
+int tileType(const std::string &ext)
+{
+    if (ext == "mvt") { return 1; }
+    if (ext == "png") { return 2; }
+    if ((ext == "jpg") || (ext == "jpeg")) { return 3; }
+    if (ext == "webp") { return 4; }
+    if (ext == "avif") { return 5; }
+    return 0;
+}
+
+void systemError(const std::string &what, const fs::path &path)
+{
+    std::system_error e(errno, std::system_category());
+    LOG(err2) << "Cannot " << what << " " << path << ": <" << e.code()
+              << ", " << e.what() << ">.";
+    throw e;
+}
+
+void writeAll(int fd, const void *data, std::size_t size
+              , std::uint64_t offset, const fs::path &path)
+{
+    const auto *p(static_cast<const char*>(data));
+    while (size) {
+        const auto written(::pwrite(fd, p, size, offset));
+        if (written < 0) {
+            if (errno == EINTR) { continue; }
+            systemError("write", path);
+        }
+        p += written;
+        size -= written;
+        offset += written;
+    }
+}
+
+void readAll(int fd, void *data, std::size_t size, std::uint64_t offset
+             , const fs::path &path)
+{
+    auto *p(static_cast<char*>(data));
+    while (size) {
+        const auto read(::pread(fd, p, size, offset));
+        if (read < 0) {
+            if (errno == EINTR) { continue; }
+            systemError("read", path);
+        }
+        if (!read) {
+            LOGTHROW(err2, std::runtime_error)
+                << "Unexpected end of file " << path << ".";
+        }
+        p += read;
+        size -= read;
+        offset += read;
+    }
+}
+
+void varint(std::string &out, std::uint64_t value)
+{
+    while (value >= 0x80) {
+        out.push_back(char((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(char(value));
+}
+
+void le64(char *out, std::uint64_t value)
+{
+    for (int i(0); i < 8; ++i) { out[i] = char(value >> (8 * i)); }
+}
+
+template <typename Iterator>
+std::string serialize(Iterator begin, Iterator end)
+{
+    std::string out;
+    varint(out, end - begin);
+
+    std::uint64_t last(0);
+    for (auto i(begin); i != end; ++i) {
+        varint(out, i->tileId - last);
+        last = i->tileId;
+    }
+    for (auto i(begin); i != end; ++i) { varint(out, i->runLength); }
+    for (auto i(begin); i != end; ++i) { varint(out, i->length); }
+    for (auto i(begin); i != end; ++i) {
+        const bool contiguous((i != begin) && (i->offset
+                                               == ((i - 1)->offset
+                                                   + (i - 1)->length)));
+        varint(out, contiguous ? 0 : (i->offset + 1));
+    }
+
+    return out;
+}
+
+} // namespace
+
+ArchiveWriter::ArchiveWriter(const fs::path &path, const std::string &ext)
+    : path_(path), dataPath_(utility::addExtension(path, ".data.tmp"))
+    , tileType_(tileType(ext)), fd_(-1), dataSize_(), gzipped_()
+    , minLod_(~0u), maxLod_(), finished_(false)
+{
+    if (path_.has_parent_path()) {
+        fs::create_directories(path_.parent_path());
+    }
+
+    fd_ = ::open(dataPath_.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC
+                 , 0644);
+    if (fd_ < 0) { systemError("create", dataPath_); }
+}
+
+ArchiveWriter::~ArchiveWriter()
+{
+    if (fd_ >= 0) { ::close(fd_); }
+    boost::system::error_code ec;
+    fs::remove(dataPath_, ec);
+}
+
+const ArchiveWriter::Entry* ArchiveWriter::find(std::uint64_t hash
+                                                , const void *data
+                                                , std::size_t size) const
+{
+    const auto range(contents_.equal_range(hash));
+    std::string stored;
+    for (auto i(range.first); i != range.second; ++i) {
+        const auto &entry(i->second);
+        if (entry.length != size) { continue; }
+
+        // hash match, compare content
+        stored.resize(size);
+        readAll(fd_, &stored[0], size, entry.offset, dataPath_);
+        if (!std::memcmp(stored.data(), data, size)) { return &entry; }
+    }
+    return nullptr;
+}
+
+void ArchiveWriter::add(const vts::TileId &tileId, const void *data
+                        , std::size_t size, bool gzipped)
+{
+    if (!size) { return; }
+
+    const std::string content(static_cast<const char*>(data), size);
+    const auto hash(stableHash(content));
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (finished_) { return; }
+
+    Entry entry{ tilearchive::pmTilesId(tileId.lod, tileId.x, tileId.y)
+                 , 0, size, 1 };
+
+    if (const auto *stored = find(hash, data, size)) {
+        entry.offset = stored->offset;
+    } else {
+        entry.offset = dataSize_;
+        writeAll(fd_, data, size, dataSize_, dataPath_);
+        dataSize_ += size;
+        contents_.emplace(hash, entry);
+        if (gzipped) { ++gzipped_; }
+    }
+
+    tiles_.push_back(entry);
+    minLod_ = std::min<unsigned int>(minLod_, tileId.lod);
+    maxLod_ = std::max<unsigned int>(maxLod_, tileId.lod);
+}
+
+void ArchiveWriter::finish(const std::string &metadata)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (finished_) { return; }
+    finished_ = true;
+
+    // sort by tile id, drop repeated tiles, merge runs of identical tiles
+    std::stable_sort(tiles_.begin(), tiles_.end()
+                     , [](const Entry &l, const Entry &r)
+    {
+        return l.tileId < r.tileId;
+    });
+
+    Entries entries;
+    for (const auto &tile : tiles_) {
+        if (!entries.empty()) {
+            auto &last(entries.back());
+            if (tile.tileId < (last.tileId + last.runLength)) { continue; }
+            if ((tile.tileId == (last.tileId + last.runLength))
+                && (tile.offset == last.offset))
+            {
+                ++last.runLength;
+                continue;
+            }
+        }
+        entries.push_back(tile);
+    }
+    const auto addressed(tiles_.size());
+    Entries().swap(tiles_);
+
+    // root directory, split into leaves if it does not fit
+    auto root(serialize(entries.begin(), entries.end()));
+    std::string leaves;
+    for (std::size_t leafSize(4096); root.size() > MaxRootSize;
+         leafSize *= 2)
+    {
+        Entries rootEntries;
+        leaves.clear();
+        for (std::size_t i(0); i < entries.size(); i += leafSize) {
+            const auto begin(entries.begin() + i);
+            const auto end(entries.begin()
+                           + std::min(entries.size(), i + leafSize));
+            const auto leaf(serialize(begin, end));
+            rootEntries.push_back
+                (Entry{ begin->tileId, leaves.size(), leaf.size(), 0 });
+            leaves += leaf;
+        }
+        root = serialize(rootEntries.begin(), rootEntries.end());
+    }
+
+    const std::uint64_t rootOffset(HeaderSize);
+    const std::uint64_t metadataOffset(rootOffset + root.size());
+    const std::uint64_t leafOffset(metadataOffset + metadata.size());
+    const std::uint64_t dataOffset(leafOffset + leaves.size());
+
+    char header[HeaderSize];
+    std::memset(header, 0, sizeof(header));
+    std::memcpy(header, "PMTiles", 7);
+    header[7] = 3;
+    le64(header + 8, rootOffset);
+    le64(header + 16, root.size());
+    le64(header + 24, metadataOffset);
+    le64(header + 32, metadata.size());
+    le64(header + 40, leafOffset);
+    le64(header + 48, leaves.size());
+    le64(header + 56, dataOffset);
+    le64(header + 64, dataSize_);
+    le64(header + 72, addressed);
+    le64(header + 80, entries.size());
+    le64(header + 88, contents_.size());
+    // tile data are in order of arrival, not clustered
+    header[96] = 0;
+    header[97] = Compression::none;
+    header[98] = (!gzipped_ ? Compression::none
+                  : ((gzipped_ == contents_.size()) ? Compression::gzip
+                     : Compression::unknown));
+    header[99] = char(tileType_);
+    header[100] = char(entries.empty() ? 0 : minLod_);
+    header[101] = char(entries.empty() ? 0 : maxLod_);
+
+    const auto tmp(utility::addExtension(path_, ".tmp"));
+    const int out(::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC
+                         | O_CLOEXEC, 0644));
+    if (out < 0) { systemError("create", tmp); }
+
+    try {
+        std::uint64_t offset(0);
+        const auto write([&](const void *data, std::size_t size)
+        {
+            writeAll(out, data, size, offset, tmp);
+            offset += size;
+        });
+
+        write(header, sizeof(header));
+        write(root.data(), root.size());
+        write(metadata.data(), metadata.size());
+        write(leaves.data(), leaves.size());
+
+        std::vector<char> block(CopyBlock);
+        for (std::uint64_t done(0); done < dataSize_; ) {
+            const auto size(std::min<std::uint64_t>(CopyBlock
+                                                    , dataSize_ - done));
+            readAll(fd_, block.data(), size, done, dataPath_);
+            write(block.data(), size);
+            done += size;
+        }
+
+        if (::fsync(out) < 0) { systemError("sync", tmp); }
+    } catch (...) {
+        ::close(out);
+        boost::system::error_code ec;
+        fs::remove(tmp, ec);
+        throw;
+    }
+
+    ::close(out);
+    fs::rename(tmp, path_);
+
+    LOG(info3) << "Written archive " << path_ << ": " << addressed
+               << " tiles, " << entries.size() << " directory entries, "
+               << contents_.size() << " distinct payloads ("
+               << dataSize_ << " bytes).";
+}
@@ -0,0 +1,119 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef mapproxy_archivewriter_hpp_included_
+#define mapproxy_archivewriter_hpp_included_
+
+#include <mutex>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+
+#include <boost/filesystem/path.hpp>
+
+#include "vts-libs/vts/basetypes.hpp"
+
+/** Static single-file tile archive in PMTiles (v3) layout, written by export
+ *  jobs (see Seeder::Job::archive).
+ *
+ *  Tiles are numbered by PMTiles tile id of their lod, x and y (i.e. in the
+ *  resource's reference frame tiling, not necessarily in web mercator). Tile
+ *  payloads are appended to a temporary data file as they arrive; identical
+ *  payloads are stored once and runs of identical neighbours share one
+ *  directory entry. The archive itself is written by finish(): header, root
+ *  directory, metadata, leaf directories and tile data. It replaces the
+ *  target file in one rename.
+ *
+ *  Thread-safe.
+ */
+class ArchiveWriter {
+public:
+    typedef std::shared_ptr<ArchiveWriter> pointer;
+
+    /** Starts archive of tiles with given extension (jpg, bin, ...).
+     */
+    ArchiveWriter(const boost::filesystem::path &path
+                  , const std::string &ext);
+
+    /** Removes temporary data, unless finished.
+     */
+    ~ArchiveWriter();
+
+    ArchiveWriter(const ArchiveWriter&) = delete;
+    ArchiveWriter& operator=(const ArchiveWriter&) = delete;
+
+    /** Adds tile payload as sent to clients, gzipped tells whether it is
+     *  sent with gzip content encoding. Tiles added again are ignored.
+     */
+    void add(const vts::TileId &tileId, const void *data, std::size_t size
+             , bool gzipped);
+
+    /** Writes the archive, metadata is a JSON document.
+     */
+    void finish(const std::string &metadata);
+
+    const boost::filesystem::path& path() const { return path_; }
+
+private:
+    struct Entry {
+        std::uint64_t tileId;
+        std::uint64_t offset;
+        std::uint64_t length;
+        std::uint64_t runLength;
+    };
+
+    typedef std::vector<Entry> Entries;
+
+    /** Stored payload of given hash equal to data, if any.
+     */
+    const Entry* find(std::uint64_t hash, const void *data
+                      , std::size_t size) const;
+
+    const boost::filesystem::path path_;
+    const boost::filesystem::path dataPath_;
+    const int tileType_;
+
+    mutable std::mutex mutex_;
+    int fd_;
+    std::uint64_t dataSize_;
+
+    /** One entry per tile (runLength is 1 until finish).
+     */
+    Entries tiles_;
+
+    /** Stored payloads by content hash.
+     */
+    std::unordered_multimap<std::uint64_t, Entry> contents_;
+
+    unsigned int gzipped_;
+    unsigned int minLod_;
+    unsigned int maxLod_;
+    bool finished_;
+};
+
+#endif // mapproxy_archivewriter_hpp_included_
@@ -0,0 +1,187 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cstdint>
+
+#include "error.hpp"
+#include "bundle.hpp"
+
+const std::string Bundle::ContentType("application/x-mapproxy-bundle");
+
+namespace {
+
+/** Server sink collecting single response of bundled file.
+ */
+class ItemSink : public http::ServerSink {
+public:
+    ItemSink(const Bundle::pointer &bundle, std::size_t index)
+        : bundle_(bundle), index_(index)
+    {}
+
+private:
+    virtual void content_impl(const void *data, std::size_t size
+                              , const FileInfo &stat, bool
+                              , const http::Header::list *headers)
+    {
+        Bundle::Item item;
+        item.status = 200;
+        item.contentType = stat.contentType;
+        if (headers) { item.headers = *headers; }
+        item.body.assign(static_cast<const char*>(data), size);
+        bundle_->done(index_, std::move(item));
+    }
+
+    virtual void content_impl(const DataSource::pointer &source)
+    {
+        Bundle::Item item;
+        item.status = 200;
+        item.contentType = source->stat().contentType;
+        if (const auto *headers = source->headers()) {
+            item.headers = *headers;
+        }
+
+        const auto size(source->size());
+        if (size >= 0) { item.body.resize(size); }
+        std::size_t off(0);
+        char buf[65536];
+        for (;;) {
+            const auto got(source->read(buf, sizeof(buf), off));
+            if (!got) { break; }
+            if ((off + got) > item.body.size()) {
+                item.body.resize(off + got);
+            }
+            std::copy(buf, buf + got, &item.body[off]);
+            off += got;
+        }
+        item.body.resize(off);
+        source->close();
+
+        bundle_->done(index_, std::move(item));
+    }
+
+    virtual void error_impl(const std::exception_ptr &exc)
+    {
+        Bundle::Item item;
+        item.status = httpStatus(exc);
+        bundle_->done(index_, std::move(item));
+    }
+
+    virtual void listing_impl(const Listing&, const std::string&
+                              , const std::string&)
+    {
+        error_impl(std::make_exception_ptr
+                   (NotFound("Listing cannot be bundled.")));
+    }
+
+    virtual void redirect_impl(const std::string&, utility::HttpCode)
+    {
+        error_impl(std::make_exception_ptr
+                   (NotFound("Redirect cannot be bundled.")));
+    }
+
+    virtual void checkAborted_impl() const { bundle_->checkAborted(); }
+
+    virtual void setAborter_impl(const AbortedCallback&) {}
+
+    Bundle::pointer bundle_;
+    std::size_t index_;
+};
+
+template <typename T>
+void append(std::string &out, T value)
+{
+    // little-endian
+    for (std::size_t i(0); i < sizeof(T); ++i) {
+        out.push_back(char(value & 0xff));
+        value >>= 8;
+    }
+}
+
+void append(std::string &out, const std::string &value)
+{
+    append(out, std::uint32_t(value.size()));
+    out.append(value);
+}
+
+} // namespace
+
+Bundle::Bundle(const Sink &sink, const std::vector<std::string> &filenames)
+    : sink_(sink), filenames_(filenames), items_(filenames.size())
+    , pending_(filenames.size())
+{}
+
+Bundle::pointer Bundle::create(const Sink &sink
+                               , const std::vector<std::string> &filenames)
+{
+    return pointer(new Bundle(sink, filenames));
+}
+
+Sink Bundle::itemSink(std::size_t index)
+{
+    return Sink(std::make_shared<ItemSink>(shared_from_this(), index));
+}
+
+void Bundle::done(std::size_t index, Item &&item)
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        items_[index] = std::move(item);
+        if (--pending_) { return; }
+    }
+
+    // last one, ship it
+    send();
+}
+
+void Bundle::send()
+{
+    std::size_t size(16);
+    for (const auto &item : items_) { size += item.body.size() + 64; }
+
+    std::string out;
+    out.reserve(size);
+    out.append("MPB1", 4);
+    append(out, std::uint32_t(items_.size()));
+
+    auto ifilenames(filenames_.begin());
+    for (const auto &item : items_) {
+        append(out, std::uint32_t(item.status));
+        append(out, *ifilenames++);
+        append(out, item.contentType);
+        append(out, std::uint32_t(item.headers.size()));
+        for (const auto &header : item.headers) {
+            append(out, header.name);
+            append(out, header.value);
+        }
+        append(out, std::uint64_t(item.body.size()));
+        out.append(item.body);
+    }
+
+    items_.clear();
+
+    sink_.content(out, Sink::FileInfo(ContentType)
+                  .setFileClass(FileClass::data));
+}
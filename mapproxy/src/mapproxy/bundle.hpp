@@ -0,0 +1,100 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef mapproxy_bundle_hpp_included_
+#define mapproxy_bundle_hpp_included_
+
+#include <mutex>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "sink.hpp"
+
+/** Multi-file response: collects responses of individual files of one
+ *  resource and sends them to the client as a single container once all
+ *  are done.
+ *
+ *  Container layout (integers are little-endian, string is uint32 length
+ *  followed by bytes):
+ *
+ *      char[4] magic "MPB1"
+ *      uint32 file count
+ *      for each file, in request order:
+ *          uint32 HTTP status
+ *          string filename
+ *          string content type
+ *          uint32 header count, (string name, string value) x count
+ *          uint64 body size, body
+ */
+class Bundle : public std::enable_shared_from_this<Bundle> {
+public:
+    typedef std::shared_ptr<Bundle> pointer;
+
+    static const std::string ContentType;
+
+    /** Creates bundle of given files answered to given sink.
+     */
+    static pointer create(const Sink &sink
+                          , const std::vector<std::string> &filenames);
+
+    const std::vector<std::string>& filenames() const { return filenames_; }
+
+    /** Sink collecting response of index-th file.
+     */
+    Sink itemSink(std::size_t index);
+
+    struct Item {
+        int status;
+        std::string contentType;
+        http::Header::list headers;
+        std::string body;
+
+        Item() : status() {}
+    };
+
+    /** Called by item sink with collected response.
+     */
+    void done(std::size_t index, Item &&item);
+
+    /** Throws when client aborted whole bundle.
+     */
+    void checkAborted() const { sink_.checkAborted(); }
+
+private:
+    Bundle(const Sink &sink, const std::vector<std::string> &filenames);
+
+    void send();
+
+    Sink sink_;
+    const std::vector<std::string> filenames_;
+
+    std::mutex mutex_;
+    std::vector<Item> items_;
+    std::size_t pending_;
+};
+
+#endif // mapproxy_bundle_hpp_included_
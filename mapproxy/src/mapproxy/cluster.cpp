@@ -0,0 +1,297 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <fstream>
+#include <algorithm>
+
+#include <boost/format.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/algorithm/string/trim.hpp>
+
+#include "dbglog/dbglog.hpp"
+
+#include "vts-libs/vts/tileop.hpp"
+
+#include "support/hash.hpp"
+#include "support/urlparse.hpp"
+
+#include "diskcache.hpp"
+#include "cluster.hpp"
+
+namespace fs = boost::filesystem;
+namespace ba = boost::algorithm;
+namespace vts = vtslibs::vts;
+
+constexpr char Cluster::Marker[];
+constexpr char Cluster::PackedType[];
+
+namespace {
+
+/** Ownership key: all files of one tile go to the same node (i.e. where
+ *  its datasets are already open and warped).
+ */
+std::string ownershipKey(const FileInfo &fi)
+{
+    std::string key(fi.resourceId.referenceFrame + '/' + fi.resourceId.group
+                    + '/' + fi.resourceId.id + '|');
+
+    vts::TileId tileId;
+    if (urlparse::parseTileIdPrefix(tileId, fi.filename)) {
+        return key + str(boost::format("%d-%d-%d")
+                         % tileId.lod % tileId.x % tileId.y);
+    }
+    return key + fi.filename;
+}
+
+std::vector<std::string> readMembers(const fs::path &path)
+{
+    std::vector<std::string> members;
+
+    std::ifstream f(path.string());
+    if (!f) {
+        LOG(warn2) << "Unable to read cluster members from " << path << ".";
+        return members;
+    }
+
+    std::string line;
+    while (std::getline(f, line)) {
+        const auto hash(line.find('#'));
+        if (hash != std::string::npos) { line.erase(hash); }
+        ba::trim(line);
+        if (!line.empty()) { members.push_back(line); }
+    }
+    return members;
+}
+
+/** Removes marker argument from query. Returns true if it was there.
+ */
+bool stripMarker(std::string &query)
+{
+    const std::string marker(Cluster::Marker);
+    auto pos(query.find(marker));
+    while (pos != std::string::npos) {
+        const auto end(pos + marker.size());
+        if (((pos == 0) || (query[pos - 1] == '&'))
+            && ((end == query.size()) || (query[end] == '&')))
+        {
+            // remove argument along with one separator
+            if (end < query.size()) {
+                query.erase(pos, marker.size() + 1);
+            } else {
+                query.erase(pos ? pos - 1 : pos, marker.size() + (pos != 0));
+            }
+            return true;
+        }
+        pos = query.find(marker, pos + 1);
+    }
+    return false;
+}
+
+} // namespace
+
+Cluster::Cluster(const Options &options)
+    : options_(options), lastCheck_(), fileTime_()
+    , owned_(0), forwarded_(0), failed_(0)
+{
+    if (!enabled()) { return; }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (options_.membersFile.empty()) {
+        build(options_.members);
+    } else {
+        reload();
+    }
+}
+
+void Cluster::build(const std::vector<std::string> &urls)
+{
+    // keep failure state of members that stay
+    std::vector<Member> members;
+    for (const auto &url : urls) {
+        if (const auto *member = find(url)) {
+            members.push_back(*member);
+        } else {
+            members.emplace_back(url);
+        }
+    }
+    members_.swap(members);
+
+    ring_.clear();
+    ring_.reserve(members_.size() * options_.replicas);
+    for (std::size_t i(0); i < members_.size(); ++i) {
+        for (unsigned int r(0); r < options_.replicas; ++r) {
+            ring_.emplace_back(stableHash(str(boost::format("%s#%d")
+                                              % members_[i].url % r))
+                               , i);
+        }
+    }
+    std::sort(ring_.begin(), ring_.end());
+
+    if (!find(options_.self)) {
+        LOG(warn3) << "This node (" << options_.self << ") is not a cluster "
+                   "member, it forwards everything.";
+    }
+    LOG(info3) << "Cluster has " << members_.size() << " members.";
+}
+
+void Cluster::reload()
+{
+    if (options_.membersFile.empty()) { return; }
+
+    const auto now(std::time(nullptr));
+    if (now == lastCheck_) { return; }
+    lastCheck_ = now;
+
+    boost::system::error_code ec;
+    const auto time(fs::last_write_time(options_.membersFile, ec));
+    if (ec || (time == fileTime_)) { return; }
+    fileTime_ = time;
+
+    build(readMembers(options_.membersFile));
+}
+
+Cluster::Member* Cluster::find(const std::string &url)
+{
+    for (auto &member : members_) {
+        if (member.url == url) { return &member; }
+    }
+    return nullptr;
+}
+
+std::string Cluster::lookup(const FileInfo &fi)
+{
+    const auto point(stableHash(ownershipKey(fi)));
+    const auto now(std::time(nullptr));
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    reload();
+
+    // first point at or after key's point, wrapping around
+    auto iring(std::lower_bound(ring_.begin(), ring_.end()
+                                , Ring::value_type(point, 0)));
+    for (std::size_t i(0); i < ring_.size(); ++i, ++iring) {
+        if (iring == ring_.end()) { iring = ring_.begin(); }
+        const auto &member(members_[iring->second]);
+        if (member.url == options_.self) { break; }
+        if (member.skipUntil > now) { continue; }
+        return member.url;
+    }
+    return {};
+}
+
+std::string Cluster::owner(const FileInfo &fi)
+{
+    if (!enabled()) { return {}; }
+
+    auto url(lookup(fi));
+    if (url.empty()) {
+        ++owned_;
+    } else {
+        ++forwarded_;
+    }
+    return url;
+}
+
+bool Cluster::owns(const FileInfo &fi)
+{
+    return !enabled() || lookup(fi).empty();
+}
+
+void Cluster::failed(const std::string &peer)
+{
+    ++failed_;
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto *member(find(peer));
+    if (!member) { return; }
+
+    if (++member->failures >= options_.failureLimit) {
+        LOG(warn3) << "Cluster peer " << peer << " is failing, skipping it "
+                   "for " << options_.backoff << " s.";
+        member->failures = 0;
+        member->skipUntil = std::time(nullptr) + options_.backoff;
+    }
+}
+
+void Cluster::succeeded(const std::string &peer)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (auto *member = find(peer)) { member->failures = 0; }
+}
+
+void Cluster::unmark(FileInfo &fi)
+{
+    if (!stripMarker(fi.query)) { return; }
+
+    fi.forwarded = true;
+    fi.url = (fi.url.substr(0, fi.url.find('?'))
+              + (fi.query.empty() ? "" : "?" + fi.query));
+}
+
+std::string Cluster::pack(const void *data, std::size_t size
+                          , const Sink::FileInfo &stat)
+{
+    // same record as in the disk cache
+    return DiskCache::record(Marker, data, size, stat);
+}
+
+ResponseCache::Response::pointer Cluster::unpack(const std::string &packed)
+{
+    // replayed right away, expiration is irrelevant
+    return DiskCache::parse(Marker, packed, std::time(nullptr));
+}
+
+void Cluster::stat(std::ostream &os, const std::string &prefix) const
+{
+    std::size_t members(0), skipped(0);
+    {
+        const auto now(std::time(nullptr));
+        std::unique_lock<std::mutex> lock(mutex_);
+        members = members_.size();
+        for (const auto &member : members_) {
+            if (member.skipUntil > now) { ++skipped; }
+        }
+    }
+
+    os << prefix << "members=" << members << '\n'
+       << prefix << "skipped=" << skipped << '\n'
+       << prefix << "owned=" << owned_ << '\n'
+       << prefix << "forwarded=" << forwarded_ << '\n'
+       << prefix << "failed=" << failed_ << '\n';
+}
+
+void Cluster::metrics(metrics::Writer &writer
+                      , const std::string &prefix) const
+{
+    writer.counter(prefix + "owned"
+                   , "Tile requests owned (generated) by this node."
+                   , owned_);
+    writer.counter(prefix + "forwarded"
+                   , "Tile requests forwarded to owning peer.", forwarded_);
+    writer.counter(prefix + "failed"
+                   , "Forwarded requests that failed (generated locally)."
+                   , failed_);
+}
@@ -0,0 +1,202 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef mapproxy_cluster_hpp_included_
+#define mapproxy_cluster_hpp_included_
+
+#include <ctime>
+#include <mutex>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <ostream>
+
+#include <boost/filesystem/path.hpp>
+
+#include "support/metrics.hpp"
+
+#include "fileinfo.hpp"
+#include "responsecache.hpp"
+
+/** Cluster of mapproxy nodes sharing the work of generating tiles.
+ *
+ *  Every (resource, tile) is owned by one node picked by consistent hashing
+ *  (each member has a number of points on a hash ring). Nodes forward
+ *  generation of tiles they do not own to the owner, so each tile is
+ *  generated (and cached) by a single node of the fleet.
+ *
+ *  Member list is static (from configuration) or read from a file that is
+ *  re-read whenever it changes. Peers failing repeatedly are skipped for a
+ *  while, their tiles move to the next node on the ring meanwhile.
+ *
+ *  Forwarded requests carry a marker query argument; they are never
+ *  forwarded again (members lists may temporarily differ between nodes).
+ *  The owner answers them with a packed response (body and all its headers)
+ *  the forwarding node replays verbatim.
+ */
+class Cluster {
+public:
+    struct Options {
+        /** URLs of all cluster nodes, this one included (e.g.
+         *  http://node1:3070). Empty list means cluster mode is off.
+         */
+        std::vector<std::string> members;
+
+        /** File with member URLs (one per line, # starts a comment).
+         *  Overrides members when set.
+         */
+        boost::filesystem::path membersFile;
+
+        /** URL of this node as listed among members.
+         */
+        std::string self;
+
+        /** Points on the hash ring per member.
+         */
+        unsigned int replicas;
+
+        /** Timeout of forwarded requests (in ms), local generation is used
+         *  on timeout.
+         */
+        long timeout;
+
+        /** Number of consecutive failures after which a peer is skipped.
+         */
+        unsigned int failureLimit;
+
+        /** How long a failing peer is skipped (in seconds).
+         */
+        std::size_t backoff;
+
+        Options()
+            : replicas(64), timeout(2000), failureLimit(3), backoff(10)
+        {}
+
+        bool enabled() const {
+            return !self.empty() && (!members.empty() || !membersFile.empty());
+        }
+    };
+
+    /** Query argument marking requests forwarded by a peer.
+     */
+    static constexpr char Marker[] = "mapproxy-peer=1";
+
+    /** Content type of packed responses sent to the forwarding peer.
+     */
+    static constexpr char PackedType[] = "application/x-mapproxy-response";
+
+    Cluster(const Options &options);
+
+    bool enabled() const { return options_.enabled(); }
+
+    long timeout() const { return options_.timeout; }
+
+    /** Returns URL of node owning given file of given resource. Returns an
+     *  empty string when this node is the owner, when nobody else is
+     *  available or when cluster mode is off.
+     */
+    std::string owner(const FileInfo &fi);
+
+    /** Checks whether this node owns given file (same as empty owner() but
+     *  not counted in statistics).
+     */
+    bool owns(const FileInfo &fi);
+
+    /** Forwarded request failed.
+     */
+    void failed(const std::string &peer);
+
+    /** Forwarded request succeeded.
+     */
+    void succeeded(const std::string &peer);
+
+    /** Strips marker from file's URL and query and sets its forwarded flag
+     *  if it was there (i.e. the request was forwarded by a peer).
+     */
+    static void unmark(FileInfo &fi);
+
+    /** Packs response to a forwarded request: body along with its final file
+     *  info (content type, cache control, ETag, Content-Encoding etc.).
+     */
+    static std::string pack(const void *data, std::size_t size
+                            , const Sink::FileInfo &stat);
+
+    /** Unpacks response packed by pack(). Returns null pointer if it is
+     *  malformed.
+     */
+    static ResponseCache::Response::pointer
+    unpack(const std::string &packed);
+
+    void stat(std::ostream &os, const std::string &prefix) const;
+
+    /** Writes lock-free counters, metric names start with given prefix.
+     */
+    void metrics(metrics::Writer &writer, const std::string &prefix) const;
+
+private:
+    struct Member {
+        std::string url;
+        unsigned int failures;
+        std::time_t skipUntil;
+
+        Member(const std::string &url)
+            : url(url), failures(), skipUntil() {}
+    };
+
+    /** (point, member index), sorted by point.
+     */
+    typedef std::vector<std::pair<std::uint64_t, std::size_t>> Ring;
+
+    /** Builds ring from given member URLs. Must be called under lock.
+     */
+    void build(const std::vector<std::string> &urls);
+
+    /** Re-reads members file if changed (checked at most once a second).
+     *  Must be called under lock.
+     */
+    void reload();
+
+    Member* find(const std::string &url);
+
+    /** Owner lookup, see owner().
+     */
+    std::string lookup(const FileInfo &fi);
+
+    const Options options_;
+
+    mutable std::mutex mutex_;
+    std::vector<Member> members_;
+    Ring ring_;
+    std::time_t lastCheck_;
+    std::time_t fileTime_;
+
+    std::atomic<std::uint64_t> owned_;
+    std::atomic<std::uint64_t> forwarded_;
+    std::atomic<std::uint64_t> failed_;
+};
+
+#endif // mapproxy_cluster_hpp_included_
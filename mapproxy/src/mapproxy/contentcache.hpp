@@ -0,0 +1,66 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef mapproxy_contentcache_hpp_included_
+#define mapproxy_contentcache_hpp_included_
+
+#include <string>
+
+#include "responsecache.hpp"
+#include "diskcache.hpp"
+
+/** Cache of derived content keyed by content identity instead of URL (e.g.
+ *  heightcoded geodata keyed by source tile and DEM set), so that different
+ *  URLs producing the same content share one entry.
+ *
+ *  Uses core's response cache (memory tier) and disk cache (disk tier);
+ *  keys are prefixed to keep them apart from URL keys.
+ */
+class ContentCache {
+public:
+    ContentCache(ResponseCache &memory, DiskCache &disk)
+        : memory_(memory), disk_(disk)
+    {}
+
+    bool enabled() const { return memory_.enabled() || disk_.enabled(); }
+
+    /** Returns cached content or null pointer. Disk hits are promoted to
+     *  memory.
+     */
+    ResponseCache::Response::pointer get(const std::string &key);
+
+    /** Stores content in both tiers. Content without positive max-age is not
+     *  stored.
+     */
+    void put(const std::string &key, const void *data, std::size_t size
+             , const Sink::FileInfo &stat);
+
+private:
+    ResponseCache &memory_;
+    DiskCache &disk_;
+};
+
+#endif // mapproxy_contentcache_hpp_included_
@@ -25,37 +25,319 @@
  */
 
 #include <thread>
+#include <mutex>
+#include <list>
+#include <atomic>
+#include <map>
+#include <unordered_map>
+#include <algorithm>
+#include <sstream>
+#include <chrono>
+#include <cctype>
+#include <cstdio>
+#include <ctime>
 
 #include <boost/format.hpp>
 #include <boost/asio.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/algorithm/string/split.hpp>
+#include <boost/algorithm/string/classification.hpp>
+#include <boost/algorithm/string/join.hpp>
+#include <boost/algorithm/string/trim.hpp>
+#include <boost/algorithm/string/predicate.hpp>
 
 #include "utility/raise.hpp"
+#include "utility/time.hpp"
 
 #include "http/resourcefetcher.hpp"
 
 #include "vts-libs/vts/mapconfig.hpp"
+#include "vts-libs/vts/tileop.hpp"
 #include "vts-libs/registry.hpp"
 #include "vts-libs/registry/extensions.hpp"
 
+#include "support/hash.hpp"
+#include "support/metrics.hpp"
+#include "support/scratch.hpp"
+#include "support/masktree.hpp"
+#include "support/accounting.hpp"
+#include "support/profiler.hpp"
+#include "support/probes.hpp"
+#include "support/sharedcache.hpp"
+#include "support/preparedstate.hpp"
+#include "support/urlparse.hpp"
+
 #include "fileinfo.hpp"
 #include "error.hpp"
 #include "core.hpp"
 #include "sink.hpp"
+#include "bundle.hpp"
+#include "contentcache.hpp"
+#include "cluster.hpp"
+#include "scheduler.hpp"
+#include "flights.hpp"
+#include "admission.hpp"
 
 namespace asio = boost::asio;
+namespace ba = boost::algorithm;
 namespace vts = vtslibs::vts;
 namespace vr = vtslibs::registry;
 namespace vre = vtslibs::registry::extensions;
 
+namespace {
+
+/** Name of bundle pseudo-file (in resource directory).
+ */
+const std::string BundleFile("bundle");
+
+/** Maximum number of files in one bundle.
+ */
+const std::size_t MaxBundleSize(256);
+
+/** Registry of generator tasks in flight (queued or running) for the
+ *  in-flight dump. Registered task holds an entry; the task leaves the
+ *  registry when the entry dies.
+ */
+class TaskRegistry
+    : public std::enable_shared_from_this<TaskRegistry>
+    , boost::noncopyable
+{
+public:
+    class Entry;
+    typedef std::shared_ptr<Entry> EntryPointer;
+
+    /** Registers queued task generating given file of given resource.
+     */
+    EntryPointer add(const std::string &resource, const FileInfo &fi
+                     , const Sink &sink);
+
+    /** Prints one line per task, oldest first.
+     */
+    void dump(std::ostream &os) const;
+
+private:
+    struct Task {
+        std::string resource;
+        std::string filename;
+        Sink sink;
+        Trace::Clock::time_point posted;
+        Trace::Clock::time_point started;
+        bool running;
+
+        Task(const std::string &resource, const std::string &filename
+             , const Sink &sink)
+            : resource(resource), filename(filename), sink(sink)
+            , posted(Trace::Clock::now()), running(false)
+        {}
+    };
+
+    typedef std::list<Task> Tasks;
+
+    mutable std::mutex mutex_;
+    Tasks tasks_;
+};
+
+class TaskRegistry::Entry : boost::noncopyable {
+public:
+    Entry(const std::shared_ptr<TaskRegistry> &registry
+          , TaskRegistry::Tasks::iterator task)
+        : registry_(registry), task_(task)
+    {}
+
+    ~Entry() {
+        std::unique_lock<std::mutex> lock(registry_->mutex_);
+        registry_->tasks_.erase(task_);
+    }
+
+    /** Task has got a processing thread.
+     */
+    void started() {
+        std::unique_lock<std::mutex> lock(registry_->mutex_);
+        task_->started = Trace::Clock::now();
+        task_->running = true;
+    }
+
+private:
+    std::shared_ptr<TaskRegistry> registry_;
+    TaskRegistry::Tasks::iterator task_;
+};
+
+TaskRegistry::EntryPointer
+TaskRegistry::add(const std::string &resource, const FileInfo &fi
+                  , const Sink &sink)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    const auto task(tasks_.emplace(tasks_.end(), resource, fi.filename
+                                   , sink));
+    return std::make_shared<Entry>(shared_from_this(), task);
+}
+
+void TaskRegistry::dump(std::ostream &os) const
+{
+    const auto now(Trace::Clock::now());
+    const auto ms([](const Trace::Clock::duration &d)
+    {
+        return std::chrono::duration_cast<std::chrono::milliseconds>
+            (d).count();
+    });
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (const auto &task : tasks_) {
+        const auto dot(task.filename.rfind('.'));
+
+        // tile files of all generators are named lod-x-y.ext
+        unsigned int lod, x, y;
+        const bool tile(std::sscanf(task.filename.c_str(), "%u-%u-%u."
+                                    , &lod, &x, &y) == 3);
+
+        const char *aborted("no");
+        try {
+            task.sink.checkAborted();
+        } catch (const RequestAborted&) {
+            aborted = "yes";
+        } catch (const DeadlineExceeded&) {
+            aborted = "deadline";
+        } catch (...) {}
+
+        os << "core.task resource=" << task.resource
+           << " file=" << task.filename
+           << " type="
+           << ((dot == std::string::npos)
+               ? "-" : task.filename.substr(dot + 1))
+           << " tile=";
+        if (tile) { os << lod << '-' << x << '-' << y; } else { os << '-'; }
+        os << " state=" << (task.running ? "running" : "queued")
+           << " queued="
+           << ms((task.running ? task.started : now) - task.posted)
+           << "ms running="
+           << (task.running ? ms(now - task.started) : 0)
+           << "ms aborted=" << aborted
+           << " trace=" << task.sink.traceId() << '\n';
+    }
+}
+
+/** Masks and debug nodes are cheap to regenerate and expendable, they go
+ *  first under load.
+ */
+bool lowPriority(const FileInfo &fi)
+{
+    if (ba::ends_with(fi.filename, ".mask")) { return true; }
+
+    vts::TileId tileId;
+    vts::TileFile tileType;
+    unsigned int subTileIndex;
+    auto flavor(vts::FileFlavor::regular);
+    return (vts::fromFilename(tileId, tileType, subTileIndex, fi.filename
+                              , 0, &flavor)
+            && (flavor == vts::FileFlavor::debug));
+}
+
+/** Prefetch makes sense only when there is a cache to prefetch into.
+ */
+Prefetcher::Options prefetchOptions(const Core::Options &options)
+{
+    auto po(options.prefetch);
+    if (po.budget && !options.cache.size && !options.disk.size) {
+        LOG(warn3) << "Prefetch needs response cache, disabling it.";
+        po.budget = 0;
+    }
+    return po;
+}
+
+/** Calls callback once: when the response is sent (or fails) or when the
+ *  last copy of the sink dies without any response. Held by the sink's
+ *  observer.
+ */
+class Landing {
+public:
+    typedef std::function<void()> Callback;
+
+    Landing(const Callback &callback) : callback_(callback) {}
+    ~Landing() { land(); }
+
+    void land() {
+        if (!callback_) { return; }
+        const auto callback(std::move(callback_));
+        callback_ = {};
+        callback();
+    }
+
+private:
+    Callback callback_;
+};
+
+/** Failure specific to the failing request (client gone, past its
+ *  deadline, not admitted); identical request may well succeed.
+ */
+bool transient(const std::exception_ptr &exc)
+{
+    const auto status(httpStatus(exc));
+    return (status == 499) || (status == 503) || (status == 504);
+}
+
+/** Calls landing when the response is sent, after the original observer.
+ */
+void attachLanding(Sink &sink, const std::shared_ptr<Landing> &landing)
+{
+    const auto observer(sink.observer());
+    sink.setObserver([observer, landing](int status)
+    {
+        if (observer) { observer(status); }
+        landing->land();
+    });
+}
+
+} // namespace
+
 class Core::Detail : boost::noncopyable {
 public:
     Detail(Generators &generators, GdalWarper &warper
-           , unsigned int threadCount, http::ContentFetcher &contentFetcher)
+           , unsigned int threadCount, http::ContentFetcher &contentFetcher
+           , const Core::Options &options)
         : resourceFetcher_(contentFetcher, &ios_)
         , generators_(generators)
-        , arsenal_(warper, resourceFetcher_)
+        , arsenal_(warper, resourceFetcher_
+                   , [this](const Arsenal::Continuation &continuation
+                            , const Sink &sink)
+                   {
+                       post(continuation, sink);
+                   })
         , work_(ios_)
+        , scheduling_(options.scheduling)
+        , scheduler_(ios_, options.scheduling.maxRunningPerResource)
+        , cache_(options.cache)
+        , diskCache_(options.disk)
+        , sharedCache_(options.shared)
+        , contentCache_(cache_, diskCache_)
+        , cluster_(options.cluster)
+        , admission_(std::make_shared<AdmissionControl>(options.admission))
+        , queued_()
+        , tasks_(std::make_shared<TaskRegistry>())
+        , prefetcher_(prefetchOptions(options))
+        , seedBudget_(options.seedBudget)
+        , warmup_(options.warmup)
+        , seedTimer_(ios_), seedTimerArmed_(false)
+        , coalesce_(options.coalesce), coalesced_(0)
+        , deadline_(options.deadline), deadlines_(options.deadlines)
+        , deadlineExceeded_(0), deadlineDropped_(0)
+        , traceSlowThreshold_(options.traceSlowThreshold)
+        , profile_(options.profile)
+        , responses_("mapproxy_responses"
+                     , "Sent responses by HTTP status (bundled files"
+                     " included).")
+        , requestDuration_("mapproxy_request_duration_seconds"
+                           , "Time to answer resource file request.")
+        , epoch_(std::make_shared<char>())
     {
+        if (contentCache_.enabled()) { arsenal_.contentCache = &contentCache_; }
+        if (warmup_.onPrepare) {
+            arsenal_.onPrepared = [this](const Generator::pointer &generator)
+            {
+                ios_.post([this, generator]() { warm(generator); });
+            };
+        }
+        precompressSupportFiles();
         generators_.start(arsenal_);
         start(threadCount);
     }
@@ -69,10 +351,105 @@ public:
 
     void generateResourceFile(const FileInfo &fi, Sink &sink);
 
+    /** Sets sink's deadline by file type, if configured.
+     */
+    void setDeadline(const FileInfo &fi, Sink &sink) const;
+
+    /** Generates file not found in the in-memory cache. Key is empty when
+     *  both caching and coalescing are off. Unless told otherwise,
+     *  identical requests in flight are coalesced.
+     */
+    void generateMissed(const Generator::pointer &generator
+                        , const FileInfo &fi, const std::string &key
+                        , Sink &sink, bool coalesce = true);
+
+    /** Is any response cache enabled?
+     */
+    bool caching() const {
+        return (cache_.enabled() || diskCache_.enabled()
+                || sharedCache_.enabled());
+    }
+
+    struct FlightContext;
+    struct FlightOutcome;
+    typedef Flights<Sink, FlightOutcome, FlightContext> FlightBoard;
+
+    /** Joins identical request (same cache key) already in flight: sink is
+     *  answered with leader's response (or error) and true is returned.
+     *  Otherwise makes this request the leader of a new flight and returns
+     *  false. Background requests neither lead nor join.
+     */
+    bool join(const std::string &key, const Generator::pointer &generator
+              , const FileInfo &fi, Sink &sink);
+
+    /** Leader of given flight has responded (or its sink is gone): answers
+     *  waiters with captured response or error, waiters without one (leader
+     *  aborted, past its deadline, streamed file) generate on their own.
+     */
+    void land(const FlightBoard::pointer &flight);
+
+    /** Fetches file from its owner in the cluster, generates it locally if
+     *  the owner fails.
+     */
+    void forward(const std::string &peer, const Generator::pointer &generator
+                 , const FileInfo &fi, const std::string &key, Sink &sink);
+
+    /** Answers files listed in the files query argument in one response.
+     */
+    void generateBundle(const FileInfo &fi, Sink &sink);
+
     void generateListing(const FileInfo &fi, Sink &sink);
 
     void generateReferenceFrameDems(const FileInfo &fi, Sink &sink);
 
+    void stat(std::ostream &os) const {
+        if (cache_.enabled()) { cache_.stat(os, "core.cache."); }
+        if (diskCache_.enabled()) { diskCache_.stat(os, "core.diskCache."); }
+        if (sharedCache_.enabled()) {
+            sharedCache_.stat(os, "core.sharedCache.");
+        }
+        if (cluster_.enabled()) { cluster_.stat(os, "core.cluster."); }
+        os << "core.queued=" << queued_ << '\n';
+        if (coalesce_) { os << "core.coalesced=" << coalesced_ << '\n'; }
+        if (deadline_ || !deadlines_.empty()) {
+            os << "core.deadline.exceeded=" << deadlineExceeded_ << '\n'
+               << "core.deadline.dropped=" << deadlineDropped_ << '\n';
+        }
+        scheduler_.stat(os, "core.scheduler.");
+        if (admission_->enabled()) {
+            admission_->stat(os, "core.admission.");
+        }
+        if (prefetcher_.enabled()) {
+            prefetcher_.stat(os, "core.prefetch.");
+        }
+        if (!seeder_.idle()) { seeder_.stat(os, "core.seed."); }
+        ScratchMat::stat(os, "core.scratch.");
+        SharedMaskTree::stat(os, "core.maskTree.");
+    }
+
+    void metrics(metrics::Writer &writer) const;
+
+    unsigned int seed(Seeder::Job job);
+
+    bool cancelSeed(unsigned int id) { return seeder_.cancel(id); }
+
+    void seedStatus(std::ostream &os) const { seeder_.stat(os, "seed."); }
+
+    unsigned int warm(const Resource::Id &resourceId);
+
+    /** Warms single generator, see Core::warm.
+     */
+    void warm(const Generator::pointer &generator);
+
+    void resourceUsage(std::ostream &os) const {
+        accounting_.stat(os, "resource.");
+    }
+
+    void inFlight(std::ostream &os) const {
+        tasks_->dump(os);
+        arsenal_.warper.inFlight(os);
+    }
+
     bool assertBrowserEnabled(int flags, Sink &sink) const {
         if (flags & FileFlags::browserEnabled) { return true; }
         sink.error(utility::makeError<NotFound>("Browsing disabled."));
@@ -85,6 +462,64 @@ private:
     void worker(std::size_t id);
     void post(const Generator::Task &task, Sink sink);
 
+    /** Queues generator task in its resource's fair queue.
+     */
+    void schedule(const Generator &generator, const Generator::Task &task
+                  , Sink sink);
+
+    /** Wraps task into processing thread handler.
+     */
+    std::function<void()> handler(const Generator::Task &task, Sink sink);
+
+    /** Posts generator task if admitted, otherwise tells the client to come
+     *  back later.
+     */
+    void postAdmitted(const Generator &generator, const FileInfo &fi
+                      , const Generator::Task &task, Sink &sink);
+
+    /** Counts response to the request once it is sent. Its duration is
+     *  observed in given histogram (if any).
+     */
+    void observe(Sink &sink, metrics::Histogram *duration = nullptr);
+
+    /** See Core::drain().
+     */
+    bool drain(unsigned int timeout);
+
+    /** Generates predicted files in the background while processing threads
+     *  are idle and prefetch budget allows.
+     */
+    void prefetch();
+
+    /** Generates files of seeding jobs into the persistent cache while
+     *  processing threads are idle.
+     */
+    void seed();
+
+    /** Runs seed() again after given time (rate limited seeding).
+     */
+    void scheduleSeed(std::chrono::milliseconds wait);
+
+    /** Key of generated file in the host-wide cache: persistent cache key
+     *  qualified by resource definition and by settings of this instance
+     *  that affect generated content (resource root, external URL), since
+     *  instances may define the same resource ID differently.
+     */
+    std::string sharedCacheKey(const Generator &generator
+                               , const std::string &persistentKey);
+
+    /** Host-wide cache access in the disk cache record format. Empty key
+     *  means no access.
+     */
+    ResponseCache::Response::pointer sharedGet(const std::string &key);
+    void sharedPut(const std::string &key, const void *data, std::size_t size
+                   , const Sink::FileInfo &stat);
+
+    /** Returns listing memoized under given key until next resources update.
+     */
+    Sink::Listing listing(const std::string &key
+                          , const std::function<Sink::Listing()> &build);
+
     asio::io_service ios_;
     http::ResourceFetcher resourceFetcher_;
 
@@ -95,6 +530,115 @@ private:
      */
     asio::io_service::work work_;
     std::vector<std::thread> workers_;
+
+    /** Fair queues of generator tasks.
+     */
+    const Core::Options::Scheduling scheduling_;
+    Scheduler scheduler_;
+
+    /** Generated responses.
+     */
+    ResponseCache cache_;
+    DiskCache diskCache_;
+    SharedCache sharedCache_;
+    ContentCache contentCache_;
+
+    /** Tile ownership among cluster nodes.
+     */
+    Cluster cluster_;
+
+    /** Shared with tickets of queued tasks (that may outlive us).
+     */
+    std::shared_ptr<AdmissionControl> admission_;
+
+    /** Number of tasks waiting for a processing thread.
+     */
+    std::atomic<std::size_t> queued_;
+
+    /** Generator tasks in flight, shared with their entries.
+     */
+    std::shared_ptr<TaskRegistry> tasks_;
+
+    /** Predicts and tracks background generated files.
+     */
+    Prefetcher prefetcher_;
+
+    /** Seeding jobs.
+     */
+    Seeder seeder_;
+    const std::size_t seedBudget_;
+    const Core::Options::Warmup warmup_;
+    asio::steady_timer seedTimer_;
+    std::atomic<bool> seedTimerArmed_;
+
+    /** Memoized listings.
+     */
+    struct CachedListing {
+        std::uint64_t timestamp;
+        Sink::Listing listing;
+    };
+    std::mutex listingsLock_;
+    std::map<std::string, CachedListing> listings_;
+
+    /** Memoized definition tags of sharedCacheKey(), by resource, its
+     *  revision, metadata and generator's ready time.
+     */
+    std::mutex definitionTagsLock_;
+    std::unordered_map<std::string, std::string> definitionTags_;
+
+    /** Request generated by flight's leader.
+     */
+    struct FlightContext {
+        Generator::pointer generator;
+        FileInfo fi;
+    };
+
+    /** Leader's response or error shared with waiters.
+     */
+    struct FlightOutcome {
+        ResponseCache::Response::pointer response;
+        std::exception_ptr error;
+    };
+
+    const bool coalesce_;
+
+    /** Identical requests being generated right now, by cache key.
+     */
+    FlightBoard flights_;
+    std::atomic<std::uint64_t> coalesced_;
+
+    /** Request deadlines (in ms, 0 = none), default and by file type.
+     */
+    const unsigned int deadline_;
+    const std::map<std::string, unsigned int> deadlines_;
+
+    /** Requests answered with 504 and tasks dropped due to deadline.
+     */
+    std::atomic<std::uint64_t> deadlineExceeded_;
+    std::atomic<std::uint64_t> deadlineDropped_;
+
+    /** Requests slower than this are logged (in ms, 0 = never).
+     */
+    const unsigned int traceSlowThreshold_;
+
+    /** Stack sampling of slow tasks (every request is traced when on).
+     */
+    const profiler::Options profile_;
+
+    /** Lock-free request metrics.
+     */
+    metrics::Family<metrics::Counter> responses_;
+    metrics::Family<metrics::Histogram> requestDuration_;
+
+    /** Per-resource usage (CPU, bytes sent, cache hits).
+     */
+    Accounting accounting_;
+
+    /** Held by every request (its sink's observer) received since last
+     *  drain, i.e. it expires once all of them are done.
+     */
+    std::mutex epochLock_;
+    std::shared_ptr<const void> epoch_;
 };
 
 void Core::Detail::start(std::size_t count)
@@ -130,6 +674,12 @@ void Core::Detail::worker(std::size_t id)
     dbglog::thread_id(str(boost::format("core:%u") % id));
     LOG(info2) << "Spawned worker id:" << id << ".";
 
+    // samples stack of slow tasks run by this thread
+    std::unique_ptr<profiler::Sampler> sampler;
+    if (profile_.enabled()) {
+        sampler.reset(new profiler::Sampler(profile_, "core"));
+    }
+
     for (;;) {
         try {
             ios_.run();
@@ -146,23 +696,191 @@ void Core::Detail::worker(std::size_t id)
 void Core::Detail::post(const Generator::Task &task, Sink sink)
 {
     if (!task) { return; }
+    ios_.post(handler(task, sink));
+}
+
+void Core::Detail::schedule(const Generator &generator
+                            , const Generator::Task &task, Sink sink)
+{
+    if (!task) { return; }
+
+    const auto weight([&]() -> unsigned int
+    {
+        switch (generator.type()) {
+        case Resource::Generator::Type::tms: return scheduling_.tmsWeight;
+        case Resource::Generator::Type::surface:
+            return scheduling_.surfaceWeight;
+        case Resource::Generator::Type::geodata:
+            return scheduling_.geodataWeight;
+        }
+        return 1;
+    }());
+
+    scheduler_.post(generator.referenceFrameId() + '/'
+                    + generator.id().fullId()
+                    , weight, handler(task, sink));
+}
 
-    ios_.post([=]() mutable // sink is passed as non-const ref
+std::function<void()> Core::Detail::handler(const Generator::Task &task
+                                            , Sink sink)
+{
+    ++queued_;
+    const auto posted(Trace::Clock::now());
+    MAPPROXY_PROBE1(task__enqueue, sink.traceId());
+    return [=]() mutable // sink is passed as non-const ref
     {
+        --queued_;
+        const std::uint64_t queue
+            (std::chrono::duration_cast<std::chrono::microseconds>
+             (Trace::Clock::now() - posted).count());
+        if (const auto tracer = sink.tracer()) { tracer("queue", queue); }
+        MAPPROXY_PROBE2(task__dequeue, sink.traceId(), queue);
+
         try {
+            if (sink.expired()) {
+                // nobody is interested in the result anymore
+                ++deadlineDropped_;
+                throw DeadlineExceeded("Request deadline passed in queue.");
+            }
+
+            const profiler::Sampler::Scope profile(sink.traceId());
+            const Account::CpuScope cpu(sink.account());
             task(sink, arsenal_);
         } catch (...) {
             sink.error();
         }
-    });
+        MAPPROXY_PROBE1(task__finish, sink.traceId());
+
+        prefetch();
+        seed();
+    };
+}
+
+void Core::Detail::postAdmitted(const Generator &generator
+                                , const FileInfo &fi
+                                , const Generator::Task &task, Sink &sink)
+{
+    if (!task) { return; }
+
+    const auto resource(generator.referenceFrameId() + '/'
+                        + generator.id().fullId());
+
+    AdmissionControl::Ticket ticket;
+    if (admission_->enabled()) {
+        ticket = admission_->admit
+            (resource, lowPriority(fi) || sink.background());
+        if (!ticket) {
+            sink.error(utility::makeError<Unavailable>
+                       ("Server is overloaded, try again later."));
+            return;
+        }
+    }
+
+    // ticket and registry entry are released once the response is sent or
+    // the sink is gone, not when the task returns: asynchronous generators
+    // (e.g. tms-raster warping in the GDAL workers) respond long after that
+    const auto entry(tasks_->add(resource, fi, sink));
+    attachLanding(sink, std::make_shared<Landing>
+                  ([ticket, entry]() mutable
+    {
+        ticket.reset();
+        entry.reset();
+    }));
+
+    schedule(generator, [entry, task](Sink &sink, Arsenal &arsenal)
+    {
+        entry->started();
+        task(sink, arsenal);
+    }, sink);
 }
 
 Core::Core(Generators &generators, GdalWarper &warper
-           , unsigned int threadCount, http::ContentFetcher &contentFetcher)
+           , unsigned int threadCount, http::ContentFetcher &contentFetcher
+           , const Options &options)
     : detail_(std::make_shared<Detail>
-              (generators, warper, threadCount, contentFetcher))
+              (generators, warper, threadCount, contentFetcher, options))
 {}
 
+void Core::stat(std::ostream &os) const
+{
+    detail().stat(os);
+}
+
+void Core::metrics(metrics::Writer &writer) const
+{
+    detail().metrics(writer);
+}
+
+unsigned int Core::seed(const Seeder::Job &job)
+{
+    return detail().seed(job);
+}
+
+bool Core::cancelSeed(unsigned int id)
+{
+    return detail().cancelSeed(id);
+}
+
+void Core::seedStatus(std::ostream &os) const
+{
+    detail().seedStatus(os);
+}
+
+unsigned int Core::warm(const Resource::Id &resourceId)
+{
+    return detail().warm(resourceId);
+}
+
+void Core::resourceUsage(std::ostream &os) const
+{
+    detail().resourceUsage(os);
+}
+
+void Core::inFlight(std::ostream &os) const
+{
+    detail().inFlight(os);
+}
+
+bool Core::drain(unsigned int timeout)
+{
+    return detail().drain(timeout);
+}
+
+void Core::Detail::metrics(metrics::Writer &writer) const
+{
+    writer.write(responses_);
+    writer.write(requestDuration_);
+
+    writer.gauge("mapproxy_core_queued"
+                 , "Tasks waiting for a processing thread.", queued_);
+    writer.counter("mapproxy_core_coalesced"
+                   , "Requests answered by identical request in flight."
+                   , coalesced_);
+    writer.counter("mapproxy_core_deadline_exceeded"
+                   , "Requests answered with 504 being past their deadline."
+                   , deadlineExceeded_);
+    writer.counter("mapproxy_core_deadline_dropped"
+                   , "Tasks dropped from the queue being past their deadline."
+                   , deadlineDropped_);
+    scheduler_.metrics(writer, "mapproxy_scheduler_");
+    if (cache_.enabled()) { cache_.metrics(writer, "mapproxy_cache_"); }
+    if (diskCache_.enabled()) {
+        diskCache_.metrics(writer, "mapproxy_disk_cache_");
+    }
+    if (sharedCache_.enabled()) {
+        sharedCache_.metrics(writer, "mapproxy_shared_cache_");
+    }
+    if (cluster_.enabled()) { cluster_.metrics(writer, "mapproxy_cluster_"); }
+    if (admission_->enabled()) {
+        admission_->metrics(writer, "mapproxy_admission_");
+    }
+    if (prefetcher_.enabled()) {
+        prefetcher_.metrics(writer, "mapproxy_prefetch_");
+    }
+    SharedMaskTree::metrics(writer, "mapproxy_mask_tree_");
+    accounting_.metrics(writer, "mapproxy_resource_");
+}
+
 void Core::generate_impl(const http::Request &request
                          , const http::ServerSink::pointer &sink)
 {
@@ -171,6 +889,12 @@ void Core::generate_impl(const http::Request &request
 
 namespace {
 
+const std::string TraceHeader("X-Mapproxy-Trace");
+
+} // namespace
+
+namespace {
+
 [[maybe_unused]]
 const std::string& getItem(const std::string &s)
 {
@@ -250,16 +974,178 @@ buildListing(const Container &container
     return buildListing<true, Container>(container, bootstrap);
 }
 
+/** Cache key: resource, its revision, metadata and readiness (i.e.
+ *  generator instance), interface, accepted encoding and image formats and
+ *  file path with normalized (sorted) query.
+ *
+ *  Persistent key omits readiness since it is not stable across restarts.
+ */
+std::string cacheKey(const Generator &generator, const FileInfo &fi
+                     , bool persistent = false)
+{
+    std::vector<std::string> args;
+    ba::split(args, fi.query, ba::is_any_of("&"), ba::token_compress_on);
+    args.erase(std::remove(args.begin(), args.end(), std::string())
+               , args.end());
+    std::sort(args.begin(), args.end());
+
+    std::ostringstream os;
+    os << generator.referenceFrameId() << '/' << generator.id().fullId()
+       << '/' << generator.type() << '@' << generator.resource().revision
+       << '~' << std::hex << generator.metadataTag() << std::dec;
+    if (!persistent) { os << ':' << generator.readySince(); }
+    os << '|' << fi.interface.interface << (fi.acceptGzip ? "+gzip" : "");
+    // image format negotiation may pick a different response
+    if (fi.acceptImage) { os << "+img" << fi.acceptImage; }
+    os << '|' << fi.path << '?' << ba::join(args, "&");
+    return os.str();
+}
+
+/** Strong entity tag: hash of persistent cache key, i.e. resource, its
+ *  revision and metadata, file path and query (carrying generator
+ *  revision).
+ */
+std::string entityTag(const Generator &generator, const FileInfo &fi)
+{
+    return str(boost::format("\"%016x\"")
+               % stableHash(cacheKey(generator, fi, true)));
+}
+
+/** File is tile content, i.e. fully determined by its URL. Other files
+ *  (mapConfig.json, freelayer.json, boundlayer.json...) depend on other
+ *  resources and on server configuration as well.
+ */
+bool tileContent(const FileInfo &fi)
+{
+    vts::TileId tileId;
+    return urlparse::parseTileIdPrefix(tileId, fi.filename);
+}
+
+/** Checks If-None-Match tag list against entity tag (weak comparison as
+ *  mandated for If-None-Match).
+ */
+bool matches(const std::string &ifNoneMatch, const std::string &etag)
+{
+    std::vector<std::string> tags;
+    ba::split(tags, ifNoneMatch, ba::is_any_of(","), ba::token_compress_on);
+    for (auto &tag : tags) {
+        ba::trim(tag);
+        if (tag == "*") { return true; }
+        if (ba::starts_with(tag, "W/")) { tag.erase(0, 2); }
+        if (tag == etag) { return true; }
+    }
+    return false;
+}
+
+/** Peer answered with 4xx, i.e. it works but refuses the request itself.
+ *  Transport errors, timeouts and 5xx count against the peer.
+ */
+bool clientError(const std::error_code &ec)
+{
+    if (ec.category()
+        != make_error_code(utility::HttpCode::NotFound).category())
+    {
+        return false;
+    }
+    return (ec.value() >= 400) && (ec.value() < 500);
+}
+
+} // namespace
+
+namespace {
+
+/** Metric label of requested file: its extension, if sane.
+ */
+std::string fileLabel(const std::string &filename)
+{
+    const auto dot(filename.rfind('.'));
+    if ((dot == std::string::npos) || (dot + 1 == filename.size())
+        || (filename.size() - dot > 9))
+    {
+        return "other";
+    }
+
+    const auto ext(filename.substr(dot + 1));
+    if (!std::all_of(ext.begin(), ext.end(), [](char c)
+    {
+        return std::isalnum(static_cast<unsigned char>(c));
+    })) {
+        return "other";
+    }
+    return ext;
+}
+
 } // namespace
 
+void Core::Detail::observe(Sink &sink, metrics::Histogram *duration)
+{
+    const auto start(std::chrono::steady_clock::now());
+    const auto epoch([this]()
+    {
+        std::unique_lock<std::mutex> lock(epochLock_);
+        return epoch_;
+    }());
+
+    // epoch is just held, see drain()
+    sink.setObserver([this, start, duration, epoch](int status)
+    {
+        responses_({ { "code", std::to_string(status) } }).inc();
+        if (status == 504) { ++deadlineExceeded_; }
+        if (duration) {
+            duration->observe
+                (std::chrono::duration_cast<std::chrono::microseconds>
+                 (std::chrono::steady_clock::now() - start).count());
+        }
+    });
+}
+
+bool Core::Detail::drain(unsigned int timeout)
+{
+    std::weak_ptr<const void> epoch;
+    {
+        std::unique_lock<std::mutex> lock(epochLock_);
+        epoch = epoch_;
+        epoch_ = std::make_shared<char>();
+    }
+
+    const auto until(std::chrono::steady_clock::now()
+                     + std::chrono::milliseconds(timeout));
+    while (!epoch.expired()) {
+        if (std::chrono::steady_clock::now() >= until) { return false; }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return true;
+}
+
 void Core::Detail::generate(const http::Request &request, Sink sink)
 {
+    observe(sink);
+
+    const bool reply(request.hasHeader(TraceHeader));
+    if (reply || traceSlowThreshold_ || profile_.enabled()) {
+        sink.setTrace(std::make_shared<Trace>
+                      (request.uri, reply, traceSlowThreshold_));
+    }
+
     try {
-        FileInfo fi(request, generators_.config().fileFlags);
+        auto fi([&]()
+        {
+            const auto scope(sink.traceStage("parse"));
+            return FileInfo(request, generators_.config().fileFlags);
+        }());
+        if (cluster_.enabled()) {
+            Cluster::unmark(fi);
+            if (fi.forwarded) {
+                // forwarding peer replays our response verbatim
+                sink.setPacker(&Cluster::pack, Cluster::PackedType);
+            }
+        }
 
         switch (fi.type) {
         case FileInfo::Type::resourceFile:
             generateResourceFile(fi, sink);
+            prefetch();
+            seed();
             return;
 
         case FileInfo::Type::dirRedir:
@@ -287,20 +1173,647 @@ void Core::Detail::generate(const http::Request &request, Sink sink)
     }
 }
 
+std::string Core::Detail::sharedCacheKey(const Generator &generator
+                                         , const std::string &persistentKey)
+{
+    const auto id(str(boost::format("%s/%s@%s~%x:%s")
+                      % generator.referenceFrameId()
+                      % generator.id().fullId()
+                      % generator.resource().revision
+                      % generator.metadataTag()
+                      % generator.readySince()));
+
+    std::unique_lock<std::mutex> lock(definitionTagsLock_);
+    auto &tag(definitionTags_[id]);
+    if (tag.empty()) {
+        const auto &config(generator.config());
+        tag = str(boost::format("%016x")
+                  % stableHash(definitionHash(generator.resource())
+                               + '|' + config.resourceRoot.string()
+                               + '|' + config.externalUrl));
+    }
+    return persistentKey + '#' + tag;
+}
+
+ResponseCache::Response::pointer
+Core::Detail::sharedGet(const std::string &key)
+{
+    if (key.empty()) { return {}; }
+
+    std::string record;
+    std::time_t expires;
+    if (!sharedCache_.get(key, record, &expires)) { return {}; }
+    return DiskCache::parse(key, record, expires);
+}
+
+void Core::Detail::sharedPut(const std::string &key, const void *data
+                             , std::size_t size, const Sink::FileInfo &stat)
+{
+    if (key.empty()) { return; }
+
+    const auto &maxAge(stat.cacheControl.maxAge);
+    if (!maxAge || (*maxAge <= 0)) { return; }
+
+    const auto record(DiskCache::record(key, data, size, stat));
+    sharedCache_.put(key, record.data(), record.size()
+                     , std::time(nullptr) + *maxAge);
+}
+
+void Core::Detail::setDeadline(const FileInfo &fi, Sink &sink) const
+{
+    auto deadline(deadline_);
+    if (!deadlines_.empty()) {
+        const auto fdeadlines(deadlines_.find(fileLabel(fi.filename)));
+        if (fdeadlines != deadlines_.end()) { deadline = fdeadlines->second; }
+    }
+    if (!deadline) { return; }
+
+    sink.setDeadline
+        (std::chrono::duration_cast<std::chrono::microseconds>
+         (std::chrono::system_clock::now().time_since_epoch()).count()
+         + std::uint64_t(deadline) * 1000);
+}
+
 void Core::Detail::generateResourceFile(const FileInfo &fi, Sink &sink)
 {
-    auto generator(generators_.generator(fi));
+    auto generator([&]()
+    {
+        const auto scope(sink.traceStage("lookup"));
+        return generators_.generator(fi);
+    }());
     if (!generator) {
         sink.error(utility::makeError<NotFound>
                     ("No generator for URL <%s> found.", fi.url));
         return;
     }
 
+    if (generators_.config().lazy && !generator->ready()) {
+        // lazily loaded resource still being prepared
+        sink.error(utility::makeError<Unavailable>
+                   ("Resource <%s> is not ready yet, try again later."
+                    , generator->id()));
+        return;
+    }
+
+    if (fi.filename == BundleFile) {
+        generateBundle(fi, sink);
+        return;
+    }
+
+    const auto &resource(generator->resource());
+    const auto resourceLabel(resource.id.referenceFrame + "/"
+                             + resource.id.group + "/" + resource.id.id);
+
+    // background work is charged to the resource as well
+    const auto account(accounting_.account(resourceLabel));
+    account->request();
+    sink.setAccount(account);
+
+    // prefetch is not a client request, keep it out of the metrics
+    if (!sink.background()) {
+        prefetcher_.requested(fi);
+
+        observe(sink, &requestDuration_
+                ({ { "resource", resourceLabel }
+                   , { "generator"
+                       , boost::lexical_cast<std::string>
+                       (resource.generator) }
+                   , { "file", fileLabel(fi.filename) } }));
+    }
+
     // assign file class stuff
     sink.assignFileClassSettings(generator->resource().fileClassSettings);
 
-    // run machinery
-    post(generator->generateFile(fi, sink), sink);
+    // nobody waits for background work, it has no deadline
+    if (!sink.background()) { setDeadline(fi, sink); }
+
+    if (!generator->cacheable()) {
+        // run machinery
+        postAdmitted(*generator, fi, generator->generateFile(fi, sink), sink);
+        return;
+    }
+
+    // tile is fully determined by the URL, answer revalidation right away
+    if (tileContent(fi)) {
+        const auto etag(entityTag(*generator, fi));
+        if (!fi.ifNoneMatch.empty() && matches(fi.ifNoneMatch, etag)) {
+            sink.error(utility::makeError<NotModified>("Not modified."));
+            return;
+        }
+        sink.setETag(etag);
+    }
+
+    const bool cached(caching());
+    const auto key((cached || coalesce_)
+                   ? cacheKey(*generator, fi) : std::string());
+    if (cached) {
+        if (const auto response = cache_.get(key)) {
+            account->cacheHit();
+            ResponseCache::send(sink, response);
+            return;
+        }
+    }
+
+    if (cluster_.enabled() && !fi.forwarded && !sink.background()) {
+        // owned by another node: let it generate (and cache) the file
+        const auto peer(cluster_.owner(fi));
+        if (!peer.empty()) {
+            forward(peer, generator, fi, key, sink);
+            return;
+        }
+    }
+
+    generateMissed(generator, fi, key, sink);
+}
+
+void Core::Detail::forward(const std::string &peer
+                           , const Generator::pointer &generator
+                           , const FileInfo &fi, const std::string &key
+                           , Sink &sink)
+{
+    typedef utility::ResourceFetcher::Query Query;
+    typedef utility::ResourceFetcher::MultiQuery MultiQuery;
+
+    const auto url(peer + fi.path + '?'
+                   + (fi.query.empty() ? "" : fi.query + '&')
+                   + Cluster::Marker);
+
+    resourceFetcher_.perform
+        (Query(url).timeout(cluster_.timeout())
+         , [this, peer, generator, fi, key, sink](const MultiQuery &query)
+         mutable -> void
+    {
+        const auto &q(query.front());
+        try {
+            const auto &body(q.get());
+            cluster_.succeeded(peer);
+
+            // not recorded: the owner caches it
+            if (body.contentType == Cluster::PackedType) {
+                if (const auto response = Cluster::unpack(body.data)) {
+                    ResponseCache::send(sink, response);
+                    return;
+                }
+                LOGTHROW(err1, std::runtime_error)
+                    << "Malformed packed response.";
+            }
+
+            // not packed (e.g. redirected elsewhere), pass as is
+            sink.content(body.data, Sink::FileInfo(body.contentType)
+                         .setFileClass(FileClass::data));
+            return;
+        } catch (const std::exception &e) {
+            if (clientError(q.ec())) {
+                // peer is fine, the request is not: answer the same
+                cluster_.succeeded(peer);
+                sink.error(utility::HttpError(q.ec(), e.what()));
+                return;
+            }
+
+            LOG(warn2) << "Cluster peer " << peer << " failed to generate <"
+                       << fi.url << ">: <" << e.what()
+                       << ">; generating locally.";
+            cluster_.failed(peer);
+        }
+
+        try {
+            generateMissed(generator, fi, key, sink);
+        } catch (...) {
+            sink.error();
+        }
+    });
+}
+
+void Core::Detail::generateMissed(const Generator::pointer &generator
+                                  , const FileInfo &fi
+                                  , const std::string &key, Sink &sink
+                                  , bool coalesce)
+{
+    if (!caching()) {
+        if (coalesce && join(key, generator, fi, sink)) { return; }
+
+        // no caching, run machinery
+        postAdmitted(*generator, fi, generator->generateFile(fi, sink), sink);
+        return;
+    }
+
+    // persistent key is stable across restarts and instances
+    const auto persistentKey((diskCache_.enabled() || sharedCache_.enabled())
+                             ? cacheKey(*generator, fi, true)
+                             : std::string());
+    const auto diskKey(diskCache_.enabled() ? persistentKey : std::string());
+    const auto sharedKey(sharedCache_.enabled()
+                         ? sharedCacheKey(*generator, persistentKey)
+                         : std::string());
+
+    if (const auto response = sharedGet(sharedKey)) {
+        // generated by another instance on this host
+        if (auto *account = sink.account()) { account->cacheHit(); }
+        cache_.put(key, response);
+        ResponseCache::send(sink, response);
+        return;
+    }
+
+    // remember generated response
+    sink.setRecorder([this, key, diskKey, sharedKey]
+                     (const void *data, std::size_t size
+                      , const Sink::FileInfo &stat)
+    {
+        cache_.put(key, data, size, stat);
+        if (!diskKey.empty()) { diskCache_.put(diskKey, data, size, stat); }
+        sharedPut(sharedKey, data, size, stat);
+    });
+
+    if (coalesce && join(key, generator, fi, sink)) { return; }
+
+    auto task(generator->generateFile(fi, sink));
+    if (!task || diskKey.empty()) {
+        // run machinery
+        postAdmitted(*generator, fi, task, sink);
+        return;
+    }
+
+    // consult disk cache in processing thread before running the machinery
+    postAdmitted(*generator, fi
+                 , [this, key, diskKey, task](Sink &sink, Arsenal &arsenal)
+    {
+        if (const auto response = diskCache_.get(diskKey)) {
+            if (auto *account = sink.account()) { account->cacheHit(); }
+
+            // already stored, do not record again
+            sink.setRecorder({});
+            cache_.put(key, response);
+            ResponseCache::send(sink, response);
+            return;
+        }
+        task(sink, arsenal);
+    }, sink);
+}
+
+bool Core::Detail::join(const std::string &key
+                        , const Generator::pointer &generator
+                        , const FileInfo &fi, Sink &sink)
+{
+    if (!coalesce_ || sink.background()) { return false; }
+
+    const auto flight(flights_.join(key, { generator, fi }, sink));
+    if (!flight) {
+        // answered by the leader
+        ++coalesced_;
+        return true;
+    }
+
+    // capture response for the waiters
+    const auto recorder(sink.recorder());
+    sink.setRecorder([this, recorder, flight]
+                     (const void *data, std::size_t size
+                      , const Sink::FileInfo &stat)
+    {
+        if (recorder) { recorder(data, size, stat); }
+
+        if (!flights_.awaited(flight)) { return; }
+
+        // late waiters (joining after this) generate on their own
+        auto response(std::make_shared<ResponseCache::Response>());
+        response->content = std::make_shared<std::string>
+            (static_cast<const char*>(data), size);
+        response->stat = stat;
+        response->expires = ResponseCache::Clock::now();
+
+        flights_.respond(flight, { response, {} });
+    });
+
+    // share definitive errors (e.g. 404) as well
+    const auto errorRecorder(sink.errorRecorder());
+    sink.setErrorRecorder([this, errorRecorder, flight]
+                          (const std::exception_ptr &exc)
+    {
+        if (errorRecorder) { errorRecorder(exc); }
+
+        if (transient(exc) || !flights_.awaited(flight)) { return; }
+        flights_.respond(flight, { {}, exc });
+    });
+
+    // land once the response is sent or the sink is gone
+    attachLanding(sink, std::make_shared<Landing>([this, flight]()
+    {
+        land(flight);
+    }));
+
+    return false;
+}
+
+void Core::Detail::land(const FlightBoard::pointer &flight)
+{
+    auto landed(flights_.land(flight));
+    const auto &response(landed.second.response);
+    const auto &error(landed.second.error);
+
+    for (auto &waiter : landed.first) {
+        try {
+            if (response) {
+                if (auto *account = waiter.account()) { account->cacheHit(); }
+                ResponseCache::send(waiter, response);
+                continue;
+            }
+
+            // leader's error, sent to the waiter by the handler below
+            if (error) { std::rethrow_exception(error); }
+
+            // no shareable outcome (streamed file, aborted leader)
+            if (const auto cached = cache_.get(flight->key)) {
+                if (auto *account = waiter.account()) { account->cacheHit(); }
+                ResponseCache::send(waiter, cached);
+                continue;
+            }
+            generateMissed(flight->context.generator, flight->context.fi
+                           , flight->key, waiter, false);
+        } catch (...) {
+            waiter.error();
+        }
+    }
+}
+
+void Core::Detail::prefetch()
+{
+    if (!prefetcher_.enabled()) { return; }
+
+    // idle processing threads only
+    while (!queued_) {
+        const auto fi(prefetcher_.next());
+        if (!fi) { return; }
+
+        const auto url(fi->url);
+        try {
+            auto generator(generators_.generator(*fi));
+            if (!generator || !generator->ready() || !generator->cacheable()
+                || cache_.contains(cacheKey(*generator, *fi))
+                || !cluster_.owns(*fi))
+            {
+                prefetcher_.cancel(url);
+                continue;
+            }
+        } catch (...) {
+            prefetcher_.cancel(url);
+            continue;
+        }
+
+        auto sink(Sink::detached());
+        sink.setBackground(true);
+        sink.setObserver([this, url](int status)
+        {
+            prefetcher_.done(url, status == 200);
+        });
+
+        try {
+            generateResourceFile(*fi, sink);
+        } catch (...) {
+            sink.error();
+        }
+    }
+}
+
+unsigned int Core::Detail::seed(Seeder::Job job)
+{
+    if (!diskCache_.enabled() && job.archive.empty()) {
+        LOGTHROW(err2, std::runtime_error)
+            << "Seeding needs persistent response cache.";
+    }
+
+    const auto generator(generators_.generator(job.generatorType
+                                               , job.resourceId));
+    if (!generator) {
+        LOGTHROW(err2, std::runtime_error)
+            << "No <" << job.generatorType << "> generator for resource <"
+            << job.resourceId << "> found.";
+    }
+    if (!generator->ready()) {
+        LOGTHROW(err2, std::runtime_error)
+            << "Resource <" << job.resourceId << "> is not ready yet.";
+    }
+    if (!generator->cacheable()) {
+        LOGTHROW(err2, std::runtime_error)
+            << "Resource <" << job.resourceId << "> is not cacheable.";
+    }
+
+    if (!job.budget) { job.budget = seedBudget_; }
+    if (job.state.empty() && job.archive.empty()) {
+        job.state = generator->root() / ("seed." + job.ext + ".state");
+    }
+    if (job.ext == "meta") {
+        job.metaOrder = generator->referenceFrame().metaBinaryOrder;
+    }
+
+    // local path of resource's files
+    auto path(prependRoot(boost::filesystem::path("/"), generator->id()
+                          , GeneratorInterface
+                          (generator->type()
+                           , GeneratorInterface::Interface::vts)
+                          , { ResourceRoot::referenceFrame }).string());
+    if (path.empty() || (path.back() != '/')) { path.push_back('/'); }
+
+    const auto id(seeder_.add(job, path, generators_.config().fileFlags
+                              , generator->root() / "delivery.index"));
+
+    // kick processing
+    ios_.post([this]() { seed(); });
+    return id;
+}
+
+unsigned int Core::Detail::warm(const Resource::Id &resourceId)
+{
+    unsigned int count(0);
+    for (auto type : enumerationValues(Resource::Generator::Type())) {
+        const auto generator(generators_.generator(type, resourceId));
+        if (!generator || !generator->ready()) { continue; }
+        // runs in the background, may touch a lot of data
+        ios_.post([this, generator]() { warm(generator); });
+        ++count;
+    }
+    return count;
+}
+
+void Core::Detail::warm(const Generator::pointer &generator)
+{
+    try {
+        const auto warmup(generator->warmup());
+        arsenal_.warper.warm(warmup.datasets);
+
+        const auto index(generator->root() / "delivery.index");
+        if (warmup_.lods && diskCache_.enabled() && !warmup.ext.empty()
+            && generator->cacheable() && boost::filesystem::exists(index))
+        {
+            const auto &lr(generator->resource().lodRange);
+
+            Seeder::Job job;
+            job.resourceId = generator->id();
+            job.generatorType = generator->type();
+            job.ext = warmup.ext;
+            job.lodRange = vts::LodRange
+                (lr.min, std::min<unsigned int>
+                 (lr.max, lr.min + warmup_.lods - 1));
+            job.state = generator->root() / ("warm." + job.ext + ".state");
+            seed(job);
+        }
+
+        LOG(info2)
+            << "Warmed resource <" << generator->id() << "> (type <"
+            << generator->type() << ">): prefaulted "
+            << warmup.prefaulted << " bytes, "
+            << warmup.datasets.size() << " dataset(s).";
+    } catch (const std::exception &e) {
+        LOG(warn2)
+            << "Failed to warm resource <" << generator->id() << ">: <"
+            << e.what() << ">.";
+    }
+}
+
+void Core::Detail::scheduleSeed(std::chrono::milliseconds wait)
+{
+    if (seedTimerArmed_.exchange(true)) { return; }
+
+    seedTimer_.expires_from_now(wait);
+    seedTimer_.async_wait([this](const boost::system::error_code &ec)
+    {
+        seedTimerArmed_ = false;
+        if (!ec) { seed(); }
+    });
+}
+
+namespace {
+
+bool gzipped(const Sink::FileInfo &stat)
+{
+    for (const auto &header : stat.headers) {
+        if (ba::iequals(header.name, "Content-Encoding")) {
+            return header.value == "gzip";
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+void Core::Detail::seed()
+{
+    // live traffic first: idle processing threads only
+    while (!queued_ && !seeder_.idle()) {
+        std::chrono::milliseconds wait(0);
+        const auto fi(seeder_.next(wait));
+        if (!fi) {
+            if (wait.count()) { scheduleSeed(wait); }
+            return;
+        }
+
+        const auto url(fi->url);
+        Generator::pointer generator;
+        try {
+            generator = generators_.generator(*fi);
+        } catch (...) {}
+        if (!generator || !generator->ready() || !generator->cacheable()) {
+            seeder_.done(url, false);
+            continue;
+        }
+
+        // below live traffic in the warper queue as well
+        auto sink(Sink::detached());
+        sink.setBackground(true);
+        sink.setObserver([this, url](int status)
+        {
+            seeder_.done(url, status == 200);
+        });
+
+        // seeded files go to the persistent cache only (and to the job's
+        // archive, if exporting)
+        const auto diskKey(cacheKey(*generator, *fi, true));
+        sink.setRecorder([this, diskKey, url](const void *data
+                                              , std::size_t size
+                                              , const Sink::FileInfo &stat)
+        {
+            diskCache_.put(diskKey, data, size, stat);
+            seeder_.record(url, data, size, gzipped(stat));
+        });
+
+        try {
+            auto task(generator->generateFile(*fi, sink));
+            if (!task) {
+                seeder_.done(url, false);
+                continue;
+            }
+
+            postAdmitted(*generator, *fi
+                         , [this, url, diskKey, task](Sink &sink
+                                                      , Arsenal &arsenal)
+            {
+                if (const auto cached = diskCache_.get(diskKey)) {
+                    // already there
+                    seeder_.record(url, cached->body().data()
+                                   , cached->body().size()
+                                   , gzipped(cached->stat));
+                    seeder_.done(url, true, true);
+                    return;
+                }
+                task(sink, arsenal);
+            }, sink);
+        } catch (...) {
+            sink.error();
+        }
+    }
+}
+
+void Core::Detail::generateBundle(const FileInfo &fi, Sink &sink)
+{
+    // split query to list of files and the rest (passed to every file)
+    std::vector<std::string> args;
+    ba::split(args, fi.query, ba::is_any_of("&"), ba::token_compress_on);
+
+    std::vector<std::string> files;
+    std::vector<std::string> rest;
+    for (const auto &arg : args) {
+        if (ba::starts_with(arg, "files=")) {
+            ba::split(files, arg.substr(6), ba::is_any_of(",")
+                      , ba::token_compress_on);
+        } else if (!arg.empty()) {
+            rest.push_back(arg);
+        }
+    }
+    files.erase(std::remove(files.begin(), files.end(), std::string())
+                , files.end());
+
+    if (files.empty() || (files.size() > MaxBundleSize)) {
+        sink.error(utility::makeError<BadRequest>
+                   ("Bundle must list 1 to %d files.", MaxBundleSize));
+        return;
+    }
+
+    for (const auto &file : files) {
+        if ((file.find('/') != std::string::npos) || (file == BundleFile)) {
+            sink.error(utility::makeError<BadRequest>
+                       ("Invalid bundled file <%s>.", file));
+            return;
+        }
+    }
+
+    const auto query(ba::join(rest, "&"));
+    const auto dir(fi.path.substr(0, fi.path.size() - fi.filename.size()));
+
+    // fan out, bundle is sent once the last file is done
+    auto bundle(Bundle::create(sink, files));
+    for (std::size_t index(0); index < files.size(); ++index) {
+        FileInfo ifi(fi);
+        ifi.filename = files[index];
+        ifi.path = dir + ifi.filename;
+        ifi.query = query;
+        ifi.url = query.empty() ? ifi.path : (ifi.path + "?" + query);
+        ifi.ifNoneMatch.clear();
+
+        auto isink(bundle->itemSink(index));
+        try {
+            generateResourceFile(ifi, isink);
+        } catch (...) {
+            isink.error();
+        }
+    }
 }
 
 void Core::Detail::generateReferenceFrameDems(const FileInfo &fi, Sink &sink)
@@ -362,6 +1875,29 @@ Sink::Listing rfDirectoryContent = {
 
 } // namespace
 
+Sink::Listing
+Core::Detail::listing(const std::string &key
+                      , const std::function<Sink::Listing()> &build)
+{
+    {
+        std::unique_lock<std::mutex> lock(listingsLock_);
+        auto flistings(listings_.find(key));
+        if ((flistings != listings_.end())
+            && !generators_.updatedSince(flistings->second.timestamp))
+        {
+            return flistings->second.listing;
+        }
+    }
+
+    // timestamp taken before building: update in between invalidates
+    const auto timestamp(utility::usecFromEpoch());
+    auto listing(build());
+
+    std::unique_lock<std::mutex> lock(listingsLock_);
+    listings_[key] = { timestamp, listing };
+    return listing;
+}
+
 void Core::Detail::generateListing(const FileInfo &fi, Sink &sink)
 {
     if (!assertBrowserEnabled(fi.flags, sink)) { return; }
@@ -379,18 +1915,31 @@ void Core::Detail::generateListing(const FileInfo &fi, Sink &sink)
         return;
 
     case FileInfo::Type::groupListing:
-        sink.listing(buildListing
-                      (generators_.listGroups
-                       (fi.resourceId.referenceFrame, fi.interface.type)
-                       , browsableDirectoryContent));
+        sink.listing(listing
+                     (str(boost::format("%s/%s/")
+                          % fi.resourceId.referenceFrame % fi.interface.type)
+                      , [&]()
+        {
+            return buildListing
+                (generators_.listGroups
+                 (fi.resourceId.referenceFrame, fi.interface.type)
+                 , browsableDirectoryContent);
+        }));
         return;
 
     case FileInfo::Type::idListing:
-        sink.listing(buildListing<false>
-                      (generators_.listIds
-                       (fi.resourceId.referenceFrame, fi.interface.type
-                        , fi.resourceId.group)
-                       , browsableDirectoryContent));
+        sink.listing(listing
+                     (str(boost::format("%s/%s/%s/")
+                          % fi.resourceId.referenceFrame % fi.interface.type
+                          % fi.resourceId.group)
+                      , [&]()
+        {
+            return buildListing<false>
+                (generators_.listIds
+                 (fi.resourceId.referenceFrame, fi.interface.type
+                  , fi.resourceId.group)
+                 , browsableDirectoryContent);
+        }));
         return;
 
     default: break;
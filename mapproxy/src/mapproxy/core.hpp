@@ -27,16 +27,175 @@
 #ifndef mapproxy_core_hpp_included_
 #define mapproxy_core_hpp_included_
 
+#include <map>
+#include <string>
+
 #include "http/contentgenerator.hpp"
 
+#include "support/metrics.hpp"
+#include "support/profiler.hpp"
+#include "support/sharedcache.hpp"
+
 #include "generator.hpp"
+#include "responsecache.hpp"
+#include "diskcache.hpp"
+#include "prefetch.hpp"
+#include "seeder.hpp"
+#include "cluster.hpp"
+#include "admission.hpp"
 
 class Core : boost::noncopyable
            , public http::ContentGenerator
 {
 public:
+    struct Options {
+        /** In-memory cache of generated responses.
+         */
+        ResponseCache::Options cache;
+
+        /** Persistent on-disk cache of generated responses.
+         */
+        DiskCache::Options disk;
+
+        /** Host-wide cache of generated responses shared with other
+         *  instances on this host.
+         */
+        SharedCache::Options shared;
+
+        /** Tile ownership among cluster nodes (off by default).
+         */
+        Cluster::Options cluster;
+
+        /** Admission control of generator tasks.
+         */
+        AdmissionControl::Options admission;
+
+        /** Fair sharing of processing threads among resources. Each
+         *  resource gets threads in proportion to the weight of its
+         *  generator type.
+         */
+        struct Scheduling {
+            /** Maximum number of tasks of one resource running at once
+             *  (0 = unlimited).
+             */
+            std::size_t maxRunningPerResource;
+
+            /** Weights of generator types.
+             */
+            unsigned int tmsWeight;
+            unsigned int surfaceWeight;
+            unsigned int geodataWeight;
+
+            Scheduling()
+                : maxRunningPerResource(), tmsWeight(1), surfaceWeight(1)
+                , geodataWeight(1)
+            {}
+        };
+
+        Scheduling scheduling;
+
+        /** Background generation of tiles likely to be requested next.
+         *  Needs response cache (in-memory or on-disk) to be of any use.
+         */
+        Prefetcher::Options prefetch;
+
+        /** Requests slower than this are logged with breakdown of their
+         *  processing stages (in ms, 0 = never).
+         */
+        unsigned int traceSlowThreshold;
+
+        /** Stack sampling of generator tasks running over threshold.
+         */
+        profiler::Options profile;
+
+        /** Maximum number of files of a seeding job in flight.
+         */
+        std::size_t seedBudget;
+
+        /** Identical requests in flight at the same time share single
+         *  generator run, its response is sent to all of them.
+         */
+        bool coalesce;
+
+        /** Warming of resources (see warm()).
+         */
+        struct Warmup {
+            /** Warm every resource right after it is prepared.
+             */
+            bool onPrepare;
+
+            /** Number of resource's top lods generated into the persistent
+             *  cache (0 = none).
+             */
+            unsigned int lods;
+
+            Warmup() : onPrepare(false), lods(3) {}
+        };
+
+        Warmup warmup;
+
+        /** Resource file requests not answered within this time are
+         *  answered with 504; work still queued or running for them (incl.
+         *  GDAL warper requests) is dropped (in ms, 0 = no deadline).
+         */
+        unsigned int deadline;
+
+        /** Deadlines overriding the one above by file type, i.e. filename
+         *  extension ("jpg", "bin", "json", ...).
+         */
+        std::map<std::string, unsigned int> deadlines;
+
+        Options()
+            : traceSlowThreshold(), seedBudget(4), coalesce(true)
+            , deadline()
+        {}
+    };
+
     Core(Generators &generators, GdalWarper &warper
-         , unsigned int threadCount, http::ContentFetcher &contentFetcher);
+         , unsigned int threadCount, http::ContentFetcher &contentFetcher
+         , const Options &options = Options());
+
+    void stat(std::ostream &os) const;
+
+    /** Writes lock-free metrics.
+     */
+    void metrics(metrics::Writer &writer) const;
+
+    /** Queues seeding job: tiles of given resource are generated into the
+     *  persistent cache in the background (see Seeder). Job's budget and
+     *  state file are filled in if not set. Returns job id.
+     */
+    unsigned int seed(const Seeder::Job &job);
+
+    /** Cancels seeding job, its state is kept for later resume.
+     */
+    bool cancelSeed(unsigned int id);
+
+    void seedStatus(std::ostream &os) const;
+
+    /** Warms all ready generators of given resource: prefaults their
+     *  indices, asks every GDAL worker to open their datasets and seeds
+     *  their top lods into the persistent cache (if enabled) in the
+     *  background. Returns number of warmed generators.
+     */
+    unsigned int warm(const Resource::Id &resourceId);
+
+    /** Prints per-resource usage: requests, response cache hits, bytes
+     *  sent, processing thread and GDAL worker CPU time (in microseconds).
+     */
+    void resourceUsage(std::ostream &os) const;
+
+    /** Prints generator tasks in flight (queued or running) and GDAL
+     *  warper requests (queued or running) with their ages, one per line.
+     */
+    void inFlight(std::ostream &os) const;
+
+    /** Waits (at most timeout ms) until all requests received so far are
+     *  answered and their processing is finished. Requests received
+     *  meanwhile are served as usual but not waited for. Returns false on
+     *  timeout.
+     */
+    bool drain(unsigned int timeout);
 
     struct Detail;
 
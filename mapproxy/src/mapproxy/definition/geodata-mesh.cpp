@@ -150,12 +150,13 @@ Changed GeodataMesh::changed_impl(const DefinitionBase &o) const
     // options can be safely changed
     if (optionsChanged(*this, other)) { safe = true; }
 
-    // introspection can change
-    if (introspection != other.introspection) { safe = true; }
+    // introspection is presentation only
+    bool meta(introspection != other.introspection);
 
     // interpret change type
     if (bump) { return Changed::withRevisionBump; }
     if (safe) { return Changed::safely; }
+    if (meta) { return Changed::metadata; }
     return Changed::no;
 }
 
@@ -123,12 +123,13 @@ Changed GeodataSemanticBase::changed_impl(const DefinitionBase &o) const
     // options can be safely changed
     if (optionsChanged(*this, other)) { safe = true; }
 
-    // introspection can change
-    if (introspection != other.introspection) { safe = true; }
+    // introspection is presentation only
+    bool meta(introspection != other.introspection);
 
     // interpret change type
     if (bump) { return Changed::withRevisionBump; }
     if (safe) { return Changed::safely; }
+    if (meta) { return Changed::metadata; }
     return Changed::no;
 }
 
@@ -191,6 +192,9 @@ void parseDefinition(GeodataSemanticTiled &def, const Json::Value &value)
     Json::get(def.dem.dataset, value, "demDataset");
     Json::get(def.dem.geoidGrid, value, "geoidGrid");
     Json::get(def.lod, value, "lod");
+    if (value.isMember("pretiled")) {
+        Json::get(def.pretiled, value, "pretiled");
+    }
 }
 
 void buildDefinition(Json::Value &value, const GeodataSemanticTiled &def)
@@ -198,6 +202,7 @@ void buildDefinition(Json::Value &value, const GeodataSemanticTiled &def)
     value["demDataset"] = def.dem.dataset;
     if (def.dem.geoidGrid) { value["geoidGrid"] = *def.dem.geoidGrid; }
     value["lod"] = def.lod;
+    if (def.pretiled) { value["pretiled"] = def.pretiled; }
 }
 
 } // namespace
@@ -235,6 +240,13 @@ Changed GeodataSemanticTiled::changed_impl(const DefinitionBase &o) const
         return Changed::withRevisionBump;
     }
 
+    // same output, different store -> regenerate unless bumped anyway
+    if ((changed != Changed::withRevisionBump)
+        && (pretiled != other.pretiled))
+    {
+        return Changed::yes;
+    }
+
     // pass result from parent
     return changed;
 }
@@ -88,7 +88,11 @@ struct GeodataSemanticTiled : public GeodataSemanticBase {
     DemDataset dem;
     int lod;
 
-    GeodataSemanticTiled() : lod(2) {}
+    /** Generate all tiles at prepare time and serve them from the store.
+     */
+    bool pretiled;
+
+    GeodataSemanticTiled() : lod(2), pretiled(false) {}
 
     virtual void from_impl(const Json::Value &value);
     virtual void to_impl(Json::Value &value) const;
@@ -55,6 +55,10 @@ void parseDefinition(GeodataVectorTiled &def, const Json::Value &value)
     }
  
     Json::getOpt(def.schema, value, "schema");
+
+    if (value.isMember("precomputedMetatiles")) {
+        Json::get(def.precomputedMetatiles, value, "precomputedMetatiles");
+    }
 }
 
 void buildDefinition(Json::Value &value, const GeodataVectorTiled &def)
@@ -64,6 +68,10 @@ void buildDefinition(Json::Value &value, const GeodataVectorTiled &def)
     }
     
     value["schema"] = boost::lexical_cast<std::string>(def.schema);
+
+    if (def.precomputedMetatiles) {
+        value["precomputedMetatiles"] = def.precomputedMetatiles;
+    }
 }
 
 } // namespace
@@ -103,6 +111,13 @@ Changed GeodataVectorTiled::changed_impl(const DefinitionBase &o)
         return Changed::withRevisionBump;
     }
 
+    // same output, different store -> regenerate unless bumped anyway
+    if ((changed != Changed::withRevisionBump)
+        && (precomputedMetatiles != other.precomputedMetatiles))
+    {
+        return Changed::yes;
+    }
+
     // pass result from parent
     return changed;
 }
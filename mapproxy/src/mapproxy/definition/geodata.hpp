@@ -74,6 +74,11 @@ struct GeodataVectorBase : public DefinitionBase {
     std::string styleUrl;
     int displaySize;
     geo::heightcoding::Mode mode;
+
+    /** Sample DEM in batches instead of vertex by vertex.
+     */
+    bool batchSampling;
+
     LayerEnhancer::map layerEnhancers;
     HeightFunction::pointer heightFunction;
     boost::any options;
@@ -82,7 +87,7 @@ struct GeodataVectorBase : public DefinitionBase {
 
     GeodataVectorBase()
         : format(geo::VectorFormat::geodataJson) , displaySize(256)
-        , mode(geo::heightcoding::Mode::auto_)
+        , mode(geo::heightcoding::Mode::auto_), batchSampling(false)
     {}
 
     virtual void from_impl(const Json::Value &value);
@@ -113,12 +118,19 @@ struct GeodataVectorTiled : GeodataVectorBase {
      */
     boost::optional<vts::Lod> maxSourceLod;
 
+    /** Generate all metatiles at prepare time and serve them from the store.
+     */
+    bool precomputedMetatiles;
+
     virtual void from_impl(const Json::Value &value);
     virtual void to_impl(Json::Value &value) const;
     
     geo::heightcoding::Schema schema;
 
-    GeodataVectorTiled() : schema(geo::heightcoding::Schema::maptiler) {}
+    GeodataVectorTiled()
+        : precomputedMetatiles(false)
+        , schema(geo::heightcoding::Schema::maptiler)
+    {}
 
     static constexpr Resource::Generator::Type type
         = Resource::Generator::Type::geodata;
@@ -88,6 +88,7 @@ void parseDefinition(GeodataVectorBase &def
     Json::getOpt(def.styleUrl, value, "styleUrl");
     Json::get(def.displaySize, value, "displaySize");
     Json::getOpt(def.mode, value, "mode");
+    Json::getOpt(def.batchSampling, value, "batchSampling");
 
     if (value.isMember("enhance")) {
         const auto enhance(value["enhance"]);
@@ -144,6 +145,7 @@ void buildDefinition(Json::Value &value
     value["displaySize"] = def.displaySize;
     value["styleUrl"] = def.styleUrl;
     value["mode"] = boost::lexical_cast<std::string>(def.mode);
+    if (def.batchSampling) { value["batchSampling"] = def.batchSampling; }
 
     if (!def.layerEnhancers.empty()) {
         auto &layerEnhancers(value["enhance"] = Json::objectValue);
@@ -195,6 +197,8 @@ Changed GeodataVectorBase::changed_impl(const DefinitionBase &o) const
     if (layers != other.layers) { bump = true; }
     if (clipLayers != other.clipLayers) { bump = true; }
     if (mode != other.mode) { bump = true; }
+    // heights are interpolated differently
+    if (batchSampling != other.batchSampling) { bump = true; }
     if (layerEnhancers != other.layerEnhancers) { bump = true; }
     if (HeightFunction::changed(heightFunction, other.heightFunction)) {
         bump = true;
@@ -212,12 +216,13 @@ Changed GeodataVectorBase::changed_impl(const DefinitionBase &o) const
     // options can be safely changed
     if (optionsChanged(*this, other)) { safe = true; }
 
-    // introspection can change
-    if (introspection != other.introspection) { safe = true; }
+    // introspection is presentation only
+    bool meta(introspection != other.introspection);
 
     // interpret change type
     if (bump) { return Changed::withRevisionBump; }
     if (safe) { return Changed::safely; }
+    if (meta) { return Changed::metadata; }
     return Changed::no;
 }
 
@@ -28,6 +28,7 @@
 #include <boost/utility/in_place_factory.hpp>
 
 #include "utility/premain.hpp"
+#include "utility/raise.hpp"
 
 #include "jsoncpp/json.hpp"
 #include "jsoncpp/as.hpp"
@@ -38,6 +39,7 @@
 namespace resource {
 
 constexpr char SurfaceDem::driverName[];
+constexpr double SurfaceDem::DefaultDemFastRatio;
 
 MAPPROXY_DEFINITION_REGISTER(SurfaceDem)
 
@@ -62,6 +64,14 @@ void parseDefinition(SurfaceDem &def, const Json::Value &value)
         def.dem.geoidGrid = s;
     }
 
+    if (value.isMember("bakeGeoid")) {
+        Json::get(def.bakeGeoid, value, "bakeGeoid");
+        if (def.bakeGeoid && !def.dem.geoidGrid) {
+            utility::raise<Json::Error>
+                ("bakeGeoid makes no sense without geoidGrid.");
+        }
+    }
+
     if (value.isMember("landcover")) {
 
         auto lc = value["landcover"];
@@ -78,6 +88,53 @@ void parseDefinition(SurfaceDem &def, const Json::Value &value)
         Json::get(*def.heightcodingAlias, value, "heightcodingAlias");
     }
 
+    if (value.isMember("mesher")) {
+        std::string s;
+        Json::get(s, value, "mesher");
+        try {
+            def.mesher = boost::lexical_cast<SurfaceDem::Mesher>(s);
+        } catch (const boost::bad_lexical_cast&) {
+            utility::raise<Json::Error>
+                ("Value stored in mesher is not SurfaceDem::Mesher value");
+        }
+    }
+
+    if (value.isMember("overviewRatio")) {
+        def.overviewRatio = boost::in_place();
+        Json::get(*def.overviewRatio, value, "overviewRatio");
+    }
+
+    if (value.isMember("virtualLods")) {
+        Json::get(def.virtualLods, value, "virtualLods");
+    }
+
+    if (value.isMember("reprojectedMaxLod")) {
+        def.reprojectedMaxLod = boost::in_place();
+        Json::get(*def.reprojectedMaxLod, value, "reprojectedMaxLod");
+    }
+
+    if (value.isMember("fillGaps")) {
+        def.fillGaps = boost::in_place();
+        Json::get(*def.fillGaps, value, "fillGaps");
+        if (!*def.fillGaps) {
+            utility::raise<Json::Error>("fillGaps must be positive.");
+        }
+    }
+
+    if (value.isMember("demResampling")) {
+        std::string s;
+        Json::get(s, value, "demResampling");
+        if (s == "dem-fast") {
+            def.demFastRatio = SurfaceDem::DefaultDemFastRatio;
+            if (value.isMember("demFastRatio")) {
+                Json::get(*def.demFastRatio, value, "demFastRatio");
+            }
+        } else if (s != "dem") {
+            utility::raise<Json::Error>
+                ("Value stored in demResampling is neither dem nor dem-fast");
+        }
+    }
+
     def.parse(value);
 }
 
@@ -94,6 +151,7 @@ void buildDefinition(Json::Value &value, const SurfaceDem &def)
     if (def.dem.geoidGrid) {
         value["geoidGrid"] = *def.dem.geoidGrid;
     }
+    if (def.bakeGeoid) { value["bakeGeoid"] = true; }
     if (def.landcover) {
         auto& lc(value["landcover"] = Json::objectValue);
 
@@ -105,6 +163,21 @@ void buildDefinition(Json::Value &value, const SurfaceDem &def)
         value["heightcodingAlias"] = *def.heightcodingAlias;
     }
 
+    if (def.mesher != SurfaceDem::Mesher::simplify) {
+        value["mesher"] = boost::lexical_cast<std::string>(def.mesher);
+    }
+
+    if (def.overviewRatio) { value["overviewRatio"] = *def.overviewRatio; }
+    if (def.virtualLods) { value["virtualLods"] = true; }
+    if (def.reprojectedMaxLod) {
+        value["reprojectedMaxLod"] = *def.reprojectedMaxLod;
+    }
+    if (def.fillGaps) { value["fillGaps"] = *def.fillGaps; }
+    if (def.demFastRatio) {
+        value["demResampling"] = "dem-fast";
+        value["demFastRatio"] = *def.demFastRatio;
+    }
+
     def.build(value);
 }
 
@@ -127,9 +200,26 @@ Changed SurfaceDem::changed_impl(const DefinitionBase &o) const
     if (dem != other.dem) { return Changed::yes; }
     if (mask != other.mask) { return Changed::yes; }
     if (textureLayerId != other.textureLayerId) { return Changed::yes; }
+    if (bakeGeoid != other.bakeGeoid) { return Changed::yes; }
 
     if (landcover != other.landcover) { return Changed::yes; }
 
+    // different meshes: must be published under new revision
+    if (mesher != other.mesher) { return Changed::withRevisionBump; }
+    if (overviewRatio != other.overviewRatio) {
+        return Changed::withRevisionBump;
+    }
+    if (virtualLods != other.virtualLods) {
+        return Changed::withRevisionBump;
+    }
+    if (demFastRatio != other.demFastRatio) {
+        return Changed::withRevisionBump;
+    }
+    if (reprojectedMaxLod != other.reprojectedMaxLod) {
+        return Changed::withRevisionBump;
+    }
+    if (fillGaps != other.fillGaps) { return Changed::withRevisionBump; }
+
     return Surface::changed_impl(o);
 }
 
@@ -27,6 +27,8 @@
 #include <boost/lexical_cast.hpp>
 #include <boost/utility/in_place_factory.hpp>
 
+#include "utility/raise.hpp"
+
 #include "jsoncpp/json.hpp"
 #include "jsoncpp/as.hpp"
 
@@ -81,6 +83,22 @@ void Surface::parse(const Json::Value &value)
 
     heightFunction = HeightFunction::parse(value, "heightFunction");
 
+    if (value.isMember("compressedMesh")) {
+        Json::get(compressedMesh, value, "compressedMesh");
+    }
+
+    if (value.isMember("normalMaps")) {
+        std::string s;
+        Json::get(s, value, "normalMaps");
+        try {
+            normalMaps = boost::lexical_cast<NormalMaps>(s);
+        } catch (const boost::bad_lexical_cast&) {
+            utility::raise<Json::Error>
+                ("Value stored in normalMaps is not "
+                 "Surface::NormalMaps value");
+        }
+    }
+
     if (value.isMember("introspection")) {
         const auto &jintrospection(value["introspection"]);
 
@@ -116,6 +134,14 @@ void Surface::build(Json::Value &value) const
         heightFunction->build(tmp);
     }
 
+    if (compressedMesh) {
+        value["compressedMesh"] = compressedMesh;
+    }
+
+    if (normalMaps != NormalMaps::full) {
+        value["normalMaps"] = boost::lexical_cast<std::string>(normalMaps);
+    }
+
     if (!introspection.empty()) {
         auto &jintrospection(value["introspection"] = Json::objectValue);
         introspection::layersTo(jintrospection, "tms", introspection.tms) ;
@@ -148,7 +174,7 @@ Changed Surface::changed_impl(const DefinitionBase &o)
         return Changed::safely;
     }
 
-    if (introspection != other.introspection) {
+    if (compressedMesh != other.compressedMesh) {
         return Changed::safely;
     }
 
@@ -156,6 +182,16 @@ Changed Surface::changed_impl(const DefinitionBase &o)
         return Changed::yes;
     }
 
+    // different normal maps: must be published under new revision
+    if (normalMaps != other.normalMaps) {
+        return Changed::withRevisionBump;
+    }
+
+    // introspection is presentation only
+    if (introspection != other.introspection) {
+        return Changed::metadata;
+    }
+
     return Changed::no;
 }
 
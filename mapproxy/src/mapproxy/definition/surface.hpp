@@ -30,6 +30,8 @@
 #include <boost/optional.hpp>
 #include <boost/filesystem.hpp>
 
+#include "utility/enum-io.hpp"
+
 #include "geo/geodataset.hpp"
 
 #include "../support/geo.hpp"
@@ -63,6 +65,28 @@ public:
     HeightFunction::pointer heightFunction;
     Introspection introspection;
 
+    /** Serve compressed mesh flavor (see support/meshcompress.hpp) besides
+     *  regular meshes.
+     */
+    bool compressedMesh;
+
+    /** Normal map resolution policy.
+     */
+    enum class NormalMaps {
+        /** always 256x256 */
+        full
+        /** tiles finer than the DEM get normal maps at the DEM's effective
+         *  resolution (128x128, 64x64, ...), client scales them */
+        , adaptive
+        /** as adaptive but normal maps are upscaled to 256x256 in-process
+         *  (bilinear, after encoding) */
+        , adaptiveUpscale
+    };
+
+    NormalMaps normalMaps;
+
+    Surface() : compressedMesh(false), normalMaps(NormalMaps::full) {}
+
     void parse(const Json::Value &value);
     void build(Json::Value &value) const;
 
@@ -93,15 +117,73 @@ private:
 };
 
 struct SurfaceDem : public Surface {
+    /** Mesh generation pipeline.
+     */
+    enum class Mesher {
+        /** fixed 128x128 grid, generic simplification */
+        simplify
+        /** grid resolution adapted to tile roughness, generic
+         *  simplification */
+        , adaptive
+        /** grid resolution adapted to tile roughness, error-driven RTIN
+         *  triangulation */
+        , rtin
+    };
 
     DemDataset dem;
     boost::optional<LandcoverDataset> landcover;
     boost::optional<boost::filesystem::path> mask;
     unsigned int textureLayerId;
     boost::optional<std::string> heightcodingAlias;
-
-
-    SurfaceDem() : textureLayerId() {}
+    Mesher mesher;
+
+    /** Overview selection policy of DEM warps: warp from the coarsest
+     *  overview at least this many times finer than the sample spacing.
+     *  Unset = GDAL's choice.
+     */
+    boost::optional<double> overviewRatio;
+
+    /** Add geoid undulation to DEM heights at prepare time: ellipsoidal
+     *  DEM (with overviews) is written into the resource store and served
+     *  instead of the dataset, no geoid grid is applied at runtime. Needs
+     *  geoidGrid.
+     */
+    bool bakeGeoid;
+
+    /** Tiles finer than the DEM's effective GSD are not meshed: their mesh
+     *  is a small regular grid subdividing the DEM of their ancestor at
+     *  native resolution, no warp, no simplification.
+     */
+    bool virtualLods;
+
+    /** DEM resampling policy "dem-fast": DEM warps (meshes, normal maps,
+     *  navtiles and metatiles) whose destination pixel spans more than this
+     *  many source pixels use average filter on a suitable overview instead
+     *  of Resampling::dem. Unset = policy "dem" (always full kernel).
+     */
+    boost::optional<double> demFastRatio;
+
+    static constexpr double DefaultDemFastRatio = 4.0;
+
+    /** DEM warps of tiles up to this LOD read overview pyramids of the DEM
+     *  pre-reprojected into SRSes of the reference frame (see
+     *  ReprojectedPyramids). Unset = always warp the DEM itself. Not used
+     *  with bakeGeoid.
+     */
+    boost::optional<unsigned int> reprojectedMaxLod;
+
+    /** Fill DEM holes and extend its edges at prepare time by up to this
+     *  many pixels: gap-filled DEM (with validity mask) is written into the
+     *  resource store and meshes, normal maps and navtiles are warped from
+     *  it; coverage comes from the validity mask. Unset = warp the DEM
+     *  itself. Takes precedence over reprojectedMaxLod.
+     */
+    boost::optional<unsigned int> fillGaps;
+
+    SurfaceDem()
+        : textureLayerId(), mesher(Mesher::simplify), bakeGeoid(false)
+        , virtualLods(false)
+    {}
 
     static constexpr char driverName[] = "surface-dem";
 
@@ -116,5 +198,17 @@ private:
 
 } // namespace resource
 
+UTILITY_GENERATE_ENUM_IO(resource::Surface::NormalMaps,
+    ((full))
+    ((adaptive))
+    ((adaptiveUpscale))
+)
+
+UTILITY_GENERATE_ENUM_IO(resource::SurfaceDem::Mesher,
+    ((simplify))
+    ((adaptive))
+    ((rtin))
+)
+
 #endif // mapproxy_definition_surface_hpp_included_
 
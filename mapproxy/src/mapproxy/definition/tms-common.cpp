@@ -42,6 +42,7 @@ constexpr Resource::Generator::Type TmsCommon::type;
 void TmsCommon::parse(const Json::Value &value)
 {
     if (value.isMember("options")) { options = value["options"]; }
+    encoding.parse(value);
 }
 
 void TmsCommon::build(Json::Value &value) const
@@ -49,6 +50,7 @@ void TmsCommon::build(Json::Value &value) const
     if (!options.empty()) {
         value["options"] = boost::any_cast<Json::Value>(options);
     }
+    encoding.build(value);
 }
 
 Changed TmsCommon::changed_impl(const DefinitionBase &o) const
@@ -58,6 +60,9 @@ Changed TmsCommon::changed_impl(const DefinitionBase &o) const
     // options can change
     if (optionsChanged(*this, other)) { return Changed::safely; }
 
+    // encoding can change
+    if (encoding != other.encoding) { return Changed::safely; }
+
     // not changed
     return Changed::no;
 }
@@ -62,10 +62,12 @@ void parseDefinition(TmsNormalMap &def, const Json::Value &value) {
     }
 
     // sanity check
-    if (def.format != RasterFormat::webp) {
-
+    if ((def.format != RasterFormat::webp)
+        && (def.format != RasterFormat::ktx2))
+    {
         ut::raise<Json::Error>(
-            "Format %1% not supported in tms-normalmap, use webp", def.format);
+            "Format %1% not supported in tms-normalmap, use webp or ktx2"
+            , def.format);
     }
 
 }
@@ -73,6 +73,59 @@ void parseDefinition(TmsRaster &def, const Json::Value &value)
 
     Json::get(def.resampling, value, "resampling");
 
+    if (value.isMember("pyramid")) {
+        Json::get(s, value, "pyramid");
+        try {
+            def.pyramid = boost::lexical_cast<TmsRaster::PyramidFilter>(s);
+        } catch (const boost::bad_lexical_cast&) {
+            utility::raise<Json::Error>
+                ("Value stored in pyramid is not TmsRaster::PyramidFilter "
+                 "value");
+        }
+    }
+
+    if (value.isMember("overviewRatio")) {
+        def.overviewRatio = boost::in_place();
+        Json::get(*def.overviewRatio, value, "overviewRatio");
+    }
+
+    if (value.isMember("palette")) {
+        Json::get(def.palette, value, "palette");
+    }
+
+    if (value.isMember("reprojectedMaxLod")) {
+        def.reprojectedMaxLod = boost::in_place();
+        Json::get(*def.reprojectedMaxLod, value, "reprojectedMaxLod");
+    }
+
+    const auto checkEncoder([](RasterFormat format)
+    {
+        if (!encoderAvailable(format)) {
+            utility::raise<Json::Error>
+                ("Format %s is not supported by this build.", format);
+        }
+    });
+    checkEncoder(def.format);
+
+    def.negotiate.clear();
+    if (value.isMember("negotiate")) {
+        const auto &negotiate(value["negotiate"]);
+        if (!negotiate.isArray()) {
+            utility::raise<Json::Error>("Negotiate is not an array.");
+        }
+        for (const auto &item : negotiate) {
+            RasterFormat format(RasterFormat::jpg);
+            try {
+                format = boost::lexical_cast<RasterFormat>(item.asString());
+            } catch (const boost::bad_lexical_cast&) {
+                utility::raise<Json::Error>
+                    ("Value stored in negotiate is not RasterFormat value");
+            }
+            checkEncoder(format);
+            def.negotiate.push_back(format);
+        }
+    }
+
     def.parse(value);
 }
 
@@ -92,6 +145,23 @@ void buildDefinition(Json::Value &value, const TmsRaster &def)
             = boost::lexical_cast<std::string>(*def.resampling);
     }
 
+    if (def.pyramid) {
+        value["pyramid"] = boost::lexical_cast<std::string>(*def.pyramid);
+    }
+
+    if (def.overviewRatio) { value["overviewRatio"] = *def.overviewRatio; }
+    if (def.palette) { value["palette"] = true; }
+    if (def.reprojectedMaxLod) {
+        value["reprojectedMaxLod"] = *def.reprojectedMaxLod;
+    }
+
+    if (!def.negotiate.empty()) {
+        auto &negotiate(value["negotiate"] = Json::arrayValue);
+        for (const auto format : def.negotiate) {
+            negotiate.append(boost::lexical_cast<std::string>(format));
+        }
+    }
+
     def.build(value);
 }
 
@@ -115,16 +185,27 @@ Changed TmsRaster::changed_impl(const DefinitionBase &o) const
     if (dataset != other.dataset) { return Changed::yes; }
     if (mask != other.mask) { return Changed::yes; }
 
+    // colour table is read when resource is prepared
+    if (palette != other.palette) { return Changed::yes; }
+
     // transparent can change
     if (transparent != other.transparent) { return Changed::safely; }
 
     // format can change
     if (format != other.format) { return Changed::safely; }
+    if (negotiate != other.negotiate) { return Changed::safely; }
 
     // resampling can change
     if (resampling != other.resampling) { return Changed::safely; }
+    if (overviewRatio != other.overviewRatio) { return Changed::safely; }
+    if (reprojectedMaxLod != other.reprojectedMaxLod) {
+        return Changed::safely;
+    }
     if (erodeMask != other.erodeMask) { return Changed::safely; }
 
+    // pyramid changes output
+    if (pyramid != other.pyramid) { return Changed::withRevisionBump; }
+
     return TmsCommon::changed_impl(o);
 }
 
@@ -0,0 +1,110 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "mapproxy/resource.hpp"
+#include "utility/premain.hpp"
+#include "utility/raise.hpp"
+
+#include "jsoncpp/json.hpp"
+#include "jsoncpp/as.hpp"
+
+#include "tms.hpp"
+#include "factory.hpp"
+
+namespace ut = utility;
+
+namespace resource {
+
+constexpr char TmsTerrainRgb::driverName[];
+
+MAPPROXY_DEFINITION_REGISTER(TmsTerrainRgb)
+
+namespace {
+
+void parseDefinition(TmsTerrainRgb &def, const Json::Value &value) {
+
+    Json::getOpt(def.base, value, "base");
+    Json::getOpt(def.interval, value, "interval");
+
+    if (value.isMember("surface")) {
+        def.surface = boost::in_place();
+        Json::get(*def.surface, value, "surface");
+    }
+
+    // sanity check
+    if (def.interval <= 0.0) {
+        ut::raise<Json::Error>("Interval in tms-terrainrgb must be positive.");
+    }
+
+    // heights must survive encoding bit-exact
+    if ((def.format != RasterFormat::png)
+        && !((def.format == RasterFormat::webp)
+             && def.encoding.webpLossless))
+    {
+        ut::raise<Json::Error>(
+            "Format %1% not supported in tms-terrainrgb, use png or "
+            "lossless webp", def.format);
+    }
+}
+
+void buildDefinition(Json::Value &value, const TmsTerrainRgb &def) {
+
+    value["base"] = def.base;
+    value["interval"] = def.interval;
+    if (def.surface) { value["surface"] = *def.surface; }
+}
+
+} // namespace
+
+void TmsTerrainRgb::from_impl(const Json::Value &value) {
+
+    TmsRaster::from_impl(value);
+    parseDefinition(*this, value);
+}
+
+void TmsTerrainRgb::to_impl(Json::Value &value) const {
+
+    TmsRaster::to_impl(value);
+    buildDefinition(value, *this);
+}
+
+Changed TmsTerrainRgb::changed_impl(const DefinitionBase &o) const {
+
+    const auto &other(o.as<TmsTerrainRgb>());
+
+    // encoding changes output
+    if (!math::almostEqual(base, other.base)
+        || !math::almostEqual(interval, other.interval)
+        || (surface != other.surface))
+    {
+        return Changed::withRevisionBump;
+    }
+
+    // common definition
+    return TmsRaster::changed_impl(o);
+}
+
+} // namespace resource
@@ -46,6 +46,13 @@ namespace {
 void parseDefinition(TmsWindyty &def, const Json::Value &value)
 {
     Json::getOpt(def.forecastOffset, value, "forecastOffset");
+    Json::getOpt(def.preRotate, value, "preRotate");
+    Json::getOpt(def.staleTtl, value, "staleTtl");
+
+    if (value.isMember("warmLod")) {
+        def.warmLod = boost::in_place();
+        Json::get(*def.warmLod, value, "warmLod");
+    }
 
     def.parse(value);
 }
@@ -55,6 +62,9 @@ void buildDefinition(Json::Value &value, const TmsWindyty &def)
     if (def.forecastOffset) {
         value["forecastOffset"] = def.forecastOffset;
     }
+    if (def.preRotate) { value["preRotate"] = def.preRotate; }
+    if (def.warmLod) { value["warmLod"] = *def.warmLod; }
+    if (def.staleTtl) { value["staleTtl"] = def.staleTtl; }
 
     def.build(value);
 }
@@ -88,6 +98,13 @@ Changed TmsWindyty::changed_impl(const DefinitionBase &o) const
     // forecast offset can change
     if (forecastOffset != other.forecastOffset) { return Changed::safely; }
 
+    // slice rotation settings can change as well
+    if ((preRotate != other.preRotate) || (warmLod != other.warmLod)
+        || (staleTtl != other.staleTtl))
+    {
+        return Changed::safely;
+    }
+
     return TmsCommon::changed_impl(o);
 }
 
@@ -35,6 +35,7 @@
 
 #include "../resource.hpp"
 #include "../support/geo.hpp"
+#include "../support/imgencode.hpp"
 
 // fwd
 namespace Json { class Value; }
@@ -46,6 +47,10 @@ namespace resource {
 struct TmsCommon : public DefinitionBase {
     boost::any options;
 
+    /** Image encoder settings.
+     */
+    ImageEncoding encoding;
+
     static constexpr Resource::Generator::Type type
         = Resource::Generator::Type::tms;
 
@@ -103,8 +108,41 @@ struct TmsRaster : public TmsCommon {
     bool erodeMask;
     boost::optional<geo::GeoDataset::Resampling> resampling;
 
+    /** Filter used to build tile from its four cached children instead of
+     *  warping the dataset.
+     */
+    enum class PyramidFilter { box, lanczos };
+
+    /** Pyramid from children: tile whose children are all cached is built
+     *  by downsampling them. Unset = always warp. Changes output slightly.
+     */
+    boost::optional<PyramidFilter> pyramid;
+
+    /** Overview selection policy: warp from the coarsest overview at least
+     *  this many times finer than the tile pixel. Unset = GDAL's choice.
+     */
+    boost::optional<double> overviewRatio;
+
+    /** Keep colour table of a paletted dataset: tiles are warped as
+     *  indices (nearest neighbour unless resampling is configured) and PNG
+     *  tiles are sent as indexed PNG. Ignored for non-paletted datasets.
+     */
+    bool palette;
+
+    /** Formats offered instead of the configured one to clients accepting
+     *  them (HTTP Accept header), in order of preference. Applies to tile
+     *  images requested in the configured format, not to atlases.
+     */
+    std::vector<RasterFormat> negotiate;
+
+    /** Tiles up to this LOD are warped from overview pyramids of the
+     *  dataset pre-reprojected into SRSes of the reference frame (see
+     *  ReprojectedPyramids). Unset = always warp the dataset itself.
+     */
+    boost::optional<unsigned int> reprojectedMaxLod;
+
     TmsRaster(): format(RasterFormat::jpg), transparent(false),
-        erodeMask(false) {}
+        erodeMask(false), palette(false) {}
 
     static constexpr char driverName[] = "tms-raster";
 
@@ -179,6 +217,38 @@ protected:
     bool frozenCredits_impl() const override { return false; }
 };
 
+/** Raw DEM tiles for client-side meshing, encoded as terrain-RGB:
+ *
+ *      height = base + (R * 65536 + G * 256 + B) * interval
+ *
+ *  Samples are taken at pixel centres. Defaults follow the widespread
+ *  Mapbox convention. Code 0 (black pixel) marks nodata, valid heights
+ *  start at code 1.
+ */
+struct TmsTerrainRgb : public TmsRaster {
+    double base;
+    double interval;
+
+    /** Surface (full resource ID in the same reference frame) whose DEM and
+     *  geoid grid are served; heights are then ellipsoidal like the
+     *  surface's mesh. Inherited dataset (which drives tile index and mask
+     *  anyway) is served as is when unset.
+     */
+    boost::optional<std::string> surface;
+
+    TmsTerrainRgb(): TmsRaster(), base(-10000.0), interval(0.1) {
+        format = RasterFormat::png;
+    }
+
+    static constexpr char driverName[] = "tms-terrainrgb";
+
+protected:
+    void from_impl(const Json::Value &value) override;
+    void to_impl(Json::Value &value) const override;
+    Changed changed_impl(const DefinitionBase &other) const override;
+    bool frozenCredits_impl() const override { return false; }
+};
+
 struct TmsSpecularMap: public TmsRaster {
 
     uchar shininessBits;
@@ -232,7 +302,23 @@ private:
 struct TmsWindyty : public TmsRaster {
     int forecastOffset;
 
-    TmsWindyty() : forecastOffset() {}
+    /** Dataset of the next forecast slice is written this many seconds
+     *  before the switch-over (0 = at the switch-over).
+     */
+    int preRotate;
+
+    /** Tiles of the next slice up to this LOD are warped right after it is
+     *  written to warm GDAL's cache of upstream tiles. Needs preRotate.
+     */
+    boost::optional<vts::Lod> warmLod;
+
+    /** Previous slices are served to clients still using them (i.e. with
+     *  stale bound layer definition) for this many seconds after the
+     *  switch-over (0 = current slice only).
+     */
+    int staleTtl;
+
+    TmsWindyty() : forecastOffset(), preRotate(), staleTtl() {}
 
     static constexpr char driverName[] = "tms-windyty";
 
@@ -245,4 +331,9 @@ private:
 
 } // namespace resource
 
+UTILITY_GENERATE_ENUM_IO(resource::TmsRaster::PyramidFilter,
+    ((box))
+    ((lanczos))
+)
+
 #endif // mapproxy_definition_tms_hpp_included_
@@ -0,0 +1,709 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+
+#include <ctime>
+#include <chrono>
+#include <fstream>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <system_error>
+
+#include <boost/filesystem.hpp>
+
+#include "dbglog/dbglog.hpp"
+
+#include "support/hash.hpp"
+
+#include "diskcache.hpp"
+
+namespace fs = boost::filesystem;
+namespace bi = boost::interprocess;
+
+namespace {
+
+const char IndexMagic[4] = { 'M', 'P', 'D', 'I' };
+const char RecordMagic[4] = { 'M', 'P', 'D', 'R' };
+const char BlobMagic[4] = { 'M', 'P', 'D', 'B' };
+const std::uint32_t IndexVersion(2);
+
+/** Slots probed from the home slot of a hash.
+ */
+const std::size_t MaxProbe(16);
+
+/** Period of cache directory lock retries.
+ */
+const std::chrono::seconds LockRetry(1);
+
+/** Key hash; zero is reserved for empty slot.
+ */
+std::uint64_t keyHash(const std::string &key)
+{
+    const auto hash(stableHash(key));
+    return hash ? hash : 1;
+}
+
+/** Content hash of a body; zero is reserved for empty slot. Blob records
+ *  tell themselves apart from response records by their magic.
+ */
+std::uint64_t contentHash(const void *data, std::size_t size)
+{
+    const auto hash(stableHash(data, size) ^ 0x9e3779b97f4a7c15ULL);
+    return hash ? hash : 1;
+}
+
+struct RecordHeader {
+    char magic[4];
+    std::uint32_t keySize;
+    std::uint32_t contentTypeSize;
+    std::uint32_t headerCount;
+    std::uint64_t bodySize;
+    std::int64_t lastModified;
+    std::int64_t maxAge;
+    std::int64_t staleWhileRevalidate;
+};
+
+/** Body record, stored once per distinct content.
+ */
+struct BlobHeader {
+    char magic[4];
+    std::uint32_t reserved;
+    std::uint64_t hash;
+    std::uint64_t bodySize;
+};
+
+/** Trailer of a response record in the pack: location of its body.
+ */
+struct BlobRef {
+    std::uint64_t offset;
+    std::uint64_t size;
+};
+
+template <typename T>
+void append(std::string &out, const T &value)
+{
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void append(std::string &out, const std::string &value)
+{
+    append(out, std::uint32_t(value.size()));
+    out.append(value);
+}
+
+/** Sequential reader over record data with bounds checking.
+ */
+class RecordReader {
+public:
+    RecordReader(const std::string &data) : data_(data), pos_() {}
+
+    template <typename T> bool read(T &value) {
+        if ((pos_ + sizeof(T)) > data_.size()) { return false; }
+        std::memcpy(&value, data_.data() + pos_, sizeof(T));
+        pos_ += sizeof(T);
+        return true;
+    }
+
+    bool read(std::string &value, std::size_t size) {
+        if ((pos_ + size) > data_.size()) { return false; }
+        value.assign(data_.data() + pos_, size);
+        pos_ += size;
+        return true;
+    }
+
+    bool read(std::string &value) {
+        std::uint32_t size;
+        return read(size) && read(value, size);
+    }
+
+private:
+    const std::string &data_;
+    std::size_t pos_;
+};
+
+void checkedPwrite(int fd, const char *data, std::size_t size
+                   , std::uint64_t offset)
+{
+    while (size) {
+        const auto written(::pwrite(fd, data, size, offset));
+        if (written < 0) {
+            if (errno == EINTR) { continue; }
+            std::system_error e(errno, std::system_category());
+            LOG(err2) << "Unable to write to disk cache: <"
+                      << e.what() << ">.";
+            throw e;
+        }
+        data += written;
+        size -= written;
+        offset += written;
+    }
+}
+
+bool checkedPread(int fd, char *data, std::size_t size
+                  , std::uint64_t offset)
+{
+    while (size) {
+        const auto got(::pread(fd, data, size, offset));
+        if (got < 0) {
+            if (errno == EINTR) { continue; }
+            return false;
+        }
+        if (!got) { return false; }
+        data += got;
+        size -= got;
+        offset += got;
+    }
+    return true;
+}
+
+std::shared_ptr<ResponseCache::Response>
+parseRecord(const std::string &key, const std::string &data
+            , std::time_t expires)
+{
+    RecordReader r(data);
+    RecordHeader rh;
+    std::string rkey, contentType;
+    auto response(std::make_shared<ResponseCache::Response>());
+    bool ok(r.read(rh)
+            && !std::memcmp(rh.magic, RecordMagic, sizeof(RecordMagic))
+            && r.read(rkey, rh.keySize) && (rkey == key)
+            && r.read(contentType, rh.contentTypeSize));
+
+    for (std::uint32_t i(0); ok && (i < rh.headerCount); ++i) {
+        std::string name, value;
+        ok = r.read(name) && r.read(value);
+        if (ok) { response->stat.headers.emplace_back(name, value); }
+    }
+
+    auto body(std::make_shared<std::string>());
+    if (!ok || !r.read(*body, rh.bodySize)) { return {}; }
+    response->content = body;
+
+    auto &stat(response->stat);
+    stat.contentType = contentType;
+    stat.lastModified = rh.lastModified;
+    stat.cacheControl.maxAge = rh.maxAge;
+    if (rh.staleWhileRevalidate >= 0) {
+        stat.cacheControl.staleWhileRevalidate = rh.staleWhileRevalidate;
+    }
+    const auto ttl(expires - std::time(nullptr));
+    response->expires = (ResponseCache::Clock::now()
+                         + std::chrono::seconds(ttl));
+
+    return response;
+}
+
+} // namespace
+
+struct DiskCache::Header {
+    char magic[4];
+    std::uint32_t version;
+    std::uint64_t slotCount;
+    std::uint64_t packSize;
+    std::uint64_t packLimit;
+
+    /** Size of bodies as referenced by responses and as stored in blobs
+     *  (current generation).
+     */
+    std::uint64_t bodySize;
+    std::uint64_t blobSize;
+};
+
+struct DiskCache::Slot {
+    std::uint64_t hash;
+    std::uint64_t offset;
+    std::uint64_t size;
+    std::int64_t expires;
+};
+
+DiskCache::DiskCache(const Options &options)
+    : options_(options)
+    // one slot per 16 KB of pack (i.e. typical tile size)
+    , slotCount_(std::max<std::size_t>(options.size << 6, 1024))
+    , lockFd_(-1), ready_(false), fd_(-1), running_(true)
+    , hits_(0), misses_(0), stored_(0), dropped_(0), resets_(0)
+    , deduplicated_(0)
+{
+    if (!options_.size) { return; }
+
+    fs::create_directories(options_.path);
+    const auto lockPath(options_.path / "lock");
+    lockFd_ = ::open(lockPath.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (lockFd_ < 0) {
+        std::system_error e(errno, std::system_category());
+        LOG(err2) << "Unable to open disk cache lock " << lockPath
+                  << ": <" << e.what() << ">.";
+        throw e;
+    }
+
+    if (!acquire()) {
+        LOG(info3) << "Disk cache at " << options_.path
+                   << " is used by another instance; running without it"
+                   " until it is released.";
+    }
+
+    // writer opens the cache once it gets the lock
+    writer_ = std::thread(&DiskCache::writer, this);
+}
+
+DiskCache::~DiskCache()
+{
+    if (writer_.joinable()) {
+        {
+            std::unique_lock<std::mutex> lock(queueMutex_);
+            running_ = false;
+        }
+        queueCond_.notify_all();
+        writer_.join();
+    }
+
+    // unmap and close everything before the next owner gets the lock
+    index_ = bi::mapped_region();
+    indexFile_ = bi::file_mapping();
+    if (fd_ >= 0) { ::close(fd_); }
+    if (lockFd_ >= 0) { ::close(lockFd_); }
+}
+
+bool DiskCache::acquire()
+{
+    if (::flock(lockFd_, LOCK_EX | LOCK_NB) == -1) {
+        if (errno != EWOULDBLOCK) {
+            LOG(warn2) << "Unable to lock disk cache " << options_.path
+                       << ": <" << std::strerror(errno) << ">.";
+        }
+        return false;
+    }
+
+    {
+        std::unique_lock<std::shared_timed_mutex> lock(mutex_);
+        open();
+    }
+    ready_ = true;
+    return true;
+}
+
+DiskCache::Header& DiskCache::header()
+{
+    return *static_cast<Header*>(index_.get_address());
+}
+
+DiskCache::Slot* DiskCache::slots()
+{
+    return reinterpret_cast<Slot*>
+        (static_cast<char*>(index_.get_address()) + sizeof(Header));
+}
+
+void DiskCache::open()
+{
+    const auto indexPath(options_.path / "index");
+    const auto packPath(options_.path / "pack");
+    const auto indexSize(sizeof(Header) + slotCount_ * sizeof(Slot));
+    const std::uint64_t packLimit(std::uint64_t(options_.size) << 20);
+
+    bool fresh(false);
+    {
+        boost::system::error_code ec;
+        if (fs::file_size(indexPath, ec) != indexSize) {
+            // missing or of different geometry: start from scratch
+            fs::remove(indexPath, ec);
+            { std::ofstream f(indexPath.string()); }
+            fs::resize_file(indexPath, indexSize);
+            fresh = true;
+        }
+    }
+
+    fd_ = ::open(packPath.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd_ < 0) {
+        std::system_error e(errno, std::system_category());
+        LOG(err2) << "Unable to open disk cache pack " << packPath
+                  << ": <" << e.what() << ">.";
+        throw e;
+    }
+
+    indexFile_ = bi::file_mapping(indexPath.c_str(), bi::read_write);
+    index_ = bi::mapped_region(indexFile_, bi::read_write);
+
+    auto &h(header());
+    const auto packSize(fs::file_size(packPath));
+    if (fresh || std::memcmp(h.magic, IndexMagic, sizeof(IndexMagic))
+        || (h.version != IndexVersion) || (h.slotCount != slotCount_)
+        || (h.packLimit != packLimit) || (h.packSize > packSize))
+    {
+        LOG(info3) << "Initializing disk cache at " << options_.path << ".";
+        std::memcpy(h.magic, IndexMagic, sizeof(IndexMagic));
+        h.version = IndexVersion;
+        h.slotCount = slotCount_;
+        h.packLimit = packLimit;
+        reset();
+        return;
+    }
+
+    LOG(info3) << "Using disk cache at " << options_.path << " ("
+               << (h.packSize >> 20) << " MB used).";
+}
+
+void DiskCache::reset()
+{
+    std::memset(slots(), 0, slotCount_ * sizeof(Slot));
+    header().packSize = 0;
+    header().bodySize = 0;
+    header().blobSize = 0;
+    if (::ftruncate(fd_, 0) == -1) {
+        LOG(warn2) << "Unable to truncate disk cache pack: <"
+                   << std::strerror(errno) << ">.";
+    }
+}
+
+DiskCache::Slot* DiskCache::find(std::uint64_t hash)
+{
+    auto *s(slots());
+    for (std::size_t i(0); i < MaxProbe; ++i) {
+        auto &slot(s[(hash + i) % slotCount_]);
+        if (slot.hash == hash) { return &slot; }
+        if (!slot.hash) { break; }
+    }
+    return nullptr;
+}
+
+DiskCache::Slot* DiskCache::findBlob(const Pending &pending)
+{
+    auto *slot(find(pending.content));
+    if (!slot || (slot->size != (sizeof(BlobHeader) + pending.body.size())))
+    {
+        return nullptr;
+    }
+
+    // compare whole body, the hash alone is not trusted
+    std::string data(slot->size, '\0');
+    if (!checkedPread(fd_, &data[0], data.size(), slot->offset)) {
+        return nullptr;
+    }
+
+    BlobHeader bh;
+    std::memcpy(&bh, data.data(), sizeof(bh));
+    if (std::memcmp(bh.magic, BlobMagic, sizeof(BlobMagic))
+        || (bh.hash != pending.content)
+        || data.compare(sizeof(bh), std::string::npos, pending.body))
+    {
+        return nullptr;
+    }
+    return slot;
+}
+
+void DiskCache::place(std::uint64_t hash, std::uint64_t offset
+                      , std::uint64_t size, std::int64_t expires)
+{
+    // pick first free, same or expired slot; fall back to home slot
+    const auto now(std::time(nullptr));
+    auto *s(slots());
+    auto *target(&s[hash % slotCount_]);
+    for (std::size_t i(0); i < MaxProbe; ++i) {
+        auto &slot(s[(hash + i) % slotCount_]);
+        if (!slot.hash || (slot.hash == hash) || (slot.expires <= now)) {
+            target = &slot;
+            break;
+        }
+    }
+
+    target->hash = hash;
+    target->offset = offset;
+    target->size = size;
+    target->expires = expires;
+}
+
+std::string DiskCache::record(const std::string &key, const void *data
+                              , std::size_t size, const Sink::FileInfo &stat)
+{
+    RecordHeader rh;
+    std::memcpy(rh.magic, RecordMagic, sizeof(RecordMagic));
+    rh.keySize = key.size();
+    rh.contentTypeSize = stat.contentType.size();
+    rh.headerCount = stat.headers.size();
+    rh.bodySize = size;
+    rh.lastModified = stat.lastModified;
+    rh.maxAge = *stat.cacheControl.maxAge;
+    rh.staleWhileRevalidate = (stat.cacheControl.staleWhileRevalidate
+                               ? *stat.cacheControl.staleWhileRevalidate
+                               : -1);
+
+    std::string record;
+    append(record, rh);
+    record.append(key);
+    record.append(stat.contentType);
+    for (const auto &header : stat.headers) {
+        append(record, header.name);
+        append(record, header.value);
+    }
+    record.append(static_cast<const char*>(data), size);
+
+    return record;
+}
+
+ResponseCache::Response::pointer
+DiskCache::parse(const std::string &key, const std::string &data
+                 , std::time_t expires)
+{
+    return parseRecord(key, data, expires);
+}
+
+ResponseCache::Response::pointer DiskCache::get(const std::string &key)
+{
+    if (!ready_) { return {}; }
+
+    const auto now(std::time(nullptr));
+
+    std::string data, blob;
+    std::int64_t expires(0);
+    {
+        std::shared_lock<std::shared_timed_mutex> lock(mutex_);
+        const auto *slot(find(keyHash(key)));
+        if (!slot || (slot->expires <= now)
+            || (slot->size < sizeof(BlobRef)))
+        {
+            ++misses_;
+            return {};
+        }
+
+        expires = slot->expires;
+        data.resize(slot->size);
+        if (!checkedPread(fd_, &data[0], data.size(), slot->offset)) {
+            ++misses_;
+            return {};
+        }
+
+        // body lives in its blob record
+        BlobRef ref;
+        std::memcpy(&ref, data.data() + data.size() - sizeof(ref)
+                    , sizeof(ref));
+        data.resize(data.size() - sizeof(ref));
+        if ((ref.size < sizeof(BlobHeader))
+            || ((ref.offset + ref.size) > header().packSize))
+        {
+            ++misses_;
+            return {};
+        }
+
+        blob.resize(ref.size);
+        if (!checkedPread(fd_, &blob[0], blob.size(), ref.offset)) {
+            ++misses_;
+            return {};
+        }
+    }
+
+    BlobHeader bh;
+    std::memcpy(&bh, blob.data(), sizeof(bh));
+    auto response(parseRecord(key, data, expires));
+    if (!response || std::memcmp(bh.magic, BlobMagic, sizeof(BlobMagic))
+        || ((sizeof(bh) + bh.bodySize) != blob.size()))
+    {
+        // hash collision or torn record
+        ++misses_;
+        return {};
+    }
+
+    response->content = std::make_shared<std::string>(blob, sizeof(bh));
+
+    ++hits_;
+    return response;
+}
+
+void DiskCache::put(const std::string &key, const void *data
+                    , std::size_t size, const Sink::FileInfo &stat)
+{
+    if (!ready_) { return; }
+
+    const auto &maxAge(stat.cacheControl.maxAge);
+    if (!maxAge || (*maxAge <= 0)) { return; }
+
+    Pending pending;
+    pending.key = key;
+    pending.hash = keyHash(key);
+    pending.content = contentHash(data, size);
+    pending.expires = std::time(nullptr) + *maxAge;
+    pending.record = record(key, "", 0, stat);
+    pending.body.assign(static_cast<const char*>(data), size);
+
+    {
+        std::unique_lock<std::mutex> lock(queueMutex_);
+        if (queue_.size() >= options_.queueLimit) {
+            ++dropped_;
+            return;
+        }
+        queue_.push_back(std::move(pending));
+    }
+    queueCond_.notify_one();
+}
+
+void DiskCache::writer()
+{
+    dbglog::thread_id("diskcache");
+
+    std::unique_lock<std::mutex> lock(queueMutex_);
+    while (!ready_) {
+        // cache directory owned by another instance, retry until released
+        if (queueCond_.wait_for(lock, LockRetry, [this]() {
+                    return !running_; }))
+        {
+            return;
+        }
+
+        lock.unlock();
+        try {
+            if (acquire()) {
+                LOG(info3) << "Disk cache at " << options_.path
+                           << " released by other instance, using it.";
+            }
+        } catch (const std::exception &e) {
+            LOG(err2) << "Unable to open disk cache: <" << e.what()
+                      << ">; running without it.";
+            ::flock(lockFd_, LOCK_UN);
+            return;
+        }
+        lock.lock();
+    }
+
+    for (;;) {
+        queueCond_.wait(lock, [this]()
+        {
+            return !running_ || !queue_.empty();
+        });
+        if (queue_.empty()) { return; }
+
+        auto pending(std::move(queue_.front()));
+        queue_.pop_front();
+
+        lock.unlock();
+        try {
+            write(pending);
+        } catch (const std::exception &e) {
+            LOG(err2) << "Disk cache write failed: <" << e.what() << ">.";
+        }
+        lock.lock();
+    }
+}
+
+void DiskCache::write(const Pending &pending)
+{
+    std::unique_lock<std::shared_timed_mutex> lock(mutex_);
+
+    auto &h(header());
+    const std::uint64_t blobSize(sizeof(BlobHeader) + pending.body.size());
+    const std::uint64_t recordSize(pending.record.size() + sizeof(BlobRef));
+
+    // reuse body of the same content if already stored
+    auto *blob(findBlob(pending));
+    if ((h.packSize + recordSize + (blob ? 0 : blobSize)) > h.packLimit) {
+        if ((recordSize + blobSize) > h.packLimit) { return; }
+        LOG(info2) << "Disk cache is full, starting over.";
+        reset();
+        ++resets_;
+        blob = nullptr;
+    }
+
+    BlobRef ref;
+    if (blob) {
+        // blob must stay findable as long as any of its users
+        blob->expires = std::max(blob->expires, pending.expires);
+        ref.offset = blob->offset;
+        ref.size = blob->size;
+        ++deduplicated_;
+    } else {
+        BlobHeader bh;
+        std::memcpy(bh.magic, BlobMagic, sizeof(BlobMagic));
+        bh.reserved = 0;
+        bh.hash = pending.content;
+        bh.bodySize = pending.body.size();
+
+        std::string data;
+        data.reserve(blobSize);
+        append(data, bh);
+        data.append(pending.body);
+
+        ref.offset = h.packSize;
+        ref.size = blobSize;
+        checkedPwrite(fd_, data.data(), data.size(), ref.offset);
+        place(pending.content, ref.offset, ref.size, pending.expires);
+        h.packSize = ref.offset + ref.size;
+        h.blobSize += pending.body.size();
+    }
+
+    auto record(pending.record);
+    append(record, ref);
+
+    const auto offset(h.packSize);
+    checkedPwrite(fd_, record.data(), record.size(), offset);
+    place(pending.hash, offset, record.size(), pending.expires);
+    h.packSize = offset + record.size();
+    h.bodySize += pending.body.size();
+    ++stored_;
+}
+
+void DiskCache::stat(std::ostream &os, const std::string &prefix) const
+{
+    std::uint64_t used(0), bodySize(0), blobSize(0);
+    if (ready_) {
+        std::shared_lock<std::shared_timed_mutex> lock(mutex_);
+        const auto &h(*static_cast<const Header*>(index_.get_address()));
+        used = h.packSize;
+        bodySize = h.bodySize;
+        blobSize = h.blobSize;
+    }
+
+    os << prefix << "ready=" << ready_ << '\n'
+       << prefix << "hits=" << hits_ << '\n'
+       << prefix << "misses=" << misses_ << '\n'
+       << prefix << "stored=" << stored_ << '\n'
+       << prefix << "dropped=" << dropped_ << '\n'
+       << prefix << "resets=" << resets_ << '\n'
+       << prefix << "size=" << used << '\n'
+       << prefix << "deduplicated=" << deduplicated_ << '\n'
+       << prefix << "logicalSize=" << bodySize << '\n'
+       << prefix << "blobSize=" << blobSize << '\n'
+       << prefix << "dedupRatio="
+       << (blobSize ? (double(bodySize) / blobSize) : 1.0) << '\n';
+}
+
+void DiskCache::metrics(metrics::Writer &writer
+                        , const std::string &prefix) const
+{
+    writer.counter(prefix + "hits", "Responses served from disk cache."
+                   , hits_);
+    writer.counter(prefix + "misses", "Responses not found in disk cache."
+                   , misses_);
+    writer.counter(prefix + "stored", "Responses written to disk cache."
+                   , stored_);
+    writer.counter(prefix + "dropped"
+                   , "Responses not written due to full write queue."
+                   , dropped_);
+    writer.counter(prefix + "resets", "Disk cache resets.", resets_);
+    writer.counter(prefix + "deduplicated"
+                   , "Responses written sharing already stored body."
+                   , deduplicated_);
+}
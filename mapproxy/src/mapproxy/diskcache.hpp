@@ -0,0 +1,197 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef mapproxy_diskcache_hpp_included_
+#define mapproxy_diskcache_hpp_included_
+
+#include <ctime>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <string>
+#include <ostream>
+#include <shared_mutex>
+#include <condition_variable>
+
+#include <boost/filesystem/path.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include "responsecache.hpp"
+
+/** Persistent cache of generated responses on local disk.
+ *
+ *  Responses are appended to a pack file, a memory mapped open-addressing
+ *  hash table maps key hashes to pack records. Records carry their keys,
+ *  hash collisions are detected on read. Once the pack is full the whole
+ *  cache starts over (i.e. old generation is dropped at once).
+ *
+ *  Bodies are content-addressed: each body is stored once as a blob record
+ *  indexed by its content hash and response records refer to it by
+ *  offset. Since the pack is only ever dropped as a whole, blobs need no
+ *  reference counting.
+ *
+ *  Writes are asynchronous (in a background thread), pending writes over the
+ *  queue limit are dropped.
+ *
+ *  Index and pack are guarded by in-process locks only, therefore the cache
+ *  directory is owned by single process: it holds exclusive flock on the
+ *  directory's lock file. An instance started while another one still owns
+ *  the directory (e.g. during overlapping restart) runs without disk cache
+ *  and opens it once the other instance releases it.
+ */
+class DiskCache {
+public:
+    struct Options {
+        /** Cache directory.
+         */
+        boost::filesystem::path path;
+
+        /** Size of the pack file (in MB, 0 = cache disabled).
+         */
+        std::size_t size;
+
+        /** Maximum number of pending writes.
+         */
+        std::size_t queueLimit;
+
+        Options() : size(0), queueLimit(256) {}
+    };
+
+    DiskCache(const Options &options);
+    ~DiskCache();
+
+    /** Disk cache is configured. It may still be waiting for the cache
+     *  directory being released by another instance (see ready()).
+     */
+    bool enabled() const { return options_.size; }
+
+    /** Disk cache is open, i.e. this instance owns the cache directory.
+     */
+    bool ready() const { return ready_; }
+
+    /** Returns cached response or null pointer if not found (or expired).
+     */
+    ResponseCache::Response::pointer get(const std::string &key);
+
+    /** Schedules response to be stored. Responses without positive max-age
+     *  are not stored.
+     */
+    void put(const std::string &key, const void *data, std::size_t size
+             , const Sink::FileInfo &stat);
+
+    /** Serializes response into a self-contained record (key included).
+     *  Response must have positive max-age.
+     */
+    static std::string record(const std::string &key, const void *data
+                              , std::size_t size
+                              , const Sink::FileInfo &stat);
+
+    /** Parses record made by record(). Returns null pointer if it is
+     *  malformed or belongs to another key. Response expires at given time.
+     */
+    static ResponseCache::Response::pointer
+    parse(const std::string &key, const std::string &record
+          , std::time_t expires);
+
+    void stat(std::ostream &os, const std::string &prefix) const;
+
+    /** Writes lock-free counters, metric names start with given prefix.
+     */
+    void metrics(metrics::Writer &writer, const std::string &prefix) const;
+
+    struct Header;
+    struct Slot;
+
+private:
+    struct Pending {
+        std::string key;
+        std::string record;
+        std::string body;
+        std::uint64_t hash;
+        std::uint64_t content;
+        std::int64_t expires;
+    };
+
+    /** Tries to lock cache directory (without waiting), opens the cache
+     *  once locked. Returns ready().
+     */
+    bool acquire();
+
+    void open();
+    void reset();
+    void writer();
+    void write(const Pending &pending);
+
+    Header& header();
+    Slot* slots();
+
+    /** Finds slot holding given hash or null.
+     */
+    Slot* find(std::uint64_t hash);
+
+    /** Finds blob record holding given body or null.
+     */
+    Slot* findBlob(const Pending &pending);
+
+    /** Points slot of given hash to pack record.
+     */
+    void place(std::uint64_t hash, std::uint64_t offset, std::uint64_t size
+               , std::int64_t expires);
+
+    Options options_;
+    std::size_t slotCount_;
+
+    /** Lock file, held locked while the cache is open.
+     */
+    int lockFd_;
+    std::atomic<bool> ready_;
+
+    int fd_;
+    boost::interprocess::file_mapping indexFile_;
+    boost::interprocess::mapped_region index_;
+
+    /** Guards index and pack; exclusive for writes and resets, shared for
+     *  reads.
+     */
+    mutable std::shared_timed_mutex mutex_;
+
+    std::mutex queueMutex_;
+    std::condition_variable queueCond_;
+    std::deque<Pending> queue_;
+    bool running_;
+    std::thread writer_;
+
+    std::atomic<std::uint64_t> hits_;
+    std::atomic<std::uint64_t> misses_;
+    std::atomic<std::uint64_t> stored_;
+    std::atomic<std::uint64_t> dropped_;
+    std::atomic<std::uint64_t> resets_;
+    std::atomic<std::uint64_t> deduplicated_;
+};
+
+#endif // mapproxy_diskcache_hpp_included_
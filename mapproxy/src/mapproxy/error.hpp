@@ -28,8 +28,11 @@
 #define mapproxy_error_hpp_included_
 
 #include <stdexcept>
+#include <exception>
 #include <string>
 
+#include "utility/errorcode.hpp"
+
 #include "http/error.hpp"
 
 struct Error : std::runtime_error {
@@ -83,5 +86,38 @@ typedef http::ServiceUnavailable Unavailable;
 typedef http::InternalServerError InternalError;
 typedef http::RequestAborted RequestAborted;
 typedef http::BadRequest BadRequest;
+typedef http::NotModified NotModified;
+
+/** Request has not been answered before its deadline (504).
+ */
+struct DeadlineExceeded : utility::HttpError {
+    DeadlineExceeded(const std::string &message)
+        : utility::HttpError
+          (make_error_code(utility::HttpCode::GatewayTimeout), message)
+    {}
+};
+
+/** HTTP status code of response to given error.
+ */
+inline int httpStatus(const std::exception_ptr &exc)
+{
+    try {
+        std::rethrow_exception(exc);
+    } catch (const NotModified&) {
+        return 304;
+    } catch (const BadRequest&) {
+        return 400;
+    } catch (const NotFound&) {
+        return 404;
+    } catch (const RequestAborted&) {
+        // client closed request (nginx convention)
+        return 499;
+    } catch (const Unavailable&) {
+        return 503;
+    } catch (const DeadlineExceeded&) {
+        return 504;
+    } catch (...) {}
+    return 500;
+}
 
 #endif // mapproxy_error_hpp_included_
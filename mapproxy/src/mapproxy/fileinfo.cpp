@@ -25,9 +25,7 @@
  */
 
 #include <boost/lexical_cast.hpp>
-#include <boost/algorithm/string/split.hpp>
-#include <boost/algorithm/string/classification.hpp>
-#include <boost/range/iterator.hpp>
+#include <boost/algorithm/string/predicate.hpp>
 
 #include "utility/streams.hpp"
 
@@ -42,6 +40,8 @@
 #include "browser2d.hpp"
 #include "cesium.hpp"
 #include "ol.hpp"
+#include "support/precompressed.hpp"
+#include "support/urlparse.hpp"
 
 namespace ba = boost::algorithm;
 namespace vr = vtslibs::registry;
@@ -51,6 +51,8 @@ namespace constants {
     const std::string BoundLayerDefinition("boundlayer.json");
     const std::string FreeLayerDefinition("freelayer.json");
     const std::string DebugConfig("debug.json");
+    const std::string MeshExtension(".bin");
+    const std::string CompressedMeshExtension(".cmesh");
     const std::string Self("");
     const std::string Index("index.html");
     const std::string Browser("browser.html");
@@ -71,11 +73,15 @@ namespace constants {
     const std::string WmtsCapabilities("WMTSCapabilities.xml");
 
     const std::string DisableBrowserHeader("X-Mapproxy-Disable-Browser");
+    const std::string IfNoneMatchHeader("If-None-Match");
+    const std::string AcceptEncodingHeader("Accept-Encoding");
+    const std::string AcceptHeader("Accept");
 
     const char *applicationJson("application/json; charset=utf-8");
     const char *textHtml("text/html; charset=utf-8");
     const char *textXml("text/xml; charset=utf-8");
     const char *quantizedMesh("application/vnd.quantized-mesh");
+    const char *compressedMesh("application/x-mapproxy-compressed-mesh");
 } // namesapce constants
 
 namespace {
@@ -100,8 +106,39 @@ void asEnumChecked(const std::string &str, E &value, const std::string message)
     }
 }
 
-const std::string& checkReferenceFrame(const std::string &referenceFrame)
+/** Interface lookup: precompiled table first, lexical cast as a fallback.
+ */
+void parseInterface(std::string_view str, GeneratorInterface &value)
+{
+    if (urlparse::generatorInterface(str, value)) { return; }
+    asEnumChecked<GeneratorInterface, NotFound>
+        (urlparse::asString(str), value, "Unknown generator interface.");
+}
+
+/** Raster format lookup: precompiled table first, lexical cast as a
+ *  fallback.
+ */
+void parseRasterFormat(std::string_view ext, RasterFormat &value)
 {
+    if (urlparse::rasterFormat(ext, value)) { return; }
+    asEnumChecked<RasterFormat, NotFound>
+        (urlparse::asString(ext), value, "raster format");
+}
+
+/** Tile id prefix: fast parser first, vts parser as a fallback. Returns
+ *  extension.
+ */
+const char* parseTileIdPrefix(vts::TileId &tileId, const std::string &filename)
+{
+    if (const auto *p = urlparse::parseTileIdPrefix(tileId, filename)) {
+        return p;
+    }
+    return vts::parseTileIdPrefix(tileId, filename);
+}
+
+std::string checkReferenceFrame(std::string_view rf)
+{
+    std::string referenceFrame(urlparse::asString(rf));
     if (vr::system.referenceFrames(referenceFrame, std::nothrow)) {
         return referenceFrame;
     }
@@ -115,7 +152,8 @@ const std::string& checkReferenceFrame(const std::string &referenceFrame)
 
 FileInfo::FileInfo(const http::Request &request, int f)
     : url(request.uri), path(request.path), query(request.query)
-    , flags(f), type(Type::resourceFile)
+    , flags(f), type(Type::resourceFile), acceptGzip(false), acceptImage()
+    , forwarded(false)
 {
     if (flags & FileFlags::browserEnabled) {
         // browsing enabled, check for disable header
@@ -124,16 +162,29 @@ FileInfo::FileInfo(const http::Request &request, int f)
         }
     }
 
-    auto end(path.end());
-
-    std::vector<std::string> components;
-    {
-        auto range(boost::make_iterator_range(path.begin(), end));
-        ba::split(components, range, ba::is_any_of("/")
-                  , ba::token_compress_on);
+    for (const auto &header : request.headers) {
+        if (ba::iequals(header.name, constants::IfNoneMatchHeader)) {
+            if (!ifNoneMatch.empty()) { ifNoneMatch += ", "; }
+            ifNoneMatch += header.value;
+        } else if (ba::iequals(header.name, constants::AcceptEncodingHeader)
+                   && ba::icontains(header.value, "gzip"))
+        {
+            acceptGzip = true;
+        } else if (ba::iequals(header.name, constants::AcceptHeader)) {
+            for (const auto format : { RasterFormat::webp, RasterFormat::avif
+                                       , RasterFormat::jxl })
+            {
+                if (ba::icontains(header.value, contentType(format))) {
+                    acceptImage |= (1u << static_cast<int>(format));
+                }
+            }
+        }
     }
 
-    switch (components.size() - 1) {
+    // views into path, no allocation
+    const auto components(urlparse::split(path));
+
+    switch (components.size - 1) {
     case 1:
         filename = components[1];
 
@@ -173,8 +224,7 @@ FileInfo::FileInfo(const http::Request &request, int f)
     case 3:
         // only reference frame -> allow only map config
         resourceId.referenceFrame = checkReferenceFrame(components[1]);
-        asEnumChecked<GeneratorInterface, NotFound>
-            (components[2], interface, "Unknown generator interface.");
+        parseInterface(components[2], interface);
         filename = components[3];
 
         if (filename == constants::Index) {
@@ -194,8 +244,7 @@ FileInfo::FileInfo(const http::Request &request, int f)
     case 4:
         // only reference frame -> allow only map config
         resourceId.referenceFrame = checkReferenceFrame(components[1]);
-        asEnumChecked<GeneratorInterface, NotFound>
-            (components[2], interface, "Unknown generator interface.");
+        parseInterface(components[2], interface);
         resourceId.group = components[3];
         filename = components[4];
 
@@ -216,18 +265,17 @@ FileInfo::FileInfo(const http::Request &request, int f)
     case 5:
         // full resource file path
         resourceId.referenceFrame = checkReferenceFrame(components[1]);
-        asEnumChecked<GeneratorInterface, NotFound>
-            (components[2], interface, "Unknown generator interface.");
+        parseInterface(components[2], interface);
         resourceId.group = components[3];
         resourceId.id = components[4];
         filename = components[5];
         return;
 
     default:
-        if (components.size() != 6) {
+        if (components.size != 6) {
             LOGTHROW(err1, NotFound)
                 << "URL <" << url << "> not found: invalid number "
-                "of path components (" << components.size() << ").";
+                "of path components (" << components.size << ").";
         }
     }
 
@@ -236,8 +284,8 @@ FileInfo::FileInfo(const http::Request &request, int f)
 TmsFileInfo::TmsFileInfo(const FileInfo &fi)
     : fileInfo(fi), type(Type::unknown), format(), support()
 {
-    if (const auto *p = vts::parseTileIdPrefix(tileId, fi.filename)) {
-        const std::string ext(p);
+    if (const auto *p = parseTileIdPrefix(tileId, fi.filename)) {
+        const std::string_view ext(p);
         if (ext == "mask") {
             // mask file
             type = Type::mask;
@@ -250,7 +298,7 @@ TmsFileInfo::TmsFileInfo(const FileInfo &fi)
 
         // another file -> parse as format
         type = Type::image;
-        asEnumChecked<RasterFormat, NotFound>(ext, format, "raster format");
+        parseRasterFormat(ext, format);
         return;
     }
 
@@ -316,12 +364,33 @@ Sink::FileInfo TmsFileInfo::sinkFileInfo(std::time_t lastModified) const
     return {};
 }
 
+const std::string SurfaceFileInfo::CompressedMeshUrl
+    ("{lod}-{x}-{y}" + constants::CompressedMeshExtension);
+
 SurfaceFileInfo::SurfaceFileInfo(const FileInfo &fi)
     : fileInfo(fi), type(Type::unknown), fileType(vs::File::config)
     , tileType(vts::TileFile::meta), subTileIndex()
-    , flavor(vts::FileFlavor::regular)
+    , flavor(vts::FileFlavor::regular), compressedMesh(false)
     , support(), registry(), serviceFile()
 {
+    if (ba::ends_with(fi.filename, constants::CompressedMeshExtension)) {
+        // compressed mesh: parse as regular mesh
+        const auto filename
+            (fi.filename.substr(0, fi.filename.size()
+                                - constants::CompressedMeshExtension.size())
+             + constants::MeshExtension);
+
+        if (vts::fromFilename
+            (tileId, tileType, subTileIndex, filename, 0, &flavor)
+            && (tileType == vts::TileFile::mesh)
+            && (flavor == vts::FileFlavor::regular))
+        {
+            type = Type::tile;
+            compressedMesh = true;
+        }
+        return;
+    }
+
     if (vts::fromFilename
         (tileId, tileType, subTileIndex, fi.filename, 0, &flavor))
     {
@@ -426,6 +495,10 @@ Sink::FileInfo SurfaceFileInfo::sinkFileInfo(std::time_t lastModified) const
             .setFileClass(FileClass::config);
 
     case Type::tile:
+        if (compressedMesh) {
+            return Sink::FileInfo(constants::compressedMesh, lastModified)
+                .setFileClass(FileClass::data);
+        }
         return Sink::FileInfo(contentType(tileType, flavor), lastModified)
             .setFileClass(FileClass::data);
 
@@ -458,8 +531,8 @@ GeodataFileInfo::GeodataFileInfo(const FileInfo &fi, bool tiled
     , format(format)
 {
     if (tiled) {
-        if (const auto *p = vts::parseTileIdPrefix(tileId, fi.filename)) {
-            std::string ext(p);
+        if (const auto *p = parseTileIdPrefix(tileId, fi.filename)) {
+            const std::string_view ext(p);
             if (ext == "geo") {
                 // mask file
                 type = Type::geo;
@@ -560,8 +633,8 @@ Sink::FileInfo GeodataFileInfo::sinkFileInfo(std::time_t lastModified) const
 TerrainFileInfo::TerrainFileInfo(const FileInfo &fi)
     : fileInfo(fi), type(Type::unknown), support()
 {
-    if (const auto *p = vts::parseTileIdPrefix(tileId, fi.filename)) {
-        const std::string ext(p);
+    if (const auto *p = parseTileIdPrefix(tileId, fi.filename)) {
+        const std::string_view ext(p);
         if (ext == "terrain") {
             type = Type::tile;
             return;
@@ -640,11 +713,11 @@ const Sink::Listing TerrainFileInfo::listing {
 WmtsFileInfo::WmtsFileInfo(const FileInfo &fi)
     : fileInfo(fi), type(Type::unknown), format(), support()
 {
-    if (const auto *p = vts::parseTileIdPrefix(tileId, fi.filename)) {
-        const std::string ext(p);
+    if (const auto *p = parseTileIdPrefix(tileId, fi.filename)) {
+        const std::string_view ext(p);
         // parse as format
         type = Type::image;
-        asEnumChecked<RasterFormat, NotFound>(ext, format, "raster format");
+        parseRasterFormat(ext, format);
         return;
     }
 
@@ -712,3 +785,11 @@ const Sink::Listing WmtsFileInfo::listing {
     , { constants::WmtsCapabilities }
     , { constants::README }
 };
+
+void precompressSupportFiles()
+{
+    precompressed::prepare(vts::supportFiles);
+    precompressed::prepare(browser2d::supportFiles);
+    precompressed::prepare(cesium::supportFiles);
+    precompressed::prepare(ol::supportFiles);
+}
@@ -93,6 +93,27 @@ struct FileInfo {
      *  Valid only if type == Type::resourceFile.
      */
     std::string filename;
+
+    /** Entity tags from If-None-Match request header(s), unparsed.
+     */
+    std::string ifNoneMatch;
+
+    /** Client accepts gzip content encoding.
+     */
+    bool acceptGzip;
+
+    /** Optional image formats listed in the Accept header, bit mask of
+     *  (1 << RasterFormat).
+     */
+    unsigned int acceptImage;
+
+    bool accepts(RasterFormat format) const {
+        return acceptImage & (1u << static_cast<int>(format));
+    }
+
+    /** Request forwarded by a cluster peer, never forwarded again.
+     */
+    bool forwarded;
 };
 
 /** Parsed TMS file information.
@@ -166,6 +187,12 @@ struct SurfaceFileInfo {
      */
     vts::FileFlavor flavor;
 
+    /** Mapproxy specific mesh flavor: compressed mesh (see
+     *  support/meshcompress.hpp). Valid only when type == Type::tile and
+     *  tileType == vts::TileFile::mesh.
+     */
+    bool compressedMesh;
+
     /** Valid only when type == Type::support
      */
     const vs::SupportFile *support;
@@ -177,6 +204,10 @@ struct SurfaceFileInfo {
     /** Valid only when type == Type::service
      */
     unsigned int serviceFile;
+
+    /** URL template of compressed mesh, relative to surface root.
+     */
+    static const std::string CompressedMeshUrl;
 };
 
 /** Parsed surface file information.
@@ -279,4 +310,9 @@ struct WmtsFileInfo {
     static const Sink::Listing listing;
 };
 
+/** Prepares gzipped variants of all built-in support files looked up here.
+ *  Called once at startup.
+ */
+void precompressSupportFiles();
+
 #endif // mapproxy_fileinfo_hpp_included_
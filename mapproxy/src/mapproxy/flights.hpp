@@ -0,0 +1,153 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef mapproxy_flights_hpp_included_
+#define mapproxy_flights_hpp_included_
+
+#include <mutex>
+#include <memory>
+#include <string>
+#include <vector>
+#include <utility>
+#include <unordered_map>
+
+#include <boost/noncopyable.hpp>
+
+/** Identical requests in flight, keyed by cache key: the first request
+ *  leads the flight, the later ones join it as waiters. Once the leader
+ *  lands, waiters are answered with leader's response (if captured) or are
+ *  on their own.
+ */
+template <typename Waiter, typename Response, typename Context>
+class Flights : boost::noncopyable {
+public:
+    struct Flight {
+        std::string key;
+
+        /** What is needed to answer waiters left without response.
+         */
+        Context context;
+
+        std::vector<Waiter> waiters;
+
+        /** Leader's response, captured only if there are waiters.
+         */
+        Response response;
+
+        Flight(const std::string &key, const Context &context)
+            : key(key), context(context), response() {}
+    };
+
+    typedef std::shared_ptr<Flight> pointer;
+
+    /** Makes caller leader of a new flight (returned) or adds waiter to the
+     *  flight of given key in progress (returns null).
+     */
+    pointer join(const std::string &key, const Context &context
+                 , const Waiter &waiter);
+
+    /** Tells whether anybody waits for leader of given flight.
+     */
+    bool awaited(const pointer &flight) const;
+
+    /** Captures leader's response to be shared with waiters.
+     */
+    void respond(const pointer &flight, const Response &response);
+
+    /** Lands flight: forgets it (same key takes off anew) and returns its
+     *  waiters with leader's response. Landing again returns no waiters.
+     */
+    std::pair<std::vector<Waiter>, Response> land(const pointer &flight);
+
+    /** Number of flights.
+     */
+    std::size_t size() const;
+
+private:
+    mutable std::mutex lock_;
+    std::unordered_map<std::string, pointer> flights_;
+};
+
+// inlines
+
+template <typename Waiter, typename Response, typename Context>
+typename Flights<Waiter, Response, Context>::pointer
+Flights<Waiter, Response, Context>::join(const std::string &key
+                                         , const Context &context
+                                         , const Waiter &waiter)
+{
+    auto flight(std::make_shared<Flight>(key, context));
+
+    std::unique_lock<std::mutex> lock(lock_);
+    const auto res(flights_.emplace(key, flight));
+    if (res.second) { return flight; }
+
+    // answered by the leader
+    res.first->second->waiters.push_back(waiter);
+    return {};
+}
+
+template <typename Waiter, typename Response, typename Context>
+bool Flights<Waiter, Response, Context>::awaited(const pointer &flight)
+    const
+{
+    std::unique_lock<std::mutex> lock(lock_);
+    return !flight->waiters.empty();
+}
+
+template <typename Waiter, typename Response, typename Context>
+void Flights<Waiter, Response, Context>::respond(const pointer &flight
+                                                 , const Response &response)
+{
+    std::unique_lock<std::mutex> lock(lock_);
+    flight->response = response;
+}
+
+template <typename Waiter, typename Response, typename Context>
+std::pair<std::vector<Waiter>, Response>
+Flights<Waiter, Response, Context>::land(const pointer &flight)
+{
+    std::pair<std::vector<Waiter>, Response> landed;
+
+    std::unique_lock<std::mutex> lock(lock_);
+    // flight of the same key might have taken off after this one landed
+    const auto fflights(flights_.find(flight->key));
+    if ((fflights != flights_.end()) && (fflights->second == flight)) {
+        flights_.erase(fflights);
+    }
+    std::swap(landed.first, flight->waiters);
+    landed.second = flight->response;
+    return landed;
+}
+
+template <typename Waiter, typename Response, typename Context>
+std::size_t Flights<Waiter, Response, Context>::size() const
+{
+    std::unique_lock<std::mutex> lock(lock_);
+    return flights_.size();
+}
+
+#endif // mapproxy_flights_hpp_included_
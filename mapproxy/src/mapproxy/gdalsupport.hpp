@@ -27,8 +27,14 @@
 #ifndef mapproxy_gdalsupport_hpp_included_
 #define mapproxy_gdalsupport_hpp_included_
 
+#include <array>
 #include <memory>
 #include <chrono>
+#include <exception>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
 
 #include <boost/optional.hpp>
 #include <boost/filesystem/path.hpp>
@@ -36,6 +42,7 @@
 #include <opencv2/core/core.hpp>
 
 #include "utility/runnable.hpp"
+#include "utility/enum-io.hpp"
 
 #include "geo/srsdef.hpp"
 #include "geo/geodataset.hpp"
@@ -47,20 +54,246 @@
 #include "support/geo.hpp"
 #include "support/layerenancer.hpp"
 #include "support/aborter.hpp"
+#include "support/metrics.hpp"
+#include "support/profiler.hpp"
+#include "support/sharedcache.hpp"
 
 #include "gdalsupport/workrequestfwd.hpp"
+#include "gdalsupport/demprocessing.hpp"
+#include "gdalsupport/autoscaler.hpp"
+#include "gdalsupport/rangecache.hpp"
+#include "gdalsupport/uringio.hpp"
 
 class GdalWarper {
 public:
+    /** Request priority classes (queue lanes), from the most important one:
+     *  * tile: metatiles and navtiles
+     *  * mesh: meshes, normal maps and geodata
+     *  * imagery: bound layer imagery
+     *  * mask: masks and debug output
+     *  * background: speculative work (e.g. prefetch), served only when
+     *    no other lane has anything to do
+     */
+    enum class Priority { tile, mesh, imagery, mask, background };
+
+    static constexpr std::size_t PriorityCount = 5;
+
+    /** Warper backends:
+     *  * process: requests are processed by forked GDAL processes talking to
+     *             the main process via shared memory
+     *  * threads: requests are processed by threads of the main process,
+     *             each with its own dataset cache
+     */
+    enum class Backend { process, threads };
+
     struct Options {
+        Backend backend;
+
+        /** Number of GDAL processes (or threads when using threads backend).
+         *  Initial number of processes when autoscaling.
+         */
         unsigned int processCount;
+
+        /** Sizing of process pool by load (process backend only).
+         */
+        Autoscaler::Options autoscale;
         boost::filesystem::path tmpRoot;
         std::size_t rssCheckPeriod;
         std::size_t rssLimit;
 
+        /** Route requests to workers that have already opened the same
+         *  dataset.
+         */
+        bool affinity;
+
+        /** Time (in milliseconds) after which an idle worker steals a queued
+         *  request bound to another worker.
+         */
+        std::size_t affinityStealDelay;
+
+        /** Maximum number of datasets kept open by single GDAL process
+         *  (0 = unlimited, the default: datasets stay open as before).
+         */
+        std::size_t datasetCacheLimit;
+
+        /** Private memory budget (in MB) of single GDAL process. Least
+         *  recently used datasets are closed when exceeded (0 = unlimited).
+         */
+        std::size_t datasetCacheMemoryLimit;
+
+        /** Maximum number of vector datasets (heightcoding sources) kept open
+         *  by single GDAL process (0 = vector datasets are not cached).
+         */
+        std::size_t vectorDatasetCacheLimit;
+
+        /** Identical concurrent raster requests are served by single warp.
+         */
+        bool coalesce;
+
+        /** Weights of priority lanes (indexed by Priority). Lanes are served
+         *  by weighted round-robin, weight must be at least 1. Background
+         *  lane does not take part in the round-robin, its weight is
+         *  ignored.
+         */
+        std::array<unsigned int, PriorityCount> priorityWeights;
+
+        /** Queued requests waiting longer than this (in seconds) are dropped
+         *  since their clients have most probably given up (0 = never).
+         */
+        std::size_t queueMaxAge;
+
+        /** Total size of shared memory (in MB).
+         */
+        std::size_t shmSize;
+
+        /** Part of shared memory (in MB) reserved for request bookkeeping;
+         *  the rest holds response data (rasters, heightcoded geodata).
+         */
+        std::size_t shmControlSize;
+
+        /** Free response memory (in MB) required to accept new request.
+         *  Must be smaller than the data arena (shmSize - shmControlSize).
+         */
+        std::size_t shmReserve;
+
+        /** How long (in milliseconds) new request waits for free response
+         *  memory before being rejected with 503.
+         */
+        std::size_t shmWait;
+
+        /** Back shared memory by explicitly reserved hugepages (see
+         *  vm.nr_hugepages); regular pages are used if none are available.
+         */
+        bool shmHugepages;
+
+        /** Fault in all shared memory pages at startup.
+         */
+        bool shmPrefault;
+
+        /** Number of most used datasets opened by freshly spawned GDAL
+         *  process before it starts taking requests (0 = no pre-warming).
+         */
+        std::size_t prewarmDatasets;
+
+        /** Time budget (in milliseconds) of the pre-warm step.
+         */
+        std::size_t prewarmBudget;
+
+        /** GDAL process over the memory limit is drained (finishes its
+         *  current request and exits while its replacement is already
+         *  running) instead of being terminated.
+         */
+        bool recycleGraceful;
+
+        /** Time (in seconds) after which a draining GDAL process is
+         *  terminated anyway.
+         */
+        std::size_t recycleTimeout;
+
+        /** GDAL process is recycled after processing this number of requests
+         *  (0 = never).
+         */
+        std::size_t recycleRequests;
+
+        /** Semicolon-separated CPU sets in Linux cpulist format (e.g.
+         *  "0-7,16-23;8-15,24-31"). Workers are pinned to them round-robin
+         *  as they are spawned. Empty means no pinning.
+         */
+        std::string cpuSets;
+
+        /** Pin workers round-robin to NUMA nodes: to node's CPUs and to
+         *  node's memory (preferred). Overrides cpuSets.
+         */
+        bool numaPinning;
+
+        /** GDAL_NUM_THREADS of each worker (0 = GDAL default).
+         */
+        unsigned int gdalThreads;
+
+        /** Size of GDAL block cache of each worker in MB (0 = GDAL
+         *  default).
+         */
+        std::size_t gdalCacheMax;
+
+        /** Share of GDAL block cache single dataset can occupy in each
+         *  worker in MB; dataset over its share is closed between requests
+         *  (0 = no quota).
+         */
+        std::size_t datasetBlockQuota;
+
+        /** Maximum number of workers processing requests for single dataset
+         *  at once; requests over the limit stay queued while other work is
+         *  dispatched (0 = unlimited).
+         */
+        unsigned int datasetConcurrency;
+
+        /** Limits overriding the one above for datasets whose path starts
+         *  with given prefix (e.g. resource's root), longest prefix wins.
+         */
+        std::map<std::string, unsigned int> datasetConcurrencyByPrefix;
+
+        /** Local-disk cache of byte ranges of remote datasets shared by all
+         *  workers.
+         */
+        rangecache::Options rangeCache;
+
+        /** Batched io_uring reads of local GeoTIFFs.
+         */
+        uringio::Options uring;
+
+        /** Raster request whose warp is estimated (from past warps of the
+         *  same dataset) to take longer than this (in milliseconds) is split
+         *  into horizontal strips warped by several workers and joined
+         *  (0 = never split).
+         */
+        std::size_t splitThreshold;
+
+        /** Maximum number of strips a split request is cut into.
+         */
+        std::size_t splitStrips;
+
+        /** Square tile warps padded by a few pixels (e.g. 258x258 tiles of
+         *  normal maps, 257x257 DEM grids) are served by cropping single
+         *  canonical padded warp of the same tile, i.e. generators on the
+         *  same dataset share it instead of warping the tile again.
+         */
+        bool sharePadded;
+
+        /** Stack sampling of requests processed longer than threshold.
+         */
+        profiler::Options profile;
+
+        /** Host-wide cache of warp results shared with other instances on
+         *  this host.
+         */
+        SharedCache::Options sharedCache;
+
+        /** Time (in seconds) warp results are kept in the host-wide cache.
+         */
+        std::size_t sharedCacheTtl;
+
+        /** File where measured request costs (see predict()) are kept over
+         *  restarts (empty = not kept).
+         */
+        boost::filesystem::path costFile;
+
         Options()
-            : processCount(5), rssCheckPeriod(5)
+            : backend(Backend::process), processCount(5), rssCheckPeriod(5)
             , rssLimit(std::size_t(1) << 12)
+            , affinity(true), affinityStealDelay(50)
+            , datasetCacheLimit(0), datasetCacheMemoryLimit(0)
+            , vectorDatasetCacheLimit(16)
+            , coalesce(true)
+            , priorityWeights{{ 8, 4, 2, 1, 0 }}
+            , queueMaxAge(60)
+            , shmSize(1024), shmControlSize(64), shmReserve(32), shmWait(1000)
+            , shmHugepages(false), shmPrefault(false)
+            , prewarmDatasets(16), prewarmBudget(10000)
+            , recycleGraceful(true), recycleTimeout(60), recycleRequests(0)
+            , numaPinning(false), gdalThreads(0), gdalCacheMax(0)
+            , datasetBlockQuota(0), datasetConcurrency(0)
+            , splitThreshold(0), splitStrips(4), sharePadded(true)
+            , sharedCacheTtl(600)
         {}
     };
 
@@ -114,12 +347,18 @@ public:
          *       returns 3-channel double matrix with current value, minimum
          *       value and maximum value in each pixel
          *
+         * * demFloat, demOptimalFloat, valueMinMaxFloat:
+         *       same as dem, demOptimal and valueMinMax but return float
+         *       matrices (CV_32F/CV_32FC3); source DEMs are float anyway and
+         *       half of the data is copied through shared memory
+         *
          * * none:
          *       placeholder for a derived class
          */
         enum class Operation {
             image, imageNoOpt, imageNoExpand, mask, maskNoOpt, detailMask, dem
-            , demOptimal, valueMinMax, none
+            , demOptimal, valueMinMax, demFloat, demOptimalFloat
+            , valueMinMaxFloat, none
         };
 
         Operation operation;
@@ -130,6 +369,43 @@ public:
         geo::GeoDataset::Resampling resampling;
         boost::optional<std::string> mask;
         boost::optional<double> nodata;
+        Priority priority;
+
+        /** Source bands (1-based) to read in image operations; empty means
+         *  all bands. Other bands are not read from the dataset at all.
+         */
+        std::vector<int> bands;
+
+        /** Image operations return single channel grayscale matrix.
+         */
+        bool grayscale;
+
+        /** Image operations on paletted datasets return single channel
+         *  matrix of colour table indices instead of expanding palette into
+         *  3 channels.
+         */
+        bool keepPalette;
+
+        /** Overview selection policy of image and DEM operations: use the
+         *  coarsest overview at least this many times finer than the
+         *  destination pixel. None means GDAL's own choice.
+         */
+        boost::optional<double> overviewRatio;
+
+        /** Fast DEM resampling ("dem-fast") of DEM and valueMinMax
+         *  operations: when destination pixel spans more than this many
+         *  source pixels, average filter is used instead of the expensive
+         *  Resampling::dem kernel, on the coarsest overview at least as fine
+         *  as the destination pixel (or given by overviewRatio). None means
+         *  Resampling::dem everywhere.
+         */
+        boost::optional<double> demFastRatio;
+
+        /** Image operations append validity mask of the warped image as an
+         *  extra channel, i.e. single warp yields both the image and its
+         *  mask.
+         */
+        bool withMask;
 
         RasterRequest(Operation operation
                       , const std::string &dataset
@@ -142,22 +418,119 @@ public:
                       = boost::none)
             : operation(operation), dataset(dataset)
             , srs(srs), extents(extents), size(size), resampling(resampling)
-            , mask(mask)
+            , mask(mask), priority(defaultPriority(operation))
+            , grayscale(false), keepPalette(false), withMask(false)
         {}
 
         RasterRequest& setNodata(const boost::optional<double> &value) {
             nodata = value; return *this;
         }
+
+        RasterRequest& setPriority(Priority value) {
+            priority = value; return *this;
+        }
+
+        RasterRequest& setBands(const std::vector<int> &value) {
+            bands = value; return *this;
+        }
+
+        RasterRequest& setGrayscale(bool value = true) {
+            grayscale = value; return *this;
+        }
+
+        RasterRequest& setKeepPalette(bool value = true) {
+            keepPalette = value; return *this;
+        }
+
+        RasterRequest&
+        setOverviewRatio(const boost::optional<double> &value) {
+            overviewRatio = value; return *this;
+        }
+
+        RasterRequest&
+        setDemFastRatio(const boost::optional<double> &value) {
+            demFastRatio = value; return *this;
+        }
+
+        RasterRequest& setWithMask(bool value = true) {
+            withMask = value; return *this;
+        }
+
+        /** Priority derived from operation: valueMinMax (metatiles) goes to
+         *  the tile lane, DEMs to the mesh lane, images to the imagery lane
+         *  and masks to the mask lane.
+         */
+        static Priority defaultPriority(Operation operation);
+
+        /** Key identifying warped raster (all fields but priority).
+         */
+        std::string key() const;
+
+        /** Key identifying warped raster regardless of how the request
+         *  treats empty result, i.e. image and imageNoOpt requests share
+         *  it. Raster of the former is a valid result of the latter, caches
+         *  keyed by it are shared among interfaces asking for the same
+         *  tile differently (e.g. VTS and WMTS).
+         */
+        std::string canonicalKey() const;
     };
 
+    /** Warps raster.
+     *
+     *  Slow requests may be split into strips processed in parallel (see
+     *  Options::splitThreshold); result is the same.
+     *
+     *  NB: returned raster can be shared with other callers that issued
+     *  identical request at the same time; treat it as read-only.
+     */
     Raster warp(const RasterRequest &request, Aborter &sink);
 
+    /** Asynchronous completion callback. Receives either result or error.
+     *
+     *  Called from warper's completion thread: must not block, post any
+     *  heavy work elsewhere.
+     */
+    typedef std::function<void(const Raster&, const std::exception_ptr&)>
+        RasterCallback;
+
+    /** Asynchronous warp: returns immediately, result is passed to callback.
+     *  Identical requests in flight (both synchronous and asynchronous) are
+     *  coalesced like in the synchronous warp. Result found in the
+     *  host-wide cache is passed to callback right away from the calling
+     *  thread.
+     */
+    void warp(const RasterRequest &request, Aborter &sink
+              , const RasterCallback &callback);
+
+    typedef std::vector<Raster> Rasters;
+
+    /** Batch warp: warps block of tiles.width x tiles.height tiles covered by
+     *  request.extents/request.size in a single pass and slices the result
+     *  into per-tile views (row-major, top row first).
+     *
+     *  Overlap is number of pixels of request.size shared by neighbouring
+     *  tiles (e.g. 2 for tiles with one pixel margin on each side). Result
+     *  slices include any extra pixels added by the operation itself (e.g.
+     *  grid registration of DEMs).
+     *
+     *  Slices share memory with the whole block; treat them as read-only.
+     *  Operation::demOptimal cannot be batched.
+     */
+    Rasters warpBatch(const RasterRequest &request, const math::Size2 &tiles
+                      , int overlap, Aborter &sink);
+
     /** Raster request with DEM post processing */
     class RasterRequestWP : public RasterRequest {
     public:
         geo::GeoDataset::DemProcessing processing;
         std::vector<std::string> processingOptions;
 
+        /** Precompiled native processing (see demprocessing::parse). When
+         *  set, processing options are not sent to the worker at all.
+         *  Otherwise options are parsed in the worker.
+         */
+        boost::optional<demprocessing::Params> native;
+
         RasterRequestWP(const std::string &dataset
                         , const geo::SrsDefinition & srs
                         , const math::Extents2 & extents
@@ -170,10 +543,20 @@ public:
                         size, resampling)
             , processing(processing), processingOptions(processingOptions)
         {}
+
+        RasterRequestWP&
+        setNative(const boost::optional<demprocessing::Params> &value) {
+            native = value; return *this;
+        }
     };
 
     Raster warpWP(const RasterRequestWP &request, Aborter &sink);
 
+    /** Asynchronous warpWP, see asynchronous warp.
+     */
+    void warpWP(const RasterRequestWP &request, Aborter &sink
+                , const RasterCallback &callback);
+
     struct Heightcoded {
         typedef std::shared_ptr<Heightcoded> pointer;
 
@@ -191,17 +574,108 @@ public:
 
     typedef std::vector<std::string> OpenOptions;
 
+    /** Heightcoding configuration: libgeo's one extended with mapproxy's
+     *  own sampling options.
+     */
+    struct HeightcodeConfig : geo::heightcoding::Config {
+        /** Sample DEM heights of all vertices in one batch (see
+         *  gdalsupport/demsampler.hpp) before running libgeo's heightcoding.
+         */
+        bool batchSampling;
+
+        HeightcodeConfig() : batchSampling(false) {}
+    };
+
     /** Heightcode vector ds using raster ds
      */
     Heightcoded::pointer
     heightcode(const std::string &vectorDs
                , const DemDataset::list &rasterDs
-               , const geo::heightcoding::Config &config
+               , const HeightcodeConfig &config
                , const boost::optional<std::string> &vectorGeoidGrid
                , const OpenOptions &openOptions
                , const LayerEnhancer::map &layerEnancers
                , Aborter &aborter);
 
+    typedef std::function<void(const Heightcoded::pointer&
+                               , const std::exception_ptr&)>
+        HeightcodedCallback;
+
+    /** Asynchronous heightcode, see asynchronous warp.
+     */
+    void heightcode(const std::string &vectorDs
+                    , const DemDataset::list &rasterDs
+                    , const HeightcodeConfig &config
+                    , const boost::optional<std::string> &vectorGeoidGrid
+                    , const OpenOptions &openOptions
+                    , const LayerEnhancer::map &layerEnancers
+                    , Aborter &aborter
+                    , const HeightcodedCallback &callback);
+
+    /** Single tile of batched heightcoding.
+     */
+    struct HeightcodeTile {
+        std::string vectorDs;
+        HeightcodeConfig config;
+        OpenOptions openOptions;
+
+        typedef std::vector<HeightcodeTile> list;
+    };
+
+    /** Result of single tile of batched heightcoding: data or error.
+     */
+    struct HeightcodedTile {
+        Heightcoded::pointer heightcoded;
+        std::exception_ptr error;
+
+        typedef std::vector<HeightcodedTile> list;
+    };
+
+    /** Heightcodes several vector datasets using the same raster ds in a
+     *  single worker job. DEMs are opened once and, when all tiles are
+     *  clipped to extents in the same working SRS, cropped into in-memory
+     *  patches covering union of the tiles. Results are in order of tiles.
+     */
+    HeightcodedTile::list
+    heightcode(const HeightcodeTile::list &tiles
+               , const DemDataset::list &rasterDs
+               , const boost::optional<std::string> &vectorGeoidGrid
+               , const LayerEnhancer::map &layerEnancers
+               , Aborter &aborter);
+
+    /** Dataset properties as seen by a GDAL worker (see probe()).
+     */
+    struct DatasetProbe {
+        std::string dataset;
+        math::Extents2 extents;
+        math::Size2 size;
+        geo::SrsDefinition srs;
+
+        /** Dataset has no invalid pixel (see geo::GeoDataset::allValid).
+         */
+        bool allValid;
+
+        /** See support/geo.hpp.
+         */
+        EffectiveGsd effectiveGsd;
+
+        /** Set if the dataset cannot be opened, nothing else is valid then.
+         */
+        std::exception_ptr error;
+
+        typedef std::vector<DatasetProbe> list;
+    };
+
+    /** Opens given datasets in a worker and returns their properties, i.e.
+     *  the calling process never opens them itself (keeps GDAL caches and
+     *  heap of the daemon out of forked workers). Datasets stay open in the
+     *  worker's dataset cache. Results are in order of datasets.
+     *
+     *  Throws IOError if any dataset cannot be opened.
+     */
+    DatasetProbe::list probe(const std::vector<std::string> &datasets
+                             , Aborter &aborter);
+
     typedef std::function<WorkRequest*(const WorkRequestParams&)>
         WorkGenerator;
 
@@ -209,6 +683,45 @@ public:
      */
     WorkResponse job(const WorkGenerator &workGenerator, Aborter &aborter);
 
+    typedef std::function<void(const WorkResponse&, const std::exception_ptr&)>
+        JobCallback;
+
+    /** Asynchronous job, see asynchronous warp.
+     */
+    void job(const WorkGenerator &workGenerator, Aborter &aborter
+             , const JobCallback &callback);
+
+    /** Asks every worker to open given datasets so that first requests
+     *  touching them find them ready. Returns immediately.
+     */
+    void warm(const std::vector<std::string> &datasets);
+
+    /** Predicted cost of a request: worker wall and CPU time (in
+     *  microseconds) from decaying averages of past requests of the same
+     *  operation, dataset and resolution level measured by workers.
+     */
+    struct Cost {
+        std::uint64_t wall;
+        std::uint64_t cpu;
+
+        /** Number of samples behind the prediction, 0 means no prediction
+         *  (not enough samples yet).
+         */
+        std::uint64_t samples;
+
+        Cost() : wall(), cpu(), samples() {}
+
+        explicit operator bool() const { return samples; }
+    };
+
+    Cost predict(const RasterRequest &request) const;
+
+    /** Prediction of non-raster request by its operation name (as in
+     *  statistics, e.g. "heightcode") and dataset.
+     */
+    Cost predict(const std::string &operation, const std::string &dataset)
+        const;
+
     /** Do housekeeping. Must be called in the process where internals are being
      * run.
      */
@@ -216,6 +729,15 @@ public:
 
     void stat(std::ostream &os) const;
 
+    /** Prints requests being processed by workers and queued requests with
+     *  time spent in each state, one per line.
+     */
+    void inFlight(std::ostream &os) const;
+
+    /** Writes lock-free metrics.
+     */
+    void metrics(metrics::Writer &writer) const;
+
     class Detail;
 
 private:
@@ -224,4 +746,9 @@ private:
     const Detail& detail() const { return *detail_; }
 };
 
+UTILITY_GENERATE_ENUM_IO(GdalWarper::Backend,
+    ((process))
+    ((threads))
+)
+
 #endif // mapproxy_gdalsupport_hpp_included_
@@ -0,0 +1,143 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <chrono>
+#include <algorithm>
+
+#include "autoscaler.hpp"
+
+Autoscaler::Autoscaler(const Options &options, unsigned int size)
+    : options_(options)
+    , target_(options.max
+              ? std::max(std::max(options.min, 1u)
+                         , std::min(size, options.max))
+              : size)
+    , grown_(0), shrunk_(0), cpuLimited_(0)
+    , lastReason_(Reason::none), lastDecision_(0), idleSince_(0)
+{}
+
+std::int64_t Autoscaler::now()
+{
+    // monotonic clock is shared by all processes
+    return std::chrono::duration_cast<std::chrono::milliseconds>
+        (std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+Autoscaler::Decision Autoscaler::update(const Sample &sample)
+{
+    if (!enabled()) { return Decision::none; }
+
+    const auto t(now());
+
+    // track continuous idle period
+    if (!sample.idle) {
+        idleSince_ = 0;
+    } else if (!idleSince_) {
+        idleSince_ = t;
+    }
+
+    if (lastDecision_
+        && ((t - lastDecision_) < std::int64_t(options_.cooldown * 1000)))
+    {
+        return Decision::none;
+    }
+
+    // let the pool converge to the current target first
+    const unsigned int target(target_);
+    if (sample.workers != target) { return Decision::none; }
+
+    const auto decide([&](Decision decision, Reason reason)
+    {
+        lastReason_ = reason;
+        lastDecision_ = t;
+        return decision;
+    });
+
+    const auto reason([&]()
+    {
+        if (options_.queueDepth
+            && (sample.queued > options_.queueDepth * sample.workers))
+        {
+            return Reason::queueDepth;
+        }
+        if (options_.queueWait && sample.queued
+            && (sample.wait > options_.queueWait))
+        {
+            return Reason::queueWait;
+        }
+        return Reason::none;
+    }());
+
+    if (reason != Reason::none) {
+        if (target >= options_.max) { return Decision::none; }
+        if (sample.load > options_.loadLimit) {
+            ++cpuLimited_;
+            return Decision::none;
+        }
+
+        target_ = target + 1;
+        ++grown_;
+        return decide(Decision::grow, reason);
+    }
+
+    if (idleSince_ && (target > std::max(options_.min, 1u))
+        && ((t - idleSince_) >= std::int64_t(options_.idle * 1000)))
+    {
+        target_ = target - 1;
+        ++shrunk_;
+        // drained worker was idle, the others have to prove it again
+        idleSince_ = t;
+        return decide(Decision::shrink, Reason::idle);
+    }
+
+    return Decision::none;
+}
+
+const char* Autoscaler::reasonName(Reason reason)
+{
+    switch (reason) {
+    case Reason::none: return "none";
+    case Reason::queueDepth: return "queueDepth";
+    case Reason::queueWait: return "queueWait";
+    case Reason::idle: return "idle";
+    }
+    return "unknown";
+}
+
+void Autoscaler::stat(std::ostream &os, const std::string &prefix) const
+{
+    const std::int64_t last(lastDecision_);
+
+    os << prefix << "min=" << std::max(options_.min, 1u) << '\n'
+       << prefix << "max=" << options_.max << '\n'
+       << prefix << "target=" << target_ << '\n'
+       << prefix << "grown=" << grown_ << '\n'
+       << prefix << "shrunk=" << shrunk_ << '\n'
+       << prefix << "cpuLimited=" << cpuLimited_ << '\n'
+       << prefix << "last.reason=" << reasonName(lastReason_) << '\n'
+       << prefix << "last.age="
+       << (last ? ((now() - last) / 1000.0) : -1.0) << '\n';
+}
@@ -0,0 +1,146 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef mapproxy_gdalsupport_autoscaler_hpp_included_
+#define mapproxy_gdalsupport_autoscaler_hpp_included_
+
+#include <atomic>
+#include <string>
+#include <cstdint>
+#include <ostream>
+
+/** Sizing of GDAL worker pool by load.
+ *
+ *  Lives in shared memory: decisions are made by the manager process
+ *  (update() called periodically), target and decision history are read by
+ *  any process.
+ *
+ *  Pool grows by one worker when the queue is too deep or its oldest request
+ *  waits too long, but only while there is CPU headroom (another worker
+ *  would only compete for the same CPUs otherwise). Pool shrinks by one
+ *  worker when there has been some idle worker all the time for the idle
+ *  period; the manager drains such worker. Consecutive decisions are at
+ *  least cooldown apart to let the pool settle.
+ */
+class Autoscaler {
+public:
+    struct Options {
+        /** Pool size bounds. Autoscaling is off when max is 0.
+         */
+        unsigned int min;
+        unsigned int max;
+
+        /** Grow when there are more queued requests than this per worker.
+         */
+        std::size_t queueDepth;
+
+        /** Grow when the oldest queued request waits longer than this (in
+         *  milliseconds).
+         */
+        std::size_t queueWait;
+
+        /** Shrink when some worker has been idle all the time for this
+         *  period (in seconds).
+         */
+        std::size_t idle;
+
+        /** Do not grow when 1-minute load average per CPU is above this.
+         */
+        double loadLimit;
+
+        /** Minimum time between two decisions (in seconds).
+         */
+        std::size_t cooldown;
+
+        Options()
+            : min(1), max(0), queueDepth(2), queueWait(500), idle(60)
+            , loadLimit(0.9), cooldown(10)
+        {}
+    };
+
+    /** Pool state sampled by the manager.
+     */
+    struct Sample {
+        /** Workers not being drained. */
+        std::size_t workers;
+        /** Parked workers. */
+        std::size_t idle;
+        /** Queued requests and wait time (ms) of the oldest one. */
+        std::size_t queued;
+        std::size_t wait;
+        /** 1-minute load average per CPU. */
+        double load;
+
+        Sample() : workers(), idle(), queued(), wait(), load() {}
+    };
+
+    enum class Decision { none, grow, shrink };
+
+    /** Initial target is given pool size clamped to bounds.
+     */
+    Autoscaler(const Options &options, unsigned int size);
+
+    bool enabled() const { return options_.max; }
+
+    /** Current pool size target.
+     */
+    unsigned int target() const { return target_; }
+
+    /** Evaluates sample and updates target. Called by the manager only.
+     */
+    Decision update(const Sample &sample);
+
+    void stat(std::ostream &os, const std::string &prefix) const;
+
+private:
+    /** Reason of last decision.
+     */
+    enum class Reason { none, queueDepth, queueWait, idle };
+
+    static const char* reasonName(Reason reason);
+
+    static std::int64_t now();
+
+    const Options options_;
+
+    std::atomic<unsigned int> target_;
+
+    std::atomic<std::uint64_t> grown_;
+    std::atomic<std::uint64_t> shrunk_;
+
+    /** Samples calling for growth denied due to lack of CPU headroom.
+     */
+    std::atomic<std::uint64_t> cpuLimited_;
+
+    std::atomic<Reason> lastReason_;
+    std::atomic<std::int64_t> lastDecision_;
+
+    /** Start of current idle period (0 = nobody idle). Manager only.
+     */
+    std::int64_t idleSince_;
+};
+
+#endif // mapproxy_gdalsupport_autoscaler_hpp_included_
@@ -0,0 +1,297 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef mapproxy_gdalsupport_coalescer_hpp_included_
+#define mapproxy_gdalsupport_coalescer_hpp_included_
+
+#include <map>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <string>
+#include <cstdint>
+#include <exception>
+#include <functional>
+
+#include "../error.hpp"
+
+/** How often a coalesced follower checks its own client and deadline.
+ */
+constexpr std::chrono::milliseconds FollowerPoll(20);
+
+/** Waits for result of a coalesced request. Throws RequestAborted when the
+ *  waiting client gives up and DeadlineExceeded past its own deadline (in
+ *  microseconds since the Unix epoch, 0 = none).
+ */
+template <typename T>
+void follow(const std::shared_future<T> &future
+            , const std::atomic<bool> &aborted, std::uint64_t deadline)
+{
+    while (future.wait_for(FollowerPoll) != std::future_status::ready) {
+        if (aborted) { throw RequestAborted("Request has been aborted"); }
+
+        const std::uint64_t now
+            (std::chrono::duration_cast<std::chrono::microseconds>
+             (std::chrono::system_clock::now().time_since_epoch()).count());
+        if (deadline && (now > deadline)) {
+            throw DeadlineExceeded
+                ("Request deadline passed while waiting for coalesced "
+                 "request.");
+        }
+    }
+}
+
+/** Tells whether follower should retry on its own after the leader failed
+ *  with given error: leader's client gave up or ran out of its time (not
+ *  ours), or leader's optimized raster is empty (not an error for an
+ *  unoptimized follower).
+ */
+inline bool followerRetries(const std::exception_ptr &error, bool optimized)
+{
+    try {
+        std::rethrow_exception(error);
+    } catch (const RequestAborted&) {
+        return true;
+    } catch (const DeadlineExceeded&) {
+        return true;
+    } catch (const EmptyImage&) {
+        return optimized;
+    } catch (...) {}
+    return false;
+}
+
+/** Coalesces identical work in flight (singleflight): the first caller of
+ *  a key (leader) does the work, other callers (followers) wait for its
+ *  result. Synchronous and asynchronous callers share the same flights.
+ */
+template <typename T>
+class Coalescer {
+public:
+    typedef std::function<void(const T &result
+                               , const std::exception_ptr &error)> Callback;
+
+    /** Does work() as leader of flight of given key or, if the same work is
+     *  in flight under key (or under alternate key, unless empty), waits
+     *  for its result by wait(future) and returns it.
+     *
+     *  Follower does work() on its own when retry(error, alternated) holds
+     *  for leader's error; alternated is set when flight of alternate key
+     *  was joined. Errors thrown by wait() are passed through.
+     */
+    template <typename Work, typename Wait, typename Retry>
+    T operator()(const std::string &key, const std::string &alternate
+                 , Work work, Wait wait, Retry retry);
+
+    /** Asynchronous variant: leader starts work by start(done) and the
+     *  work calls done(result, error) exactly once when finished; follower
+     *  attaches its callback to the flight in progress instead. Callbacks
+     *  run in the thread that finished the work and must not throw.
+     *
+     *  Follower starts (a copy of) start(callback) on its own when
+     *  retry(error, alternated) holds for leader's error. Error thrown by
+     *  leader's start() is passed to followers and rethrown. Returns true
+     *  if a flight in progress was joined.
+     */
+    template <typename Start, typename Retry>
+    bool async(const std::string &key, const std::string &alternate
+               , Start start, const Callback &callback, Retry retry);
+
+    /** Number of flights.
+     */
+    std::size_t size() const;
+
+private:
+    struct Flight {
+        std::promise<T> promise;
+        std::shared_future<T> future;
+
+        /** Asynchronous followers, guarded by lock_.
+         */
+        std::vector<Callback> callbacks;
+
+        Flight() : future(promise.get_future().share()) {}
+        typedef std::shared_ptr<Flight> pointer;
+    };
+
+    typedef std::map<std::string, typename Flight::pointer> Flights;
+
+    /** Finds flight of key (or of alternate key, unless empty) or starts
+     *  a new one as leader. Must be called under lock.
+     */
+    typename Flight::pointer find(const std::string &key
+                                  , const std::string &alternate
+                                  , bool &leader, bool &alternated);
+
+    /** Removes leader's flight and passes result (or error) to the
+     *  followers.
+     */
+    void land(const std::string &key, const typename Flight::pointer &flight
+              , const T &result, const std::exception_ptr &error);
+
+    mutable std::mutex lock_;
+    Flights flights_;
+};
+
+// inlines
+
+template <typename T>
+typename Coalescer<T>::Flight::pointer
+Coalescer<T>::find(const std::string &key, const std::string &alternate
+                   , bool &leader, bool &alternated)
+{
+    auto fflights(flights_.find(key));
+    if ((fflights == flights_.end()) && !alternate.empty()) {
+        fflights = flights_.find(alternate);
+        alternated = (fflights != flights_.end());
+    }
+    if (fflights != flights_.end()) { return fflights->second; }
+
+    leader = true;
+    auto flight(std::make_shared<Flight>());
+    flights_.insert(typename Flights::value_type(key, flight));
+    return flight;
+}
+
+template <typename T>
+void Coalescer<T>::land(const std::string &key
+                        , const typename Flight::pointer &flight
+                        , const T &result, const std::exception_ptr &error)
+{
+    std::vector<Callback> callbacks;
+    {
+        // no follower can attach once the flight is gone
+        std::unique_lock<std::mutex> lock(lock_);
+        flights_.erase(key);
+        std::swap(callbacks, flight->callbacks);
+    }
+
+    if (error) {
+        flight->promise.set_exception(error);
+    } else {
+        flight->promise.set_value(result);
+    }
+
+    for (const auto &callback : callbacks) {
+        callback(error ? T() : result, error);
+    }
+}
+
+template <typename T>
+template <typename Work, typename Wait, typename Retry>
+T Coalescer<T>::operator()(const std::string &key
+                           , const std::string &alternate
+                           , Work work, Wait wait, Retry retry)
+{
+    bool leader(false);
+    bool alternated(false);
+    typename Flight::pointer flight;
+
+    {
+        std::unique_lock<std::mutex> lock(lock_);
+        flight = find(key, alternate, leader, alternated);
+    }
+
+    if (!leader) {
+        wait(flight->future);
+        try {
+            return flight->future.get();
+        } catch (...) {
+            if (!retry(std::current_exception(), alternated)) { throw; }
+        }
+        return work();
+    }
+
+    T result;
+    try {
+        result = work();
+    } catch (...) {
+        land(key, flight, T(), std::current_exception());
+        throw;
+    }
+    land(key, flight, result, {});
+    return result;
+}
+
+template <typename T>
+template <typename Start, typename Retry>
+bool Coalescer<T>::async(const std::string &key
+                         , const std::string &alternate
+                         , Start start, const Callback &callback
+                         , Retry retry)
+{
+    bool leader(false);
+    bool alternated(false);
+    typename Flight::pointer flight;
+
+    {
+        std::unique_lock<std::mutex> lock(lock_);
+        flight = find(key, alternate, leader, alternated);
+        if (!leader) {
+            flight->callbacks.push_back
+                ([start, callback, retry, alternated]
+                 (const T &result, const std::exception_ptr &error) mutable
+            {
+                if (!error || !retry(error, alternated)) {
+                    return callback(result, error);
+                }
+
+                try {
+                    start(callback);
+                } catch (...) {
+                    callback(T(), std::current_exception());
+                }
+            });
+            return true;
+        }
+    }
+
+    // leader: fan the result out to everybody attached meanwhile; work
+    // that fails to start fails the followers as well
+    try {
+        start([this, key, flight, callback]
+              (const T &result, const std::exception_ptr &error)
+        {
+            land(key, flight, result, error);
+            callback(result, error);
+        });
+    } catch (...) {
+        land(key, flight, T(), std::current_exception());
+        throw;
+    }
+    return false;
+}
+
+template <typename T>
+std::size_t Coalescer<T>::size() const
+{
+    std::unique_lock<std::mutex> lock(lock_);
+    return flights_.size();
+}
+
+#endif // mapproxy_gdalsupport_coalescer_hpp_included_
@@ -0,0 +1,290 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cmath>
+#include <limits>
+#include <sstream>
+#include <algorithm>
+#include <functional>
+
+#include <boost/filesystem.hpp>
+
+#include "dbglog/dbglog.hpp"
+
+#include "utility/streams.hpp"
+
+#include "costmodel.hpp"
+
+namespace fs = boost::filesystem;
+
+namespace {
+
+/** Number of samples needed before the average is trusted.
+ */
+constexpr std::uint64_t MinCostSamples(4);
+
+/** Weight of new sample in the averages.
+ */
+constexpr double CostAlpha(0.2);
+
+/** First line of the persisted file.
+ */
+const std::string CostSignature("mapproxy-warpcost 1");
+
+std::size_t costKey(const std::string &operation, const std::string &dataset
+                    , int lod)
+{
+    return std::hash<std::string>()
+        (operation + '|' + dataset + '|' + std::to_string(lod));
+}
+
+void average(double &value, double sample, std::uint64_t samples)
+{
+    if (samples == 1) {
+        value = sample;
+    } else {
+        value += CostAlpha * (sample - value);
+    }
+}
+
+} // namespace
+
+int costLod(const math::Extents2 &extents, const math::Size2 &size)
+{
+    const auto width(math::size(extents).width);
+    if ((width <= 0) || (size.width <= 0)) { return 0; }
+    return int(std::lround(std::log2(size.width / width)));
+}
+
+CostModel::Record::Record(const std::string &operation
+                          , const std::string &dataset, int lod
+                          , ManagedBuffer &mb)
+    : operation(operation.data(), operation.size()
+                , mb.get_allocator<char>())
+    , dataset(dataset.data(), dataset.size(), mb.get_allocator<char>())
+    , lod(lod), samples(), wall(), cpu(), pixelSamples(), wallPerPixel()
+    , cpuPerPixel(), updated()
+{}
+
+CostModel::CostModel(ManagedBuffer &mb, std::size_t limit)
+    : mb_(mb), limit_(limit)
+    , records_(std::less<std::size_t>()
+               , mb.get_allocator<Records::value_type>())
+    , sequence_(), recorded_()
+{}
+
+const CostModel::Record* CostModel::find(const std::string &operation
+                                         , const std::string &dataset
+                                         , int lod) const
+{
+    auto frecords(records_.find(costKey(operation, dataset, lod)));
+    if (frecords == records_.end()) { return nullptr; }
+
+    // hash collision
+    const auto &record(frecords->second);
+    if ((record.lod != lod) || (asString(record.operation) != operation)
+        || (asString(record.dataset) != dataset))
+    {
+        return nullptr;
+    }
+    return &record;
+}
+
+CostModel::Record& CostModel::get(const std::string &operation
+                                  , const std::string &dataset, int lod)
+{
+    const auto key(costKey(operation, dataset, lod));
+    auto frecords(records_.find(key));
+    if (frecords != records_.end()) {
+        auto &record(frecords->second);
+        if ((record.lod == lod) && (asString(record.operation) == operation)
+            && (asString(record.dataset) == dataset))
+        {
+            return record;
+        }
+        // hash collision: newcomer takes over the slot
+        records_.erase(frecords);
+    } else if (records_.size() >= limit_) {
+        records_.erase(std::min_element
+                       (records_.begin(), records_.end()
+                        , [](const Records::value_type &l
+                             , const Records::value_type &r)
+                        {
+                            return l.second.updated < r.second.updated;
+                        }));
+    }
+
+    return records_.insert
+        (Records::value_type(key, Record(operation, dataset, lod, mb_)))
+        .first->second;
+}
+
+void CostModel::record(const std::string &operation
+                       , const std::string &dataset, int lod
+                       , std::uint64_t pixels, std::uint64_t wall
+                       , std::uint64_t cpu)
+{
+    auto &record(get(operation, dataset, lod));
+    record.updated = ++sequence_;
+    ++recorded_;
+
+    ++record.samples;
+    average(record.wall, wall, record.samples);
+    average(record.cpu, cpu, record.samples);
+
+    if (!pixels) { return; }
+    ++record.pixelSamples;
+    average(record.wallPerPixel, double(wall) / pixels, record.pixelSamples);
+    average(record.cpuPerPixel, double(cpu) / pixels, record.pixelSamples);
+}
+
+GdalWarper::Cost CostModel::predict(const std::string &operation
+                                    , const std::string &dataset, int lod
+                                    , std::uint64_t pixels) const
+{
+    GdalWarper::Cost cost;
+
+    const auto *record(find(operation, dataset, lod));
+    if (pixels) {
+        // per-pixel cost changes slowly between levels
+        for (const auto l : { lod, lod + 1, lod - 1 }) {
+            const auto *r((l == lod) ? record : find(operation, dataset, l));
+            if (!r || (r->pixelSamples < MinCostSamples)) { continue; }
+            cost.wall = std::uint64_t(r->wallPerPixel * pixels);
+            cost.cpu = std::uint64_t(r->cpuPerPixel * pixels);
+            cost.samples = r->pixelSamples;
+            return cost;
+        }
+    }
+
+    if (record && (record->samples >= MinCostSamples)) {
+        cost.wall = std::uint64_t(record->wall);
+        cost.cpu = std::uint64_t(record->cpu);
+        cost.samples = record->samples;
+    }
+    return cost;
+}
+
+CostModel::Entry::list CostModel::entries() const
+{
+    Entry::list entries;
+    entries.reserve(records_.size());
+    for (const auto &item : records_) {
+        const auto &record(item.second);
+        entries.emplace_back();
+        auto &entry(entries.back());
+        entry.operation = asString(record.operation);
+        entry.dataset = asString(record.dataset);
+        entry.lod = record.lod;
+        entry.samples = record.samples;
+        entry.wall = record.wall;
+        entry.cpu = record.cpu;
+        entry.pixelSamples = record.pixelSamples;
+        entry.wallPerPixel = record.wallPerPixel;
+        entry.cpuPerPixel = record.cpuPerPixel;
+    }
+    return entries;
+}
+
+void CostModel::restore(const Entry::list &entries)
+{
+    for (const auto &entry : entries) {
+        auto &record(get(entry.operation, entry.dataset, entry.lod));
+        record.updated = ++sequence_;
+        record.samples = entry.samples;
+        record.wall = entry.wall;
+        record.cpu = entry.cpu;
+        record.pixelSamples = entry.pixelSamples;
+        record.wallPerPixel = entry.wallPerPixel;
+        record.cpuPerPixel = entry.cpuPerPixel;
+    }
+}
+
+CostModel::Entry::list CostModel::load(const fs::path &path)
+{
+    Entry::list entries;
+    if (path.empty() || !fs::exists(path)) { return entries; }
+
+    try {
+        utility::ifstreambuf f(path.string());
+        std::string line;
+        if (!std::getline(f, line) || (line != CostSignature)) {
+            LOG(warn2) << "Warp cost file " << path
+                       << " has unknown format, ignored.";
+            return entries;
+        }
+
+        // operation lod samples wall cpu pixelSamples wallPerPixel
+        // cpuPerPixel dataset (the rest of the line)
+        while (std::getline(f, line)) {
+            std::istringstream is(line);
+            Entry entry;
+            if (!(is >> entry.operation >> entry.lod >> entry.samples
+                  >> entry.wall >> entry.cpu >> entry.pixelSamples
+                  >> entry.wallPerPixel >> entry.cpuPerPixel)
+                || !std::getline(is >> std::ws, entry.dataset))
+            {
+                continue;
+            }
+            entries.push_back(entry);
+        }
+    } catch (const std::exception &e) {
+        LOG(warn2) << "Cannot load warp cost file " << path
+                   << ": <" << e.what() << ">.";
+        entries.clear();
+    }
+
+    LOG(info2) << "Loaded warp cost of " << entries.size()
+               << " keys from " << path << ".";
+    return entries;
+}
+
+void CostModel::save(const fs::path &path, const Entry::list &entries)
+{
+    if (path.empty()) { return; }
+
+    try {
+        auto tmp(path);
+        tmp += ".tmp";
+        {
+            utility::ofstreambuf f(tmp.string());
+            f.precision(std::numeric_limits<double>::max_digits10);
+            f << CostSignature << '\n';
+            for (const auto &entry : entries) {
+                f << entry.operation << ' ' << entry.lod << ' '
+                  << entry.samples << ' ' << entry.wall << ' ' << entry.cpu
+                  << ' ' << entry.pixelSamples << ' ' << entry.wallPerPixel
+                  << ' ' << entry.cpuPerPixel << ' ' << entry.dataset
+                  << '\n';
+            }
+            f.close();
+        }
+        fs::rename(tmp, path);
+    } catch (const std::exception &e) {
+        LOG(warn2) << "Cannot save warp cost into " << path
+                   << ": <" << e.what() << ">.";
+    }
+}
@@ -0,0 +1,158 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef mapproxy_gdalsupport_costmodel_hpp_included_
+#define mapproxy_gdalsupport_costmodel_hpp_included_
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <ostream>
+
+#include <boost/noncopyable.hpp>
+#include <boost/filesystem/path.hpp>
+#include <boost/interprocess/containers/map.hpp>
+
+#include "../gdalsupport.hpp"
+#include "types.hpp"
+
+/** Resolution level of a raster request: log2 of destination pixels per
+ *  SRS unit, rounded. Equals tile LOD up to a constant for any tiling of
+ *  the same SRS and does not change when a request is cut into strips.
+ */
+int costLod(const math::Extents2 &extents, const math::Size2 &size);
+
+/** Cost of GDAL requests measured by workers: exponentially weighted
+ *  averages of worker wall and CPU time, keyed by operation, dataset and
+ *  resolution level (see costLod()). Raster requests also keep time per
+ *  output pixel so that requests of different sizes (e.g. strips of split
+ *  requests) feed the same estimate.
+ *
+ *  Lives in shared memory: recorded by workers, predictions are made in the
+ *  main process. Guarded by the warper mutex.
+ */
+class CostModel : boost::noncopyable {
+public:
+    /** Keeps at most limit keys, least recently updated key is dropped when
+     *  full.
+     */
+    CostModel(ManagedBuffer &mb, std::size_t limit = 4096);
+
+    /** Records request processed by a worker. Pixels is 0 for requests not
+     *  producing raster. Times are in microseconds.
+     */
+    void record(const std::string &operation, const std::string &dataset
+                , int lod, std::uint64_t pixels, std::uint64_t wall
+                , std::uint64_t cpu);
+
+    /** Predicts cost of given request. Raster requests without samples at
+     *  given level use per-pixel cost of the neighbouring levels.
+     */
+    GdalWarper::Cost predict(const std::string &operation
+                             , const std::string &dataset, int lod
+                             , std::uint64_t pixels) const;
+
+    /** Averages of single key, as persisted.
+     */
+    struct Entry {
+        std::string operation;
+        std::string dataset;
+        int lod;
+        std::uint64_t samples;
+        double wall;
+        double cpu;
+        std::uint64_t pixelSamples;
+        double wallPerPixel;
+        double cpuPerPixel;
+
+        Entry()
+            : lod(), samples(), wall(), cpu(), pixelSamples()
+            , wallPerPixel(), cpuPerPixel()
+        {}
+
+        typedef std::vector<Entry> list;
+    };
+
+    /** Copies all entries (to be saved outside of the lock).
+     */
+    Entry::list entries() const;
+
+    /** Replaces averages of all given entries.
+     */
+    void restore(const Entry::list &entries);
+
+    std::size_t size() const { return records_.size(); }
+
+    std::uint64_t recorded() const { return recorded_; }
+
+    /** Persistence; load returns empty list and save logs failure on error.
+     */
+    static Entry::list load(const boost::filesystem::path &path);
+    static void save(const boost::filesystem::path &path
+                     , const Entry::list &entries);
+
+private:
+    struct Record {
+        String operation;
+        String dataset;
+        int lod;
+        std::uint64_t samples;
+        double wall;
+        double cpu;
+        std::uint64_t pixelSamples;
+        double wallPerPixel;
+        double cpuPerPixel;
+
+        /** Value of update sequence at last update.
+         */
+        std::uint64_t updated;
+
+        Record(const std::string &operation, const std::string &dataset
+               , int lod, ManagedBuffer &mb);
+    };
+
+    typedef bi::map<std::size_t, Record, std::less<std::size_t>
+                    , bi::allocator<std::pair<const std::size_t, Record>
+                                    , SegmentManager>
+                    > Records;
+
+    /** Finds record of given key or creates new one (possibly dropping the
+     *  stalest one).
+     */
+    Record& get(const std::string &operation, const std::string &dataset
+                , int lod);
+
+    const Record* find(const std::string &operation
+                       , const std::string &dataset, int lod) const;
+
+    ManagedBuffer &mb_;
+    const std::size_t limit_;
+    Records records_;
+    std::uint64_t sequence_;
+    std::uint64_t recorded_;
+};
+
+#endif // mapproxy_gdalsupport_costmodel_hpp_included_
@@ -24,16 +24,156 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <ogrsf_frmts.h>
+
+#include "dbglog/dbglog.hpp"
+
 #include "../error.hpp"
 #include "datasetcache.hpp"
+#include "rangecache.hpp"
+#include "uringio.hpp"
 
 geo::GeoDataset& DatasetCache::operator()(const std::string &path)
 {
-    ++hits_;
+    auto fdatasets(datasets_.find(path));
+    if (fdatasets != datasets_.end()) {
+        ++stats_.hits;
+        // move to the back of LRU
+        auto &entry(fdatasets->second);
+        lru_.splice(lru_.end(), lru_, entry.lru);
+        return entry.dataset;
+    }
+
+    ++stats_.misses;
+
+    // open first, dataset can fail to open; remote datasets are read
+    // through the range cache (if any) and local GeoTIFFs through io_uring
+    // (if enabled), cache is still keyed by given path
+    auto ds(geo::GeoDataset::open(uringio::route(rangecache::route(path))));
+
+    auto ilru(lru_.insert(lru_.end(), path));
+    try {
+        return datasets_.insert
+            (Cache::value_type(path, Entry(std::move(ds), ilru)))
+            .first->second.dataset;
+    } catch (...) {
+        lru_.erase(ilru);
+        throw;
+    }
+}
+
+DatasetCache::VectorDataset
+DatasetCache::vector(const std::string &path, const OpenOptions &openOptions
+                     , const VectorOpener &open)
+{
+    if (!vectorLimit_) { return open(); }
+
+    // key: path and all options
+    auto key(path);
+    for (const auto &option : openOptions) {
+        key.push_back('\0');
+        key.append(option);
+    }
+
+    auto fvectors(vectors_.find(key));
+    if (fvectors != vectors_.end()) {
+        ++stats_.vectorHits;
+        auto &entry(fvectors->second);
+        vectorLru_.splice(vectorLru_.end(), vectorLru_, entry.lru);
+
+        // previous user might have left filters set or layers half-read
+        auto &ds(*entry.dataset);
+        for (int i(0), e(ds.GetLayerCount()); i < e; ++i) {
+            auto *layer(ds.GetLayer(i));
+            layer->SetSpatialFilter(nullptr);
+            layer->SetAttributeFilter(nullptr);
+            layer->ResetReading();
+        }
+        return entry.dataset;
+    }
+
+    ++stats_.vectorMisses;
+
+    // open first, dataset can fail to open
+    auto ds(open());
+
+    auto ilru(vectorLru_.insert(vectorLru_.end(), key));
+    try {
+        vectors_.insert(VectorCache::value_type(key, VectorEntry{ ds, ilru }));
+    } catch (...) {
+        vectorLru_.erase(ilru);
+        throw;
+    }
+
+    while (vectors_.size() > vectorLimit_) {
+        vectors_.erase(vectorLru_.front());
+        vectorLru_.pop_front();
+        ++stats_.vectorEvictions;
+    }
+
+    return ds;
+}
+
+tilearchive::Archive& DatasetCache::archive(const std::string &path)
+{
+    auto farchives(archives_.find(path));
+    if (farchives == archives_.end()) {
+        farchives = archives_.insert
+            (std::make_pair(path, tilearchive::Archive::open(path))).first;
+    }
+    return *farchives->second;
+}
+
+bool DatasetCache::evict()
+{
+    if (lru_.empty()) { return false; }
+
+    const auto path(lru_.front());
+    lru_.pop_front();
+    datasets_.erase(path);
+    ++stats_.evictions;
+
+    LOG(info1) << "Closed dataset " << path << ".";
+
+    if (evictCallback_) { evictCallback_(path); }
+    return true;
+}
+
+bool DatasetCache::account(const std::string &path, std::int64_t grown)
+{
+    if (grown <= 0) { return true; }
 
     auto fdatasets(datasets_.find(path));
-    if (fdatasets != datasets_.end()) { return fdatasets->second; }
+    if (fdatasets != datasets_.end()) {
+        fdatasets->second.blockBytes += grown;
+    }
+    return false;
+}
+
+void DatasetCache::trim()
+{
+    if (blockQuota_) {
+        for (auto idatasets(datasets_.begin());
+             idatasets != datasets_.end(); )
+        {
+            if (idatasets->second.blockBytes <= blockQuota_) {
+                ++idatasets;
+                continue;
+            }
+
+            // closing the dataset frees all its blocks
+            const auto path(idatasets->first);
+            lru_.erase(idatasets->second.lru);
+            idatasets = datasets_.erase(idatasets);
+            ++stats_.blockFlushes;
+
+            LOG(info1) << "Closed dataset " << path
+                       << " over its block cache quota.";
+
+            if (evictCallback_) { evictCallback_(path); }
+        }
+    }
 
-    return datasets_.insert(Cache::value_type
-                            (path, geo::GeoDataset::open(path))).first->second;
+    if (!limit_) { return; }
+    while (datasets_.size() > limit_) { evict(); }
 }
@@ -28,21 +28,160 @@
 #define mapproxy_datasetcache_hpp_included_
 
 #include <map>
+#include <list>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <functional>
 
 #include "geo/geodataset.hpp"
 
+#include "tilearchive.hpp"
+
+class GDALDataset;
+
+/** LRU cache of open GDAL datasets.
+ *
+ *  Datasets are never evicted inside operator() since callers may hold
+ *  references to other cached datasets; call trim() between requests.
+ *
+ *  Growth of GDAL block cache while serving requests is accounted to their
+ *  datasets (see account()). Dataset whose blocks exceed the block quota
+ *  is closed by trim(), which releases all its blocks; one huge dataset
+ *  thus cannot push blocks of all others out of the shared block cache.
+ */
 class DatasetCache {
 public:
-    DatasetCache() : hits_() {}
+    struct Stats {
+        std::uint64_t hits;
+        std::uint64_t misses;
+        std::uint64_t evictions;
+
+        /** Vector datasets.
+         */
+        std::uint64_t vectorHits;
+        std::uint64_t vectorMisses;
+        std::uint64_t vectorEvictions;
+
+        /** Datasets closed over their block cache quota.
+         */
+        std::uint64_t blockFlushes;
+
+        Stats()
+            : hits(), misses(), evictions()
+            , vectorHits(), vectorMisses(), vectorEvictions()
+            , blockFlushes()
+        {}
+    };
+
+    typedef std::shared_ptr< ::GDALDataset> VectorDataset;
+    typedef std::vector<std::string> OpenOptions;
+    typedef std::function<VectorDataset()> VectorOpener;
+
+    /** Called with path of every evicted dataset.
+     */
+    typedef std::function<void(const std::string &path)> EvictCallback;
+
+    /** Creates cache.
+     *
+     * \param limit maximum number of open datasets (0 = unlimited)
+     * \param evictCallback callback called on eviction
+     * \param vectorLimit maximum number of open vector datasets (0 =
+     *                    vector datasets are not cached)
+     * \param blockQuota block cache quota of single dataset in bytes
+     *                   (0 = no quota)
+     */
+    DatasetCache(std::size_t limit = 0
+                 , const EvictCallback &evictCallback = EvictCallback()
+                 , std::size_t vectorLimit = 0
+                 , std::size_t blockQuota = 0)
+        : limit_(limit), evictCallback_(evictCallback)
+        , blockQuota_(blockQuota), vectorLimit_(vectorLimit)
+    {}
 
     geo::GeoDataset& operator()(const std::string &path);
 
+    /** Returns vector dataset open with given options, calls open on cache
+     *  miss. Filters and reading of all layers are reset before the dataset
+     *  is handed out again.
+     */
+    VectorDataset vector(const std::string &path
+                         , const OpenOptions &openOptions
+                         , const VectorOpener &open);
+
+    /** Returns tile archive (MBTiles, PMTiles), opens it on first use.
+     *  Archives are kept open for the lifetime of the cache.
+     */
+    tilearchive::Archive& archive(const std::string &path);
+
+    /** Accounts given growth of GDAL block cache (in bytes) to dataset.
+     *  Returns true when the cache did not grow, i.e. all blocks were
+     *  found in the cache.
+     */
+    bool account(const std::string &path, std::int64_t grown);
+
+    /** Closes datasets over their block cache quota and evicts least
+     *  recently used datasets to fit in the limit.
+     */
+    void trim();
+
+    /** Evicts least recently used dataset. Returns false if cache is empty.
+     */
+    bool evict();
+
+    /** Number of open datasets.
+     */
+    std::size_t size() const { return datasets_.size(); }
+
+    /** Number of open vector datasets.
+     */
+    std::size_t vectorSize() const { return vectors_.size(); }
+
+    const Stats& stats() const { return stats_; }
+
 private:
-    typedef std::map<std::string, geo::GeoDataset> Cache;
+    typedef std::list<std::string> Lru;
+
+    struct Entry {
+        geo::GeoDataset dataset;
+        Lru::iterator lru;
+
+        /** Block cache growth accounted to this dataset since opened.
+         */
+        std::uint64_t blockBytes;
+
+        Entry(geo::GeoDataset &&dataset, Lru::iterator lru)
+            : dataset(std::move(dataset)), lru(lru), blockBytes()
+        {}
+    };
+
+    typedef std::map<std::string, Entry> Cache;
+
+    std::size_t limit_;
+    EvictCallback evictCallback_;
+    std::size_t blockQuota_;
 
     Cache datasets_;
 
-    std::size_t hits_;
+    /** Least recently used dataset at the front.
+     */
+    Lru lru_;
+
+    struct VectorEntry {
+        VectorDataset dataset;
+        Lru::iterator lru;
+    };
+
+    typedef std::map<std::string, VectorEntry> VectorCache;
+
+    std::size_t vectorLimit_;
+    VectorCache vectors_;
+    Lru vectorLru_;
+
+    std::map<std::string, tilearchive::Archive::pointer> archives_;
+
+    Stats stats_;
 };
 
 #endif // mapproxy_dataset_hpp_included_
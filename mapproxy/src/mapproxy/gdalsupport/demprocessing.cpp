@@ -0,0 +1,286 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cmath>
+
+#include <boost/lexical_cast.hpp>
+
+#include "dbglog/dbglog.hpp"
+
+#include "demprocessing.hpp"
+
+namespace demprocessing {
+
+namespace {
+
+constexpr double DegToRad(M_PI / 180.0);
+constexpr double RadToDeg(180.0 / M_PI);
+
+/** 3x3 window around current pixel, row-major, top row first.
+ */
+struct Window {
+    double v[9];
+
+    /** Loads window around pixel i of given row, returns false if any value
+     *  is invalid.
+     */
+    bool load(const double *top, const double *mid, const double *bottom
+              , int i, double nodata, bool checkNodata)
+    {
+        v[0] = top[i - 1]; v[1] = top[i]; v[2] = top[i + 1];
+        v[3] = mid[i - 1]; v[4] = mid[i]; v[5] = mid[i + 1];
+        v[6] = bottom[i - 1]; v[7] = bottom[i]; v[8] = bottom[i + 1];
+
+        if (!checkNodata) { return true; }
+        for (auto value : v) {
+            if (value == nodata) { return false; }
+        }
+        return true;
+    }
+};
+
+/** Gradient in x and y, not yet divided by algorithm's normalization factor
+ *  (8 for Horn, 2 for Zevenbergen & Thorne).
+ */
+struct Gradient {
+    double invEwres;
+    double invNsres;
+    bool zt;
+
+    void operator()(const Window &w, double &x, double &y) const {
+        const auto &a(w.v);
+        if (zt) {
+            x = (a[3] - a[5]) * invEwres;
+            y = (a[7] - a[1]) * invNsres;
+        } else {
+            x = ((a[0] + a[3] + a[3] + a[6])
+                 - (a[2] + a[5] + a[5] + a[8])) * invEwres;
+            y = ((a[6] + a[7] + a[7] + a[8])
+                 - (a[0] + a[1] + a[1] + a[2])) * invNsres;
+        }
+    }
+};
+
+inline uchar toByte(double value)
+{
+    return cv::saturate_cast<uchar>(value);
+}
+
+template <typename Kernel>
+cv::Mat apply(const cv::Mat &dem, const geo::NodataValue &nodata
+              , const Kernel &kernel)
+{
+    cv::Mat out(dem.rows - 2, dem.cols - 2, CV_8UC1, cv::Scalar(0));
+
+    const bool checkNodata(bool(nodata));
+    const double nd(nodata ? *nodata : 0.0);
+
+    Window w;
+    for (int j(0); j < out.rows; ++j) {
+        const auto *top(dem.ptr<double>(j));
+        const auto *mid(dem.ptr<double>(j + 1));
+        const auto *bottom(dem.ptr<double>(j + 2));
+        auto *o(out.ptr<uchar>(j));
+
+        for (int i(0); i < out.cols; ++i) {
+            if (!w.load(top, mid, bottom, i + 1, nd, checkNodata)) {
+                continue;
+            }
+            o[i] = toByte(kernel(w));
+        }
+    }
+
+    return out;
+}
+
+} // namespace
+
+boost::optional<Params>
+parse(geo::GeoDataset::DemProcessing processing
+      , const std::vector<std::string> &options)
+{
+    typedef geo::GeoDataset::DemProcessing Processing;
+
+    Params params;
+    switch (processing) {
+    case Processing::hillshade:
+        params.algorithm = Params::Algorithm::hillshade;
+        break;
+
+    case Processing::slope:
+        params.algorithm = Params::Algorithm::slope;
+        break;
+
+    default:
+        return boost::none;
+    }
+
+    const auto end(options.end());
+    for (auto ioptions(options.begin()); ioptions != end; ++ioptions) {
+        const auto &option(*ioptions);
+
+        const auto value([&]() -> double
+        {
+            if (++ioptions == end) {
+                LOGTHROW(err1, std::runtime_error)
+                    << "Missing value of gdaldem option " << option << ".";
+            }
+            return boost::lexical_cast<double>(*ioptions);
+        });
+
+        if (option == "-z") {
+            params.zFactor = value();
+        } else if (option == "-s") {
+            params.scale = value();
+        } else if (option == "-az") {
+            params.azimuth = value();
+        } else if (option == "-alt") {
+            params.altitude = value();
+        } else if (option == "-p") {
+            params.percent = true;
+        } else if (option == "-multidirectional") {
+            if (params.algorithm != Params::Algorithm::hillshade) {
+                return boost::none;
+            }
+            params.algorithm = Params::Algorithm::multidirectional;
+        } else if (option == "-alg") {
+            if (++ioptions == end) { return boost::none; }
+            if (*ioptions == "ZevenbergenThorne") {
+                params.zevenbergenThorne = true;
+            } else if (*ioptions != "Horn") {
+                return boost::none;
+            }
+        } else if ((option == "-compute_edges") || (option == "-q")) {
+            // edges are covered by warp margin; quiet is implied
+        } else if (option == "-b") {
+            // only the first band is ever processed
+            if (value() != 1.0) { return boost::none; }
+        } else {
+            // anything else (-combined, -igor, -of, -co...) is left to GDAL
+            return boost::none;
+        }
+    }
+
+    return params;
+}
+
+cv::Mat process(const Params &params, const cv::Mat &dem
+                , double ewres, double nsres
+                , const geo::NodataValue &nodata)
+{
+    cv::Mat src(dem);
+    if (src.type() != CV_64FC1) { dem.convertTo(src, CV_64FC1); }
+
+    const double norm(params.zevenbergenThorne ? 2.0 : 8.0);
+
+    switch (params.algorithm) {
+    case Params::Algorithm::slope: {
+        // slope uses scaled horizontal resolution
+        const Gradient gradient{ 1.0 / (ewres * params.scale)
+                , 1.0 / (nsres * params.scale), params.zevenbergenThorne };
+        const bool percent(params.percent);
+
+        return apply(src, nodata, [&](const Window &w) -> double
+        {
+            double x, y;
+            gradient(w, x, y);
+            const auto key(std::sqrt(x * x + y * y) / norm);
+            return percent ? (100.0 * key) : (std::atan(key) * RadToDeg);
+        });
+    }
+
+    case Params::Algorithm::hillshade: {
+        const Gradient gradient{ 1.0 / ewres, 1.0 / nsres
+                , params.zevenbergenThorne };
+
+        const double z(params.zFactor / (norm * params.scale));
+        const double squareZ(z * z);
+        const double alt(params.altitude * DegToRad);
+        const double az(params.azimuth * DegToRad);
+        const double sinAlt254(254.0 * std::sin(alt));
+        const double cosAltZ254(254.0 * std::cos(alt) * z);
+        const double cosAz(std::cos(az) * cosAltZ254);
+        const double sinAz(std::sin(az) * cosAltZ254);
+
+        return apply(src, nodata, [&](const Window &w) -> double
+        {
+            double x, y;
+            gradient(w, x, y);
+            const auto cang((sinAlt254 - (y * cosAz - x * sinAz))
+                            / std::sqrt(1.0 + squareZ * (x * x + y * y)));
+            return (cang <= 0.0) ? 1.0 : (1.0 + cang);
+        });
+    }
+
+    case Params::Algorithm::multidirectional: {
+        const Gradient gradient{ 1.0 / ewres, 1.0 / nsres
+                , params.zevenbergenThorne };
+
+        // see http://pubs.usgs.gov/of/1992/of92-422/of92-422.pdf
+        const double z(params.zFactor / (norm * params.scale));
+        const double squareZ(z * z);
+        const double alt(params.altitude * DegToRad);
+        const double sinAlt127(127.0 * std::sin(alt));
+        const double cosAltZ127(127.0 * std::cos(alt) * z);
+        const double sinAlt254(254.0 * std::sin(alt));
+
+        return apply(src, nodata, [&](const Window &w) -> double
+        {
+            double x, y;
+            gradient(w, x, y);
+
+            const auto xx(x * x);
+            const auto yy(y * y);
+            const auto xxPlusYy(xx + yy);
+            if (xxPlusYy == 0.0) { return 1.0 + sinAlt254; }
+
+            const auto positive([](double v) { return (v <= 0.0) ? 0.0 : v; });
+
+            const auto val225(positive(sinAlt127 + (x - y) * cosAltZ127));
+            const auto val270(positive(sinAlt127
+                                       - x * cosAltZ127 * M_SQRT2));
+            const auto val315(positive(sinAlt127 + (x + y) * cosAltZ127));
+            const auto val360(positive(sinAlt127
+                                       - y * cosAltZ127 * M_SQRT2));
+
+            const auto weight225(0.5 * xxPlusYy - x * y);
+            const auto weight270(xx);
+            const auto weight315(xxPlusYy - weight225);
+            const auto weight360(yy);
+
+            const auto cang(((weight225 * val225 + weight270 * val270
+                              + weight315 * val315 + weight360 * val360)
+                             / xxPlusYy)
+                            / std::sqrt(1.0 + squareZ * xxPlusYy));
+            return 1.0 + cang;
+        });
+    }
+    }
+
+    return {};
+}
+
+} // namespace demprocessing
@@ -0,0 +1,104 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef mapproxy_gdalsupport_demprocessing_hpp_included_
+#define mapproxy_gdalsupport_demprocessing_hpp_included_
+
+#include <string>
+#include <vector>
+
+#include <boost/optional.hpp>
+
+#include <opencv2/core/core.hpp>
+
+#include "geo/geodataset.hpp"
+
+/** Native implementation of the most common gdaldem processings, applied
+ *  directly to warped DEM without building any temporary GDAL dataset.
+ *
+ *  Output should match gdaldem output for the same DEM window.
+ */
+namespace demprocessing {
+
+/** Typed gdaldem processing parameters.
+ */
+struct Params {
+    enum class Algorithm { hillshade, multidirectional, slope };
+
+    Algorithm algorithm;
+
+    /** Use Zevenbergen & Thorne gradient instead of Horn.
+     */
+    bool zevenbergenThorne;
+
+    /** Vertical exaggeration (-z).
+     */
+    double zFactor;
+
+    /** Ratio of vertical and horizontal units (-s).
+     */
+    double scale;
+
+    /** Light source azimuth and altitude, in degrees (-az, -alt).
+     */
+    double azimuth;
+    double altitude;
+
+    /** Slope in percent (-p) instead of degrees.
+     */
+    bool percent;
+
+    Params(Algorithm algorithm = Algorithm::hillshade)
+        : algorithm(algorithm), zevenbergenThorne(false)
+        , zFactor(1.0), scale(1.0), azimuth(315.0), altitude(45.0)
+        , percent(false)
+    {}
+};
+
+/** Parses gdaldem processing and its options. Returns none when this
+ *  combination is not supported natively (i.e. must be handled by GDAL).
+ */
+boost::optional<Params>
+parse(geo::GeoDataset::DemProcessing processing
+      , const std::vector<std::string> &options);
+
+/** Processes DEM.
+ *
+ *  \param params processing parameters
+ *  \param dem single channel DEM with 1 pixel margin on each side
+ *  \param ewres west-east pixel size
+ *  \param nsres north-south pixel size (negative for north-up rasters)
+ *  \param nodata DEM nodata value
+ *  \return single channel 8bit raster 2 pixels smaller than DEM, pixels
+ *          with any invalid neighbour are 0
+ */
+cv::Mat process(const Params &params, const cv::Mat &dem
+                , double ewres, double nsres
+                , const geo::NodataValue &nodata);
+
+} // namespace demprocessing
+
+#endif // mapproxy_gdalsupport_demprocessing_hpp_included_
@@ -0,0 +1,377 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cmath>
+#include <string>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+
+#include <ogrsf_frmts.h>
+#include <ogr_api.h>
+
+#include "dbglog/dbglog.hpp"
+
+#include "geo/verticaladjuster.hpp"
+
+#include "demsampler.hpp"
+
+namespace {
+
+/** Nodata of in-memory DEM blocks.
+ */
+const float Nodata(-1e10f);
+
+/** Calls op(geometry, index) for every vertex of given geometry, nested
+ *  geometries (polygon rings, collection members) included.
+ */
+template <typename Op>
+void forEachVertex(::OGRGeometryH geometry, const Op &op)
+{
+    if (const int count = ::OGR_G_GetGeometryCount(geometry)) {
+        for (int i(0); i < count; ++i) {
+            forEachVertex(::OGR_G_GetGeometryRef(geometry, i), op);
+        }
+        return;
+    }
+
+    for (int i(0), e(::OGR_G_GetPointCount(geometry)); i < e; ++i) {
+        op(geometry, i);
+    }
+}
+
+OGRSpatialReference reference(const geo::SrsDefinition &srs)
+{
+    auto ref(srs.reference());
+#if GDAL_VERSION_MAJOR >= 3
+    ref.SetAxisMappingStrategy(OAMS_TRADITIONAL_GIS_ORDER);
+#endif
+    return ref;
+}
+
+/** Converts all points in a single call, heights too if asked. Returns false
+ *  if any point cannot be converted.
+ */
+bool convert(const OGRSpatialReference &src, const OGRSpatialReference &dst
+             , DemSampler::Points &points, bool heights)
+{
+    if (!points.size()) { return true; }
+
+    auto s(src);
+    auto d(dst);
+    std::unique_ptr< ::OGRCoordinateTransformation>
+        ct(::OGRCreateCoordinateTransformation(&s, &d));
+    if (!ct) { return false; }
+
+    std::vector<int> success(points.size());
+    if (!ct->Transform(int(points.size()), points.x.data(), points.y.data()
+                       , (heights ? points.z.data() : nullptr)
+                       , success.data()))
+    {
+        return false;
+    }
+
+    return std::all_of(success.begin(), success.end()
+                       , [](int s) { return s != 0; });
+}
+
+typedef std::unique_ptr< ::OGRFeature, void(*)(::OGRFeature*)> Feature;
+
+Feature feature(::OGRFeature *f)
+{
+    return Feature(f, [](::OGRFeature *of)
+    {
+        ::OGRFeature::DestroyFeature(of);
+    });
+}
+
+} // namespace
+
+DemSampler::DemSampler(const geo::GeoDataset &dem, int blockSize)
+    : dem_(dem), blockSize_(blockSize)
+{}
+
+std::size_t DemSampler::interpolate(const Grid &grid, std::size_t count
+                                    , const double *col, const double *row
+                                    , double *z)
+{
+    const double maxCol(grid.width - 1);
+    const double maxRow(grid.height - 1);
+    const int lastCol(std::max(grid.width - 2, 0));
+    const int lastRow(std::max(grid.height - 2, 0));
+    const auto *data(grid.data);
+    const auto stride(grid.stride);
+    const auto nodata(grid.nodata);
+
+    // no branches inside, invalid neighbours just get zero weight
+    std::size_t missing(0);
+    for (std::size_t i(0); i < count; ++i) {
+        const double c(std::min(std::max(col[i], 0.0), maxCol));
+        const double r(std::min(std::max(row[i], 0.0), maxRow));
+        const int c0(std::min(int(c), lastCol));
+        const int r0(std::min(int(r), lastRow));
+        const int c1(std::min(c0 + 1, grid.width - 1));
+        const int r1(std::min(r0 + 1, grid.height - 1));
+        const double fx(c - c0);
+        const double fy(r - r0);
+
+        const double v00(data[r0 * stride + c0]);
+        const double v01(data[r0 * stride + c1]);
+        const double v10(data[r1 * stride + c0]);
+        const double v11(data[r1 * stride + c1]);
+
+        const double w00((1.0 - fx) * (1.0 - fy) * (v00 != nodata));
+        const double w01(fx * (1.0 - fy) * (v01 != nodata));
+        const double w10((1.0 - fx) * fy * (v10 != nodata));
+        const double w11(fx * fy * (v11 != nodata));
+
+        const double sw(w00 + w01 + w10 + w11);
+        const double sv(w00 * v00 + w01 * v01 + w10 * v10 + w11 * v11);
+        const bool valid(sw > 0.0);
+
+        z[i] = valid ? (sv / sw) : nodata;
+        missing += !valid;
+    }
+
+    return missing;
+}
+
+bool DemSampler::operator()(Points &points) const
+{
+    const auto count(points.size());
+    if (!count) { return true; }
+
+    const auto &extents(dem_.extents());
+    const auto size(dem_.size());
+    const auto esize(math::size(extents));
+    const double rw(esize.width / size.width);
+    const double rh(esize.height / size.height);
+
+    const int bw((size.width + blockSize_ - 1) / blockSize_);
+
+    // grid coordinates (pixel centers at integral values) and block keys
+    std::vector<double> col(count), row(count);
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> order(count);
+    for (std::size_t i(0); i < count; ++i) {
+        const double c((points.x[i] - extents.ll(0)) / rw - 0.5);
+        const double r((extents.ur(1) - points.y[i]) / rh - 0.5);
+
+        // outside of the DEM (NaN included)
+        if (!((c >= -0.5) && (c <= size.width - 0.5)
+              && (r >= -0.5) && (r <= size.height - 0.5)))
+        {
+            return false;
+        }
+
+        col[i] = c;
+        row[i] = r;
+
+        const int ic(std::min(std::max(int(c), 0), size.width - 1));
+        const int ir(std::min(std::max(int(r), 0), size.height - 1));
+        order[i].first = (ir / blockSize_) * bw + (ic / blockSize_);
+        order[i].second = i;
+    }
+
+    std::sort(order.begin(), order.end());
+
+    std::vector<double> bcol, brow, bz;
+    for (auto iorder(order.begin()), eorder(order.end()); iorder != eorder; )
+    {
+        auto end(iorder);
+        while ((end != eorder) && (end->first == iorder->first)) { ++end; }
+
+        // block with one more pixel so every bilinear neighbour is inside
+        const int c0((iorder->first % bw) * blockSize_);
+        const int r0((iorder->first / bw) * blockSize_);
+        const math::Size2 bsize(std::min(blockSize_ + 1, size.width - c0)
+                                , std::min(blockSize_ + 1, size.height - r0));
+        const math::Extents2 be(extents.ll(0) + c0 * rw
+                                , extents.ur(1) - (r0 + bsize.height) * rh
+                                , extents.ll(0) + (c0 + bsize.width) * rw
+                                , extents.ur(1) - r0 * rh);
+
+        // grids are aligned -> nearest neighbour is plain copy
+        auto block(geo::GeoDataset::deriveInMemory
+                   (dem_, dem_.srs(), bsize, be, GDT_Float32
+                    , geo::GeoDataset::NodataValue(Nodata)));
+        dem_.warpInto(block, geo::GeoDataset::Resampling::nearest);
+        const auto &mat(block.cdata());
+
+        // gather points of this block
+        const auto n(std::distance(iorder, end));
+        bcol.resize(n);
+        brow.resize(n);
+        bz.resize(n);
+        for (std::ptrdiff_t k(0); k < n; ++k) {
+            const auto i(iorder[k].second);
+            bcol[k] = col[i] - c0;
+            brow[k] = row[i] - r0;
+        }
+
+        const Grid grid{ mat.ptr<double>(), mat.cols, mat.rows
+                         , mat.step1(), double(Nodata) };
+        if (interpolate(grid, n, bcol.data(), brow.data(), bz.data())) {
+            return false;
+        }
+
+        // scatter heights back
+        for (std::ptrdiff_t k(0); k < n; ++k) {
+            points.z[iorder[k].second] = bz[k];
+        }
+
+        iorder = end;
+    }
+
+    return true;
+}
+
+std::shared_ptr< ::GDALDataset>
+sampleHeights(::GDALDataset &ds
+              , const std::vector<const geo::GeoDataset*> &rasters
+              , GdalWarper::HeightcodeConfig &config)
+{
+    typedef geo::heightcoding::Mode Mode;
+
+    if (!config.batchSampling || (rasters.size() != 1)
+        || (config.mode == Mode::never))
+    {
+        return {};
+    }
+
+    const auto &dem(*rasters.front());
+    const auto demSrs(config.rasterDsSrs ? *config.rasterDsSrs : dem.srs());
+    const auto outSrs(config.outputSrs ? config.outputSrs->srs : demSrs);
+    const bool adjust(config.outputSrs && config.outputSrs->adjustVertical);
+
+    const auto demRef(reference(demSrs));
+    const auto outRef(reference(outSrs));
+    const geo::VerticalAdjuster adjuster(adjust, outSrs);
+    const DemSampler sampler(dem);
+
+    auto *driver(::GetGDALDriverManager()->GetDriverByName("Memory"));
+    std::shared_ptr< ::GDALDataset>
+        out(driver->Create("", 0, 0, 0, GDT_Unknown, nullptr)
+            , [](::GDALDataset *ds) { delete ds; });
+    if (!out) { return {}; }
+
+    for (int l(0), le(ds.GetLayerCount()); l < le; ++l) {
+        auto *layer(ds.GetLayer(l));
+        const std::string name(layer->GetName());
+        if (config.layers
+            && (std::find(config.layers->begin(), config.layers->end(), name)
+                == config.layers->end()))
+        {
+            continue;
+        }
+
+        OGRSpatialReference srcRef;
+        if (config.vectorDsSrs) {
+            srcRef = reference(*config.vectorDsSrs);
+        } else if (const auto *ref = layer->GetSpatialRef()) {
+            srcRef = *ref;
+#if GDAL_VERSION_MAJOR >= 3
+            srcRef.SetAxisMappingStrategy(OAMS_TRADITIONAL_GIS_ORDER);
+#endif
+        } else {
+            return {};
+        }
+
+        // load features and collect all their vertices
+        std::vector<Feature> features;
+        DemSampler::Points points;
+        layer->ResetReading();
+        while (auto *f = layer->GetNextFeature()) {
+            features.push_back(feature(f));
+            auto *g(f->GetGeometryRef());
+            if (!g) { continue; }
+
+            // auto mode keeps 3D geometries as they are
+            if ((config.mode == Mode::auto_) && g->Is3D()) { return {}; }
+
+            forEachVertex(::OGRGeometry::ToHandle(g)
+                          , [&](::OGRGeometryH h, int i)
+            {
+                points.push_back(::OGR_G_GetX(h, i), ::OGR_G_GetY(h, i));
+            });
+        }
+
+        // whole batch: to DEM, sample, to output, adjust
+        if (!convert(srcRef, demRef, points, false)) { return {}; }
+        if (!sampler(points)) { return {}; }
+        if (!convert(demRef, outRef, points, true)) { return {}; }
+        if (adjust) {
+            for (std::size_t i(0), e(points.size()); i < e; ++i) {
+                points.z[i] = adjuster(math::Point3(points.x[i], points.y[i]
+                                                    , points.z[i]))(2);
+            }
+        }
+
+        // write back into in-memory copy of the layer
+        auto outRefCopy(outRef);
+        auto *olayer(out->CreateLayer
+                     (name.c_str(), &outRefCopy
+                      , ::OGR_GT_SetZ(layer->GetGeomType()), nullptr));
+        if (!olayer) { return {}; }
+
+        auto *defn(layer->GetLayerDefn());
+        for (int i(0), e(defn->GetFieldCount()); i < e; ++i) {
+            if (olayer->CreateField(defn->GetFieldDefn(i)) != OGRERR_NONE) {
+                return {};
+            }
+        }
+
+        std::size_t index(0);
+        for (const auto &f : features) {
+            if (auto *g = f->GetGeometryRef()) {
+                g->setCoordinateDimension(3);
+                forEachVertex(::OGRGeometry::ToHandle(g)
+                              , [&](::OGRGeometryH h, int i)
+                {
+                    ::OGR_G_SetPoint(h, i, points.x[index], points.y[index]
+                                     , points.z[index]);
+                    ++index;
+                });
+                g->assignSpatialReference(olayer->GetSpatialRef());
+            }
+
+            auto of(feature(::OGRFeature::CreateFeature
+                            (olayer->GetLayerDefn())));
+            of->SetFrom(f.get());
+            of->SetFID(f->GetFID());
+            if (olayer->CreateFeature(of.get()) != OGRERR_NONE) {
+                return {};
+            }
+        }
+    }
+
+    LOG(debug) << "Heights of vector dataset sampled in batch.";
+
+    // libgeo only converts (and clips and formats) the result
+    config.mode = Mode::never;
+    config.vectorDsSrs = outSrs;
+    if (config.outputSrs) { config.outputSrs->adjustVertical = false; }
+    return out;
+}
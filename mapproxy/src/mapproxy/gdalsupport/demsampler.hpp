@@ -0,0 +1,113 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef mapproxy_gdalsupport_demsampler_hpp_included_
+#define mapproxy_gdalsupport_demsampler_hpp_included_
+
+#include <memory>
+#include <vector>
+#include <cstddef>
+
+#include "geo/geodataset.hpp"
+
+#include "../gdalsupport.hpp"
+
+class GDALDataset;
+
+/** Batched DEM sampler.
+ *
+ *  Samples heights of many points at once: points are sorted by DEM block,
+ *  each block is read into memory once and heights of all its points are
+ *  interpolated bilinearly in a single branch-free (vectorizable) loop.
+ */
+class DemSampler {
+public:
+    /** Points in structure-of-arrays layout.
+     */
+    struct Points {
+        std::vector<double> x;
+        std::vector<double> y;
+        std::vector<double> z;
+
+        std::size_t size() const { return x.size(); }
+
+        void push_back(double px, double py) {
+            x.push_back(px);
+            y.push_back(py);
+            z.push_back(0.0);
+        }
+    };
+
+    /** Block of DEM in memory, row-major, invalid cells hold nodata.
+     */
+    struct Grid {
+        const double *data;
+        int width;
+        int height;
+        std::size_t stride;
+        double nodata;
+    };
+
+    /** Blocks are blockSize x blockSize pixels.
+     */
+    DemSampler(const geo::GeoDataset &dem, int blockSize = 256);
+
+    /** Samples heights of given points (in DEM's SRS) into points.z.
+     *  Returns false when some point has no height (outside of the DEM or
+     *  surrounded by nodata only).
+     */
+    bool operator()(Points &points) const;
+
+    /** Bilinear interpolation of count points at grid coordinates col/row
+     *  (pixel centers at integral coordinates, clamped to the grid). Nodata
+     *  neighbours are left out; points without any valid neighbour get
+     *  nodata. Returns number of such points.
+     */
+    static std::size_t interpolate(const Grid &grid, std::size_t count
+                                   , const double *col, const double *row
+                                   , double *z);
+
+private:
+    const geo::GeoDataset &dem_;
+    int blockSize_;
+};
+
+/** Samples heights of all vertices of vector dataset in one batch when
+ *  config.batchSampling is set: vertices are converted to DEM's SRS,
+ *  sampled by DemSampler, converted to output SRS and vertically adjusted
+ *  (all per batch). Returns in-memory copy of the dataset with final 3D
+ *  coordinates and turns config into plain conversion (mode never) of it.
+ *
+ *  Returns null (config untouched) when batch sampling is off or does not
+ *  apply: more DEMs than one, mode never, 3D input in auto mode, layer
+ *  without SRS or a vertex without height. libgeo samples on its own then.
+ */
+std::shared_ptr< ::GDALDataset>
+sampleHeights(::GDALDataset &ds
+              , const std::vector<const geo::GeoDataset*> &rasters
+              , GdalWarper::HeightcodeConfig &config);
+
+#endif // mapproxy_gdalsupport_demsampler_hpp_included_
@@ -0,0 +1,166 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef mapproxy_gdalsupport_dispatch_hpp_included_
+#define mapproxy_gdalsupport_dispatch_hpp_included_
+
+/** Request dispatch policies of the GDAL warper, independent of the
+ *  shared-memory queue they operate on (all state is passed in).
+ */
+
+#include <array>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+
+namespace dispatch {
+
+/** Smooth weighted round-robin over priority lanes: every pending lane
+ *  gains its weight (at least 1) in credit, lanes are ordered by credit
+ *  (highest first) with lanes without pending requests last. Lane that
+ *  gets served pays the returned total weight of all pending lanes:
+ *
+ *      credit[served] -= total;
+ *
+ *  Credit is left untouched if nothing is served.
+ */
+template <std::size_t Count>
+std::int64_t laneOrder(const std::array<bool, Count> &pending
+                       , const std::array<unsigned int, Count> &weights
+                       , std::array<std::int64_t, Count> &credit
+                       , std::array<std::size_t, Count> &order)
+{
+    std::int64_t total(0);
+    for (std::size_t lane(0); lane < Count; ++lane) {
+        order[lane] = lane;
+        if (!pending[lane]) { continue; }
+        const std::int64_t weight(std::max(weights[lane], 1u));
+        credit[lane] += weight;
+        total += weight;
+    }
+
+    std::stable_sort(order.begin(), order.end()
+                     , [&](std::size_t l, std::size_t r)
+    {
+        if (pending[l] != pending[r]) { return pending[l]; }
+        return credit[l] > credit[r];
+    });
+
+    return total;
+}
+
+/** Tells whether request for given dataset is held back by the dataset's
+ *  concurrency cap (0 = no cap): dispatch maps affinity key to dispatch
+ *  state with number of workers processing the dataset in member running.
+ */
+template <typename Table>
+bool capped(const Table &dispatch, std::size_t affinity
+            , unsigned int concurrency)
+{
+    if (!concurrency) { return false; }
+    const auto fdispatch(dispatch.find(affinity));
+    return ((fdispatch != dispatch.end())
+            && (fdispatch->second.running >= concurrency));
+}
+
+/** Source of request picked by pick().
+ */
+enum class Pick {
+    /** nothing for this worker */
+    none
+    /** request for a dataset this worker has open */
+    , own
+    /** request for a dataset nobody has open or without any dataset */
+    , free
+    /** request waiting for another worker for too long */
+    , steal
+};
+
+/** Picks request for worker pid from queue [begin, end) of request
+ *  pointers, the most recent (last) request first. Own request wins over
+ *  free one, free one over stolen one; request bound to another worker is
+ *  stolen only after waiting for stealDelay. Requests not passing
+ *  eligible(request) are skipped.
+ *
+ *  Owners maps (non-zero) affinity key to worker having the dataset open;
+ *  claiming dataset of picked free or stolen request is up to the caller.
+ */
+template <typename Iterator, typename Owners, typename Id, typename Time
+          , typename Duration, typename Eligible>
+std::pair<Iterator, Pick> pick(Iterator begin, Iterator end
+                               , const Owners &owners, const Id &pid
+                               , const Time &now, const Duration &stealDelay
+                               , Eligible eligible)
+{
+    auto free(end), steal(end);
+
+    for (auto i(end); i != begin; ) {
+        --i;
+        if (!eligible(**i)) { continue; }
+
+        const auto affinity((*i)->affinity());
+        if (!affinity) {
+            if (free == end) { free = i; }
+            continue;
+        }
+
+        const auto fowners(owners.find(affinity));
+        if (fowners == owners.end()) {
+            // nobody has this dataset open
+            if (free == end) { free = i; }
+            continue;
+        }
+
+        // our dataset
+        if (fowners->second == pid) { return { i, Pick::own }; }
+
+        // bound to other worker; steal if waiting for too long
+        if ((steal == end) && ((now - (*i)->enqueued()) >= stealDelay)) {
+            steal = i;
+        }
+    }
+
+    if (free != end) { return { free, Pick::free }; }
+    if (steal != end) { return { steal, Pick::steal }; }
+    return { end, Pick::none };
+}
+
+/** Picks the most recent eligible request (plain LIFO), returns end if
+ *  there is none.
+ */
+template <typename Iterator, typename Eligible>
+Iterator pickLast(Iterator begin, Iterator end, Eligible eligible)
+{
+    for (auto i(end); i != begin; ) {
+        --i;
+        if (eligible(**i)) { return i; }
+    }
+    return end;
+}
+
+} // namespace dispatch
+
+#endif // mapproxy_gdalsupport_dispatch_hpp_included_
@@ -25,19 +25,39 @@
  */
 
 #include <sys/types.h>
+#include <sys/prctl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
 #include <signal.h>
+#include <time.h>
 
 #include <new>
 #include <array>
 #include <atomic>
 #include <thread>
+#include <set>
 #include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <functional>
+#include <future>
+#include <list>
+#include <memory>
+#include <numeric>
+#include <mutex>
+#include <sstream>
 
 #include <boost/noncopyable.hpp>
 #include <boost/format.hpp>
+#include <boost/algorithm/string/predicate.hpp>
 #include <boost/asio.hpp>
 #include <boost/asio/steady_timer.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/interprocess/containers/map.hpp>
+
+#include <opencv2/imgproc/imgproc.hpp>
 
 #include "utility/errorcode.hpp"
 #include "utility/procstat.hpp"
@@ -45,17 +65,35 @@
 
 #include "geo/gdal.hpp"
 
+#include <gdal.h>
+
 #include "../error.hpp"
 #include "../gdalsupport.hpp"
+#include "../support/profiler.hpp"
+#include "../support/probes.hpp"
+#include "../support/sharedcache.hpp"
 #include "process.hpp"
 #include "datasetcache.hpp"
 #include "types.hpp"
 #include "operations.hpp"
 #include "requests.hpp"
 #include "workrequest.hpp"
+#include "dispatch.hpp"
+#include "coalescer.hpp"
+#include "heightcodebatch.hpp"
+#include "probe.hpp"
+#include "segment.hpp"
+#include "latency.hpp"
+#include "costmodel.hpp"
+#include "matpool.hpp"
+#include "reclaimer.hpp"
+#include "pinning.hpp"
+#include "autoscaler.hpp"
+#include "interner.hpp"
 
 namespace asio = boost::asio;
 namespace bs = boost::system;
+namespace ba = boost::algorithm;
 
 namespace {
 
@@ -75,6 +113,286 @@ SystemTime absTime(const Delta &delta)
 
 typedef boost::posix_time::milliseconds milliseconds;
 
+/** How often (in milliseconds) request waiting for free response memory
+ *  rechecks it without being notified.
+ */
+const long MemoryRecheck(100);
+
+/** How often measured request costs are saved into the cost file.
+ */
+const std::chrono::minutes CostSavePeriod(5);
+
+/** CPU time consumed by this process (or by this thread only if
+ *  thisThread is set) in microseconds.
+ */
+std::uint64_t processCpuTime(bool thisThread = false)
+{
+    struct timespec ts;
+    if (::clock_gettime(thisThread ? CLOCK_THREAD_CPUTIME_ID
+                        : CLOCK_PROCESS_CPUTIME_ID, &ts) == -1)
+    {
+        return 0;
+    }
+    return std::uint64_t(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+/** Minor and major page fault counts of this process (or of this thread
+ *  only if thisThread is set).
+ */
+std::pair<std::uint64_t, std::uint64_t> pageFaults(bool thisThread = false)
+{
+    struct rusage ru;
+    if (::getrusage(thisThread ? RUSAGE_THREAD : RUSAGE_SELF, &ru) == -1) {
+        return { 0, 0 };
+    }
+    return { std::uint64_t(ru.ru_minflt), std::uint64_t(ru.ru_majflt) };
+}
+
+/** CPU clock of the request being processed by this worker thread. The
+ *  request stores its CPU time when it is finished in this thread.
+ */
+struct ProcessingCpu {
+    const void *request = nullptr;
+    bool thisThread = false;
+    std::uint64_t start = 0;
+};
+
+thread_local ProcessingCpu processingCpu;
+
+/** Kernel ID of calling thread. Unique among processes and threads, used as
+ *  worker ID by the threads backend.
+ */
+inline Process::Id threadId()
+{
+    return static_cast<Process::Id>(::syscall(SYS_gettid));
+}
+
+/** Dataset affinity key. Zero means no affinity.
+ */
+inline std::size_t datasetAffinity(const std::string &dataset)
+{
+    if (dataset.empty()) { return 0; }
+    const auto hash(std::hash<std::string>()(dataset));
+    // 0 is reserved for "no affinity"
+    return hash ? hash : 1;
+}
+
+/** Maps dataset affinity key to the worker process that has the dataset
+ *  open.
+ */
+typedef bi::map<std::size_t, Process::Id, std::less<std::size_t>
+                , bi::allocator<std::pair<const std::size_t, Process::Id>
+                                , SegmentManager>
+                > AffinityTable;
+
+/** Usage of single dataset, used to pre-warm new worker processes.
+ */
+struct DatasetUsage {
+    String path;
+    std::uint64_t hits;
+
+    DatasetUsage(const std::string &path, ManagedBuffer &mb)
+        : path(path.data(), path.size(), mb.get_allocator<char>()), hits()
+    {}
+};
+
+/** Dataset usage indexed by dataset affinity key. Guarded by the warper
+ *  mutex.
+ */
+typedef bi::map<std::size_t, DatasetUsage, std::less<std::size_t>
+                , bi::allocator<std::pair<const std::size_t, DatasetUsage>
+                                , SegmentManager>
+                > DatasetUsageTable;
+
+/** GDAL block cache usage of single dataset summed over all workers.
+ */
+struct BlockUsage {
+    String path;
+
+    /** Requests served without loading any block.
+     */
+    std::uint64_t hits;
+
+    /** Requests that loaded blocks.
+     */
+    std::uint64_t misses;
+
+    BlockUsage(const std::string &path, ManagedBuffer &mb)
+        : path(path.data(), path.size(), mb.get_allocator<char>())
+        , hits(), misses()
+    {}
+};
+
+/** Block cache usage indexed by dataset affinity key. Guarded by the warper
+ *  mutex.
+ */
+typedef bi::map<std::size_t, BlockUsage, std::less<std::size_t>
+                , bi::allocator<std::pair<const std::size_t, BlockUsage>
+                                , SegmentManager>
+                > BlockUsageTable;
+
+/** Dispatch of requests for single dataset to workers.
+ */
+struct DatasetDispatch {
+    String path;
+
+    /** Number of workers processing requests for this dataset right now.
+     */
+    unsigned int running;
+
+    /** Requests dispatched so far.
+     */
+    std::uint64_t dispatched;
+
+    /** Sum and maximum of time (in microseconds) dispatched requests spent
+     *  in the queue.
+     */
+    std::uint64_t waitSum;
+    std::uint64_t waitMax;
+
+    /** Dispatched requests held back by the concurrency limit before.
+     */
+    std::uint64_t deferred;
+
+    DatasetDispatch(const std::string &path, ManagedBuffer &mb)
+        : path(path.data(), path.size(), mb.get_allocator<char>())
+        , running(), dispatched(), waitSum(), waitMax(), deferred()
+    {}
+};
+
+/** Dataset dispatch indexed by dataset affinity key. Guarded by the warper
+ *  mutex.
+ */
+typedef bi::map<std::size_t, DatasetDispatch, std::less<std::size_t>
+                , bi::allocator<std::pair<const std::size_t, DatasetDispatch>
+                                , SegmentManager>
+                > DatasetDispatchTable;
+
+/** Dataset every worker is asked to open (see GdalWarper::warm).
+ */
+struct WarmEntry {
+    /** Increasing sequence number.
+     */
+    std::uint64_t generation;
+    String path;
+
+    WarmEntry(std::uint64_t generation, const std::string &path
+              , ManagedBuffer &mb)
+        : generation(generation)
+        , path(path.data(), path.size(), mb.get_allocator<char>())
+    {}
+};
+
+/** Datasets to warm, newest last. Guarded by the warper mutex.
+ */
+typedef bi::deque<WarmEntry, bi::allocator<WarmEntry, SegmentManager>>
+    WarmList;
+
+/** Maximum number of remembered datasets to warm; workers busy for longer
+ *  than it takes to queue that many miss the oldest ones.
+ */
+constexpr std::size_t WarmListLimit(256);
+
+/** Affinity dispatch statistics, shared by all processes.
+ */
+struct AffinityStats {
+    std::atomic<std::uint64_t> hit;
+    std::atomic<std::uint64_t> miss;
+    std::atomic<std::uint64_t> steal;
+
+    AffinityStats() : hit(0), miss(0), steal(0) {}
+};
+
+/** Statistics of requests aborted by clients, shared by all processes. CPU
+ *  times are in microseconds.
+ */
+struct AbortStats {
+    /** Requests dropped from the queue before processing. */
+    std::atomic<std::uint64_t> dropped;
+
+    /** Requests aborted while being processed and CPU time spent on them. */
+    std::atomic<std::uint64_t> cancelled;
+    std::atomic<std::uint64_t> cancelledCpu;
+
+    /** Requests past client's deadline dropped from the queue and
+     *  cancelled while being processed (and CPU time spent on the latter).
+     */
+    std::atomic<std::uint64_t> deadlineDropped;
+    std::atomic<std::uint64_t> deadlineCancelled;
+    std::atomic<std::uint64_t> deadlineCancelledCpu;
+
+    /** Regularly finished requests and CPU time spent on them. */
+    std::atomic<std::uint64_t> finished;
+    std::atomic<std::uint64_t> finishedCpu;
+
+    AbortStats()
+        : dropped(0), cancelled(0), cancelledCpu(0)
+        , deadlineDropped(0), deadlineCancelled(0), deadlineCancelledCpu(0)
+        , finished(0), finishedCpu(0)
+    {}
+};
+
+/** Priority lane scheduling state and statistics, shared by all processes.
+ *  Credits are guarded by the warper mutex.
+ */
+struct QueueStats {
+    std::array<std::int64_t, GdalWarper::PriorityCount> credit;
+    std::array<std::atomic<std::uint64_t>, GdalWarper::PriorityCount> served;
+    std::atomic<std::uint64_t> expired;
+
+    QueueStats() : credit{}, expired(0) {
+        for (auto &s : served) { s = 0; }
+    }
+};
+
+/** Worker process lifecycle statistics, shared by all processes.
+ */
+struct ProcessStats {
+    /** Worker processes started (including the initial ones). */
+    std::atomic<std::uint64_t> spawned;
+
+    /** Worker processes terminated unexpectedly. */
+    std::atomic<std::uint64_t> crashed;
+
+    /** Worker processes recycled after draining. */
+    std::atomic<std::uint64_t> recycled;
+
+    ProcessStats() : spawned(0), crashed(0), recycled(0) {}
+};
+
+const char *operationName(GdalWarper::RasterRequest::Operation operation)
+{
+    typedef GdalWarper::RasterRequest::Operation Operation;
+    switch (operation) {
+    case Operation::image: return "image";
+    case Operation::imageNoOpt: return "imageNoOpt";
+    case Operation::imageNoExpand: return "imageNoExpand";
+    case Operation::mask: return "mask";
+    case Operation::maskNoOpt: return "maskNoOpt";
+    case Operation::detailMask: return "detailMask";
+    case Operation::dem: return "dem";
+    case Operation::demOptimal: return "demOptimal";
+    case Operation::valueMinMax: return "valueMinMax";
+    case Operation::demFloat: return "demFloat";
+    case Operation::demOptimalFloat: return "demOptimalFloat";
+    case Operation::valueMinMaxFloat: return "valueMinMaxFloat";
+    case Operation::none: return "none";
+    }
+    return "unknown";
+}
+
+const char *priorityName(GdalWarper::Priority priority)
+{
+    switch (priority) {
+    case GdalWarper::Priority::tile: return "tile";
+    case GdalWarper::Priority::mesh: return "mesh";
+    case GdalWarper::Priority::imagery: return "imagery";
+    case GdalWarper::Priority::mask: return "mask";
+    case GdalWarper::Priority::background: return "background";
+    }
+    return "unknown";
+}
+
 /** TODO: check for allocation failures.
  */
 class ShRequest : boost::noncopyable, public ShRequestBase {
@@ -85,8 +403,9 @@ public:
 
     typedef bi::deque<pointer, bi::allocator<pointer, SegmentManager>> Deque;
 
-    ShRequest(const GdalWarper::RasterRequest &other, ManagedBuffer &sm)
-        : sm_(sm)
+    ShRequest(const GdalWarper::RasterRequest &other, ManagedBuffer &sm
+              , ManagedBuffer &data)
+        : sm_(sm), data_(data)
         , raster_(sm.construct<ShRaster>
                   (bi::anonymous_instance)(other, sm, this))
         , rasterWP_()
@@ -96,10 +415,20 @@ public:
         , error_(sm.get_allocator<char>())
         , errorType_(ErrorType::none)
         , ec_()
+        , affinity_(datasetAffinity(other.dataset))
+        , enqueued_(systemTime())
+        , aborted_(false)
+        , priority_(other.priority)
+        , notify_()
+        , picked_(), opened_(), finished_(), cpu_(), predicted_()
+        , traceId_()
+        , deadline_()
+        , concurrency_(), deferred_(false)
     {}
 
-    ShRequest(const GdalWarper::RasterRequestWP &other, ManagedBuffer &sm)
-        : sm_(sm)
+    ShRequest(const GdalWarper::RasterRequestWP &other, ManagedBuffer &sm
+              , ManagedBuffer &data)
+        : sm_(sm), data_(data)
         , raster_()
         , rasterWP_(sm.construct<ShRasterWP>
                   (bi::anonymous_instance)(other, sm, this))
@@ -109,16 +438,25 @@ public:
         , error_(sm.get_allocator<char>())
         , errorType_(ErrorType::none)
         , ec_()
+        , affinity_(datasetAffinity(other.dataset))
+        , enqueued_(systemTime())
+        , aborted_(false)
+        , priority_(other.priority)
+        , notify_()
+        , picked_(), opened_(), finished_(), cpu_(), predicted_()
+        , traceId_()
+        , deadline_()
+        , concurrency_(), deferred_(false)
     {}
 
     ShRequest(const std::string &vectorDs
               , const DemDataset::list &rasterDs
-              , const geo::heightcoding::Config &config
+              , const GdalWarper::HeightcodeConfig &config
               , const boost::optional<std::string> &vectorGeoidGrid
               , const GdalWarper::OpenOptions &openOptions
               , const LayerEnhancer::map &layerEnhancers
-              , ManagedBuffer &sm)
-        : sm_(sm)
+              , ManagedBuffer &sm, ManagedBuffer &data)
+        : sm_(sm), data_(data)
         , raster_()
         , rasterWP_()
         , heightcode_(sm.construct<ShHeightCode>
@@ -130,11 +468,20 @@ public:
         , error_(sm.get_allocator<char>())
         , errorType_(ErrorType::none)
         , ec_()
+        , affinity_(datasetAffinity(vectorDs))
+        , enqueued_(systemTime())
+        , aborted_(false)
+        , priority_(GdalWarper::Priority::mesh)
+        , notify_()
+        , picked_(), opened_(), finished_(), cpu_(), predicted_()
+        , traceId_()
+        , deadline_()
+        , concurrency_(), deferred_(false)
     {}
 
     ShRequest(const GdalWarper::WorkGenerator &workGenerator
-              , ManagedBuffer &sm)
-        : sm_(sm)
+              , ManagedBuffer &sm, ManagedBuffer &data)
+        : sm_(sm), data_(data)
         , raster_()
         , rasterWP_()
         , heightcode_()
@@ -143,98 +490,255 @@ public:
         , error_(sm.get_allocator<char>())
         , errorType_(ErrorType::none)
         , ec_()
+        , affinity_()
+        , enqueued_(systemTime())
+        , aborted_(false)
+        , priority_(GdalWarper::Priority::mesh)
+        , notify_()
+        , picked_(), opened_(), finished_(), cpu_(), predicted_()
+        , traceId_()
+        , deadline_()
+        , concurrency_(), deferred_(false)
     {
         work_ = workGenerator(sm);
     }
 
     ~ShRequest() {
-        if (raster_) { sm_.destroy_ptr(raster_); }
-        if (heightcode_) { sm_.destroy_ptr(heightcode_); }
+        // unclaimed responses live in the data arena
+        if (raster_) {
+            if (auto *response = raster_->response()) {
+                MatPool::deallocate(data_, response);
+            }
+            sm_.destroy_ptr(raster_);
+        }
+        if (rasterWP_) {
+            if (auto *response = rasterWP_->response()) {
+                MatPool::deallocate(data_, response);
+            }
+            sm_.destroy_ptr(rasterWP_);
+        }
+        if (heightcode_) {
+            if (auto *response = heightcode_->response()) {
+                data_.deallocate(response);
+            }
+            sm_.destroy_ptr(heightcode_);
+        }
         if (work_) { work_->destroy(); }
     }
 
+    /** Fails request. Caller must not hold the global lock; it is taken
+     *  only to notify the asynchronous completion condition (if any).
+     */
     template <typename T>
     void setError(bi::interprocess_mutex &mutex, const T &what);
 
-    void setError(Lock&, const char *message);
-    void setError(Lock&, const std::exception &e);
-    void setError(Lock&, const utility::HttpError &exc);
-    void setError(Lock&, const EmptyImage &exc);
-    void setError(Lock&, const FullImage &exc);
-    void setError(Lock&, const EmptyGeoData &exc);
+    /** Fails request. Caller holds the global lock.
+     */
+    template <typename T>
+    void setError(Lock &lock, const T &what);
+
+    /** Response getters. Wait for the request to finish on its own lock
+     *  and condition; the global lock must not be held.
+     */
+    GdalWarper::Raster getRaster(Reclaimer &reclaimer);
+    GdalWarper::Heightcoded::pointer getHeightcoded(Reclaimer &reclaimer);
+    WorkRequest::Response consumeWork();
 
-    GdalWarper::Raster getRaster(Lock &lock);
+    virtual void done_impl();
 
-    [[maybe_unused]]
-    GdalWarper::Raster getRaster(bi::interprocess_mutex &mutex);
+    /** Dataset affinity key, zero if request is not bound to any dataset.
+     */
+    std::size_t affinity() const { return affinity_; }
 
-    GdalWarper::Heightcoded::pointer getHeightcoded(Lock &lock);
+    /** Time when this request was created.
+     */
+    const SystemTime& enqueued() const { return enqueued_; }
 
-    [[maybe_unused]]
-    GdalWarper::Heightcoded::pointer getHeightcoded(bi::interprocess_mutex &mutex);
+    /** Marks request as aborted and wakes up the waiting client. Running
+     *  warp is stopped at the next check.
+     */
+    void abort(bi::interprocess_mutex &mutex);
 
-    WorkRequest::Response consumeWork(Lock &lock);
+    bool aborted() const { return aborted_; }
 
-    virtual void done_impl();
+    /** Queue lane of this request.
+     */
+    GdalWarper::Priority priority() const { return priority_; }
+
+    /** Moves request to another lane. Must be called before enqueueing.
+     */
+    void priority(GdalWarper::Priority priority) { priority_ = priority; }
+
+    /** Throws RequestAborted if this request has been aborted or
+     *  DeadlineExceeded if it is past client's deadline.
+     */
+    void checkAborted() const;
+
+    /** Request has been processed (or failed).
+     */
+    bool finished() const { return done_; }
+
+    /** Additional condition notified when this request is finished. Must be
+     *  set before the request is enqueued.
+     */
+    void notify(bi::interprocess_condition *cond) { notify_ = cond; }
+
+    /** Marks request as picked up by a worker. Must be called under lock.
+     */
+    void picked() { picked_ = systemTime(); }
+
+    /** CPU time (in microseconds) the worker spent on the request until it
+     *  finished (0 if not processed by a worker).
+     */
+    std::uint64_t cpu() const { return cpu_; }
+
+    /** Trace ID of the client request (names stack samples). Must be set
+     *  before the request is enqueued.
+     */
+    std::uint64_t traceId() const { return traceId_; }
+    void traceId(std::uint64_t value) { traceId_ = value; }
+
+    /** Client's deadline (in microseconds since the Unix epoch, 0 = none).
+     *  Must be set before the request is enqueued.
+     */
+    void deadline(std::uint64_t value);
+
+    /** Request is past client's deadline.
+     */
+    bool expired(const SystemTime &now) const {
+        return !deadline_.is_special() && (now > deadline_);
+    }
+
+    /** Maximum number of workers processing requests for this request's
+     *  dataset at once (0 = unlimited). Must be set before the request is
+     *  enqueued.
+     */
+    unsigned int concurrency() const { return concurrency_; }
+    void concurrency(unsigned int value) { concurrency_ = value; }
+
+    /** Request has been held in the queue by its dataset's concurrency
+     *  limit. Must be accessed under lock.
+     */
+    bool deferred() const { return deferred_; }
+    void deferred(bool value) { deferred_ = value; }
+
+    /** Request's dataset is held in the dataset cache.
+     */
+    bool cachesDataset() const { return raster_ || rasterWP_; }
+
+    /** Operation and dataset name for latency statistics.
+     */
+    std::string operationName() const;
+    std::string dataset() const;
+
+    /** Overview chosen by overview selection policy (raster requests only).
+     */
+    boost::optional<int> overview() const {
+        if (raster_) { return raster_->overview(); }
+        return boost::none;
+    }
+
+    /** Number of requested pixels (raster requests only, 0 otherwise).
+     */
+    std::uint64_t pixels() const {
+        return raster_ ? math::area(raster_->size()) : 0;
+    }
+
+    /** Cost model key and size (see CostModel), incl. DEM processing.
+     */
+    int costLod() const;
+    std::uint64_t costPixels() const;
+
+    /** Worker wall time (in microseconds) from pickup until finished (0 if
+     *  not processed by a worker).
+     */
+    std::uint64_t processing() const;
+
+    /** Worker wall time predicted when the request was enqueued (0 = no
+     *  prediction). Must be set before the request is enqueued.
+     */
+    std::uint64_t predicted() const { return predicted_; }
+    void predicted(std::uint64_t value) { predicted_ = value; }
+
+    /** Stage durations of finished request consumed at given time. Must be
+     *  called after the response has been taken.
+     */
+    LatencyStats::Durations durations(const SystemTime &consumed) const;
+
+    /** Prints single in-flight dump line of this request processed (or
+     *  queued if 0) by given worker. Must be called under lock.
+     */
+    void dump(std::ostream &os, Process::Id worker, const SystemTime &now)
+        const;
 
     // called in  workers
     void process(bi::interprocess_mutex &mutex, DatasetCache &cache);
 
     // called in the main thread
     static pointer create(const GdalWarper::RasterRequest &req
-                          , ManagedBuffer &mb)
+                          , ManagedBuffer &mb, ManagedBuffer &data)
     {
         return pointer(mb.construct<ShRequest>
-                       (bi::anonymous_instance)(req, mb)
+                       (bi::anonymous_instance)(req, mb, data)
                        , mb.get_allocator<void>()
                        , mb.get_deleter<ShRequest>());
     }
 
     static pointer create(const GdalWarper::RasterRequestWP &req
-                          , ManagedBuffer &mb)
+                          , ManagedBuffer &mb, ManagedBuffer &data)
     {
         return pointer(mb.construct<ShRequest>
-                       (bi::anonymous_instance)(req, mb)
+                       (bi::anonymous_instance)(req, mb, data)
                        , mb.get_allocator<void>()
                        , mb.get_deleter<ShRequest>());
     }
 
     static pointer create(const std::string &vectorDs
                           , const DemDataset::list &rasterDs
-                          , const geo::heightcoding::Config &config
+                          , const GdalWarper::HeightcodeConfig &config
                           , const boost::optional<std::string> &vectorGeoidGrid
                           , const std::vector<std::string> &openOptions
                           , const LayerEnhancer::map &layerEnhancers
-                          , ManagedBuffer &mb)
+                          , ManagedBuffer &mb, ManagedBuffer &data)
     {
         return pointer(mb.construct<ShRequest>
                        (bi::anonymous_instance)
                        (vectorDs, rasterDs, config, vectorGeoidGrid
-                        , openOptions, layerEnhancers, mb)
+                        , openOptions, layerEnhancers, mb, data)
                        , mb.get_allocator<void>()
                        , mb.get_deleter<ShRequest>());
     }
 
     static pointer create(const GdalWarper::WorkGenerator &workGenerator
-                          , ManagedBuffer &mb)
+                          , ManagedBuffer &mb, ManagedBuffer &data)
     {
         return pointer(mb.construct<ShRequest>
-                       (bi::anonymous_instance)(workGenerator, mb)
+                       (bi::anonymous_instance)(workGenerator, mb, data)
                        , mb.get_allocator<void>()
                        , mb.get_deleter<ShRequest>());
     }
 
 private:
+    /** Control arena: request itself.
+     */
     ManagedBuffer &sm_;
 
+    /** Data arena: response data.
+     */
+    ManagedBuffer &data_;
+
     ShRaster *raster_;
     ShRasterWP *rasterWP_;
     ShHeightCode *heightcode_;
     WorkRequest *work_;
 
+    // request's own lock, guards response and error; completion never
+    // touches the global lock unless somebody waits on notify_
+    Mutex mutex_;
+
     // response condition and flag
     bi::interprocess_condition cond_;
-    bool done_;
+    std::atomic<bool> done_;
 
     // response error
     String error_;
@@ -245,132 +749,378 @@ private:
     };
     ErrorType errorType_;
     std::error_code ec_;
+
+    std::size_t affinity_;
+    SystemTime enqueued_;
+
+    // set by the client side, polled by worker without lock
+    std::atomic<bool> aborted_;
+
+    GdalWarper::Priority priority_;
+
+    bi::interprocess_condition *notify_;
+
+    // processing timestamps (pickup, dataset open, response)
+    SystemTime picked_;
+    SystemTime opened_;
+    SystemTime finished_;
+
+    // worker CPU time, set when finished by the worker
+    std::uint64_t cpu_;
+
+    // predicted worker wall time
+    std::uint64_t predicted_;
+
+    std::uint64_t traceId_;
+
+    // client's deadline, not_a_date_time if none
+    SystemTime deadline_;
+
+    // per-dataset concurrency limit and whether it has held the request
+    unsigned int concurrency_;
+    bool deferred_;
+
+    /** Marks request as finished. Must be called under request lock.
+     */
+    void finish();
+
+    /** Notifies asynchronous completion condition, if set. Must be called
+     *  after request lock has been released (lock order is global lock
+     *  first).
+     */
+    void notifyFinished(Lock &lock);
+    void notifyFinished(bi::interprocess_mutex &mutex);
+
+    /** Records error, returns false if an error has already been recorded.
+     */
+    bool fail(const char *message);
+    bool fail(const std::exception &e);
+    bool fail(const utility::HttpError &exc);
+    bool fail(const EmptyImage &exc);
+    bool fail(const FullImage &exc);
+    bool fail(const EmptyGeoData &exc);
+
+    /** Waits for the request to finish.
+     */
+    void wait(Lock &lock);
+
+    /** Throws recorded error. Must be called under request lock.
+     */
+    [[noreturn]] void throwError() const;
+};
+
+/** Statistics published by single worker process. Guarded by the warper
+ *  mutex.
+ */
+struct WorkerStats {
+    std::size_t id;
+    std::size_t datasets;
+    std::size_t vectors;
+    DatasetCache::Stats cache;
+
+    /** Page faults when the worker started and now.
+     */
+    std::uint64_t startMinorFaults;
+    std::uint64_t startMajorFaults;
+    std::uint64_t minorFaults;
+    std::uint64_t majorFaults;
+
+    /** Request being processed (if any).
+     */
+    ShRequest::pointer request;
+
+    WorkerStats()
+        : id(), datasets(), vectors(), startMinorFaults(), startMajorFaults()
+        , minorFaults(), majorFaults()
+    {}
 };
 
+typedef bi::map<Process::Id, WorkerStats, std::less<Process::Id>
+                , bi::allocator<std::pair<const Process::Id, WorkerStats>
+                                , SegmentManager>
+                > WorkerStatsTable;
+
 void ShRequest::process(bi::interprocess_mutex &mutex, DatasetCache &cache)
 {
+    const CheckAborted checkAborted([this]() { this->checkAborted(); });
+
+    // open source dataset upfront to measure its opening time separately;
+    // other requests open their datasets as part of processing
+    if (raster_) {
+        cache(raster_->dataset());
+    } else if (rasterWP_) {
+        cache(rasterWP_->dataset());
+    }
+    opened_ = systemTime();
+
     if (raster_) {
-        raster_->response(mutex, ::warp(cache, sm_, *raster_));
+        boost::optional<int> overview;
+        auto *response(::warp(cache, data_, *raster_, checkAborted
+                              , &overview));
+        raster_->overview(overview);
+        raster_->response(mutex_, response);
+        notifyFinished(mutex);
         return;
     }
 
     if (rasterWP_) {
-        rasterWP_->response(mutex, ::warpWP(cache, sm_, *rasterWP_));
+        rasterWP_->response
+            (mutex_, ::warpWP(cache, data_, *rasterWP_, checkAborted));
+        notifyFinished(mutex);
         return;
     }
 
     if (heightcode_) {
         heightcode_->response
-            (mutex, ::heightcode(cache, sm_
+            (mutex_, ::heightcode(cache, data_
                                  , heightcode_->vectorDs()
                                  , heightcode_->rasterDs()
                                  , heightcode_->config()
                                  , heightcode_->vectorGeoidGrid()
                                  , heightcode_->openOptions()
                                  , heightcode_->layerEnhancers()));
+        notifyFinished(mutex);
         return;
     }
 
     if (work_) {
         work_->process(mutex, cache);
         {
-            Lock lock(mutex);
+            Lock lock(mutex_);
             done();
         }
+        notifyFinished(mutex);
         return;
     }
 
     setError(mutex, InternalError("No associated request."));
 }
 
-void ShRequest::done_impl()
+std::string ShRequest::operationName() const
 {
-    done_ = true;
-    cond_.notify_one();
+    if (raster_) { return ::operationName(raster_->operation()); }
+    if (rasterWP_) { return "demProcessing"; }
+    if (heightcode_) { return "heightcode"; }
+    return "job";
 }
 
-template <typename T>
-void ShRequest::setError(bi::interprocess_mutex &mutex, const T &what)
+std::string ShRequest::dataset() const
 {
-    Lock lock(mutex);
-    setError(lock, what);
+    if (raster_) { return raster_->dataset(); }
+    if (rasterWP_) { return rasterWP_->dataset(); }
+    if (heightcode_) { return heightcode_->vectorDs(); }
+    return {};
 }
 
-void ShRequest::setError(Lock&, const char *message)
+int ShRequest::costLod() const
 {
-    if (!error_.empty()) { return; }
-    error_.assign(message);
-    errorType_ = ErrorType::errorCode;
-    ec_ = make_error_code(utility::HttpCode::InternalServerError);
-    done_ = true;
-    cond_.notify_one();
+    if (raster_) { return ::costLod(raster_->extents(), raster_->size()); }
+    if (rasterWP_) {
+        return ::costLod(rasterWP_->extents(), rasterWP_->size());
+    }
+    return 0;
 }
 
-void ShRequest::setError(Lock&, const utility::HttpError &exc)
+std::uint64_t ShRequest::costPixels() const
 {
-    if (!error_.empty()) { return; }
-    error_.assign(exc.what());
-    errorType_ = ErrorType::errorCode;
-    ec_ = exc.code();
-    done_ = true;
-    cond_.notify_one();
+    if (raster_) { return math::area(raster_->size()); }
+    if (rasterWP_) { return math::area(rasterWP_->size()); }
+    return 0;
 }
 
-void ShRequest::setError(Lock&, const EmptyImage &exc)
+std::uint64_t ShRequest::processing() const
 {
-    if (!error_.empty()) { return; }
-    error_.assign(exc.what());
-    errorType_ = ErrorType::emptyImage;
-    done_ = true;
-    cond_.notify_one();
+    if (picked_.is_not_a_date_time() || finished_.is_not_a_date_time()
+        || (finished_ <= picked_))
+    {
+        return 0;
+    }
+    return (finished_ - picked_).total_microseconds();
 }
 
-void ShRequest::setError(Lock&, const FullImage &exc)
+LatencyStats::Durations ShRequest::durations(const SystemTime &consumed)
+    const
 {
-    if (!error_.empty()) { return; }
-    error_.assign(exc.what());
-    errorType_ = ErrorType::fullImage;
-    done_ = true;
-    cond_.notify_one();
+    // missing timestamps (request failed before reaching given stage)
+    // collapse to the following one
+    const auto finished
+        (finished_.is_not_a_date_time() ? consumed : finished_);
+    const auto picked(picked_.is_not_a_date_time() ? finished : picked_);
+    const auto opened(opened_.is_not_a_date_time() ? picked : opened_);
+
+    const auto usec([](const SystemTime &from, const SystemTime &to)
+                    -> std::uint64_t
+    {
+        if (to <= from) { return 0; }
+        return (to - from).total_microseconds();
+    });
+
+    LatencyStats::Durations durations;
+    durations[int(LatencyStage::queue)] = usec(enqueued_, picked);
+    durations[int(LatencyStage::open)] = usec(picked, opened);
+    durations[int(LatencyStage::warp)] = usec(opened, finished);
+    durations[int(LatencyStage::wakeup)] = usec(finished, consumed);
+    durations[int(LatencyStage::total)] = usec(enqueued_, consumed);
+    return durations;
 }
 
-void ShRequest::setError(Lock&, const EmptyGeoData &exc)
+void ShRequest::dump(std::ostream &os, Process::Id worker
+                     , const SystemTime &now) const
 {
-    if (!error_.empty()) { return; }
-    error_.assign(exc.what());
-    errorType_ = ErrorType::emptyGeoData;
+    const auto ms([](const SystemTime &from, const SystemTime &to)
+                  -> std::uint64_t
+    {
+        if (from.is_not_a_date_time() || (to <= from)) { return 0; }
+        return (to - from).total_milliseconds();
+    });
+
+    const auto picked(picked_.is_not_a_date_time() ? now : picked_);
+    const auto opened(opened_.is_not_a_date_time() ? now : opened_);
+
+    const auto ds(dataset());
+    os << "gdal.request operation=" << operationName()
+       << " dataset=" << (ds.empty() ? "-" : ds)
+       << " worker=";
+    if (worker) { os << worker; } else { os << '-'; }
+    os << " state="
+       << (!worker ? (deferred_ ? "deferred" : "queued")
+           : (opened_.is_not_a_date_time() ? "opening" : "warping"))
+       << " queued=" << ms(enqueued_, picked)
+       << "ms opening=" << (worker ? ms(picked_, opened) : 0)
+       << "ms warping=" << (worker ? ms(opened_, now) : 0)
+       << "ms aborted="
+       << (aborted_ ? "yes" : (expired(now) ? "deadline" : "no"))
+       << " trace=" << traceId_ << '\n';
+}
+
+void ShRequest::finish()
+{
+    if (processingCpu.request == this) {
+        cpu_ = processCpuTime(processingCpu.thisThread)
+            - processingCpu.start;
+    }
+    finished_ = systemTime();
     done_ = true;
     cond_.notify_one();
 }
 
-void ShRequest::setError(Lock &lock, const std::exception &e)
+void ShRequest::notifyFinished(Lock&)
 {
-    setError(lock, e.what());
+    if (notify_) { notify_->notify_all(); }
 }
 
-GdalWarper::Raster ShRequest::getRaster(Lock &lock)
+void ShRequest::notifyFinished(bi::interprocess_mutex &mutex)
 {
-    cond_.wait(lock, [&]()
-    {
-        return done_;
-    });
+    if (!notify_) { return; }
+    Lock lock(mutex);
+    notify_->notify_all();
+}
 
-    if (!raster_ && !rasterWP_) {
-        throw std::logic_error("This shared request is not handling a "
-                               "raster operation!");
-    }
+void ShRequest::abort(bi::interprocess_mutex &mutex)
+{
+    aborted_ = true;
+    setError(mutex, RequestAborted("Request has been aborted"));
+}
 
-    auto * response = raster_ ? raster_->response() : rasterWP_->response();
+void ShRequest::checkAborted() const
+{
+    if (aborted_) { throw RequestAborted("Request has been aborted"); }
+    if (expired(systemTime())) {
+        throw DeadlineExceeded("Request deadline passed during processing.");
+    }
+}
 
-    if (response) {
-        auto &sm(sm_);
-        return GdalWarper::Raster(response, [&sm](cv::Mat *mat)
-        {
-            // deallocate data
-            sm.deallocate(mat);
-        });
-    }
+void ShRequest::deadline(std::uint64_t value)
+{
+    if (!value) { deadline_ = SystemTime(); return; }
+    deadline_ = (SystemTime(boost::gregorian::date(1970, 1, 1))
+                 + boost::posix_time::microseconds(value));
+}
+
+void ShRequest::done_impl()
+{
+    finish();
+}
+
+template <typename T>
+void ShRequest::setError(bi::interprocess_mutex &mutex, const T &what)
+{
+    if (fail(what)) { notifyFinished(mutex); }
+}
+
+template <typename T>
+void ShRequest::setError(Lock &lock, const T &what)
+{
+    if (fail(what)) { notifyFinished(lock); }
+}
+
+bool ShRequest::fail(const char *message)
+{
+    Lock lock(mutex_);
+    if (!error_.empty()) { return false; }
+    error_.assign(message);
+    errorType_ = ErrorType::errorCode;
+    ec_ = make_error_code(utility::HttpCode::InternalServerError);
+    finish();
+    return true;
+}
+
+bool ShRequest::fail(const utility::HttpError &exc)
+{
+    Lock lock(mutex_);
+    if (!error_.empty()) { return false; }
+    error_.assign(exc.what());
+    errorType_ = ErrorType::errorCode;
+    ec_ = exc.code();
+    finish();
+    return true;
+}
 
+bool ShRequest::fail(const EmptyImage &exc)
+{
+    Lock lock(mutex_);
+    if (!error_.empty()) { return false; }
+    error_.assign(exc.what());
+    errorType_ = ErrorType::emptyImage;
+    finish();
+    return true;
+}
+
+bool ShRequest::fail(const FullImage &exc)
+{
+    Lock lock(mutex_);
+    if (!error_.empty()) { return false; }
+    error_.assign(exc.what());
+    errorType_ = ErrorType::fullImage;
+    finish();
+    return true;
+}
+
+bool ShRequest::fail(const EmptyGeoData &exc)
+{
+    Lock lock(mutex_);
+    if (!error_.empty()) { return false; }
+    error_.assign(exc.what());
+    errorType_ = ErrorType::emptyGeoData;
+    finish();
+    return true;
+}
+
+bool ShRequest::fail(const std::exception &e)
+{
+    return fail(e.what());
+}
+
+void ShRequest::wait(Lock &lock)
+{
+    cond_.wait(lock, [&]()
+    {
+        return bool(done_);
+    });
+}
+
+void ShRequest::throwError() const
+{
     switch (errorType_) {
     case ErrorType::none: break; // handled at the end of function
 
@@ -381,24 +1131,43 @@ GdalWarper::Raster ShRequest::getRaster(Lock &lock)
     case ErrorType::emptyGeoData: throw EmptyGeoData(asString(error_));
 
     case ErrorType::errorCode:
+        if (ec_ == make_error_code(utility::HttpCode::GatewayTimeout)) {
+            throw DeadlineExceeded(asString(error_));
+        }
         utility::throwErrorCode(ec_, asString(error_));
     }
 
     throw std::runtime_error("Unknown exception!");
 }
 
-GdalWarper::Raster ShRequest::getRaster(bi::interprocess_mutex &mutex)
+GdalWarper::Raster ShRequest::getRaster(Reclaimer &reclaimer)
 {
-    Lock lock(mutex);
-    return getRaster(lock);
+    Lock lock(mutex_);
+    wait(lock);
+
+    if (!raster_ && !rasterWP_) {
+        throw std::logic_error("This shared request is not handling a "
+                               "raster operation!");
+    }
+
+    auto * response = raster_ ? raster_->response() : rasterWP_->response();
+
+    if (response) {
+        return GdalWarper::Raster(response, [&reclaimer](cv::Mat *mat)
+        {
+            // return data to the pool, deferred
+            reclaimer.release(mat);
+        });
+    }
+
+    throwError();
 }
 
-GdalWarper::Heightcoded::pointer ShRequest::getHeightcoded(Lock &lock)
+GdalWarper::Heightcoded::pointer
+ShRequest::getHeightcoded(Reclaimer &reclaimer)
 {
-    cond_.wait(lock, [&]()
-    {
-        return done_;
-    });
+    Lock lock(mutex_);
+    wait(lock);
 
     // TODO: extend for other memblock-generating operations
 
@@ -408,61 +1177,28 @@ GdalWarper::Heightcoded::pointer ShRequest::getHeightcoded(Lock &lock)
     }
 
     if (auto *response = (heightcode_->response())) {
-        auto &sm(sm_);
         return GdalWarper::Heightcoded::pointer
-            (response, [&sm](GdalWarper::Heightcoded *block)
+            (response, [&reclaimer](GdalWarper::Heightcoded *block)
         {
             // deallocate data
-            sm.deallocate(block);
+            reclaimer.deallocate(block);
         });
     }
 
-    switch (errorType_) {
-    case ErrorType::none: break; // handled at the end of function
-
-    case ErrorType::emptyImage: throw EmptyImage(asString(error_));
-
-    case ErrorType::fullImage: throw FullImage(asString(error_));
-
-    case ErrorType::emptyGeoData: throw EmptyGeoData(asString(error_));
-
-    case ErrorType::errorCode:
-        utility::throwErrorCode(ec_, asString(error_));
-    }
-
-    throw std::runtime_error("Unknown exception!");
-}
-
-GdalWarper::Heightcoded::pointer
-ShRequest::getHeightcoded(bi::interprocess_mutex &mutex)
-{
-    Lock lock(mutex);
-    return getHeightcoded(lock);
+    throwError();
 }
 
-WorkRequest::Response ShRequest::consumeWork(Lock &lock)
+WorkRequest::Response ShRequest::consumeWork()
 {
-    cond_.wait(lock, [&]()
-    {
-        return done_;
-    });
+    Lock lock(mutex_);
+    wait(lock);
 
     if (!work_) {
         throw std::logic_error("This shared request is not handling a "
                                "job!");
     }
 
-    if (!error_.empty()) {
-        switch (errorType_) {
-        case ErrorType::none: break; // handled at the end of function
-        case ErrorType::emptyImage: throw EmptyImage(asString(error_));
-        case ErrorType::fullImage: throw FullImage(asString(error_));
-        case ErrorType::emptyGeoData: throw EmptyGeoData(asString(error_));
-        case ErrorType::errorCode:
-            utility::throwErrorCode(ec_, asString(error_));
-        }
-        throw std::runtime_error("Unknown exception!");
-    }
+    if (!error_.empty()) { throwError(); }
 
     return work_->response(lock);
 }
@@ -472,7 +1208,7 @@ struct Worker {
     typedef bi::shared_ptr<Worker, Allocator, Deleter> pointer;
     typedef std::map<Process::Id, pointer> map;
 
-    Worker() {}
+    Worker() : drain_(false), idle_(false), dispatched_() {}
 
     void attach(Process &&process) { process_ = std::move(process); }
 
@@ -502,10 +1238,29 @@ struct Worker {
 
     bool killed() const { return process_.killed(); }
 
+    /** Asks worker to finish its current request and exit.
+     */
+    void drain() { drain_ = true; }
+
+    bool draining() const { return drain_; }
+
+    /** Idle flag and wake-up condition of parked worker. Guarded by warper
+     *  mutex.
+     */
+    bool idle() const { return idle_; }
+    void idle(bool value) { idle_ = value; }
+    bi::interprocess_condition& wakeup() { return wakeup_; }
+
     void associate(const ShRequest::pointer &req) { req_ = req; }
 
     void disassociate() { req_ = {}; }
 
+    /** Affinity key of dataset this worker's current request is counted
+     *  against in the dispatch table (0 = none). Guarded by warper mutex.
+     */
+    std::size_t dispatched() const { return dispatched_; }
+    void dispatched(std::size_t value) { dispatched_ = value; }
+
     Process::Id id() const { return process_.id(); }
 
     void internalError(bi::interprocess_mutex &mutex)
@@ -531,8 +1286,367 @@ private:
     /** Processed request.
      */
     ShRequest::pointer req_;
+
+    /** Set when worker should exit after its current request.
+     */
+    std::atomic<bool> drain_;
+
+    /** Set while worker is parked waiting for work.
+     */
+    bool idle_;
+
+    /** Parked worker waits here, notified only when there is work for it.
+     */
+    bi::interprocess_condition wakeup_;
+
+    /** Dispatch table entry of current request.
+     */
+    std::size_t dispatched_;
+};
+
+/** Parked worker. Workers live in the control arena which is mapped at the
+ *  same address in all processes, plain pointer is fine.
+ */
+struct IdleWorker {
+    Process::Id pid;
+    Worker *worker;
+
+    IdleWorker(Process::Id pid, Worker *worker) : pid(pid), worker(worker) {}
+};
+
+typedef bi::vector<IdleWorker, bi::allocator<IdleWorker, SegmentManager>>
+    IdleWorkers;
+
+/** Minimum height of a strip of split raster request.
+ */
+constexpr int MinStripRows(16);
+
+/** Operations that produce the same result when warped in horizontal
+ *  strips. Masks are excluded since their full/empty optimization is
+ *  decided for the whole tile.
+ */
+bool splittable(GdalWarper::RasterRequest::Operation operation)
+{
+    typedef GdalWarper::RasterRequest::Operation Operation;
+    switch (operation) {
+    case Operation::image:
+    case Operation::imageNoOpt:
+    case Operation::imageNoExpand:
+    case Operation::dem:
+    case Operation::demFloat:
+    case Operation::valueMinMax:
+    case Operation::valueMinMaxFloat:
+        return true;
+
+    default: break;
+    }
+    return false;
+}
+
+/** Operations warped in grid registration: neighbouring strips share one
+ *  row.
+ */
+bool gridRegistered(GdalWarper::RasterRequest::Operation operation)
+{
+    typedef GdalWarper::RasterRequest::Operation Operation;
+    return ((operation == Operation::dem)
+            || (operation == Operation::demFloat));
+}
+
+/** Splits request into count horizontal strips (top strip first). Strips
+ *  keep request's pixel size, i.e. joined strips are identical to the
+ *  request warped in one pass.
+ */
+std::vector<GdalWarper::RasterRequest>
+splitRequest(const GdalWarper::RasterRequest &req, int count)
+{
+    const int height(req.size.height);
+    const double pixel((req.extents.ur(1) - req.extents.ll(1)) / height);
+
+    std::vector<GdalWarper::RasterRequest> strips;
+    strips.reserve(count);
+    for (int i(0), top(0); i < count; ++i) {
+        // spread remainder over top strips
+        const int rows(height / count + ((i < (height % count)) ? 1 : 0));
+        const int bottom(top + rows);
+
+        auto strip(req);
+        strip.size.height = rows;
+        strip.extents.ur(1) = req.extents.ur(1) - top * pixel;
+        strip.extents.ll(1) = ((bottom == height) ? req.extents.ll(1)
+                               : (req.extents.ur(1) - bottom * pixel));
+        strips.push_back(strip);
+
+        top = bottom;
+    }
+    return strips;
+}
+
+/** Result of single strip of split request.
+ */
+struct StripResult {
+    GdalWarper::Raster raster;
+    std::exception_ptr error;
+    bool empty;
+
+    StripResult() : empty(false) {}
+};
+
+typedef std::vector<StripResult> StripResults;
+
+/** Checks strip results. Throws first error or EmptyImage if no strip has
+ *  any valid data. Returns indices of strips without valid data that must be
+ *  warped again without the empty image optimization (strips of partially
+ *  covered image tile).
+ */
+std::vector<std::size_t>
+stripsToRetry(GdalWarper::RasterRequest::Operation operation
+              , const StripResults &results)
+{
+    for (const auto &result : results) {
+        if (result.error) { std::rethrow_exception(result.error); }
+    }
+
+    std::vector<std::size_t> retry;
+    for (std::size_t i(0); i < results.size(); ++i) {
+        if (results[i].empty) { retry.push_back(i); }
+    }
+
+    if (!retry.empty()
+        && ((retry.size() == results.size())
+            || (operation != GdalWarper::RasterRequest::Operation::image)))
+    {
+        throw EmptyImage("No valid data.");
+    }
+    return retry;
+}
+
+/** Joins strip rasters (top strip first) into single raster.
+ */
+GdalWarper::Raster joinStrips(GdalWarper::RasterRequest::Operation operation
+                              , const StripResults &results)
+{
+    const int overlap(gridRegistered(operation) ? 1 : 0);
+
+    const auto &first(*results.front().raster);
+    int rows(first.rows);
+    for (std::size_t i(1); i < results.size(); ++i) {
+        rows += results[i].raster->rows - overlap;
+    }
+
+    auto joined(std::make_shared<cv::Mat>(rows, first.cols, first.type()));
+    int row(0);
+    for (std::size_t i(0); i < results.size(); ++i) {
+        const auto &part(*results[i].raster);
+        const int skip(i ? overlap : 0);
+        const int height(part.rows - skip);
+        part.rowRange(skip, part.rows)
+            .copyTo(joined->rowRange(row, row + height));
+        row += height;
+    }
+    return joined;
+}
+
+/** Asynchronous split request in progress. Guarded by the warper mutex.
+ */
+struct StripJoin {
+    typedef std::shared_ptr<StripJoin> pointer;
+
+    GdalWarper::RasterRequest request;
+    std::vector<GdalWarper::RasterRequest> strips;
+    StripResults results;
+
+    /** Requests of current round.
+     */
+    std::vector<ShRequest::pointer> parts;
+    std::size_t remaining;
+
+    /** Empty strips are being warped again.
+     */
+    bool retried;
+    bool aborted;
+
+    Aborter::Tracer tracer;
+    std::uint64_t traceId;
+    std::uint64_t deadline;
+    GdalWarper::RasterCallback callback;
+
+    StripJoin(const GdalWarper::RasterRequest &request, int count
+              , const Aborter::Tracer &tracer
+              , const GdalWarper::RasterCallback &callback)
+        : request(request), strips(splitRequest(request, count))
+        , results(count), remaining(), retried(false), aborted(false)
+        , tracer(tracer), traceId(), deadline(), callback(callback)
+    {}
+};
+
+/** Raster header in the host-wide cache, followed by pixel data.
+ */
+struct SharedRaster {
+    int rows;
+    int cols;
+    int type;
+
+    /** Produced by optimized image warp, i.e. known to be non-empty.
+     */
+    int optimized;
+};
+
+/** Key of optimized variant of non-optimized image request (its raster is a
+ *  valid result of the latter), empty for other requests.
+ */
+std::string optimizedKey(const GdalWarper::RasterRequest &req)
+{
+    if (req.operation != GdalWarper::RasterRequest::Operation::imageNoOpt) {
+        return {};
+    }
+    auto optimized(req);
+    optimized.operation = GdalWarper::RasterRequest::Operation::image;
+    return optimized.key();
+}
+
+/** Size of canonical padded tile warp: 256 pixel tile with 2 pixel margin on
+ *  each side.
+ */
+constexpr int CanonicalPadded(260);
+
+/** Canonical padded warp serving a request and margin (in pixels) to crop
+ *  from its result on each side.
+ */
+struct Canonical {
+    GdalWarper::RasterRequest request;
+    int crop;
+
+    Canonical(const GdalWarper::RasterRequest &request, int crop)
+        : request(request), crop(crop)
+    {}
 };
 
+bool imageOperation(GdalWarper::RasterRequest::Operation operation)
+{
+    typedef GdalWarper::RasterRequest::Operation Operation;
+    return ((operation == Operation::image)
+            || (operation == Operation::imageNoOpt)
+            || (operation == Operation::imageNoExpand));
+}
+
+/** Canonical padded warp of given request, none if request cannot be served
+ *  by one. Only square tiles of 256 to 260 pixels with even padding qualify:
+ *  odd padding shifts pixel centres by half a pixel.
+ *
+ *  Image requests are served by non-optimized color warp with mask; the
+ *  empty image optimization and grayscale conversion are applied on the
+ *  cropped result.
+ */
+boost::optional<Canonical> canonical(const GdalWarper::RasterRequest &req)
+{
+    typedef GdalWarper::RasterRequest::Operation Operation;
+
+    const auto &size(req.size);
+    if ((size.width != size.height) || (size.width < 256)
+        || (size.width > CanonicalPadded) || (size.width % 2))
+    {
+        return boost::none;
+    }
+
+    const bool image(imageOperation(req.operation));
+    if (!image && (req.operation != Operation::dem)
+        && (req.operation != Operation::demFloat))
+    {
+        return boost::none;
+    }
+
+    const int crop((CanonicalPadded - size.width) / 2);
+    Canonical c(req, crop);
+    auto &creq(c.request);
+
+    if (image) {
+        if (req.operation == Operation::image) {
+            creq.operation = Operation::imageNoOpt;
+        }
+        creq.grayscale = false;
+        creq.withMask = true;
+    }
+
+    if (crop) {
+        const auto es(math::size(req.extents));
+        const double px(es.width / size.width);
+        const double py(es.height / size.height);
+        creq.extents.ll(0) -= crop * px;
+        creq.extents.ll(1) -= crop * py;
+        creq.extents.ur(0) += crop * px;
+        creq.extents.ur(1) += crop * py;
+        creq.size = math::Size2(CanonicalPadded, CanonicalPadded);
+    }
+
+    // already canonical
+    if (creq.key() == req.key()) { return boost::none; }
+    return c;
+}
+
+/** Derives result of original request from result of its canonical padded
+ *  warp. Throws EmptyImage when optimized image has no valid data.
+ */
+GdalWarper::Raster fromCanonical(const GdalWarper::RasterRequest &req
+                                 , const Canonical &c
+                                 , const GdalWarper::Raster &raster)
+{
+    typedef GdalWarper::RasterRequest::Operation Operation;
+
+    const auto &src(*raster);
+    const int crop(c.crop);
+    const cv::Mat view(src, cv::Range(crop, src.rows - crop)
+                       , cv::Range(crop, src.cols - crop));
+
+    if (!imageOperation(req.operation)) {
+        return std::make_shared<cv::Mat>(view.clone());
+    }
+
+    // split off mask (last channel)
+    const int channels(view.channels() - 1);
+    cv::Mat color(view.rows, view.cols, CV_8UC(channels));
+    cv::Mat mask(view.rows, view.cols, CV_8UC1);
+    {
+        std::vector<int> fromTo;
+        for (int ch(0); ch <= channels; ++ch) {
+            fromTo.push_back(ch);
+            fromTo.push_back(ch);
+        }
+        std::vector<cv::Mat> dst{ color, mask };
+        cv::mixChannels(std::vector<cv::Mat>{ view }, dst, fromTo);
+    }
+
+    if ((req.operation == Operation::image) && !cv::countNonZero(mask)) {
+        throw EmptyImage("No valid data.");
+    }
+
+    if (req.grayscale) {
+        cv::Mat gray;
+        switch (color.channels()) {
+        case 1: gray = color; break;
+        case 3: cv::cvtColor(color, gray, cv::COLOR_BGR2GRAY); break;
+        case 4: cv::cvtColor(color, gray, cv::COLOR_BGRA2GRAY); break;
+        default:
+            // keep first channel
+            cv::extractChannel(color, gray, 0);
+        }
+        color = gray;
+    }
+
+    if (!req.withMask) { return std::make_shared<cv::Mat>(color); }
+
+    auto joined(std::make_shared<cv::Mat>
+                (view.rows, view.cols, CV_8UC(color.channels() + 1)));
+    std::vector<int> fromTo;
+    for (int ch(0); ch <= color.channels(); ++ch) {
+        fromTo.push_back(ch);
+        fromTo.push_back(ch);
+    }
+    std::vector<cv::Mat> dst{ *joined };
+    cv::mixChannels(std::vector<cv::Mat>{ color, mask }, dst, fromTo);
+    return joined;
+}
+
 } // namespace
 
 class GdalWarper::Detail
@@ -545,10 +1659,35 @@ public:
 
     Raster warpWP(const RasterRequestWP &req, Aborter &aborter);
 
+    /** Warp without request coalescing, consults host-wide cache.
+     */
+    Raster warpCached(const RasterRequest &req, Aborter &aborter);
+
+    /** Asynchronous warp without request coalescing, consults host-wide
+     *  cache.
+     */
+    void warpCached(const RasterRequest &req, Aborter &aborter
+                    , const RasterCallback &callback);
+
+    /** Warp without request coalescing.
+     */
+    Raster warpSingle(const RasterRequest &req, Aborter &aborter);
+
+    /** Host-wide cache access, keyed by canonical request key. Empty raster
+     *  if not found. Optimized lookup accepts only rasters known to be
+     *  non-empty.
+     */
+    Raster sharedGet(const std::string &key, bool optimized);
+    void sharedPut(const std::string &key, const Raster &raster
+                   , bool optimized);
+
+    Rasters warpBatch(const RasterRequest &req, const math::Size2 &tiles
+                      , int overlap, Aborter &aborter);
+
     Heightcoded::pointer
     heightcode(const std::string &vectorDs
                , const DemDataset::list &rasterDs
-               , const geo::heightcoding::Config &config
+               , const GdalWarper::HeightcodeConfig &config
                , const boost::optional<std::string> &vectorGeoidGrid
                , const GdalWarper::OpenOptions &openOptions
                , const LayerEnhancer::map &layerEnhancers
@@ -557,12 +1696,49 @@ public:
     WorkRequest::Response job(const WorkGenerator &workGenerator
                               , Aborter &aborter);
 
+    void warp(const RasterRequest &req, Aborter &aborter
+              , const RasterCallback &callback);
+
+    void warpWP(const RasterRequestWP &req, Aborter &aborter
+                , const RasterCallback &callback);
+
+    void heightcode(const std::string &vectorDs
+                    , const DemDataset::list &rasterDs
+                    , const GdalWarper::HeightcodeConfig &config
+                    , const boost::optional<std::string> &vectorGeoidGrid
+                    , const GdalWarper::OpenOptions &openOptions
+                    , const LayerEnhancer::map &layerEnhancers
+                    , Aborter &aborter
+                    , const HeightcodedCallback &callback);
+
+    void job(const WorkGenerator &workGenerator, Aborter &aborter
+             , const JobCallback &callback);
+
     void housekeeping();
 
     void stat(std::ostream &os) const;
 
+    void inFlight(std::ostream &os) const;
+
+    GdalWarper::Cost predict(const RasterRequest &request) const;
+    GdalWarper::Cost predict(const std::string &operation
+                             , const std::string &dataset) const;
+
+    void metrics(metrics::Writer &writer) const;
+
+    bool sharePadded() const { return options_.sharePadded; }
+
 private:
     void runManager(Process::Id parentId);
+
+    /** Runs worker in a thread of this process (threads backend).
+     */
+    void runThread(std::size_t id);
+
+    inline bool threaded() const {
+        return options_.backend == Backend::threads;
+    }
+
     void start();
     void stop();
     void worker(std::size_t id, Process::Id parentId, Worker::pointer worker);
@@ -571,45 +1747,460 @@ private:
 
     void killLeviathan();
 
-    inline bool running() const { return *running_; }
-    inline void running(bool val) { *running_ = val; }
+    /** Drains given worker or terminates it if graceful recycling is off.
+     *  Called in the manager process.
+     */
+    void recycle(Worker &worker);
 
-    inline bi::interprocess_mutex& mutex() { return *mutex_; }
-    inline bi::interprocess_condition& cond() { return *cond_; }
+    /** Asks given worker to exit after its current request. Called in the
+     *  manager process.
+     */
+    void drain(Worker &worker);
 
-    void reportShm();
+    /** Terminates workers draining for too long. Called in the manager
+     *  process.
+     */
+    void reapDraining();
 
-    Options options_;
-    utility::Runnable &runnable_;
+    /** Samples pool state and resizes the pool if needed. Called in the
+     *  manager process.
+     */
+    void autoscale();
 
-    bi::mapped_region mem_;
+    /** Enqueues request and wakes up a worker. Must be called under lock.
+     */
+    void enqueue(const ShRequest::pointer &request);
+
+    /** Parks worker until it is woken up. Waits at most timeout
+     *  milliseconds if non-zero. Must be called under lock.
+     */
+    void park(Lock &lock, Process::Id pid, Worker &worker
+              , std::size_t timeout = 0);
+
+    /** Wakes up single parked worker, the one that has dataset with given
+     *  affinity open if possible. Must be called under lock.
+     */
+    void wakeWorker(std::size_t affinity);
+
+    /** Wakes up given worker if parked. Must be called under lock.
+     */
+    void wake(Worker &worker);
+
+    /** Wakes up all parked workers. Must be called under lock.
+     */
+    void wakeAll();
+
+    /** Waits until there is enough free memory in the data arena. Throws
+     *  Unavailable if memory is not freed in time. Must be called under
+     *  lock, the lock is released while waiting.
+     */
+    void admit(Lock &lock);
+
+    /** Wakes up requests waiting in admit(), if any. Called when memory is
+     *  returned to the data arena, must be called without lock.
+     */
+    void memoryReleased();
+
+    /** Binds client's aborter to the request.
+     */
+    void bindAborter(const ShRequest::pointer &request, Aborter &aborter);
+
+    /** Binds client's aborter to all given requests.
+     */
+    void bindAborter(const std::vector<ShRequest::pointer> &requests
+                     , Aborter &aborter);
+
+    /** Starts asynchronous request completion thread if not running yet.
+     */
+    void startCompleter();
+
+    /** Admits and enqueues request and binds client's aborter to it. Must be
+     *  called under lock.
+     */
+    void submit(Lock &lock, const ShRequest::pointer &request
+                , Aborter &aborter);
+
+    /** Result extractor of asynchronous request. Called under lock in the
+     *  completion thread once the request is finished, returns function
+     *  that invokes client's callback (called without lock).
+     */
+    typedef std::function<std::function<void()>(Lock&)> Completion;
+
+    /** Enqueues asynchronous request. Completion is run once the request is
+     *  finished.
+     */
+    void submit(Lock &lock, const ShRequest::pointer &request
+                , Aborter &aborter, const Completion &completion);
+
+    /** Asynchronous request completion thread body.
+     */
+    void completer();
+
+    /** Number of strips the request should be split into (see
+     *  Options::splitThreshold); 0 means no split.
+     */
+    int splitCount(const RasterRequest &req, const Aborter &aborter) const;
+
+    /** Warps strips via the given operation in parallel and collects
+     *  their results. Must be called under lock.
+     */
+    StripResults warpStrips(Lock &lock
+                            , const std::vector<RasterRequest> &strips
+                            , const std::vector<std::size_t> &indices
+                            , RasterRequest::Operation operation
+                            , Aborter &aborter);
+
+    /** Warps request split into count strips and joins the result.
+     */
+    Raster warpSplit(const RasterRequest &req, int count, Aborter &aborter);
+
+    /** Asynchronous warpSplit.
+     */
+    void warpSplit(const RasterRequest &req, int count, Aborter &aborter
+                   , const RasterCallback &callback);
+
+    /** Enqueues given strips of asynchronous split request. Must be called
+     *  under lock.
+     */
+    void submitStrips(Lock &lock, const StripJoin::pointer &join
+                      , const std::vector<std::size_t> &indices);
+
+    /** Collects result of single strip of asynchronous split request. Called
+     *  under lock in the completion thread.
+     */
+    std::function<void()> stripDone(Lock &lock
+                                    , const StripJoin::pointer &join
+                                    , const ShRequest::pointer &request
+                                    , std::size_t index);
+
+    /** Picks next request to process by worker process pid. Lanes are
+     *  served by weighted round-robin. Expired and aborted requests are
+     *  dropped. Returns null pointer if there is nothing to process by this
+     *  worker. Must be called under lock.
+     */
+    ShRequest::pointer nextRequest(Lock &lock, Process::Id pid);
+
+    /** Picks next request from given lane.
+     */
+    ShRequest::pointer nextRequest(Process::Id pid, Priority priority
+                                   , const SystemTime &now);
+
+    /** Forgets all dataset affinities held by given worker process. Must be
+     *  called under lock.
+     */
+    void dropAffinity(Process::Id pid);
+
+    /** Forgets dataset affinity if held by given worker process. Must be
+     *  called under lock.
+     */
+    void dropAffinity(Process::Id pid, const std::string &dataset);
+
+    /** Memory and page faults of a worker.
+     */
+    struct WorkerSample {
+        /** Private memory (in kB), 0 if not measured.
+         */
+        std::size_t memory;
+        std::pair<std::uint64_t, std::uint64_t> faults;
+    };
+
+    /** Samples memory and page faults of given worker. Reads /proc, must be
+     *  called without lock.
+     */
+    WorkerSample sampleWorker(Process::Id pid) const;
+
+    /** Closes least recently used datasets if worker process is over its
+     *  memory budget (as sampled by sampleWorker()) and publishes worker
+     *  stats. Must be called under lock.
+     */
+    void trimCache(Process::Id pid, DatasetCache &cache
+                   , const WorkerSample &sample);
+
+    /** Counts use of given dataset. Must be called under lock.
+     */
+    void recordUsage(const std::string &dataset);
+
+    /** Feeds cost model with request processed by a worker. Must be called
+     *  under lock.
+     */
+    void recordCost(const ShRequest &request);
+
+    /** Saves cost model into cost file.
+     */
+    void saveCost();
+
+    /** Records whether request to given dataset was served from the block
+     *  cache. Called under lock.
+     */
+    void recordBlocks(const std::string &dataset, bool hit);
+
+    /** Concurrency limit of given dataset (0 = unlimited).
+     */
+    unsigned int concurrencyLimit(const std::string &dataset) const;
+
+    /** Counts request picked by worker against its dataset's concurrency
+     *  limit and records its wait. Must be called under lock.
+     */
+    void dispatched(Worker &worker, ShRequest &req);
+
+    /** Releases worker's current request from its dataset's concurrency
+     *  limit. Must be called under lock.
+     */
+    void undispatched(Worker &worker);
+
+    /** Opens most used datasets in freshly spawned worker process. Returns
+     *  once all are open or the time budget runs out.
+     */
+    void prewarm(Process::Id pid, DatasetCache &cache);
+
+    /** Asks all workers to open given datasets.
+     */
+    void warm(const std::vector<std::string> &datasets);
+
+    /** Opens datasets queued for warming since generation warmed (see
+     *  warm()) and updates it.
+     */
+    void warm(Process::Id pid, DatasetCache &cache, std::uint64_t &warmed);
+
+    /** Records latency of finished request being consumed right now and
+     *  reports its stages to client's tracer (if any). Must be called under
+     *  lock.
+     */
+    void recordLatency(const ShRequest &request
+                       , const Aborter::Tracer &tracer);
+
+    /** Extracts result of request via given getter and records its latency.
+     *  Waits on request's own lock, the global lock must not be held unless
+     *  the request has already finished.
+     */
+    template <typename T, typename ...Args>
+    T consume(ShRequest &request, T (ShRequest::*getter)(Args&...)
+              , const Aborter::Tracer &tracer, Args &...args)
+    {
+        try {
+            auto result((request.*getter)(args...));
+            recordLatency(request, tracer);
+            return result;
+        } catch (...) {
+            recordLatency(request, tracer);
+            throw;
+        }
+    }
+
+    inline bool running() const { return *running_; }
+    inline void running(bool val) { *running_ = val; }
+
+    inline bi::interprocess_mutex& mutex() const { return *mutex_; }
+    inline bi::interprocess_condition& doneCond() { return *doneCond_; }
+
+    void reportShm();
+
+    Options options_;
+    utility::Runnable &runnable_;
+
+    SharedSegment mem_;
+
+    /** Control arena (requests, queue, statistics).
+     */
     ManagedBuffer mb_;
 
+    /** Data arena (response rasters and blobs). Kept apart from the control
+     *  arena so that large short-lived blocks do not fragment it.
+     */
+    ManagedBuffer dataMb_;
+
+    /** Size-class free lists of response rasters (in the data arena).
+     */
+    MatPool *matPool_;
+
+    /** Deferred release of consumed response rasters.
+     */
+    std::unique_ptr<Reclaimer> reclaimer_;
+
     std::atomic<bool> *running_;
     ShRequest::Deque *queue_;
 
+    AffinityTable *affinity_;
+    AffinityStats *affinityStats_;
+
+    AbortStats *abortStats_;
+
+    QueueStats *queueStats_;
+
+    ProcessStats *processStats_;
+
+    Autoscaler *autoscaler_;
+
+    /** Dataset paths, SRS definitions and options shared by requests.
+     */
+    InternTable *interned_;
+
+    WorkerStatsTable *workerStats_;
+
+    DatasetUsageTable *datasetUsage_;
+
+    BlockUsageTable *blockUsage_;
+
+    /** Request costs measured by workers.
+     */
+    CostModel *costModel_;
+
+    DatasetDispatchTable *dispatch_;
+
+    WarmList *warmList_;
+
+    /** Generation of the newest warm list entry, read without lock.
+     */
+    std::atomic<std::uint64_t> *warmGeneration_;
+
+    /** Parked workers, most recently parked last.
+     */
+    IdleWorkers *idle_;
+
     bi::interprocess_mutex *mutex_;
-    bi::interprocess_condition *cond_;
+
+    /** Notified when any asynchronous request is finished.
+     */
+    bi::interprocess_condition *doneCond_;
+
+    /** Notified when response memory is returned to the data arena while
+     *  somebody waits for it in admit().
+     */
+    bi::interprocess_condition *memoryCond_;
+    std::atomic<unsigned int> *memoryWaiters_;
 
     Process manager_;
 
     Worker::map workers_;
 
+    /** Worker threads (threads backend only).
+     */
+    std::vector<std::thread> threads_;
+
+    /** Drain start of draining workers. Lives only in the manager process.
+     */
+    std::map<Process::Id, std::chrono::steady_clock::time_point> draining_;
+
+    /** Workers drained by the autoscaler. Lives only in the manager process.
+     */
+    std::set<Process::Id> scaledDown_;
+
+    /** Identical raster requests being processed right now.
+     */
+    Coalescer<Raster> inFlight_;
+    std::atomic<std::uint64_t> coalescedTotal_;
+
+    /** Warp results shared with other instances on this host.
+     */
+    SharedCache sharedCache_;
+
+    /** Number of requests rejected due to lack of shared memory.
+     */
+    std::atomic<std::uint64_t> shmRejected_;
+
+    /** Shared memory usage and queue length sampled by reportShm(), readable
+     *  without the warper mutex.
+     */
+    std::atomic<std::size_t> shmUsed_;
+    std::atomic<std::size_t> queueDepth_;
+
+    /** Pending asynchronous requests, guarded by the warper mutex. Lives
+     *  only in the main process.
+     */
+    struct Pending {
+        ShRequest::pointer request;
+        Completion completion;
+
+        Pending(const ShRequest::pointer &request
+                , const Completion &completion)
+            : request(request), completion(completion)
+        {}
+    };
+    std::list<Pending> pending_;
+
+    /** Completion thread, started on first asynchronous request.
+     */
+    std::once_flag completerStarted_;
+    std::thread completer_;
+    Process::Id completerPid_;
+
     utility::EventCounter warpCounter_;
+    utility::EventCounter coalescedCounter_;
+    utility::EventCounter batchCounter_;
     utility::EventCounter heightcodeCounter_;
     utility::EventCounter shmCounter_;
     utility::EventCounter queueCounter_;
+
+    /** Per-stage latencies measured in the main process.
+     */
+    LatencyStats latency_;
+
+    utility::EventCounter splitCounter_;
+
+    /** Predicted and measured worker wall time of requests that had a
+     *  prediction, by operation.
+     */
+    metrics::Family<metrics::Counter> costPredicted_;
+    metrics::Family<metrics::Counter> costMeasured_;
+
+    /** Last time measured costs were saved.
+     */
+    std::chrono::steady_clock::time_point costSaved_;
+
+    /** CPU sets workers are pinned to (round-robin by worker ID).
+     */
+    CpuSet::list cpuSets_;
 };
 
+GdalWarper::Priority
+GdalWarper::RasterRequest::defaultPriority(Operation operation)
+{
+    switch (operation) {
+    case Operation::valueMinMax:
+    case Operation::valueMinMaxFloat:
+        return Priority::tile;
+
+    case Operation::dem:
+    case Operation::demOptimal:
+    case Operation::demFloat:
+    case Operation::demOptimalFloat:
+        return Priority::mesh;
+
+    case Operation::mask:
+    case Operation::maskNoOpt:
+    case Operation::detailMask:
+        return Priority::mask;
+
+    case Operation::image:
+    case Operation::imageNoOpt:
+    case Operation::imageNoExpand:
+    case Operation::none:
+        break;
+    }
+    return Priority::imagery;
+}
+
 GdalWarper::GdalWarper(const Options &options, utility::Runnable &runnable)
     : detail_(std::make_shared<Detail>(options, runnable))
 {}
 
 GdalWarper::Raster GdalWarper::warp(const RasterRequest &req, Aborter &aborter)
 {
+    if (detail().sharePadded()) {
+        if (const auto c = canonical(req)) {
+            return fromCanonical(req, *c, detail().warp(c->request, aborter));
+        }
+    }
     return detail().warp(req, aborter);
 }
 
+GdalWarper::Rasters GdalWarper::warpBatch(const RasterRequest &req
+                                           , const math::Size2 &tiles
+                                           , int overlap, Aborter &aborter)
+{
+    return detail().warpBatch(req, tiles, overlap, aborter);
+}
+
 GdalWarper::Raster GdalWarper::warpWP(const RasterRequestWP &req
     , Aborter &aborter)
 {
@@ -619,7 +2210,7 @@ GdalWarper::Raster GdalWarper::warpWP(const RasterRequestWP &req
 GdalWarper::Heightcoded::pointer
 GdalWarper::heightcode(const std::string &vectorDs
                        , const DemDataset::list &rasterDs
-                       , const geo::heightcoding::Config &config
+                       , const GdalWarper::HeightcodeConfig &config
                        , const boost::optional<std::string> &vectorGeoidGrid
                        , const GdalWarper::OpenOptions &openOptions
                        , const LayerEnhancer::map &layerEnhancers
@@ -629,12 +2220,103 @@ GdalWarper::heightcode(const std::string &vectorDs
                                , openOptions, layerEnhancers, aborter);
 }
 
+GdalWarper::HeightcodedTile::list
+GdalWarper::heightcode(const HeightcodeTile::list &tiles
+                       , const DemDataset::list &rasterDs
+                       , const boost::optional<std::string> &vectorGeoidGrid
+                       , const LayerEnhancer::map &layerEnhancers
+                       , Aborter &aborter)
+{
+    auto response(detail().job([&](const WorkRequestParams &params)
+    {
+        return params.sm.construct<HeightcodeBatch>
+            (bi::anonymous_instance)
+            (params, tiles, rasterDs, vectorGeoidGrid, layerEnhancers);
+    }, aborter));
+
+    return std::move
+        (*std::static_pointer_cast<HeightcodedTile::list>(response));
+}
+
+GdalWarper::DatasetProbe::list
+GdalWarper::probe(const std::vector<std::string> &datasets
+                  , Aborter &aborter)
+{
+    auto response(detail().job([&](const WorkRequestParams &params)
+    {
+        return params.sm.construct<ProbeJob>
+            (bi::anonymous_instance)(params, datasets);
+    }, aborter));
+
+    auto probes(std::move
+                (*std::static_pointer_cast<DatasetProbe::list>(response)));
+    for (const auto &probe : probes) {
+        if (probe.error) { std::rethrow_exception(probe.error); }
+    }
+    return probes;
+}
+
 WorkRequest::Response GdalWarper::job(const WorkGenerator &workGenerator
                                       , Aborter &aborter)
 {
     return detail().job(workGenerator, aborter);
 }
 
+void GdalWarper::warp(const RasterRequest &req, Aborter &aborter
+                      , const RasterCallback &callback)
+{
+    if (detail().sharePadded()) {
+        if (const auto c = canonical(req)) {
+            detail().warp(c->request, aborter
+                          , [req, c, callback](const Raster &raster
+                                               , const std::exception_ptr &exc)
+            {
+                if (exc) { return callback({}, exc); }
+                Raster result;
+                try {
+                    result = fromCanonical(req, *c, raster);
+                } catch (...) {
+                    return callback({}, std::current_exception());
+                }
+                callback(result, {});
+            });
+            return;
+        }
+    }
+    detail().warp(req, aborter, callback);
+}
+
+void GdalWarper::warpWP(const RasterRequestWP &req, Aborter &aborter
+                        , const RasterCallback &callback)
+{
+    detail().warpWP(req, aborter, callback);
+}
+
+void GdalWarper::heightcode(const std::string &vectorDs
+                            , const DemDataset::list &rasterDs
+                            , const GdalWarper::HeightcodeConfig &config
+                            , const boost::optional<std::string>
+                            &vectorGeoidGrid
+                            , const GdalWarper::OpenOptions &openOptions
+                            , const LayerEnhancer::map &layerEnhancers
+                            , Aborter &aborter
+                            , const HeightcodedCallback &callback)
+{
+    detail().heightcode(vectorDs, rasterDs, config, vectorGeoidGrid
+                        , openOptions, layerEnhancers, aborter, callback);
+}
+
+void GdalWarper::job(const WorkGenerator &workGenerator, Aborter &aborter
+                     , const JobCallback &callback)
+{
+    detail().job(workGenerator, aborter, callback);
+}
+
+void GdalWarper::warm(const std::vector<std::string> &datasets)
+{
+    detail().warm(datasets);
+}
+
 void GdalWarper::housekeeping()
 {
     return detail().housekeeping();
@@ -643,21 +2325,97 @@ void GdalWarper::housekeeping()
 GdalWarper::Detail::Detail(const Options &options
                            , utility::Runnable &runnable)
     : options_(options), runnable_(runnable)
-    , mem_(bi::anonymous_shared_memory(std::size_t(1) << 30))
-    , mb_(bi::create_only, mem_.get_address(), mem_.get_size())
+    , mem_(options.shmSize << 20, options.shmHugepages, options.shmPrefault)
+    , mb_(bi::create_only, mem_.get_address(), options.shmControlSize << 20)
+    , dataMb_(bi::create_only
+              , static_cast<char*>(mem_.get_address())
+              + (options.shmControlSize << 20)
+              , mem_.get_size() - (options.shmControlSize << 20))
+    , matPool_(MatPool::create(dataMb_))
+    , reclaimer_(std::make_unique<Reclaimer>
+                 (dataMb_, [this]() { memoryReleased(); }))
     , running_(mb_.construct<std::atomic<bool>>(bi::anonymous_instance)(true))
     , queue_(mb_.construct<ShRequest::Deque>
              (bi::anonymous_instance)
              (mb_.get_allocator<ShRequest>()))
+    , affinity_(mb_.construct<AffinityTable>
+                (bi::anonymous_instance)
+                (std::less<std::size_t>()
+                 , mb_.get_allocator<AffinityTable::value_type>()))
+    , affinityStats_(mb_.construct<AffinityStats>
+                     (bi::anonymous_instance)())
+    , abortStats_(mb_.construct<AbortStats>(bi::anonymous_instance)())
+    , queueStats_(mb_.construct<QueueStats>(bi::anonymous_instance)())
+    , processStats_(mb_.construct<ProcessStats>(bi::anonymous_instance)())
+    , autoscaler_(mb_.construct<Autoscaler>
+                  (bi::anonymous_instance)
+                  ((options.backend == Backend::threads)
+                   ? Autoscaler::Options() : options.autoscale
+                   , options.processCount))
+    , interned_(&InternTable::instance(mb_))
+    , workerStats_(mb_.construct<WorkerStatsTable>
+                   (bi::anonymous_instance)
+                   (std::less<Process::Id>()
+                    , mb_.get_allocator<WorkerStatsTable::value_type>()))
+    , datasetUsage_(mb_.construct<DatasetUsageTable>
+                    (bi::anonymous_instance)
+                    (std::less<std::size_t>()
+                     , mb_.get_allocator<DatasetUsageTable::value_type>()))
+    , blockUsage_(mb_.construct<BlockUsageTable>
+                  (bi::anonymous_instance)
+                  (std::less<std::size_t>()
+                   , mb_.get_allocator<BlockUsageTable::value_type>()))
+    , costModel_(mb_.construct<CostModel>(bi::anonymous_instance)(mb_))
+    , dispatch_(mb_.construct<DatasetDispatchTable>
+                (bi::anonymous_instance)
+                (std::less<std::size_t>()
+                 , mb_.get_allocator<DatasetDispatchTable::value_type>()))
+    , warmList_(mb_.construct<WarmList>
+                (bi::anonymous_instance)
+                (mb_.get_allocator<WarmEntry>()))
+    , warmGeneration_(mb_.construct<std::atomic<std::uint64_t>>
+                      (bi::anonymous_instance)(0))
+    , idle_(mb_.construct<IdleWorkers>
+            (bi::anonymous_instance)
+            (mb_.get_allocator<IdleWorker>()))
     , mutex_(mb_.construct<bi::interprocess_mutex>
              (bi::anonymous_instance)())
-    , cond_(mb_.construct<bi::interprocess_condition>
-            (bi::anonymous_instance)())
+    , doneCond_(mb_.construct<bi::interprocess_condition>
+                (bi::anonymous_instance)())
+    , memoryCond_(mb_.construct<bi::interprocess_condition>
+                  (bi::anonymous_instance)())
+    , memoryWaiters_(mb_.construct<std::atomic<unsigned int>>
+                     (bi::anonymous_instance)(0))
+    , coalescedTotal_(0)
+    , sharedCache_(options.sharedCache)
+    , shmRejected_(0)
+    , shmUsed_(0)
+    , queueDepth_(0)
+    , completerPid_()
     , warpCounter_(512)
+    , coalescedCounter_(512)
+    , batchCounter_(512)
     , heightcodeCounter_(512)
     , shmCounter_(512)
     , queueCounter_(512)
+    , splitCounter_(512)
+    , costPredicted_("mapproxy_gdal_cost_predicted_microseconds"
+                     , "Predicted worker wall time of requests with a"
+                     " prediction.")
+    , costMeasured_("mapproxy_gdal_cost_measured_microseconds"
+                    , "Measured worker wall time of requests with a"
+                    " prediction.")
+    , costSaved_(std::chrono::steady_clock::now())
+    , cpuSets_(options.numaPinning ? numaCpuSets()
+               : parseCpuSets(options.cpuSets))
 {
+    if (options.numaPinning && cpuSets_.empty()) {
+        LOG(warn3) << "No NUMA nodes found, GDAL workers are not pinned.";
+    }
+
+    // nobody else is running yet
+    costModel_->restore(CostModel::load(options_.costFile));
+
     start();
 }
 
@@ -697,16 +2455,36 @@ void GdalWarper::Detail::runManager(Process::Id parentId)
                 // try to join this process
                 auto id(worker->id());
                 worker->join(true);
-                if (worker->killed()) {
+                if (scaledDown_.erase(id)) {
+                    LOG(info2)
+                        << "Collected scaled-down process " << id << ".";
+                } else if (worker->draining()) {
+                    LOG(info2)
+                        << "Collected recycled process " << id << ".";
+                    ++processStats_->recycled;
+                } else if (worker->killed()) {
                     LOG(info1)
                         << "Collected process " << id << ".";
                 } else {
                     LOG(warn2)
                         << "Process " << id << " terminated unexpectedly.";
+                    ++processStats_->crashed;
                 }
                 worker->internalError(mutex());
 
+                {
+                    // datasets opened by this process are gone
+                    Lock lock(mutex());
+                    dropAffinity(id);
+                    undispatched(*worker);
+                    workerStats_->erase(id);
+
+                    // forget the worker if it died parked
+                    wake(*worker);
+                }
+
                 // process terminated -> remove
+                draining_.erase(id);
                 iworkers = workers_.erase(iworkers);
             } catch (Process::Alive) {
                 // process is still running, skip
@@ -715,24 +2493,40 @@ void GdalWarper::Detail::runManager(Process::Id parentId)
         }
     };
 
+    asio::steady_timer scaleTimer(ios);
+    std::function<void(const bs::error_code &e)> scaleHandler;
+    scaleHandler = [&](const bs::error_code&)
+    {
+        scaleTimer.expires_from_now(std::chrono::seconds(1));
+        scaleTimer.async_wait(scaleHandler);
+        autoscale();
+    };
+
     killTimeoutHandler = [&](const bs::error_code&)
     {
         killTimer.expires_from_now
         (std::chrono::seconds(options_.rssCheckPeriod));
         killTimer.async_wait(killTimeoutHandler);
         killLeviathan();
+        reapDraining();
     };
 
     // launch handler to let them register
     signalHandler({}, 0);
     killTimeoutHandler({});
+    if (autoscaler_->enabled()) { scaleHandler({}); }
 
     std::size_t idGenerator(0);
 
-    // TODO: bind process with request so we can notify outer world that worker
-    // process has died
     while (isRunning()) {
-        if (workers_.size() < options_.processCount) {
+        // draining workers are already being replaced
+        const auto active
+            (std::count_if(workers_.begin(), workers_.end()
+                           , [](const Worker::map::value_type &item)
+                           {
+                               return !item.second->draining();
+                           }));
+        if (std::size_t(active) < autoscaler_->target()) {
             ios.notify_fork(asio::io_service::fork_prepare);
             auto id(++idGenerator);
 
@@ -749,6 +2543,7 @@ void GdalWarper::Detail::runManager(Process::Id parentId)
 
             // remember worker
             workers_.insert(Worker::map::value_type(worker->id(), worker));
+            ++processStats_->spawned;
 
             // notify fork and poll
             ios.notify_fork(asio::io_service::fork_parent);
@@ -771,8 +2566,12 @@ void GdalWarper::Detail::killLeviathan()
     // stop if there are no workers (yet)
     if (workers_.empty()) { return; }
 
+    // draining workers are on their way out, do not count them
     utility::PidList pids;
-    for (const auto &item : workers_) { pids.push_back(item.first); }
+    for (const auto &item : workers_) {
+        if (!item.second->draining()) { pids.push_back(item.first); }
+    }
+    if (pids.empty()) { return; }
 
     auto stats(utility::getProcStat(pids));
 
@@ -815,15 +2614,15 @@ void GdalWarper::Detail::killLeviathan()
     for (const auto &u : usage) {
         if (total < limit) { return; }
 
-        // a leviathan found! kill it with fire
+        // a leviathan found! recycle it
         LOG(info3)
-            << "Killing large GDAL process " << u.pid
+            << "Recycling large GDAL process " << u.pid
             << " occupying " << (u.mem / 1024) << "MB of memory.";
 
         try {
             auto fworkers(workers_.find(u.pid));
             if (fworkers != workers_.end()) {
-                fworkers->second->terminate();
+                recycle(*fworkers->second);
             } else {
                 // should not happen
                 Process::kill(u.pid);
@@ -837,19 +2636,151 @@ void GdalWarper::Detail::killLeviathan()
     }
 }
 
+void GdalWarper::Detail::recycle(Worker &worker)
+{
+    if (!options_.recycleGraceful) {
+        worker.terminate();
+        return;
+    }
+
+    drain(worker);
+}
+
+void GdalWarper::Detail::drain(Worker &worker)
+{
+    draining_.insert(std::make_pair
+                     (worker.id(), std::chrono::steady_clock::now()));
+
+    // wake up the worker if idle
+    Lock lock(mutex());
+    worker.drain();
+    wake(worker);
+}
+
+void GdalWarper::Detail::autoscale()
+{
+    Autoscaler::Sample sample;
+    sample.workers = std::count_if(workers_.begin(), workers_.end()
+                                   , [](const Worker::map::value_type &item)
+                                   {
+                                       return !item.second->draining();
+                                   });
+
+    // longest parked worker is the one to go if the pool shrinks
+    Process::Id idlest(0);
+    {
+        Lock lock(mutex());
+        for (const auto &idle : *idle_) {
+            if (idle.worker->draining()) { continue; }
+            if (!idlest) { idlest = idle.pid; }
+            ++sample.idle;
+        }
+
+        sample.queued = queue_->size();
+        const auto now(systemTime());
+        for (const auto &req : *queue_) {
+            sample.wait = std::max
+                (sample.wait, std::size_t((now - req->enqueued())
+                                          .total_milliseconds()));
+        }
+    }
+
+    double load(0);
+    if (::getloadavg(&load, 1) == 1) {
+        sample.load = load / std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    switch (autoscaler_->update(sample)) {
+    case Autoscaler::Decision::none: break;
+
+    case Autoscaler::Decision::grow:
+        // spawned by the manager loop
+        LOG(info3)
+            << "Growing GDAL worker pool to " << autoscaler_->target()
+            << " processes (queued: " << sample.queued
+            << ", wait: " << sample.wait << " ms, load: " << sample.load
+            << ").";
+        break;
+
+    case Autoscaler::Decision::shrink: {
+        LOG(info3)
+            << "Shrinking GDAL worker pool to " << autoscaler_->target()
+            << " processes (idle: " << sample.idle << ").";
+
+        auto fworkers(workers_.find(idlest));
+        if (fworkers == workers_.end()) {
+            // parked worker is gone meanwhile, take any other
+            fworkers = std::find_if(workers_.begin(), workers_.end()
+                                    , [](const Worker::map::value_type &item)
+                                    {
+                                        return !item.second->draining();
+                                    });
+            if (fworkers == workers_.end()) { break; }
+        }
+        scaledDown_.insert(fworkers->first);
+        drain(*fworkers->second);
+        break; }
+    }
+}
+
+void GdalWarper::Detail::reapDraining()
+{
+    // workers that drained themselves (request limit)
+    for (const auto &item : workers_) {
+        if (item.second->draining() && !draining_.count(item.first)) {
+            draining_.insert(std::make_pair
+                             (item.first, std::chrono::steady_clock::now()));
+        }
+    }
+
+    const auto deadline(std::chrono::steady_clock::now()
+                        - std::chrono::seconds(options_.recycleTimeout));
+
+    for (const auto &item : draining_) {
+        if (item.second > deadline) { continue; }
+
+        auto fworkers(workers_.find(item.first));
+        if (fworkers == workers_.end()) { continue; }
+
+        LOG(warn2)
+            << "GDAL process " << item.first
+            << " not drained in time, terminating.";
+        fworkers->second->terminate();
+    }
+}
+
 void GdalWarper::Detail::start()
 {
+    if (threaded()) {
+        if (options_.autoscale.max) {
+            LOG(warn2) << "Autoscaling is not available with threads "
+                "backend, running fixed number of threads.";
+        }
+        LOG(info2) << "Starting " << options_.processCount
+                   << " GDAL warper threads.";
+        for (unsigned int id(1); id <= options_.processCount; ++id) {
+            threads_.emplace_back(&Detail::runThread, this, id);
+        }
+        return;
+    }
+
     manager_ = Process(Process::Flags().quickExit(true)
                        , &Detail::runManager, this, ThisProcess::id());
 }
 
+void GdalWarper::Detail::runThread(std::size_t id)
+{
+    // no manager: thread worker lives as long as the warper itself
+    worker(id, ThisProcess::id(), Worker::create(mb_));
+}
+
 void GdalWarper::Detail::cleanup(bool join)
 {
     // make not-running
     {
         Lock lock(mutex());
         running(false);
-        cond().notify_all();
+        wakeAll();
     }
 
     // TODO: kill unresponsive processes
@@ -883,6 +2814,13 @@ void GdalWarper::Detail::housekeeping()
         reportShm();
     } catch (...) {}
 
+    if ((std::chrono::steady_clock::now() - costSaved_) >= CostSavePeriod) {
+        saveCost();
+    }
+
+    // threads are joined in stop(), there is no manager to watch
+    if (threaded()) { return; }
+
     try {
         manager_.join(true);
         LOG(warn3) << "Manager process terminated. Bailing out.";
@@ -894,15 +2832,35 @@ void GdalWarper::Detail::housekeeping()
 void GdalWarper::Detail::stop()
 {
     LOG(info2) << "Stopping GDAL support.";
+    saveCost();
     {
         Lock lock(mutex());
         running(false);
-        cond().notify_all();
+        wakeAll();
     }
 
-    LOG(info2) << "Waiting for processes to terminate.";
+    {
+        Lock lock(mutex());
+        doneCond().notify_all();
+    }
 
-    // join manager process
+    // join completion thread (only in process that has started it)
+    if (completer_.joinable() && (completerPid_ == ThisProcess::id())) {
+        completer_.join();
+    }
+
+    if (threaded()) {
+        LOG(info2) << "Waiting for threads to terminate.";
+        for (auto &thread : threads_) {
+            if (thread.joinable()) { thread.join(); }
+        }
+        threads_.clear();
+        return;
+    }
+
+    LOG(info2) << "Waiting for processes to terminate.";
+
+    // join manager process
     if (manager_.joinable()) {
         manager_.join();
     }
@@ -915,45 +2873,135 @@ void GdalWarper::Detail::worker(std::size_t id, Process::Id parentId
 {
     dbglog::thread_id(str(boost::format("gdal:%u") % id));
     LOG(info2) << "Spawned GDAL worker id:" << id << ".";
-    DatasetCache cache;
+
+    if (!threaded()) {
+        // parked workers do not poll: die with the manager
+        ::prctl(PR_SET_PDEATHSIG, SIGKILL);
+        if (parentId != ThisProcess::parentId()) { return; }
+    }
+
+    // threads share process ID, use thread ID instead
+    const auto pid(threaded() ? threadId() : ThisProcess::id());
+
+    // evicted dataset is not open by this worker anymore, called under lock
+    DatasetCache cache(options_.datasetCacheLimit
+                       , [this, pid](const std::string &path)
+    {
+        dropAffinity(pid, path);
+    }, options_.vectorDatasetCacheLimit
+       , options_.datasetBlockQuota << 20);
+
+    {
+        const auto faults(pageFaults(threaded()));
+        Lock lock(mutex());
+        auto &ws((*workerStats_)[pid]);
+        ws.id = id;
+        ws.startMinorFaults = ws.minorFaults = faults.first;
+        ws.startMajorFaults = ws.majorFaults = faults.second;
+    }
+
+    // pin before touching any data to get memory from the right node
+    if (!cpuSets_.empty()) {
+        const auto index((id - 1) % cpuSets_.size());
+        LOG(info2)
+            << "Pinning GDAL worker id:" << id << " to CPU set "
+            << index << ".";
+        pinThread(cpuSets_[index]);
+    }
+
+    if (options_.gdalThreads) {
+        geo::Gdal::setOption("GDAL_NUM_THREADS"
+                             , std::to_string(options_.gdalThreads));
+    }
+
+    if (options_.gdalCacheMax) {
+        // threads share single block cache
+        ::GDALSetCacheMax64
+            (GIntBig(options_.gdalCacheMax
+                     * (threaded() ? options_.processCount : 1)) << 20);
+    }
 
     geo::Gdal::setOption("GDAL_ERROR_ON_LIBJPEG_WARNING", true);
+    if (!options_.rangeCache.root.empty()) {
+        rangecache::install(options_.rangeCache);
+    }
+    if (options_.uring.enabled) { uringio::install(options_.uring); }
     if (!options_.tmpRoot.empty()) {
         geo::Gdal::setOption("GDAL_DEFAULT_WMS_CACHE_PATH"
                              , (options_.tmpRoot / "gdalwmscache").string());
     }
 
+    // datasets warmed before this worker started are covered by pre-warm
+    std::uint64_t warmed(*warmGeneration_);
+    prewarm(pid, cache);
+
+    // samples stack of slow requests processed by this worker
+    std::unique_ptr<profiler::Sampler> sampler;
+    if (options_.profile.enabled()) {
+        sampler.reset(new profiler::Sampler(options_.profile, "gdal"));
+    }
+
     auto isRunning([&]()
     {
-        return (running() && (parentId == ThisProcess::parentId())
-                && runnable_.isRunning());
+        return (running()
+                && (threaded() || (parentId == ThisProcess::parentId()))
+                && runnable_.isRunning() && !worker->draining());
     });
 
+    std::size_t processed(0);
+
     while (isRunning()) {
         try {
+            if (warmed != *warmGeneration_) { warm(pid, cache, warmed); }
+
             ShRequest::pointer req;
 
             {
                 Lock lock(mutex());
-                cond().timed_wait(lock, absTime(milliseconds(500)), [&]()
-                {
-                    return (!isRunning() || !queue_->empty());
-                });
-                if (!isRunning()) { break; }
-
-                // empty queue -> nothing to do
-                if (queue_->empty()) { continue; }
 
                 // grab request
-                req = queue_->back();
-                queue_->pop_back();
+                req = nextRequest(lock, pid);
+
+                if (!req) {
+                    if (warmed != *warmGeneration_) {
+                        // warm request arrived meanwhile, handle it first
+                        continue;
+                    } else if (queue_->empty()) {
+                        // sleep until woken up by new request or shutdown
+                        park(lock, pid, *worker);
+                    } else {
+                        // there is something in the queue but bound to other
+                        // workers; wait for new request or for the steal
+                        // period to pass
+                        park(lock, pid, *worker
+                             , std::max<std::size_t>
+                             (options_.affinityStealDelay, 1));
+                    }
+                    if (!isRunning()) { break; }
+
+                    // nothing to do
+                    if (!(req = nextRequest(lock, pid))) { continue; }
+                }
 
                 // associate request to this worker
                 worker->associate(req);
+                req->picked();
+                dispatched(*worker, *req);
+                (*workerStats_)[pid].request = req;
             }
 
+            const auto cpuStart(processCpuTime(threaded()));
+            processingCpu = { req.get(), threaded(), cpuStart };
+            MAPPROXY_PROBE2(warp__start, req->traceId(), req->pixels());
+            const auto blocksUsed(::GDALGetCacheUsed64());
+
+            bool expired(false);
             try {
+                const profiler::Sampler::Scope profile(req->traceId());
                 req->process(mutex(), cache);
+            } catch (const DeadlineExceeded &e) {
+                expired = true;
+                req->setError(mutex(), e);
             } catch (const utility::HttpError &e) {
                 req->setError(mutex(), e);
             } catch (const EmptyImage &e) {
@@ -967,11 +3015,57 @@ void GdalWarper::Detail::worker(std::size_t id, Process::Id parentId
             } catch (...) {
                 req->setError(mutex(), "Unknown error.");
             }
+            processingCpu = {};
+            MAPPROXY_PROBE2(warp__finish, req->traceId(), req->cpu());
+
+            {
+                const auto cpu(processCpuTime(threaded()) - cpuStart);
+                if (req->aborted()) {
+                    ++abortStats_->cancelled;
+                    abortStats_->cancelledCpu += cpu;
+                } else if (expired) {
+                    ++abortStats_->deadlineCancelled;
+                    abortStats_->deadlineCancelledCpu += cpu;
+                } else {
+                    ++abortStats_->finished;
+                    abortStats_->finishedCpu += cpu;
+                }
+            }
 
             {
+                // memory is sampled before taking the lock
+                const auto sample(sampleWorker(pid));
+
                 // disassociate request from this worker
                 Lock lock(mutex());
                 worker->disassociate();
+                undispatched(*worker);
+                (*workerStats_)[pid].request = {};
+
+                // interrupted requests say nothing about the cost
+                if (!req->aborted() && !expired) {
+                    recordCost(*req);
+                }
+
+                if (req->cachesDataset()) {
+                    recordUsage(req->dataset());
+                    recordBlocks(req->dataset(), cache.account
+                                 (req->dataset(), ::GDALGetCacheUsed64()
+                                  - blocksUsed));
+                }
+
+                // close datasets over the limits and publish stats
+                trimCache(pid, cache, sample);
+
+                // threads are not recycled: there is nothing to reclaim
+                if (!threaded() && options_.recycleRequests
+                    && (++processed >= options_.recycleRequests))
+                {
+                    LOG(info2)
+                        << "GDAL worker id:" << id << " processed "
+                        << processed << " requests, recycling.";
+                    worker->drain();
+                }
             }
         } catch (const std::exception &e) {
             LOG(err3)
@@ -980,145 +3074,1734 @@ void GdalWarper::Detail::worker(std::size_t id, Process::Id parentId
         }
     }
 
+    if (worker->draining()) {
+        // let other workers take over our datasets right away
+        Lock lock(mutex());
+        dropAffinity(pid);
+    }
+
     LOG(info2) << "GDAL worker id:" << id << " finishing.";
 }
 
-void GdalWarper::Detail::reportShm()
+void GdalWarper::Detail::enqueue(const ShRequest::pointer &request)
 {
-    shmCounter_.eventMax(mb_.get_size() - mb_.get_free_memory());
-    queueCounter_.eventMax(queue_->size());
+    request->predicted(costModel_->predict
+                       (request->operationName(), request->dataset()
+                        , request->costLod(), request->costPixels()).wall);
+
+    if (request->affinity()) {
+        request->concurrency(concurrencyLimit(request->dataset()));
+    }
+    queue_->push_back(request);
+
+    // busy workers check the queue before parking, no need to wake them
+    wakeWorker(request->affinity());
 }
 
-GdalWarper::Raster GdalWarper::Detail::warp(const RasterRequest &req
-                                            , Aborter &aborter)
+void GdalWarper::Detail::park(Lock &lock, Process::Id pid, Worker &worker
+                              , std::size_t timeout)
+{
+    worker.idle(true);
+    idle_->push_back(IdleWorker(pid, &worker));
+
+    const auto woken([&]() { return !worker.idle(); });
+    if (timeout) {
+        worker.wakeup().timed_wait
+            (lock, absTime(milliseconds(timeout)), woken);
+    } else {
+        worker.wakeup().wait(lock, woken);
+    }
+
+    if (worker.idle()) {
+        // timed out, unpark ourselves
+        worker.idle(false);
+        idle_->erase(std::remove_if(idle_->begin(), idle_->end()
+                                    , [&](const IdleWorker &iw)
+                                    {
+                                        return iw.worker == &worker;
+                                    })
+                     , idle_->end());
+    }
+}
+
+void GdalWarper::Detail::wakeWorker(std::size_t affinity)
+{
+    if (idle_->empty()) { return; }
+
+    // most recently parked worker by default, its caches are the warmest
+    auto target(std::prev(idle_->end()));
+
+    if (options_.affinity && affinity) {
+        // prefer worker that has the dataset open; if it is busy the one
+        // woken up here steals the request after the steal delay
+        auto faffinity(affinity_->find(affinity));
+        if (faffinity != affinity_->end()) {
+            auto fidle(std::find_if(idle_->begin(), idle_->end()
+                                    , [&](const IdleWorker &iw)
+                                    {
+                                        return iw.pid == faffinity->second;
+                                    }));
+            if (fidle != idle_->end()) { target = fidle; }
+        }
+    }
+
+    auto *worker(target->worker);
+    idle_->erase(target);
+    worker->idle(false);
+    worker->wakeup().notify_one();
+}
+
+void GdalWarper::Detail::wake(Worker &worker)
+{
+    if (!worker.idle()) { return; }
+
+    idle_->erase(std::remove_if(idle_->begin(), idle_->end()
+                                , [&](const IdleWorker &iw)
+                                {
+                                    return iw.worker == &worker;
+                                })
+                 , idle_->end());
+    worker.idle(false);
+    worker.wakeup().notify_one();
+}
+
+void GdalWarper::Detail::wakeAll()
+{
+    for (auto &iw : *idle_) {
+        iw.worker->idle(false);
+        iw.worker->wakeup().notify_one();
+    }
+    idle_->clear();
+}
+
+void GdalWarper::Detail::admit(Lock &lock)
+{
+    const std::size_t reserve(options_.shmReserve << 20);
+    if (dataMb_.get_free_memory() >= reserve) { return; }
+
+    // registered before the next check: release seeing no waiter happened
+    // before it, i.e. its memory is seen by the check
+    ++*memoryWaiters_;
+    const auto deadline(absTime(milliseconds(options_.shmWait)));
+    bool admitted(false);
+    for (;;) {
+        if (dataMb_.get_free_memory() >= reserve) {
+            admitted = true;
+            break;
+        }
+        if (systemTime() >= deadline) { break; }
+
+        // memory freed without notification (unclaimed responses of
+        // dropped requests) is noticed after a while
+        memoryCond_->timed_wait
+            (lock, std::min(deadline, absTime(milliseconds(MemoryRecheck))));
+    }
+    --*memoryWaiters_;
+
+    if (admitted) { return; }
+
+    ++shmRejected_;
+    throw Unavailable("Out of GDAL shared memory.");
+}
+
+void GdalWarper::Detail::memoryReleased()
 {
+    if (!*memoryWaiters_) { return; }
+
+    // taking the lock makes sure the waiter is already waiting
     Lock lock(mutex());
-    ShRequest::pointer shReq(ShRequest::create(req, mb_));
-    queue_->push_back(shReq);
+    memoryCond_->notify_all();
+}
 
-    cond().notify_one();
+void GdalWarper::Detail::bindAborter(const ShRequest::pointer &request
+                                     , Aborter &aborter)
+{
+    ShRequest::wpointer wreq(request);
+    aborter.setAborter([wreq, this]()
+    {
+        if (auto r = wreq.lock()) {
+            r->abort(mutex());
+        }
+    });
+}
 
+void GdalWarper::Detail
+::bindAborter(const std::vector<ShRequest::pointer> &requests
+              , Aborter &aborter)
+{
+    std::vector<ShRequest::wpointer> wreqs(requests.begin(), requests.end());
+    aborter.setAborter([wreqs, this]()
     {
-        // set aborter for this request
-        ShRequest::wpointer wreq(shReq);
-        aborter.setAborter([wreq, this]()
-        {
+        for (const auto &wreq : wreqs) {
             if (auto r = wreq.lock()) {
-                r->setError
-                    (mutex(), RequestAborted("Request has been aborted"));
+                r->abort(mutex());
             }
-        });
-    }
+        }
+    });
+}
 
-    auto result(shReq->getRaster(lock));
-    lock.unlock();
+void GdalWarper::Detail::startCompleter()
+{
+    std::call_once(completerStarted_, [this]()
+    {
+        completerPid_ = ThisProcess::id();
+        completer_ = std::thread(&Detail::completer, this);
+    });
+}
 
-    warpCounter_.event();
+void GdalWarper::Detail::submit(Lock &lock, const ShRequest::pointer &request
+                                , Aborter &aborter)
+{
+    admit(lock);
+    if (aborter.background()) { request->priority(Priority::background); }
+    request->traceId(aborter.traceId());
+    request->deadline(aborter.deadline());
+    enqueue(request);
+    bindAborter(request, aborter);
+}
 
-    return result;
+void GdalWarper::Detail::submit(Lock &lock, const ShRequest::pointer &request
+                                , Aborter &aborter
+                                , const Completion &completion)
+{
+    admit(lock);
+    startCompleter();
+
+    request->notify(doneCond_);
+    pending_.emplace_back(request, completion);
+    if (aborter.background()) { request->priority(Priority::background); }
+    request->traceId(aborter.traceId());
+    request->deadline(aborter.deadline());
+    enqueue(request);
+    bindAborter(request, aborter);
 }
 
-GdalWarper::Raster GdalWarper::Detail::warpWP(const RasterRequestWP &req
-                                            , Aborter &aborter)
+void GdalWarper::Detail::completer()
 {
+    dbglog::thread_id("gdal:async");
+    LOG(info2) << "Started GDAL warper completion thread.";
+
+    std::vector<std::function<void()>> ready;
+
     Lock lock(mutex());
-    ShRequest::pointer shReq(ShRequest::create(req, mb_));
-    queue_->push_back(shReq);
+    for (;;) {
+        const bool terminating(!running());
+
+        for (auto ipending(pending_.begin()); ipending != pending_.end(); ) {
+            auto &request(*ipending->request);
+            if (terminating && !request.finished()) {
+                request.setError
+                    (lock, Unavailable("GDAL warper is terminating."));
+            }
 
-    cond().notify_one();
+            if (!request.finished()) { ++ipending; continue; }
 
-    {
-        // set aborter for this request
-        ShRequest::wpointer wreq(shReq);
-        aborter.setAborter([wreq, this]()
-        {
-            if (auto r = wreq.lock()) {
-                r->setError
-                    (mutex(), RequestAborted("Request has been aborted"));
+            ready.push_back(ipending->completion(lock));
+            ipending = pending_.erase(ipending);
+        }
+
+        if (ready.empty()) {
+            if (terminating) { break; }
+            doneCond().timed_wait(lock, absTime(milliseconds(500)));
+            continue;
+        }
+
+        // run callbacks without lock
+        lock.unlock();
+        for (const auto &callback : ready) {
+            try {
+                callback();
+            } catch (const std::exception &e) {
+                LOG(err2) << "Asynchronous request callback failed: <"
+                          << e.what() << ">.";
             }
-        });
+        }
+        ready.clear();
+        lock.lock();
     }
 
-    auto result(shReq->getRaster(lock));
-    lock.unlock();
+    LOG(info2) << "Terminated GDAL warper completion thread.";
+}
 
-    warpCounter_.event();
+ShRequest::pointer GdalWarper::Detail::nextRequest(Lock &lock
+                                                   , Process::Id pid)
+{
+    const auto now(systemTime());
+
+    // drop requests aborted before anybody picked them up, requests past
+    // client's deadline and requests waiting for too long
+    const auto maxAge(boost::posix_time::seconds(options_.queueMaxAge));
+    for (auto i(queue_->begin()); i != queue_->end(); ) {
+        if ((*i)->aborted()) {
+            ++abortStats_->dropped;
+            i = queue_->erase(i);
+        } else if ((*i)->expired(now)) {
+            (*i)->setError
+                (lock, DeadlineExceeded("Request deadline passed in queue."));
+            ++abortStats_->deadlineDropped;
+            i = queue_->erase(i);
+        } else if (options_.queueMaxAge && ((now - (*i)->enqueued()) > maxAge))
+        {
+            (*i)->setError(lock, Unavailable("Request expired in queue."));
+            ++queueStats_->expired;
+            i = queue_->erase(i);
+        } else {
+            ++i;
+        }
+    }
 
-    return result;
+    if (queue_->empty()) { return {}; }
+
+    // lanes with pending requests
+    std::array<bool, PriorityCount> pending{};
+    for (const auto &req : *queue_) {
+        pending[static_cast<std::size_t>(req->priority())] = true;
+    }
+
+    // background lane is served only when nothing else can be
+    const auto background(static_cast<std::size_t>(Priority::background));
+    const bool backgroundPending(pending[background]);
+    pending[background] = false;
+
+    // smooth weighted round-robin: every pending lane gains its weight,
+    // lane with highest credit is served first and pays the total weight
+    std::array<std::int64_t, PriorityCount> credit;
+    std::array<std::size_t, PriorityCount> order;
+    for (std::size_t lane(0); lane < PriorityCount; ++lane) {
+        credit[lane] = queueStats_->credit[lane];
+    }
+    const auto total(dispatch::laneOrder(pending, options_.priorityWeights
+                                         , credit, order));
+
+    for (const auto lane : order) {
+        if (!pending[lane]) { break; }
+
+        if (auto req = nextRequest(pid, static_cast<Priority>(lane), now)) {
+            // commit round-robin state
+            credit[lane] -= total;
+            for (std::size_t l(0); l < PriorityCount; ++l) {
+                queueStats_->credit[l] = credit[l];
+            }
+            ++queueStats_->served[lane];
+            return req;
+        }
+    }
+
+    if (backgroundPending) {
+        if (auto req = nextRequest(pid, Priority::background, now)) {
+            ++queueStats_->served[background];
+            return req;
+        }
+    }
+
+    // nothing for us
+    return {};
 }
 
-GdalWarper::Heightcoded::pointer GdalWarper::Detail
-::heightcode(const std::string &vectorDs
-             , const DemDataset::list &rasterDs
-             , const geo::heightcoding::Config &config
-             , const boost::optional<std::string> &vectorGeoidGrid
-             , const GdalWarper::OpenOptions &openOptions
-             , const LayerEnhancer::map &layerEnhancers
-             , Aborter &aborter)
+ShRequest::pointer GdalWarper::Detail::nextRequest(Process::Id pid
+                                                   , Priority priority
+                                                   , const SystemTime &now)
 {
-    Lock lock(mutex());
-    ShRequest::pointer shReq
-        (ShRequest::create(vectorDs, rasterDs, config, vectorGeoidGrid
-                           , openOptions, layerEnhancers, mb_));
-    queue_->push_back(shReq);
-    cond().notify_one();
+    const auto take([&](ShRequest::Deque::iterator i) -> ShRequest::pointer
+    {
+        auto req(*i);
+        queue_->erase(i);
+        return req;
+    });
 
+    // request from this lane not held back by its dataset's concurrency cap
+    const auto eligible([&](ShRequest &req) -> bool
     {
-        // set aborter for this request
-        ShRequest::wpointer wreq(shReq);
-        aborter.setAborter([wreq, this]()
+        if (req.priority() != priority) { return false; }
+        if (!dispatch::capped(*dispatch_, req.affinity(), req.concurrency()))
         {
-            if (auto r = wreq.lock()) {
-                r->setError
-                    (mutex(), RequestAborted("Request has been aborted"));
-            }
-        });
+            return true;
+        }
+        req.deferred(true);
+        return false;
+    });
+
+    const auto begin(queue_->begin()), end(queue_->end());
+
+    if (!options_.affinity) {
+        // plain LIFO
+        const auto i(dispatch::pickLast(begin, end, eligible));
+        if (i == end) { return {}; }
+        return take(i);
     }
 
-    auto result(shReq->getHeightcoded(lock));
-    lock.unlock();
+    const auto picked(dispatch::pick
+                      (begin, end, *affinity_, pid, now
+                       , milliseconds(options_.affinityStealDelay)
+                       , eligible));
+    const auto i(picked.first);
 
-    heightcodeCounter_.event();
+    const auto claim([&]()
+    {
+        if (const auto affinity = (*i)->affinity()) {
+            (*affinity_)[affinity] = pid;
+        }
+    });
 
-    return result;
+    switch (picked.second) {
+    case dispatch::Pick::own:
+        ++affinityStats_->hit;
+        return take(i);
+
+    case dispatch::Pick::free:
+        if ((*i)->affinity()) { ++affinityStats_->miss; }
+        claim();
+        return take(i);
+
+    case dispatch::Pick::steal:
+        ++affinityStats_->steal;
+        claim();
+        return take(i);
+
+    case dispatch::Pick::none:
+        break;
+    }
+
+    // nothing for us
+    return {};
 }
 
-WorkRequest::Response GdalWarper::Detail
-::job(const WorkGenerator &workGenerator, Aborter &aborter)
+void GdalWarper::Detail::dropAffinity(Process::Id pid)
 {
-    Lock lock(mutex());
+    for (auto i(affinity_->begin()); i != affinity_->end(); ) {
+        if (i->second == pid) {
+            i = affinity_->erase(i);
+        } else {
+            ++i;
+        }
+    }
+}
+
+void GdalWarper::Detail::dropAffinity(Process::Id pid
+                                      , const std::string &dataset)
+{
+    auto faffinity(affinity_->find(datasetAffinity(dataset)));
+    if ((faffinity != affinity_->end()) && (faffinity->second == pid)) {
+        affinity_->erase(faffinity);
+    }
+}
+
+GdalWarper::Detail::WorkerSample
+GdalWarper::Detail::sampleWorker(Process::Id pid) const
+{
+    WorkerSample sample{ 0, pageFaults(threaded()) };
+    if (!options_.datasetCacheMemoryLimit) { return sample; }
+
+    utility::PidList pids;
+    pids.push_back(threaded() ? ThisProcess::id() : pid);
+    const auto stats(utility::getProcStat(pids));
+    if (!stats.empty()) {
+        const auto &ps(stats.front());
+        sample.memory = ((ps.rss > ps.shared) ? (ps.rss - ps.shared) : 0);
+    }
+    return sample;
+}
+
+void GdalWarper::Detail::trimCache(Process::Id pid, DatasetCache &cache
+                                   , const WorkerSample &sample)
+{
+    cache.trim();
+
+    if (options_.datasetCacheMemoryLimit) {
+        // compute limit in kilobytes; threads share memory of the whole
+        // process, scale the budget by their count
+        const std::size_t limit(options_.datasetCacheMemoryLimit * 1024
+                                * (threaded() ? options_.processCount : 1));
+
+        // close one dataset at a time, memory is not returned immediately
+        // and we do not want to throw away everything at once
+        const auto mem(sample.memory);
+        if ((mem > limit) && (cache.size() > 1)) {
+            LOG(info2)
+                << "GDAL process occupies " << (mem / 1024)
+                << "MB of memory, closing least recently used dataset.";
+            cache.evict();
+        }
+    }
+
+    const auto &faults(sample.faults);
+    auto &ws((*workerStats_)[pid]);
+    ws.datasets = cache.size();
+    ws.vectors = cache.vectorSize();
+    ws.cache = cache.stats();
+    ws.minorFaults = faults.first;
+    ws.majorFaults = faults.second;
+}
+
+void GdalWarper::Detail::recordCost(const ShRequest &request)
+{
+    const auto wall(request.processing());
+    if (!wall) { return; }
+
+    try {
+        costModel_->record(request.operationName(), request.dataset()
+                           , request.costLod(), request.costPixels(), wall
+                           , request.cpu());
+    } catch (const bi::bad_alloc&) {
+        // out of control memory, statistics are not worth it
+    }
+}
 
-    auto shReq(ShRequest::create(workGenerator, mb_));
-    queue_->push_back(shReq);
-    cond().notify_one();
+void GdalWarper::Detail::saveCost()
+{
+    if (options_.costFile.empty()) { return; }
 
+    CostModel::Entry::list entries;
     {
-        // set aborter for this request
-        ShRequest::wpointer wreq(shReq);
-        aborter.setAborter([wreq, this]()
-        {
-            if (auto r = wreq.lock()) {
-                r->setError
-                    (mutex(), RequestAborted("Request has been aborted"));
-            }
-        });
+        Lock lock(mutex());
+        entries = costModel_->entries();
     }
+    CostModel::save(options_.costFile, entries);
+    costSaved_ = std::chrono::steady_clock::now();
+}
 
-    /** Consume response for a work request
-     */
-    return shReq->consumeWork(lock);
+GdalWarper::Cost GdalWarper::Detail::predict(const RasterRequest &request)
+    const
+{
+    Lock lock(mutex());
+    return costModel_->predict(::operationName(request.operation)
+                               , request.dataset
+                               , ::costLod(request.extents, request.size)
+                               , math::area(request.size));
 }
 
-void GdalWarper::Detail::stat(std::ostream &os) const
+GdalWarper::Cost GdalWarper::Detail::predict(const std::string &operation
+                                             , const std::string &dataset)
+    const
 {
-    warpCounter_.averageAndMax(os, "gdal.warp.");
-    heightcodeCounter_.averageAndMax(os, "gdal.heightcode.");
-    shmCounter_.max(os, "gdal.shm.used.");
-    os << "gdal.shm.total=" << mb_.get_size() << '\n';
-    queueCounter_.max(os, "gdal.shm.enqueued.");
+    Lock lock(mutex());
+    return costModel_->predict(operation, dataset, 0, 0);
 }
 
-void GdalWarper::stat(std::ostream &os) const
+void GdalWarper::Detail::recordUsage(const std::string &dataset)
 {
-    detail().stat(os);
+    if (!options_.prewarmDatasets) { return; }
+
+    const auto key(datasetAffinity(dataset));
+    if (!key) { return; }
+
+    auto fdatasetUsage(datasetUsage_->find(key));
+    if (fdatasetUsage == datasetUsage_->end()) {
+        // keep some history beyond pre-warmed datasets; drop the least used
+        // dataset when full
+        const auto limit(std::max<std::size_t>
+                         (64, 4 * options_.prewarmDatasets));
+        if (datasetUsage_->size() >= limit) {
+            datasetUsage_->erase
+                (std::min_element
+                 (datasetUsage_->begin(), datasetUsage_->end()
+                  , [](const DatasetUsageTable::value_type &l
+                       , const DatasetUsageTable::value_type &r)
+                  {
+                      return l.second.hits < r.second.hits;
+                  }));
+        }
+
+        fdatasetUsage = datasetUsage_->insert
+            (DatasetUsageTable::value_type(key, DatasetUsage(dataset, mb_)))
+            .first;
+    }
+
+    // age all counts once in a while so that old favourites fade out
+    if (++fdatasetUsage->second.hits >= (1 << 16)) {
+        for (auto &item : *datasetUsage_) { item.second.hits /= 2; }
+    }
+}
+
+void GdalWarper::Detail::recordBlocks(const std::string &dataset, bool hit)
+{
+    const auto key(datasetAffinity(dataset));
+    if (!key) { return; }
+
+    auto fblockUsage(blockUsage_->find(key));
+    if (fblockUsage == blockUsage_->end()) {
+        // bounded; drop the least requested dataset when full
+        if (blockUsage_->size() >= 256) {
+            blockUsage_->erase
+                (std::min_element
+                 (blockUsage_->begin(), blockUsage_->end()
+                  , [](const BlockUsageTable::value_type &l
+                       , const BlockUsageTable::value_type &r)
+                  {
+                      return ((l.second.hits + l.second.misses)
+                              < (r.second.hits + r.second.misses));
+                  }));
+        }
+
+        fblockUsage = blockUsage_->insert
+            (BlockUsageTable::value_type(key, BlockUsage(dataset, mb_)))
+            .first;
+    }
+
+    ++(hit ? fblockUsage->second.hits : fblockUsage->second.misses);
+}
+
+unsigned int GdalWarper::Detail::concurrencyLimit(const std::string &dataset)
+    const
+{
+    // longest matching prefix wins
+    std::size_t best(0);
+    auto limit(options_.datasetConcurrency);
+    for (const auto &item : options_.datasetConcurrencyByPrefix) {
+        if ((item.first.size() >= best)
+            && ba::starts_with(dataset, item.first))
+        {
+            best = item.first.size();
+            limit = item.second;
+        }
+    }
+    return limit;
+}
+
+void GdalWarper::Detail::dispatched(Worker &worker, ShRequest &req)
+{
+    const auto key(req.affinity());
+    if (!key) { return; }
+
+    auto fdispatch(dispatch_->find(key));
+    if (fdispatch == dispatch_->end()) {
+        // bounded; drop the least dispatched idle dataset when full
+        if (dispatch_->size() >= 256) {
+            auto victim(dispatch_->end());
+            for (auto i(dispatch_->begin()); i != dispatch_->end(); ++i) {
+                if (i->second.running) { continue; }
+                if ((victim == dispatch_->end())
+                    || (i->second.dispatched < victim->second.dispatched))
+                {
+                    victim = i;
+                }
+            }
+            if (victim != dispatch_->end()) { dispatch_->erase(victim); }
+        }
+
+        fdispatch = dispatch_->insert
+            (DatasetDispatchTable::value_type
+             (key, DatasetDispatch(req.dataset(), mb_)))
+            .first;
+    }
+
+    auto &d(fdispatch->second);
+    const std::uint64_t wait
+        (std::max(std::int64_t((systemTime() - req.enqueued())
+                               .total_microseconds()), std::int64_t(0)));
+    ++d.dispatched;
+    d.waitSum += wait;
+    d.waitMax = std::max(d.waitMax, wait);
+    if (req.deferred()) { ++d.deferred; }
+    ++d.running;
+
+    worker.dispatched(key);
+}
+
+void GdalWarper::Detail::undispatched(Worker &worker)
+{
+    const auto key(worker.dispatched());
+    if (!key) { return; }
+    worker.dispatched(0);
+
+    auto fdispatch(dispatch_->find(key));
+    if ((fdispatch != dispatch_->end()) && fdispatch->second.running) {
+        --fdispatch->second.running;
+    }
+}
+
+void GdalWarper::Detail::prewarm(Process::Id pid, DatasetCache &cache)
+{
+    if (!options_.prewarmDatasets) { return; }
+
+    std::vector<std::pair<std::uint64_t, std::string>> datasets;
+    {
+        Lock lock(mutex());
+        for (const auto &item : *datasetUsage_) {
+            datasets.emplace_back(item.second.hits
+                                  , asString(item.second.path));
+        }
+    }
+    if (datasets.empty()) { return; }
+
+    // most used first
+    std::sort(datasets.begin(), datasets.end()
+              , [](const std::pair<std::uint64_t, std::string> &l
+                   , const std::pair<std::uint64_t, std::string> &r)
+              {
+                  return l.first > r.first;
+              });
+
+    auto count(std::min(options_.prewarmDatasets, datasets.size()));
+    if (options_.datasetCacheLimit) {
+        count = std::min(count, options_.datasetCacheLimit);
+    }
+
+    const auto deadline(absTime(milliseconds(options_.prewarmBudget)));
+
+    std::size_t opened(0);
+    for (std::size_t i(0); i < count; ++i) {
+        if (!running() || (systemTime() >= deadline)) { break; }
+
+        try {
+            cache(datasets[i].second);
+            ++opened;
+        } catch (const std::exception &e) {
+            LOG(warn2)
+                << "Unable to pre-warm dataset <" << datasets[i].second
+                << ">: <" << e.what() << ">.";
+        }
+    }
+
+    LOG(info2) << "Pre-warmed " << opened << " of " << count
+               << " dataset(s).";
+
+    const auto sample(sampleWorker(pid));
+    Lock lock(mutex());
+    trimCache(pid, cache, sample);
+}
+
+void GdalWarper::Detail::warm(const std::vector<std::string> &datasets)
+{
+    if (datasets.empty()) { return; }
+
+    Lock lock(mutex());
+    std::uint64_t generation(*warmGeneration_);
+    for (const auto &dataset : datasets) {
+        warmList_->emplace_back(++generation, dataset, mb_);
+        // count as used: workers spawned later pre-warm them as well
+        recordUsage(dataset);
+    }
+    while (warmList_->size() > WarmListLimit) { warmList_->pop_front(); }
+    *warmGeneration_ = generation;
+
+    // parked workers only; busy ones check before taking next request
+    while (!idle_->empty()) { wakeWorker(0); }
+}
+
+void GdalWarper::Detail::warm(Process::Id pid, DatasetCache &cache
+                              , std::uint64_t &warmed)
+{
+    std::vector<std::string> datasets;
+    {
+        Lock lock(mutex());
+        for (const auto &entry : *warmList_) {
+            if (entry.generation > warmed) {
+                datasets.push_back(asString(entry.path));
+            }
+        }
+        warmed = *warmGeneration_;
+    }
+
+    std::size_t opened(0);
+    for (const auto &dataset : datasets) {
+        if (!running()) { break; }
+
+        try {
+            cache(dataset);
+            ++opened;
+        } catch (const std::exception &e) {
+            LOG(warn2)
+                << "Unable to warm dataset <" << dataset << ">: <"
+                << e.what() << ">.";
+        }
+    }
+
+    LOG(info2) << "Warmed " << opened << " of " << datasets.size()
+               << " dataset(s).";
+
+    const auto sample(sampleWorker(pid));
+    Lock lock(mutex());
+    trimCache(pid, cache, sample);
+}
+
+void GdalWarper::Detail::reportShm()
+{
+    shmUsed_ = (mb_.get_size() - mb_.get_free_memory()
+                + dataMb_.get_size() - dataMb_.get_free_memory());
+    queueDepth_ = queue_->size();
+    matPool_->sample(dataMb_);
+    shmCounter_.eventMax(shmUsed_);
+    queueCounter_.eventMax(queueDepth_);
+}
+
+std::string GdalWarper::RasterRequest::key() const
+{
+    std::ostringstream os;
+    os.precision(17);
+    os << static_cast<int>(operation)
+       << '|' << dataset
+       << '|' << static_cast<int>(srs.type) << ':' << srs.srs
+       << '|' << extents.ll(0) << ',' << extents.ll(1)
+       << ':' << extents.ur(0) << ',' << extents.ur(1)
+       << '|' << size.width << 'x' << size.height
+       << '|' << static_cast<int>(resampling)
+       << '|' << (mask ? *mask : std::string())
+       << '|';
+    if (nodata) { os << *nodata; }
+    os << '|';
+    for (auto band : bands) { os << band << ','; }
+    os << '|' << grayscale << '|' << keepPalette << '|';
+    if (overviewRatio) { os << *overviewRatio; }
+    os << '|';
+    if (demFastRatio) { os << *demFastRatio; }
+    // keep keys of plain requests stable
+    if (withMask) { os << "|withMask"; }
+    return os.str();
+}
+
+std::string GdalWarper::RasterRequest::canonicalKey() const
+{
+    if (operation != Operation::image) { return key(); }
+    auto noOpt(*this);
+    noOpt.operation = Operation::imageNoOpt;
+    return noOpt.key();
+}
+
+GdalWarper::Raster GdalWarper::Detail::warp(const RasterRequest &req
+                                            , Aborter &aborter)
+{
+    // never let a client wait for speculative work in the background lane
+    if (!options_.coalesce || aborter.background()) {
+        return warpCached(req, aborter);
+    }
+
+    // joins optimized warp of the same tile (e.g. for another interface)
+    // as well
+    return inFlight_
+        (req.key(), optimizedKey(req)
+         , [&]() { return warpCached(req, aborter); }
+         , [&](const std::shared_future<Raster> &future)
+    {
+        // wait for result of the same request already in flight
+        ++coalescedTotal_;
+        coalescedCounter_.event();
+
+        // our own client may give up (or run out of time) meanwhile
+        const auto aborted(std::make_shared<std::atomic<bool>>(false));
+        aborter.setAborter([aborted]() { *aborted = true; });
+        follow(future, *aborted, aborter.deadline());
+    }, &followerRetries);
+}
+
+GdalWarper::Raster GdalWarper::Detail::warpCached(const RasterRequest &req
+                                                  , Aborter &aborter)
+{
+    if (!sharedCache_.enabled()) { return warpSingle(req, aborter); }
+
+    // optimized rasters are valid results of both image operations, the
+    // other way round only if known to be non-empty
+    const bool optimized(req.operation == RasterRequest::Operation::image);
+    const auto key("warp|" + req.canonicalKey());
+    if (auto raster = sharedGet(key, optimized)) { return raster; }
+
+    auto raster(warpSingle(req, aborter));
+    sharedPut(key, raster, optimized);
+    return raster;
+}
+
+GdalWarper::Raster GdalWarper::Detail::sharedGet(const std::string &key
+                                                 , bool optimized)
+{
+    std::string value;
+    if (!sharedCache_.get(key, value)) { return {}; }
+
+    SharedRaster header;
+    if (value.size() < sizeof(header)) { return {}; }
+    std::memcpy(&header, value.data(), sizeof(header));
+
+    const auto size(std::size_t(header.rows) * header.cols
+                    * CV_ELEM_SIZE(header.type));
+    if ((header.rows <= 0) || (header.cols <= 0)
+        || (value.size() != (sizeof(header) + size))
+        || (optimized && !header.optimized))
+    {
+        return {};
+    }
+
+    auto raster(std::make_shared<cv::Mat>(header.rows, header.cols
+                                          , header.type));
+    std::memcpy(raster->data, value.data() + sizeof(header), size);
+    return raster;
+}
+
+void GdalWarper::Detail::sharedPut(const std::string &key
+                                   , const Raster &raster, bool optimized)
+{
+    if (!raster || raster->empty()) { return; }
+
+    const SharedRaster header{ raster->rows, raster->cols, raster->type()
+                               , optimized };
+    const auto rowSize(raster->cols * raster->elemSize());
+
+    std::string value;
+    value.reserve(sizeof(header) + raster->rows * rowSize);
+    value.append(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (int j(0); j < raster->rows; ++j) {
+        value.append(reinterpret_cast<const char*>(raster->ptr(j))
+                     , rowSize);
+    }
+
+    sharedCache_.put(key, value.data(), value.size()
+                     , std::time(nullptr) + options_.sharedCacheTtl);
+}
+
+GdalWarper::Rasters
+GdalWarper::Detail::warpBatch(const RasterRequest &req
+                              , const math::Size2 &tiles, int overlap
+                              , Aborter &aborter)
+{
+    if ((req.operation == RasterRequest::Operation::demOptimal)
+        || (req.operation == RasterRequest::Operation::demOptimalFloat))
+    {
+        throw std::logic_error("Optimal DEM warp cannot be batched.");
+    }
+
+    if ((tiles.width <= 0) || (tiles.height <= 0)
+        || ((req.size.width - overlap) % tiles.width)
+        || ((req.size.height - overlap) % tiles.height))
+    {
+        throw std::logic_error("Batch raster size is not divisible by "
+                               "number of tiles.");
+    }
+
+    // distance between neighbouring tiles
+    const math::Size2 step((req.size.width - overlap) / tiles.width
+                           , (req.size.height - overlap) / tiles.height);
+
+    auto block(warp(req, aborter));
+
+    // slice size is derived from result to take any extra pixels added by
+    // the operation into account
+    const math::Size2 slice(block->cols - (tiles.width - 1) * step.width
+                            , block->rows - (tiles.height - 1) * step.height);
+
+    Rasters slices;
+    slices.reserve(math::area(tiles));
+    for (int j(0); j < tiles.height; ++j) {
+        for (int i(0); i < tiles.width; ++i) {
+            // view into block, keeps block alive
+            slices.emplace_back
+                (new cv::Mat(*block, cv::Rect(i * step.width, j * step.height
+                                              , slice.width, slice.height))
+                 , [block](cv::Mat *mat) { delete mat; });
+        }
+    }
+
+    batchCounter_.event();
+    return slices;
+}
+
+GdalWarper::Raster GdalWarper::Detail::warpSingle(const RasterRequest &req
+                                                  , Aborter &aborter)
+{
+    if (const auto count = splitCount(req, aborter)) {
+        return warpSplit(req, count, aborter);
+    }
+
+    Lock lock(mutex());
+    ShRequest::pointer shReq(ShRequest::create(req, mb_, dataMb_));
+    submit(lock, shReq, aborter);
+    lock.unlock();
+
+    auto result(consume<Raster>(*shReq, &ShRequest::getRaster
+                                , aborter.tracer(), *reclaimer_));
+
+    warpCounter_.event();
+
+    return result;
+}
+
+GdalWarper::Raster GdalWarper::Detail::warpWP(const RasterRequestWP &req
+                                            , Aborter &aborter)
+{
+    Lock lock(mutex());
+    ShRequest::pointer shReq(ShRequest::create(req, mb_, dataMb_));
+    submit(lock, shReq, aborter);
+    lock.unlock();
+
+    auto result(consume<Raster>(*shReq, &ShRequest::getRaster
+                                , aborter.tracer(), *reclaimer_));
+
+    warpCounter_.event();
+
+    return result;
+}
+
+GdalWarper::Heightcoded::pointer GdalWarper::Detail
+::heightcode(const std::string &vectorDs
+             , const DemDataset::list &rasterDs
+             , const GdalWarper::HeightcodeConfig &config
+             , const boost::optional<std::string> &vectorGeoidGrid
+             , const GdalWarper::OpenOptions &openOptions
+             , const LayerEnhancer::map &layerEnhancers
+             , Aborter &aborter)
+{
+    Lock lock(mutex());
+    ShRequest::pointer shReq
+        (ShRequest::create(vectorDs, rasterDs, config, vectorGeoidGrid
+                           , openOptions, layerEnhancers, mb_
+                           , dataMb_));
+    submit(lock, shReq, aborter);
+    lock.unlock();
+
+    auto result(consume<Heightcoded::pointer>
+                (*shReq, &ShRequest::getHeightcoded, aborter.tracer()
+                 , *reclaimer_));
+
+    heightcodeCounter_.event();
+
+    return result;
+}
+
+WorkRequest::Response GdalWarper::Detail
+::job(const WorkGenerator &workGenerator, Aborter &aborter)
+{
+    Lock lock(mutex());
+
+    auto shReq(ShRequest::create(workGenerator, mb_, dataMb_));
+    submit(lock, shReq, aborter);
+    lock.unlock();
+
+    /** Consume response for a work request
+     */
+    return consume<WorkRequest::Response>
+        (*shReq, &ShRequest::consumeWork, aborter.tracer());
+}
+
+void GdalWarper::Detail::recordLatency(const ShRequest &request
+                                       , const Aborter::Tracer &tracer)
+{
+    // aborted requests say nothing about the pipeline
+    if (request.aborted()) { return; }
+
+    const auto durations(request.durations(systemTime()));
+    latency_.record(request.operationName(), request.dataset(), durations);
+
+    if (request.predicted() && request.processing()) {
+        const metrics::Labels labels{{ "operation", request.operationName() }};
+        costPredicted_(labels).inc(request.predicted());
+        costMeasured_(labels).inc(request.processing());
+    }
+
+    if (tracer) {
+        for (auto stage : { LatencyStage::queue, LatencyStage::open
+                    , LatencyStage::warp, LatencyStage::wakeup })
+        {
+            tracer(std::string("gdal-") + latencyStageName(stage)
+                   , durations[int(stage)]);
+        }
+        tracer(Aborter::GdalCpuStage, request.cpu());
+
+        // chosen overview is recorded as (zero-length) stage
+        if (const auto overview = request.overview()) {
+            tracer((*overview < 0) ? std::string("gdal-overview-full")
+                   : str(boost::format("gdal-overview-%d") % *overview)
+                   , 0);
+        }
+    }
+}
+
+namespace {
+
+/** Builds completion that extracts result by given getter and passes it (or
+ *  error) to client's callback.
+ */
+template <typename Result, typename Getter, typename Callback>
+std::function<void()> complete(Lock &lock, const Getter &getter
+                               , const Callback &callback)
+{
+    try {
+        const Result result(getter(lock));
+        return [=]() { callback(result, std::exception_ptr()); };
+    } catch (...) {
+        const auto error(std::current_exception());
+        return [=]() { callback(Result(), error); };
+    }
+}
+
+/** Keeps client's aborter settings and aborted callback after the client
+ *  has returned: asynchronous follower may have to do the work on its own
+ *  long after it has attached to the flight.
+ */
+class HeldAborter : public Aborter {
+public:
+    HeldAborter(Aborter &aborter)
+        : tracer_(aborter.tracer()), traceId_(aborter.traceId())
+        , background_(aborter.background()), deadline_(aborter.deadline())
+        , state_(std::make_shared<State>())
+    {
+        // client's aborter (e.g. a sink) keeps the callback itself
+        const auto state(state_);
+        aborter.setAborter([state]()
+        {
+            AbortedCallback ac;
+            {
+                std::unique_lock<std::mutex> lock(state->mutex);
+                state->aborted = true;
+                ac = state->ac;
+            }
+            if (ac) { ac(); }
+        });
+    }
+
+    virtual void setAborter(const AbortedCallback &ac) {
+        {
+            std::unique_lock<std::mutex> lock(state_->mutex);
+            state_->ac = ac;
+            if (!state_->aborted) { return; }
+        }
+        ac();
+    }
+
+    virtual Tracer tracer() const { return tracer_; }
+    virtual std::uint64_t traceId() const { return traceId_; }
+    virtual bool background() const { return background_; }
+    virtual std::uint64_t deadline() const { return deadline_; }
+
+private:
+    struct State {
+        std::mutex mutex;
+        bool aborted = false;
+        AbortedCallback ac;
+    };
+
+    Tracer tracer_;
+    std::uint64_t traceId_;
+    bool background_;
+    std::uint64_t deadline_;
+    std::shared_ptr<State> state_;
+};
+
+} // namespace
+
+void GdalWarper::Detail::warp(const RasterRequest &req, Aborter &aborter
+                              , const RasterCallback &callback)
+{
+    // never let a client wait for speculative work in the background lane
+    if (!options_.coalesce || aborter.background()) {
+        return warpCached(req, aborter, callback);
+    }
+
+    const auto held(std::make_shared<HeldAborter>(aborter));
+    const bool joined(inFlight_.async
+        (req.key(), optimizedKey(req)
+         , [this, req, held](const RasterCallback &done)
+    {
+        warpCached(req, *held, done);
+    }, callback, &followerRetries));
+
+    if (joined) {
+        ++coalescedTotal_;
+        coalescedCounter_.event();
+    }
+}
+
+void GdalWarper::Detail::warpCached(const RasterRequest &req
+                                    , Aborter &aborter
+                                    , const RasterCallback &userCallback)
+{
+    auto callback(userCallback);
+    if (sharedCache_.enabled()) {
+        const bool optimized
+            (req.operation == RasterRequest::Operation::image);
+        const auto key("warp|" + req.canonicalKey());
+        if (const auto raster = sharedGet(key, optimized)) {
+            callback(raster, std::exception_ptr());
+            return;
+        }
+
+        callback = [this, key, optimized, userCallback]
+            (const Raster &raster, const std::exception_ptr &error)
+        {
+            if (!error) { sharedPut(key, raster, optimized); }
+            userCallback(raster, error);
+        };
+    }
+
+    if (const auto count = splitCount(req, aborter)) {
+        return warpSplit(req, count, aborter, callback);
+    }
+
+    Lock lock(mutex());
+    auto shReq(ShRequest::create(req, mb_, dataMb_));
+    const auto tracer(aborter.tracer());
+    submit(lock, shReq, aborter
+           , [shReq, callback, tracer, this](Lock &lock)
+    {
+        warpCounter_.event();
+        return complete<Raster>(lock, [&](Lock&)
+        {
+            // finished request, never waits
+            return consume<Raster>(*shReq, &ShRequest::getRaster
+                                   , tracer, *reclaimer_);
+        }, callback);
+    });
+}
+
+int GdalWarper::Detail::splitCount(const RasterRequest &req
+                                   , const Aborter &aborter) const
+{
+    // speculative work never occupies more than one worker
+    if (!options_.splitThreshold || aborter.background()
+        || !splittable(req.operation))
+    {
+        return 0;
+    }
+
+    const auto count(std::min({ options_.splitStrips
+                    , std::size_t(autoscaler_->target())
+                    , std::size_t(req.size.height / MinStripRows) }));
+    if (count < 2) { return 0; }
+
+    const auto cost(predict(req));
+    if (!cost || (cost.wall < (options_.splitThreshold * 1000))) {
+        return 0;
+    }
+
+    return int(count);
+}
+
+StripResults GdalWarper::Detail
+::warpStrips(Lock &lock, const std::vector<RasterRequest> &strips
+             , const std::vector<std::size_t> &indices
+             , RasterRequest::Operation operation, Aborter &aborter)
+{
+    admit(lock);
+
+    std::vector<ShRequest::pointer> requests;
+    for (auto index : indices) {
+        auto strip(strips[index]);
+        strip.operation = operation;
+        requests.push_back(ShRequest::create(strip, mb_, dataMb_));
+        requests.back()->traceId(aborter.traceId());
+        requests.back()->deadline(aborter.deadline());
+        enqueue(requests.back());
+    }
+    bindAborter(requests, aborter);
+
+    // strips are waited for on their own locks
+    lock.unlock();
+
+    const auto tracer(aborter.tracer());
+    StripResults results(strips.size());
+    for (std::size_t i(0); i < indices.size(); ++i) {
+        auto &result(results[indices[i]]);
+        try {
+            result.raster = consume<Raster>(*requests[i]
+                                            , &ShRequest::getRaster, tracer
+                                            , *reclaimer_);
+        } catch (const EmptyImage&) {
+            result.empty = true;
+        } catch (...) {
+            result.error = std::current_exception();
+        }
+    }
+
+    lock.lock();
+    return results;
+}
+
+GdalWarper::Raster GdalWarper::Detail::warpSplit(const RasterRequest &req
+                                                 , int count
+                                                 , Aborter &aborter)
+{
+    if (const auto tracer = aborter.tracer()) {
+        tracer(str(boost::format("gdal-split-%d") % count), 0);
+    }
+
+    const auto strips(splitRequest(req, count));
+    std::vector<std::size_t> indices(count);
+    std::iota(indices.begin(), indices.end(), 0);
+
+    Lock lock(mutex());
+    auto results(warpStrips(lock, strips, indices, req.operation, aborter));
+
+    // partially covered image: warp empty strips without optimization
+    const auto retry(stripsToRetry(req.operation, results));
+    if (!retry.empty()) {
+        auto retried(warpStrips(lock, strips, retry
+                                , RasterRequest::Operation::imageNoOpt
+                                , aborter));
+        for (auto index : retry) { results[index] = retried[index]; }
+        stripsToRetry(req.operation, results);
+    }
+    lock.unlock();
+
+    warpCounter_.event();
+    splitCounter_.event();
+
+    return joinStrips(req.operation, results);
+}
+
+void GdalWarper::Detail::warpSplit(const RasterRequest &req, int count
+                                   , Aborter &aborter
+                                   , const RasterCallback &callback)
+{
+    const auto tracer(aborter.tracer());
+    if (tracer) { tracer(str(boost::format("gdal-split-%d") % count), 0); }
+
+    auto join(std::make_shared<StripJoin>(req, count, tracer, callback));
+    join->traceId = aborter.traceId();
+    join->deadline = aborter.deadline();
+    std::vector<std::size_t> indices(count);
+    std::iota(indices.begin(), indices.end(), 0);
+
+    Lock lock(mutex());
+    admit(lock);
+    startCompleter();
+    submitStrips(lock, join, indices);
+
+    // aborts strips of the current round, stops any further round
+    std::weak_ptr<StripJoin> wjoin(join);
+    aborter.setAborter([wjoin, this]()
+    {
+        auto join(wjoin.lock());
+        if (!join) { return; }
+
+        std::vector<ShRequest::pointer> parts;
+        {
+            Lock lock(mutex());
+            join->aborted = true;
+            parts = join->parts;
+        }
+        for (const auto &part : parts) { part->abort(mutex()); }
+    });
+}
+
+void GdalWarper::Detail::submitStrips(Lock&, const StripJoin::pointer &join
+                                      , const std::vector<std::size_t> &indices)
+{
+    join->parts.clear();
+    join->remaining = indices.size();
+
+    for (auto index : indices) {
+        auto strip(join->strips[index]);
+        if (join->retried) {
+            strip.operation = RasterRequest::Operation::imageNoOpt;
+        }
+
+        auto shReq(ShRequest::create(strip, mb_, dataMb_));
+        shReq->traceId(join->traceId);
+        shReq->deadline(join->deadline);
+        shReq->notify(doneCond_);
+        pending_.emplace_back(shReq, [join, shReq, index, this](Lock &lock)
+        {
+            return stripDone(lock, join, shReq, index);
+        });
+        join->parts.push_back(shReq);
+        enqueue(shReq);
+    }
+}
+
+std::function<void()> GdalWarper::Detail
+::stripDone(Lock &lock, const StripJoin::pointer &join
+            , const ShRequest::pointer &request, std::size_t index)
+{
+    auto &result(join->results[index]);
+    result = StripResult();
+    try {
+        result.raster = consume<Raster>(*request, &ShRequest::getRaster
+                                        , join->tracer, *reclaimer_);
+    } catch (const EmptyImage&) {
+        result.empty = true;
+    } catch (...) {
+        result.error = std::current_exception();
+    }
+
+    // wait for the rest of this round
+    if (--join->remaining) { return []() {}; }
+
+    try {
+        if (join->aborted) {
+            throw RequestAborted("Request has been aborted");
+        }
+
+        const auto retry(stripsToRetry(join->request.operation
+                                       , join->results));
+        if (!retry.empty() && join->retried) {
+            throw EmptyImage("No valid data.");
+        }
+
+        if (retry.empty()) {
+            warpCounter_.event();
+            splitCounter_.event();
+            const auto raster(joinStrips(join->request.operation
+                                         , join->results));
+            join->parts.clear();
+            return [join, raster]() {
+                join->callback(raster, std::exception_ptr());
+            };
+        }
+
+        // partially covered image: warp empty strips without optimization
+        join->retried = true;
+        submitStrips(lock, join, retry);
+        return []() {};
+    } catch (...) {
+        const auto error(std::current_exception());
+        join->parts.clear();
+        return [join, error]() { join->callback(Raster(), error); };
+    }
+}
+
+void GdalWarper::Detail::warpWP(const RasterRequestWP &req, Aborter &aborter
+                                , const RasterCallback &callback)
+{
+    Lock lock(mutex());
+    auto shReq(ShRequest::create(req, mb_, dataMb_));
+    const auto tracer(aborter.tracer());
+    submit(lock, shReq, aborter
+           , [shReq, callback, tracer, this](Lock &lock)
+    {
+        warpCounter_.event();
+        return complete<Raster>(lock, [&](Lock&)
+        {
+            // finished request, never waits
+            return consume<Raster>(*shReq, &ShRequest::getRaster
+                                   , tracer, *reclaimer_);
+        }, callback);
+    });
+}
+
+void GdalWarper::Detail
+::heightcode(const std::string &vectorDs
+             , const DemDataset::list &rasterDs
+             , const GdalWarper::HeightcodeConfig &config
+             , const boost::optional<std::string> &vectorGeoidGrid
+             , const GdalWarper::OpenOptions &openOptions
+             , const LayerEnhancer::map &layerEnhancers
+             , Aborter &aborter
+             , const HeightcodedCallback &callback)
+{
+    Lock lock(mutex());
+    auto shReq(ShRequest::create(vectorDs, rasterDs, config, vectorGeoidGrid
+                                 , openOptions, layerEnhancers, mb_
+                           , dataMb_));
+    const auto tracer(aborter.tracer());
+    submit(lock, shReq, aborter
+           , [shReq, callback, tracer, this](Lock &lock)
+    {
+        heightcodeCounter_.event();
+        return complete<Heightcoded::pointer>(lock, [&](Lock&)
+        {
+            return consume<Heightcoded::pointer>
+                (*shReq, &ShRequest::getHeightcoded, tracer
+                 , *reclaimer_);
+        }, callback);
+    });
+}
+
+void GdalWarper::Detail::job(const WorkGenerator &workGenerator
+                             , Aborter &aborter, const JobCallback &callback)
+{
+    Lock lock(mutex());
+    auto shReq(ShRequest::create(workGenerator, mb_, dataMb_));
+    const auto tracer(aborter.tracer());
+    submit(lock, shReq, aborter
+           , [shReq, callback, tracer, this](Lock &lock)
+    {
+        return complete<WorkResponse>(lock, [&](Lock&)
+        {
+            return consume<WorkRequest::Response>
+                (*shReq, &ShRequest::consumeWork, tracer);
+        }, callback);
+    });
+}
+
+void GdalWarper::Detail::inFlight(std::ostream &os) const
+{
+    const auto now(systemTime());
+
+    Lock lock(mutex());
+    for (const auto &item : *workerStats_) {
+        if (item.second.request) {
+            item.second.request->dump(os, item.first, now);
+        }
+    }
+    for (const auto &req : *queue_) { req->dump(os, 0, now); }
+}
+
+void GdalWarper::Detail::stat(std::ostream &os) const
+{
+    warpCounter_.averageAndMax(os, "gdal.warp.");
+    if (options_.coalesce) {
+        coalescedCounter_.averageAndMax(os, "gdal.warp.coalesced.");
+        os << "gdal.warp.coalesced.total=" << coalescedTotal_ << '\n';
+    }
+    batchCounter_.averageAndMax(os, "gdal.warp.batch.");
+    if (options_.splitThreshold) {
+        splitCounter_.averageAndMax(os, "gdal.warp.split.");
+    }
+    heightcodeCounter_.averageAndMax(os, "gdal.heightcode.");
+    if (sharedCache_.enabled()) {
+        sharedCache_.stat(os, "gdal.sharedCache.");
+    }
+    shmCounter_.max(os, "gdal.shm.used.");
+    os << "gdal.shm.total=" << (mb_.get_size() + dataMb_.get_size()) << '\n'
+       << "gdal.shm.control.free=" << mb_.get_free_memory() << '\n'
+       << "gdal.shm.data.free=" << dataMb_.get_free_memory() << '\n'
+       << "gdal.shm.rejected=" << shmRejected_ << '\n'
+       << "gdal.shm.hugepages=" << mem_.hugepages() << '\n';
+    matPool_->stat(os, "gdal.shm.data.pool.");
+    interned_->stat(os, "gdal.shm.interned.");
+    reclaimer_->stat(os, "gdal.shm.data.reclaimer.");
+    queueCounter_.max(os, "gdal.shm.enqueued.");
+
+    {
+        // saved CPU time is estimated from the average CPU time of
+        // regularly finished requests
+        const std::uint64_t dropped(abortStats_->dropped);
+        const std::uint64_t cancelled(abortStats_->cancelled);
+        const std::uint64_t cancelledCpu(abortStats_->cancelledCpu);
+        const std::uint64_t finished(abortStats_->finished);
+        const std::uint64_t finishedCpu(abortStats_->finishedCpu);
+
+        const double average(finished ? (double(finishedCpu) / finished) : 0);
+        const double saved
+            (std::max(0.0, average * (dropped + cancelled) - cancelledCpu));
+
+        os << "gdal.aborted.dropped=" << dropped << '\n'
+           << "gdal.aborted.cancelled=" << cancelled << '\n'
+           << "gdal.aborted.cpuSpent=" << (cancelledCpu / 1e6) << '\n'
+           << "gdal.aborted.cpuSaved=" << (saved / 1e6) << '\n'
+           << "gdal.deadline.dropped=" << abortStats_->deadlineDropped
+           << '\n'
+           << "gdal.deadline.cancelled=" << abortStats_->deadlineCancelled
+           << '\n'
+           << "gdal.deadline.cpuSpent="
+           << (abortStats_->deadlineCancelledCpu / 1e6) << '\n';
+    }
+
+    for (std::size_t lane(0); lane < PriorityCount; ++lane) {
+        os << "gdal.queue." << priorityName(static_cast<Priority>(lane))
+           << ".served=" << queueStats_->served[lane] << '\n';
+    }
+    os << "gdal.queue.expired=" << queueStats_->expired << '\n';
+
+    latency_.stat(os, "gdal.latency.");
+
+    {
+        Lock lock(mutex());
+        os << "gdal.cost.keys=" << costModel_->size() << '\n'
+           << "gdal.cost.recorded=" << costModel_->recorded() << '\n';
+    }
+
+    if (options_.affinity) {
+        const std::uint64_t hit(affinityStats_->hit);
+        const std::uint64_t miss(affinityStats_->miss);
+        const std::uint64_t steal(affinityStats_->steal);
+        const auto total(hit + miss + steal);
+
+        os << "gdal.affinity.hit=" << hit << '\n'
+           << "gdal.affinity.miss=" << miss << '\n'
+           << "gdal.affinity.steal=" << steal << '\n'
+           << "gdal.affinity.hitRate="
+           << (total ? (double(hit) / total) : 0.0) << '\n';
+    }
+
+    if (autoscaler_->enabled()) { autoscaler_->stat(os, "gdal.autoscale."); }
+
+    // per-worker dataset cache stats
+    std::vector<WorkerStats> workers;
+    {
+        Lock lock(mutex());
+        for (const auto &item : *workerStats_) {
+            workers.push_back(item.second);
+        }
+    }
+
+    WorkerStats total;
+    for (const auto &ws : workers) {
+        const auto prefix(str(boost::format("gdal.worker.%u.datasets.")
+                              % ws.id));
+        os << prefix << "open=" << ws.datasets << '\n'
+           << prefix << "hits=" << ws.cache.hits << '\n'
+           << prefix << "misses=" << ws.cache.misses << '\n'
+           << prefix << "evictions=" << ws.cache.evictions << '\n'
+           << prefix << "blockFlushes=" << ws.cache.blockFlushes << '\n';
+
+        const auto vprefix(str(boost::format("gdal.worker.%u.vectors.")
+                               % ws.id));
+        os << vprefix << "open=" << ws.vectors << '\n'
+           << vprefix << "hits=" << ws.cache.vectorHits << '\n'
+           << vprefix << "misses=" << ws.cache.vectorMisses << '\n'
+           << vprefix << "evictions=" << ws.cache.vectorEvictions << '\n';
+
+        // page faults at worker start and taken since then
+        const auto fprefix(str(boost::format("gdal.worker.%u.faults.")
+                               % ws.id));
+        os << fprefix << "minor.start=" << ws.startMinorFaults << '\n'
+           << fprefix << "minor=" << (ws.minorFaults - ws.startMinorFaults)
+           << '\n'
+           << fprefix << "major.start=" << ws.startMajorFaults << '\n'
+           << fprefix << "major=" << (ws.majorFaults - ws.startMajorFaults)
+           << '\n';
+
+        total.datasets += ws.datasets;
+        total.vectors += ws.vectors;
+        total.cache.hits += ws.cache.hits;
+        total.cache.misses += ws.cache.misses;
+        total.cache.evictions += ws.cache.evictions;
+        total.cache.blockFlushes += ws.cache.blockFlushes;
+        total.cache.vectorHits += ws.cache.vectorHits;
+        total.cache.vectorMisses += ws.cache.vectorMisses;
+        total.cache.vectorEvictions += ws.cache.vectorEvictions;
+    }
+
+    os << "gdal.datasets.open=" << total.datasets << '\n'
+       << "gdal.datasets.hits=" << total.cache.hits << '\n'
+       << "gdal.datasets.misses=" << total.cache.misses << '\n'
+       << "gdal.datasets.evictions=" << total.cache.evictions << '\n'
+       << "gdal.datasets.blockFlushes=" << total.cache.blockFlushes << '\n'
+       << "gdal.vectors.open=" << total.vectors << '\n'
+       << "gdal.vectors.hits=" << total.cache.vectorHits << '\n'
+       << "gdal.vectors.misses=" << total.cache.vectorMisses << '\n'
+       << "gdal.vectors.evictions=" << total.cache.vectorEvictions << '\n';
+
+    // per-dataset block cache usage, most requested first
+    struct Blocks {
+        std::string path;
+        std::uint64_t hits;
+        std::uint64_t misses;
+    };
+    std::vector<Blocks> blocks;
+    {
+        Lock lock(mutex());
+        for (const auto &item : *blockUsage_) {
+            const auto &bu(item.second);
+            blocks.push_back({ std::string(bu.path.data(), bu.path.size())
+                               , bu.hits, bu.misses });
+        }
+    }
+    std::sort(blocks.begin(), blocks.end()
+              , [](const Blocks &l, const Blocks &r)
+    {
+        return (l.hits + l.misses) > (r.hits + r.misses);
+    });
+
+    std::size_t index(0);
+    for (const auto &b : blocks) {
+        const auto prefix(str(boost::format("gdal.blocks.%u.") % index++));
+        const auto total(b.hits + b.misses);
+        os << prefix << "dataset=" << b.path << '\n'
+           << prefix << "hits=" << b.hits << '\n'
+           << prefix << "misses=" << b.misses << '\n'
+           << prefix << "hitRate="
+           << (total ? (double(b.hits) / total) : 0.0) << '\n';
+    }
+
+    // per-dataset dispatch, most dispatched first
+    struct Dispatch {
+        std::string path;
+        unsigned int running;
+        std::uint64_t dispatched;
+        std::uint64_t waitSum;
+        std::uint64_t waitMax;
+        std::uint64_t deferred;
+    };
+    std::vector<Dispatch> dispatch;
+    {
+        Lock lock(mutex());
+        for (const auto &item : *dispatch_) {
+            const auto &d(item.second);
+            dispatch.push_back({ std::string(d.path.data(), d.path.size())
+                                 , d.running, d.dispatched, d.waitSum
+                                 , d.waitMax, d.deferred });
+        }
+    }
+    std::sort(dispatch.begin(), dispatch.end()
+              , [](const Dispatch &l, const Dispatch &r)
+    {
+        return l.dispatched > r.dispatched;
+    });
+
+    index = 0;
+    for (const auto &d : dispatch) {
+        const auto prefix(str(boost::format("gdal.dispatch.%u.") % index++));
+        os << prefix << "dataset=" << d.path << '\n'
+           << prefix << "limit=" << concurrencyLimit(d.path) << '\n'
+           << prefix << "running=" << d.running << '\n'
+           << prefix << "dispatched=" << d.dispatched << '\n'
+           << prefix << "deferred=" << d.deferred << '\n'
+           << prefix << "waitAvg="
+           << (d.dispatched ? (d.waitSum / 1e6 / d.dispatched) : 0.0) << '\n'
+           << prefix << "waitMax=" << (d.waitMax / 1e6) << '\n';
+    }
+}
+
+void GdalWarper::Detail::metrics(metrics::Writer &writer) const
+{
+    writer.write(costPredicted_);
+    writer.write(costMeasured_);
+    writer.gauge("mapproxy_gdal_shm_used_bytes"
+                 , "Used shared memory (sampled).", shmUsed_);
+    writer.gauge("mapproxy_gdal_shm_total_bytes", "Total shared memory."
+                 , mb_.get_size() + dataMb_.get_size());
+    writer.counter("mapproxy_gdal_shm_rejected"
+                   , "Requests rejected due to lack of shared memory."
+                   , shmRejected_);
+    writer.gauge("mapproxy_gdal_queue_depth"
+                 , "Requests waiting in the warper queue (sampled)."
+                 , queueDepth_);
+    writer.counter("mapproxy_gdal_queue_expired"
+                   , "Requests expired in the warper queue."
+                   , queueStats_->expired);
+
+    writer.counter("mapproxy_gdal_aborted_dropped"
+                   , "Aborted requests dropped before processing."
+                   , abortStats_->dropped);
+    writer.counter("mapproxy_gdal_aborted_cancelled"
+                   , "Aborted requests cancelled while being processed."
+                   , abortStats_->cancelled);
+    writer.counter("mapproxy_gdal_deadline_dropped"
+                   , "Requests past deadline dropped before processing."
+                   , abortStats_->deadlineDropped);
+    writer.counter("mapproxy_gdal_deadline_cancelled"
+                   , "Requests past deadline cancelled while being processed."
+                   , abortStats_->deadlineCancelled);
+    writer.counter("mapproxy_gdal_finished"
+                   , "Regularly finished requests.", abortStats_->finished);
+
+    writer.gauge("mapproxy_gdal_workers_target"
+                 , "Target number of worker processes."
+                 , autoscaler_->target());
+    writer.counter("mapproxy_gdal_workers_spawned"
+                   , "Started worker processes.", processStats_->spawned);
+    writer.counter("mapproxy_gdal_workers_crashed"
+                   , "Worker processes terminated unexpectedly."
+                   , processStats_->crashed);
+    writer.counter("mapproxy_gdal_workers_recycled"
+                   , "Worker processes recycled after draining."
+                   , processStats_->recycled);
+
+    if (sharedCache_.enabled()) {
+        sharedCache_.metrics(writer, "mapproxy_gdal_shared_cache_");
+    }
+}
+
+void GdalWarper::stat(std::ostream &os) const
+{
+    detail().stat(os);
+}
+
+GdalWarper::Cost GdalWarper::predict(const RasterRequest &request) const
+{
+    return detail().predict(request);
+}
+
+GdalWarper::Cost GdalWarper::predict(const std::string &operation
+                                     , const std::string &dataset) const
+{
+    return detail().predict(operation, dataset);
+}
+
+void GdalWarper::inFlight(std::ostream &os) const
+{
+    detail().inFlight(os);
+}
+
+void GdalWarper::metrics(metrics::Writer &writer) const
+{
+    detail().metrics(writer);
 }
@@ -0,0 +1,170 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "dbglog/dbglog.hpp"
+
+#include "../error.hpp"
+
+#include "heightcodebatch.hpp"
+#include "operations.hpp"
+
+namespace {
+
+/** DEMs larger than this (in pixels) are not cropped into memory.
+ */
+const std::size_t MaxPatchPixels(4096 * 4096);
+
+} // namespace
+
+HeightcodeBatch
+::HeightcodeBatch(const WorkRequestParams &params
+                  , const GdalWarper::HeightcodeTile::list &tiles
+                  , const DemDataset::list &rasterDs
+                  , const boost::optional<std::string> &vectorGeoidGrid
+                  , const LayerEnhancer::map &layerEnhancers)
+    : WorkRequest(params.sm)
+    , tiles_(params.sm.get_allocator<ShHeightCode*>())
+    , responses_(tiles.size(), nullptr
+                 , params.sm.get_allocator<GdalWarper::Heightcoded*>())
+    , errorTypes_(tiles.size(), int(ErrorType::none)
+                  , params.sm.get_allocator<int>())
+    , errors_(params.sm.get_allocator<String>())
+{
+    auto &sm(params.sm);
+    for (const auto &tile : tiles) {
+        // responses are kept here, there is no owning request to notify
+        tiles_.push_back(sm.construct<ShHeightCode>(bi::anonymous_instance)
+                         (tile.vectorDs, rasterDs, tile.config
+                          , vectorGeoidGrid, tile.openOptions
+                          , layerEnhancers, sm, nullptr));
+        errors_.emplace_back(sm.get_allocator<char>());
+    }
+}
+
+HeightcodeBatch::~HeightcodeBatch()
+{
+    for (auto *response : responses_) {
+        if (response) { sm().deallocate(response); }
+    }
+    for (auto *tile : tiles_) { sm().destroy_ptr(tile); }
+}
+
+void HeightcodeBatch::process(Mutex&, DatasetCache &cache)
+{
+    if (tiles_.empty()) { return; }
+
+    const auto &front(*tiles_.front());
+    HeightcodeRasters rasters(cache, front.rasterDs());
+
+    // crop DEMs to union of tiles when all of them live in the same SRS
+    if (tiles_.size() > 1) {
+        const auto frontConfig(front.config());
+        boost::optional<math::Extents2> extents;
+        bool crop(frontConfig.workingSrs
+                  && frontConfig.clipWorkingExtents);
+
+        for (auto itiles(tiles_.begin()), etiles(tiles_.end());
+             crop && (itiles != etiles); ++itiles)
+        {
+            const auto config((*itiles)->config());
+            if (!config.workingSrs || !config.clipWorkingExtents
+                || (config.workingSrs->srs != frontConfig.workingSrs->srs))
+            {
+                crop = false;
+                break;
+            }
+
+            if (extents) {
+                math::update(*extents, config.clipWorkingExtents->ll);
+                math::update(*extents, config.clipWorkingExtents->ur);
+            } else {
+                extents = *config.clipWorkingExtents;
+            }
+        }
+
+        if (crop) {
+            rasters.crop(*frontConfig.workingSrs, *extents, MaxPatchPixels);
+        }
+    }
+
+    for (std::size_t i(0), e(tiles_.size()); i != e; ++i) {
+        const auto &tile(*tiles_[i]);
+        try {
+            responses_[i] = ::heightcode
+                (cache, sm(), tile.vectorDs(), rasters, tile.config()
+                 , tile.vectorGeoidGrid(), tile.openOptions()
+                 , tile.layerEnhancers());
+        } catch (const EmptyGeoData &e) {
+            errorTypes_[i] = int(ErrorType::emptyGeoData);
+            errors_[i].assign(e.what());
+        } catch (const std::exception &e) {
+            LOG(err2) << "Batched heightcoding of <" << tile.vectorDs()
+                      << "> failed: " << e.what();
+            errorTypes_[i] = int(ErrorType::other);
+            errors_[i].assign(e.what());
+        }
+    }
+}
+
+WorkRequest::Response HeightcodeBatch::response(Lock&)
+{
+    auto results(std::make_shared<GdalWarper::HeightcodedTile::list>
+                 (tiles_.size()));
+
+    auto &sm(this->sm());
+    for (std::size_t i(0), e(tiles_.size()); i != e; ++i) {
+        auto &result((*results)[i]);
+
+        switch (ErrorType(errorTypes_[i])) {
+        case ErrorType::none: break;
+
+        case ErrorType::emptyGeoData:
+            result.error = std::make_exception_ptr
+                (EmptyGeoData(asString(errors_[i])));
+            continue;
+
+        case ErrorType::other:
+            result.error = std::make_exception_ptr
+                (std::runtime_error(asString(errors_[i])));
+            continue;
+        }
+
+        if (auto *response = responses_[i]) {
+            responses_[i] = nullptr;
+            result.heightcoded = GdalWarper::Heightcoded::pointer
+                (response, [&sm](GdalWarper::Heightcoded *block)
+            {
+                // deallocate data
+                sm.deallocate(block);
+            });
+        } else {
+            result.error = std::make_exception_ptr
+                (std::runtime_error("No heightcoded data generated."));
+        }
+    }
+
+    return results;
+}
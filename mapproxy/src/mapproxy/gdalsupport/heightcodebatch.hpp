@@ -0,0 +1,80 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef mapproxy_gdalsupport_heightcodebatch_hpp_included_
+#define mapproxy_gdalsupport_heightcodebatch_hpp_included_
+
+#include "../gdalsupport.hpp"
+#include "workrequest.hpp"
+#include "requests.hpp"
+
+/** Batched heightcoding job: several vector datasets heightcoded using the
+ *  same raster datasets in one go (see GdalWarper::heightcode(tiles...)).
+ *
+ *  Response is GdalWarper::HeightcodedTile::list.
+ */
+class HeightcodeBatch : public WorkRequest {
+public:
+    HeightcodeBatch(const WorkRequestParams &params
+                    , const GdalWarper::HeightcodeTile::list &tiles
+                    , const DemDataset::list &rasterDs
+                    , const boost::optional<std::string> &vectorGeoidGrid
+                    , const LayerEnhancer::map &layerEnhancers);
+
+    ~HeightcodeBatch();
+
+    virtual void process(Mutex &mutex, DatasetCache &cache);
+
+    virtual Response response(Lock &lock);
+
+    /** Destroys this object. Only to be called from warper machinery.
+     */
+    virtual void destroy() { sm().destroy_ptr(this); }
+
+private:
+    enum class ErrorType { none, emptyGeoData, other };
+
+    typedef bi::vector<ShHeightCode*
+                       , bi::allocator<ShHeightCode*, SegmentManager>>
+        ShHeightCodeList;
+
+    typedef bi::vector<GdalWarper::Heightcoded*
+                       , bi::allocator<GdalWarper::Heightcoded*
+                                       , SegmentManager>>
+        ResponseList;
+
+    /** Per-tile requests (DEM list is the same in all of them).
+     */
+    ShHeightCodeList tiles_;
+
+    /** Per tile responses and errors.
+     */
+    ResponseList responses_;
+    IntVector errorTypes_;
+    StringVector errors_;
+};
+
+#endif // mapproxy_gdalsupport_heightcodebatch_hpp_included_
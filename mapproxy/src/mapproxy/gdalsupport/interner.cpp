@@ -0,0 +1,153 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <map>
+#include <mutex>
+#include <utility>
+
+#include "../support/hash.hpp"
+
+#include "interner.hpp"
+
+namespace {
+
+/** Process-local copies of resolved strings. Node-based map, i.e. returned
+ *  references stay valid.
+ */
+struct LocalCache {
+    std::mutex mutex;
+    std::map<std::pair<const InternTable*, InternTable::Id>
+             , std::string> strings;
+};
+
+LocalCache& localCache()
+{
+    static LocalCache cache;
+    return cache;
+}
+
+/** Default number of interned strings.
+ */
+const std::size_t DefaultLimit(4096);
+
+} // namespace
+
+constexpr InternTable::Id InternTable::None;
+
+InternTable::InternTable(ManagedBuffer &sm, std::size_t limit)
+    : limit_(limit)
+    , ids_(std::less<std::uint64_t>(), sm.get_allocator<Mapping>())
+    , strings_(sm.get_allocator<String>())
+    , overflow_(0)
+{}
+
+InternTable& InternTable::instance(ManagedBuffer &sm)
+{
+    return *sm.find_or_construct<InternTable>(bi::unique_instance)
+        (sm, DefaultLimit);
+}
+
+InternTable::Id InternTable::intern(const std::string &value)
+{
+    if (value.empty()) { return None; }
+
+    const auto hash(stableHash(value));
+
+    Lock lock(mutex_);
+    auto fids(ids_.find(hash));
+    if (fids != ids_.end()) {
+        const auto &str(strings_[fids->second - 1]);
+        if ((str.size() == value.size())
+            && !value.compare(0, value.size(), str.data(), str.size()))
+        {
+            return fids->second;
+        }
+
+        // collision, keep the first one
+        ++overflow_;
+        return None;
+    }
+
+    if (strings_.size() >= limit_) {
+        ++overflow_;
+        return None;
+    }
+
+    strings_.push_back(String(value.data(), value.size()
+                              , strings_.get_allocator()));
+    const Id id(strings_.size());
+    ids_.insert(Mapping(hash, id));
+    return id;
+}
+
+const std::string& InternTable::lookup(Id id) const
+{
+    auto &cache(localCache());
+    const auto key(std::make_pair(this, id));
+
+    std::unique_lock<std::mutex> localLock(cache.mutex);
+    auto fstrings(cache.strings.find(key));
+    if (fstrings != cache.strings.end()) { return fstrings->second; }
+
+    std::string value;
+    {
+        Lock lock(mutex_);
+        value = asString(strings_.at(id - 1));
+    }
+    return cache.strings.emplace(key, std::move(value)).first->second;
+}
+
+void InternTable::stat(std::ostream &os, const std::string &prefix) const
+{
+    std::size_t size;
+    {
+        Lock lock(mutex_);
+        size = strings_.size();
+    }
+
+    os << prefix << "size=" << size << '\n'
+       << prefix << "limit=" << limit_ << '\n'
+       << prefix << "overflow=" << overflow_ << '\n';
+}
+
+ShInterned::ShInterned(const std::string &value, ManagedBuffer &sm)
+    : table_(&InternTable::instance(sm))
+    , id_(table_->intern(value))
+    , value_(sm.get_allocator<char>())
+{
+    if (!id_) { value_.assign(value.data(), value.size()); }
+}
+
+ShInterned::ShInterned(ManagedBuffer &sm)
+    : table_(nullptr), id_(InternTable::None)
+    , value_(sm.get_allocator<char>())
+{}
+
+std::string ShInterned::str() const
+{
+    if (id_) { return table_->lookup(id_); }
+    return asString(value_);
+}
@@ -0,0 +1,117 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef mapproxy_gdalsupport_interner_hpp_included_
+#define mapproxy_gdalsupport_interner_hpp_included_
+
+#include <atomic>
+#include <string>
+#include <cstdint>
+#include <ostream>
+
+#include <boost/noncopyable.hpp>
+#include <boost/interprocess/containers/map.hpp>
+
+#include "types.hpp"
+
+/** Table of interned strings in the control arena.
+ *
+ *  Requests carry small IDs of dataset paths, SRS definitions and options
+ *  instead of their own copies since most requests reuse small set of them.
+ *  Entries are never removed, i.e. IDs are stable. Table is bounded,
+ *  strings not fitting in are stored by value (see ShInterned).
+ *
+ *  Resolved strings are cached in each process: shared table is touched
+ *  (under its own lock) only on the first use of an ID in given process.
+ */
+class InternTable : boost::noncopyable {
+public:
+    typedef std::uint32_t Id;
+
+    /** Not interned.
+     */
+    static constexpr Id None = 0;
+
+    InternTable(ManagedBuffer &sm, std::size_t limit);
+
+    /** Returns table of given segment, created on first use.
+     */
+    static InternTable& instance(ManagedBuffer &sm);
+
+    /** Returns ID of given string, interns it if not known yet. Returns None
+     *  for empty string or when the table is full.
+     */
+    Id intern(const std::string &value);
+
+    /** Returns interned string.
+     */
+    const std::string& lookup(Id id) const;
+
+    void stat(std::ostream &os, const std::string &prefix) const;
+
+private:
+    typedef std::pair<const std::uint64_t, Id> Mapping;
+    typedef bi::map<std::uint64_t, Id, std::less<std::uint64_t>
+                    , bi::allocator<Mapping, SegmentManager>> Ids;
+
+    const std::size_t limit_;
+
+    mutable Mutex mutex_;
+
+    /** String hash -> ID (ID = index in strings_ + 1).
+     */
+    Ids ids_;
+    StringVector strings_;
+
+    /** Strings stored by value due to full table or hash collision.
+     */
+    std::atomic<std::uint64_t> overflow_;
+};
+
+/** String stored as interned ID if possible, by value otherwise.
+ */
+class ShInterned {
+public:
+    ShInterned(const std::string &value, ManagedBuffer &sm);
+
+    /** Empty string.
+     */
+    explicit ShInterned(ManagedBuffer &sm);
+
+    std::string str() const;
+
+    bool empty() const { return !id_ && value_.empty(); }
+
+private:
+    InternTable *table_;
+    InternTable::Id id_;
+    String value_;
+};
+
+typedef bi::vector<ShInterned, bi::allocator<ShInterned, SegmentManager>>
+    ShInternedVector;
+
+#endif // mapproxy_gdalsupport_interner_hpp_included_
@@ -0,0 +1,194 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cmath>
+#include <cctype>
+#include <algorithm>
+
+#include "latency.hpp"
+
+namespace {
+
+/** Dataset path sanitized to be usable inside a stat key.
+ */
+std::string statKey(std::string key)
+{
+    for (auto &c : key) {
+        if ((c == '=') || std::isspace(static_cast<unsigned char>(c))) {
+            c = '_';
+        }
+    }
+    return key;
+}
+
+void percentiles(std::ostream &os, const std::string &prefix
+                 , const LatencyHistogram &histogram)
+{
+    os << prefix << "count=" << histogram.count() << '\n';
+    for (const auto p : { 50, 90, 99 }) {
+        os << prefix << 'p' << p << '='
+           << (histogram.percentile(p) / 1e3) << '\n';
+    }
+}
+
+} // namespace
+
+const char* latencyStageName(LatencyStage stage)
+{
+    switch (stage) {
+    case LatencyStage::queue: return "queue";
+    case LatencyStage::open: return "open";
+    case LatencyStage::warp: return "warp";
+    case LatencyStage::wakeup: return "wakeup";
+    case LatencyStage::total: return "total";
+    }
+    return "unknown";
+}
+
+void LatencyHistogram::record(std::uint64_t usec)
+{
+    std::size_t bucket(0);
+    if (usec > 1) {
+        bucket = std::min<std::size_t>
+            (BucketCount - 1, std::size_t(4.0 * std::log2(double(usec))));
+    }
+    ++buckets_[bucket];
+    ++count_;
+}
+
+LatencyHistogram& LatencyHistogram::operator+=(const LatencyHistogram &other)
+{
+    for (std::size_t i(0); i < BucketCount; ++i) {
+        buckets_[i] += other.buckets_[i];
+    }
+    count_ += other.count_;
+    return *this;
+}
+
+std::uint64_t LatencyHistogram::percentile(double p) const
+{
+    if (!count_) { return 0; }
+
+    const auto rank(std::max<std::uint64_t>
+                    (1, std::uint64_t(std::ceil(count_ * p / 100.0))));
+
+    std::uint64_t seen(0);
+    std::size_t bucket(0);
+    for (; bucket < BucketCount; ++bucket) {
+        if ((seen += buckets_[bucket]) >= rank) { break; }
+    }
+
+    // upper bound of the bucket
+    return std::uint64_t(std::exp2((bucket + 1) / 4.0));
+}
+
+LatencyStats::LatencyStats(Clock::duration window, std::size_t datasetLimit)
+    : window_(window), datasetLimit_(datasetLimit), started_(Clock::now())
+{}
+
+void LatencyStats::rotate(const Clock::time_point &now) const
+{
+    if ((now - started_) < window_) { return; }
+
+    // more than one window without any rotation -> previous is stale too
+    if ((now - started_) >= 2 * window_) {
+        previous_ = Generation();
+    } else {
+        previous_ = std::move(current_);
+    }
+    current_ = Generation();
+    started_ = now;
+}
+
+void LatencyStats::record(const std::string &operation
+                          , const std::string &dataset
+                          , const Durations &durations)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    rotate(Clock::now());
+
+    auto &op(current_.operations[operation]);
+
+    auto fdataset(current_.datasets.find(dataset));
+    if (fdataset == current_.datasets.end()) {
+        if (current_.datasets.size() < datasetLimit_) {
+            fdataset = current_.datasets.insert
+                (StagesMap::value_type(dataset, Stages())).first;
+        } else {
+            fdataset = current_.datasets.insert
+                (StagesMap::value_type("other", Stages())).first;
+        }
+    }
+    auto &ds(fdataset->second);
+
+    for (std::size_t stage(0); stage < LatencyStageCount; ++stage) {
+        op[stage].record(durations[stage]);
+        ds[stage].record(durations[stage]);
+    }
+}
+
+void LatencyStats::stat(std::ostream &os, const std::string &prefix) const
+{
+    StagesMap operations;
+    StagesMap datasets;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        rotate(Clock::now());
+
+        const auto merge([](StagesMap &dst, const StagesMap &src)
+        {
+            for (const auto &item : src) {
+                auto &stages(dst[item.first]);
+                for (std::size_t stage(0); stage < LatencyStageCount;
+                     ++stage)
+                {
+                    stages[stage] += item.second[stage];
+                }
+            }
+        });
+
+        merge(operations, previous_.operations);
+        merge(operations, current_.operations);
+        merge(datasets, previous_.datasets);
+        merge(datasets, current_.datasets);
+    }
+
+    for (const auto &item : operations) {
+        for (std::size_t stage(0); stage < LatencyStageCount; ++stage) {
+            percentiles(os, prefix + "op." + item.first + "."
+                        + latencyStageName(static_cast<LatencyStage>(stage)) + "."
+                        , item.second[stage]);
+        }
+    }
+
+    for (const auto &item : datasets) {
+        for (const auto stage : { LatencyStage::warp, LatencyStage::total }) {
+            percentiles(os, prefix + "dataset." + statKey(item.first) + "."
+                        + latencyStageName(stage) + "."
+                        , item.second[static_cast<std::size_t>(stage)]);
+        }
+    }
+}
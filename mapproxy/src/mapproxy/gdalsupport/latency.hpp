@@ -0,0 +1,136 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef mapproxy_gdalsupport_latency_hpp_included_
+#define mapproxy_gdalsupport_latency_hpp_included_
+
+#include <array>
+#include <map>
+#include <mutex>
+#include <chrono>
+#include <string>
+#include <cstdint>
+#include <ostream>
+
+/** Processing stages of single GDAL request.
+ */
+enum class LatencyStage {
+    /** Waiting in the queue for a worker. */
+    queue
+    /** Opening (or looking up) source dataset in the worker. */
+    , open
+    /** Warping and copying the result into shared memory. */
+    , warp
+    /** Waking up the client and handing over the result. */
+    , wakeup
+    /** Whole request, from enqueue to consumption. */
+    , total
+};
+
+constexpr std::size_t LatencyStageCount = 5;
+
+/** Stage name as used in statistics.
+ */
+const char* latencyStageName(LatencyStage stage);
+
+/** Log-bucketed histogram of latencies in microseconds. Each power of two is
+ *  split into 4 buckets, i.e. percentiles are accurate to ~20%.
+ */
+class LatencyHistogram {
+public:
+    LatencyHistogram() : buckets_{}, count_() {}
+
+    void record(std::uint64_t usec);
+
+    /** Adds other histogram to this one.
+     */
+    LatencyHistogram& operator+=(const LatencyHistogram &other);
+
+    /** Returns upper bound of bucket holding given percentile (0-100) in
+     *  microseconds. Returns 0 for empty histogram.
+     */
+    std::uint64_t percentile(double p) const;
+
+    std::uint64_t count() const { return count_; }
+
+private:
+    static constexpr std::size_t BucketCount = 128;
+    std::array<std::uint64_t, BucketCount> buckets_;
+    std::uint64_t count_;
+};
+
+/** Per-stage latency statistics of GDAL requests, split by operation and by
+ *  dataset.
+ *
+ *  Histograms cover the last window (at least one window, at most two
+ *  windows of history are kept). Thread safe.
+ */
+class LatencyStats {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    /** Stage durations in microseconds, indexed by LatencyStage.
+     */
+    typedef std::array<std::uint64_t, LatencyStageCount> Durations;
+
+    /** Keeps at most datasetLimit datasets, requests to any other dataset
+     *  are accounted under "other".
+     */
+    LatencyStats(Clock::duration window = std::chrono::minutes(5)
+                 , std::size_t datasetLimit = 64);
+
+    void record(const std::string &operation, const std::string &dataset
+                , const Durations &durations);
+
+    /** Writes p50/p90/p99 (in milliseconds) of all stages per operation and
+     *  of warp and total stages per dataset.
+     */
+    void stat(std::ostream &os, const std::string &prefix) const;
+
+private:
+    typedef std::array<LatencyHistogram, LatencyStageCount> Stages;
+    typedef std::map<std::string, Stages> StagesMap;
+
+    struct Generation {
+        StagesMap operations;
+        StagesMap datasets;
+    };
+
+    /** Starts new generation if current one is older than window. Must be
+     *  called under lock.
+     */
+    void rotate(const Clock::time_point &now) const;
+
+    const Clock::duration window_;
+    const std::size_t datasetLimit_;
+
+    mutable std::mutex mutex_;
+    mutable Generation current_;
+    mutable Generation previous_;
+    mutable Clock::time_point started_;
+};
+
+#endif // mapproxy_gdalsupport_latency_hpp_included_
@@ -0,0 +1,296 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <new>
+#include <stdexcept>
+#include <algorithm>
+
+#include "matpool.hpp"
+
+namespace {
+
+/** Sizes are rounded up to make near-identical requests share a list.
+ */
+constexpr std::uint64_t Granularity = 64;
+
+/** Precision of the largest free block probe.
+ */
+constexpr std::uint64_t ProbeGranularity = 1 << 12;
+
+void updateHigh(std::atomic<std::uint64_t> &high, std::uint64_t value)
+{
+    auto current(high.load());
+    while ((value > current) && !high.compare_exchange_weak(current, value))
+    {}
+}
+
+} // namespace
+
+MatPool::MatPool(const void *arena, std::size_t arenaSize)
+    : arena_(arena)
+    , maxRetained_(arenaSize / 4)
+    , retained_(0), retainedHigh_(0)
+    , allocated_(0), hits_(0), flushes_(0)
+    , largestFree_(0), free_(0)
+{}
+
+MatPool* MatPool::create(ManagedBuffer &mb)
+{
+    return mb.construct<MatPool>(bi::unique_instance)
+        (mb.get_address(), mb.get_size());
+}
+
+MatPool& MatPool::pool(ManagedBuffer &mb)
+{
+    // lookup takes the arena lock; there is single data arena per process
+    static std::atomic<MatPool*> cached(nullptr);
+
+    auto *p(cached.load(std::memory_order_acquire));
+    if (p && (p->arena_ == mb.get_address())) { return *p; }
+
+    p = mb.find<MatPool>(bi::unique_instance).first;
+    if (!p) { throw std::logic_error("No raster pool in data arena."); }
+    cached.store(p, std::memory_order_release);
+    return *p;
+}
+
+MatPool::SizeClass* MatPool::find(std::uint64_t size)
+{
+    for (auto &cls : classes_) {
+        if (cls.size == size) { return &cls; }
+    }
+    return nullptr;
+}
+
+MatPool::SizeClass* MatPool::claim(std::uint64_t size)
+{
+    if (auto *cls = find(size)) { return cls; }
+
+    for (auto &cls : classes_) {
+        std::uint64_t expected(0);
+        if (cls.size.compare_exchange_strong(expected, size)
+            || (expected == size))
+        {
+            return &cls;
+        }
+    }
+
+    // all slots taken by other sizes
+    return nullptr;
+}
+
+void* MatPool::allocate(ManagedBuffer &mb, std::size_t size
+                        , std::size_t alignment)
+{
+    auto &p(pool(mb));
+    const std::uint64_t total
+        (((sizeof(Header) + size + Granularity - 1) / Granularity)
+         * Granularity);
+    ++p.allocated_;
+
+    if (auto *cls = p.find(total)) {
+        Header *h(nullptr);
+        {
+            Lock lock(cls->mutex);
+            if (cls->head && (cls->size == total)) {
+                h = cls->head;
+                cls->head = h->next;
+                --cls->count;
+            }
+        }
+
+        if (h) {
+            ++cls->hits;
+            ++p.hits_;
+            p.retained_ -= total;
+            return h + 1;
+        }
+    }
+
+    // header keeps user block aligned
+    alignment = std::max(alignment, alignof(Header));
+
+    void *raw(nullptr);
+    try {
+        raw = mb.allocate_aligned(total, alignment);
+    } catch (const bi::bad_alloc&) {
+        // retained blocks may be what stands in the way
+        p.flush(mb);
+        raw = mb.allocate_aligned(total, alignment);
+    }
+
+    auto *h(static_cast<Header*>(raw));
+    h->size = total;
+    h->next = nullptr;
+    return h + 1;
+}
+
+void MatPool::deallocate(ManagedBuffer &mb, void *block)
+{
+    if (!block) { return; }
+
+    auto &p(pool(mb));
+    auto *h(static_cast<Header*>(block) - 1);
+    const auto size(h->size);
+
+    if ((p.retained_ + size) <= p.maxRetained_) {
+        if (auto *cls = p.claim(size)) {
+            Lock lock(cls->mutex);
+            if ((cls->size == size) && (cls->count < MaxPerClass)) {
+                h->next = cls->head;
+                cls->head = h;
+                ++cls->count;
+                updateHigh(p.retainedHigh_, p.retained_ += size);
+                return;
+            }
+        }
+    }
+
+    mb.deallocate(h);
+}
+
+void MatPool::deallocate(ManagedBuffer &mb, std::vector<void*> &blocks)
+{
+    const auto blockSize([](void *block)
+    {
+        return (static_cast<Header*>(block) - 1)->size;
+    });
+
+    // group blocks of the same size
+    blocks.erase(std::remove(blocks.begin(), blocks.end(), nullptr)
+                 , blocks.end());
+    std::sort(blocks.begin(), blocks.end(), [&](void *l, void *r)
+    {
+        return blockSize(l) < blockSize(r);
+    });
+
+    auto &p(pool(mb));
+    for (auto i(blocks.begin()), e(blocks.end()); i != e; ) {
+        const auto size(blockSize(*i));
+        const auto end(std::find_if(i, e, [&](void *block)
+        {
+            return blockSize(block) != size;
+        }));
+
+        auto *cls(((p.retained_ + size) <= p.maxRetained_)
+                  ? p.claim(size) : nullptr);
+        if (cls) {
+            Lock lock(cls->mutex);
+            for (; (i != end) && (cls->size == size)
+                     && (cls->count < MaxPerClass)
+                     && ((p.retained_ + size) <= p.maxRetained_); ++i)
+            {
+                auto *h(static_cast<Header*>(*i) - 1);
+                h->next = cls->head;
+                cls->head = h;
+                ++cls->count;
+                updateHigh(p.retainedHigh_, p.retained_ += size);
+            }
+        }
+
+        // overflow goes back to the arena
+        for (; i != end; ++i) { mb.deallocate(static_cast<Header*>(*i) - 1); }
+    }
+
+    blocks.clear();
+}
+
+void MatPool::flush(ManagedBuffer &mb)
+{
+    for (auto &cls : classes_) {
+        Header *head(nullptr);
+        {
+            Lock lock(cls.mutex);
+            head = cls.head;
+            cls.head = nullptr;
+            cls.count = 0;
+            // release slot, shapes may have changed
+            cls.size = 0;
+        }
+
+        while (head) {
+            auto *next(head->next);
+            retained_ -= head->size;
+            mb.deallocate(head);
+            head = next;
+        }
+    }
+
+    ++flushes_;
+}
+
+void MatPool::sample(ManagedBuffer &mb)
+{
+    // binary search of the largest allocatable block
+    const std::uint64_t free(mb.get_free_memory());
+    std::uint64_t lo(0), hi(free);
+    while ((hi - lo) > ProbeGranularity) {
+        const auto mid(lo + (hi - lo) / 2);
+        if (auto *block = mb.allocate(mid, std::nothrow)) {
+            mb.deallocate(block);
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+
+    free_ = free;
+    largestFree_ = lo;
+}
+
+void MatPool::stat(std::ostream &os, const std::string &prefix)
+{
+    const std::uint64_t allocated(allocated_);
+    const std::uint64_t hits(hits_);
+    const std::uint64_t free(free_);
+    const std::uint64_t largestFree(largestFree_);
+
+    os << prefix << "allocated=" << allocated << '\n'
+       << prefix << "hits=" << hits << '\n'
+       << prefix << "hitRate="
+       << (allocated ? (double(hits) / allocated) : 0.0) << '\n'
+       << prefix << "retained=" << retained_ << '\n'
+       << prefix << "retainedHigh=" << retainedHigh_ << '\n'
+       << prefix << "flushes=" << flushes_ << '\n'
+       << prefix << "largestFree=" << largestFree << '\n'
+       << prefix << "fragmentation="
+       << (free ? (1.0 - double(largestFree) / free) : 0.0) << '\n';
+
+    for (std::size_t i(0); i < ClassCount; ++i) {
+        auto &cls(classes_[i]);
+        std::uint64_t size(0);
+        std::uint32_t count(0);
+        {
+            Lock lock(cls.mutex);
+            size = cls.size;
+            count = cls.count;
+        }
+        if (!size) { continue; }
+        os << prefix << "class." << i << ".size=" << size << '\n'
+           << prefix << "class." << i << ".free=" << count << '\n'
+           << prefix << "class." << i << ".hits=" << cls.hits << '\n';
+    }
+}
@@ -0,0 +1,137 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef mapproxy_gdalsupport_matpool_hpp_included_
+#define mapproxy_gdalsupport_matpool_hpp_included_
+
+#include <array>
+#include <atomic>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <ostream>
+
+#include "types.hpp"
+
+/** Size-class free lists of raster blocks on top of the data arena.
+ *
+ *  Response rasters come in a handful of shapes (256x256 images, 257x257
+ *  DEMs, batch blocks). Released blocks are kept in per-size free lists and
+ *  handed out again to the next allocation of the same size, bypassing
+ *  arena's best-fit allocator and its global lock; each list has its own
+ *  lock held only to push/pop a single block.
+ *
+ *  The pool lives in the data arena itself so blocks released by the server
+ *  are reused by warper processes. Free lists are flushed back to the arena
+ *  when the arena runs out of memory.
+ *
+ *  Blocks carry a small header; blocks allocated here must be released by
+ *  MatPool::deallocate and vice versa.
+ */
+class MatPool {
+public:
+    MatPool(const void *arena, std::size_t arenaSize);
+
+    MatPool(const MatPool&) = delete;
+    MatPool& operator=(const MatPool&) = delete;
+
+    /** Creates pool in given arena. Call once before any worker starts.
+     */
+    static MatPool* create(ManagedBuffer &mb);
+
+    /** Allocates block of given size. Throws bi::bad_alloc when arena is
+     *  exhausted even after flushing free lists.
+     */
+    static void* allocate(ManagedBuffer &mb, std::size_t size
+                          , std::size_t alignment);
+
+    /** Returns block to its free list (or to the arena).
+     */
+    static void deallocate(ManagedBuffer &mb, void *block);
+
+    /** Returns batch of blocks; each free list is locked once per batch.
+     *  Blocks are consumed, vector is left empty.
+     */
+    static void deallocate(ManagedBuffer &mb, std::vector<void*> &blocks);
+
+    /** Samples largest free block of the arena. Probes the arena by
+     *  allocation, call from housekeeping only.
+     */
+    void sample(ManagedBuffer &mb);
+
+    void stat(std::ostream &os, const std::string &prefix);
+
+private:
+    struct Header {
+        std::uint64_t size;
+        Header *next;
+    };
+
+    struct SizeClass {
+        /** Block size (including header), 0 = unused slot.
+         */
+        std::atomic<std::uint64_t> size;
+        Mutex mutex;
+        Header *head;
+        std::uint32_t count;
+        std::atomic<std::uint64_t> hits;
+
+        SizeClass() : size(0), head(), count(0), hits(0) {}
+    };
+
+    static MatPool& pool(ManagedBuffer &mb);
+
+    SizeClass* find(std::uint64_t size);
+    SizeClass* claim(std::uint64_t size);
+
+    /** Returns all free blocks to the arena.
+     */
+    void flush(ManagedBuffer &mb);
+
+    static constexpr std::size_t ClassCount = 16;
+    static constexpr std::uint32_t MaxPerClass = 64;
+
+    /** Arena address, validates cached pool lookup.
+     */
+    const void *arena_;
+
+    std::array<SizeClass, ClassCount> classes_;
+
+    /** Upper limit of retained bytes.
+     */
+    const std::uint64_t maxRetained_;
+    std::atomic<std::uint64_t> retained_;
+    std::atomic<std::uint64_t> retainedHigh_;
+
+    std::atomic<std::uint64_t> allocated_;
+    std::atomic<std::uint64_t> hits_;
+    std::atomic<std::uint64_t> flushes_;
+
+    std::atomic<std::uint64_t> largestFree_;
+    std::atomic<std::uint64_t> free_;
+};
+
+#endif // mapproxy_gdalsupport_matpool_hpp_included_
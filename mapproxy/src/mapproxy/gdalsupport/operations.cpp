@@ -25,8 +25,13 @@
  */
 
 #include <new>
+#include <map>
 #include <algorithm>
+#include <cmath>
 #include <cstring>
+#include <future>
+#include <mutex>
+#include <atomic>
 #include <sstream>
 #include <string>
 #include <type_traits>
@@ -35,10 +40,13 @@
 #include <boost/iostreams/device/array.hpp>
 
 #include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
 
 #include <sqlite3.h>
 
 #include <ogrsf_frmts.h>
+#include <vrtdataset.h>
+#include <gdal_utils.h>
 
 #include "utility/gccversion.hpp"
 #include "utility/format.hpp"
@@ -52,12 +60,30 @@
 #include "../error.hpp"
 #include "../support/geo.hpp"
 #include "operations.hpp"
+#include "matpool.hpp"
+#include "demsampler.hpp"
+#include "demprocessing.hpp"
 
 //namespace bio = boost::iostreams;
 //namespace vr = vtslibs::registry;
 
 namespace {
 
+/** Allocates raw block in shared memory. Exhausted shared memory is reported
+ *  as temporary unavailability instead of an internal error.
+ */
+void* allocateRaw(ManagedBuffer &mb, std::size_t size, std::size_t alignment)
+{
+    try {
+        return mb.allocate_aligned(size, alignment);
+    } catch (const bi::bad_alloc&) {
+        throw Unavailable("Out of GDAL shared memory.");
+    }
+}
+
+/** Allocates matrix and its data in a single block taken from raster pool.
+ *  Must be released by MatPool::deallocate.
+ */
 cv::Mat* allocateMat(ManagedBuffer &mb
                      , const math::Size2 &size, int type)
 {
@@ -66,14 +92,55 @@ cv::Mat* allocateMat(ManagedBuffer &mb
     const auto matSize(sizeof(cv::Mat) + dataSize);
 
     // create raw memory to hold matrix and data
-    char *raw(static_cast<char*>
-              (mb.allocate_aligned(matSize, alignof(cv::Mat))));
+    char *raw([&]() -> char*
+    {
+        try {
+            return static_cast<char*>
+                (MatPool::allocate(mb, matSize, alignof(cv::Mat)));
+        } catch (const bi::bad_alloc&) {
+            throw Unavailable("Out of GDAL shared memory.");
+        }
+    }());
 
     // allocate matrix in raw data block
     return new (raw) cv::Mat(size.height, size.width, type
                              , raw + sizeof(cv::Mat));
 }
 
+/** GDAL string list (options, argument vectors) holder.
+ */
+class OptionsWrapper {
+public:
+    OptionsWrapper() : opts_() {}
+
+    ~OptionsWrapper() { ::CSLDestroy(opts_); }
+
+    operator char**() const { return opts_; }
+
+    OptionsWrapper& operator()(const char *name, const char *value) {
+        opts_ = ::CSLSetNameValue(opts_, name, value);
+        return *this;
+    }
+
+    template <typename T>
+    OptionsWrapper& operator()(const char *name, const T &value) {
+        return operator()
+            (name, boost::lexical_cast<std::string>(value).c_str());
+    }
+
+    OptionsWrapper& operator()(const char *name, bool value) {
+        return operator()(name, value ? "YES" : "NO");
+    }
+
+    OptionsWrapper& operator()(const std::string &pair) {
+        opts_ = ::CSLAddString(opts_, pair.c_str());
+        return *this;
+    }
+
+private:
+    char **opts_;
+};
+
 inline geo::OptionalNodataValue
 asOptNodata(const geo::NodataValue &nodata, const geo::NodataValue &dflt)
 {
@@ -86,6 +153,263 @@ inline geo::OptionalNodataValue asOptNodata(const geo::NodataValue &nodata)
     return boost::none;
 }
 
+/** Builds in-memory VRT of image dataset that uses validity of mask dataset
+ *  as its per-dataset mask; the GDAL warper then honours the mask while
+ *  warping the image and no separate mask warp is needed.
+ *
+ *  Returns path to the VRT or nothing if these datasets cannot be stacked
+ *  (different SRS, rotated rasters). Result is remembered for the lifetime
+ *  of the worker process.
+ */
+boost::optional<std::string> maskedVrt(const std::string &dataset
+                                       , const std::string &maskDataset)
+{
+    typedef std::map<std::string, boost::optional<std::string>> Cache;
+    static Cache cache;
+    // guards cache when warping in threads
+    static std::mutex cacheMutex;
+    std::lock_guard<std::mutex> guard(cacheMutex);
+
+    const auto key(dataset + '\n' + maskDataset);
+    auto fcache(cache.find(key));
+    if (fcache != cache.end()) { return fcache->second; }
+
+    auto &result(cache[key]);
+
+    const auto open([](const std::string &path)
+    {
+        return std::shared_ptr< ::GDALDataset>
+            (static_cast< ::GDALDataset*>
+             (::GDALOpenEx(path.c_str(), (GDAL_OF_RASTER | GDAL_OF_READONLY)
+                           , nullptr, nullptr, nullptr))
+             , [](::GDALDataset *ds) { delete ds; });
+    });
+
+    auto image(open(dataset));
+    auto mask(open(maskDataset));
+    if (!image || !mask || !mask->GetRasterCount()) { return result; }
+
+    double igt[6], mgt[6];
+    if ((image->GetGeoTransform(igt) != CE_None)
+        || (mask->GetGeoTransform(mgt) != CE_None)
+        || igt[2] || igt[4] || mgt[2] || mgt[4])
+    {
+        return result;
+    }
+
+    {
+        OGRSpatialReference isrs, msrs;
+        if ((isrs.SetFromUserInput(image->GetProjectionRef()) != OGRERR_NONE)
+            || (msrs.SetFromUserInput(mask->GetProjectionRef())
+                != OGRERR_NONE)
+            || !isrs.IsSame(&msrs))
+        {
+            return result;
+        }
+    }
+
+    const auto path(utility::format("/vsimem/mapproxy/masked-%s.vrt"
+                                    , std::hash<std::string>()(key)));
+
+    auto *driver(::GetGDALDriverManager()->GetDriverByName("VRT"));
+    if (!driver) { return result; }
+
+    std::unique_ptr< ::GDALDataset> vrt
+        (driver->CreateCopy(path.c_str(), image.get(), false
+                            , nullptr, nullptr, nullptr));
+    if (!vrt || (vrt->CreateMaskBand(GMF_PER_DATASET) != CE_None)) {
+        return result;
+    }
+
+    // place whole mask raster into image raster coordinates
+    const auto msize(math::Size2(mask->GetRasterXSize()
+                                 , mask->GetRasterYSize()));
+    const double dstX((mgt[0] - igt[0]) / igt[1]);
+    const double dstY((mgt[3] - igt[3]) / igt[5]);
+    const double dstW(msize.width * mgt[1] / igt[1]);
+    const double dstH(msize.height * mgt[5] / igt[5]);
+
+    // VRT mask band is always a sourced band
+    auto *maskBand(dynamic_cast< ::VRTSourcedRasterBand*>
+                   (vrt->GetRasterBand(1)->GetMaskBand()));
+    if (!maskBand
+        || (maskBand->AddMaskBandSource
+            (mask->GetRasterBand(1), 0, 0, msize.width, msize.height
+             , dstX, dstY, dstW, dstH) != CE_None))
+    {
+        return result;
+    }
+
+    // flush VRT to /vsimem
+    vrt.reset();
+
+    LOG(info2) << "Using fused mask VRT " << path << " for dataset <"
+               << dataset << "> masked by <" << maskDataset << ">.";
+    return result = path;
+}
+
+/** Builds in-memory VRT exposing only given bands of dataset (per-dataset
+ *  mask is kept), i.e. the warper does not read other bands at all.
+ *
+ *  Returns path to the VRT or nothing if it cannot be built. Result is
+ *  remembered for the lifetime of the worker process.
+ */
+boost::optional<std::string> bandSubsetVrt(const std::string &dataset
+                                           , const std::vector<int> &bands)
+{
+    typedef std::map<std::string, boost::optional<std::string>> Cache;
+    static Cache cache;
+    // guards cache when warping in threads
+    static std::mutex cacheMutex;
+    std::lock_guard<std::mutex> guard(cacheMutex);
+
+    std::string key(dataset + '\n');
+    for (auto band : bands) { key += std::to_string(band) + ','; }
+
+    auto fcache(cache.find(key));
+    if (fcache != cache.end()) { return fcache->second; }
+
+    auto &result(cache[key]);
+
+    std::unique_ptr<void, void(*)(void*)> src
+        (::GDALOpenEx(dataset.c_str(), (GDAL_OF_RASTER | GDAL_OF_READONLY)
+                      , nullptr, nullptr, nullptr)
+         , [](void *ds) { if (ds) { ::GDALClose(ds); } });
+    if (!src) { return result; }
+
+    const int count(::GDALGetRasterCount(src.get()));
+
+    OptionsWrapper argv;
+    argv("-of")("VRT");
+    for (auto band : bands) {
+        if ((band < 1) || (band > count)) { return result; }
+        argv("-b")(std::to_string(band));
+    }
+
+    std::unique_ptr< ::GDALTranslateOptions
+                    , void(*)(::GDALTranslateOptions*)>
+        options(::GDALTranslateOptionsNew(argv, nullptr)
+                , &::GDALTranslateOptionsFree);
+    if (!options) { return result; }
+
+    const auto path(utility::format("/vsimem/mapproxy/bands-%s.vrt"
+                                    , std::hash<std::string>()(key)));
+
+    auto vrt(::GDALTranslate(path.c_str(), src.get(), options.get()
+                             , nullptr));
+    if (!vrt) { return result; }
+
+    // flush VRT to /vsimem
+    ::GDALClose(vrt);
+
+    return result = path;
+}
+
+/** Downsampling factors (full resolution width / overview width) of
+ *  dataset's overviews, finest first. Remembered for the lifetime of the
+ *  worker process.
+ */
+std::vector<double> overviewFactors(const std::string &dataset)
+{
+    typedef std::map<std::string, std::vector<double>> Cache;
+    static Cache cache;
+    // guards cache when warping in threads
+    static std::mutex cacheMutex;
+    std::lock_guard<std::mutex> guard(cacheMutex);
+
+    auto fcache(cache.find(dataset));
+    if (fcache != cache.end()) { return fcache->second; }
+
+    auto &result(cache[dataset]);
+
+    std::unique_ptr<void, void(*)(void*)> src
+        (::GDALOpenEx(dataset.c_str(), (GDAL_OF_RASTER | GDAL_OF_READONLY)
+                      , nullptr, nullptr, nullptr)
+         , [](void *ds) { if (ds) { ::GDALClose(ds); } });
+    if (!src || !::GDALGetRasterCount(src.get())) { return result; }
+
+    const double width(::GDALGetRasterXSize(src.get()));
+    auto *band(::GDALGetRasterBand(src.get(), 1));
+    for (int i(0), e(::GDALGetOverviewCount(band)); i < e; ++i) {
+        auto *ovr(::GDALGetOverview(band, i));
+        if (!ovr || !::GDALGetRasterBandXSize(ovr)) { break; }
+        result.push_back(width / ::GDALGetRasterBandXSize(ovr));
+    }
+
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+/** Applies overview selection policy: picks the coarsest overview whose
+ *  pixel is at least ratio times finer than the destination pixel.
+ *
+ *  Overview is passed to the warper as a bias relative to its automatic
+ *  choice (the coarsest overview not coarser than destination pixel).
+ *  Returns chosen overview (-1 = full resolution) or nothing if the policy
+ *  does not apply.
+ */
+boost::optional<int> selectOverview(const std::string &dataset
+                                    , const geo::GeoDataset &src
+                                    , const geo::SrsDefinition &srs
+                                    , const math::Extents2 &extents
+                                    , const math::Size2 &size
+                                    , const boost::optional<double> &ratio
+                                    , geo::GeoDataset::WarpOptions &wo)
+{
+    if (!ratio || (*ratio <= 0.0)) { return boost::none; }
+
+    const auto factors(overviewFactors(dataset));
+    if (factors.empty()) { return boost::none; }
+
+    // source pixels per destination pixel
+    const double scale(tileCircumference(extents, srs, src)
+                       / (2.0 * (size.width + size.height)));
+
+    const auto level([&](double limit) -> int
+    {
+        int l(-1);
+        for (const auto factor : factors) {
+            // tolerate rounding of overview sizes
+            if (factor > (limit * 1.01)) { break; }
+            ++l;
+        }
+        return l;
+    });
+
+    const auto automatic(level(scale));
+    const auto chosen(level(scale / *ratio));
+    wo.overviewBias += (chosen - automatic);
+
+    LOG(debug) << "Overview of <" << dataset << ">: " << chosen
+               << " (automatic " << automatic << ", scale " << scale
+               << ").";
+    return chosen;
+}
+
+/** Fast DEM resampling (see RasterRequest::demFastRatio): true if
+ *  destination pixel spans more than ratio source pixels.
+ */
+bool demFast(const geo::GeoDataset &src, const geo::SrsDefinition &srs
+             , const math::Extents2 &extents, const math::Size2 &size
+             , const boost::optional<double> &ratio)
+{
+    if (!ratio || (*ratio <= 0.0)) { return false; }
+
+    // source pixels per destination pixel
+    const double scale(tileCircumference(extents, srs, src)
+                       / (2.0 * (size.width + size.height)));
+    return scale > *ratio;
+}
+
+/** Overview selection policy of fast DEM warp: explicit policy or the
+ *  coarsest overview at least as fine as destination pixel.
+ */
+inline boost::optional<double>
+demFastOverviewRatio(const boost::optional<double> &overviewRatio)
+{
+    return overviewRatio ? overviewRatio : boost::optional<double>(1.0);
+}
+
 cv::Mat* warpImage(DatasetCache &cache, ManagedBuffer &mb
                    , const std::string &dataset
                    , const geo::SrsDefinition &srs
@@ -95,9 +419,31 @@ cv::Mat* warpImage(DatasetCache &cache, ManagedBuffer &mb
                    , const boost::optional<std::string> &maskDataset
                    , bool optimize
                    , bool expand
-                   , const geo::NodataValue &nodata)
+                   , const geo::NodataValue &nodata
+                   , const std::vector<int> &bands
+                   , bool grayscale
+                   , bool withMask
+                   , const boost::optional<double> &overviewRatio
+                   , boost::optional<int> *overview
+                   , const CheckAborted &checkAborted)
 {
-    auto &src(cache(dataset));
+    // try to warp image and mask in one go
+    boost::optional<std::string> fused;
+    if (maskDataset) { fused = maskedVrt(dataset, *maskDataset); }
+
+    // read only requested bands
+    auto source(fused ? *fused : dataset);
+    if (!bands.empty()) {
+        if (const auto subset = bandSubsetVrt(source, bands)) {
+            source = *subset;
+        } else {
+            LOGTHROW(err2, std::runtime_error)
+                << "Unable to select bands from dataset <" << dataset
+                << ">.";
+        }
+    }
+
+    auto &src(cache(source));
     auto dst(geo::GeoDataset::deriveInMemory
              (src, srs, size, extents, boost::none, asOptNodata(nodata)));
 
@@ -109,18 +455,24 @@ cv::Mat* warpImage(DatasetCache &cache, ManagedBuffer &mb
     LOG(debug) << "Optimize: " << optimize;
     LOG(debug) << "Expand: " << expand;
 
-    src.warpInto(dst, resampling);
+    geo::GeoDataset::WarpOptions wo;
+    *overview = selectOverview(dataset, src, srs, extents, size
+                               , overviewRatio, wo);
+
+    src.warpInto(dst, resampling, wo);
+    checkAborted();
 
     if (optimize && dst.cmask().empty()) {
         throw EmptyImage("No valid data.");
     }
 
-    // apply mask set if defined
-    if (maskDataset) {
+    // apply mask set if defined and not already applied during warp
+    if (maskDataset && !fused) {
         auto &srcMask(cache(*maskDataset));
         auto dstMask(geo::GeoDataset::deriveInMemory
                      (srcMask, srs, size, extents));
         srcMask.warpInto(dstMask, resampling);
+        checkAborted();
         dst.applyMask(dstMask.cmask());
 
         if (optimize && dst.cmask().empty()) {
@@ -129,24 +481,70 @@ cv::Mat* warpImage(DatasetCache &cache, ManagedBuffer &mb
     }
 
     /** Load data into matrix in shared memory. Expand paletted image into 3
-     *  channels. (TODO: make #channels configurable?)
-     * 
-     * OP: to serve imagery in original color table mode we shall need to 
-     * extract palette and pass it back to the calling layer.
+     *  channels unless asked not to; colour table itself is read by the
+     *  caller (see support/palette.hpp).
+     *
+     *  Image with mask is assembled locally first, combined matrix goes to
+     *  shared memory.
      */
 
-    cv::Mat *tile;
+    cv::Mat *tile(nullptr);
+    cv::Mat local;
 
-    if (expand) {
+    const auto output([&](int type) -> cv::Mat&
+    {
+        if (withMask) {
+            local.create(size.height, size.width, type);
+            return local;
+        }
+        tile = allocateMat(mb, size, type);
+        return *tile;
+    });
 
-        tile = allocateMat(mb, size, dst.makeDataType(CV_8U, 3));
-        dst.readDataInto(CV_8U, *tile, 3);
+    if (grayscale) {
+        // convert locally, only single channel goes to shared memory
+        cv::Mat color(size.height, size.width
+                      , dst.makeDataType(CV_8U, expand ? 3 : 0));
+        dst.readDataInto(CV_8U, color, expand ? 3 : 0);
+
+        auto &gray(output(CV_8UC1));
+        switch (color.channels()) {
+        case 1: color.copyTo(gray); break;
+        case 3: cv::cvtColor(color, gray, cv::COLOR_BGR2GRAY); break;
+        case 4: cv::cvtColor(color, gray, cv::COLOR_BGRA2GRAY); break;
+        default:
+            // keep first channel
+            cv::extractChannel(color, gray, 0);
+        }
+
+    } else if (expand) {
+
+        dst.readDataInto(CV_8U, output(dst.makeDataType(CV_8U, 3)), 3);
 
     } else {
 
-        tile = allocateMat(mb, size, dst.makeDataType(CV_8U, 0));
-        dst.readDataInto(CV_8U, *tile, 0);
+        dst.readDataInto(CV_8U, output(dst.makeDataType(CV_8U, 0)), 0);
+    }
+
+    if (!withMask) { return tile; }
+
+    // mask of the very same warp (incl. mask dataset) as the last channel
+    auto mask(dst.fetchMask(false));
+    if (!mask.data) {
+        mask = cv::Mat(size.height, size.width, CV_8UC1, cv::Scalar(255));
+    }
+
+    const int channels(local.channels());
+    tile = allocateMat(mb, size, CV_8UC(channels + 1));
+
+    std::vector<int> fromTo;
+    for (int c(0); c <= channels; ++c) {
+        fromTo.push_back(c);
+        fromTo.push_back(c);
     }
+    const std::vector<cv::Mat> src{ local, mask };
+    std::vector<cv::Mat> dstMats{ *tile };
+    cv::mixChannels(src, dstMats, fromTo);
 
     return tile;
 }
@@ -158,13 +556,15 @@ cv::Mat* warpMask(DatasetCache &cache, ManagedBuffer &mb
                   , const math::Size2 &size
                   , geo::GeoDataset::Resampling resampling
                   , bool optimize
-                  , const geo::NodataValue &nodata)
+                  , const geo::NodataValue &nodata
+                  , const CheckAborted &checkAborted)
 {
     auto &src(cache(dataset));
     auto dst(geo::GeoDataset::deriveInMemory
              (src, srs, size, extents, boost::none, asOptNodata(nodata)));
 
     src.warpInto(dst, resampling);
+    checkAborted();
 
     // fetch mask from dataset (optimized, all valid -> invalid matrix)
     auto m(dst.fetchMask(optimize));
@@ -193,7 +593,8 @@ cv::Mat* warpDetailMask(DatasetCache &cache, ManagedBuffer &mb
                         , const std::string &dataset
                         , const geo::SrsDefinition &srs
                         , const math::Extents2 &extents
-                        , const math::Size2 &size)
+                        , const math::Size2 &size
+                        , const CheckAborted &checkAborted)
 {
     // generate metatile from mask dataset
     auto &srcMask(cache(dataset));
@@ -205,6 +606,7 @@ cv::Mat* warpDetailMask(DatasetCache &cache, ManagedBuffer &mb
     wo.srcNodataValue = geo::GeoDataset::NodataValue();
     wo.dstNodataValue = geo::GeoDataset::NodataValue();
     srcMask.warpInto(dstMask, geo::GeoDataset::Resampling::average, wo);
+    checkAborted();
 
     // mask is guaranteed to have single (double) channel
     auto &dstMat(dstMask.cdata());
@@ -215,13 +617,18 @@ cv::Mat* warpDetailMask(DatasetCache &cache, ManagedBuffer &mb
 
 const auto ForcedNodata(geo::GeoDataset::NodataValue(-1e10f));
 
+/** Vec is either cv::Vec3d or cv::Vec3f, defines output matrix type.
+ */
+template <typename Vec>
 cv::Mat* warpValueMinMax(DatasetCache &cache, ManagedBuffer &mb
                          , const std::string &dataset
                          , const geo::SrsDefinition &srs
                          , const math::Extents2 &extents
                          , const math::Size2 &size
                          , geo::GeoDataset::Resampling resampling
-                         , const geo::NodataValue &nodata)
+                         , const geo::NodataValue &nodata
+                         , const boost::optional<double> &demFastRatio
+                         , const CheckAborted &checkAborted)
 {
     // combined result of warped dataset and result of warpMinMax
     auto &src(cache(dataset));
@@ -244,15 +651,35 @@ cv::Mat* warpValueMinMax(DatasetCache &cache, ManagedBuffer &mb
 #endif
     warpOptions.workingDataType = GDT_Float32;
 
+    // value, minimum and maximum come from three distinct datasets (each
+    // with its own GDAL handle) into three distinct outputs -> warp them
+    // concurrently; futures are joined even if the value warp fails
+    auto minWarp(std::async(std::launch::async, [&]()
+    {
+        minSrc.warpInto(minDst, geo::GeoDataset::Resampling::minimum
+                        , warpOptions);
+    }));
+    auto maxWarp(std::async(std::launch::async, [&]()
+    {
+        maxSrc.warpInto(maxDst, geo::GeoDataset::Resampling::maximum
+                        , warpOptions);
+    }));
+
+    // value is resampled by cheap filter when much coarser than source
+    if ((resampling == geo::GeoDataset::Resampling::dem)
+        && demFast(src, srs, extents, size, demFastRatio))
+    {
+        resampling = geo::GeoDataset::Resampling::average;
+    }
+
     //auto wri(src.warpInto(dst, resampling, warpOptions));
     src.warpInto(dst, resampling, warpOptions);
-    minSrc.warpInto(minDst, geo::GeoDataset::Resampling::minimum
-                    , warpOptions);
-    maxSrc.warpInto(maxDst, geo::GeoDataset::Resampling::maximum
-                    , warpOptions);
+    minWarp.get();
+    maxWarp.get();
+    checkAborted();
 
     // combine data
-    auto *tile(allocateMat(mb, size, CV_64FC3));
+    auto *tile(allocateMat(mb, size, cv::DataType<Vec>::type));
     *tile = cv::Scalar(*ForcedNodata, *ForcedNodata, *ForcedNodata);
 
     {
@@ -265,8 +692,8 @@ cv::Mat* warpValueMinMax(DatasetCache &cache, ManagedBuffer &mb
         auto idmin(dmin.begin<double>());
         auto idmax(dmax.begin<double>());
 
-        for (auto itile(tile->begin<cv::Vec3d>())
-                 , etile(tile->end<cv::Vec3d>());
+        for (auto itile(tile->begin<Vec>())
+                 , etile(tile->end<Vec>());
              itile != etile; ++itile, ++id, ++idmin, ++idmax)
         {
             // skip invalid value
@@ -309,7 +736,12 @@ cv::Mat* warpDem(DatasetCache &cache, ManagedBuffer &mb
                  , const math::Extents2 &extents
                  , const math::Size2 &requestedSize
                  , bool optimize
-                 , const geo::NodataValue &nodata)
+                 , int type
+                 , const geo::NodataValue &nodata
+                 , const boost::optional<double> &overviewRatio
+                 , const boost::optional<double> &demFastRatio
+                 , boost::optional<int> *overview
+                 , const CheckAborted &checkAborted)
 {
     auto &src(cache(dataset));
 
@@ -337,17 +769,29 @@ cv::Mat* warpDem(DatasetCache &cache, ManagedBuffer &mb
              (src, srs, gridSize, gridExtents, ::GDT_Float32
               , asOptNodata(nodata, ForcedNodata)));
 
+    // destination much coarser than source: averaging suitable overview is
+    // indistinguishable from the full dem kernel and far cheaper
+    const bool fast(demFast(src, srs, extents, size, demFastRatio));
+
     geo::GeoDataset::WarpOptions wo;
     wo.workingDataType = ::GDT_Float32;
-
-    auto wri(src.warpInto(dst, geo::GeoDataset::Resampling::dem, wo));
+    *overview = selectOverview(dataset, src, srs, extents, size
+                               , (fast ? demFastOverviewRatio(overviewRatio)
+                                  : overviewRatio)
+                               , wo);
+
+    auto wri(src.warpInto(dst, (fast ? geo::GeoDataset::Resampling::average
+                                : geo::GeoDataset::Resampling::dem)
+                          , wo));
+    checkAborted();
     LOG(info1) << "Warp result: scale=" << wri.scale
                << ", resampling=" << wri.resampling << ".";
 
-    // mask is guaranteed to have single (double) channel
+    // dem is guaranteed to have single (double) channel, convert to
+    // requested type on the fly
     auto &dstMat(dst.cdata());
-    auto *tile(allocateMat(mb, gridSize, dstMat.type()));
-    dstMat.copyTo(*tile);
+    auto *tile(allocateMat(mb, gridSize, type));
+    dstMat.convertTo(*tile, type);
     return tile;
 }
 
@@ -356,10 +800,18 @@ cv::Mat* warpDem(DatasetCache &cache, ManagedBuffer &mb
 } // namespace
 
 cv::Mat* warp(DatasetCache &cache, ManagedBuffer &mb
-              , const GdalWarper::RasterRequest &req)
+              , const GdalWarper::RasterRequest &req
+              , const CheckAborted &checkAborted
+              , boost::optional<int> *overview)
 {
     typedef GdalWarper::RasterRequest::Operation Operation;
 
+    boost::optional<int> dummy;
+    if (!overview) { overview = &dummy; }
+
+    // do not start anything when client is already gone
+    checkAborted();
+
     bool optimize, expand;
 
     switch (req.operation) {
@@ -367,35 +819,52 @@ cv::Mat* warp(DatasetCache &cache, ManagedBuffer &mb
     case Operation::imageNoOpt:
     case Operation::imageNoExpand:
         optimize = (req.operation == Operation::image);
-        expand = (req.operation != Operation::imageNoExpand);
+        expand = ((req.operation != Operation::imageNoExpand)
+                  && !req.keepPalette);
 
         return warpImage
             (cache, mb, req.dataset, req.srs, req.extents, req.size
              , req.resampling, req.mask
-             , optimize, expand, req.nodata);
+             , optimize, expand, req.nodata, req.bands, req.grayscale
+             , req.withMask, req.overviewRatio, overview, checkAborted);
 
     case Operation::mask:
     case Operation::maskNoOpt:
         return warpMask
             (cache, mb, req.dataset, req.srs, req.extents, req.size
              , req.resampling, (req.operation == Operation::mask)
-             , req.nodata);
+             , req.nodata, checkAborted);
 
     case Operation::detailMask:
         return warpDetailMask
-            (cache, mb, req.dataset, req.srs, req.extents, req.size);
+            (cache, mb, req.dataset, req.srs, req.extents, req.size
+             , checkAborted);
 
     case Operation::dem:
     case Operation::demOptimal:
         return warpDem
             (cache, mb, req.dataset, req.srs, req.extents, req.size
-             , (req.operation == Operation::demOptimal)
-             , req.nodata);
+             , (req.operation == Operation::demOptimal), CV_64FC1
+             , req.nodata, req.overviewRatio, req.demFastRatio, overview
+             , checkAborted);
+
+    case Operation::demFloat:
+    case Operation::demOptimalFloat:
+        return warpDem
+            (cache, mb, req.dataset, req.srs, req.extents, req.size
+             , (req.operation == Operation::demOptimalFloat), CV_32FC1
+             , req.nodata, req.overviewRatio, req.demFastRatio, overview
+             , checkAborted);
 
     case Operation::valueMinMax:
-        return warpValueMinMax
+        return warpValueMinMax<cv::Vec3d>
+            (cache, mb, req.dataset, req.srs, req.extents, req.size
+             , req.resampling, req.nodata, req.demFastRatio, checkAborted);
+
+    case Operation::valueMinMaxFloat:
+        return warpValueMinMax<cv::Vec3f>
             (cache, mb, req.dataset, req.srs, req.extents, req.size
-             , req.resampling, req.nodata);
+             , req.resampling, req.nodata, req.demFastRatio, checkAborted);
 
     default:
         throw;
@@ -416,8 +885,11 @@ namespace {
 }
 
 cv::Mat* warpWP(DatasetCache &cache, ManagedBuffer &mb
-              , const GdalWarper::RasterRequestWP &req)
+              , const GdalWarper::RasterRequestWP &req
+              , const CheckAborted &checkAborted)
 {
+    // do not start anything when client is already gone
+    checkAborted();
 
     // obtain dataset handle
     auto &src(cache(req.dataset));
@@ -438,22 +910,41 @@ cv::Mat* warpWP(DatasetCache &cache, ManagedBuffer &mb
     wo.workingDataType  = ::GDT_Float32;
 
     auto wri(src.warpInto(warpedSrc, geo::GeoDataset::Resampling::dem, wo));
+    checkAborted();
     LOG(info1) << "Warp result: scale=" << wri.scale
                << ", resampling=" << wri.resampling << ".";
 
-    auto dst(geo::GeoDataset::demProcessing(warpedSrc
-        , req.processing, req.processingOptions));
-
-    LOG(info1) << utility::format("DEM processing '%s', complete, options: %s",
-                                  req.processing
-                                  , serialize(req.processingOptions));
+    cv::Mat retMat;
+    const auto params(req.native ? req.native
+                      : demprocessing::parse(req.processing
+                                             , req.processingOptions));
+    if (params) {
+        // native processing directly on warped DEM
+        const auto es(math::size(extents_));
+        retMat = demprocessing::process
+            (*params, warpedSrc.cdata()
+             , es.width / size_.width, -es.height / size_.height
+             , asOptNodata(req.nodata, ForcedNodata));
+        checkAborted();
+
+        LOG(info1) << utility::format
+            ("DEM processing '%s' (native), complete, options: %s"
+             , req.processing, serialize(req.processingOptions));
+    } else {
+        auto dst(geo::GeoDataset::demProcessing(warpedSrc
+            , req.processing, req.processingOptions));
+        checkAborted();
 
-    // return output
-    auto dstMat(dst.readData(CV_8UC1, 1));
+        LOG(info1) << utility::format
+            ("DEM processing '%s', complete, options: %s"
+             , req.processing, serialize(req.processingOptions));
 
-    cv::Rect roi(1, 1, dstMat.cols - 2, dstMat.rows - 2);
-    auto retMat(dstMat(roi));
+        // cut off margin
+        auto dstMat(dst.readData(CV_8UC1, 1));
+        retMat = dstMat(cv::Rect(1, 1, dstMat.cols - 2, dstMat.rows - 2));
+    }
 
+    // return output
     auto *tile(allocateMat(mb, req.size, retMat.type()));
     retMat.copyTo(*tile);
 
@@ -464,38 +955,6 @@ namespace {
 
 typedef std::shared_ptr< ::GDALDataset> VectorDataset;
 
-class OptionsWrapper {
-public:
-    OptionsWrapper() : opts_() {}
-
-    ~OptionsWrapper() { ::CSLDestroy(opts_); }
-
-    operator char**() const { return opts_; }
-
-    OptionsWrapper& operator()(const char *name, const char *value) {
-        opts_ = ::CSLSetNameValue(opts_, name, value);
-        return *this;
-    }
-
-    template <typename T>
-    OptionsWrapper& operator()(const char *name, const T &value) {
-        return operator()
-            (name, boost::lexical_cast<std::string>(value).c_str());
-    }
-
-    OptionsWrapper& operator()(const char *name, bool value) {
-        return operator()(name, value ? "YES" : "NO");
-    }
-
-    OptionsWrapper& operator()(const std::string &pair) {
-        opts_ = ::CSLAddString(opts_, pair.c_str());
-        return *this;
-    }
-
-private:
-    char **opts_;
-};
-
 VectorDataset openVectorDataset(const std::string &dataset
                                 , const OptionsWrapper &openOptions)
 {
@@ -518,36 +977,128 @@ VectorDataset openVectorDataset(const std::string &dataset
                          , [](::GDALDataset *ds) { delete ds; });
 }
 
-VectorDataset openVectorDataset(const std::string &dataset
+/** Opens tile payload fetched from a tile archive. Payload lives in an
+ *  in-memory file until the dataset is closed, gzipped payload is read
+ *  through /vsigzip/.
+ */
+VectorDataset openVectorTile(const std::string &data
+                             , const OptionsWrapper &openOptions)
+{
+    static std::atomic<unsigned int> counter(0);
+    const auto name(utility::format("/vsimem/archive-tile-%u.mvt"
+                                    , ++counter));
+
+    auto *buffer(static_cast< ::GByte*>(::CPLMalloc(data.size())));
+    std::copy(data.begin(), data.end(), buffer);
+    ::VSIFCloseL(::VSIFileFromMemBuffer(name.c_str(), buffer, data.size()
+                                        , true));
+
+    const bool gzipped((data.size() > 1) && (data[0] == '\x1f')
+                       && (data[1] == '\x8b'));
+
+    VectorDataset ds;
+    try {
+        ds = openVectorDataset((gzipped ? "/vsigzip/" + name : name)
+                               , openOptions);
+    } catch (...) {
+        ::VSIUnlink(name.c_str());
+        throw;
+    }
+
+    return VectorDataset(ds.get(), [ds, name](::GDALDataset*) mutable
+    {
+        ds.reset();
+        ::VSIUnlink(name.c_str());
+    });
+}
+
+VectorDataset openVectorDataset(DatasetCache &cache
+                                , const std::string &dataset
                                 , const geo::heightcoding::Config&
                                 , const GdalWarper::OpenOptions &openOptions)
 {
-    OptionsWrapper ow;
-    for (const auto &option : openOptions) { ow(option); }
-    return openVectorDataset(dataset, ow);
+    return cache.vector(dataset, openOptions, [&]()
+    {
+        OptionsWrapper ow;
+        for (const auto &option : openOptions) { ow(option); }
+
+        // tile inside an archive: read from the archive kept open
+        if (const auto ref = tilearchive::parse(dataset)) {
+            std::string data;
+            if (!cache.archive(ref->archive).tile(ref->z, ref->x, ref->y
+                                                  , data))
+            {
+                LOGTHROW(err2, EmptyGeoData)
+                    << "No tile found for " << dataset << ".";
+            }
+            return openVectorTile(data, ow);
+        }
+
+        return openVectorDataset(dataset, ow);
+    });
 }
 
-GdalWarper::Heightcoded*
-allocateHc(ManagedBuffer &mb
-           , const std::string &data
-           , const geo::heightcoding::Metadata &metadata)
-{
-    // create raw memory to hold block and data
-    char *raw(static_cast<char*>
-              (mb.allocate_aligned
-               (sizeof(GdalWarper::Heightcoded) + data.size()
-                , alignof(GdalWarper::Heightcoded))));
+/** Output stream buffer writing heightcoded data straight into a shared
+ *  memory block with room for GdalWarper::Heightcoded header in front of the
+ *  data. The block grows geometrically, no private copy of the output is
+ *  ever made.
+ */
+class HcBuffer : public std::streambuf {
+public:
+    HcBuffer(ManagedBuffer &mb) : mb_(mb), raw_(), capacity_() {
+        grow(InitialCapacity);
+    }
 
-    // poiter to output data
-    auto *dataPtr(raw + sizeof(GdalWarper::Heightcoded));
+    ~HcBuffer() { if (raw_) { mb_.deallocate(raw_); } }
 
-    // copy data into block
-    std::copy(data.begin(), data.end(), dataPtr);
+    /** Constructs header in front of written data and hands whole block
+     *  over to the caller.
+     */
+    GdalWarper::Heightcoded*
+    release(const geo::heightcoding::Metadata &metadata) {
+        auto *raw(raw_);
+        raw_ = nullptr;
+        return new (raw) GdalWarper::Heightcoded
+            (raw + HeaderSize, pptr() - pbase(), metadata);
+    }
 
-    // allocate block in raw data block
-    return new (raw) GdalWarper::Heightcoded
-        (dataPtr, data.size(), metadata);
-}
+private:
+    static constexpr std::size_t HeaderSize
+        = sizeof(GdalWarper::Heightcoded);
+    static constexpr std::size_t InitialCapacity = 1 << 16;
+
+    virtual int_type overflow(int_type c) {
+        if (traits_type::eq_int_type(c, traits_type::eof())) {
+            return traits_type::not_eof(c);
+        }
+
+        grow(2 * capacity_);
+        *pptr() = traits_type::to_char_type(c);
+        pbump(1);
+        return c;
+    }
+
+    void grow(std::size_t capacity) {
+        const std::size_t used(raw_ ? (pptr() - pbase()) : 0);
+
+        auto *raw(static_cast<char*>
+                  (allocateRaw(mb_, HeaderSize + capacity
+                               , alignof(GdalWarper::Heightcoded))));
+        if (raw_) {
+            std::copy(pbase(), pptr(), raw + HeaderSize);
+            mb_.deallocate(raw_);
+        }
+
+        raw_ = raw;
+        capacity_ = capacity;
+        setp(raw + HeaderSize, raw + HeaderSize + capacity);
+        pbump(int(used));
+    }
+
+    ManagedBuffer &mb_;
+    char *raw_;
+    std::size_t capacity_;
+};
 
 struct DbError : public std::runtime_error {
     DbError(const std::string &msg) : std::runtime_error(msg) {}
@@ -682,7 +1233,7 @@ void enhanceLayers(const LayerEnhancer::map &layerEnancers
 GdalWarper::Heightcoded*
 heightcode(ManagedBuffer &mb, const VectorDataset &vds
            , std::vector<const geo::GeoDataset*> rds
-           , geo::heightcoding::Config config
+           , GdalWarper::HeightcodeConfig config
            , const boost::optional<std::string> &geoidGrid
            , const boost::optional<std::string> &vectorGeoidGrid
            , const LayerEnhancer::map &layerEnancers)
@@ -712,10 +1263,17 @@ heightcode(ManagedBuffer &mb, const VectorDataset &vds
         };
     }
 
-    std::ostringstream os;
-    auto metadata(geo::heightcoding::heightCode(*vds, rds, os, config));
+    // heights of all vertices in one batch, libgeo only converts them then
+    const auto sampled(sampleHeights(*vds, rds, config));
 
-    return allocateHc(mb, os.str(), metadata);
+    // heightcode directly into shared memory
+    HcBuffer buffer(mb);
+    std::ostream os(&buffer);
+    auto metadata(geo::heightcoding::heightCode
+                  (*(sampled ? sampled : vds), rds, os, config));
+    os.flush();
+
+    return buffer.release(metadata);
 }
 
 } // namespace
@@ -724,18 +1282,96 @@ GdalWarper::Heightcoded*
 heightcode(DatasetCache &cache, ManagedBuffer &mb
            , const std::string &vectorDs
            , const DemDataset::list &rasterDs
-           , geo::heightcoding::Config config
+           , GdalWarper::HeightcodeConfig config
            , const boost::optional<std::string> &vectorGeoidGrid
            , const GdalWarper::OpenOptions &openOptions
            , const LayerEnhancer::map &layerEnancers)
 {
-    std::vector<const geo::GeoDataset*> rasterDsStack;
+    return heightcode(cache, mb, vectorDs, HeightcodeRasters(cache, rasterDs)
+                      , config, vectorGeoidGrid, openOptions, layerEnancers);
+}
+
+HeightcodeRasters::HeightcodeRasters(DatasetCache &cache
+                                     , const DemDataset::list &rasterDs)
+    : geoidGrid_(rasterDs.back().geoidGrid)
+{
     for (const auto &ds : rasterDs) {
-        rasterDsStack.push_back(&cache(ds.dataset));
+        datasets_.push_back(&cache(ds.dataset));
     }
-    
-    return heightcode(mb, openVectorDataset(vectorDs, config, openOptions)
-                      , rasterDsStack
-                      , config, rasterDs.back().geoidGrid
+}
+
+void HeightcodeRasters::crop(const geo::SrsDefinition &srs
+                             , const math::Extents2 &extents
+                             , std::size_t maxPixels)
+{
+    // snaps to source pixel grid
+    const auto down([](double value, double origin, double step)
+    {
+        return origin + std::floor((value - origin) / step) * step;
+    });
+    const auto up([](double value, double origin, double step)
+    {
+        return origin + std::ceil((value - origin) / step) * step;
+    });
+
+    for (auto &ds : datasets_) {
+        const auto &srcExtents(ds->extents());
+        const auto srcSize(ds->size());
+        const auto srcSizef(math::size(srcExtents));
+        const math::Size2f res(srcSizef.width / srcSize.width
+                               , srcSizef.height / srcSize.height);
+
+        math::Extents2 e;
+        try {
+            e = geo::CsConvertor(srs, ds->srs())(extents);
+        } catch (const std::exception &ex) {
+            LOG(info1) << "Cannot convert heightcoding extents into DEM SRS ("
+                       << ex.what() << "), not cropping.";
+            continue;
+        }
+
+        // keep margin of two pixels for resampling
+        const auto &o(srcExtents.ll);
+        math::Extents2 patch
+            (std::max(down(e.ll(0) - 2 * res.width, o(0), res.width)
+                      , srcExtents.ll(0))
+             , std::max(down(e.ll(1) - 2 * res.height, o(1), res.height)
+                        , srcExtents.ll(1))
+             , std::min(up(e.ur(0) + 2 * res.width, o(0), res.width)
+                        , srcExtents.ur(0))
+             , std::min(up(e.ur(1) + 2 * res.height, o(1), res.height)
+                        , srcExtents.ur(1)));
+
+        const math::Size2
+            size(int(std::round((patch.ur(0) - patch.ll(0)) / res.width))
+                 , int(std::round((patch.ur(1) - patch.ll(1))
+                                  / res.height)));
+        if ((size.width <= 0) || (size.height <= 0)
+            || (std::size_t(math::area(size)) > maxPixels))
+        {
+            continue;
+        }
+
+        // grids are aligned -> nearest neighbour is plain copy
+        patches_.push_back(geo::GeoDataset::deriveInMemory
+                           (*ds, ds->srs(), size, patch));
+        ds->warpInto(patches_.back()
+                     , geo::GeoDataset::Resampling::nearest);
+        ds = &patches_.back();
+    }
+}
+
+GdalWarper::Heightcoded*
+heightcode(DatasetCache &cache, ManagedBuffer &mb
+           , const std::string &vectorDs
+           , const HeightcodeRasters &rasters
+           , GdalWarper::HeightcodeConfig config
+           , const boost::optional<std::string> &vectorGeoidGrid
+           , const GdalWarper::OpenOptions &openOptions
+           , const LayerEnhancer::map &layerEnancers)
+{
+    return heightcode(mb, openVectorDataset(cache, vectorDs, config
+                                            , openOptions)
+                      , rasters.datasets(), config, rasters.geoidGrid()
                       , vectorGeoidGrid, layerEnancers);
 }
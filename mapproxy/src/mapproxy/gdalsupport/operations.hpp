@@ -27,21 +27,79 @@
 #ifndef mapproxy_gdalsupport_operations_hpp_included_
 #define mapproxy_gdalsupport_operations_hpp_included_
 
+#include <functional>
+#include <list>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+#include "geo/geodataset.hpp"
+
 #include "../gdalsupport.hpp"
 #include "types.hpp"
 #include "datasetcache.hpp"
 
+/** Called between individual warp stages. Throws RequestAborted when client
+ *  is no longer interested in the result.
+ */
+typedef std::function<void()> CheckAborted;
+
+/** Warps raster. Overview chosen by request's overview selection policy
+ *  (if applied) is stored in overview (if given).
+ */
 cv::Mat* warp(DatasetCache &cache, ManagedBuffer &mb
-              , const GdalWarper::RasterRequest &req);
+              , const GdalWarper::RasterRequest &req
+              , const CheckAborted &checkAborted
+              , boost::optional<int> *overview = nullptr);
 
 cv::Mat* warpWP(DatasetCache &cache, ManagedBuffer &mb
-              , const GdalWarper::RasterRequestWP &req);
+              , const GdalWarper::RasterRequestWP &req
+              , const CheckAborted &checkAborted);
 
 GdalWarper::Heightcoded*
 heightcode(DatasetCache &cache, ManagedBuffer &mb
            , const std::string &vectorDs
            , const DemDataset::list &rasterDs
-           , geo::heightcoding::Config config
+           , GdalWarper::HeightcodeConfig config
+           , const boost::optional<std::string> &vectorGeoidGrid
+           , const GdalWarper::OpenOptions &openOptions
+           , const LayerEnhancer::map &layerEnancers);
+
+/** DEM stack shared by several heightcoding runs. DEMs are opened only once;
+ *  crop() replaces them with in-memory copies of the area the runs need.
+ */
+class HeightcodeRasters : boost::noncopyable {
+public:
+    HeightcodeRasters(DatasetCache &cache, const DemDataset::list &rasterDs);
+
+    /** Crops DEMs to given extents (in given SRS) at their native
+     *  resolution. DEMs not overlapping the extents or whose in-memory copy
+     *  would have more than maxPixels pixels are left as they are.
+     */
+    void crop(const geo::SrsDefinition &srs, const math::Extents2 &extents
+              , std::size_t maxPixels);
+
+    std::vector<const geo::GeoDataset*> datasets() const {
+        return { datasets_.begin(), datasets_.end() };
+    }
+
+    /** Geoid grid applied to the whole stack.
+     */
+    const boost::optional<std::string>& geoidGrid() const {
+        return geoidGrid_;
+    }
+
+private:
+    std::vector<geo::GeoDataset*> datasets_;
+    std::list<geo::GeoDataset> patches_;
+    boost::optional<std::string> geoidGrid_;
+};
+
+GdalWarper::Heightcoded*
+heightcode(DatasetCache &cache, ManagedBuffer &mb
+           , const std::string &vectorDs
+           , const HeightcodeRasters &rasters
+           , GdalWarper::HeightcodeConfig config
            , const boost::optional<std::string> &vectorGeoidGrid
            , const GdalWarper::OpenOptions &openOptions
            , const LayerEnhancer::map &layerEnancers);
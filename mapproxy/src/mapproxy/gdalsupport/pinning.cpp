@@ -0,0 +1,193 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+
+#include <cerrno>
+#include <cstring>
+#include <climits>
+#include <fstream>
+#include <algorithm>
+#include <stdexcept>
+
+#include <boost/filesystem.hpp>
+#include <boost/algorithm/string/split.hpp>
+#include <boost/algorithm/string/trim.hpp>
+#include <boost/algorithm/string/classification.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include "dbglog/dbglog.hpp"
+
+#include "pinning.hpp"
+
+namespace fs = boost::filesystem;
+namespace ba = boost::algorithm;
+
+namespace {
+
+int parseCpu(const std::string &value, const std::string &list)
+{
+    int cpu(-1);
+    try {
+        cpu = boost::lexical_cast<int>(ba::trim_copy(value));
+    } catch (const boost::bad_lexical_cast&) {}
+
+    if (cpu < 0) {
+        LOGTHROW(err2, std::runtime_error)
+            << "Invalid CPU <" << value << "> in CPU list <" << list << ">.";
+    }
+    return cpu;
+}
+
+} // namespace
+
+std::vector<int> parseCpuList(const std::string &value)
+{
+    std::vector<int> cpus;
+
+    std::vector<std::string> ranges;
+    ba::split(ranges, value, ba::is_any_of(","), ba::token_compress_on);
+    for (const auto &range : ranges) {
+        if (ba::trim_copy(range).empty()) { continue; }
+
+        const auto dash(range.find('-'));
+        if (dash == std::string::npos) {
+            cpus.push_back(parseCpu(range, value));
+            continue;
+        }
+
+        const auto first(parseCpu(range.substr(0, dash), value));
+        const auto last(parseCpu(range.substr(dash + 1), value));
+        if (last < first) {
+            LOGTHROW(err2, std::runtime_error)
+                << "Invalid CPU range <" << range << "> in CPU list <"
+                << value << ">.";
+        }
+        for (auto cpu(first); cpu <= last; ++cpu) { cpus.push_back(cpu); }
+    }
+
+    std::sort(cpus.begin(), cpus.end());
+    cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+    return cpus;
+}
+
+CpuSet::list parseCpuSets(const std::string &value)
+{
+    CpuSet::list sets;
+
+    std::vector<std::string> lists;
+    ba::split(lists, value, ba::is_any_of(";"), ba::token_compress_on);
+    for (const auto &list : lists) {
+        if (ba::trim_copy(list).empty()) { continue; }
+
+        CpuSet set;
+        set.cpus = parseCpuList(list);
+        if (set.cpus.empty()) {
+            LOGTHROW(err2, std::runtime_error)
+                << "Empty CPU set in <" << value << ">.";
+        }
+        sets.push_back(set);
+    }
+
+    return sets;
+}
+
+CpuSet::list numaCpuSets()
+{
+    CpuSet::list sets;
+
+    const fs::path root("/sys/devices/system/node");
+    boost::system::error_code ec;
+    for (fs::directory_iterator it(root, ec), end; !ec && (it != end);
+         it.increment(ec))
+    {
+        const auto name(it->path().filename().string());
+        if ((name.size() <= 4) || name.compare(0, 4, "node")) { continue; }
+
+        CpuSet set;
+        try {
+            set.node = boost::lexical_cast<int>(name.substr(4));
+        } catch (const boost::bad_lexical_cast&) { continue; }
+
+        std::ifstream f((it->path() / "cpulist").string());
+        std::string list;
+        if (!std::getline(f, list)) { continue; }
+
+        set.cpus = parseCpuList(list);
+        // memory-only nodes have no CPUs
+        if (!set.cpus.empty()) { sets.push_back(set); }
+    }
+
+    std::sort(sets.begin(), sets.end()
+              , [](const CpuSet &l, const CpuSet &r)
+    {
+        return *l.node < *r.node;
+    });
+
+    return sets;
+}
+
+void pinThread(const CpuSet &set)
+{
+    if (!set.cpus.empty()) {
+        ::cpu_set_t mask;
+        CPU_ZERO(&mask);
+        for (auto cpu : set.cpus) {
+            if (cpu < CPU_SETSIZE) { CPU_SET(cpu, &mask); }
+        }
+
+        // pid 0 == calling thread
+        if (::sched_setaffinity(0, sizeof(mask), &mask) == -1) {
+            LOG(warn2)
+                << "Unable to pin GDAL worker to CPUs: <"
+                << std::strerror(errno) << ">.";
+        }
+    }
+
+    if (set.node) {
+        // prefer (but do not enforce) memory from the node to avoid OOM
+        // when the node is full
+        constexpr int Bits(sizeof(unsigned long) * CHAR_BIT);
+        const int node(*set.node);
+        if (node >= 16 * Bits) {
+            LOG(warn2) << "NUMA node " << node << " out of range.";
+            return;
+        }
+
+        unsigned long nodeMask[16] = { 0 };
+        nodeMask[node / Bits] = 1UL << (node % Bits);
+        if (::syscall(SYS_set_mempolicy, MPOL_PREFERRED, nodeMask
+                      , 16 * Bits + 1) == -1)
+        {
+            LOG(warn2)
+                << "Unable to set NUMA memory policy of GDAL worker: <"
+                << std::strerror(errno) << ">.";
+        }
+    }
+}
@@ -0,0 +1,65 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef mapproxy_gdalsupport_pinning_hpp_included_
+#define mapproxy_gdalsupport_pinning_hpp_included_
+
+#include <vector>
+#include <string>
+
+#include <boost/optional.hpp>
+
+/** Placement of single GDAL worker: set of CPUs it may run on and NUMA node
+ *  it should allocate memory from.
+ */
+struct CpuSet {
+    std::vector<int> cpus;
+    boost::optional<int> node;
+
+    typedef std::vector<CpuSet> list;
+};
+
+/** Parses CPU list in the Linux cpulist format (e.g. "0-3,8,10-11").
+ *  Throws std::runtime_error on malformed input.
+ */
+std::vector<int> parseCpuList(const std::string &value);
+
+/** Parses semicolon-separated list of CPU lists (e.g. "0-7;8-15"), one set
+ *  per entry. Throws std::runtime_error on malformed input.
+ */
+CpuSet::list parseCpuSets(const std::string &value);
+
+/** Builds one set per NUMA node of this machine, bound to the node. Returns
+ *  empty list if there is no NUMA information available.
+ */
+CpuSet::list numaCpuSets();
+
+/** Pins calling thread to given CPU set and prefers memory from its NUMA
+ *  node (if any). Failures are logged and ignored.
+ */
+void pinThread(const CpuSet &set);
+
+#endif // mapproxy_gdalsupport_pinning_hpp_included_
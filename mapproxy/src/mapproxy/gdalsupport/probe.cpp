@@ -0,0 +1,106 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "dbglog/dbglog.hpp"
+
+#include "utility/format.hpp"
+
+#include "../error.hpp"
+
+#include "probe.hpp"
+
+ProbeJob::ProbeJob(const WorkRequestParams &params
+                   , const std::vector<std::string> &datasets)
+    : WorkRequest(params.sm)
+    , datasets_(params.sm.get_allocator<String>())
+    , records_(datasets.size(), Record()
+               , params.sm.get_allocator<Record>())
+    , srs_(params.sm.get_allocator<String>())
+    , errors_(params.sm.get_allocator<String>())
+{
+    auto &sm(params.sm);
+    for (const auto &dataset : datasets) {
+        datasets_.emplace_back(dataset.data(), dataset.size()
+                               , sm.get_allocator<char>());
+        srs_.emplace_back(sm.get_allocator<char>());
+        errors_.emplace_back(sm.get_allocator<char>());
+    }
+}
+
+void ProbeJob::process(Mutex&, DatasetCache &cache)
+{
+    for (std::size_t i(0), e(datasets_.size()); i != e; ++i) {
+        const auto dataset(asString(datasets_[i]));
+        try {
+            const auto &ds(cache(dataset));
+            auto &record(records_[i]);
+            record.extents = ds.extents();
+            record.size = ds.size();
+            record.allValid = ds.allValid();
+
+            const auto gsd(effectiveGsd(ds));
+            record.gsdArea = gsd.area;
+            record.gsdComputed = gsd.computed;
+
+            const auto srs(ds.srs());
+            record.srsType = int(srs.type);
+            srs_[i].assign(srs.srs.data(), srs.srs.size());
+        } catch (const std::exception &e) {
+            LOG(err2) << "Probing of dataset <" << dataset
+                      << "> failed: " << e.what();
+            errors_[i].assign(e.what());
+        }
+    }
+}
+
+WorkRequest::Response ProbeJob::response(Lock&)
+{
+    auto results(std::make_shared<GdalWarper::DatasetProbe::list>
+                 (datasets_.size()));
+
+    for (std::size_t i(0), e(datasets_.size()); i != e; ++i) {
+        auto &result((*results)[i]);
+        result.dataset = asString(datasets_[i]);
+
+        if (!errors_[i].empty()) {
+            result.error = std::make_exception_ptr
+                (IOError(utility::format("Unable to open dataset <%s>: %s"
+                                         , result.dataset
+                                         , asString(errors_[i]))));
+            continue;
+        }
+
+        const auto &record(records_[i]);
+        result.extents = record.extents;
+        result.size = record.size;
+        result.srs = geo::SrsDefinition
+            (asString(srs_[i]), geo::SrsDefinition::Type(record.srsType));
+        result.allValid = record.allValid;
+        result.effectiveGsd = { record.gsdArea, record.gsdComputed };
+    }
+
+    return results;
+}
@@ -0,0 +1,80 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef mapproxy_gdalsupport_probe_hpp_included_
+#define mapproxy_gdalsupport_probe_hpp_included_
+
+#include "../gdalsupport.hpp"
+#include "workrequest.hpp"
+
+/** Dataset probing job: opens datasets in the worker's dataset cache and
+ *  reports their properties (see GdalWarper::probe).
+ *
+ *  Response is GdalWarper::DatasetProbe::list.
+ */
+class ProbeJob : public WorkRequest {
+public:
+    ProbeJob(const WorkRequestParams &params
+             , const std::vector<std::string> &datasets);
+
+    virtual void process(Mutex &mutex, DatasetCache &cache);
+
+    virtual Response response(Lock &lock);
+
+    /** Destroys this object. Only to be called from warper machinery.
+     */
+    virtual void destroy() { sm().destroy_ptr(this); }
+
+private:
+    /** Plain properties of single dataset.
+     */
+    struct Record {
+        math::Extents2 extents;
+        math::Size2 size;
+        int srsType;
+        bool allValid;
+        double gsdArea;
+        bool gsdComputed;
+
+        Record()
+            : extents(math::InvalidExtents{}), srsType(), allValid()
+            , gsdArea(), gsdComputed()
+        {}
+    };
+
+    typedef bi::vector<Record, bi::allocator<Record, SegmentManager>>
+        RecordList;
+
+    StringVector datasets_;
+
+    /** Per dataset results and errors (empty = none).
+     */
+    RecordList records_;
+    StringVector srs_;
+    StringVector errors_;
+};
+
+#endif // mapproxy_gdalsupport_probe_hpp_included_
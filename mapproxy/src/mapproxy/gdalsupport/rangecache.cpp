@@ -0,0 +1,561 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/syscall.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <vector>
+#include <algorithm>
+
+#include <boost/format.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/algorithm/string/predicate.hpp>
+
+#include <cpl_vsi.h>
+#include <cpl_string.h>
+#include <gdal.h>
+
+#include "dbglog/dbglog.hpp"
+
+#include "../support/hash.hpp"
+
+#include "rangecache.hpp"
+
+namespace fs = boost::filesystem;
+namespace ba = boost::algorithm;
+
+namespace rangecache {
+
+namespace {
+
+const std::string Prefix("/vsirangecache/");
+
+/** Remote file systems worth caching.
+ */
+const char *RemotePrefixes[] = {
+    "/vsicurl/", "/vsicurl?", "/vsis3/", "/vsigs/", "/vsiaz/", "/vsiadls/"
+    , "/vsioss/", "/vsiswift/", "/vsiwebhdfs/"
+};
+
+/** Closes file descriptor on scope exit.
+ */
+struct Fd {
+    int fd;
+    Fd(int fd) : fd(fd) {}
+    ~Fd() { if (fd >= 0) { ::close(fd); } }
+    operator int() const { return fd; }
+    Fd(const Fd&) = delete;
+    Fd& operator=(const Fd&) = delete;
+};
+
+std::string hex(std::uint64_t value)
+{
+    return str(boost::format("%016x") % value);
+}
+
+/** Remote file identity: size and version.
+ */
+struct Remote {
+    vsi_l_offset size;
+    std::string version;
+    std::chrono::steady_clock::time_point checked;
+};
+
+/** Process-wide cache state.
+ */
+class Cache {
+public:
+    Cache(const Options &options)
+        : root(options.root)
+        , blockSize(std::max<std::size_t>(options.blockSize, 4) << 10)
+        , readahead(std::max<std::size_t>(options.readahead, 1))
+        , headerBlocks(std::max<std::size_t>
+                       (1, ((options.headerSize << 10) + blockSize - 1)
+                        / blockSize))
+        , limit(std::uint64_t(options.size) << 20)
+        , revalidate(options.revalidate)
+        , written_()
+    {}
+
+    /** Returns remote file identity, asks the remote side only when not
+     *  checked recently. Returns false if file cannot be stat'ed.
+     */
+    bool remote(const std::string &path, Remote &remote);
+
+    /** Directory with blocks of given file version, created on demand.
+     */
+    fs::path directory(const std::string &path, const Remote &remote) const;
+
+    /** Accounts written data, sweeps the cache when enough data have been
+     *  written since last sweep.
+     */
+    void written(std::size_t size);
+
+    const fs::path root;
+    const std::size_t blockSize;
+    const std::size_t readahead;
+    const std::size_t headerBlocks;
+    const std::uint64_t limit;
+    const std::chrono::seconds revalidate;
+
+private:
+    /** Removes oldest blocks until the cache fits in 90 % of the limit.
+     *  Only one process of the host sweeps at a time.
+     */
+    void sweep();
+
+    std::mutex mutex_;
+    std::map<std::string, Remote> remotes_;
+    std::atomic<std::uint64_t> written_;
+};
+
+std::unique_ptr<Cache> cache;
+
+bool Cache::remote(const std::string &path, Remote &remote)
+{
+    const auto now(std::chrono::steady_clock::now());
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        auto fremotes(remotes_.find(path));
+        if ((fremotes != remotes_.end())
+            && ((now - fremotes->second.checked) < revalidate))
+        {
+            remote = fremotes->second;
+            return true;
+        }
+    }
+
+    VSIStatBufL st;
+    if (::VSIStatExL(path.c_str(), &st
+                     , VSI_STAT_EXISTS_FLAG | VSI_STAT_SIZE_FLAG))
+    {
+        return false;
+    }
+
+    remote.size = st.st_size;
+    remote.checked = now;
+    remote.version.clear();
+
+#if GDAL_VERSION_NUM >= GDAL_COMPUTE_VERSION(3, 1, 0)
+    if (auto *headers = ::VSIGetFileMetadata(path.c_str(), "HEADERS"
+                                             , nullptr))
+    {
+        if (const auto *etag = ::CSLFetchNameValue(headers, "ETag")) {
+            remote.version = etag;
+        }
+        ::CSLDestroy(headers);
+    }
+#endif
+
+    if (remote.version.empty()) {
+        remote.version = str(boost::format("%d@%d")
+                             % remote.size % st.st_mtime);
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    remotes_[path] = remote;
+    return true;
+}
+
+fs::path Cache::directory(const std::string &path, const Remote &remote)
+    const
+{
+    const auto dir(root / hex(stableHash(path))
+                   / hex(stableHash(remote.version + '#'
+                                    + std::to_string(blockSize))));
+    boost::system::error_code ec;
+    fs::create_directories(dir, ec);
+    return dir;
+}
+
+void Cache::written(std::size_t size)
+{
+    // sweep after each sixteenth of the limit
+    const auto step(std::max<std::uint64_t>(limit / 16, 1));
+    const auto before(written_.fetch_add(size));
+    if ((before / step) != ((before + size) / step)) { sweep(); }
+}
+
+void Cache::sweep()
+{
+    Fd lock(::open((root / ".lock").c_str(), O_RDWR | O_CREAT | O_CLOEXEC
+                   , 0666));
+    if ((lock < 0) || ::flock(lock, LOCK_EX | LOCK_NB)) { return; }
+
+    struct Block {
+        std::time_t mtime;
+        std::uint64_t size;
+        fs::path path;
+        bool operator<(const Block &o) const { return mtime < o.mtime; }
+    };
+
+    std::vector<Block> blocks;
+    std::uint64_t total(0);
+
+    boost::system::error_code ec;
+    for (fs::recursive_directory_iterator i(root, ec), e; !ec && (i != e);
+         i.increment(ec))
+    {
+        if (!fs::is_regular_file(i->status())) { continue; }
+        Block block{ fs::last_write_time(i->path(), ec)
+                     , fs::file_size(i->path(), ec), i->path() };
+        if (ec) { ec.clear(); continue; }
+        total += block.size;
+        blocks.push_back(std::move(block));
+    }
+
+    const auto target(limit / 10 * 9);
+    if (total <= target) { return; }
+
+    std::sort(blocks.begin(), blocks.end());
+
+    std::size_t removed(0);
+    for (const auto &block : blocks) {
+        if (total <= target) { break; }
+        if (block.path.filename() == ".lock") { continue; }
+        if (fs::remove(block.path, ec)) {
+            total -= block.size;
+            ++removed;
+        }
+    }
+
+    LOG(info2) << "Range cache swept: removed " << removed
+               << " blocks, " << (total >> 20) << " MB left.";
+}
+
+/** Open cached file.
+ */
+class File {
+public:
+    File(const std::string &path, const Remote &remote)
+        : path_(path), size_(remote.size)
+        , dir_(cache->directory(path, remote))
+        , blockCount_((size_ + cache->blockSize - 1) / cache->blockSize)
+        , offset_(), eof_(), remote_()
+    {}
+
+    ~File() { if (remote_) { ::VSIFCloseL(remote_); } }
+
+    std::size_t read(char *dst, std::size_t size);
+
+    int seek(vsi_l_offset offset, int whence) {
+        switch (whence) {
+        case SEEK_SET: offset_ = offset; break;
+        case SEEK_CUR: offset_ += offset; break;
+        case SEEK_END: offset_ = size_ + offset; break;
+        default: return -1;
+        }
+        eof_ = false;
+        return 0;
+    }
+
+    vsi_l_offset tell() const { return offset_; }
+
+    bool eof() const { return eof_; }
+
+private:
+    typedef std::vector<char> Data;
+
+    std::size_t blockLength(std::uint64_t block) const {
+        return std::min<vsi_l_offset>
+            (cache->blockSize, size_ - block * cache->blockSize);
+    }
+
+    fs::path blockPath(std::uint64_t block) const {
+        return dir_ / std::to_string(block);
+    }
+
+    /** Loads block from the disk cache.
+     */
+    bool load(std::uint64_t block, Data &data) const;
+
+    /** Stores block into the disk cache, best effort.
+     */
+    void store(std::uint64_t block, const char *data) const;
+
+    /** Fetches run of missing blocks starting at given block from the
+     *  remote side. Fetched blocks are kept in fetched_.
+     */
+    bool fetch(std::uint64_t block, std::uint64_t last);
+
+    const std::string path_;
+    const vsi_l_offset size_;
+    const fs::path dir_;
+    const std::uint64_t blockCount_;
+
+    vsi_l_offset offset_;
+    bool eof_;
+
+    /** Remote file, opened on first miss.
+     */
+    VSILFILE *remote_;
+
+    /** Blocks of the last fetched run.
+     */
+    std::map<std::uint64_t, Data> fetched_;
+};
+
+bool File::load(std::uint64_t block, Data &data) const
+{
+    const auto length(blockLength(block));
+    Fd fd(::open(blockPath(block).c_str(), O_RDONLY | O_CLOEXEC));
+    if (fd < 0) { return false; }
+
+    data.resize(length);
+    // NB: truncated block (e.g. crashed writer) counts as a miss
+    return (::pread(fd, data.data(), length, 0) == ssize_t(length));
+}
+
+void File::store(std::uint64_t block, const char *data) const
+{
+    const auto length(blockLength(block));
+    const auto path(blockPath(block));
+    auto tmp(path);
+    tmp += str(boost::format(".tmp.%d.%d") % ::getpid()
+               % ::syscall(SYS_gettid));
+
+    {
+        Fd fd(::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC
+                     , 0666));
+        if (fd < 0) { return; }
+        if (::write(fd, data, length) != ssize_t(length)) {
+            boost::system::error_code ec;
+            fs::remove(tmp, ec);
+            return;
+        }
+    }
+
+    if (::rename(tmp.c_str(), path.c_str())) {
+        boost::system::error_code ec;
+        fs::remove(tmp, ec);
+        return;
+    }
+
+    cache->written(length);
+}
+
+bool File::fetch(std::uint64_t block, std::uint64_t last)
+{
+    // header area or readahead, never past the file end
+    last = std::max<std::uint64_t>
+        (last, block + ((block < cache->headerBlocks)
+                        ? cache->headerBlocks : cache->readahead) - 1);
+    last = std::min<std::uint64_t>(last, blockCount_ - 1);
+
+    // stop before first block already in the cache
+    for (auto b(block + 1); b <= last; ++b) {
+        boost::system::error_code ec;
+        if (fs::exists(blockPath(b), ec)) {
+            last = b - 1;
+            break;
+        }
+    }
+
+    if (!remote_) {
+        remote_ = ::VSIFOpenL(path_.c_str(), "rb");
+        if (!remote_) { return false; }
+    }
+
+    const vsi_l_offset start(block * cache->blockSize);
+    const std::size_t length((last - block) * cache->blockSize
+                             + blockLength(last));
+    Data data(length);
+    if (::VSIFSeekL(remote_, start, SEEK_SET)
+        || (::VSIFReadL(data.data(), 1, length, remote_) != length))
+    {
+        return false;
+    }
+
+    fetched_.clear();
+    for (auto b(block); b <= last; ++b) {
+        const auto *src(data.data() + (b - block) * cache->blockSize);
+        store(b, src);
+        fetched_[b].assign(src, src + blockLength(b));
+    }
+    return true;
+}
+
+std::size_t File::read(char *dst, std::size_t size)
+{
+    if (offset_ >= size_) {
+        eof_ = true;
+        return 0;
+    }
+
+    if (size > (size_ - offset_)) {
+        size = size_ - offset_;
+        eof_ = true;
+    }
+
+    const auto lastBlock((offset_ + size - 1) / cache->blockSize);
+
+    std::size_t done(0);
+    Data data;
+    while (done < size) {
+        const auto block(offset_ / cache->blockSize);
+        const std::size_t skip(offset_ % cache->blockSize);
+
+        const Data *src(&data);
+        auto ffetched(fetched_.find(block));
+        if (ffetched != fetched_.end()) {
+            src = &ffetched->second;
+        } else if (!load(block, data)) {
+            if (!fetch(block, lastBlock)) {
+                LOG(err2) << "Unable to read block " << block
+                          << " of <" << path_ << ">.";
+                return done;
+            }
+            src = &fetched_[block];
+        }
+
+        const auto chunk(std::min(size - done, src->size() - skip));
+        std::memcpy(dst + done, src->data() + skip, chunk);
+        done += chunk;
+        offset_ += chunk;
+    }
+
+    return done;
+}
+
+std::string underlying(const char *filename)
+{
+    return std::string(filename).substr(Prefix.size());
+}
+
+int vsiStat(void*, const char *filename, VSIStatBufL *stat, int flags)
+{
+    return ::VSIStatExL(underlying(filename).c_str(), stat, flags);
+}
+
+void* vsiOpen(void*, const char *filename, const char *access)
+{
+    // read-only
+    if (std::strchr(access, 'w') || std::strchr(access, 'a')
+        || std::strchr(access, '+'))
+    {
+        return nullptr;
+    }
+
+    const auto path(underlying(filename));
+    Remote remote;
+    if (!cache->remote(path, remote)) { return nullptr; }
+    return new File(path, remote);
+}
+
+vsi_l_offset vsiTell(void *file)
+{
+    return static_cast<File*>(file)->tell();
+}
+
+int vsiSeek(void *file, vsi_l_offset offset, int whence)
+{
+    return static_cast<File*>(file)->seek(offset, whence);
+}
+
+std::size_t vsiRead(void *file, void *buffer, std::size_t size
+                    , std::size_t count)
+{
+    if (!size) { return 0; }
+    return static_cast<File*>(file)->read
+        (static_cast<char*>(buffer), size * count) / size;
+}
+
+int vsiEof(void *file)
+{
+    return static_cast<File*>(file)->eof();
+}
+
+int vsiClose(void *file)
+{
+    delete static_cast<File*>(file);
+    return 0;
+}
+
+} // namespace
+
+void install(const Options &options)
+{
+    static std::once_flag once;
+    std::call_once(once, [&]()
+    {
+#if GDAL_VERSION_NUM >= GDAL_COMPUTE_VERSION(3, 0, 0)
+        boost::system::error_code ec;
+        fs::create_directories(options.root, ec);
+        if (ec) {
+            LOG(warn3) << "Unable to create range cache directory "
+                       << options.root << ": " << ec.message()
+                       << "; remote datasets are not cached.";
+            return;
+        }
+
+        cache.reset(new Cache(options));
+
+        auto *cb(::VSIAllocFilesystemPluginCallbacksStruct());
+        cb->stat = &vsiStat;
+        cb->open = &vsiOpen;
+        cb->tell = &vsiTell;
+        cb->seek = &vsiSeek;
+        cb->read = &vsiRead;
+        cb->eof = &vsiEof;
+        cb->close = &vsiClose;
+        const auto installed(::VSIInstallPluginHandler(Prefix.c_str(), cb));
+        ::VSIFreeFilesystemPluginCallbacksStruct(cb);
+
+        if (installed) {
+            LOG(warn3) << "Unable to install " << Prefix
+                       << " handler; remote datasets are not cached.";
+            cache.reset();
+            return;
+        }
+
+        LOG(info2) << "Remote datasets are cached in " << options.root
+                   << ".";
+#else
+        (void) options;
+        LOG(warn3) << "GDAL too old for range cache (needs 3.0); remote "
+            "datasets are not cached.";
+#endif
+    });
+}
+
+std::string route(const std::string &path)
+{
+    if (!cache) { return path; }
+    for (const auto *prefix : RemotePrefixes) {
+        if (ba::starts_with(path, prefix)) { return Prefix + path; }
+    }
+    return path;
+}
+
+} // namespace rangecache
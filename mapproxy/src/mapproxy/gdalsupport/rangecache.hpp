@@ -0,0 +1,96 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef mapproxy_gdalsupport_rangecache_hpp_included_
+#define mapproxy_gdalsupport_rangecache_hpp_included_
+
+#include <string>
+
+#include <boost/filesystem/path.hpp>
+
+/** Local-disk cache of byte ranges of remote datasets (/vsicurl/, /vsis3/,
+ *  ...) shared by all GDAL workers of this host.
+ *
+ *  Remote datasets are opened through /vsirangecache/ handler installed in
+ *  each worker. Files are read in fixed-size blocks, each block is stored
+ *  in its own file keyed by URL, remote version (ETag or size and
+ *  modification time) and block index; blocks fetched by one worker are
+ *  read by all others and survive worker (and server) restarts.
+ *
+ *  Missing blocks are fetched in runs: readahead blocks after the missed
+ *  one (neighbouring COG tiles lie next to each other) and the whole header
+ *  area on the first read of a file (COG keeps all IFDs and tile offsets
+ *  at its start).
+ *
+ *  Cache size is kept under limit by workers themselves: oldest blocks are
+ *  removed once enough new data have been written.
+ */
+namespace rangecache {
+
+struct Options {
+    /** Cache directory. Empty means no cache.
+     */
+    boost::filesystem::path root;
+
+    /** Size limit in MB.
+     */
+    std::size_t size;
+
+    /** Block size in KB.
+     */
+    std::size_t blockSize;
+
+    /** Number of blocks fetched in one go on block miss.
+     */
+    std::size_t readahead;
+
+    /** Size of header area fetched on first read (in KB).
+     */
+    std::size_t headerSize;
+
+    /** Time (in seconds) remote file version is trusted before being
+     *  checked again.
+     */
+    std::size_t revalidate;
+
+    Options()
+        : size(4096), blockSize(64), readahead(4), headerSize(256)
+        , revalidate(300)
+    {}
+};
+
+/** Installs the /vsirangecache/ handler into this process. Idempotent.
+ */
+void install(const Options &options);
+
+/** Routes remote path through the cache if the handler is installed in this
+ *  process. Other paths are returned untouched.
+ */
+std::string route(const std::string &path);
+
+} // namespace rangecache
+
+#endif // mapproxy_gdalsupport_rangecache_hpp_included_
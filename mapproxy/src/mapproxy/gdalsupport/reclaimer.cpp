@@ -0,0 +1,152 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <algorithm>
+
+#include "dbglog/dbglog.hpp"
+
+#include "matpool.hpp"
+#include "reclaimer.hpp"
+
+Reclaimer::Reclaimer(ManagedBuffer &mb, const Released &released
+                     , std::size_t batch, std::chrono::milliseconds delay)
+    : mb_(mb), onReleased_(released)
+    , batch_(std::max<std::size_t>(batch, 1)), delay_(delay)
+    , stop_(false), freed_(false), pid_()
+    , released_(0), batches_(0), pendingHigh_(0)
+{
+    pending_.reserve(batch_);
+}
+
+Reclaimer::~Reclaimer()
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    cond_.notify_all();
+
+    // forked copy: thread and pending blocks belong to the parent
+    if (pid_ && (pid_ != ThisProcess::id())) { return; }
+
+    if (thread_.joinable()) { thread_.join(); }
+    MatPool::deallocate(mb_, pending_);
+}
+
+void Reclaimer::release(void *block)
+{
+    if (!block) { return; }
+
+    start();
+
+    std::size_t size(0);
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        pending_.push_back(block);
+        size = pending_.size();
+    }
+
+    if (size > pendingHigh_) { pendingHigh_ = size; }
+    // wake up reclaimer sleeping on empty queue or waiting for full batch
+    if ((size == 1) || (size == batch_)) { cond_.notify_one(); }
+}
+
+void Reclaimer::deallocate(void *block)
+{
+    if (!block) { return; }
+
+    mb_.deallocate(block);
+    if (!onReleased_) { return; }
+
+    // callback runs in reclaimer thread: caller may hold any lock
+    start();
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        freed_ = true;
+    }
+    cond_.notify_one();
+}
+
+void Reclaimer::start()
+{
+    std::call_once(started_, [this]()
+    {
+        pid_ = ThisProcess::id();
+        thread_ = std::thread(&Reclaimer::run, this);
+    });
+}
+
+void Reclaimer::run()
+{
+    dbglog::thread_id("gdal:reclaim");
+
+    std::vector<void*> blocks;
+    blocks.reserve(batch_);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stop_) {
+        cond_.wait(lock, [this]()
+        {
+            return stop_ || !pending_.empty() || freed_;
+        });
+
+        if (!pending_.empty()) {
+            // wait for full batch; stragglers are picked up after short delay
+            cond_.wait_for(lock, delay_, [this]()
+            {
+                return stop_ || (pending_.size() >= batch_);
+            });
+        }
+        if (pending_.empty() && !freed_) { continue; }
+
+        std::swap(blocks, pending_);
+        freed_ = false;
+        lock.unlock();
+
+        if (!blocks.empty()) {
+            released_ += blocks.size();
+            ++batches_;
+            MatPool::deallocate(mb_, blocks);
+        }
+        if (onReleased_) { onReleased_(); }
+
+        lock.lock();
+    }
+}
+
+void Reclaimer::stat(std::ostream &os, const std::string &prefix) const
+{
+    std::size_t pending(0);
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        pending = pending_.size();
+    }
+
+    os << prefix << "released=" << released_ << '\n'
+       << prefix << "batches=" << batches_ << '\n'
+       << prefix << "pending=" << pending << '\n'
+       << prefix << "pendingHigh=" << pendingHigh_ << '\n';
+}
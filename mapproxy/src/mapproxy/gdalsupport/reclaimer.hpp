@@ -0,0 +1,110 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef mapproxy_gdalsupport_reclaimer_hpp_included_
+#define mapproxy_gdalsupport_reclaimer_hpp_included_
+
+#include <mutex>
+#include <chrono>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <string>
+#include <cstdint>
+#include <ostream>
+#include <functional>
+#include <condition_variable>
+
+#include "types.hpp"
+#include "process.hpp"
+
+/** Deferred release of response rasters held by the server.
+ *
+ *  Raster deleters run in request handling threads; instead of returning
+ *  every block to the pool right away they queue it here (process-local
+ *  lock only). Single reclaimer thread returns queued blocks to the pool in
+ *  batches once enough of them piles up or after short delay.
+ *
+ *  Thread is started by the first release, i.e. in the process that
+ *  consumes responses. Pending blocks are released on destruction.
+ *
+ *  Optional released callback is called whenever memory is returned to the
+ *  arena (e.g. to wake up requests waiting for free memory).
+ */
+class Reclaimer {
+public:
+    typedef std::function<void()> Released;
+
+    Reclaimer(ManagedBuffer &mb, const Released &released = Released()
+              , std::size_t batch = 32
+              , std::chrono::milliseconds delay
+              = std::chrono::milliseconds(50));
+
+    ~Reclaimer();
+
+    Reclaimer(const Reclaimer&) = delete;
+    Reclaimer& operator=(const Reclaimer&) = delete;
+
+    /** Queues block allocated by MatPool for release.
+     */
+    void release(void *block);
+
+    /** Returns block not allocated by MatPool to the arena right away
+     *  (released callback is still called by the reclaimer thread).
+     */
+    void deallocate(void *block);
+
+    void stat(std::ostream &os, const std::string &prefix) const;
+
+private:
+    void start();
+
+    void run();
+
+    ManagedBuffer &mb_;
+    const Released onReleased_;
+    const std::size_t batch_;
+    const std::chrono::milliseconds delay_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable cond_;
+    std::vector<void*> pending_;
+    bool stop_;
+
+    /** Some block has been deallocated right away since last callback.
+     */
+    bool freed_;
+
+    std::once_flag started_;
+    std::thread thread_;
+    Process::Id pid_;
+
+    std::atomic<std::uint64_t> released_;
+    std::atomic<std::uint64_t> batches_;
+    std::atomic<std::uint64_t> pendingHigh_;
+};
+
+#endif // mapproxy_gdalsupport_reclaimer_hpp_included_
@@ -32,24 +32,23 @@ ShRaster::ShRaster(const GdalWarper::RasterRequest &other
                    , ManagedBuffer &sm, ShRequestBase *owner)
     : sm_(sm), owner_(owner)
     , operation_(other.operation)
-    , dataset_(other.dataset.data()
-               , other.dataset.size()
-               , sm.get_allocator<char>())
-    , srs_(other.srs.srs.data()
-           , other.srs.srs.size()
-           , sm.get_allocator<char>())
+    , dataset_(other.dataset, sm)
+    , srs_(other.srs.srs, sm)
     , srsType_(other.srs.type)
     , extents_(other.extents)
     , size_(other.size)
     , resampling_(other.resampling)
-    , mask_(sm.get_allocator<char>())
+    , mask_(other.mask ? ShInterned(*other.mask, sm) : ShInterned(sm))
     , nodata_(other.nodata)
+    , bands_(other.bands.begin(), other.bands.end()
+             , sm.get_allocator<int>())
+    , grayscale_(other.grayscale)
+    , keepPalette_(other.keepPalette)
+    , overviewRatio_(other.overviewRatio)
+    , demFastRatio_(other.demFastRatio)
+    , withMask_(other.withMask)
     , response_()
-{
-    if (other.mask) {
-        mask_.assign(other.mask->data(), other.mask->size());
-    }
-}
+{}
 
 ShRaster::~ShRaster() {
     if (response_) { sm_.deallocate(response_); }
@@ -58,10 +57,17 @@ ShRaster::~ShRaster() {
 ShRaster::operator GdalWarper::RasterRequest() const {
     return GdalWarper::RasterRequest
         (operation_
-         , std::string(dataset_.data(), dataset_.size())
-         , geo::SrsDefinition(asString(srs_), srsType_)
+         , dataset_.str()
+         , geo::SrsDefinition(srs_.str(), srsType_)
          , extents_, size_, resampling_
-         , asOptional(mask_)).setNodata(nodata_);
+         , (mask_.empty() ? boost::optional<std::string>()
+            : mask_.str())).setNodata(nodata_)
+        .setBands(std::vector<int>(bands_.begin(), bands_.end()))
+        .setGrayscale(grayscale_)
+        .setKeepPalette(keepPalette_)
+        .setOverviewRatio(overviewRatio_)
+        .setDemFastRatio(demFastRatio_)
+        .setWithMask(withMask_);
 }
 
 cv::Mat* ShRaster::response() {
@@ -82,20 +88,19 @@ void ShRaster::response(bi::interprocess_mutex &mutex, cv::Mat *response)
 
 namespace {
 
-void copyOptions(StringVector &dst
+void copyOptions(ShInternedVector &dst
                 , const geo::GeoDataset::Sl & options
                 , ManagedBuffer &sm)
 {
     for (const auto & option : options)
-        dst.push_back(String(option.data(), option.size()
-                         , sm.get_allocator<char>()));
+        dst.push_back(ShInterned(option, sm));
 }
 
 void copyOptions(geo::GeoDataset::Sl & options
-                , const StringVector &src)
+                , const ShInternedVector &src)
 {
     for (const auto &str : src)
-        options.emplace_back(str.data(), str.size());
+        options.push_back(str.str());
 
 }
 
@@ -107,9 +112,13 @@ ShRasterWP::ShRasterWP(const GdalWarper::RasterRequestWP &other
     , ManagedBuffer &sm, ShRequestBase *owner)
     : ShRaster(other, sm, owner)
     , processing_(other.processing)
-    , processingOptions_(sm.get_allocator<char>()) {
+    , processingOptions_(sm.get_allocator<ShInterned>())
+    , native_(other.native) {
 
-    copyOptions(processingOptions_, other.processingOptions, sm);
+    // precompiled processing needs no options
+    if (!native_) {
+        copyOptions(processingOptions_, other.processingOptions, sm);
+    }
 }
 
 ShRasterWP::operator GdalWarper::RasterRequestWP() const {
@@ -118,12 +127,13 @@ ShRasterWP::operator GdalWarper::RasterRequestWP() const {
     copyOptions(processingOptions, processingOptions_);
 
     GdalWarper::RasterRequestWP ret(
-        std::string(dataset_.data(), dataset_.size())
-        , geo::SrsDefinition(asString(srs_), srsType_)
+        dataset_.str()
+        , geo::SrsDefinition(srs_.str(), srsType_)
         , extents_, size_, processing_, processingOptions
         , resampling_);
 
     ret.setNodata(nodata_);
+    ret.setNative(native_);
 
     return ret;
 }
@@ -159,7 +169,7 @@ void copyLayers(boost::optional<geo::heightcoding::Config::LayerNames> &dst
 } // namespace
 
 ShHeightCodeConfig
-::ShHeightCodeConfig(const geo::heightcoding::Config &config
+::ShHeightCodeConfig(const GdalWarper::HeightcodeConfig &config
                      , ManagedBuffer &sm)
     : workingSrs_(sm.get_allocator<char>())
     , workingSrsType_()
@@ -173,6 +183,7 @@ ShHeightCodeConfig
     , formatConfig_(config.formatConfig)
     , mode_(config.mode)
     , schema_(config.schema)
+    , batchSampling_(config.batchSampling)
 {
     if (config.workingSrs) {
         workingSrs_.assign(config.workingSrs->srs.data()
@@ -191,9 +202,9 @@ ShHeightCodeConfig
     copyLayers(clipLayers_, config.clipLayers, sm);
 }
 
-ShHeightCodeConfig::operator geo::heightcoding::Config() const
+ShHeightCodeConfig::operator GdalWarper::HeightcodeConfig() const
 {
-    geo::heightcoding::Config config;
+    GdalWarper::HeightcodeConfig config;
     config.workingSrs = asOptional(workingSrs_, workingSrsType_);
     if (!outputSrs_.empty()) {
         config.outputSrs
@@ -211,6 +222,7 @@ ShHeightCodeConfig::operator geo::heightcoding::Config() const
     config.formatConfig = formatConfig_;
     config.mode = mode_;
     config.schema = schema_;
+    config.batchSampling = batchSampling_;
 
     return config;
 }
@@ -218,8 +230,7 @@ ShHeightCodeConfig::operator geo::heightcoding::Config() const
 
 ShDemDataset::ShDemDataset(const DemDataset &demDataset
                            , ManagedBuffer &sm)
-    : dataset(demDataset.dataset.data(), demDataset.dataset.size()
-              , sm.get_allocator<char>())
+    : dataset(demDataset.dataset, sm)
     , geoidGrid(sm.get_allocator<char>())
 {
     if (demDataset.geoidGrid) {
@@ -230,20 +241,19 @@ ShDemDataset::ShDemDataset(const DemDataset &demDataset
 
 DemDataset ShDemDataset::demDataset() const
 {
-    return { asString(dataset), asOptional(geoidGrid) };
+    return { dataset.str(), asOptional(geoidGrid) };
 }
 
 ShHeightCode
 ::ShHeightCode(const std::string &vectorDs
                , const DemDataset::list &rasterDs
-               , const geo::heightcoding::Config &config
+               , const GdalWarper::HeightcodeConfig &config
                , const boost::optional<std::string> &vectorGeoidGrid
                , const std::vector<std::string> &openOptions
                , const LayerEnhancer::map &layerEnhancers
                , ManagedBuffer &sm, ShRequestBase *owner)
     : sm_(sm), owner_(owner)
-    , vectorDs_(vectorDs.data(), vectorDs.size()
-                , sm.get_allocator<char>())
+    , vectorDs_(vectorDs, sm)
     , rasterDs_(sm.get_allocator<ShDemDataset>())
     , config_(config, sm)
     , vectorGeoidGrid_(sm.get_allocator<char>())
@@ -261,11 +271,10 @@ ShHeightCode
     }
 
     if (!openOptions.empty()) {
-        openOptions_ = boost::in_place(sm.get_allocator<String>());
+        openOptions_ = boost::in_place(sm.get_allocator<ShInterned>());
 
         for (const auto &str : openOptions) {
-            openOptions_->push_back(String(str.data(), str.size()
-                                           , sm.get_allocator<char>()));
+            openOptions_->push_back(ShInterned(str, sm));
         }
     }
 
@@ -292,7 +301,7 @@ ShHeightCode::~ShHeightCode() {
 
 std::string ShHeightCode::vectorDs() const
 {
-    return asString(vectorDs_);
+    return vectorDs_.str();
 }
 
 DemDataset::list ShHeightCode::rasterDs() const
@@ -304,7 +313,7 @@ DemDataset::list ShHeightCode::rasterDs() const
     return ds;
 }
 
-geo::heightcoding::Config ShHeightCode::config() const {
+GdalWarper::HeightcodeConfig ShHeightCode::config() const {
     return config_;
 }
 
@@ -320,7 +329,7 @@ std::vector<std::string> ShHeightCode::openOptions() const
 
     std::vector<std::string> openOptions;
     for (const auto &str : *openOptions_) {
-        openOptions.emplace_back(str.data(), str.size());
+        openOptions.push_back(str.str());
     }
     return openOptions;
 }
@@ -29,6 +29,7 @@
 
 #include "../gdalsupport.hpp"
 #include "requestbase.hpp"
+#include "interner.hpp"
 
 class ShRaster : boost::noncopyable {
 public:
@@ -44,19 +45,43 @@ public:
     cv::Mat* response();
     void response(bi::interprocess_mutex &mutex, cv::Mat *response);
 
+    GdalWarper::RasterRequest::Operation operation() const {
+        return operation_;
+    }
+
+    std::string dataset() const { return dataset_.str(); }
+
+    const math::Size2& size() const { return size_; }
+
+    const math::Extents2& extents() const { return extents_; }
+
+    /** Overview chosen by selection policy (if applied).
+     */
+    boost::optional<int> overview() const { return overview_; }
+    void overview(const boost::optional<int> &overview) {
+        overview_ = overview;
+    }
+
 protected:
     ManagedBuffer &sm_;
     ShRequestBase *owner_;
 
     GdalWarper::RasterRequest::Operation operation_;
-    String dataset_;
-    String srs_;
+    ShInterned dataset_;
+    ShInterned srs_;
     geo::SrsDefinition::Type srsType_;
     math::Extents2 extents_;
     math::Size2 size_;
     geo::GeoDataset::Resampling resampling_;
-    String mask_;
+    ShInterned mask_;
     boost::optional<double> nodata_;
+    IntVector bands_;
+    bool grayscale_;
+    bool keepPalette_;
+    boost::optional<double> overviewRatio_;
+    boost::optional<double> demFastRatio_;
+    bool withMask_;
+    boost::optional<int> overview_;
 
     // response matrix
     cv::Mat *response_;
@@ -74,15 +99,16 @@ public:
 
 private:
     geo::GeoDataset::DemProcessing processing_;
-    StringVector processingOptions_;
+    ShInternedVector processingOptions_;
+    boost::optional<demprocessing::Params> native_;
 };
 
 class ShHeightCodeConfig {
 public:
-    ShHeightCodeConfig(const geo::heightcoding::Config &config
+    ShHeightCodeConfig(const GdalWarper::HeightcodeConfig &config
                        , ManagedBuffer &sm);
 
-    operator geo::heightcoding::Config() const;
+    operator GdalWarper::HeightcodeConfig() const;
 
 private:
     String workingSrs_;
@@ -104,10 +130,11 @@ private:
 
     geo::heightcoding::Mode mode_;
     geo::heightcoding::Schema schema_;
+    bool batchSampling_;
 };
 
 struct ShDemDataset {
-    String dataset;
+    ShInterned dataset;
     String geoidGrid;
 
     ShDemDataset(const DemDataset &demDataset, ManagedBuffer &sm);
@@ -122,7 +149,7 @@ class ShHeightCode : boost::noncopyable {
 public:
     ShHeightCode(const std::string &vectorDs
                  , const DemDataset::list &rasterDs
-                 , const geo::heightcoding::Config &config
+                 , const GdalWarper::HeightcodeConfig &config
                  , const boost::optional<std::string> &vectorGeoidGrid
                  , const std::vector<std::string> &openOptions
                  , const LayerEnhancer::map &layerEnhancers
@@ -134,7 +161,7 @@ public:
 
     DemDataset::list rasterDs() const;
 
-    geo::heightcoding::Config config() const;
+    GdalWarper::HeightcodeConfig config() const;
 
     boost::optional<std::string> vectorGeoidGrid() const;
 
@@ -152,11 +179,11 @@ public:
 private:
     ManagedBuffer &sm_;
     ShRequestBase *owner_;
-    String vectorDs_;
+    ShInterned vectorDs_;
     ShDemDatasetList rasterDs_;
     ShHeightCodeConfig config_;
     String vectorGeoidGrid_;
-    boost::optional<StringVector> openOptions_;
+    boost::optional<ShInternedVector> openOptions_;
     StringVector layerEnhancers_; // NB: encoded as 3 strings each
 
     // response memory block
@@ -0,0 +1,139 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <system_error>
+
+#include "dbglog/dbglog.hpp"
+
+#include "segment.hpp"
+
+namespace {
+
+/** Default hugepage size as reported by the kernel, 2 MB if unknown.
+ */
+std::size_t hugepageSize()
+{
+    std::ifstream f("/proc/meminfo");
+    std::string key;
+    std::size_t value;
+    while (f >> key >> value) {
+        if (key == "Hugepagesize:") { return value << 10; }
+        f.ignore(256, '\n');
+    }
+    return std::size_t(2) << 20;
+}
+
+std::size_t roundUp(std::size_t size, std::size_t page)
+{
+    return ((size + page - 1) / page) * page;
+}
+
+void* mapHugepages(std::size_t size)
+{
+#ifdef MFD_HUGETLB
+    // memfd keeps the mapping visible (and accounted) as a file
+    const int fd(::memfd_create("mapproxy-warper", MFD_HUGETLB));
+    if (fd >= 0) {
+        void *mem(MAP_FAILED);
+        if (!::ftruncate(fd, size)) {
+            mem = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED
+                         , fd, 0);
+        }
+        ::close(fd);
+        if (mem != MAP_FAILED) { return mem; }
+    }
+#endif
+
+    return ::mmap(nullptr, size, PROT_READ | PROT_WRITE
+                  , MAP_SHARED | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+}
+
+/** Touches every page of the segment.
+ */
+void prefault(void *mem, std::size_t size)
+{
+#ifdef MADV_POPULATE_WRITE
+    if (!::madvise(mem, size, MADV_POPULATE_WRITE)) { return; }
+#endif
+
+    // memory is zero-filled, writing zeros keeps it that way
+    const std::size_t page(::sysconf(_SC_PAGESIZE));
+    auto *data(static_cast<volatile char*>(mem));
+    for (std::size_t offset(0); offset < size; offset += page) {
+        data[offset] = 0;
+    }
+}
+
+} // namespace
+
+SharedSegment::SharedSegment(std::size_t size, bool hugepages
+                             , bool prefault)
+    : address_(MAP_FAILED), size_(size), mapped_(), hugepages_(false)
+{
+    if (hugepages) {
+        mapped_ = roundUp(size, hugepageSize());
+        address_ = mapHugepages(mapped_);
+        if (address_ != MAP_FAILED) {
+            hugepages_ = true;
+        } else {
+            const int err(errno);
+            LOG(warn3)
+                << "Unable to map " << (mapped_ >> 20)
+                << " MB of shared memory in hugepages (" << std::strerror(err)
+                << "); reserve them via vm.nr_hugepages. Using regular pages.";
+        }
+    }
+
+    if (!hugepages_) {
+        mapped_ = roundUp(size, ::sysconf(_SC_PAGESIZE));
+        address_ = ::mmap(nullptr, mapped_, PROT_READ | PROT_WRITE
+                          , MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (address_ == MAP_FAILED) {
+            std::system_error e(errno, std::system_category());
+            LOG(fatal) << "Unable to map shared memory: <" << e.what()
+                       << ">.";
+            throw e;
+        }
+    }
+
+    if (prefault) {
+        LOG(info2) << "Prefaulting " << (mapped_ >> 20)
+                   << " MB of shared memory.";
+        ::prefault(address_, mapped_);
+    }
+}
+
+SharedSegment::~SharedSegment()
+{
+    if (address_ != MAP_FAILED) { ::munmap(address_, mapped_); }
+}
@@ -0,0 +1,63 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef mapproxy_gdalsupport_segment_hpp_included_
+#define mapproxy_gdalsupport_segment_hpp_included_
+
+#include <cstddef>
+
+#include <boost/noncopyable.hpp>
+
+/** Anonymous shared memory segment inherited by forked GDAL workers.
+ *
+ *  Optionally backed by explicitly reserved hugepages (memfd or
+ *  MAP_HUGETLB mapping; falls back to regular pages with a warning when
+ *  none are available) and prefaulted at creation, i.e. workers do not take
+ *  page faults on first touch and share fewer TLB entries.
+ */
+class SharedSegment : boost::noncopyable {
+public:
+    SharedSegment(std::size_t size, bool hugepages, bool prefault);
+    ~SharedSegment();
+
+    void* get_address() const { return address_; }
+    std::size_t get_size() const { return size_; }
+
+    /** Segment is backed by hugepages.
+     */
+    bool hugepages() const { return hugepages_; }
+
+private:
+    void *address_;
+    std::size_t size_;
+
+    /** Size of the mapping, rounded up to page size.
+     */
+    std::size_t mapped_;
+    bool hugepages_;
+};
+
+#endif // mapproxy_gdalsupport_segment_hpp_included_
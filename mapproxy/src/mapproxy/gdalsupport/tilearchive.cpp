@@ -0,0 +1,458 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdint>
+#include <atomic>
+#include <map>
+#include <vector>
+#include <algorithm>
+#include <system_error>
+
+#include <boost/algorithm/string/predicate.hpp>
+
+#include <sqlite3.h>
+
+#include <cpl_vsi.h>
+
+#include "dbglog/dbglog.hpp"
+
+#include "utility/format.hpp"
+
+#include "tilearchive.hpp"
+
+namespace ba = boost::algorithm;
+
+namespace tilearchive {
+
+namespace {
+
+const std::string MbTilesExtension(".mbtiles");
+const std::string PmTilesExtension(".pmtiles");
+
+boost::optional<TileRef> parse(const std::string &path
+                               , const std::string &extension)
+{
+    const auto marker(extension + "/");
+    const auto pos(path.rfind(marker));
+    if (pos == std::string::npos) { return boost::none; }
+
+    TileRef ref;
+    ref.archive = path.substr(0, pos + extension.size());
+
+    const auto tile(path.substr(pos + marker.size()));
+    char sep1, sep2;
+    int taken(0);
+    if ((std::sscanf(tile.c_str(), "%u%c%u%c%u%n", &ref.z, &sep1, &ref.x
+                     , &sep2, &ref.y, &taken) != 5)
+        || (sep1 != sep2) || ((sep1 != '-') && (sep1 != '/'))
+        || (ref.z > 31) || (ref.x >> ref.z) || (ref.y >> ref.z))
+    {
+        return boost::none;
+    }
+
+    // allow filename extension, e.g. 14-8956-5513.pbf
+    if ((std::size_t(taken) != tile.size()) && (tile[taken] != '.')) {
+        return boost::none;
+    }
+
+    return ref;
+}
+
+/** Inflates gzip stream using GDAL's virtual file systems.
+ */
+std::string gunzip(const char *data, std::size_t size)
+{
+    static std::atomic<unsigned int> counter(0);
+    const auto name(utility::format("/vsimem/tilearchive-%u.gz"
+                                    , ++counter));
+    ::VSIFCloseL(::VSIFileFromMemBuffer
+                 (name.c_str()
+                  , reinterpret_cast< ::GByte*>(const_cast<char*>(data))
+                  , size, false));
+
+    ::GByte *out(nullptr);
+    ::vsi_l_offset outSize(0);
+    const bool ok(::VSIIngestFile(nullptr, ("/vsigzip/" + name).c_str()
+                                  , &out, &outSize, -1));
+    ::VSIUnlink(name.c_str());
+
+    if (!ok) {
+        ::VSIFree(out);
+        LOGTHROW(err2, std::runtime_error)
+            << "Failed to inflate tile archive data.";
+    }
+
+    std::string result(reinterpret_cast<const char*>(out), outSize);
+    ::VSIFree(out);
+    return result;
+}
+
+/** MBTiles: SQLite database with tiles table. The connection and the tile
+ *  query are held open.
+ */
+class MbTiles : public Archive {
+public:
+    MbTiles(const std::string &path)
+        : path_(path), db_(), select_()
+    {
+        check(::sqlite3_open_v2
+              (path.c_str(), &db_, SQLITE_OPEN_READONLY, nullptr)
+              , "sqlite3_open_v2");
+
+        const std::string sql("SELECT tile_data FROM tiles WHERE"
+                              " zoom_level=? AND tile_column=?"
+                              " AND tile_row=?");
+        check(::sqlite3_prepare_v2(db_, sql.data(), sql.size()
+                                   , &select_, nullptr)
+              , "sqlite3_prepare");
+    }
+
+    ~MbTiles() {
+        if (select_) { ::sqlite3_finalize(select_); }
+        if (db_) { ::sqlite3_close(db_); }
+    }
+
+    bool tile(unsigned int z, unsigned int x, unsigned int y
+              , std::string &data) override
+    {
+        check(::sqlite3_reset(select_), "sqlite3_reset");
+        check(::sqlite3_bind_int(select_, 1, z), "sqlite3_bind_int");
+        check(::sqlite3_bind_int(select_, 2, x), "sqlite3_bind_int");
+        // MBTiles rows are counted from the bottom (TMS)
+        check(::sqlite3_bind_int(select_, 3, (1u << z) - 1 - y)
+              , "sqlite3_bind_int");
+
+        switch (auto res = ::sqlite3_step(select_)) {
+        case SQLITE_ROW: break;
+
+        case SQLITE_DONE:
+            // nothing found
+            return false;
+
+        default:
+            check(res, "sqlite3_step");
+        }
+
+        const auto *blob(::sqlite3_column_blob(select_, 0));
+        const auto size(::sqlite3_column_bytes(select_, 0));
+        if (!blob || (size <= 0)) { return false; }
+
+        data.assign(static_cast<const char*>(blob), size);
+        return true;
+    }
+
+private:
+    void check(int status, const char *what) const {
+        if (status) {
+            const char *msg(::sqlite3_errmsg(db_));
+            LOGTHROW(err1, std::runtime_error)
+                << "Sqlite3 operation " << what << " failed: <"
+                << msg << "> (file \"" << path_ << "\").";
+        }
+    }
+
+    const std::string path_;
+    ::sqlite3 *db_;
+    ::sqlite3_stmt *select_;
+};
+
+/** PMTiles (v3): the file is mapped into memory, root directory is parsed
+ *  at open, leaf directories on first use.
+ */
+class PmTiles : public Archive {
+public:
+    PmTiles(const std::string &path);
+
+    ~PmTiles();
+
+    bool tile(unsigned int z, unsigned int x, unsigned int y
+              , std::string &data) override;
+
+private:
+    struct Entry {
+        std::uint64_t tileId;
+        std::uint64_t offset;
+        std::uint64_t length;
+        std::uint64_t runLength;
+    };
+
+    typedef std::vector<Entry> Directory;
+
+    enum Compression : int { none = 1, gzip = 2 };
+
+    /** Returns pointer to given range of the file, checks bounds.
+     */
+    const char* at(std::uint64_t offset, std::uint64_t length) const;
+
+    Directory directory(std::uint64_t offset, std::uint64_t length) const;
+
+    const Directory& leaf(std::uint64_t offset, std::uint64_t length);
+
+    const std::string path_;
+    const char *data_;
+    std::size_t size_;
+
+    std::uint64_t leafOffset_;
+    std::uint64_t tileOffset_;
+    int internalCompression_;
+
+    Directory root_;
+
+    /** Parsed leaf directories by offset, dropped all at once when full.
+     */
+    std::map<std::uint64_t, Directory> leaves_;
+};
+
+const std::size_t PmTilesHeaderSize(127);
+const std::size_t MaxLeaves(256);
+
+std::uint64_t le64(const char *p)
+{
+    std::uint64_t value(0);
+    for (int i(7); i >= 0; --i) {
+        value = (value << 8) | static_cast<unsigned char>(p[i]);
+    }
+    return value;
+}
+
+PmTiles::PmTiles(const std::string &path)
+    : path_(path), data_(), size_()
+{
+    const int fd(::open(path.c_str(), O_RDONLY | O_CLOEXEC));
+    if (fd < 0) {
+        std::system_error e(errno, std::system_category());
+        LOG(err2) << "Cannot open PMTiles archive " << path << ": <"
+                  << e.code() << ", " << e.what() << ">.";
+        throw e;
+    }
+
+    struct ::stat st;
+    void *data(MAP_FAILED);
+    if (!::fstat(fd, &st) && (st.st_size > 0)) {
+        data = ::mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    const int error(errno);
+    ::close(fd);
+
+    if (data == MAP_FAILED) {
+        std::system_error e(error, std::system_category());
+        LOG(err2) << "Cannot map PMTiles archive " << path << ": <"
+                  << e.code() << ", " << e.what() << ">.";
+        throw e;
+    }
+
+    data_ = static_cast<const char*>(data);
+    size_ = st.st_size;
+
+    try {
+        const auto *header(at(0, PmTilesHeaderSize));
+        if (std::string(header, 7) != "PMTiles" || (header[7] != 3)) {
+            LOGTHROW(err2, std::runtime_error)
+                << "File " << path << " is not a PMTiles v3 archive.";
+        }
+
+        leafOffset_ = le64(header + 40);
+        tileOffset_ = le64(header + 56);
+        internalCompression_ = header[97];
+
+        const int tileCompression(header[98]);
+        if ((internalCompression_ != Compression::none)
+            && (internalCompression_ != Compression::gzip))
+        {
+            LOGTHROW(err2, std::runtime_error)
+                << "Unsupported directory compression "
+                << internalCompression_ << " in " << path << ".";
+        }
+        if (tileCompression > Compression::gzip) {
+            LOGTHROW(err2, std::runtime_error)
+                << "Unsupported tile compression " << tileCompression
+                << " in " << path << ".";
+        }
+
+        root_ = directory(le64(header + 8), le64(header + 16));
+    } catch (...) {
+        ::munmap(const_cast<char*>(data_), size_);
+        throw;
+    }
+}
+
+PmTiles::~PmTiles()
+{
+    ::munmap(const_cast<char*>(data_), size_);
+}
+
+const char* PmTiles::at(std::uint64_t offset, std::uint64_t length) const
+{
+    if ((offset > size_) || (length > (size_ - offset))) {
+        LOGTHROW(err2, std::runtime_error)
+            << "Range " << offset << "+" << length << " out of PMTiles "
+            "archive " << path_ << ".";
+    }
+    return data_ + offset;
+}
+
+PmTiles::Directory PmTiles::directory(std::uint64_t offset
+                                      , std::uint64_t length) const
+{
+    const auto *raw(at(offset, length));
+    const auto plain((internalCompression_ == Compression::gzip)
+                     ? gunzip(raw, length) : std::string(raw, length));
+
+    const char *p(plain.data());
+    const char *end(p + plain.size());
+    const auto varint([&]() -> std::uint64_t
+    {
+        std::uint64_t value(0);
+        for (int shift(0); ; shift += 7) {
+            if ((shift >= 64) || (p == end)) {
+                LOGTHROW(err2, std::runtime_error)
+                    << "Malformed directory in PMTiles archive " << path_
+                    << ".";
+            }
+            const auto byte(static_cast<unsigned char>(*p++));
+            value |= std::uint64_t(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) { return value; }
+        }
+    });
+
+    // every entry takes at least 4 bytes
+    const auto count(varint());
+    if (count > plain.size()) {
+        LOGTHROW(err2, std::runtime_error)
+            << "Malformed directory in PMTiles archive " << path_ << ".";
+    }
+
+    Directory dir(count);
+    std::uint64_t last(0);
+    for (auto &entry : dir) { entry.tileId = (last += varint()); }
+    for (auto &entry : dir) { entry.runLength = varint(); }
+    for (auto &entry : dir) { entry.length = varint(); }
+    for (std::size_t i(0); i < dir.size(); ++i) {
+        const auto value(varint());
+        if (value) {
+            dir[i].offset = value - 1;
+        } else if (i) {
+            // right after previous entry
+            dir[i].offset = dir[i - 1].offset + dir[i - 1].length;
+        } else {
+            LOGTHROW(err2, std::runtime_error)
+                << "Malformed directory in PMTiles archive " << path_
+                << ".";
+        }
+    }
+
+    return dir;
+}
+
+const PmTiles::Directory& PmTiles::leaf(std::uint64_t offset
+                                        , std::uint64_t length)
+{
+    auto fleaves(leaves_.find(offset));
+    if (fleaves != leaves_.end()) { return fleaves->second; }
+
+    auto dir(directory(offset, length));
+    if (leaves_.size() >= MaxLeaves) { leaves_.clear(); }
+    return leaves_.insert(std::make_pair(offset, std::move(dir)))
+        .first->second;
+}
+
+bool PmTiles::tile(unsigned int z, unsigned int x, unsigned int y
+                   , std::string &data)
+{
+    const auto id(pmTilesId(z, x, y));
+
+    // root -> leaf directories, spec allows at most 3 levels
+    const auto *dir(&root_);
+    for (int depth(0); depth < 4; ++depth) {
+        // last entry starting at or before the tile
+        auto it(std::upper_bound(dir->begin(), dir->end(), id
+                                 , [](std::uint64_t id, const Entry &entry)
+        {
+            return id < entry.tileId;
+        }));
+        if (it == dir->begin()) { return false; }
+        const auto entry(*--it);
+
+        if (entry.runLength) {
+            if (id >= (entry.tileId + entry.runLength)) { return false; }
+            data.assign(at(tileOffset_ + entry.offset, entry.length)
+                        , entry.length);
+            return true;
+        }
+
+        dir = &leaf(leafOffset_ + entry.offset, entry.length);
+    }
+
+    return false;
+}
+
+} // namespace
+
+std::uint64_t pmTilesId(unsigned int z, std::uint64_t x, std::uint64_t y)
+{
+    std::uint64_t id(((std::uint64_t(1) << (2 * z)) - 1) / 3);
+
+    const std::uint64_t n(std::uint64_t(1) << z);
+    for (std::uint64_t s(n >> 1); s; s >>= 1) {
+        const std::uint64_t rx((x & s) ? 1 : 0);
+        const std::uint64_t ry((y & s) ? 1 : 0);
+        id += s * s * ((3 * rx) ^ ry);
+
+        // rotate quadrant
+        if (!ry) {
+            if (rx) {
+                x = n - 1 - x;
+                y = n - 1 - y;
+            }
+            std::swap(x, y);
+        }
+    }
+
+    return id;
+}
+
+boost::optional<TileRef> parse(const std::string &path)
+{
+    if (auto ref = parse(path, MbTilesExtension)) { return ref; }
+    return parse(path, PmTilesExtension);
+}
+
+Archive::pointer Archive::open(const std::string &path)
+{
+    if (ba::iends_with(path, PmTilesExtension)) {
+        return std::make_shared<PmTiles>(path);
+    }
+    return std::make_shared<MbTiles>(path);
+}
+
+} // namespace tilearchive
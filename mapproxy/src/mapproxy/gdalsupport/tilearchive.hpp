@@ -0,0 +1,85 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef mapproxy_gdalsupport_tilearchive_hpp_included_
+#define mapproxy_gdalsupport_tilearchive_hpp_included_
+
+#include <memory>
+#include <cstdint>
+#include <string>
+
+#include <boost/optional.hpp>
+
+/** Single-file archives of pre-tiled vector data (MBTiles, PMTiles).
+ *
+ *  A tile inside an archive is addressed by a path of the form
+ *  <archive>.mbtiles/<z>-<x>-<y> (or .pmtiles), i.e. the dataset template of
+ *  geodata-vector-tiled expands to it directly. Tile coordinates follow the
+ *  XYZ scheme (row 0 at the top), MBTiles rows are flipped internally.
+ *
+ *  Archives are kept open by the GDAL worker (see DatasetCache::archive())
+ *  and tiles are read by offset, i.e. there is no per-tile file open.
+ */
+namespace tilearchive {
+
+struct TileRef {
+    std::string archive;
+    unsigned int z;
+    unsigned int x;
+    unsigned int y;
+
+    TileRef() : z(), x(), y() {}
+};
+
+/** Parses path to a tile inside an archive. Returns nothing for any other
+ *  path.
+ */
+boost::optional<TileRef> parse(const std::string &path);
+
+/** PMTiles tile id: position along the Hilbert curves of all zoom levels.
+ */
+std::uint64_t pmTilesId(unsigned int z, std::uint64_t x, std::uint64_t y);
+
+class Archive {
+public:
+    typedef std::shared_ptr<Archive> pointer;
+
+    virtual ~Archive() {}
+
+    /** Fetches raw tile payload (as stored, possibly gzipped). Returns false
+     *  if there is no such tile.
+     */
+    virtual bool tile(unsigned int z, unsigned int x, unsigned int y
+                      , std::string &data) = 0;
+
+    /** Opens archive, type is derived from filename extension.
+     */
+    static pointer open(const std::string &path);
+};
+
+} // namespace tilearchive
+
+#endif // mapproxy_gdalsupport_tilearchive_hpp_included_
@@ -68,6 +68,8 @@ typedef bi::basic_string<
 
 typedef bi::vector<String, bi::allocator<String, SegmentManager>> StringVector;
 
+typedef bi::vector<int, bi::allocator<int, SegmentManager>> IntVector;
+
 typedef bi::interprocess_mutex Mutex;
 typedef bi::scoped_lock<Mutex> Lock;
 
@@ -0,0 +1,478 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <algorithm>
+
+#include <boost/algorithm/string/predicate.hpp>
+
+#ifdef MAPPROXY_HAS_URING
+#include <liburing.h>
+#endif
+
+#include <cpl_vsi.h>
+#include <gdal.h>
+
+#include "dbglog/dbglog.hpp"
+
+#include "uringio.hpp"
+
+namespace ba = boost::algorithm;
+
+namespace uringio {
+
+namespace {
+
+const std::string Prefix("/vsiuring/");
+
+/** Process-wide handler configuration.
+ */
+struct Config {
+    Config(const Options &options)
+        : queueDepth(std::max(options.queueDepth, 1u))
+        , blockSize(std::max<std::size_t>(options.blockSize, 4) << 10)
+        , readahead(std::max<std::size_t>(options.readahead, 1))
+    {}
+
+    const unsigned int queueDepth;
+    const std::size_t blockSize;
+    const std::size_t readahead;
+};
+
+std::unique_ptr<Config> config;
+
+/** Single read of a batch.
+ */
+struct Range {
+    char *dst;
+    vsi_l_offset offset;
+    std::size_t size;
+};
+
+typedef std::vector<Range> Ranges;
+
+/** Reads whole range synchronously.
+ */
+bool preadAll(int fd, Range range)
+{
+    while (range.size) {
+        const auto r(::pread(fd, range.dst, range.size, range.offset));
+        if (r < 0) {
+            if (errno == EINTR) { continue; }
+            return false;
+        }
+        if (!r) { return false; }
+        range.dst += r;
+        range.offset += r;
+        range.size -= r;
+    }
+    return true;
+}
+
+#ifdef MAPPROXY_HAS_URING
+
+/** Per-thread submission ring.
+ */
+class Ring {
+public:
+    Ring(unsigned int depth) : depth_(depth) {
+        const auto res(::io_uring_queue_init(depth, &ring_, 0));
+        ok_ = !res;
+        if (!ok_) {
+            LOG(warn2) << "Unable to set up io_uring: "
+                       << std::strerror(-res) << "; using pread().";
+        }
+    }
+
+    ~Ring() { if (ok_) { ::io_uring_queue_exit(&ring_); } }
+
+    bool ok() const { return ok_; }
+
+    /** Reads all ranges, at most depth reads in flight. Short reads are
+     *  finished synchronously.
+     */
+    bool read(int fd, Ranges &ranges);
+
+private:
+    const unsigned int depth_;
+    io_uring ring_;
+    bool ok_;
+};
+
+bool Ring::read(int fd, Ranges &ranges)
+{
+    bool ok(true);
+    std::size_t next(0);
+    unsigned int pending(0);
+
+    while ((next < ranges.size()) || pending) {
+        // fill submission queue
+        while ((next < ranges.size()) && (pending < depth_)) {
+            auto *sqe(::io_uring_get_sqe(&ring_));
+            if (!sqe) { break; }
+            auto &range(ranges[next++]);
+            ::io_uring_prep_read(sqe, fd, range.dst, range.size
+                                 , range.offset);
+            ::io_uring_sqe_set_data(sqe, &range);
+            ++pending;
+        }
+
+        const auto res(::io_uring_submit_and_wait(&ring_, 1));
+        if (res < 0) {
+            if (res == -EINTR) { continue; }
+            // ring state is unknown, do not use it anymore
+            LOG(warn2) << "io_uring submission failed: "
+                       << std::strerror(-res) << "; using pread().";
+            ::io_uring_queue_exit(&ring_);
+            ok_ = false;
+            return false;
+        }
+
+        unsigned int head, seen(0);
+        io_uring_cqe *cqe;
+        io_uring_for_each_cqe(&ring_, head, cqe) {
+            ++seen;
+            auto &range(*static_cast<Range*>(::io_uring_cqe_get_data(cqe)));
+            if (cqe->res <= 0) {
+                ok = false;
+            } else if (std::size_t(cqe->res) < range.size) {
+                // short read, finish synchronously
+                range.dst += cqe->res;
+                range.offset += cqe->res;
+                range.size -= cqe->res;
+                if (!preadAll(fd, range)) { ok = false; }
+            }
+        }
+        ::io_uring_cq_advance(&ring_, seen);
+        pending -= seen;
+    }
+
+    return ok;
+}
+
+thread_local std::unique_ptr<Ring> threadRing;
+
+Ring* ring()
+{
+    if (!threadRing) { threadRing.reset(new Ring(config->queueDepth)); }
+    return threadRing->ok() ? threadRing.get() : nullptr;
+}
+
+#endif // MAPPROXY_HAS_URING
+
+/** Reads all ranges in one batch if possible, one by one otherwise.
+ */
+bool read(int fd, Ranges &ranges)
+{
+    if (ranges.empty()) { return true; }
+
+#ifdef MAPPROXY_HAS_URING
+    if (ranges.size() > 1) {
+        // NB: ranges are modified by short reads, keep the original ones
+        auto copy(ranges);
+        if (auto *r = ring()) { if (r->read(fd, copy)) { return true; } }
+    }
+#endif
+
+    for (const auto &range : ranges) {
+        if (!preadAll(fd, range)) { return false; }
+    }
+    return true;
+}
+
+/** Splits range into block-sized reads (so that they run in parallel) and
+ *  adds them to the batch.
+ */
+void split(Ranges &ranges, char *dst, vsi_l_offset offset, std::size_t size)
+{
+    while (size) {
+        const auto chunk(std::min(size, config->blockSize
+                                  - std::size_t(offset % config->blockSize)));
+        ranges.push_back({ dst, offset, chunk });
+        dst += chunk;
+        offset += chunk;
+        size -= chunk;
+    }
+}
+
+/** Open local file.
+ */
+class File {
+public:
+    File(int fd, vsi_l_offset size)
+        : fd_(fd), size_(size), offset_(), eof_(), bufferStart_()
+    {}
+
+    ~File() { ::close(fd_); }
+
+    std::size_t read(char *dst, std::size_t size);
+
+    /** Reads all given ranges in one batch.
+     */
+    int read(int count, void **data, const vsi_l_offset *offsets
+             , const std::size_t *sizes);
+
+    int seek(vsi_l_offset offset, int whence) {
+        switch (whence) {
+        case SEEK_SET: offset_ = offset; break;
+        case SEEK_CUR: offset_ += offset; break;
+        case SEEK_END: offset_ = size_ + offset; break;
+        default: return -1;
+        }
+        eof_ = false;
+        return 0;
+    }
+
+    vsi_l_offset tell() const { return offset_; }
+
+    bool eof() const { return eof_; }
+
+private:
+    /** Fills readahead buffer with blocks covering given range.
+     */
+    bool fill(vsi_l_offset offset, std::size_t size);
+
+    const int fd_;
+    const vsi_l_offset size_;
+
+    vsi_l_offset offset_;
+    bool eof_;
+
+    /** Readahead buffer and its position in the file.
+     */
+    vsi_l_offset bufferStart_;
+    std::vector<char> buffer_;
+};
+
+bool File::fill(vsi_l_offset offset, std::size_t size)
+{
+    const auto start(offset - (offset % config->blockSize));
+    const auto end(std::min<vsi_l_offset>
+                   (size_, std::max<vsi_l_offset>
+                    (offset + size
+                     , start + config->readahead * config->blockSize)));
+
+    buffer_.resize(end - start);
+    bufferStart_ = start;
+
+    Ranges ranges;
+    split(ranges, buffer_.data(), start, buffer_.size());
+    if (!uringio::read(fd_, ranges)) {
+        buffer_.clear();
+        return false;
+    }
+    return true;
+}
+
+std::size_t File::read(char *dst, std::size_t size)
+{
+    if (offset_ >= size_) {
+        eof_ = true;
+        return 0;
+    }
+
+    if (size > (size_ - offset_)) {
+        size = size_ - offset_;
+        eof_ = true;
+    }
+
+    const auto inBuffer([&]() -> bool
+    {
+        return ((offset_ >= bufferStart_)
+                && ((offset_ + size) <= (bufferStart_ + buffer_.size())));
+    });
+
+    if (!inBuffer()) {
+        if (size >= (config->readahead * config->blockSize)) {
+            // large read, straight into the destination
+            Ranges ranges;
+            split(ranges, dst, offset_, size);
+            if (!uringio::read(fd_, ranges)) { return 0; }
+            offset_ += size;
+            return size;
+        }
+
+        if (!fill(offset_, size)) { return 0; }
+    }
+
+    std::memcpy(dst, buffer_.data() + (offset_ - bufferStart_), size);
+    offset_ += size;
+    return size;
+}
+
+int File::read(int count, void **data, const vsi_l_offset *offsets
+               , const std::size_t *sizes)
+{
+    Ranges ranges;
+    for (int i(0); i < count; ++i) {
+        if ((offsets[i] + sizes[i]) > size_) { return -1; }
+        split(ranges, static_cast<char*>(data[i]), offsets[i], sizes[i]);
+    }
+    return uringio::read(fd_, ranges) ? 0 : -1;
+}
+
+std::string underlying(const char *filename)
+{
+    return std::string(filename).substr(Prefix.size());
+}
+
+int vsiStat(void*, const char *filename, VSIStatBufL *stat, int flags)
+{
+    return ::VSIStatExL(underlying(filename).c_str(), stat, flags);
+}
+
+void* vsiOpen(void*, const char *filename, const char *access)
+{
+    // read-only
+    if (std::strchr(access, 'w') || std::strchr(access, 'a')
+        || std::strchr(access, '+'))
+    {
+        return nullptr;
+    }
+
+    const auto path(underlying(filename));
+    const int fd(::open(path.c_str(), O_RDONLY | O_CLOEXEC));
+    if (fd < 0) { return nullptr; }
+
+    struct ::stat st;
+    if (::fstat(fd, &st) || !S_ISREG(st.st_mode)) {
+        ::close(fd);
+        return nullptr;
+    }
+
+    // we do our own readahead
+    ::posix_fadvise(fd, 0, 0, POSIX_FADV_RANDOM);
+
+    return new File(fd, st.st_size);
+}
+
+vsi_l_offset vsiTell(void *file)
+{
+    return static_cast<File*>(file)->tell();
+}
+
+int vsiSeek(void *file, vsi_l_offset offset, int whence)
+{
+    return static_cast<File*>(file)->seek(offset, whence);
+}
+
+std::size_t vsiRead(void *file, void *buffer, std::size_t size
+                    , std::size_t count)
+{
+    if (!size) { return 0; }
+    return static_cast<File*>(file)->read
+        (static_cast<char*>(buffer), size * count) / size;
+}
+
+int vsiReadMultiRange(void *file, int count, void **data
+                      , const vsi_l_offset *offsets
+                      , const std::size_t *sizes)
+{
+    return static_cast<File*>(file)->read(count, data, offsets, sizes);
+}
+
+int vsiEof(void *file)
+{
+    return static_cast<File*>(file)->eof();
+}
+
+int vsiClose(void *file)
+{
+    delete static_cast<File*>(file);
+    return 0;
+}
+
+} // namespace
+
+void install(const Options &options)
+{
+    static std::once_flag once;
+    std::call_once(once, [&]()
+    {
+#if defined(MAPPROXY_HAS_URING) \
+    && (GDAL_VERSION_NUM >= GDAL_COMPUTE_VERSION(3, 0, 0))
+        config.reset(new Config(options));
+
+        // probe: kernel (or seccomp policy) may not allow io_uring
+        if (!Ring(config->queueDepth).ok()) {
+            LOG(warn3) << "io_uring not available; local datasets are read "
+                "by GDAL directly.";
+            config.reset();
+            return;
+        }
+
+        auto *cb(::VSIAllocFilesystemPluginCallbacksStruct());
+        cb->stat = &vsiStat;
+        cb->open = &vsiOpen;
+        cb->tell = &vsiTell;
+        cb->seek = &vsiSeek;
+        cb->read = &vsiRead;
+        cb->read_multi_range = &vsiReadMultiRange;
+        cb->eof = &vsiEof;
+        cb->close = &vsiClose;
+        const auto installed(::VSIInstallPluginHandler(Prefix.c_str(), cb));
+        ::VSIFreeFilesystemPluginCallbacksStruct(cb);
+
+        if (installed) {
+            LOG(warn3) << "Unable to install " << Prefix
+                       << " handler; local datasets are read by GDAL "
+                "directly.";
+            config.reset();
+            return;
+        }
+
+        LOG(info2) << "Local GeoTIFFs are read via io_uring (queue depth "
+                   << config->queueDepth << ").";
+#else
+        (void) options;
+        LOG(warn3) << "Built without liburing or GDAL too old (needs 3.0); "
+            "local datasets are read by GDAL directly.";
+#endif
+    });
+}
+
+std::string route(const std::string &path)
+{
+    if (!config) { return path; }
+    if (!ba::starts_with(path, "/") || ba::starts_with(path, "/vsi")) {
+        return path;
+    }
+    if (ba::iends_with(path, ".tif") || ba::iends_with(path, ".tiff")) {
+        return Prefix + path;
+    }
+    return path;
+}
+
+} // namespace uringio
@@ -0,0 +1,79 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef mapproxy_gdalsupport_uringio_hpp_included_
+#define mapproxy_gdalsupport_uringio_hpp_included_
+
+#include <string>
+
+/** Batched reads of local GeoTIFF datasets via io_uring.
+ *
+ *  Local GeoTIFFs are opened through /vsiuring/ handler installed in each
+ *  worker. GDAL's GeoTIFF driver hands all blocks of a RasterIO window to
+ *  the handler at once (multi-range read); they are submitted as a single
+ *  io_uring batch so that one warp keeps the device's queue busy. Plain
+ *  reads missing the readahead buffer fetch several blocks after the read
+ *  one in a single batch as well.
+ *
+ *  Needs liburing at build time (MAPPROXY_HAS_URING) and io_uring at run
+ *  time; reads fall back to pread() if the ring cannot be set up.
+ */
+namespace uringio {
+
+struct Options {
+    /** Route local GeoTIFFs through the handler.
+     */
+    bool enabled;
+
+    /** Submission queue depth of each thread's ring.
+     */
+    unsigned int queueDepth;
+
+    /** Readahead block size in KB.
+     */
+    std::size_t blockSize;
+
+    /** Number of blocks read at once on readahead miss.
+     */
+    std::size_t readahead;
+
+    Options()
+        : enabled(false), queueDepth(64), blockSize(64), readahead(8)
+    {}
+};
+
+/** Installs the /vsiuring/ handler into this process. Idempotent.
+ */
+void install(const Options &options);
+
+/** Routes local GeoTIFF path through the handler if it is installed in this
+ *  process. Other paths are returned untouched.
+ */
+std::string route(const std::string &path);
+
+} // namespace uringio
+
+#endif // mapproxy_gdalsupport_uringio_hpp_included_
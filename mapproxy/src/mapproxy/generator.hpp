@@ -30,9 +30,14 @@
 #include <memory>
 #include <string>
 #include <map>
+#include <list>
+#include <vector>
 #include <iostream>
 #include <atomic>
+#include <mutex>
+#include <shared_mutex>
 #include <cstdint>
+#include <functional>
 
 #include <boost/noncopyable.hpp>
 #include <boost/any.hpp>
@@ -50,18 +55,49 @@
 #include "gdalsupport.hpp"
 #include "sink.hpp"
 
+#include "support/mmapped/memory.hpp"
+
 #include "generator/demregistry.hpp"
 
 namespace vs = vtslibs::storage;
 namespace vts = vtslibs::vts;
 
+class ContentCache;
+class SharedMaskTree;
+namespace mmapped { class TileIndex; }
+
 struct Arsenal {
+    typedef std::function<void(Sink&, Arsenal&)> Continuation;
+    typedef std::function<void(const Continuation&, const Sink&)> Poster;
+
     GdalWarper &warper;
     const utility::ResourceFetcher &fetcher;
 
-    Arsenal(GdalWarper &warper, const utility::ResourceFetcher &fetcher)
-        : warper(warper), fetcher(fetcher)
+    /** Cache of derived content shared by generators, null if disabled.
+     */
+    ContentCache *contentCache;
+
+    /** Called after generator has been successfully prepared, if set.
+     */
+    std::function<void(const std::shared_ptr<Generator>&)> onPrepared;
+
+    Arsenal(GdalWarper &warper, const utility::ResourceFetcher &fetcher
+            , const Poster &poster = Poster())
+        : warper(warper), fetcher(fetcher), contentCache(), poster_(poster)
     {}
+
+    /** Runs continuation (e.g. from asynchronous warper callback) in the
+     *  core processing pool, or in place if there is no pool. Any exception
+     *  thrown by continuation is reported to the sink.
+     */
+    void post(const Continuation &continuation, const Sink &sink);
+
+    /** Is there a core processing pool to post continuations to?
+     */
+    bool pooled() const { return bool(poster_); }
+
+private:
+    Poster poster_;
 };
 
 class Generator;
@@ -118,10 +154,29 @@ public:
         std::set<Resource::Generator::Type> freezeResourceTypes;
         std::string externalUrl;
 
+        /** Tile index lods held in dense arrays (see mmapped::TileIndex).
+         */
+        unsigned int denseTileIndexLods;
+
+        /** How tile index files are brought into memory.
+         */
+        mmapped::MapPolicy indexMapPolicy;
+
+        /** Geodata tiles using the same DEMs requested within this time (in
+         *  ms) are heightcoded in one warper job (0 = no batching).
+         */
+        unsigned int heightcodeBatchWindow;
+
+        /** Maximum number of tiles heightcoded in one warper job.
+         */
+        std::size_t heightcodeBatchSize;
+
         Config()
             : fileFlags(), variables(), defaults()
             , defaultFov(vr::Position::naturalFov())
             , freezeResourceTypes{Resource::Generator::Type::surface}
+            , denseTileIndexLods(8), heightcodeBatchWindow()
+            , heightcodeBatchSize(16)
         {}
 
         bool freezes(Resource::Generator::Type type) const {
@@ -164,6 +219,17 @@ public:
 
     static DefinitionBase::pointer definition(const Resource::Generator &type);
 
+    /** Store directory of given resource under given root.
+     */
+    static boost::filesystem::path
+    storeRoot(const boost::filesystem::path &root
+              , const Resource::Id &resourceId);
+
+    /** Does generator of given type serve delivery index converted from
+     *  tileset.index (see Factory::deliveryIndex())?
+     */
+    static bool deliveryIndex(const Resource::Generator &type);
+
     struct Factory;
     static void registerType(const Resource::Generator &type
                              , const std::shared_ptr<Factory> &factory);
@@ -189,7 +255,11 @@ public:
      */
     void prepare(Arsenal &arsenal);
 
-    const Resource& resource() const { return resource_; }
+    /** Current resource. Metadata update (see updateMetadata) publishes new
+     *  immutable resource instead of modifying this one, i.e. returned
+     *  reference stays valid (and unchanged) for generator's lifetime.
+     */
+    const Resource& resource() const { return *current_; }
     const Resource::Id& id() const { return resource_.id; }
     const std::string& group() const { return resource_.id.group; }
     Resource::Generator::Type type() const { return resource_.generator.type; }
@@ -236,6 +306,93 @@ public:
      */
     bool updatedSince(std::uint64_t timestamp) const;
 
+    /** Timestamp when this generator became ready.
+     */
+    std::uint64_t readySince() const { return readySince_; }
+
+    /** Stable digest of resource's metadata (comment, credits, registry,
+     *  file class settings and definition incl. introspection). Changes
+     *  with every metadata update; part of response cache keys.
+     */
+    std::uint64_t metadataTag() const { return metadataTag_; }
+
+    /** Records access to this generator (used to unload idle generators).
+     */
+    void touch() const;
+
+    /** Timestamp of last recorded access (or creation).
+     */
+    std::uint64_t lastAccess() const { return lastAccess_; }
+
+    /** Can generated files be cached, i.e. are they the same for the same
+     *  URL and resource revision? Defaults to true.
+     */
+    bool cacheable() const { return cacheable_impl(); }
+
+    /** What warming the generator up involves (see Core::warm).
+     */
+    struct Warmup {
+        /** Datasets read through the GDAL warper, opened by every worker.
+         */
+        std::vector<std::string> datasets;
+
+        /** Extension of tile files worth rendering at the lowest lods of the
+         *  resource (empty = nothing to render).
+         */
+        std::string ext;
+
+        /** Bytes of memory-mapped data (indexes, mask trees) faulted in.
+         */
+        std::size_t prefaulted = 0;
+    };
+
+    /** Faults in generator's memory-mapped data and returns the rest of the
+     *  warm-up to be done by the caller.
+     */
+    Warmup warmup() const { return warmup_impl(); }
+
+    /** Memory held by the generator, by component ("index", "maskTree",
+     *  "landcover", "cache", ...). Mask trees shared by several generators
+     *  are reported by each of them.
+     */
+    struct Memory {
+        struct Usage {
+            /** Bytes currently in RAM.
+             */
+            std::size_t resident = 0;
+
+            /** Bytes of address space, mapped files included.
+             */
+            std::size_t virt = 0;
+
+            Usage& operator+=(const Usage &o) {
+                resident += o.resident; virt += o.virt; return *this;
+            }
+        };
+
+        std::map<std::string, Usage> components;
+
+        void add(const std::string &component, std::size_t resident
+                 , std::size_t virt);
+
+        /** Heap memory: resident as well as virtual.
+         */
+        void add(const std::string &component, std::size_t heap) {
+            add(component, heap, heap);
+        }
+
+        void add(const std::string &component
+                 , const mmapped::TileIndex &index);
+
+        void add(const std::string &component, const SharedMaskTree &tree);
+
+        Usage total() const;
+    };
+
+    /** Measures memory held by the generator.
+     */
+    Memory memory() const;
+
     /** Generic type for provider handling
      */
     struct Provider { virtual ~Provider() {} };
@@ -250,6 +407,23 @@ public:
      */
     void purge();
 
+    /** Drops memoized documents. Called on resources update since documents
+     *  may depend on other resources.
+     */
+    void forgetDocuments();
+
+    /** Applies metadata-only change (see Changed::metadata) in place:
+     *  publishes copy of current resource with credits, registry, file
+     *  class settings, comment and definition (differs in presentation data
+     *  only) taken from given resource, stored resource file is re-saved
+     *  and memoized documents are dropped. Generator stays ready and keeps
+     *  its prepared data.
+     *
+     *  Metadata must be read through resource(): data held by derived
+     *  generators (e.g. definition reference) keep the original values.
+     */
+    void updateMetadata(const Resource &resource);
+
 protected:
     Generator(const Params &params, const Properties &props = Properties());
 
@@ -258,6 +432,25 @@ protected:
 
     void mapConfig(std::ostream &os, ResourceRoot root) const;
 
+    typedef std::function<void(std::ostream &os)> Serializer;
+
+    /** Sends serialized document (mapConfig, layer definition, ...)
+     *  memoized under given name. Document is serialized (and gzipped) on
+     *  first use, gzipped variant is sent to clients accepting it.
+     */
+    void sendDocument(const std::string &name, const FileInfo &fileInfo
+                      , const Sink::FileInfo &stat, Sink &sink
+                      , const Serializer &serializer) const;
+
+    /** Sends style: built-in support file or external style file if path is
+     *  not empty. Memoized as a document (see sendDocument); external file
+     *  is re-read when its modification time or size changes.
+     */
+    void sendStyle(const vs::SupportFile &builtin
+                   , const boost::filesystem::path &path
+                   , const FileInfo &fileInfo, const Sink::FileInfo &stat
+                   , Sink &sink) const;
+
     std::string absoluteDataset(const std::string &path) const;
     boost::filesystem::path
     absoluteDataset(const boost::filesystem::path &path) const;
@@ -287,8 +480,12 @@ protected:
                                       , bool mustBeReady = true
                                       , bool mandatory = false) const;
 
+    /** Sends support file; plain files are sent gzipped if client accepts
+     *  it (see precompressed), templates are expanded.
+     */
     void supportFile(const vs::SupportFile &support, Sink &sink
-                     , const Sink::FileInfo &fileInfo) const;
+                     , const Sink::FileInfo &fileInfo
+                     , bool acceptGzip) const;
 
     DemRegistry& demRegistry() { return *demRegistry_; }
     const DemRegistry& demRegistry() const { return *demRegistry_; }
@@ -302,8 +499,11 @@ protected:
      */
     void setProvider(std::unique_ptr<Provider> &&provider);
 
+    typedef std::shared_lock<std::shared_timed_mutex> MetadataLock;
+
     /** Updates revision in this resource. Revision is updated only if more
-     *  recent revision is used.
+     *  recent revision is used. Must be called before generator is ready
+     *  (i.e. before any metadata update).
      */
     void updateRevision(unsigned int revision);
 
@@ -314,19 +514,55 @@ private:
     virtual Task generateFile_impl(const FileInfo &fileInfo
                                    , Sink &sink) const = 0;
 
+    virtual bool cacheable_impl() const { return true; }
+
+    /** Defaults to nothing to warm up.
+     */
+    virtual Warmup warmup_impl() const { return {}; }
+
+    /** Adds generator specific components. Defaults to none.
+     */
+    virtual void memory_impl(Memory&) const {}
+
     const GeneratorFinder *generatorFinder_;
     Config config_;
     Properties properties_;
     Resource resource_;
     Resource savedResource_;
+
+    /** Current resource: resource_ or the last published one.
+     */
+    std::atomic<const Resource*> current_;
+
+    /** Resources published by updateMetadata. Never dropped: requests in
+     *  flight hold references to them (e.g. sinks to file class settings).
+     */
+    std::list<Resource> published_;
+    std::atomic<std::uint64_t> metadataTag_;
     bool fresh_;
     bool system_;
     bool changeEnforced_;
     std::atomic<bool> ready_;
     std::atomic<std::uint64_t> readySince_;
+    mutable std::atomic<std::uint64_t> lastAccess_;
     DemRegistry::pointer demRegistry_;
     Generator::pointer replace_;
     std::unique_ptr<Provider> provider_;
+
+    struct Document {
+        std::string plain;
+        std::string gzipped;
+        typedef std::shared_ptr<const Document> pointer;
+        typedef std::map<std::string, pointer> map;
+    };
+
+    mutable std::mutex documentsLock_;
+    mutable Document::map documents_;
+
+    /** Serializes metadata updates; held shared by document serialization
+     *  so no document made from replaced metadata is memoized.
+     */
+    mutable std::shared_timed_mutex metadataLock_;
 };
 
 /** Set of dataset generators.
@@ -337,6 +573,20 @@ public:
         int resourceUpdatePeriod = 100;
         bool purgeRemovedResources = false;
 
+        /** Number of threads preparing generators.
+         */
+        unsigned int prepareWorkers = 5;
+
+        /** Lazy mode: generators are created and prepared on first request
+         *  instead of on resource update.
+         */
+        bool lazy = false;
+
+        /** Lazily loaded generators not accessed for this number of seconds
+         *  are unloaded. 0 means never.
+         */
+        int lazyIdleTimeout = 0;
+
         Config() {}
     };
 
@@ -387,6 +637,20 @@ public:
 
     void listResources(std::ostream &os) const;
 
+    /** Prints memory held by each generator, by component (see
+     *  Generator::memory).
+     */
+    void memoryUsage(std::ostream &os) const;
+
+    /** Writes per-resource memory gauges.
+     */
+    void metrics(metrics::Writer &writer, const std::string &prefix) const;
+
+    /** Converts missing delivery indices of all known resources in bulk (in
+     *  parallel). Returns number of converted indices.
+     */
+    std::size_t convertIndices();
+
     bool has(const Resource::Id &resourceId) const;
 
     bool isReady(const Resource::Id &resourceId) const;
@@ -25,29 +25,162 @@
  */
 
 #include <map>
+#include <set>
 #include <mutex>
+#include <sstream>
+#include <functional>
+
+#include <boost/format.hpp>
+#include <boost/filesystem.hpp>
+
+#include "dbglog/dbglog.hpp"
+
+#include "../support/hash.hpp"
+#include "../support/demfusion.hpp"
 
 #include "demregistry.hpp"
 
+namespace fs = boost::filesystem;
+
+namespace {
+
+/** Maximum number of memoized lookups (per registry content).
+ */
+const std::size_t MaxCachedLookups(1024);
+
+} // namespace
+
 class DemRegistry::Detail {
 public:
-    Detail() {}
+    typedef std::pair<DemDataset::list, bool> Result;
+
+    Detail(const fs::path &fusionRoot)
+        : snapshot_(std::make_shared<Snapshot>()), fusionRoot_(fusionRoot)
+    {}
 
-    std::pair<DemDataset::list, bool>
-    find(const std::string &referenceFrame
-         , const std::vector<std::string> &ids) const
+    Result find(const std::string &referenceFrame
+                , const std::vector<std::string> &ids) const
     {
-        std::unique_lock<std::mutex> lock(mutex_);
+        return find(*snapshot(), referenceFrame, ids);
+    }
+
+    Result find(const std::string &referenceFrame, const std::string &key
+                , const IdParser &parse) const
+    {
+        const auto snapshot(this->snapshot());
+
+        const auto cacheKey(std::make_pair(referenceFrame, key));
+        {
+            std::unique_lock<std::mutex> lock(snapshot->cacheMutex);
+            auto fcache(snapshot->cache.find(cacheKey));
+            if (fcache != snapshot->cache.end()) { return fcache->second; }
+        }
+
+        auto result(find(*snapshot, referenceFrame, parse()));
+
+        std::unique_lock<std::mutex> lock(snapshot->cacheMutex);
+        if (snapshot->cache.size() >= MaxCachedLookups) {
+            // keys come from clients, do not let it grow
+            snapshot->cache.clear();
+        }
+        snapshot->cache.insert({ cacheKey, result });
+        return result;
+    }
+
+    DemDataset::list fuse(const DemDataset::list &datasets) const {
+        if (fusionRoot_.empty() || (datasets.size() < 2)) { return datasets; }
+
+        // mosaic has single geoid grid
+        const auto &geoidGrid(datasets.front().geoidGrid);
+
+        std::ostringstream os;
+        std::vector<std::string> paths;
+        for (const auto &dataset : datasets) {
+            if (dataset.geoidGrid != geoidGrid) { return datasets; }
+            os << dataset.dataset << '|';
+            paths.push_back(dataset.dataset);
+        }
+        const auto key(os.str());
+
+        // mosaic is built under lock, only once per dataset list
+        std::unique_lock<std::mutex> lock(fusionMutex_);
+        auto ffused(fused_.find(key));
+        if (ffused != fused_.end()) { return ffused->second; }
+
+        const auto path(fusionRoot_ / str(boost::format("%016x.vrt")
+                                          % stableHash(key)));
+
+        DemDataset::list result(datasets);
+        try {
+            if (fs::exists(path) || fuseDems(paths, path.string())) {
+                result = { DemDataset(path.string(), geoidGrid) };
+                LOG(info1) << "DEMs <" << key << "> fused into "
+                           << path << ".";
+            }
+        } catch (const std::exception &e) {
+            LOG(warn2) << "Unable to fuse DEMs <" << key << ">: "
+                       << e.what() << "; sampling them one by one.";
+        }
+
+        if (fused_.size() >= MaxCachedLookups) { fused_.clear(); }
+        fused_.insert({ key, result });
+        return result;
+    }
+
+    void add(const Record &record) {
+        modify([&](Map &map)
+        {
+            map.insert(Map::value_type(record.id, record));
+        });
+    }
+
+    void remove(const Id &id) {
+        modify([&](Map &map) { map.erase(id); });
+    }
+
+    Record::list records(const std::string &referenceFrame) const {
+        Record::list records;
 
-        std::pair<DemDataset::list, bool> result;
+        for (const auto &item : snapshot()->map) {
+            if (item.first.referenceFrame == referenceFrame) {
+                records.push_back(item.second);
+            }
+        }
+
+        return records;
+    }
+
+private:
+    typedef std::map<Id, Record> Map;
+
+    /** Immutable registry content along with lookups memoized against it.
+     *  Any change creates new snapshot, i.e. starts with an empty cache.
+     */
+    struct Snapshot {
+        Map map;
+
+        mutable std::mutex cacheMutex;
+        typedef std::map<std::pair<std::string, std::string>, Result> Cache;
+        mutable Cache cache;
+    };
+
+    std::shared_ptr<const Snapshot> snapshot() const {
+        return std::atomic_load(&snapshot_);
+    }
+
+    static Result find(const Snapshot &snapshot
+                       , const std::string &referenceFrame
+                       , const std::vector<std::string> &ids)
+    {
+        Result result;
         DemDataset::list &datasets(result.first);
 
         size_t found(0);
         std::set<std::string> seen;
         for (const auto &id : ids) {
             if (!seen.insert(id).second) { continue; }
-            auto fmap(map_.find({ referenceFrame, id }));
-            if (fmap != map_.end()) {
+            auto fmap(snapshot.map.find({ referenceFrame, id }));
+            if (fmap != snapshot.map.end()) {
                 ++found;
                 datasets.push_back(fmap->second.dataset);
                 LOG(info1)
@@ -63,37 +196,30 @@ public:
         return result;
     }
 
-    void add(const Record &record) {
-        std::unique_lock<std::mutex> lock(mutex_);
-        map_.insert(Map::value_type(record.id, record));
-    }
-
-    void remove(const Id &id) {
+    void modify(const std::function<void(Map&)> &modifier) {
         std::unique_lock<std::mutex> lock(mutex_);
-        map_.erase(id);
+        auto snapshot(std::make_shared<Snapshot>());
+        snapshot->map = std::atomic_load(&snapshot_)->map;
+        modifier(snapshot->map);
+        std::atomic_store(&snapshot_
+                          , std::shared_ptr<const Snapshot>(snapshot));
     }
 
-    Record::list records(const std::string &referenceFrame) const {
-        Record::list records;
-
-        std::unique_lock<std::mutex> lock(mutex_);
-        for (const auto &item : map_) {
-            if (item.first.referenceFrame == referenceFrame) {
-                records.push_back(item.second);
-            }
-        }
+    /** Serializes writers.
+     */
+    std::mutex mutex_;
 
-        return records;
-    }
+    std::shared_ptr<const Snapshot> snapshot_;
 
-private:
-    mutable std::mutex mutex_;
-    typedef std::map<Id, Record> Map;
-    Map map_;
+    /** Fused dataset lists, independent of registry content.
+     */
+    const fs::path fusionRoot_;
+    mutable std::mutex fusionMutex_;
+    mutable std::map<std::string, DemDataset::list> fused_;
 };
 
-DemRegistry::DemRegistry()
-    : detail_(std::make_shared<Detail>())
+DemRegistry::DemRegistry(const boost::filesystem::path &fusionRoot)
+    : detail_(std::make_shared<Detail>(fusionRoot))
 {}
 
 DemRegistry::~DemRegistry() {}
@@ -106,6 +232,18 @@ DemRegistry::find(const std::string &referenceFrame
     return detail().find(referenceFrame, ids);
 }
 
+std::pair<DemDataset::list, bool>
+DemRegistry::find(const std::string &referenceFrame, const std::string &key
+                  , const IdParser &parse) const
+{
+    return detail().find(referenceFrame, key, parse);
+}
+
+DemDataset::list DemRegistry::fuse(const DemDataset::list &datasets) const
+{
+    return detail().fuse(datasets);
+}
+
 void DemRegistry::add(const Record &record)
 {
     return detail().add(record);
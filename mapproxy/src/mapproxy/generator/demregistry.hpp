@@ -30,8 +30,10 @@
 #include <memory>
 #include <string>
 #include <vector>
+#include <functional>
 
 #include <boost/optional.hpp>
+#include <boost/filesystem/path.hpp>
 
 #include "../resource.hpp"
 #include "../support/geo.hpp"
@@ -42,7 +44,11 @@ class DemRegistry {
 public:
     typedef std::shared_ptr<DemRegistry> pointer;
 
-    DemRegistry();
+    /** Fused DEMs (see fuse()) are kept under fusionRoot, empty path
+     *  disables fusion.
+     */
+    DemRegistry(const boost::filesystem::path &fusionRoot
+                = boost::filesystem::path());
     ~DemRegistry();
 
     /** Simplified resource ID.
@@ -85,6 +91,24 @@ public:
     find(const std::string &referenceFrame
          , const std::vector<std::string> &ids) const;
 
+    typedef std::function<std::vector<std::string>()> IdParser;
+
+    /** Memoized find: key (e.g. raw viewspec) identifies list of ids that is
+     *  obtained by calling parse only if key has not been looked up since
+     *  last add/remove.
+     */
+    std::pair<DemDataset::list, bool>
+    find(const std::string &referenceFrame, const std::string &key
+         , const IdParser &parse) const;
+
+    /** Fuses list of datasets (ordered by priority) into single VRT mosaic
+     *  so it can be sampled in one pass. Mosaic is built on first use and
+     *  kept on disk, keyed by the dataset list. Original list is returned
+     *  when there is nothing to fuse, datasets differ in geoid grid or SRS,
+     *  or fusion fails.
+     */
+    DemDataset::list fuse(const DemDataset::list &datasets) const;
+
     /** Registers DEM under given ID.
      */
     void add(const Record &record);
@@ -41,6 +41,12 @@ struct Generator::Factory {
      */
     virtual bool systemInstance() const { return false; }
 
+    /** If true, generator serves delivery index converted from tileset.index
+     *  in its store directory. Missing delivery indices can be converted in
+     *  bulk before generators are created.
+     */
+    virtual bool deliveryIndex() const { return false; }
+
     /** Factory registry support
      */
     typedef std::map<Resource::Generator, pointer> Registry;
@@ -27,6 +27,7 @@
 #include <thread>
 #include <condition_variable>
 #include <sstream>
+#include <fstream>
 #include <deque>
 
 #include <boost/filesystem.hpp>
@@ -45,8 +46,18 @@
 #include "utility/time.hpp"
 #include "utility/raise.hpp"
 
+#include "jsoncpp/json.hpp"
+#include "jsoncpp/io.hpp"
+
+#include "vts-libs/registry/json.hpp"
+
 #include "../error.hpp"
 #include "../generator.hpp"
+#include "../support/masktree.hpp"
+#include "../support/mmapped/tileindex.hpp"
+#include "../support/compression.hpp"
+#include "../support/hash.hpp"
+#include "../support/preparedstate.hpp"
 #include "../definition.hpp"
 #include "./factory.hpp"
 
@@ -59,8 +70,38 @@ namespace {
 
 const std::string ResourceFile("resource.json");
 
+/** Digest of everything updateMetadata may change.
+ */
+std::uint64_t metadataDigest(const Resource &r)
+{
+    std::ostringstream os;
+    os.precision(15);
+    os << r.comment << '|' << definitionHash(r) << '|';
+    for (const auto &credit : r.credits) { os << credit.id << ','; }
+    os << '|';
+    Json::write(os, vr::asJson(r.registry));
+    for (std::size_t i(0); i < FileClassSettings::storageSize; ++i) {
+        const auto fc(static_cast<FileClass>(i));
+        os << '|' << r.fileClassSettings.getMaxAge(fc)
+           << '/' << r.fileClassSettings.getStaleWhileRevalidate(fc);
+    }
+    return stableHash(os.str());
+}
+
 } // namespace
 
+void Arsenal::post(const Continuation &continuation, const Sink &sink)
+{
+    if (poster_) { return poster_(continuation, sink); }
+
+    Sink s(sink);
+    try {
+        continuation(s, *this);
+    } catch (...) {
+        s.error();
+    }
+}
+
 void Generator::registerType(const Resource::Generator &type
                              , const Factory::pointer &factory)
 {
@@ -72,6 +113,21 @@ DefinitionBase::pointer Generator::definition(const Resource::Generator &type)
     return resource::definition(type);
 }
 
+fs::path Generator::storeRoot(const fs::path &root
+                              , const Resource::Id &resourceId)
+{
+    return root / resourceId.referenceFrame / resourceId.group
+        / resourceId.id;
+}
+
+bool Generator::deliveryIndex(const Resource::Generator &type)
+{
+    const auto &registry(Factory::registry());
+    const auto fregistry(registry.find(type));
+    return ((fregistry != registry.end())
+            && fregistry->second->deliveryIndex());
+}
+
 Generator::pointer Generator::create(const Params &params)
 {
     try {
@@ -88,14 +144,15 @@ Generator::Generator(const Params &params, const Properties &properties)
     : generatorFinder_(params.generatorFinder), config_(params.config)
     , properties_(properties)
     , resource_(params.resource), savedResource_(params.resource)
+    , current_(&resource_), metadataTag_(0)
     , fresh_(false), system_(params.system)
     , changeEnforced_(false)
     , ready_(false), readySince_(0)
+    , lastAccess_(utility::usecFromEpoch())
     , demRegistry_(params.demRegistry)
     , replace_(params.replace)
 {
-    config_.root = (config_.root / resource_.id.referenceFrame
-                    / resource_.id.group / resource_.id.id);
+    config_.root = storeRoot(config_.root, resource_.id);
 
     // TODO: handle failed creation
     auto rfile(root() / ResourceFile);
@@ -127,6 +184,7 @@ Generator::Generator(const Params &params, const Properties &properties)
             UTILITY_FALLTHROUGH;
 
         case Changed::no: UTILITY_FALLTHROUGH;
+        case Changed::metadata: UTILITY_FALLTHROUGH;
         case Changed::safely:
             // nothing or something non-destructive changed -> re-save
             save(rfile, resource_);
@@ -161,11 +219,13 @@ Generator::Generator(const Params &params, const Properties &properties)
             }
         }
     }
+
+    metadataTag_ = metadataDigest(resource_);
 }
 
 Changed Generator::changed(const Resource &resource) const
 {
-    switch (auto changed = resource.changed(resource_)) {
+    switch (auto changed = resource.changed(this->resource())) {
     case Changed::yes:
         if (!config().freezes(resource.generator.type)) {
             LOG(warn2)
@@ -201,6 +261,172 @@ void Generator::mapConfig(std::ostream &os, ResourceRoot root)
     vts::saveMapConfig(mc, os);
 }
 
+void Generator::sendDocument(const std::string &name
+                             , const FileInfo &fileInfo
+                             , const Sink::FileInfo &stat, Sink &sink
+                             , const Serializer &serializer) const
+{
+    auto document([&]() -> Document::pointer
+    {
+        std::unique_lock<std::mutex> lock(documentsLock_);
+        auto fdocuments(documents_.find(name));
+        if (fdocuments == documents_.end()) { return {}; }
+        return fdocuments->second;
+    }());
+
+    if (!document) {
+        // serialize outside lock; concurrent first uses may do it twice;
+        // metadata must not change until serialized document is stored
+        MetadataLock mlock(metadataLock_);
+
+        auto doc(std::make_shared<Document>());
+        {
+            std::ostringstream os;
+            serializer(os);
+            doc->plain = os.str();
+        }
+        {
+            std::ostringstream os;
+            {
+                compression::Gzipper gzipper
+                    (os, compression::Target::document);
+                std::ostream &gos(gzipper);
+                gos.write(doc->plain.data(), doc->plain.size());
+            }
+            doc->gzipped = os.str();
+        }
+
+        std::unique_lock<std::mutex> lock(documentsLock_);
+        document = documents_[name] = doc;
+    }
+
+    auto sfi(stat);
+    sfi.addHeader("Vary", "Accept-Encoding");
+    if (fileInfo.acceptGzip) {
+        sfi.addHeader("Content-Encoding", "gzip");
+        sink.content(document->gzipped.data(), document->gzipped.size()
+                     , sfi, document);
+    } else {
+        sink.content(document->plain.data(), document->plain.size()
+                     , sfi, document);
+    }
+}
+
+void Generator::sendStyle(const vs::SupportFile &builtin
+                          , const fs::path &path
+                          , const FileInfo &fileInfo
+                          , const Sink::FileInfo &stat, Sink &sink) const
+{
+    if (path.empty()) {
+        sendDocument("style", fileInfo, stat, sink
+                     , [&](std::ostream &os)
+        {
+            if (builtin.isTemplate) {
+                os << builtin.expand(config_.variables, config_.defaults);
+            } else {
+                os.write(reinterpret_cast<const char*>(builtin.data)
+                         , builtin.size);
+            }
+        });
+        return;
+    }
+
+    boost::system::error_code ec;
+    const auto mtime(fs::last_write_time(path, ec));
+    const auto size(ec ? 0 : fs::file_size(path, ec));
+    if (ec) {
+        LOG(warn2) << "<" << id() << ">: cannot stat style file " << path
+                   << ": <" << ec.message() << ">.";
+        sink.error(utility::makeError<NotFound>("Style file not found."));
+        return;
+    }
+
+    // external file changes without revision change
+    sendDocument(str(boost::format("style@%d:%d") % mtime % size)
+                 , fileInfo, stat, sink, [&](std::ostream &os)
+    {
+        std::ifstream f;
+        f.exceptions(std::ios::badbit | std::ios::failbit);
+        f.open(path.string(), std::ios_base::in | std::ios_base::binary);
+        os << f.rdbuf();
+    });
+}
+
+void Generator::forgetDocuments()
+{
+    std::unique_lock<std::mutex> lock(documentsLock_);
+    documents_.clear();
+}
+
+void Generator::updateMetadata(const Resource &resource)
+{
+    std::unique_lock<std::shared_timed_mutex> mlock(metadataLock_);
+
+    // requests in flight keep reading the current resource
+    published_.push_back(*current_);
+    auto &r(published_.back());
+    r.comment = resource.comment;
+    r.credits = resource.credits;
+    r.registry = resource.registry;
+    r.fileClassSettings = resource.fileClassSettings;
+    // differs in metadata only, never modified afterwards
+    r.definition(resource.definition());
+
+    save(root() / ResourceFile, r);
+    savedResource_ = r;
+
+    metadataTag_ = metadataDigest(r);
+    current_ = &r;
+
+    forgetDocuments();
+
+    LOG(info3) << "<" << id() << ">: metadata updated in place.";
+}
+
+void Generator::Memory::add(const std::string &component
+                            , std::size_t resident, std::size_t virt)
+{
+    auto &usage(components[component]);
+    usage.resident += resident;
+    usage.virt += virt;
+}
+
+void Generator::Memory::add(const std::string &component
+                            , const mmapped::TileIndex &index)
+{
+    // mapped file plus dense lods expanded on the heap
+    const auto dense(index.denseMemory());
+    add(component, index.residentMemory() + dense, index.fileSize() + dense);
+}
+
+void Generator::Memory::add(const std::string &component
+                            , const SharedMaskTree &tree)
+{
+    if (tree.size()) { add(component, tree.size()); }
+}
+
+Generator::Memory::Usage Generator::Memory::total() const
+{
+    Usage total;
+    for (const auto &item : components) { total += item.second; }
+    return total;
+}
+
+Generator::Memory Generator::memory() const
+{
+    Memory memory;
+    {
+        std::unique_lock<std::mutex> lock(documentsLock_);
+        std::size_t size(0);
+        for (const auto &item : documents_) {
+            size += item.second->plain.size() + item.second->gzipped.size();
+        }
+        if (size) { memory.add("documents", size); }
+    }
+    memory_impl(memory);
+    return memory;
+}
+
 namespace {
 
 bool isRemote(const std::string &path)
@@ -297,6 +523,11 @@ bool Generator::updatedSince(std::uint64_t timestamp) const
     return readySince_ > timestamp;
 }
 
+void Generator::touch() const
+{
+    lastAccess_ = utility::usecFromEpoch();
+}
+
 Generator::Task Generator::generateFile(const FileInfo &fileInfo, Sink sink)
     const
 {
@@ -24,7 +24,9 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <map>
 #include <thread>
+#include <algorithm>
 #include <condition_variable>
 #include <sstream>
 #include <deque>
@@ -32,6 +34,7 @@
 #include <boost/filesystem.hpp>
 #include <boost/format.hpp>
 #include <boost/asio.hpp>
+#include <boost/lexical_cast.hpp>
 #include <boost/algorithm/string/predicate.hpp>
 
 #include "dbglog/dbglog.hpp"
@@ -42,10 +45,12 @@
 
 #include "../error.hpp"
 #include "../definition.hpp"
+#include "../support/mmapped/tilesetindex.hpp"
+#include "../support/precompressed.hpp"
 #include "generators.hpp"
 #include "factory.hpp"
 
-//namespace fs = boost::filesystem;
+namespace fs = boost::filesystem;
 //namespace ba = boost::algorithm;
 
 namespace {
@@ -65,8 +70,11 @@ Generators::Detail::Detail(const Generators::Config &config
                            , const ResourceBackend::pointer &resourceBackend)
     : config_(fixUp(config)), resourceBackend_(resourceBackend)
     , arsenal_(), running_(false), updateRequest_(false), lastUpdate_(0)
+    , backendRevision_()
+    , serving_(std::make_shared<GeneratorMap>())
     , ready_(false), preparing_(0)
-    , work_(ios_), demRegistry_(std::make_shared<DemRegistry>())
+    , work_(ios_), demRegistry_(std::make_shared<DemRegistry>
+                                 (config_.root / "dem-fusion"))
 {
     registerSystemGenerators();
 }
@@ -93,8 +101,7 @@ void Generators::Detail::start(Arsenal &arsenal)
     updater_.swap(updater);
 
     arsenal_ = &arsenal;
-    // TODO: make configurable
-    std::size_t count(5);
+    const std::size_t count(std::max(config_.prepareWorkers, 1u));
     // start workers
     for (std::size_t id(1); id <= count; ++id) {
         workers_.emplace_back(&Detail::worker, this, id);
@@ -130,13 +137,22 @@ void Generators::Detail::updater()
     updateRequest_ = false;
     // never update
     lastUpdate_ = 0;
+    backendRevision_ = 0;
 
     while (running_) {
         // default sleep time in seconds
         std::chrono::seconds sleep(config_.resourceUpdatePeriod);
 
         try {
-            update(resourceBackend_->load());
+            // load only what has changed since last update
+            const auto loaded(resourceBackend_->load(backendRevision_));
+            if (loaded.changed) {
+                update(loaded.resources, loaded.unchanged);
+            } else {
+                LOG(info2) << "Resources unchanged.";
+                unloadIdle();
+            }
+            backendRevision_ = loaded.revision;
             lastUpdate_ = utility::usecFromEpoch();
         } catch (Aborted) {
             // pass
@@ -188,17 +204,99 @@ void Generators::Detail::worker(std::size_t id)
     }
 }
 
+struct Generators::Detail::PrepareBatch {
+    Generator::list generators;
+
+    /** Number of not yet prepared dependencies of each generator.
+     */
+    std::vector<int> pending;
+
+    /** Indices of generators depending on each generator.
+     */
+    std::vector<std::vector<std::size_t>> dependents;
+
+    std::mutex mutex;
+};
+
 void Generators::Detail::prepare(const Generator::pointer &generator)
 {
-    ++preparing_;
+    prepare(Generator::list{ generator });
+}
+
+void Generators::Detail::prepare(const Generator::list &generators)
+{
+    if (generators.empty()) { return; }
+
+    auto batch(std::make_shared<PrepareBatch>());
+    batch->generators = generators;
+    batch->pending.assign(generators.size(), 0);
+    batch->dependents.resize(generators.size());
+
+    // dependencies inside this batch
+    {
+        std::map<Resource::Id, std::size_t> index;
+        for (std::size_t i(0), e(generators.size()); i < e; ++i) {
+            index.insert(std::make_pair(generators[i]->id(), i));
+        }
+
+        for (std::size_t i(0), e(generators.size()); i < e; ++i) {
+            for (const auto &id : generators[i]->resource().needsResources()) {
+                const auto findex(index.find(id));
+                if ((findex == index.end()) || (findex->second == i)) {
+                    continue;
+                }
+                ++batch->pending[i];
+                batch->dependents[findex->second].push_back(i);
+            }
+        }
+    }
+
+    // generators not reachable in topological order are in (or depend on) a
+    // dependency cycle; prepare them right away
+    std::vector<std::size_t> ready;
+    {
+        auto pending(batch->pending);
+        std::vector<std::size_t> queue;
+        for (std::size_t i(0), e(pending.size()); i < e; ++i) {
+            if (!pending[i]) { queue.push_back(i); }
+        }
+        ready = queue;
+
+        while (!queue.empty()) {
+            const auto i(queue.back());
+            queue.pop_back();
+            for (const auto d : batch->dependents[i]) {
+                if (!--pending[d]) { queue.push_back(d); }
+            }
+        }
+
+        for (std::size_t i(0), e(pending.size()); i < e; ++i) {
+            if (!pending[i]) { continue; }
+            LOG(warn2)
+                << "Resource <" << generators[i]->id()
+                << "> is part of a dependency cycle; preparing it without "
+                "waiting for its dependencies.";
+            batch->pending[i] = 0;
+            ready.push_back(i);
+        }
+    }
 
+    preparing_ += generators.size();
+    for (const auto i : ready) { prepare(batch, i); }
+}
+
+void Generators::Detail::prepare(const PrepareBatchPointer &batch
+                                 , std::size_t index)
+{
     ios_.post([=]()
     {
+        const auto &generator(batch->generators[index]);
         try {
             generator->prepare(*arsenal_);
             if (auto original = generator->replace()) {
                 replace(original, generator);
             }
+            if (arsenal_->onPrepared) { arsenal_->onPrepared(generator); }
         } catch (const std::exception &e) {
             LOG(warn2)
                 << "Failed to prepare generator for <"
@@ -207,16 +305,168 @@ void Generators::Detail::prepare(const Generator::pointer &generator)
 
             resourceBackend_->error(generator->resource().id, e.what());
 
-            // erease from map (under lock)
-            std::unique_lock<std::mutex> lock(lock_);
-            serving_.erase(generator);
+            // erease from map
+            modify([&](GeneratorMap &serving) { serving.erase(generator); });
         }
+
+        // dependents are started even on failure to report their own errors
+        std::vector<std::size_t> ready;
+        {
+            std::unique_lock<std::mutex> lock(batch->mutex);
+            for (const auto d : batch->dependents[index]) {
+                if (!--batch->pending[d]) { ready.push_back(d); }
+            }
+        }
+        for (const auto d : ready) { prepare(batch, d); }
+
         --preparing_;
     });
 }
 
+Generator::pointer Generators::Detail::create(const Resource &resource
+                                              , const Generator::pointer
+                                              &replace) const
+{
+    Generator::Params params(resource);
+    params.config = config_;
+    params.config.root = config_.root;
+    params.generatorFinder = this;
+    params.demRegistry = demRegistry_;
+    params.replace = replace;
+    return Generator::create(params);
+}
+
+bool Generators::Detail::loadLazy(const Resource::Id &resourceId) const
+{
+    if (!config_.lazy) { return false; }
+
+    Resource::list toLoad;
+    {
+        std::unique_lock<std::mutex> lock(lazyLock_);
+        if (loading_.count(resourceId)) { return true; }
+        if (!lazy_.count(resourceId)) { return false; }
+
+        // claim resource and lazily held resources it needs, dependencies
+        // first
+        std::function<void(const Resource::Id&)> claim
+            ([&](const Resource::Id &id)
+        {
+            auto flazy(lazy_.find(id));
+            if (flazy == lazy_.end()) { return; }
+            const auto resource(flazy->second);
+            lazy_.erase(flazy);
+            loading_.insert(id);
+
+            for (const auto &needed : resource.needsResources()) {
+                claim(needed);
+            }
+            toLoad.push_back(resource);
+        });
+        claim(resourceId);
+    }
+
+    auto self(const_cast<Detail*>(this));
+    ios_.post([self, toLoad]() { self->load(toLoad); });
+    return true;
+}
+
+void Generators::Detail::load(const Resource::list &resources)
+{
+    convertIndices(resources);
+
+    Generator::list generators;
+    for (const auto &resource : resources) {
+        LOG(info3) << "Loading resource <" << resource.id << "> on demand.";
+        try {
+            auto generator(create(resource));
+
+            // register right away, dependents may look it up in their ctor;
+            // membership is rechecked under lazy lock to not race with
+            // update() that might have removed the resource meanwhile
+            std::unique_lock<std::mutex> lock(lazyLock_);
+            if (!known_.count(resource.id)) {
+                LOG(info3) << "Resource <" << resource.id
+                           << "> removed while being loaded, dropping.";
+                continue;
+            }
+            modify([&](GeneratorMap &serving) { serving.insert(generator); });
+            generators.push_back(generator);
+        } catch (const std::exception &e) {
+            LOG(err2) << "Failed to create generator for resource <"
+                      << resource.id << ">: <" << e.what() << ">.";
+            resourceBackend_->error(resource.id, e.what());
+        }
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(lazyLock_);
+        for (const auto &resource : resources) {
+            loading_.erase(resource.id);
+        }
+        for (const auto &generator : generators) {
+            lazyLoaded_.insert(generator->id());
+        }
+    }
+
+    Generator::list toPrepare;
+    for (const auto &generator : generators) {
+        if (!generator->ready()) { toPrepare.push_back(generator); }
+    }
+    prepare(toPrepare);
+}
+
+void Generators::Detail::unloadIdle()
+{
+    if (!config_.lazy || (config_.lazyIdleTimeout <= 0)) { return; }
+
+    const auto limit(utility::usecFromEpoch()
+                     - std::uint64_t(config_.lazyIdleTimeout) * 1000000);
+
+    Generator::list idle;
+    {
+        std::unique_lock<std::mutex> lock(lazyLock_);
+        const auto serving(this->serving());
+        auto &idx(serving->get<ResourceIdIdx>());
+        for (auto ilazyLoaded(lazyLoaded_.begin());
+             ilazyLoaded != lazyLoaded_.end(); )
+        {
+            const auto fserving(idx.find(*ilazyLoaded));
+            if (fserving == idx.end()) {
+                // removed or replaced in the meantime
+                ilazyLoaded = lazyLoaded_.erase(ilazyLoaded);
+                continue;
+            }
+
+            const auto &generator(*fserving);
+            if (!generator->ready() || (generator->lastAccess() >= limit)) {
+                ++ilazyLoaded;
+                continue;
+            }
+
+            // back to lazily held resources
+            idle.push_back(generator);
+            lazy_[generator->id()] = generator->resource();
+            ilazyLoaded = lazyLoaded_.erase(ilazyLoaded);
+        }
+    }
+
+    if (idle.empty()) { return; }
+
+    modify([&](GeneratorMap &serving)
+    {
+        for (const auto &generator : idle) { serving.erase(generator); }
+    });
+
+    for (const auto &generator : idle) {
+        LOG(info3) << "Unloaded resource <" << generator->id()
+                   << ">, idle for more than " << config_.lazyIdleTimeout
+                   << " s.";
+    }
+}
+
 void Generators::Detail::registerSystemGenerators()
 {
+    Generator::list generators;
     for (const auto &ritem : Generator::Factory::registry()) {
         const auto &resourceGenerator(ritem.first);
         const auto &factory(ritem.second);
@@ -264,17 +514,22 @@ void Generators::Detail::registerSystemGenerators()
             params.system = true;
 
             // create generator
-            auto g(factory->create(params));
+            generators.push_back(factory->create(params));
+        }
+    }
 
-            // register
-            serving_.insert(g);
+    // register
+    modify([&](GeneratorMap &serving)
+    {
+        serving.insert(generators.begin(), generators.end());
+    });
 
-            // and prepare if not ready
-            if (!g->ready()) {
-                prepare(g);
-            }
-        }
+    // and prepare if not ready
+    Generator::list toPrepare;
+    for (const auto &g : generators) {
+        if (!g->ready()) { toPrepare.push_back(g); }
     }
+    prepare(toPrepare);
 }
 
 Generators::Generators(const Config &config
@@ -310,40 +565,67 @@ Generators::generator(Resource::Generator::Type generatorType
     return detail().generator(generatorType, resourceId);
 }
 
+void Generators::Detail::modify
+(const std::function<void(GeneratorMap&)> &modifier)
+{
+    std::unique_lock<std::mutex> lock(lock_);
+    auto serving(std::make_shared<GeneratorMap>(*std::atomic_load(&serving_)));
+    modifier(*serving);
+    std::atomic_store(&serving_, Snapshot(std::move(serving)));
+}
+
 void Generators::Detail::replace(const Generator::pointer &original
                                  , const Generator::pointer &replacement)
 {
-    std::unique_lock<std::mutex> lock(lock_);
-    // find original in the serving set
-    auto ioriginal(serving_.find(original));
-    // and replace
-    serving_.replace(ioriginal, replacement);
+    modify([&](GeneratorMap &serving)
+    {
+        // find original in the serving set
+        auto ioriginal(serving.find(original));
+        // and replace (unless removed in the meantime)
+        if (ioriginal != serving.end()) {
+            serving.replace(ioriginal, replacement);
+        }
+    });
 }
 
-void Generators::Detail::update(const Resource::map &resources)
+void Generators::Detail::update(const Resource::map &resources
+                                , const std::set<Resource::Id> &unchanged)
 {
     LOG(info2) << "Updating resources.";
 
+    // lazy mode: make idle generators lazily held again
+    unloadIdle();
+
+    // diff against a consistent snapshot
+    const auto serving(this->serving());
+
     auto iresources(resources.begin()), eresources(resources.end());
-    auto &idx(serving_.get<ResourceIdIdx>());
+    auto &idx(serving->get<ResourceIdIdx>());
     auto iserving(idx.begin()), eserving(idx.end());
 
     Generator::list toAdd;
     Generator::list toRemove;
     Generator::list toReplace;
+    std::size_t metadataUpdated(0);
+
+    // lazy mode: resources known but not loaded
+    Resource::map lazy;
 
     auto add([&](const Resource &res)
     {
         if (!running_) {
             throw Aborted{};
         }
+
+        if (config_.lazy) {
+            // just remember, created on first request
+            std::unique_lock<std::mutex> lock(lazyLock_);
+            if (!loading_.count(res.id)) { lazy.insert({ res.id, res }); }
+            return;
+        }
+
         try {
-            Generator::Params params(res);
-            params.config = config_;
-            params.config.root = config_.root;
-            params.generatorFinder = this;
-            params.demRegistry = demRegistry_;
-            toAdd.push_back(Generator::create(params));
+            toAdd.push_back(create(res));
         } catch (const std::exception &e) {
             LOG(err2) << "Failed to create generator for resource <"
                       << iresources->first << ">: <" << e.what() << ">.";
@@ -356,25 +638,28 @@ void Generators::Detail::update(const Resource::map &resources)
             throw Aborted{};
         }
         try {
-            Generator::Params params(res);
-            params.config = config_;
-            params.config.root = config_.root;
-            params.generatorFinder = this;
-            params.demRegistry = demRegistry_;
-            params.replace = original;
-            toReplace.push_back(Generator::create(params));
+            toReplace.push_back(create(res, original));
         } catch (const std::exception &e) {
             LOG(err2) << "Failed to re-create generator for resource <"
                       << iresources->first << ">: <" << e.what() << ">.";
         }
     });
 
+    // convert missing delivery indices of new resources in bulk, generators
+    // would do it one by one in their constructors
+    if (!config_.lazy) {
+        Resource::list fresh;
+        for (const auto &item : resources) {
+            if (!idx.count(item.first)) { fresh.push_back(item.second); }
+        }
+        convertIndices(fresh);
+    }
+
     // process common stuff
     while ((iresources != eresources) && (iserving != eserving)) {
-        auto resource(iresources->second);
         if (iresources->first < (*iserving)->id()) {
             // new resource
-            add(resource);
+            add(iresources->second);
             ++iresources;
         } else if ((*iserving)->id() < iresources->first) {
             // removed resource
@@ -382,8 +667,13 @@ void Generators::Detail::update(const Resource::map &resources)
                 toRemove.push_back(*iserving);
             }
             ++iserving;
+        } else if (unchanged.count(iresources->first)) {
+            // backend knows nothing has changed here
+            ++iresources;
+            ++iserving;
         } else {
             // existing resource
+            auto resource(iresources->second);
             resource.revision = std::max((*iserving)->resource().revision,
                                          resource.revision);
 
@@ -399,6 +689,17 @@ void Generators::Detail::update(const Resource::map &resources)
                 }
                 break;
 
+            case Changed::metadata:
+                // presentation only, keep prepared generator; generator
+                // still being prepared reads its resource -> replace
+                if ((*iserving)->ready()) {
+                    (*iserving)->updateMetadata(resource);
+                    ++metadataUpdated;
+                } else {
+                    replace(resource, *iserving);
+                }
+                break;
+
             case Changed::safely:
             case Changed::withRevisionBump:
                 // here comes the fun
@@ -423,33 +724,50 @@ void Generators::Detail::update(const Resource::map &resources)
         }
     }
 
-    // remove stuff
-    for (const auto &generator : toRemove) {
-        {
-            std::unique_lock<std::mutex> lock(lock_);
-            if (config_.purgeRemovedResources) {
-                generator->purge();
+    if (config_.lazy) {
+        std::unique_lock<std::mutex> lock(lazyLock_);
+        lazy_.swap(lazy);
+
+        known_.clear();
+        for (const auto &item : resources) { known_.insert(item.first); }
+
+        // on-demand loads registered after our snapshot was taken; drop
+        // those whose resource is gone (load() sees new known_ from now on)
+        for (const auto &generator : *this->serving()) {
+            if (generator->system() || idx.count(generator->id())
+                || resources.count(generator->id()))
+            {
+                continue;
             }
-            serving_.erase(generator);
+            toRemove.push_back(generator);
         }
     }
 
-    // add generators; not prepared yet to make them available to the others
-    // when prepared
-    for (const auto &generator : toAdd) {
-        std::unique_lock<std::mutex> lock(lock_);
-        serving_.insert(generator);
+    // remove stuff
+    if (config_.purgeRemovedResources) {
+        for (const auto &generator : toRemove) { generator->purge(); }
+    }
+
+    // publish removals and additions in one go; added generators are not
+    // prepared yet to make them available to the others when prepared
+    if (!toRemove.empty() || !toAdd.empty()) {
+        modify([&](GeneratorMap &set)
+        {
+            for (const auto &generator : toRemove) { set.erase(generator); }
+            set.insert(toAdd.begin(), toAdd.end());
+        });
     }
 
     // prepare generators if not ready
+    Generator::list toPrepare;
     for (const auto &generator : toAdd) {
-        if (!generator->ready()) { prepare(generator); }
+        if (!generator->ready()) { toPrepare.push_back(generator); }
     }
 
     // replace stuff (prepare)
     for (const auto &generator : toReplace) {
         if (!generator->ready()) {
-            prepare(generator);
+            toPrepare.push_back(generator);
         } else {
             this->replace(generator->replace(), generator);
 
@@ -460,6 +778,9 @@ void Generators::Detail::update(const Resource::map &resources)
                 << generator->resource().revision << ".";
     }
 
+    // all at once, in dependency order
+    prepare(toPrepare);
+
     LOG(info4) << "Resources updated.";
     if (!ready_) {
         ready_ = true;
@@ -470,6 +791,17 @@ void Generators::Detail::update(const Resource::map &resources)
     while (preparing_ && running_) {
         std::this_thread::sleep_for(std::chrono::milliseconds(100));
     }
+
+    if (toAdd.empty() && toRemove.empty() && toReplace.empty()
+        && !metadataUpdated)
+    {
+        return;
+    }
+
+    // documents may refer to other resources (introspection); start over
+    for (const auto &generator : *this->serving()) {
+        generator->forgetDocuments();
+    }
 }
 
 Generator::list
@@ -481,8 +813,8 @@ Generators::Detail::referenceFrame(const std::string &referenceFrame)
     Generator::list out;
 
     // use only ready generators that handle datasets for given reference frame
-    std::unique_lock<std::mutex> lock(lock_);
-    auto &idx(serving_.get<ReferenceFrameIdx>());
+    const auto serving(this->serving());
+    auto &idx(serving->get<ReferenceFrameIdx>());
     for (auto range(idx.equal_range(referenceFrame));
          range.first != range.second; ++range.first)
     {
@@ -497,22 +829,33 @@ Generators::Detail::referenceFrame(const std::string &referenceFrame)
 Generator::pointer
 Generators::Detail::generator(Resource::Generator::Type generatorType
                               , const Resource::Id &resourceId
-                              , bool noReadyCheck)
+                              , bool noReadyCheck
+                              , bool lazyUnavailable)
     const
 {
     if (!noReadyCheck) { checkReady(); }
 
-    // find generator (under lock)
+    // find generator in current snapshot
     auto generator([&]() -> Generator::pointer
     {
-        std::unique_lock<std::mutex> lock(lock_);
-        auto &idx(serving_.get<ResourceIdIdx>());
+        const auto serving(this->serving());
+        auto &idx(serving->get<ResourceIdIdx>());
         auto fserving(idx.find(resourceId));
         if (fserving == idx.end()) { return {}; }
         return *fserving;
     }());
 
-    if (!generator) { return generator; }
+    if (!generator) {
+        // lazy mode: load on demand
+        if (loadLazy(resourceId) && lazyUnavailable) {
+            utility::raise<Unavailable>
+                ("Resource <%s> is being loaded, try again later."
+                 , resourceId);
+        }
+        return generator;
+    }
+
+    if (config_.lazy) { generator->touch(); }
 
     const auto &resource(generator->resource());
 
@@ -529,7 +872,8 @@ Generators::Detail::findGenerator_impl(Resource::Generator::Type generatorType
                                        , const Resource::Id &resourceId
                                        , bool mustBeReady) const
 {
-    auto g(generator(generatorType, resourceId, !mustBeReady));
+    // lazily held resource is loaded in the background, not ready for now
+    auto g(generator(generatorType, resourceId, !mustBeReady, false));
     if (!g) { return {}; }
     if (mustBeReady && !g->ready()) { return {}; }
     return g;
@@ -548,9 +892,8 @@ Generators::Detail::listGroups(const std::string &referenceFrame
 
     std::vector<std::string> out;
     {
-        std::unique_lock<std::mutex> lock(lock_);
-
-        auto &idx(serving_.get<TypeIdx>());
+        const auto serving(this->serving());
+        auto &idx(serving->get<TypeIdx>());
         std::string prev;
         for (auto range(idx.equal_range(Keys::TypeKey(referenceFrame, type)));
              range.first != range.second; ++range.first)
@@ -576,8 +919,8 @@ Generators::Detail::listIds(const std::string &referenceFrame
 
     std::vector<std::string> out;
     {
-        std::unique_lock<std::mutex> lock(lock_);
-        auto &idx(serving_.get<GroupIdx>());
+        const auto serving(this->serving());
+        auto &idx(serving->get<GroupIdx>());
         for (auto range(idx.equal_range
                         (Keys::GroupKey(referenceFrame, type, group)));
              range.first != range.second; ++range.first)
@@ -605,10 +948,11 @@ Generators::listIds(const std::string &referenceFrame
 }
 
 void Generator::supportFile(const vs::SupportFile &support, Sink &sink
-                            , const Sink::FileInfo &fileInfo) const
+                            , const Sink::FileInfo &fileInfo
+                            , bool acceptGzip) const
 {
     if (!support.isTemplate) {
-        sink.content(support.data, support.size, fileInfo, false);
+        precompressed::send(sink, support, fileInfo, acceptGzip);
         return;
     }
 
@@ -647,10 +991,14 @@ bool Generators::updatedSince(std::uint64_t timestamp) const
 
 bool Generators::Detail::has(const Resource::Id &resourceId) const
 {
-    std::unique_lock<std::mutex> lock(lock_);
-    auto &idx(serving_.get<ResourceIdIdx>());
+    const auto serving(this->serving());
+    auto &idx(serving->get<ResourceIdIdx>());
     auto fserving(idx.find(resourceId));
-    return (fserving != idx.end());
+    if (fserving != idx.end()) { return true; }
+
+    if (!config_.lazy) { return false; }
+    std::unique_lock<std::mutex> lock(lazyLock_);
+    return lazy_.count(resourceId) || loading_.count(resourceId);
 }
 
 bool Generators::has(const Resource::Id &resourceId) const
@@ -660,8 +1008,8 @@ bool Generators::has(const Resource::Id &resourceId) const
 
 bool Generators::Detail::isReady(const Resource::Id &resourceId) const
 {
-    std::unique_lock<std::mutex> lock(lock_);
-    auto &idx(serving_.get<ResourceIdIdx>());
+    const auto serving(this->serving());
+    auto &idx(serving->get<ResourceIdIdx>());
     auto fserving(idx.find(resourceId));
     if (fserving == idx.end()) { return false; }
     return (*fserving)->ready();
@@ -676,8 +1024,8 @@ std::string Generators::Detail::url(const Resource::Id &resourceId
                                     , GeneratorInterface::Interface iface)
     const
 {
-    std::unique_lock<std::mutex> lock(lock_);
-    auto &idx(serving_.get<ResourceIdIdx>());
+    const auto serving(this->serving());
+    auto &idx(serving->get<ResourceIdIdx>());
     auto fserving(idx.find(resourceId));
     if (fserving == idx.end()) {
         LOGTHROW(err1, UnknownGenerator)
@@ -696,8 +1044,8 @@ bool Generators::Detail::updatedSince(const Resource::Id &resourceId
                                       , std::uint64_t timestamp
                                       , bool nothrow) const
 {
-    std::unique_lock<std::mutex> lock(lock_);
-    auto &idx(serving_.get<ResourceIdIdx>());
+    const auto serving(this->serving());
+    auto &idx(serving->get<ResourceIdIdx>());
     auto fserving(idx.find(resourceId));
     if (fserving == idx.end()) {
         if (nothrow) { return false; }
@@ -724,15 +1072,7 @@ void Generator::status(std::ostream &os) const
 void Generators::Detail::listResources(std::ostream &os) const
 {
 
-    Generator::list generators;
-    {
-        std::unique_lock<std::mutex> lock(lock_);
-        for (const auto &generator : serving_) {
-            generators.push_back(generator);
-        }
-    }
-
-    for (const auto &generator : generators) {
+    for (const auto &generator : *serving()) {
         generator->status(os);
     }
 }
@@ -741,3 +1081,114 @@ void Generators::listResources(std::ostream &os) const
 {
     detail().listResources(os);
 }
+
+namespace {
+
+std::string resourceLabel(const Generator &generator)
+{
+    const auto &id(generator.id());
+    return id.referenceFrame + "/" + id.group + "/" + id.id;
+}
+
+} // namespace
+
+void Generators::Detail::memoryUsage(std::ostream &os) const
+{
+    for (const auto &generator : *serving()) {
+        const auto memory(generator->memory());
+        const auto p("memory." + resourceLabel(*generator) + '.'
+                     + boost::lexical_cast<std::string>(generator->type())
+                     + '.');
+        const auto total(memory.total());
+        os << p << "resident=" << total.resident << '\n'
+           << p << "virtual=" << total.virt << '\n';
+        for (const auto &item : memory.components) {
+            os << p << item.first << ".resident=" << item.second.resident
+               << '\n'
+               << p << item.first << ".virtual=" << item.second.virt
+               << '\n';
+        }
+    }
+}
+
+void Generators::memoryUsage(std::ostream &os) const
+{
+    detail().memoryUsage(os);
+}
+
+void Generators::Detail::metrics(metrics::Writer &writer
+                                 , const std::string &prefix) const
+{
+    // families are built at scrape time only
+    metrics::Family<metrics::Gauge>
+        resident(prefix + "resident_bytes"
+                 , "Memory of resource's generator resident in RAM.")
+        , virt(prefix + "virtual_bytes"
+               , "Address space of resource's generator, mapped files "
+               "included.");
+
+    for (const auto &generator : *serving()) {
+        const auto memory(generator->memory());
+        for (const auto &item : memory.components) {
+            const metrics::Labels labels
+                { { "resource", resourceLabel(*generator) }
+                , { "generator", boost::lexical_cast<std::string>
+                    (generator->type()) }
+                , { "component", item.first } };
+            resident(labels).set(item.second.resident);
+            virt(labels).set(item.second.virt);
+        }
+    }
+
+    writer.write(resident);
+    writer.write(virt);
+}
+
+void Generators::metrics(metrics::Writer &writer
+                         , const std::string &prefix) const
+{
+    detail().metrics(writer, prefix);
+}
+
+std::size_t Generators::Detail::convertIndices(const Resource::list &resources)
+    const
+{
+    std::vector<mmapped::DeliveryIndexJob> jobs;
+    for (const auto &resource : resources) {
+        if (!Generator::deliveryIndex(resource.generator)) { continue; }
+
+        const auto root(Generator::storeRoot(config_.root, resource.id));
+        const auto tilesetIndexPath(root / "tileset.index");
+        const auto deliveryIndexPath(root / "delivery.index");
+        if (!fs::exists(tilesetIndexPath) || fs::exists(deliveryIndexPath)) {
+            continue;
+        }
+
+        jobs.push_back({ resource.referenceFrame->metaBinaryOrder
+                         , tilesetIndexPath, deliveryIndexPath });
+    }
+
+    return mmapped::convertDeliveryIndices(jobs, config_.prepareWorkers);
+}
+
+std::size_t Generators::Detail::convertIndices() const
+{
+    Resource::list resources;
+    {
+        const auto serving(this->serving());
+        for (const auto &generator : *serving) {
+            resources.push_back(generator->resource());
+        }
+    }
+    {
+        std::unique_lock<std::mutex> lock(lazyLock_);
+        for (const auto &item : lazy_) { resources.push_back(item.second); }
+    }
+
+    return convertIndices(resources);
+}
+
+std::size_t Generators::convertIndices()
+{
+    return detail().convertIndices();
+}
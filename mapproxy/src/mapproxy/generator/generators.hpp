@@ -27,6 +27,10 @@
 #ifndef mapproxy_generator_generators_hpp_included_
 #define mapproxy_generator_generators_hpp_included_
 
+#include <set>
+#include <memory>
+#include <functional>
+
 #include <boost/multi_index_container.hpp>
 #include <boost/multi_index/ordered_index.hpp>
 #include <boost/multi_index/identity.hpp>
@@ -102,7 +106,8 @@ public:
 
     Generator::pointer generator(Resource::Generator::Type generatorType
                                  , const Resource::Id &resourceId
-                                 , bool noReadyCheck = false) const;
+                                 , bool noReadyCheck = false
+                                 , bool lazyUnavailable = true) const;
 
     Generator::list referenceFrame(const std::string &referenceFrame) const;
 
@@ -127,6 +132,18 @@ public:
 
     void listResources(std::ostream &os) const;
 
+    void memoryUsage(std::ostream &os) const;
+
+    void metrics(metrics::Writer &writer, const std::string &prefix) const;
+
+    /** Converts missing delivery indices of all known resources.
+     */
+    std::size_t convertIndices() const;
+
+    /** Converts missing delivery indices of given resources in bulk.
+     */
+    std::size_t convertIndices(const Resource::list &resources) const;
+
     void replace(const Generator::pointer &original
                  , const Generator::pointer &replacement);
 
@@ -143,12 +160,52 @@ public:
 private:
     void registerSystemGenerators();
 
-    void update(const Resource::map &resources);
+    /** Diffs served generators against given resources. Resources listed
+     *  in unchanged are known to be unchanged since last update and are not
+     *  diffed.
+     */
+    void update(const Resource::map &resources
+                , const std::set<Resource::Id> &unchanged
+                = std::set<Resource::Id>());
 
     void updater();
     void worker(std::size_t id);
     void prepare(const Generator::pointer &generator);
 
+    /** Prepares all given generators. Generator is prepared only after all
+     *  generators from the same list it needs (Resource::needsResources) are
+     *  prepared; independent ones are prepared in parallel.
+     */
+    void prepare(const Generator::list &generators);
+
+    struct PrepareBatch;
+    typedef std::shared_ptr<PrepareBatch> PrepareBatchPointer;
+
+    /** Posts generator at given index in batch to prepare workers.
+     */
+    void prepare(const PrepareBatchPointer &batch, std::size_t index);
+
+    /** Creates generator for given resource.
+     */
+    Generator::pointer create(const Resource &resource
+                              , const Generator::pointer &replace = {})
+        const;
+
+    /** Lazy mode: claims lazily held resource (along with lazily held
+     *  resources it needs) and loads it in the background. Returns false if
+     *  there is no such resource.
+     */
+    bool loadLazy(const Resource::Id &resourceId) const;
+
+    /** Lazy mode: creates, registers and prepares generators for given
+     *  resources (dependencies first).
+     */
+    void load(const Resource::list &resources);
+
+    /** Lazy mode: unregisters lazily loaded generators idle for too long.
+     */
+    void unloadIdle();
+
     virtual Generator::pointer
     findGenerator_impl(Resource::Generator::Type generatorType
                        , const Resource::Id &resourceId
@@ -163,6 +220,10 @@ private:
     std::atomic<bool> running_;
     std::atomic<bool> updateRequest_;
     std::atomic<std::uint64_t> lastUpdate_;
+
+    /** Resource backend revision of last successful update.
+     */
+    ResourceBackend::Revision backendRevision_;
     std::mutex updaterLock_;
     std::condition_variable updaterCond_;
 
@@ -203,17 +264,54 @@ private:
 
         > GeneratorMap;
 
+    /** Immutable snapshot of the serving set.
+     */
+    typedef std::shared_ptr<const GeneratorMap> Snapshot;
 
+    /** Returns current serving set. Readers never wait for modifications.
+     */
+    Snapshot serving() const { return std::atomic_load(&serving_); }
+
+    /** Applies modifier to a copy of the serving set and publishes the
+     *  result. Modifications are serialized.
+     */
+    void modify(const std::function<void(GeneratorMap&)> &modifier);
 
     // internals
-    mutable std::mutex lock_;
-    GeneratorMap serving_;
+    /** Serializes modifications of the serving set.
+     */
+    std::mutex lock_;
+
+    /** Serving set, replaced as a whole (RCU style); accessed only via
+     *  std::atomic_load/std::atomic_store.
+     */
+    Snapshot serving_;
 
     std::atomic<bool> ready_;
     std::atomic<int> preparing_;
 
+    // lazy mode
+    mutable std::mutex lazyLock_;
+
+    /** Resources known but not loaded yet.
+     */
+    mutable Resource::map lazy_;
+
+    /** Resources being loaded.
+     */
+    mutable std::set<Resource::Id> loading_;
+
+    /** Lazily loaded resources, candidates for unloading.
+     */
+    std::set<Resource::Id> lazyLoaded_;
+
+    /** Resources in the latest resource map. On-demand load completing after
+     *  its resource has been removed must not register it.
+     */
+    std::set<Resource::Id> known_;
+
     // prepare stuff
-    asio::io_service ios_;
+    mutable asio::io_service ios_;
     asio::io_service::work work_;
     std::vector<std::thread> workers_;
 
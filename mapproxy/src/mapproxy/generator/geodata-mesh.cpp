@@ -48,6 +48,7 @@
 
 #include "../support/revision.hpp"
 #include "../support/geo.hpp"
+#include "../support/outbuffer.hpp"
 
 #include "geodata-mesh.hpp"
 #include "factory.hpp"
@@ -175,7 +176,10 @@ GeodataMesh::GeodataMesh(const Params &params)
     try {
         metadata_ = loadMetadata(root() / "metadata.json");
         if (fs::file_size(dataPath_) == metadata_.fileSize) {
-            // valid file
+            // valid file; stores prepared by older versions have no
+            // gzipped copy
+            StoreFile::ensureGzipped(dataPath_);
+            output_ = StoreFile(dataPath_);
             makeReady();
             return;
         }
@@ -351,7 +355,7 @@ void GeodataMesh::prepare_impl(Arsenal&)
     }
 
     {
-        utility::ofstreambuf f(dataPath_.string());
+        OutputBuffer f;
         f.precision(15);
 
         switch (definition_.format) {
@@ -374,7 +378,9 @@ void GeodataMesh::prepare_impl(Arsenal&)
                 << definition_.format << ">.";
         }
 
-        f.close();
+        // store output and its gzipped copy
+        StoreFile::write(dataPath_, f.data(), f.size());
+        output_ = StoreFile(dataPath_);
     }
 
     metadata_.fileSize = fs::file_size(dataPath_);
@@ -406,6 +412,9 @@ vr::FreeLayer GeodataMesh::freeLayer(ResourceRoot root) const
 
 vts::MapConfig GeodataMesh::mapConfig_impl(ResourceRoot root) const
 {
+    // metadata may change, see Generator::updateMetadata
+    const auto &introspection
+        (resource().definition<Definition>().introspection);
     const auto &res(resource());
 
     vts::MapConfig mapConfig;
@@ -421,10 +430,10 @@ vts::MapConfig GeodataMesh::mapConfig_impl(ResourceRoot root) const
     // add free layer into view
     mapConfig.view.freeLayers[res.id.fullId()];
 
-    if (definition_.introspection.surface) {
+    if (introspection.surface) {
         if (auto other = otherGenerator
             (Resource::Generator::Type::surface
-             , addReferenceFrame(*definition_.introspection.surface
+             , addReferenceFrame(*introspection.surface
                                  , referenceFrameId())))
         {
             mapConfig.merge(other->mapConfig
@@ -433,9 +442,9 @@ vts::MapConfig GeodataMesh::mapConfig_impl(ResourceRoot root) const
     }
 
     // override position
-    if (definition_.introspection.position) {
+    if (introspection.position) {
         // user supplied
-        mapConfig.position = *definition_.introspection.position;
+        mapConfig.position = *introspection.position;
     } else {
         // calculated
         mapConfig.position = metadata_.position;
@@ -443,8 +452,8 @@ vts::MapConfig GeodataMesh::mapConfig_impl(ResourceRoot root) const
 
     // browser options (must be Json::Value!); overrides browser options from
     // surface's introspection
-    if (!definition_.introspection.browserOptions.empty()) {
-        mapConfig.browserOptions = definition_.introspection.browserOptions;
+    if (!introspection.browserOptions.empty()) {
+        mapConfig.browserOptions = introspection.browserOptions;
     }
 
     // done
@@ -465,21 +474,26 @@ Generator::Task GeodataMesh::generateFile_impl(const FileInfo &fileInfo
         break;
 
     case GeodataFileInfo::Type::config: {
-        std::ostringstream os;
-        mapConfig(os, ResourceRoot::none);
-        sink.content(os.str(), fi.sinkFileInfo());
+        sendDocument("mapConfig", fi.fileInfo, fi.sinkFileInfo(), sink
+                     , [this](std::ostream &os)
+        {
+            mapConfig(os, ResourceRoot::none);
+        });
         break;
     }
 
     case GeodataFileInfo::Type::definition: {
-        std::ostringstream os;
-        vr::saveFreeLayer(os, freeLayer(ResourceRoot::none));
-        sink.content(os.str(), fi.sinkFileInfo());
+        sendDocument("freelayer", fi.fileInfo, fi.sinkFileInfo(), sink
+                     , [this](std::ostream &os)
+        {
+            vr::saveFreeLayer(os, freeLayer(ResourceRoot::none));
+        });
         break;
     }
 
     case GeodataFileInfo::Type::support:
-        supportFile(*fi.support, sink, fi.sinkFileInfo());
+        supportFile(*fi.support, sink, fi.sinkFileInfo()
+                    , fi.fileInfo.acceptGzip);
         break;
 
     case GeodataFileInfo::Type::registry:
@@ -489,15 +503,8 @@ Generator::Task GeodataMesh::generateFile_impl(const FileInfo &fileInfo
         break;
 
     case GeodataFileInfo::Type::style:
-        if (stylePath_.empty()) {
-            // return internal file
-            supportFile(files::defaultMeshStyle, sink, fi.sinkFileInfo());
-        } else {
-            // return external file
-            sink.content(vs::fileIStream
-                         (files::defaultMeshStyle.contentType, stylePath_)
-                         , FileClass::config);
-        }
+        sendStyle(files::defaultMeshStyle, stylePath_, fi.fileInfo
+                  , fi.sinkFileInfo(), sink);
         break;
 
     default:
@@ -511,8 +518,7 @@ Generator::Task GeodataMesh::generateFile_impl(const FileInfo &fileInfo
 void GeodataMesh::generateGeodata(Sink &sink, const GeodataFileInfo &fi
                                   , Arsenal &) const
 {
-    sink.content(vs::fileIStream(fi.sinkFileInfo().contentType.c_str()
-                                 , dataPath_), FileClass::data);
+    output_.send(sink, fi.sinkFileInfo(), fi.fileInfo.acceptGzip);
 }
 
 } // namespace generator
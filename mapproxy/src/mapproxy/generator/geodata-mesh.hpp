@@ -27,6 +27,8 @@
 #ifndef mapproxy_generator_geodata_mesh_hpp_included_
 #define mapproxy_generator_geodata_mesh_hpp_included_
 
+#include "../support/storefile.hpp"
+
 #include "../heightfunction.hpp"
 #include "../generator.hpp"
 #include "../definition.hpp"
@@ -82,6 +84,10 @@ private:
      */
     boost::filesystem::path dataPath_;
 
+    /** Cached output data and their gzipped copy, mapped into memory.
+     */
+    StoreFile output_;
+
     /** Metadata of processed output.
      */
     Metadata metadata_;
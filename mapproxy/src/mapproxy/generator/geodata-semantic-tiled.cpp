@@ -25,6 +25,10 @@
  */
 
 #include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <fstream>
 
 #include <boost/filesystem.hpp>
 #include <boost/algorithm/string/split.hpp>
@@ -34,6 +38,7 @@
 #include "utility/raise.hpp"
 #include "utility/format.hpp"
 #include "utility/path.hpp"
+#include "utility/time.hpp"
 
 #include "math/transform.hpp"
 
@@ -51,6 +56,8 @@
 #include "../support/revision.hpp"
 #include "../support/geo.hpp"
 #include "../support/position.hpp"
+#include "../support/outbuffer.hpp"
+#include "../support/compression.hpp"
 
 #include "geodata-semantic-tiled.hpp"
 #include "factory.hpp"
@@ -136,6 +143,31 @@ void saveMetadata(const boost::filesystem::path &path
 
     f.close();
 }
+
+/** Generates geodata tile from semantic world inside given extents.
+ */
+void semanticTile(std::ostream &os, const semantic::GeoPackage &gpkg
+                  , const geo::SrsDefinition &outputSrs
+                  , bool outputAdjustVertical
+                  , const geo::SrsDefinition &srs
+                  , const math::Extents2 &extents
+                  , int lod
+                  , const geo::vectorformat::GeodataConfig &geodataConfig)
+{
+    semantic::GeoPackage::Query query;
+    query.extents = extents;
+    query.srs = srs;
+
+    auto world(gpkg.world(query));
+
+    // TODO: add meshconfig
+    auto fl(semantic::featureLayers(world, {}, lod));
+    fl.transform(outputSrs, outputAdjustVertical);
+
+    os.precision(15);
+    fl.dumpVTSGeodata(os, geodataConfig.resolution);
+}
+
 } // namespace
 
 GeodataSemanticTiled::GeodataSemanticTiled(const Params &params)
@@ -147,6 +179,7 @@ GeodataSemanticTiled::GeodataSemanticTiled(const Params &params)
     , dataset_(absoluteDataset(definition_.dataset))
     , physicalSrs_
       (vr::system.srs(resource().referenceFrame->model.physicalSrs))
+    , tilesRoot_(root() / "tiles")
 {
     if (definition_.format != geo::VectorFormat::geodataJson) {
         LOGTHROW(err1, std::runtime_error)
@@ -182,9 +215,12 @@ GeodataSemanticTiled::GeodataSemanticTiled(const Params &params)
         // map delivery index
         auto deliveryIndexPath(root() / "delivery.index");
         index_ = boost::in_place(referenceFrame().metaBinaryOrder
-                                 , deliveryIndexPath);
+                                 , deliveryIndexPath
+                                 , config().denseTileIndexLods
+                                 , config().indexMapPolicy);
         metadata_ = loadMetadata(root() / "metadata.json");
-        return;
+        if (!definition_.pretiled || fs::exists(tilesRoot_)) { return; }
+        LOG(info1) << "Missing pretiled tiles, regenerate.";
     } catch (const std::exception &e) {
         // not ready
     }
@@ -192,7 +228,12 @@ GeodataSemanticTiled::GeodataSemanticTiled(const Params &params)
     LOG(info1) << "Generator for <" << id() << "> not ready.";
 }
 
-void GeodataSemanticTiled::prepare_impl(Arsenal&)
+void GeodataSemanticTiled::memory_impl(Memory &memory) const
+{
+    if (index_) { memory.add("index", index_->tileIndex); }
+}
+
+void GeodataSemanticTiled::prepare_impl(Arsenal &arsenal)
 {
     LOG(info2) << "Preparing <" << id() << ">.";
 
@@ -212,10 +253,10 @@ void GeodataSemanticTiled::prepare_impl(Arsenal&)
              });
     }
 
-    // try to open datasets
-    geo::GeoDataset::open(dem_.dataset);
-    geo::GeoDataset::open(dem_.dataset + ".min");
-    geo::GeoDataset::open(dem_.dataset + ".max");
+    // try to open datasets (in a worker, see GdalWarper::probe)
+    Aborter aborter;
+    arsenal.warper.probe({ dem_.dataset, dem_.dataset + ".min"
+                           , dem_.dataset + ".max" }, aborter);
 
     // prepare tile index
     {
@@ -236,12 +277,108 @@ void GeodataSemanticTiled::prepare_impl(Arsenal&)
         fs::rename(tmpPath, deliveryIndexPath);
 
         index_ = boost::in_place(referenceFrame().metaBinaryOrder
-                                 , deliveryIndexPath);
+                                 , deliveryIndexPath
+                                 , config().denseTileIndexLods
+                                 , config().indexMapPolicy);
     }
 
+    // tiles from previous preparation are stale in any case; metadata are
+    // saved last and thus mark the store as complete
+    fs::remove(root() / "metadata.json");
+    fs::remove_all(tilesRoot_);
+    if (definition_.pretiled) { pretile(); }
+
     saveMetadata(root() / "metadata.json", metadata_);
 }
 
+fs::path GeodataSemanticTiled::tilePath(const vts::TileId &tileId) const
+{
+    return tilesRoot_ / utility::format("%d/%d-%d.geo", tileId.lod
+                                        , tileId.x, tileId.y);
+}
+
+void GeodataSemanticTiled::pretile() const
+{
+    // collect all real tiles from the index
+    std::vector<vts::TileId> tiles;
+    const auto &ti(index_->tileIndex);
+    for (vts::Lod lod(0); lod < ti.lodCount(); ++lod) {
+        const auto *tree(ti.tree(lod));
+        if (!tree) { continue; }
+        fs::create_directories(tilesRoot_ / utility::format("%d", lod));
+
+        tree->forEachNode([&](int x, int y, int w, int h
+                              , mmapped::QTree::value_type flags)
+        {
+            if (!vts::TileIndex::Flag::isReal(flags)) { return; }
+            for (int j(y), je(y + h); j < je; ++j) {
+                for (int i(x), ie(x + w); i < ie; ++i) {
+                    tiles.emplace_back(lod, i, j);
+                }
+            }
+        }, mmapped::QTree::Filter::white);
+    }
+
+    const auto threads(std::max(std::thread::hardware_concurrency(), 1u));
+    LOG(info3) << "<" << id() << ">: pretiling " << tiles.size()
+               << " tiles in " << threads << " thread(s).";
+    const auto start(utility::usecFromEpoch());
+
+    std::atomic<std::size_t> next(0);
+    std::exception_ptr failure;
+    std::mutex failureLock;
+
+    const auto worker([&]()
+    {
+        try {
+            // GeoPackage handles must not be shared between threads
+            semantic::GeoPackage gpkg(dataset_);
+            for (;;) {
+                const auto i(next++);
+                if (i >= tiles.size()) { return; }
+                const auto &tileId(tiles[i]);
+
+                vts::NodeInfo nodeInfo(referenceFrame(), tileId);
+                if (!nodeInfo.productive()) { continue; }
+
+                OutputBuffer os;
+                semanticTile(os, gpkg, physicalSrs_.srsDef
+                             , physicalSrs_.adjustVertical()
+                             , nodeInfo.srsDef(), nodeInfo.extents()
+                             , definition_.lod, geodataConfig_);
+
+                const auto path(tilePath(tileId));
+                const auto tmpPath(utility::addExtension(path, ".tmp"));
+                {
+                    std::ofstream f;
+                    f.exceptions(std::ios::badbit | std::ios::failbit);
+                    f.open(tmpPath.string(), std::ios_base::out
+                           | std::ios_base::trunc | std::ios_base::binary);
+                    f.write(os.data(), os.size());
+                    f.close();
+                }
+                fs::rename(tmpPath, path);
+            }
+        } catch (...) {
+            std::unique_lock<std::mutex> lock(failureLock);
+            if (!failure) { failure = std::current_exception(); }
+            // stop other workers
+            next = tiles.size();
+        }
+    });
+
+    std::vector<std::thread> pool;
+    for (unsigned int i(1); i < threads; ++i) { pool.emplace_back(worker); }
+    worker();
+    for (auto &thread : pool) { thread.join(); }
+
+    if (failure) { std::rethrow_exception(failure); }
+
+    LOG(info3) << "<" << id() << ">: pretiled " << tiles.size()
+               << " tiles in "
+               << (utility::usecFromEpoch() - start) / 1000 << " ms.";
+}
+
 vr::FreeLayer GeodataSemanticTiled::freeLayer(ResourceRoot root) const
 {
     const auto &res(resource());
@@ -274,6 +411,9 @@ vr::FreeLayer GeodataSemanticTiled::freeLayer(ResourceRoot root) const
 
 vts::MapConfig GeodataSemanticTiled::mapConfig_impl(ResourceRoot root) const
 {
+    // metadata may change, see Generator::updateMetadata
+    const auto &introspection
+        (resource().definition<Definition>().introspection);
     const auto &res(resource());
 
     vts::MapConfig mapConfig;
@@ -289,10 +429,10 @@ vts::MapConfig GeodataSemanticTiled::mapConfig_impl(ResourceRoot root) const
     // add free layer into view
     mapConfig.view.freeLayers[res.id.fullId()];
 
-    if (definition_.introspection.surface) {
+    if (introspection.surface) {
         if (auto other = otherGenerator
             (Resource::Generator::Type::surface
-             , addReferenceFrame(*definition_.introspection.surface
+             , addReferenceFrame(*introspection.surface
                                  , referenceFrameId())))
         {
             mapConfig.merge(other->mapConfig
@@ -301,9 +441,9 @@ vts::MapConfig GeodataSemanticTiled::mapConfig_impl(ResourceRoot root) const
     }
 
     // override position
-    if (definition_.introspection.position) {
+    if (introspection.position) {
         // user supplied
-        mapConfig.position = *definition_.introspection.position;
+        mapConfig.position = *introspection.position;
     } else {
         // calculated
         mapConfig.position = metadata_.position;
@@ -311,8 +451,8 @@ vts::MapConfig GeodataSemanticTiled::mapConfig_impl(ResourceRoot root) const
 
     // browser options (must be Json::Value!); overrides browser options from
     // surface's introspection
-    if (!definition_.introspection.browserOptions.empty()) {
-        mapConfig.browserOptions = definition_.introspection.browserOptions;
+    if (!introspection.browserOptions.empty()) {
+        mapConfig.browserOptions = introspection.browserOptions;
     }
 
     // done
@@ -341,21 +481,26 @@ GeodataSemanticTiled::generateFile_impl(const FileInfo &fileInfo
         }
 
     case GeodataFileInfo::Type::config: {
-        std::ostringstream os;
-        mapConfig(os, ResourceRoot::none);
-        sink.content(os.str(), fi.sinkFileInfo());
+        sendDocument("mapConfig", fi.fileInfo, fi.sinkFileInfo(), sink
+                     , [this](std::ostream &os)
+        {
+            mapConfig(os, ResourceRoot::none);
+        });
         break;
     }
 
     case GeodataFileInfo::Type::definition: {
-        std::ostringstream os;
-        vr::saveFreeLayer(os, freeLayer(ResourceRoot::none));
-        sink.content(os.str(), fi.sinkFileInfo());
+        sendDocument("freelayer", fi.fileInfo, fi.sinkFileInfo(), sink
+                     , [this](std::ostream &os)
+        {
+            vr::saveFreeLayer(os, freeLayer(ResourceRoot::none));
+        });
         break;
     }
 
     case GeodataFileInfo::Type::support:
-        supportFile(*fi.support, sink, fi.sinkFileInfo());
+        supportFile(*fi.support, sink, fi.sinkFileInfo()
+                    , fi.fileInfo.acceptGzip);
         break;
 
     case GeodataFileInfo::Type::registry:
@@ -365,15 +510,8 @@ GeodataSemanticTiled::generateFile_impl(const FileInfo &fileInfo
         break;
 
     case GeodataFileInfo::Type::style:
-        if (stylePath_.empty()) {
-            // return internal file
-            supportFile(files::defaultMeshStyle, sink, fi.sinkFileInfo());
-        } else {
-            // return external file
-            sink.content(vs::fileIStream
-                         (files::defaultMeshStyle.contentType, stylePath_)
-                         , FileClass::config);
-        }
+        sendStyle(files::defaultMeshStyle, stylePath_, fi.fileInfo
+                  , fi.sinkFileInfo(), sink);
         break;
 
     default:
@@ -396,16 +534,22 @@ void GeodataSemanticTiled::generateMetatile(Sink &sink
         return;
     }
 
-    auto metatile(metatileFromDem
-                  (fi.tileId, sink, arsenal, resource()
-                   , index_->tileIndex, dem_.dataset
-                   , dem_.geoidGrid
-                   , MaskTree(), definition_.displaySize));
+    const auto metatile(metatileCache_(resource().revision, fi.tileId, {}
+                                       , [&]()
+    {
+        return metatileFromDem
+            (fi.tileId, sink, arsenal, resource()
+             , index_->tileIndex, dem_.dataset
+             , dem_.geoidGrid
+             , MaskTree(), definition_.displaySize);
+    }));
 
     // write metatile to stream
-    std::ostringstream os;
-    metatile.save(os);
-    sink.content(os.str(), fi.sinkFileInfo());
+    const auto os(OutputBuffer::create());
+    metatile->save(*os);
+    compression::send(sink, compression::Target::metatile
+                      , os->data(), os->size(), fi.sinkFileInfo()
+                      , fi.fileInfo.acceptGzip, os);
 }
 
 struct MemoryBlock {
@@ -465,26 +609,13 @@ public:
 
     virtual void process(Mutex&, DatasetCache&) {
         const std::string dataset(dataset_.data(), dataset_.size());
-        auto &ds(openDataset(dataset));
-
-        semantic::GeoPackage::Query query;
-        query.extents = extents_;
-        query.srs = srs_;
 
-        auto world(ds.world(query));
-
-        // TODO: add meshconfig
-        auto fl(semantic::featureLayers(world, {}, lod_));
-        fl.transform(outputSrs_, outputAdjustVertical_);
-
-        {
-            std::ostringstream os;
-            os.precision(15);
-            fl.dumpVTSGeodata(os, geodataConfig_.resolution);
+        OutputBuffer os;
+        semanticTile(os, openDataset(dataset), outputSrs_
+                     , outputAdjustVertical_, srs_, extents_, lod_
+                     , geodataConfig_);
 
-            const auto str(os.str());
-            rawTile_ = MemoryBlock::allocate(sm(), str.data(), str.size());
-        }
+        rawTile_ = MemoryBlock::allocate(sm(), os.data(), os.size());
     }
 
     virtual Response response(Lock&) {
@@ -508,8 +639,11 @@ public:
     virtual void destroy() { sm().destroy_ptr(this); }
 
 private:
+    /** Per-thread cache: GeoPackage handles must not be shared between
+     *  threads of the threads backend.
+     */
     using GeoPackageCache = std::map<std::string, semantic::GeoPackage>;
-    static GeoPackageCache cache_;
+    static thread_local GeoPackageCache cache_;
 
     static const semantic::GeoPackage& openDataset(const std::string &path) {
         auto fcache(cache_.find(path));
@@ -528,7 +662,7 @@ private:
     geo::vectorformat::GeodataConfig geodataConfig_;
 };
 
-SemanticJob::GeoPackageCache SemanticJob::cache_;
+thread_local SemanticJob::GeoPackageCache SemanticJob::cache_;
 
 MemoryBlock::pointer
 semantic2GeodataTile(Arsenal &arsenal, Aborter &aborter
@@ -570,6 +704,14 @@ void GeodataSemanticTiled::generateGeodata(Sink &sink
         return;
     }
 
+    if (definition_.pretiled) {
+        // generated at prepare time
+        sink.content(vs::fileIStream(fi.sinkFileInfo().contentType.c_str()
+                                     , tilePath(tileId))
+                     , FileClass::data);
+        return;
+    }
+
     auto tile(semantic2GeodataTile
               (arsenal, sink
                , dataset_.string()
@@ -577,7 +719,10 @@ void GeodataSemanticTiled::generateGeodata(Sink &sink
                , nodeInfo.srsDef(), nodeInfo.extents()
                , definition_.lod, geodataConfig_));
 
-    sink.content(tile->data, tile->size, fi.sinkFileInfo(), true);
+    // send straight from warper's memory, tile is held until sent
+    compression::send(sink, compression::Target::geodata
+                      , tile->data, tile->size, fi.sinkFileInfo()
+                      , fi.fileInfo.acceptGzip, tile);
 }
 
 } // namespace generator
@@ -33,6 +33,8 @@
 #include "../generator.hpp"
 #include "../definition.hpp"
 
+#include "metatile.hpp"
+
 namespace generator {
 
 class GeodataSemanticTiled : public Generator {
@@ -65,6 +67,14 @@ private:
     void generateMetatile(Sink &sink, const GeodataFileInfo &fi
                           , Arsenal &arsenal) const;
 
+    /** Generates all tiles into the store (pretiled mode).
+     */
+    void pretile() const;
+
+    /** Path to pretiled tile in the store.
+     */
+    boost::filesystem::path tilePath(const vts::TileId &tileId) const;
+
     Definition definition_;
 
     /** Path to /dem dataset
@@ -89,6 +99,15 @@ private:
 
     boost::optional<mmapped::Index> index_;
 
+    void memory_impl(Memory &memory) const override;
+
+    /** Root of pretiled tiles.
+     */
+    const boost::filesystem::path tilesRoot_;
+
+    // recently generated metatiles
+    mutable MetatileCache metatileCache_;
+
     /** Generator metadata.
      */
     Metadata metadata_;
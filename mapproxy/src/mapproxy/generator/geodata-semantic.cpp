@@ -321,6 +321,9 @@ vr::FreeLayer GeodataSemantic::freeLayer(ResourceRoot root) const
 
 vts::MapConfig GeodataSemantic::mapConfig_impl(ResourceRoot root) const
 {
+    // metadata may change, see Generator::updateMetadata
+    const auto &introspection
+        (resource().definition<Definition>().introspection);
     const auto &res(resource());
 
     vts::MapConfig mapConfig;
@@ -336,10 +339,10 @@ vts::MapConfig GeodataSemantic::mapConfig_impl(ResourceRoot root) const
     // add free layer into view
     mapConfig.view.freeLayers[res.id.fullId()];
 
-    if (definition_.introspection.surface) {
+    if (introspection.surface) {
         if (auto other = otherGenerator
             (Resource::Generator::Type::surface
-             , addReferenceFrame(*definition_.introspection.surface
+             , addReferenceFrame(*introspection.surface
                                  , referenceFrameId())))
         {
             mapConfig.merge(other->mapConfig
@@ -348,9 +351,9 @@ vts::MapConfig GeodataSemantic::mapConfig_impl(ResourceRoot root) const
     }
 
     // override position
-    if (definition_.introspection.position) {
+    if (introspection.position) {
         // user supplied
-        mapConfig.position = *definition_.introspection.position;
+        mapConfig.position = *introspection.position;
     } else {
         // calculated
         mapConfig.position = metadata_.position;
@@ -358,8 +361,8 @@ vts::MapConfig GeodataSemantic::mapConfig_impl(ResourceRoot root) const
 
     // browser options (must be Json::Value!); overrides browser options from
     // surface's introspection
-    if (!definition_.introspection.browserOptions.empty()) {
-        mapConfig.browserOptions = definition_.introspection.browserOptions;
+    if (!introspection.browserOptions.empty()) {
+        mapConfig.browserOptions = introspection.browserOptions;
     }
 
     // done
@@ -380,21 +383,26 @@ Generator::Task GeodataSemantic::generateFile_impl(const FileInfo &fileInfo
         break;
 
     case GeodataFileInfo::Type::config: {
-        std::ostringstream os;
-        mapConfig(os, ResourceRoot::none);
-        sink.content(os.str(), fi.sinkFileInfo());
+        sendDocument("mapConfig", fi.fileInfo, fi.sinkFileInfo(), sink
+                     , [this](std::ostream &os)
+        {
+            mapConfig(os, ResourceRoot::none);
+        });
         break;
     }
 
     case GeodataFileInfo::Type::definition: {
-        std::ostringstream os;
-        vr::saveFreeLayer(os, freeLayer(ResourceRoot::none));
-        sink.content(os.str(), fi.sinkFileInfo());
+        sendDocument("freelayer", fi.fileInfo, fi.sinkFileInfo(), sink
+                     , [this](std::ostream &os)
+        {
+            vr::saveFreeLayer(os, freeLayer(ResourceRoot::none));
+        });
         break;
     }
 
     case GeodataFileInfo::Type::support:
-        supportFile(*fi.support, sink, fi.sinkFileInfo());
+        supportFile(*fi.support, sink, fi.sinkFileInfo()
+                    , fi.fileInfo.acceptGzip);
         break;
 
     case GeodataFileInfo::Type::registry:
@@ -404,15 +412,8 @@ Generator::Task GeodataSemantic::generateFile_impl(const FileInfo &fileInfo
         break;
 
     case GeodataFileInfo::Type::style:
-        if (stylePath_.empty()) {
-            // return internal file
-            supportFile(files::defaultMeshStyle, sink, fi.sinkFileInfo());
-        } else {
-            // return external file
-            sink.content(vs::fileIStream
-                         (files::defaultMeshStyle.contentType, stylePath_)
-                         , FileClass::config);
-        }
+        sendStyle(files::defaultMeshStyle, stylePath_, fi.fileInfo
+                  , fi.sinkFileInfo(), sink);
         break;
 
     default:
@@ -24,6 +24,13 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <set>
+#include <atomic>
+#include <thread>
+#include <fstream>
+#include <sstream>
+
+#include <boost/format.hpp>
 #include <boost/algorithm/string/split.hpp>
 #include <boost/algorithm/string/replace.hpp>
 
@@ -31,6 +38,7 @@
 #include "utility/raise.hpp"
 #include "utility/format.hpp"
 #include "utility/path.hpp"
+#include "utility/time.hpp"
 
 #include "geo/heightcoding.hpp"
 #include "geo/srsfactors.hpp"
@@ -39,10 +47,17 @@
 #include "jsoncpp/as.hpp"
 
 #include "vts-libs/vts/opencv/navtile.hpp"
+#include "vts-libs/storage/fstreams.hpp"
 
 #include "../support/tileindex.hpp"
 #include "../support/srs.hpp"
+#include "../support/geo.hpp"
+#include "../support/preparedstate.hpp"
 #include "../support/revision.hpp"
+#include "../support/outbuffer.hpp"
+#include "../support/compression.hpp"
+
+#include "../contentcache.hpp"
 
 #include "geodata-vector-tiled.hpp"
 #include "factory.hpp"
@@ -63,6 +78,8 @@ struct Factory : Generator::Factory {
         return std::make_shared<GeodataVectorTiled>(params);
     }
 
+    virtual bool deliveryIndex() const { return true; }
+
 private:
     static utility::PreMain register_;
 };
@@ -87,48 +104,26 @@ GeodataVectorTiled::GeodataVectorTiled(const Params &params)
     , tileFile_(definition_.dataset)
     , physicalSrs_
       (vr::system.srs(resource().referenceFrame->model.physicalSrs))
+    , metatilesRoot_(root() / "metatiles")
+    , contentKey_(str(boost::format("geodata:%s@%d:%d:%s")
+                      % resource().id.fullId() % resource().revision
+                      % GeneratorRevision % definitionHash(resource())))
+    , batcher_(config().heightcodeBatchWindow, config().heightcodeBatchSize)
 {
     {
-        // open dataset and get descriptor + metadata
-        auto ds(geo::GeoDataset::open(dem_.dataset));
-        demDescriptor_ = ds.descriptor();
-
-        auto md(ds.getMetadata("vts"));
-
-        if (auto effectiveGSD = md.get<double>("effectiveGSD")) {
-            effectiveGsdArea_ = (*effectiveGSD * *effectiveGSD);
-
-            LOG(info2)
-                << "<" << id() << ">: using configured effective GSD area of "
-                << definition_.dem.dataset << ": "
-                << effectiveGsdArea_ << " m2.";
-        } else {
-            auto esize(math::size(demDescriptor_.extents));
-            auto srs(demDescriptor_.srs.reference());
-            if (srs.IsGeographic()) {
-                // geographic coordinates system -> convert degrees to meters
-                double a(srs.GetSemiMajor());
-                // double b(srs.GetSemiMinor());
-
-                esize.width *= (a * M_PI / 180.0);
-
-                // TODO: compute length of arc between extents.ll(1) nad
-                // extents.ur(1) on the ellipsoid
-                // for now, use same calculation as on the equator
-                esize.height *= (a * M_PI / 180.0);
-            }
-
-            math::Size2f px(esize.width / demDescriptor_.size.width
-                            , esize.height / demDescriptor_.size.height);
-
-            effectiveGsdArea_ = math::area(px);
-            effectiveGsdAreaComputed_ = true;
-
-            LOG(info2)
-                << id() << ": using computed effective GSD area "
-                << definition_.dem.dataset << ": "
-                << effectiveGsdArea_ << " m2.";
-        }
+        // GSD from prepared state if possible, from dataset otherwise
+        PreparedState state(root(), resource());
+        const auto gsd(effectiveGsd(state, dem_.dataset));
+        state.save();
+
+        effectiveGsdArea_ = gsd.area;
+        effectiveGsdAreaComputed_ = gsd.computed;
+
+        LOG(info2)
+            << "<" << id() << ">: using "
+            << (gsd.computed ? "computed" : "configured")
+            << " effective GSD area of " << definition_.dem.dataset << ": "
+            << effectiveGsdArea_ << " m2.";
     }
 
     if (changeEnforced()) {
@@ -143,19 +138,16 @@ GeodataVectorTiled::GeodataVectorTiled(const Params &params)
         if (fs::exists(indexPath)) {
             if (!fs::exists(deliveryIndexPath)) {
                 // no delivery index -> create
-                vts::tileset::Index index(referenceFrame().metaBinaryOrder);
-                vts::tileset::loadTileSetIndex(index, indexPath);
-
-                // convert it to delivery index (using a temporary file)
-                const auto tmpPath(utility::addExtension
-                                   (deliveryIndexPath, ".tmp"));
-                mmapped::TileIndex::write(tmpPath, index.tileIndex);
-                fs::rename(tmpPath, deliveryIndexPath);
+                mmapped::convertDeliveryIndex
+                    (referenceFrame().metaBinaryOrder, indexPath
+                     , deliveryIndexPath);
             }
 
             // load delivery index
             index_ = boost::in_place(referenceFrame().metaBinaryOrder
-                                     , deliveryIndexPath);
+                                     , deliveryIndexPath
+                                     , config().denseTileIndexLods
+                                     , config().indexMapPolicy);
             makeReady();
             return;
         }
@@ -166,16 +158,21 @@ GeodataVectorTiled::GeodataVectorTiled(const Params &params)
     LOG(info1) << "Generator for <" << id() << "> not ready.";
 }
 
-void GeodataVectorTiled::prepare_impl(Arsenal&)
+void GeodataVectorTiled::memory_impl(Memory &memory) const
+{
+    if (index_) { memory.add("index", index_->tileIndex); }
+}
+
+void GeodataVectorTiled::prepare_impl(Arsenal &arsenal)
 {
     LOG(info2) << "Preparing <" << id() << ">.";
 
     const auto &r(resource());
 
-    // try to open datasets
-    geo::GeoDataset::open(dem_.dataset);
-    geo::GeoDataset::open(dem_.dataset + ".min");
-    geo::GeoDataset::open(dem_.dataset + ".max");
+    // try to open datasets (in a worker, see GdalWarper::probe)
+    Aborter aborter;
+    arsenal.warper.probe({ dem_.dataset, dem_.dataset + ".min"
+                           , dem_.dataset + ".max" }, aborter);
 
     // prepare tile index
     {
@@ -196,8 +193,113 @@ void GeodataVectorTiled::prepare_impl(Arsenal&)
         fs::rename(tmpPath, deliveryIndexPath);
 
         index_ = boost::in_place(referenceFrame().metaBinaryOrder
-                                 , deliveryIndexPath);
+                                 , deliveryIndexPath
+                                 , config().denseTileIndexLods
+                                 , config().indexMapPolicy);
     }
+
+    // metatiles from previous preparation are stale in any case;
+    // missing metatiles are generated on demand
+    fs::remove_all(metatilesRoot_);
+    if (definition_.precomputedMetatiles) { precomputeMetatiles(arsenal); }
+}
+
+fs::path GeodataVectorTiled::metatilePath(const vts::TileId &tileId) const
+{
+    return metatilesRoot_ / utility::format("%d/%d-%d.meta", tileId.lod
+                                            , tileId.x, tileId.y);
+}
+
+void GeodataVectorTiled::precomputeMetatiles(Arsenal &arsenal) const
+{
+    const auto &ti(index_->tileIndex);
+    const auto mbo(index_->metaBinaryOrder());
+
+    // collect metatiles covering subtrees of all valid tiles
+    std::set<vts::TileId> ids;
+    for (vts::Lod lod(0); lod < ti.lodCount(); ++lod) {
+        for (vts::Lod l(lod); l < ti.lodCount(); ++l) {
+            const auto *tree(ti.tree(l));
+            if (!tree) { continue; }
+
+            const auto shift(l - lod);
+            tree->forEachNode([&](unsigned int x, unsigned int y
+                                  , unsigned int w, unsigned int h
+                                  , mmapped::QTree::value_type)
+            {
+                const auto x0((x >> shift) >> mbo);
+                const auto y0((y >> shift) >> mbo);
+                const auto x1(((x + w - 1) >> shift) >> mbo);
+                const auto y1(((y + h - 1) >> shift) >> mbo);
+                for (auto j(y0); j <= y1; ++j) {
+                    for (auto i(x0); i <= x1; ++i) {
+                        const vts::TileId id(lod, i << mbo, j << mbo);
+                        if (index_->meta(id)) { ids.insert(id); }
+                    }
+                }
+            }, mmapped::QTree::Filter::white);
+        }
+        fs::create_directories(metatilesRoot_ / utility::format("%d", lod));
+    }
+
+    const std::vector<vts::TileId> metatiles(ids.begin(), ids.end());
+    const auto threads(std::max(std::thread::hardware_concurrency(), 1u));
+    LOG(info3) << "<" << id() << ">: precomputing " << metatiles.size()
+               << " metatiles in " << threads << " thread(s).";
+    const auto start(utility::usecFromEpoch());
+
+    std::atomic<std::size_t> next(0);
+    std::atomic<std::size_t> generated(0);
+
+    const auto worker([&]()
+    {
+        auto sink(Sink::detached());
+        for (;;) {
+            const auto i(next++);
+            if (i >= metatiles.size()) { return; }
+            const auto &tileId(metatiles[i]);
+
+            try {
+                const auto metatile
+                    (metatileFromDem(tileId, sink, arsenal, resource()
+                                     , index_->tileIndex, dem_.dataset
+                                     , dem_.geoidGrid, MaskTree()
+                                     , definition_.displaySize));
+
+                OutputBuffer os;
+                metatile.save(os);
+
+                const auto path(metatilePath(tileId));
+                const auto tmpPath(utility::addExtension(path, ".tmp"));
+                {
+                    std::ofstream f;
+                    f.exceptions(std::ios::badbit | std::ios::failbit);
+                    f.open(tmpPath.string(), std::ios_base::out
+                           | std::ios_base::trunc | std::ios_base::binary);
+                    f.write(os.data(), os.size());
+                    f.close();
+                }
+                fs::rename(tmpPath, path);
+                ++generated;
+            } catch (const NotFound&) {
+                // outside of configured range, nothing to store
+            } catch (const std::exception &e) {
+                // generated on demand
+                LOG(err2) << "<" << id() << ">: failed to precompute "
+                          << "metatile " << tileId << ": <"
+                          << e.what() << ">.";
+            }
+        }
+    });
+
+    std::vector<std::thread> pool;
+    for (unsigned int i(1); i < threads; ++i) { pool.emplace_back(worker); }
+    worker();
+    for (auto &thread : pool) { thread.join(); }
+
+    LOG(info3) << "<" << id() << ">: precomputed " << generated << " of "
+               << metatiles.size() << " metatiles in "
+               << (utility::usecFromEpoch() - start) / 1000 << " ms.";
 }
 
 vr::FreeLayer GeodataVectorTiled::freeLayer_impl(ResourceRoot root) const
@@ -234,6 +336,9 @@ vr::FreeLayer GeodataVectorTiled::freeLayer_impl(ResourceRoot root) const
 vts::MapConfig GeodataVectorTiled::mapConfig_impl(ResourceRoot root)
     const
 {
+    // metadata may change, see Generator::updateMetadata
+    const auto &introspection
+        (resource().definition<Definition>().introspection);
     const auto &res(resource());
 
     vts::MapConfig mapConfig;
@@ -249,11 +354,11 @@ vts::MapConfig GeodataVectorTiled::mapConfig_impl(ResourceRoot root)
     // add free layer into view
     mapConfig.view.freeLayers[res.id.fullId()];
 
-    if (definition_.introspection.surface) {
+    if (introspection.surface) {
         LOG(info1) << "trying to find surface";
         if (auto other = otherGenerator
             (Resource::Generator::Type::surface
-             , addReferenceFrame(*definition_.introspection.surface
+             , addReferenceFrame(*introspection.surface
                                  , referenceFrameId())))
         {
             mapConfig.merge(other->mapConfig
@@ -261,14 +366,14 @@ vts::MapConfig GeodataVectorTiled::mapConfig_impl(ResourceRoot root)
         }
     }
 
-    if (definition_.introspection.position) {
-        mapConfig.position = *definition_.introspection.position;
+    if (introspection.position) {
+        mapConfig.position = *introspection.position;
     }
 
     // browser options (must be Json::Value!); overrides browser options from
     // surface's introspection
-    if (!definition_.introspection.browserOptions.empty()) {
-        mapConfig.browserOptions = definition_.introspection.browserOptions;
+    if (!introspection.browserOptions.empty()) {
+        mapConfig.browserOptions = introspection.browserOptions;
     }
 
     // done
@@ -286,16 +391,33 @@ void GeodataVectorTiled::generateMetatile(Sink &sink
         return;
     }
 
-    auto metatile(metatileFromDem
-                  (fi.tileId, sink, arsenal, resource()
-                   , index_->tileIndex, dem_.dataset
-                   , dem_.geoidGrid
-                   , MaskTree(), definition_.displaySize));
+    if (definition_.precomputedMetatiles) {
+        const auto path(metatilePath(fi.tileId));
+        if (fs::exists(path)) {
+            // generated at prepare time
+            sink.content(vs::fileIStream
+                         (fi.sinkFileInfo().contentType.c_str(), path)
+                         , FileClass::data);
+            return;
+        }
+    }
+
+    const auto metatile(metatileCache_(resource().revision, fi.tileId, {}
+                                       , [&]()
+    {
+        return metatileFromDem
+            (fi.tileId, sink, arsenal, resource()
+             , index_->tileIndex, dem_.dataset
+             , dem_.geoidGrid
+             , MaskTree(), definition_.displaySize);
+    }));
 
     // write metatile to stream
-    std::ostringstream os;
-    metatile.save(os);
-    sink.content(os.str(), fi.sinkFileInfo());
+    const auto os(OutputBuffer::create());
+    metatile->save(*os);
+    compression::send(sink, compression::Target::metatile
+                      , os->data(), os->size(), fi.sinkFileInfo()
+                      , fi.fileInfo.acceptGzip, os);
 }
 
 void GeodataVectorTiled::generateGeodata(Sink &sink
@@ -342,7 +464,7 @@ void GeodataVectorTiled::generateGeodata(Sink &sink
     // combine all dem datasets and default/fallback dem dataset
     auto datasets(viewspec2datasets(fi.fileInfo.query, dem_));
 
-    geo::heightcoding::Config config;
+    GdalWarper::HeightcodeConfig config;
     config.workingSrs = sds(nodeInfo, dem_.geoidGrid);
     config.outputSrs = boost::in_place
         (physicalSrs_.srsDef, physicalSrs_.adjustVertical());
@@ -350,6 +472,7 @@ void GeodataVectorTiled::generateGeodata(Sink &sink
     config.format = definition_.format;
     config.formatConfig = definition_.formatConfig;
     config.mode = definition_.mode;
+    config.batchSampling = definition_.batchSampling;
     config.schema = definition_.schema;
     
     LOG(debug) << "Schema: " << config.schema;
@@ -375,18 +498,56 @@ void GeodataVectorTiled::generateGeodata(Sink &sink
         openOptions.push_back(os.str());
     }
 
-    // heightcode data using warper's machinery
-    LOG(info1) << "Heightcoding.";
-    auto hc(arsenal.warper.heightcode
-            (tileFile, datasets.first, config, dem_.geoidGrid
-             , openOptions, layerEnhancers(), sink));
-
     // force 1 hour max age if not all views from viewspec have been found
     boost::optional<long> maxAge;
     if (!datasets.second) { maxAge = 3600; }
 
-    sink.content(hc->data, hc->size
-                 , fi.sinkFileInfo().setMaxAge(maxAge), true);
+    // output is fully determined by source tile, resolved DEM set and
+    // definition, i.e. shared by all viewspecs resolving to the same DEMs
+    std::string key;
+    if (arsenal.contentCache) {
+        std::ostringstream os;
+        os << contentKey_ << '|' << tileFile << '|' << sourceTileId;
+        if (cutting) { os << '>' << tileId; }
+        for (const auto &dataset : datasets.first) {
+            os << '|' << dataset.dataset;
+            if (dataset.geoidGrid) { os << '+' << *dataset.geoidGrid; }
+        }
+        key = os.str();
+
+        if (const auto cached = arsenal.contentCache->get(key)) {
+            LOG(info1) << "Using cached heightcoded data.";
+            compression::send(sink, compression::Target::geodata
+                              , cached->body().data(), cached->body().size()
+                              , fi.sinkFileInfo().setMaxAge(maxAge)
+                              , fi.fileInfo.acceptGzip, cached);
+            return;
+        }
+    }
+
+    // heightcode data using warper's machinery
+    LOG(info1) << "Heightcoding.";
+    const auto rasterDs(demRegistry().fuse(datasets.first));
+    std::string batchKey;
+    for (const auto &dataset : rasterDs) {
+        batchKey += dataset.dataset;
+        if (dataset.geoidGrid) { batchKey += '+' + *dataset.geoidGrid; }
+        batchKey += '|';
+    }
+
+    auto hc(batcher_.heightcode
+            (arsenal.warper, batchKey
+             , GdalWarper::HeightcodeTile{ tileFile, config, openOptions }
+             , rasterDs, dem_.geoidGrid, layerEnhancers(), sink));
+
+    const auto stat(fi.sinkFileInfo().setMaxAge(maxAge));
+    if (!key.empty()) {
+        arsenal.contentCache->put(key, hc->data, hc->size, stat);
+    }
+
+    // send straight from warper's memory, hc is held until sent
+    compression::send(sink, compression::Target::geodata, hc->data, hc->size
+                      , stat, fi.fileInfo.acceptGzip, hc);
 }
 
 } // namespace generator
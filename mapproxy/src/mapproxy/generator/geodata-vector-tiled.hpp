@@ -35,6 +35,8 @@
 
 #include "../support/mmapped/tilesetindex.hpp"
 #include "geodatavectorbase.hpp"
+#include "metatile.hpp"
+#include "heightcodebatcher.hpp"
 
 namespace generator {
 
@@ -58,13 +60,20 @@ private:
                                  , const GeodataFileInfo &fileInfo
                                  , Arsenal &arsenal) const;
 
+    /** Generates all metatiles into the store.
+     */
+    void precomputeMetatiles(Arsenal &arsenal) const;
+
+    /** Path to precomputed metatile in the store.
+     */
+    boost::filesystem::path metatilePath(const vts::TileId &tileId) const;
+
     Definition definition_;
 
     /** Path to /dem dataset
      */
     const DemDataset dem_;
 
-    geo::GeoDataset::Descriptor demDescriptor_;
     double effectiveGsdArea_;
     bool effectiveGsdAreaComputed_;
 
@@ -73,6 +82,22 @@ private:
     const vr::Srs &physicalSrs_;
 
     boost::optional<mmapped::Index> index_;
+
+    void memory_impl(Memory &memory) const override;
+
+    /** Root of precomputed metatiles.
+     */
+    const boost::filesystem::path metatilesRoot_;
+
+    /** Identifies resource definition in heightcoded content cache keys.
+     */
+    std::string contentKey_;
+
+    // recently generated metatiles
+    mutable MetatileCache metatileCache_;
+
+    // batches heightcoding of neighbouring tiles
+    mutable HeightcodeBatcher batcher_;
 };
 
 } // namespace generator
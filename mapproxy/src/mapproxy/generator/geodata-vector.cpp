@@ -24,7 +24,11 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <sstream>
+
+#include <boost/format.hpp>
 #include <boost/filesystem.hpp>
+#include <boost/algorithm/string/predicate.hpp>
 
 #include "utility/premain.hpp"
 #include "utility/raise.hpp"
@@ -41,12 +45,16 @@
 #include "../support/tileindex.hpp"
 #include "../support/srs.hpp"
 #include "../support/revision.hpp"
+#include "../support/hash.hpp"
+#include "../support/storefile.hpp"
+#include "../support/compression.hpp"
 
 #include "geodata-vector.hpp"
 #include "factory.hpp"
 
 namespace vr = vtslibs::registry;
 namespace fs = boost::filesystem;
+namespace ba = boost::algorithm;
 
 namespace generator {
 
@@ -67,6 +75,11 @@ utility::PreMain Factory::register_([]()
     Generator::registerType<GeodataVector>(std::make_shared<Factory>());
 });
 
+/** Maximum number of alternative DEM sets materialized in the store. Output
+ *  for any other DEM set is heightcoded on each request.
+ */
+const std::size_t MaxAlternatives(64);
+
 } // namespace
 
 GeodataVector::GeodataVector(const Params &params)
@@ -88,7 +101,10 @@ GeodataVector::GeodataVector(const Params &params)
         metadata_ = geo::heightcoding::loadMetadata
             (root() / "metadata.json");
         if (fs::file_size(dataPath_) == metadata_.fileSize) {
-            // valid file
+            // valid file; stores prepared by older versions have no
+            // gzipped copy
+            StoreFile::ensureGzipped(dataPath_);
+            output_ = StoreFile(dataPath_);
             makeReady();
             return;
         }
@@ -103,29 +119,40 @@ GeodataVector::heightcode(const DemDataset::list &datasets
                           , GdalWarper &warper, Aborter &aborter) const
 {
     // height code dataset
-    geo::heightcoding::Config config;
+    GdalWarper::HeightcodeConfig config;
     config.outputSrs = boost::in_place
         (physicalSrs_.srsDef, physicalSrs_.adjustVertical());
     config.layers = definition_.layers;
     config.format = definition_.format;
     config.formatConfig = definition_.formatConfig;
     config.mode = definition_.mode;
+    config.batchSampling = definition_.batchSampling;
 
     // heightcode data using warper's machinery
     auto hc(warper.heightcode
             (absoluteDataset(definition_.dataset)
-             , datasets, config, dem_.geoidGrid, {}
+             , demRegistry().fuse(datasets), config, dem_.geoidGrid, {}
              , layerEnhancers(), aborter));
     return hc;
 }
 
 void GeodataVector::prepare_impl(Arsenal &arsenal)
 {
+    // drop everything materialized by previous definition
+    for (fs::directory_iterator i(root()), e; i != e; ++i) {
+        if (ba::starts_with(i->path().filename().string()
+                            , dataPath_.filename().string() + "."))
+        {
+            fs::remove(i->path());
+        }
+    }
+
     Aborter dummyAborter;
     auto hc(heightcode({ dem_ }, arsenal.warper, dummyAborter));
 
-    // save output to file
-    utility::write(dataPath_, hc->data, hc->size);
+    // save output (and its gzipped copy) to store
+    StoreFile::write(dataPath_, hc->data, hc->size);
+    output_ = StoreFile(dataPath_);
 
     // store metadata
     metadata_ = hc->metadata;
@@ -161,6 +188,9 @@ vr::FreeLayer GeodataVector::freeLayer_impl(ResourceRoot root) const
 vts::MapConfig GeodataVector::mapConfig_impl(ResourceRoot root)
     const
 {
+    // metadata may change, see Generator::updateMetadata
+    const auto &introspection
+        (resource().definition<Definition>().introspection);
     const auto &res(resource());
 
     vts::MapConfig mapConfig;
@@ -176,10 +206,10 @@ vts::MapConfig GeodataVector::mapConfig_impl(ResourceRoot root)
     // add free layer into view
     mapConfig.view.freeLayers[res.id.fullId()];
 
-    if (definition_.introspection.surface) {
+    if (introspection.surface) {
         if (auto other = otherGenerator
             (Resource::Generator::Type::surface
-             , addReferenceFrame(*definition_.introspection.surface
+             , addReferenceFrame(*introspection.surface
                                  , referenceFrameId())))
         {
             mapConfig.merge(other->mapConfig
@@ -189,8 +219,8 @@ vts::MapConfig GeodataVector::mapConfig_impl(ResourceRoot root)
 
     // browser options (must be Json::Value!); overrides browser options from
     // surface's introspection
-    if (!definition_.introspection.browserOptions.empty()) {
-        mapConfig.browserOptions = definition_.introspection.browserOptions;
+    if (!introspection.browserOptions.empty()) {
+        mapConfig.browserOptions = introspection.browserOptions;
     }
 
     // done
@@ -204,6 +234,43 @@ void GeodataVector::generateMetatile(Sink &sink, const GeodataFileInfo &
                ("Monolithic geodata resource has no metatiles."));
 }
 
+boost::optional<StoreFile>
+GeodataVector::alternative(const DemDataset::list &datasets
+                           , GdalWarper &warper, Aborter &aborter) const
+{
+    std::ostringstream os;
+    for (const auto &dataset : datasets) {
+        os << dataset.dataset;
+        if (dataset.geoidGrid) { os << '+' << *dataset.geoidGrid; }
+        os << '|';
+    }
+    const auto key(os.str());
+
+    {
+        std::unique_lock<std::mutex> lock(alternativesLock_);
+        auto falternatives(alternatives_.find(key));
+        if (falternatives != alternatives_.end()) {
+            return falternatives->second;
+        }
+        if (alternatives_.size() >= MaxAlternatives) { return boost::none; }
+    }
+
+    const auto path(utility::addExtension
+                    (dataPath_, str(boost::format(".%016x")
+                                    % stableHash(key))));
+    if (!fs::exists(path)) {
+        // heightcode outside lock; concurrent first uses may do it twice
+        LOG(info1) << "Materializing geodata for DEM set <" << key << ">.";
+        auto hc(heightcode(datasets, warper, aborter));
+        StoreFile::write(path, hc->data, hc->size);
+    }
+
+    StoreFile output(path);
+
+    std::unique_lock<std::mutex> lock(alternativesLock_);
+    return alternatives_.emplace(key, output).first->second;
+}
+
 void GeodataVector::generateGeodata(Sink &sink
                                     , const GeodataFileInfo &fi
                                     , Arsenal &arsenal) const
@@ -214,19 +281,27 @@ void GeodataVector::generateGeodata(Sink &sink
     boost::optional<long> maxAge;
     if (!datasets.second) { maxAge = 3600; }
 
-    if (datasets.first.size() > 1) {
-        // valid viewspec -> use it to heightcode file
-        auto hc(heightcode(datasets.first, arsenal.warper, sink));
+    if (datasets.first.size() <= 1) {
+        // no valid viewspec, return original output
+        output_.send(sink, fi.sinkFileInfo().setMaxAge(maxAge)
+                     , fi.fileInfo.acceptGzip);
+        return;
+    }
 
-        sink.content(hc->data, hc->size
-                     , fi.sinkFileInfo().setMaxAge(maxAge), true);
+    // valid viewspec -> use materialized output for its DEM set
+    if (auto output = alternative(datasets.first, arsenal.warper, sink)) {
+        output->send(sink, fi.sinkFileInfo().setMaxAge(maxAge)
+                     , fi.fileInfo.acceptGzip);
         return;
     }
 
-    // no valid viewspec, return original file
-    sink.content(vs::fileIStream(fi.sinkFileInfo().contentType.c_str()
-                                 , dataPath_)
-                 , FileClass::data, maxAge);
+    // too many DEM sets, heightcode file
+    auto hc(heightcode(datasets.first, arsenal.warper, sink));
+
+    // send straight from warper's memory, hc is held until sent
+    compression::send(sink, compression::Target::geodata, hc->data, hc->size
+                      , fi.sinkFileInfo().setMaxAge(maxAge)
+                      , fi.fileInfo.acceptGzip, hc);
 }
 
 } // namespace generator
@@ -27,8 +27,13 @@
 #ifndef mapproxy_generator_geodata_vector_hpp_included_
 #define mapproxy_generator_geodata_vector_hpp_included_
 
+#include <map>
+#include <mutex>
+
 #include "vts-libs/vts/tileset/tilesetindex.hpp"
 
+#include "../support/storefile.hpp"
+
 #include "geodatavectorbase.hpp"
 
 namespace generator {
@@ -57,6 +62,14 @@ private:
     heightcode(const DemDataset::list &datasets
                , GdalWarper &warper, Aborter &aborter) const;
 
+    /** Returns materialized output for given alternative DEM set. Output is
+     *  heightcoded and stored on first use. Returns none if no more
+     *  alternatives can be materialized.
+     */
+    boost::optional<StoreFile>
+    alternative(const DemDataset::list &datasets
+                , GdalWarper &warper, Aborter &aborter) const;
+
     Definition definition_;
 
     const DemDataset dem_;
@@ -70,6 +83,15 @@ private:
     /** Path to cached output data.
      */
     boost::filesystem::path dataPath_;
+
+    /** Output for default DEM.
+     */
+    StoreFile output_;
+
+    /** Outputs for alternative DEM sets, mapped on first use.
+     */
+    mutable std::mutex alternativesLock_;
+    mutable std::map<std::string, StoreFile> alternatives_;
 };
 
 } // namespace generator
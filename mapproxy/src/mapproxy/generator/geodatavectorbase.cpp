@@ -90,21 +90,26 @@ Generator::Task GeodataVectorBase::generateFile_impl(const FileInfo &fileInfo
         break;
 
     case GeodataFileInfo::Type::config: {
-        std::ostringstream os;
-        mapConfig(os, ResourceRoot::none);
-        sink.content(os.str(), fi.sinkFileInfo());
+        sendDocument("mapConfig", fi.fileInfo, fi.sinkFileInfo(), sink
+                     , [this](std::ostream &os)
+        {
+            mapConfig(os, ResourceRoot::none);
+        });
         break;
     }
 
     case GeodataFileInfo::Type::definition: {
-        std::ostringstream os;
-        vr::saveFreeLayer(os, freeLayer_impl(ResourceRoot::none));
-        sink.content(os.str(), fi.sinkFileInfo());
+        sendDocument("freelayer", fi.fileInfo, fi.sinkFileInfo(), sink
+                     , [this](std::ostream &os)
+        {
+            vr::saveFreeLayer(os, freeLayer_impl(ResourceRoot::none));
+        });
         break;
     }
 
     case GeodataFileInfo::Type::support:
-        supportFile(*fi.support, sink, fi.sinkFileInfo());
+        supportFile(*fi.support, sink, fi.sinkFileInfo()
+                    , fi.fileInfo.acceptGzip);
         break;
 
     case GeodataFileInfo::Type::registry:
@@ -114,15 +119,8 @@ Generator::Task GeodataVectorBase::generateFile_impl(const FileInfo &fileInfo
         break;
 
     case GeodataFileInfo::Type::style:
-        if (stylePath_.empty()) {
-            // return internal file
-            supportFile(files::defaultStyle, sink, fi.sinkFileInfo());
-        } else {
-            // return external file
-            sink.content(vs::fileIStream
-                         (files::defaultStyle.contentType, stylePath_)
-                         , FileClass::config);
-        }
+        sendStyle(files::defaultStyle, stylePath_, fi.fileInfo
+                  , fi.sinkFileInfo(), sink);
         break;
 
     default:
@@ -175,23 +173,33 @@ GeodataVectorBase::viewspec2datasets(const std::string &query
     {
         auto kv(splitArgument(*iargs));
         if (ba::equals(kv.first, "viewspec")) {
-            std::vector<std::string> ids;
-            ba::split(ids, kv.second, ba::is_any_of(",")
-                      , ba::token_compress_on);
-
-            // url decode values
-            for (auto &id : ids) { id = utility::urlDecode(id); }
+            const std::string viewspec(kv.second.begin(), kv.second.end());
 
-            if ((ids.size() == 1)
-                && ((ids.front() == "{viewspec}")
-                    || (ids.front() == "viewspec")))
+            // parsed only when not memoized by the registry
+            const auto parse([&]() -> std::vector<std::string>
             {
-                // viewspec not expanded, treate as empty
-                LOG(info1) << "Viewspec not expanded, ignoring.";
-                return empty();
-            }
-
-            auto result(demRegistry().find(referenceFrameId(), ids));
+                std::vector<std::string> ids;
+                ba::split(ids, viewspec, ba::is_any_of(",")
+                          , ba::token_compress_on);
+
+                // url decode values
+                for (auto &id : ids) { id = utility::urlDecode(id); }
+
+                if ((ids.size() == 1)
+                    && ((ids.front() == "{viewspec}")
+                        || (ids.front() == "viewspec")))
+                {
+                    // viewspec not expanded, treate as empty (i.e. only
+                    // fallback is used)
+                    LOG(info1) << "Viewspec not expanded, ignoring.";
+                    return {};
+                }
+
+                return ids;
+            });
+
+            auto result(demRegistry().find(referenceFrameId(), viewspec
+                                           , parse));
             result.first.emplace_back(fallback);
             return result;
         }
@@ -0,0 +1,138 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <algorithm>
+#include <condition_variable>
+
+#include "dbglog/dbglog.hpp"
+
+#include "heightcodebatcher.hpp"
+
+namespace generator {
+
+struct HeightcodeBatcher::Batch {
+    GdalWarper::HeightcodeTile::list tiles;
+    GdalWarper::HeightcodedTile::list results;
+    bool done = false;
+    bool failed = false;
+    std::condition_variable cond;
+};
+
+HeightcodeBatcher::HeightcodeBatcher(unsigned int window
+                                     , std::size_t maxTiles)
+    : window_(window), maxTiles_(std::max(maxTiles, std::size_t(1)))
+{}
+
+GdalWarper::Heightcoded::pointer
+HeightcodeBatcher::heightcode(GdalWarper &warper, const std::string &key
+                              , const GdalWarper::HeightcodeTile &tile
+                              , const DemDataset::list &rasterDs
+                              , const boost::optional<std::string>
+                              &vectorGeoidGrid
+                              , const LayerEnhancer::map &layerEnhancers
+                              , Aborter &aborter)
+{
+    const auto single([&]()
+    {
+        return warper.heightcode(tile.vectorDs, rasterDs, tile.config
+                                 , vectorGeoidGrid, tile.openOptions
+                                 , layerEnhancers, aborter);
+    });
+
+    if (!window_.count() || (maxTiles_ == 1)) { return single(); }
+
+    const auto unwrap([](const GdalWarper::HeightcodedTile &result)
+    {
+        if (result.error) { std::rethrow_exception(result.error); }
+        return result.heightcoded;
+    });
+
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    auto fopen(open_.find(key));
+    if (fopen != open_.end()) {
+        // join open batch
+        auto batch(fopen->second);
+        const auto index(batch->tiles.size());
+        batch->tiles.push_back(tile);
+        if (batch->tiles.size() >= maxTiles_) {
+            // full, wake up its runner
+            open_.erase(fopen);
+            batch->cond.notify_all();
+        }
+
+        batch->cond.wait(lock, [&]() { return batch->done; });
+        if (batch->failed) {
+            lock.unlock();
+            return single();
+        }
+        return unwrap(batch->results[index]);
+    }
+
+    // open new batch and wait for others
+    auto batch(std::make_shared<Batch>());
+    batch->tiles.push_back(tile);
+    open_.insert({ key, batch });
+
+    batch->cond.wait_for(lock, window_, [&]()
+    {
+        return batch->tiles.size() >= maxTiles_;
+    });
+
+    fopen = open_.find(key);
+    if ((fopen != open_.end()) && (fopen->second == batch)) {
+        open_.erase(fopen);
+    }
+
+    // closed, nobody else can join
+    lock.unlock();
+
+    if (batch->tiles.size() == 1) { return single(); }
+
+    LOG(info1) << "Heightcoding batch of " << batch->tiles.size()
+               << " tiles.";
+
+    GdalWarper::HeightcodedTile::list results;
+    std::exception_ptr error;
+    try {
+        results = warper.heightcode(batch->tiles, rasterDs, vectorGeoidGrid
+                                    , layerEnhancers, aborter);
+    } catch (...) {
+        error = std::current_exception();
+    }
+
+    lock.lock();
+    batch->results = results;
+    batch->failed = bool(error);
+    batch->done = true;
+    batch->cond.notify_all();
+    lock.unlock();
+
+    if (error) { std::rethrow_exception(error); }
+    return unwrap(results.front());
+}
+
+} // namespace generator
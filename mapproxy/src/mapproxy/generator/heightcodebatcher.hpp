@@ -0,0 +1,83 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef mapproxy_generator_heightcodebatcher_hpp_included_
+#define mapproxy_generator_heightcodebatcher_hpp_included_
+
+#include <map>
+#include <chrono>
+#include <mutex>
+#include <memory>
+#include <string>
+
+#include <boost/noncopyable.hpp>
+
+#include "../gdalsupport.hpp"
+
+namespace generator {
+
+/** Collects heightcoding of tiles requested close to each other in time
+ *  into batches handled by single warper job (see
+ *  GdalWarper::heightcode(tiles...)).
+ *
+ *  First tile under given key opens a batch and waits for others up to the
+ *  batching window (or until the batch is full), then runs the batch on
+ *  behalf of all of them. When the batch as a whole fails (e.g. its first
+ *  client goes away) other tiles are heightcoded one by one.
+ */
+class HeightcodeBatcher : boost::noncopyable {
+public:
+    /** Batching window in ms (0 = no batching) and maximum batch size.
+     */
+    HeightcodeBatcher(unsigned int window, std::size_t maxTiles);
+
+    /** Heightcodes tile. Key identifies what must be shared among batched
+     *  tiles: DEMs, vector geoid grid and layer enhancers.
+     */
+    GdalWarper::Heightcoded::pointer
+    heightcode(GdalWarper &warper, const std::string &key
+               , const GdalWarper::HeightcodeTile &tile
+               , const DemDataset::list &rasterDs
+               , const boost::optional<std::string> &vectorGeoidGrid
+               , const LayerEnhancer::map &layerEnhancers
+               , Aborter &aborter);
+
+private:
+    struct Batch;
+
+    const std::chrono::milliseconds window_;
+    const std::size_t maxTiles_;
+
+    std::mutex mutex_;
+
+    /** Batches still accepting tiles.
+     */
+    std::map<std::string, std::shared_ptr<Batch>> open_;
+};
+
+} // namespace generator
+
+#endif // mapproxy_generator_heightcodebatcher_hpp_included_
@@ -24,7 +24,15 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <condition_variable>
+
 #include "utility/raise.hpp"
+#include "utility/format.hpp"
 
 #include "../support/metatile.hpp"
 #include "../support/geo.hpp"
@@ -99,6 +107,8 @@ inline bool validSample(double value)
     return (value >= -1e6);
 }
 
+/** Samples 3-channel float (valueMinMaxFloat) raster.
+ */
 class ValueMinMaxSampler {
 public:
     ValueMinMaxSampler(const GdalWarper::Raster &dem
@@ -108,7 +118,7 @@ public:
 
     boost::optional<cv::Vec3d> operator()(int i, int j) const {
         // first, try exact value
-        const auto &v(dem_->at<cv::Vec3d>(j, i));
+        const cv::Vec3d v(dem_->at<cv::Vec3f>(j, i));
         if (validSample(v[0])) { return applyHeightFunction(v); }
 
         // output vector and count of valid samples
@@ -127,7 +137,7 @@ public:
                     || (y < 0) || (y >= dem_->rows))
                     { continue; }
 
-                const auto &v(dem_->at<cv::Vec3d>(y, x));
+                const auto &v(dem_->at<cv::Vec3f>(y, x));
                 if (validSample(v[0])) {
                     out[0] += v[0];
                     out[1] = std::min(out[1], v[1]);
@@ -173,6 +183,367 @@ inline MetaFlag::value_type ti2metaFlags(TiFlag::value_type ti)
     return meta;
 }
 
+/** Run op(x, y, xsize, ysize, value) for every valid node of tree in subtree
+ *  starting at given node. Works for both vts and memory mapped trees.
+ */
+template <typename Tree, typename Op>
+void forEachValidNode(const Tree &tree, unsigned int depth
+                      , unsigned int x, unsigned int y, const Op &op)
+{
+    tree.forEachNode(depth, x, y
+                     , [&](unsigned int x, unsigned int y
+                           , unsigned int xsize, unsigned int ysize
+                           , typename Tree::value_type)
+    {
+        op(x, y, xsize, ysize);
+    }, Tree::Filter::white);
+}
+
+inline vts::Lod lodCount(const vts::TileIndex &tileIndex)
+{
+    return (tileIndex.empty() ? 0 : (tileIndex.maxLod() + 1));
+}
+
+inline vts::Lod lodCount(const mmapped::TileIndex &tileIndex)
+{
+    return tileIndex.lodCount();
+}
+
+/** Flags of all tiles of given tile range at given lod, row-major.
+ */
+std::vector<TiFlag::value_type>
+rangeFlags(const vts::TileIndex &tileIndex, vts::Lod lod
+           , const vts::TileRange &range)
+{
+    const auto size(vts::tileRangesSize(range));
+    std::vector<TiFlag::value_type> flags(math::area(size));
+    auto iflags(flags.begin());
+    for (int j(0); j < size.height; ++j) {
+        for (int i(0); i < size.width; ++i) {
+            *iflags++ = tileIndex.get
+                (vts::TileId(lod, range.ll(0) + i, range.ll(1) + j));
+        }
+    }
+    return flags;
+}
+
+/** Flags of all tiles of given tile range at given lod, row-major. Single
+ *  descent of memory mapped tree.
+ */
+std::vector<TiFlag::value_type>
+rangeFlags(const mmapped::TileIndex &tileIndex, vts::Lod lod
+           , const vts::TileRange &range)
+{
+    const auto flags(tileIndex.rangeFlags(lod, range));
+    return { flags.begin(), flags.end() };
+}
+
+/** Subtree validity of all tiles in aligned window (size x size tiles at
+ *  given lod, origin at (wx, wy) << shift), row-major.
+ */
+std::vector<char> windowValidSubtree(const vts::TileIndex &tileIndex
+                                     , vts::Lod lod, unsigned int shift
+                                     , unsigned int wx, unsigned int wy)
+{
+    const unsigned int size(1 << shift);
+    const vts::Lod depth(lod - shift);
+    std::vector<char> valid(size * size, false);
+
+    for (vts::Lod l(lod), le(lodCount(tileIndex)); l < le; ++l) {
+        const auto *tree(tileIndex.tree(l));
+        if (!tree) { continue; }
+
+        // tree coordinates -> window coordinates
+        const auto s(l - lod);
+        forEachValidNode(*tree, depth, wx, wy
+                         , [&](unsigned int x, unsigned int y
+                               , unsigned int xsize, unsigned int ysize)
+        {
+            const auto xe((x + xsize - 1) >> s), ye((y + ysize - 1) >> s);
+            for (auto j(y >> s); j <= ye; ++j) {
+                for (auto i(x >> s); i <= xe; ++i) {
+                    valid[j * size + i] = true;
+                }
+            }
+        });
+    }
+
+    return valid;
+}
+
+std::vector<char> windowValidSubtree(const mmapped::TileIndex &tileIndex
+                                     , vts::Lod lod, unsigned int shift
+                                     , unsigned int wx, unsigned int wy)
+{
+    return tileIndex.rangeValidSubtree
+        (lod, vts::TileRange(wx << shift, wy << shift
+                             , ((wx + 1) << shift) - 1
+                             , ((wy + 1) << shift) - 1));
+}
+
+/** Subtree validity of all children of metatile's tiles, computed by a single
+ *  traversal of each tile index tree below metatile's lod instead of
+ *  validSubtree for every child.
+ */
+class SubtreeValidity {
+public:
+    template <typename TileIndexType>
+    SubtreeValidity(const TileIndexType &tileIndex, const vts::TileId &tileId
+                    , unsigned int metaBinaryOrder);
+
+    /** Validity of subtree starting at given child of metatile's tile.
+     */
+    bool operator()(const vts::TileId &child) const {
+        const auto x(child.x - origin_.x), y(child.y - origin_.y);
+        if ((child.lod != origin_.lod) || (x >= size_) || (y >= size_)) {
+            // should not happen
+            return false;
+        }
+        return valid_[y * size_ + x];
+    }
+
+private:
+    vts::TileId origin_;
+    unsigned int size_;
+    std::vector<char> valid_;
+};
+
+template <typename TileIndexType>
+SubtreeValidity::SubtreeValidity(const TileIndexType &tileIndex
+                                 , const vts::TileId &tileId
+                                 , unsigned int metaBinaryOrder)
+{
+    // children lod and depth of subtree covering all children
+    const vts::Lod lod(tileId.lod + 1);
+    const unsigned int shift(std::min(metaBinaryOrder + 1, unsigned(lod)));
+    const unsigned int wx((tileId.x << 1) >> shift);
+    const unsigned int wy((tileId.y << 1) >> shift);
+
+    size_ = (1 << shift);
+    origin_ = vts::TileId(lod, wx << shift, wy << shift);
+    valid_ = windowValidSubtree(tileIndex, lod, shift, wx, wy);
+}
+
+/** Generated metanodes of one metatile block.
+ */
+typedef std::vector<std::pair<vts::TileId, vts::MetaNode>> MetaNodes;
+
+/** Processes one warped block.
+ */
+typedef std::function<MetaNodes(const MetatileBlock &block
+                                , const GdalWarper::Raster &dem)>
+    BlockProcessor;
+
+/** Concurrent processing of metatile blocks.
+ *
+ *  All warps are issued at once; warped block is processed by whoever comes
+ *  first: a task posted to the core pool or the requesting thread itself.
+ *  Requesting thread never waits for work it could do itself, i.e. it cannot
+ *  deadlock on exhausted pool.
+ */
+class ParallelBlocks : public std::enable_shared_from_this<ParallelBlocks> {
+public:
+    typedef std::shared_ptr<ParallelBlocks> pointer;
+    typedef std::vector<const MetatileBlock*> Blocks;
+    typedef std::function<GdalWarper::RasterRequest(const MetatileBlock&)>
+        Request;
+
+    /** Processes all blocks, returns generated nodes in block order.
+     */
+    static std::vector<MetaNodes>
+    run(const Blocks &blocks, const Request &request
+        , const BlockProcessor &processor, Sink &sink, Arsenal &arsenal);
+
+    ParallelBlocks(const Blocks &blocks, const BlockProcessor &processor
+                   , const Sink &sink, const Arsenal &arsenal)
+        : processor_(processor), sink_(sink), arsenal_(arsenal)
+        , jobs_(blocks.size()), pending_(blocks.size())
+    {
+        for (std::size_t i(0); i < blocks.size(); ++i) {
+            jobs_[i].block = blocks[i];
+        }
+    }
+
+private:
+    struct Job {
+        enum class State { warping, warped, claimed, done };
+
+        const MetatileBlock *block = nullptr;
+        State state = State::warping;
+        GdalWarper::Raster dem;
+        MetaNodes nodes;
+        std::exception_ptr error;
+    };
+
+    /** Called from warper completion callback.
+     */
+    void warped(std::size_t index, const GdalWarper::Raster &dem
+                , const std::exception_ptr &error);
+
+    /** Marks job as done with given error. Lock must be held.
+     */
+    void fail(Job &job, const std::exception_ptr &error);
+
+    /** Processes job if not claimed by anybody else.
+     */
+    void tryProcess(std::size_t index);
+
+    /** Processes claimed job.
+     */
+    void process(Job &job);
+
+    /** Processes any warped job or waits until everything is done.
+     */
+    void wait();
+
+    const BlockProcessor processor_;
+    Sink sink_;
+    Arsenal arsenal_;
+
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::vector<Job> jobs_;
+    std::size_t pending_;
+};
+
+void ParallelBlocks::fail(Job &job, const std::exception_ptr &error)
+{
+    job.state = Job::State::done;
+    job.error = error;
+    job.dem.reset();
+    --pending_;
+}
+
+void ParallelBlocks::warped(std::size_t index, const GdalWarper::Raster &dem
+                            , const std::exception_ptr &error)
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        auto &job(jobs_[index]);
+        if (error) {
+            fail(job, error);
+        } else {
+            job.dem = dem;
+            job.state = Job::State::warped;
+        }
+    }
+    cond_.notify_all();
+
+    // completion callback must not block: offload processing to core pool
+    if (error || !arsenal_.pooled()) { return; }
+
+    try {
+        auto self(shared_from_this());
+        arsenal_.post([self, index](Sink&, Arsenal&)
+        {
+            self->tryProcess(index);
+        }, sink_);
+    } catch (...) {
+        // cannot post, requesting thread processes the block
+    }
+}
+
+void ParallelBlocks::tryProcess(std::size_t index)
+{
+    auto &job(jobs_[index]);
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (job.state != Job::State::warped) { return; }
+        job.state = Job::State::claimed;
+    }
+
+    process(job);
+}
+
+void ParallelBlocks::process(Job &job)
+{
+    MetaNodes nodes;
+    std::exception_ptr error;
+    try {
+        nodes = processor_(*job.block, job.dem);
+    } catch (...) {
+        error = std::current_exception();
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (error) {
+            fail(job, error);
+        } else {
+            job.nodes = std::move(nodes);
+            job.state = Job::State::done;
+            job.dem.reset();
+            --pending_;
+        }
+    }
+    cond_.notify_all();
+}
+
+void ParallelBlocks::wait()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (pending_) {
+        auto fjobs(std::find_if(jobs_.begin(), jobs_.end()
+                                , [](const Job &job)
+        {
+            return job.state == Job::State::warped;
+        }));
+
+        if (fjobs == jobs_.end()) {
+            // nothing to do, wait for warper or pool
+            cond_.wait(lock);
+            continue;
+        }
+
+        // process block ourselves
+        fjobs->state = Job::State::claimed;
+        lock.unlock();
+        process(*fjobs);
+        lock.lock();
+    }
+}
+
+std::vector<MetaNodes>
+ParallelBlocks::run(const Blocks &blocks, const Request &request
+                    , const BlockProcessor &processor, Sink &sink
+                    , Arsenal &arsenal)
+{
+    const auto pb(std::make_shared<ParallelBlocks>
+                  (blocks, processor, sink, arsenal));
+
+    // issue all warps
+    for (std::size_t i(0); i < blocks.size(); ++i) {
+        try {
+            arsenal.warper.warp
+                (request(*blocks[i]), sink
+                 , [pb, i](const GdalWarper::Raster &dem
+                           , const std::exception_ptr &error)
+            {
+                pb->warped(i, dem, error);
+            });
+        } catch (...) {
+            // nothing issued for rest of blocks
+            const auto error(std::current_exception());
+            std::unique_lock<std::mutex> lock(pb->mutex_);
+            for (std::size_t j(i); j < blocks.size(); ++j) {
+                pb->fail(pb->jobs_[j], error);
+            }
+            break;
+        }
+    }
+
+    // process and wait for everything issued so far, even on failure
+    pb->wait();
+
+    std::vector<MetaNodes> out;
+    out.reserve(blocks.size());
+    for (auto &job : pb->jobs_) {
+        if (job.error) { std::rethrow_exception(job.error); }
+        out.push_back(std::move(job.nodes));
+    }
+    return out;
+}
+
 template <typename TileIndexType>
 vts::MetaTile
 metatileFromDemImpl(const vts::TileId &tileId, Sink &sink, Arsenal &arsenal
@@ -201,6 +572,9 @@ metatileFromDemImpl(const vts::TileId &tileId, Sink &sink, Arsenal &arsenal
 
     const auto credits(overrides.mergedCredits(resource.credits));
 
+    // subtree validity of all children in all blocks
+    const SubtreeValidity validSubtree(tileIndex, tileId, rf.metaBinaryOrder);
+
     auto setChildren([&](const MetatileBlock &block
                          , const vts::TileId &nodeId, vts::MetaNode &node)
                      -> void
@@ -209,15 +583,13 @@ metatileFromDemImpl(const vts::TileId &tileId, Sink &sink, Arsenal &arsenal
          * (i.e. melown2015 polar caps)
          *
          * Combine tile index with node validity.
-         *
-         * TODO: optimize
          */
 
         if (!block.commonAncestor.partial()) {
             // fully covered RF subtree: just copy tileindex subtree validity
 
             for (const auto &child : vts::children(nodeId)) {
-                node.setChildFromId(child, tileIndex.validSubtree(child));
+                node.setChildFromId(child, validSubtree(child));
             }
             return;
         }
@@ -228,8 +600,7 @@ metatileFromDemImpl(const vts::TileId &tileId, Sink &sink, Arsenal &arsenal
 
         // check tileindex along with RF validity for each child
         for (const auto &child : vts::children(nodeId)) {
-            bool valid(tileIndex.validSubtree(child)
-                       && ni.child(child).valid());
+            bool valid(validSubtree(child) && ni.child(child).valid());
             node.setChildFromId(child, valid);
         }
     });
@@ -238,6 +609,8 @@ metatileFromDemImpl(const vts::TileId &tileId, Sink &sink, Arsenal &arsenal
                                        , const math::Size2 &bSize) -> void
     {
         const auto &view(block.view);
+        const auto flags(rangeFlags(tileIndex, tileId.lod, view));
+        auto iflags(flags.begin());
         for (int j(0), je(bSize.height); j < je; ++j) {
             for (int i(0), ie(bSize.width); i < ie; ++i) {
                 // ID of current tile
@@ -246,28 +619,24 @@ metatileFromDemImpl(const vts::TileId &tileId, Sink &sink, Arsenal &arsenal
 
                 // build metanode
                 vts::MetaNode node;
-                node.flags(ti2metaFlags(tileIndex.get(nodeId)));
+                node.flags(ti2metaFlags(*iflags++));
                 setChildren(block, nodeId, node);
                 metatile.set(nodeId, node);
             }
         }
     });
 
-    for (const auto &block : blocks) {
-        const auto &view(block.view);
-        auto extents = block.extents;
-        const auto es(math::size(extents));
-        const math::Size2 bSize(vts::tileRangesSize(view));
-
-        if (!block.commonAncestor.productive()) {
-            // unproductive node
-            generateUnproductiveNodes(block, bSize);
-            continue;
-        }
+    auto blockGridSize([&](const MetatileBlock &block) -> math::Size2
+    {
+        const math::Size2 bSize(vts::tileRangesSize(block.view));
+        return math::Size2(bSize.width * metatileSamplesPerTile + 1
+                           , bSize.height * metatileSamplesPerTile + 1);
+    });
 
-        const math::Size2 gridSize
-            (bSize.width * metatileSamplesPerTile + 1
-             , bSize.height * metatileSamplesPerTile + 1);
+    auto warpRequest([&](const MetatileBlock &block)
+                     -> GdalWarper::RasterRequest
+    {
+        const auto gs(blockGridSize(block));
 
         LOG(info1) << "Processing metatile block ["
                    << vts::tileId(tileId.lod, block.view.ll)
@@ -291,16 +660,28 @@ metatileFromDemImpl(const vts::TileId &tileId, Sink &sink, Arsenal &arsenal
         const auto resampling(geo::GeoDataset::Resampling::dem);
 #endif
 
-        auto dem(arsenal.warper.warp
-                 (GdalWarper::RasterRequest
-                  (GdalWarper::RasterRequest::Operation::valueMinMax
-                   , demDataset
-                   , vr::system.srs(block.srs).srsDef
-                   // add half pixel to warp in grid coordinates
-                   , extentsPlusHalfPixel
-                   (extents, { gridSize.width - 1, gridSize.height - 1 })
-                   , gridSize, resampling)
-                  , sink));
+        return GdalWarper::RasterRequest
+            (GdalWarper::RasterRequest::Operation::valueMinMaxFloat
+             , demDataset
+             , vr::system.srs(block.srs).srsDef
+             // add half pixel to warp in grid coordinates
+             , extentsPlusHalfPixel
+             (block.extents, { gs.width - 1, gs.height - 1 })
+             , gs, resampling)
+            .setDemFastRatio(overrides.demFastRatio);
+    });
+
+    // processes warped block; runs concurrently, must not touch metatile
+    auto processBlock([&](const MetatileBlock &block
+                          , const GdalWarper::Raster &dem) -> MetaNodes
+    {
+        const auto &view(block.view);
+        const auto &extents(block.extents);
+        const auto es(math::size(extents));
+        const math::Size2 bSize(vts::tileRangesSize(view));
+        const auto gridSize(blockGridSize(block));
+
+        MetaNodes nodes;
 
         sink.checkAborted();
 
@@ -341,10 +722,8 @@ metatileFromDemImpl(const vts::TileId &tileId, Sink &sink, Arsenal &arsenal
             }
         }
 
-        // release shared data
-        dem.reset();
-
         // generate metatile content
+        const auto flags(rangeFlags(tileIndex, tileId.lod, view));
         for (int j(0), je(bSize.height); j < je; ++j) {
             for (int i(0), ie(bSize.width); i < ie; ++i) {
                 // ID of current tile
@@ -353,7 +732,7 @@ metatileFromDemImpl(const vts::TileId &tileId, Sink &sink, Arsenal &arsenal
 
                 // build metanode
                 vts::MetaNode node;
-                node.flags(ti2metaFlags(tileIndex.get(nodeId)));
+                node.flags(ti2metaFlags(flags[j * bSize.width + i]));
                 bool geometry(node.geometry());
                 bool navtile(node.navtile());
 
@@ -464,9 +843,32 @@ metatileFromDemImpl(const vts::TileId &tileId, Sink &sink, Arsenal &arsenal
                 }
 
                 // store metata node
-                metatile.set(nodeId, node);
+                nodes.emplace_back(nodeId, node);
             }
         }
+
+        return nodes;
+    });
+
+    // unproductive blocks are generated in place, productive ones are warped
+    // and processed in parallel
+    ParallelBlocks::Blocks productive;
+    for (const auto &block : blocks) {
+        if (!block.commonAncestor.productive()) {
+            generateUnproductiveNodes
+                (block, math::Size2(vts::tileRangesSize(block.view)));
+            continue;
+        }
+        productive.push_back(&block);
+    }
+
+    for (const auto &nodes : ParallelBlocks::run(productive, warpRequest
+                                                 , processBlock, sink
+                                                 , arsenal))
+    {
+        for (const auto &node : nodes) {
+            metatile.set(node.first, node.second);
+        }
     }
 
     return metatile;
@@ -508,3 +910,74 @@ metatileFromDem(const vts::TileId &tileId, Sink &sink, Arsenal &arsenal
                                , heightFunction, overrides);
 
 }
+
+MetatileCache::MetatileCache(std::size_t limit)
+    : limit_(std::max(limit, std::size_t(1))), clock_()
+{}
+
+MetatileCache::pointer
+MetatileCache::operator()(unsigned int revision, const vts::TileId &tileId
+                          , const MetatileOverrides &overrides
+                          , const Generate &generate)
+{
+    std::string key(utility::format
+                    ("%d:%s:%d:%d", revision, tileId
+                     , int(overrides.textureMode)
+                     , int(overrides.creditsMode)));
+    for (const auto &credit : overrides.credits) {
+        key.push_back(':');
+        key.append(credit.id);
+    }
+
+    std::promise<pointer> promise;
+    std::shared_future<pointer> future;
+    bool leader(false);
+
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        auto fentries(entries_.find(key));
+        if (fentries == entries_.end()) {
+            // drop least recently used metatile
+            if (entries_.size() >= limit_) {
+                entries_.erase(std::min_element
+                               (entries_.begin(), entries_.end()
+                                , [](const Entries::value_type &l
+                                     , const Entries::value_type &r)
+                {
+                    return l.second.used < r.second.used;
+                }));
+            }
+
+            future = promise.get_future().share();
+            entries_[key] = { future, ++clock_ };
+            leader = true;
+        } else {
+            fentries->second.used = ++clock_;
+            future = fentries->second.metatile;
+        }
+    }
+
+    if (!leader) {
+        try {
+            return future.get();
+        } catch (const RequestAborted&) {
+            // client of the original request gave up; generate on our own
+            return std::make_shared<const vts::MetaTile>(generate());
+        }
+    }
+
+    try {
+        const pointer metatile(std::make_shared<const vts::MetaTile>
+                               (generate()));
+        promise.set_value(metatile);
+        return metatile;
+    } catch (...) {
+        // do not cache failures
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            entries_.erase(key);
+        }
+        promise.set_exception(std::current_exception());
+        throw;
+    }
+}
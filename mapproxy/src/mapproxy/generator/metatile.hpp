@@ -27,6 +27,14 @@
 #ifndef mapproxy_metatile_hpp_included_
 #define mapproxy_metatile_hpp_included_
 
+#include <map>
+#include <mutex>
+#include <future>
+#include <memory>
+#include <string>
+#include <cstdint>
+#include <functional>
+
 #include "vts-libs/vts/tileindex.hpp"
 #include "vts-libs/vts/metatile.hpp"
 
@@ -44,6 +52,13 @@ struct MetatileOverrides {
     DualId::set credits;
     CreditsMode creditsMode = CreditsMode::add;
 
+    /** Fast DEM resampling of the metatile DEM warp (see
+     *  GdalWarper::RasterRequest::demFastRatio). Set by the generator from
+     *  its definition; not part of the cache key since its change bumps
+     *  revision.
+     */
+    boost::optional<double> demFastRatio;
+
     MetatileOverrides() = default;
     MetatileOverrides(vts::SubMesh::TextureMode textureMode)
         : textureMode(textureMode)
@@ -82,6 +97,43 @@ vts::MetaTile metatileFromDem(const vts::TileId &tileId, Sink &sink
                               = HeightFunction::pointer()
                               , const MetatileOverrides &overrides = {});
 
+/** Cache of generated metatiles.
+ *
+ *  Metatiles gate all rendering and are requested far more often than
+ *  individual tiles (navtiles are derived from them as well). Entries are
+ *  keyed by resource revision, metatile ID and overrides, i.e. revision bump
+ *  invalidates all. Concurrent requests for the same metatile wait for the
+ *  first one.
+ */
+class MetatileCache {
+public:
+    typedef std::shared_ptr<const vts::MetaTile> pointer;
+    typedef std::function<vts::MetaTile()> Generate;
+
+    /** At most limit metatiles are held.
+     */
+    MetatileCache(std::size_t limit = 256);
+
+    /** Returns cached metatile or generates new one by given function.
+     */
+    pointer operator()(unsigned int revision, const vts::TileId &tileId
+                       , const MetatileOverrides &overrides
+                       , const Generate &generate);
+
+private:
+    struct Entry {
+        std::shared_future<pointer> metatile;
+        std::uint64_t used;
+    };
+    typedef std::map<std::string, Entry> Entries;
+
+    const std::size_t limit_;
+
+    std::mutex mutex_;
+    Entries entries_;
+    std::uint64_t clock_;
+};
+
 // inines
 
 inline DualId::set
@@ -0,0 +1,192 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <algorithm>
+
+#include "vts-libs/vts/tileop.hpp"
+
+#include "../error.hpp"
+
+#include "rasterblockcache.hpp"
+
+boost::optional<SiblingBlock>
+siblingBlock(const vr::ReferenceFrame &referenceFrame
+             , const vts::TileId &tileId, const vts::NodeInfo &nodeInfo)
+{
+    if (!tileId.lod) { return boost::none; }
+
+    const auto parentId(vts::parent(tileId));
+    vts::NodeInfo parent(referenceFrame, parentId);
+    if (!parent.valid() || (parent.srs() != nodeInfo.srs())) {
+        // parent lives in different subtree, children are not its quadrants
+        return boost::none;
+    }
+
+    return SiblingBlock
+        { parentId, parent.extents()
+        , std::size_t(((tileId.y & 1) << 1) | (tileId.x & 1)) };
+}
+
+RasterBlockCache::RasterBlockCache(Clock::duration ttl, std::size_t limit)
+    : ttl_(ttl), limit_(std::max(limit, std::size_t(1)))
+{}
+
+void RasterBlockCache::purge(const Clock::time_point &now)
+{
+    for (auto ientries(entries_.begin()); ientries != entries_.end(); ) {
+        if ((now - ientries->second.created) > ttl_) {
+            ientries = entries_.erase(ientries);
+        } else {
+            ++ientries;
+        }
+    }
+
+    while (entries_.size() >= limit_) {
+        auto oldest(std::min_element
+                    (entries_.begin(), entries_.end()
+                     , [](const Entries::value_type &l
+                          , const Entries::value_type &r)
+        {
+            return l.second.created < r.second.created;
+        }));
+        entries_.erase(oldest);
+    }
+}
+
+GdalWarper::Raster RasterBlockCache::find(const std::string &key
+                                          , std::size_t index)
+{
+    std::shared_future<GdalWarper::Rasters> future;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        auto fentries(entries_.find(key));
+        if (fentries == entries_.end()) { return {}; }
+        if ((Clock::now() - fentries->second.created) > ttl_) { return {}; }
+        future = fentries->second.rasters;
+    }
+
+    if (future.wait_for(std::chrono::seconds(0))
+        != std::future_status::ready)
+    {
+        // still being warped
+        return {};
+    }
+
+    try {
+        const auto &rasters(future.get());
+        if (index >= rasters.size()) { return {}; }
+        return rasters[index];
+    } catch (...) {
+        // failed warp, caller warps on its own
+        return {};
+    }
+}
+
+void RasterBlockCache::put(const std::string &key
+                           , const GdalWarper::Rasters &rasters)
+{
+    std::promise<GdalWarper::Rasters> promise;
+    promise.set_value(rasters);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    purge(Clock::now());
+    entries_[key] = { promise.get_future().share(), Clock::now() };
+}
+
+std::size_t RasterBlockCache::memory()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    std::size_t size(0);
+    for (const auto &item : entries_) {
+        const auto &future(item.second.rasters);
+        if (future.wait_for(std::chrono::seconds(0))
+            != std::future_status::ready)
+        {
+            continue;
+        }
+
+        try {
+            // slices share the block, count the memory they cover
+            for (const auto &raster : future.get()) {
+                if (raster) { size += raster->total() * raster->elemSize(); }
+            }
+        } catch (...) {}
+    }
+    return size;
+}
+
+GdalWarper::Raster RasterBlockCache::operator()(const std::string &key
+                                                , std::size_t index
+                                                , const Warp &warp)
+{
+    std::promise<GdalWarper::Rasters> promise;
+    std::shared_future<GdalWarper::Rasters> future;
+    bool leader(false);
+
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        auto fentries(entries_.find(key));
+        if (fentries == entries_.end()) {
+            purge(Clock::now());
+            future = promise.get_future().share();
+            entries_[key] = { future, Clock::now() };
+            leader = true;
+        } else {
+            future = fentries->second.rasters;
+        }
+    }
+
+    const auto pick([&](const GdalWarper::Rasters &rasters)
+    {
+        if (index >= rasters.size()) {
+            throw std::logic_error("Raster block index out of range.");
+        }
+        return rasters[index];
+    });
+
+    if (!leader) {
+        try {
+            return pick(future.get());
+        } catch (const RequestAborted&) {
+            // client of the original request gave up; warp on our own
+            return pick(warp());
+        }
+    }
+
+    try {
+        auto rasters(warp());
+        promise.set_value(rasters);
+        return pick(rasters);
+    } catch (...) {
+        // do not cache failures
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            entries_.erase(key);
+        }
+        promise.set_exception(std::current_exception());
+        throw;
+    }
+}
@@ -0,0 +1,124 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef mapproxy_generator_rasterblockcache_hpp_included_
+#define mapproxy_generator_rasterblockcache_hpp_included_
+
+#include <map>
+#include <string>
+#include <mutex>
+#include <future>
+#include <chrono>
+#include <functional>
+
+#include <boost/optional.hpp>
+
+#include "vts-libs/vts/nodeinfo.hpp"
+
+#include "../gdalsupport.hpp"
+
+namespace vts = vtslibs::vts;
+namespace vr = vtslibs::registry;
+
+/** Block of 2x2 siblings the tile belongs to.
+ */
+struct SiblingBlock {
+    /** Parent tile, i.e. the whole block. */
+    vts::TileId parentId;
+
+    /** Extents of the whole block. */
+    math::Extents2 extents;
+
+    /** Row-major index of the tile in the block. */
+    std::size_t index;
+};
+
+/** Returns sibling block of given tile or nothing if tile cannot be batched
+ *  with its siblings (root tile, parent in different SRS).
+ */
+boost::optional<SiblingBlock>
+siblingBlock(const vr::ReferenceFrame &referenceFrame
+             , const vts::TileId &tileId, const vts::NodeInfo &nodeInfo);
+
+/** Short-lived cache of batch-warped sibling tiles.
+ *
+ *  Clients ask for sibling tiles at almost the same time. First request for
+ *  any tile in a block warps the whole block in a single pass (see
+ *  GdalWarper::warpBatch), following requests pick their slices from the
+ *  cache. Concurrent requests for the same block wait for the first one.
+ *
+ *  Also holds other short-lived results worth reusing by a request that is
+ *  likely to arrive shortly (see put()).
+ */
+class RasterBlockCache {
+public:
+    typedef std::chrono::steady_clock Clock;
+    typedef std::function<GdalWarper::Rasters()> Warp;
+
+    /** Blocks are kept for ttl, at most limit blocks are held.
+     */
+    RasterBlockCache(Clock::duration ttl = std::chrono::seconds(10)
+                     , std::size_t limit = 32);
+
+    /** Returns slice at given index of block identified by key. Block is
+     *  warped by given function if not cached.
+     */
+    GdalWarper::Raster operator()(const std::string &key, std::size_t index
+                                  , const Warp &warp);
+
+    /** Returns slice at given index of block identified by key if the block
+     *  is already warped. Never waits nor warps, returns null otherwise.
+     */
+    GdalWarper::Raster find(const std::string &key, std::size_t index);
+
+    /** Stores already warped block under given key.
+     */
+    void put(const std::string &key, const GdalWarper::Rasters &rasters);
+
+    /** Bytes held by warped blocks.
+     */
+    std::size_t memory();
+
+private:
+    struct Entry {
+        std::shared_future<GdalWarper::Rasters> rasters;
+        Clock::time_point created;
+    };
+    typedef std::map<std::string, Entry> Entries;
+
+    /** Drops expired blocks and oldest blocks over the limit. Must be called
+     *  under lock.
+     */
+    void purge(const Clock::time_point &now);
+
+    const Clock::duration ttl_;
+    const std::size_t limit_;
+
+    std::mutex mutex_;
+    Entries entries_;
+};
+
+#endif // mapproxy_generator_rasterblockcache_hpp_included_
@@ -25,6 +25,8 @@
  */
 
 #include <new>
+#include <cmath>
+#include <algorithm>
 
 #include <boost/filesystem.hpp>
 #include <boost/format.hpp>
@@ -34,6 +36,7 @@
 
 #include "utility/premain.hpp"
 #include "utility/raise.hpp"
+#include "utility/format.hpp"
 #include "utility/path.hpp"
 
 #include "geometry/mesh.hpp"
@@ -51,6 +54,7 @@
 #include "vts-libs/registry/py.hpp"
 #include "vts-libs/vts/io.hpp"
 #include "vts-libs/vts/nodeinfo.hpp"
+#include "vts-libs/vts/tileop.hpp"
 #include "vts-libs/vts/tileset/config.hpp"
 #include "vts-libs/vts/metatile.hpp"
 #include "vts-libs/vts/csconvertor.hpp"
@@ -64,9 +68,16 @@
 #include "../support/mesh.hpp"
 #include "../support/srs.hpp"
 #include "../support/geo.hpp"
+#include "../support/preparedstate.hpp"
 #include "../support/grid.hpp"
 #include "../support/coverage.hpp"
 #include "../support/tileindex.hpp"
+#include "../support/rtin.hpp"
+#include "../support/landcover.hpp"
+#include "../support/scratch.hpp"
+#include "../support/normalmap.hpp"
+#include "../support/demgeoid.hpp"
+#include "../support/compression.hpp"
 
 #include "surface-dem.hpp"
 #include "factory.hpp"
@@ -83,12 +94,35 @@ namespace {
 
 unsigned int GeneratorRevision(2);
 
+const char *DemComplements[] = { "", ".min", ".max" };
+
+/** DEM served by the generator: geoid-baked copy lives in the store and has
+ *  no geoid grid attached.
+ */
+DemDataset servedDem(const resource::SurfaceDem &def, const fs::path &root
+                     , const DemDataset &source)
+{
+    if (!def.bakeGeoid || !source.geoidGrid) { return source; }
+    return DemDataset((root / "ellipsoidal" / "dem").string());
+}
+
+/** Gap-filled DEM in the store, if configured.
+ */
+boost::optional<std::string> filledDem(const resource::SurfaceDem &def
+                                       , const fs::path &root)
+{
+    if (!def.fillGaps) { return boost::none; }
+    return (root / "filled" / "dem").string();
+}
+
 struct Factory : Generator::Factory {
     virtual Generator::pointer create(const Generator::Params &params)
     {
         return std::make_shared<SurfaceDem>(params);
     }
 
+    virtual bool deliveryIndex() const { return true; }
+
 private:
     static utility::PreMain register_;
 };
@@ -103,9 +137,14 @@ utility::PreMain Factory::register_([]()
 SurfaceDem::SurfaceDem(const Params &params)
     : SurfaceBase(params)
     , definition_(resource().definition<Definition>())
-    , dem_(absoluteDataset(definition_.dem.dataset + "/dem")
-           , definition_.dem.geoidGrid)
+    , sourceDem_(absoluteDataset(definition_.dem.dataset + "/dem")
+                 , definition_.dem.geoidGrid)
+    , dem_(servedDem(definition_, root(), sourceDem_))
+    , filledDem_(filledDem(definition_, root()))
     , maskTree_(absoluteDatasetRf(definition_.mask))
+    , gsdArea_()
+    , pyramidCache_(std::chrono::seconds(60), 64)
+    , navtileCache_(std::chrono::seconds(10), 16)
 {
     if (definition_.landcover) {
         landcover_.emplace(
@@ -116,7 +155,7 @@ SurfaceDem::SurfaceDem(const Params &params)
 
     bool success = true;
 
-    if (loadFiles(definition_)) {
+    if (geoidBaked() && gapsFilled() && loadFiles(definition_)) {
 
         // remember dem in registry
         addToRegistry();
@@ -134,6 +173,15 @@ SurfaceDem::SurfaceDem(const Params &params)
         success = false;
     }
 
+    if (success) {
+        try {
+            prepareDemPyramid();
+        } catch (const std::exception &e) {
+            // not ready
+            success = false;
+        }
+    }
+
     if (success) makeReady();
 }
 
@@ -142,6 +190,115 @@ SurfaceDem::~SurfaceDem()
     removeFromRegistry();
 }
 
+void SurfaceDem::prepareDemPyramid(const boost::optional<EffectiveGsd> &probed)
+{
+    PreparedState state(root(), resource());
+    const auto gsd(probed ? effectiveGsd(state, dem_.dataset, *probed)
+                   : effectiveGsd(state, dem_.dataset));
+    state.save();
+    gsdArea_ = gsd.area;
+
+    LOG(info2)
+        << "<" << id() << ">: using "
+        << (gsd.computed ? "computed" : "configured")
+        << " effective GSD area of " << dem_.dataset << ": "
+        << gsdArea_ << " m2.";
+
+    srsScale_.clear();
+    for (const auto &node : referenceFrame().division.nodes) {
+        const auto &srs(node.second.srs);
+        if (srsScale_.count(srs)) { continue; }
+        srsScale_[srs] = srsUnitScale(vr::system.srs(srs).srsDef);
+    }
+
+    reprojected_ = {};
+    if (definition_.reprojectedMaxLod) {
+        reprojected_ = ReprojectedPyramids
+            (dem_.dataset, referenceFrame(), *definition_.reprojectedMaxLod);
+    }
+}
+
+bool SurfaceDem::geoidBaked() const
+{
+    if (dem_.dataset == sourceDem_.dataset) { return true; }
+    for (const auto *suffix : DemComplements) {
+        if (!fs::exists(dem_.dataset + suffix)) { return false; }
+    }
+    return true;
+}
+
+Generator::Warmup SurfaceDem::warmup_impl() const
+{
+    auto warmup(SurfaceBase::warmup_impl());
+    warmup.datasets.push_back(dem_.dataset);
+    if (filledDem_) {
+        warmup.datasets.push_back(*filledDem_);
+        warmup.datasets.push_back(*filledDem_ + DemValiditySuffix);
+    }
+    if (landcover_) { warmup.datasets.push_back(landcover_->dataset); }
+    warmup.prefaulted += maskTree_.prefault();
+    return warmup;
+}
+
+void SurfaceDem::memory_impl(Memory &memory) const
+{
+    SurfaceBase::memory_impl(memory);
+    memory.add("maskTree", maskTree_);
+    if (lcClassdef_) { memory.add("landcover", lcClassdef_->memory()); }
+    memory.add("rasterCache", blockCache_.memory() + pyramidCache_.memory()
+               + navtileCache_.memory());
+}
+
+void SurfaceDem::bakeGeoid()
+{
+    if (dem_.dataset == sourceDem_.dataset) { return; }
+
+    // rebaked whenever the source changes (or definition, see PreparedState)
+    PreparedState state(root(), resource());
+    for (const auto *suffix : DemComplements) {
+        const auto src(sourceDem_.dataset + suffix);
+        const auto dst(dem_.dataset + suffix);
+
+        bool baked(false);
+        const auto bake([&]() -> Json::Value
+        {
+            ::bakeGeoid(src, *sourceDem_.geoidGrid, dst);
+            baked = true;
+            return dst;
+        });
+
+        state.get(std::string("bakedGeoid") + suffix, { src }, bake);
+        if (!baked && !fs::exists(dst)) { bake(); }
+    }
+    state.save();
+}
+
+bool SurfaceDem::gapsFilled() const
+{
+    if (!filledDem_) { return true; }
+    return (fs::exists(*filledDem_)
+            && fs::exists(*filledDem_ + DemValiditySuffix));
+}
+
+void SurfaceDem::fillGaps()
+{
+    if (!filledDem_) { return; }
+
+    // refilled whenever the DEM changes (or definition, see PreparedState)
+    PreparedState state(root(), resource());
+    bool filled(false);
+    const auto fill([&]() -> Json::Value
+    {
+        ::fillDemGaps(dem_.dataset, *definition_.fillGaps, *filledDem_);
+        filled = true;
+        return *filledDem_;
+    });
+
+    state.get("filledGaps", { dem_.dataset }, fill);
+    if (!filled && !gapsFilled()) { fill(); }
+    state.save();
+}
+
 void SurfaceDem::loadLandcoverClassdef() {
 
     Json::Value jclasses;
@@ -158,26 +315,36 @@ void SurfaceDem::loadLandcoverClassdef() {
                 landcover_->classdef, e.what());
     }
 
-    lcClassdef_ = geo::landcover::fromJson(jclasses);
+    lcClassdef_ = std::make_shared<landcover::ClassLut>
+        (geo::landcover::fromJson(jclasses));
+    lcClassdefKey_ = landcover::classdefKey(landcover_->classdef);
 }
 
 
-void SurfaceDem::prepare_impl(Arsenal&)
+void SurfaceDem::prepare_impl(Arsenal &arsenal)
 {
     LOG(info2) << "Preparing <" << id() << ">.";
 
     const auto &r(resource());
 
-    // try to open datasets
-    auto dataset(geo::GeoDataset::open(dem_.dataset));
-    auto datasetMin(geo::GeoDataset::open(dem_.dataset + ".min"));
-    auto datasetMax(geo::GeoDataset::open(dem_.dataset + ".max"));
+    // ellipsoidal copy of DEM, if configured
+    bakeGeoid();
 
-    // open optional landcover dataset + load lc class definition
-    if (landcover_) {
-        auto lcDataset(geo::GeoDataset::open(landcover_->dataset));
-        loadLandcoverClassdef();
-    }
+    // gap-filled copy of DEM, if configured
+    fillGaps();
+
+    // try to open datasets (in a worker, see GdalWarper::probe)
+    std::vector<std::string> datasets
+        { dem_.dataset, dem_.dataset + ".min", dem_.dataset + ".max" };
+    if (landcover_) { datasets.push_back(landcover_->dataset); }
+
+    Aborter aborter;
+    const auto probes(arsenal.warper.probe(datasets, aborter));
+
+    prepareDemPyramid(probes.front().effectiveGsd);
+
+    // load lc class definition
+    if (landcover_) { loadLandcoverClassdef(); }
 
     // build properties
     properties_ = {};
@@ -229,7 +396,9 @@ void SurfaceDem::prepare_impl(Arsenal&)
 
         // open delivery index
         index_ = boost::in_place(referenceFrame().metaBinaryOrder
-                                 , deliveryIndexPath);
+                                 , deliveryIndexPath
+                                 , config().denseTileIndexLods
+                                 , config().indexMapPolicy);
     }
 
     addToRegistry();
@@ -261,12 +430,14 @@ void SurfaceDem::removeFromRegistry()
 vts::MapConfig SurfaceDem::mapConfig_impl(ResourceRoot root) const
 {
     const auto path(prependRoot(fs::path(), resource(), root));
+    // metadata may change, see Generator::updateMetadata
+    const auto &def(resource().definition<Definition>());
 
     auto mc(vts::mapConfig
-            (properties_, resource().registry, extraProperties(definition_)
+            (properties_, resource().registry, extraProperties(def)
              , path));
 
-    if (!definition_.introspection.position) {
+    if (!def.introspection.position) {
         // no introspection position, generate some
 
         // look down
@@ -302,21 +473,27 @@ void SurfaceDem::generateMetatile(const vts::TileId &tileId
     auto metatile(generateMetatileImpl(tileId, sink, arsenal, overrides));
 
     // write metatile to stream
-    std::ostringstream os;
-    metatile.save(os);
-    sink.content(os.str(), fi.sinkFileInfo());
+    const auto os(OutputBuffer::create());
+    metatile->save(*os);
+    compression::send(sink, compression::Target::metatile
+                      , os->data(), os->size(), fi.sinkFileInfo()
+                      , fi.fileInfo.acceptGzip, os);
 }
 
-vts::MetaTile
+MetatileCache::pointer
 SurfaceDem::generateMetatileImpl(const vts::TileId &tileId
                                  , Sink &sink, Arsenal &arsenal
                                  , const MetatileOverrides &overrides) const
 {
-    return metatileFromDem(tileId, sink, arsenal, resource()
-                           , index_->tileIndex, dem_.dataset
-                           , dem_.geoidGrid, maskTree_, boost::none
-                           , definition_.heightFunction
-                           , overrides);
+    return metatileCache_(resource().revision, tileId, overrides, [&]()
+    {
+        auto o(overrides);
+        o.demFastRatio = definition_.demFastRatio;
+        return metatileFromDem(tileId, sink, arsenal, resource()
+                               , index_->tileIndex, dem_.dataset
+                               , dem_.geoidGrid, maskTree_, boost::none
+                               , definition_.heightFunction, o);
+    });
 }
 
 namespace {
@@ -326,12 +503,18 @@ inline bool validSample(double value)
     return (value >= -1e6);
 }
 
+/** Sample type T must match the dem matrix type (float or double).
+ */
+template <typename T>
 class DemSampler {
 public:
     /** Samples point in dem. Dilates by one pixel if pixel is invalid.
      *
      *  Pixels masked by external mask are not valid (i.e. the mask must be
      *  dilated by 1 pixel beforehand)
+     *
+     *  Gap-filled DEM (see SurfaceDem::demCoverage) is valid under the
+     *  mask, dilation is never needed then.
      */
     DemSampler(const cv::Mat &dem, const vts::NodeInfo::CoverageMask &mask
                , const HeightFunction::pointer &heightFunction)
@@ -342,7 +525,7 @@ public:
         // ignore masked-out pixels
         if (!mask_.get(i, j)) { return false; }
 
-        h = dem_.at<double>(j, i);
+        h = dem_.at<T>(j, i);
         if (validSample(h)) {
             if (heightFunction_) { h = (*heightFunction_)(h); }
             return true;
@@ -366,7 +549,7 @@ public:
                 if (!mask_.get(x, y)) { continue; }
 
                 // sample pixel and use if valid
-                auto v(dem_.at<double>(y, x));
+                double v(dem_.at<T>(y, x));
                 if (!validSample(v)) { continue; }
 
                 h += v;
@@ -384,33 +567,337 @@ public:
         return true;
     }
 
+    /** Fast path for fully covered and fully valid grids (the common case):
+     *  fills all heights (row-major) in one pass and applies height function
+     *  in batch.
+     *
+     *  Returns false if any sample is masked out or invalid; per-sample
+     *  operator() must be used then.
+     */
+    bool fill(std::vector<double> &heights) const {
+        if (!mask_.full()) { return false; }
+
+        const int cols(dem_.cols), rows(dem_.rows);
+        heights.resize(std::size_t(cols) * rows);
+
+        auto *out(heights.data());
+        bool valid(true);
+        for (int j(0); j < rows; ++j, out += cols) {
+            const auto *row(dem_.ptr<T>(j));
+            for (int i(0); i < cols; ++i) {
+                const double h(row[i]);
+                valid &= validSample(h);
+                out[i] = h;
+            }
+        }
+
+        if (!valid) { return false; }
+
+        if (heightFunction_) {
+            heightFunction_->transform(heights.data()
+                                       , heights.data() + heights.size());
+        }
+        return true;
+    }
+
 private:
     cv::Mat dem_;
     const vts::NodeInfo::CoverageMask &mask_;
     const HeightFunction::pointer &heightFunction_;
 };
 
+const float InvalidSample(-1e10f);
+
+/** Maximum number of lods a tile DEM is derived across (see
+ *  SurfaceDem::nativeAncestor).
+ */
+const int MaxDerivedDepth(8);
+
+/** Adaptive normal maps (see Surface::NormalMaps) are never smaller than
+ *  this.
+ */
+const int MinAdaptiveNormalMap(32);
+
+/** Navtile grids are warped in blocks of up to 2^NavtileBlockOrder x
+ *  2^NavtileBlockOrder tiles (see SurfaceDem::navtileDem).
+ */
+const int NavtileBlockOrder(2);
+
+/** Key of sibling block of tile DEMs in SurfaceDem::blockCache_.
+ */
+std::string blockDemKey(const std::string &dataset
+                        , const vts::TileId &parentId)
+{
+    return utility::format("%s:%s", dataset, parentId);
+}
+
+/** Key of standalone tile DEM in SurfaceDem::blockCache_.
+ */
+std::string singleDemKey(const std::string &dataset
+                         , const vts::TileId &tileId)
+{
+    return utility::format("%s:%s:single", dataset, tileId);
+}
+
+/** Bilinearly interpolates tile DEM at (u, v) given in samples. Only valid
+ *  samples are used, returns InvalidSample if there is no valid neighbour.
+ */
+float sampleTileDem(const cv::Mat &dem, double u, double v)
+{
+    const int j0(std::floor(v));
+    const int j1(std::min(j0 + 1, dem.rows - 1));
+    const double fy(v - j0);
+
+    const int i0(std::floor(u));
+    const int i1(std::min(i0 + 1, dem.cols - 1));
+    const double fx(u - i0);
+
+    double sum(0), weight(0);
+    const auto add([&](int x, int y, double w)
+    {
+        if (w <= 0) { return; }
+        const float h(dem.at<float>(y, x));
+        if (!validSample(h)) { return; }
+        sum += w * h;
+        weight += w;
+    });
+
+    add(i0, j0, (1 - fx) * (1 - fy));
+    add(i1, j0, fx * (1 - fy));
+    add(i0, j1, (1 - fx) * fy);
+    add(i1, j1, fx * fy);
+
+    return (weight ? (sum / weight) : InvalidSample);
+}
+
+/** Derives DEM grid of given size covering tile's extents (i.e. grid
+ *  registration) from tile DEM (see SurfaceDem::tileDem).
+ *
+ *  Tile DEM samples lie at pixel centers of the tile and one more pixel
+ *  around it. Output is bilinearly interpolated from valid samples only,
+ *  output sample without any valid neighbour is invalid.
+ */
+cv::Mat gridFromTileDem(const cv::Mat &dem, const math::Size2 &gridSize)
+{
+    // number of tile pixels
+    const math::Size2 pixels(dem.cols - 2, dem.rows - 2);
+
+    // output sample i lies at (i * step + 0.5) in tile DEM samples
+    const double stepX(double(pixels.width) / (gridSize.width - 1));
+    const double stepY(double(pixels.height) / (gridSize.height - 1));
+
+    cv::Mat grid(gridSize.height, gridSize.width, CV_32FC1);
+
+    for (int j(0); j < gridSize.height; ++j) {
+        const double v(j * stepY + 0.5);
+        for (int i(0); i < gridSize.width; ++i) {
+            grid.at<float>(j, i) = sampleTileDem(dem, i * stepX + 0.5, v);
+        }
+    }
+
+    return grid;
+}
+
+/** Derives tile DEM (see SurfaceDem::tileDem) of a descendant tile lying
+ *  depth lods below the ancestor whose tile DEM is given. (x, y) is the
+ *  descendant's position among the ancestor's 2^depth x 2^depth descendants
+ *  (top row first).
+ *
+ *  Output has the same layout as the input with given number of samples
+ *  per side (plus margin; 0 = same as input): sample k lies at tile pixel
+ *  center (k - 0.5).
+ */
+cv::Mat deriveTileDem(const cv::Mat &dem, int depth, int x, int y
+                      , int samples = 0)
+{
+    const double scale(1 << depth);
+    const int pxWidth(dem.cols - 2), pxHeight(dem.rows - 2);
+    const double ox(x * pxWidth / scale);
+    const double oy(y * pxHeight / scale);
+
+    // output pixel size in input tile pixels
+    const double stepX(samples ? double(pxWidth) / samples : 1.0);
+    const double stepY(samples ? double(pxHeight) / samples : 1.0);
+
+    cv::Mat out((samples ? samples + 2 : dem.rows)
+                , (samples ? samples + 2 : dem.cols), CV_32FC1);
+
+    for (int j(0); j < out.rows; ++j) {
+        const double v(oy + (j - 0.5) * stepY / scale + 0.5);
+        for (int i(0); i < out.cols; ++i) {
+            out.at<float>(j, i)
+                = sampleTileDem(dem, ox + (i - 0.5) * stepX / scale + 0.5
+                                , v);
+        }
+    }
+
+    return out;
+}
+
+/** Estimates number of faces the tile mesh will be simplified to from
+ *  roughness of a coarse grid derived from tile DEM.
+ */
+int estimateFaceCount(const cv::Mat &tileDem, const vts::NodeInfo &nodeInfo
+                      , const TileFacesCalculator &tileFacesCalculator)
+{
+    const int edges(16);
+    const auto grid(gridFromTileDem(tileDem, math::Size2(edges + 1
+                                                         , edges + 1)));
+    const auto ts(math::size(nodeInfo.extents()));
+    const double dx(ts.width / edges), dy(ts.height / edges);
+
+    double area(0.0), projected(0.0);
+    for (int j(0); j < edges; ++j) {
+        for (int i(0); i < edges; ++i) {
+            const float h00(grid.at<float>(j, i));
+            const float h01(grid.at<float>(j, i + 1));
+            const float h10(grid.at<float>(j + 1, i));
+            const float h11(grid.at<float>(j + 1, i + 1));
+            if (!validSample(h00) || !validSample(h01)
+                || !validSample(h10) || !validSample(h11))
+            {
+                continue;
+            }
+
+            const math::Point3 v00(0.0, dy, h00), v01(dx, dy, h01);
+            const math::Point3 v10(0.0, 0.0, h10), v11(dx, 0.0, h11);
+            area += (vts::triangleArea(v10, v11, v00)
+                     + vts::triangleArea(v11, v01, v00));
+            projected += dx * dy;
+        }
+    }
+
+    if (projected <= 0.0) { return tileFacesCalculator(1.0, 1.0); }
+    return tileFacesCalculator(area, projected);
+}
+
+/** Grid edges per side for given face count: twice the linear density
+ *  needed to hold the faces, power of two (RTIN) within [16, 128].
+ */
+int adaptiveEdges(int faceCount)
+{
+    const double needed(2.0 * std::sqrt(faceCount / 2.0));
+    int edges(16);
+    while ((edges < 128) && (edges < needed)) { edges <<= 1; }
+    return edges;
+}
+
+/** Grid edges per side of a virtual tile (see resource::SurfaceDem::
+ *  virtualLods) lying depth lods below its native ancestor: its DEM holds
+ *  just 256 >> depth distinct samples per side.
+ */
+int virtualEdges(int depth)
+{
+    return std::max(2, std::min(16, 256 >> std::min(depth, 8)));
+}
+
+/** Meshes fully valid grid (see DemSampler::fill) by error-driven RTIN
+ *  triangulation with at most faceCount faces.
+ */
+void rtinMesh(AugmentedMesh &out, const vts::NodeInfo &nodeInfo
+              , const std::vector<double> &grid, int edges, int faceCount)
+{
+    const int size(edges + 1);
+    const std::vector<float> heights(grid.begin(), grid.end());
+
+    const Rtin rtin(heights, size);
+    const auto faces(rtin.triangulate(rtin.threshold(faceCount)));
+
+    const auto extents(nodeInfo.extents());
+    const auto ts(math::size(extents));
+    const math::Size2f px(ts.width / edges, ts.height / edges);
+    const auto g2l(geo::geo2local(extents));
+
+    auto &lm(out.mesh);
+    std::vector<int> indices(heights.size(), -1);
+    const auto vertex([&](int index) -> int
+    {
+        auto &v(indices[index]);
+        if (v < 0) {
+            v = lm.vertices.size();
+            const int i(index % size), j(index / size);
+            lm.vertices.push_back
+                (math::transform
+                 (g2l, math::Point3(extents.ll(0) + i * px.width
+                                    , extents.ur(1) - j * px.height
+                                    , grid[index])));
+        }
+        return v;
+    });
+
+    for (const auto &f : faces) {
+        // counter-clockwise in SDS (grid rows go down)
+        const int ai(f[0] % size), aj(f[0] / size);
+        const int bi(f[1] % size), bj(f[1] / size);
+        const int ci(f[2] % size), cj(f[2] / size);
+        const long cross((long(bi - ai) * (aj - cj))
+                         - (long(aj - bj) * (ci - ai)));
+
+        const auto a(vertex(f[0])), b(vertex(f[1])), c(vertex(f[2]));
+        if (cross > 0) {
+            lm.addFace(a, b, c);
+        } else {
+            lm.addFace(a, c, b);
+        }
+    }
+
+    out.fullyCovered = true;
+}
+
 } // namespace
 
 AugmentedMesh SurfaceDem
 ::generateMeshImpl(const vts::NodeInfo &nodeInfo, Sink &sink
                    , Arsenal &arsenal, const OptHeight &defaultHeight) const
 {
-    const int samplesPerSide(128);
+    typedef resource::SurfaceDem::Mesher Mesher;
+    const auto mesher(definition_.mesher);
+
+    int samplesPerSide(128);
+    boost::optional<int> faceCount;
     const TileFacesCalculator tileFacesCalculator;
 
+    // tile is finer than the dataset: regular grid, no simplification
+    boost::optional<vts::NodeInfo> ancestor;
+    if (definition_.virtualLods && !defaultHeight) {
+        ancestor = nativeAncestor(nodeInfo);
+    }
+
     sink.checkAborted();
 
-    /** warp input dataset as a DEM, with optimized size
-     */
-    auto dem(arsenal.warper.warp
-             (GdalWarper::RasterRequest
-              (GdalWarper::RasterRequest::Operation::demOptimal
-               , dem_.dataset
-               , nodeInfo.srsDef(), nodeInfo.extents()
-               , math::Size2(samplesPerSide, samplesPerSide))
-              .setNodata(defaultHeight)
-              , sink));
+    GdalWarper::Raster dem;
+    if (defaultHeight) {
+        /** warp input dataset as a DEM, with optimized size; default height
+         *  fills holes, i.e. the shared tile DEM cannot be used
+         */
+        dem = arsenal.warper.warp
+            (GdalWarper::RasterRequest
+             (GdalWarper::RasterRequest::Operation::demOptimalFloat
+              , demDataset(nodeInfo)
+              , nodeInfo.srsDef(), nodeInfo.extents()
+              , math::Size2(samplesPerSide, samplesPerSide))
+             .setNodata(defaultHeight)
+             .setOverviewRatio(definition_.overviewRatio)
+             .setDemFastRatio(definition_.demFastRatio)
+             , sink);
+    } else {
+        // derive mesh grid from tile DEM shared with normal map and navtile
+        const auto tile(tileDem(nodeInfo, sink, arsenal));
+
+        if (ancestor) {
+            samplesPerSide = virtualEdges(nodeInfo.nodeId().lod
+                                          - ancestor->nodeId().lod);
+        } else if (mesher != Mesher::simplify) {
+            // grid resolution driven by expected face count
+            faceCount = estimateFaceCount(*tile, nodeInfo
+                                          , tileFacesCalculator);
+            samplesPerSide = adaptiveEdges(*faceCount);
+        }
+
+        dem = std::make_shared<cv::Mat>
+            (gridFromTileDem(*tile, math::Size2(samplesPerSide + 1
+                                                , samplesPerSide + 1)));
+    }
 
     sink.checkAborted();
 
@@ -421,79 +908,401 @@ AugmentedMesh SurfaceDem
     auto coverage(generateCoverage(dem->cols - 1, nodeInfo, maskTree_
                                    , vts::NodeInfo::CoverageType::grid));
 
-    DemSampler ds(*dem, coverage, definition_.heightFunction);
+    // gap-filled DEM is valid past the data, default height fills holes
+    if (!defaultHeight) {
+        demCoverage(coverage, nodeInfo, math::Size2(dem->cols, dem->rows)
+                    , sink, arsenal);
+    }
+
+    DemSampler<float> ds(*dem, coverage, definition_.heightFunction);
+
+    // fully valid tile: all heights at once
+    std::vector<double> grid;
+    const bool gridValid(ds.fill(grid));
+
+    if ((mesher == Mesher::rtin) && faceCount && gridValid) {
+        AugmentedMesh mesh;
+        {
+            const auto scope(sink.traceStage("simplify"));
+            rtinMesh(mesh, nodeInfo, grid, size.width, *faceCount);
+        }
+
+        mesh.textureLayerId = definition_.textureLayerId;
+        mesh.geoidGrid = dem_.geoidGrid;
+        return mesh;
+    }
 
     // generate mesh
-    auto mesh(meshFromNode(nodeInfo, size
-                               , [&](int i, int j, double &h) -> bool
-    {
-        return ds(i, j, h);
-    }));
+    HeightSampler sampler;
+    if (gridValid) {
+        const int stride(dem->cols);
+        sampler = [&grid, stride](int i, int j, double &h) -> bool
+        {
+            h = grid[j * stride + i];
+            return true;
+        };
+    } else {
+        // edge tile, per-sample path with hole filling
+        sampler = [&ds](int i, int j, double &h) -> bool
+        {
+            return ds(i, j, h);
+        };
+    }
+
+    auto mesh(meshFromNode(nodeInfo, size, sampler));
     mesh.textureLayerId = definition_.textureLayerId;
     mesh.geoidGrid = dem_.geoidGrid;
 
+    // virtual tile carries no detail worth simplifying
+    if (ancestor && gridValid) { return mesh; }
+
     // simplify
-    simplifyMesh(mesh.mesh, nodeInfo, tileFacesCalculator, dem_.geoidGrid);
+    {
+        const auto scope(sink.traceStage("simplify"));
+        simplifyMesh(mesh.mesh, nodeInfo, tileFacesCalculator
+                     , dem_.geoidGrid);
+    }
 
     // done for now
     return mesh;
 }
 
-cv::Mat SurfaceDem::generateNormalMapImpl(
-    const vts::NodeInfo &nodeInfo, Sink &sink, Arsenal &arsenal) const {
+AugmentedMesh SurfaceDem
+::generateTerrainMeshImpl(const vts::NodeInfo &nodeInfo, Sink &sink
+                          , Arsenal &arsenal) const
+{
+    const TileFacesCalculator tileFacesCalculator;
 
     sink.checkAborted();
 
+    // grid resolution driven by expected face count
+    const auto tile(tileDem(nodeInfo, sink, arsenal));
+    const auto faceCount(estimateFaceCount(*tile, nodeInfo
+                                           , tileFacesCalculator));
+    const auto edges(adaptiveEdges(faceCount));
+
+    auto dem(gridFromTileDem(*tile, math::Size2(edges + 1, edges + 1)));
+
+    // terrain has no holes: replace no-data with zero
+    for (int j(0); j < dem.rows; ++j) {
+        auto *row(dem.ptr<float>(j));
+        for (int i(0); i < dem.cols; ++i) {
+            if (!validSample(row[i])) { row[i] = 0.0f; }
+        }
+    }
+
+    sink.checkAborted();
+
+    auto coverage(generateCoverage(edges, nodeInfo, maskTree_
+                                   , vts::NodeInfo::CoverageType::grid));
+
+    DemSampler<float> ds(dem, coverage, definition_.heightFunction);
+
+    std::vector<double> grid;
+    if (!ds.fill(grid)) {
+        // masked tile, generic path
+        return generateMeshImpl(nodeInfo, sink, arsenal, 0.0);
+    }
+
+    AugmentedMesh mesh;
+    {
+        const auto scope(sink.traceStage("simplify"));
+        rtinMesh(mesh, nodeInfo, grid, edges, faceCount);
+    }
+
+    mesh.textureLayerId = definition_.textureLayerId;
+    mesh.geoidGrid = dem_.geoidGrid;
+    return mesh;
+}
+
+boost::optional<vts::NodeInfo>
+SurfaceDem::nativeAncestor(const vts::NodeInfo &nodeInfo) const
+{
+    if (!(gsdArea_ > 0.0)) { return boost::none; }
+
+    const auto fscale(srsScale_.find(nodeInfo.srs()));
+    if (fscale == srsScale_.end()) { return boost::none; }
+
+    // ground area of one tile DEM pixel
+    const auto ts(math::size(nodeInfo.extents()));
+    double pixelArea(math::area(ts) * fscale->second * fscale->second
+                     / (256.0 * 256.0));
+
+    // climb while parent's pixel is not coarser than the dataset's GSD
+    boost::optional<vts::NodeInfo> ancestor;
+    auto tileId(nodeInfo.nodeId());
+    for (int depth(0); (depth < MaxDerivedDepth) && tileId.lod
+             && ((4.0 * pixelArea) <= gsdArea_); ++depth)
+    {
+        const vts::NodeInfo parent(referenceFrame(), vts::parent(tileId));
+        if (!parent.valid() || (parent.srs() != nodeInfo.srs())) {
+            // different subtree
+            break;
+        }
+
+        ancestor = parent;
+        tileId = parent.nodeId();
+        pixelArea *= 4.0;
+    }
+
+    return ancestor;
+}
+
+GdalWarper::Raster SurfaceDem::tileDem(const vts::NodeInfo &nodeInfo
+                                       , Sink &sink, Arsenal &arsenal) const
+{
+    // tile is finer than the dataset: no new information would be warped,
+    // derive DEM from ancestor at native resolution in-process
+    if (const auto ancestor = nativeAncestor(nodeInfo)) {
+        return derivedTileDem(nodeInfo, *ancestor, 0, sink, arsenal);
+    }
+
     // warp input dataset as DEM, at tile size + 1 pixel on each side
     // we inflate the extents by half pixel, Operation::dem
     // adds another half pixel.
     // this trickery could be replaced with a new type of ::Operation
-    auto extents = extentsPlusHalfPixel(nodeInfo.extents(), {256,256});
+    //
+    // the same DEM is used by normal map, mesh and navtile of this tile
+    const auto warp([&](const math::Extents2 &extents
+                        , const math::Size2 &tiles)
+    {
+        const math::Size2 size(256 * tiles.width + 1
+                               , 256 * tiles.height + 1);
+        return GdalWarper::RasterRequest
+            (GdalWarper::RasterRequest::Operation::demFloat
+             , demDataset(nodeInfo)
+             , nodeInfo.srsDef()
+             , extentsPlusHalfPixel(extents, { size.width - 1
+                                               , size.height - 1 })
+             , size)
+            .setOverviewRatio(definition_.overviewRatio)
+            .setDemFastRatio(definition_.demFastRatio);
+    });
+
+    if (const auto block = siblingBlock
+        (referenceFrame(), nodeInfo.nodeId(), nodeInfo))
+    {
+        // warp all siblings at once, neighbours share one grid row/column
+        return blockCache_
+            (blockDemKey(dem_.dataset, block->parentId)
+             , block->index, [&]()
+        {
+            return arsenal.warper.warpBatch
+                (warp(block->extents, math::Size2(2, 2)), math::Size2(2, 2)
+                 , 1, sink);
+        });
+    }
 
-    auto dem(arsenal.warper.warp(
-        GdalWarper::RasterRequest(
-            GdalWarper::RasterRequest::Operation::dem
-            , dem_.dataset
-            , nodeInfo.srsDef(), extents
-            , math::Size2(257, 257))
-        , sink));
+    // root tile or tile not batchable with its siblings, cache it alone
+    return blockCache_
+        (singleDemKey(dem_.dataset, nodeInfo.nodeId())
+         , 0, [&]()
+    {
+        return GdalWarper::Rasters
+            { arsenal.warper.warp
+              (warp(nodeInfo.extents(), math::Size2(1, 1)), sink) };
+    });
+}
+
+GdalWarper::Raster SurfaceDem::derivedTileDem(const vts::NodeInfo &nodeInfo
+                                              , const vts::NodeInfo &ancestor
+                                              , int samples, Sink &sink
+                                              , Arsenal &arsenal) const
+{
+    const auto native(pyramidCache_
+                      (utility::format("%s:%s", dem_.dataset
+                                       , ancestor.nodeId())
+                       , 0, [&]()
+    {
+        return GdalWarper::Rasters{ tileDem(ancestor, sink, arsenal) };
+    }));
+
+    sink.checkAborted();
+
+    const auto &tileId(nodeInfo.nodeId());
+    const auto &ancestorId(ancestor.nodeId());
+    const int depth(tileId.lod - ancestorId.lod);
+    return std::make_shared<cv::Mat>
+        (deriveTileDem(*native, depth
+                       , tileId.x - (ancestorId.x << depth)
+                       , tileId.y - (ancestorId.y << depth), samples));
+}
+
+GdalWarper::Raster SurfaceDem::cachedTileDem(const vts::NodeInfo &nodeInfo)
+    const
+{
+    if (const auto block = siblingBlock
+        (referenceFrame(), nodeInfo.nodeId(), nodeInfo))
+    {
+        return blockCache_.find(blockDemKey(dem_.dataset, block->parentId)
+                                , block->index);
+    }
+
+    return blockCache_.find(singleDemKey(dem_.dataset, nodeInfo.nodeId()), 0);
+}
+
+void SurfaceDem::demCoverage(vts::NodeInfo::CoverageMask &coverage
+                             , const vts::NodeInfo &nodeInfo
+                             , const math::Size2 &gridSize
+                             , Sink &sink, Arsenal &arsenal) const
+{
+    if (!filledDem_) { return; }
+
+    // fully covered by the DEM (see mapproxy-tiling)
+    if (index_ && (index_->tileIndex.get(nodeInfo.nodeId())
+                   & vts::TileIndex::Flag::watertight))
+    {
+        return;
+    }
+
+    // validity at grid samples, i.e. pixel centers of extents inflated by
+    // half a pixel
+    GdalWarper::Raster valid;
+    try {
+        valid = arsenal.warper.warp
+            (GdalWarper::RasterRequest
+             (GdalWarper::RasterRequest::Operation::mask
+              , *filledDem_ + DemValiditySuffix
+              , nodeInfo.srsDef()
+              , extentsPlusHalfPixel(nodeInfo.extents()
+                                     , { gridSize.width - 1
+                                         , gridSize.height - 1 })
+              , gridSize, geo::GeoDataset::Resampling::nearest)
+             .setPriority(GdalWarper::Priority::mesh)
+             , sink);
+    } catch (const FullImage&) {
+        return;
+    } catch (const EmptyImage&) {
+        // no data at all
+        for (int j(0); j < gridSize.height; ++j) {
+            for (int i(0); i < gridSize.width; ++i) {
+                coverage.set(i, j, false);
+            }
+        }
+        return;
+    }
+
+    for (int j(0); j < gridSize.height; ++j) {
+        const auto *row(valid->ptr<std::uint8_t>(j));
+        for (int i(0); i < gridSize.width; ++i) {
+            if (!row[i]) { coverage.set(i, j, false); }
+        }
+    }
+}
 
-    //auto dem = std::make_shared<cv::Mat>(cv::Mat::zeros(257, 257, CV_64FC1));
+GdalWarper::Raster SurfaceDem::navtileDem(const vts::NodeInfo &nodeInfo
+                                          , const math::Size2 &gridSize
+                                          , Sink &sink, Arsenal &arsenal)
+    const
+{
+    const auto fromTileDem([&](const GdalWarper::Raster &dem)
+    {
+        return std::make_shared<cv::Mat>(gridFromTileDem(*dem, gridSize));
+    });
+
+    // oversampled tile, its DEM is derived in-process anyway
+    if (nativeAncestor(nodeInfo)) {
+        return fromTileDem(tileDem(nodeInfo, sink, arsenal));
+    }
+
+    // mesh or normal map of this tile has been generated recently
+    if (const auto dem = cachedTileDem(nodeInfo)) {
+        return fromTileDem(dem);
+    }
+
+    // find block: aligned ancestor at most NavtileBlockOrder lods up, in the
+    // same SRS; such block never crosses metatile boundary
+    const auto &rf(referenceFrame());
+    const auto &tileId(nodeInfo.nodeId());
+    auto blockId(tileId);
+    auto extents(nodeInfo.extents());
+    int depth(0);
+    for (; (depth < NavtileBlockOrder) && (depth < int(rf.metaBinaryOrder))
+             && blockId.lod; ++depth)
+    {
+        const vts::NodeInfo parent(rf, vts::parent(blockId));
+        if (!parent.valid() || (parent.srs() != nodeInfo.srs())) { break; }
+        blockId = parent.nodeId();
+        extents = parent.extents();
+    }
+
+    const int tiles(1 << depth);
+    const std::size_t index(((tileId.y - (blockId.y << depth)) * tiles)
+                            + (tileId.x - (blockId.x << depth)));
+
+    return navtileCache_
+        (utility::format("%s:%s:%dx%d", dem_.dataset, blockId
+                         , gridSize.width, gridSize.height)
+         , index, [&]()
+    {
+        // Operation::demFloat adds one sample to simulate grid registration,
+        // neighbouring navtiles share edge row/column
+        const math::Size2 size((gridSize.width - 1) * tiles
+                               , (gridSize.height - 1) * tiles);
+        return arsenal.warper.warpBatch
+            (GdalWarper::RasterRequest
+             (GdalWarper::RasterRequest::Operation::demFloat
+              , demDataset(nodeInfo), nodeInfo.srsDef(), extents, size)
+             .setOverviewRatio(definition_.overviewRatio)
+             .setDemFastRatio(definition_.demFastRatio)
+             , math::Size2(tiles, tiles), 0, sink);
+    });
+}
+
+cv::Mat SurfaceDem::generateNormalMapImpl(
+    const vts::NodeInfo &nodeInfo, Sink &sink, Arsenal &arsenal) const {
+
+    sink.checkAborted();
+
+    // normal map size: full or, for adaptive normal maps of oversampled
+    // tiles, the DEM's effective resolution (ancestor's pixel)
+    int samples(256);
+    GdalWarper::Raster dem;
+    if (definition_.normalMaps != resource::Surface::NormalMaps::full) {
+        if (const auto ancestor = nativeAncestor(nodeInfo)) {
+            const int depth(nodeInfo.nodeId().lod - ancestor->nodeId().lod);
+            samples = std::max(samples >> depth, MinAdaptiveNormalMap);
+            dem = derivedTileDem(nodeInfo, *ancestor, samples, sink
+                                 , arsenal);
+        }
+    }
+    if (!dem) { dem = tileDem(nodeInfo, sink, arsenal); }
 
     sink.checkAborted();
 
-    // obtain flat mask if landcover ds is provided, create empty inversion mask
-    imgproc::RasterMask flatMask(dem->cols, dem->rows,
-                            imgproc::RasterMask::EMPTY);
+    // obtain flat mask if landcover ds is provided (shared, not copied),
+    // create empty inversion mask
+    landcover::FlatMask flatMask;
     imgproc::quadtree::RasterMask inversionMask(dem->cols, dem->rows,
                             imgproc::quadtree::RasterMask::EMPTY);
 
-    if (landcover_) {
-
-        auto lc(arsenal.warper.warp(
+    if (!landcover_) {
+        flatMask = landcover::emptyFlatMask(dem->cols, dem->rows);
+    } else {
+        // landcover tile, and its flat mask, is shared with other generators
+        flatMask = landcover::flatMask(
+            arsenal.warper,
             GdalWarper::RasterRequest(
                 GdalWarper::RasterRequest::Operation::imageNoExpand,
                 landcover_->dataset,
                 nodeInfo.srsDef(),
                 nodeInfo.extents(),
-                math::Size2(256, 256),
-                geo::GeoDataset::Resampling::nearest), sink));
-
-        //cv::imwrite("lc.png", *lc);
+                math::Size2(samples, samples),
+                geo::GeoDataset::Resampling::nearest)
+            .setPriority(GdalWarper::Priority::mesh),
+            lcClassdefKey_, *lcClassdef_, sink);
 
         sink.checkAborted();
-
-        flatMask = geo::landcover::flatMask(*lc, lcClassdef_);
-        // flatMask.invert(); // diagnostics
     }
 
     /* FIXME: we should deal with no-data values from normal inputs.
-       With current code, normal artifacts may appear on DEM edges. */
+       With current code, normal artifacts may appear on DEM edges unless
+       the DEM is gap-filled (see Definition::fillGaps). */
 
     // obtain normal map at spatial division coords
     math::Size2f pixelSize(
-        (nodeInfo.extents().ur[0] - nodeInfo.extents().ll[0]) / 256,
-        (nodeInfo.extents().ur[1] - nodeInfo.extents().ll[1]) / 256);
+        (nodeInfo.extents().ur[0] - nodeInfo.extents().ll[0]) / samples,
+        (nodeInfo.extents().ur[1] - nodeInfo.extents().ll[1]) / samples);
         
     geo::normalmap::Parameters params;
     
@@ -501,8 +1310,21 @@ cv::Mat SurfaceDem::generateNormalMapImpl(
     params.viewspaceRf = true; params.invertRelief = false; 
     params.zFactor = 1.0;
 
-    auto normalMap = geo::normalmap::demNormals<double>(
-        *dem, pixelSize, params, flatMask, inversionMask);
+    // native kernel works on float DEM (block slice) directly
+    cv::Mat normalMap;
+    if (nativeDemNormals(*dem, normalMap, pixelSize, params, *flatMask
+                         , inversionMask))
+    {
+        return normalMap;
+    }
+
+    // DEM travels through shared memory as float, demNormals computes in
+    // double; this also turns block slice into plain matrix
+    ScratchMat converted;
+    dem->convertTo(converted.create(dem->rows, dem->cols, CV_64F), CV_64F);
+
+    normalMap = geo::normalmap::demNormals<double>(
+        converted.mat(), pixelSize, params, *flatMask, inversionMask);
 
     // return result
     return normalMap;
@@ -535,7 +1357,7 @@ void SurfaceDem::generateNavtile(const vts::TileId &tileId
         metaId.y &= ~((1 << rf.metaBinaryOrder) - 1);
     }
 
-    // suboptimal solution: generate metatile
+    // metatile is most probably cached
     auto metatile(generateMetatileImpl(metaId, sink, arsenal));
 
     const auto &extents(node.extents());
@@ -546,7 +1368,7 @@ void SurfaceDem::generateNavtile(const vts::TileId &tileId
 
     sink.checkAborted();
 
-    const auto *metanode(metatile.get(tileId, std::nothrow));
+    const auto *metanode(metatile->get(tileId, std::nothrow));
     if (!metanode) {
         sink.error(utility::makeError<NotFound>("Metatile not found."));
         return;
@@ -562,21 +1384,20 @@ void SurfaceDem::generateNavtile(const vts::TileId &tileId
                    = generateCoverage(ntd.cols - 1, node, maskTree_
                                       , vts::NodeInfo::CoverageType::grid));
 
-    // warp input dataset as a DEM
-    auto dem(arsenal.warper.warp
-             (GdalWarper::RasterRequest
-              (GdalWarper::RasterRequest::Operation::dem
-               , dem_.dataset
-               , node.srsDef(), node.extents()
-               , math::Size2(ntd.cols - 1, ntd.rows -1))
-              , sink));
+    // navtile grid, from tile DEM shared with mesh and normal map if
+    // available
+    auto dem(navtileDem(node, math::Size2(ntd.cols, ntd.rows)
+                        , sink, arsenal));
 
     sink.checkAborted();
 
+    demCoverage(coverage, node, math::Size2(ntd.cols, ntd.rows), sink
+                , arsenal);
+
     // set height range
     nt.heightRange(vts::NavTile::HeightRange
                    (std::floor(heightRange.min), std::ceil(heightRange.max)));
-    DemSampler ds(*dem, coverage, definition_.heightFunction);
+    DemSampler<float> ds(*dem, coverage, definition_.heightFunction);
 
     // calculate navtile values
     math::Size2f npx(ts.width / (ntd.cols - 1)
@@ -603,16 +1424,16 @@ void SurfaceDem::generateNavtile(const vts::TileId &tileId
     }
 
     // done
-    std::ostringstream os;
+    const auto os(OutputBuffer::create());
     if (fi.flavor == vts::FileFlavor::raw) {
         // raw navtile -> serialize to on-disk format
-        nt.serialize(os);
+        nt.serialize(*os);
     } else {
         // just navtile itself
-        nt.serializeNavtileProper(os);
+        nt.serializeNavtileProper(*os);
     }
 
-    sink.content(os.str(), fi.sinkFileInfo());
+    sink.content(os, fi.sinkFileInfo());
 }
 
 unsigned int SurfaceDem::generatorRevision() const {
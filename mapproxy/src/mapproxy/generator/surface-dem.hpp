@@ -27,13 +27,20 @@
 #ifndef mapproxy_generator_surface_dem_hpp_included_
 #define mapproxy_generator_surface_dem_hpp_included_
 
+#include <map>
+
+#include <boost/optional.hpp>
+
 #include "vts-libs/vts/tileset/tilesetindex.hpp"
 #include "vts-libs/vts/tileset/properties.hpp"
-#include "geo/landcover.hpp"
 
 #include "surface.hpp"
+#include "rasterblockcache.hpp"
 
 #include "../support/coverage.hpp"
+#include "../support/landcover.hpp"
+#include "../support/masktree.hpp"
+#include "../support/reprojected.hpp"
 
 namespace vts = vtslibs::vts;
 //namespace vr = vtslibs::registry;
@@ -63,19 +70,115 @@ private:
     generateMeshImpl(const vts::NodeInfo &nodeInfo, Sink &sink
                      , Arsenal &arsenal, const OptHeight &defaultHeight) const;
 
+    /** Terrain mesh straight from tile DEM grid by RTIN, no simplification.
+     *  Falls back to generateMeshImpl for partially covered tiles.
+     */
+    virtual AugmentedMesh
+    generateTerrainMeshImpl(const vts::NodeInfo &nodeInfo, Sink &sink
+                            , Arsenal &arsenal) const;
+
     virtual cv::Mat
     generateNormalMapImpl(const vts::NodeInfo &nodeInfo
                           , Sink &sink, Arsenal &arsenal) const;
 
+    /** DEM of given tile: float samples at pixel centers of the 256x256
+     *  tile plus one pixel on each side. Shared by normal map, mesh and
+     *  navtile; warped in sibling blocks and cached briefly.
+     */
+    GdalWarper::Raster tileDem(const vts::NodeInfo &nodeInfo, Sink &sink
+                               , Arsenal &arsenal) const;
+
+    /** DEM of oversampled tile (see nativeAncestor) derived from its
+     *  ancestor's tile DEM, in tile DEM layout with given number of samples
+     *  per side (plus one on each side).
+     */
+    GdalWarper::Raster derivedTileDem(const vts::NodeInfo &nodeInfo
+                                      , const vts::NodeInfo &ancestor
+                                      , int samples, Sink &sink
+                                      , Arsenal &arsenal) const;
+
+    /** Tile DEM if it is already warped and cached, null otherwise. Does not
+     *  warp nor wait.
+     */
+    GdalWarper::Raster cachedTileDem(const vts::NodeInfo &nodeInfo) const;
+
+    /** Navtile grid (grid registration) of given size. Derived from tile DEM
+     *  if available, otherwise navtile grids of a whole block of tiles are
+     *  warped at once and cached briefly.
+     */
+    GdalWarper::Raster navtileDem(const vts::NodeInfo &nodeInfo
+                                  , const math::Size2 &gridSize
+                                  , Sink &sink, Arsenal &arsenal) const;
+
+    /** Ancestor of oversampled tile (i.e. tile whose parent's pixel is
+     *  already finer than the dataset's GSD) that still lies at (or above)
+     *  the dataset's native resolution. Returns nothing for tiles that must
+     *  be warped.
+     */
+    boost::optional<vts::NodeInfo>
+    nativeAncestor(const vts::NodeInfo &nodeInfo) const;
+
+    /** Computes everything needed by nativeAncestor. Uses effective GSD
+     *  probed by a GDAL worker if given.
+     */
+    void prepareDemPyramid(const boost::optional<EffectiveGsd> &probed
+                           = boost::none);
+
+    /** DEM to warp meshes, normal maps and navtiles of given tile from:
+     *  gap-filled DEM, its reprojected pyramid or the DEM.
+     */
+    std::string demDataset(const vts::NodeInfo &nodeInfo) const {
+        if (filledDem_) { return *filledDem_; }
+        return reprojected_.dataset(nodeInfo, dem_.dataset);
+    }
+
+    /** Writes gap-filled DEM and its validity mask into the store unless
+     *  up to date.
+     */
+    void fillGaps();
+
+    /** Gap-filled DEM is present in the store (or not needed).
+     */
+    bool gapsFilled() const;
+
+    /** Removes samples of grid (grid registration) of given size that lie
+     *  outside of the DEM's data, taken from the validity mask of the
+     *  gap-filled DEM, from coverage. Does nothing without gap filling and
+     *  for watertight tiles.
+     */
+    void demCoverage(vts::NodeInfo::CoverageMask &coverage
+                     , const vts::NodeInfo &nodeInfo
+                     , const math::Size2 &gridSize
+                     , Sink &sink, Arsenal &arsenal) const;
+
+    /** Writes geoid-baked copies of DEM and its min/max complements into
+     *  the store unless up to date.
+     */
+    void bakeGeoid();
+
+    /** Geoid-baked DEM copies are present in the store (or not needed).
+     */
+    bool geoidBaked() const;
+
+    /** Adds DEM (and landcover) dataset and mask tree.
+     */
+    Warmup warmup_impl() const override;
+
+    /** Adds mask tree, landcover lookups and raster caches.
+     */
+    void memory_impl(Memory &memory) const override;
+
     virtual void generateNavtile(const vts::TileId &tileId
                                  , Sink &sink
                                  , const SurfaceFileInfo &fileInfo
                                  , Arsenal &arsenal) const;
 
-    vts::MetaTile generateMetatileImpl(const vts::TileId &tileId
-                                       , Sink &sink, Arsenal &arsenal
-                                       , const MetatileOverrides &overrides
-                                       = {}) const;
+    /** Generates metatile or returns a cached one.
+     */
+    MetatileCache::pointer
+    generateMetatileImpl(const vts::TileId &tileId, Sink &sink
+                         , Arsenal &arsenal
+                         , const MetatileOverrides &overrides = {}) const;
 
     void addToRegistry();
 
@@ -89,16 +192,54 @@ private:
 
     /** Path to original dataset (must contain overviews)
      */
+    const DemDataset sourceDem_;
+
+    /** Dataset actually used: the original one or its geoid-baked copy in
+     *  the store (see bakeGeoid()).
+     */
     const DemDataset dem_;
 
+    /** DEM pre-reprojected into SRSes of the reference frame.
+     */
+    ReprojectedPyramids reprojected_;
+
+    /** Gap-filled copy of dem_ in the store (see fillGaps()), if
+     *  configured.
+     */
+    const boost::optional<std::string> filledDem_;
+
     // path to optional landcover
     boost::optional<const LandcoverDataset> landcover_;
 
-    // loaded landcover class definition;
-    geo::landcover::Classes lcClassdef_;
+    // loaded landcover class definition, compiled into lookup tables
+    landcover::ClassLut::pointer lcClassdef_;
+
+    // loaded landcover class definition version, see landcover::classdefKey
+    std::string lcClassdefKey_;
+
+    // mask tree (shared with other resources using the same file)
+    SharedMaskTree maskTree_;
+
+    // recently warped tile DEMs (see tileDem)
+    mutable RasterBlockCache blockCache_;
+
+    /** Effective GSD area of the DEM (m2), zero if unknown (oversampled tiles
+     *  are warped then).
+     */
+    double gsdArea_;
+
+    /** Meters per SRS unit for each node SRS of the reference frame.
+     */
+    std::map<std::string, double> srsScale_;
+
+    // native resolution DEMs of ancestors of oversampled tiles
+    mutable RasterBlockCache pyramidCache_;
+
+    // recently warped navtile grid blocks (see navtileDem)
+    mutable RasterBlockCache navtileCache_;
 
-    // mask tree
-    MaskTree maskTree_;
+    // recently generated metatiles
+    mutable MetatileCache metatileCache_;
 };
 
 } // namespace generator
@@ -27,6 +27,7 @@
 #include <new>
 
 #include <boost/filesystem.hpp>
+#include <boost/algorithm/string/predicate.hpp>
 #include <boost/format.hpp>
 #include <boost/logic/tribool_io.hpp>
 
@@ -73,6 +74,7 @@
 #include "factory.hpp"
 
 namespace fs = boost::filesystem;
+namespace ba = boost::algorithm;
 namespace vr = vtslibs::registry;
 namespace vs = vtslibs::storage;
 namespace vts = vtslibs::vts;
@@ -169,15 +171,22 @@ vts::MapConfig SurfaceMeta::mapConfig_impl(ResourceRoot root) const
 
 typedef vts::TileIndex::Flag TiFlag;
 
-Generator::Task SurfaceMeta::tileindex(const SurfaceFileInfo &fi, Sink&)
-    const
+StoreFile SurfaceMeta::tileindexFile() const
 {
-    const auto path(ts_->path(vts::File::tileIndex).value());
+    const auto path(root() / str(boost::format("tileindex.%d-%d")
+                                 % surface_->resource().revision
+                                 % tms_->resource().revision));
+
+    std::unique_lock<std::mutex> lock(tileindexLock_);
+    if (tileindex_ && (tileindexPath_ == path)) { return *tileindex_; }
+
+    if (!fs::exists(path)) {
+        LOG(info1) << "Materializing tile index of <" << id() << ">.";
 
-    return [=](Sink &sink, Arsenal&) {
         // rewrite original tileindex to contain atlas
         vts::tileset::Index index(referenceFrame().metaBinaryOrder);
-        vts::tileset::loadTileSetIndex(index, path);
+        vts::tileset::loadTileSetIndex
+            (index, ts_->path(vts::File::tileIndex).value());
 
         auto &ti(index.tileIndex);
 
@@ -191,7 +200,31 @@ Generator::Task SurfaceMeta::tileindex(const SurfaceFileInfo &fi, Sink&)
 
         std::ostringstream os;
         vts::tileset::saveTileSetIndex(index, os);
-        sink.content(os.str(), fi.sinkFileInfo());
+        const auto data(os.str());
+        StoreFile::write(path, data.data(), data.size());
+
+        // drop indices of previous revisions
+        for (fs::directory_iterator i(root()), e; i != e; ++i) {
+            const auto &other(i->path());
+            if ((other != path) && (other != StoreFile::gzPath(path))
+                && ba::starts_with(other.filename().string(), "tileindex."))
+            {
+                boost::system::error_code ec;
+                fs::remove(other, ec);
+            }
+        }
+    }
+
+    tileindex_ = StoreFile(path);
+    tileindexPath_ = path;
+    return *tileindex_;
+}
+
+Generator::Task SurfaceMeta::tileindex(const SurfaceFileInfo &fi, Sink&)
+    const
+{
+    return [=](Sink &sink, Arsenal&) {
+        tileindexFile().send(sink, fi.sinkFileInfo(), fi.fileInfo.acceptGzip);
     };
 }
 
@@ -266,17 +299,18 @@ Generator::Task SurfaceMeta
 
     } break;
 
-    case SurfaceFileInfo::Type::definition: {
-        auto fl(vts::freeLayer
-                (vts::meshTilesConfig
-                 (properties(), vts::ExtraTileSetProperties()
-                  , prependRoot(fs::path(), resource(), ResourceRoot::none))));
-
-        std::ostringstream os;
-        vr::saveFreeLayer(os, fl);
-        sink.content(os.str(), fi.sinkFileInfo());
+    case SurfaceFileInfo::Type::definition:
+        sendDocument("freelayer", fi.fileInfo, fi.sinkFileInfo(), sink
+                     , [this](std::ostream &os)
+        {
+            auto fl(vts::freeLayer
+                    (vts::meshTilesConfig
+                     (properties(), vts::ExtraTileSetProperties()
+                      , prependRoot(fs::path(), resource()
+                                    , ResourceRoot::none))));
+            vr::saveFreeLayer(os, fl);
+        });
         return {};
-    }
 
     default: break;
     }
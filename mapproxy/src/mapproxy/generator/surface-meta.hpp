@@ -27,8 +27,13 @@
 #ifndef mapproxy_generator_surface_meta_hpp_included_
 #define mapproxy_generator_surface_meta_hpp_included_
 
+#include <mutex>
+
+#include <boost/optional.hpp>
+
 #include "../generator.hpp"
 #include "../definition.hpp"
+#include "../support/storefile.hpp"
 
 #include "providers.hpp"
 
@@ -55,6 +60,11 @@ private:
     Generator::Task tileindex(const SurfaceFileInfo &fileInfo, Sink &sink)
         const;
 
+    /** Returns rewritten tile index materialized in the store for current
+     *  surface and tms revisions, builds it if missing.
+     */
+    StoreFile tileindexFile() const;
+
     vts::FullTileSetProperties properties() const;
 
     const Definition &definition_;
@@ -71,6 +81,14 @@ private:
     VtsAtlasProvider *atlas_;
 
     MetatileOverrides metatileOverrides_;
+
+    /** Materialized rewritten tile index, built once per surface and tms
+     *  revision pair. Lock is held while building, i.e. concurrent first
+     *  requests wait for single build.
+     */
+    mutable std::mutex tileindexLock_;
+    mutable boost::optional<StoreFile> tileindex_;
+    mutable boost::filesystem::path tileindexPath_;
 };
 
 } // namespace generator
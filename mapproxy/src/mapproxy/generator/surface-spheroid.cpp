@@ -25,6 +25,11 @@
  */
 
 #include <new>
+#include <map>
+#include <array>
+#include <cmath>
+#include <mutex>
+#include <tuple>
 
 #include <boost/filesystem.hpp>
 #include <boost/format.hpp>
@@ -66,6 +71,7 @@ namespace fs = boost::filesystem;
 namespace vr = vtslibs::registry;
 namespace vs = vtslibs::storage;
 namespace vts = vtslibs::vts;
+namespace ublas = boost::numeric::ublas;
 
 namespace generator {
 
@@ -81,6 +87,8 @@ struct Factory : Generator::Factory {
 
     virtual bool systemInstance() const { return true; }
 
+    virtual bool deliveryIndex() const { return true; }
+
 private:
     static utility::PreMain register_;
 };
@@ -92,9 +100,211 @@ utility::PreMain Factory::register_([]()
 
 } // namespace
 
+namespace {
+
+typedef vts::MetaNode::Flag MetaFlag;
+typedef vts::TileIndex::Flag TiFlag;
+
+inline MetaFlag::value_type ti2metaFlags(TiFlag::value_type ti)
+{
+    MetaFlag::value_type meta(MetaFlag::allChildren);
+    if (ti & TiFlag::mesh) {
+        meta |= MetaFlag::geometryPresent;
+    }
+    if (ti & TiFlag::navtile) {
+        meta |= MetaFlag::navtilePresent;
+    }
+
+    return meta;
+}
+
+/** NB: Do Not Change!
+ *
+ * This constant has huge impact on dataset stability. Changing this value break
+ * data already served to the outer world.
+ */
+const int metatileSamplesPerTile(8);
+
+/** Metanode geometry of one tile.
+ */
+struct TileGeometry {
+    vts::GeomExtents geomExtents;
+    double area = 0.0;
+    int triangleCount = 0;
+    double avgHeightSum = 0.0;
+    int avgHeightCount = 0;
+};
+
+/** Computes tile geometry of tile (i, j) from block grid.
+ */
+template <typename Mask>
+TileGeometry tileGeometry(const Grid<math::Point3> &grid
+                          , const Mask &mask, int i, int j
+                          , const vts::CsConvertor &geConv)
+{
+    TileGeometry tg;
+
+    // process all node's vertices in grid
+    for (int jj(0); jj <= metatileSamplesPerTile; ++jj) {
+        auto yy(j * metatileSamplesPerTile + jj);
+        for (int ii(0); ii <= metatileSamplesPerTile; ++ii) {
+            auto xx(i * metatileSamplesPerTile + ii);
+            const auto *p(grid(mask, xx, yy));
+
+            // update tile extents (if point valid)
+            if (p) {
+                // convert point to proper SDS
+                const auto sdPoint(geConv(*p));
+                // update geom extents
+                vts::update(tg.geomExtents, sdPoint);
+
+                // accumulate average height (surrogate) calculator
+                tg.avgHeightSum += sdPoint(2);
+                ++tg.avgHeightCount;
+            }
+
+            if (ii && jj) {
+                // compute area of the quad composed of 1 or 2 triangles
+                auto qa(quadArea(grid(mask, xx - 1, yy - 1)
+                                 , p
+                                 , grid(mask, xx - 1, yy)
+                                 , grid(mask, xx, yy - 1)));
+                tg.area += std::get<0>(qa);
+                tg.triangleCount += std::get<1>(qa);
+            }
+        }
+    }
+
+    return tg;
+}
+
+/** Probe points of a tile: corners and center in physical SRS.
+ */
+typedef std::array<math::Point3, 4> Probes;
+
+Probes probes(const math::Extents2 &te, const vts::CsConvertor &conv)
+{
+    const auto c(math::center(te));
+    return {{ conv(math::Point3(te.ll(0), te.ll(1), 0.0))
+            , conv(math::Point3(te.ur(0), te.ll(1), 0.0))
+            , conv(math::Point3(te.ll(0), te.ur(1), 0.0))
+            , conv(math::Point3(c(0), c(1), 0.0)) }};
+}
+
+/** Checks whether two tiles have the same shape up to rigid motion: all
+ *  probe distances and heights in SDS must match.
+ */
+bool sameShape(const Probes &l, const Probes &r
+               , const vts::CsConvertor &geConv)
+{
+    const auto close([](double a, double b)
+    {
+        return std::abs(a - b) <= (1e-4 + 1e-9 * std::abs(a));
+    });
+
+    for (std::size_t i(0); i < l.size(); ++i) {
+        if (!close(geConv(l[i])(2), geConv(r[i])(2))) { return false; }
+        for (std::size_t j(i + 1); j < l.size(); ++j) {
+            if (!close(ublas::norm_2(l[i] - l[j])
+                       , ublas::norm_2(r[i] - r[j])))
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+} // namespace
+
+/** Geometry of tiles of the same shape.
+ *
+ *  In most reference frames a spheroid tile's shape depends only on its lod
+ *  and row (longitudinal symmetry): geometry of the first tile in a row is
+ *  computed once and reused by all other tiles whose probe points match it
+ *  up to rigid motion (i.e. rotation about the axis or shift).
+ */
+class SurfaceSpheroid::TileTemplates {
+public:
+    TileTemplates(std::size_t limit = 1 << 14) : limit_(limit) {}
+
+    boost::optional<TileGeometry>
+    get(const std::string &srs, vts::Lod lod, const math::Extents2 &te
+        , const vts::CsConvertor &conv, const vts::CsConvertor &geConv);
+
+private:
+    struct Template {
+        Probes probes;
+        TileGeometry geometry;
+    };
+
+    // template key: srs, lod and tile's extents in y and width
+    typedef std::tuple<std::string, vts::Lod, double, double, double> Key;
+    typedef std::map<Key, std::shared_ptr<const Template>> Templates;
+
+    const std::size_t limit_;
+    std::mutex mutex_;
+    Templates templates_;
+};
+
+boost::optional<TileGeometry>
+SurfaceSpheroid::TileTemplates::get(const std::string &srs, vts::Lod lod
+                                    , const math::Extents2 &te
+                                    , const vts::CsConvertor &conv
+                                    , const vts::CsConvertor &geConv)
+{
+    const Key key(srs, lod, te.ll(1), te.ur(1), te.ur(0) - te.ll(0));
+    const auto tileProbes(probes(te, conv));
+
+    std::shared_ptr<const Template> tmpl;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        auto ftemplates(templates_.find(key));
+        if (ftemplates != templates_.end()) { tmpl = ftemplates->second; }
+    }
+
+    if (tmpl) {
+        // shape mismatch (no symmetry in this SRS) -> compute from grid
+        if (!sameShape(tmpl->probes, tileProbes, geConv)) {
+            return boost::none;
+        }
+        return tmpl->geometry;
+    }
+
+    // no template yet, compute this tile's geometry in its own grid
+    const math::Size2 gridSize(metatileSamplesPerTile + 1
+                               , metatileSamplesPerTile + 1);
+    const auto ts(math::size(te));
+    const math::Size2f gts(ts.width / metatileSamplesPerTile
+                           , ts.height / metatileSamplesPerTile);
+
+    Grid<math::Point3> grid(gridSize);
+    for (int j(0); j < gridSize.height; ++j) {
+        auto y(te.ur(1) - j * gts.height);
+        for (int i(0); i < gridSize.width; ++i) {
+            grid(i, j) = conv(math::Point3(te.ll(0) + i * gts.width, y, 0.0));
+        }
+    }
+
+    auto t(std::make_shared<Template>());
+    t->probes = tileProbes;
+    t->geometry = tileGeometry(grid, [](int, int) { return true; }
+                               , 0, 0, geConv);
+
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (templates_.size() >= limit_) { templates_.clear(); }
+        templates_.emplace(key, t);
+    }
+
+    return t->geometry;
+}
+
 SurfaceSpheroid::SurfaceSpheroid(const Params &params)
     : SurfaceBase(params)
     , definition_(resource().definition<Definition>())
+    , templates_(std::make_shared<TileTemplates>())
 {
     // TODO: do not load existing file if system and something changed
     if (loadFiles(definition_)) {
@@ -195,19 +405,23 @@ void SurfaceSpheroid::prepare_impl(Arsenal&)
     fs::rename(tmpPath, deliveryIndexPath);
 
     index_ = boost::in_place(referenceFrame().metaBinaryOrder
-                             , deliveryIndexPath);
+                             , deliveryIndexPath
+                             , config().denseTileIndexLods
+                             , config().indexMapPolicy);
 }
 
 vts::MapConfig SurfaceSpheroid::mapConfig_impl(ResourceRoot root) const
 {
     const auto path(prependRoot(fs::path(), resource(), root));
+    // metadata may change, see Generator::updateMetadata
+    const auto &def(resource().definition<Definition>());
 
     auto mc(vts::mapConfig
             (properties_, resource().registry
-             , extraProperties(definition_), path));
+             , extraProperties(def), path));
 
     // position
-    if (!definition_.introspection.position) {
+    if (!def.introspection.position) {
         // no introspection position, generate some
 
         // look down
@@ -226,33 +440,6 @@ vts::MapConfig SurfaceSpheroid::mapConfig_impl(ResourceRoot root) const
     return mc;
 }
 
-namespace {
-
-typedef vts::MetaNode::Flag MetaFlag;
-typedef vts::TileIndex::Flag TiFlag;
-
-inline MetaFlag::value_type ti2metaFlags(TiFlag::value_type ti)
-{
-    MetaFlag::value_type meta(MetaFlag::allChildren);
-    if (ti & TiFlag::mesh) {
-        meta |= MetaFlag::geometryPresent;
-    }
-    if (ti & TiFlag::navtile) {
-        meta |= MetaFlag::navtilePresent;
-    }
-
-    return meta;
-}
-
-/** NB: Do Not Change!
- *
- * This constant has huge impact on dataset stability. Changing this value break
- * data already served to the outer world.
- */
-const int metatileSamplesPerTile(8);
-
-} // namespace
-
 void SurfaceSpheroid::generateMetatile(const vts::TileId &tileId
                                        , Sink &sink
                                        , const SurfaceFileInfo &fi
@@ -337,13 +524,6 @@ void SurfaceSpheroid::generateMetatile(const vts::TileId &tileId
                    << "], ancestor: " << block.commonAncestor.nodeId()
                    << ", tile offset: " << block.offset;
 
-        // grid (in grid coordinates); fill in with invalid numbers
-        Grid<math::Point3> grid
-            (gridSize, math::Point3(std::numeric_limits<double>::quiet_NaN()));
-
-        // grid mask
-        const ShiftMask mask(block, metatileSamplesPerTile);
-
         // tile size in grid and in real SDS
         math::Size2f gts
             (es.width / (metatileSamplesPerTile * bSize.width)
@@ -355,20 +535,41 @@ void SurfaceSpheroid::generateMetatile(const vts::TileId &tileId
         auto navConv(sds2nav(block.commonAncestor, definition_.geoidGrid));
         auto geConv(phys2sds(block.commonAncestor));
 
-        // fill in matrix
-        for (int j(0), je(gridSize.height); j < je; ++j) {
-            auto y(extents.ur(1) - j * gts.height);
-            for (int i(0), ie(gridSize.width); i < ie; ++i) {
-                // work only with non-masked pixels
-                if (mask(i, j)) {
-                    grid(i, j)
-                        = conv(math::Point3
-                               (extents.ll(0) + i * gts.width, y, 0.0));
+        // grid mask
+        const ShiftMask mask(block, metatileSamplesPerTile);
+
+        // grid (in grid coordinates), computed only when some tile cannot
+        // use a template
+        boost::optional<Grid<math::Point3>> grid;
+        auto blockGrid([&]() -> const Grid<math::Point3>&
+        {
+            if (grid) { return *grid; }
+
+            // fill in with invalid numbers
+            grid = boost::in_place
+                (gridSize
+                 , math::Point3(std::numeric_limits<double>::quiet_NaN()));
+
+            // fill in matrix
+            for (int j(0), je(gridSize.height); j < je; ++j) {
+                auto y(extents.ur(1) - j * gts.height);
+                for (int i(0), ie(gridSize.width); i < ie; ++i) {
+                    // work only with non-masked pixels
+                    if (mask(i, j)) {
+                        (*grid)(i, j)
+                            = conv(math::Point3
+                                   (extents.ll(0) + i * gts.width, y, 0.0));
+                    }
                 }
             }
-        }
+            return *grid;
+        });
+
+        // templates are usable only in fully covered subtrees
+        const bool useTemplates(!block.commonAncestor.partial());
 
         // generate metatile content
+        const auto flags(index_->tileIndex.rangeFlags(tileId.lod, view));
         for (int j(0), je(bSize.height); j < je; ++j) {
             for (int i(0), ie(bSize.width); i < ie; ++i) {
                 // ID of current tile
@@ -377,50 +578,42 @@ void SurfaceSpheroid::generateMetatile(const vts::TileId &tileId
 
                 // build metanode
                 vts::MetaNode node;
-                node.flags(ti2metaFlags(index_->tileIndex.get(nodeId)));
+                node.flags(ti2metaFlags(flags[j * bSize.width + i]));
                 bool geometry(node.geometry());
                 bool navtile(node.navtile());
 
-                // compute tile extents and height range
-                auto heightRange(vs::Range<double>::emptyRange());
-                // math::Extents3 te(math::InvalidExtents{});
-                double area(0);
-                int triangleCount(0);
-                double avgHeightSum(0.f);
-                int avgHeightCount(0);
-
-                // process all node's vertices in grid
-                for (int jj(0); jj <= metatileSamplesPerTile; ++jj) {
-                    auto yy(j * metatileSamplesPerTile + jj);
-                    for (int ii(0); ii <= metatileSamplesPerTile; ++ii) {
-                        auto xx(i * metatileSamplesPerTile + ii);
-                        const auto *p(grid(mask, xx, yy));
-
-                        // update tile extents (if point valid)
-                        if (p) {
-                            // math::update(te, *p);
-                            // convert point to proper SDS
-                            const auto sdPoint(geConv(*p));
-                            // update geom extents
-                            vts::update(node.geomExtents, sdPoint);
-
-                            // accumulate average height (surrogate) calculator
-                            avgHeightSum += sdPoint(2);
-                            ++avgHeightCount;
-                        }
+                // tile geometry: from template of the same shaped tile if
+                // possible, from the block grid otherwise
+                boost::optional<TileGeometry> tg;
+                if (useTemplates) {
+                    const math::Extents2 te
+                        (extents.ll(0) + i * ts.width
+                         , extents.ur(1) - (j + 1) * ts.height
+                         , extents.ll(0) + (i + 1) * ts.width
+                         , extents.ur(1) - j * ts.height);
+                    tg = templates_->get(block.srs, tileId.lod, te
+                                         , conv, geConv);
+                }
 
-                        if (geometry && ii && jj) {
-                            // compute area of the quad composed of 1 or 2
-                            // triangles
-                            auto qa(quadArea(grid(mask, xx - 1, yy - 1)
-                                             , p
-                                             , grid(mask, xx - 1, yy)
-                                             , grid(mask, xx, yy - 1)));
-                            area += std::get<0>(qa);
-                            triangleCount += std::get<1>(qa);
-                        }
+                if (!tg) {
+                    tg = tileGeometry(blockGrid(), mask, i, j, geConv);
+                }
+
+                node.geomExtents = tg->geomExtents;
+                const auto area(tg->area);
+                const auto triangleCount(tg->triangleCount);
+                const auto avgHeightSum(tg->avgHeightSum);
+                const auto avgHeightCount(tg->avgHeightCount);
+
+                // compute height range
+                auto heightRange(vs::Range<double>::emptyRange());
+                if (navtile) {
+                    for (int jj(0); jj <= metatileSamplesPerTile; ++jj) {
+                        auto yy(j * metatileSamplesPerTile + jj);
+                        for (int ii(0); ii <= metatileSamplesPerTile; ++ii) {
+                            auto xx(i * metatileSamplesPerTile + ii);
+                            if (!mask(xx, yy)) { continue; }
 
-                        if (p && navtile) {
                             // sample height in navtile
                             auto z(navConv
                                    (math::Point3
@@ -495,9 +688,9 @@ void SurfaceSpheroid::generateMetatile(const vts::TileId &tileId
     }
 
     // write metatile to stream
-    std::ostringstream os;
-    metatile.save(os);
-    sink.content(os.str(), fi.sinkFileInfo());
+    const auto os(OutputBuffer::create());
+    metatile.save(*os);
+    sink.content(os, fi.sinkFileInfo());
 }
 
 AugmentedMesh
@@ -617,16 +810,16 @@ void SurfaceSpheroid::generateNavtile(const vts::TileId &tileId
     }
 
     // done
-    std::ostringstream os;
+    const auto os(OutputBuffer::create());
     if (fi.flavor == vts::FileFlavor::raw) {
         // raw navtile -> serialize to on-disk format
-        nt.serialize(os);
+        nt.serialize(*os);
     } else {
         // just navtile itself
-        nt.serializeNavtileProper(os);
+        nt.serializeNavtileProper(*os);
     }
 
-    sink.content(os.str(), fi.sinkFileInfo());
+    sink.content(os, fi.sinkFileInfo());
 }
 
 unsigned int SurfaceSpheroid::generatorRevision() const {
@@ -27,6 +27,8 @@
 #ifndef mapproxy_generator_surface_spheroid_hpp_included_
 #define mapproxy_generator_surface_spheroid_hpp_included_
 
+#include <memory>
+
 #include "vts-libs/vts/tileset/tilesetindex.hpp"
 #include "vts-libs/vts/tileset/properties.hpp"
 
@@ -73,7 +75,10 @@ private:
 
     const Definition &definition_;
 
-
+    /** Geometry templates of same shaped tiles (see generateMetatile).
+     */
+    class TileTemplates;
+    std::shared_ptr<TileTemplates> templates_;
 };
 
 } // namespace generator
@@ -25,6 +25,7 @@
  */
 
 #include <new>
+#include <algorithm>
 
 #include <boost/filesystem.hpp>
 #include <boost/format.hpp>
@@ -32,12 +33,14 @@
 #include <boost/lexical_cast.hpp>
 
 #include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
 
 #include "utility/raise.hpp"
 #include "utility/path.hpp"
-#include "utility/gzipper.hpp"
 #include "utility/cppversion.hpp"
 
+#include "jsoncpp/json.hpp"
+
 #include "imgproc/rastermask/cvmat.hpp"
 #include "imgproc/png.hpp"
 
@@ -70,6 +73,11 @@
 #include "../support/tms.hpp"
 #include "../support/introspection.hpp"
 #include "../support/atlas.hpp"
+#include "../support/meshcompress.hpp"
+#include "../support/compression.hpp"
+#include "../support/normalmap.hpp"
+#include "../support/scratch.hpp"
+#include "../support/pngencode.hpp"
 
 #include "files.hpp"
 #include "surface.hpp"
@@ -182,6 +190,8 @@ SurfaceBase::SurfaceBase(const Params &params)
     : Generator(params, terrainSupport(params))
     , definition_(resource().definition<Definition>())
     , tms_(params.resource.referenceFrame->findExtension<vre::Tms>())
+    , terrainBoundRevision_()
+    , cache2dSize_(), cache2dRevision_()
 {
     setProvider(std::make_unique<SurfaceProvider>(*this));
 }
@@ -208,19 +218,16 @@ bool SurfaceBase::loadFiles(const Definition &definition)
 
             if (!fs::exists(deliveryIndexPath)) {
                 // no delivery index -> create
-                vts::tileset::Index index(referenceFrame().metaBinaryOrder);
-                vts::tileset::loadTileSetIndex(index, indexPath);
-
-                // convert it to delivery index (using a temporary file)
-                const auto tmpPath(utility::addExtension
-                                   (deliveryIndexPath, ".tmp"));
-                mmapped::TileIndex::write(tmpPath, index.tileIndex);
-                fs::rename(tmpPath, deliveryIndexPath);
+                mmapped::convertDeliveryIndex
+                    (referenceFrame().metaBinaryOrder, indexPath
+                     , deliveryIndexPath);
             }
 
             // load delivery index
             index_ = boost::in_place(referenceFrame().metaBinaryOrder
-                                     , deliveryIndexPath);
+                                     , deliveryIndexPath
+                                     , config().denseTileIndexLods
+                                     , config().indexMapPolicy);
             // it is now up to child class to handle this
             // makeReady();
             return true;
@@ -233,6 +240,24 @@ bool SurfaceBase::loadFiles(const Definition &definition)
     return false;
 }
 
+Generator::Warmup SurfaceBase::warmup_impl() const
+{
+    Warmup warmup;
+    if (index_) {
+        warmup.prefaulted += index_->tileIndex.prefault();
+        warmup.ext = "bin";
+    }
+    return warmup;
+}
+
+void SurfaceBase::memory_impl(Memory &memory) const
+{
+    if (index_) { memory.add("index", index_->tileIndex); }
+
+    std::unique_lock<std::mutex> lock(cache2dMutex_);
+    memory.add("2d", cache2dSize_);
+}
+
 bool SurfaceBase::updateProperties(const Definition &def)
 {
     bool changed(false);
@@ -283,28 +308,30 @@ Generator::Task SurfaceBase
         sink.error(utility::makeError<NotFound>("Unrecognized filename."));
         break;
 
-    case SurfaceFileInfo::Type::definition: {
-        auto fl(vts::freeLayer
-                (vts::meshTilesConfig
-                 (properties_, vts::ExtraTileSetProperties()
-                  , prependRoot(fs::path(), resource(), ResourceRoot::none))));
-
-        std::ostringstream os;
-        vr::saveFreeLayer(os, fl);
-        sink.content(os.str(), fi.sinkFileInfo());
+    case SurfaceFileInfo::Type::definition:
+        sendDocument("freelayer", fi.fileInfo, fi.sinkFileInfo(), sink
+                     , [this](std::ostream &os)
+        {
+            auto fl(vts::freeLayer
+                    (vts::meshTilesConfig
+                     (properties_, vts::ExtraTileSetProperties()
+                      , prependRoot(fs::path(), resource()
+                                    , ResourceRoot::none))));
+            vr::saveFreeLayer(os, fl);
+        });
         break;
-    }
 
     case SurfaceFileInfo::Type::file: {
         switch (fi.fileType) {
         case vts::File::config: {
             switch (fi.flavor) {
-            case vts::FileFlavor::regular: {
-                std::ostringstream os;
-                mapConfig(os, ResourceRoot::none);
-                sink.content(os.str(), fi.sinkFileInfo());
+            case vts::FileFlavor::regular:
+                sendDocument("mapConfig", fi.fileInfo, fi.sinkFileInfo()
+                             , sink, [this](std::ostream &os)
+                {
+                    mapConfig(os, ResourceRoot::none);
+                });
                 break;
-            }
 
             case vts::FileFlavor::raw:
                 sink.content(vs::fileIStream
@@ -413,7 +440,8 @@ Generator::Task SurfaceBase
     }
 
     case SurfaceFileInfo::Type::support:
-        supportFile(*fi.support, sink, fi.sinkFileInfo());
+        supportFile(*fi.support, sink, fi.sinkFileInfo()
+                    , fi.fileInfo.acceptGzip);
         break;
 
     case SurfaceFileInfo::Type::registry:
@@ -447,6 +475,10 @@ void SurfaceBase::generateMesh(const vts::TileId &tileId
         utility::raise<NotFound>("No mesh for this tile.");
     }
 
+    if (fi.compressedMesh && !definition_.compressedMesh) {
+        utility::raise<NotFound>("Compressed mesh not enabled.");
+    }
+
     vts::NodeInfo nodeInfo(referenceFrame(), tileId);
     if (!nodeInfo.productive()) {
         utility::raise<NotFound>
@@ -473,25 +505,30 @@ void SurfaceBase::generateMesh(const vts::TileId &tileId
 
         if (raw) {
             // we are returning full mesh file -> generate coverage mask
-            meshCoverageMask
-                (mesh.coverageMask, lm.mesh, nodeInfo, lm.fullyCovered);
+            meshCoverageMask(mesh.coverageMask, lm, nodeInfo);
         }
     }
 
     // write mesh to stream
-    std::stringstream os;
+    const auto os(OutputBuffer::create());
     auto sfi(fi.sinkFileInfo());
-    if (raw) {
-        vts::saveMesh(os, mesh);
-    } else {
-        vts::saveMeshProper(os, mesh);
-        if (vs::gzipped(os)) {
-            // gzip -> mesh
+    {
+        const auto scope(sink.traceStage("encode"));
+        if (raw) {
+            vts::saveMesh(*os, mesh);
+        } else if (fi.compressedMesh) {
+            saveCompressedMesh(*os, mesh);
             sfi.addHeader("Content-Encoding", "gzip");
+        } else {
+            vts::saveMeshProper(*os, mesh);
+            if (os->gzipped()) {
+                // gzip -> mesh
+                sfi.addHeader("Content-Encoding", "gzip");
+            }
         }
     }
 
-    sink.content(os.str(), sfi);
+    sink.content(os, sfi);
 }
 
 
@@ -538,18 +575,37 @@ void SurfaceBase::generateNormalMap(const vts::TileId &tileId
         optimize = true;
     }
 
-    // actual conversion
-    geo::normalmap::convertNormals(
-        normalMap, nodeInfo.extents(), conv.conv(), extraConv, optimize);
-
-    // octahedron encoding (mandatory only if expected by the client)
-    geo::normalmap::encodeOct(normalMap);
+    ScratchMat img;
+    {
+        const auto scope(sink.traceStage("normals"));
+
+        // conversion, octahedron encoding and quantization in one pass
+        exportNormals(normalMap
+                      , img.create(normalMap.rows, normalMap.cols, CV_8UC3)
+                      , nodeInfo.extents(), conv, extraConv
+                      , (optimize ? NormalRotation::perTile
+                         : NormalRotation::grid));
+    }
 
-    // obtain the final image, write to stream
     auto sfi(fi.sinkFileInfo());
 
-    cv::Mat img = geo::normalmap::exportToBGR(normalMap);
-    sendImage(img, sfi, RasterNormalMapFormat, false, sink);
+    // adaptive normal map below full size: upscale cheaply if asked to
+    if ((definition_.normalMaps
+         == resource::Surface::NormalMaps::adaptiveUpscale)
+        && (img.mat().cols < 256))
+    {
+        cv::Mat upscaled;
+        {
+            const auto scope(sink.traceStage("upscale"));
+            cv::resize(img.mat(), upscaled, cv::Size(256, 256), 0, 0
+                       , cv::INTER_LINEAR);
+        }
+        sendImage(upscaled, sfi, RasterNormalMapFormat, false, sink);
+        return;
+    }
+
+    // obtain the final image, write to stream
+    sendImage(img.mat(), sfi, RasterNormalMapFormat, false, sink);
 }
 
 cv::Mat SurfaceBase::generateNormalMapImpl(
@@ -560,6 +616,84 @@ cv::Mat SurfaceBase::generateNormalMapImpl(
 }
 
 
+namespace {
+
+/** Limits of the 2D cache: number of entries and bytes held.
+ */
+const std::size_t Cache2dLimit(1 << 14);
+const std::size_t Cache2dMemoryLimit(std::size_t(64) << 20);
+
+template <typename T>
+std::shared_ptr<const std::string> encoded(const T &data)
+{
+    return std::make_shared<const std::string>(data.begin(), data.end());
+}
+
+} // namespace
+
+SurfaceBase::Encoded2d
+SurfaceBase::encoded2d(vts::TileFile type, const vts::TileId &tileId
+                       , bool debug
+                       , const std::function<Encoded2d()> &encode) const
+{
+    const Key2d key(type, debug, tileId);
+    const auto revision(resource().revision);
+
+    {
+        std::unique_lock<std::mutex> lock(cache2dMutex_);
+        if (cache2dRevision_ != revision) {
+            cache2d_.clear();
+            cache2dOrder_.clear();
+            constants2d_.clear();
+            cache2dSize_ = 0;
+            cache2dRevision_ = revision;
+        }
+
+        auto fcache2d(cache2d_.find(key));
+        if (fcache2d != cache2d_.end()) { return fcache2d->second; }
+    }
+
+    // encode outside of lock, concurrent requests for the same tile may
+    // encode it twice but the result is the same
+    auto data(encode());
+
+    std::unique_lock<std::mutex> lock(cache2dMutex_);
+    if (cache2dRevision_ != revision) { return data; }
+
+    if (!cache2d_.insert(std::make_pair(key, data)).second) { return data; }
+    cache2dOrder_.push_back(key);
+    cache2dSize_ += data->size();
+
+    while ((cache2d_.size() > Cache2dLimit)
+           || (cache2dSize_ > Cache2dMemoryLimit))
+    {
+        auto fcache2d(cache2d_.find(cache2dOrder_.front()));
+        cache2dSize_ -= fcache2d->second->size();
+        cache2d_.erase(fcache2d);
+        cache2dOrder_.pop_front();
+    }
+
+    return data;
+}
+
+SurfaceBase::Encoded2d
+SurfaceBase::constant2d(const std::string &key
+                        , const std::function<Encoded2d()> &encode) const
+{
+    {
+        std::unique_lock<std::mutex> lock(cache2dMutex_);
+        auto fconstants2d(constants2d_.find(key));
+        if (fconstants2d != constants2d_.end()) {
+            return fconstants2d->second;
+        }
+    }
+
+    auto data(encode());
+
+    std::unique_lock<std::mutex> lock(cache2dMutex_);
+    return constants2d_.insert(std::make_pair(key, data)).first->second;
+}
+
 void SurfaceBase::generate2dMask(const vts::TileId &tileId
                                  , Sink &sink
                                  , const SurfaceFileInfo &fi
@@ -587,25 +721,50 @@ void SurfaceBase::generate2dMask(const vts::TileId &tileId
                           ("TileId outside of valid reference frame tree."));
     }
 
-    // by default full watertight mesh
-    vts::MeshMask mask;
-    mask.createCoverage(true);
+    const auto encode([&](const vts::MeshMask &mask) -> Encoded2d
+    {
+        if (debug) {
+            return encoded(imgproc::png::serialize
+                           (vts::debugMask(mask.coverageMask, { 1 }), 9));
+        }
 
-    if (!vts::TileIndex::Flag::isWatertight(flags)) {
-        auto lm(generateMeshImpl(nodeInfo, sink, arsenal));
-        meshCoverageMask
-            (mask.coverageMask, lm.mesh, nodeInfo, lm.fullyCovered);
-    }
+        // wrap gil image (no copy) to use bit-packing mask encoder
+        const auto m2d(vts::mask2d(mask.coverageMask, { 1 }));
+        const auto v(boost::gil::const_view(m2d));
+        const cv::Mat m(v.height(), v.width(), CV_8UC1
+                        , const_cast<void*>
+                        (static_cast<const void*>(&v(0, 0)))
+                        , v.pixels().row_size());
+
+        std::vector<unsigned char> buf;
+        encodeMask(m, buf);
+        return encoded(buf);
+    });
 
-    if (debug) {
-        sink.content(imgproc::png::serialize
-                     (vts::debugMask(mask.coverageMask, { 1 }), 9)
-                     , fi.sinkFileInfo());
-    } else {
-        sink.content(imgproc::png::serialize
-                     (vts::mask2d(mask.coverageMask, { 1 }), 9)
-                     , fi.sinkFileInfo());
-    }
+    const auto data([&]() -> Encoded2d
+    {
+        if (vts::TileIndex::Flag::isWatertight(flags)) {
+            // full watertight mesh: same mask for every such tile
+            return constant2d
+                (debug ? "mask-full-debug" : "mask-full", [&]()
+            {
+                vts::MeshMask mask;
+                mask.createCoverage(true);
+                return encode(mask);
+            });
+        }
+
+        return encoded2d(vts::TileFile::mask, tileId, debug, [&]()
+        {
+            vts::MeshMask mask;
+            mask.createCoverage(true);
+            auto lm(generateMeshImpl(nodeInfo, sink, arsenal));
+            meshCoverageMask(mask.coverageMask, lm, nodeInfo);
+            return encode(mask);
+        });
+    }());
+
+    sink.content(data->data(), data->size(), fi.sinkFileInfo(), data);
 }
 
 void SurfaceBase::generate2dMetatile(const vts::TileId &tileId
@@ -614,9 +773,30 @@ void SurfaceBase::generate2dMetatile(const vts::TileId &tileId
                                      , Arsenal&) const
 
 {
-    sink.content(imgproc::png::serialize
-                 (vts::meta2d(index_->tileIndex, tileId), 9)
-                 , fi.sinkFileInfo());
+    const auto data(encoded2d(vts::TileFile::meta2d, tileId, false, [&]()
+    {
+        const auto meta(vts::meta2d(index_->tileIndex, tileId));
+
+        // uniform metatile (subtree fully covered or fully empty): share
+        // single response among all such tiles
+        const auto v(boost::gil::const_view(meta));
+        const auto first(v(0, 0));
+        if (std::all_of(v.begin(), v.end(), [&](decltype(first) px)
+                        { return px == first; }))
+        {
+            const auto key(str(boost::format("meta2d-%dx%d-%d")
+                               % v.width() % v.height()
+                               % int(boost::gil::at_c<0>(first))));
+            return constant2d(key, [&]()
+            {
+                return encoded(imgproc::png::serialize(meta, 9));
+            });
+        }
+
+        return encoded(imgproc::png::serialize(meta, 9));
+    }));
+
+    sink.content(data->data(), data->size(), fi.sinkFileInfo(), data);
 }
 
 void SurfaceBase::generateCredits(const vts::TileId&
@@ -699,6 +879,18 @@ SurfaceBase::extraProperties(const Definition &def) const
     // browser options (must be Json::Value!)
     extra.browserOptions = def.introspection.browserOptions;
 
+    if (def.compressedMesh) {
+        // advertise compressed mesh flavor, unaware clients ignore it
+        Json::Value options(Json::objectValue);
+        if (!extra.browserOptions.empty()) {
+            options = boost::any_cast<const Json::Value&>
+                (extra.browserOptions);
+        }
+        options["compressedMesh"][r.id.fullId()]
+            = SurfaceFileInfo::CompressedMeshUrl;
+        extra.browserOptions = options;
+    }
+
     return extra;
 }
 
@@ -735,7 +927,8 @@ Generator::Task SurfaceBase
         break;
 
     case TerrainFileInfo::Type::support:
-        supportFile(*fi.support, sink, fi.sinkFileInfo());
+        supportFile(*fi.support, sink, fi.sinkFileInfo()
+                    , fi.fileInfo.acceptGzip);
         break;
 
     case TerrainFileInfo::Type::cesiumConf:
@@ -792,16 +985,20 @@ void SurfaceBase::generateTerrain(const vts::TileId &tmsTileId
         auto lm(meshFromNode(nodeInfo, math::Size2(10, 10)));
 
         // write mesh to stream (gzipped)
-        std::ostringstream os;
-        qmf::save(qmfMesh(lm.mesh, nodeInfo
-                          , (tms.physicalSrs ? *tms.physicalSrs
-                             : referenceFrame().model.physicalSrs)
-                          , definition_.getGeoidGrid())
-                  , utility::Gzipper(os), fi.fileInfo.filename);
+        const auto os(OutputBuffer::create());
+        {
+            compression::Gzipper gzipper
+                (*os, compression::Target::terrain);
+            qmf::save(qmfMesh(std::move(lm.mesh), nodeInfo
+                              , (tms.physicalSrs ? *tms.physicalSrs
+                                 : referenceFrame().model.physicalSrs)
+                              , definition_.getGeoidGrid())
+                      , gzipper, fi.fileInfo.filename);
+        }
 
         auto sfi(fi.sinkFileInfo());
         sfi.addHeader("Content-Encoding", "gzip");
-        sink.content(os.str(), sfi);
+        sink.content(os, sfi);
 
         return true;
     });
@@ -819,22 +1016,30 @@ void SurfaceBase::generateTerrain(const vts::TileId &tmsTileId
     }
 
     // generate the actual mesh; replace all no-data values with zero
-    auto lm(generateMeshImpl(nodeInfo, sink, arsenal, 0.0));
+    auto lm(generateTerrainMeshImpl(nodeInfo, sink, arsenal));
 
     // write mesh to stream (gzipped)
-    std::ostringstream os;
-    qmf::save(qmfMesh(lm.mesh, nodeInfo
-                      , (tms.physicalSrs ? *tms.physicalSrs
-                         : referenceFrame().model.physicalSrs)
-                      , lm.geoidGrid)
-              , utility::Gzipper(os), fi.fileInfo.filename);
+    const auto os(OutputBuffer::create());
+    {
+        compression::Gzipper gzipper(*os, compression::Target::terrain);
+        qmf::save(qmfMesh(std::move(lm.mesh), nodeInfo
+                          , (tms.physicalSrs ? *tms.physicalSrs
+                             : referenceFrame().model.physicalSrs)
+                          , lm.geoidGrid)
+                  , gzipper, fi.fileInfo.filename);
+    }
 
     auto sfi(fi.sinkFileInfo());
     sfi.addHeader("Content-Encoding", "gzip");
-    sink.content(os.str(), sfi);
+    sink.content(os, sfi);
 }
 
-namespace {
+AugmentedMesh SurfaceBase
+::generateTerrainMeshImpl(const vts::NodeInfo &nodeInfo, Sink &sink
+                          , Arsenal &arsenal) const
+{
+    return generateMeshImpl(nodeInfo, sink, arsenal, 0.0);
+}
 
 struct TerrainBound {
     LayerJson::Available available;
@@ -843,6 +1048,8 @@ struct TerrainBound {
     TerrainBound() : bounds(math::InvalidExtents{}) {}
 };
 
+namespace {
+
 TerrainBound terrainBounds(const Resource &r, const vre::Tms &tms)
 {
     TerrainBound tb;
@@ -889,46 +1096,64 @@ TerrainBound terrainBounds(const Resource &r, const vre::Tms &tms)
 
 } // namespace
 
-void SurfaceBase::layerJson(Sink &sink, const TerrainFileInfo &fi
-                            , const vre::Tms &tms) const
+std::shared_ptr<const TerrainBound>
+SurfaceBase::terrainBound(const vre::Tms &tms) const
 {
-    LayerJson layer;
     const auto &r(resource());
 
-    layer.name = id().fullId();
-    layer.description = r.comment;
-
-    // use revision as major version (plus 1)
-    layer.version.maj = r.revision + 1;
-    layer.format = "quantized-mesh-1.0";
-    layer.scheme = LayerJson::Scheme::tms;
-    layer.tiles.push_back
-        (utility::format("{z}-{x}-{y}.terrain%s"
-                         , RevisionWrapper(r.revision, "?")));
-    layer.projection = tms.projection;
-
-    // fixed LOD range
-    layer.zoom.min = 0; // r.lodRange.min - tms.rootId.lod;
-    layer.zoom.max = r.lodRange.max - tms.rootId.lod;
-
-    auto tb(terrainBounds(r, tms));
-    layer.available = std::move(tb.available);
-    layer.bounds = std::move(tb.bounds);
-
-    if (!r.credits.empty()) {
-        layer.attribution
-            = boost::lexical_cast<std::string>
-            (utility::join(html(asInlineCredits(r)), "<br/>"));
+    std::unique_lock<std::mutex> lock(terrainBoundMutex_);
+    if (!terrainBound_ || (terrainBoundRevision_ != r.revision)) {
+        // walks all metatile blocks of all lods, do it once per revision
+        terrainBound_ = std::make_shared<TerrainBound>(terrainBounds(r, tms));
+        terrainBoundRevision_ = r.revision;
     }
+    return terrainBound_;
+}
 
-    std::ostringstream os;
-    save(layer, os);
-    sink.content(os.str(), fi.sinkFileInfo());
+void SurfaceBase::layerJson(Sink &sink, const TerrainFileInfo &fi
+                            , const vre::Tms &tms) const
+{
+    sendDocument("layer.json", fi.fileInfo, fi.sinkFileInfo(), sink
+                 , [&](std::ostream &os)
+    {
+        LayerJson layer;
+        const auto &r(resource());
+
+        layer.name = id().fullId();
+        layer.description = r.comment;
+
+        // use revision as major version (plus 1)
+        layer.version.maj = r.revision + 1;
+        layer.format = "quantized-mesh-1.0";
+        layer.scheme = LayerJson::Scheme::tms;
+        layer.tiles.push_back
+            (utility::format("{z}-{x}-{y}.terrain%s"
+                             , RevisionWrapper(r.revision, "?")));
+        layer.projection = tms.projection;
+
+        // fixed LOD range
+        layer.zoom.min = 0; // r.lodRange.min - tms.rootId.lod;
+        layer.zoom.max = r.lodRange.max - tms.rootId.lod;
+
+        const auto tb(terrainBound(tms));
+        layer.available = tb->available;
+        layer.bounds = tb->bounds;
+
+        if (!r.credits.empty()) {
+            layer.attribution
+                = boost::lexical_cast<std::string>
+                (utility::join(html(asInlineCredits(r)), "<br/>"));
+        }
+
+        save(layer, os);
+    });
 }
 
 void SurfaceBase::cesiumConf(Sink &sink, const TerrainFileInfo &fi
                              , const vre::Tms &tms) const
 {
+    // metadata may change, see Generator::updateMetadata
+    const auto &def(resource().definition<Definition>());
     const auto &findResource([this](Resource::Generator::Type type
                                     , const Resource::Id &id)
                              -> const Resource*
@@ -944,7 +1169,7 @@ void SurfaceBase::cesiumConf(Sink &sink, const TerrainFileInfo &fi
     CesiumConf conf;
     conf.tms = tms;
 
-    if (definition_.introspection.tms.empty()) {
+    if (def.introspection.tms.empty()) {
         if (const auto intro = introspection::remote
             (Resource::Generator::Type::tms
              , Resource::Id({}, systemGroup(), "tms-raster-patchwork")
@@ -954,14 +1179,13 @@ void SurfaceBase::cesiumConf(Sink &sink, const TerrainFileInfo &fi
         }
     } else if (const auto intro = introspection::remote
                (Resource::Generator::Type::tms
-                , definition_.introspection.tms.front()
+                , def.introspection.tms.front()
                 , resource(), findResource))
     {
         conf.boundLayer = intro->url;
     }
 
-    const auto tb(terrainBounds(resource(), tms));
-    conf.defaultView = tb.bounds;
+    conf.defaultView = terrainBound(tms)->bounds;
 
     std::ostringstream os;
     save(conf, os);
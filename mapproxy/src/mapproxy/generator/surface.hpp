@@ -27,6 +27,14 @@
 #ifndef mapproxy_generator_surface_hpp_included_
 #define mapproxy_generator_surface_hpp_included_
 
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+
 #include <boost/optional.hpp>
 
 #include "vts-libs/registry/extensions.hpp"
@@ -45,6 +53,8 @@ namespace vre = vtslibs::registry::extensions;
 
 namespace generator {
 
+struct TerrainBound;
+
 class SurfaceBase : public Generator {
 public:
     SurfaceBase(const Params &params);
@@ -62,6 +72,14 @@ protected:
 
     virtual unsigned int generatorRevision() const { return 0; }
 
+    /** Prefaults delivery index; meshes are worth rendering.
+     */
+    Warmup warmup_impl() const override;
+
+    /** Adds delivery index.
+     */
+    void memory_impl(Memory &memory) const override;
+
 protected:
     const vre::Tms& getTms() const;
 
@@ -102,6 +120,25 @@ private:
                             , const SurfaceFileInfo &fileInfo
                             , Arsenal &arsenal) const;
 
+    /** Encoded 2D interface output (2D mask or 2D metatile).
+     */
+    typedef std::shared_ptr<const std::string> Encoded2d;
+
+    /** Returns encoded 2D output of given tile file and flavor from the 2D
+     *  cache; it is encoded by given function and cached if missing. Cache
+     *  is dropped when resource revision changes.
+     */
+    Encoded2d encoded2d(vts::TileFile type, const vts::TileId &tileId
+                        , bool debug
+                        , const std::function<Encoded2d()> &encode) const;
+
+    /** Returns shared constant response for given encoded 2D output if
+     *  there is an identical one already, registers it otherwise. Used for
+     *  outputs of fully covered subtrees, same for many tiles.
+     */
+    Encoded2d constant2d(const std::string &key
+                         , const std::function<Encoded2d()> &encode) const;
+
     void generateCredits(const vts::TileId &tileId
                          , Sink &sink
                          , const SurfaceFileInfo &fileInfo
@@ -131,6 +168,13 @@ private:
     virtual cv::Mat generateNormalMapImpl(const vts::NodeInfo &nodeInfo
                      , Sink &sink, Arsenal &arsenal) const;
 
+    /** Mesh for terrain interface, holes filled with zero height. Defaults
+     *  to generateMeshImpl.
+     */
+    virtual AugmentedMesh
+    generateTerrainMeshImpl(const vts::NodeInfo &nodeInfo
+                            , Sink &sink, Arsenal &arsenal) const;
+
     /** Cesium terrain provider support. Generates non-VTS mesh.
      */
 
@@ -149,9 +193,29 @@ private:
 
     std::string cesiumReadme() const;
 
+    /** Terrain availability and bounds, computed once per resource revision.
+     */
+    std::shared_ptr<const TerrainBound>
+    terrainBound(const vre::Tms &tms) const;
+
     const Definition &definition_;
     const vre::Tms *tms_;
 
+    mutable std::mutex terrainBoundMutex_;
+    mutable std::shared_ptr<const TerrainBound> terrainBound_;
+    mutable unsigned int terrainBoundRevision_;
+
+    typedef std::tuple<vts::TileFile, bool, vts::TileId> Key2d;
+
+    /** Encoded 2D outputs, oldest dropped first when full.
+     */
+    mutable std::mutex cache2dMutex_;
+    mutable std::map<Key2d, Encoded2d> cache2d_;
+    mutable std::deque<Key2d> cache2dOrder_;
+    mutable std::size_t cache2dSize_;
+    mutable unsigned int cache2dRevision_;
+    mutable std::map<std::string, Encoded2d> constants2d_;
+
     friend class SurfaceProvider;
 };
 
@@ -24,7 +24,10 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <ctime>
 #include <future>
+#include <mutex>
+#include <vector>
 
 #include <boost/filesystem.hpp>
 #include <boost/format.hpp>
@@ -48,6 +51,7 @@
 
 #include "../error.hpp"
 #include "../support/metatile.hpp"
+#include "../support/precompressed.hpp"
 
 #include "tms-bing.hpp"
 #include "factory.hpp"
@@ -82,6 +86,7 @@ utility::PreMain Factory::register_([]()
 TmsBing::TmsBing(const Params &params)
     : Generator(params)
     , definition_(resource().definition<Definition>())
+    , tileUrlCache_(std::make_shared<TileUrlCache>())
 {
     LOG(info1) << "Generator for <" << id() << "> not ready.";
 }
@@ -93,76 +98,148 @@ void TmsBing::prepare_impl(Arsenal&)
 
 namespace {
 
-template <typename Callback>
-void generateTileUrl(Sink sink, Arsenal &arsenal
-                     , const std::string &metadataUrl
-                     , Callback callback)
+/** How long is fetched Bing metadata considered valid.
+ */
+constexpr std::time_t TileUrlTtl(3600);
+
+std::string parseTileUrl(const std::string &data
+                         , const std::string &metadataUrl)
+{
+    std::istringstream in(data);
+    auto reply(Json::read<InternalError>(in, metadataUrl, "Bing metadata"));
+
+    const auto &resource(reply["resourceSets"][0]["resources"][0]);
+
+    const auto &jurl(resource["imageUrl"]);
+    if (!jurl.isString()) {
+        LOGTHROW(err1, InternalError)
+            << "Cannot find imageUrl in bind metadata reply.";
+    }
+
+    const auto jsubdomains(resource["imageUrlSubdomains"]);
+    if (!jsubdomains.isArray()) {
+        LOGTHROW(err1, InternalError)
+            << "Cannot find imageUrl in bind metadata reply.";
+    }
+
+    auto subdomains([&]() -> std::string
+    {
+        std::string res("{alt(");
+        bool first(true);
+        for (const auto &js : jsubdomains) {
+            if (first) {
+                first = false;
+            } else {
+                res.push_back(',');
+            }
+            res.append(js.asString());
+        }
+        res.append(")}");
+        return res;
+    });
+
+    auto url(jurl.asString());
+
+    // replace expandable strings
+    ba::replace_all(url, "{quadkey}", "{quad(loclod,locx,locy)}");
+    ba::replace_all(url, "{subdomain}", subdomains());
+
+    // cut-off scheme
+    if (ba::istarts_with(url, "http:")) {
+        url = url.substr(5);
+    } else if (ba::istarts_with(url, "https:")) {
+        url = url.substr(6);
+    }
+
+    return url;
+}
+
+} // namespace
+
+/** Bing metadata cache. Fetched tile URL template is kept for TileUrlTtl
+ *  seconds; concurrent requests arriving while metadata are being fetched
+ *  are queued and served by the single in-flight fetch.
+ */
+struct TmsBing::TileUrlCache {
+    typedef std::function<void(const std::string&)> Callback;
+
+    struct Waiter {
+        Sink sink;
+        Callback callback;
+        Waiter(const Sink &sink, const Callback &callback)
+            : sink(sink), callback(callback) {}
+    };
+
+    std::mutex mutex;
+    std::string url;
+    std::time_t expires = 0;
+    bool fetching = false;
+    std::vector<Waiter> waiters;
+};
+
+void TmsBing::generateTileUrl(Sink &sink, Arsenal &arsenal
+                              , const TileUrlCache::Callback &callback) const
 {
     typedef utility::ResourceFetcher::Query Query;
     typedef utility::ResourceFetcher::MultiQuery MultiQuery;
 
+    // keep cache alive even if generator is gone before fetch finishes
+    auto cache(tileUrlCache_);
+    const auto &metadataUrl(definition_.metadataUrl);
+
+    {
+        std::unique_lock<std::mutex> lock(cache->mutex);
+        if (!cache->url.empty() && (std::time(nullptr) < cache->expires)) {
+            const auto url(cache->url);
+            lock.unlock();
+            callback(url);
+            return;
+        }
+
+        cache->waiters.emplace_back(sink, callback);
+        if (cache->fetching) { return; }
+        cache->fetching = true;
+    }
+
     // fetch JSON; no reuse, reasonable timeout
     arsenal.fetcher.perform(Query(metadataUrl).reuse(false).timeout(10000)
                             , [=](const MultiQuery &query) mutable -> void
     {
+        std::string url;
+        std::exception_ptr error;
         try {
-            std::istringstream in(query.front().get().data);
-            auto reply(Json::read<InternalError>
-                       (in, metadataUrl, "Bing metadata"));
-
-            const auto &resource
-                (reply["resourceSets"][0]["resources"][0]);
+            url = parseTileUrl(query.front().get().data, metadataUrl);
+        } catch (...) {
+            error = std::current_exception();
+        }
 
-            const auto &jurl(resource["imageUrl"]);
-            if (!jurl.isString()) {
-                LOGTHROW(err1, InternalError)
-                    << "Cannot find imageUrl in bind metadata reply.";
+        std::vector<TileUrlCache::Waiter> waiters;
+        {
+            std::unique_lock<std::mutex> lock(cache->mutex);
+            cache->fetching = false;
+            if (!error) {
+                // only successful replies are cached
+                cache->url = url;
+                cache->expires = std::time(nullptr) + TileUrlTtl;
             }
+            std::swap(waiters, cache->waiters);
+        }
 
-            const auto jsubdomains(resource["imageUrlSubdomains"]);
-            if (!jsubdomains.isArray()) {
-                LOGTHROW(err1, InternalError)
-                    << "Cannot find imageUrl in bind metadata reply.";
+        for (auto &waiter : waiters) {
+            if (error) {
+                waiter.sink.error(error);
+                continue;
             }
 
-            auto subdomains([&]() -> std::string
-            {
-                std::string res("{alt(");
-                bool first(true);
-                for (const auto &js : jsubdomains) {
-                    if (first) {
-                        first = false;
-                    } else {
-                        res.push_back(',');
-                    }
-                    res.append(js.asString());
-                }
-                res.append(")}");
-                return res;
-            });
-
-            auto url(jurl.asString());
-
-            // replace expandable strings
-            ba::replace_all(url, "{quadkey}", "{quad(loclod,locx,locy)}");
-            ba::replace_all(url, "{subdomain}", subdomains());
-
-            // cut-off scheme
-            if (ba::istarts_with(url, "http:")) {
-                url = url.substr(5);
-            } else if (ba::istarts_with(url, "https:")) {
-                url = url.substr(6);
+            try {
+                waiter.callback(url);
+            } catch (...) {
+                waiter.sink.error();
             }
-
-            callback(sink, url);
-        } catch (...) {
-            sink.error();
         }
     });
 }
 
-} // namespace
-
 vr::BoundLayer TmsBing::boundLayer(ResourceRoot, const std::string &url)
     const
 {
@@ -219,16 +296,18 @@ Generator::Task TmsBing::generateFile_impl(const FileInfo &fileInfo
         break;
 
     case TmsFileInfo::Type::config: {
-        std::ostringstream os;
-        mapConfig(os, ResourceRoot::none);
-        sink.content(os.str(), fi.sinkFileInfo());
+        sendDocument("mapConfig", fi.fileInfo, fi.sinkFileInfo(), sink
+                     , [this](std::ostream &os)
+        {
+            mapConfig(os, ResourceRoot::none);
+        });
         break;
     }
 
     case TmsFileInfo::Type::definition:
         return [this, fi](Sink &sink, Arsenal &arsenal) {
-            generateTileUrl(sink, arsenal, definition_.metadataUrl
-                            , [this, fi](Sink sink, const std::string &url)
+            generateTileUrl(sink, arsenal
+                            , [this, fi, sink](const std::string &url)
                             mutable
             {
                 std::ostringstream os;
@@ -238,8 +317,8 @@ Generator::Task TmsBing::generateFile_impl(const FileInfo &fileInfo
         };
 
     case TmsFileInfo::Type::support:
-        sink.content(fi.support->data, fi.support->size
-                      , fi.sinkFileInfo(), false);
+        precompressed::send(sink, *fi.support, fi.sinkFileInfo()
+                            , fi.fileInfo.acceptGzip);
         break;
 
     case TmsFileInfo::Type::image: {
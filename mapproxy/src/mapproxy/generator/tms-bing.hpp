@@ -28,6 +28,7 @@
 #define mapproxy_generator_tms_bing_hpp_included_
 
 #include <functional>
+#include <memory>
 
 #include "../generator.hpp"
 #include "../definition/tms.hpp"
@@ -49,7 +50,18 @@ private:
 
     vr::BoundLayer boundLayer(ResourceRoot root, const std::string &url) const;
 
+    /** Calls callback with tile URL template derived from Bing metadata.
+     */
+    void generateTileUrl(Sink &sink, Arsenal &arsenal
+                         , const std::function<void(const std::string&)>
+                         &callback) const;
+
     const Definition &definition_;
+
+    /** Cached and coalesced Bing metadata (tile URL template).
+     */
+    struct TileUrlCache;
+    std::shared_ptr<TileUrlCache> tileUrlCache_;
 };
 
 } // namespace generator
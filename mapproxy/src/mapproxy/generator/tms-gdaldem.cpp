@@ -30,7 +30,10 @@
 
 #include "../support/tileindex.hpp"
 #include "../support/mmapped/tileindex.hpp"
+#include "../support/sharedindex.hpp"
 #include "../support/atlas.hpp"
+#include "../support/scratch.hpp"
+#include "../support/pngencode.hpp"
 
 #include "imgproc/morphology.hpp"
 #include "utility/premain.hpp"
@@ -92,6 +95,11 @@ TmsGdaldem::TmsGdaldem(const Params &params
     : detail::TmsGdaldemMFB(params)
     , TmsRasterBase(params, format ? *format : definition_.format) {
 
+    // compile options for all lods up front
+    for (vts::Lod lod(0); lod <= resource().lodRange.max; ++lod) {
+        lodProcessing_.push_back(lodProcessing(lod));
+    }
+
     const auto deliveryIndexPath(root() / "delivery.index");
 
     // compulsory check for every driver
@@ -102,7 +110,9 @@ TmsGdaldem::TmsGdaldem(const Params &params
 
     // delivery index is all we need
     if (fs::exists(deliveryIndexPath)) {
-        index_ = std::make_unique<mmapped::TileIndex>(deliveryIndexPath);
+        index_ = sharedindex::open(deliveryIndexPath
+                                   , config().denseTileIndexLods
+                                   , config().indexMapPolicy);
         makeReady();
         return;
     }
@@ -112,27 +122,31 @@ TmsGdaldem::TmsGdaldem(const Params &params
     return;
 }
 
-void TmsGdaldem::prepare_impl(Arsenal &) {
+void TmsGdaldem::prepare_impl(Arsenal &arsenal) {
 
     LOG(info2) << "Preparing <" << id() << ">.";
 
-    // probe
-    geo::GeoDataset::open(absoluteDataset(
-        datasetPath_(definition_.dataset)));
+    // probe (in a worker, see GdalWarper::probe)
+    Aborter aborter;
+    arsenal.warper.probe
+        ({ absoluteDataset(datasetPath_(definition_.dataset)) }, aborter);
 
-    // build delivery index
+    // build delivery index, shared with other layers over the same DEM
     const auto &r(resource());
-
-    vts::TileIndex index;
-    prepareTileIndex(index, (absoluteDataset(definition_.dataset)
-        + "/tiling." + r.id.referenceFrame), r, false, {});
+    const fs::path tilesPath(absoluteDataset(definition_.dataset)
+                             + "/tiling." + r.id.referenceFrame);
 
     // store and open
     const auto deliveryIndexPath(root() / "delivery.index");
-    const auto tmpPath(utility::addExtension(deliveryIndexPath, ".tmp"));
-    mmapped::TileIndex::write(tmpPath, index);
-    fs::rename(tmpPath, deliveryIndexPath);
-    index_ = std::make_unique<mmapped::TileIndex>(deliveryIndexPath);
+    sharedindex::prepare(sharedindex::directory(config().root)
+                         , sharedindex::key(r, tilesPath)
+                         , [&](vts::TileIndex &index)
+    {
+        prepareTileIndex(index, tilesPath, r, false, {});
+    }, deliveryIndexPath);
+    index_ = sharedindex::open(deliveryIndexPath
+                               , config().denseTileIndexLods
+                               , config().indexMapPolicy);
 
     // done
     return;
@@ -180,6 +194,23 @@ namespace {
 } // namespace
 
 
+TmsGdaldem::LodProcessing TmsGdaldem::lodProcessing(vts::Lod lod) const
+{
+    LodProcessing lp;
+    lp.options = applyProgressions(definition_.processingOptions
+                                   , definition_.poProgressions, lod);
+
+    try {
+        lp.native = demprocessing::parse(definition_.processing, lp.options);
+    } catch (const std::exception &e) {
+        // let GDAL report broken options
+        LOG(warn2) << "<" << id() << ">: cannot compile processing options ("
+                   << e.what() << "), using GDAL.";
+    }
+
+    return lp;
+}
+
 void TmsGdaldem::generateTileImage(const vts::TileId &tileId
     , const Sink::FileInfo &fi, RasterFormat format
     , Sink &sink, Arsenal &arsenal, const ImageFlags &imageFlags) const {
@@ -187,7 +218,8 @@ void TmsGdaldem::generateTileImage(const vts::TileId &tileId
     // serialization lambda
     const auto &serialize([&](const cv::Mat &tile) -> void {
 
-        sendImage(tile, Sink::FileInfo(fi), format, imageFlags.atlas, sink);
+        sendImage(tile, Sink::FileInfo(fi), format, imageFlags.atlas, sink
+                  , definition_.encoding);
     });
 
     // checks
@@ -216,16 +248,17 @@ void TmsGdaldem::generateTileImage(const vts::TileId &tileId
         }
 
         // return full blown black image
-        return serialize(cv::Mat_<cv::Vec3b>(vr::BoundLayer::tileHeight
-                                             , vr::BoundLayer::tileWidth
-                                             , cv::Vec3b(0, 0, 0)));
+        return serialize(blackTile());
     }
 
-    // apply option progression
-    //auto moptions(applyProgressions(definition_.processingOptions,
-    //    {{ "-z", 15, 1.1823 }}, tileId.lod));
-    auto moptions(applyProgressions(definition_.processingOptions,
-        definition_.poProgressions, tileId.lod));
+    // precomputed option progression (compute ad hoc past lod range)
+    LodProcessing adHoc;
+    const auto *lp(&adHoc);
+    if (tileId.lod < lodProcessing_.size()) {
+        lp = &lodProcessing_[tileId.lod];
+    } else {
+        adHoc = lodProcessing(tileId.lod);
+    }
 
     // obtain tile
     auto tile(arsenal.warper.warpWP(
@@ -235,8 +268,9 @@ void TmsGdaldem::generateTileImage(const vts::TileId &tileId
                 , nodeInfo.extents()
                 , math::Size2(256, 256)
                 , definition_.processing
-                , moptions
+                , lp->options
                 , definition_.resampling)
+               .setNative(lp->native)
                , sink));
     sink.checkAborted();
 
@@ -283,14 +317,15 @@ void TmsGdaldem::generateTileMask(const vts::TileId &tileId
     if (definition_.erodeMask) {
         // TODO: mask should be warped with 1px margin
         // for correct handling of edge pixels
+        // warped raster can be shared by coalesced requests, erode a copy
+        mask = std::make_shared<cv::Mat>(mask->clone());
         imgproc::erode<uchar>(*mask);
     }
 
     // serialize
     std::vector<unsigned char> buf;
     // write as png file
-    cv::imencode(".png", *mask, buf
-                 , { cv::IMWRITE_PNG_COMPRESSION, 9 });
+    encodeMask(*mask, buf);
 
     // done
     sink.content(buf, fi.sinkFileInfo());
@@ -305,6 +340,14 @@ RasterFormat TmsGdaldem::format() const {
     return transparent() ? RasterFormat::png : definition_.format;
 }
 
+Generator::Warmup TmsGdaldem::warmup_impl() const
+{
+    auto warmup(TmsRasterBase::warmup_impl());
+    warmup.datasets.push_back
+        (absoluteDataset(datasetPath_(definition_.dataset)));
+    return warmup;
+}
+
 
 boost::any TmsGdaldem::boundLayerOptions() const {
     return definition_.options;
@@ -30,6 +30,7 @@
 #include "geo/geodataset.hpp"
 
 #include "../definition/tms.hpp"
+#include "../gdalsupport/demprocessing.hpp"
 
 #include "tms-raster-base.hpp"
 
@@ -88,7 +89,23 @@ private:
     const mmapped::TileIndex *tileIndex() const override
     { return index_.get(); }
 
-    std::unique_ptr<mmapped::TileIndex> index_;
+    Warmup warmup_impl() const override;
+
+    std::shared_ptr<const mmapped::TileIndex> index_;
+
+    /** Processing options with progressions applied, compiled for native
+     *  processing when possible.
+     */
+    struct LodProcessing {
+        std::vector<std::string> options;
+        boost::optional<demprocessing::Params> native;
+    };
+
+    LodProcessing lodProcessing(vts::Lod lod) const;
+
+    /** Precomputed per-lod processing, indexed by lod.
+     */
+    std::vector<LodProcessing> lodProcessing_;
 };
 
 } // namespace generator
@@ -28,11 +28,15 @@
 
 #include "factory.hpp"
 #include "../support/atlas.hpp"
+#include "../support/normalmap.hpp"
+#include "../support/landcover.hpp"
+#include "../support/scratch.hpp"
 #include "../support/mesh.cpp"
 
 //#include "imgproc/morphology.hpp"
 #include "utility/premain.hpp"
 #include "utility/raise.hpp"
+#include "utility/format.hpp"
 
 
 namespace generator {
@@ -114,7 +118,7 @@ void TmsNormalMap::generateTileImage(const vts::TileId &tileId
                           -> void
     {
         sendImage(tile, Sink::FileInfo(fi).setMaxAge(ds.maxAge)
-                  , format, imageFlags.atlas, sink);
+                  , format, imageFlags.atlas, sink, definition().encoding);
     });
 
 
@@ -137,10 +141,7 @@ void TmsNormalMap::generateTileImage(const vts::TileId &tileId
         || (index_ && !vts::TileIndex::Flag::isReal(index_->get(tileId))))
     {
         // return full blown black image
-        return serialize(cv::Mat_<cv::Vec3b>(vr::BoundLayer::tileHeight
-                                             , vr::BoundLayer::tileWidth
-                                             , cv::Vec3b(0, 0, 0))
-                         , dataset());
+        return serialize(blackTile(), dataset());
     }
 
     // grab dataset to use
@@ -150,61 +151,67 @@ void TmsNormalMap::generateTileImage(const vts::TileId &tileId
     const auto resampling(definition_.resampling ? *definition_.resampling
                           : geo::GeoDataset::Resampling::cubic);
 
-    // warp
-    auto extents = extentsPlusPixel(nodeInfo.extents(), {256,256});
-
-    auto tile(arsenal.warper.warp
-              (GdalWarper::RasterRequest
-               (GdalWarper::RasterRequest::Operation::image
-                , absoluteDataset(ds.path)
-                , nodeInfo.srsDef()
-                , extents
-                , math::Size2(258, 258)
-                , resampling
-                , absoluteDataset(maskDataset_))
-               , sink));
-    sink.checkAborted();
-
-
-    // convert to grayscale if needed
-    if  (tile->channels() != 1) {
-
-        auto tmp = std::make_shared<cv::Mat>();
-
-        if (tile->channels() == 3) {
-            cv::cvtColor(*tile, *tmp, cv::COLOR_BGR2GRAY);
-        }
-
-        if (tile->channels() == 4) {
-            cv::cvtColor(*tile, *tmp, cv::COLOR_BGRA2GRAY);
-        }
+    // warp tile with 1px margin
+    const auto warp([&](const math::Extents2 &extents
+                        , const math::Size2 &tiles)
+    {
+        const math::Size2 size(256 * tiles.width + 2
+                               , 256 * tiles.height + 2);
+        return GdalWarper::RasterRequest
+            (GdalWarper::RasterRequest::Operation::image
+             , absoluteDataset(ds.path)
+             , nodeInfo.srsDef()
+             , extentsPlusPixel(extents, { size.width - 2, size.height - 2 })
+             , size
+             , resampling
+             , absoluteDataset(maskDataset_))
+            .setPriority(GdalWarper::Priority::mesh)
+            .setGrayscale();
+    });
 
-        tile = tmp;
+    ScratchMat blockTile;
+    GdalWarper::Raster tile;
+    if (const auto block = siblingBlock(referenceFrame(), tileId, nodeInfo)) {
+        // warp all siblings at once
+        tile = blockCache_
+            (utility::format("%s:%s", ds.path, block->parentId), block->index
+             , [&]()
+        {
+            return arsenal.warper.warpBatch
+                (warp(block->extents, math::Size2(2, 2)), math::Size2(2, 2)
+                 , 2, sink);
+        });
+    } else {
+        tile = arsenal.warper.warp
+            (warp(nodeInfo.extents(), math::Size2(1, 1)), sink);
     }
+    sink.checkAborted();
 
-    // obtain flat mask if landcover ds is provided, create empty inversion mask
-    imgproc::RasterMask flatMask(tile->cols, tile->rows,
-                            imgproc::RasterMask::EMPTY);
+    // tile is already single channel grayscale (converted by warper)
+
+    // obtain flat mask if landcover ds is provided (shared, not copied),
+    // create empty inversion mask
+    landcover::FlatMask flatMask;
     imgproc::quadtree::RasterMask inversionMask(tile->cols, tile->rows,
                             imgproc::quadtree::RasterMask::EMPTY);
 
-    if (landcover_) {
-
-        auto lc(arsenal.warper.warp(
+    if (!landcover_) {
+        flatMask = landcover::emptyFlatMask(tile->cols, tile->rows);
+    } else {
+        // landcover tile, and its flat mask, is shared with other generators
+        flatMask = landcover::flatMask(
+            arsenal.warper,
             GdalWarper::RasterRequest(
                 GdalWarper::RasterRequest::Operation::imageNoExpand,
                 landcover_->dataset,
                 nodeInfo.srsDef(),
                 nodeInfo.extents(),
                 math::Size2(256, 256),
-                geo::GeoDataset::Resampling::nearest), sink));
-
-        //cv::imwrite("lc.png", *lc);
+                geo::GeoDataset::Resampling::nearest)
+            .setPriority(GdalWarper::Priority::mesh),
+            lcClassdefKey_, *lcClassdef_, sink);
 
         sink.checkAborted();
-
-        flatMask = geo::landcover::flatMask(*lc, lcClassdef_);
-        //flatMask.invert(); // diagnostics
     }
 
     // obtain normal map
@@ -219,8 +226,18 @@ void TmsNormalMap::generateTileImage(const vts::TileId &tileId
     params.invertRelief = params_.invertRelief; // darker is higher, as the convention goes
     params.zFactor = params_.zFactor; // empirical value chosen to mimick gimp plugin
 
-    auto normalMap = geo::normalmap::demNormals<uchar>(
-        *tile, pixelSize, params, flatMask, inversionMask);
+    // native kernel works on block slice directly
+    cv::Mat normalMap;
+    if (!nativeDemNormals(*tile, normalMap, pixelSize, params, *flatMask
+                          , inversionMask))
+    {
+        // slice is a view into the block; image filters expect plain
+        // matrix, copy into scratch buffer
+        tile->copyTo(blockTile.create(tile->rows, tile->cols, tile->type()));
+
+        normalMap = geo::normalmap::demNormals<uchar>(
+            blockTile.mat(), pixelSize, params, *flatMask, inversionMask);
+    }
 
     LOG(debug) << boost::format("normal map size: %1%x%2%")
         % normalMap.rows % normalMap.cols;
@@ -249,33 +266,39 @@ void TmsNormalMap::generateTileImage(const vts::TileId &tileId
         optimize = true;
     }
 
-    // actual conversion
-    geo::normalmap::convertNormals(
-        normalMap, nodeInfo.extents(), conv.conv(), extraConv, optimize);
-
-    // convert normals to tangent space of the node
-    //geo::normalmap::convertNormals
-    //    (normalMap, trans(nodeTangentSpace(nodeInfo, boost::none)));
-
-    // octahedron encoding
-    geo::normalmap::encodeOct(normalMap);
-
-    // obtain the final image
-    cv::Mat img = geo::normalmap::exportToBGR(normalMap);
+    ScratchMat img;
+    {
+        const auto scope(sink.traceStage("normals"));
+
+        // conversion to tangent plane, octahedron encoding and
+        // quantization in one pass
+        exportNormals(normalMap
+                      , img.create(normalMap.rows, normalMap.cols, CV_8UC3)
+                      , nodeInfo.extents(), conv, extraConv
+                      , (optimize ? NormalRotation::perTile
+                         : NormalRotation::grid));
+    }
 
     // send output
-    serialize(img, ds);
+    serialize(img.mat(), ds);
 }
 
 
 RasterFormat TmsNormalMap::format() const {
-    return RasterFormat::webp;
+    return definition().format;
 }
 
 int TmsNormalMap::generatorRevision() const {
     return generatorRevision_;
 }
 
+void TmsNormalMap::memory_impl(Memory &memory) const
+{
+    TmsRaster::memory_impl(memory);
+    if (lcClassdef_) { memory.add("landcover", lcClassdef_->memory()); }
+    memory.add("rasterCache", blockCache_.memory());
+}
+
 
 void TmsNormalMap::loadLandcoverClassdef() {
 
@@ -293,7 +316,9 @@ void TmsNormalMap::loadLandcoverClassdef() {
                 landcover_->classdef, e.what());
     }
 
-    lcClassdef_ = geo::landcover::fromJson(jclasses);
+    lcClassdef_ = std::make_shared<landcover::ClassLut>
+        (geo::landcover::fromJson(jclasses));
+    lcClassdefKey_ = landcover::classdefKey(landcover_->classdef);
 }
 
 } // namespace generator
@@ -28,8 +28,9 @@
 #define mapproxy_generator_tms_normalmap_hpp_included_
 
 #include "tms-raster.hpp"
+#include "rasterblockcache.hpp"
 
-#include "geo/landcover.hpp"
+#include "../support/landcover.hpp"
 
 namespace generator {
 
@@ -58,6 +59,8 @@ private:
 
     int generatorRevision() const override;
 
+    void memory_impl(Memory &memory) const override;
+
     // load landcover class def from file
     void loadLandcoverClassdef();
 
@@ -70,8 +73,14 @@ private:
         bool invertRelief;
     } params_;
 
-    // loaded landcover class definition;
-    geo::landcover::Classes lcClassdef_;
+    // loaded landcover class definition, compiled into lookup tables
+    landcover::ClassLut::pointer lcClassdef_;
+
+    // loaded landcover class definition version, see landcover::classdefKey
+    std::string lcClassdefKey_;
+
+    // recently warped blocks of sibling tiles
+    mutable RasterBlockCache blockCache_;
 
 };
 
@@ -24,6 +24,8 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <boost/lexical_cast.hpp>
+
 #include "mapproxy/resource.hpp"
 
 #include "imgproc/png.hpp"
@@ -37,6 +39,7 @@
 #include "../support/revision.hpp"
 #include "../support/mmapped/qtree-rasterize.hpp"
 #include "../support/metatile.hpp"
+#include "../support/precompressed.hpp"
 
 
 #include "files.hpp"
@@ -184,20 +187,32 @@ Generator::Task TmsRasterBase
         sink.error(utility::makeError<NotFound>("Unrecognized filename."));
         break;
 
-    case WmtsFileInfo::Type::image:
+    case WmtsFileInfo::Type::image: {
+        ImageFlags imageFlags;
+        imageFlags.dontOptimize = true;
+        auto format(fi.format);
+        auto sfi(fi.sinkFileInfo());
+        negotiate(format, sfi, imageFlags, fi.fileInfo);
         return [=](Sink &sink, Arsenal &arsenal) {
-            ImageFlags imageFlags;
-            imageFlags.dontOptimize = true;
-            generateTileImage(fi.tileId, fi.sinkFileInfo(), fi.format
-                              , sink, arsenal, imageFlags);
+            generateTileImage(fi.tileId, sfi, format, sink, arsenal
+                              , imageFlags);
         };
+    }
 
-    case WmtsFileInfo::Type::capabilities:
-        sink.content(wmtsCapabilities(wmtsResources(fi)), fi.sinkFileInfo());
-        return {};
+    case WmtsFileInfo::Type::capabilities: {
+        // introspection variant differs in URLs
+        const auto resources(wmtsResources(fi));
+        sendDocument("WMTSCapabilities:" + resources.capabilitiesUrl
+                     , fi.fileInfo, fi.sinkFileInfo(), sink
+                     , [&](std::ostream &os)
+        {
+            os << wmtsCapabilities(resources);
+        });
+        return {}; }
 
     case WmtsFileInfo::Type::support:
-        supportFile(*fi.support, sink, fi.sinkFileInfo());
+        supportFile(*fi.support, sink, fi.sinkFileInfo()
+                    , fi.fileInfo.acceptGzip);
         break;
 
     case WmtsFileInfo::Type::listing:
@@ -217,6 +232,41 @@ Generator::Task TmsRasterBase
     return {};
 }
 
+void TmsRasterBase::negotiate(RasterFormat &format, Sink::FileInfo &sfi
+                              , ImageFlags &imageFlags, const FileInfo &fi)
+    const
+{
+    const auto negotiated(negotiateFormat_impl(format, fi));
+    if (!negotiated || (*negotiated == format)) { return; }
+
+    format = *negotiated;
+    sfi.contentType = contentType(format);
+    sfi.addHeader("Vary", "Accept");
+    // not the configured format anymore
+    imageFlags.forceFormat = true;
+}
+
+boost::optional<RasterFormat>
+TmsRasterBase::negotiateFormat_impl(RasterFormat, const FileInfo&) const
+{
+    return boost::none;
+}
+
+Generator::Warmup TmsRasterBase::warmup_impl() const
+{
+    Warmup warmup;
+    if (const auto *index = tileIndex()) {
+        warmup.prefaulted += index->prefault();
+        warmup.ext = boost::lexical_cast<std::string>(format());
+    }
+    return warmup;
+}
+
+void TmsRasterBase::memory_impl(Memory &memory) const
+{
+    if (const auto *index = tileIndex()) { memory.add("index", *index); }
+}
+
 vts::MapConfig TmsRasterBase::mapConfig_impl(ResourceRoot root)
     const
 {
@@ -273,28 +323,36 @@ Generator::Task TmsRasterBase::generateVtsFile_impl(const FileInfo &fileInfo
         break;
 
     case TmsFileInfo::Type::config: {
-        std::ostringstream os;
-        mapConfig(os, ResourceRoot::none);
-        sink.content(os.str(), fi.sinkFileInfo());
+        sendDocument("mapConfig", fi.fileInfo, fi.sinkFileInfo(), sink
+                     , [this](std::ostream &os)
+        {
+            mapConfig(os, ResourceRoot::none);
+        });
         break;
     };
 
     case TmsFileInfo::Type::definition: {
-        std::ostringstream os;
-        vr::saveBoundLayer(os, boundLayer(ResourceRoot::none));
-        sink.content(os.str(), fi.sinkFileInfo());
+        sendDocument("boundlayer", fi.fileInfo, fi.sinkFileInfo(), sink
+                     , [this](std::ostream &os)
+        {
+            vr::saveBoundLayer(os, boundLayer(ResourceRoot::none));
+        });
         break;
     }
 
     case TmsFileInfo::Type::support:
-        sink.content(fi.support->data, fi.support->size
-                      , fi.sinkFileInfo(), false);
+        precompressed::send(sink, *fi.support, fi.sinkFileInfo()
+                            , fi.fileInfo.acceptGzip);
         break;
 
     case TmsFileInfo::Type::image: {
+        ImageFlags imageFlags;
+        auto format(fi.format);
+        auto sfi(fi.sinkFileInfo());
+        negotiate(format, sfi, imageFlags, fi.fileInfo);
         return[=](Sink &sink, Arsenal &arsenal) {
-            generateTileImage(fi.tileId, fi.sinkFileInfo(), fi.format
-                              , sink, arsenal, ImageFlags());
+            generateTileImage(fi.tileId, sfi, format, sink, arsenal
+                              , imageFlags);
         };
     }
 
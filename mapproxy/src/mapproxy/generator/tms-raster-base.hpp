@@ -79,7 +79,28 @@ protected:
 
     virtual vr::BoundLayer boundLayer(ResourceRoot root) const;
 
+    /** Content negotiation of tile image format: format, file info and
+     *  flags are updated when the image is to be sent in another format than
+     *  requested.
+     */
+    void negotiate(RasterFormat &format, Sink::FileInfo &sfi
+                   , ImageFlags &imageFlags, const FileInfo &fi) const;
+
+    /** Prefaults tile index (if any); tiles in the configured format are
+     *  worth rendering.
+     */
+    Warmup warmup_impl() const override;
+
+    /** Adds tile index (if any).
+     */
+    void memory_impl(Memory &memory) const override;
+
 private:
+    /** Format to send instead of requested one to given client. Defaults to
+     *  none, i.e. no negotiation.
+     */
+    virtual boost::optional<RasterFormat>
+    negotiateFormat_impl(RasterFormat requested, const FileInfo &fi) const;
 
     virtual vts::MapConfig mapConfig_impl(ResourceRoot root) const;
 
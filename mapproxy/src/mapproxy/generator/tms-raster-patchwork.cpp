@@ -24,6 +24,8 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <array>
+
 #include <boost/filesystem.hpp>
 
 #include <opencv2/highgui/highgui.hpp>
@@ -98,6 +100,52 @@ double contrast(int i1, int i2)
     return (l1 + 0.05) / (l2 + 0.05);
 }
 
+/** Everything in the patchwork except the label is drawn from a finite set:
+ *  8x8 checkerboard of palette colour and its darker version. Label colour
+ *  (black or white, whichever contrasts more) is given by palette colour
+ *  as well.
+ */
+struct Patchwork {
+    /** Dark patches of the checkerboard.
+     */
+    cv::Mat_<std::uint8_t> dark;
+
+    std::array<cv::Vec3b, 256> colors;
+    std::array<cv::Vec3b, 256> darkColors;
+    std::array<cv::Scalar, 256> labelColors;
+
+    Patchwork()
+        : dark(vr::BoundLayer::tileHeight, vr::BoundLayer::tileWidth)
+    {
+        for (int j(0); j < dark.rows; ++j) {
+            for (int i(0); i < dark.cols; ++i) {
+                dark(j, i) = (((j >> 3) + (i >> 3)) & 1) ? 255 : 0;
+            }
+        }
+
+        for (int index(0); index < 256; ++index) {
+            const cv::Vec3b color(vts::opencv::palette256vec[index]);
+            colors[index] = color;
+            darkColors[index] = cv::Vec3b
+                (color[0] * 0.8, color[1] * 0.8, color[2] * 0.8);
+
+            cv::Vec3b inColor(color);
+            std::uint8_t gray;
+            cv::Mat_<cv::Vec3b> in(1, 1, &inColor);
+            cv::Mat_<std::uint8_t> out(1, 1, &gray);
+            cv::cvtColor(in, out, cv::COLOR_RGB2GRAY);
+            labelColors[index] = ((contrast(gray, 0) > contrast(gray, 255))
+                                  ? cv::Scalar(0, 0, 0)
+                                  : cv::Scalar(255, 255, 255));
+        }
+    }
+
+    static const Patchwork& instance() {
+        static const Patchwork patchwork;
+        return patchwork;
+    }
+};
+
 } // namespace
 
 cv::Mat TmsRasterPatchwork::generateTileImage(const vts::TileId &tileId) const
@@ -108,33 +156,14 @@ cv::Mat TmsRasterPatchwork::generateTileImage(const vts::TileId &tileId) const
     // skip black
     colorIndex = 1 + (colorIndex % 254);
 
-    cv::Mat_<cv::Vec3b> tile(vr::BoundLayer::tileHeight
-                             , vr::BoundLayer::tileWidth);
-
-    const cv::Vec3b color(vts::opencv::palette256vec[colorIndex]);
-    const cv::Vec3b darkColor(color[0] * 0.8, color[1] * 0.8, color[2] * 0.8);
-    cv::Vec3b colors[2] = { color, darkColor };
+    const auto &patchwork(Patchwork::instance());
 
-    for (int j(0); j < vr::BoundLayer::tileHeight; ++j) {
-        for (int i(0); i < vr::BoundLayer::tileWidth; ++i) {
-            tile(j, i) = colors[((j >> 3) + (i >> 3)) & 1];
-        }
-    }
+    cv::Mat_<cv::Vec3b> tile(vr::BoundLayer::tileHeight
+                             , vr::BoundLayer::tileWidth
+                             , patchwork.colors[colorIndex]);
+    tile.setTo(patchwork.darkColors[colorIndex], patchwork.dark);
 
     {
-        const auto negative([&]() -> cv::Scalar
-        {
-            cv::Vec3b inColor(color);
-            std::uint8_t gray;
-            cv::Mat_<cv::Vec3b> in(1, 1, &inColor);
-            cv::Mat_<std::uint8_t> out(1, 1, &gray);
-            cv::cvtColor(in, out, cv::COLOR_RGB2GRAY);
-            if (contrast(gray, 0) > contrast(gray, 255)) {
-                return cv::Scalar(0, 0, 0);
-            }
-            return cv::Scalar(255, 255, 255);
-        }());
-
         const auto label(boost::lexical_cast<std::string>(tileId));
         const auto face(cv::FONT_HERSHEY_COMPLEX_SMALL);
         const int thickness(1);
@@ -145,7 +174,8 @@ cv::Mat TmsRasterPatchwork::generateTileImage(const vts::TileId &tileId) const
         const cv::Point org((tile.cols - size.width) / 2
                       , (tile.rows + size.height) / 2);
 
-        cv::putText(tile, label, org, face, 1.0, negative, 1.0, thickness);
+        cv::putText(tile, label, org, face, 1.0
+                    , patchwork.labelColors[colorIndex], 1.0, thickness);
     }
 
     return tile;
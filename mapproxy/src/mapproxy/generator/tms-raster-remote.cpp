@@ -49,6 +49,8 @@
 #include "tms-raster-remote.hpp"
 #include "factory.hpp"
 #include "../support/wmts.hpp"
+#include "../support/precompressed.hpp"
+#include "../support/pngencode.hpp"
 
 #include "browser2d/index.html.hpp"
 
@@ -80,11 +82,12 @@ TmsRasterRemote::TmsRasterRemote(const Params &params)
     , definition_(resource().definition<Definition>())
     , hasMetatiles_(false)
     , maskTree_(ignoreNonexistent(absoluteDatasetRf(definition_.mask)))
+    , maskTiles_(std::make_shared<MaskTileCache>(1 << 12))
 {
     LOG(info1) << "Generator for <" << id() << "> not ready.";
 }
 
-void TmsRasterRemote::prepare_impl(Arsenal&)
+void TmsRasterRemote::prepare_impl(Arsenal &arsenal)
 {
     LOG(info2) << "Preparing <" << id() << ">.";
     if (maskTree_) {
@@ -92,7 +95,8 @@ void TmsRasterRemote::prepare_impl(Arsenal&)
         hasMetatiles_ = true;
     } else if (definition_.mask) {
         maskDataset_ = definition_.mask->string();
-        geo::GeoDataset::open(absoluteDataset(*maskDataset_));
+        Aborter aborter;
+        arsenal.warper.probe({ absoluteDataset(*maskDataset_) }, aborter);
         // we have mask dataset -> metatiles exist
         hasMetatiles_ = true;
     }
@@ -100,6 +104,12 @@ void TmsRasterRemote::prepare_impl(Arsenal&)
     makeReady();
 }
 
+void TmsRasterRemote::memory_impl(Memory &memory) const
+{
+    memory.add("maskTree", maskTree_);
+    if (maskTiles_) { memory.add("maskTiles", maskTiles_->memory()); }
+}
+
 vr::BoundLayer TmsRasterRemote::boundLayer(ResourceRoot root) const
 {
     const auto &res(resource());
@@ -200,22 +210,26 @@ Generator::Task TmsRasterRemote::generateFile_impl(const FileInfo &fileInfo
         break;
 
     case TmsFileInfo::Type::config: {
-        std::ostringstream os;
-        mapConfig(os, ResourceRoot::none);
-        sink.content(os.str(), fi.sinkFileInfo());
+        sendDocument("mapConfig", fi.fileInfo, fi.sinkFileInfo(), sink
+                     , [this](std::ostream &os)
+        {
+            mapConfig(os, ResourceRoot::none);
+        });
         break;
     }
 
     case TmsFileInfo::Type::definition: {
-        std::ostringstream os;
-        vr::saveBoundLayer(os, boundLayer(ResourceRoot::none));
-        sink.content(os.str(), fi.sinkFileInfo());
+        sendDocument("boundlayer", fi.fileInfo, fi.sinkFileInfo(), sink
+                     , [this](std::ostream &os)
+        {
+            vr::saveBoundLayer(os, boundLayer(ResourceRoot::none));
+        });
         break;
     }
 
     case TmsFileInfo::Type::support:
-        sink.content(fi.support->data, fi.support->size
-                      , fi.sinkFileInfo(), false);
+        precompressed::send(sink, *fi.support, fi.sinkFileInfo()
+                            , fi.fileInfo.acceptGzip);
         break;
 
     case TmsFileInfo::Type::image: {
@@ -284,8 +298,7 @@ void TmsRasterRemote::generateTileMask(const vts::TileId &tileId
     // serialize
     std::vector<unsigned char> buf;
     // write as png file
-    cv::imencode(".png", *mask, buf
-                 , { cv::IMWRITE_PNG_COMPRESSION, 9 });
+    encodeMask(*mask, buf);
 
     sink.content(buf, fi.sinkFileInfo());
 }
@@ -309,24 +322,28 @@ void TmsRasterRemote::generateTileMaskFromTree(const vts::TileId &tileId
         return;
     }
 
-    auto mask(boundlayerMask(tileId, maskTree_));
-
-    const auto nz(countNonZero(mask));
-    if (!nz) {
+    // most tiles are uniform: answer from the tree without rasterizing
+    const auto coverage(boundlayerMaskCoverage(tileId, maskTree_));
+    if (coverage.empty()) {
         return sink.error(utility::makeError<EmptyImage>
                           ("No pixels, optimize."));
-    } else if (nz == vr::BoundLayer::basicTileArea) {
+    } else if (coverage.covered()) {
         return sink.error(utility::makeError<FullImage>
                           ("All pixels valid, optimize."));
     }
 
-    // serialize
-    std::vector<unsigned char> buf;
-    // write as png file
-    cv::imencode(".png", mask, buf
-                 , { cv::IMWRITE_PNG_COMPRESSION, 9 });
+    auto data(maskTiles_->get(tileId));
+    if (!data) {
+        const auto mask(boundlayerMask(tileId, maskTree_));
 
-    sink.content(buf, fi.sinkFileInfo());
+        // serialize, write as png file
+        auto buf(std::make_shared<std::vector<unsigned char>>());
+        encodeMask(mask, *buf);
+        maskTiles_->put(tileId, buf);
+        data = buf;
+    }
+
+    sink.content(data->data(), data->size(), fi.sinkFileInfo(), data);
 }
 
 namespace Constants {
@@ -28,6 +28,7 @@
 #define mapproxy_generator_tms_raster_remote_hpp_included_
 
 #include "../support/coverage.hpp"
+#include "../support/masktree.hpp"
 #include "../generator.hpp"
 #include "../definition.hpp"
 
@@ -68,12 +69,18 @@ private:
 
     vr::BoundLayer boundLayer(ResourceRoot root) const;
 
+    void memory_impl(Memory &memory) const override;
+
     const Definition &definition_;
 
     bool hasMetatiles_;
 
-    // mask tree
-    MaskTree maskTree_;
+    // mask tree (shared with other resources using the same file)
+    SharedMaskTree maskTree_;
+
+    /** Rasterized partial masks from mask tree.
+     */
+    std::shared_ptr<MaskTileCache> maskTiles_;
 
     /** Mask dataset path. Only when defined and not a RF tree.
      */
@@ -104,4 +104,10 @@ cv::Mat TmsRasterSolid::generateTileImage(const vts::TileId &tileId) const
                                , burnColor_);
 }
 
+boost::optional<unsigned int>
+TmsRasterSolid::tileVariant(const vts::TileId&) const
+{
+    return 0;
+}
+
 } // namespace generator
@@ -40,6 +40,11 @@ public:
 private:
     virtual cv::Mat generateTileImage(const vts::TileId &tileId) const;
 
+    /** All tiles are the same.
+     */
+    virtual boost::optional<unsigned int>
+    tileVariant(const vts::TileId &tileId) const;
+
     const Definition &definition_;
 
     const cv::Vec3b burnColor_;
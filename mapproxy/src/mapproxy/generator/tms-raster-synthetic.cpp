@@ -35,14 +35,12 @@
 #include "geo/geodataset.hpp"
 
 #include "imgproc/rastermask/cvmat.hpp"
-#include "imgproc/png.hpp"
 
 #include "jsoncpp/json.hpp"
 #include "jsoncpp/as.hpp"
 
 #include "vts-libs/vts/io.hpp"
 #include "vts-libs/vts/nodeinfo.hpp"
-#include "vts-libs/vts/qtree-rasterize.hpp"
 #include "vts-libs/vts/opencv/colors.hpp"
 
 #include "../error.hpp"
@@ -50,6 +48,8 @@
 #include "../support/tileindex.hpp"
 #include "../support/revision.hpp"
 #include "../support/atlas.hpp"
+#include "../support/precompressed.hpp"
+#include "../support/pngencode.hpp"
 
 #include "tms-raster-synthetic.hpp"
 #include "factory.hpp"
@@ -57,7 +57,6 @@
 #include "browser2d/index.html.hpp"
 
 //namespace fs = boost::filesystem;
-namespace bgil = boost::gil;
 namespace vr = vtslibs::registry;
 
 namespace generator {
@@ -76,20 +75,68 @@ TmsRasterSynthetic::TmsRasterSynthetic(const Params &params)
     LOG(info1) << "Generator for <" << id() << "> not ready.";
 }
 
-void TmsRasterSynthetic::prepare_impl(Arsenal&)
+void TmsRasterSynthetic::prepare_impl(Arsenal &arsenal)
 {
     LOG(info2) << "Preparing <" << id() << ">.";
 
     // try to open datasets
     if (definition_.mask) {
-        geo::GeoDataset::open(absoluteDataset(*definition_.mask));
+        Aborter aborter;
+        arsenal.warper.probe({ absoluteDataset(*definition_.mask) }
+                             , aborter);
         // we have mask dataset -> metatiles exist
         hasMetatiles_ = true;
+    } else {
+        std::vector<unsigned char> buf;
+        cv::imencode(".png", cv::Mat_<std::uint8_t>
+                     (vr::BoundLayer::tileHeight, vr::BoundLayer::tileWidth
+                      , 255)
+                     , buf, { cv::IMWRITE_PNG_COMPRESSION, 9 });
+        fullMask_ = std::make_shared<const std::string>
+            (buf.begin(), buf.end());
+    }
+
+    // precompute constant tiles in the configured format
+    const vts::TileId root;
+    if (const auto variant = tileVariant(root)) {
+        encodedVariant(root, variant, definition_.format, false);
     }
 
     makeReady();
 }
 
+boost::optional<unsigned int>
+TmsRasterSynthetic::tileVariant(const vts::TileId&) const
+{
+    return boost::none;
+}
+
+EncodedImage TmsRasterSynthetic
+::encodedVariant(const vts::TileId &tileId
+                 , const boost::optional<unsigned int> &variant
+                 , RasterFormat format, bool atlas) const
+{
+    const VariantKey key(variant ? long(*variant) : -1l, format, atlas);
+
+    {
+        std::unique_lock<std::mutex> lock(variantsLock_);
+        auto fvariants(variants_.find(key));
+        if (fvariants != variants_.end()) { return fvariants->second; }
+    }
+
+    // encode outside of lock, racing threads produce the same data
+    const auto image(variant
+                     ? generateTileImage(tileId)
+                     : cv::Mat_<cv::Vec3b>(vr::BoundLayer::tileHeight
+                                           , vr::BoundLayer::tileWidth
+                                           , cv::Vec3b(0, 0, 0)));
+    const auto encoded(encodeTile(image, format, atlas
+                                  , definition_.encoding));
+
+    std::unique_lock<std::mutex> lock(variantsLock_);
+    return variants_.insert(std::make_pair(key, encoded)).first->second;
+}
+
 vr::BoundLayer TmsRasterSynthetic::boundLayer(ResourceRoot root) const
 {
     const auto &res(resource());
@@ -184,22 +231,26 @@ Generator::Task TmsRasterSynthetic
         break;
 
     case TmsFileInfo::Type::config: {
-        std::ostringstream os;
-        mapConfig(os, ResourceRoot::none);
-        sink.content(os.str(), fi.sinkFileInfo());
+        sendDocument("mapConfig", fi.fileInfo, fi.sinkFileInfo(), sink
+                     , [this](std::ostream &os)
+        {
+            mapConfig(os, ResourceRoot::none);
+        });
         break;
     };
 
     case TmsFileInfo::Type::definition: {
-        std::ostringstream os;
-        vr::saveBoundLayer(os, boundLayer(ResourceRoot::none));
-        sink.content(os.str(), fi.sinkFileInfo());
+        sendDocument("boundlayer", fi.fileInfo, fi.sinkFileInfo(), sink
+                     , [this](std::ostream &os)
+        {
+            vr::saveBoundLayer(os, boundLayer(ResourceRoot::none));
+        });
         break;
     }
 
     case TmsFileInfo::Type::support:
-        sink.content(fi.support->data, fi.support->size
-                      , fi.sinkFileInfo(), false);
+        precompressed::send(sink, *fi.support, fi.sinkFileInfo()
+                            , fi.fileInfo.acceptGzip);
         break;
 
     case TmsFileInfo::Type::image:
@@ -244,26 +295,30 @@ void TmsRasterSynthetic::generateTileImage(const vts::TileId &tileId
              ("TileId outside of valid reference frame tree."));
     }
 
-    bool valid(true);
     if (!nodeInfo.productive()) {
         if (!imageFlags.dontOptimize) {
             return sink.error
                 (utility::makeError<EmptyImage>("No valid data."));
         }
 
-        // invalid but we cannot optimize
-        valid = false;
+        // invalid but we cannot optimize: send black tile
+        return sendEncoded(encodedVariant(tileId, boost::none, format
+                                          , imageFlags.atlas)
+                           , sfi, sink);
+    }
+
+    if (const auto variant = tileVariant(tileId)) {
+        return sendEncoded(encodedVariant(tileId, variant, format
+                                          , imageFlags.atlas)
+                           , sfi, sink);
     }
 
     // generate image
-    const auto tile(valid
-                    ? generateTileImage(tileId)
-                    : cv::Mat_<cv::Vec3b>(vr::BoundLayer::tileHeight
-                                          , vr::BoundLayer::tileWidth
-                                          , cv::Vec3b(0, 0, 0)));
+    const auto tile(generateTileImage(tileId));
 
     // send image to client
-    sendImage(tile, sfi, format, imageFlags.atlas, sink);
+    sendImage(tile, sfi, format, imageFlags.atlas, sink
+              , definition_.encoding);
 }
 
 void TmsRasterSynthetic::generateTileMask(const vts::TileId &tileId
@@ -286,17 +341,8 @@ void TmsRasterSynthetic::generateTileMask(const vts::TileId &tileId
     }
 
     if (!definition_.mask) {
-        cv::Mat_<std::uint8_t> mask(vr::BoundLayer::tileHeight
-                                    , vr::BoundLayer::tileWidth, 255);
-
-        // serialize
-        std::vector<unsigned char> buf;
-        // write as png file
-        cv::imencode(".png", mask, buf
-                     , { cv::IMWRITE_PNG_COMPRESSION, 9 });
-
-        // reset max age received from dataset if mask is uded
-        sink.content(buf, fi.sinkFileInfo());
+        // precomputed at prepare time
+        sendEncoded(fullMask_, fi.sinkFileInfo(), sink);
         return;
     }
 
@@ -315,8 +361,7 @@ void TmsRasterSynthetic::generateTileMask(const vts::TileId &tileId
     // serialize
     std::vector<unsigned char> buf;
     // write as png file
-    cv::imencode(".png", *mask, buf
-                 , { cv::IMWRITE_PNG_COMPRESSION, 9 });
+    encodeMask(*mask, buf);
 
     // reset max age received from dataset if mask is uded
     sink.content(buf, fi.sinkFileInfo());
@@ -334,43 +379,6 @@ namespace MetaFlags {
     constexpr std::uint8_t unavailable(0x00);
 }
 
-namespace {
-
-[[maybe_unused]]
-void meta2d(const vts::TileIndex &tileIndex, const vts::TileId &tileId
-            , const TmsFileInfo &fi, Sink &sink)
-{
-    bgil::gray8_image_t out(Constants::RasterMetatileSize.width
-                            , Constants::RasterMetatileSize.height
-                            , bgil::gray8_pixel_t(0x00), 0);
-    auto outView(view(out));
-
-    if (const auto *tree = tileIndex.tree(tileId.lod)) {
-        const auto parentId
-            (vts::parent(tileId, Constants::RasterMetatileBinaryOrder));
-
-        rasterize(*tree, parentId.lod, parentId.x, parentId.y
-                  , outView, [&](vts::QTree::value_type flags) -> std::uint8_t
-        {
-            std::uint8_t out(0);
-
-            if (flags & vts::TileIndex::Flag::mesh) {
-                out |= MetaFlags::available;
-
-                if (flags & vts::TileIndex::Flag::watertight) {
-                    out |= MetaFlags::watertight;
-                }
-            }
-
-            return out;
-        });
-    }
-
-    sink.content(imgproc::png::serialize(out, 9), fi.sinkFileInfo());
-}
-
-} // namespace
-
 void TmsRasterSynthetic::generateMetatile(const vts::TileId &tileId
                                  , const TmsFileInfo &fi
                                  , Sink &sink
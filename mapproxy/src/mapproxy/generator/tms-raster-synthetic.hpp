@@ -27,8 +27,16 @@
 #ifndef mapproxy_generator_tms_raster_synthetic_hpp_included_
 #define mapproxy_generator_tms_raster_synthetic_hpp_included_
 
+#include <map>
+#include <mutex>
+#include <tuple>
+
+#include <boost/optional.hpp>
+
 #include "vts-libs/vts/nodeinfo.hpp"
 
+#include "../support/atlas.hpp"
+
 #include "../definition/tms.hpp"
 
 #include "tms-raster-base.hpp"
@@ -62,6 +70,14 @@ public:
 
     using TmsRasterSyntheticMFB::Definition;
 
+protected:
+    /** Returns variant of tile image if it comes from a small finite set of
+     *  images (i.e. it depends on the variant only). Images of such tiles
+     *  are encoded only once. Defaults to none (every tile is unique).
+     */
+    virtual boost::optional<unsigned int>
+    tileVariant(const vts::TileId &tileId) const;
+
 private:
     virtual void prepare_impl(Arsenal &arsenal);
     virtual vts::MapConfig mapConfig_impl(ResourceRoot root) const;
@@ -91,7 +107,25 @@ private:
 
     bool hasMask() const { return true; };
 
+    /** Returns encoded image of given variant (none = invalid tile),
+     *  encodes it on first use.
+     */
+    EncodedImage encodedVariant(const vts::TileId &tileId
+                                , const boost::optional<unsigned int> &variant
+                                , RasterFormat format, bool atlas) const;
+
     bool hasMetatiles_;
+
+    /** Fully valid mask, sent when there is no mask dataset.
+     */
+    EncodedImage fullMask_;
+
+    /** Encoded tile variants, by (variant, format, atlas); invalid tile
+     *  is stored under variant -1.
+     */
+    typedef std::tuple<long, RasterFormat, bool> VariantKey;
+    mutable std::mutex variantsLock_;
+    mutable std::map<VariantKey, EncodedImage> variants_;
 };
 
 } // namespace generator
@@ -24,9 +24,16 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
 #include <boost/filesystem.hpp>
+#include <boost/format.hpp>
 
 #include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
 
 #include "utility/premain.hpp"
 #include "utility/raise.hpp"
@@ -47,6 +54,7 @@
 #include "vts-libs/vts/tileindex.hpp"
 
 #include "../error.hpp"
+#include "../contentcache.hpp"
 #include "../support/metatile.hpp"
 #include "../support/tileindex.hpp"
 #include "../support/mmapped/qtree.hpp"
@@ -54,6 +62,11 @@
 #include "../support/revision.hpp"
 #include "../support/atlas.hpp"
 #include "../support/wmts.hpp"
+#include "../support/preparedstate.hpp"
+#include "../support/scratch.hpp"
+#include "../support/precompressed.hpp"
+#include "../support/pngencode.hpp"
+#include "../support/sharedindex.hpp"
 
 #include "tms-raster.hpp"
 #include "factory.hpp"
@@ -94,6 +107,181 @@ asPath(const boost::optional<std::string> &path)
     return fs::path(*path);
 }
 
+/** Raw tiles for pyramid building are kept in the content cache for a week;
+ *  keys contain resource revision and definition hash.
+ */
+const long PyramidMaxAge(7 * 24 * 3600);
+
+/** Sends tile, index images of paletted datasets through their palette.
+ */
+void sendTile(const cv::Mat &tile, const Palette::pointer &palette
+              , const Sink::FileInfo &sfi, RasterFormat format, bool atlas
+              , Sink &sink, const ImageEncoding &encoding)
+{
+    if (palette) {
+        return sendImage(tile, *palette, sfi, format, atlas, sink, encoding);
+    }
+    sendImage(tile, sfi, format, atlas, sink, encoding);
+}
+
+/** Tells whether resampling keeps colour table indices intact.
+ */
+bool paletteResampling(geo::GeoDataset::Resampling resampling)
+{
+    return ((resampling == geo::GeoDataset::Resampling::nearest)
+            || (resampling == geo::GeoDataset::Resampling::mode));
+}
+
+/** Raw tile record: header followed by continuous pixel data.
+ */
+struct RawTileHeader {
+    std::int32_t rows;
+    std::int32_t cols;
+    std::int32_t type;
+};
+
+std::string packTile(const cv::Mat &tile)
+{
+    const RawTileHeader header{ tile.rows, tile.cols, tile.type() };
+    const std::size_t rowSize(tile.cols * tile.elemSize());
+
+    std::string out(sizeof(header) + rowSize * tile.rows, '\0');
+    std::memcpy(&out[0], &header, sizeof(header));
+    auto *data(&out[sizeof(header)]);
+    for (int j(0); j < tile.rows; ++j, data += rowSize) {
+        std::memcpy(data, tile.ptr(j), rowSize);
+    }
+    return out;
+}
+
+/** Returns matrix pointing into data. Empty matrix if data are malformed.
+ */
+cv::Mat unpackTile(const std::string &data)
+{
+    RawTileHeader header;
+    if (data.size() < sizeof(header)) { return {}; }
+    std::memcpy(&header, data.data(), sizeof(header));
+
+    cv::Mat tile(header.rows, header.cols, header.type
+                 , const_cast<char*>(data.data() + sizeof(header)));
+    if ((tile.total() * tile.elemSize()) != (data.size() - sizeof(header))) {
+        return {};
+    }
+    return tile;
+}
+
+/** Remembers raw tile in the content cache for pyramid building.
+ */
+void storePyramidTile(ContentCache &cache, const std::string &prefix
+                      , const vts::TileId &tileId, const cv::Mat &tile)
+{
+    const auto data(packTile(tile));
+    cache.put(prefix + '|' + boost::lexical_cast<std::string>(tileId)
+              , data.data(), data.size()
+              , Sink::FileInfo("application/octet-stream", -1
+                               , PyramidMaxAge));
+}
+
+/** Tells whether child covers given quadrant (i, j) of parent in parent's
+ *  SRS, i.e. whether child's pixels are parent's pixels at double
+ *  resolution.
+ */
+bool isQuadrant(const vts::NodeInfo &parent, const vts::NodeInfo &child
+                , int i, int j)
+{
+    if (!child.valid() || (child.srs() != parent.srs())) { return false; }
+
+    const auto &pe(parent.extents());
+    const auto &ce(child.extents());
+    const auto half(math::size(pe).width / 2.0);
+    const auto halfHeight(math::size(pe).height / 2.0);
+    const double eps(1e-6 * std::max(half, halfHeight));
+
+    // row 0 is the upper one
+    const math::Extents2 quadrant
+        (pe.ll(0) + i * half, pe.ur(1) - (j + 1) * halfHeight
+         , pe.ll(0) + (i + 1) * half, pe.ur(1) - j * halfHeight);
+    return ((std::abs(ce.ll(0) - quadrant.ll(0)) <= eps)
+            && (std::abs(ce.ll(1) - quadrant.ll(1)) <= eps)
+            && (std::abs(ce.ur(0) - quadrant.ur(0)) <= eps)
+            && (std::abs(ce.ur(1) - quadrant.ur(1)) <= eps));
+}
+
+/** Halves block of children. Colour of tiles with alpha (last channel) is
+ *  resampled premultiplied so that transparent pixels do not bleed into
+ *  their neighbours; overshoot of ringing filters (LANCZOS4) is clamped.
+ */
+cv::Mat downsample(const cv::Mat &block, int interpolation)
+{
+    const cv::Size size(block.cols / 2, block.rows / 2);
+    const int channels(block.channels());
+    cv::Mat tile;
+    if ((channels != 2) && (channels != 4)) {
+        // 8-bit resize saturates the result itself
+        cv::resize(block, tile, size, 0.0, 0.0, interpolation);
+        return tile;
+    }
+
+    const int alpha(channels - 1);
+    cv::Mat premultiplied;
+    block.convertTo(premultiplied, CV_32FC(channels));
+    for (int j(0); j < premultiplied.rows; ++j) {
+        auto *px(premultiplied.ptr<float>(j));
+        for (int i(0); i < premultiplied.cols; ++i, px += channels) {
+            const float a(px[alpha] / 255.f);
+            for (int c(0); c < alpha; ++c) { px[c] *= a; }
+        }
+    }
+
+    cv::Mat resized;
+    cv::resize(premultiplied, resized, size, 0.0, 0.0, interpolation);
+
+    for (int j(0); j < resized.rows; ++j) {
+        auto *px(resized.ptr<float>(j));
+        for (int i(0); i < resized.cols; ++i, px += channels) {
+            const float a(std::min(std::max(px[alpha], 0.f), 255.f));
+            px[alpha] = a;
+            for (int c(0); c < alpha; ++c) {
+                // premultiplied colour never exceeds its alpha
+                const float v(std::min(std::max(px[c], 0.f), a));
+                px[c] = (a > 0.f) ? (v * 255.f / a) : 0.f;
+            }
+        }
+    }
+
+    resized.convertTo(tile, block.type());
+    return tile;
+}
+
+/** Key of tile in joint warps.
+ */
+std::string jointKey(const std::string &dataset, const vts::TileId &tileId)
+{
+    return dataset + '|' + boost::lexical_cast<std::string>(tileId);
+}
+
+/** Splits raster warped with mask (see RasterRequest::withMask) into
+ *  { image, mask }.
+ */
+GdalWarper::Rasters splitJoint(const cv::Mat &joint)
+{
+    const int channels(joint.channels() - 1);
+    auto image(std::make_shared<cv::Mat>
+               (joint.rows, joint.cols, CV_8UC(channels)));
+    auto mask(std::make_shared<cv::Mat>(joint.rows, joint.cols, CV_8UC1));
+
+    std::vector<int> fromTo;
+    for (int c(0); c <= channels; ++c) {
+        fromTo.push_back(c);
+        fromTo.push_back(c);
+    }
+    const std::vector<cv::Mat> src{ joint };
+    std::vector<cv::Mat> dst{ *image, *mask };
+    cv::mixChannels(src, dst, fromTo);
+
+    return { image, mask };
+}
+
 } // namespace
 
 detail::TmsRasterMFB
@@ -109,6 +297,13 @@ TmsRaster::TmsRaster(const Params &params
     , hasMetatiles_(false)
     , complexDataset_(false)
     , maskTree_(ignoreNonexistent(absoluteDatasetRf(asPath(definition_.mask))))
+    , maskTiles_(std::make_shared<MaskTileCache>(1 << 12))
+    , uniformTiles_(std::make_shared<UniformTiles>(1 << 16))
+    , jointWarps_(std::make_shared<RasterBlockCache>
+                  (std::chrono::seconds(10), 128))
+    , pyramidKey_(str(boost::format("tms-raster-pyramid:%s@%d:%d:%s")
+                      % resource().id.fullId() % resource().revision
+                      % GeneratorRevision % definitionHash(resource())))
 {
     //const auto indexPath(root() / "tileset.index");
     const auto deliveryIndexPath(root() / "delivery.index");
@@ -119,7 +314,9 @@ TmsRaster::TmsRaster(const Params &params
     }
 
     if (fs::exists(deliveryIndexPath)) {
-        index_ = boost::in_place(deliveryIndexPath);
+        index_ = sharedindex::open(deliveryIndexPath
+                                   , config().denseTileIndexLods
+                                   , config().indexMapPolicy);
     }
 
     if (index_) {
@@ -137,6 +334,8 @@ TmsRaster::TmsRaster(const Params &params
         }
 
         if (success && ! doNotMakeReady) { makeReady(); return; }*/
+        openOutcomes();
+        openReprojected();
         if (!doNotMakeReady) { makeReady(); return; }
     };
 
@@ -156,10 +355,63 @@ TmsRaster::DatasetDesc TmsRaster::dataset_impl() const
     return { definition_.dataset };
 }
 
-void TmsRaster::prepare_impl(Arsenal&)
+bool TmsRaster::cacheable_impl() const
+{
+    return !dataset().dynamic;
+}
+
+Generator::Warmup TmsRaster::warmup_impl() const
+{
+    auto warmup(TmsRasterBase::warmup_impl());
+    warmup.datasets.push_back(absoluteDataset(dataset().path));
+    if (maskDataset_) {
+        warmup.datasets.push_back(absoluteDataset(*maskDataset_));
+    }
+    warmup.prefaulted += maskTree_.prefault();
+    return warmup;
+}
+
+void TmsRaster::memory_impl(Memory &memory) const
+{
+    TmsRasterBase::memory_impl(memory);
+    memory.add("maskTree", maskTree_);
+    if (maskTiles_) { memory.add("maskTiles", maskTiles_->memory()); }
+    memory.add("jointWarps", jointWarps_->memory());
+}
+
+void TmsRaster::prepare_impl(Arsenal &arsenal)
 {
     LOG(info2) << "Preparing <" << id() << ">.";
 
+    // builds delivery index (shared with other resources built from the
+    // same tiling and mask) and opens it
+    const auto prepareIndex([&](const boost::optional<fs::path> &tilesPath)
+    {
+        const auto &r(resource());
+        const auto deliveryIndexPath(root() / "delivery.index");
+        const auto maskPath
+            (maskTree_ ? ignoreNonexistent
+             (absoluteDatasetRf(asPath(definition_.mask))) : boost::none);
+
+        sharedindex::prepare(sharedindex::directory(config().root)
+                             , sharedindex::key(r, tilesPath, false, maskPath)
+                             , [&](vts::TileIndex &index)
+        {
+            if (tilesPath) {
+                prepareTileIndex(index, *tilesPath, r, false, maskTree_);
+            } else {
+                prepareTileIndex(index, r, false, maskTree_);
+            }
+
+            // save vts::TileIndex anyway
+            index.save(root() / "tileset.index");
+        }, deliveryIndexPath);
+
+        index_ = sharedindex::open(deliveryIndexPath
+                                   , config().denseTileIndexLods
+                                   , config().indexMapPolicy);
+    });
+
 
     if (fs::exists(absoluteDataset(definition_.dataset + "/ophoto"))) {
         // complex dataset directory
@@ -167,62 +419,82 @@ void TmsRaster::prepare_impl(Arsenal&)
         hasMetatiles_ = true;
         complexDataset_ = true;
 
-        // try to open
-        geo::GeoDataset::open
-            (absoluteDataset(definition_.dataset + "/ophoto"));
-
-        const auto &r(resource());
-
-        vts::TileIndex index;
-        prepareTileIndex(index
-                         , (absoluteDataset(definition_.dataset)
-                            + "/tiling." + r.id.referenceFrame)
-                         , r, false, maskTree_);
+        // try to open (in a worker, see GdalWarper::probe)
+        Aborter aborter;
+        arsenal.warper.probe
+            ({ absoluteDataset(definition_.dataset + "/ophoto") }, aborter);
 
-        // save vts::TileIndex anyway
-        index.save(root() / "tileset.index");
-
-        // store and open
-        const auto deliveryIndexPath(root() / "delivery.index");
-        const auto tmpPath(utility::addExtension(deliveryIndexPath, ".tmp"));
-        mmapped::TileIndex::write(tmpPath, index);
-        fs::rename(tmpPath, deliveryIndexPath);
-        index_ = boost::in_place(deliveryIndexPath);
+        prepareIndex(fs::path(absoluteDataset(definition_.dataset)
+                              + "/tiling." + resource().id.referenceFrame));
 
         // done
+        openOutcomes();
+        openReprojected();
         return;
     }
 
-    // try to open datasets
-    auto ds(geo::GeoDataset::open(absoluteDataset(dataset().path)));
+    // try to open datasets (in a worker, see GdalWarper::probe)
+    std::vector<std::string> datasets{ absoluteDataset(dataset().path) };
+    if (!maskTree_ && definition_.mask) {
+        datasets.push_back(absoluteDataset(*definition_.mask));
+    }
+
+    Aborter aborter;
+    const auto probes(arsenal.warper.probe(datasets, aborter));
+
+    palette_.reset();
+    if (definition_.palette) {
+        palette_ = readPalette(absoluteDataset(dataset().path));
+        if (!palette_) {
+            LOG(warn2) << "Dataset of <" << id() << "> has no usable colour "
+                "table; its palette is expanded.";
+        } else if (definition_.resampling
+                   && !paletteResampling(*definition_.resampling))
+        {
+            LOG(warn2) << "Resampling <" << *definition_.resampling
+                       << "> of <" << id() << "> ignored for paletted "
+                       << "dataset, using nearest.";
+        }
+    }
     if (maskTree_) {
         // we have mask tree -> metatiles exist
         hasMetatiles_ = true;
 
         // build tileindex
-        vts::TileIndex index;
-        prepareTileIndex(index, resource(), false, maskTree_);
-
-        // save vts::TileIndex anyway
-        index.save(root() / "tileset.index");
-
-        // store and open
-        const auto deliveryIndexPath(root() / "delivery.index");
-        mmapped::TileIndex::write(deliveryIndexPath, index);
-        index_ = boost::in_place(deliveryIndexPath);
+        prepareIndex(boost::none);
     } else if (definition_.mask) {
         maskDataset_ = definition_.mask;
-        geo::GeoDataset::open(absoluteDataset(*maskDataset_));
         // we have mask dataset -> metatiles exist
         hasMetatiles_ = true;
     } else {
         // no external mask available -> metatiles exist only when dataset has
         // some invalid pixels
-        hasMetatiles_ = !ds.allValid();
+        hasMetatiles_ = !probes.front().allValid;
     }
 
     // extra prep in subclass
     extraPrep();
+
+    openOutcomes();
+    openReprojected();
+}
+
+void TmsRaster::openOutcomes()
+{
+    outcomes_ = std::make_shared<TileOutcomes>
+        (root() / "tile.outcomes"
+         , str(boost::format("%s@%d:%d:%s")
+               % resource().id.fullId() % resource().revision
+               % GeneratorRevision % definitionHash(resource())));
+}
+
+void TmsRaster::openReprojected()
+{
+    reprojected_ = {};
+    if (!definition_.reprojectedMaxLod || dataset().dynamic) { return; }
+    reprojected_ = ReprojectedPyramids
+        (absoluteDataset(dataset().path), referenceFrame()
+         , *definition_.reprojectedMaxLod);
 }
 
 RasterFormat TmsRaster::format() const
@@ -239,6 +511,19 @@ int TmsRaster::generatorRevision() const {
     return GeneratorRevision;
 }
 
+boost::optional<RasterFormat>
+TmsRaster::negotiateFormat_impl(RasterFormat requested, const FileInfo &fi)
+    const
+{
+    // indexed output of paletted datasets is not negotiable
+    if ((requested != format()) || palette_) { return boost::none; }
+
+    for (const auto candidate : definition_.negotiate) {
+        if (fi.accepts(candidate)) { return candidate; }
+    }
+    return boost::none;
+}
+
 bool TmsRaster::transparent_impl() const
 {
     return definition_.transparent;
@@ -347,22 +632,26 @@ Generator::Task TmsRaster::generateVtsFile_impl(const FileInfo &fileInfo
         break;
 
     case TmsFileInfo::Type::config: {
-        std::ostringstream os;
-        mapConfig(os, ResourceRoot::none);
-        sink.content(os.str(), fi.sinkFileInfo());
+        sendDocument("mapConfig", fi.fileInfo, fi.sinkFileInfo(), sink
+                     , [this](std::ostream &os)
+        {
+            mapConfig(os, ResourceRoot::none);
+        });
         break;
     };
 
     case TmsFileInfo::Type::definition: {
-        std::ostringstream os;
-        vr::saveBoundLayer(os, boundLayer(ResourceRoot::none));
-        sink.content(os.str(), fi.sinkFileInfo());
+        sendDocument("boundlayer", fi.fileInfo, fi.sinkFileInfo(), sink
+                     , [this](std::ostream &os)
+        {
+            vr::saveBoundLayer(os, boundLayer(ResourceRoot::none));
+        });
         break;
     }
 
     case TmsFileInfo::Type::support:
-        sink.content(fi.support->data, fi.support->size
-                      , fi.sinkFileInfo(), false);
+        precompressed::send(sink, *fi.support, fi.sinkFileInfo()
+                            , fi.fileInfo.acceptGzip);
         break;
 
     case TmsFileInfo::Type::image: {
@@ -403,8 +692,8 @@ void TmsRaster::generateTileImage(const vts::TileId &tileId
     const auto &serialize([&](const cv::Mat &tile, const DatasetDesc &ds)
                           -> void
     {
-        sendImage(tile, Sink::FileInfo(fi).setMaxAge(ds.maxAge)
-                  , format, imageFlags.atlas, sink);
+        sendTile(tile, palette_, Sink::FileInfo(fi).setMaxAge(ds.maxAge)
+                 , format, imageFlags.atlas, sink, definition_.encoding);
     });
 
     if (!imageFlags.checkFormat(format, this->format())) {
@@ -430,10 +719,7 @@ void TmsRaster::generateTileImage(const vts::TileId &tileId
         }
 
         // return full blown black image
-        return serialize(cv::Mat_<cv::Vec3b>(vr::BoundLayer::tileHeight
-                                             , vr::BoundLayer::tileWidth
-                                             , cv::Vec3b(0, 0, 0))
-                         , dataset());
+        return serialize(blackTile(), dataset());
     }
 
     // grab dataset to use
@@ -451,23 +737,192 @@ void TmsRaster::generateTileImage(const vts::TileId &tileId
          ? GdalWarper::RasterRequest::Operation::imageNoOpt
          : GdalWarper::RasterRequest::Operation::image);
 
-    // choose resampling (configured or default)
-    const auto resampling(definition_.resampling ? *definition_.resampling
-                          : geo::GeoDataset::Resampling::cubic);
-
-    auto tile(arsenal.warper.warp
-              (GdalWarper::RasterRequest
-               (operation
-                , absoluteDataset(ds.path)
-                , nodeInfo.srsDef()
-                , nodeInfo.extents()
-                , math::Size2(256, 256)
-                , resampling
-                , absoluteDataset(maskDataset_))
-               , sink));
-    sink.checkAborted();
+    // tiles warped to nothing before are not warped again
+    const auto outcomes
+        ((operation == GdalWarper::RasterRequest::Operation::image)
+         ? outcomes_ : TileOutcomes::pointer());
+    if (outcomes && outcomes->has(tileId, TileOutcomes::emptyImage)) {
+        return sink.error(utility::makeError<EmptyImage>("No valid data."));
+    }
+
+    const auto palette(palette_);
+
+    // warp asynchronously, do not block core thread while GDAL is working;
+    // serialization continues in the core processing pool
+    const auto sfi(Sink::FileInfo(fi).setMaxAge(ds.maxAge));
+    const bool atlas(imageFlags.atlas);
+    const auto encoding(definition_.encoding);
+
+    // solid tiles seen before need no warping; dynamic datasets can change
+    // any time
+    const auto uniformTiles(ds.dynamic ? std::shared_ptr<UniformTiles>()
+                            : uniformTiles_);
+    if (uniformTiles) {
+        if (const auto uniform = uniformTiles->get(tileId)) {
+            return sendTile(uniform->image(), palette, sfi, format, atlas
+                            , sink, encoding);
+        }
+    }
 
-    serialize(*tile, ds);
+    // pyramid from children; needs stable (non-dynamic) dataset and cannot
+    // downsample colour table indices
+    const bool pyramid(definition_.pyramid && !ds.dynamic && !palette
+                       && arsenal.contentCache);
+    const auto pyramidKey(pyramidKey_);
+    if (pyramid) {
+        const auto tile(pyramidTile(nodeInfo, arsenal));
+        if (!tile.empty()) {
+            storePyramidTile(*arsenal.contentCache, pyramidKey_, tileId, tile);
+            return sendImage(tile, sfi, format, atlas, sink, encoding);
+        }
+    }
+
+    const auto deliver([=](const cv::Mat &tile, Sink &sink
+                           , Arsenal &arsenal)
+    {
+        if (uniformTiles && isUniform(tile)) {
+            uniformTiles->put(tileId, UniformImage(tile));
+        } else if (pyramid && arsenal.contentCache) {
+            storePyramidTile(*arsenal.contentCache, pyramidKey, tileId
+                             , tile);
+        }
+        sendTile(tile, palette, sfi, format, atlas, sink, encoding);
+    });
+
+    // image of this tile warped along with its mask very recently
+    const auto jointWarps(jointMask() ? jointWarps_
+                          : std::shared_ptr<RasterBlockCache>());
+    const auto tileKey(jointKey(ds.path, tileId));
+    if (jointWarps) {
+        const auto tile(jointWarps->find(tileKey, 0));
+        const auto mask(jointWarps->find(tileKey, 1));
+        if (tile && mask) {
+            // joint warp is not optimized, check for emptiness here
+            if ((operation == GdalWarper::RasterRequest::Operation::image)
+                && !cv::countNonZero(*mask))
+            {
+                return sink.error
+                    (utility::makeError<EmptyImage>("No valid data."));
+            }
+            return deliver(*tile, sink, arsenal);
+        }
+    }
+
+    arsenal.warper.warp
+        (imageRequest(ds, nodeInfo, operation)
+         .setWithMask(bool(jointWarps))
+         , sink
+         , [=, &arsenal](const GdalWarper::Raster &tile
+                         , const std::exception_ptr &error)
+    {
+        arsenal.post([=](Sink &sink, Arsenal &arsenal)
+        {
+            if (error) {
+                if (outcomes) {
+                    try {
+                        std::rethrow_exception(error);
+                    } catch (const EmptyImage&) {
+                        outcomes->put(tileId, TileOutcomes::emptyImage);
+                        throw;
+                    }
+                }
+                std::rethrow_exception(error);
+            }
+            sink.checkAborted();
+
+            if (!jointWarps) { return deliver(*tile, sink, arsenal); }
+
+            // keep mask for the mask request
+            const auto joint(splitJoint(*tile));
+            jointWarps->put(tileKey, joint);
+            deliver(*joint.front(), sink, arsenal);
+        }, sink);
+    });
+}
+
+GdalWarper::RasterRequest
+TmsRaster::imageRequest(const DatasetDesc &ds, const vts::NodeInfo &nodeInfo
+                        , GdalWarper::RasterRequest::Operation operation)
+    const
+{
+    // choose resampling (configured or default); colour table indices
+    // cannot be interpolated, only nearest or mode is allowed for them
+    auto resampling(definition_.resampling ? *definition_.resampling
+                    : geo::GeoDataset::Resampling::cubic);
+    if (palette_ && !paletteResampling(resampling)) {
+        resampling = geo::GeoDataset::Resampling::nearest;
+    }
+
+    // low lods come from the pyramid in node's SRS, if any
+    return GdalWarper::RasterRequest
+        (operation
+         , reprojected_.dataset(nodeInfo, absoluteDataset(ds.path))
+         , nodeInfo.srsDef()
+         , nodeInfo.extents()
+         , math::Size2(256, 256)
+         , resampling
+         , absoluteDataset(maskDataset_))
+        .setOverviewRatio(definition_.overviewRatio)
+        .setKeepPalette(bool(palette_));
+}
+
+cv::Mat TmsRaster::pyramidTile(const vts::NodeInfo &nodeInfo
+                               , Arsenal &arsenal) const
+{
+    // no children in this resource
+    const auto &tileId(nodeInfo.nodeId());
+    if (tileId.lod >= resource().lodRange.max) { return {}; }
+
+    cv::Mat block;
+    for (int j(0); j < 2; ++j) {
+        for (int i(0); i < 2; ++i) {
+            const vts::TileId child(tileId.lod + 1, 2 * tileId.x + i
+                                    , 2 * tileId.y + j);
+
+            // child in another subtree (different SRS or extents) is not
+            // this tile's quadrant, warp instead
+            if (!isQuadrant(nodeInfo, vts::NodeInfo(referenceFrame(), child)
+                            , i, j))
+            {
+                return {};
+            }
+
+            // uniform tiles are not stored in the content cache at all
+            cv::Mat tile;
+            ResponseCache::Response::pointer cached;
+            if (const auto uniform = uniformTiles_->get(child)) {
+                tile = uniform->image();
+            } else if ((cached = arsenal.contentCache->get
+                        (pyramidKey_ + '|' + boost::lexical_cast
+                         <std::string>(child))))
+            {
+                tile = unpackTile(cached->body());
+            }
+
+            if (tile.empty()) { return {}; }
+
+            if (block.empty()) {
+                block.create(2 * tile.rows, 2 * tile.cols, tile.type());
+            } else if ((tile.type() != block.type())
+                       || ((2 * tile.rows) != block.rows)
+                       || ((2 * tile.cols) != block.cols))
+            {
+                // incompatible children (e.g. format change), warp instead
+                return {};
+            }
+
+            tile.copyTo(block(cv::Rect(i * tile.cols, j * tile.rows
+                                       , tile.cols, tile.rows)));
+        }
+    }
+
+    const auto tile(downsample
+                    (block, ((*definition_.pyramid
+                              == resource::TmsRaster::PyramidFilter::lanczos)
+                             ? cv::INTER_LANCZOS4 : cv::INTER_AREA)));
+
+    LOG(info1) << "Tile " << tileId << " built from its children.";
+    return tile;
 }
 
 void TmsRaster::generateTileMask(const vts::TileId &tileId
@@ -507,15 +962,61 @@ void TmsRaster::generateTileMask_impl(const vts::TileId &tileId
     // get dataset
     auto ds(dataset());
 
-    auto mask(arsenal.warper.warp
-              (GdalWarper::RasterRequest
-               (GdalWarper::RasterRequest::Operation::mask
-                , absoluteDataset(ds.path, maskDataset_)
-                , nodeInfo.srsDef()
-                , nodeInfo.extents()
-                , math::Size2(256, 256)
-                , geo::GeoDataset::Resampling::cubic)
-               , sink));
+    // masks warped to nothing or to all valid before are not warped again
+    const auto outcomes(ds.dynamic ? TileOutcomes::pointer() : outcomes_);
+    if (outcomes) {
+        if (outcomes->has(tileId, TileOutcomes::emptyMask)) {
+            sink.error(utility::makeError<EmptyImage>("No valid data."));
+            return;
+        }
+        if (outcomes->has(tileId, TileOutcomes::fullMask)) {
+            sink.error(utility::makeError<FullImage>("All data valid."));
+            return;
+        }
+    }
+
+    GdalWarper::Raster mask;
+    try {
+        if (jointMask()) {
+            // mask of recent image warp or of image warped now; image is
+            // kept for the image request
+            const auto key(jointKey(ds.path, tileId));
+            mask = (*jointWarps_)(key, 1, [&]()
+            {
+                return splitJoint
+                    (*arsenal.warper.warp
+                     (imageRequest
+                      (ds, nodeInfo
+                       , GdalWarper::RasterRequest::Operation::imageNoOpt)
+                      .setWithMask()
+                      , sink));
+            });
+
+            // the same optimization as mask operation does
+            const auto valid(cv::countNonZero(*mask));
+            if (!valid) {
+                throw EmptyImage("No valid data.");
+            } else if (std::size_t(valid) == mask->total()) {
+                throw FullImage("All data valid.");
+            }
+        } else {
+            mask = arsenal.warper.warp
+                (GdalWarper::RasterRequest
+                 (GdalWarper::RasterRequest::Operation::mask
+                  , absoluteDataset(ds.path, maskDataset_)
+                  , nodeInfo.srsDef()
+                  , nodeInfo.extents()
+                  , math::Size2(256, 256)
+                  , geo::GeoDataset::Resampling::cubic)
+                 , sink);
+        }
+    } catch (const EmptyImage&) {
+        if (outcomes) { outcomes->put(tileId, TileOutcomes::emptyMask); }
+        throw;
+    } catch (const FullImage&) {
+        if (outcomes) { outcomes->put(tileId, TileOutcomes::fullMask); }
+        throw;
+    }
 
     sink.checkAborted();
 
@@ -523,14 +1024,15 @@ void TmsRaster::generateTileMask_impl(const vts::TileId &tileId
     if (definition_.erodeMask) {
         // TODO: mask should be warped with 1px margin
         // for correct handling of edge pixels
+        // warped raster can be shared by coalesced requests, erode a copy
+        mask = std::make_shared<cv::Mat>(mask->clone());
         imgproc::erode<uchar>(*mask);
     }
 
     // serialize
     std::vector<unsigned char> buf;
     // write as png file
-    cv::imencode(".png", *mask, buf
-                 , { cv::IMWRITE_PNG_COMPRESSION, 9 });
+    encodeMask(*mask, buf);
 
     // reset max age received from dataset if mask is used
     if (maskDataset_) { ds.maxAge = boost::none; }
@@ -558,24 +1060,28 @@ void TmsRaster::generateTileMaskFromTree_impl(const vts::TileId &tileId
         return;
     }
 
-    auto mask(boundlayerMask(tileId, maskTree_));
-
-    const auto nz(countNonZero(mask));
-    if (!nz) {
-        sink.error(utility::makeError<EmptyImage>
-                   ("No pixels, optimize."));
-    } else if (nz == vr::BoundLayer::basicTileArea) {
-        sink.error(utility::makeError<FullImage>
-                   ("All pixels valid, optimize."));
+    // most tiles are uniform: answer from the tree without rasterizing
+    const auto coverage(boundlayerMaskCoverage(tileId, maskTree_));
+    if (coverage.empty()) {
+        return sink.error(utility::makeError<EmptyImage>
+                          ("No pixels, optimize."));
+    } else if (coverage.covered()) {
+        return sink.error(utility::makeError<FullImage>
+                          ("All pixels valid, optimize."));
     }
 
-    // serialize
-    std::vector<unsigned char> buf;
-    // write as png file
-    cv::imencode(".png", mask, buf
-                 , { cv::IMWRITE_PNG_COMPRESSION, 9 });
+    auto data(maskTiles_->get(tileId));
+    if (!data) {
+        const auto mask(boundlayerMask(tileId, maskTree_));
+
+        // serialize, write as png file
+        auto buf(std::make_shared<std::vector<unsigned char>>());
+        encodeMask(mask, *buf);
+        maskTiles_->put(tileId, buf);
+        data = buf;
+    }
 
-    sink.content(buf, fi.sinkFileInfo());
+    sink.content(data->data(), data->size(), fi.sinkFileInfo(), data);
 }
 
 namespace Constants {
@@ -30,11 +30,17 @@
 #include "geo/geodataset.hpp"
 
 #include "../support/coverage.hpp"
+#include "../support/masktree.hpp"
 #include "../support/mmapped/tileindex.hpp"
+#include "../support/uniform.hpp"
+#include "../support/tileoutcomes.hpp"
+#include "../support/palette.hpp"
+#include "../support/reprojected.hpp"
 
 #include "../definition/tms.hpp"
 
 #include "tms-raster-base.hpp"
+#include "rasterblockcache.hpp"
 
 namespace generator {
 
@@ -96,7 +102,7 @@ protected:
 
     DatasetDesc dataset() const;
 
-    boost::optional<mmapped::TileIndex> index_;
+    std::shared_ptr<const mmapped::TileIndex> index_;
 
     bool transparent() const override;
 
@@ -110,12 +116,31 @@ protected:
      */
     boost::optional<std::string> maskDataset_;
 
+    Task generateVtsFile_impl(const FileInfo &fileInfo
+                              , Sink &sink) const override;
+
+    /** Adds mask tree and its rasterized tiles.
+     */
+    void memory_impl(Memory &memory) const override;
+
 private:
     void prepare_impl(Arsenal &arsenal) override;
     vts::MapConfig mapConfig_impl(ResourceRoot root) const override;
 
-    Task generateVtsFile_impl(const FileInfo &fileInfo
-                                      , Sink &sink) const override;
+    /** Dynamic datasets are not cacheable.
+     */
+    bool cacheable_impl() const override;
+
+    /** Adds dataset (and mask dataset) and mask tree.
+     */
+    Warmup warmup_impl() const override;
+
+    /** First format from definition's negotiate list accepted by the
+     *  client; only for tiles requested in the configured format.
+     */
+    boost::optional<RasterFormat>
+    negotiateFormat_impl(RasterFormat requested, const FileInfo &fi)
+        const override;
 
     void generateTileImage(const vts::TileId &tileId
                                    , const Sink::FileInfo &fi
@@ -133,16 +158,42 @@ private:
                           , const TmsFileInfo &fi
                           , Sink &sink, Arsenal &arsenal) const override;
 
+    /** Builds tile by downsampling its four children found in the content
+     *  cache (or among uniform tiles). Returns empty matrix when any child
+     *  is missing or is not the tile's quadrant in the same SRS.
+     */
+    cv::Mat pyramidTile(const vts::NodeInfo &nodeInfo, Arsenal &arsenal)
+        const;
+
     void generateTileMask_impl(const vts::TileId &tileId
                           , const TmsFileInfo &fi
                           , Sink &sink, Arsenal &arsenal) const;
 
+    /** Image warp request of given tile.
+     */
+    GdalWarper::RasterRequest
+    imageRequest(const DatasetDesc &ds, const vts::NodeInfo &nodeInfo
+                 , GdalWarper::RasterRequest::Operation operation) const;
+
+    /** Image and mask of a tile come from single warp (see jointWarps_).
+     *  Only without separate mask dataset: image mask is the mask then.
+     */
+    bool jointMask() const { return !maskDataset_; }
+
     void generateTileMaskFromTree_impl(const vts::TileId &tileId
                                   , const TmsFileInfo &fi
                                   , Sink &sink
                                   , Arsenal&) const;
     bool hasMask() const override;
 
+    /** Opens log of learned tile outcomes in resource's store directory.
+     */
+    void openOutcomes();
+
+    /** Finds reprojected pyramids of the dataset, if configured.
+     */
+    void openReprojected();
+
     virtual bool hasMetatiles() const override { return hasMetatiles_; }
 
     void update(vr::BoundLayer &bl) const;
@@ -170,8 +221,38 @@ private:
 
     bool complexDataset_;
 
-    // mask tree
-    MaskTree maskTree_;
+    // mask tree (shared with other resources using the same file)
+    SharedMaskTree maskTree_;
+
+    /** Rasterized partial masks from mask tree.
+     */
+    std::shared_ptr<MaskTileCache> maskTiles_;
+
+    /** Tiles found to be uniform; shared with in-flight warps.
+     */
+    std::shared_ptr<UniformTiles> uniformTiles_;
+
+    /** Recently warped tiles as { image, mask }, for the other of image and
+     *  mask requests arriving shortly; shared with in-flight warps.
+     */
+    std::shared_ptr<RasterBlockCache> jointWarps_;
+
+    /** Content cache key prefix of raw tiles used for pyramid building.
+     */
+    std::string pyramidKey_;
+
+    /** Tiles found empty (or with full mask) by the warper; persisted,
+     *  bound to resource revision and definition.
+     */
+    TileOutcomes::pointer outcomes_;
+
+    /** Colour table of paletted dataset (only when configured to keep it).
+     */
+    Palette::pointer palette_;
+
+    /** Dataset pre-reprojected into SRSes of the reference frame.
+     */
+    ReprojectedPyramids reprojected_;
 };
 
 // inlines
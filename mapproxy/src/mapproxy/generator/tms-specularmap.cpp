@@ -28,6 +28,8 @@
 
 #include "factory.hpp"
 #include "../support/atlas.hpp"
+#include "../support/landcover.hpp"
+#include "../support/scratch.hpp"
 
 #include "imgproc/morphology.hpp"
 #include "utility/premain.hpp"
@@ -105,7 +107,7 @@ void TmsSpecularMap::generateTileImage(const vts::TileId &tileId
                           -> void
     {
         sendImage(tile, Sink::FileInfo(fi).setMaxAge(ds.maxAge)
-                  , format, imageFlags.atlas, sink);
+                  , format, imageFlags.atlas, sink, definition().encoding);
     });
 
 
@@ -128,10 +130,7 @@ void TmsSpecularMap::generateTileImage(const vts::TileId &tileId
         || (index_ && !vts::TileIndex::Flag::isReal(index_->get(tileId))))
     {
         // return full blown black image
-        return serialize(cv::Mat_<cv::Vec3b>(vr::BoundLayer::tileHeight
-                                             , vr::BoundLayer::tileWidth
-                                             , cv::Vec3b(0, 0, 0))
-                         , dataset());
+        return serialize(blackTile(), dataset());
     }
 
     // grab dataset to use
@@ -143,9 +142,9 @@ void TmsSpecularMap::generateTileImage(const vts::TileId &tileId
     const auto resampling(definition_.resampling ? *definition_.resampling
                           : geo::GeoDataset::Resampling::cubic);
 
-    // warp
-    auto tile(arsenal.warper.warp
-              (GdalWarper::RasterRequest
+    // warp; landcover tile is shared with other generators
+    auto tile(landcover::tile
+              (arsenal.warper, GdalWarper::RasterRequest
                (GdalWarper::RasterRequest::Operation::imageNoExpand
                 , absoluteDataset(ds.path)
                 , nodeInfo.srsDef()
@@ -153,12 +152,14 @@ void TmsSpecularMap::generateTileImage(const vts::TileId &tileId
                 , math::Size2(256, 256)
                 , resampling
                 , absoluteDataset(maskDataset_))
+               .setPriority(GdalWarper::Priority::mesh)
+               // landcover classes live in the first band
+               .setBands({ 1 })
                , sink));
     sink.checkAborted();
 
     // obtain specular map
-    auto img = geo::landcover::specularMap(*tile, lcClassdef_,
-                                           params_.shininessBits);
+    auto img = lcClassdef_->specularMap(*tile, params_.shininessBits);
 
     // send output
     serialize(img, ds);
@@ -169,6 +170,12 @@ int TmsSpecularMap::generatorRevision() const {
     return generatorRevision_;
 }
 
+void TmsSpecularMap::memory_impl(Memory &memory) const
+{
+    TmsRaster::memory_impl(memory);
+    if (lcClassdef_) { memory.add("landcover", lcClassdef_->memory()); }
+}
+
 void TmsSpecularMap::loadLandcoverClassdef() {
 
     Json::Value jclasses;
@@ -185,7 +192,8 @@ void TmsSpecularMap::loadLandcoverClassdef() {
                 params_.classdef, e.what());
     }
 
-    lcClassdef_ = geo::landcover::fromJson(jclasses);
+    lcClassdef_ = std::make_shared<landcover::ClassLut>
+        (geo::landcover::fromJson(jclasses));
 }
 
 } // namespace generator
@@ -30,7 +30,7 @@
 
 #include "tms-raster.hpp"
 
-#include "geo/landcover.hpp"
+#include "../support/landcover.hpp"
 
 namespace generator {
 
@@ -56,6 +56,8 @@ private:
 
     int generatorRevision() const override;
 
+    void memory_impl(Memory &memory) const override;
+
     // load landcover class def from file
     void loadLandcoverClassdef();
 
@@ -65,8 +67,8 @@ private:
         uchar shininessBits;
     } params_;
 
-    // loaded landcover class definition;
-    geo::landcover::Classes lcClassdef_;
+    // loaded landcover class definition, compiled into lookup tables
+    landcover::ClassLut::pointer lcClassdef_;
 };
 
 } // namespace generator
@@ -0,0 +1,214 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cmath>
+#include <algorithm>
+
+#include "tms-terrainrgb.hpp"
+
+#include "factory.hpp"
+#include "demregistry.hpp"
+#include "../error.hpp"
+#include "../support/atlas.hpp"
+#include "../support/scratch.hpp"
+#include "../support/srs.hpp"
+
+#include "utility/premain.hpp"
+#include "utility/raise.hpp"
+
+
+namespace generator {
+
+namespace {
+
+// upgrade whenever functionality is altered to warrant invalidation
+// of all cached generator output in production environment
+int generatorRevision_(1);
+
+// register generator via pre-main static initialization
+
+struct Factory : Generator::Factory {
+    virtual Generator::pointer create(const Generator::Params &params)
+    {
+        return std::make_shared<TmsTerrainRgb>(params);
+    }
+
+private:
+    static utility::PreMain register_;
+};
+
+utility::PreMain Factory::register_([]()
+{
+    Generator::registerType<TmsTerrainRgb>(std::make_shared<Factory>());
+});
+
+/** Largest value stored in 24 bits.
+ */
+constexpr double MaxCode((1 << 24) - 1);
+
+/** Code of nodata samples, valid heights never get it.
+ */
+constexpr std::uint32_t NodataCode(0);
+
+/** Samples below this value are warper's nodata.
+ */
+constexpr float InvalidHeight(-1e9f);
+
+} // namespace
+
+TmsTerrainRgb::TmsTerrainRgb(const Params &params)
+    : TmsRaster(params, boost::none, true)
+{
+    auto definition = params.resource.definition<resource::TmsTerrainRgb>();
+
+    params_.base = definition.base;
+    params_.interval = definition.interval;
+    params_.surface = definition.surface;
+}
+
+void TmsTerrainRgb::generateTileImage(const vts::TileId &tileId
+    , const Sink::FileInfo &fi
+    , RasterFormat format
+    , Sink &sink, Arsenal &arsenal
+    , const ImageFlags &imageFlags) const {
+
+    sink.checkAborted();
+
+    // serialization func
+    const auto &serialize([&](const cv::Mat &tile, const DatasetDesc &ds)
+                          -> void
+    {
+        sendImage(tile, Sink::FileInfo(fi).setMaxAge(ds.maxAge)
+                  , format, imageFlags.atlas, sink, definition().encoding);
+    });
+
+    // validity checks and corner cases; atlas is JPEG, i.e. lossy
+    if (imageFlags.atlas || !imageFlags.checkFormat(format, this->format()))
+    {
+        return sink.error
+            (utility::makeError<NotFound>
+             ("Format <%s> is not supported by this resource (%s)."
+              , format, this->format()));
+    }
+
+    vts::NodeInfo nodeInfo(referenceFrame(), tileId);
+    if (!nodeInfo.valid()) {
+        return sink.error
+            (utility::makeError<NotFound>
+             ("TileId outside of valid reference frame tree."));
+    }
+
+    if (!nodeInfo.productive()
+        || (index_ && !vts::TileIndex::Flag::isReal(index_->get(tileId))))
+    {
+        return sink.error
+            (utility::makeError<EmptyImage>("No valid data."));
+    }
+
+    // grab dataset to use
+    const auto ds(dataset());
+
+    // DEM and geoid grid of referenced surface, plain dataset otherwise
+    DemDataset dem(absoluteDataset(ds.path));
+    if (params_.surface) {
+        const auto surface(demRegistry().find(referenceFrameId()
+                                              , { *params_.surface }));
+        if (!surface.second) {
+            return sink.error
+                (utility::makeError<Unavailable>
+                 ("Surface <%s> is not available.", *params_.surface));
+        }
+        dem = surface.first.front();
+    }
+
+    // sample DEM at pixel centres: demFloat works in grid registration, ask
+    // for 255 intervals between centres of the outermost pixels
+    const auto &extents(nodeInfo.extents());
+    const auto es(math::size(extents));
+    const math::Point2 hpx(es.width / 512.0, es.height / 512.0);
+
+    const auto heights(arsenal.warper.warp
+                       (GdalWarper::RasterRequest
+                        (GdalWarper::RasterRequest::Operation::demFloat
+                         , dem.dataset
+                         , nodeInfo.srsDef()
+                         , math::Extents2(extents.ll + hpx, extents.ur - hpx)
+                         , math::Size2(255, 255))
+                        .setOverviewRatio(definition_.overviewRatio)
+                        , sink));
+    sink.checkAborted();
+
+    // geoid-relative heights to raw SDS (i.e. ellipsoidal) heights
+    boost::optional<vts::CsConvertor> geoid;
+    if (dem.geoidGrid) { geoid = sdsg2sdsr(nodeInfo, dem.geoidGrid); }
+    const math::Point2 step(es.width / 256.0, es.height / 256.0);
+
+    ScratchMat img;
+    {
+        const auto scope(sink.traceStage("encode-heights"));
+
+        auto &out(img.create(heights->rows, heights->cols, CV_8UC3));
+        for (int j(0); j < heights->rows; ++j) {
+            const auto *src(heights->ptr<float>(j));
+            auto *dst(out.ptr<cv::Vec3b>(j));
+            const double y(extents.ur(1) - hpx(1) - j * step(1));
+            for (int i(0); i < heights->cols; ++i) {
+                std::uint32_t code(NodataCode);
+                if ((src[i] > InvalidHeight) && std::isfinite(src[i])) {
+                    double height(src[i]);
+                    if (geoid) {
+                        height = (*geoid)
+                            (math::Point3(extents.ll(0) + hpx(0)
+                                          + i * step(0), y, height))(2);
+                    }
+
+                    // valid heights never collide with nodata
+                    code = static_cast<std::uint32_t>
+                        (std::min(std::max(std::round
+                                           ((height - params_.base)
+                                            / params_.interval)
+                                           , 1.0), MaxCode));
+                }
+                // BGR order
+                dst[i] = cv::Vec3b(code & 0xff, (code >> 8) & 0xff
+                                   , (code >> 16) & 0xff);
+            }
+        }
+    }
+
+    // send output
+    serialize(img.mat(), ds);
+}
+
+RasterFormat TmsTerrainRgb::format() const {
+    return definition().format;
+}
+
+int TmsTerrainRgb::generatorRevision() const {
+    return generatorRevision_;
+}
+
+} // namespace generator
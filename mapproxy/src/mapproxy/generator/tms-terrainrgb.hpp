@@ -0,0 +1,69 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef mapproxy_generator_tms_terrainrgb_hpp_included_
+#define mapproxy_generator_tms_terrainrgb_hpp_included_
+
+#include "tms-raster.hpp"
+
+namespace generator {
+
+/** Serves warped DEM as terrain-RGB raster tiles. Clients mesh them on
+ *  their own, the server only warps and encodes.
+ */
+class TmsTerrainRgb : public TmsRaster
+{
+public:
+
+    // needed for Generator::registerType
+    typedef resource::TmsTerrainRgb Definition;
+
+    TmsTerrainRgb(const Params &params);
+
+private:
+
+    void generateTileImage(const vts::TileId &tileId
+                                   , const Sink::FileInfo &fi
+                                   , RasterFormat format
+                                   , Sink &sink, Arsenal &arsenal
+                                   , const ImageFlags &imageFlags
+                                   = ImageFlags()) const override;
+
+    RasterFormat format() const override;
+
+    int generatorRevision() const override;
+
+    // height encoding and source
+    struct {
+        double base;
+        double interval;
+        boost::optional<std::string> surface;
+    } params_;
+};
+
+} // namespace generator
+
+#endif // mapproxy_generator_tms_terrainrgb_hpp_included_
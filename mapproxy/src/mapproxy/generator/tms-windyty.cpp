@@ -28,11 +28,16 @@
 #include <unistd.h>
 
 #include <cerrno>
+#include <cctype>
 #include <fstream>
+#include <algorithm>
 #include <system_error>
 
 #include <boost/filesystem.hpp>
 #include <boost/format.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/algorithm/string/split.hpp>
+#include <boost/algorithm/string/classification.hpp>
 #include <boost/program_options.hpp>
 #include <boost/iostreams/stream_buffer.hpp>
 #include <boost/iostreams/device/file_descriptor.hpp>
@@ -47,6 +52,9 @@
 #include "jsoncpp/json.hpp"
 #include "jsoncpp/as.hpp"
 
+#include "vts-libs/vts/tileop.hpp"
+#include "vts-libs/vts/nodeinfo.hpp"
+
 #include "../error.hpp"
 
 #include "factory.hpp"
@@ -55,6 +63,7 @@
 namespace fs = boost::filesystem;
 namespace po = boost::program_options;
 namespace bio = boost::iostreams;
+namespace ba = boost::algorithm;
 
 namespace generator {
 
@@ -219,6 +228,30 @@ TmsWindyty::File writeWms(const fs::path &root
                             , path.string());
 }
 
+/** Maximum number of tiles warped to warm up the next slice.
+ */
+const std::size_t WarmLimit(1024);
+
+/** Stale slice used instead of the current one by the task running in this
+ *  thread.
+ */
+struct SliceOverride {
+    std::string path;
+    std::time_t timestamp;
+};
+
+thread_local const SliceOverride *sliceOverride(nullptr);
+
+struct SliceScope {
+    SliceScope(const SliceOverride &slice) : prev(sliceOverride) {
+        sliceOverride = &slice;
+    }
+
+    ~SliceScope() { sliceOverride = prev; }
+
+    const SliceOverride *prev;
+};
+
 } // namespace
 
 void TmsWindyty::File::remove()
@@ -253,21 +286,176 @@ TmsWindyty::DsInfo TmsWindyty::dsInfo(std::time_t now) const
     std::unique_lock<std::mutex> lock(ds_.mutex);
 
     if (now > ds_.current.timestamp) {
-        // Generate new file
-        auto file(writeWms(config().tmpRoot, dsConfig_, resource()
-                           , normalizedTime(now, dsConfig_)
-                           , 1, definition_.forecastOffset));
-        ds_.prev = std::move(ds_.current);
+        // use pre-rotated slice if still valid, generate new file otherwise
+        auto file((!ds_.next.path.empty() && (now <= ds_.next.timestamp))
+                  ? std::move(ds_.next)
+                  : writeWms(config().tmpRoot, dsConfig_, resource()
+                             , normalizedTime(now, dsConfig_)
+                             , 1, definition_.forecastOffset));
+        ds_.next = File(0, std::string());
+
+        // previous slice is kept for clients with stale definition
+        const auto timestamp(ds_.current.timestamp);
+        ds_.stale[timestamp] = std::move(ds_.current);
         ds_.current = std::move(file);
     }
 
+    // forget slices out of service; the last one is kept anyway since it
+    // may still be used by requests in flight
+    while (ds_.stale.size() > 1) {
+        const auto first(ds_.stale.begin());
+        if ((first->first + definition_.staleTtl) >= now) { break; }
+        ds_.stale.erase(first);
+    }
+
     // done
     return { ds_.current.path, ds_.current.timestamp };
 }
 
+boost::optional<TmsWindyty::DsInfo>
+TmsWindyty::staleSlice(std::time_t timestamp, std::time_t now) const
+{
+    std::unique_lock<std::mutex> lock(ds_.mutex);
+
+    const auto fstale(ds_.stale.find(timestamp));
+    if ((fstale == ds_.stale.end())
+        || ((timestamp + definition_.staleTtl) < now))
+    {
+        return boost::none;
+    }
+
+    // valid until the end of service
+    return DsInfo{ fstale->second.path, timestamp + definition_.staleTtl };
+}
+
+boost::optional<std::string> TmsWindyty::preRotate(std::time_t now) const
+{
+    if (!definition_.preRotate) { return boost::none; }
+
+    std::unique_lock<std::mutex> lock(ds_.mutex);
+
+    // already done, too early or too late (switch-over is due)
+    if (!ds_.next.path.empty()
+        || (now < (ds_.current.timestamp - definition_.preRotate))
+        || (now >= ds_.current.timestamp))
+    {
+        return boost::none;
+    }
+
+    // next slice starts when the current one ends
+    ds_.next = writeWms(config().tmpRoot, dsConfig_, resource()
+                        , normalizedTime(ds_.current.timestamp, dsConfig_)
+                        , 1, definition_.forecastOffset);
+
+    LOG(info2) << "Pre-rotated <" << id() << "> to slice valid till "
+               << ds_.next.timestamp << ".";
+    return ds_.next.path;
+}
+
+void TmsWindyty::warm(const std::string &path, Arsenal &arsenal) const
+{
+    if (!definition_.warmLod) { return; }
+
+    const auto &res(resource());
+    const auto resampling(definition_.resampling ? *definition_.resampling
+                          : geo::GeoDataset::Resampling::cubic);
+
+    // nobody waits for the result, keep out of the way of real requests
+    auto sink(Sink::detached());
+    sink.setBackground(true);
+
+    std::size_t count(0);
+    const auto maxLod(std::min(*definition_.warmLod, res.lodRange.max));
+    for (auto lod(res.lodRange.min); lod <= maxLod; ++lod) {
+        const auto tr(vts::shiftRange(res.lodRange.min, res.tileRange, lod));
+        for (auto j(tr.ll(1)); j <= tr.ur(1); ++j) {
+            for (auto i(tr.ll(0)); i <= tr.ur(0); ++i) {
+                if (count >= WarmLimit) { break; }
+
+                const vts::NodeInfo nodeInfo
+                    (referenceFrame(), vts::TileId(lod, i, j));
+                if (!nodeInfo.productive()) { continue; }
+
+                arsenal.warper.warp
+                    (GdalWarper::RasterRequest
+                     (GdalWarper::RasterRequest::Operation::imageNoOpt
+                      , absoluteDataset(path)
+                      , nodeInfo.srsDef()
+                      , nodeInfo.extents()
+                      , math::Size2(256, 256)
+                      , resampling)
+                     , sink
+                     , [](const GdalWarper::Raster&, const std::exception_ptr&)
+                     {});
+                ++count;
+            }
+        }
+    }
+
+    LOG(info2) << "Warming <" << id() << ">: " << count
+               << " tiles of the next slice queued.";
+}
+
+Generator::Task TmsWindyty::generateVtsFile_impl(const FileInfo &fileInfo
+                                                 , Sink &sink) const
+{
+    auto task(TmsRaster::generateVtsFile_impl(fileInfo, sink));
+    if (!task) { return task; }
+
+    const auto now(std::time(nullptr));
+
+    // stale slice is identified by revision appended to the query
+    boost::optional<SliceOverride> slice;
+    if (definition_.staleTtl) {
+        std::vector<std::string> args;
+        ba::split(args, fileInfo.query, ba::is_any_of("&")
+                  , ba::token_compress_on);
+        for (const auto &arg : args) {
+            if (arg.empty() || !std::all_of(arg.begin(), arg.end(), ::isdigit))
+            {
+                continue;
+            }
+            if (const auto info = staleSlice
+                (boost::lexical_cast<std::time_t>(arg), now))
+            {
+                slice = SliceOverride{ info->path, info->timestamp };
+                break;
+            }
+        }
+    }
+
+    boost::optional<std::string> warmPath;
+    try {
+        warmPath = preRotate(now);
+    } catch (const std::exception &e) {
+        // not fatal, slice is written at the switch-over
+        LOG(warn2) << "Pre-rotation of <" << id() << "> failed: <"
+                   << e.what() << ">.";
+    }
+
+    if (!slice && !warmPath) { return task; }
+
+    return [=](Sink &sink, Arsenal &arsenal)
+    {
+        if (warmPath) { warm(*warmPath, arsenal); }
+        if (!slice) { return task(sink, arsenal); }
+
+        SliceScope scope(*slice);
+        task(sink, arsenal);
+    };
+}
+
 TmsRaster::DatasetDesc TmsWindyty::dataset_impl() const
 {
     const auto now(std::time(nullptr));
+
+    if (sliceOverride) {
+        // stale slice requested by tile being generated in this thread
+        return { sliceOverride->path
+                 , long(std::max(sliceOverride->timestamp - now
+                                 , std::time_t(0)))
+                 , true };
+    }
     const auto info(dsInfo(now));
 
     // max age is time remaining till the end of this forecast
@@ -27,6 +27,7 @@
 #ifndef mapproxy_generator_tms_windyty_hpp_included_
 #define mapproxy_generator_tms_windyty_hpp_included_
 
+#include <map>
 #include <mutex>
 
 #include <boost/format.hpp>
@@ -107,6 +108,12 @@ private:
 
     virtual vr::BoundLayer boundLayer(ResourceRoot root) const;
 
+    /** Serves tiles of stale slices (by revision in the query) from their
+     *  own datasets and triggers pre-rotation.
+     */
+    virtual Task generateVtsFile_impl(const FileInfo &fileInfo
+                                      , Sink &sink) const;
+
     struct DsInfo {
         std::string path;
         std::time_t timestamp;
@@ -114,11 +121,34 @@ private:
 
     DsInfo dsInfo(std::time_t now) const;
 
+    /** Returns still served stale slice with given timestamp (if any).
+     */
+    boost::optional<DsInfo> staleSlice(std::time_t timestamp
+                                       , std::time_t now) const;
+
+    /** Writes the next slice ahead of the switch-over. Returns its path
+     *  if just written (i.e. when it should be warmed up).
+     */
+    boost::optional<std::string> preRotate(std::time_t now) const;
+
+    /** Warps low LOD tiles of given slice in the background, results are
+     *  dropped. Only GDAL's cache of upstream tiles gets filled.
+     */
+    void warm(const std::string &path, Arsenal &arsenal) const;
+
     struct Dataset {
         std::mutex mutex;
 
         File current;
-        File prev;
+
+        /** Next slice written ahead of time (pre-rotation).
+         */
+        File next;
+
+        /** Previous slices, by their timestamp (i.e. revision their tiles
+         *  are requested with).
+         */
+        std::map<std::time_t, File> stale;
     };
 
     const Definition &definition_;
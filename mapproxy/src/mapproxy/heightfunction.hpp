@@ -43,6 +43,13 @@ public:
     virtual ~HeightFunction() {}
     virtual double operator()(double h) const = 0;
 
+    /** Applies height function to all heights in range [begin, end) in place.
+     *  Default implementation calls operator() for each height.
+     */
+    virtual void transform(double *begin, double *end) const {
+        for (; begin != end; ++begin) { *begin = (*this)(*begin); }
+    }
+
     static HeightFunction::pointer parse(const Json::Value &value
                                          , const std::string &key);
     static bool changed(const HeightFunction::pointer &l
@@ -76,6 +83,18 @@ public:
         return apply(h);
     }
 
+    /** Branch-free batch version, vectorizable by the compiler.
+     */
+    virtual void transform(double *begin, double *end) const {
+        const auto &hr(config_.heightRange);
+        for (; begin != end; ++begin) {
+            const double h(*begin);
+            const double v(apply(h));
+            *begin = ((h < hr.min) ? limits_.min
+                      : ((h > hr.max) ? limits_.max : v));
+        }
+    }
+
     virtual void build(Json::Value &value) const;
     virtual bool changed(const HeightFunction::pointer &other) const;
 
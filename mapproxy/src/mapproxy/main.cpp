@@ -28,6 +28,9 @@
 #include <utility>
 #include <functional>
 #include <map>
+#include <sstream>
+#include <chrono>
+#include <thread>
 
 #include <boost/optional.hpp>
 #include <boost/utility/in_place_factory.hpp>
@@ -40,6 +43,7 @@
 #include "utility/tcpendpoint-io.hpp"
 #include "utility/buildsys.hpp"
 #include "utility/format.hpp"
+#include "utility/raise.hpp"
 #include "service/service.hpp"
 
 #include "gdal-drivers/register.hpp"
@@ -48,8 +52,12 @@
 #include "vts-libs/vts/support.hpp"
 
 #include "http/http.hpp"
+#include "http/contentgenerator.hpp"
 
+#include "support/atlas.hpp"
 #include "support/wmts.hpp"
+#include "support/metrics.hpp"
+#include "support/compression.hpp"
 
 #include "error.hpp"
 #include "resourcebackend.hpp"
@@ -64,6 +72,45 @@ namespace ba = boost::algorithm;
 namespace vr = vtslibs::registry;
 namespace vts = vtslibs::vts;
 
+/** Serves metrics in OpenMetrics format at /metrics and in-flight dump
+ *  (see in-flight ctrl command) as plain text at /in-flight.
+ */
+class MetricsServer : public http::ContentGenerator {
+public:
+    typedef std::function<void(std::ostream &os)> Renderer;
+
+    MetricsServer(const Renderer &renderer, const Renderer &inFlight)
+        : renderer_(renderer), inFlight_(inFlight)
+    {}
+
+private:
+    virtual void generate_impl(const http::Request &request
+                               , const http::ServerSink::pointer &sink)
+    {
+        if (request.path == "/in-flight") {
+            std::ostringstream os;
+            inFlight_(os);
+            sink->content(os.str(), http::SinkBase::FileInfo
+                          ("text/plain; charset=utf-8"), nullptr);
+            return;
+        }
+
+        if (request.path != "/metrics") {
+            sink->error(utility::makeError<NotFound>
+                        ("Metrics are available at /metrics."));
+            return;
+        }
+
+        std::ostringstream os;
+        renderer_(os);
+        sink->content(os.str(), http::SinkBase::FileInfo
+                      (metrics::ContentType), nullptr);
+    }
+
+    Renderer renderer_;
+    Renderer inFlight_;
+};
+
 class Daemon : public service::Service {
 public:
     Daemon()
@@ -72,9 +119,10 @@ public:
                            | service::ENABLE_UNRECOGNIZED_OPTIONS)
         , httpListen_(3070)
         , httpThreadCount_(boost::thread::hardware_concurrency())
+        , httpListenRetry_(), httpDrainTimeout_()
         , httpClientThreadCount_(1)
         , coreThreadCount_(boost::thread::hardware_concurrency())
-        , httpEnableBrowser_(false)
+        , httpEnableBrowser_(false), dumpImagesLimit_(10000)
     {
         generatorsConfig_.root
             = utility::buildsys::installPath("var/mapproxy/store");
@@ -122,12 +170,20 @@ private:
 
     void cleanup();
 
+    /** Starts listening, retries for a while if the endpoint is in use.
+     */
+    void listen();
+
     virtual bool ctrl(const CtrlCommand &cmd, std::ostream &os);
 
     virtual void stat(std::ostream &os);
 
     virtual void monitor(std::ostream &os);
 
+    /** Renders lock-free metrics in OpenMetrics format.
+     */
+    void metrics(std::ostream &os);
+
     struct Stopper {
         Stopper(Daemon &d) : d(d) { }
         ~Stopper() { d.cleanup(); }
@@ -139,9 +195,16 @@ private:
 
     utility::TcpEndpoint httpListen_;
     unsigned int httpThreadCount_;
+    unsigned int httpListenRetry_;
+    unsigned int httpDrainTimeout_;
+    boost::optional<utility::TcpEndpoint> metricsListen_;
     unsigned int httpClientThreadCount_;
     unsigned int coreThreadCount_;
+    Core::Options coreOptions_;
     bool httpEnableBrowser_;
+    fs::path dumpImages_;
+    std::size_t dumpImagesLimit_;
+    compression::Options compressionOptions_;
     ResourceBackend::GenericConfig resourceBackendGenericConfig_;
     ResourceBackend::TypedConfig resourceBackendConfig_;
     vs::SupportFile::Vars variables_;
@@ -153,6 +216,8 @@ private:
     boost::optional<Generators> generators_;
     boost::optional<Core> core_;
     boost::optional<http::Http> http_;
+    boost::optional<MetricsServer> metricsServer_;
+    boost::optional<http::Http> metricsHttp_;
 };
 
 void Daemon::configuration(po::options_description &cmdline
@@ -172,6 +237,22 @@ void Daemon::configuration(po::options_description &cmdline
         ("http.threadCount", po::value(&httpThreadCount_)
          ->default_value(httpThreadCount_)->required()
          , "Number of server HTTP threads.")
+        ("http.listenRetry", po::value(&httpListenRetry_)
+         ->default_value(httpListenRetry_)->required()
+         , "Time (in ms) to keep retrying to listen while the endpoint is "
+         "in use. Allows starting new instance while the old one still "
+         "serves: the new one prepares its resources (including its own "
+         "GDAL workers, shared memory and dataset cache, which start cold) "
+         "and takes over once the old one is gone (disk cache is opened "
+         "once the old one releases it). 0 = fail right away.")
+        ("http.drainTimeout", po::value(&httpDrainTimeout_)
+         ->default_value(httpDrainTimeout_)->required()
+         , "Time (in ms) to wait on stop for requests being processed "
+         "to be answered before the server is shut down. 0 = no wait.")
+        ("http.metrics.listen", po::value<utility::TcpEndpoint>()
+         , "TCP endpoint where to serve metrics (at /metrics) in "
+         "OpenMetrics format and in-flight dump (at /in-flight). "
+         "Disabled if not set.")
         ("http.client.threadCount", po::value(&httpClientThreadCount_)
          ->default_value(httpClientThreadCount_)->required()
          , "Number of client HTTP threads.")
@@ -186,11 +267,276 @@ void Daemon::configuration(po::options_description &cmdline
         ("core.threadCount", po::value(&coreThreadCount_)
          ->default_value(coreThreadCount_)->required()
          , "Number of processing threads.")
-
+        ("core.cache.size", po::value(&coreOptions_.cache.size)
+         ->default_value(coreOptions_.cache.size)->required()
+         , "Size of in-memory cache of generated responses (in MB, "
+         "0 = disabled). Responses are kept for their max-age.")
+        ("core.cache.shards", po::value(&coreOptions_.cache.shards)
+         ->default_value(coreOptions_.cache.shards)->required()
+         , "Number of independently locked parts of the response cache.")
+        ("core.cache.maxEntrySize"
+         , po::value(&coreOptions_.cache.maxEntrySize)
+         ->default_value(coreOptions_.cache.maxEntrySize)->required()
+         , "Larger responses are not cached (in KB).")
+        ("core.diskCache.size", po::value(&coreOptions_.disk.size)
+         ->default_value(coreOptions_.disk.size)->required()
+         , "Size of on-disk cache of generated responses (in MB, "
+         "0 = disabled). Survives restarts; checked on in-memory cache miss.")
+        ("core.diskCache.path", po::value(&coreOptions_.disk.path)
+         , "Directory of on-disk response cache. Defaults to "
+         "responsecache subdirectory of store.path.")
+        ("core.diskCache.queueLimit"
+         , po::value(&coreOptions_.disk.queueLimit)
+         ->default_value(coreOptions_.disk.queueLimit)->required()
+         , "Maximum number of responses waiting to be written to disk; "
+         "responses over the limit are not stored.")
+        ("core.admission.maxInFlight"
+         , po::value(&coreOptions_.admission.maxInFlight)
+         ->default_value(coreOptions_.admission.maxInFlight)->required()
+         , "Maximum number of generator tasks in flight (queued or "
+         "running, 0 = unlimited). Requests over the limit get 503.")
+        ("core.admission.maxInFlightPerResource"
+         , po::value(&coreOptions_.admission.maxInFlightPerResource)
+         ->default_value(coreOptions_.admission.maxInFlightPerResource)
+         ->required()
+         , "Maximum number of generator tasks in flight per resource "
+         "(0 = unlimited).")
+        ("core.admission.lowPriorityLimit"
+         , po::value(&coreOptions_.admission.lowPriorityLimit)
+         ->default_value(coreOptions_.admission.lowPriorityLimit)
+         ->required()
+         , "Masks and debug nodes are generated only while number of tasks "
+         "in flight is below this limit (0 = same as "
+         "core.admission.maxInFlight).")
+        ("core.scheduler.maxRunningPerResource"
+         , po::value(&coreOptions_.scheduling.maxRunningPerResource)
+         ->default_value(coreOptions_.scheduling.maxRunningPerResource)
+         ->required()
+         , "Maximum number of tasks of a single resource processed at once "
+         "(0 = unlimited). Keeps one heavy resource from taking over all "
+         "core threads.")
+        ("core.scheduler.weight.tms"
+         , po::value(&coreOptions_.scheduling.tmsWeight)
+         ->default_value(coreOptions_.scheduling.tmsWeight)->required()
+         , "Share of core threads of a tms resource relative to other "
+         "resources with queued tasks.")
+        ("core.scheduler.weight.surface"
+         , po::value(&coreOptions_.scheduling.surfaceWeight)
+         ->default_value(coreOptions_.scheduling.surfaceWeight)->required()
+         , "Share of core threads of a surface resource relative to other "
+         "resources with queued tasks.")
+        ("core.scheduler.weight.geodata"
+         , po::value(&coreOptions_.scheduling.geodataWeight)
+         ->default_value(coreOptions_.scheduling.geodataWeight)->required()
+         , "Share of core threads of a geodata resource relative to other "
+         "resources with queued tasks.")
+        ("core.prefetch.budget"
+         , po::value(&coreOptions_.prefetch.budget)
+         ->default_value(coreOptions_.prefetch.budget)->required()
+         , "Maximum number of tiles (children and neighbours of requested "
+         "tiles) generated speculatively in the background at once "
+         "(0 = prefetch disabled). Needs core.cache.size or "
+         "core.diskCache.size.")
+        ("core.prefetch.queueLimit"
+         , po::value(&coreOptions_.prefetch.queueLimit)
+         ->default_value(coreOptions_.prefetch.queueLimit)->required()
+         , "Maximum number of tiles waiting for prefetch.")
+        ("core.prefetch.trackLimit"
+         , po::value(&coreOptions_.prefetch.trackLimit)
+         ->default_value(coreOptions_.prefetch.trackLimit)->required()
+         , "Number of prefetched tiles remembered to count prefetch hits; "
+         "older ones are counted as wasted.")
+        ("core.seed.budget"
+         , po::value(&coreOptions_.seedBudget)
+         ->default_value(coreOptions_.seedBudget)->required()
+         , "Maximum number of tiles of a seeding job (see seed control "
+         "command) generated at once.")
+        ("core.warmup.onPrepare"
+         , po::value(&coreOptions_.warmup.onPrepare)
+         ->default_value(coreOptions_.warmup.onPrepare)->required()
+         , "Warm every resource right after it is prepared (see "
+         "warm-resource control command).")
+        ("core.warmup.lods"
+         , po::value(&coreOptions_.warmup.lods)
+         ->default_value(coreOptions_.warmup.lods)->required()
+         , "Number of top lods of a warmed resource generated into the "
+         "persistent cache (0 = none).")
+        ("core.debug.dumpImages", po::value(&dumpImages_)
+         , "Directory where every non-uniform image sent as a raster tile "
+         "is also written as PNG before encoding (a corpus for "
+         "mapproxy-encoder-bench). Off if not set.")
+        ("core.debug.dumpImagesLimit", po::value(&dumpImagesLimit_)
+         ->default_value(dumpImagesLimit_)->required()
+         , "Maximum number of images dumped by this process.")
+        ("core.compression.mesh"
+         , po::value(&compressionOptions_.mesh)
+         ->default_value(compressionOptions_.mesh)->required()
+         , "Gzip level of compressed meshes (1 = fastest, 9 = best, "
+         "-1 = zlib default).")
+        ("core.compression.terrain"
+         , po::value(&compressionOptions_.terrain)
+         ->default_value(compressionOptions_.terrain)->required()
+         , "Gzip level of Cesium terrain tiles (see core.compression.mesh).")
+        ("core.compression.metatile"
+         , po::value(&compressionOptions_.metatile)
+         ->default_value(compressionOptions_.metatile)->required()
+         , "Gzip level of metatiles sent to clients accepting gzip "
+         "(0 = sent plain).")
+        ("core.compression.geodata"
+         , po::value(&compressionOptions_.geodata)
+         ->default_value(compressionOptions_.geodata)->required()
+         , "Gzip level of heightcoded geodata tiles sent to clients "
+         "accepting gzip (0 = sent plain).")
+        ("core.compression.document"
+         , po::value(&compressionOptions_.document)
+         ->default_value(compressionOptions_.document)->required()
+         , "Gzip level of memoized documents (map configurations, layer "
+         "definitions, styles; see core.compression.mesh).")
+        ("core.coalesce"
+         , po::value(&coreOptions_.coalesce)
+         ->default_value(coreOptions_.coalesce)->required()
+         , "Identical requests (same resource, file and query) in flight at "
+         "the same time share single generator run.")
+        ("core.deadline"
+         , po::value(&coreOptions_.deadline)
+         ->default_value(coreOptions_.deadline)->required()
+         , "Resource file requests not answered within this time get 504 "
+         "and their remaining work, incl. queued and running GDAL "
+         "requests, is dropped (in ms, 0 = no deadline).")
+        ("core.deadline.byType"
+         , po::value<std::string>()->default_value("")
+         , "Per file type deadlines overriding core.deadline, list of "
+         "type=ms pairs, e.g. \"jpg=2000,bin=5000\". File type is "
+         "filename extension.")
+        ("core.trace.slowThreshold"
+         , po::value(&coreOptions_.traceSlowThreshold)
+         ->default_value(coreOptions_.traceSlowThreshold)->required()
+         , "Requests slower than this are logged along with breakdown of "
+         "their processing stages (in ms, 0 = never). Breakdown is sent "
+         "back in Server-Timing header to requests carrying "
+         "X-Mapproxy-Trace header.")
+        ("profile.threshold"
+         , po::value(&coreOptions_.profile.threshold)
+         ->default_value(coreOptions_.profile.threshold)->required()
+         , "Generator tasks and GDAL requests running longer than this "
+         "(in ms, 0 = never) get stack of their thread sampled into "
+         "profile directory, file names carry request's trace ID (logged "
+         "along with slow requests).")
+        ("profile.dir"
+         , po::value(&coreOptions_.profile.dir)
+         , "Directory of stack samples. Defaults to profile "
+         "subdirectory of store.path.")
+        ("profile.samples"
+         , po::value(&coreOptions_.profile.samples)
+         ->default_value(coreOptions_.profile.samples)->required()
+         , "Maximum number of stack samples of one slow request.")
+        ("profile.interval"
+         , po::value(&coreOptions_.profile.interval)
+         ->default_value(coreOptions_.profile.interval)->required()
+         , "Time between stack samples of one slow request (in ms).")
+        ("profile.maxFiles"
+         , po::value(&coreOptions_.profile.maxFiles)
+         ->default_value(coreOptions_.profile.maxFiles)->required()
+         , "Maximum number of files kept in profile directory; the "
+         "oldest ones are removed.")
+        ("cluster.self"
+         , po::value(&coreOptions_.cluster.self)
+         , "URL of this node as listed among cluster members. Cluster mode "
+         "is on when set along with cluster.members or "
+         "cluster.membersFile.")
+        ("cluster.members"
+         , po::value<std::string>()->default_value("")
+         , "Comma-separated list of URLs of all cluster nodes (this one "
+         "included). Each tile is owned by one of them (consistent "
+         "hashing); other nodes forward its generation to the owner.")
+        ("cluster.membersFile"
+         , po::value(&coreOptions_.cluster.membersFile)
+         , "File with URLs of cluster nodes, one per line. Re-read when "
+         "changed; overrides cluster.members.")
+        ("cluster.replicas"
+         , po::value(&coreOptions_.cluster.replicas)
+         ->default_value(coreOptions_.cluster.replicas)->required()
+         , "Points on the hash ring per cluster node.")
+        ("cluster.timeout"
+         , po::value(&coreOptions_.cluster.timeout)
+         ->default_value(coreOptions_.cluster.timeout)->required()
+         , "Timeout of requests forwarded to the owner (in ms); the file "
+         "is generated locally on timeout or error.")
+        ("cluster.failureLimit"
+         , po::value(&coreOptions_.cluster.failureLimit)
+         ->default_value(coreOptions_.cluster.failureLimit)->required()
+         , "Number of consecutive failures after which a peer is skipped.")
+        ("cluster.backoff"
+         , po::value(&coreOptions_.cluster.backoff)
+         ->default_value(coreOptions_.cluster.backoff)->required()
+         , "How long a failing peer is skipped (in s).")
+
+        ("sharedCache.size"
+         , po::value(&coreOptions_.shared.size)
+         ->default_value(coreOptions_.shared.size)->required()
+         , "Size of host-wide cache of generated responses and warp "
+         "results in shared memory (in MB, 0 = disabled). Shared by all "
+         "instances using the same sharedCache.name; the first one to "
+         "start sets the size.")
+        ("sharedCache.name"
+         , po::value(&coreOptions_.shared.name)
+         ->default_value(coreOptions_.shared.name)->required()
+         , "Name of host-wide cache segment (/dev/shm/mapproxy-<name>).")
+        ("sharedCache.warpTtl"
+         , po::value(&gdalWarperOptions_.sharedCacheTtl)
+         ->default_value(gdalWarperOptions_.sharedCacheTtl)->required()
+         , "Time warp results are kept in the host-wide cache (in s). "
+         "Datasets replaced in place are seen after this time.")
+
+        ("gdal.backend"
+         , po::value(&gdalWarperOptions_.backend)
+         ->default_value(gdalWarperOptions_.backend)->required()
+         , "GDAL warper backend: process (forked GDAL processes talking via "
+         "shared memory) or threads (threads of this process, each with its "
+         "own dataset cache).")
         ("gdal.processCount"
          , po::value(&gdalWarperOptions_.processCount)
          ->default_value(gdalWarperOptions_.processCount)->required()
-         , "Number of GDAL processes.")
+         , "Number of GDAL processes (or threads). Initial number of "
+         "processes when autoscaling.")
+        ("gdal.autoscale.max"
+         , po::value(&gdalWarperOptions_.autoscale.max)
+         ->default_value(gdalWarperOptions_.autoscale.max)->required()
+         , "Maximum number of GDAL processes; the process pool is resized "
+         "by load between gdal.autoscale.min and this (0 = off, fixed "
+         "gdal.processCount). Process backend only.")
+        ("gdal.autoscale.min"
+         , po::value(&gdalWarperOptions_.autoscale.min)
+         ->default_value(gdalWarperOptions_.autoscale.min)->required()
+         , "Minimum number of GDAL processes when autoscaling.")
+        ("gdal.autoscale.queueDepth"
+         , po::value(&gdalWarperOptions_.autoscale.queueDepth)
+         ->default_value(gdalWarperOptions_.autoscale.queueDepth)
+         ->required()
+         , "Add GDAL process when there are more queued requests than this "
+         "per process (0 = ignore queue depth).")
+        ("gdal.autoscale.queueWait"
+         , po::value(&gdalWarperOptions_.autoscale.queueWait)
+         ->default_value(gdalWarperOptions_.autoscale.queueWait)
+         ->required()
+         , "Add GDAL process when the oldest queued request waits longer "
+         "than this (in ms, 0 = ignore wait time).")
+        ("gdal.autoscale.loadLimit"
+         , po::value(&gdalWarperOptions_.autoscale.loadLimit)
+         ->default_value(gdalWarperOptions_.autoscale.loadLimit)
+         ->required()
+         , "GDAL process is added only while 1-minute load average per CPU "
+         "is below this.")
+        ("gdal.autoscale.idle"
+         , po::value(&gdalWarperOptions_.autoscale.idle)
+         ->default_value(gdalWarperOptions_.autoscale.idle)->required()
+         , "Drain one GDAL process when some process has been idle all the "
+         "time for this period (in seconds).")
+        ("gdal.autoscale.cooldown"
+         , po::value(&gdalWarperOptions_.autoscale.cooldown)
+         ->default_value(gdalWarperOptions_.autoscale.cooldown)
+         ->required()
+         , "Minimum time between two pool size changes (in seconds).")
         ("gdal.tmpRoot"
          , po::value(&gdalWarperOptions_.tmpRoot)
          ->default_value(gdalWarperOptions_.tmpRoot)->required()
@@ -203,6 +549,218 @@ void Daemon::configuration(po::options_description &cmdline
          , po::value(&gdalWarperOptions_.rssCheckPeriod)
          ->default_value(gdalWarperOptions_.rssCheckPeriod)->required()
          , "Memory check period (in seconds)")
+        ("gdal.affinity"
+         , po::value(&gdalWarperOptions_.affinity)
+         ->default_value(gdalWarperOptions_.affinity)->required()
+         , "Dispatch requests to GDAL processes that already have "
+         "the dataset open.")
+        ("gdal.affinity.stealDelay"
+         , po::value(&gdalWarperOptions_.affinityStealDelay)
+         ->default_value(gdalWarperOptions_.affinityStealDelay)->required()
+         , "Time (in milliseconds) after which an idle GDAL process "
+         "takes over request bound to another process.")
+        ("gdal.datasetCache.limit"
+         , po::value(&gdalWarperOptions_.datasetCacheLimit)
+         ->default_value(gdalWarperOptions_.datasetCacheLimit)->required()
+         , "Maximum number of datasets kept open by single GDAL process "
+         "(0 = unlimited).")
+        ("gdal.datasetCache.memoryLimit"
+         , po::value(&gdalWarperOptions_.datasetCacheMemoryLimit)
+         ->default_value(gdalWarperOptions_.datasetCacheMemoryLimit)
+         ->required()
+         , "Private memory budget of single GDAL process (in MB); least "
+         "recently used datasets are closed when exceeded (0 = unlimited).")
+        ("gdal.datasetCache.vectorLimit"
+         , po::value(&gdalWarperOptions_.vectorDatasetCacheLimit)
+         ->default_value(gdalWarperOptions_.vectorDatasetCacheLimit)
+         ->required()
+         , "Maximum number of vector datasets (heightcoding sources) kept "
+         "open by single GDAL process (0 = no caching).")
+        ("gdal.coalesce"
+         , po::value(&gdalWarperOptions_.coalesce)
+         ->default_value(gdalWarperOptions_.coalesce)->required()
+         , "Serve identical concurrent raster requests by single warp.")
+        ("gdal.priority.tile.weight"
+         , po::value(&gdalWarperOptions_.priorityWeights[0])
+         ->default_value(gdalWarperOptions_.priorityWeights[0])->required()
+         , "Weight of the metatile/navtile queue lane (at least 1).")
+        ("gdal.priority.mesh.weight"
+         , po::value(&gdalWarperOptions_.priorityWeights[1])
+         ->default_value(gdalWarperOptions_.priorityWeights[1])->required()
+         , "Weight of the mesh/normal map/geodata queue lane (at least 1).")
+        ("gdal.priority.imagery.weight"
+         , po::value(&gdalWarperOptions_.priorityWeights[2])
+         ->default_value(gdalWarperOptions_.priorityWeights[2])->required()
+         , "Weight of the imagery queue lane (at least 1).")
+        ("gdal.priority.mask.weight"
+         , po::value(&gdalWarperOptions_.priorityWeights[3])
+         ->default_value(gdalWarperOptions_.priorityWeights[3])->required()
+         , "Weight of the mask/debug queue lane (at least 1).")
+        ("gdal.queue.maxAge"
+         , po::value(&gdalWarperOptions_.queueMaxAge)
+         ->default_value(gdalWarperOptions_.queueMaxAge)->required()
+         , "Drop queued requests waiting longer than this (in seconds); "
+         "their clients have most probably given up (0 = never).")
+        ("gdal.shm.size"
+         , po::value(&gdalWarperOptions_.shmSize)
+         ->default_value(gdalWarperOptions_.shmSize)->required()
+         , "Size of shared memory used to talk to GDAL processes (in MB).")
+        ("gdal.shm.controlSize"
+         , po::value(&gdalWarperOptions_.shmControlSize)
+         ->default_value(gdalWarperOptions_.shmControlSize)->required()
+         , "Part of shared memory reserved for request bookkeeping (in MB); "
+         "the rest holds response data.")
+        ("gdal.shm.reserve"
+         , po::value(&gdalWarperOptions_.shmReserve)
+         ->default_value(gdalWarperOptions_.shmReserve)->required()
+         , "Free response memory (in MB) required to accept new request.")
+        ("gdal.shm.wait"
+         , po::value(&gdalWarperOptions_.shmWait)
+         ->default_value(gdalWarperOptions_.shmWait)->required()
+         , "How long (in milliseconds) new request waits for free response "
+         "memory before being rejected with 503.")
+        ("gdal.shm.hugepages"
+         , po::value(&gdalWarperOptions_.shmHugepages)
+         ->default_value(gdalWarperOptions_.shmHugepages)->required()
+         , "Back shared memory by explicitly reserved hugepages "
+         "(vm.nr_hugepages); falls back to regular pages if there are not "
+         "enough of them.")
+        ("gdal.shm.prefault"
+         , po::value(&gdalWarperOptions_.shmPrefault)
+         ->default_value(gdalWarperOptions_.shmPrefault)->required()
+         , "Fault in all shared memory pages at startup instead of on first "
+         "use by GDAL workers.")
+        ("gdal.prewarm.datasets"
+         , po::value(&gdalWarperOptions_.prewarmDatasets)
+         ->default_value(gdalWarperOptions_.prewarmDatasets)->required()
+         , "Number of most used datasets opened by newly spawned GDAL "
+         "process before it starts taking requests (0 = no pre-warming).")
+        ("gdal.prewarm.budget"
+         , po::value(&gdalWarperOptions_.prewarmBudget)
+         ->default_value(gdalWarperOptions_.prewarmBudget)->required()
+         , "Time budget (in milliseconds) of GDAL process pre-warming.")
+        ("gdal.recycle.graceful"
+         , po::value(&gdalWarperOptions_.recycleGraceful)
+         ->default_value(gdalWarperOptions_.recycleGraceful)->required()
+         , "Let GDAL process over the memory limit finish its current "
+         "request and exit instead of terminating it.")
+        ("gdal.recycle.timeout"
+         , po::value(&gdalWarperOptions_.recycleTimeout)
+         ->default_value(gdalWarperOptions_.recycleTimeout)->required()
+         , "Time (in seconds) after which a draining GDAL process is "
+         "terminated anyway.")
+        ("gdal.recycle.requests"
+         , po::value(&gdalWarperOptions_.recycleRequests)
+         ->default_value(gdalWarperOptions_.recycleRequests)->required()
+         , "Recycle GDAL process after processing this number of requests "
+         "(0 = never).")
+        ("gdal.cpuSets"
+         , po::value(&gdalWarperOptions_.cpuSets)
+         ->default_value(gdalWarperOptions_.cpuSets)
+         , "Semicolon-separated CPU sets in cpulist format (e.g. "
+         "\"0-7,16-23;8-15,24-31\"); GDAL processes are pinned to them "
+         "round-robin. Empty means no pinning.")
+        ("gdal.numaPinning"
+         , po::value(&gdalWarperOptions_.numaPinning)
+         ->default_value(gdalWarperOptions_.numaPinning)->required()
+         , "Pin GDAL processes round-robin to NUMA nodes (CPUs and "
+         "preferred memory). Overrides gdal.cpuSets.")
+        ("gdal.threads"
+         , po::value(&gdalWarperOptions_.gdalThreads)
+         ->default_value(gdalWarperOptions_.gdalThreads)->required()
+         , "GDAL_NUM_THREADS of each GDAL process (0 = GDAL default).")
+        ("gdal.cacheMax"
+         , po::value(&gdalWarperOptions_.gdalCacheMax)
+         ->default_value(gdalWarperOptions_.gdalCacheMax)->required()
+         , "GDAL block cache size of each GDAL process in MB "
+         "(0 = GDAL default).")
+        ("gdal.datasetBlockQuota"
+         , po::value(&gdalWarperOptions_.datasetBlockQuota)
+         ->default_value(gdalWarperOptions_.datasetBlockQuota)->required()
+         , "Share of GDAL block cache a single dataset can occupy in each "
+         "GDAL process in MB; dataset over its share is closed (releasing "
+         "its blocks) between requests. 0 means no quota.")
+        ("gdal.datasetConcurrency"
+         , po::value(&gdalWarperOptions_.datasetConcurrency)
+         ->default_value(gdalWarperOptions_.datasetConcurrency)->required()
+         , "Maximum number of GDAL processes working on requests for a single "
+         "dataset at once; requests over the limit stay queued while other "
+         "work is dispatched. 0 means unlimited.")
+        ("gdal.datasetConcurrency.byPrefix"
+         , po::value<std::string>()->default_value("")
+         , "Per dataset limits overriding gdal.datasetConcurrency, list of "
+         "prefix=N pairs, e.g. \"/store/resources/wms=2\". Applies to "
+         "datasets whose path starts with given prefix (e.g. resource's "
+         "root directory), longest prefix wins.")
+        ("gdal.rangeCache.path"
+         , po::value(&gdalWarperOptions_.rangeCache.root)
+         ->default_value(gdalWarperOptions_.rangeCache.root)
+         , "Directory of local-disk cache of byte ranges of remote datasets "
+         "(/vsicurl/, /vsis3/, ...) shared by all GDAL processes and kept "
+         "over restarts. Empty means no cache.")
+        ("gdal.rangeCache.size"
+         , po::value(&gdalWarperOptions_.rangeCache.size)
+         ->default_value(gdalWarperOptions_.rangeCache.size)->required()
+         , "Range cache size limit in MB.")
+        ("gdal.rangeCache.blockSize"
+         , po::value(&gdalWarperOptions_.rangeCache.blockSize)
+         ->default_value(gdalWarperOptions_.rangeCache.blockSize)
+         ->required()
+         , "Range cache block size in KB.")
+        ("gdal.rangeCache.readahead"
+         , po::value(&gdalWarperOptions_.rangeCache.readahead)
+         ->default_value(gdalWarperOptions_.rangeCache.readahead)
+         ->required()
+         , "Number of blocks fetched at once on range cache miss.")
+        ("gdal.rangeCache.headerSize"
+         , po::value(&gdalWarperOptions_.rangeCache.headerSize)
+         ->default_value(gdalWarperOptions_.rangeCache.headerSize)
+         ->required()
+         , "Size of header area (in KB) fetched at once on first read of "
+         "a remote file (COG IFDs and tile offsets).")
+        ("gdal.rangeCache.revalidate"
+         , po::value(&gdalWarperOptions_.rangeCache.revalidate)
+         ->default_value(gdalWarperOptions_.rangeCache.revalidate)
+         ->required()
+         , "Time (in seconds) remote file version (ETag) is trusted before "
+         "being checked again.")
+        ("gdal.uring.enable"
+         , po::value(&gdalWarperOptions_.uring.enabled)
+         ->default_value(gdalWarperOptions_.uring.enabled)->required()
+         , "Read local GeoTIFFs via io_uring: blocks of each warped window "
+         "are read in a single batch. Needs liburing at build time.")
+        ("gdal.uring.queueDepth"
+         , po::value(&gdalWarperOptions_.uring.queueDepth)
+         ->default_value(gdalWarperOptions_.uring.queueDepth)->required()
+         , "Maximum number of io_uring reads in flight per GDAL thread.")
+        ("gdal.uring.blockSize"
+         , po::value(&gdalWarperOptions_.uring.blockSize)
+         ->default_value(gdalWarperOptions_.uring.blockSize)->required()
+         , "Size of single io_uring read in KB; larger reads are split.")
+        ("gdal.uring.readahead"
+         , po::value(&gdalWarperOptions_.uring.readahead)
+         ->default_value(gdalWarperOptions_.uring.readahead)->required()
+         , "Number of blocks read at once on readahead miss.")
+        ("gdal.split.threshold"
+         , po::value(&gdalWarperOptions_.splitThreshold)
+         ->default_value(gdalWarperOptions_.splitThreshold)->required()
+         , "Split raster warps estimated (from past warps of the same "
+         "dataset) to take longer than this (in milliseconds) into strips "
+         "warped in parallel by several GDAL processes (0 = never split).")
+        ("gdal.split.strips"
+         , po::value(&gdalWarperOptions_.splitStrips)
+         ->default_value(gdalWarperOptions_.splitStrips)->required()
+         , "Maximum number of strips of a split raster warp.")
+        ("gdal.cost.path", po::value(&gdalWarperOptions_.costFile)
+         , "File where request costs measured by GDAL processes (used to "
+         "predict cost of new requests) are kept over restarts. Defaults "
+         "to warpcost file in store.path.")
+        ("gdal.sharePadded"
+         , po::value(&gdalWarperOptions_.sharePadded)
+         ->default_value(gdalWarperOptions_.sharePadded)->required()
+         , "Serve square tile warps padded by up to 2 pixels on each side "
+         "(normal maps, DEM grids) by cropping single shared 260x260 warp "
+         "of the tile.")
 
         ("resource-backend.type"
          , po::value(&resourceBackendConfig_.type)->required()
@@ -234,6 +792,65 @@ void Daemon::configuration(po::options_description &cmdline
          , po::value(&generatorsConfig_.purgeRemovedResources)
          ->default_value(generatorsConfig_.purgeRemovedResources)->required()
          , "Removed resources are purged from store if true. Use with care.")
+        ("resource-backend.prepareWorkers"
+         , po::value(&generatorsConfig_.prepareWorkers)
+         ->default_value(generatorsConfig_.prepareWorkers)->required()
+         , "Number of threads preparing resources (building tile indices "
+         "etc.). Resources needed by other resources are prepared first.")
+        ("resource-backend.lazy"
+         , po::value(&generatorsConfig_.lazy)
+         ->default_value(generatorsConfig_.lazy)->required()
+         , "Resources are loaded and prepared on first request if true. "
+         "Requests to resource being loaded are answered with 503.")
+        ("resource-backend.lazyIdleTimeout"
+         , po::value(&generatorsConfig_.lazyIdleTimeout)
+         ->default_value(generatorsConfig_.lazyIdleTimeout)->required()
+         , "Lazy mode: resources not accessed for this many seconds are "
+         "unloaded on next resource update. 0 means never.")
+
+        ("tileIndex.denseLods"
+         , po::value(&generatorsConfig_.denseTileIndexLods)
+         ->default_value(generatorsConfig_.denseTileIndexLods)->required()
+         , "Tile index lods below this one are held in dense per-tile "
+         "arrays answering queries without tree walk; costs about "
+         "4^denseLods / 3 bytes per tile index. 0 disables.")
+        ("tileIndex.advice"
+         , po::value(&generatorsConfig_.indexMapPolicy.advice)
+         ->default_value(generatorsConfig_.indexMapPolicy.advice)->required()
+         , "Access pattern hint (madvise) for mapped tile index files: "
+         "normal, random or willneed.")
+        ("tileIndex.prefault"
+         , po::value(&generatorsConfig_.indexMapPolicy.prefault)
+         ->default_value(generatorsConfig_.indexMapPolicy.prefault)
+         ->required()
+         , "Fault in whole tile index files at load instead of on first "
+         "tile request.")
+        ("tileIndex.copyLimit"
+         , po::value(&generatorsConfig_.indexMapPolicy.copyLimit)
+         ->default_value(generatorsConfig_.indexMapPolicy.copyLimit)
+         ->required()
+         , "Tile index files up to this size (bytes) are copied into "
+         "anonymous (hugepage backed when possible) memory instead of being "
+         "mapped. 0 disables.")
+        ("tileIndex.lockLimit"
+         , po::value(&generatorsConfig_.indexMapPolicy.lockLimit)
+         ->default_value(generatorsConfig_.indexMapPolicy.lockLimit)
+         ->required()
+         , "Tile index files up to this size (bytes) are locked in memory "
+         "(mlock, subject to RLIMIT_MEMLOCK). 0 disables.")
+
+        ("heightcode.batchWindow"
+         , po::value(&generatorsConfig_.heightcodeBatchWindow)
+         ->default_value(generatorsConfig_.heightcodeBatchWindow)
+         ->required()
+         , "Geodata tiles using the same DEMs requested within this time "
+         "(in ms) are heightcoded together in one GDAL worker job, against "
+         "DEMs cropped to their union. 0 disables batching.")
+        ("heightcode.batchSize"
+         , po::value(&generatorsConfig_.heightcodeBatchSize)
+         ->default_value(generatorsConfig_.heightcodeBatchSize)->required()
+         , "Maximum number of geodata tiles heightcoded in one GDAL worker "
+         "job.")
 
         ("vts.builtinBrowserUrl"
          , po::value(&variables_["VTS_BUILTIN_BROWSER_URL"])
@@ -286,6 +903,71 @@ void Daemon::configure(const po::variables_map &vars)
     }
 
     gdalWarperOptions_.tmpRoot = fs::absolute(gdalWarperOptions_.tmpRoot);
+    if (!gdalWarperOptions_.rangeCache.root.empty()) {
+        gdalWarperOptions_.rangeCache.root
+            = fs::absolute(gdalWarperOptions_.rangeCache.root);
+    }
+
+    if (coreOptions_.disk.path.empty()) {
+        coreOptions_.disk.path = generatorsConfig_.root / "responsecache";
+    }
+    if (gdalWarperOptions_.costFile.empty()) {
+        gdalWarperOptions_.costFile = generatorsConfig_.root / "warpcost";
+    }
+    gdalWarperOptions_.costFile = fs::absolute(gdalWarperOptions_.costFile);
+    coreOptions_.disk.path = fs::absolute(coreOptions_.disk.path);
+
+    if (!dumpImages_.empty()) {
+        dumpImages_ = fs::absolute(dumpImages_);
+        dumpImages(dumpImages_, dumpImagesLimit_);
+    }
+
+    compression::configure(compressionOptions_);
+
+    if (coreOptions_.profile.dir.empty()) {
+        coreOptions_.profile.dir = generatorsConfig_.root / "profile";
+    }
+    coreOptions_.profile.dir = fs::absolute(coreOptions_.profile.dir);
+    gdalWarperOptions_.profile = coreOptions_.profile;
+    gdalWarperOptions_.sharedCache = coreOptions_.shared;
+
+    if (!coreOptions_.cluster.membersFile.empty()) {
+        coreOptions_.cluster.membersFile
+            = fs::absolute(coreOptions_.cluster.membersFile);
+    }
+
+    if (gdalWarperOptions_.shmControlSize >= gdalWarperOptions_.shmSize) {
+        // control arena must leave some space for response data
+        throw po::validation_error
+            (po::validation_error::invalid_option_value
+             , "gdal.shm.controlSize");
+    }
+
+    if (gdalWarperOptions_.shmReserve
+        >= (gdalWarperOptions_.shmSize - gdalWarperOptions_.shmControlSize))
+    {
+        // reserve bigger than the data arena would reject every request
+        throw po::validation_error
+            (po::validation_error::invalid_option_value
+             , "gdal.shm.reserve");
+    }
+
+    if (gdalWarperOptions_.autoscale.max
+        && (gdalWarperOptions_.autoscale.min
+            > gdalWarperOptions_.autoscale.max))
+    {
+        throw po::validation_error
+            (po::validation_error::invalid_option_value
+             , "gdal.autoscale.min");
+    }
+
+    for (const auto &weight : { "tms", "surface", "geodata" }) {
+        const auto name(std::string("core.scheduler.weight.") + weight);
+        if (!vars[name].as<unsigned int>()) {
+            throw po::validation_error
+                (po::validation_error::invalid_option_value, name);
+        }
+    }
 
     {
         const auto &value(vars["resource-backend.freeze"].as<std::string>());
@@ -305,22 +987,239 @@ void Daemon::configure(const po::variables_map &vars)
         }
     }
 
+    {
+        const auto &value(vars["cluster.members"].as<std::string>());
+        std::vector<std::string> parts;
+        ba::split(parts, value, ba::is_any_of(", "), ba::token_compress_on);
+
+        coreOptions_.cluster.members.clear();
+        for (const auto &part : parts) {
+            if (!part.empty()) { coreOptions_.cluster.members.push_back(part); }
+        }
+    }
+
+    {
+        const auto &value(vars["core.deadline.byType"].as<std::string>());
+        std::vector<std::string> parts;
+        ba::split(parts, value, ba::is_any_of(", "), ba::token_compress_on);
+
+        coreOptions_.deadlines.clear();
+        for (const auto &part : parts) {
+            if (part.empty()) { continue; }
+            const auto eq(part.find('='));
+            if ((eq == std::string::npos) || !eq) {
+                throw po::validation_error
+                    (po::validation_error::invalid_option_value, value);
+            }
+            try {
+                coreOptions_.deadlines[part.substr(0, eq)]
+                    = boost::lexical_cast<unsigned int>(part.substr(eq + 1));
+            } catch (const boost::bad_lexical_cast&) {
+                throw po::validation_error
+                    (po::validation_error::invalid_option_value, value);
+            }
+        }
+    }
+
+    {
+        const auto &value
+            (vars["gdal.datasetConcurrency.byPrefix"].as<std::string>());
+        std::vector<std::string> parts;
+        ba::split(parts, value, ba::is_any_of(", "), ba::token_compress_on);
+
+        gdalWarperOptions_.datasetConcurrencyByPrefix.clear();
+        for (const auto &part : parts) {
+            if (part.empty()) { continue; }
+            const auto eq(part.rfind('='));
+            if ((eq == std::string::npos) || !eq) {
+                throw po::validation_error
+                    (po::validation_error::invalid_option_value, value);
+            }
+            try {
+                gdalWarperOptions_.datasetConcurrencyByPrefix
+                    [part.substr(0, eq)]
+                    = boost::lexical_cast<unsigned int>(part.substr(eq + 1));
+            } catch (const boost::bad_lexical_cast&) {
+                throw po::validation_error
+                    (po::validation_error::invalid_option_value, value);
+            }
+        }
+    }
+
+    if (vars.count("http.metrics.listen")) {
+        metricsListen_ = vars["http.metrics.listen"].as<utility::TcpEndpoint>();
+    }
+
     if (!vars.count("http.externalUrl")) {
         generatorsConfig_.externalUrl
             = utility::format("http://%s/"
                               , utility::TcpEndpointPrettyPrint(httpListen_));
     }
 
+    std::vector<std::string> deadlines;
+    for (const auto &item : coreOptions_.deadlines) {
+        deadlines.push_back(item.first + "=" + std::to_string(item.second));
+    }
+
+    std::vector<std::string> datasetConcurrency;
+    for (const auto &item : gdalWarperOptions_.datasetConcurrencyByPrefix) {
+        datasetConcurrency.push_back
+            (item.first + "=" + std::to_string(item.second));
+    }
+
     LOG(info3, log_)
         << "Config:"
         << "\n\tstore.path = " << generatorsConfig_.root
         << "\n\thttp.listen = " << httpListen_
         << "\n\thttp.threadCount = " << httpThreadCount_
+        << "\n\thttp.listenRetry = " << httpListenRetry_
+        << "\n\thttp.drainTimeout = " << httpDrainTimeout_
+        << "\n\thttp.metrics.listen = "
+        << (metricsListen_ ? boost::lexical_cast<std::string>(*metricsListen_)
+            : std::string("none"))
         << "\n\thttp.client.threadCount = " << httpClientThreadCount_
         << "\n\thttp.enableBrowser = " << std::boolalpha << httpEnableBrowser_
         << "\n\tcore.threadCount = " << coreThreadCount_
+        << "\n\tcore.cache.size = " << coreOptions_.cache.size
+        << "\n\tcore.cache.shards = " << coreOptions_.cache.shards
+        << "\n\tcore.cache.maxEntrySize = "
+        << coreOptions_.cache.maxEntrySize
+        << "\n\tcore.diskCache.size = " << coreOptions_.disk.size
+        << "\n\tcore.diskCache.path = " << coreOptions_.disk.path
+        << "\n\tcore.diskCache.queueLimit = "
+        << coreOptions_.disk.queueLimit
+        << "\n\tcore.admission.maxInFlight = "
+        << coreOptions_.admission.maxInFlight
+        << "\n\tcore.admission.maxInFlightPerResource = "
+        << coreOptions_.admission.maxInFlightPerResource
+        << "\n\tcore.admission.lowPriorityLimit = "
+        << coreOptions_.admission.lowPriorityLimit
+        << "\n\tcore.scheduler.maxRunningPerResource = "
+        << coreOptions_.scheduling.maxRunningPerResource
+        << "\n\tcore.scheduler.weight.tms = "
+        << coreOptions_.scheduling.tmsWeight
+        << "\n\tcore.scheduler.weight.surface = "
+        << coreOptions_.scheduling.surfaceWeight
+        << "\n\tcore.scheduler.weight.geodata = "
+        << coreOptions_.scheduling.geodataWeight
+        << "\n\tcore.prefetch.budget = " << coreOptions_.prefetch.budget
+        << "\n\tcore.prefetch.queueLimit = "
+        << coreOptions_.prefetch.queueLimit
+        << "\n\tcore.prefetch.trackLimit = "
+        << coreOptions_.prefetch.trackLimit
+        << "\n\tcore.seed.budget = " << coreOptions_.seedBudget
+        << "\n\tcore.warmup.onPrepare = " << coreOptions_.warmup.onPrepare
+        << "\n\tcore.warmup.lods = " << coreOptions_.warmup.lods
+        << "\n\tcore.debug.dumpImages = " << dumpImages_
+        << "\n\tcore.debug.dumpImagesLimit = " << dumpImagesLimit_
+        << "\n\tcore.compression.mesh = " << compressionOptions_.mesh
+        << "\n\tcore.compression.terrain = " << compressionOptions_.terrain
+        << "\n\tcore.compression.metatile = "
+        << compressionOptions_.metatile
+        << "\n\tcore.compression.geodata = " << compressionOptions_.geodata
+        << "\n\tcore.compression.document = "
+        << compressionOptions_.document
+        << "\n\tcore.coalesce = " << coreOptions_.coalesce
+        << "\n\tcore.deadline = " << coreOptions_.deadline
+        << "\n\tcore.deadline.byType = ["
+        << utility::join(deadlines, ",") << "]"
+        << "\n\tcore.trace.slowThreshold = "
+        << coreOptions_.traceSlowThreshold
+        << "\n\tprofile.threshold = " << coreOptions_.profile.threshold
+        << "\n\tprofile.dir = " << coreOptions_.profile.dir
+        << "\n\tprofile.samples = " << coreOptions_.profile.samples
+        << "\n\tprofile.interval = " << coreOptions_.profile.interval
+        << "\n\tprofile.maxFiles = " << coreOptions_.profile.maxFiles
+        << "\n\tcluster.self = " << coreOptions_.cluster.self
+        << "\n\tcluster.members = ["
+        << utility::join(coreOptions_.cluster.members, ",") << "]"
+        << "\n\tcluster.membersFile = " << coreOptions_.cluster.membersFile
+        << "\n\tcluster.replicas = " << coreOptions_.cluster.replicas
+        << "\n\tcluster.timeout = " << coreOptions_.cluster.timeout
+        << "\n\tcluster.failureLimit = "
+        << coreOptions_.cluster.failureLimit
+        << "\n\tcluster.backoff = " << coreOptions_.cluster.backoff
+        << "\n\tsharedCache.size = " << coreOptions_.shared.size
+        << "\n\tsharedCache.name = " << coreOptions_.shared.name
+        << "\n\tsharedCache.warpTtl = "
+        << gdalWarperOptions_.sharedCacheTtl
+        << "\n\tgdal.backend = " << gdalWarperOptions_.backend
         << "\n\tgdal.processCount = " << gdalWarperOptions_.processCount
+        << "\n\tgdal.autoscale.max = " << gdalWarperOptions_.autoscale.max
+        << "\n\tgdal.autoscale.min = " << gdalWarperOptions_.autoscale.min
+        << "\n\tgdal.autoscale.queueDepth = "
+        << gdalWarperOptions_.autoscale.queueDepth
+        << "\n\tgdal.autoscale.queueWait = "
+        << gdalWarperOptions_.autoscale.queueWait
+        << "\n\tgdal.autoscale.loadLimit = "
+        << gdalWarperOptions_.autoscale.loadLimit
+        << "\n\tgdal.autoscale.idle = " << gdalWarperOptions_.autoscale.idle
+        << "\n\tgdal.autoscale.cooldown = "
+        << gdalWarperOptions_.autoscale.cooldown
         << "\n\tgdal.tmpRoot = " << gdalWarperOptions_.tmpRoot
+        << "\n\tgdal.affinity = " << gdalWarperOptions_.affinity
+        << "\n\tgdal.affinity.stealDelay = "
+        << gdalWarperOptions_.affinityStealDelay
+        << "\n\tgdal.datasetCache.limit = "
+        << gdalWarperOptions_.datasetCacheLimit
+        << "\n\tgdal.datasetCache.memoryLimit = "
+        << gdalWarperOptions_.datasetCacheMemoryLimit
+        << "\n\tgdal.datasetCache.vectorLimit = "
+        << gdalWarperOptions_.vectorDatasetCacheLimit
+        << "\n\tgdal.coalesce = " << gdalWarperOptions_.coalesce
+        << "\n\tgdal.priority.weights = "
+        << gdalWarperOptions_.priorityWeights[0] << ','
+        << gdalWarperOptions_.priorityWeights[1] << ','
+        << gdalWarperOptions_.priorityWeights[2] << ','
+        << gdalWarperOptions_.priorityWeights[3]
+        << "\n\tgdal.queue.maxAge = " << gdalWarperOptions_.queueMaxAge
+        << "\n\tgdal.shm.size = " << gdalWarperOptions_.shmSize
+        << "\n\tgdal.shm.controlSize = " << gdalWarperOptions_.shmControlSize
+        << "\n\tgdal.shm.reserve = " << gdalWarperOptions_.shmReserve
+        << "\n\tgdal.shm.wait = " << gdalWarperOptions_.shmWait
+        << "\n\tgdal.shm.hugepages = " << gdalWarperOptions_.shmHugepages
+        << "\n\tgdal.shm.prefault = " << gdalWarperOptions_.shmPrefault
+        << "\n\tgdal.prewarm.datasets = "
+        << gdalWarperOptions_.prewarmDatasets
+        << "\n\tgdal.prewarm.budget = " << gdalWarperOptions_.prewarmBudget
+        << "\n\tgdal.recycle.graceful = " << gdalWarperOptions_.recycleGraceful
+        << "\n\tgdal.recycle.timeout = " << gdalWarperOptions_.recycleTimeout
+        << "\n\tgdal.recycle.requests = "
+        << gdalWarperOptions_.recycleRequests
+        << "\n\tgdal.cpuSets = " << gdalWarperOptions_.cpuSets
+        << "\n\tgdal.numaPinning = " << gdalWarperOptions_.numaPinning
+        << "\n\tgdal.threads = " << gdalWarperOptions_.gdalThreads
+        << "\n\tgdal.cacheMax = " << gdalWarperOptions_.gdalCacheMax
+        << "\n\tgdal.datasetBlockQuota = "
+        << gdalWarperOptions_.datasetBlockQuota
+        << "\n\tgdal.datasetConcurrency = "
+        << gdalWarperOptions_.datasetConcurrency
+        << "\n\tgdal.datasetConcurrency.byPrefix = ["
+        << utility::join(datasetConcurrency, ",") << "]"
+        << "\n\tgdal.rangeCache.path = "
+        << gdalWarperOptions_.rangeCache.root
+        << "\n\tgdal.rangeCache.size = "
+        << gdalWarperOptions_.rangeCache.size
+        << "\n\tgdal.rangeCache.blockSize = "
+        << gdalWarperOptions_.rangeCache.blockSize
+        << "\n\tgdal.rangeCache.readahead = "
+        << gdalWarperOptions_.rangeCache.readahead
+        << "\n\tgdal.rangeCache.headerSize = "
+        << gdalWarperOptions_.rangeCache.headerSize
+        << "\n\tgdal.rangeCache.revalidate = "
+        << gdalWarperOptions_.rangeCache.revalidate
+        << "\n\tgdal.uring.enable = " << gdalWarperOptions_.uring.enabled
+        << "\n\tgdal.uring.queueDepth = "
+        << gdalWarperOptions_.uring.queueDepth
+        << "\n\tgdal.uring.blockSize = "
+        << gdalWarperOptions_.uring.blockSize
+        << "\n\tgdal.uring.readahead = "
+        << gdalWarperOptions_.uring.readahead
+        << "\n\tgdal.split.threshold = "
+        << gdalWarperOptions_.splitThreshold
+        << "\n\tgdal.split.strips = " << gdalWarperOptions_.splitStrips
+        << "\n\tgdal.cost.path = " << gdalWarperOptions_.costFile
+        << "\n\tgdal.sharePadded = " << gdalWarperOptions_.sharePadded
         << "\n\tresource-backend.updatePeriod = "
         << generatorsConfig_.resourceUpdatePeriod
         << "\n\tresource-backend.root = "
@@ -330,6 +1229,26 @@ void Daemon::configure(const po::variables_map &vars)
         << "]\n"
         << "\n\tresource-backend.purgeRemoved = "
         << generatorsConfig_.purgeRemovedResources << '\n'
+        << "\tresource-backend.prepareWorkers = "
+        << generatorsConfig_.prepareWorkers << '\n'
+        << "\tresource-backend.lazy = "
+        << generatorsConfig_.lazy << '\n'
+        << "\tresource-backend.lazyIdleTimeout = "
+        << generatorsConfig_.lazyIdleTimeout << '\n'
+        << "\ttileIndex.denseLods = "
+        << generatorsConfig_.denseTileIndexLods << '\n'
+        << "\ttileIndex.advice = "
+        << generatorsConfig_.indexMapPolicy.advice << '\n'
+        << "\ttileIndex.prefault = "
+        << generatorsConfig_.indexMapPolicy.prefault << '\n'
+        << "\ttileIndex.copyLimit = "
+        << generatorsConfig_.indexMapPolicy.copyLimit << '\n'
+        << "\ttileIndex.lockLimit = "
+        << generatorsConfig_.indexMapPolicy.lockLimit << '\n'
+        << "\theightcode.batchWindow = "
+        << generatorsConfig_.heightcodeBatchWindow << '\n'
+        << "\theightcode.batchSize = "
+        << generatorsConfig_.heightcodeBatchSize << '\n'
         << "\thttp.externalUrl = " << generatorsConfig_.externalUrl << '\n'
         << utility::LManip([&](std::ostream &os) {
                 ResourceBackend::printConfig(os, "\t" + RBPrefixDotted
@@ -402,18 +1321,61 @@ service::Service::Cleanup Daemon::start()
     // starts core + generators
     core_ = boost::in_place(std::ref(*generators_), std::ref(*gdalWarper_)
                             , coreThreadCount_
-                            , std::ref(http_->fetcher()));
+                            , std::ref(http_->fetcher()), coreOptions_);
 
-    http_->listen(httpListen_, std::ref(*core_));
+    listen();
     http_->startServer(httpThreadCount_);
 
+    if (metricsListen_) {
+        // separate listener, scraping never waits for tile serving threads
+        metricsServer_ = boost::in_place([this](std::ostream &os)
+        {
+            metrics(os);
+        }, [this](std::ostream &os)
+        {
+            core_->inFlight(os);
+        });
+        metricsHttp_ = boost::in_place();
+        metricsHttp_->listen(*metricsListen_, std::ref(*metricsServer_));
+        metricsHttp_->startServer(1);
+    }
+
     return guard;
 }
 
+void Daemon::listen()
+{
+    const auto until(std::chrono::steady_clock::now()
+                     + std::chrono::milliseconds(httpListenRetry_));
+    for (;;) {
+        try {
+            http_->listen(httpListen_, std::ref(*core_));
+            return;
+        } catch (const std::exception &e) {
+            if (std::chrono::steady_clock::now() >= until) { throw; }
+            LOG(info2, log_) << "Cannot listen at " << httpListen_
+                             << " (" << e.what() << "), retrying.";
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+}
+
 void Daemon::cleanup()
 {
+    // let requests in progress finish while still listening; only the
+    // shared and on-disk response caches survive us, GDAL shared memory and
+    // the workers' dataset caches are rebuilt by the next instance
+    if (core_ && httpDrainTimeout_) {
+        if (!core_->drain(httpDrainTimeout_)) {
+            LOG(warn2, log_) << "Requests still in progress after "
+                             << httpDrainTimeout_ << " ms, stopping anyway.";
+        }
+    }
+
     // TODO: stop machinery
     // destroy, in reverse order
+    metricsHttp_ = boost::none;
+    metricsServer_ = boost::none;
     http_ = boost::none;
     core_ = boost::none;
     generators_.reset();
@@ -425,9 +1387,19 @@ void Daemon::cleanup()
 void Daemon::stat(std::ostream &os)
 {
     http_->stat(os);
+    core_->stat(os);
     gdalWarper_->stat(os);
 }
 
+void Daemon::metrics(std::ostream &os)
+{
+    metrics::Writer writer(os);
+    core_->metrics(writer);
+    gdalWarper_->metrics(writer);
+    generators_->metrics(writer, "mapproxy_generator_memory_");
+    writer.finish();
+}
+
 void Daemon::monitor(std::ostream &os)
 {
     (void) os;
@@ -496,6 +1468,10 @@ bool Daemon::ctrl(const CtrlCommand &cmd, std::ostream &os)
         }
         return true;
 
+    } else if (cmd.cmd == "convert-indices") {
+        os << generators_->convertIndices() << "\n";
+        return true;
+
     } else if (cmd.cmd == "supports-reference-frame") {
         sendBoolean(os, bool(vr::system.referenceFrames
                              (cmd.args[0], std::nothrow)));
@@ -532,6 +1508,115 @@ bool Daemon::ctrl(const CtrlCommand &cmd, std::ostream &os)
            << '\n';
         return true;
 
+    } else if (cmd.cmd == "seed") {
+        // rf type group id ext minLod maxLod [rate [llx lly urx ury]]
+        const auto &a(cmd.args);
+        if ((a.size() != 7) && (a.size() != 8) && (a.size() != 12)) {
+            os << "error: seed expects 7, 8 or 12 arguments\n";
+            return true;
+        }
+
+        try {
+            Seeder::Job job;
+            job.resourceId = Resource::Id(a[0], a[2], a[3]);
+            job.generatorType
+                = boost::lexical_cast<Resource::Generator::Type>(a[1]);
+            job.ext = a[4];
+            job.lodRange = vts::LodRange
+                (boost::lexical_cast<int>(a[5])
+                 , boost::lexical_cast<int>(a[6]));
+            job.budget = 0;
+            if (a.size() >= 8) { job.rate = boost::lexical_cast<double>(a[7]); }
+            if (a.size() == 12) {
+                job.tileRange = vts::TileRange
+                    (boost::lexical_cast<unsigned int>(a[8])
+                     , boost::lexical_cast<unsigned int>(a[9])
+                     , boost::lexical_cast<unsigned int>(a[10])
+                     , boost::lexical_cast<unsigned int>(a[11]));
+            }
+
+            os << core_->seed(job) << '\n';
+        } catch (const boost::bad_lexical_cast&) {
+            os << "error: invalid argument\n";
+        } catch (const std::exception &e) {
+            os << "error: " << e.what() << '\n';
+        }
+        return true;
+
+    } else if (cmd.cmd == "export") {
+        // rf type group id ext minLod maxLod archive [rate]
+        const auto &a(cmd.args);
+        if ((a.size() != 8) && (a.size() != 9)) {
+            os << "error: export expects 8 or 9 arguments\n";
+            return true;
+        }
+
+        try {
+            Seeder::Job job;
+            job.resourceId = Resource::Id(a[0], a[2], a[3]);
+            job.generatorType
+                = boost::lexical_cast<Resource::Generator::Type>(a[1]);
+            job.ext = a[4];
+            job.lodRange = vts::LodRange
+                (boost::lexical_cast<int>(a[5])
+                 , boost::lexical_cast<int>(a[6]));
+            job.archive = a[7];
+            job.budget = 0;
+            if (a.size() == 9) { job.rate = boost::lexical_cast<double>(a[8]); }
+
+            os << core_->seed(job) << '\n';
+        } catch (const boost::bad_lexical_cast&) {
+            os << "error: invalid argument\n";
+        } catch (const std::exception &e) {
+            os << "error: " << e.what() << '\n';
+        }
+        return true;
+
+    } else if (cmd.cmd == "seed-status") {
+        core_->seedStatus(os);
+        return true;
+
+    } else if (cmd.cmd == "seed-cancel") {
+        if (cmd.args.size() != 1) {
+            os << "error: seed-cancel expects 1 argument\n";
+            return true;
+        }
+
+        try {
+            sendBoolean(os, core_->cancelSeed
+                        (boost::lexical_cast<unsigned int>(cmd.args[0])));
+        } catch (const boost::bad_lexical_cast&) {
+            os << "error: argument is not a number\n";
+        }
+        return true;
+
+    } else if (cmd.cmd == "warm-resource") {
+        if (cmd.args.size() != 3) {
+            os << "error: warm-resource expects 3 arguments\n";
+            return true;
+        }
+
+        try {
+            os << core_->warm
+                (Resource::Id(cmd.args[0], cmd.args[1], cmd.args[2]))
+               << '\n';
+        } catch (const std::exception &e) {
+            os << "error: " << e.what() << '\n';
+        }
+        return true;
+
+    } else if (cmd.cmd == "resource-usage") {
+        core_->resourceUsage(os);
+        return true;
+
+    } else if (cmd.cmd == "resource-memory") {
+        generators_->memoryUsage(os);
+        return true;
+
+    } else if (cmd.cmd == "in-flight") {
+        core_->inFlight(os);
+        return true;
+
     } else if (cmd.cmd == "help") {
         os << "update-resources  schedule immediate update of resources;\n"
            << "                  returns timestamp (usec from Epoch)\n"
@@ -540,6 +1625,9 @@ bool Daemon::ctrl(const CtrlCommand &cmd, std::ostream &os)
            << "updated-since timestamp\n"
            << "                  check whether resources have been updated\n"
            << "                  since given timestamp (usec since Epoch)\n"
+           << "convert-indices   converts missing delivery indices of all\n"
+           << "                  resources in parallel; returns number of\n"
+           << "                  converted indices\n"
            << "has-resource referenceFrame group id\n"
            << "                  returns boolean (true/false) indicating\n"
            << "                  resource presence in the delivery table\n"
@@ -548,6 +1636,41 @@ bool Daemon::ctrl(const CtrlCommand &cmd, std::ostream &os)
            << "                  resource readiness\n"
            << "resource-url referenceFrame group id\n"
            << "                  returns local resource URL\n"
+           << "seed referenceFrame type group id ext minLod maxLod\n"
+           << "     [rate [llx lly urx ury]]\n"
+           << "                  generates tiles <lod>-<x>-<y>.<ext> listed\n"
+           << "                  in resource's delivery index into the\n"
+           << "                  persistent cache in the background, at\n"
+           << "                  most rate tiles per second (0 = no limit),\n"
+           << "                  optionally limited to tile range at\n"
+           << "                  minLod; resumes interrupted job; returns\n"
+           << "                  job id\n"
+           << "export referenceFrame type group id ext minLod maxLod\n"
+           << "     archive [rate]\n"
+           << "                  generates tiles <lod>-<x>-<y>.<ext> (or\n"
+           << "                  metatiles for ext meta) listed in\n"
+           << "                  resource's delivery index like seed does\n"
+           << "                  and writes them into a static PMTiles\n"
+           << "                  archive at given path once done; returns\n"
+           << "                  job id\n"
+           << "seed-status       prints state of seeding jobs\n"
+           << "seed-cancel jobId\n"
+           << "                  cancels seeding job (state is kept for\n"
+           << "                  resume)\n"
+           << "warm-resource referenceFrame group id\n"
+           << "                  prefaults resource's indices, opens its\n"
+           << "                  datasets in all GDAL workers and seeds its\n"
+           << "                  top lods (see core.warmup.lods); returns\n"
+           << "                  number of warmed generators\n"
+           << "resource-usage    prints per-resource totals: requests, cache\n"
+           << "                  hits, bytes sent, processing thread and\n"
+           << "                  GDAL worker CPU time (usec)\n"
+           << "resource-memory   prints per-resource memory footprint\n"
+           << "                  (resident/virtual bytes) by component\n"
+           << "in-flight         prints generator tasks and GDAL warper\n"
+           << "                  requests queued or running, with time\n"
+           << "                  spent in each state (ms), worker and\n"
+           << "                  abort state\n"
             ;
         return true;
 
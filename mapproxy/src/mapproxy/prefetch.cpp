@@ -0,0 +1,205 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <iterator>
+
+#include <boost/format.hpp>
+
+#include "prefetch.hpp"
+
+Prefetcher::Prefetcher(const Options &options)
+    : options_(options)
+    , generated_(0), hits_(0), wasted_(0), failed_(0), dropped_(0)
+{}
+
+void Prefetcher::requested(const FileInfo &fi)
+{
+    if (!enabled()) { return; }
+
+    vts::TileId tileId;
+    const auto *p(vts::parseTileIdPrefix(tileId, fi.filename));
+    if (!p) { return; }
+    const std::string ext(p);
+
+    // metatiles are cheap and requested ahead of their tiles anyway
+    if (ext.empty() || (ext == "meta")) { return; }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    const auto fprefetched(prefetchedIndex_.find(fi.url));
+    if (fprefetched != prefetchedIndex_.end()) {
+        ++hits_;
+        prefetched_.erase(fprefetched->second);
+        prefetchedIndex_.erase(fprefetched);
+    }
+
+    // client got here first
+    const auto fqueued(queued_.find(fi.url));
+    if (fqueued != queued_.end()) {
+        queue_.erase(fqueued->second);
+        queued_.erase(fqueued);
+    }
+
+    // neighbours first: they end up behind children in the queue
+    const auto size(std::uint64_t(1) << tileId.lod);
+    const auto neighbour([&](int dx, int dy)
+    {
+        const std::int64_t x(std::int64_t(tileId.x) + dx);
+        const std::int64_t y(std::int64_t(tileId.y) + dy);
+        if ((x < 0) || (y < 0) || (std::uint64_t(x) >= size)
+            || (std::uint64_t(y) >= size))
+        {
+            return;
+        }
+        suggest(fi, vts::TileId(tileId.lod, x, y), ext);
+    });
+    neighbour(-1, 0);
+    neighbour(1, 0);
+    neighbour(0, -1);
+    neighbour(0, 1);
+
+    for (const auto &child : vts::children(tileId)) {
+        suggest(fi, child, ext);
+    }
+}
+
+void Prefetcher::suggest(const FileInfo &fi, const vts::TileId &tileId
+                         , const std::string &ext)
+{
+    FileInfo sfi(fi);
+    sfi.filename = str(boost::format("%d-%d-%d.%s")
+                       % tileId.lod % tileId.x % tileId.y % ext);
+    sfi.path = fi.path.substr(0, fi.path.size() - fi.filename.size())
+        + sfi.filename;
+    sfi.url = fi.query.empty() ? sfi.path : (sfi.path + "?" + fi.query);
+    sfi.ifNoneMatch.clear();
+
+    // already generated or being generated
+    if (prefetchedIndex_.count(sfi.url) || inFlight_.count(sfi.url)) {
+        return;
+    }
+
+    const auto fqueued(queued_.find(sfi.url));
+    if (fqueued != queued_.end()) {
+        // hot again, move to front
+        queue_.splice(queue_.begin(), queue_, fqueued->second);
+        return;
+    }
+
+    queue_.push_front(sfi);
+    queued_.emplace(sfi.url, queue_.begin());
+
+    while (queue_.size() > options_.queueLimit) {
+        queued_.erase(queue_.back().url);
+        queue_.pop_back();
+        ++dropped_;
+    }
+}
+
+boost::optional<FileInfo> Prefetcher::next()
+{
+    if (!enabled()) { return boost::none; }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (queue_.empty() || (inFlight_.size() >= options_.budget)) {
+        return boost::none;
+    }
+
+    auto fi(queue_.front());
+    queued_.erase(fi.url);
+    queue_.pop_front();
+
+    inFlight_.insert(fi.url);
+    return fi;
+}
+
+void Prefetcher::done(const std::string &url, bool success)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    inFlight_.erase(url);
+
+    if (!success) {
+        ++failed_;
+        return;
+    }
+
+    ++generated_;
+    if (prefetchedIndex_.count(url)) { return; }
+    prefetched_.push_back(url);
+    prefetchedIndex_.emplace(url, std::prev(prefetched_.end()));
+
+    while (prefetched_.size() > options_.trackLimit) {
+        // prefetched but never asked for
+        prefetchedIndex_.erase(prefetched_.front());
+        prefetched_.pop_front();
+        ++wasted_;
+    }
+}
+
+void Prefetcher::cancel(const std::string &url)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    inFlight_.erase(url);
+}
+
+void Prefetcher::stat(std::ostream &os, const std::string &prefix) const
+{
+    std::size_t queued(0), inFlight(0), pending(0);
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        queued = queue_.size();
+        inFlight = inFlight_.size();
+        pending = prefetched_.size();
+    }
+
+    const std::uint64_t generated(generated_);
+    const std::uint64_t hits(hits_);
+
+    os << prefix << "generated=" << generated << '\n'
+       << prefix << "hits=" << hits << '\n'
+       << prefix << "hitRate="
+       << (generated ? (double(hits) / generated) : 0.0) << '\n'
+       << prefix << "wasted=" << wasted_ << '\n'
+       << prefix << "failed=" << failed_ << '\n'
+       << prefix << "dropped=" << dropped_ << '\n'
+       << prefix << "queued=" << queued << '\n'
+       << prefix << "inFlight=" << inFlight << '\n'
+       << prefix << "pending=" << pending << '\n';
+}
+
+void Prefetcher::metrics(metrics::Writer &writer
+                         , const std::string &prefix) const
+{
+    writer.counter(prefix + "generated", "Files generated speculatively."
+                   , generated_);
+    writer.counter(prefix + "hits", "Requests for prefetched files."
+                   , hits_);
+    writer.counter(prefix + "wasted", "Prefetched files forgotten without"
+                   " being requested.", wasted_);
+    writer.counter(prefix + "failed", "Failed prefetches.", failed_);
+    writer.counter(prefix + "dropped", "Prefetch suggestions dropped from"
+                   " full queue.", dropped_);
+}
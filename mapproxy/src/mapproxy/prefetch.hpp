@@ -0,0 +1,135 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef mapproxy_prefetch_hpp_included_
+#define mapproxy_prefetch_hpp_included_
+
+#include <list>
+#include <mutex>
+#include <atomic>
+#include <string>
+#include <ostream>
+#include <unordered_map>
+#include <unordered_set>
+
+#include <boost/optional.hpp>
+
+#include "support/metrics.hpp"
+
+#include "fileinfo.hpp"
+
+/** Predicts tiles likely to be requested next and hands them out for
+ *  speculative (background) generation.
+ *
+ *  Every requested tile suggests its 4 children and 4 neighbours. Suggested
+ *  tiles are queued, most recently (re)suggested first; the queue is bounded
+ *  and the stalest suggestions are forgotten first. Number of prefetches in
+ *  flight is limited by the budget.
+ *
+ *  Generated prefetches are remembered (bounded as well): a later request
+ *  for such a file is a hit, a prefetch forgotten without being requested
+ *  (or a failed one) is wasted work.
+ */
+class Prefetcher {
+public:
+    struct Options {
+        /** Maximum number of prefetches in flight (0 = prefetch disabled).
+         */
+        std::size_t budget;
+
+        /** Maximum number of queued suggestions.
+         */
+        std::size_t queueLimit;
+
+        /** Maximum number of remembered prefetched files.
+         */
+        std::size_t trackLimit;
+
+        Options() : budget(0), queueLimit(1024), trackLimit(8192) {}
+    };
+
+    Prefetcher(const Options &options);
+
+    bool enabled() const { return options_.budget; }
+
+    /** Notes file requested by a client: counts hit and queues its
+     *  surroundings.
+     */
+    void requested(const FileInfo &fi);
+
+    /** Returns next file to prefetch (and reserves budget for it) or nothing
+     *  if the queue is empty or the budget exhausted.
+     */
+    boost::optional<FileInfo> next();
+
+    /** Prefetch of file returned by next() has finished.
+     */
+    void done(const std::string &url, bool success);
+
+    /** File returned by next() is not going to be prefetched after all
+     *  (e.g. it is already cached).
+     */
+    void cancel(const std::string &url);
+
+    void stat(std::ostream &os, const std::string &prefix) const;
+
+    /** Writes lock-free counters, metric names start with given prefix.
+     */
+    void metrics(metrics::Writer &writer, const std::string &prefix) const;
+
+private:
+    void suggest(const FileInfo &fi, const vts::TileId &tileId
+                 , const std::string &ext);
+
+    typedef std::list<FileInfo> Queue;
+
+    const Options options_;
+
+    mutable std::mutex mutex_;
+
+    /** Suggestions, most recent first, indexed by URL.
+     */
+    Queue queue_;
+    std::unordered_map<std::string, Queue::iterator> queued_;
+
+    /** Prefetched files not requested yet, oldest first, indexed by URL.
+     */
+    std::list<std::string> prefetched_;
+    std::unordered_map<std::string, std::list<std::string>::iterator>
+        prefetchedIndex_;
+
+    /** Prefetches in flight.
+     */
+    std::unordered_set<std::string> inFlight_;
+
+    std::atomic<std::uint64_t> generated_;
+    std::atomic<std::uint64_t> hits_;
+    std::atomic<std::uint64_t> wasted_;
+    std::atomic<std::uint64_t> failed_;
+    std::atomic<std::uint64_t> dropped_;
+};
+
+#endif // mapproxy_prefetch_hpp_included_
@@ -207,7 +207,8 @@ Resource::list parseResource(const Json::Value &value
 void parseResources(Resource::map &resources, const Json::Value &value
                     , ResourceLoadErrorCallback error
                     , const FileClassSettings &fileClassSettings
-                    , const fs::path &path)
+                    , const fs::path &path
+                    , std::vector<fs::path> *includes = nullptr)
 {
     // TODO: use error callback
     const auto dir(path.parent_path());
@@ -254,6 +255,12 @@ void parseResources(Resource::map &resources, const Json::Value &value
     {
         const auto includePath(fs::absolute(value, dir));
 
+        if (includes) {
+            // shallow load: just remember the pattern
+            includes->push_back(includePath);
+            return;
+        }
+
         try {
             for (const auto &path : utility::globPath(includePath)) {
                 // ignore directories
@@ -333,12 +340,14 @@ void parseResources(Resource::map &resources, const Json::Value &value
 
 Resource::map loadResources(const Json::Value &config, const fs::path &path
                             , ResourceLoadErrorCallback error
-                            , const FileClassSettings &fileClassSettings)
+                            , const FileClassSettings &fileClassSettings
+                            , std::vector<fs::path> *includes = nullptr)
 {
     Resource::map resources;
 
     try {
-        parseResources(resources, config, error, fileClassSettings, path);
+        parseResources(resources, config, error, fileClassSettings, path
+                       , includes);
     } catch (const Json::Error &e) {
         LOGTHROW(err1, FormatError)
             << "Invalid resource config file " << path
@@ -457,6 +466,28 @@ Resource::map loadResources(const Json::Value &json
     return detail::loadResources(json, path, error, fileClassSettings);
 }
 
+Resource::map loadResourcesShallow(const boost::filesystem::path &path
+                                   , std::vector<boost::filesystem::path>
+                                   &includes
+                                   , const FileClassSettings
+                                   &fileClassSettings)
+{
+    std::ifstream f;
+    f.exceptions(std::ios::badbit | std::ios::failbit);
+
+    try {
+        f.open(path.string(), std::ios_base::in);
+    } catch (const std::exception &e) {
+        LOGTHROW(err1, IOError)
+            << "Unable to load resources " << path
+            << ": <" << e.what() << ">.";
+    }
+
+    return detail::loadResources(Json::read<FormatError>(f, path, "resources")
+                                 , path, ResourceLoadErrorCallback()
+                                 , fileClassSettings, &includes);
+}
+
 Resource::list loadResource(const boost::filesystem::path &path
                             , const FileClassSettings &fileClassSettings)
 {
@@ -540,21 +571,25 @@ Changed Resource::changed(const Resource &o) const
     // check definition, it must check mandatory stuff first, save stuff
     // second
     auto def(definition_->changed(*o.definition()));
-    if (def != Changed::no) { return def; }
+    if ((def != Changed::no) && (def != Changed::metadata)) { return def; }
 
     // forced revision change
     if (o.revision != revision) {
         return Changed::safely;
     }
 
-    // from here down only safely-changed stuff can follow
+    // from here down only metadata can follow
 
-    if (changedCredits) { return Changed::safely; }
+    if (changedCredits) { return Changed::metadata; }
 
-    if (registry != o.registry) { return Changed::safely; }
+    if (registry != o.registry) { return Changed::metadata; }
+
+    if (fileClassSettings != o.fileClassSettings) {
+        return Changed::metadata;
+    }
 
-    // not changed at all
-    return Changed::no;
+    // not changed at all or metadata in definition
+    return def;
 }
 
 boost::filesystem::path prependRoot(const boost::filesystem::path &path
@@ -643,6 +678,9 @@ std::string contentType(RasterFormat format)
     case RasterFormat::jpg: return "image/jpeg";
     case RasterFormat::png: return "image/png";
     case RasterFormat::webp: return "image/webp";
+    case RasterFormat::ktx2: return "image/ktx2";
+    case RasterFormat::avif: return "image/avif";
+    case RasterFormat::jxl: return "image/jxl";
     }
     return {};
 }
@@ -49,7 +49,11 @@
 // fwd
 namespace Json { class Value; }
 
-enum class Changed { yes, no, safely, withRevisionBump };
+/** Result of resource comparison. Metadata (presentation-only change:
+ *  credits, registry, max-age, introspection) can be applied to the running
+ *  generator in place (see Generator::updateMetadata).
+ */
+enum class Changed { yes, no, safely, withRevisionBump, metadata };
 
 // fwd
 class DefinitionBase;
@@ -279,6 +283,9 @@ UTILITY_GENERATE_ENUM(RasterFormat,
     ((jpg))
     ((png))
     ((webp))
+    ((ktx2))
+    ((avif))
+    ((jxl))
 )
 
 UTILITY_GENERATE_ENUM_IO(GeneratorInterface::Interface,
@@ -368,6 +375,16 @@ Resource::map loadResources(const Json::Value &json
                             , const FileClassSettings &fileClassSettings
                             = FileClassSettings());
 
+/** Load resources defined directly in file at given path. Included files are
+ *  not loaded, their (absolute) glob patterns are appended to includes
+ *  instead.
+ */
+Resource::map loadResourcesShallow(const boost::filesystem::path &path
+                                   , std::vector<boost::filesystem::path>
+                                   &includes
+                                   , const FileClassSettings &fileClassSettings
+                                   = FileClassSettings());
+
 /** Load single resource from given path.
  */
 Resource::list loadResource(const boost::filesystem::path &path
@@ -27,6 +27,7 @@
 #ifndef mapproxy_resourcebackend_hpp_included_
 #define mapproxy_resourcebackend_hpp_included_
 
+#include <set>
 #include <memory>
 #include <string>
 #include <iostream>
@@ -48,6 +49,39 @@ public:
 
     Resource::map load() const;
 
+    /** Revision of loaded resource set. Zero means nothing loaded yet.
+     */
+    typedef std::uint64_t Revision;
+
+    /** Result of incremental load.
+     */
+    struct Update {
+        /** Revision of resource set.
+         */
+        Revision revision;
+
+        /** False if resource set has not changed since revision passed to
+         *  load(). Resources are not loaded in that case.
+         */
+        bool changed;
+
+        /** Complete resource set.
+         */
+        Resource::map resources;
+
+        /** Resources known to be unchanged since revision passed to load();
+         *  there is no need to diff them against served ones.
+         */
+        std::set<Resource::Id> unchanged;
+
+        Update() : revision(), changed(true) {}
+    };
+
+    /** Incremental load: reloads only what has changed since given revision
+     *  (if supported by backend).
+     */
+    Update load(Revision since) const;
+
     void error(const Resource::Id &resourceId, const std::string &message)
         const;
 
@@ -109,6 +143,11 @@ protected:
 
     virtual Resource::map load_impl() const = 0;
 
+    /** Incremental load. Default implementation does a full load and
+     *  reports everything as changed.
+     */
+    virtual Update loadSince_impl(Revision since) const;
+
     virtual void error_impl(const Resource::Id&, const std::string&) const {}
 
     GenericConfig genericConfig_;
@@ -119,6 +158,11 @@ inline Resource::map ResourceBackend::load() const
     return load_impl();
 }
 
+inline ResourceBackend::Update ResourceBackend::load(Revision since) const
+{
+    return loadSince_impl(since);
+}
+
 inline void ResourceBackend::error(const Resource::Id &resourceId
                                    , const std::string &message) const
 {
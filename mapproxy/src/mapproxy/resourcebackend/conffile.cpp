@@ -24,9 +24,18 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <sys/stat.h>
+
+#include <cerrno>
+#include <cstring>
+#include <functional>
+
+#include <boost/filesystem.hpp>
+
 #include "dbglog/dbglog.hpp"
 
 #include "utility/premain.hpp"
+#include "utility/glob.hpp"
 #include "service/program.hpp"
 
 #include "../error.hpp"
@@ -87,6 +96,7 @@ utility::PreMain Factory::register_([]()
 Conffile::Conffile(const GenericConfig &genericConfig
                    , const Config &config)
     : ResourceBackend(genericConfig), config_(config)
+    , revision_(), rescan_(true)
 {
     // try to load config file now
     load_impl();
@@ -97,4 +107,161 @@ Resource::map Conffile::load_impl() const
     return loadResources(config_.path, {}, genericConfig_.fileClassSettings);
 }
 
+namespace {
+
+std::vector<std::uint64_t> fileStat(const fs::path &path)
+{
+    struct ::stat st;
+    if (::stat(path.c_str(), &st) == -1) {
+        LOGTHROW(err1, IOError)
+            << "Unable to stat resource file " << path
+            << ": <" << std::strerror(errno) << ">.";
+    }
+
+    return { std::uint64_t(st.st_dev), std::uint64_t(st.st_ino)
+            , std::uint64_t(st.st_size), std::uint64_t(st.st_mtim.tv_sec)
+            , std::uint64_t(st.st_mtim.tv_nsec) };
+}
+
+bool hasWildcard(const fs::path &path)
+{
+    return path.string().find_first_of("*?[") != std::string::npos;
+}
+
+} // namespace
+
+bool Conffile::scan() const
+{
+    const auto next(revision_ + 1);
+
+    Files files;
+    bool modified(false);
+
+    const auto watchFile([&](const fs::path &path)
+    {
+        watch_.watch(path.parent_path());
+
+        // configuration may be symlinked from elsewhere
+        boost::system::error_code ec;
+        const auto real(fs::canonical(path, ec));
+        if (!ec && (real != path)) { watch_.watch(real.parent_path()); }
+    });
+
+    std::function<void(const fs::path&)> visit([&](const fs::path &path)
+    {
+        // already seen (or an include cycle)
+        if (files.count(path)) { return; }
+
+        auto stat(fileStat(path));
+        auto &file(files[path]);
+
+        auto ffiles(files_.find(path));
+        if ((ffiles != files_.end()) && (ffiles->second.stat == stat)) {
+            // unchanged, reuse
+            file = ffiles->second;
+        } else {
+            LOG(info2) << "Loading resources from file " << path << ".";
+            file.resources = loadResourcesShallow
+                (path, file.includes, genericConfig_.fileClassSettings);
+            file.stat = stat;
+            file.revision = next;
+            modified = true;
+        }
+
+        watchFile(path);
+
+        for (const auto &include : file.includes) {
+            // new files matching pattern appear in its directory
+            const auto dir(include.parent_path());
+            if (hasWildcard(dir)) {
+                watch_.giveUp();
+            } else {
+                watch_.watch(dir);
+            }
+
+            const auto expanded([&]()
+            {
+                try {
+                    return utility::globPath(include);
+                } catch (const std::exception &e) {
+                    LOGTHROW(err3, std::runtime_error)
+                        << "Failed to include file(s) from " << path
+                        << ": " << e.what() << ".";
+                }
+                throw;
+            }());
+
+            for (const auto &ipath : expanded) {
+                // ignore directories
+                if (ipath.filename() == ".") { continue; }
+                visit(ipath);
+            }
+        }
+    });
+
+    visit(config_.path);
+
+    // removed files
+    for (const auto &item : files_) {
+        if (!files.count(item.first)) { modified = true; }
+    }
+
+    if (!modified) { return false; }
+
+    // merge
+    Resource::map resources;
+    for (const auto &item : files) {
+        for (const auto &res : item.second.resources) {
+            if (!resources.insert(res).second) {
+                LOGTHROW(err1, FormatError)
+                    << "Duplicate entry for <" << res.first << ">.";
+            }
+        }
+    }
+
+    files_.swap(files);
+    resources_.swap(resources);
+    revision_ = next;
+    return true;
+}
+
+ResourceBackend::Update Conffile::loadSince_impl(Revision since) const
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    // drain events first, changes done while scanning show up next time
+    const bool dirty(watch_.changed() || rescan_);
+
+    Update update;
+    if (dirty) {
+        // failed scan is retried next time regardless of any events
+        rescan_ = true;
+        scan();
+        rescan_ = false;
+    }
+
+    update.revision = revision_;
+    if (since && (since == revision_)) {
+        update.changed = false;
+        return update;
+    }
+
+    update.resources = resources_;
+
+    if (since) {
+        for (const auto &item : files_) {
+            if (item.second.revision > since) { continue; }
+            for (const auto &res : item.second.resources) {
+                update.unchanged.insert(res.first);
+            }
+        }
+    }
+
+    LOG(info1) << "Resources at revision " << revision_ << ", "
+               << update.unchanged.size() << " of "
+               << update.resources.size() << " unchanged.";
+
+    return update;
+}
+
 } // namespace resource_backend
@@ -27,9 +27,14 @@
 #ifndef mapproxy_resourcebackend_conffile_hpp_included_
 #define mapproxy_resourcebackend_conffile_hpp_included_
 
+#include <map>
+#include <mutex>
+#include <vector>
+
 #include <boost/filesystem/path.hpp>
 
 #include "../resourcebackend.hpp"
+#include "../support/filewatch.hpp"
 
 namespace resource_backend {
 
@@ -45,7 +50,45 @@ public:
 private:
     virtual Resource::map load_impl() const;
 
+    virtual Update loadSince_impl(Revision since) const;
+
+    /** Rescans all configuration files, reparses changed ones. Returns true
+     *  if resource set has changed.
+     */
+    bool scan() const;
+
+    /** Parsed configuration file.
+     */
+    struct File {
+        /** File identity (device, inode, size, mtime)
+         */
+        std::vector<std::uint64_t> stat;
+
+        /** Revision when this file was parsed.
+         */
+        Revision revision;
+
+        /** Resources defined directly in this file.
+         */
+        Resource::map resources;
+
+        /** Include patterns.
+         */
+        std::vector<boost::filesystem::path> includes;
+
+        File() : revision() {}
+    };
+
+    typedef std::map<boost::filesystem::path, File> Files;
+
     const Config config_;
+
+    mutable std::mutex mutex_;
+    mutable FileWatch watch_;
+    mutable Files files_;
+    mutable Resource::map resources_;
+    mutable Revision revision_;
+    mutable bool rescan_;
 };
 
 } // namespace resource_backend
@@ -24,12 +24,29 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
-#include <thread>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/prctl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <signal.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <cstdint>
+#include <sstream>
+#include <system_error>
+
+#include <boost/python.hpp>
+#include <boost/python/stl_iterator.hpp>
 
 #include "dbglog/dbglog.hpp"
 
 #include "utility/premain.hpp"
 
+#include "jsoncpp/io.hpp"
+
 #include "pydbglog/dbglogmodule.hpp"
 #include "pysupport/import.hpp"
 #include "pysupport/formatexception.hpp"
@@ -47,22 +64,10 @@ namespace resource_backend {
 
 namespace {
 
-std::once_flag onceFlag;
-
-
 struct Factory : ResourceBackend::Factory {
     virtual ResourceBackend::pointer create(const GenericConfig &genericConfig
                                             , const TypedConfig &config)
     {
-        std::call_once(onceFlag, [&]()
-        {
-            // Initialize python interpreter
-            ::Py_Initialize();
-
-            // make sure dbglog is ready
-            dbglog::py::import();
-        });
-
         return std::make_shared<Python>
             (genericConfig, config.value<Python::Config>());
     }
@@ -81,6 +86,17 @@ struct Factory : ResourceBackend::Factory {
             ((prefix + "script").c_str()
              , po::value(&config.script)->required()
              , "Path pythong script. It must privide global function run().")
+            ((prefix + "timeout").c_str()
+             , po::value(&config.timeout)
+             ->default_value(config.timeout)->required()
+             , "Maximum time (in ms) to wait for an answer from the helper "
+             "process running the script. Helper is restarted when it does "
+             "not answer in time.")
+            ((prefix + "restartDelay").c_str()
+             , po::value(&config.restartDelay)
+             ->default_value(config.restartDelay)->required()
+             , "Delay (in ms) before restart of failed helper process. "
+             "Doubled with each consecutive failure.")
             ;
 
         const auto optPrefix(prefix + "option");
@@ -131,6 +147,8 @@ struct Factory : ResourceBackend::Factory {
         const auto &config(typedConfig.value<Python::Config>());
 
         os << prefix << "script = " << config.script << "\n";
+        os << prefix << "timeout = " << config.timeout << "\n";
+        os << prefix << "restartDelay = " << config.restartDelay << "\n";
 
         for (const auto &option : config.options) {
             os << prefix << "option." << option.first << " = "
@@ -147,51 +165,510 @@ utility::PreMain Factory::register_([]()
     ResourceBackend::registerType("python", std::make_shared<Factory>());
 });
 
+/** Helper process is unusable (timeout, I/O error, premature exit).
+ */
+struct HelperFailure : std::runtime_error {
+    HelperFailure(const std::string &message) : std::runtime_error(message) {}
+};
+
+typedef std::chrono::steady_clock Clock;
+
+/** Waits for given poll event, no deadline means wait forever.
+ */
+void waitFor(int fd, short events, const Clock::time_point *deadline)
+{
+    if (!deadline) { return; }
+
+    for (;;) {
+        const auto remaining
+            (std::chrono::duration_cast<std::chrono::milliseconds>
+             (*deadline - Clock::now()).count());
+        if (remaining <= 0) { throw HelperFailure("timed out"); }
+
+        ::pollfd pfd;
+        pfd.fd = fd;
+        pfd.events = events;
+        pfd.revents = 0;
+
+        const auto res(::poll(&pfd, 1, int(remaining)));
+        if (res < 0) {
+            if (errno == EINTR) { continue; }
+            throw HelperFailure(std::string("poll failed: ")
+                                + std::strerror(errno));
+        }
+        if (res) { return; }
+    }
+}
+
+void writeAll(int fd, const char *data, std::size_t size
+              , const Clock::time_point *deadline)
+{
+    while (size) {
+        waitFor(fd, POLLOUT, deadline);
+        const auto res(::send(fd, data, size, MSG_NOSIGNAL));
+        if (res < 0) {
+            if (errno == EINTR) { continue; }
+            throw HelperFailure(std::string("send failed: ")
+                                + std::strerror(errno));
+        }
+        data += res;
+        size -= res;
+    }
+}
+
+/** Returns false on EOF before first byte.
+ */
+bool readAll(int fd, char *data, std::size_t size
+             , const Clock::time_point *deadline)
+{
+    const auto total(size);
+    while (size) {
+        waitFor(fd, POLLIN, deadline);
+        const auto res(::recv(fd, data, size, 0));
+        if (res < 0) {
+            if (errno == EINTR) { continue; }
+            throw HelperFailure(std::string("recv failed: ")
+                                + std::strerror(errno));
+        }
+        if (!res) {
+            if (size == total) { return false; }
+            throw HelperFailure("truncated message");
+        }
+        data += res;
+        size -= res;
+    }
+    return true;
+}
+
+/** Messages are JSON documents prefixed by their length (32 bit, host
+ *  order: both ends live on the same machine).
+ */
+constexpr std::uint32_t MaxMessageSize(1u << 30);
+
+void sendMessage(int fd, const Json::Value &message
+                 , const Clock::time_point *deadline = nullptr)
+{
+    std::ostringstream os;
+    os.precision(15);
+    Json::write(os, message);
+    const auto data(os.str());
+
+    if (data.size() > MaxMessageSize) {
+        throw HelperFailure("message too long");
+    }
+
+    const std::uint32_t size(data.size());
+    writeAll(fd, reinterpret_cast<const char*>(&size), sizeof(size)
+             , deadline);
+    writeAll(fd, data.data(), data.size(), deadline);
+}
+
+bool receiveMessage(int fd, Json::Value &message
+                    , const Clock::time_point *deadline = nullptr)
+{
+    std::uint32_t size;
+    if (!readAll(fd, reinterpret_cast<char*>(&size), sizeof(size)
+                 , deadline))
+    {
+        return false;
+    }
+    if (size > MaxMessageSize) { throw HelperFailure("message too long"); }
+
+    std::string data(size, '\0');
+    if (size && !readAll(fd, &data[0], size, deadline)) {
+        throw HelperFailure("truncated message");
+    }
+
+    try {
+        std::istringstream is(data);
+        message = Json::read<FormatError>(is, "python helper", "message");
+    } catch (const FormatError &e) {
+        throw HelperFailure(e.what());
+    }
+    return true;
+}
+
+Json::Value command(const std::string &name)
+{
+    Json::Value request(Json::objectValue);
+    request["command"] = name;
+    return request;
+}
+
+/** Diff key of resource definition: group/id (ordinal appended when
+ *  not unique or when missing).
+ */
+std::string definitionKey(const Json::Value &definition, std::size_t index
+                          , const std::map<std::string, Json::Value> &seen)
+{
+    std::string key;
+    if (definition.isObject() && definition["group"].isString()
+        && definition["id"].isString())
+    {
+        key = definition["group"].asString() + "/"
+            + definition["id"].asString();
+        if (!seen.count(key)) { return key; }
+    }
+    return key + "#" + std::to_string(index);
+}
+
+/** Helper process main loop. Runs the script and answers daemon's requests
+ *  until the socket is closed.
+ */
+void serve(int fd, const Python::Config &config)
+{
+    // do not outlive the daemon
+    ::prctl(PR_SET_PDEATHSIG, SIGKILL);
+    ::signal(SIGPIPE, SIG_IGN);
+
+    ::Py_Initialize();
+    dbglog::py::import();
+
+    python::object run;
+    python::object error;
+    python::object revision;
+
+    {
+        Json::Value hello(Json::objectValue);
+        try {
+            python::dict options;
+            for (const auto &option : config.options) {
+                options[option.first] = option.second;
+            }
+
+            run = pysupport::import(config.script)
+                .attr("resource_backend")(options);
+            if (PyObject_HasAttrString(run.ptr(), "error")) {
+                error = run.attr("error");
+            }
+            if (PyObject_HasAttrString(run.ptr(), "revision")) {
+                revision = run.attr("revision");
+            }
+        } catch (const python::error_already_set&) {
+            hello["error"] = pysupport::formatCurrentException();
+        }
+
+        sendMessage(fd, hello);
+        if (hello.isMember("error")) { return; }
+    }
+
+    // definitions already known to the daemon
+    std::map<std::string, Json::Value> sent;
+
+    Json::Value request;
+    while (receiveMessage(fd, request)) {
+        Json::Value reply(Json::objectValue);
+
+        try {
+            const auto name(request["command"].asString());
+            if (name == "load") {
+                if (request["full"].asBool()) { sent.clear(); }
+
+                const auto list(pysupport::asJson(python::list(run())));
+                if (!list.isArray()) {
+                    throw std::runtime_error("run() must return a list");
+                }
+
+                std::map<std::string, Json::Value> current;
+                auto &upsert(reply["upsert"] = Json::arrayValue);
+                auto &remove(reply["remove"] = Json::arrayValue);
+
+                for (Json::ArrayIndex i(0), e(list.size()); i != e; ++i) {
+                    const auto &definition(list[i]);
+                    const auto key(definitionKey(definition, i, current));
+                    current[key] = definition;
+
+                    auto fsent(sent.find(key));
+                    if ((fsent != sent.end())
+                        && (fsent->second == definition))
+                    {
+                        continue;
+                    }
+
+                    auto &item(upsert.append(Json::objectValue));
+                    item["key"] = key;
+                    item["definition"] = definition;
+                }
+
+                for (const auto &item : sent) {
+                    if (!current.count(item.first)) {
+                        remove.append(item.first);
+                    }
+                }
+
+                sent.swap(current);
+            } else if (name == "revision") {
+                if (revision) {
+                    reply["token"] = std::string
+                        (python::extract<std::string>
+                         (python::str(revision())));
+                } else {
+                    reply["token"] = Json::nullValue;
+                }
+            } else if (name == "error") {
+                if (error) {
+                    error(request["referenceFrame"].asString()
+                          , request["group"].asString()
+                          , request["id"].asString()
+                          , request["message"].asString());
+                }
+            } else {
+                throw std::runtime_error("unknown command <" + name + ">");
+            }
+        } catch (const python::error_already_set&) {
+            reply = Json::objectValue;
+            reply["error"] = pysupport::formatCurrentException();
+        } catch (const std::exception &e) {
+            reply = Json::objectValue;
+            reply["error"] = e.what();
+        }
+
+        sendMessage(fd, reply);
+    }
+}
+
 } // namespace
 
 Python::Python(const GenericConfig &genericConfig, const Config &config)
     : ResourceBackend(genericConfig)
-    , script_(config.script)
-    , run_(), error_()
+    , config_(config), fd_(-1), failures_(), resync_(true)
+    , lastRevision_()
 {
+    // broken script is reported right away
     try {
-        python::dict options;
-        for (const auto &option : config.options) {
-            options[option.first] = option.second;
-        }
+        spawn();
+    } catch (const HelperFailure &e) {
+        LOGTHROW(err2, Error)
+            << "Run importing python script from " << config_.script << ": "
+            << e.what();
+    }
+}
+
+Python::~Python()
+{
+    shutdown();
+}
+
+void Python::spawn() const
+{
+    int fds[2];
+    if (::socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) == -1) {
+        std::system_error e(errno, std::system_category());
+        LOG(err3) << "socketpair() failed: <" << e.code() << ", "
+                  << e.what() << ">.";
+        throw e;
+    }
+
+    const auto config(config_);
+    helper_ = Process(Process::Flags().quickExit(true)
+                      , [fds, config]()
+    {
+        ::close(fds[0]);
+        serve(fds[1], config);
+    });
 
-        run_ = pysupport::import(script_)
-            .attr("resource_backend")(options);
-        if (PyObject_HasAttrString(run_.ptr(), "error")) {
-            error_ = run_.attr("error");
+    ::close(fds[1]);
+    fd_ = fds[0];
+
+    // fresh helper knows nothing about what we have
+    resync_ = true;
+
+    LOG(info3) << "Started python resource backend helper (pid "
+               << helper_.id() << ") running " << config_.script << ".";
+
+    const auto deadline
+        (Clock::now() + std::chrono::milliseconds(config_.timeout));
+
+    try {
+        Json::Value hello;
+        if (!receiveMessage(fd_, hello, &deadline)) {
+            throw HelperFailure("helper exited");
         }
-    } catch (const python::error_already_set&) {
-        LOGTHROW(err2, Error)
-            << "Run importing python script from " << script_ << ": "
-            << pysupport::formatCurrentException();
+        if (hello.isMember("error")) {
+            throw HelperFailure(hello["error"].asString());
+        }
+    } catch (...) {
+        shutdown();
+        throw;
     }
 }
 
-Resource::map Python::load_impl() const
+void Python::shutdown() const
 {
-    std::unique_lock<decltype(mutex_)> lock(mutex_);
+    if (fd_ >= 0) {
+        // helper exits on EOF
+        ::close(fd_);
+        fd_ = -1;
+    }
+
+    if (!helper_.joinable()) { return; }
+
+    try {
+        helper_.kill();
+    } catch (const std::system_error&) {}
+
+    try {
+        helper_.join();
+    } catch (const std::system_error&) {}
+}
+
+Json::Value Python::call(const Json::Value &request) const
+{
+    const auto now(Clock::now());
+
     try {
-        LOG(info4) << "Loading resources";
-        loadResources(pysupport::asJson(python::list(run_()))
-                      , script_
-                      , [this](const Resource::Id &id
-                               , const std::string &error)
-                      { error_impl(id, error); }
-                      , genericConfig_.fileClassSettings);
-    } catch (const python::error_already_set&) {
-        python::handle_exception();
+        if (!helper_.joinable()) {
+            if (now < restartAfter_) {
+                LOGTHROW(err2, Error)
+                    << "Python resource backend helper is not running, "
+                    "restart pending.";
+            }
+            spawn();
+        }
+
+        const auto deadline
+            (Clock::now() + std::chrono::milliseconds(config_.timeout));
+
+        sendMessage(fd_, request, &deadline);
+
+        Json::Value reply;
+        if (!receiveMessage(fd_, reply, &deadline)) {
+            throw HelperFailure("helper exited");
+        }
+        failures_ = 0;
+
+        if (reply.isMember("error")) {
+            LOGTHROW(err3, Error)
+                << "Resource backend " << request["command"].asString()
+                << " run failed: " << reply["error"].asString();
+        }
+
+        return reply;
+    } catch (const HelperFailure &e) {
+        shutdown();
+        ++failures_;
+        const auto delay(std::chrono::milliseconds(config_.restartDelay)
+                         * (1 << std::min(failures_ - 1, 6u)));
+        restartAfter_ = now + delay;
+
         LOGTHROW(err3, Error)
-            << "Resource backend error run failed: "
-            << pysupport::formatCurrentException();
+            << "Python resource backend helper failed: " << e.what()
+            << "; restart in "
+            << std::chrono::duration_cast<std::chrono::milliseconds>
+            (delay).count() << " ms.";
     }
     throw;
 }
 
+bool Python::refresh() const
+{
+    auto request(command("load"));
+    request["full"] = resync_;
+
+    const auto reply(call(request));
+    const bool full(resync_);
+    resync_ = false;
+
+    if (full) { entries_.clear(); }
+
+    const auto next(lastRevision_ + 1);
+    bool modified(full || !lastRevision_);
+
+    for (const auto &key : reply["remove"]) {
+        modified |= bool(entries_.erase(key.asString()));
+    }
+
+    for (const auto &item : reply["upsert"]) {
+        auto &entry(entries_[item["key"].asString()]);
+        entry.definition = item["definition"];
+        entry.revision = next;
+        modified = true;
+
+        Json::Value list(Json::arrayValue);
+        list.append(entry.definition);
+
+        try {
+            entry.resources = loadResources
+                (list, config_.script
+                 , [this](const Resource::Id &id, const std::string &error)
+                 { errorRaw(id, error); }
+                 , genericConfig_.fileClassSettings);
+        } catch (...) {
+            // start over next time
+            resync_ = true;
+            throw;
+        }
+    }
+
+    if (modified) { lastRevision_ = next; }
+    return modified;
+}
+
+Resource::map Python::merge() const
+{
+    Resource::map resources;
+    for (const auto &item : entries_) {
+        for (const auto &res : item.second.resources) {
+            if (!resources.insert(res).second) {
+                LOGTHROW(err1, FormatError)
+                    << "Duplicate entry for <" << res.first << ">.";
+            }
+        }
+    }
+    return resources;
+}
+
+Resource::map Python::load_impl() const
+{
+    std::unique_lock<decltype(mutex_)> lock(mutex_);
+    LOG(info4) << "Loading resources";
+    refresh();
+    return merge();
+}
+
+ResourceBackend::Update Python::loadSince_impl(Revision since) const
+{
+    std::unique_lock<decltype(mutex_)> lock(mutex_);
+
+    Update update;
+
+    const auto reply(call(command("revision")));
+    const bool hasToken(reply["token"].isString());
+    const auto token(hasToken ? reply["token"].asString() : std::string());
+
+    if (hasToken && lastRevision_ && !resync_ && (token == token_)
+        && (since == lastRevision_))
+    {
+        // nothing changed, loader not run at all
+        update.revision = lastRevision_;
+        update.changed = false;
+        return update;
+    }
+
+    LOG(info4) << "Loading resources";
+    refresh();
+    token_ = token;
+    update.revision = lastRevision_;
+
+    if (since && (since == lastRevision_)) {
+        update.changed = false;
+        return update;
+    }
+
+    update.resources = merge();
+
+    if (since) {
+        for (const auto &item : entries_) {
+            if (item.second.revision > since) { continue; }
+            for (const auto &res : item.second.resources) {
+                update.unchanged.insert(res.first);
+            }
+        }
+    }
+
+    return update;
+}
+
 void Python::error_impl(const Resource::Id &resourceId
                         , const std::string &message) const
 {
@@ -202,15 +679,16 @@ void Python::error_impl(const Resource::Id &resourceId
 void Python::errorRaw(const Resource::Id &resourceId
                       , const std::string &message) const
 {
-    if (error_) {
-        try {
-            error_(resourceId.referenceFrame, resourceId.group
-                   , resourceId.id, message);
-        } catch (const python::error_already_set&) {
-        LOGTHROW(err3, Error)
-            << "Resource backend error report failed: "
-            << pysupport::formatCurrentException();
-        }
+    auto request(command("error"));
+    request["referenceFrame"] = resourceId.referenceFrame;
+    request["group"] = resourceId.group;
+    request["id"] = resourceId.id;
+    request["message"] = message;
+
+    try {
+        call(request);
+    } catch (const Error &e) {
+        LOG(err3) << "Resource backend error report failed: " << e.what();
     }
 }
 
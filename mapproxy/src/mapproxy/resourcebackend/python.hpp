@@ -27,41 +27,110 @@
 #ifndef mapproxy_resourcebackend_python_hpp_included_
 #define mapproxy_resourcebackend_python_hpp_included_
 
+#include <map>
 #include <mutex>
+#include <chrono>
 
-#include <boost/python.hpp>
-#include <boost/python/stl_iterator.hpp>
 #include <boost/filesystem/path.hpp>
 
-#include "../resourcebackend.hpp"
+#include "jsoncpp/json.hpp"
 
-namespace python = boost::python;
+#include "../resourcebackend.hpp"
+#include "../gdalsupport/process.hpp"
 
 namespace resource_backend {
 
+/** Python resource backend. User's script runs in a helper process forked
+ *  from the daemon; it talks to the daemon via incremental resource-diff
+ *  protocol: on each load only added, changed and removed resource
+ *  definitions are sent back. Helper is killed when it does not answer in
+ *  time (or dies) and it is restarted on next load, not sooner than after
+ *  restartDelay (doubled with each consecutive failure).
+ */
 class Python : public ResourceBackend {
 public:
     struct Config {
         typedef std::map<std::string, std::string> Options;
         boost::filesystem::path script;
         Options options;
+
+        /** Maximum time to wait for helper's answer (in ms).
+         */
+        unsigned int timeout;
+
+        /** Delay before restart of failed helper (in ms).
+         */
+        unsigned int restartDelay;
+
+        Config() : timeout(60000), restartDelay(5000) {}
     };
 
     Python(const GenericConfig &genericConfig, const Config &config);
+    ~Python();
 
 private:
     virtual Resource::map load_impl() const;
 
+    virtual Update loadSince_impl(Revision since) const;
+
     virtual void error_impl(const Resource::Id &resourceId
                             , const std::string &message) const;
 
     void errorRaw(const Resource::Id &resourceId
                   , const std::string &message) const;
 
+    /** Applies resource diff from helper. Returns true if anything changed.
+     */
+    bool refresh() const;
+
+    /** Merges all known resources.
+     */
+    Resource::map merge() const;
+
+    /** Sends request to helper and waits for reply, (re)starts helper if
+     *  not running.
+     */
+    Json::Value call(const Json::Value &request) const;
+
+    void spawn() const;
+    void shutdown() const;
+
     mutable std::recursive_mutex mutex_;
-    boost::filesystem::path script_;
-    python::object run_;
-    python::object error_;
+    Config config_;
+
+    /** Helper process and our end of the socket pair.
+     */
+    mutable Process helper_;
+    mutable int fd_;
+
+    /** Consecutive helper failures and time of next restart.
+     */
+    mutable unsigned int failures_;
+    mutable std::chrono::steady_clock::time_point restartAfter_;
+
+    /** Helper's diff state is to be discarded on next load (fresh helper,
+     *  failed parse).
+     */
+    mutable bool resync_;
+
+    /** Single resource definition as sent by the helper.
+     */
+    struct Entry {
+        Json::Value definition;
+        Resource::map resources;
+        Revision revision;
+
+        Entry() : revision() {}
+    };
+
+    /** Known definitions, keyed by helper's key.
+     */
+    mutable std::map<std::string, Entry> entries_;
+
+    /** Last seen change token and revision assigned to it.
+     */
+    mutable std::string token_;
+    mutable Revision lastRevision_;
 };
 
 } // namespace resource_backend
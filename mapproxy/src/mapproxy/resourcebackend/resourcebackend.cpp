@@ -53,6 +53,13 @@ ResourceBackend::Factory::pointer findFactory(const std::string &type)
 
 } // namespace
 
+ResourceBackend::Update ResourceBackend::loadSince_impl(Revision) const
+{
+    Update update;
+    update.resources = load_impl();
+    return update;
+}
+
 void ResourceBackend::registerType(const std::string &type
                                    , const Factory::pointer &factory)
 {
@@ -0,0 +1,238 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <iterator>
+#include <functional>
+
+#include "support/hash.hpp"
+
+#include "responsecache.hpp"
+
+namespace {
+
+/** Content hash of a body; zero is reserved for unshared body.
+ */
+std::uint64_t contentHash(const std::string &body)
+{
+    const auto hash(stableHash(body));
+    return hash ? hash : 1;
+}
+
+} // namespace
+
+ResponseCache::ResponseCache(const Options &options)
+    : shardLimit_(options.shards
+                  ? ((options.size << 20) / options.shards) : 0)
+    , maxEntrySize_(options.maxEntrySize << 10)
+    , hits_(0), misses_(0), stored_(0), evicted_(0), deduplicated_(0)
+{
+    if (!options.size || !options.shards) { return; }
+
+    for (unsigned int i(0); i < options.shards; ++i) {
+        shards_.push_back(std::make_unique<Shard>());
+    }
+}
+
+ResponseCache::Shard& ResponseCache::shard(const std::string &key)
+{
+    return *shards_[std::hash<std::string>()(key) % shards_.size()];
+}
+
+void ResponseCache::Shard::erase(Lru::iterator item)
+{
+    const auto bodySize(item->response->body().size());
+    logicalSize -= bodySize;
+
+    if (item->content) {
+        auto fcontents(contents.find(item->content));
+        if (!--fcontents->second.refs) {
+            size -= bodySize;
+            contents.erase(fcontents);
+        }
+    } else {
+        size -= bodySize;
+    }
+
+    index.erase(item->key);
+    lru.erase(item);
+}
+
+ResponseCache::Response::pointer ResponseCache::get(const std::string &key)
+{
+    if (!enabled()) { return {}; }
+
+    auto &s(shard(key));
+    std::unique_lock<std::mutex> lock(s.mutex);
+
+    auto findex(s.index.find(key));
+    if (findex == s.index.end()) {
+        ++misses_;
+        return {};
+    }
+
+    auto item(findex->second);
+    if (item->response->expires <= Clock::now()) {
+        s.erase(item);
+        ++misses_;
+        return {};
+    }
+
+    // move to front
+    s.lru.splice(s.lru.begin(), s.lru, item);
+    ++hits_;
+    return item->response;
+}
+
+bool ResponseCache::contains(const std::string &key)
+{
+    if (!enabled()) { return false; }
+
+    auto &s(shard(key));
+    std::unique_lock<std::mutex> lock(s.mutex);
+
+    auto findex(s.index.find(key));
+    return ((findex != s.index.end())
+            && (findex->second->response->expires > Clock::now()));
+}
+
+void ResponseCache::put(const std::string &key, const void *data
+                        , std::size_t size, const Sink::FileInfo &stat)
+{
+    if (!enabled() || (size > maxEntrySize_) || (size > shardLimit_)) {
+        return;
+    }
+
+    // only responses cacheable by clients are cacheable by us
+    const auto &maxAge(stat.cacheControl.maxAge);
+    if (!maxAge || (*maxAge <= 0)) { return; }
+
+    auto response(std::make_shared<Response>());
+    response->content = std::make_shared<std::string>
+        (static_cast<const char*>(data), size);
+    response->stat = stat;
+    response->expires = Clock::now() + std::chrono::seconds(*maxAge);
+
+    put(key, response);
+}
+
+void ResponseCache::put(const std::string &key
+                        , Response::pointer response)
+{
+    const auto size(response->body().size());
+    if (!enabled() || (size > maxEntrySize_) || (size > shardLimit_)) {
+        return;
+    }
+
+    // hashed outside of the lock
+    auto content(contentHash(response->body()));
+
+    auto &s(shard(key));
+    std::unique_lock<std::mutex> lock(s.mutex);
+
+    auto findex(s.index.find(key));
+    if (findex != s.index.end()) { s.erase(findex->second); }
+
+    // share body with responses of the same content
+    std::size_t charge(size);
+    auto fcontents(s.contents.find(content));
+    if (fcontents == s.contents.end()) {
+        s.contents[content] = { response->content, 1 };
+    } else if (*fcontents->second.body == response->body()) {
+        if (fcontents->second.body != response->content) {
+            auto shared(std::make_shared<Response>(*response));
+            shared->content = fcontents->second.body;
+            response = shared;
+        }
+        ++fcontents->second.refs;
+        charge = 0;
+        ++deduplicated_;
+    } else {
+        // hash collision, keep body on its own
+        content = 0;
+    }
+
+    // make room
+    while (charge && !s.lru.empty() && ((s.size + charge) > shardLimit_)) {
+        s.erase(std::prev(s.lru.end()));
+        ++evicted_;
+    }
+
+    s.lru.emplace_front(key, response, content);
+    s.index[key] = s.lru.begin();
+    s.size += charge;
+    s.logicalSize += size;
+    ++stored_;
+}
+
+void ResponseCache::send(Sink &sink, const Response::pointer &response)
+{
+    sink.content(response->body().data(), response->body().size()
+                 , response->stat, response);
+}
+
+void ResponseCache::stat(std::ostream &os, const std::string &prefix) const
+{
+    std::size_t size(0), logicalSize(0), count(0), contents(0);
+    for (const auto &s : shards_) {
+        std::unique_lock<std::mutex> lock(s->mutex);
+        size += s->size;
+        logicalSize += s->logicalSize;
+        count += s->lru.size();
+        contents += s->contents.size();
+    }
+
+    const std::uint64_t hits(hits_);
+    const std::uint64_t misses(misses_);
+
+    os << prefix << "hits=" << hits << '\n'
+       << prefix << "misses=" << misses << '\n'
+       << prefix << "hitRate="
+       << ((hits + misses) ? (double(hits) / (hits + misses)) : 0.0) << '\n'
+       << prefix << "stored=" << stored_ << '\n'
+       << prefix << "evicted=" << evicted_ << '\n'
+       << prefix << "entries=" << count << '\n'
+       << prefix << "size=" << size << '\n'
+       << prefix << "deduplicated=" << deduplicated_ << '\n'
+       << prefix << "contents=" << contents << '\n'
+       << prefix << "logicalSize=" << logicalSize << '\n'
+       << prefix << "dedupRatio="
+       << (size ? (double(logicalSize) / size) : 1.0) << '\n';
+}
+
+void ResponseCache::metrics(metrics::Writer &writer
+                            , const std::string &prefix) const
+{
+    writer.counter(prefix + "hits", "Responses served from cache.", hits_);
+    writer.counter(prefix + "misses", "Responses not found in cache."
+                   , misses_);
+    writer.counter(prefix + "stored", "Responses stored in cache."
+                   , stored_);
+    writer.counter(prefix + "evicted", "Responses evicted from cache."
+                   , evicted_);
+    writer.counter(prefix + "deduplicated"
+                   , "Responses stored sharing body of another response."
+                   , deduplicated_);
+}
@@ -0,0 +1,172 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef mapproxy_responsecache_hpp_included_
+#define mapproxy_responsecache_hpp_included_
+
+#include <list>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include <ostream>
+#include <unordered_map>
+
+#include "support/metrics.hpp"
+
+#include "sink.hpp"
+
+/** In-memory cache of fully encoded responses (body and file info).
+ *
+ *  Entries are kept for max-age of the response, size of the cache is
+ *  bounded and least recently used entries are evicted first. The cache is
+ *  split into independently locked shards by key hash.
+ *
+ *  Bodies are content-addressed within a shard: responses of identical
+ *  content (e.g. empty ocean tiles) share single reference counted copy of
+ *  the body, which is counted against the size limit only once.
+ */
+class ResponseCache {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Options {
+        /** Total size of cached bodies (in MB, 0 = cache disabled).
+         */
+        std::size_t size;
+
+        /** Number of independently locked shards.
+         */
+        unsigned int shards;
+
+        /** Larger responses are not cached (in KB).
+         */
+        std::size_t maxEntrySize;
+
+        Options() : size(0), shards(16), maxEntrySize(4096) {}
+    };
+
+    struct Response {
+        typedef std::shared_ptr<const Response> pointer;
+
+        /** Body, possibly shared with other responses of the same content.
+         */
+        std::shared_ptr<const std::string> content;
+        Sink::FileInfo stat;
+        Clock::time_point expires;
+
+        const std::string& body() const { return *content; }
+    };
+
+    ResponseCache(const Options &options);
+
+    bool enabled() const { return !shards_.empty(); }
+
+    /** Returns cached response or null pointer if there is none (or it has
+     *  expired).
+     */
+    Response::pointer get(const std::string &key);
+
+    /** Checks for (unexpired) response without counting it as a hit or a
+     *  miss and without touching its position in the LRU.
+     */
+    bool contains(const std::string &key);
+
+    /** Stores response. Responses without positive max-age are not stored.
+     */
+    void put(const std::string &key, const void *data, std::size_t size
+             , const Sink::FileInfo &stat);
+
+    /** Stores already built response (e.g. one coming from the disk cache),
+     *  keeping its expiration time. Cached copy may differ from the given one
+     *  in body sharing only.
+     */
+    void put(const std::string &key, Response::pointer response);
+
+    /** Sends cached response to the sink. Body is not copied.
+     */
+    static void send(Sink &sink, const Response::pointer &response);
+
+    void stat(std::ostream &os, const std::string &prefix) const;
+
+    /** Writes lock-free counters, metric names start with given prefix.
+     */
+    void metrics(metrics::Writer &writer, const std::string &prefix) const;
+
+private:
+    struct Shard {
+        struct Item {
+            std::string key;
+            Response::pointer response;
+
+            /** Content hash of the body, 0 = body is not shared.
+             */
+            std::uint64_t content;
+
+            Item(const std::string &key, const Response::pointer &response
+                 , std::uint64_t content)
+                : key(key), response(response), content(content)
+            {}
+        };
+        typedef std::list<Item> Lru;
+
+        /** Shared body and number of entries referencing it.
+         */
+        struct Content {
+            std::shared_ptr<const std::string> body;
+            std::size_t refs;
+        };
+
+        std::mutex mutex;
+        Lru lru;
+        std::unordered_map<std::string, Lru::iterator> index;
+        std::unordered_map<std::uint64_t, Content> contents;
+
+        /** Size of stored bodies (shared ones counted once) and of the
+         *  bodies as referenced by entries.
+         */
+        std::size_t size = 0;
+        std::size_t logicalSize = 0;
+
+        void erase(Lru::iterator item);
+    };
+
+    Shard& shard(const std::string &key);
+
+    const std::size_t shardLimit_;
+    const std::size_t maxEntrySize_;
+    std::vector<std::unique_ptr<Shard>> shards_;
+
+    std::atomic<std::uint64_t> hits_;
+    std::atomic<std::uint64_t> misses_;
+    std::atomic<std::uint64_t> stored_;
+    std::atomic<std::uint64_t> evicted_;
+    std::atomic<std::uint64_t> deduplicated_;
+};
+
+#endif // mapproxy_responsecache_hpp_included_
@@ -0,0 +1,149 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <algorithm>
+
+#include "scheduler.hpp"
+
+namespace {
+
+/** Virtual time advance of a task of weight 1.
+ */
+constexpr std::uint64_t Stride(1 << 20);
+
+} // namespace
+
+Scheduler::Scheduler(boost::asio::io_service &ios, std::size_t maxRunning)
+    : ios_(ios), maxRunning_(maxRunning), vtime_(), parked_()
+    , queued_(), served_(), capped_()
+{}
+
+void Scheduler::post(const std::string &tenant, unsigned int weight
+                     , Job job)
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        auto &t(tenants_[tenant]);
+        if (t.queue.empty()) {
+            // (re)activated tenant must not bank idle time
+            t.pass = std::max(t.pass, vtime_);
+        }
+        t.weight = std::max(weight, 1u);
+        t.queue.push_back(std::move(job));
+    }
+    ++queued_;
+
+    ios_.post([this]() { pump(); });
+}
+
+Scheduler::Tenants::iterator Scheduler::pick()
+{
+    auto best(tenants_.end());
+    for (auto it(tenants_.begin()), end(tenants_.end()); it != end; ++it) {
+        const auto &t(it->second);
+        if (t.queue.empty()) { continue; }
+        if (maxRunning_ && (t.running >= maxRunning_)) { continue; }
+        if ((best == tenants_.end()) || (t.pass < best->second.pass)) {
+            best = it;
+        }
+    }
+    return best;
+}
+
+void Scheduler::pump()
+{
+    Job job;
+    Tenants::iterator it;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        it = pick();
+        if (it == tenants_.end()) {
+            // everything left belongs to tenants at their cap
+            ++parked_;
+            ++capped_;
+            return;
+        }
+
+        auto &t(it->second);
+        job = std::move(t.queue.front());
+        t.queue.pop_front();
+        ++t.running;
+        vtime_ = t.pass;
+        t.pass += Stride / t.weight;
+    }
+    --queued_;
+    ++served_;
+
+    // finish bookkeeping even if job throws; iterator stays valid: running
+    // tenant is never erased and std::map insertion invalidates nothing
+    struct Finish {
+        Scheduler &s;
+        Tenants::iterator it;
+        ~Finish() {
+            bool repost(false);
+            {
+                std::unique_lock<std::mutex> lock(s.mutex_);
+                auto &t(it->second);
+                --t.running;
+                if (s.parked_) {
+                    --s.parked_;
+                    repost = true;
+                }
+                if (t.queue.empty() && !t.running) { s.tenants_.erase(it); }
+            }
+            if (repost) { s.ios_.post([&s=s]() { s.pump(); }); }
+        }
+    } finish{*this, it};
+
+    job();
+}
+
+void Scheduler::stat(std::ostream &os, const std::string &prefix) const
+{
+    os << prefix << "queued=" << queued_ << '\n'
+       << prefix << "served=" << served_ << '\n'
+       << prefix << "capped=" << capped_ << '\n';
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    os << prefix << "tenants=" << tenants_.size() << '\n';
+    for (const auto &item : tenants_) {
+        os << prefix << "tenant." << item.first << ".queued="
+           << item.second.queue.size() << '\n'
+           << prefix << "tenant." << item.first << ".running="
+           << item.second.running << '\n';
+    }
+}
+
+void Scheduler::metrics(metrics::Writer &writer, const std::string &prefix)
+    const
+{
+    writer.gauge(prefix + "queued", "Tasks waiting in fair queues."
+                 , queued_);
+    writer.counter(prefix + "served", "Tasks started by fair scheduler."
+                   , served_);
+    writer.counter(prefix + "capped", "Scheduling rounds that found only "
+                   "tenants at their concurrency cap.", capped_);
+}
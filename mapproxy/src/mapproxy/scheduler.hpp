@@ -0,0 +1,119 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef mapproxy_scheduler_hpp_included_
+#define mapproxy_scheduler_hpp_included_
+
+#include <map>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <string>
+#include <cstdint>
+#include <ostream>
+#include <functional>
+
+#include <boost/asio/io_service.hpp>
+
+#include "support/metrics.hpp"
+
+/** Weighted fair queueing of generator tasks on top of the processing
+ *  thread pool.
+ *
+ *  Every tenant (resource) has its own FIFO queue. Each posted task posts a
+ *  pump to the io_service; the pump runs the head of the tenant queue with
+ *  the lowest virtual time (stride scheduling), i.e. tenants get processing
+ *  threads in proportion to their weights no matter how many tasks they
+ *  have queued. Tenant reaching its concurrency cap is skipped; a pump that
+ *  finds only capped tenants is parked and reposted once a task finishes.
+ *
+ *  Other handlers (continuations, timers, fetcher callbacks) still go to
+ *  the io_service directly.
+ */
+class Scheduler {
+public:
+    typedef std::function<void()> Job;
+
+    /** Maximum number of running tasks per tenant (0 = unlimited).
+     */
+    Scheduler(boost::asio::io_service &ios, std::size_t maxRunning);
+
+    Scheduler(const Scheduler&) = delete;
+    Scheduler& operator=(const Scheduler&) = delete;
+
+    /** Queues job of given tenant. Weight must be positive.
+     */
+    void post(const std::string &tenant, unsigned int weight, Job job);
+
+    void stat(std::ostream &os, const std::string &prefix) const;
+
+    /** Writes lock-free counters, metric names start with given prefix.
+     */
+    void metrics(metrics::Writer &writer, const std::string &prefix) const;
+
+private:
+    struct Tenant {
+        std::deque<Job> queue;
+        std::uint64_t pass;
+        unsigned int weight;
+        std::size_t running;
+
+        Tenant() : pass(), weight(1), running() {}
+    };
+
+    /** Ordered map: its iterators survive insertion of other tenants, i.e.
+     *  running job's tenant can be referenced without lock.
+     */
+    typedef std::map<std::string, Tenant> Tenants;
+
+    /** Runs single job of the most entitled tenant.
+     */
+    void pump();
+
+    /** Picks tenant to serve next. Must be called under lock.
+     */
+    Tenants::iterator pick();
+
+    boost::asio::io_service &ios_;
+    const std::size_t maxRunning_;
+
+    mutable std::mutex mutex_;
+    Tenants tenants_;
+
+    /** Virtual time: pass of the last served tenant.
+     */
+    std::uint64_t vtime_;
+
+    /** Pumps that found nothing runnable.
+     */
+    std::size_t parked_;
+
+    std::atomic<std::size_t> queued_;
+    std::atomic<std::uint64_t> served_;
+    std::atomic<std::uint64_t> capped_;
+};
+
+#endif // mapproxy_scheduler_hpp_included_
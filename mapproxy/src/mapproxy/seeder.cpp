@@ -0,0 +1,565 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <thread>
+#include <sstream>
+#include <algorithm>
+
+#include <boost/format.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include "dbglog/dbglog.hpp"
+
+#include "utility/streams.hpp"
+
+#include "jsoncpp/json.hpp"
+#include "jsoncpp/io.hpp"
+
+#include "vts-libs/vts/tileop.hpp"
+
+#include "archivewriter.hpp"
+#include "seeder.hpp"
+
+namespace fs = boost::filesystem;
+
+namespace {
+
+/** Tiles are looked up in the delivery index in blocks of 256x256 tiles.
+ */
+const vts::Lod BlockOrder(8);
+
+/** Minimum period between two checkpoints.
+ */
+const std::chrono::seconds CheckpointPeriod(1);
+
+typedef std::chrono::steady_clock Clock;
+
+/** Block position in job: lod and block index in its block grid.
+ */
+typedef std::pair<vts::Lod, std::uint64_t> BlockKey;
+
+} // namespace
+
+struct Seeder::Task {
+    Task(unsigned int id, const Job &job, const std::string &path
+         , int fileFlags, const fs::path &index);
+
+    /** Loads next block with tiles. Returns false when there is none.
+     */
+    bool load();
+
+    /** Tile range of given lod.
+     */
+    vts::TileRange lodRange(vts::Lod l) const;
+
+    FileInfo fileInfo(const vts::TileId &tileId) const;
+
+    /** Oldest block not fully seeded.
+     */
+    BlockKey checkpointKey() const;
+
+    void checkpoint(bool force = false);
+
+    /** Tries to resume from saved state.
+     */
+    void resume();
+
+    void finish();
+
+    const unsigned int id;
+    const Job job;
+    const std::string path;
+    const int fileFlags;
+    const mmapped::TileIndex index;
+    const std::string signature;
+
+    /** Export target, if any.
+     */
+    ArchiveWriter::pointer archive;
+
+    /** Index flags a tile must have to be seeded.
+     */
+    mmapped::TileFlag::value_type mask;
+
+    /** Cursor: current lod, its block grid and next block to load.
+     */
+    vts::Lod lod;
+    math::Size2 blocks;
+    std::uint64_t block;
+
+    /** Tiles of loaded block not handed out yet.
+     */
+    BlockKey loaded;
+    std::vector<vts::TileId> tiles;
+    std::size_t nextTile;
+
+    bool exhausted;
+    bool cancelled;
+
+    /** Files in flight per block.
+     */
+    std::map<BlockKey, std::size_t> pending;
+    std::size_t inFlight;
+
+    std::uint64_t issued;
+    std::uint64_t generated;
+    std::uint64_t cached;
+    std::uint64_t failed;
+
+    Clock::time_point started;
+    Clock::time_point lastIssue;
+    Clock::time_point lastCheckpoint;
+};
+
+namespace {
+
+std::string makeSignature(const Seeder::Job &job)
+{
+    std::ostringstream os;
+    os << job.resourceId << ' ' << job.generatorType << ' ' << job.ext
+       << ' ' << job.lodRange.min << '-' << job.lodRange.max;
+    if (job.tileRange) {
+        const auto &tr(*job.tileRange);
+        os << ' ' << tr.ll(0) << ',' << tr.ll(1) << ':'
+           << tr.ur(0) << ',' << tr.ur(1);
+    }
+    return os.str();
+}
+
+/** Block of tile at given lod is its ancestor this number of lods up.
+ */
+inline vts::Lod blockShift(vts::Lod lod)
+{
+    return std::min(lod, BlockOrder);
+}
+
+/** Grid of blocks covering given tile range at given lod.
+ */
+math::Size2 blockGrid(vts::Lod lod, const vts::TileRange &range)
+{
+    const auto shift(blockShift(lod));
+    return math::Size2((range.ur(0) >> shift) - (range.ll(0) >> shift) + 1
+                       , (range.ur(1) >> shift) - (range.ll(1) >> shift) + 1);
+}
+
+} // namespace
+
+Seeder::Task::Task(unsigned int id, const Job &job, const std::string &path
+                   , int fileFlags, const fs::path &index)
+    : id(id), job(job), path(path), fileFlags(fileFlags), index(index)
+    , signature(makeSignature(job))
+    , mask((job.ext == "nav") ? mmapped::TileFlag::navtile
+           : mmapped::TileFlag::mesh)
+    , lod(job.lodRange.min), blocks(blockGrid(lod, lodRange(lod))), block()
+    , loaded(lod, 0), nextTile(), exhausted(false), cancelled(false)
+    , inFlight(), issued(), generated(), cached(), failed()
+    , started(Clock::now()), lastIssue(), lastCheckpoint(Clock::now())
+{
+    if (!job.archive.empty()) {
+        archive = std::make_shared<ArchiveWriter>(job.archive, job.ext);
+    }
+    resume();
+}
+
+vts::TileRange Seeder::Task::lodRange(vts::Lod l) const
+{
+    if (job.tileRange) {
+        return vts::shiftRange(job.lodRange.min, *job.tileRange, l);
+    }
+    const auto max((1u << l) - 1);
+    return vts::TileRange(0, 0, max, max);
+}
+
+bool Seeder::Task::load()
+{
+    tiles.clear();
+    nextTile = 0;
+
+    while (lod <= job.lodRange.max) {
+        if (lod >= index.lodCount()) { break; }
+
+        const auto range(lodRange(lod));
+        const auto *tree(index.tree(lod));
+        const auto shift(blockShift(lod));
+        const vts::Lod blockLod(lod - shift);
+
+        while (block < std::uint64_t(math::area(blocks))) {
+            const auto key(BlockKey(lod, block));
+            const unsigned int bx((range.ll(0) >> shift)
+                                  + (block % blocks.width));
+            const unsigned int by((range.ll(1) >> shift)
+                                  + (block / blocks.width));
+            ++block;
+
+            // skip blocks without any data at this lod
+            if (!tree || !tree->get(blockLod, bx, by)) { continue; }
+
+            // clip block to job's range
+            vts::TileRange br(bx << shift, by << shift
+                              , ((bx + 1) << shift) - 1
+                              , ((by + 1) << shift) - 1);
+            br = vts::TileRange(std::max(br.ll(0), range.ll(0))
+                                , std::max(br.ll(1), range.ll(1))
+                                , std::min(br.ur(0), range.ur(0))
+                                , std::min(br.ur(1), range.ur(1)));
+
+            const auto flags(index.rangeFlags(lod, br));
+            const auto width(br.ur(0) - br.ll(0) + 1);
+            for (std::size_t i(0); i < flags.size(); ++i) {
+                if (!mmapped::TileFlag::leaf(flags[i])
+                    || !(flags[i] & mask))
+                {
+                    continue;
+                }
+                tiles.emplace_back(lod, br.ll(0) + (i % width)
+                                   , br.ll(1) + (i / width));
+            }
+
+            if (job.metaOrder) {
+                // fold tiles into their metatiles, blocks are made of
+                // whole metatiles unless the lod is shallower
+                const auto order(job.metaOrder);
+                for (auto &tile : tiles) {
+                    tile.x = (tile.x >> order) << order;
+                    tile.y = (tile.y >> order) << order;
+                }
+                std::sort(tiles.begin(), tiles.end());
+                tiles.erase(std::unique(tiles.begin(), tiles.end())
+                            , tiles.end());
+            }
+
+            if (!tiles.empty()) {
+                loaded = key;
+                return true;
+            }
+        }
+
+        // next lod
+        ++lod;
+        block = 0;
+        if (lod <= job.lodRange.max) {
+            blocks = blockGrid(lod, lodRange(lod));
+        }
+    }
+
+    return false;
+}
+
+FileInfo Seeder::Task::fileInfo(const vts::TileId &tileId) const
+{
+    http::Request request;
+    request.path = path + str(boost::format("%d-%d-%d.%s")
+                              % tileId.lod % tileId.x % tileId.y % job.ext);
+    request.uri = request.path;
+
+    FileInfo fi(request, fileFlags);
+    // most clients accept gzip, seed what they are going to ask for
+    fi.acceptGzip = true;
+    return fi;
+}
+
+BlockKey Seeder::Task::checkpointKey() const
+{
+    if (!pending.empty()) { return pending.begin()->first; }
+    if (nextTile < tiles.size()) { return loaded; }
+    return BlockKey(lod, block);
+}
+
+void Seeder::Task::checkpoint(bool force)
+{
+    if (job.state.empty()) { return; }
+
+    const auto now(Clock::now());
+    if (!force && ((now - lastCheckpoint) < CheckpointPeriod)) { return; }
+    lastCheckpoint = now;
+
+    const auto key(checkpointKey());
+    try {
+        const auto tmp(utility::addExtension(job.state, ".tmp"));
+        {
+            utility::ofstreambuf f(tmp.string());
+            f << signature << '\n' << int(key.first) << ' ' << key.second
+              << '\n';
+            f.close();
+        }
+        fs::rename(tmp, job.state);
+    } catch (const std::exception &e) {
+        LOG(warn2) << "Seed job #" << id << ": cannot save checkpoint into "
+                   << job.state << ": <" << e.what() << ">.";
+    }
+}
+
+void Seeder::Task::resume()
+{
+    if (job.state.empty() || !fs::exists(job.state)) { return; }
+
+    try {
+        utility::ifstreambuf f(job.state.string());
+        std::string saved;
+        int savedLod(0);
+        std::uint64_t savedBlock(0);
+        if (!std::getline(f, saved) || (saved != signature)
+            || !(f >> savedLod >> savedBlock))
+        {
+            LOG(info3) << "Seed job #" << id << ": state file "
+                       << job.state << " belongs to another job, ignored.";
+            return;
+        }
+
+        if ((savedLod < job.lodRange.min) || (savedLod > job.lodRange.max)) {
+            // job has been already finished
+            lod = job.lodRange.max + 1;
+            return;
+        }
+
+        lod = savedLod;
+        blocks = blockGrid(lod, lodRange(lod));
+        block = savedBlock;
+        LOG(info3) << "Seed job #" << id << ": resuming at lod " << savedLod
+                   << ", block " << savedBlock << ".";
+    } catch (const std::exception &e) {
+        LOG(warn2) << "Seed job #" << id << ": cannot read checkpoint from "
+                   << job.state << ": <" << e.what() << ">; starting over.";
+    }
+}
+
+void Seeder::Task::finish()
+{
+    const std::chrono::duration<double> elapsed(Clock::now() - started);
+    LOG(info3)
+        << "Seed job #" << id << " (" << signature << ") "
+        << (cancelled ? "cancelled" : "finished") << ": "
+        << generated << " generated, " << cached << " already cached, "
+        << failed << " failed in "
+        << str(boost::format("%.1f") % elapsed.count()) << " s.";
+
+    if (cancelled) {
+        // keep state for later resume; unfinished export is dropped
+        checkpoint(true);
+        archive.reset();
+        return;
+    }
+
+    if (archive) {
+        Json::Value metadata(Json::objectValue);
+        metadata["generator"] = "mapproxy";
+        metadata["resource"] = boost::lexical_cast<std::string>
+            (job.resourceId);
+        metadata["type"] = boost::lexical_cast<std::string>
+            (job.generatorType);
+        metadata["ext"] = job.ext;
+        metadata["minLod"] = int(job.lodRange.min);
+        metadata["maxLod"] = int(job.lodRange.max);
+        if (job.metaOrder) { metadata["metaOrder"] = job.metaOrder; }
+        std::ostringstream os;
+        Json::write(os, metadata);
+
+        // archive is written off the seeder, other jobs go on meanwhile
+        std::thread([jobId = id, archive = std::move(archive)
+                     , metadata = os.str()]()
+        {
+            try {
+                archive->finish(metadata);
+            } catch (const std::exception &e) {
+                LOG(err2) << "Seed job #" << jobId
+                          << ": cannot write archive "
+                          << archive->path() << ": <" << e.what() << ">.";
+            }
+        }).detach();
+    }
+
+    if (!job.state.empty()) {
+        boost::system::error_code ec;
+        fs::remove(job.state, ec);
+    }
+}
+
+unsigned int Seeder::add(const Job &job, const std::string &path
+                         , int fileFlags, const fs::path &index)
+{
+    if (!fs::exists(index)) {
+        LOGTHROW(err2, std::runtime_error)
+            << "Resource <" << job.resourceId
+            << "> has no delivery index to seed from.";
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto task(std::make_shared<Task>(++lastId_, job, path, fileFlags, index));
+    tasks_.push_back(task);
+
+    LOG(info3) << "Queued seed job #" << task->id << " ("
+               << task->signature << ").";
+    return task->id;
+}
+
+bool Seeder::cancel(unsigned int id)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (auto itasks(tasks_.begin()), etasks(tasks_.end());
+         itasks != etasks; ++itasks)
+    {
+        auto &task(**itasks);
+        if (task.id != id) { continue; }
+
+        // files in flight finish on their own
+        task.cancelled = true;
+        task.finish();
+        tasks_.erase(itasks);
+        return true;
+    }
+    return false;
+}
+
+bool Seeder::idle() const
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    return tasks_.empty();
+}
+
+boost::optional<FileInfo> Seeder::next(std::chrono::milliseconds &wait)
+{
+    wait = std::chrono::milliseconds(0);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!tasks_.empty()) {
+        auto ptask(tasks_.front());
+        auto &task(*ptask);
+
+        if (task.nextTile >= task.tiles.size()) {
+            if (task.exhausted || !task.load()) {
+                task.exhausted = true;
+                if (task.inFlight) { return boost::none; }
+                // done, try next task
+                task.finish();
+                tasks_.pop_front();
+                continue;
+            }
+        }
+
+        if (task.inFlight >= task.job.budget) { return boost::none; }
+
+        const auto now(Clock::now());
+        if (task.job.rate > 0.0) {
+            const auto period(std::chrono::duration_cast<Clock::duration>
+                              (std::chrono::duration<double>
+                               (1.0 / task.job.rate)));
+            const auto due(task.lastIssue + period);
+            if (now < due) {
+                wait = std::chrono::duration_cast<std::chrono::milliseconds>
+                    (due - now) + std::chrono::milliseconds(1);
+                return boost::none;
+            }
+        }
+
+        const auto tileId(task.tiles[task.nextTile++]);
+        const auto fi(task.fileInfo(tileId));
+        if (inFlight_.count(fi.url)) {
+            // should not happen, tiles are unique
+            continue;
+        }
+
+        task.lastIssue = now;
+        ++task.issued;
+        ++task.inFlight;
+        ++task.pending[task.loaded];
+        inFlight_.emplace(fi.url, Flight{ ptask, task.loaded, tileId });
+        return fi;
+    }
+
+    return boost::none;
+}
+
+void Seeder::done(const std::string &url, bool success, bool cached)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto finFlight(inFlight_.find(url));
+    if (finFlight == inFlight_.end()) { return; }
+
+    const auto ptask(finFlight->second.task);
+    const auto key(finFlight->second.key);
+    inFlight_.erase(finFlight);
+
+    auto &task(*ptask);
+    --task.inFlight;
+    if (!success) {
+        ++task.failed;
+    } else if (cached) {
+        ++task.cached;
+    } else {
+        ++task.generated;
+    }
+
+    auto fpending(task.pending.find(key));
+    if ((fpending != task.pending.end()) && !--fpending->second) {
+        task.pending.erase(fpending);
+    }
+
+    // cancelled task is already gone
+    if (task.cancelled) { return; }
+
+    if (task.exhausted && !task.inFlight) {
+        task.finish();
+        tasks_.remove(ptask);
+        return;
+    }
+
+    task.checkpoint();
+}
+
+void Seeder::record(const std::string &url, const void *data
+                    , std::size_t size, bool gzipped)
+{
+    ArchiveWriter::pointer archive;
+    vts::TileId tileId;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        auto finFlight(inFlight_.find(url));
+        if (finFlight == inFlight_.end()) { return; }
+        archive = finFlight->second.task->archive;
+        tileId = finFlight->second.tileId;
+    }
+
+    // written outside of the lock, archive has its own
+    if (archive) { archive->add(tileId, data, size, gzipped); }
+}
+
+void Seeder::stat(std::ostream &os, const std::string &prefix) const
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    os << prefix << "jobs=" << tasks_.size() << '\n';
+    for (const auto &ptask : tasks_) {
+        const auto &task(*ptask);
+        const auto p(str(boost::format("%sjob.%d.") % prefix % task.id));
+        os << p << "job=" << task.signature << '\n'
+           << p << "lod=" << int(task.lod) << '\n'
+           << p << "issued=" << task.issued << '\n'
+           << p << "generated=" << task.generated << '\n'
+           << p << "cached=" << task.cached << '\n'
+           << p << "failed=" << task.failed << '\n'
+           << p << "inFlight=" << task.inFlight << '\n';
+    }
+}
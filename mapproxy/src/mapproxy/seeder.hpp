@@ -0,0 +1,159 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef mapproxy_seeder_hpp_included_
+#define mapproxy_seeder_hpp_included_
+
+#include <map>
+#include <list>
+#include <mutex>
+#include <memory>
+#include <chrono>
+#include <string>
+#include <ostream>
+#include <cstdint>
+#include <utility>
+
+#include <boost/optional.hpp>
+#include <boost/filesystem/path.hpp>
+
+#include "vts-libs/vts/basetypes.hpp"
+
+#include "support/mmapped/tileindex.hpp"
+
+#include "resource.hpp"
+#include "fileinfo.hpp"
+
+/** Offline pre-rendering of tiles into the persistent response cache.
+ *
+ *  Seeding job walks resource's delivery index over given lod range (and
+ *  optional tile range) and hands out tile files (<lod>-<x>-<y>.<ext>) for
+ *  background generation. Jobs are processed one by one in order of
+ *  submission.
+ *
+ *  Number of files in flight is limited by job's budget and files are handed
+ *  out no faster than job's rate. Progress is checkpointed (row by row) into
+ *  job's state file; job submitted again with the same parameters resumes
+ *  from the checkpoint.
+ */
+class Seeder {
+public:
+    struct Job {
+        Resource::Id resourceId;
+        Resource::Generator::Type generatorType;
+
+        /** Extension of seeded tile files (e.g. bin, jpg, mask).
+         */
+        std::string ext;
+
+        vts::LodRange lodRange;
+
+        /** Tile range at lodRange.min, whole lod if unset.
+         */
+        boost::optional<vts::TileRange> tileRange;
+
+        /** Maximum number of files handed out per second (0 = unlimited).
+         */
+        double rate;
+
+        /** Maximum number of files in flight.
+         */
+        std::size_t budget;
+
+        /** Checkpoint file (empty = no checkpoint).
+         */
+        boost::filesystem::path state;
+
+        /** Export: seeded files are also written into this static archive
+         *  (see ArchiveWriter) once the job finishes (empty = no export).
+         *  Export has no checkpoint.
+         */
+        boost::filesystem::path archive;
+
+        /** Seed metatiles of this binary order instead of tiles: every
+         *  metatile covering some seeded tile is handed out once (0 = plain
+         *  tiles).
+         */
+        unsigned int metaOrder;
+
+        Job()
+            : generatorType(), lodRange(vts::LodRange::emptyRange())
+            , rate(), budget(4), metaOrder()
+        {}
+    };
+
+    /** Job being generated: path is the generator's local URL path prefix
+     *  (/rf/type/group/id/), index is its opened delivery index.
+     */
+    unsigned int add(const Job &job, const std::string &path, int fileFlags
+                     , const boost::filesystem::path &index);
+
+    bool cancel(unsigned int id);
+
+    bool idle() const;
+
+    /** Returns next file to seed (and reserves budget for it). If nothing is
+     *  returned because of the rate limit, wait is set to time after which
+     *  next call makes sense.
+     */
+    boost::optional<FileInfo> next(std::chrono::milliseconds &wait);
+
+    /** Seeding of file returned by next() has finished. cached: file has been
+     *  already cached, nothing was generated.
+     */
+    void done(const std::string &url, bool success, bool cached = false);
+
+    /** Content of file returned by next() has been generated (or found in
+     *  the cache). Passed to the job's archive, if any.
+     */
+    void record(const std::string &url, const void *data, std::size_t size
+                , bool gzipped);
+
+    void stat(std::ostream &os, const std::string &prefix) const;
+
+    struct Task;
+
+private:
+    typedef std::shared_ptr<Task> TaskPointer;
+
+    /** File in flight: its task, block (lod, block index) and tile.
+     */
+    struct Flight {
+        TaskPointer task;
+        std::pair<vts::Lod, std::uint64_t> key;
+        vts::TileId tileId;
+    };
+
+    mutable std::mutex mutex_;
+    unsigned int lastId_ = 0;
+    std::list<TaskPointer> tasks_;
+
+    /** Files in flight, indexed by URL.
+     */
+    std::map<std::string, Flight> inFlight_;
+};
+
+#endif // mapproxy_seeder_hpp_included_
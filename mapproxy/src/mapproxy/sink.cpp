@@ -24,6 +24,15 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <cerrno>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+
 #include <boost/lexical_cast.hpp>
 #include <boost/format.hpp>
 
@@ -117,16 +126,18 @@ const auto emptyDebugMask([]() -> std::vector<char>
 class IStreamDataSource : public http::ServerSink::DataSource {
 public:
     IStreamDataSource(const vs::IStream::pointer &stream
-                      , FileClass fileClass
+                      , const vs::FileStat &stat, FileClass fileClass
                       , const FileClassSettings *fileClassSettings
                       , const http::SinkBase::CacheControl &forcedCacheControl
-                      , bool gzipped)
-        : stream_(stream), stat_(stream->stat())
+                      , bool gzipped, const std::string &etag
+                      , const http::Header::list &headers)
+        : stream_(stream), stat_(stat)
         , fs_(Sink::FileInfo(stat_.contentType, stat_.lastModified
                              , cacheControl(fileClass, fileClassSettings
                                             , forcedCacheControl)))
+        , headers_(headers)
     {
-        headers_.emplace_back("Access-Control-Allow-Origin", "*");
+        if (!etag.empty()) { headers_.emplace_back("ETag", etag); }
         // do not fail on eof
         stream->get().exceptions(std::ios::badbit);
 
@@ -153,22 +164,241 @@ public:
 
     virtual const http::Header::list *headers() const { return &headers_; }
 
-private:
+protected:
     vs::IStream::pointer stream_;
+
+private:
     vs::FileStat stat_;
     Sink::FileInfo fs_;
     http::Header::list headers_;
 };
 
+/** Opens file behind given stream if the stream is a whole plain regular
+ *  file (i.e. not a window into an archive), returns -1 otherwise.
+ */
+int openPlainFile(vs::IStream &stream, const vs::FileStat &stat)
+{
+    const auto path(stream.name());
+    if (path.empty()) { return -1; }
+
+    const int fd(::open(path.c_str(), O_RDONLY | O_CLOEXEC));
+    if (fd < 0) { return -1; }
+
+    struct ::stat st;
+    if (::fstat(fd, &st) || !S_ISREG(st.st_mode)
+        || (std::size_t(st.st_size) != std::size_t(stat.size))
+        || (st.st_mtime != stat.lastModified))
+    {
+        ::close(fd);
+        return -1;
+    }
+
+    ::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    return fd;
+}
+
+/** Serves plain file straight from its descriptor: data are read by
+ *  pread(2) directly into libhttp's buffer, bypassing stream buffering and
+ *  seeking. The stream is kept for its name and metadata.
+ */
+class FileDataSource : public IStreamDataSource {
+public:
+    FileDataSource(int fd, const vs::IStream::pointer &stream
+                   , const vs::FileStat &stat, FileClass fileClass
+                   , const FileClassSettings *fileClassSettings
+                   , const http::SinkBase::CacheControl &forcedCacheControl
+                   , bool gzipped, const std::string &etag
+                   , const http::Header::list &headers)
+        : IStreamDataSource(stream, stat, fileClass, fileClassSettings
+                            , forcedCacheControl, gzipped, etag, headers)
+        , fd_(fd)
+    {}
+
+    virtual ~FileDataSource() { closeFd(); }
+
+    virtual std::size_t read(char *buf, std::size_t size
+                             , std::size_t off)
+    {
+        for (;;) {
+            const auto r(::pread(fd_, buf, size, off));
+            if (r >= 0) { return r; }
+            if (errno == EINTR) { continue; }
+
+            LOGTHROW(err2, std::runtime_error)
+                << "Unable to read from file <" << name() << ">: "
+                << std::strerror(errno) << ".";
+        }
+    }
+
+    virtual void close() const {
+        closeFd();
+        stream_->close();
+    }
+
+private:
+    void closeFd() const {
+        if (fd_ >= 0) {
+            ::close(fd_);
+            fd_ = -1;
+        }
+    }
+
+    mutable int fd_;
+};
+
+/** Reads whole stream into memory.
+ */
+std::string readAll(vs::IStream &stream, const vs::FileStat &stat)
+{
+    std::string data(stat.size, '\0');
+    std::size_t off(0);
+    while (off < data.size()) {
+        const auto r(stream.read(&data[off], data.size() - off, off));
+        if (!r) { break; }
+        off += r;
+    }
+    data.resize(off);
+    stream.close();
+    return data;
+}
+
+/** Serves memory block owned by holder. The block lives as long as the data
+ *  source, i.e. until libhttp finishes the response.
+ */
+class BlobDataSource : public http::ServerSink::DataSource {
+public:
+    BlobDataSource(const void *data, std::size_t size
+                   , const Sink::FileInfo &stat
+                   , const http::Header::list &headers
+                   , const std::shared_ptr<const void> &holder)
+        : data_(static_cast<const char*>(data)), size_(size)
+        , fs_(stat), headers_(headers), holder_(holder)
+    {}
+
+    virtual http::SinkBase::FileInfo stat() const {
+        return fs_;
+    }
+
+    virtual std::size_t read(char *buf, std::size_t size
+                             , std::size_t off)
+    {
+        if (off >= size_) { return 0; }
+        size = std::min(size, size_ - off);
+        std::memcpy(buf, data_ + off, size);
+        return size;
+    }
+
+    virtual std::string name() const { return "memory"; }
+
+    virtual void close() const {}
+
+    virtual long size() const { return size_; }
+
+    virtual const http::Header::list *headers() const { return &headers_; }
+
+private:
+    const char *data_;
+    std::size_t size_;
+    Sink::FileInfo fs_;
+    http::Header::list headers_;
+    std::shared_ptr<const void> holder_;
+};
+
+/** Server sink not connected to any client. Sent content is dropped, errors
+ *  are logged.
+ */
+class DetachedSink : public http::ServerSink {
+private:
+    virtual void content_impl(const void*, std::size_t, const FileInfo&
+                              , bool, const http::Header::list*)
+    {}
+
+    virtual void content_impl(const DataSource::pointer &source)
+    {
+        source->close();
+    }
+
+    virtual void error_impl(const std::exception_ptr &exc)
+    {
+        try {
+            std::rethrow_exception(exc);
+        } catch (const std::exception &e) {
+            LOG(warn2) << "Detached sink error: <" << e.what() << ">.";
+        } catch (...) {
+            LOG(warn2) << "Detached sink error: unknown.";
+        }
+    }
+
+    virtual void listing_impl(const Listing&, const std::string&
+                              , const std::string&)
+    {}
+
+    virtual void redirect_impl(const std::string&, utility::HttpCode) {}
+
+    virtual void checkAborted_impl() const {}
+
+    virtual void setAborter_impl(const AbortedCallback&) {}
+};
+
 } //namesapce
 
+Sink Sink::detached()
+{
+    return Sink(std::make_shared<DetachedSink>());
+}
+
+void Sink::content(const void *data, std::size_t size, const FileInfo &stat
+                   , const std::shared_ptr<const void> &holder)
+{
+    const auto updated(record(data, size, stat));
+    if (packer_) { packed(data, size, updated); return; }
+    sink_->content(std::make_shared<BlobDataSource>
+                   (data, size, updated, headers(updated), holder));
+}
+
+void Sink::content(const std::shared_ptr<OutputBuffer> &buffer
+                   , const FileInfo &stat)
+{
+    content(buffer->data(), buffer->size(), stat, buffer);
+}
+
 void Sink::content(const vs::IStream::pointer &stream, FileClass fileClass
                    , const http::SinkBase::CacheControl &cacheControl
                    , bool gzipped)
 {
+    const auto stat(stream->stat());
+    if (account_) { account_->sent(stat.size); }
+
+    if (packer_) {
+        // packed with the very headers the data source would send
+        auto fs(FileInfo(stat.contentType, stat.lastModified
+                         , ::cacheControl(fileClass, fileClassSettings_
+                                          , cacheControl))
+                .setFileClass(fileClass));
+        if (gzipped) { fs.addHeader("Content-Encoding", "gzip"); }
+        const auto data(readAll(*stream, stat));
+        packed(data.data(), data.size(), update(fs));
+        return;
+    }
+
+    const int fd(openPlainFile(*stream, stat));
+    if (fd >= 0) {
+        std::shared_ptr<FileDataSource> source;
+        try {
+            source = std::make_shared<FileDataSource>
+                (fd, stream, stat, fileClass, fileClassSettings_
+                 , cacheControl, gzipped, etag_, headers(FileInfo()));
+        } catch (...) {
+            ::close(fd);
+            throw;
+        }
+        sink_->content(source);
+        return;
+    }
+
     sink_->content(std::make_shared<IStreamDataSource>
-                   (stream, fileClass, fileClassSettings_, cacheControl
-                    , gzipped));
+                   (stream, stat, fileClass, fileClassSettings_
+                    , cacheControl, gzipped, etag_, headers(FileInfo())));
 }
 
 void Sink::error(const std::exception_ptr &exc)
@@ -198,10 +428,68 @@ void Sink::error(const std::exception_ptr &exc)
         content("{}", Sink::FileInfo("application/json; charset=utf-8")
                 .setFileClass(FileClass::data));
     } catch (...) {
+        if (errorRecorder_) { errorRecorder_(std::current_exception()); }
+        if (trace_) { trace_->finish(); }
+        if (observer_) { observer_(httpStatus(std::current_exception())); }
         sink_->error(std::current_exception());
     }
 }
 
+http::Header::list Sink::headers(const FileInfo &stat) const
+{
+    http::Header::list headers(stat.headers);
+    headers.emplace_back("Access-Control-Allow-Origin", "*");
+
+    if (trace_) {
+        if (trace_->reply()) {
+            headers.emplace_back("Server-Timing", trace_->serverTiming());
+        }
+        trace_->finish();
+    }
+
+    if (observer_) { observer_(200); }
+
+    return headers;
+}
+
+void Sink::packed(const void *data, std::size_t size, const FileInfo &stat)
+{
+    const auto body(packer_(data, size, stat));
+    const FileInfo fi(packedType_, -1, -1);
+    const auto headers_(headers(fi));
+    sink_->content(body, fi, &headers_);
+}
+
+void Sink::checkAborted() const
+{
+    sink_->checkAborted();
+    if (expired()) {
+        throw DeadlineExceeded("Request has not been answered in time.");
+    }
+}
+
+bool Sink::expired() const
+{
+    if (!deadline_) { return false; }
+    return (std::uint64_t(std::chrono::duration_cast
+                          <std::chrono::microseconds>
+                          (std::chrono::system_clock::now()
+                           .time_since_epoch()).count()) > deadline_);
+}
+
+Aborter::Tracer Sink::tracer() const
+{
+    if (!trace_ && !account_) { return {}; }
+
+    auto trace(trace_);
+    auto account(account_);
+    return [trace, account](const std::string &stage, std::uint64_t usec)
+    {
+        if (account && (stage == GdalCpuStage)) { account->gdalCpu(usec); }
+        if (trace) { trace->record(stage, usec); }
+    };
+}
+
 Sink::FileInfo& Sink::FileInfo::setFileClass(FileClass fc)
 {
     fileClass = fc;
@@ -229,7 +517,15 @@ Sink::FileInfo& Sink::FileInfo::addHeader(const std::string &name
 
 Sink::FileInfo Sink::update(const FileInfo &stat) const
 {
-    return ::update(stat, fileClassSettings_);
+    auto updated(::update(stat, fileClassSettings_));
+    if (etag_.empty()) { return updated; }
+
+    // replayed (cached) responses already carry the tag
+    for (const auto &header : updated.headers) {
+        if (header.name == "ETag") { return updated; }
+    }
+    updated.headers.emplace_back("ETag", etag_);
+    return updated;
 }
 
 void markdown(std::ostream &os, const std::string &source)
@@ -31,6 +31,7 @@
 #include <string>
 #include <memory>
 #include <exception>
+#include <functional>
 #include <sstream>
 
 #include "dbglog/dbglog.hpp"
@@ -43,6 +44,9 @@
 
 #include "support/fileclass.hpp"
 #include "support/aborter.hpp"
+#include "support/trace.hpp"
+#include "support/accounting.hpp"
+#include "support/outbuffer.hpp"
 
 namespace vs = vtslibs::storage;
 
@@ -81,8 +85,36 @@ public:
         http::Header::list headers;
     };
 
+    /** Response recorder, gets every in-memory content sent through the sink
+     *  along with its final file info.
+     */
+    typedef std::function<void(const void *data, std::size_t size
+                               , const FileInfo &stat)> Recorder;
+
+    /** Error recorder, gets every error sent to the client as an error
+     *  response (i.e. not special "errors" sent as content).
+     */
+    typedef std::function<void(const std::exception_ptr &exc)>
+        ErrorRecorder;
+
+    /** Response observer, gets HTTP status of the response once it is sent.
+     */
+    typedef std::function<void(int status)> Observer;
+
+    /** Response packer, turns content along with its final file info into
+     *  a single body sent instead of it (e.g. to answer a cluster peer).
+     */
+    typedef std::function<std::string(const void *data, std::size_t size
+                                      , const FileInfo &stat)> Packer;
+
     Sink(const http::ServerSink::pointer &sink)
-        : sink_(sink), fileClassSettings_() {}
+        : sink_(sink), fileClassSettings_(), background_(false), deadline_() {}
+
+    /** Sink not connected to any client, for generating content outside of
+     *  request processing (e.g. at prepare time). Never aborted, anything
+     *  sent is dropped.
+     */
+    static Sink detached();
 
     /** Sends content to client.
      * \param data data top send
@@ -106,7 +138,26 @@ public:
     void content(const void *data, std::size_t size
                  , const FileInfo &stat, bool needCopy);
 
-    /** Sends content to client.
+    /** Sends content to client without copying it. Data are kept alive by
+     *  holder until the response is sent.
+     * \param data data top send
+     * \param size size of data
+     * \param stat file info (size is ignored)
+     * \param holder owner of data, released once the response is done
+     */
+    void content(const void *data, std::size_t size, const FileInfo &stat
+                 , const std::shared_ptr<const void> &holder);
+
+    /** Sends content of output buffer to client without copying it. Buffer
+     *  is kept alive until the response is sent.
+     * \param buffer filled output buffer
+     * \param stat file info (size is ignored)
+     */
+    void content(const std::shared_ptr<OutputBuffer> &buffer
+                 , const FileInfo &stat);
+
+    /** Sends content to client. Stream of a plain regular file is served
+     *  directly from a file descriptor.
      * \param stream stream to send
      * \param fileclass file class
      * \param cacheControl explicit cache-control
@@ -120,12 +171,14 @@ public:
     /** Tell client to look somewhere else.
      */
     void redirect(const std::string &url, utility::HttpCode code) {
+        if (observer_) { observer_(static_cast<int>(code)); }
         sink_->redirect(url, code);
     }
 
     /** Generates listing.
      */
     template <typename ...Args> void listing(Args &&...args) {
+        if (observer_) { observer_(200); }
         sink_->listing(std::forward<Args>(args)...);
     }
 
@@ -143,10 +196,9 @@ public:
 
     /** Checks wheter client aborted request.
      *  Throws RequestAborted exception when true.
+     *  Throws DeadlineExceeded exception when past the deadline.
      */
-    void checkAborted() const {
-        sink_->checkAborted();
-    }
+    void checkAborted() const;
 
     /** Sets aborted callback.
      */
@@ -159,6 +211,84 @@ public:
      */
     void assignFileClassSettings(const FileClassSettings &fileClasssettings);
 
+    /** Sets response recorder (e.g. to populate response cache).
+     */
+    void setRecorder(const Recorder &recorder) { recorder_ = recorder; }
+
+    const Recorder& recorder() const { return recorder_; }
+
+    /** Sets error recorder (e.g. to share error with identical requests).
+     */
+    void setErrorRecorder(const ErrorRecorder &errorRecorder) {
+        errorRecorder_ = errorRecorder;
+    }
+
+    const ErrorRecorder& errorRecorder() const { return errorRecorder_; }
+
+    /** Sets response observer (e.g. to collect metrics).
+     */
+    void setObserver(const Observer &observer) { observer_ = observer; }
+
+    const Observer& observer() const { return observer_; }
+
+    /** Sets response packer, packed content is sent as uncacheable content
+     *  of given type. Streams are read into memory.
+     */
+    void setPacker(const Packer &packer, const std::string &contentType) {
+        packer_ = packer;
+        packedType_ = contentType;
+    }
+
+    /** Sets entity tag sent (as ETag header) with content.
+     */
+    void setETag(const std::string &etag) { etag_ = etag; }
+
+    /** Attaches request trace.
+     */
+    void setTrace(const Trace::pointer &trace) { trace_ = trace; }
+
+    /** Times given stage until returned scope dies. No-op without trace.
+     */
+    Trace::Scope traceStage(const std::string &stage) const {
+        return Trace::Scope(trace_, stage);
+    }
+
+    /** Returns tracer of processing stages if there is a trace or an
+     *  account (the latter gets GDAL worker CPU time, see
+     *  Aborter::GdalCpuStage).
+     */
+    virtual Tracer tracer() const;
+
+    virtual std::uint64_t traceId() const {
+        return trace_ ? trace_->id() : 0;
+    }
+
+    /** Charges resource usage of this request (content sent, CPU time) to
+     *  given account.
+     */
+    void setAccount(const Account::pointer &account) { account_ = account; }
+
+    /** Account charged by this request, if any.
+     */
+    Account* account() const { return account_.get(); }
+
+    /** Marks content generated into this sink as speculative (prefetch).
+     */
+    void setBackground(bool background) { background_ = background; }
+
+    virtual bool background() const { return background_; }
+
+    /** Sets deadline of this request, i.e. time (in microseconds since the
+     *  Unix epoch) by which it has to be answered (0 = no deadline).
+     */
+    void setDeadline(std::uint64_t deadline) { deadline_ = deadline; }
+
+    virtual std::uint64_t deadline() const { return deadline_; }
+
+    /** Request is past its deadline.
+     */
+    bool expired() const;
+
 private:
     /** Sends given error to the client.
      */
@@ -166,9 +296,42 @@ private:
 
     FileInfo update(const FileInfo &stat) const;
 
+    /** Updates file info and passes content to the recorder (if any).
+     */
+    FileInfo record(const void *data, std::size_t size
+                    , const FileInfo &stat) const;
+
+    /** Response headers: file's own headers, CORS and trace (if any).
+     *  Finishes trace and notifies observer.
+     */
+    http::Header::list headers(const FileInfo &stat) const;
+
+    /** Sends content packed by packer.
+     */
+    void packed(const void *data, std::size_t size, const FileInfo &stat);
+
     http::ServerSink::pointer sink_;
 
     const FileClassSettings *fileClassSettings_;
+
+    Recorder recorder_;
+
+    ErrorRecorder errorRecorder_;
+
+    Observer observer_;
+
+    Packer packer_;
+    std::string packedType_;
+
+    std::string etag_;
+
+    Trace::pointer trace_;
+
+    Account::pointer account_;
+
+    bool background_;
+
+    std::uint64_t deadline_;
 };
 
 /** Formats markdown as a HTML.
@@ -191,25 +354,40 @@ inline void Sink::error() { error(std::current_exception()); }
 
 inline void Sink::content(const std::string &data, const FileInfo &stat) {
 
-    http::Header::list headers_(stat.headers);
-    headers_.emplace_back("Access-Control-Allow-Origin", "*");
-    sink_->content(data, update(stat), &headers_);
+    const auto updated(record(data.data(), data.size(), stat));
+    if (packer_) { packed(data.data(), data.size(), updated); return; }
+    const auto headers_(headers(updated));
+    sink_->content(data, updated, &headers_);
 }
 
 template <typename T>
 inline void Sink::content(const std::vector<T> &data, const FileInfo &stat) {
 
-    http::Header::list headers_(stat.headers);
-    headers_.emplace_back("Access-Control-Allow-Origin", "*");
-    sink_->content(data, update(stat), &headers_);
+    const auto updated(record(data.data(), data.size() * sizeof(T), stat));
+    if (packer_) {
+        packed(data.data(), data.size() * sizeof(T), updated);
+        return;
+    }
+    const auto headers_(headers(updated));
+    sink_->content(data, updated, &headers_);
 }
 
 inline void Sink::content(const void *data, std::size_t size
                           , const FileInfo &stat, bool needCopy) {
 
-    http::Header::list headers_(stat.headers);
-    headers_.emplace_back("Access-Control-Allow-Origin", "*");
-    sink_->content(data, size, update(stat), needCopy, &headers_);
+    const auto updated(record(data, size, stat));
+    if (packer_) { packed(data, size, updated); return; }
+    const auto headers_(headers(updated));
+    sink_->content(data, size, updated, needCopy, &headers_);
+}
+
+inline Sink::FileInfo Sink::record(const void *data, std::size_t size
+                                   , const FileInfo &stat) const
+{
+    auto updated(update(stat));
+    if (recorder_) { recorder_(data, size, updated); }
+    if (account_) { account_->sent(size); }
+    return updated;
 }
 
 inline void
@@ -27,6 +27,8 @@
 #ifndef mapproxy_support_aborter_hpp_included_
 #define mapproxy_support_aborter_hpp_included_
 
+#include <string>
+#include <cstdint>
 #include <functional>
 
 /** Aborter helper.
@@ -34,11 +36,43 @@
 struct Aborter {
     typedef std::function<void()> AbortedCallback;
 
+    /** Receives duration (in microseconds) of named processing stage done
+     *  on behalf of the client.
+     */
+    typedef std::function<void(const std::string &stage
+                               , std::uint64_t usec)> Tracer;
+
+    /** Stage carrying CPU time (in microseconds) a GDAL worker spent on
+     *  the request, charged to the requesting resource.
+     */
+    static constexpr char GdalCpuStage[] = "gdal-cpu";
+
     virtual ~Aborter() {}
 
     /** Defaults to dummy aborter
      */
     virtual void setAborter(const AbortedCallback&) {};
+
+    /** Returns tracer of processing stages. Defaults to none (i.e. tracing
+     *  is off).
+     */
+    virtual Tracer tracer() const { return {}; }
+
+    /** Returns ID of request's trace (used to name stack samples of slow
+     *  requests). Defaults to 0 (untraced).
+     */
+    virtual std::uint64_t traceId() const { return 0; }
+
+    /** Returns true if the work is speculative (i.e. nobody is waiting for
+     *  it) and should yield to everything else. Defaults to false.
+     */
+    virtual bool background() const { return false; }
+
+    /** Returns time (in microseconds since the Unix epoch) by which the
+     *  work has to be done, work still running past it is useless. Defaults
+     *  to 0 (no deadline).
+     */
+    virtual std::uint64_t deadline() const { return 0; }
 };
 
 #endif // mapproxy_support_aborter_hpp_included_
@@ -0,0 +1,132 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <ctime>
+#include <vector>
+#include <utility>
+
+#include "accounting.hpp"
+
+namespace {
+
+/** CPU time consumed by calling thread in microseconds.
+ */
+std::uint64_t threadCpuTime()
+{
+    struct timespec ts;
+    if (::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == -1) { return 0; }
+    return std::uint64_t(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+} // namespace
+
+Account::CpuScope::CpuScope(Account *account)
+    : account_(account), start_(account ? threadCpuTime() : 0)
+{}
+
+Account::CpuScope::~CpuScope()
+{
+    if (!account_) { return; }
+    const auto now(threadCpuTime());
+    if (now > start_) { account_->coreCpu(now - start_); }
+}
+
+Account::pointer Accounting::account(const std::string &resource)
+{
+    {
+        std::shared_lock<std::shared_timed_mutex> lock(mutex_);
+        auto faccounts(accounts_.find(resource));
+        if (faccounts != accounts_.end()) { return faccounts->second; }
+    }
+
+    std::unique_lock<std::shared_timed_mutex> lock(mutex_);
+    auto &account(accounts_[resource]);
+    if (!account) { account = std::make_shared<Account>(); }
+    return account;
+}
+
+namespace {
+
+typedef std::vector<std::pair<std::string, Account::pointer>> Snapshot;
+
+} // namespace
+
+void Accounting::stat(std::ostream &os, const std::string &prefix) const
+{
+    // copy out, do not hold the lock while writing
+    Snapshot accounts;
+    {
+        std::shared_lock<std::shared_timed_mutex> lock(mutex_);
+        accounts.assign(accounts_.begin(), accounts_.end());
+    }
+
+    for (const auto &item : accounts) {
+        const auto p(prefix + item.first + '.');
+        const auto &a(*item.second);
+        os << p << "requests=" << a.requests_.value() << '\n'
+           << p << "cacheHits=" << a.cacheHits_.value() << '\n'
+           << p << "sent=" << a.sent_.value() << '\n'
+           << p << "coreCpu=" << a.coreCpu_.value() << '\n'
+           << p << "gdalCpu=" << a.gdalCpu_.value() << '\n';
+    }
+}
+
+void Accounting::metrics(metrics::Writer &writer
+                         , const std::string &prefix) const
+{
+    Snapshot accounts;
+    {
+        std::shared_lock<std::shared_timed_mutex> lock(mutex_);
+        accounts.assign(accounts_.begin(), accounts_.end());
+    }
+
+    // families are built at scrape time only
+    metrics::Family<metrics::Counter>
+        requests(prefix + "requests", "Resource file requests.")
+        , cacheHits(prefix + "cache_hits"
+                    , "Resource files answered from response cache.")
+        , sent(prefix + "sent_bytes", "Bytes of resource files sent.")
+        , coreCpu(prefix + "core_cpu_microseconds"
+                  , "Processing thread CPU time spent on resource.")
+        , gdalCpu(prefix + "gdal_cpu_microseconds"
+                  , "GDAL worker CPU time spent on resource.");
+
+    for (const auto &item : accounts) {
+        const metrics::Labels labels{ { "resource", item.first } };
+        const auto &a(*item.second);
+        requests(labels).inc(a.requests_.value());
+        cacheHits(labels).inc(a.cacheHits_.value());
+        sent(labels).inc(a.sent_.value());
+        coreCpu(labels).inc(a.coreCpu_.value());
+        gdalCpu(labels).inc(a.gdalCpu_.value());
+    }
+
+    writer.write(requests);
+    writer.write(cacheHits);
+    writer.write(sent);
+    writer.write(coreCpu);
+    writer.write(gdalCpu);
+}
@@ -0,0 +1,113 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef mapproxy_support_accounting_hpp_included_
+#define mapproxy_support_accounting_hpp_included_
+
+#include <map>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <cstdint>
+#include <ostream>
+#include <shared_mutex>
+
+#include "metrics.hpp"
+
+/** Resource usage of one resource: processing thread and GDAL worker CPU
+ *  time, bytes sent and response cache hits. Plain atomics, charged
+ *  without any locking.
+ */
+class Account {
+public:
+    typedef std::shared_ptr<Account> pointer;
+
+    /** Charges CPU time of calling processing thread from construction to
+     *  destruction. No-op without account.
+     */
+    class CpuScope {
+    public:
+        CpuScope(Account *account);
+        ~CpuScope();
+
+        CpuScope(const CpuScope&) = delete;
+        CpuScope& operator=(const CpuScope&) = delete;
+
+    private:
+        Account *account_;
+        std::uint64_t start_;
+    };
+
+    void request() { requests_.inc(); }
+    void cacheHit() { cacheHits_.inc(); }
+    void sent(std::uint64_t bytes) { sent_.inc(bytes); }
+
+    /** CPU times are in microseconds.
+     */
+    void coreCpu(std::uint64_t usec) { coreCpu_.inc(usec); }
+    void gdalCpu(std::uint64_t usec) { gdalCpu_.inc(usec); }
+
+private:
+    friend class Accounting;
+
+    metrics::Counter requests_;
+    metrics::Counter cacheHits_;
+    metrics::Counter sent_;
+    metrics::Counter coreCpu_;
+    metrics::Counter gdalCpu_;
+};
+
+/** Accounts of all resources, keyed by resource ID. Accounts are created on
+ *  first use and kept as long as the accounting (totals are monotonic,
+ *  i.e. they survive resource removal). Existing account is looked up under
+ *  shared lock only.
+ */
+class Accounting {
+public:
+    Accounting() = default;
+
+    Accounting(const Accounting&) = delete;
+    Accounting& operator=(const Accounting&) = delete;
+
+    /** Returns account of given resource, creates it on first use.
+     */
+    Account::pointer account(const std::string &resource);
+
+    /** Prints totals of every resource, one value per line.
+     */
+    void stat(std::ostream &os, const std::string &prefix) const;
+
+    /** Writes per-resource counters (labelled by resource), metric names
+     *  start with given prefix.
+     */
+    void metrics(metrics::Writer &writer, const std::string &prefix) const;
+
+private:
+    mutable std::shared_timed_mutex mutex_;
+    std::map<std::string, Account::pointer> accounts_;
+};
+
+#endif // mapproxy_support_accounting_hpp_included_
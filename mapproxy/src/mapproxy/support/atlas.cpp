@@ -24,99 +24,216 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
-#include <opencv2/highgui/highgui.hpp>
-#include <webp/encode.h>
+#include <atomic>
+#include <sstream>
+#include <fstream>
 
-#include "vts-libs/vts/opencv/atlas.hpp"
+#include <boost/format.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include "dbglog/dbglog.hpp"
+
+#include "vts-libs/vts/atlas.hpp"
 #include "utility/raise.hpp"
 
+#include "../error.hpp"
+
+#include "uniform.hpp"
+#include "pngencode.hpp"
 #include "atlas.hpp"
 
 namespace vts = vtslibs::vts;
 
 namespace {
 
+/** Encoded solid-colour tiles.
+ */
+EncodedUniformCache uniformCache(256);
 
-void encodeToWebP(const cv::Mat& img, std::vector<unsigned char>& buf) {
-
-    int width = img.cols;
-    int height = img.rows;
-    int stride = img.step;
+std::string uniformKey(const cv::Mat &image, RasterFormat format, bool atlas
+                       , const ImageEncoding &encoding)
+{
+    std::ostringstream os;
+    os << (atlas ? std::string("atlas") : boost::lexical_cast<std::string>
+           (format))
+       << ':' << encoding.jpegQuality << ':' << encoding.pngCompression
+       << ':' << encoding.webpLossless << ':' << encoding.webpQuality
+       << ':' << encoding.webpEffort
+       << ':' << encoding.avifQuality << ':' << encoding.avifSpeed
+       << ':' << encoding.jxlQuality << ':' << encoding.jxlEffort
+       << ':' << image.cols << 'x' << image.rows << ':' << image.type()
+       << ':';
+    os.write(reinterpret_cast<const char*>(image.ptr(0)), image.elemSize());
+    return os.str();
+}
 
-    uint8_t* output = nullptr;
-    size_t outputSize;
+/** Image dump settings, see dumpImages().
+ */
+struct ImageDump {
+    boost::filesystem::path dir;
+    std::size_t limit = 0;
+    std::atomic<std::size_t> count{0};
+};
 
-    //LOG(debug) << "depth = " << img.depth() << ", channels = " << img.channels();
+ImageDump imageDump;
 
-    if (img.depth() != CV_8U || (img.channels() != 3 && img.channels() != 4))
-        throw utility::makeError<InternalError>("Unsupported image type.");
+void dump(const cv::Mat &image, RasterFormat format, bool atlas)
+{
+    const auto seq(imageDump.count++);
+    if (seq >= imageDump.limit) { return; }
+
+    const auto path
+        (imageDump.dir
+         / str(boost::format("%08d.%s.png") % seq
+               % (atlas ? std::string("atlas")
+                  : boost::lexical_cast<std::string>(format))));
+
+    // fast lossless PNG, it is a debugging aid only
+    ImageEncoding encoding;
+    encoding.pngCompression = 1;
+    const auto &buf(encodeImage(image, RasterFormat::png, encoding));
+
+    std::ofstream f(path.string(), std::ios::binary);
+    f.write(reinterpret_cast<const char*>(buf.data()), buf.size());
+    if (!f) { LOG(warn2) << "Unable to dump image into " << path << "."; }
+}
 
+void send(Sink &sink, const Sink::FileInfo &sfi
+          , const EncodedUniformCache::Data &data)
+{
+    sink.content(data->data(), data->size(), sfi, data);
+}
 
-    if (img.type() == CV_8UC3) {
+/** Encodes images as JPEG pages of raw atlas and serializes it into pooled
+ *  buffer.
+ */
+OutputBuffer::pointer serializeAtlas(const std::vector<cv::Mat> &images
+                                     , Sink &sink
+                                     , const ImageEncoding &encoding)
+{
+    const auto scope(sink.traceStage("encode"));
 
-        outputSize = WebPEncodeLosslessBGR(
-            img.data, width, height, stride, &output);
+    vts::RawAtlas a;
+    for (const auto &image : images) {
+        a.add(encodeImage(image, RasterFormat::jpg, encoding));
     }
 
-    if (img.type() == CV_8UC4) {
+    const auto os(OutputBuffer::create());
+    a.serialize(*os);
+    return os;
+}
+
+} // namespace
 
-        outputSize = WebPEncodeLosslessBGRA(
-            img.data, width, height, stride, &output);
+void sendImage(const cv::Mat &image, const Sink::FileInfo &sfi
+               , RasterFormat format, bool atlas, Sink &sink
+               , const ImageEncoding &encoding)
+{
+    // solid-colour tiles are encoded only once
+    std::string key;
+    if (isUniform(image)) {
+        key = uniformKey(image, format, atlas, encoding);
+        if (const auto data = uniformCache.get(key)) {
+            return send(sink, sfi, data);
+        }
+    } else if (imageDump.limit) {
+        dump(image, format, atlas);
     }
 
-    // note that we use the BGR (not the RGB) variant.
-    // This is meant for normal maps.
+    if (atlas) {
+        // serialize as a single-image atlas
+        const auto os(serializeAtlas({ image }, sink, encoding));
+
+        if (!key.empty()) {
+            const auto data(std::make_shared<const std::string>
+                            (os->data(), os->size()));
+            uniformCache.put(key, data);
+            return send(sink, sfi, data);
+        }
 
-    if (outputSize == 0) {
-        throw utility::makeError<InternalError>("Failed to create WebP data");
+        sink.content(os, sfi);
+        return;
     }
 
-    buf.assign(output, output + outputSize);
+    // serialize as a raw image
+    const auto &buf([&]() -> const std::vector<unsigned char>&
+    {
+        const auto scope(sink.traceStage("encode"));
+        return encodeImage(image, format, encoding);
+    }());
+
+    if (!key.empty()) {
+        const auto data(std::make_shared<const std::string>
+                        (buf.begin(), buf.end()));
+        uniformCache.put(key, data);
+        return send(sink, sfi, data);
+    }
 
-    // cleanup
-    WebPFree(output);
+    sink.content(buf.data(), buf.size(), sfi, true);
 }
 
+void sendImage(const cv::Mat &image, const Palette &palette
+               , const Sink::FileInfo &sfi, RasterFormat format, bool atlas
+               , Sink &sink, const ImageEncoding &encoding)
+{
+    if (image.type() != CV_8UC1) {
+        return sendImage(image, sfi, format, atlas, sink, encoding);
+    }
 
+    if (atlas || (format != RasterFormat::png)) {
+        return sendImage(applyPalette(image, palette), sfi, format, atlas
+                         , sink, encoding);
+    }
 
-} // namespace
+    if (imageDump.limit) { dump(applyPalette(image, palette), format, false); }
 
+    const auto &buf([&]() -> const std::vector<unsigned char>&
+    {
+        const auto scope(sink.traceStage("encode"));
+        return encodePalettedPng(image, palette, encoding.pngCompression);
+    }());
 
-void sendImage(const cv::Mat &image, const Sink::FileInfo &sfi
-               , RasterFormat format, bool atlas, Sink &sink)
+    sink.content(buf.data(), buf.size(), sfi, true);
+}
+
+EncodedImage encodeTile(const cv::Mat &image, RasterFormat format, bool atlas
+                        , const ImageEncoding &encoding)
 {
     if (atlas) {
-        // serialize as a single-image atlas
-
-        // TODO: make quality configurable
-        vts::opencv::Atlas a(75);
-        a.add(image);
+        vts::RawAtlas a;
+        a.add(encodeImage(image, RasterFormat::jpg, encoding));
 
         std::ostringstream os;
         a.serialize(os);
-        sink.content(os.str(), sfi);
-        return;
+        return std::make_shared<const std::string>(os.str());
     }
 
-    // serialize as a raw image
-    std::vector<unsigned char> buf;
-    switch (format) {
-    case RasterFormat::jpg:
-        // TODO: make quality configurable
-        cv::imencode(".jpg", image, buf
-                     , { cv::IMWRITE_JPEG_QUALITY, 75 });
-        break;
-
-    case RasterFormat::png:
-        cv::imencode(".png", image, buf
-                     , { cv::IMWRITE_PNG_COMPRESSION, 9 });
-        break;
-
-    case RasterFormat::webp:
-        // meant for normal maps
-        encodeToWebP(image, buf);
-        break;
-    }
+    const auto &buf(encodeImage(image, format, encoding));
+    return std::make_shared<const std::string>(buf.begin(), buf.end());
+}
+
+void sendEncoded(const EncodedImage &image, const Sink::FileInfo &sfi
+                 , Sink &sink)
+{
+    send(sink, sfi, image);
+}
 
-    sink.content(buf, sfi);
+void dumpImages(const boost::filesystem::path &dir, std::size_t limit)
+{
+    boost::filesystem::create_directories(dir);
+    imageDump.dir = dir;
+    imageDump.limit = limit;
+
+    LOG(info3) << "Dumping up to " << limit << " sent images into "
+               << dir << ".";
+}
+
+void sendAtlas(const std::vector<cv::Mat> &images, const Sink::FileInfo &sfi
+               , Sink &sink, const ImageEncoding &encoding)
+{
+    if (images.empty()) {
+        utility::raise<InternalError>("No image to store in atlas.");
+    }
+    sink.content(serializeAtlas(images, sink, encoding), sfi);
 }
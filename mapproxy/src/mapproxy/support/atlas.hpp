@@ -27,15 +27,61 @@
 #ifndef mapproxy_support_atlas_hpp_included_
 #define mapproxy_support_atlas_hpp_included_
 
+#include <vector>
+#include <memory>
+#include <string>
+
+#include <boost/filesystem/path.hpp>
+
 #include <opencv2/core/core.hpp>
 
 #include "../resource.hpp"
 #include "../sink.hpp"
 
+#include "imgencode.hpp"
+#include "palette.hpp"
+
 /** Sends image from cv::Mat into sink in given format. If atlas is set it
  *  generates single-image VTS atlas (always JPEG).
  */
 void sendImage(const cv::Mat &image, const Sink::FileInfo &sfi
-               , RasterFormat format, bool atlas, Sink &sink);
+               , RasterFormat format, bool atlas, Sink &sink
+               , const ImageEncoding &encoding = ImageEncoding());
+
+/** Sends image of colour table indices. Plain PNG is sent as indexed PNG,
+ *  any other format gets palette expanded first. Images that are not single
+ *  channel (e.g. synthesized black tile) are sent as is.
+ */
+void sendImage(const cv::Mat &image, const Palette &palette
+               , const Sink::FileInfo &sfi, RasterFormat format, bool atlas
+               , Sink &sink, const ImageEncoding &encoding = ImageEncoding());
+
+/** Encoded image, shareable between responses.
+ */
+typedef std::shared_ptr<const std::string> EncodedImage;
+
+/** Encodes image exactly as sendImage would send it. Meant for images
+ *  that are sent over and over again.
+ */
+EncodedImage encodeTile(const cv::Mat &image, RasterFormat format, bool atlas
+                        , const ImageEncoding &encoding = ImageEncoding());
+
+/** Sends image encoded by encodeTile. Data are not copied.
+ */
+void sendEncoded(const EncodedImage &image, const Sink::FileInfo &sfi
+                 , Sink &sink);
+
+/** Sends images as multi-image VTS atlas, one JPEG page per image (in the
+ *  order of submeshes). Pages are encoded with encoding.jpegQuality.
+ */
+void sendAtlas(const std::vector<cv::Mat> &images, const Sink::FileInfo &sfi
+               , Sink &sink, const ImageEncoding &encoding = ImageEncoding());
+
+/** Debugging aid: every non-uniform image passed to sendImage is also
+ *  written as PNG (<seq>.<format>.png) into given directory before it is
+ *  encoded, at most limit images. Meant for recording corpora of real tiles
+ *  (see mapproxy-encoder-bench). To be called before serving starts.
+ */
+void dumpImages(const boost::filesystem::path &dir, std::size_t limit);
 
 #endif // mapproxy_support_atlas_hpp_included_
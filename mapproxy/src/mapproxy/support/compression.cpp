@@ -0,0 +1,112 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <boost/iostreams/filter/gzip.hpp>
+
+#include "dbglog/dbglog.hpp"
+
+#include "outbuffer.hpp"
+#include "compression.hpp"
+
+namespace bio = boost::iostreams;
+
+namespace compression {
+
+namespace {
+
+Options& current()
+{
+    static Options options;
+    return options;
+}
+
+} // namespace
+
+void configure(const Options &options)
+{
+    current() = options;
+
+    LOG(info1) << "Compression levels: mesh=" << options.mesh
+               << ", terrain=" << options.terrain
+               << ", metatile=" << options.metatile
+               << ", geodata=" << options.geodata
+               << ", document=" << options.document << ".";
+}
+
+const Options& options() { return current(); }
+
+int level(Target target)
+{
+    const auto &o(current());
+    switch (target) {
+    case Target::mesh: return o.mesh;
+    case Target::terrain: return o.terrain;
+    case Target::metatile: return o.metatile;
+    case Target::geodata: return o.geodata;
+    case Target::document: return o.document;
+    }
+    return bio::gzip::default_compression;
+}
+
+Gzipper::Gzipper(std::ostream &os, Target target)
+{
+    push(bio::gzip_compressor(bio::gzip_params(level(target))));
+    push(os);
+}
+
+Gzipper::~Gzipper()
+{
+    // closes the chain: writes gzip trailer into the underlying stream
+    reset();
+}
+
+void send(Sink &sink, Target target, const void *data, std::size_t size
+          , const Sink::FileInfo &stat, bool acceptGzip
+          , const std::shared_ptr<const void> &holder)
+{
+    if (!enabled(target)) {
+        sink.content(data, size, stat, holder);
+        return;
+    }
+
+    auto sfi(stat);
+    sfi.addHeader("Vary", "Accept-Encoding");
+    if (!acceptGzip) {
+        sink.content(data, size, sfi, holder);
+        return;
+    }
+
+    const auto os(OutputBuffer::create());
+    {
+        Gzipper gzipper(*os, target);
+        gzipper.write(static_cast<const char*>(data), size);
+    }
+
+    sfi.addHeader("Content-Encoding", "gzip");
+    sink.content(os, sfi);
+}
+
+} // namespace compression
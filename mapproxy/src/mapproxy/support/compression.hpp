@@ -0,0 +1,114 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef mapproxy_support_compression_hpp_included_
+#define mapproxy_support_compression_hpp_included_
+
+#include <iostream>
+
+#include <boost/iostreams/filtering_stream.hpp>
+
+#include "../sink.hpp"
+
+/** Gzip compression of generated content, level configurable per file type.
+ *
+ *  Levels are zlib's: 1 (fastest) to 9 (best), -1 zlib's default. Level 0 of
+ *  optional targets (metatiles, geodata) means content is sent plain, other
+ *  targets are always gzipped (level 0 stores data uncompressed).
+ *
+ *  Compressed responses are what response cache tiers store, i.e. content
+ *  is compressed once per cached response.
+ */
+namespace compression {
+
+enum class Target { mesh, terrain, metatile, geodata, document };
+
+struct Options {
+    /** Compressed meshes (see saveCompressedMesh).
+     */
+    int mesh;
+
+    /** Cesium terrain (quantized mesh) tiles.
+     */
+    int terrain;
+
+    /** Metatiles, sent gzipped to clients accepting it when not 0.
+     */
+    int metatile;
+
+    /** Heightcoded geodata tiles, sent gzipped to clients accepting it when
+     *  not 0.
+     */
+    int geodata;
+
+    /** Memoized documents (map configurations, layer definitions, styles).
+     */
+    int document;
+
+    Options()
+        : mesh(-1), terrain(-1), metatile(), geodata(), document(-1)
+    {}
+};
+
+/** Sets compression levels. Must be called before any request is served.
+ */
+void configure(const Options &options);
+
+const Options& options();
+
+int level(Target target);
+
+/** Optional target is compressed.
+ */
+inline bool enabled(Target target) { return level(target) != 0; }
+
+/** Gzipping output stream using target's compression level. Data are
+ *  flushed into the underlying stream on destruction.
+ */
+class Gzipper : public boost::iostreams::filtering_ostream {
+public:
+    Gzipper(std::ostream &os, Target target);
+    ~Gzipper();
+};
+
+/** Sends data gzipped if target is enabled and client accepts gzip, as is
+ *  otherwise.
+ *
+ *  \param sink sink to send to
+ *  \param target file type
+ *  \param data data to send
+ *  \param size size of data
+ *  \param stat file info (size is ignored)
+ *  \param acceptGzip client accepts gzipped content
+ *  \param holder keeps plain data alive until sent
+ */
+void send(Sink &sink, Target target, const void *data, std::size_t size
+          , const Sink::FileInfo &stat, bool acceptGzip
+          , const std::shared_ptr<const void> &holder);
+
+} // namespace compression
+
+#endif // mapproxy_support_compression_hpp_included_
@@ -24,6 +24,10 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <list>
+#include <string>
+#include <tuple>
+
 #include <opencv2/highgui/highgui.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 
@@ -35,6 +39,125 @@
 
 namespace vr = vtslibs::registry;
 
+namespace {
+
+/** Maximum number of cached reference frame node coverage masks.
+ */
+constexpr std::size_t RfCoverageCacheLimit(1024);
+
+/** Process-wide LRU cache of coverage masks of partial reference frame
+ *  nodes (polar caps, subtree boundaries); computing them means
+ *  rasterizing node's valid area. Thread safe.
+ */
+class RfCoverageCache {
+public:
+    typedef std::shared_ptr<const vts::NodeInfo::CoverageMask> CoverageMask;
+
+    typedef std::tuple<std::string, vts::TileId, vts::NodeInfo::CoverageType
+                       , int, int> Key;
+
+    CoverageMask get(const Key &key) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        auto findex(index_.find(key));
+        if (findex == index_.end()) { return {}; }
+        lru_.splice(lru_.begin(), lru_, findex->second);
+        return findex->second->second;
+    }
+
+    void put(const Key &key, const CoverageMask &mask) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (index_.count(key)) { return; }
+
+        lru_.emplace_front(key, mask);
+        index_.insert(Index::value_type(key, lru_.begin()));
+
+        while (lru_.size() > RfCoverageCacheLimit) {
+            index_.erase(lru_.back().first);
+            lru_.pop_back();
+        }
+    }
+
+private:
+    typedef std::list<std::pair<Key, CoverageMask>> List;
+    typedef std::map<Key, List::iterator> Index;
+
+    std::mutex mutex_;
+    List lru_;
+    Index index_;
+};
+
+/** Coverage mask of reference frame node, dilated by 1. Masks of partial
+ *  nodes are cached, full nodes are cheap.
+ */
+vts::NodeInfo::CoverageMask
+rfCoverage(const vts::NodeInfo &nodeInfo, vts::NodeInfo::CoverageType type
+           , const math::Size2 &gridSize)
+{
+    if (!nodeInfo.partial()) {
+        return nodeInfo.coverageMask(type, gridSize, 1);
+    }
+
+    static RfCoverageCache cache;
+
+    const RfCoverageCache::Key key
+        (nodeInfo.referenceFrame().id, nodeInfo.nodeId(), type
+         , gridSize.width, gridSize.height);
+
+    if (const auto cached = cache.get(key)) { return *cached; }
+
+    auto coverage(nodeInfo.coverageMask(type, gridSize, 1));
+    cache.put(key, std::make_shared<const vts::NodeInfo::CoverageMask>
+              (coverage));
+    return coverage;
+}
+
+} // namespace
+
+MaskTreeCoverage maskTreeCoverage(const MaskTree &maskTree, vts::Lod lod
+                                  , std::int64_t x, std::int64_t y
+                                  , int size)
+{
+    MaskTreeCoverage coverage(std::uint64_t(size) * size);
+
+    // clip sampling depth
+    int depth(std::min(int(lod), int(maskTree.depth())));
+
+    // bit shift; NB: can be negative!
+    int shift(maskTree.depth() - depth);
+
+    // setup constraints
+    MaskTree::Constraints con(depth);
+    con.extents.ll(0) = applyShift(x, shift);
+    con.extents.ll(1) = applyShift(y, shift);
+    con.extents.ur(0) = applyShift(x + size, shift);
+    con.extents.ur(1) = applyShift(y + size, shift);
+
+    maskTree.forEachQuad([&](MaskTree::Node node, boost::tribool value)
+    {
+        // black -> nothing
+        if (!value) { return; }
+
+        // update to match level grid
+        node.shift(shift);
+
+        // intersect with window
+        const auto x1(std::max<std::int64_t>(node.x, x));
+        const auto y1(std::max<std::int64_t>(node.y, y));
+        const auto x2(std::min<std::int64_t>(node.x + node.size, x + size));
+        const auto y2(std::min<std::int64_t>(node.y + node.size, y + size));
+        if ((x2 <= x1) || (y2 <= y1)) { return; }
+
+        const std::uint64_t area((x2 - x1) * (y2 - y1));
+        if (value) {
+            coverage.white += area;
+        } else {
+            coverage.gray += area;
+        }
+    }, con);
+
+    return coverage;
+}
+
 vts::NodeInfo::CoverageMask
 generateCoverage(const int size, const vts::NodeInfo &nodeInfo
                  , const MaskTree &maskTree
@@ -47,10 +170,10 @@ generateCoverage(const int size, const vts::NodeInfo &nodeInfo
         (size + (type == vts::NodeInfo::CoverageType::grid)
          , size + (type == vts::NodeInfo::CoverageType::grid));
     // dilate by 1
-    auto coverage(nodeInfo.coverageMask(type, gridSize, 1));
+    auto coverage(rfCoverage(nodeInfo, type, gridSize));
 
-    if (!maskTree) {
-        // no mask to apply
+    if (!maskTree || coverage.empty()) {
+        // no mask to apply or nothing the mask could remove
         return coverage;
     }
 
@@ -92,6 +215,32 @@ generateCoverage(const int size, const vts::NodeInfo &nodeInfo
     // scale in x and y coordinates
     const double scale(double(ws) / double(size));
 
+    {
+        // shortcuts for uniform neighbourhood, no need to rasterize anything
+        const std::int64_t wx((std::int64_t(nodeInfo.nodeId().x) << detail)
+                              - margin);
+        const std::int64_t wy((std::int64_t(nodeInfo.nodeId().y) << detail)
+                              - margin);
+
+        // fully covered window stays covered after dilation
+        if (maskTreeCoverage(maskTree, tileId.lod, wx, wy, ts).covered()) {
+            return coverage;
+        }
+
+        // quads dilate by scale: check window grown accordingly
+        const int grow(int(std::ceil(scale)) + 1);
+        if (maskTreeCoverage(maskTree, tileId.lod, wx - grow, wy - grow
+                             , ts + 2 * grow).empty())
+        {
+            for (int j(0); j < gridSize.height; ++j) {
+                for (int i(0); i < gridSize.width; ++i) {
+                    coverage.set(i, j, false);
+                }
+            }
+            return coverage;
+        }
+    }
+
     cv::Mat tile(ts, ts, CV_8UC1, cv::Scalar(0x00));
     {
         // bit shift; NB: can be negative!
@@ -249,3 +398,38 @@ cv::Mat boundlayerMask(const vts::TileId &coarseTileId
 
     return mask;
 }
+
+MaskTreeCoverage boundlayerMaskCoverage(const vts::TileId &tileId
+                                        , const MaskTree &maskTree)
+{
+    return maskTreeCoverage
+        (maskTree, tileId.lod + vr::BoundLayer::binaryOrder
+         , std::int64_t(tileId.x) << vr::BoundLayer::binaryOrder
+         , std::int64_t(tileId.y) << vr::BoundLayer::binaryOrder
+         , vr::BoundLayer::tileWidth);
+}
+
+MaskTileCache::Data MaskTileCache::get(const vts::TileId &tileId) const
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto fdata(data_.find(tileId));
+    if (fdata == data_.end()) { return {}; }
+    return fdata->second;
+}
+
+void MaskTileCache::put(const vts::TileId &tileId, const Data &data)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (data_.size() >= limit_) { data_.clear(); }
+    data_[tileId] = data;
+}
+
+std::size_t MaskTileCache::memory() const
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    std::size_t size(0);
+    for (const auto &item : data_) {
+        if (item.second) { size += item.second->size(); }
+    }
+    return size;
+}
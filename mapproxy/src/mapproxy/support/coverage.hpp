@@ -28,6 +28,12 @@
 #define mapproxy_support_coverage_hpp_included_
 
 
+#include <map>
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <cstdint>
+
 #include "vts-libs/vts/nodeinfo.hpp"
 #include "imgproc/rastermask/mappedqtree.hpp"
 
@@ -35,6 +41,45 @@ namespace vts = vtslibs::vts;
 
 typedef imgproc::mappedqtree::RasterMask MaskTree;
 
+/** Coverage of square window by mask tree, computed from tree quads
+ *  without rasterizing anything. Areas are in window pixels.
+ */
+struct MaskTreeCoverage {
+    /** Window area.
+     */
+    std::uint64_t total;
+
+    /** Area covered by white (watertight) quads.
+     */
+    std::uint64_t white;
+
+    /** Area covered by gray (partially valid) quads.
+     */
+    std::uint64_t gray;
+
+    MaskTreeCoverage(std::uint64_t total = 0)
+        : total(total), white(), gray() {}
+
+    /** Nothing drawn.
+     */
+    bool empty() const { return !white && !gray; }
+
+    /** Whole window drawn (gray quads are drawn as well).
+     */
+    bool covered() const { return (white + gray) == total; }
+
+    /** Whole window watertight.
+     */
+    bool watertight() const { return white == total; }
+};
+
+/** Measures coverage of size x size pixel window at given lod whose upper
+ *  left corner is pixel (x, y).
+ */
+MaskTreeCoverage maskTreeCoverage(const MaskTree &maskTree, vts::Lod lod
+                                  , std::int64_t x, std::int64_t y
+                                  , int size);
+
 /** Complex converage, used for surface mask.
  */
 vts::NodeInfo::CoverageMask
@@ -47,6 +92,34 @@ generateCoverage(const int size, const vts::NodeInfo &nodeInfo
  */
 cv::Mat boundlayerMask(const vts::TileId &tileId, const MaskTree &maskTree);
 
+/** Coverage of boundlayer mask of given tile.
+ */
+MaskTreeCoverage boundlayerMaskCoverage(const vts::TileId &tileId
+                                        , const MaskTree &maskTree);
+
+/** Small cache of encoded (partial) boundlayer masks; mask trees are static
+ *  per resource. Bounded; forgets everything when full. Thread safe.
+ */
+class MaskTileCache {
+public:
+    typedef std::shared_ptr<const std::vector<unsigned char>> Data;
+
+    MaskTileCache(std::size_t limit) : limit_(limit) {}
+
+    Data get(const vts::TileId &tileId) const;
+
+    void put(const vts::TileId &tileId, const Data &data);
+
+    /** Bytes of cached mask tiles.
+     */
+    std::size_t memory() const;
+
+private:
+    const std::size_t limit_;
+    mutable std::mutex mutex_;
+    std::map<vts::TileId, Data> data_;
+};
+
 /** Helper for positive/negative bit shift
  */
 template <typename T>
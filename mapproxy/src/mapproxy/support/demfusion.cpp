@@ -0,0 +1,164 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <memory>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include <gdal.h>
+#include <gdal_utils.h>
+#include <ogr_srs_api.h>
+#include <cpl_string.h>
+#include <cpl_error.h>
+
+#include "dbglog/dbglog.hpp"
+
+#include "utility/path.hpp"
+
+#include "../error.hpp"
+
+#include "demfusion.hpp"
+
+namespace fs = boost::filesystem;
+
+namespace {
+
+/** GDAL argument vector holder.
+ */
+class Argv {
+public:
+    Argv() : argv_() {}
+    ~Argv() { ::CSLDestroy(argv_); }
+
+    operator char**() const { return argv_; }
+
+    template <typename T>
+    Argv& operator()(const T &value) {
+        argv_ = ::CSLAddString
+            (argv_, boost::lexical_cast<std::string>(value).c_str());
+        return *this;
+    }
+
+private:
+    char **argv_;
+};
+
+typedef std::unique_ptr<void, void(*)(void*)> Dataset;
+
+Dataset openDataset(const std::string &path)
+{
+    return Dataset(::GDALOpenEx(path.c_str()
+                                , (GDAL_OF_RASTER | GDAL_OF_READONLY)
+                                , nullptr, nullptr, nullptr)
+                   , [](void *ds) { if (ds) { ::GDALClose(ds); } });
+}
+
+typedef std::unique_ptr<void, void(*)(void*)> Srs;
+
+Srs datasetSrs(void *ds)
+{
+    const char *wkt(::GDALGetProjectionRef(ds));
+    return Srs(((wkt && *wkt) ? ::OSRNewSpatialReference(wkt) : nullptr)
+               , [](void *srs)
+               {
+                   if (srs) { ::OSRDestroySpatialReference(srs); }
+               });
+}
+
+} // namespace
+
+bool fuseDems(const std::vector<std::string> &datasets
+              , const std::string &dst)
+{
+    LOG(info2) << "Fusing " << datasets.size() << " DEMs into " << dst
+               << ".";
+
+    std::vector<Dataset> opened;
+    for (const auto &src : datasets) {
+        opened.push_back(openDataset(src));
+        if (!opened.back()) {
+            LOGTHROW(err2, IOError)
+                << "Unable to open DEM " << src << ": <"
+                << ::CPLGetLastErrorMsg() << ">.";
+        }
+    }
+
+    // mosaic cannot mix SRSs
+    const auto srs(datasetSrs(opened.front().get()));
+    if (!srs) { return false; }
+    for (std::size_t i(1); i < opened.size(); ++i) {
+        const auto other(datasetSrs(opened[i].get()));
+        if (!other || !::OSRIsSame(srs.get(), other.get())) {
+            LOG(info2) << "DEM " << datasets[i] << " SRS differs from "
+                       << datasets.front() << "; not fusing.";
+            return false;
+        }
+    }
+
+    Argv argv;
+    argv("-resolution")("highest")("-r")("nearest");
+
+    std::unique_ptr< ::GDALBuildVRTOptions
+                     , void(*)(::GDALBuildVRTOptions*)>
+        options(::GDALBuildVRTOptionsNew(argv, nullptr)
+                , &::GDALBuildVRTOptionsFree);
+    if (!options) {
+        LOGTHROW(err2, InternalError)
+            << "Invalid VRT options: <" << ::CPLGetLastErrorMsg() << ">.";
+    }
+
+    // last source wins in the mosaic -> reverse priority order
+    std::vector< ::GDALDatasetH> srcDs;
+    for (auto iopened(opened.rbegin()), eopened(opened.rend());
+         iopened != eopened; ++iopened)
+    {
+        srcDs.push_back(iopened->get());
+    }
+
+    const fs::path dstPath(dst);
+    fs::create_directories(dstPath.parent_path());
+    const auto tmpPath(utility::addExtension(dstPath, ".tmp"));
+
+    int usageError(false);
+    Dataset out(::GDALBuildVRT(tmpPath.c_str(), int(srcDs.size())
+                               , srcDs.data(), nullptr, options.get()
+                               , &usageError)
+                , [](void *ds) { if (ds) { ::GDALClose(ds); } });
+    if (!out) {
+        boost::system::error_code ec;
+        fs::remove(tmpPath, ec);
+        LOGTHROW(err2, IOError)
+            << "Unable to fuse DEMs into " << dst << ": <"
+            << ::CPLGetLastErrorMsg() << ">.";
+    }
+
+    // flush and move into place
+    out.reset();
+    fs::rename(tmpPath, dstPath);
+    return true;
+}
@@ -0,0 +1,266 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <memory>
+#include <vector>
+#include <algorithm>
+
+#include <boost/filesystem.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include <gdal.h>
+#include <gdal_alg.h>
+#include <gdal_utils.h>
+#include <cpl_string.h>
+#include <cpl_error.h>
+
+#include "dbglog/dbglog.hpp"
+
+#include "utility/path.hpp"
+
+#include "geo/geodataset.hpp"
+
+#include "../error.hpp"
+
+#include "demgeoid.hpp"
+
+namespace fs = boost::filesystem;
+
+namespace {
+
+/** GDAL argument vector holder.
+ */
+class Argv {
+public:
+    Argv() : argv_() {}
+    ~Argv() { ::CSLDestroy(argv_); }
+
+    operator char**() const { return argv_; }
+
+    template <typename T>
+    Argv& operator()(const T &value) {
+        argv_ = ::CSLAddString
+            (argv_, boost::lexical_cast<std::string>(value).c_str());
+        return *this;
+    }
+
+private:
+    char **argv_;
+};
+
+typedef std::unique_ptr<void, void(*)(void*)> Dataset;
+
+Dataset openDataset(const std::string &path)
+{
+    return Dataset(::GDALOpenEx(path.c_str()
+                                , (GDAL_OF_RASTER | GDAL_OF_READONLY)
+                                , nullptr, nullptr, nullptr)
+                   , [](void *ds) { if (ds) { ::GDALClose(ds); } });
+}
+
+/** Builds overviews down to a single 256x256 block.
+ */
+void buildOverviews(void *ds, const char *resampling = "AVERAGE")
+{
+    std::vector<int> factors;
+    int size(std::max(::GDALGetRasterXSize(ds), ::GDALGetRasterYSize(ds)));
+    for (int factor(2); (size /= 2) >= 256; factor *= 2) {
+        factors.push_back(factor);
+    }
+    if (factors.empty()) { return; }
+
+    if (::GDALBuildOverviews(ds, resampling, int(factors.size())
+                             , factors.data(), 0, nullptr
+                             , nullptr, nullptr) != CE_None)
+    {
+        LOGTHROW(err2, IOError)
+            << "Unable to build overviews: <" << ::CPLGetLastErrorMsg()
+            << ">.";
+    }
+}
+
+/** Translates source dataset into a tiled GeoTIFF, throws on failure.
+ */
+Dataset translate(void *src, const std::string &srcPath
+                  , const fs::path &dst, const Argv &argv)
+{
+    std::unique_ptr< ::GDALTranslateOptions
+                    , void(*)(::GDALTranslateOptions*)>
+        options(::GDALTranslateOptionsNew(argv, nullptr)
+                , &::GDALTranslateOptionsFree);
+    if (!options) {
+        LOGTHROW(err2, InternalError)
+            << "Invalid translate options: <" << ::CPLGetLastErrorMsg()
+            << ">.";
+    }
+
+    int usageError(false);
+    Dataset out(::GDALTranslate(dst.c_str(), src, options.get()
+                                , &usageError)
+                , [](void *ds) { if (ds) { ::GDALClose(ds); } });
+    if (!out) {
+        boost::system::error_code ec;
+        fs::remove(dst, ec);
+        LOGTHROW(err2, IOError)
+            << "Unable to copy DEM " << srcPath << ": <"
+            << ::CPLGetLastErrorMsg() << ">.";
+    }
+    return out;
+}
+
+} // namespace
+
+const char *DemValiditySuffix = ".valid";
+
+void bakeGeoid(const std::string &src, const std::string &geoidGrid
+               , const std::string &dst)
+{
+    LOG(info2) << "Baking geoid grid <" << geoidGrid << "> into DEM "
+               << src << " -> " << dst << ".";
+
+    // source grid and SRS; heights of source are above the geoid, target
+    // SRS is the same sans the vertical datum -> GDAL applies the shift
+    const auto info(geo::GeoDataset::open(src));
+    const auto &extents(info.extents());
+    const auto size(info.size());
+    const auto dstSrs(info.srs());
+    const auto srcSrs(geo::setGeoid(dstSrs, geoidGrid));
+
+    auto ds(openDataset(src));
+    if (!ds) {
+        LOGTHROW(err2, IOError)
+            << "Unable to open DEM " << src << ": <"
+            << ::CPLGetLastErrorMsg() << ">.";
+    }
+
+    Argv argv;
+    argv("-s_srs")(srcSrs.toString())("-t_srs")(dstSrs.toString())
+        ("-te")(extents.ll(0))(extents.ll(1))(extents.ur(0))(extents.ur(1))
+        ("-ts")(size.width)(size.height)
+        ("-r")("near")("-et")(0)("-ot")("Float32")
+        ("-overwrite")
+#if GDAL_VERSION_NUM >= GDAL_COMPUTE_VERSION(3, 1, 0)
+        ("-of")("COG")
+        ("-co")("COMPRESS=DEFLATE")("-co")("PREDICTOR=YES")
+        ("-co")("OVERVIEW_RESAMPLING=AVERAGE")
+#else
+        ("-of")("GTiff")
+        ("-co")("TILED=YES")("-co")("COMPRESS=DEFLATE")
+        ("-co")("PREDICTOR=3")
+#endif
+        ;
+
+    std::unique_ptr< ::GDALWarpAppOptions, void(*)(::GDALWarpAppOptions*)>
+        options(::GDALWarpAppOptionsNew(argv, nullptr)
+                , &::GDALWarpAppOptionsFree);
+    if (!options) {
+        LOGTHROW(err2, InternalError)
+            << "Invalid warp options: <" << ::CPLGetLastErrorMsg() << ">.";
+    }
+
+    const fs::path dstPath(dst);
+    fs::create_directories(dstPath.parent_path());
+    const auto tmpPath(utility::addExtension(dstPath, ".tmp"));
+
+    ::GDALDatasetH srcDs(ds.get());
+    int usageError(false);
+    Dataset out(::GDALWarp(tmpPath.c_str(), nullptr, 1, &srcDs
+                           , options.get(), &usageError)
+                , [](void *ds) { if (ds) { ::GDALClose(ds); } });
+    if (!out) {
+        boost::system::error_code ec;
+        fs::remove(tmpPath, ec);
+        LOGTHROW(err2, IOError)
+            << "Unable to bake geoid into DEM " << src << ": <"
+            << ::CPLGetLastErrorMsg() << ">.";
+    }
+
+#if GDAL_VERSION_NUM < GDAL_COMPUTE_VERSION(3, 1, 0)
+    buildOverviews(out.get());
+#endif
+
+    // flush and move into place
+    out.reset();
+    fs::rename(tmpPath, dstPath);
+}
+
+void fillDemGaps(const std::string &src, unsigned int maxDistance
+                 , const std::string &dst)
+{
+    LOG(info2) << "Filling gaps (up to " << maxDistance << " px) in DEM "
+               << src << " -> " << dst << ".";
+
+    auto ds(openDataset(src));
+    if (!ds) {
+        LOGTHROW(err2, IOError)
+            << "Unable to open DEM " << src << ": <"
+            << ::CPLGetLastErrorMsg() << ">.";
+    }
+
+    const fs::path dstPath(dst);
+    const fs::path validPath(dst + DemValiditySuffix);
+    fs::create_directories(dstPath.parent_path());
+    const auto tmpPath(utility::addExtension(dstPath, ".tmp"));
+    const auto tmpValidPath(utility::addExtension(validPath, ".tmp"));
+
+    // validity: source mask band, no data outside
+    {
+        Argv argv;
+        argv("-of")("GTiff")("-b")("mask")("-ot")("Byte")("-a_nodata")(0)
+            ("-co")("TILED=YES")("-co")("COMPRESS=DEFLATE");
+        auto out(translate(ds.get(), src, tmpValidPath, argv));
+        buildOverviews(out.get(), "NEAREST");
+    }
+
+    // heights, filled in place
+    {
+        Argv argv;
+        argv("-of")("GTiff")("-b")(1)("-ot")("Float32")
+            ("-co")("TILED=YES")("-co")("COMPRESS=DEFLATE")
+            ("-co")("PREDICTOR=3")("-co")("BIGTIFF=IF_SAFER");
+        auto out(translate(ds.get(), src, tmpPath, argv));
+
+        // band's own validity mask drives the fill
+        if (::GDALFillNodata(::GDALGetRasterBand(out.get(), 1), nullptr
+                             , maxDistance, 0, 0, nullptr
+                             , nullptr, nullptr) != CE_None)
+        {
+            out.reset();
+            boost::system::error_code ec;
+            fs::remove(tmpPath, ec);
+            fs::remove(tmpValidPath, ec);
+            LOGTHROW(err2, IOError)
+                << "Unable to fill gaps in DEM " << src << ": <"
+                << ::CPLGetLastErrorMsg() << ">.";
+        }
+
+        buildOverviews(out.get());
+    }
+
+    // move into place, DEM last
+    fs::rename(tmpValidPath, validPath);
+    fs::rename(tmpPath, dstPath);
+}
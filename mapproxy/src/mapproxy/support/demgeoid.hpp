@@ -0,0 +1,62 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef mapproxy_support_demgeoid_hpp_included_
+#define mapproxy_support_demgeoid_hpp_included_
+
+#include <string>
+
+/** Writes a copy of DEM dataset with geoid undulation from given grid added
+ *  to its heights, i.e. heights above the ellipsoid. Output is a
+ *  Cloud-Optimized GeoTIFF (tiled GeoTIFF with overviews on GDAL < 3.1) in
+ *  the same grid and horizontal SRS as the source.
+ *
+ *  Output is written to a temporary file that is moved into place once
+ *  complete. Throws on failure.
+ */
+void bakeGeoid(const std::string &src, const std::string &geoidGrid
+               , const std::string &dst);
+
+/** Suffix of validity mask dataset written by fillDemGaps.
+ */
+extern const char *DemValiditySuffix;
+
+/** Writes a gap-filled copy of DEM dataset: no-data pixels up to
+ *  maxDistance pixels away from valid data (holes as well as the area
+ *  around the dataset's edges) are interpolated from their neighbourhood
+ *  (GDAL's fillnodata). Output is a tiled GeoTIFF with overviews in the same
+ *  grid and horizontal SRS as the source.
+ *
+ *  Original validity is written alongside as a single band byte dataset
+ *  (dst + DemValiditySuffix, 255 = valid, 0 = no data).
+ *
+ *  Outputs are written to temporary files that are moved into place once
+ *  complete (DEM last). Throws on failure.
+ */
+void fillDemGaps(const std::string &src, unsigned int maxDistance
+                 , const std::string &dst);
+
+#endif // mapproxy_support_demgeoid_hpp_included_
@@ -62,6 +62,14 @@ public:
     void setStaleWhileRevalidate(FileClass fc, std::time_t value);
     std::time_t getStaleWhileRevalidate(FileClass fc) const;
 
+    bool operator==(const FileClassSettings &o) const {
+        return ((maxAges_ == o.maxAges_)
+                && (staleWhileRevalidate_ == o.staleWhileRevalidate_));
+    }
+    bool operator!=(const FileClassSettings &o) const {
+        return !operator==(o);
+    }
+
 private:
     Times maxAges_;
     Times staleWhileRevalidate_;
@@ -0,0 +1,117 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <unistd.h>
+#include <sys/inotify.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+
+#include "dbglog/dbglog.hpp"
+
+#include "filewatch.hpp"
+
+namespace fs = boost::filesystem;
+
+namespace {
+
+const std::uint32_t WatchMask
+    (IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_MOVED_FROM | IN_MOVED_TO
+     | IN_CREATE | IN_DELETE | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR);
+
+} // namespace
+
+FileWatch::FileWatch()
+    : fd_(::inotify_init1(IN_NONBLOCK | IN_CLOEXEC)), broken_(false)
+{
+    if (fd_ < 0) {
+        LOG(warn2) << "Unable to initialize inotify: <"
+                   << std::strerror(errno) << ">; watching disabled.";
+        broken_ = true;
+    }
+}
+
+FileWatch::~FileWatch()
+{
+    if (fd_ >= 0) { ::close(fd_); }
+}
+
+void FileWatch::watch(const fs::path &dir)
+{
+    if (broken_ || watches_.count(dir)) { return; }
+
+    const auto wd(::inotify_add_watch(fd_, dir.c_str(), WatchMask));
+    if (wd < 0) {
+        LOG(warn2) << "Unable to watch directory " << dir << ": <"
+                   << std::strerror(errno) << ">; watching disabled.";
+        broken_ = true;
+        return;
+    }
+
+    watches_.insert({ dir, wd });
+}
+
+bool FileWatch::changed()
+{
+    if (broken_) { return true; }
+
+    bool changed(false);
+    alignas(struct inotify_event) char buf[4096];
+    for (;;) {
+        const auto bytes(::read(fd_, buf, sizeof(buf)));
+        if (bytes < 0) {
+            if (errno == EINTR) { continue; }
+            if ((errno != EAGAIN) && (errno != EWOULDBLOCK)) {
+                LOG(warn2) << "Unable to read inotify events: <"
+                           << std::strerror(errno) << ">; watching disabled.";
+                broken_ = true;
+                return true;
+            }
+            break;
+        }
+        if (!bytes) { break; }
+
+        changed = true;
+        for (const char *p(buf); p < buf + bytes; ) {
+            const auto *event(reinterpret_cast<const inotify_event*>(p));
+            if (event->mask & IN_IGNORED) {
+                // directory gone, watch again when seen next time
+                for (auto iwatches(watches_.begin());
+                     iwatches != watches_.end(); ++iwatches)
+                {
+                    if (iwatches->second == event->wd) {
+                        watches_.erase(iwatches);
+                        break;
+                    }
+                }
+            }
+            p += sizeof(inotify_event) + event->len;
+        }
+    }
+
+    return changed;
+}
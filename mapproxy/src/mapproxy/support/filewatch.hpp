@@ -0,0 +1,65 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef mapproxy_support_filewatch_hpp_included_
+#define mapproxy_support_filewatch_hpp_included_
+
+#include <map>
+
+#include <boost/noncopyable.hpp>
+#include <boost/filesystem/path.hpp>
+
+/** Watches directories for changes (inotify). Lets a caller skip rescanning
+ *  files nobody touched.
+ *
+ *  Watching is best effort: if inotify is not available or a watch cannot be
+ *  established changed() always returns true.
+ */
+class FileWatch : boost::noncopyable {
+public:
+    FileWatch();
+    ~FileWatch();
+
+    /** Starts watching given directory (no-op if already watched).
+     */
+    void watch(const boost::filesystem::path &dir);
+
+    /** Makes changed() always return true, for things that cannot be watched.
+     */
+    void giveUp() { broken_ = true; }
+
+    /** Drains pending events. Returns true if anything happened in watched
+     *  directories since last call or if watching does not work.
+     */
+    bool changed();
+
+private:
+    int fd_;
+    bool broken_;
+    std::map<boost::filesystem::path, int> watches_;
+};
+
+#endif // mapproxy_support_filewatch_hpp_included_
@@ -24,6 +24,15 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <cmath>
+#include <map>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <utility>
+
+#include <ogr_spatialref.h>
+
 #include "math/math.hpp"
 
 #include "geo/csconvertor.hpp"
@@ -36,12 +45,55 @@ namespace ublas = boost::numeric::ublas;
 namespace vts = vtslibs::vts;
 
 
+namespace {
+
+/** Returns convertor between given SRS from per-thread cache. Building
+ *  coordinate transformation (parsing both SRS definitions, setting up PROJ
+ *  pipeline) is far more expensive than the handful of points converted per
+ *  tile; GDAL workers see the same few SRS pairs over and over.
+ *
+ *  Cache is per thread since OGR coordinate transformation must not be used
+ *  concurrently.
+ */
+geo::CsConvertor& convertor(const geo::SrsDefinition &src
+                            , const geo::SrsDefinition &dst)
+{
+    typedef std::pair<std::string, std::string> Key;
+    typedef std::map<Key, geo::CsConvertor> Cache;
+
+    // there are just a few SRS in any configuration, this limit is only a
+    // safety net against unbounded growth
+    constexpr std::size_t Limit(64);
+
+    thread_local Cache cache;
+
+    const auto str([](const geo::SrsDefinition &srs) -> std::string
+    {
+        std::ostringstream os;
+        os << srs;
+        return os.str();
+    });
+
+    Key key(str(src), str(dst));
+    auto fcache(cache.find(key));
+    if (fcache != cache.end()) { return fcache->second; }
+
+    if (cache.size() >= Limit) { cache.clear(); }
+
+    return cache.emplace(std::piecewise_construct
+                         , std::forward_as_tuple(std::move(key))
+                         , std::forward_as_tuple(src, dst))
+        .first->second;
+}
+
+} // namespace
+
 double tileCircumference(const math::Extents2 &extents
                          , const geo::SrsDefinition &srs
                          , const geo::GeoDataset &dataset
                          , int samples)
 {
-    geo::CsConvertor conv(srs, dataset.srs());
+    auto &conv(convertor(srs, dataset.srs()));
 
     auto es(math::size(extents));
     math::Size2f step(es.width / samples, es.height / samples);
@@ -86,6 +138,36 @@ double tileCircumference(const math::Extents2 &extents
 }
 
 
+EffectiveGsd effectiveGsd(const geo::GeoDataset &dataset)
+{
+    const auto md(dataset.getMetadata("vts"));
+    if (const auto effectiveGSD = md.get<double>("effectiveGSD")) {
+        return { *effectiveGSD * *effectiveGSD, false };
+    }
+
+    const auto &descriptor(dataset.descriptor());
+    auto esize(math::size(descriptor.extents));
+
+    // geographic coordinates system -> convert degrees to meters
+    // TODO: compute length of arc between extents.ll(1) and extents.ur(1)
+    // on the ellipsoid; for now, use same calculation as on the equator
+    const auto scale(srsUnitScale(descriptor.srs));
+    esize.width *= scale;
+    esize.height *= scale;
+
+    const math::Size2f px(esize.width / descriptor.size.width
+                          , esize.height / descriptor.size.height);
+
+    return { math::area(px), true };
+}
+
+double srsUnitScale(const geo::SrsDefinition &srs)
+{
+    const auto ref(srs.reference());
+    if (!ref.IsGeographic()) { return 1.0; }
+    return ref.GetSemiMajor() * M_PI / 180.0;
+}
+
 math::Extents2 extentsPlusHalfPixel(const math::Extents2 &extents
                                     , const math::Size2 &pixels)
 {
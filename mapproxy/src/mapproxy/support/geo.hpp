@@ -73,6 +73,24 @@ double tileCircumference(const math::Extents2 &extents
                          , const geo::GeoDataset &dataset
                          , int samples = 20);
 
+/** Effective ground sample distance of a dataset as area of one pixel in m2.
+ */
+struct EffectiveGsd {
+    double area;
+
+    /** Computed from dataset extents and size (false: configured as
+     *  "effectiveGSD" in the "vts" metadata domain).
+     */
+    bool computed;
+};
+
+EffectiveGsd effectiveGsd(const geo::GeoDataset &dataset);
+
+/** Meters per unit of given SRS. Geographic SRS is measured at the equator,
+ *  i.e. same simplification as in effectiveGsd.
+ */
+double srsUnitScale(const geo::SrsDefinition &srs);
+
 math::Extents2 extentsPlusHalfPixel(const math::Extents2 &extents
                                     , const math::Size2 &pixels);
 
@@ -0,0 +1,569 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cstdio>
+#include <cstdint>
+#include <memory>
+#include <algorithm>
+#include <stdexcept>
+
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <jpeglib.h>
+#include <webp/encode.h>
+
+#ifdef MAPPROXY_HAS_AVIF
+#  include <avif/avif.h>
+#endif
+
+#ifdef MAPPROXY_HAS_JXL
+#  include <jxl/encode.h>
+#endif
+
+#include "dbglog/dbglog.hpp"
+#include "utility/raise.hpp"
+
+#include "jsoncpp/json.hpp"
+#include "jsoncpp/as.hpp"
+
+#include "../error.hpp"
+
+#include "ktx2.hpp"
+#include "scratch.hpp"
+#include "probes.hpp"
+#include "imgencode.hpp"
+
+namespace {
+
+/** Initial size of scratch buffer.
+ */
+constexpr std::size_t InitialBufferSize(1 << 16);
+
+/** JPEG destination writing into a scratch buffer, grows as needed.
+ */
+struct JpegDestination : jpeg_destination_mgr {
+    std::vector<unsigned char> *buf;
+
+    JpegDestination(std::vector<unsigned char> &buf) : buf(&buf) {
+        init_destination = &JpegDestination::init;
+        empty_output_buffer = &JpegDestination::empty;
+        term_destination = &JpegDestination::term;
+    }
+
+    static JpegDestination& self(j_compress_ptr cinfo) {
+        return *static_cast<JpegDestination*>(cinfo->dest);
+    }
+
+    static void init(j_compress_ptr cinfo) {
+        auto &d(self(cinfo));
+        // keep already allocated memory
+        d.buf->resize(std::max(d.buf->capacity(), InitialBufferSize));
+        d.next_output_byte = d.buf->data();
+        d.free_in_buffer = d.buf->size();
+    }
+
+    static boolean empty(j_compress_ptr cinfo) {
+        auto &d(self(cinfo));
+        // libjpeg requires the whole buffer to be flushed here
+        const auto used(d.buf->size());
+        d.buf->resize(2 * used);
+        d.next_output_byte = d.buf->data() + used;
+        d.free_in_buffer = d.buf->size() - used;
+        return TRUE;
+    }
+
+    static void term(j_compress_ptr cinfo) {
+        auto &d(self(cinfo));
+        d.buf->resize(d.buf->size() - d.free_in_buffer);
+    }
+};
+
+struct JpegError : std::runtime_error {
+    JpegError(const std::string &message) : std::runtime_error(message) {}
+};
+
+void jpegErrorExit(j_common_ptr cinfo)
+{
+    char message[JMSG_LENGTH_MAX];
+    (*cinfo->err->format_message)(cinfo, message);
+    throw JpegError(message);
+}
+
+void encodeJpeg(const cv::Mat &image, int quality
+                , std::vector<unsigned char> &buf)
+{
+#ifdef JCS_EXTENSIONS
+    // libjpeg-turbo: compress BGR directly
+    const bool bgr(image.type() == CV_8UC3);
+#else
+    const bool bgr(false);
+#endif
+
+    if (!bgr && (image.type() != CV_8UC1)) {
+        // no direct path, let OpenCV convert this
+        cv::imencode(".jpg", image, buf
+                     , { cv::IMWRITE_JPEG_QUALITY, quality });
+        return;
+    }
+
+    jpeg_compress_struct cinfo;
+    jpeg_error_mgr jerr;
+    cinfo.err = jpeg_std_error(&jerr);
+    jerr.error_exit = &jpegErrorExit;
+
+    jpeg_create_compress(&cinfo);
+    JpegDestination dest(buf);
+
+    try {
+        cinfo.dest = &dest;
+        cinfo.image_width = image.cols;
+        cinfo.image_height = image.rows;
+        if (bgr) {
+#ifdef JCS_EXTENSIONS
+            cinfo.input_components = 3;
+            cinfo.in_color_space = JCS_EXT_BGR;
+#endif
+        } else {
+            cinfo.input_components = 1;
+            cinfo.in_color_space = JCS_GRAYSCALE;
+        }
+
+        jpeg_set_defaults(&cinfo);
+        jpeg_set_quality(&cinfo, quality, TRUE);
+        jpeg_start_compress(&cinfo, TRUE);
+
+        while (cinfo.next_scanline < cinfo.image_height) {
+            JSAMPROW row(const_cast<JSAMPLE*>
+                         (image.ptr<JSAMPLE>(cinfo.next_scanline)));
+            jpeg_write_scanlines(&cinfo, &row, 1);
+        }
+
+        jpeg_finish_compress(&cinfo);
+    } catch (const JpegError &e) {
+        jpeg_destroy_compress(&cinfo);
+        LOGTHROW(err2, InternalError)
+            << "Failed to encode JPEG image: <" << e.what() << ">.";
+    }
+
+    jpeg_destroy_compress(&cinfo);
+}
+
+int webpWriter(const std::uint8_t *data, std::size_t size
+               , const WebPPicture *picture)
+{
+    auto &buf(*static_cast<std::vector<unsigned char>*>
+               (picture->custom_ptr));
+    buf.insert(buf.end(), data, data + size);
+    return 1;
+}
+
+void encodeWebP(const cv::Mat &image, const ImageEncoding &encoding
+                , std::vector<unsigned char> &buf)
+{
+    if ((image.type() != CV_8UC3) && (image.type() != CV_8UC4)) {
+        throw utility::makeError<InternalError>("Unsupported image type.");
+    }
+
+    WebPConfig config;
+    if (!WebPConfigInit(&config)) {
+        throw utility::makeError<InternalError>
+            ("Incompatible WebP library.");
+    }
+    config.lossless = encoding.webpLossless;
+    config.quality = encoding.webpQuality;
+    config.method = encoding.webpEffort;
+
+    WebPPicture picture;
+    if (!WebPPictureInit(&picture)) {
+        throw utility::makeError<InternalError>
+            ("Incompatible WebP library.");
+    }
+    picture.use_argb = encoding.webpLossless;
+    picture.width = image.cols;
+    picture.height = image.rows;
+
+    // note that we use the BGR (not the RGB) variant.
+    // This is meant for normal maps.
+    const bool imported
+        ((image.type() == CV_8UC3)
+         ? WebPPictureImportBGR(&picture, image.data, image.step)
+         : WebPPictureImportBGRA(&picture, image.data, image.step));
+    if (!imported) {
+        WebPPictureFree(&picture);
+        throw utility::makeError<InternalError>
+            ("Failed to import image to WebP.");
+    }
+
+    buf.clear();
+    picture.writer = &webpWriter;
+    picture.custom_ptr = &buf;
+
+    const bool ok(WebPEncode(&config, &picture));
+    const auto code(picture.error_code);
+    WebPPictureFree(&picture);
+
+    if (!ok) {
+        throw utility::makeError<InternalError>
+            ("Failed to create WebP data (error %d).", int(code));
+    }
+}
+
+#ifdef MAPPROXY_HAS_AVIF
+
+void encodeAvif(const cv::Mat &image, const ImageEncoding &encoding
+                , std::vector<unsigned char> &buf)
+{
+    cv::Mat src(image);
+    switch (image.type()) {
+    case CV_8UC1: cv::cvtColor(image, src, cv::COLOR_GRAY2BGR); break;
+    case CV_8UC3: case CV_8UC4: break;
+    default:
+        throw utility::makeError<InternalError>("Unsupported image type.");
+    }
+    const bool alpha(src.type() == CV_8UC4);
+
+    std::unique_ptr< ::avifImage, decltype(&::avifImageDestroy)> avif
+        (::avifImageCreate(src.cols, src.rows, 8, AVIF_PIXEL_FORMAT_YUV420)
+         , &::avifImageDestroy);
+    std::unique_ptr< ::avifEncoder, decltype(&::avifEncoderDestroy)> encoder
+        (::avifEncoderCreate(), &::avifEncoderDestroy);
+    if (!avif || !encoder) {
+        throw utility::makeError<InternalError>
+            ("Unable to create AVIF encoder.");
+    }
+
+    ::avifRGBImage rgb;
+    ::avifRGBImageSetDefaults(&rgb, avif.get());
+    rgb.format = alpha ? AVIF_RGB_FORMAT_BGRA : AVIF_RGB_FORMAT_BGR;
+    rgb.pixels = const_cast<std::uint8_t*>(src.ptr<std::uint8_t>());
+    rgb.rowBytes = src.step;
+    if (::avifImageRGBToYUV(avif.get(), &rgb) != AVIF_RESULT_OK) {
+        throw utility::makeError<InternalError>
+            ("Failed to convert image to AVIF.");
+    }
+
+#if AVIF_VERSION >= 1000000
+    encoder->quality = encoding.avifQuality;
+    encoder->qualityAlpha = encoding.avifQuality;
+#else
+    // quality scale maps linearly onto quantizer
+    const int q(((100 - encoding.avifQuality) * AVIF_QUANTIZER_WORST_QUALITY
+                 + 50) / 100);
+    encoder->minQuantizer = encoder->maxQuantizer = q;
+    encoder->minQuantizerAlpha = encoder->maxQuantizerAlpha = q;
+#endif
+    encoder->speed = encoding.avifSpeed;
+    // tiles are encoded in parallel by the core pool
+    encoder->maxThreads = 1;
+
+    ::avifRWData out = AVIF_DATA_EMPTY;
+    const auto res(::avifEncoderWrite(encoder.get(), avif.get(), &out));
+    if (res != AVIF_RESULT_OK) {
+        ::avifRWDataFree(&out);
+        throw utility::makeError<InternalError>
+            ("Failed to create AVIF data (%s).", ::avifResultToString(res));
+    }
+
+    buf.assign(out.data, out.data + out.size);
+    ::avifRWDataFree(&out);
+}
+
+#endif // MAPPROXY_HAS_AVIF
+
+#ifdef MAPPROXY_HAS_JXL
+
+/** Butteraugli distance from 0-100 quality, same mapping as cjxl uses.
+ */
+float jxlDistance(int quality)
+{
+    if (quality >= 30) { return 0.1f + (100 - quality) * 0.09f; }
+    return (53.0f / 3000.0f) * quality * quality
+        - (23.0f / 20.0f) * quality + 25.0f;
+}
+
+void encodeJxl(const cv::Mat &image, const ImageEncoding &encoding
+               , std::vector<unsigned char> &buf)
+{
+    // JPEG XL takes RGB(A) with tightly packed rows
+    cv::Mat src;
+    switch (image.type()) {
+    case CV_8UC1:
+        src = image.isContinuous() ? image : image.clone();
+        break;
+    case CV_8UC3: cv::cvtColor(image, src, cv::COLOR_BGR2RGB); break;
+    case CV_8UC4: cv::cvtColor(image, src, cv::COLOR_BGRA2RGBA); break;
+    default:
+        throw utility::makeError<InternalError>("Unsupported image type.");
+    }
+    const int channels(src.channels());
+    const bool alpha(channels == 4);
+
+    std::unique_ptr< ::JxlEncoder, decltype(&::JxlEncoderDestroy)> encoder
+        (::JxlEncoderCreate(nullptr), &::JxlEncoderDestroy);
+    if (!encoder) {
+        throw utility::makeError<InternalError>
+            ("Unable to create JPEG XL encoder.");
+    }
+    auto *enc(encoder.get());
+
+    ::JxlBasicInfo info;
+    ::JxlEncoderInitBasicInfo(&info);
+    info.xsize = src.cols;
+    info.ysize = src.rows;
+    info.bits_per_sample = 8;
+    info.num_color_channels = (channels == 1) ? 1 : 3;
+    info.num_extra_channels = alpha ? 1 : 0;
+    info.alpha_bits = alpha ? 8 : 0;
+    const bool lossless(encoding.jxlQuality >= 100);
+    info.uses_original_profile = lossless ? JXL_TRUE : JXL_FALSE;
+
+    ::JxlColorEncoding color;
+    ::JxlColorEncodingSetToSRGB(&color, (channels == 1));
+
+    auto *settings(::JxlEncoderFrameSettingsCreate(enc, nullptr));
+    const ::JxlPixelFormat format
+        = { std::uint32_t(channels), JXL_TYPE_UINT8, JXL_NATIVE_ENDIAN, 0 };
+
+    if ((::JxlEncoderSetBasicInfo(enc, &info) != JXL_ENC_SUCCESS)
+        || (::JxlEncoderSetColorEncoding(enc, &color) != JXL_ENC_SUCCESS)
+        || !settings
+        || (::JxlEncoderFrameSettingsSetOption
+            (settings, JXL_ENC_FRAME_SETTING_EFFORT, encoding.jxlEffort)
+            != JXL_ENC_SUCCESS)
+        || (lossless
+            ? ::JxlEncoderSetFrameLossless(settings, JXL_TRUE)
+            : ::JxlEncoderSetFrameDistance
+              (settings, jxlDistance(encoding.jxlQuality)))
+           != JXL_ENC_SUCCESS
+        || (::JxlEncoderAddImageFrame
+            (settings, &format, src.data, src.total() * src.elemSize())
+            != JXL_ENC_SUCCESS))
+    {
+        throw utility::makeError<InternalError>
+            ("Failed to set up JPEG XL encoder.");
+    }
+    ::JxlEncoderCloseInput(enc);
+
+    // encode directly into scratch buffer, grow as needed
+    buf.resize(std::max(buf.capacity(), InitialBufferSize));
+    auto *next(buf.data());
+    auto avail(buf.size());
+    for (;;) {
+        const auto status(::JxlEncoderProcessOutput(enc, &next, &avail));
+        if (status == JXL_ENC_SUCCESS) { break; }
+        if (status != JXL_ENC_NEED_MORE_OUTPUT) {
+            throw utility::makeError<InternalError>
+                ("Failed to create JPEG XL data.");
+        }
+        const auto used(next - buf.data());
+        buf.resize(2 * buf.size());
+        next = buf.data() + used;
+        avail = buf.size() - used;
+    }
+    buf.resize(next - buf.data());
+}
+
+#endif // MAPPROXY_HAS_JXL
+
+void checkRange(const char *name, int value, int min, int max)
+{
+    if ((value < min) || (value > max)) {
+        utility::raise<Json::Error>
+            ("Value stored in encoding.%s is out of range [%d, %d]."
+             , name, min, max);
+    }
+}
+
+} // namespace
+
+bool ImageEncoding::operator==(const ImageEncoding &o) const
+{
+    return ((jpegQuality == o.jpegQuality)
+            && (pngCompression == o.pngCompression)
+            && (webpLossless == o.webpLossless)
+            && (webpQuality == o.webpQuality)
+            && (webpEffort == o.webpEffort)
+            && (avifQuality == o.avifQuality)
+            && (avifSpeed == o.avifSpeed)
+            && (jxlQuality == o.jxlQuality)
+            && (jxlEffort == o.jxlEffort));
+}
+
+void ImageEncoding::parse(const Json::Value &value)
+{
+    if (!value.isMember("encoding")) { return; }
+    const auto &encoding(value["encoding"]);
+    if (!encoding.isObject()) {
+        utility::raise<Json::Error>("Encoding is not an object.");
+    }
+
+    if (encoding.isMember("jpegQuality")) {
+        Json::get(jpegQuality, encoding, "jpegQuality");
+        checkRange("jpegQuality", jpegQuality, 0, 100);
+    }
+    if (encoding.isMember("pngCompression")) {
+        Json::get(pngCompression, encoding, "pngCompression");
+        checkRange("pngCompression", pngCompression, 0, 9);
+    }
+    if (encoding.isMember("webpLossless")) {
+        Json::get(webpLossless, encoding, "webpLossless");
+    }
+    if (encoding.isMember("webpQuality")) {
+        Json::get(webpQuality, encoding, "webpQuality");
+        checkRange("webpQuality", webpQuality, 0, 100);
+    }
+    if (encoding.isMember("webpEffort")) {
+        Json::get(webpEffort, encoding, "webpEffort");
+        checkRange("webpEffort", webpEffort, 0, 6);
+    }
+    if (encoding.isMember("avifQuality")) {
+        Json::get(avifQuality, encoding, "avifQuality");
+        checkRange("avifQuality", avifQuality, 0, 100);
+    }
+    if (encoding.isMember("avifSpeed")) {
+        Json::get(avifSpeed, encoding, "avifSpeed");
+        checkRange("avifSpeed", avifSpeed, 0, 10);
+    }
+    if (encoding.isMember("jxlQuality")) {
+        Json::get(jxlQuality, encoding, "jxlQuality");
+        checkRange("jxlQuality", jxlQuality, 0, 100);
+    }
+    if (encoding.isMember("jxlEffort")) {
+        Json::get(jxlEffort, encoding, "jxlEffort");
+        checkRange("jxlEffort", jxlEffort, 1, 9);
+    }
+}
+
+void ImageEncoding::build(Json::Value &value) const
+{
+    const ImageEncoding defaults;
+    if (*this == defaults) { return; }
+
+    auto &encoding(value["encoding"] = Json::Value(Json::objectValue));
+    if (jpegQuality != defaults.jpegQuality) {
+        encoding["jpegQuality"] = jpegQuality;
+    }
+    if (pngCompression != defaults.pngCompression) {
+        encoding["pngCompression"] = pngCompression;
+    }
+    if (webpLossless != defaults.webpLossless) {
+        encoding["webpLossless"] = webpLossless;
+    }
+    if (webpQuality != defaults.webpQuality) {
+        encoding["webpQuality"] = webpQuality;
+    }
+    if (webpEffort != defaults.webpEffort) {
+        encoding["webpEffort"] = webpEffort;
+    }
+    if (avifQuality != defaults.avifQuality) {
+        encoding["avifQuality"] = avifQuality;
+    }
+    if (avifSpeed != defaults.avifSpeed) {
+        encoding["avifSpeed"] = avifSpeed;
+    }
+    if (jxlQuality != defaults.jxlQuality) {
+        encoding["jxlQuality"] = jxlQuality;
+    }
+    if (jxlEffort != defaults.jxlEffort) {
+        encoding["jxlEffort"] = jxlEffort;
+    }
+}
+
+bool encoderAvailable(RasterFormat format)
+{
+    switch (format) {
+    case RasterFormat::avif:
+#ifdef MAPPROXY_HAS_AVIF
+        return true;
+#else
+        return false;
+#endif
+
+    case RasterFormat::jxl:
+#ifdef MAPPROXY_HAS_JXL
+        return true;
+#else
+        return false;
+#endif
+
+    default:
+        return true;
+    }
+}
+
+const std::vector<unsigned char>&
+encodeImage(const cv::Mat &image, RasterFormat format
+            , const ImageEncoding &encoding)
+{
+    // scratch buffer, keeps its capacity between calls
+    thread_local std::vector<unsigned char> buf;
+
+    MAPPROXY_PROBE2(encode__start, int(format)
+                    , std::uint64_t(image.cols) * image.rows);
+
+    switch (format) {
+    case RasterFormat::jpg:
+        encodeJpeg(image, encoding.jpegQuality, buf);
+        break;
+
+    case RasterFormat::png:
+        cv::imencode(".png", image, buf
+                     , { cv::IMWRITE_PNG_COMPRESSION
+                         , encoding.pngCompression });
+        break;
+
+    case RasterFormat::webp:
+        encodeWebP(image, encoding, buf);
+        break;
+
+    case RasterFormat::ktx2:
+        encodeKtx2(image, buf);
+        break;
+
+    case RasterFormat::avif:
+#ifdef MAPPROXY_HAS_AVIF
+        encodeAvif(image, encoding, buf);
+        break;
+#else
+        throw utility::makeError<NotFound>("AVIF support not compiled in.");
+#endif
+
+    case RasterFormat::jxl:
+#ifdef MAPPROXY_HAS_JXL
+        encodeJxl(image, encoding, buf);
+        break;
+#else
+        throw utility::makeError<NotFound>
+            ("JPEG XL support not compiled in.");
+#endif
+    }
+
+    MAPPROXY_PROBE2(encode__finish, int(format), buf.size());
+
+    ScratchMat::bufferCapacity(buf.capacity());
+    return buf;
+}
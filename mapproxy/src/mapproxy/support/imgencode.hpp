@@ -0,0 +1,111 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef mapproxy_support_imgencode_hpp_included_
+#define mapproxy_support_imgencode_hpp_included_
+
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include "../resource.hpp"
+
+// fwd
+namespace Json { class Value; }
+
+/** Image encoder settings, configurable per resource.
+ */
+struct ImageEncoding {
+    /** JPEG quality (0-100).
+     */
+    int jpegQuality;
+
+    /** PNG (zlib) compression level (0-9). Levels above 6 cost a lot of CPU
+     *  for little gain.
+     */
+    int pngCompression;
+
+    /** Lossless WebP (meant for normal maps).
+     */
+    bool webpLossless;
+
+    /** WebP quality (0-100); compression effort in lossless mode.
+     */
+    int webpQuality;
+
+    /** WebP method (0 = fastest, 6 = smallest output).
+     */
+    int webpEffort;
+
+    /** AVIF quality (0-100).
+     */
+    int avifQuality;
+
+    /** AVIF encoder speed (0 = slowest, 10 = fastest). AV1 encoding is
+     *  expensive, slow presets easily cost tens of ms per tile.
+     */
+    int avifSpeed;
+
+    /** JPEG XL quality (0-100, mapped to butteraugli distance).
+     */
+    int jxlQuality;
+
+    /** JPEG XL effort (1 = fastest, 9 = smallest output).
+     */
+    int jxlEffort;
+
+    ImageEncoding()
+        : jpegQuality(75), pngCompression(9), webpLossless(true)
+        , webpQuality(70), webpEffort(6), avifQuality(60), avifSpeed(8)
+        , jxlQuality(75), jxlEffort(3)
+    {}
+
+    bool operator==(const ImageEncoding &o) const;
+    bool operator!=(const ImageEncoding &o) const { return !(*this == o); }
+
+    /** Parses settings from an (optional) JSON object; missing values keep
+     *  their defaults.
+     */
+    void parse(const Json::Value &value);
+
+    /** Builds JSON object with settings that differ from defaults.
+     */
+    void build(Json::Value &value) const;
+};
+
+/** Encoder of given format is compiled in. AVIF and JPEG XL encoders are
+ *  optional (libavif, libjxl).
+ */
+bool encoderAvailable(RasterFormat format);
+
+/** Encodes image in given format. Returned buffer is a per-thread scratch
+ *  buffer valid until the next call in the same thread.
+ */
+const std::vector<unsigned char>&
+encodeImage(const cv::Mat &image, RasterFormat format
+            , const ImageEncoding &encoding = ImageEncoding());
+
+#endif // mapproxy_support_imgencode_hpp_included_
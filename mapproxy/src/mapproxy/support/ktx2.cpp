@@ -0,0 +1,228 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <array>
+#include <limits>
+#include <cstdint>
+#include <cstdlib>
+#include <algorithm>
+
+#include "utility/raise.hpp"
+
+#include "../error.hpp"
+
+#include "ktx2.hpp"
+
+namespace {
+
+const std::array<unsigned char, 12> Identifier = {{
+    0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A
+}};
+
+// Vulkan formats
+const std::uint32_t VK_FORMAT_BC4_UNORM_BLOCK(139);
+const std::uint32_t VK_FORMAT_BC5_UNORM_BLOCK(141);
+
+// data format descriptor values
+const unsigned char KHR_DF_MODEL_BC4(131);
+const unsigned char KHR_DF_MODEL_BC5(132);
+const unsigned char KHR_DF_PRIMARIES_UNSPECIFIED(0);
+const unsigned char KHR_DF_TRANSFER_LINEAR(1);
+const unsigned char KHR_DF_CHANNEL_RED(0);
+const unsigned char KHR_DF_CHANNEL_GREEN(1);
+
+/** Little-endian writer.
+ */
+class Writer {
+public:
+    Writer(std::vector<unsigned char> &buf) : buf_(buf) {}
+
+    template <typename T> void put(T value) {
+        for (std::size_t i(0); i < sizeof(T); ++i) {
+            buf_.push_back(static_cast<unsigned char>(value >> (8 * i)));
+        }
+    }
+
+    void pad(std::size_t alignment) {
+        while (buf_.size() % alignment) { buf_.push_back(0); }
+    }
+
+    std::size_t size() const { return buf_.size(); }
+
+private:
+    std::vector<unsigned char> &buf_;
+};
+
+/** Encodes 4x4 block of single channel values as BC4 block: extremes as
+ *  endpoints, each texel mapped to the nearest of 8 interpolated levels.
+ */
+void encodeBc4(const std::array<unsigned char, 16> &texels, Writer &w)
+{
+    const auto minmax(std::minmax_element(texels.begin(), texels.end()));
+    const int hi(*minmax.second);
+    const int lo(*minmax.first);
+
+    w.put<std::uint8_t>(hi);
+    w.put<std::uint8_t>(lo);
+
+    std::uint64_t indices(0);
+    if (hi != lo) {
+        // red0 > red1: index 0 = red0, 1 = red1, 2-7 interpolated
+        std::array<int, 8> levels;
+        levels[0] = hi;
+        levels[1] = lo;
+        for (int i(1); i < 7; ++i) {
+            levels[i + 1] = ((7 - i) * hi + i * lo + 3) / 7;
+        }
+
+        for (std::size_t t(0); t < texels.size(); ++t) {
+            std::uint64_t best(0);
+            int bestError(std::numeric_limits<int>::max());
+            for (std::size_t l(0); l < levels.size(); ++l) {
+                const int error(std::abs(levels[l] - texels[t]));
+                if (error < bestError) { bestError = error; best = l; }
+            }
+            indices |= (best << (3 * t));
+        }
+    }
+
+    for (int i(0); i < 6; ++i) {
+        w.put<std::uint8_t>(indices >> (8 * i));
+    }
+}
+
+/** Grabs 4x4 block of given channel, clamped at the image edges.
+ */
+std::array<unsigned char, 16> block(const cv::Mat &image, int bx, int by
+                                    , int channel)
+{
+    const int channels(image.channels());
+    std::array<unsigned char, 16> texels;
+    for (int y(0); y < 4; ++y) {
+        const auto *row(image.ptr<unsigned char>
+                        (std::min(by * 4 + y, image.rows - 1)));
+        for (int x(0); x < 4; ++x) {
+            const int col(std::min(bx * 4 + x, image.cols - 1));
+            texels[y * 4 + x] = row[col * channels + channel];
+        }
+    }
+    return texels;
+}
+
+} // namespace
+
+void encodeKtx2(const cv::Mat &image, std::vector<unsigned char> &buf)
+{
+    if ((image.depth() != CV_8U)
+        || ((image.channels() != 1) && (image.channels() != 3)
+            && (image.channels() != 4)))
+    {
+        throw utility::makeError<InternalError>
+            ("Unsupported image type for KTX2.");
+    }
+
+    const bool bc5(image.channels() != 1);
+    const std::uint32_t blockSize(bc5 ? 16 : 8);
+    const std::uint32_t blocksX((image.cols + 3) / 4);
+    const std::uint32_t blocksY((image.rows + 3) / 4);
+    const std::uint64_t levelSize(std::uint64_t(blocksX) * blocksY
+                                  * blockSize);
+
+    const std::uint32_t sampleCount(bc5 ? 2 : 1);
+    const std::uint32_t dfdSize(4 + 24 + 16 * sampleCount);
+
+    // identifier + header + index + one level
+    const std::uint32_t dfdOffset(12 + 9 * 4 + 4 * 4 + 2 * 8 + 3 * 8);
+    const std::uint64_t levelOffset
+        (((dfdOffset + dfdSize + blockSize - 1) / blockSize) * blockSize);
+
+    buf.clear();
+    buf.reserve(levelOffset + levelSize);
+    Writer w(buf);
+
+    buf.insert(buf.end(), Identifier.begin(), Identifier.end());
+
+    // header
+    w.put<std::uint32_t>(bc5 ? VK_FORMAT_BC5_UNORM_BLOCK
+                         : VK_FORMAT_BC4_UNORM_BLOCK);
+    w.put<std::uint32_t>(1); // typeSize
+    w.put<std::uint32_t>(image.cols);
+    w.put<std::uint32_t>(image.rows);
+    w.put<std::uint32_t>(0); // pixelDepth
+    w.put<std::uint32_t>(0); // layerCount
+    w.put<std::uint32_t>(1); // faceCount
+    w.put<std::uint32_t>(1); // levelCount
+    w.put<std::uint32_t>(0); // supercompressionScheme
+
+    // index: dfd, kvd (none), sgd (none)
+    w.put<std::uint32_t>(dfdOffset);
+    w.put<std::uint32_t>(dfdSize);
+    w.put<std::uint32_t>(0);
+    w.put<std::uint32_t>(0);
+    w.put<std::uint64_t>(0);
+    w.put<std::uint64_t>(0);
+
+    // level index
+    w.put<std::uint64_t>(levelOffset);
+    w.put<std::uint64_t>(levelSize);
+    w.put<std::uint64_t>(levelSize);
+
+    // data format descriptor: basic block
+    w.put<std::uint32_t>(dfdSize);
+    w.put<std::uint32_t>(0); // vendor: Khronos, type: basic
+    w.put<std::uint16_t>(2); // version
+    w.put<std::uint16_t>(24 + 16 * sampleCount);
+    w.put<std::uint8_t>(bc5 ? KHR_DF_MODEL_BC5 : KHR_DF_MODEL_BC4);
+    w.put<std::uint8_t>(KHR_DF_PRIMARIES_UNSPECIFIED);
+    w.put<std::uint8_t>(KHR_DF_TRANSFER_LINEAR);
+    w.put<std::uint8_t>(0); // flags
+    for (int d : { 3, 3, 0, 0 }) { w.put<std::uint8_t>(d); }
+    w.put<std::uint8_t>(blockSize);
+    for (int i(0); i < 7; ++i) { w.put<std::uint8_t>(0); }
+
+    for (std::uint32_t s(0); s < sampleCount; ++s) {
+        w.put<std::uint16_t>(64 * s); // bitOffset
+        w.put<std::uint8_t>(63); // bitLength - 1
+        w.put<std::uint8_t>(s ? KHR_DF_CHANNEL_GREEN : KHR_DF_CHANNEL_RED);
+        w.put<std::uint32_t>(0); // samplePosition
+        w.put<std::uint32_t>(0); // sampleLower
+        w.put<std::uint32_t>(0xffffffff); // sampleUpper
+    }
+
+    w.pad(blockSize);
+
+    // level data; OpenCV stores BGR(A), red is channel 2
+    for (std::uint32_t by(0); by < blocksY; ++by) {
+        for (std::uint32_t bx(0); bx < blocksX; ++bx) {
+            if (bc5) {
+                encodeBc4(block(image, bx, by, 2), w);
+                encodeBc4(block(image, bx, by, 1), w);
+            } else {
+                encodeBc4(block(image, bx, by, 0), w);
+            }
+        }
+    }
+}
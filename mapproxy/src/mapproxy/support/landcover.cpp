@@ -0,0 +1,464 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include "landcover.hpp"
+
+namespace landcover {
+
+namespace {
+
+/** Maximum number of cached tiles (and, separately, of flat masks).
+ */
+constexpr std::size_t TileCacheLimit(256);
+
+/** Simple thread-safe LRU cache.
+ */
+template <typename Value>
+class Lru {
+public:
+    Lru(std::size_t limit) : limit_(limit) {}
+
+    bool get(const std::string &key, Value &value) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        auto findex(index_.find(key));
+        if (findex == index_.end()) { return false; }
+        lru_.splice(lru_.begin(), lru_, findex->second);
+        value = findex->second->second;
+        return true;
+    }
+
+    void put(const std::string &key, const Value &value) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        auto findex(index_.find(key));
+        if (findex != index_.end()) {
+            // already stored by another thread
+            lru_.splice(lru_.begin(), lru_, findex->second);
+            return;
+        }
+
+        lru_.emplace_front(key, value);
+        index_.insert(typename Index::value_type(key, lru_.begin()));
+
+        while (lru_.size() > limit_) {
+            index_.erase(lru_.back().first);
+            lru_.pop_back();
+        }
+    }
+
+private:
+    typedef std::list<std::pair<std::string, Value>> List;
+    typedef std::unordered_map<std::string, typename List::iterator> Index;
+
+    const std::size_t limit_;
+    std::mutex mutex_;
+    List lru_;
+    Index index_;
+};
+
+Lru<GdalWarper::Raster>& tileCache()
+{
+    static Lru<GdalWarper::Raster> cache(TileCacheLimit);
+    return cache;
+}
+
+Lru<FlatMask>& flatMaskCache()
+{
+    static Lru<FlatMask> cache(TileCacheLimit);
+    return cache;
+}
+
+GdalWarper::Raster tile(GdalWarper &warper
+                        , const GdalWarper::RasterRequest &request
+                        , const std::string &key
+                        , Aborter &aborter)
+{
+    auto &cache(tileCache());
+
+    GdalWarper::Raster raster;
+    if (cache.get(key, raster)) { return raster; }
+
+    // concurrent misses are coalesced by the warper itself
+    raster = warper.warp(request, aborter);
+    cache.put(key, raster);
+    return raster;
+}
+
+/** Tiles with more distinct colours are not tabled.
+ */
+constexpr std::size_t MaxColours(1024);
+
+constexpr std::uint16_t FreeSlot(0xffff);
+constexpr std::uint32_t FreeKey(0xffffffff);
+
+/** Colour id of each pixel of a tile and distinct colours of the tile.
+ */
+struct ColourIndex {
+    /** Distinct colours (palette index or packed BGR), indexed by id.
+     */
+    std::vector<std::uint32_t> colours;
+
+    /** Colour id of each pixel, row by row.
+     */
+    std::vector<std::uint16_t> ids;
+
+    /** Indexes given tile. Returns false for tiles that cannot be tabled.
+     */
+    bool build(const cv::Mat &tile);
+
+    /** Creates 1xN tile of given type with given distinct colours.
+     */
+    cv::Mat probe(const std::vector<std::size_t> &which, int type) const;
+};
+
+bool ColourIndex::build(const cv::Mat &tile)
+{
+    if (tile.empty() || (tile.depth() != CV_8U)) { return false; }
+    if ((tile.channels() != 1) && (tile.channels() != 3)) { return false; }
+
+    colours.clear();
+    ids.resize(std::size_t(tile.rows) * tile.cols);
+    auto *id(ids.data());
+
+    if (tile.channels() == 1) {
+        // direct indexing
+        std::array<std::uint16_t, 256> slots;
+        slots.fill(FreeSlot);
+        for (int j(0); j < tile.rows; ++j) {
+            const auto *row(tile.ptr<uchar>(j));
+            for (int i(0); i < tile.cols; ++i) {
+                auto &slot(slots[row[i]]);
+                if (slot == FreeSlot) {
+                    slot = colours.size();
+                    colours.push_back(row[i]);
+                }
+                *id++ = slot;
+            }
+        }
+        return true;
+    }
+
+    // open addressing (Fibonacci hashing, linear probing), table is kept at
+    // most half full; runs of the same colour skip hashing altogether
+    constexpr int Bits(11);
+    constexpr std::uint32_t Mask((1 << Bits) - 1);
+    static_assert((Mask + 1) >= 2 * MaxColours, "Hash table is too small.");
+
+    std::array<std::uint32_t, Mask + 1> keys;
+    std::array<std::uint16_t, Mask + 1> slots;
+    keys.fill(FreeKey);
+
+    auto last(FreeKey);
+    std::uint16_t lastId(0);
+    for (int j(0); j < tile.rows; ++j) {
+        const auto *px(tile.ptr<uchar>(j));
+        for (int i(0); i < tile.cols; ++i, px += 3) {
+            const std::uint32_t key(px[0] | (px[1] << 8) | (px[2] << 16));
+            if (key != last) {
+                auto h((key * 2654435761u) >> (32 - Bits));
+                while (keys[h] != key) {
+                    if (keys[h] == FreeKey) {
+                        if (colours.size() == MaxColours) { return false; }
+                        keys[h] = key;
+                        slots[h] = colours.size();
+                        colours.push_back(key);
+                        break;
+                    }
+                    h = (h + 1) & Mask;
+                }
+                last = key;
+                lastId = slots[h];
+            }
+            *id++ = lastId;
+        }
+    }
+    return true;
+}
+
+cv::Mat ColourIndex::probe(const std::vector<std::size_t> &which
+                           , int type) const
+{
+    cv::Mat probe(1, which.size(), type);
+    const auto channels(probe.channels());
+    auto *px(probe.ptr<uchar>(0));
+    for (auto c : which) {
+        const auto colour(colours[c]);
+        for (int b(0); b < channels; ++b) {
+            *px++ = (colour >> (8 * b)) & 0xff;
+        }
+    }
+    return probe;
+}
+
+ColourIndex& colourIndex()
+{
+    // reused to save allocations
+    thread_local ColourIndex index;
+    return index;
+}
+
+/** Table key: palette index and BGR tiles get separate entries.
+ */
+inline std::uint32_t tableKey(const cv::Mat &tile, std::uint32_t colour)
+{
+    return (std::uint32_t(tile.channels()) << 24) | colour;
+}
+
+} // namespace
+
+struct ClassLut::Detail {
+    Detail(const geo::landcover::Classes &classes) : classes(classes) {}
+
+    const geo::landcover::Classes classes;
+
+    std::mutex mutex;
+
+    /** Flat flag per colour.
+     */
+    std::unordered_map<std::uint32_t, bool> flat;
+
+    /** Specular map pixels per colour, per shininess bits.
+     */
+    struct Specular {
+        typedef std::array<uchar, 16> Pixel;
+
+        int type = -1;
+        std::unordered_map<std::uint32_t, Pixel> pixels;
+    };
+
+    std::map<uchar, Specular> specular;
+};
+
+ClassLut::ClassLut(const geo::landcover::Classes &classes)
+    : detail_(std::make_shared<Detail>(classes))
+{}
+
+std::size_t ClassLut::memory() const
+{
+    auto &d(*detail_);
+    std::unique_lock<std::mutex> lock(d.mutex);
+
+    // hash node: key, value and a couple of pointers
+    const std::size_t node(2 * sizeof(void*));
+    std::size_t size(d.flat.size() * (sizeof(std::uint32_t) + 1 + node));
+    for (const auto &item : d.specular) {
+        size += (item.second.pixels.size()
+                 * (sizeof(std::uint32_t) + sizeof(Detail::Specular::Pixel)
+                    + node));
+    }
+    return size;
+}
+
+imgproc::RasterMask ClassLut::flatMask(const cv::Mat &tile) const
+{
+    auto &d(*detail_);
+    auto &index(colourIndex());
+    if (!index.build(tile)) {
+        return geo::landcover::flatMask(tile, d.classes);
+    }
+
+    const auto &colours(index.colours);
+    std::vector<char> flat(colours.size());
+    {
+        std::unique_lock<std::mutex> lock(d.mutex);
+        std::vector<std::size_t> missing;
+        for (std::size_t c(0); c < colours.size(); ++c) {
+            auto fflat(d.flat.find(tableKey(tile, colours[c])));
+            if (fflat == d.flat.end()) {
+                missing.push_back(c);
+            } else {
+                flat[c] = fflat->second;
+            }
+        }
+
+        if (!missing.empty()) {
+            // new colours are rare, evaluate them under the lock
+            const auto mask(geo::landcover::flatMask
+                            (index.probe(missing, tile.type()), d.classes));
+            for (std::size_t k(0); k < missing.size(); ++k) {
+                const auto c(missing[k]);
+                flat[c] = mask.get(k, 0);
+                d.flat[tableKey(tile, colours[c])] = flat[c];
+            }
+        }
+    }
+
+    const auto flats(std::count(flat.begin(), flat.end(), true));
+    if (!flats) {
+        return imgproc::RasterMask(tile.cols, tile.rows
+                                   , imgproc::RasterMask::EMPTY);
+    }
+    if (std::size_t(flats) == flat.size()) {
+        return imgproc::RasterMask(tile.cols, tile.rows
+                                   , imgproc::RasterMask::FULL);
+    }
+
+    imgproc::RasterMask mask(tile.cols, tile.rows
+                             , imgproc::RasterMask::EMPTY);
+    const auto *id(index.ids.data());
+    for (int j(0); j < tile.rows; ++j) {
+        for (int i(0); i < tile.cols; ++i) {
+            if (flat[*id++]) { mask.set(i, j); }
+        }
+    }
+    return mask;
+}
+
+cv::Mat ClassLut::specularMap(const cv::Mat &tile, uchar shininessBits)
+    const
+{
+    auto &d(*detail_);
+    const auto library([&]() {
+        return geo::landcover::specularMap(tile, d.classes, shininessBits);
+    });
+
+    auto &index(colourIndex());
+    if (!index.build(tile)) { return library(); }
+
+    // gather table: output pixel per colour id
+    const auto &colours(index.colours);
+    std::vector<uchar> table;
+    int type;
+    {
+        std::unique_lock<std::mutex> lock(d.mutex);
+        auto &specular(d.specular[shininessBits]);
+
+        std::vector<std::size_t> missing;
+        for (std::size_t c(0); c < colours.size(); ++c) {
+            if (!specular.pixels.count(tableKey(tile, colours[c]))) {
+                missing.push_back(c);
+            }
+        }
+
+        if (!missing.empty()) {
+            // new colours are rare, evaluate them under the lock
+            const auto out(geo::landcover::specularMap
+                           (index.probe(missing, tile.type()), d.classes
+                            , shininessBits));
+            const auto es(out.elemSize());
+            if ((out.rows != 1) || (out.cols != int(missing.size()))
+                || (es > Detail::Specular::Pixel().size())
+                || ((specular.type >= 0) && (out.type() != specular.type)))
+            {
+                // not a per-pixel mapping we can table
+                lock.unlock();
+                return library();
+            }
+
+            specular.type = out.type();
+            for (std::size_t k(0); k < missing.size(); ++k) {
+                auto &pixel(specular.pixels
+                            [tableKey(tile, colours[missing[k]])]);
+                std::memcpy(pixel.data(), out.ptr<uchar>(0) + k * es, es);
+            }
+        }
+
+        type = specular.type;
+        const auto es(CV_ELEM_SIZE(type));
+        table.resize(colours.size() * es);
+        auto *entry(table.data());
+        for (auto colour : colours) {
+            const auto &pixel(specular.pixels.at(tableKey(tile, colour)));
+            std::memcpy(entry, pixel.data(), es);
+            entry += es;
+        }
+    }
+
+    cv::Mat out(tile.rows, tile.cols, type);
+    const std::size_t es(out.elemSize());
+    const auto *id(index.ids.data());
+    for (int j(0); j < out.rows; ++j) {
+        auto *dst(out.ptr<uchar>(j));
+        if (es == 1) {
+            for (int i(0); i < out.cols; ++i) { dst[i] = table[*id++]; }
+        } else {
+            for (int i(0); i < out.cols; ++i, dst += es) {
+                std::memcpy(dst, table.data() + *id++ * es, es);
+            }
+        }
+    }
+    return out;
+}
+
+GdalWarper::Raster tile(GdalWarper &warper
+                        , const GdalWarper::RasterRequest &request
+                        , Aborter &aborter)
+{
+    return tile(warper, request, request.key(), aborter);
+}
+
+std::string classdefKey(const std::string &classdef)
+{
+    return classdef + '@' + std::to_string
+        (boost::filesystem::last_write_time(classdef));
+}
+
+FlatMask flatMask(GdalWarper &warper
+                  , const GdalWarper::RasterRequest &request
+                  , const std::string &classdefKey
+                  , const ClassLut &classes
+                  , Aborter &aborter)
+{
+    auto &cache(flatMaskCache());
+
+    const auto tileKey(request.key());
+    const auto key(tileKey + '#' + classdefKey);
+
+    FlatMask mask;
+    if (cache.get(key, mask)) { return mask; }
+
+    const auto lc(tile(warper, request, tileKey, aborter));
+    mask = std::make_shared<const imgproc::RasterMask>
+        (classes.flatMask(*lc));
+    cache.put(key, mask);
+    return mask;
+}
+
+FlatMask emptyFlatMask(int cols, int rows)
+{
+    // generators use handful of sizes
+    thread_local std::map<std::pair<int, int>, FlatMask> masks;
+
+    auto &mask(masks[std::make_pair(cols, rows)]);
+    if (!mask) {
+        mask = std::make_shared<const imgproc::RasterMask>
+            (cols, rows, imgproc::RasterMask::EMPTY);
+    }
+    return mask;
+}
+
+} // namespace landcover
@@ -0,0 +1,118 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef mapproxy_support_landcover_hpp_included_
+#define mapproxy_support_landcover_hpp_included_
+
+#include <memory>
+#include <string>
+
+#include "geo/landcover.hpp"
+
+#include "../gdalsupport.hpp"
+
+/** Process-wide cache of warped landcover tiles and flat masks derived from
+ *  them.
+ *
+ *  The same landcover tile is needed by normal map, specular map and surface
+ *  normal map generators of a single view; each tile is warped once and
+ *  shared by all of them. Both tiles and masks are kept in small LRU caches.
+ */
+namespace landcover {
+
+typedef std::shared_ptr<const imgproc::RasterMask> FlatMask;
+
+/** Class definition compiled into lookup tables.
+ *
+ *  Both flat mask and specular map are per-pixel functions of landcover
+ *  colour (BGR or palette index). Output of each distinct colour is
+ *  evaluated by geo::landcover only once (all new colours of a tile in a
+ *  single call) and remembered; tiles are then mapped by table lookups:
+ *  direct indexing of single band tiles, small hash table of BGR values
+ *  otherwise. Tiles of unexpected type or with too many distinct colours
+ *  (e.g. resampled by non-nearest filter) are handed to geo::landcover.
+ *
+ *  Thread-safe. Build single instance per loaded class definition.
+ */
+class ClassLut {
+public:
+    typedef std::shared_ptr<const ClassLut> pointer;
+
+    ClassLut(const geo::landcover::Classes &classes);
+
+    /** Flat mask of given landcover tile, geo::landcover::flatMask
+     *  equivalent.
+     */
+    imgproc::RasterMask flatMask(const cv::Mat &tile) const;
+
+    /** Specular map of given landcover tile, geo::landcover::specularMap
+     *  equivalent.
+     */
+    cv::Mat specularMap(const cv::Mat &tile, uchar shininessBits) const;
+
+    /** Approximate bytes held by the compiled lookups.
+     */
+    std::size_t memory() const;
+
+    struct Detail;
+
+private:
+    std::shared_ptr<Detail> detail_;
+};
+
+/** Returns warped landcover tile, warps it only when not cached.
+ *
+ *  Returned raster is shared; treat it as read-only.
+ */
+GdalWarper::Raster tile(GdalWarper &warper
+                        , const GdalWarper::RasterRequest &request
+                        , Aborter &aborter);
+
+/** Builds key identifying class definition file version (path and
+ *  modification time). Get it when loading the class definition.
+ */
+std::string classdefKey(const std::string &classdef);
+
+/** Returns flat mask of landcover tile, derives it from (cached) tile only
+ *  when not cached.
+ *
+ *  \param classdefKey class definition key (see classdefKey)
+ *  \param classes compiled class definition identified by classdefKey
+ */
+FlatMask flatMask(GdalWarper &warper
+                  , const GdalWarper::RasterRequest &request
+                  , const std::string &classdefKey
+                  , const ClassLut &classes
+                  , Aborter &aborter);
+
+/** Returns empty flat mask of given size. Masks are kept per thread and
+ *  shared; treat them as read-only.
+ */
+FlatMask emptyFlatMask(int cols, int rows);
+
+} // namespace landcover
+
+#endif // mapproxy_support_landcover_hpp_included_
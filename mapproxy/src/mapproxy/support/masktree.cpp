@@ -0,0 +1,169 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <map>
+#include <mutex>
+#include <atomic>
+
+#include <boost/filesystem.hpp>
+
+#include "dbglog/dbglog.hpp"
+
+#include "masktree.hpp"
+
+namespace fs = boost::filesystem;
+
+namespace {
+
+struct Stats {
+    std::atomic<std::uint64_t> loaded;
+    std::atomic<std::uint64_t> bytes;
+    std::atomic<std::uint64_t> loads;
+    std::atomic<std::uint64_t> shared;
+
+    Stats() : loaded(), bytes(), loads(), shared() {}
+};
+
+Stats stats;
+
+/** Loaded tree, accounted for while alive.
+ */
+struct Entry {
+    MaskTree tree;
+    std::uint64_t size;
+
+    Entry(const fs::path &path, std::uint64_t size)
+        : tree(path), size(size)
+    {
+        ++stats.loaded;
+        stats.bytes += size;
+    }
+
+    ~Entry() {
+        --stats.loaded;
+        stats.bytes -= size;
+    }
+};
+
+class Registry {
+public:
+    /** Returns shared tree, sets size to its file size.
+     */
+    std::shared_ptr<const MaskTree> get(const fs::path &path
+                                        , std::uint64_t &size);
+
+private:
+    typedef std::pair<std::string, std::time_t> Key;
+
+    std::mutex mutex_;
+    std::map<Key, std::weak_ptr<const Entry>> trees_;
+};
+
+std::shared_ptr<const MaskTree> Registry::get(const fs::path &path
+                                              , std::uint64_t &size)
+{
+    const Key key(fs::absolute(path).string(), fs::last_write_time(path));
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto &slot(trees_[key]);
+    auto entry(slot.lock());
+    if (entry) {
+        ++stats.shared;
+        size = entry->size;
+        return { entry, &entry->tree };
+    }
+
+    // drop dead slots while here
+    for (auto itrees(trees_.begin()); itrees != trees_.end(); ) {
+        if (itrees->second.expired() && (&itrees->second != &slot)) {
+            itrees = trees_.erase(itrees);
+        } else {
+            ++itrees;
+        }
+    }
+
+    LOG(info1) << "Loading mask tree " << path << ".";
+    entry = std::make_shared<const Entry>(path, fs::file_size(path));
+    ++stats.loads;
+    slot = entry;
+    size = entry->size;
+    return { entry, &entry->tree };
+}
+
+Registry registry;
+
+const std::shared_ptr<const MaskTree> emptyTree
+    (std::make_shared<const MaskTree>());
+
+} // namespace
+
+SharedMaskTree::SharedMaskTree
+(const boost::optional<boost::filesystem::path> &path)
+    : path_(path ? *path : fs::path()), size_()
+    , tree_(path ? registry.get(*path, size_) : emptyTree)
+{}
+
+std::size_t SharedMaskTree::prefault() const
+{
+    if (path_.empty()) { return 0; }
+
+    const int fd(::open(path_.c_str(), O_RDONLY | O_CLOEXEC));
+    if (fd < 0) { return 0; }
+
+    struct ::stat st;
+    std::size_t size(0);
+    if (!::fstat(fd, &st)) {
+        size = st.st_size;
+        ::posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+    }
+    ::close(fd);
+    return size;
+}
+
+void SharedMaskTree::stat(std::ostream &os, const std::string &prefix)
+{
+    os << prefix << "loaded=" << stats.loaded << '\n'
+       << prefix << "bytes=" << stats.bytes << '\n'
+       << prefix << "loads=" << stats.loads << '\n'
+       << prefix << "shared=" << stats.shared << '\n';
+}
+
+void SharedMaskTree::metrics(metrics::Writer &writer
+                             , const std::string &prefix)
+{
+    writer.gauge(prefix + "loaded", "Mask trees currently mapped."
+                 , stats.loaded);
+    writer.gauge(prefix + "bytes", "Size of mask trees currently mapped."
+                 , stats.bytes);
+    writer.counter(prefix + "loads", "Mask tree loads.", stats.loads);
+    writer.counter(prefix + "shared"
+                   , "Mask tree requests served by an already mapped tree."
+                   , stats.shared);
+}
@@ -0,0 +1,88 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef mapproxy_support_masktree_hpp_included_
+#define mapproxy_support_masktree_hpp_included_
+
+#include <memory>
+#include <string>
+#include <ostream>
+#include <cstdint>
+
+#include <boost/optional.hpp>
+#include <boost/filesystem/path.hpp>
+
+#include "coverage.hpp"
+#include "metrics.hpp"
+
+/** Mask tree shared by all generators using the same file.
+ *
+ *  Trees are loaded through a process-wide registry keyed by path and
+ *  modification time: resources pointing at the same mask (e.g. a coastline
+ *  mask generated by mapproxy-rf-mask) map it only once. Tree is unmapped
+ *  when its last user goes away; replaced file (new mtime) is loaded anew.
+ *
+ *  Converts to const MaskTree& so it can be passed wherever a mask tree is
+ *  expected.
+ */
+class SharedMaskTree {
+public:
+    /** Loads (or shares) mask tree at given path. No path -> empty tree.
+     */
+    SharedMaskTree(const boost::optional<boost::filesystem::path> &path
+                   = boost::none);
+
+    const MaskTree& get() const { return *tree_; }
+    operator const MaskTree&() const { return *tree_; }
+
+    /** Valid (non-empty) tree.
+     */
+    explicit operator bool() const { return bool(*tree_); }
+
+    /** Asks the kernel to read the tree file into the page cache so that
+     *  first use does not wait for the disk. Returns file size.
+     */
+    std::size_t prefault() const;
+
+    /** Size of loaded tree (0 for empty tree). Shared trees are counted by
+     *  each of their users.
+     */
+    std::size_t size() const { return size_; }
+
+    /** Registry statistics: loaded trees, their mapped size, loads and
+     *  shared hits.
+     */
+    static void stat(std::ostream &os, const std::string &prefix);
+
+    static void metrics(metrics::Writer &writer, const std::string &prefix);
+
+private:
+    boost::filesystem::path path_;
+    std::uint64_t size_;
+    std::shared_ptr<const MaskTree> tree_;
+};
+
+#endif // mapproxy_support_masktree_hpp_included_
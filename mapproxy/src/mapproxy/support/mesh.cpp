@@ -24,6 +24,10 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <map>
+#include <string>
+#include <utility>
+
 #include "math/math.hpp"
 #include "geometry/meshop.hpp"
 #include "imgproc/scanconversion.hpp"
@@ -95,6 +99,15 @@ meshFromNode(const vts::NodeInfo &nodeInfo, const math::Size2 &edges
         return &index;
     });
 
+    // remember grid validity
+    res.gridEdges = edges;
+    res.gridValid.resize(std::size_t(edges.width + 1) * (edges.height + 1));
+    for (int j(0), je(edges.height); j <= je; ++j) {
+        for (int i(0), ie(edges.width); i <= ie; ++i) {
+            res.gridValid[j * (ie + 1) + i] = (indices(j, i) >= 0);
+        }
+    }
+
     // mesh the grid
     for (int j(0), je(edges.height); j < je; ++j) {
         for (int i(0), ie(edges.width); i < ie; ++i) {
@@ -298,28 +311,182 @@ void meshCoverageMask(vts::Mesh::CoverageMask &mask, const geometry::Mesh &mesh
     }
 }
 
-void addSkirt(geometry::Mesh &mesh, const vts::NodeInfo &nodeInfo)
+void meshCoverageMask(vts::Mesh::CoverageMask &mask, const AugmentedMesh &mesh
+                      , const vts::NodeInfo &nodeInfo)
 {
-    const auto skirtHeight(math::size(nodeInfo.extents()).width * 0.01);
+    if (mesh.fullyCovered || mesh.gridValid.empty()) {
+        return meshCoverageMask(mask, mesh.mesh, nodeInfo, mesh.fullyCovered);
+    }
+
+    const auto size(vts::Mesh::coverageSize());
+    const auto &edges(mesh.gridEdges);
+    const int stride(edges.width + 1);
+    const auto valid([&](int i, int j) -> bool
+    {
+        return mesh.gridValid[j * stride + i];
+    });
 
-    // fake texture coordinate, needed by skirt
-    mesh.tCoords.emplace_back();
+    // coverage pixel -> grid scale
+    const double sx(double(edges.width) / size.width);
+    const double sy(double(edges.height) / size.height);
 
+    mask.recreate(vts::Mesh::coverageOrder, 0);
+    for (int y(0); y < size.height; ++y) {
+        // pixel center in grid coordinates
+        const double v((y + 0.5) * sy);
+        const int j(std::min(int(v), edges.height - 1));
+        const double fy(v - j);
+
+        for (int x(0); x < size.width; ++x) {
+            const double u((x + 0.5) * sx);
+            const int i(std::min(int(u), edges.width - 1));
+            const double fx(u - i);
+
+            // grid cell: 4 valid vertices -> 2 triangles, 3 valid vertices ->
+            // triangle opposite to the missing one (see meshFromNode)
+            const bool v00(valid(i, j)), v01(valid(i + 1, j));
+            const bool v10(valid(i, j + 1)), v11(valid(i + 1, j + 1));
+
+            bool covered(false);
+            switch (v00 + v01 + v10 + v11) {
+            case 4: covered = true; break;
+            case 3: {
+                // point is inside if not closer to missing corner than the
+                // diagonal
+                const double mx((!v01 || !v11) ? 1.0 : 0.0);
+                const double my((!v10 || !v11) ? 1.0 : 0.0);
+                covered = ((std::abs(fx - mx) + std::abs(fy - my)) >= 1.0);
+                break;
+            }
+            default: break;
+            }
+
+            if (covered) { mask.set(x, y, 1); }
+        }
+    }
+}
+
+void addSkirt(geometry::Mesh &mesh, const vts::NodeInfo &nodeInfo)
+{
     // skirt (use just tile-size width)
-    mesh.skirt(math::Point3(0.0, 0.0, -skirtHeight));
+    const math::Point3 down
+        (0.0, 0.0, -math::size(nodeInfo.extents()).width * 0.01);
+
+    const auto vertexCount(mesh.vertices.size());
+    const auto faceCount(mesh.faces.size());
+
+    // outgoing edges of each vertex (compressed rows)
+    std::vector<unsigned int> first(vertexCount + 1, 0);
+    for (const auto &f : mesh.faces) {
+        ++first[f.a + 1]; ++first[f.b + 1]; ++first[f.c + 1];
+    }
+    for (std::size_t v(0); v < vertexCount; ++v) { first[v + 1] += first[v]; }
+
+    std::vector<unsigned int> targets(3 * faceCount);
+    {
+        auto fill(first);
+        for (const auto &f : mesh.faces) {
+            targets[fill[f.a]++] = f.b;
+            targets[fill[f.b]++] = f.c;
+            targets[fill[f.c]++] = f.a;
+        }
+    }
+
+    // edge a -> b lies on boundary if there is no b -> a
+    const auto boundary([&](unsigned int a, unsigned int b) -> bool
+    {
+        for (auto i(first[b]), e(first[b + 1]); i != e; ++i) {
+            if (targets[i] == a) { return false; }
+        }
+        return true;
+    });
+
+    // skirt vertex for each boundary vertex, created on demand
+    std::vector<int> lowered(vertexCount, -1);
+    const auto lower([&](unsigned int v) -> unsigned int
+    {
+        auto &l(lowered[v]);
+        if (l < 0) {
+            l = mesh.vertices.size();
+            mesh.vertices.push_back(mesh.vertices[v] + down);
+        }
+        return l;
+    });
+
+    for (unsigned int a(0); a < vertexCount; ++a) {
+        for (auto i(first[a]), e(first[a + 1]); i != e; ++i) {
+            const auto b(targets[i]);
+            if (!boundary(a, b)) { continue; }
+
+            // faces are counter-clockwise, i.e. outside lies on the right of
+            // a -> b; skirt faces outwards
+            const auto la(lower(a)), lb(lower(b));
+            mesh.addFace(a, lb, b);
+            mesh.addFace(a, la, lb);
+        }
+    }
 }
 
+namespace {
+
+/** Per-thread cache of convertors keyed by (kind, source SRS, destination
+ *  SRS, geoid grid). Creating a convertor means parsing SRS definitions and
+ *  creating PROJ objects which is way more expensive than its use.
+ *
+ *  PROJ objects must not be used concurrently, hence the cache is thread
+ *  local: returned convertors share their PROJ objects with the cache and
+ *  must stay in the calling thread (which is the case for all convertors
+ *  used while generating a tile).
+ */
+class ConvertorCache {
+public:
+    template <typename Factory>
+    vts::CsConvertor get(char kind, const std::string &src
+                         , const std::string &dst
+                         , const boost::optional<std::string> &geoidGrid
+                         , const Factory &factory)
+    {
+        std::string key(1, kind);
+        key.append(src).push_back('\n');
+        key.append(dst).push_back('\n');
+        if (geoidGrid) { key.append(*geoidGrid); }
+
+        auto fcache(cache_.find(key));
+        if (fcache != cache_.end()) { return fcache->second; }
+
+        // bounded: forget everything when full
+        if (cache_.size() >= MaxSize) { cache_.clear(); }
+        return cache_.emplace(key, factory()).first->second;
+    }
+
+private:
+    static constexpr std::size_t MaxSize = 256;
+
+    std::map<std::string, vts::CsConvertor> cache_;
+};
+
+ConvertorCache& convertorCache()
+{
+    thread_local ConvertorCache cache;
+    return cache;
+}
+
+} // namespace
+
 vts::CsConvertor sds2srs(const std::string &sds, const std::string &dst
                          , const boost::optional<std::string> &geoidGrid)
 {
-    if (!geoidGrid) {
-        return vts::CsConvertor(sds, dst);
-    }
+    return convertorCache().get('s', sds, dst, geoidGrid, [&]()
+    {
+        if (!geoidGrid) {
+            return vts::CsConvertor(sds, dst);
+        }
 
-    // force given geoid
-    return vts::CsConvertor
-        (geo::setGeoid(vr::system.srs(sds).srsDef, *geoidGrid)
-         , dst);
+        // force given geoid
+        return vts::CsConvertor
+            (geo::setGeoid(vr::system.srs(sds).srsDef, *geoidGrid)
+             , dst);
+    });
 }
 
 vts::CsConvertor sds2phys(const vts::NodeInfo &nodeInfo
@@ -351,14 +518,22 @@ vts::CsConvertor sdsg2sdsr(const vts::NodeInfo &nodeInfo
                            , const boost::optional<std::string> &geoidGrid)
 {
     if (!geoidGrid) { return {}; }
-    return vts::CsConvertor(sds(nodeInfo, geoidGrid), nodeInfo.srs());
+    return convertorCache().get
+        ('g', nodeInfo.srs(), nodeInfo.srs(), geoidGrid, [&]()
+    {
+        return vts::CsConvertor(sds(nodeInfo, geoidGrid), nodeInfo.srs());
+    });
 }
 
 vts::CsConvertor phys2sds(const vts::NodeInfo &nodeInfo
                          , const boost::optional<std::string> &geoidGrid)
 {
-    return vts::CsConvertor(nodeInfo.referenceFrame().model.physicalSrs
-                            , sds(nodeInfo, geoidGrid));
+    const auto &physicalSrs(nodeInfo.referenceFrame().model.physicalSrs);
+    return convertorCache().get
+        ('p', physicalSrs, nodeInfo.srs(), geoidGrid, [&]()
+    {
+        return vts::CsConvertor(physicalSrs, sds(nodeInfo, geoidGrid));
+    });
 }
 
 std::array<math::Point3, 4>
@@ -522,7 +697,7 @@ int TileFacesCalculator::operator()(double meshArea, double meshProjectedArea)
     return base_* factor;
 }
 
-qmf::Mesh qmfMesh(const geometry::Mesh &gmesh, const vts::NodeInfo &nodeInfo
+qmf::Mesh qmfMesh(geometry::Mesh gmesh, const vts::NodeInfo &nodeInfo
                   , const std::string &srs
                   , const boost::optional<std::string> &geoidGrid)
 {
@@ -532,7 +707,7 @@ qmf::Mesh qmfMesh(const geometry::Mesh &gmesh, const vts::NodeInfo &nodeInfo
 
     qmf::Mesh mesh;
     mesh.extents = conv(extents);
-    mesh.mesh = gmesh;
+    mesh.mesh = std::move(gmesh);
 
     // transform to output SRS
     for (auto &v : mesh.mesh.vertices) { v = conv(transform(l2g, v)); }
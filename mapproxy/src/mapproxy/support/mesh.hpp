@@ -69,6 +69,13 @@ struct AugmentedMesh {
     boost::optional<std::string> geoidGrid;
     unsigned int textureLayerId;
 
+    /** Validity of grid vertices the mesh was generated from (row-major,
+     *  (gridEdges + 1) vertices per side); empty if mesh is not grid based.
+     *  Used to derive coverage mask without rasterizing the mesh.
+     */
+    std::vector<char> gridValid;
+    math::Size2 gridEdges;
+
     AugmentedMesh() : fullyCovered(false), textureLayerId() {}
 };
 
@@ -85,6 +92,14 @@ void simplifyMesh(geometry::Mesh &mesh, const vts::NodeInfo &nodeInfo
 void meshCoverageMask(vts::Mesh::CoverageMask &mask, const geometry::Mesh &mesh
                       , const vts::NodeInfo &nodeInfo, bool fullyCovered);
 
+/** Coverage mask of augmented mesh: full if fully covered, derived from grid
+ *  validity for grid based meshes, rasterized from mesh otherwise.
+ */
+void meshCoverageMask(vts::Mesh::CoverageMask &mask, const AugmentedMesh &mesh
+                      , const vts::NodeInfo &nodeInfo);
+
+/** Adds skirt along all boundary edges (outer border and holes).
+ */
 void addSkirt(geometry::Mesh &mesh, const vts::NodeInfo &nodeInfo);
 
 vts::SubMesh& addSubMesh(vts::Mesh &mesh, const geometry::Mesh &gmesh
@@ -93,7 +108,10 @@ vts::SubMesh& addSubMesh(vts::Mesh &mesh, const geometry::Mesh &gmesh
                          , vts::SubMesh::TextureMode textureMode
                          = vts::SubMesh::external);
 
-qmf::Mesh qmfMesh(const geometry::Mesh &gmesh, const vts::NodeInfo &nodeInfo
+/** Converts mesh in SDS to quantized mesh in given SRS. Mesh is taken by
+ *  value, move it in to avoid copy.
+ */
+qmf::Mesh qmfMesh(geometry::Mesh gmesh, const vts::NodeInfo &nodeInfo
                   , const std::string &srs
                   , const boost::optional<std::string> &geoidGrid);
 
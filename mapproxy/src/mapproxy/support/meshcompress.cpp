@@ -0,0 +1,324 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cmath>
+#include <limits>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+#include "utility/binaryio.hpp"
+
+#include "compression.hpp"
+#include "meshcompress.hpp"
+
+namespace bin = utility::binaryio;
+
+namespace {
+
+const char MPCM_MAGIC[4] = { 'M', 'P', 'C', 'M' };
+const std::uint16_t MPCM_VERSION(1);
+
+typedef std::vector<std::uint32_t> Indices;
+
+/** Vertex cache optimization, after Tom Forsyth's "Linear-Speed Vertex Cache
+ *  Optimisation". Returns new face order.
+ */
+class CacheOptimizer {
+public:
+    CacheOptimizer(const Indices &indices, std::size_t vertexCount)
+        : indices_(indices), faceCount_(indices.size() / 3)
+        , offsets_(vertexCount + 1), remaining_(vertexCount)
+        , cachePos_(vertexCount, -1), vertexScore_(vertexCount)
+        , faceScore_(faceCount_), emitted_(faceCount_)
+    {
+        // vertex -> face adjacency
+        for (auto i : indices_) { ++remaining_[i]; }
+        for (std::size_t v(0); v < vertexCount; ++v) {
+            offsets_[v + 1] = offsets_[v] + remaining_[v];
+        }
+        adjacency_.resize(indices_.size());
+        {
+            auto fill(offsets_);
+            for (std::size_t i(0); i < indices_.size(); ++i) {
+                adjacency_[fill[indices_[i]]++] = i / 3;
+            }
+        }
+
+        for (std::size_t v(0); v < vertexCount; ++v) {
+            vertexScore_[v] = score(v);
+        }
+        for (std::size_t f(0); f < faceCount_; ++f) {
+            faceScore_[f] = faceScore(f);
+        }
+    }
+
+    std::vector<std::size_t> run();
+
+private:
+    static constexpr int CacheSize = 32;
+
+    float score(std::size_t v) const {
+        if (!remaining_[v]) { return -1.f; }
+
+        float s(0.f);
+        const int pos(cachePos_[v]);
+        if (pos >= 0) {
+            if (pos < 3) {
+                // last triangle's vertices
+                s = 0.75f;
+            } else {
+                s = std::pow(1.f - float(pos - 3) / (CacheSize - 3), 1.5f);
+            }
+        }
+
+        // boost vertices with few remaining faces
+        return s + 2.f / std::sqrt(float(remaining_[v]));
+    }
+
+    float faceScore(std::size_t f) const {
+        return (vertexScore_[indices_[3 * f]]
+                + vertexScore_[indices_[3 * f + 1]]
+                + vertexScore_[indices_[3 * f + 2]]);
+    }
+
+    const Indices &indices_;
+    const std::size_t faceCount_;
+
+    std::vector<std::uint32_t> offsets_;
+    std::vector<std::uint32_t> adjacency_;
+    std::vector<std::uint32_t> remaining_;
+    std::vector<int> cachePos_;
+    std::vector<float> vertexScore_;
+    std::vector<float> faceScore_;
+    std::vector<char> emitted_;
+};
+
+std::vector<std::size_t> CacheOptimizer::run()
+{
+    std::vector<std::size_t> order;
+    order.reserve(faceCount_);
+
+    std::vector<std::uint32_t> cache;
+    std::vector<std::uint32_t> newCache;
+    cache.reserve(CacheSize + 3);
+    newCache.reserve(CacheSize + 3);
+
+    std::size_t cursor(0);
+    std::size_t best(faceCount_);
+
+    while (order.size() < faceCount_) {
+        if (best == faceCount_) {
+            // no candidate in cache, take next unemitted face
+            while (emitted_[cursor]) { ++cursor; }
+            best = cursor;
+        }
+
+        // emit
+        emitted_[best] = true;
+        order.push_back(best);
+
+        const auto *face(&indices_[3 * best]);
+        for (int i(0); i < 3; ++i) { --remaining_[face[i]]; }
+
+        // new cache: emitted face first, then old content
+        newCache.assign(face, face + 3);
+        for (auto v : cache) {
+            if ((v != face[0]) && (v != face[1]) && (v != face[2])) {
+                newCache.push_back(v);
+            }
+        }
+
+        for (auto v : cache) { cachePos_[v] = -1; }
+        for (std::size_t i(0); i < newCache.size(); ++i) {
+            cachePos_[newCache[i]] = (i < CacheSize) ? int(i) : -1;
+        }
+
+        // update scores of touched vertices (including evicted ones)
+        for (auto v : newCache) { vertexScore_[v] = score(v); }
+
+        if (newCache.size() > CacheSize) { newCache.resize(CacheSize); }
+        std::swap(cache, newCache);
+
+        // find best face adjacent to cached vertices
+        best = faceCount_;
+        float bestScore(-1.f);
+        for (auto v : cache) {
+            for (auto a(offsets_[v]), e(offsets_[v + 1]); a != e; ++a) {
+                const auto f(adjacency_[a]);
+                if (emitted_[f]) { continue; }
+                const auto s(faceScore_[f] = faceScore(f));
+                if (s > bestScore) { bestScore = s; best = f; }
+            }
+        }
+    }
+
+    return order;
+}
+
+/** Renumbers indices in order of first use. Returns new -> old mapping.
+ */
+std::vector<std::uint32_t> renumber(Indices &indices, std::size_t count)
+{
+    const auto unused(std::numeric_limits<std::uint32_t>::max());
+    std::vector<std::uint32_t> remap(count, unused);
+    std::vector<std::uint32_t> inverse;
+    inverse.reserve(count);
+
+    for (auto &i : indices) {
+        auto &r(remap[i]);
+        if (r == unused) {
+            r = inverse.size();
+            inverse.push_back(i);
+        }
+        i = r;
+    }
+
+    return inverse;
+}
+
+template <typename Faces>
+Indices flatten(const Faces &faces)
+{
+    Indices indices;
+    indices.reserve(3 * faces.size());
+    for (const auto &face : faces) {
+        for (int i(0); i < 3; ++i) { indices.push_back(face(i)); }
+    }
+    return indices;
+}
+
+template <typename Faces>
+Indices flatten(const Faces &faces, const std::vector<std::size_t> &order)
+{
+    Indices indices;
+    indices.reserve(3 * faces.size());
+    for (auto f : order) {
+        for (int i(0); i < 3; ++i) { indices.push_back(faces[f](i)); }
+    }
+    return indices;
+}
+
+std::uint16_t quantize(double value, double min, double max)
+{
+    if (max <= min) { return 0; }
+    const auto q(std::round((value - min) / (max - min) * 65535.0));
+    return std::uint16_t(std::min(std::max(q, 0.0), 65535.0));
+}
+
+template <typename Points, int Dims>
+void writeQuantized(std::ostream &os, const Points &points
+                    , const std::vector<std::uint32_t> &order)
+{
+    double min[Dims], max[Dims];
+    std::fill_n(min, Dims, std::numeric_limits<double>::max());
+    std::fill_n(max, Dims, std::numeric_limits<double>::lowest());
+    for (const auto &p : points) {
+        for (int d(0); d < Dims; ++d) {
+            min[d] = std::min(min[d], double(p(d)));
+            max[d] = std::max(max[d], double(p(d)));
+        }
+    }
+    if (points.empty()) {
+        std::fill_n(min, Dims, 0.0);
+        std::fill_n(max, Dims, 0.0);
+    }
+
+    for (int d(0); d < Dims; ++d) { bin::write(os, min[d]); }
+    for (int d(0); d < Dims; ++d) { bin::write(os, max[d]); }
+
+    for (auto i : order) {
+        const auto &p(points[i]);
+        for (int d(0); d < Dims; ++d) {
+            bin::write(os, quantize(p(d), min[d], max[d]));
+        }
+    }
+}
+
+void writeIndices(std::ostream &os, const Indices &indices
+                  , std::size_t count)
+{
+    if (count <= 65536) {
+        for (auto i : indices) { bin::write(os, std::uint16_t(i)); }
+    } else {
+        for (auto i : indices) { bin::write(os, std::uint32_t(i)); }
+    }
+}
+
+void writeSubmesh(std::ostream &os, const vts::SubMesh &sm)
+{
+    const bool hasTc(!sm.tc.empty() && !sm.facesTc.empty());
+    const bool hasEtc(!sm.etc.empty());
+
+    // reorder faces for vertex cache, then renumber vertices and tc
+    const auto order(CacheOptimizer(flatten(sm.faces), sm.vertices.size())
+                     .run());
+
+    auto faces(flatten(sm.faces, order));
+    const auto vertexOrder(renumber(faces, sm.vertices.size()));
+
+    Indices facesTc;
+    std::vector<std::uint32_t> tcOrder;
+    if (hasTc) {
+        facesTc = flatten(sm.facesTc, order);
+        tcOrder = renumber(facesTc, sm.tc.size());
+    }
+
+    bin::write(os, std::uint8_t((hasTc ? 1 : 0) | (hasEtc ? 2 : 0)));
+    bin::write(os, std::uint8_t(sm.textureMode));
+    bin::write(os, std::uint16_t(sm.textureLayer ? *sm.textureLayer : 0));
+    bin::write(os, std::uint8_t(sm.surfaceReference));
+    bin::write(os, std::uint8_t(0)); // reserved
+
+    bin::write(os, std::uint32_t(vertexOrder.size()));
+    bin::write(os, std::uint32_t(tcOrder.size()));
+    bin::write(os, std::uint32_t(order.size()));
+
+    writeQuantized<decltype(sm.vertices), 3>(os, sm.vertices, vertexOrder);
+    if (hasEtc) {
+        writeQuantized<decltype(sm.etc), 2>(os, sm.etc, vertexOrder);
+    }
+    if (hasTc) {
+        writeQuantized<decltype(sm.tc), 2>(os, sm.tc, tcOrder);
+    }
+
+    writeIndices(os, faces, vertexOrder.size());
+    if (hasTc) { writeIndices(os, facesTc, tcOrder.size()); }
+}
+
+} // namespace
+
+void saveCompressedMesh(std::ostream &os, const vts::Mesh &mesh)
+{
+    compression::Gzipper gzipper(os, compression::Target::mesh);
+    std::ostream &gos(gzipper);
+
+    bin::write(gos, MPCM_MAGIC);
+    bin::write(gos, MPCM_VERSION);
+    bin::write(gos, std::uint16_t(mesh.submeshes.size()));
+
+    for (const auto &sm : mesh.submeshes) { writeSubmesh(gos, sm); }
+}
@@ -0,0 +1,62 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef mapproxy_support_meshcompress_hpp_included_
+#define mapproxy_support_meshcompress_hpp_included_
+
+#include <ostream>
+
+#include "vts-libs/vts/mesh.hpp"
+
+namespace vts = vtslibs::vts;
+
+/** Compressed mesh: mapproxy specific mesh flavor.
+ *
+ *  Faces are reordered for post-transform vertex cache locality (Forsyth),
+ *  vertices and texture coordinates are renumbered in order of first use and
+ *  quantized to 16 bits over their submesh bounding box. Whole stream is
+ *  gzipped.
+ *
+ *  Layout (little endian, after gunzip):
+ *
+ *      char[4] magic "MPCM"; uint16 version; uint16 submeshCount
+ *      submesh {
+ *          uint8 flags (1: tc, 2: etc); uint8 textureMode
+ *          uint16 textureLayer; uint8 surfaceReference; uint8 reserved
+ *          uint32 vertexCount; uint32 tcCount; uint32 faceCount
+ *          double[6] vertex bbox (min xyz, max xyz)
+ *          uint16[3 * vertexCount] vertices
+ *          if etc: double[4] etc bbox; uint16[2 * vertexCount] etc
+ *          if tc: double[4] tc bbox; uint16[2 * tcCount] tc
+ *          index[3 * faceCount] faces
+ *          if tc: index[3 * faceCount] facesTc
+ *      }
+ *
+ *  Index is uint16 when referenced count is <= 65536, uint32 otherwise.
+ */
+void saveCompressedMesh(std::ostream &os, const vts::Mesh &mesh);
+
+#endif // mapproxy_support_meshcompress_hpp_included_
@@ -240,6 +240,22 @@ cv::Mat boundlayerMetatileFromMaskTree(const vts::TileId &tileId
     }
     if (boundsList.empty()) { return metatile; }
 
+    // uniform metatile area: answer without rasterizing the tree
+    const auto coverage(maskTreeCoverage(maskTree, tileId.lod, tileId.x
+                                         , tileId.y, metatile.cols));
+    if (coverage.empty()) { return metatile; }
+    if (coverage.watertight()) {
+        cv::Rect r(0, 0, metatile.cols, metatile.rows);
+        for (const auto &bounds : boundsList) {
+            r = r & bounds;
+            if (!r.width || !r.height) { return metatile; }
+        }
+        imgproc::fillRectangle
+            (metatile, r, cv::Scalar(BL::MetaFlags::available
+                                     | BL::MetaFlags::watertight));
+        return metatile;
+    }
+
     // clip sampling depth
     int depth(std::min(int(tileId.lod), int(maskTree.depth())));
 
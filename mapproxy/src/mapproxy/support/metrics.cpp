@@ -0,0 +1,170 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "metrics.hpp"
+
+namespace metrics {
+
+const std::string ContentType
+    ("application/openmetrics-text; version=1.0.0; charset=utf-8");
+
+const std::array<std::uint64_t, Histogram::BucketCount> Histogram::Bounds = {{
+    1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 500000
+    , 1000000, 2500000, 5000000, 10000000, 30000000
+}};
+
+Histogram::Histogram()
+    : sum_(0)
+{
+    for (auto &bucket : buckets_) { bucket = 0; }
+}
+
+void Histogram::observe(std::uint64_t usec)
+{
+    std::size_t index(0);
+    while ((index < BucketCount) && (usec > Bounds[index])) { ++index; }
+
+    buckets_[index].fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(usec, std::memory_order_relaxed);
+}
+
+namespace {
+
+void escape(std::ostream &os, const std::string &value)
+{
+    for (char c : value) {
+        switch (c) {
+        case '\\': os << "\\\\"; break;
+        case '"': os << "\\\""; break;
+        case '\n': os << "\\n"; break;
+        default: os << c;
+        }
+    }
+}
+
+} // namespace
+
+void Writer::header(const std::string &name, const char *type
+                    , const std::string &help)
+{
+    os_ << "# TYPE " << name << ' ' << type << '\n'
+        << "# HELP " << name << ' ';
+    escape(os_, help);
+    os_ << '\n';
+}
+
+void Writer::labels(const Labels &labels, const char *le)
+{
+    if (labels.empty() && !le) { return; }
+
+    os_ << '{';
+    const char *separator("");
+    for (const auto &label : labels) {
+        os_ << separator << label.first << "=\"";
+        escape(os_, label.second);
+        os_ << '"';
+        separator = ",";
+    }
+    if (le) { os_ << separator << "le=\"" << le << '"'; }
+    os_ << '}';
+}
+
+void Writer::write(const Family<Counter> &family)
+{
+    header(family.name, "counter", family.help);
+
+    std::shared_lock<std::shared_timed_mutex> lock(family.mutex_);
+    for (const auto &item : family.series_) {
+        os_ << family.name << "_total";
+        labels(item.first);
+        os_ << ' ' << item.second->value() << '\n';
+    }
+}
+
+void Writer::write(const Family<Gauge> &family)
+{
+    header(family.name, "gauge", family.help);
+
+    std::shared_lock<std::shared_timed_mutex> lock(family.mutex_);
+    for (const auto &item : family.series_) {
+        os_ << family.name;
+        labels(item.first);
+        os_ << ' ' << item.second->value() << '\n';
+    }
+}
+
+void Writer::write(const Family<Histogram> &family)
+{
+    header(family.name, "histogram", family.help);
+
+    std::shared_lock<std::shared_timed_mutex> lock(family.mutex_);
+    for (const auto &item : family.series_) {
+        const auto &histogram(*item.second);
+
+        std::uint64_t count(0);
+        for (std::size_t i(0); i <= Histogram::BucketCount; ++i) {
+            count += histogram.buckets_[i].load(std::memory_order_relaxed);
+
+            const auto le((i < Histogram::BucketCount)
+                          ? std::to_string(Histogram::Bounds[i] / 1e6)
+                          : std::string("+Inf"));
+            os_ << family.name << "_bucket";
+            labels(item.first, le.c_str());
+            os_ << ' ' << count << '\n';
+        }
+
+        os_ << family.name << "_count";
+        labels(item.first);
+        os_ << ' ' << count << '\n';
+
+        os_ << family.name << "_sum";
+        labels(item.first);
+        os_ << ' '
+            << (histogram.sum_.load(std::memory_order_relaxed) / 1e6)
+            << '\n';
+    }
+}
+
+void Writer::counter(const std::string &name, const std::string &help
+                     , std::uint64_t value)
+{
+    header(name, "counter", help);
+    os_ << name << "_total " << value << '\n';
+}
+
+void Writer::gauge(const std::string &name, const std::string &help
+                   , double value)
+{
+    header(name, "gauge", help);
+    os_ << name << ' ' << value << '\n';
+}
+
+void Writer::finish()
+{
+    os_ << "# EOF\n";
+}
+
+} // namespace metrics
@@ -0,0 +1,191 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef mapproxy_support_metrics_hpp_included_
+#define mapproxy_support_metrics_hpp_included_
+
+#include <map>
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <vector>
+#include <utility>
+#include <cstdint>
+#include <ostream>
+#include <shared_mutex>
+
+/** Lock-free metrics rendered in OpenMetrics text format.
+ *
+ *  Metric values are plain atomics updated without any locking. Series of a
+ *  family are created on first use under exclusive lock; both lookup of an
+ *  existing series and scraping take only shared lock, i.e. scraping never
+ *  blocks request processing.
+ */
+namespace metrics {
+
+/** Label name/value pairs.
+ */
+typedef std::vector<std::pair<std::string, std::string>> Labels;
+
+/** OpenMetrics content type.
+ */
+extern const std::string ContentType;
+
+/** Monotonic counter.
+ */
+class Counter {
+public:
+    Counter() : value_(0) {}
+
+    void inc(std::uint64_t value = 1) {
+        value_.fetch_add(value, std::memory_order_relaxed);
+    }
+
+    std::uint64_t value() const {
+        return value_.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<std::uint64_t> value_;
+};
+
+/** Value that can go up and down.
+ */
+class Gauge {
+public:
+    Gauge() : value_(0) {}
+
+    void set(double value) { value_.store(value, std::memory_order_relaxed); }
+
+    double value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<double> value_;
+};
+
+/** Latency histogram with fixed buckets. Observed in microseconds, rendered
+ *  in seconds.
+ */
+class Histogram {
+public:
+    static constexpr std::size_t BucketCount = 14;
+
+    /** Upper bounds of finite buckets (in microseconds).
+     */
+    static const std::array<std::uint64_t, BucketCount> Bounds;
+
+    Histogram();
+
+    void observe(std::uint64_t usec);
+
+private:
+    friend class Writer;
+
+    /** Non-cumulative bucket counts, last one is +Inf.
+     */
+    std::array<std::atomic<std::uint64_t>, BucketCount + 1> buckets_;
+    std::atomic<std::uint64_t> sum_;
+};
+
+/** Set of series sharing a name, distinguished by labels. Series live as
+ *  long as the family, references are stable.
+ */
+template <typename T>
+class Family {
+public:
+    Family(const std::string &name, const std::string &help)
+        : name(name), help(help)
+    {}
+
+    /** Returns series with given labels, creates it on first use.
+     */
+    T& operator()(const Labels &labels);
+
+    const std::string name;
+    const std::string help;
+
+private:
+    friend class Writer;
+
+    mutable std::shared_timed_mutex mutex_;
+    std::map<Labels, std::unique_ptr<T>> series_;
+};
+
+/** OpenMetrics text writer.
+ */
+class Writer {
+public:
+    Writer(std::ostream &os) : os_(os) {}
+
+    void write(const Family<Counter> &family);
+    void write(const Family<Gauge> &family);
+    void write(const Family<Histogram> &family);
+
+    /** Writes single unlabelled counter.
+     */
+    void counter(const std::string &name, const std::string &help
+                 , std::uint64_t value);
+
+    /** Writes single unlabelled gauge.
+     */
+    void gauge(const std::string &name, const std::string &help
+               , double value);
+
+    /** Writes terminating EOF marker.
+     */
+    void finish();
+
+private:
+    void header(const std::string &name, const char *type
+                , const std::string &help);
+
+    void labels(const Labels &labels, const char *le = nullptr);
+
+    std::ostream &os_;
+};
+
+// inlines
+
+template <typename T>
+T& Family<T>::operator()(const Labels &labels)
+{
+    {
+        std::shared_lock<std::shared_timed_mutex> lock(mutex_);
+        auto fseries(series_.find(labels));
+        if (fseries != series_.end()) { return *fseries->second; }
+    }
+
+    std::unique_lock<std::shared_timed_mutex> lock(mutex_);
+    auto &series(series_[labels]);
+    if (!series) { series.reset(new T()); }
+    return *series;
+}
+
+} // namespace metrics
+
+#endif // mapproxy_support_metrics_hpp_included_
@@ -27,6 +27,7 @@
 #ifndef mapproxy_support_mmapped_memory_impl_hpp_included_
 #define mapproxy_support_mmapped_memory_impl_hpp_included_
 
+#include <boost/noncopyable.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/iostreams/stream_buffer.hpp>
 #include <boost/iostreams/device/array.hpp>
@@ -40,25 +41,41 @@
 
 namespace mmapped {
 
-struct Memory {
-    Memory(const boost::filesystem::path &path)
-        : size(utility::fileSize(path))
-        , file(path.c_str(), boost::interprocess::read_only)
-        , region(file, boost::interprocess::read_only, 0, size)
-        , data(static_cast<char*>(region.get_address()))
-        , buffer(data, data + size)
-        , stream(&buffer)
-    {}
+struct Memory : boost::noncopyable {
+    Memory(const boost::filesystem::path &path
+           , const MapPolicy &policy = MapPolicy());
+
+    ~Memory();
 
     const char* addr(std::size_t pos) const { return data + pos; }
 
+    /** Number of bytes currently resident in RAM.
+     */
+    std::size_t resident() const;
+
+    /** Touches every page to fault it in.
+     */
+    void prefault() const;
+
     std::size_t size;
     boost::interprocess::file_mapping file;
     boost::interprocess::mapped_region region;
+
+    /** Anonymous copy of the file (see MapPolicy::copyLimit).
+     */
+    void *copy;
+    std::size_t copySize;
+
     const char *data;
 
     boost::iostreams::stream_buffer<boost::iostreams::array_source> buffer;
     std::istream stream;
+
+private:
+    /** Maps or copies the file according to policy, returns its address.
+     */
+    const char* load(const boost::filesystem::path &path
+                     , const MapPolicy &policy);
 };
 
 template <int magicSize>
@@ -0,0 +1,169 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <vector>
+#include <fstream>
+
+#include "dbglog/dbglog.hpp"
+
+#include "utility/filesystem.hpp"
+
+#include "memory-impl.hpp"
+
+namespace bi = boost::interprocess;
+
+namespace mmapped {
+
+namespace {
+
+std::size_t pageSize()
+{
+    static const std::size_t size(::sysconf(_SC_PAGESIZE));
+    return size;
+}
+
+int advice(MapPolicy::Advice advice)
+{
+    switch (advice) {
+    case MapPolicy::Advice::normal: break;
+    case MapPolicy::Advice::random: return MADV_RANDOM;
+    case MapPolicy::Advice::willneed: return MADV_WILLNEED;
+    }
+    return MADV_NORMAL;
+}
+
+void touch(const char *mem, std::size_t size)
+{
+    // touch every page
+    const volatile char *touch(mem);
+    for (std::size_t pos(0); pos < size; pos += pageSize()) {
+        (void) touch[pos];
+    }
+}
+
+} // namespace
+
+Memory::Memory(const boost::filesystem::path &path, const MapPolicy &policy)
+    : size(utility::fileSize(path))
+    , file(path.c_str(), bi::read_only)
+    , copy(), copySize()
+    , data(load(path, policy))
+    , buffer(data, data + size)
+    , stream(&buffer)
+{}
+
+Memory::~Memory()
+{
+    if (copy) { ::munmap(copy, copySize); }
+}
+
+const char* Memory::load(const boost::filesystem::path &path
+                         , const MapPolicy &policy)
+{
+    char *mem(nullptr);
+
+    if (size && (size <= policy.copyLimit)) {
+        // small file: private anonymous copy
+        copySize = ((size + pageSize() - 1) / pageSize()) * pageSize();
+        copy = ::mmap(nullptr, copySize, PROT_READ | PROT_WRITE
+                      , MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (copy == MAP_FAILED) {
+            LOG(warn2) << "Unable to allocate " << copySize
+                       << " bytes for a copy of " << path
+                       << ", mapping instead.";
+            copy = nullptr;
+        } else {
+#ifdef MADV_HUGEPAGE
+            // best effort, pointless for files smaller than a hugepage
+            ::madvise(copy, copySize, MADV_HUGEPAGE);
+#endif
+            try {
+                std::ifstream f;
+                f.exceptions(std::ios::badbit | std::ios::failbit);
+                f.open(path.string()
+                       , std::ios_base::in | std::ios_base::binary);
+                f.read(static_cast<char*>(copy), size);
+            } catch (...) {
+                // destructor is not called when constructor fails
+                ::munmap(copy, copySize);
+                copy = nullptr;
+                throw;
+            }
+            ::mprotect(copy, copySize, PROT_READ);
+            mem = static_cast<char*>(copy);
+        }
+    }
+
+    if (!mem) {
+        bi::mapped_region(file, bi::read_only, 0, size).swap(region);
+        mem = static_cast<char*>(region.get_address());
+
+        if (policy.advice != MapPolicy::Advice::normal) {
+            if (::madvise(mem, size, advice(policy.advice)) == -1) {
+                LOG(warn2) << "Cannot madvise " << path << ": "
+                           << std::strerror(errno) << ".";
+            }
+        }
+
+        if (policy.prefault) { touch(mem, size); }
+    }
+
+    if (size && (size <= policy.lockLimit)) {
+        if (::mlock(mem, size) == -1) {
+            LOG(warn2) << "Cannot lock " << path << " in memory: "
+                       << std::strerror(errno) << ".";
+        }
+    }
+
+    return mem;
+}
+
+void Memory::prefault() const
+{
+    touch(data, size);
+}
+
+std::size_t Memory::resident() const
+{
+    if (!size) { return 0; }
+
+    const auto ps(pageSize());
+    std::vector<unsigned char> pages((size + ps - 1) / ps);
+    if (::mincore(const_cast<char*>(data), size, pages.data()) == -1) {
+        return 0;
+    }
+
+    std::size_t count(0);
+    for (const auto page : pages) { count += (page & 1); }
+    return std::min(count * ps, size);
+}
+
+} // namespace mmapped
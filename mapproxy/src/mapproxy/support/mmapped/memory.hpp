@@ -30,6 +30,8 @@
 #include <array>
 #include <iostream>
 
+#include "utility/enum-io.hpp"
+
 #include "vts-libs/vts/tileindex.hpp"
 #include "vts-libs/vts/tileset/tilesetindex.hpp"
 
@@ -47,7 +49,35 @@ namespace mmapped {
 
 /** Memory information.
  */
-class Memory;
+struct Memory;
+
+/** How memory mapped files are brought into memory.
+ */
+struct MapPolicy {
+    /** Access pattern hint passed to madvise.
+     */
+    enum class Advice { normal, random, willneed };
+
+    Advice advice;
+
+    /** Fault in all pages right after mapping (i.e. MAP_POPULATE).
+     */
+    bool prefault;
+
+    /** Files up to this size (bytes) are copied into anonymous memory
+     *  (hugepage backed if possible) instead of being mapped. 0 disables.
+     */
+    std::size_t copyLimit;
+
+    /** Files up to this size (bytes) are locked in memory (mlock). 0
+     *  disables.
+     */
+    std::size_t lockLimit;
+
+    MapPolicy()
+        : advice(Advice::normal), prefault(false), copyLimit(), lockLimit()
+    {}
+};
 
 /** Memory reader
  */
@@ -116,4 +146,10 @@ private:
 
 } // namespace mmapped
 
+UTILITY_GENERATE_ENUM_IO(mmapped::MapPolicy::Advice,
+    ((normal))
+    ((random))
+    ((willneed))
+)
+
 #endif // mapproxy_support_mmapped_memory_hpp_included_
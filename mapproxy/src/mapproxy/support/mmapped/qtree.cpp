@@ -24,6 +24,8 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <deque>
+
 #include "dbglog/dbglog.hpp"
 
 #include "utility/filesystem.hpp"
@@ -46,25 +48,56 @@ const char MM_QTREE_MAGIC[4] = { 'M', 'M', 'Q', 'T' };
 } // namespace
 
 QTree::QTree(Memory &memory)
-    : depth_(), data_(), dataSize_()
+    : version_(), depth_(), data_(), dataSize_(), lines_(), values_()
 {
     auto &f(memory.stream);
 
-    checkHeader(f, MM_QTREE_MAGIC, 2, "mmapped qtree");
+    checkHeader(f, MM_QTREE_MAGIC, 0, "mmapped qtree");
+
+    // format version (legacy files have zero here), skip reserved byte
+    version_ = std::max(unsigned(bin::read<std::uint8_t>(f)), 1u);
+    f.seekg(1, std::ios_base::cur);
+
+    if (version_ > formatVersion) {
+        LOGTHROW(err2, std::runtime_error)
+            << "Unsupported mmapped qtree format version " << version_
+            << ".";
+    }
 
     // read tree depth (i.e. lod)
     depth_ = bin::read<std::uint8_t>(f);
     size_ = 1 << depth_;
 
-    // read data size
-    dataSize_ = bin::read<std::uint32_t>(f);
+    if (version_ == 1) {
+        // read data size
+        dataSize_ = bin::read<std::uint32_t>(f);
+
+        // align start of data block
+        std::size_t dataStart
+            (utility::align(f.tellg(), sizeof(std::uint32_t)));
 
-    // align start of data block
-    std::size_t dataStart(utility::align(f.tellg(), sizeof(std::uint32_t)));
+        // remember memory
+        data_ = memory.addr(dataStart);
+
+        // skip data
+        f.seekg(dataStart + dataSize_);
+        return;
+    }
 
-    // remember memory
+    // v2: data size and number of nodes
+    f.seekg(utility::align(f.tellg(), sizeof(std::uint32_t)));
+    dataSize_ = bin::read<std::uint32_t>(f);
+    const std::size_t nodeCount(bin::read<std::uint32_t>(f));
+
+    // data block starts at cache line boundary
+    std::size_t dataStart(utility::align(f.tellg(), lineBytes));
     data_ = memory.addr(dataStart);
 
+    const std::size_t lineCount((nodeCount + lineBits - 1) / lineBits);
+    lines_ = reinterpret_cast<const std::uint64_t*>(data_);
+    values_ = reinterpret_cast<const value_type*>
+        (data_ + lineCount * lineBytes);
+
     // skip data
     f.seekg(dataStart + dataSize_);
 }
@@ -83,7 +116,20 @@ inline TileFlag::value_type vts2mm(const vts::QTree::opt_value_type &in)
 
 } // namespace
 
-void QTree::write(std::ostream &f, const vts::QTree &tree)
+void QTree::write(std::ostream &f, const vts::QTree &tree
+                  , unsigned int version)
+{
+    switch (version) {
+    case 1: writeV1(f, tree); break;
+    case 2: writeV2(f, tree); break;
+    default:
+        LOGTHROW(err2, std::logic_error)
+            << "Unsupported mmapped qtree format version " << version
+            << ".";
+    }
+}
+
+void QTree::writeV1(std::ostream &f, const vts::QTree &tree)
 {
     bin::write(f, MM_QTREE_MAGIC); // 4 bytes
     bin::write(f, std::uint8_t(0)); // reserved
@@ -208,10 +254,130 @@ void QTree::write(std::ostream &f, const vts::QTree &tree)
     f.seekp(end);
 }
 
+void QTree::writeV2(std::ostream &f, const vts::QTree &tree)
+{
+    // unpack tree into plain nodes; children of a node are consecutive
+    struct Unpacked {
+        value_type value;
+        std::size_t children;
+    };
+
+    struct Converter {
+        typedef std::array<std::size_t, 4> IndexTable;
+
+        void root(vts::QTree::opt_value_type value) {
+            nodes.push_back({ vts2mm(value), 0 });
+            stack.push_back(0);
+        }
+
+        IndexTable children(const vts::QTree::opt_value_type &ul
+                            , const vts::QTree::opt_value_type &ur
+                            , const vts::QTree::opt_value_type &ll
+                            , const vts::QTree::opt_value_type &lr)
+        {
+            const auto first(nodes.size());
+            nodes[stack.back()].children = first;
+            nodes.push_back({ vts2mm(ul), 0 });
+            nodes.push_back({ vts2mm(ur), 0 });
+            nodes.push_back({ vts2mm(ll), 0 });
+            nodes.push_back({ vts2mm(lr), 0 });
+            return {{ first, first + 1, first + 2, first + 3 }};
+        }
+
+        void enter(const IndexTable &table, int index) {
+            stack.push_back(table[index]);
+        }
+
+        void leave(const IndexTable&, int) { stack.pop_back(); }
+
+        std::vector<Unpacked> nodes;
+        std::vector<std::size_t> stack;
+    };
+
+    Converter converter;
+    tree.convert(converter);
+    const auto &nodes(converter.nodes);
+
+    // level order: bit vector and leaf values
+    std::vector<bool> bits;
+    std::vector<value_type> values;
+    {
+        std::deque<std::size_t> queue{ 0 };
+        while (!queue.empty()) {
+            const auto &node(nodes[queue.front()]);
+            queue.pop_front();
+
+            if (TileFlag::leaf(node.value)) {
+                bits.push_back(false);
+                values.push_back(node.value);
+                continue;
+            }
+
+            bits.push_back(true);
+            for (std::size_t i(0); i < 4; ++i) {
+                queue.push_back(node.children + i);
+            }
+        }
+    }
+
+    const std::size_t lineCount((bits.size() + lineBits - 1) / lineBits);
+
+    bin::write(f, MM_QTREE_MAGIC); // 4 bytes
+    bin::write(f, std::uint8_t(2)); // format version
+    bin::write(f, std::uint8_t(0)); // reserved
+
+    // order (lod)
+    bin::write(f, std::uint8_t(tree.order()));
+
+    // data size and node count
+    f.seekp(utility::align(f.tellp(), sizeof(std::uint32_t)));
+    bin::write(f, std::uint32_t(lineCount * lineBytes + values.size()));
+    bin::write(f, std::uint32_t(bits.size()));
+
+    // cache line aligned bit vector lines
+    f.seekp(utility::align(f.tellp(), lineBytes));
+    std::uint64_t ones(0);
+    for (std::size_t l(0); l < lineCount; ++l) {
+        std::array<std::uint64_t, lineWords> line{{ ones }};
+        const auto start(l * lineBits);
+        const auto end(std::min(start + lineBits, bits.size()));
+        for (auto pos(start); pos < end; ++pos) {
+            if (!bits[pos]) { continue; }
+            const auto bit(pos - start);
+            line[1 + bit / 64] |= (std::uint64_t(1) << (bit % 64));
+            ++ones;
+        }
+        for (const auto word : line) { bin::write(f, word); }
+    }
+
+    // leaf values
+    for (const auto value : values) { bin::write(f, value); }
+}
+
+QTree::value_type QTree::getV2(unsigned int depth, unsigned int x
+                               , unsigned int y) const
+{
+    std::size_t pos(0);
+    for (unsigned int level(0); ; ++level) {
+        bool internal;
+        const auto r(rank(pos, internal));
+        if (!internal) { return values_[pos - r]; }
+
+        // internal node at requested depth
+        if (level == depth) { return TileFlag::any; }
+
+        // descend to child containing (x, y)
+        const auto shift(depth - level - 1);
+        pos = 1 + 4 * r + ((y >> shift) & 1) * 2 + ((x >> shift) & 1);
+    }
+}
+
 QTree::value_type QTree::get(unsigned int x, unsigned int y) const
 {
     if ((x >= size_) || (y >= size_)) { return TileFlag::none; }
 
+    if (version_ >= 2) { return getV2(depth_, x, y); }
+
     MemoryReader reader(data_);
 
     // load root value
@@ -238,6 +404,8 @@ QTree::value_type QTree::get(unsigned int depth, unsigned int x
 
     if ((x >= size) || (y >= size)) { return TileFlag::none; }
 
+    if (version_ >= 2) { return getV2(depth, x, y); }
+
     MemoryReader reader(data_);
 
     // load root value
@@ -28,6 +28,7 @@
 #define mapproxy_support_mmapped_qtree_hpp_included_
 
 #include <array>
+#include <cstdint>
 #include <iostream>
 #include <algorithm>
 
@@ -49,6 +50,22 @@
  *
  *  Non-leaf nodes are marked by invalid combination (mesh=false,
  *  watertight=true)
+ *
+ *  Two on-disk formats exist (format version is stored in the first reserved
+ *  header byte, legacy files have zero there):
+ *
+ *  v1: depth-first node values with variable-length tables of uint32 jumps
+ *      to internal children.
+ *
+ *  v2: level-order (LOUDS-like) bit vector, one bit (internal?) per node,
+ *      followed by values of all leaves in the same order. Children of
+ *      internal node at position p are stored at 1 + 4 * rank(p) where
+ *      rank(p) is number of internal nodes before p. The bit vector is stored
+ *      in 64-byte cache lines, each line starting with number of set bits in
+ *      all preceding lines followed by 448 payload bits, i.e. rank of any
+ *      position is computed from a single line. Leaf value of position p lives
+ *      at index p - rank(p). Trees are only descended, therefore no select
+ *      directory is needed.
  */
 namespace mmapped {
 
@@ -70,7 +87,16 @@ public:
      */
     value_type get(unsigned int depth, unsigned int x, unsigned int y) const;
 
-    static void write(std::ostream &out, const vts::QTree &tree);
+    enum : unsigned int {
+        /** Format version written by default.
+         */
+        formatVersion = 2
+    };
+
+    /** Writes tree in given format version (1 or 2).
+     */
+    static void write(std::ostream &out, const vts::QTree &tree
+                      , unsigned int version = formatVersion);
 
     enum class Filter {
         black, white, both
@@ -90,10 +116,17 @@ public:
     void forEachNode(unsigned int depth, unsigned int x, unsigned int y
                      , const Op &op, Filter filter = Filter::both) const;
 
+    /** On-disk format version of this tree.
+     */
+    unsigned int version() const { return version_; }
+
 private:
     struct Node;
     struct NodeValue;
 
+    static void writeV1(std::ostream &out, const vts::QTree &tree);
+    static void writeV2(std::ostream &out, const vts::QTree &tree);
+
     value_type get(MemoryReader &reader, const Node &node
                    , unsigned int x, unsigned int y) const;
 
@@ -103,11 +136,46 @@ private:
                  , const Op &op, Filter filter
                  , const int *clipSize) const;
 
+    /** v2: value of node at (x, y) in tree trimmed to given depth.
+     */
+    value_type getV2(unsigned int depth, unsigned int x, unsigned int y)
+        const;
+
+    /** v2: descends internal node at given bit vector position.
+     */
+    template <typename Op>
+    void descendV2(std::size_t pos, const Node &node
+                   , const Op &op, Filter filter
+                   , const int *clipSize) const;
+
+    /** v2: number of internal nodes before position pos; internal is set to
+     *  the node's own bit.
+     */
+    std::size_t rank(std::size_t pos, bool &internal) const;
+
+    /** v2: internal bit of node at given position.
+     */
+    bool internalAt(std::size_t pos) const;
+
+    /** v2: bit vector line layout.
+     */
+    enum : std::size_t {
+        lineWords = 8
+        , lineBits = (lineWords - 1) * 64
+        , lineBytes = lineWords * sizeof(std::uint64_t)
+    };
+
+    unsigned int version_;
     unsigned int depth_;
     unsigned int size_;
     const char *data_;
     std::size_t dataSize_;
 
+    /** v2: bit vector lines and leaf values
+     */
+    const std::uint64_t *lines_;
+    const value_type *values_;
+
     // -- silencing clang noises starts here --
     template<typename CharT, typename Traits>
     friend inline std::basic_ostream<CharT, Traits>&
@@ -326,6 +394,17 @@ inline bool QTree::Node::checkExtents(const int *clipSize) const
 template <typename Op>
 void QTree::forEachNode(const Op &op, Filter filter) const
 {
+    if (version_ >= 2) {
+        bool internal;
+        rank(0, internal);
+        if (!internal) {
+            Node(size_).call(op, filter, values_[0]);
+            return;
+        }
+        descendV2(0, Node(size_), op, filter, nullptr);
+        return;
+    }
+
     MemoryReader reader(data_);
 
     // load root value
@@ -381,6 +460,19 @@ void QTree::forEachNode(unsigned int depth, unsigned int x, unsigned int y
                << "); clipping limit: " << limit;
 #endif
 
+    if (version_ >= 2) {
+        bool internal;
+        rank(0, internal);
+        if (!internal) {
+            if (rootNode.checkExtents(&limit)) {
+                rootNode.call(op, filter, values_[0], &limit);
+            }
+            return;
+        }
+        descendV2(0, rootNode, op, filter, &limit);
+        return;
+    }
+
     MemoryReader reader(data_);
 
     // load root value
@@ -438,6 +530,69 @@ void QTree::descend(MemoryReader &reader, const Node &node
     processSubtree(3, node.child(ul.size, ul.size));
 }
 
+inline std::size_t QTree::rank(std::size_t pos, bool &internal) const
+{
+    const auto *line(lines_ + (pos / lineBits) * lineWords);
+    const auto bit(pos % lineBits);
+    const auto word(bit / 64);
+
+    // set bits in all preceding lines + full payload words before pos
+    std::size_t r(line[0]);
+    for (std::size_t i(1); i <= word; ++i) {
+        r += __builtin_popcountll(line[i]);
+    }
+
+    // and bits before pos in pos's word
+    const auto value(line[word + 1]);
+    const std::uint64_t mask(std::uint64_t(1) << (bit % 64));
+    internal = value & mask;
+    return r + __builtin_popcountll(value & (mask - 1));
+}
+
+inline bool QTree::internalAt(std::size_t pos) const
+{
+    const auto bit(pos % lineBits);
+    return (lines_[(pos / lineBits) * lineWords + 1 + bit / 64]
+            >> (bit % 64)) & 1;
+}
+
+template <typename Op>
+void QTree::descendV2(std::size_t pos, const Node &node
+                      , const Op &op, Filter filter
+                      , const int *clipSize) const
+{
+    bool internal;
+    const auto first(1 + 4 * rank(pos, internal));
+
+    // rank of first child, advanced by each internal child
+    auto r(rank(first, internal));
+
+    const auto ul(node.child());
+    const Node children[4] = {
+        ul, node.child(ul.size), node.child(0, ul.size)
+        , node.child(ul.size, ul.size)
+    };
+
+    for (int i(0); i < 4; ++i) {
+        const auto &child(children[i]);
+        const auto childPos(first + i);
+        if (i) { internal = internalAt(childPos); }
+
+        // terminate descent if out of extents
+        if (child.checkExtents(clipSize)) {
+            if (!internal) {
+                // leaf
+                child.call(op, filter, values_[childPos - r], clipSize);
+            } else if (child.size > 1) {
+                // internal node (broken tree if below pixel level)
+                descendV2(childPos, child, op, filter, clipSize);
+            }
+        }
+
+        r += internal;
+    }
+}
+
 } // namespace mmapped
 
 #endif // mapproxy_support_mmapped_qtree_hpp_included_
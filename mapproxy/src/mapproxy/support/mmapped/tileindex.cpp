@@ -24,6 +24,9 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <algorithm>
+#include <functional>
+
 #include <boost/filesystem.hpp>
 #include <boost/iostreams/stream_buffer.hpp>
 #include <boost/iostreams/device/array.hpp>
@@ -35,9 +38,12 @@
 
 #include "utility/filesystem.hpp"
 #include "utility/streams.hpp"
+#include "utility/path.hpp"
 #include "utility/binaryio.hpp"
 #include "utility/align.hpp"
 
+#include "vts-libs/vts/tileop.hpp"
+
 #include "tileindex.hpp"
 #include "memory-impl.hpp"
 
@@ -50,10 +56,57 @@ namespace {
 
 const char MM_TILEINDEX_MAGIC[4] = { 'M', 'M', 'T', 'I' };
 
+/** Runs op(i0, j0, i1, j1, value) for every node of tree at treeLod
+ *  intersecting tile range at lod (<= treeLod). Node is given by inclusive
+ *  tile bounds relative to range origin, clipped to range.
+ *
+ *  Descends only the smallest aligned subtree covering the range.
+ */
+template <typename Op>
+void forEachInRange(const QTree &tree, vts::Lod treeLod, vts::Lod lod
+                    , const vts::TileRange &range, const Op &op
+                    , QTree::Filter filter)
+{
+    // smallest aligned window (tile at lod - shift) covering the range
+    unsigned int shift(0);
+    unsigned int wx(range.ll(0)), wy(range.ll(1));
+    {
+        unsigned int ex(range.ur(0)), ey(range.ur(1));
+        while ((wx != ex) || (wy != ey)) {
+            wx >>= 1; wy >>= 1; ex >>= 1; ey >>= 1;
+            ++shift;
+        }
+    }
+    if (shift > lod) { return; }
+
+    const int width(range.ur(0) - range.ll(0) + 1);
+    const int height(range.ur(1) - range.ll(1) + 1);
+
+    // window origin relative to range origin
+    const int ox((wx << shift) - range.ll(0));
+    const int oy((wy << shift) - range.ll(1));
+    const int d(treeLod - lod);
+
+    tree.forEachNode(lod - shift, wx, wy
+                     , [&](unsigned int x, unsigned int y
+                           , unsigned int xsize, unsigned int ysize
+                           , QTree::value_type value)
+    {
+        const int i0(std::max(int(x >> d) + ox, 0));
+        const int j0(std::max(int(y >> d) + oy, 0));
+        const int i1(std::min(int((x + xsize - 1) >> d) + ox, width - 1));
+        const int j1(std::min(int((y + ysize - 1) >> d) + oy, height - 1));
+        if ((i0 > i1) || (j0 > j1)) { return; }
+        op(i0, j0, i1, j1, value);
+    }, filter);
+}
+
 } // namespace
 
-TileIndex::TileIndex(const fs::path &path)
-    : memory_(std::make_shared<Memory>(path))
+TileIndex::TileIndex(const fs::path &path, vts::Lod denseLods
+                     , const MapPolicy &policy)
+    : memory_(std::make_shared<Memory>(path, policy))
+    , denseLods_()
 {
     checkHeader(memory_->stream, MM_TILEINDEX_MAGIC, 2, "mmapped tile index");
 
@@ -64,9 +117,114 @@ TileIndex::TileIndex(const fs::path &path)
     for (int lod(0); lod < lods; ++lod) {
         trees_.emplace_back(*memory_);
     }
+
+    if (denseLods) {
+        buildDense(denseLods);
+        LOG(info2) << "Tile index " << path << ": lods [0, " << denseLods_
+                   << ") materialized in " << denseMemory()
+                   << " bytes of dense arrays.";
+    }
+
+    LOG(info2) << "Tile index " << path << ": " << residentMemory()
+               << " of " << fileSize() << " bytes resident.";
 }
 
-void TileIndex::write(std::ostream &f, const vts::TileIndex &ti)
+void TileIndex::buildDense(vts::Lod denseLods)
+{
+    denseLods_ = std::min(denseLods, lodCount());
+    if (!denseLods_) { return; }
+
+    const auto lodStart([](vts::Lod lod) -> std::size_t
+    {
+        return ((std::size_t(1) << (2 * lod)) - 1) / 3;
+    });
+
+    dense_.assign(lodStart(denseLods_), TileFlag::none);
+
+    // subtree validity, one more lod for the bottom-up pass
+    std::vector<bool> subtree(lodStart(denseLods_ + 1), false);
+
+    const auto fill([&](vts::Lod lod, int x, int y, int w, int h
+                        , const std::function<void(std::size_t)> &op)
+    {
+        const int size(1 << lod);
+        const auto start(lodStart(lod));
+        for (int j(std::max(y, 0)), je(std::min(y + h, size)); j < je; ++j) {
+            for (int i(std::max(x, 0)), ie(std::min(x + w, size)); i < ie;
+                 ++i)
+            {
+                op(start + (std::size_t(j) << lod) + i);
+            }
+        }
+    });
+
+    for (vts::Lod lod(0); lod < lodCount(); ++lod) {
+        const auto &tree(trees_[lod]);
+        if (lod < denseLods_) {
+            // flags of all tiles and subtree validity of non-empty ones
+            tree.forEachNode([&](int x, int y, int w, int h, value_type value)
+            {
+                fill(lod, x, y, w, h, [&](std::size_t index)
+                {
+                    dense_[index] = value;
+                    subtree[index] = true;
+                });
+            }, QTree::Filter::white);
+            continue;
+        }
+
+        // deeper tree: mark its non-empty nodes at the first non-dense lod
+        const int shift(lod - denseLods_);
+        tree.forEachNode([&](int x, int y, int w, int h, value_type)
+        {
+            const int x0(x >> shift), y0(y >> shift);
+            const int x1((x + w - 1) >> shift), y1((y + h - 1) >> shift);
+            fill(denseLods_, x0, y0, x1 - x0 + 1, y1 - y0 + 1
+                 , [&](std::size_t index) { subtree[index] = true; });
+        }, QTree::Filter::white);
+    }
+
+    // propagate subtree validity bottom-up
+    for (vts::Lod lod(denseLods_); lod > 0; --lod) {
+        const int size(1 << lod);
+        const auto start(lodStart(lod)), parentStart(lodStart(lod - 1));
+        for (int j(0); j < size; ++j) {
+            for (int i(0); i < size; ++i) {
+                if (subtree[start + (std::size_t(j) << lod) + i]) {
+                    subtree[parentStart + (std::size_t(j >> 1) << (lod - 1))
+                            + (i >> 1)] = true;
+                }
+            }
+        }
+    }
+
+    subtree.resize(dense_.size());
+    denseSubtree_ = std::move(subtree);
+}
+
+std::size_t TileIndex::fileSize() const
+{
+    return memory_->size;
+}
+
+std::size_t TileIndex::residentMemory() const
+{
+    return memory_->resident();
+}
+
+std::size_t TileIndex::prefault() const
+{
+    memory_->prefault();
+    return memory_->size;
+}
+
+std::size_t TileIndex::denseMemory() const
+{
+    return dense_.size() * sizeof(value_type) + (denseSubtree_.size() + 7) / 8;
+}
+
+void TileIndex::write(std::ostream &f, const vts::TileIndex &ti
+                      , unsigned int version)
 {
     bin::write(f, MM_TILEINDEX_MAGIC); // 4 bytes
     bin::write(f, std::uint8_t(0)); // reserved
@@ -82,26 +240,92 @@ void TileIndex::write(std::ostream &f, const vts::TileIndex &ti)
     for (vts::Lod lod(0); lod < lodCount; ++lod) {
         if (const auto *tree = ti.tree(lod)) {
             // tree exists, write
-            QTree::write(f, *tree);
+            QTree::write(f, *tree, version);
         } else {
             // tree doesn't exist, write empty
-            QTree::write(f, vts::QTree(lod));
+            QTree::write(f, vts::QTree(lod), version);
         }
     }
 }
 
 void TileIndex::write(const boost::filesystem::path &path
-                      , const vts::TileIndex &ti)
+                      , const vts::TileIndex &ti
+                      , unsigned int version)
 {
     utility::ofstreambuf f;
     f.exceptions(std::ifstream::failbit | std::ifstream::badbit);
     f.open(path.string(), std::ifstream::out | std::ifstream::trunc);
 
-    write(f, ti);
+    write(f, ti, version);
 
     f.close();
 }
 
+TileIndex::Writer::Writer(const boost::filesystem::path &path
+                          , vts::Lod lodCount, unsigned int version)
+    : path_(path), tmpPath_(utility::addExtension(path, ".tmp"))
+    , lodCount_(lodCount), version_(version), lod_(), committed_(false)
+{
+    f_.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+    f_.open(tmpPath_.string(), std::ifstream::out | std::ifstream::trunc);
+
+    bin::write(f_, MM_TILEINDEX_MAGIC); // 4 bytes
+    bin::write(f_, std::uint8_t(0)); // reserved
+    bin::write(f_, std::uint8_t(0)); // reserved
+
+    // lod count (max lod + 1), nothing for empty index
+    if (lodCount_) { bin::write(f_, std::uint8_t(lodCount_)); }
+}
+
+TileIndex::Writer::~Writer()
+{
+    if (committed_) { return; }
+
+    try {
+        f_.close();
+    } catch (...) {}
+
+    boost::system::error_code ec;
+    fs::remove(tmpPath_, ec);
+}
+
+void TileIndex::Writer::write(const vts::QTree &tree)
+{
+    if (lod_ >= lodCount_) {
+        LOGTHROW(err2, std::logic_error)
+            << "Too many trees written to tile index " << path_ << ".";
+    }
+
+    QTree::write(f_, tree, version_);
+    ++lod_;
+}
+
+void TileIndex::Writer::append(std::istream &section)
+{
+    if (lod_ >= lodCount_) {
+        LOGTHROW(err2, std::logic_error)
+            << "Too many trees written to tile index " << path_ << ".";
+    }
+
+    // empty section would leave failbit set on the output stream
+    if (section.peek() != std::istream::traits_type::eof()) {
+        f_ << section.rdbuf();
+    }
+    ++lod_;
+}
+
+void TileIndex::Writer::commit()
+{
+    // pad with empty trees
+    for (; lod_ < lodCount_; ++lod_) {
+        QTree::write(f_, vts::QTree(lod_), version_);
+    }
+
+    f_.close();
+    fs::rename(tmpPath_, path_);
+    committed_ = true;
+}
+
 const QTree* TileIndex::tree(vts::Lod lod) const
 {
     if (lod >= trees_.size()) { return nullptr; }
@@ -110,6 +334,14 @@ const QTree* TileIndex::tree(vts::Lod lod) const
 
 TileIndex::value_type TileIndex::get(const vts::TileId &tileId) const
 {
+    if (tileId.lod < denseLods_) {
+        const auto size(1u << tileId.lod);
+        if ((tileId.x >= size) || (tileId.y >= size)) {
+            return TileFlag::none;
+        }
+        return dense_[denseIndex(tileId)];
+    }
+
     if (const auto *t = tree(tileId.lod)) {
         return t->get(tileId.x, tileId.y);
     }
@@ -121,6 +353,17 @@ bool TileIndex::validSubtree(vts::Lod lod, const vts::TileId &tileId) const
 {
     if (lod >= trees_.size()) { return false; }
 
+    if (tileId.lod < denseLods_) {
+        const auto size(1u << tileId.lod);
+        if ((tileId.x >= size) || (tileId.y >= size)) { return false; }
+
+        // nothing below the tile at all
+        if (!denseSubtree_[denseIndex(tileId)]) { return false; }
+
+        // exact answer for the tile's own subtree
+        if (lod == tileId.lod) { return true; }
+    }
+
     // check all tileindex layers from tileId's lod to the bottom
     for (auto itrees(trees_.begin() + lod), etrees(trees_.end());
          itrees != etrees; ++itrees)
@@ -135,4 +378,70 @@ bool TileIndex::validSubtree(const vts::TileId &tileId) const
     return validSubtree(tileId.lod, tileId);
 }
 
+std::vector<TileIndex::value_type>
+TileIndex::rangeFlags(vts::Lod lod, const vts::TileRange &range) const
+{
+    const auto size(vts::tileRangesSize(range));
+    std::vector<value_type> flags(math::area(size), TileFlag::none);
+
+    if (lod < denseLods_) {
+        for (int j(0); j < size.height; ++j) {
+            for (int i(0); i < size.width; ++i) {
+                flags[j * size.width + i]
+                    = get(vts::TileId(lod, range.ll(0) + i
+                                      , range.ll(1) + j));
+            }
+        }
+        return flags;
+    }
+
+    if (const auto *t = tree(lod)) {
+        forEachInRange(*t, lod, lod, range
+                       , [&](int i0, int j0, int i1, int j1
+                             , value_type value)
+        {
+            for (int j(j0); j <= j1; ++j) {
+                std::fill(flags.begin() + (j * size.width + i0)
+                          , flags.begin() + (j * size.width + i1 + 1)
+                          , value);
+            }
+        }, QTree::Filter::white);
+    }
+
+    return flags;
+}
+
+std::vector<char>
+TileIndex::rangeValidSubtree(vts::Lod lod, const vts::TileRange &range)
+    const
+{
+    const auto size(vts::tileRangesSize(range));
+    std::vector<char> valid(math::area(size), false);
+
+    if (lod < denseLods_) {
+        for (int j(0); j < size.height; ++j) {
+            for (int i(0); i < size.width; ++i) {
+                valid[j * size.width + i]
+                    = validSubtree(vts::TileId(lod, range.ll(0) + i
+                                               , range.ll(1) + j));
+            }
+        }
+        return valid;
+    }
+
+    for (vts::Lod l(lod), le(lodCount()); l < le; ++l) {
+        forEachInRange(trees_[l], l, lod, range
+                       , [&](int i0, int j0, int i1, int j1, value_type)
+        {
+            for (int j(j0); j <= j1; ++j) {
+                std::fill(valid.begin() + (j * size.width + i0)
+                          , valid.begin() + (j * size.width + i1 + 1)
+                          , true);
+            }
+        }, QTree::Filter::white);
+    }
+
+    return valid;
+}
+
 } // namespace mmapped
@@ -28,8 +28,12 @@
 #define mapproxy_support_mmapped_tileindex_hpp_included_
 
 #include <array>
+#include <vector>
+#include <cstdint>
 #include <iostream>
 
+#include "utility/streams.hpp"
+
 #include "vts-libs/vts/tileindex.hpp"
 #include "vts-libs/vts/tileset/tilesetindex.hpp"
 
@@ -55,7 +59,13 @@ class TileIndex {
 public:
     typedef TileFlag::value_type value_type;
 
-    TileIndex(const boost::filesystem::path &path);
+    /** Opens tile index. Flags of lods below denseLods are materialized in
+     *  dense per-tile arrays (one byte of flags and one bit of subtree
+     *  validity per tile) answering queries without tree walk. File is
+     *  brought into memory according to given policy.
+     */
+    TileIndex(const boost::filesystem::path &path, vts::Lod denseLods = 0
+              , const MapPolicy &policy = MapPolicy());
 
     /** Find tile value.
      */
@@ -65,25 +75,108 @@ public:
 
     bool validSubtree(const vts::TileId &tileId) const;
 
+    /** Flags of all tiles of given tile range (inclusive) at given lod,
+     *  row-major. Single tree descent instead of get() for each tile.
+     */
+    std::vector<value_type> rangeFlags(vts::Lod lod
+                                       , const vts::TileRange &range) const;
+
+    /** Subtree validity (see validSubtree) of all tiles of given tile range
+     *  (inclusive) at given lod, row-major. Single descent of each tree at
+     *  and below lod.
+     */
+    std::vector<char> rangeValidSubtree(vts::Lod lod
+                                        , const vts::TileRange &range) const;
+
     /** Get quad tree for given lod.
      */
     const QTree* tree(vts::Lod lod) const;
 
+    /** Number of lods (i.e. max lod + 1).
+     */
+    vts::Lod lodCount() const { return trees_.size(); }
+
     value_type checkMask(const vts::TileId &tileId, QTree::value_type mask)
         const;
 
-    /** Save vts TileIndex into this mmapped tile index.
+    /** Save vts TileIndex into this mmapped tile index. Trees are written in
+     *  given format version (see QTree).
      */
-    static void write(std::ostream &out, const vts::TileIndex &ti);
+    static void write(std::ostream &out, const vts::TileIndex &ti
+                      , unsigned int version = QTree::formatVersion);
 
-    /** Save vts TileIndex into this mmapped tile index.
+    /** Save vts TileIndex into this mmapped tile index. Trees are written in
+     *  given format version (see QTree).
      */
     static void write(const boost::filesystem::path &path
-                      , const vts::TileIndex &ti);
+                      , const vts::TileIndex &ti
+                      , unsigned int version = QTree::formatVersion);
+
+    /** Incremental writer: trees are written one lod at a time (in lod
+     *  order) into a temporary file that replaces the destination on
+     *  commit(). Nothing is left behind if not committed.
+     */
+    class Writer {
+    public:
+        Writer(const boost::filesystem::path &path, vts::Lod lodCount
+               , unsigned int version = QTree::formatVersion);
+        ~Writer();
+
+        /** Writes tree of next lod.
+         */
+        void write(const vts::QTree &tree);
+
+        /** Appends already serialized tree of next lod (i.e. output of
+         *  QTree::write in the same format version).
+         */
+        void append(std::istream &section);
+
+        /** Writes empty trees for remaining lods, closes temporary file and
+         *  moves it into place.
+         */
+        void commit();
+
+    private:
+        const boost::filesystem::path path_;
+        const boost::filesystem::path tmpPath_;
+        utility::ofstreambuf f_;
+        const vts::Lod lodCount_;
+        const unsigned int version_;
+        vts::Lod lod_;
+        bool committed_;
+    };
+
+    /** Memory held by dense arrays (bytes).
+     */
+    std::size_t denseMemory() const;
+
+    /** Size of the index file and how much of it is resident in RAM (bytes).
+     */
+    std::size_t fileSize() const;
+    std::size_t residentMemory() const;
+
+    /** Faults in the whole index file. Returns its size.
+     */
+    std::size_t prefault() const;
 
 private:
+    void buildDense(vts::Lod denseLods);
+
+    /** Index of tile in dense arrays: lod l starts at (4^l - 1) / 3.
+     */
+    static std::size_t denseIndex(const vts::TileId &tileId) {
+        return ((std::size_t(1) << (2 * tileId.lod)) - 1) / 3
+            + (std::size_t(tileId.y) << tileId.lod) + tileId.x;
+    }
+
     std::shared_ptr<Memory> memory_;
     QTree::list trees_;
+
+    /** Dense flags and subtree validity of lods [0, denseLods_).
+     */
+    vts::Lod denseLods_;
+    std::vector<value_type> dense_;
+    std::vector<bool> denseSubtree_;
 };
 
 // inlines
@@ -24,6 +24,14 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <atomic>
+#include <algorithm>
+#include <thread>
+
+#include "dbglog/dbglog.hpp"
+
+#include "utility/time.hpp"
+
 #include "tilesetindex.hpp"
 
 namespace mmapped {
@@ -67,4 +75,72 @@ Index::checkAndGetFlags(const vts::TileId &tileId, vts::TileFile type) const
     }
 }
 
+void convertDeliveryIndex(unsigned int metaBinaryOrder
+                          , const boost::filesystem::path &tilesetIndexPath
+                          , const boost::filesystem::path &deliveryIndexPath)
+{
+    // NB: vts-libs loads tileset index as a whole, output is streamed
+    vts::tileset::Index index(metaBinaryOrder);
+    vts::tileset::loadTileSetIndex(index, tilesetIndexPath);
+
+    const auto &ti(index.tileIndex);
+    TileIndex::Writer writer(deliveryIndexPath
+                             , ti.empty() ? 0 : ti.maxLod() + 1);
+    if (!ti.empty()) {
+        for (vts::Lod lod(0), e(ti.maxLod() + 1); lod < e; ++lod) {
+            if (const auto *tree = ti.tree(lod)) {
+                writer.write(*tree);
+            } else {
+                writer.write(vts::QTree(lod));
+            }
+        }
+    }
+    writer.commit();
+}
+
+std::size_t convertDeliveryIndices(const std::vector<DeliveryIndexJob> &jobs
+                                   , unsigned int threads)
+{
+    if (jobs.empty()) { return 0; }
+
+    LOG(info3) << "Converting " << jobs.size() << " delivery indices in "
+               << threads << " thread(s).";
+    const auto start(utility::usecFromEpoch());
+
+    std::atomic<std::size_t> next(0);
+    std::atomic<std::size_t> converted(0);
+
+    const auto worker([&]()
+    {
+        for (;;) {
+            const auto i(next++);
+            if (i >= jobs.size()) { return; }
+            const auto &job(jobs[i]);
+
+            try {
+                convertDeliveryIndex(job.metaBinaryOrder
+                                     , job.tilesetIndexPath
+                                     , job.deliveryIndexPath);
+                ++converted;
+            } catch (const std::exception &e) {
+                LOG(err2) << "Failed to convert " << job.tilesetIndexPath
+                          << " to delivery index: <" << e.what() << ">.";
+            }
+        }
+    });
+
+    std::vector<std::thread> pool;
+    for (unsigned int i(1); i < std::max(threads, 1u); ++i) {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (auto &thread : pool) { thread.join(); }
+
+    LOG(info3) << "Converted " << converted << " of " << jobs.size()
+               << " delivery indices in "
+               << (utility::usecFromEpoch() - start) / 1000 << " ms.";
+
+    return converted;
+}
+
 } // namespace mmapped
@@ -35,8 +35,9 @@ class Index {
 public:
     typedef std::shared_ptr<Index> pointer;
 
-    Index(unsigned int metaBinaryOrder, const boost::filesystem::path &path)
-        : tileIndex(path)
+    Index(unsigned int metaBinaryOrder, const boost::filesystem::path &path
+          , vts::Lod denseLods = 0, const MapPolicy &policy = MapPolicy())
+        : tileIndex(path, denseLods, policy)
         , metaBinaryOrder_(metaBinaryOrder)
     {}
 
@@ -63,6 +64,27 @@ private:
     unsigned int metaBinaryOrder_;
 };
 
+/** Converts vts tileset index to delivery index, lod by lod. Destination is
+ *  replaced atomically.
+ */
+void convertDeliveryIndex(unsigned int metaBinaryOrder
+                          , const boost::filesystem::path &tilesetIndexPath
+                          , const boost::filesystem::path &deliveryIndexPath);
+
+/** Delivery index conversion job.
+ */
+struct DeliveryIndexJob {
+    unsigned int metaBinaryOrder;
+    boost::filesystem::path tilesetIndexPath;
+    boost::filesystem::path deliveryIndexPath;
+};
+
+/** Runs given conversions in given number of threads. Failures are logged.
+ *  Returns number of converted indices.
+ */
+std::size_t convertDeliveryIndices(const std::vector<DeliveryIndexJob> &jobs
+                                   , unsigned int threads);
+
 // inlines
 
 inline bool Index::real(const vts::TileId &tileId) const
@@ -0,0 +1,461 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <array>
+#include <cmath>
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <functional>
+
+#include "dbglog/dbglog.hpp"
+
+#include "utility/raise.hpp"
+
+#include "../error.hpp"
+
+#include "normalmap.hpp"
+
+namespace ublas = boost::numeric::ublas;
+
+namespace {
+
+/** Row-major 3x3 rotation in single precision.
+ */
+typedef std::array<float, 9> Rotation;
+
+/** Rotation of normals at given SDS point: normals transform by the inverse
+ *  transpose of the SDS -> physical jacobian (scale is dropped, normals are
+ *  normalized by the octahedron projection anyway), followed by the tangent
+ *  plane rotation at the physical point.
+ */
+Rotation rotation(const vts::CsConvertor &conv
+                  , const TangentialPlaneConvertor &tangent
+                  , double x, double y, double h)
+{
+    const auto p0(conv(math::Point3(x, y, 0.0)));
+    const math::Point3 a(conv(math::Point3(x + h, y, 0.0)) - p0);
+    const math::Point3 b(conv(math::Point3(x, y + h, 0.0)) - p0);
+    const math::Point3 c(conv(math::Point3(x, y, h)) - p0);
+
+    // cofactor matrix, keep orientation
+    const double sign((ublas::inner_prod(a, math::crossProduct(b, c)) < 0.0)
+                      ? -1.0 : 1.0);
+    math::Matrix3 cof(ublas::zero_matrix<double>(3, 3));
+    ublas::column(cof, 0) = sign * math::crossProduct(b, c);
+    ublas::column(cof, 1) = sign * math::crossProduct(c, a);
+    ublas::column(cof, 2) = sign * math::crossProduct(a, b);
+
+    const math::Matrix3 m(ublas::prod(tangent(p0), cof));
+
+    Rotation r;
+    for (int i(0); i < 3; ++i) {
+        for (int j(0); j < 3; ++j) { r[3 * i + j] = m(i, j); }
+    }
+    return r;
+}
+
+inline unsigned char quantize(float value)
+{
+    return static_cast<unsigned char>
+        (std::min(std::max((value * 0.5f + 0.5f) * 255.f + 0.5f, 0.f)
+                  , 255.f));
+}
+
+/** Rotate, octahedron-encode and quantize single normal.
+ */
+template <typename T>
+inline void encode(const T *n, const float *r, unsigned char *out)
+{
+    const float nx(n[0]), ny(n[1]), nz(n[2]);
+    const float x(r[0] * nx + r[1] * ny + r[2] * nz);
+    const float y(r[3] * nx + r[4] * ny + r[5] * nz);
+    const float z(r[6] * nx + r[7] * ny + r[8] * nz);
+
+    // project to octahedron
+    const float l1(std::abs(x) + std::abs(y) + std::abs(z));
+    const float s((l1 > 0.f) ? (1.f / l1) : 0.f);
+    const float px(x * s), py(y * s);
+
+    // fold lower hemisphere
+    const float fx((1.f - std::abs(py)) * std::copysign(1.f, px));
+    const float fy((1.f - std::abs(px)) * std::copysign(1.f, py));
+    const bool lower(z < 0.f);
+
+    out[0] = 0;
+    out[1] = quantize(lower ? fy : py);
+    out[2] = quantize(lower ? fx : px);
+}
+
+inline void lerp(const Rotation &a, const Rotation &b, float t, Rotation &out)
+{
+    for (int k(0); k < 9; ++k) { out[k] = a[k] + t * (b[k] - a[k]); }
+}
+
+/** Maximum angle between images of basis vectors under given rotations.
+ */
+double angularError(const Rotation &a, const Rotation &b)
+{
+    double error(0.0);
+    for (int k(0); k < 3; ++k) {
+        const double ax(a[k]), ay(a[3 + k]), az(a[6 + k]);
+        const double bx(b[k]), by(b[3 + k]), bz(b[6 + k]);
+        const double na(std::sqrt(ax * ax + ay * ay + az * az));
+        const double nb(std::sqrt(bx * bx + by * by + bz * bz));
+        if ((na <= 0.0) || (nb <= 0.0)) { continue; }
+        const double cos((ax * bx + ay * by + az * bz) / (na * nb));
+        error = std::max(error, std::acos(std::min(std::max(cos, -1.0), 1.0)));
+    }
+    return error;
+}
+
+/** Exact rotations sampled on a size x size grid spanning pixel centers,
+ *  bilinearly interpolated in between.
+ */
+class RotationGrid {
+public:
+    /** Sampler returns exact rotation at (fractional) pixel coordinates.
+     */
+    typedef std::function<Rotation(double i, double j)> Sampler;
+
+    RotationGrid(int size, const cv::Size &pixels, const Sampler &sampler)
+        : size_(size)
+        , sx_(pixels.width > 1 ? (pixels.width - 1.0) / (size - 1) : 0.0)
+        , sy_(pixels.height > 1 ? (pixels.height - 1.0) / (size - 1) : 0.0)
+        , grid_(size * size)
+    {
+        for (int gj(0); gj < size_; ++gj) {
+            for (int gi(0); gi < size_; ++gi) {
+                grid_[gj * size_ + gi] = sampler(gi * sx_, gj * sy_);
+            }
+        }
+    }
+
+    /** Checks interpolation against exact rotation in the middle of each
+     *  grid cell.
+     */
+    bool check(const Sampler &sampler, double maxError) const {
+        std::vector<Rotation> r;
+        Rotation c;
+        for (int gj(0); gj < size_ - 1; ++gj) {
+            const double j((gj + 0.5) * sy_);
+            row(j, r);
+            for (int gi(0); gi < size_ - 1; ++gi) {
+                const double i((gi + 0.5) * sx_);
+                column(r, i, c);
+                if (angularError(c, sampler(i, j)) > maxError) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    /** Interpolates grid row at pixel row j.
+     */
+    void row(double j, std::vector<Rotation> &out) const {
+        out.resize(size_);
+        const auto g(split(j, sy_));
+        for (int gi(0); gi < size_; ++gi) {
+            lerp(node(gi, g.first), node(gi, next(g.first)), g.second
+                 , out[gi]);
+        }
+    }
+
+    /** Interpolates rotation at pixel column i of row interpolated by row().
+     */
+    void column(const std::vector<Rotation> &row, double i, Rotation &out)
+        const
+    {
+        const auto g(split(i, sx_));
+        lerp(row[g.first], row[next(g.first)], g.second, out);
+    }
+
+private:
+    /** Pixel coordinate -> grid cell and position inside the cell.
+     */
+    std::pair<int, float> split(double p, double scale) const {
+        if (!scale) { return { 0, 0.f }; }
+        const double g(p / scale);
+        const int g0(std::min(std::max(int(std::floor(g)), 0), size_ - 1));
+        return { g0, float(g - g0) };
+    }
+
+    int next(int g) const { return std::min(g + 1, size_ - 1); }
+
+    const Rotation& node(int gi, int gj) const {
+        return grid_[gj * size_ + gi];
+    }
+
+    int size_;
+    double sx_;
+    double sy_;
+    std::vector<Rotation> grid_;
+};
+
+template <typename T>
+void exportNormals(const cv::Mat &normals, cv::Mat &out
+                   , const math::Extents2 &extents
+                   , const vts::CsConvertor &conv
+                   , const TangentialPlaneConvertor &tangent
+                   , NormalRotation mode, double maxAngularError)
+{
+    const auto es(math::size(extents));
+    const double pw(es.width / normals.cols);
+    const double ph(es.height / normals.rows);
+    const double h(std::min(pw, ph));
+
+    if (mode == NormalRotation::grid) {
+        const RotationGrid::Sampler sampler([&](double i, double j)
+        {
+            return rotation(conv, tangent, extents.ll(0) + (i + 0.5) * pw
+                            , extents.ur(1) - (j + 0.5) * ph, h);
+        });
+
+        // refine grid until interpolation is within tolerance
+        for (int size(17); size <= 65; size = 2 * size - 1) {
+            const RotationGrid grid(size, normals.size(), sampler);
+            if (!grid.check(sampler, maxAngularError)) { continue; }
+
+            std::vector<Rotation> row;
+            Rotation r;
+            for (int j(0); j < normals.rows; ++j) {
+                grid.row(j, row);
+                const auto *src(normals.ptr<T>(j));
+                auto *dst(out.ptr<unsigned char>(j));
+                for (int i(0); i < normals.cols; ++i) {
+                    grid.column(row, i, r);
+                    encode(src + 3 * i, r.data(), dst + 3 * i);
+                }
+            }
+            return;
+        }
+
+        // too curved even for the finest grid
+        mode = NormalRotation::exact;
+    }
+
+    if (mode == NormalRotation::perTile) {
+        const auto c(math::center(extents));
+        const auto r(rotation(conv, tangent, c(0), c(1), h));
+
+        for (int j(0); j < normals.rows; ++j) {
+            const auto *src(normals.ptr<T>(j));
+            auto *dst(out.ptr<unsigned char>(j));
+            for (int i(0); i < normals.cols; ++i) {
+                encode(src + 3 * i, r.data(), dst + 3 * i);
+            }
+        }
+        return;
+    }
+
+    // exact: rotation per pixel, evaluated row by row
+    std::vector<Rotation> rotations(normals.cols);
+    for (int j(0); j < normals.rows; ++j) {
+        const double y(extents.ur(1) - (j + 0.5) * ph);
+        for (int i(0); i < normals.cols; ++i) {
+            rotations[i] = rotation
+                (conv, tangent, extents.ll(0) + (i + 0.5) * pw, y, h);
+        }
+
+        const auto *src(normals.ptr<T>(j));
+        auto *dst(out.ptr<unsigned char>(j));
+        for (int i(0); i < normals.cols; ++i) {
+            encode(src + 3 * i, rotations[i].data(), dst + 3 * i);
+        }
+    }
+}
+
+} // namespace
+
+cv::Mat exportNormals(const cv::Mat &normals, const math::Extents2 &extents
+                      , const vts::CsConvertor &conv
+                      , const TangentialPlaneConvertor &tangent
+                      , NormalRotation rotation, double maxAngularError)
+{
+    cv::Mat out;
+    exportNormals(normals, out, extents, conv, tangent, rotation
+                  , maxAngularError);
+    return out;
+}
+
+void exportNormals(const cv::Mat &normals, cv::Mat &out
+                   , const math::Extents2 &extents
+                   , const vts::CsConvertor &conv
+                   , const TangentialPlaneConvertor &tangent
+                   , NormalRotation rotation, double maxAngularError)
+{
+    out.create(normals.rows, normals.cols, CV_8UC3);
+
+    switch (normals.type()) {
+    case CV_32FC3:
+        exportNormals<float>(normals, out, extents, conv, tangent, rotation
+                             , maxAngularError);
+        break;
+
+    case CV_64FC3:
+        exportNormals<double>(normals, out, extents, conv, tangent, rotation
+                              , maxAngularError);
+        break;
+
+    default:
+        utility::raise<InternalError>("Unsupported normal map type.");
+    }
+}
+
+namespace {
+
+template <typename T>
+void ztNormals(const cv::Mat &dem, cv::Mat &out, float kx, float ky)
+{
+    const int rows(dem.rows - 2), cols(dem.cols - 2);
+    for (int j(0); j < rows; ++j) {
+        const auto *up(dem.ptr<T>(j));
+        const auto *mid(dem.ptr<T>(j + 1));
+        const auto *down(dem.ptr<T>(j + 2));
+        auto *dst(out.ptr<float>(j));
+
+        for (int i(0); i < cols; ++i) {
+            const float dx((float(mid[i + 2]) - float(mid[i])) * kx);
+            const float dy((float(down[i + 1]) - float(up[i + 1])) * ky);
+            const float n(1.f / std::sqrt(dx * dx + dy * dy + 1.f));
+            dst[3 * i] = -dx * n;
+            dst[3 * i + 1] = -dy * n;
+            dst[3 * i + 2] = n;
+        }
+    }
+}
+
+void ztNormals(const cv::Mat &dem, cv::Mat &out
+               , const math::Size2f &pixelSize
+               , const geo::normalmap::Parameters &params)
+{
+    // central differences; image rows go down while viewspace y goes up;
+    // inverted relief flips the slope
+    const float sign(params.invertRelief ? -1.f : 1.f);
+    const float kx(sign * params.zFactor / (2.f * pixelSize.width));
+    const float ky(sign * params.zFactor / (2.f * pixelSize.height)
+                   * (params.viewspaceRf ? -1.f : 1.f));
+
+    out.create(dem.rows - 2, dem.cols - 2, CV_32FC3);
+
+    switch (dem.depth()) {
+    case CV_8U: ztNormals<unsigned char>(dem, out, kx, ky); break;
+    case CV_32F: ztNormals<float>(dem, out, kx, ky); break;
+    case CV_64F: ztNormals<double>(dem, out, kx, ky); break;
+    default:
+        utility::raise<InternalError>("Unsupported DEM type.");
+    }
+}
+
+/** Compares kernel output with demNormals on the first real input (per
+ *  input type) and disables kernel on mismatch.
+ */
+bool selfCheck(const cv::Mat &dem, const cv::Mat &normals
+               , const math::Size2f &pixelSize
+               , const geo::normalmap::Parameters &params
+               , const imgproc::RasterMask &flatMask
+               , const imgproc::quadtree::RasterMask &inversionMask)
+{
+    cv::Mat plain;
+    dem.copyTo(plain);
+
+    cv::Mat reference;
+    if (plain.depth() == CV_8U) {
+        reference = geo::normalmap::demNormals<unsigned char>
+            (plain, pixelSize, params, flatMask, inversionMask);
+    } else {
+        plain.convertTo(plain, CV_64F);
+        reference = geo::normalmap::demNormals<double>
+            (plain, pixelSize, params, flatMask, inversionMask);
+    }
+
+    if ((reference.size() != normals.size())
+        || (reference.channels() != 3))
+    {
+        LOG(warn3) << "Native normal kernel disabled: reference normal map "
+                   << reference.cols << "x" << reference.rows
+                   << " does not match.";
+        return false;
+    }
+
+    cv::Mat ref32;
+    reference.convertTo(ref32, CV_32FC3);
+    const auto error(cv::norm(ref32, normals, cv::NORM_INF));
+    if (error > 1e-3) {
+        LOG(warn3) << "Native normal kernel disabled: deviates from "
+            "reference by " << error << ".";
+        return false;
+    }
+
+    LOG(info2) << "Native normal kernel verified (max deviation "
+               << error << ").";
+    return true;
+}
+
+struct Check {
+    std::once_flag once;
+    std::atomic<bool> enabled;
+
+    Check() : enabled(true) {}
+};
+
+Check& check(int depth)
+{
+    static Check checks[3];
+    return checks[(depth == CV_8U) ? 0 : ((depth == CV_32F) ? 1 : 2)];
+}
+
+} // namespace
+
+bool nativeDemNormals(const cv::Mat &dem, cv::Mat &out
+                      , const math::Size2f &pixelSize
+                      , const geo::normalmap::Parameters &params
+                      , const imgproc::RasterMask &flatMask
+                      , const imgproc::quadtree::RasterMask &inversionMask)
+{
+    if ((params.algorithm != geo::normalmap::Algorithm::zevenbergenThorne)
+        || !flatMask.empty() || !inversionMask.empty()
+        || (dem.channels() != 1) || (dem.rows < 3) || (dem.cols < 3))
+    {
+        return false;
+    }
+
+    auto &c(check(dem.depth()));
+    if (!c.enabled) { return false; }
+
+    ztNormals(dem, out, pixelSize, params);
+
+    std::call_once(c.once, [&]()
+    {
+        c.enabled = selfCheck(dem, out, pixelSize, params, flatMask
+                              , inversionMask);
+    });
+
+    return c.enabled;
+}
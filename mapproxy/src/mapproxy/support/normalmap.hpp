@@ -0,0 +1,116 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef mapproxy_support_normalmap_hpp_included_
+#define mapproxy_support_normalmap_hpp_included_
+
+#include <opencv2/core/core.hpp>
+
+#include "math/geometry_core.hpp"
+
+#include "geo/normalmap.hpp"
+
+#include "vts-libs/vts/csconvertor.hpp"
+
+#include "srs.hpp"
+
+namespace vts = vtslibs::vts;
+
+/** How rotation of normals from node SDS to tangent plane is evaluated.
+ */
+enum class NormalRotation {
+    /** Single rotation evaluated at tile center; fine once tiles no longer
+     *  span greater parts of hemispheres.
+     */
+    perTile
+
+    /** Rotation evaluated exactly for every pixel.
+     */
+    , exact
+
+    /** Rotation evaluated exactly on a coarse grid (17x17, refined up to
+     *  65x65 when needed) and bilinearly interpolated in between. Falls back
+     *  to exact when interpolation error exceeds the tolerance.
+     */
+    , grid
+};
+
+/** Default tolerance of interpolated rotation (radians, ~0.05 degree).
+ */
+constexpr double DefaultNormalAngularError = 1e-3;
+
+/** Fused normal map post-processing: rotates normals from node SDS to given
+ *  tangent plane, octahedron-encodes them and quantizes them to 8-bit BGR
+ *  (R = u, G = v, B = 0) in a single pass over the normal map.
+ *
+ *  Replaces the convertNormals -> encodeOct -> exportToBGR chain. Inner loop
+ *  is branch-free single precision arithmetic written for the compiler to
+ *  auto-vectorize.
+ *
+ * \param normals normal map (CV_32FC3 or CV_64FC3), pixel registered
+ * \param extents normal map extents in node SDS
+ * \param conv node SDS -> physical SRS convertor
+ * \param tangent physical SRS -> tangent plane rotation
+ * \param rotation rotation evaluation mode
+ * \param maxAngularError maximum error of interpolated rotation (grid mode)
+ * \return CV_8UC3 image
+ */
+cv::Mat exportNormals(const cv::Mat &normals, const math::Extents2 &extents
+                      , const vts::CsConvertor &conv
+                      , const TangentialPlaneConvertor &tangent
+                      , NormalRotation rotation
+                      , double maxAngularError = DefaultNormalAngularError);
+
+/** Same as above but writes into given image. Image is (re)allocated only
+ *  when its size or type does not match; meant for scratch buffers (see
+ *  ScratchMat).
+ */
+void exportNormals(const cv::Mat &normals, cv::Mat &out
+                   , const math::Extents2 &extents
+                   , const vts::CsConvertor &conv
+                   , const TangentialPlaneConvertor &tangent
+                   , NormalRotation rotation
+                   , double maxAngularError = DefaultNormalAngularError);
+
+/** Zevenbergen-Thorne normals of DEM (CV_32F, CV_64F or CV_8U, one pixel
+ *  margin on each side) computed in single precision straight into out
+ *  (CV_32FC3, DEM size minus margin). Row triplets are processed by a
+ *  branch-free loop written for the compiler to auto-vectorize; DEM may be
+ *  a view (e.g. block slice).
+ *
+ *  Stands in for geo::normalmap::demNormals when both masks are empty,
+ *  which is the usual case. Returns false (out untouched) otherwise, when
+ *  parameters ask for other algorithm or when the kernel has been disabled
+ *  by its one-time self-check against demNormals; caller then falls back
+ *  to demNormals.
+ */
+bool nativeDemNormals(const cv::Mat &dem, cv::Mat &out
+                      , const math::Size2f &pixelSize
+                      , const geo::normalmap::Parameters &params
+                      , const imgproc::RasterMask &flatMask
+                      , const imgproc::quadtree::RasterMask &inversionMask);
+
+#endif // mapproxy_support_normalmap_hpp_included_
@@ -0,0 +1,170 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <mutex>
+#include <cstring>
+#include <algorithm>
+
+#include "outbuffer.hpp"
+
+namespace {
+
+/** Pool of released buffers. Buffers are kept with their capacity, only
+ *  reasonably sized ones are retained.
+ */
+class Pool {
+public:
+    std::vector<char> acquire() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (free_.empty()) {
+            lock.unlock();
+            std::vector<char> storage;
+            storage.reserve(InitialSize);
+            return storage;
+        }
+        auto storage(std::move(free_.back()));
+        free_.pop_back();
+        return storage;
+    }
+
+    void release(std::vector<char> &&storage) {
+        // keep size: no need to clear content that is overwritten anyway
+        if (storage.capacity() > MaxRetainedSize) { return; }
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (free_.size() >= MaxRetained) { return; }
+        free_.push_back(std::move(storage));
+    }
+
+private:
+    static constexpr std::size_t InitialSize = 1 << 16;
+    static constexpr std::size_t MaxRetainedSize = 1 << 23;
+    static constexpr std::size_t MaxRetained = 64;
+
+    std::mutex mutex_;
+    std::vector<std::vector<char>> free_;
+};
+
+Pool& pool()
+{
+    static Pool pool;
+    return pool;
+}
+
+} // namespace
+
+PooledStreamBuf::PooledStreamBuf()
+    : storage_(pool().acquire()), high_()
+{
+    storage_.resize(storage_.capacity());
+    setp(storage_.data(), storage_.data() + storage_.size());
+}
+
+PooledStreamBuf::~PooledStreamBuf()
+{
+    pool().release(std::move(storage_));
+}
+
+std::size_t PooledStreamBuf::size() const
+{
+    return std::max(high_, std::size_t(pptr() - pbase()));
+}
+
+void PooledStreamBuf::grow(std::size_t extra)
+{
+    const std::size_t pos(pptr() - pbase());
+    high_ = size();
+
+    const std::size_t needed(pos + extra);
+    if (needed <= storage_.size()) { return; }
+
+    storage_.resize(std::max(needed, 2 * storage_.size()));
+    setp(storage_.data(), storage_.data() + storage_.size());
+    pbump(int(pos));
+}
+
+PooledStreamBuf::int_type PooledStreamBuf::overflow(int_type c)
+{
+    if (traits_type::eq_int_type(c, traits_type::eof())) {
+        return traits_type::not_eof(c);
+    }
+
+    grow(1);
+    *pptr() = traits_type::to_char_type(c);
+    pbump(1);
+    return c;
+}
+
+std::streamsize PooledStreamBuf::xsputn(const char *s, std::streamsize n)
+{
+    if (n <= 0) { return 0; }
+    if (epptr() - pptr() < n) { grow(n); }
+
+    std::memcpy(pptr(), s, n);
+    pbump(int(n));
+    return n;
+}
+
+PooledStreamBuf::pos_type
+PooledStreamBuf::seekoff(off_type off, std::ios_base::seekdir dir
+                         , std::ios_base::openmode which)
+{
+    if (!(which & std::ios_base::out)) { return pos_type(off_type(-1)); }
+
+    const off_type current(pptr() - pbase());
+    if ((dir == std::ios_base::cur) && !off) { return pos_type(current); }
+
+    off_type base(0);
+    switch (dir) {
+    case std::ios_base::beg: base = 0; break;
+    case std::ios_base::cur: base = current; break;
+    case std::ios_base::end: base = size(); break;
+    default: return pos_type(off_type(-1));
+    }
+
+    return seekpos(pos_type(base + off), which);
+}
+
+PooledStreamBuf::pos_type
+PooledStreamBuf::seekpos(pos_type pos, std::ios_base::openmode which)
+{
+    const off_type target(pos);
+    if (!(which & std::ios_base::out) || (target < 0)
+        || (std::size_t(target) > size()))
+    {
+        return pos_type(off_type(-1));
+    }
+
+    high_ = size();
+    setp(storage_.data(), storage_.data() + storage_.size());
+    pbump(int(target));
+    return pos;
+}
+
+bool OutputBuffer::gzipped() const
+{
+    const auto *d(reinterpret_cast<const unsigned char*>(data()));
+    return ((size() >= 2) && (d[0] == 0x1f) && (d[1] == 0x8b));
+}
@@ -0,0 +1,92 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef mapproxy_support_outbuffer_hpp_included_
+#define mapproxy_support_outbuffer_hpp_included_
+
+#include <memory>
+#include <vector>
+#include <ostream>
+#include <streambuf>
+
+/** Growable output stream buffer. Storage is taken from (and returned to)
+ *  a process-wide pool of buffers so serialization of tiles does not start
+ *  from an empty allocation every time.
+ */
+class PooledStreamBuf : public std::streambuf {
+public:
+    PooledStreamBuf();
+    virtual ~PooledStreamBuf();
+
+    PooledStreamBuf(const PooledStreamBuf&) = delete;
+    PooledStreamBuf& operator=(const PooledStreamBuf&) = delete;
+
+    const char* data() const { return storage_.data(); }
+    std::size_t size() const;
+
+protected:
+    virtual int_type overflow(int_type c);
+    virtual std::streamsize xsputn(const char *s, std::streamsize n);
+    virtual pos_type seekoff(off_type off, std::ios_base::seekdir dir
+                             , std::ios_base::openmode which);
+    virtual pos_type seekpos(pos_type pos, std::ios_base::openmode which);
+
+private:
+    /** Makes room for at least extra more bytes.
+     */
+    void grow(std::size_t extra);
+
+    std::vector<char> storage_;
+
+    /** Highest written position, updated when seeking back.
+     */
+    std::size_t high_;
+};
+
+/** Output stream writing into pooled memory. Once filled it can be passed to
+ *  Sink::content(const OutputBuffer::pointer&, ...) which sends data without
+ *  copying them, the buffer is kept alive until the response is sent.
+ */
+class OutputBuffer : public std::ostream {
+public:
+    typedef std::shared_ptr<OutputBuffer> pointer;
+
+    OutputBuffer() : std::ostream(nullptr) { rdbuf(&buf_); }
+
+    static pointer create() { return std::make_shared<OutputBuffer>(); }
+
+    const char* data() const { return buf_.data(); }
+    std::size_t size() const { return buf_.size(); }
+
+    /** Checks gzip magic at the start of written data.
+     */
+    bool gzipped() const;
+
+private:
+    PooledStreamBuf buf_;
+};
+
+#endif // mapproxy_support_outbuffer_hpp_included_
@@ -0,0 +1,100 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <algorithm>
+
+#include <gdal_priv.h>
+
+#include "dbglog/dbglog.hpp"
+
+#include "../error.hpp"
+
+#include "palette.hpp"
+
+Palette::pointer readPalette(const std::string &path)
+{
+    std::shared_ptr< ::GDALDataset> ds
+        (static_cast< ::GDALDataset*>
+         (::GDALOpenEx(path.c_str(), (GDAL_OF_RASTER | GDAL_OF_READONLY)
+                       , nullptr, nullptr, nullptr))
+         , [](::GDALDataset *ds) { delete ds; });
+
+    if (!ds || (ds->GetRasterCount() != 1)) { return {}; }
+
+    auto *band(ds->GetRasterBand(1));
+    if ((band->GetRasterDataType() != ::GDT_Byte)
+        || (band->GetColorInterpretation() != ::GCI_PaletteIndex))
+    {
+        return {};
+    }
+
+    const auto *ct(band->GetColorTable());
+    if (!ct || (ct->GetPaletteInterpretation() != ::GPI_RGB)) { return {}; }
+
+    auto palette(std::make_shared<Palette>());
+    const auto count(std::min(ct->GetColorEntryCount(), 256));
+    palette->colors.reserve(count);
+    for (int i(0); i < count; ++i) {
+        const auto *e(ct->GetColorEntry(i));
+        palette->colors.emplace_back(e->c3, e->c2, e->c1, e->c4);
+        if (e->c4 != 255) { palette->transparent = true; }
+    }
+
+    return palette;
+}
+
+cv::Mat applyPalette(const cv::Mat &index, const Palette &palette)
+{
+    if (index.type() != CV_8UC1) {
+        LOGTHROW(err2, InternalError)
+            << "Paletted image must be a single channel 8-bit image.";
+    }
+
+    // full-size lookup table, missing entries are transparent black
+    cv::Vec4b lut[256] = {};
+    std::copy(palette.colors.begin(), palette.colors.end(), lut);
+
+    if (palette.transparent) {
+        cv::Mat image(index.rows, index.cols, CV_8UC4);
+        for (int j(0); j < index.rows; ++j) {
+            const auto *src(index.ptr<std::uint8_t>(j));
+            auto *dst(image.ptr<cv::Vec4b>(j));
+            for (int i(0); i < index.cols; ++i) { dst[i] = lut[src[i]]; }
+        }
+        return image;
+    }
+
+    cv::Mat image(index.rows, index.cols, CV_8UC3);
+    for (int j(0); j < index.rows; ++j) {
+        const auto *src(index.ptr<std::uint8_t>(j));
+        auto *dst(image.ptr<cv::Vec3b>(j));
+        for (int i(0); i < index.cols; ++i) {
+            const auto &c(lut[src[i]]);
+            dst[i] = cv::Vec3b(c[0], c[1], c[2]);
+        }
+    }
+    return image;
+}
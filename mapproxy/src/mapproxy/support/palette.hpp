@@ -0,0 +1,62 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef mapproxy_support_palette_hpp_included_
+#define mapproxy_support_palette_hpp_included_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+/** Colour table of a paletted (single band, indexed) dataset.
+ */
+struct Palette {
+    typedef std::shared_ptr<const Palette> pointer;
+
+    /** BGRA entries indexed by pixel value (at most 256).
+     */
+    std::vector<cv::Vec4b> colors;
+
+    /** Some entry is not fully opaque.
+     */
+    bool transparent;
+
+    Palette() : transparent(false) {}
+};
+
+/** Reads colour table of given dataset. Returns null pointer unless the
+ *  dataset has a single 8-bit band with a colour table.
+ */
+Palette::pointer readPalette(const std::string &path);
+
+/** Expands index image into BGR (BGRA if palette is transparent) image.
+ *  Indices outside of the palette end up black (and transparent).
+ */
+cv::Mat applyPalette(const cv::Mat &index, const Palette &palette);
+
+#endif // mapproxy_support_palette_hpp_included_
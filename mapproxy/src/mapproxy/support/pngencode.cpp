@@ -0,0 +1,213 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <csetjmp>
+#include <cstdint>
+
+#include <png.h>
+
+#include "dbglog/dbglog.hpp"
+
+#include "../error.hpp"
+
+#include "scratch.hpp"
+#include "pngencode.hpp"
+
+namespace {
+
+/** Initial size of scratch buffers.
+ */
+constexpr std::size_t InitialBufferSize(1 << 14);
+
+void pngWrite(::png_structp png, ::png_bytep data, ::png_size_t size)
+{
+    auto &buf(*static_cast<std::vector<unsigned char>*>
+              (::png_get_io_ptr(png)));
+    buf.insert(buf.end(), data, data + size);
+}
+
+void pngFlush(::png_structp) {}
+
+/** Writes PNG image into buf. Setup is called with PNG structures after
+ *  image header is set, row(j) must return j-th row in PNG layout.
+ *
+ *  libpng reports errors by longjmp: neither setup, nor row may throw or
+ *  create anything with a destructor.
+ */
+template <typename Setup, typename Row>
+void writePng(std::vector<unsigned char> &buf, int width, int height
+              , int bitDepth, int colorType, int compression
+              , const Setup &setup, const Row &row)
+{
+    buf.clear();
+    buf.reserve(InitialBufferSize);
+
+    auto png(::png_create_write_struct
+             (PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr));
+    if (!png) {
+        LOGTHROW(err2, InternalError) << "Unable to create PNG writer.";
+    }
+    auto info(::png_create_info_struct(png));
+    if (!info) {
+        ::png_destroy_write_struct(&png, nullptr);
+        LOGTHROW(err2, InternalError) << "Unable to create PNG writer.";
+    }
+
+    if (setjmp(png_jmpbuf(png))) {
+        ::png_destroy_write_struct(&png, &info);
+        LOGTHROW(err2, InternalError) << "Failed to encode PNG image.";
+    }
+
+    ::png_set_write_fn(png, &buf, &pngWrite, &pngFlush);
+    ::png_set_compression_level(png, compression);
+    ::png_set_IHDR(png, info, width, height, bitDepth, colorType
+                   , PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT
+                   , PNG_FILTER_TYPE_DEFAULT);
+    setup(png, info);
+
+    ::png_write_info(png, info);
+    for (int j(0); j < height; ++j) {
+        ::png_write_row(png, const_cast< ::png_bytep>(row(j)));
+    }
+    ::png_write_end(png, info);
+    ::png_destroy_write_struct(&png, &info);
+
+    ScratchMat::bufferCapacity(buf.capacity());
+}
+
+/** Lowest bit depth able to hold all mask values.
+ */
+int maskDepth(const cv::Mat &mask)
+{
+    bool binary(true);
+    for (int j(0); j < mask.rows; ++j) {
+        const auto *row(mask.ptr<std::uint8_t>(j));
+        for (int i(0); i < mask.cols; ++i) {
+            const auto value(row[i]);
+            // 2-bit gray scales to 0, 85, 170 and 255
+            if (value % 85) { return 8; }
+            if (value && (value != 255)) { binary = false; }
+        }
+    }
+    return binary ? 1 : 2;
+}
+
+/** Packs mask row into bitDepth bits per pixel, most significant bits
+ *  first.
+ */
+void packRow(const std::uint8_t *src, int width, int bitDepth
+             , std::uint8_t *dst)
+{
+    const int perByte(8 / bitDepth);
+    const int shift(8 - bitDepth);
+    for (int i(0); i < width; i += perByte) {
+        std::uint8_t byte(0);
+        for (int k(0); k < perByte; ++k) {
+            byte <<= bitDepth;
+            if ((i + k) < width) { byte |= (src[i + k] >> shift); }
+        }
+        *dst++ = byte;
+    }
+}
+
+} // namespace
+
+void encodeMask(const cv::Mat &mask, std::vector<unsigned char> &buf
+                , int compression)
+{
+    // packed rows, keep their capacity between calls
+    thread_local std::vector<std::uint8_t> packed;
+
+    if (mask.type() != CV_8UC1) {
+        LOGTHROW(err2, InternalError)
+            << "Mask must be a single channel 8-bit image.";
+    }
+
+    const auto bitDepth(maskDepth(mask));
+
+    if (bitDepth == 8) {
+        return writePng(buf, mask.cols, mask.rows, 8, PNG_COLOR_TYPE_GRAY
+                        , compression, [](::png_structp, ::png_infop) {}
+                        , [&](int j) { return mask.ptr<std::uint8_t>(j); });
+    }
+
+    const auto rowSize((mask.cols * bitDepth + 7) / 8);
+    packed.resize(rowSize);
+
+    writePng(buf, mask.cols, mask.rows, bitDepth, PNG_COLOR_TYPE_GRAY
+             , compression, [](::png_structp png, ::png_infop)
+    {
+        ::png_set_filter(png, 0, PNG_FILTER_NONE);
+    }, [&](int j) -> const std::uint8_t*
+    {
+        packRow(mask.ptr<std::uint8_t>(j), mask.cols, bitDepth
+                , packed.data());
+        return packed.data();
+    });
+}
+
+const std::vector<unsigned char>&
+encodePalettedPng(const cv::Mat &index, const Palette &palette
+                  , int compression)
+{
+    // scratch buffer, keeps its capacity between calls
+    thread_local std::vector<unsigned char> buf;
+
+    if ((index.type() != CV_8UC1) || palette.colors.empty()) {
+        LOGTHROW(err2, InternalError)
+            << "Unable to encode paletted PNG: single channel 8-bit image "
+            "and non-empty palette expected.";
+    }
+
+    // PNG wants RGB palette and separate alpha values
+    const int count(palette.colors.size());
+    ::png_color colors[256];
+    ::png_byte alpha[256];
+    for (int i(0); i < count; ++i) {
+        const auto &c(palette.colors[i]);
+        colors[i].red = c[2];
+        colors[i].green = c[1];
+        colors[i].blue = c[0];
+        alpha[i] = c[3];
+    }
+
+    // alpha of trailing opaque entries need not be stored
+    int alphaCount(count);
+    while (alphaCount && (alpha[alphaCount - 1] == 255)) { --alphaCount; }
+
+    writePng(buf, index.cols, index.rows, 8, PNG_COLOR_TYPE_PALETTE
+             , compression, [&](::png_structp png, ::png_infop info)
+    {
+        ::png_set_PLTE(png, info, colors, count);
+        if (alphaCount) {
+            ::png_set_tRNS(png, info, alpha, alphaCount, nullptr);
+        }
+        // filtering does not help indexed images
+        ::png_set_filter(png, 0, PNG_FILTER_NONE);
+    }, [&](int j) { return index.ptr<std::uint8_t>(j); });
+
+    return buf;
+}
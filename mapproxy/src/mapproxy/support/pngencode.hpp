@@ -0,0 +1,55 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef mapproxy_support_pngencode_hpp_included_
+#define mapproxy_support_pngencode_hpp_included_
+
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include "palette.hpp"
+
+/** Encodes single channel 8-bit mask as grayscale PNG of the lowest bit
+ *  depth able to hold it losslessly: 1 bit for 0/255 masks, 2 bits for
+ *  masks using only 0, 85, 170 and 255, 8 bits otherwise. Decoded image is
+ *  identical to the input in all cases.
+ *
+ *  Rows of low bit depth images are not filtered, prediction does more harm
+ *  than good on bit-packed data.
+ */
+void encodeMask(const cv::Mat &mask, std::vector<unsigned char> &buf
+                , int compression = 9);
+
+/** Encodes index image as an indexed PNG (PLTE + tRNS chunks). Returned
+ *  buffer is a per-thread scratch buffer valid until the next call in the
+ *  same thread.
+ */
+const std::vector<unsigned char>&
+encodePalettedPng(const cv::Mat &index, const Palette &palette
+                  , int compression);
+
+#endif // mapproxy_support_pngencode_hpp_included_
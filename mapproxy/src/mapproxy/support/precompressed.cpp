@@ -0,0 +1,112 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <sstream>
+#include <unordered_map>
+
+#include "dbglog/dbglog.hpp"
+
+#include "utility/gzipper.hpp"
+
+#include "precompressed.hpp"
+
+namespace vs = vtslibs::storage;
+
+namespace precompressed {
+
+namespace {
+
+/** Files smaller than this are not worth compressing.
+ */
+constexpr std::size_t MinSize(512);
+
+/** Gzipped files must save at least 10% to be used.
+ */
+constexpr double MaxRatio(0.9);
+
+/** Gzipped variants keyed by (static) support file address.
+ */
+std::unordered_map<const vs::SupportFile*, std::string>& registry()
+{
+    static std::unordered_map<const vs::SupportFile*, std::string> registry;
+    return registry;
+}
+
+} // namespace
+
+void prepare(const vs::SupportFile::Files &files)
+{
+    auto &reg(registry());
+    std::size_t plain(0), gzipped(0);
+
+    for (const auto &item : files) {
+        const auto &file(item.second);
+        if (file.isTemplate || (file.size < MinSize) || reg.count(&file)) {
+            continue;
+        }
+
+        std::ostringstream os;
+        {
+            utility::Gzipper gzipper(os);
+            std::ostream &gos(gzipper);
+            gos.write(reinterpret_cast<const char*>(file.data), file.size);
+        }
+
+        auto data(os.str());
+        if (data.size() > (file.size * MaxRatio)) { continue; }
+
+        plain += file.size;
+        gzipped += data.size();
+        reg.emplace(&file, std::move(data));
+    }
+
+    if (plain) {
+        LOG(info1) << "Precompressed support files: " << plain << " -> "
+                   << gzipped << " bytes.";
+    }
+}
+
+void send(Sink &sink, const vs::SupportFile &file
+          , const Sink::FileInfo &stat, bool acceptGzip)
+{
+    const auto &reg(registry());
+    auto freg(reg.find(&file));
+    if (freg == reg.end()) {
+        sink.content(file.data, file.size, stat, false);
+        return;
+    }
+
+    auto sfi(stat);
+    sfi.addHeader("Vary", "Accept-Encoding");
+    if (acceptGzip) {
+        sfi.addHeader("Content-Encoding", "gzip");
+        sink.content(freg->second.data(), freg->second.size(), sfi, false);
+    } else {
+        sink.content(file.data, file.size, sfi, false);
+    }
+}
+
+} // namespace precompressed
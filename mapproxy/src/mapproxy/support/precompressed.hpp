@@ -0,0 +1,59 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef mapproxy_support_precompressed_hpp_included_
+#define mapproxy_support_precompressed_hpp_included_
+
+#include "vts-libs/storage/support.hpp"
+
+#include "../sink.hpp"
+
+/** Gzipped variants of built-in support files (browser bundles, styles).
+ *
+ *  Variants are made once at startup for all non-template files of given
+ *  tables and kept for the lifetime of the process. Templates are expanded
+ *  per request and are always sent plain.
+ */
+namespace precompressed {
+
+/** Makes gzipped variants of files in given table. Must be called before
+ *  any request is served (the registry is not locked).
+ */
+void prepare(const vtslibs::storage::SupportFile::Files &files);
+
+/** Sends built-in support file as is, gzipped if the client accepts it and
+ *  there is a variant.
+ *  \param sink sink to send to
+ *  \param file support file
+ *  \param stat file info (size is ignored)
+ *  \param acceptGzip client accepts gzipped content
+ */
+void send(Sink &sink, const vtslibs::storage::SupportFile &file
+          , const Sink::FileInfo &stat, bool acceptGzip);
+
+} // namespace precompressed
+
+#endif // mapproxy_support_precompressed_hpp_included_
@@ -0,0 +1,183 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <fstream>
+#include <sstream>
+#include <functional>
+
+#include <boost/filesystem.hpp>
+#include <boost/format.hpp>
+
+#include "dbglog/dbglog.hpp"
+
+#include "utility/path.hpp"
+
+#include "jsoncpp/as.hpp"
+#include "jsoncpp/io.hpp"
+
+#include "../error.hpp"
+
+#include "hash.hpp"
+#include "preparedstate.hpp"
+
+namespace fs = boost::filesystem;
+
+std::string definitionHash(const Resource &resource)
+{
+    Json::Value definition(Json::objectValue);
+    resource.definition()->to(definition);
+
+    std::ostringstream os;
+    os.precision(15);
+    Json::write(os, definition);
+
+    return str(boost::format("%016x") % stableHash(os.str()));
+}
+
+namespace {
+
+/** Modification times of all sources, null if any is unavailable.
+ */
+Json::Value mtimes(const PreparedState::Sources &sources)
+{
+    Json::Value value(Json::arrayValue);
+    for (const auto &source : sources) {
+        boost::system::error_code ec;
+        const auto mtime(fs::last_write_time(source, ec));
+        if (ec) { return Json::nullValue; }
+        value.append(Json::Int64(mtime));
+    }
+    return value;
+}
+
+} // namespace
+
+PreparedState::PreparedState(const fs::path &root, const Resource &resource)
+    : path_(root / "prepared.json"), hash_(definitionHash(resource))
+    , values_(Json::objectValue), changed_(false)
+{
+    if (!fs::exists(path_)) { return; }
+
+    try {
+        std::ifstream f;
+        f.exceptions(std::ios::badbit | std::ios::failbit);
+        f.open(path_.string(), std::ios_base::in);
+        const auto record(Json::read<FormatError>(f, path_, "prepared state"));
+
+        std::string hash;
+        Json::get(hash, record, "hash");
+        if (hash == hash_) { values_ = record["values"]; }
+    } catch (const std::exception &e) {
+        LOG(warn2) << "Ignoring prepared state " << path_
+                   << ": <" << e.what() << ">.";
+    }
+
+    if (!values_.isObject()) { values_ = Json::objectValue; }
+}
+
+Json::Value PreparedState::get(const std::string &key, const Sources &sources
+                               , const Compute &compute)
+{
+    const auto current(mtimes(sources));
+
+    if (!current.isNull() && values_.isMember(key)) {
+        const auto &entry(values_[key]);
+        if (entry["mtimes"] == current) { return entry["value"]; }
+    }
+
+    auto value(compute());
+
+    if (!current.isNull()) {
+        auto &entry(values_[key] = Json::objectValue);
+        entry["mtimes"] = current;
+        entry["value"] = value;
+        changed_ = true;
+    } else if (values_.isMember(key)) {
+        values_.removeMember(key);
+        changed_ = true;
+    }
+
+    return value;
+}
+
+void PreparedState::save()
+{
+    if (!changed_) { return; }
+
+    Json::Value record(Json::objectValue);
+    record["hash"] = hash_;
+    record["values"] = values_;
+
+    try {
+        const auto tmpPath(utility::addExtension(path_, ".tmp"));
+        {
+            std::ofstream f;
+            f.exceptions(std::ios::badbit | std::ios::failbit);
+            f.open(tmpPath.string(), std::ios_base::out | std::ios_base::trunc);
+            f.precision(17);
+            Json::write(f, record);
+        }
+        fs::rename(tmpPath, path_);
+        changed_ = false;
+    } catch (const std::exception &e) {
+        LOG(warn2) << "Unable to save prepared state " << path_
+                   << ": <" << e.what() << ">.";
+    }
+}
+
+namespace {
+
+EffectiveGsd effectiveGsd(PreparedState &state, const std::string &dataset
+                          , const std::function<EffectiveGsd()> &compute)
+{
+    const auto value(state.get("effectiveGsd:" + dataset, { dataset }
+                               , [&]() -> Json::Value
+    {
+        const auto gsd(compute());
+        Json::Value jgsd(Json::objectValue);
+        jgsd["area"] = gsd.area;
+        jgsd["computed"] = gsd.computed;
+        return jgsd;
+    }));
+
+    return { value["area"].asDouble(), value["computed"].asBool() };
+}
+
+} // namespace
+
+EffectiveGsd effectiveGsd(PreparedState &state, const std::string &dataset)
+{
+    return effectiveGsd(state, dataset, [&]()
+    {
+        return effectiveGsd(geo::GeoDataset::open(dataset));
+    });
+}
+
+EffectiveGsd effectiveGsd(PreparedState &state, const std::string &dataset
+                          , const EffectiveGsd &known)
+{
+    return effectiveGsd(state, dataset, [&]() { return known; });
+}
@@ -0,0 +1,94 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef mapproxy_support_preparedstate_hpp_included_
+#define mapproxy_support_preparedstate_hpp_included_
+
+#include <vector>
+#include <string>
+#include <functional>
+
+#include <boost/filesystem/path.hpp>
+
+#include "jsoncpp/json.hpp"
+
+#include "../resource.hpp"
+#include "geo.hpp"
+
+/** Values computed while preparing a generator (typically by opening GDAL
+ *  datasets) persisted in resource's store directory, so that a restart does
+ *  not need to touch the datasets again.
+ *
+ *  The record is bound to the resource definition (by hash) and every value
+ *  to modification times of the files it was computed from. Stale or
+ *  unbound values are recomputed. Nothing is cached for values depending on
+ *  non-local files (no mtime available).
+ */
+class PreparedState {
+public:
+    typedef std::vector<boost::filesystem::path> Sources;
+    typedef std::function<Json::Value()> Compute;
+
+    /** Loads record stored in given resource store directory (if any and
+     *  valid for resource).
+     */
+    PreparedState(const boost::filesystem::path &root
+                  , const Resource &resource);
+
+    /** Returns value stored under key if still valid, otherwise computes it
+     *  and remembers it along with modification times of sources.
+     */
+    Json::Value get(const std::string &key, const Sources &sources
+                    , const Compute &compute);
+
+    /** Writes record back to disk if anything was recomputed. Failures are
+     *  only logged.
+     */
+    void save();
+
+private:
+    boost::filesystem::path path_;
+    std::string hash_;
+    Json::Value values_;
+    bool changed_;
+};
+
+/** Stable hash of resource definition (hex string).
+ */
+std::string definitionHash(const Resource &resource);
+
+/** Effective GSD of given dataset, cached in prepared state.
+ */
+EffectiveGsd effectiveGsd(PreparedState &state, const std::string &dataset);
+
+/** Effective GSD of given dataset, cached in prepared state. Already known
+ *  value (e.g. probed by a GDAL worker) is recorded as is, dataset is not
+ *  opened.
+ */
+EffectiveGsd effectiveGsd(PreparedState &state, const std::string &dataset
+                          , const EffectiveGsd &known);
+
+#endif // mapproxy_support_preparedstate_hpp_included_
@@ -0,0 +1,64 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef mapproxy_support_probes_hpp_included_
+#define mapproxy_support_probes_hpp_included_
+
+/** USDT (statically defined tracing) probes of provider "mapproxy" for use
+ *  with bpftrace, perf or systemtap, e.g.:
+ *
+ *      bpftrace -e 'usdt:/path/to/mapproxy:mapproxy:task__dequeue
+ *                   { @queue = hist(arg1); }'
+ *
+ *  Probes:
+ *      task__enqueue(traceId): generator task queued
+ *      task__dequeue(traceId, queueUsec): generator task started
+ *      task__finish(traceId): generator task finished
+ *      warp__start(traceId, pixels): GDAL worker picked request
+ *      warp__finish(traceId, cpuUsec): GDAL worker finished request
+ *      encode__start(format, pixels): image encoding started
+ *      encode__finish(format, bytes): image encoding finished
+ *
+ *  Probes are compiled in when <sys/sdt.h> (systemtap-sdt-dev) is available
+ *  unless MAPPROXY_NO_USDT is defined. Disabled probe is a single nop.
+ */
+
+#if !defined(MAPPROXY_NO_USDT) && defined(__has_include)
+#  if __has_include(<sys/sdt.h>)
+#    include <sys/sdt.h>
+#    define MAPPROXY_HAS_USDT 1
+#  endif
+#endif
+
+#ifdef MAPPROXY_HAS_USDT
+#  define MAPPROXY_PROBE1(name, a) DTRACE_PROBE1(mapproxy, name, a)
+#  define MAPPROXY_PROBE2(name, a, b) DTRACE_PROBE2(mapproxy, name, a, b)
+#else
+#  define MAPPROXY_PROBE1(name, a) ((void) 0)
+#  define MAPPROXY_PROBE2(name, a, b) ((void) 0)
+#endif
+
+#endif // mapproxy_support_probes_hpp_included_
@@ -0,0 +1,329 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <ctime>
+#include <mutex>
+#include <vector>
+#include <cerrno>
+#include <cstring>
+#include <system_error>
+#include <algorithm>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <execinfo.h>
+#include <sys/syscall.h>
+
+#include <boost/format.hpp>
+#include <boost/filesystem.hpp>
+
+#include "dbglog/dbglog.hpp"
+
+#include "profiler.hpp"
+
+namespace fs = boost::filesystem;
+
+// older glibc lacks the alias
+#ifndef sigev_notify_thread_id
+#  define sigev_notify_thread_id _sigev_un._tid
+#endif
+
+namespace profiler {
+
+namespace {
+
+/** Maximum depth of sampled stack.
+ */
+constexpr int MaxFrames(64);
+
+/** Real-time signal delivered by sampling timers; other signals are likely
+ *  to be used by libraries (SIGPROF by gperftools, SIGUSR* by service).
+ */
+int sampleSignal() { return SIGRTMIN + 3; }
+
+std::uint64_t monotonicNs()
+{
+    struct timespec ts;
+    ::clock_gettime(CLOCK_MONOTONIC, &ts);
+    return std::uint64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+/** Async-signal-safe decimal formatting. Returns end of output.
+ */
+char* formatNumber(char *out, std::uint64_t value)
+{
+    char tmp[24];
+    int size(0);
+    do {
+        tmp[size++] = char('0' + (value % 10));
+        value /= 10;
+    } while (value);
+
+    while (size) { *out++ = tmp[--size]; }
+    return out;
+}
+
+char* append(char *out, const char *what)
+{
+    while (*what) { *out++ = *what++; }
+    return out;
+}
+
+} // namespace
+
+struct Sampler::State {
+    const Options options;
+    const std::string what;
+
+    timer_t timer;
+    bool valid;
+
+    /** Profile file of current request.
+     */
+    char path[1024];
+
+    /** Signal handler state: armed while watching a request.
+     */
+    volatile sig_atomic_t armed;
+    volatile sig_atomic_t taken;
+    std::uint64_t started;
+
+    State(const Options &options, const std::string &what)
+        : options(options), what(what), timer(), valid(false), path()
+        , armed(0), taken(0), started()
+    {}
+
+    void disarm() {
+        struct itimerspec its;
+        std::memset(&its, 0, sizeof(its));
+        ::timer_settime(timer, 0, &its, nullptr);
+    }
+};
+
+namespace {
+
+// sampler of this thread; signal handler runs in the sampled thread
+thread_local Sampler *currentSampler(nullptr);
+thread_local Sampler::State *currentState(nullptr);
+
+void sample(int, ::siginfo_t*, void*)
+{
+    auto *state(currentState);
+    if (!state || !state->armed) { return; }
+
+    const int savedErrno(errno);
+
+    if (unsigned(state->taken) < state->options.samples) {
+        const int fd(::open(state->path
+                            , O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC
+                            , 0644));
+        if (fd >= 0) {
+            char header[128];
+            char *p(append(header, "# sample "));
+            p = formatNumber(p, state->taken + 1);
+            p = append(p, " at ");
+            p = formatNumber(p, (monotonicNs() - state->started) / 1000000);
+            p = append(p, " ms\n");
+            if (::write(fd, header, p - header) < 0) {}
+
+            void *frames[MaxFrames];
+            const int depth(::backtrace(frames, MaxFrames));
+            ::backtrace_symbols_fd(frames, depth, fd);
+            if (::write(fd, "\n", 1) < 0) {}
+            ::close(fd);
+        }
+        ++state->taken;
+    }
+
+    if (unsigned(state->taken) >= state->options.samples) {
+        state->disarm();
+    }
+
+    errno = savedErrno;
+}
+
+void installHandler()
+{
+    static std::once_flag once;
+    std::call_once(once, []()
+    {
+        // first call of backtrace() loads unwinder, do not do that in
+        // the signal handler
+        void *frames[1];
+        ::backtrace(frames, 1);
+
+        struct sigaction sa;
+        std::memset(&sa, 0, sizeof(sa));
+        sa.sa_sigaction = &sample;
+        sa.sa_flags = SA_SIGINFO | SA_RESTART;
+        ::sigemptyset(&sa.sa_mask);
+        if (::sigaction(sampleSignal(), &sa, nullptr) == -1) {
+            std::system_error e(errno, std::system_category());
+            LOG(warn2) << "Cannot install stack sampling handler: <"
+                       << e.what() << ">.";
+        }
+    });
+}
+
+itimerspec msec(unsigned int value, unsigned int interval)
+{
+    itimerspec its;
+    its.it_value.tv_sec = value / 1000;
+    its.it_value.tv_nsec = (value % 1000) * 1000000L;
+    its.it_interval.tv_sec = interval / 1000;
+    its.it_interval.tv_nsec = (interval % 1000) * 1000000L;
+    return its;
+}
+
+} // namespace
+
+Sampler::Sampler(const Options &options, const std::string &what)
+    : state_(new State(options, what))
+{
+    installHandler();
+
+    boost::system::error_code ec;
+    fs::create_directories(options.dir, ec);
+
+    struct sigevent sev;
+    std::memset(&sev, 0, sizeof(sev));
+    sev.sigev_notify = SIGEV_THREAD_ID;
+    sev.sigev_signo = sampleSignal();
+    sev.sigev_notify_thread_id = ::syscall(SYS_gettid);
+
+    if (::timer_create(CLOCK_MONOTONIC, &sev, &state_->timer) == -1) {
+        std::system_error e(errno, std::system_category());
+        LOG(warn2) << "Cannot create stack sampling timer: <"
+                   << e.what() << ">; " << what
+                   << " thread is not sampled.";
+        return;
+    }
+
+    state_->valid = true;
+    currentSampler = this;
+    currentState = state_.get();
+}
+
+Sampler::~Sampler()
+{
+    if (!state_->valid) { return; }
+
+    state_->armed = 0;
+    currentSampler = nullptr;
+    currentState = nullptr;
+    ::timer_delete(state_->timer);
+}
+
+void Sampler::start(std::uint64_t traceId)
+{
+    auto &state(*state_);
+    if (!state.valid) { return; }
+
+    // <time>-<trace>-<what>-<tid>.stack
+    const auto now(std::time(nullptr));
+    struct tm tm;
+    ::gmtime_r(&now, &tm);
+    char stamp[32];
+    std::strftime(stamp, sizeof(stamp), "%Y%m%dT%H%M%SZ", &tm);
+
+    const auto path
+        ((state.options.dir
+          / str(boost::format("%s-%s-%s-%d.stack")
+                % stamp % formatTraceId(traceId) % state.what
+                % ::syscall(SYS_gettid))).string());
+    const auto size(std::min(path.size(), sizeof(state.path) - 1));
+    std::memcpy(state.path, path.data(), size);
+    state.path[size] = '\0';
+
+    state.taken = 0;
+    state.started = monotonicNs();
+    state.armed = 1;
+
+    const auto its(msec(state.options.threshold
+                        , std::max(state.options.interval, 1u)));
+    ::timer_settime(state.timer, 0, &its, nullptr);
+}
+
+void Sampler::stop()
+{
+    auto &state(*state_);
+    if (!state.valid) { return; }
+
+    state.armed = 0;
+    state.disarm();
+
+    if (state.taken) {
+        LOG(info3) << "Slow " << state.what << " request sampled into <"
+                   << state.path << ">.";
+        rotate(state.options.dir, state.options.maxFiles);
+    }
+}
+
+Sampler::Scope::Scope(std::uint64_t traceId)
+    : sampler_(currentSampler)
+{
+    if (sampler_) { sampler_->start(traceId); }
+}
+
+Sampler::Scope::~Scope()
+{
+    if (sampler_) { sampler_->stop(); }
+}
+
+void rotate(const fs::path &dir, std::size_t maxFiles)
+{
+    typedef std::pair<std::time_t, fs::path> File;
+    std::vector<File> files;
+
+    boost::system::error_code ec;
+    for (fs::directory_iterator idir(dir, ec), edir; !ec && (idir != edir);
+         idir.increment(ec))
+    {
+        const auto &path(idir->path());
+        boost::system::error_code sec;
+        if (!fs::is_regular_file(path, sec)) { continue; }
+        const auto mtime(fs::last_write_time(path, sec));
+        if (sec) { continue; }
+        files.emplace_back(mtime, path);
+    }
+
+    if (files.size() <= maxFiles) { return; }
+
+    // oldest first
+    std::sort(files.begin(), files.end());
+    for (std::size_t i(0), e(files.size() - maxFiles); i < e; ++i) {
+        // another thread may have been rotating as well
+        fs::remove(files[i].second, ec);
+    }
+}
+
+std::string formatTraceId(std::uint64_t traceId)
+{
+    return str(boost::format("%016x") % traceId);
+}
+
+} // namespace profiler
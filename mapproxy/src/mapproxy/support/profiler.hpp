@@ -0,0 +1,132 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef mapproxy_support_profiler_hpp_included_
+#define mapproxy_support_profiler_hpp_included_
+
+#include <memory>
+#include <string>
+#include <cstdint>
+
+#include <boost/filesystem/path.hpp>
+
+/** Stack sampling of slow requests.
+ *
+ *  Every processing thread (core thread, GDAL worker) owns a sampler with a
+ *  per-thread POSIX timer. Timer is armed when the thread starts working on
+ *  a request. When the request is still running after the threshold, the
+ *  timer signals the thread and the signal handler appends the thread's
+ *  current stack to a file named after the request's trace ID. Sampling
+ *  goes on every interval until the request finishes or enough samples are
+ *  taken. Profile directory is rotated to keep the newest files only.
+ *
+ *  Works with both GDAL backends: the timer targets the sampled thread
+ *  directly, be it a thread of this process or a forked worker.
+ */
+namespace profiler {
+
+struct Options {
+    /** Directory profiles are written to.
+     */
+    boost::filesystem::path dir;
+
+    /** Requests running longer than this (in milliseconds) get their stack
+     *  sampled (0 = never).
+     */
+    unsigned int threshold;
+
+    /** Maximum number of stack samples of one slow request.
+     */
+    unsigned int samples;
+
+    /** Time between two samples (in milliseconds).
+     */
+    unsigned int interval;
+
+    /** Maximum number of files kept in the profile directory.
+     */
+    std::size_t maxFiles;
+
+    Options() : threshold(), samples(5), interval(20), maxFiles(100) {}
+
+    bool enabled() const { return threshold && !dir.empty(); }
+};
+
+/** Stack sampler of the calling thread, see above. Must be created and
+ *  destroyed in the sampled thread.
+ */
+class Sampler {
+public:
+    /** \param options sampling options
+     *  \param what thread kind used in file names (e.g. "core", "gdal")
+     */
+    Sampler(const Options &options, const std::string &what);
+    ~Sampler();
+
+    Sampler(const Sampler&) = delete;
+    Sampler& operator=(const Sampler&) = delete;
+
+    /** Starts watching request with given trace ID (0 = untraced).
+     */
+    void start(std::uint64_t traceId);
+
+    /** Stops watching current request. Rotates profile directory if
+     *  anything has been written.
+     */
+    void stop();
+
+    /** Watches request in calling thread's sampler (if any) during scope's
+     *  lifetime.
+     */
+    class Scope {
+    public:
+        Scope(std::uint64_t traceId);
+        ~Scope();
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        Sampler *sampler_;
+    };
+
+    struct State;
+
+private:
+    std::unique_ptr<State> state_;
+};
+
+/** Removes oldest files from directory to keep at most maxFiles of them.
+ */
+void rotate(const boost::filesystem::path &dir, std::size_t maxFiles);
+
+/** Formats trace ID as used in profile file names and logs.
+ */
+std::string formatTraceId(std::uint64_t traceId);
+
+} // namespace profiler
+
+#endif // mapproxy_support_profiler_hpp_included_
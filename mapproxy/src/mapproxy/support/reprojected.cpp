@@ -0,0 +1,72 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <boost/filesystem.hpp>
+
+#include "dbglog/dbglog.hpp"
+
+#include "reprojected.hpp"
+
+namespace fs = boost::filesystem;
+namespace vts = vtslibs::vts;
+namespace vr = vtslibs::registry;
+
+ReprojectedPyramids::ReprojectedPyramids(const std::string &dataset
+                                         , const vr::ReferenceFrame &rf
+                                         , vts::Lod maxLod)
+    : dataset_(dataset), maxLod_(maxLod)
+{
+    for (const auto &node : rf.division.nodes) {
+        const auto &srs(node.second.srs);
+        if (srs.empty() || pyramids_.count(srs)) { continue; }
+
+        const auto pyramid(path(dataset, srs));
+        if (!fs::exists(pyramid)) { continue; }
+
+        LOG(info2) << "Using reprojected pyramid " << pyramid
+                   << " up to LOD " << int(maxLod) << ".";
+        pyramids_[srs] = pyramid;
+    }
+}
+
+std::string
+ReprojectedPyramids::dataset(const vts::NodeInfo &node
+                             , const std::string &dataset) const
+{
+    if ((node.nodeId().lod > maxLod_) || (dataset != dataset_)) {
+        return dataset;
+    }
+
+    const auto fpyramids(pyramids_.find(node.srs()));
+    if (fpyramids == pyramids_.end()) { return dataset; }
+    return fpyramids->second;
+}
+
+std::string ReprojectedPyramids::path(const std::string &dataset
+                                      , const std::string &srs)
+{
+    return dataset + ".rf-" + srs;
+}
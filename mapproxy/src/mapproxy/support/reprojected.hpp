@@ -0,0 +1,77 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef mapproxy_support_reprojected_hpp_included_
+#define mapproxy_support_reprojected_hpp_included_
+
+#include <map>
+#include <string>
+
+#include "vts-libs/registry.hpp"
+#include "vts-libs/vts/nodeinfo.hpp"
+
+/** Overview pyramids of a dataset pre-reprojected into SRSes of reference
+ *  frame subtrees and aligned to their tile grid (built by
+ *  mapproxy-setup-resource on top of generatevrtwo). Pyramid of given SRS
+ *  lives next to the dataset as <dataset>.rf-<srs>.
+ *
+ *  Tiles up to maxLod are warped from the pyramid of their SRS, i.e. warp
+ *  reads tile-aligned pixels of a matching overview with no reprojection
+ *  instead of reprojecting huge footprint of the dataset.
+ */
+class ReprojectedPyramids {
+public:
+    ReprojectedPyramids() : maxLod_() {}
+
+    /** Finds pyramids of dataset for all SRSes used by the reference
+     *  frame. Missing pyramids are ignored.
+     */
+    ReprojectedPyramids(const std::string &dataset
+                        , const vtslibs::registry::ReferenceFrame &rf
+                        , vtslibs::vts::Lod maxLod);
+
+    /** Dataset to warp given node of given dataset from: pyramid of node's
+     *  SRS up to maxLod, the dataset itself otherwise (or when asked for
+     *  another dataset).
+     */
+    std::string dataset(const vtslibs::vts::NodeInfo &node
+                        , const std::string &dataset) const;
+
+    /** Path to pyramid of dataset in given SRS.
+     */
+    static std::string path(const std::string &dataset
+                            , const std::string &srs);
+
+private:
+    std::string dataset_;
+    vtslibs::vts::Lod maxLod_;
+
+    /** SRS -> pyramid path.
+     */
+    std::map<std::string, std::string> pyramids_;
+};
+
+#endif // mapproxy_support_reprojected_hpp_included_
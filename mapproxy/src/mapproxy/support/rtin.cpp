@@ -0,0 +1,159 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+
+#include "utility/raise.hpp"
+
+#include "../error.hpp"
+
+#include "rtin.hpp"
+
+bool Rtin::validSize(int size)
+{
+    const int tiles(size - 1);
+    return ((tiles > 0) && !(tiles & (tiles - 1)));
+}
+
+Rtin::Rtin(const std::vector<float> &heights, int size)
+    : size_(size), maxError_(), errors_(size * size, 0.f)
+{
+    if (!validSize(size) || (heights.size() != std::size_t(size * size))) {
+        utility::raise<InternalError>
+            ("Invalid RTIN grid size %d (must be 2^k + 1).", size);
+    }
+
+    const int tiles(size - 1);
+    const int triangles(tiles * tiles * 2 - 2);
+    const int parents(triangles - tiles * tiles);
+
+    // walk all triangles bottom-up, propagate errors to parents
+    for (int i(triangles - 1); i >= 0; --i) {
+        // decode triangle coordinates from its implicit binary tree id
+        int id(i + 2);
+        int ax(0), ay(0), bx(0), by(0), cx(0), cy(0);
+        if (id & 1) {
+            bx = by = cx = tiles;
+        } else {
+            ax = ay = cy = tiles;
+        }
+        while ((id >>= 1) > 1) {
+            const int mx((ax + bx) >> 1);
+            const int my((ay + by) >> 1);
+            if (id & 1) {
+                bx = ax; by = ay;
+                ax = cx; ay = cy;
+            } else {
+                ax = bx; ay = by;
+                bx = cx; by = cy;
+            }
+            cx = mx; cy = my;
+        }
+
+        // split point on the hypotenuse
+        const int mx((ax + bx) >> 1);
+        const int my((ay + by) >> 1);
+        const int middle(my * size + mx);
+
+        const float interpolated
+            ((heights[ay * size + ax] + heights[by * size + bx]) / 2.f);
+        auto &error(errors_[middle]);
+        error = std::max(error, std::abs(interpolated - heights[middle]));
+
+        if (i < parents) {
+            const int lcx(mx + my - ay), lcy(my + ax - mx);
+            const int left(((ay + lcy) >> 1) * size + ((ax + lcx) >> 1));
+            const int right(((by + lcy) >> 1) * size + ((bx + lcx) >> 1));
+            error = std::max({ error, errors_[left], errors_[right] });
+        }
+    }
+
+    maxError_ = *std::max_element(errors_.begin(), errors_.end());
+}
+
+template <typename Emit>
+void Rtin::process(int ax, int ay, int bx, int by, int cx, int cy
+                   , float maxError, const Emit &emit) const
+{
+    const int mx((ax + bx) >> 1);
+    const int my((ay + by) >> 1);
+
+    if ((std::abs(ax - cx) + std::abs(ay - cy) > 1)
+        && (errors_[my * size_ + mx] > maxError))
+    {
+        // split
+        process(cx, cy, ax, ay, mx, my, maxError, emit);
+        process(bx, by, cx, cy, mx, my, maxError, emit);
+        return;
+    }
+
+    emit(ay * size_ + ax, by * size_ + bx, cy * size_ + cx);
+}
+
+template <typename Emit>
+void Rtin::process(float maxError, const Emit &emit) const
+{
+    const int tiles(size_ - 1);
+    process(0, 0, tiles, tiles, tiles, 0, maxError, emit);
+    process(tiles, tiles, 0, 0, 0, tiles, maxError, emit);
+}
+
+std::size_t Rtin::count(float maxError) const
+{
+    std::size_t count(0);
+    process(maxError, [&](int, int, int) { ++count; });
+    return count;
+}
+
+Rtin::Faces Rtin::triangulate(float maxError) const
+{
+    Faces faces;
+    process(maxError, [&](int a, int b, int c)
+    {
+        faces.push_back({{ a, b, c }});
+    });
+    return faces;
+}
+
+float Rtin::threshold(std::size_t faceCount) const
+{
+    // bisection: face count decreases monotonically with growing error
+    float lo(0.f), hi(maxError_);
+    if (count(lo) <= faceCount) { return lo; }
+
+    for (int i(0); i < 24; ++i) {
+        const float mid(0.5f * (lo + hi));
+        if (count(mid) <= faceCount) {
+            hi = mid;
+        } else {
+            lo = mid;
+        }
+        if ((hi - lo) <= (1e-3f * maxError_)) { break; }
+    }
+    return hi;
+}
@@ -0,0 +1,85 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef mapproxy_support_rtin_hpp_included_
+#define mapproxy_support_rtin_hpp_included_
+
+#include <array>
+#include <vector>
+
+/** Right-triangulated irregular network (RTIN, after Martini) over a square
+ *  height grid of (2^k + 1) x (2^k + 1) samples.
+ *
+ *  Approximation error of every possible triangle split is computed once;
+ *  a triangulation for any error threshold is then extracted by a single
+ *  top-down pass, no iterative simplification is needed.
+ */
+class Rtin {
+public:
+    typedef std::array<int, 3> Face;
+    typedef std::vector<Face> Faces;
+
+    /** Builds error map.
+     * \param heights row-major heights, size * size samples
+     * \param size grid size, must be (2^k + 1)
+     */
+    Rtin(const std::vector<float> &heights, int size);
+
+    /** Checks whether given grid size is valid.
+     */
+    static bool validSize(int size);
+
+    /** Number of faces of triangulation with given maximum error.
+     */
+    std::size_t count(float maxError) const;
+
+    /** Triangulation with given maximum error. Faces are grid sample indices
+     *  (row-major), vertices are ordered as they are split, orientation is
+     *  left to the caller.
+     */
+    Faces triangulate(float maxError) const;
+
+    /** Finds smallest error threshold (within tolerance) whose triangulation
+     *  has at most faceCount faces.
+     */
+    float threshold(std::size_t faceCount) const;
+
+    int size() const { return size_; }
+
+private:
+    template <typename Emit>
+    void process(float maxError, const Emit &emit) const;
+
+    template <typename Emit>
+    void process(int ax, int ay, int bx, int by, int cx, int cy
+                 , float maxError, const Emit &emit) const;
+
+    int size_;
+    float maxError_;
+    std::vector<float> errors_;
+};
+
+#endif // mapproxy_support_rtin_hpp_included_
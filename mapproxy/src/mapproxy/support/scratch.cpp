@@ -0,0 +1,166 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <atomic>
+#include <vector>
+#include <cstdint>
+
+#include "scratch.hpp"
+
+namespace {
+
+/** Matrices retained per thread.
+ */
+constexpr std::size_t MaxRetained = 8;
+
+/** Larger matrices are not tile temporaries, do not retain them.
+ */
+constexpr std::size_t MaxRetainedSize = 1 << 22;
+
+struct Stats {
+    std::atomic<std::uint64_t> acquired{0};
+    std::atomic<std::uint64_t> reused{0};
+    std::atomic<std::int64_t> inUse{0};
+    std::atomic<std::int64_t> inUseHigh{0};
+    std::atomic<std::int64_t> retained{0};
+    std::atomic<std::int64_t> retainedHigh{0};
+    std::atomic<std::int64_t> bufferHigh{0};
+};
+
+Stats stats;
+
+void updateHigh(std::atomic<std::int64_t> &high, std::int64_t value)
+{
+    auto current(high.load());
+    while ((value > current) && !high.compare_exchange_weak(current, value))
+    {}
+}
+
+std::int64_t bytes(const cv::Mat &mat)
+{
+    return mat.total() * mat.elemSize();
+}
+
+/** Per-thread free list.
+ */
+struct Pool {
+    std::vector<cv::Mat> free;
+
+    ~Pool() {
+        for (const auto &mat : free) { stats.retained -= bytes(mat); }
+    }
+
+    cv::Mat acquire(int rows, int cols, int type) {
+        for (auto i(free.begin()), e(free.end()); i != e; ++i) {
+            if ((i->rows == rows) && (i->cols == cols)
+                && (i->type() == type))
+            {
+                cv::Mat mat(*i);
+                free.erase(i);
+                stats.retained -= bytes(mat);
+                ++stats.reused;
+                return mat;
+            }
+        }
+        return cv::Mat(rows, cols, type);
+    }
+
+    void release(cv::Mat &mat) {
+        // keep only exclusively owned continuous storage of sane size
+        if (!mat.u || (mat.u->refcount > 1) || !mat.isContinuous()
+            || (std::size_t(bytes(mat)) > MaxRetainedSize))
+        {
+            return;
+        }
+
+        if (free.size() >= MaxRetained) {
+            // drop the oldest one
+            stats.retained -= bytes(free.front());
+            free.erase(free.begin());
+        }
+
+        free.push_back(mat);
+        updateHigh(stats.retainedHigh, stats.retained += bytes(mat));
+    }
+};
+
+thread_local Pool pool;
+
+} // namespace
+
+cv::Mat& ScratchMat::create(int rows, int cols, int type)
+{
+    if (!mat_.empty()) {
+        if ((mat_.rows == rows) && (mat_.cols == cols)
+            && (mat_.type() == type))
+        {
+            return mat_;
+        }
+        release();
+    }
+
+    mat_ = pool.acquire(rows, cols, type);
+    ++stats.acquired;
+    updateHigh(stats.inUseHigh, ++stats.inUse);
+    return mat_;
+}
+
+void ScratchMat::release()
+{
+    if (mat_.empty()) { return; }
+
+    --stats.inUse;
+    pool.release(mat_);
+    mat_ = cv::Mat();
+}
+
+void ScratchMat::bufferCapacity(std::size_t capacity)
+{
+    updateHigh(stats.bufferHigh, capacity);
+}
+
+void ScratchMat::stat(std::ostream &os, const std::string &prefix)
+{
+    const std::uint64_t acquired(stats.acquired);
+    const std::uint64_t reused(stats.reused);
+
+    os << prefix << "acquired=" << acquired << '\n'
+       << prefix << "reused=" << reused << '\n'
+       << prefix << "reuseRate="
+       << (acquired ? (double(reused) / acquired) : 0.0) << '\n'
+       << prefix << "inUse=" << stats.inUse << '\n'
+       << prefix << "inUseHigh=" << stats.inUseHigh << '\n'
+       << prefix << "retained=" << stats.retained << '\n'
+       << prefix << "retainedHigh=" << stats.retainedHigh << '\n'
+       << prefix << "bufferHigh=" << stats.bufferHigh << '\n';
+}
+
+const cv::Mat& blackTile()
+{
+    static const cv::Mat tile(cv::Mat_<cv::Vec3b>
+                              (256, 256, cv::Vec3b(0, 0, 0)));
+    return tile;
+}
@@ -0,0 +1,80 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef mapproxy_support_scratch_hpp_included_
+#define mapproxy_support_scratch_hpp_included_
+
+#include <string>
+#include <ostream>
+
+#include <opencv2/core/core.hpp>
+
+/** Scratch matrix borrowed from a per-thread pool of tile-sized buffers.
+ *
+ *  Matrix storage is returned to the pool when the scratch matrix goes out
+ *  of scope and handed out again to the next request of the same size and
+ *  type on the same thread, so steady-state tile generation does not hit
+ *  the heap for its temporaries. Storage still referenced by another
+ *  cv::Mat at release time is not pooled.
+ */
+class ScratchMat {
+public:
+    ScratchMat() = default;
+    ScratchMat(int rows, int cols, int type) { create(rows, cols, type); }
+    ~ScratchMat() { release(); }
+
+    ScratchMat(const ScratchMat&) = delete;
+    ScratchMat& operator=(const ScratchMat&) = delete;
+
+    /** Borrows matrix of given size and type, content is undefined.
+     */
+    cv::Mat& create(int rows, int cols, int type);
+
+    /** Returns matrix to the pool.
+     */
+    void release();
+
+    cv::Mat& mat() { return mat_; }
+    const cv::Mat& mat() const { return mat_; }
+
+    /** Pool statistics (aggregated over all threads).
+     */
+    static void stat(std::ostream &os, const std::string &prefix);
+
+    /** Notes capacity of a thread-local scratch byte buffer (e.g. image
+     *  encoder output) to be reported with pool statistics.
+     */
+    static void bufferCapacity(std::size_t capacity);
+
+private:
+    cv::Mat mat_;
+};
+
+/** Shared black BGR tile (256x256 CV_8UC3). Read-only.
+ */
+const cv::Mat& blackTile();
+
+#endif // mapproxy_support_scratch_hpp_included_
@@ -0,0 +1,401 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <cerrno>
+#include <cstring>
+#include <algorithm>
+#include <system_error>
+
+#include "dbglog/dbglog.hpp"
+
+#include "hash.hpp"
+#include "sharedcache.hpp"
+
+namespace {
+
+const char SegmentMagic[4] = { 'M', 'P', 'S', 'C' };
+const std::uint32_t SegmentVersion(1);
+
+/** Slots probed from the home slot of a hash.
+ */
+const std::size_t MaxProbe(16);
+
+/** Records are kept 8-byte aligned.
+ */
+const std::size_t RecordAlignment(8);
+
+/** Key hash; zero is reserved for empty slot.
+ */
+std::uint64_t keyHash(const std::string &key)
+{
+    const auto hash(stableHash(key));
+    return hash ? hash : 1;
+}
+
+struct RecordHeader {
+    std::uint64_t keySize;
+    std::uint64_t valueSize;
+};
+
+std::size_t recordSize(std::size_t keySize, std::size_t valueSize)
+{
+    const auto size(sizeof(RecordHeader) + keySize + valueSize);
+    return ((size + RecordAlignment - 1) / RecordAlignment)
+        * RecordAlignment;
+}
+
+std::string segmentName(const std::string &name)
+{
+    return "/mapproxy-" + name;
+}
+
+} // namespace
+
+struct SharedCache::Slot {
+    std::uint64_t hash;
+    std::uint64_t offset;
+    std::uint64_t size;
+    std::int64_t expires;
+};
+
+/** Holds the segment mutex. Evaluates to false when the mutex cannot be
+ *  acquired (i.e. it is unrecoverable), the cache then behaves as empty.
+ */
+class SharedCache::Guard {
+public:
+    Guard(SharedCache &cache)
+        : mutex_(&cache.header().mutex), locked_(false)
+    {
+        const auto res(::pthread_mutex_lock(mutex_));
+        if (res == EOWNERDEAD) {
+            // previous owner died in the middle of update
+            LOG(warn2) << "Shared cache owner died, starting over.";
+            cache.reset();
+            ++cache.resets_;
+            ::pthread_mutex_consistent(mutex_);
+        } else if (res) {
+            LOG(warn1) << "Unable to lock shared cache: <"
+                       << std::strerror(res) << ">.";
+            return;
+        }
+        locked_ = true;
+    }
+
+    ~Guard() { if (locked_) { ::pthread_mutex_unlock(mutex_); } }
+
+    explicit operator bool() const { return locked_; }
+
+    Guard(const Guard&) = delete;
+    Guard& operator=(const Guard&) = delete;
+
+private:
+    pthread_mutex_t *mutex_;
+    bool locked_;
+};
+
+SharedCache::SharedCache(const Options &options)
+    : options_(options), base_(), mappedSize_()
+    , hits_(0), misses_(0), stored_(0), resets_(0)
+{
+    if (!options_.size) { return; }
+
+    const auto name(segmentName(options_.name));
+    const int fd(::shm_open(name.c_str(), O_RDWR | O_CREAT | O_CLOEXEC
+                            , 0600));
+    if (fd < 0) {
+        std::system_error e(errno, std::system_category());
+        LOG(err2) << "Unable to open shared cache segment " << name
+                  << ": <" << e.what() << ">.";
+        throw e;
+    }
+
+    try {
+        open(fd);
+    } catch (...) {
+        ::close(fd);
+        throw;
+    }
+    // mapping keeps the segment
+    ::close(fd);
+}
+
+SharedCache::~SharedCache()
+{
+    if (base_) { ::munmap(base_, mappedSize_); }
+}
+
+SharedCache::Header& SharedCache::header() const
+{
+    return *static_cast<Header*>(base_);
+}
+
+SharedCache::Slot* SharedCache::slots() const
+{
+    return reinterpret_cast<Slot*>(static_cast<char*>(base_)
+                                   + sizeof(Header));
+}
+
+char* SharedCache::data() const
+{
+    return (reinterpret_cast<char*>(slots())
+            + header().slotCount * sizeof(Slot));
+}
+
+void SharedCache::open(int fd)
+{
+    const auto name(segmentName(options_.name));
+
+    // creation and formatting is serialized among processes by file lock
+    while (::flock(fd, LOCK_EX) == -1) {
+        if (errno == EINTR) { continue; }
+        std::system_error e(errno, std::system_category());
+        LOG(err2) << "Unable to lock shared cache segment " << name
+                  << ": <" << e.what() << ">.";
+        throw e;
+    }
+
+    struct ::stat st;
+    if (::fstat(fd, &st) == -1) {
+        std::system_error e(errno, std::system_category());
+        LOG(err2) << "Unable to stat shared cache segment " << name
+                  << ": <" << e.what() << ">.";
+        throw e;
+    }
+
+    // one slot per 16 KB of data (i.e. typical tile size)
+    const std::uint64_t slotCount
+        (std::max<std::uint64_t>(options_.size << 6, 1024));
+    const std::uint64_t dataLimit(std::uint64_t(options_.size) << 20);
+
+    const bool fresh(!st.st_size);
+    if (fresh) {
+        mappedSize_ = sizeof(Header) + slotCount * sizeof(Slot) + dataLimit;
+        if (::ftruncate(fd, mappedSize_) == -1) {
+            std::system_error e(errno, std::system_category());
+            LOG(err2) << "Unable to size shared cache segment " << name
+                      << ": <" << e.what() << ">.";
+            throw e;
+        }
+    } else {
+        mappedSize_ = st.st_size;
+    }
+
+    auto *base(::mmap(nullptr, mappedSize_, PROT_READ | PROT_WRITE
+                      , MAP_SHARED, fd, 0));
+    if (base == MAP_FAILED) {
+        std::system_error e(errno, std::system_category());
+        LOG(err2) << "Unable to map shared cache segment " << name
+                  << ": <" << e.what() << ">.";
+        throw e;
+    }
+    base_ = base;
+
+    if (fresh) {
+        format();
+        LOG(info3) << "Created shared cache segment " << name << " ("
+                   << options_.size << " MB).";
+    } else {
+        const auto &h(header());
+        if ((mappedSize_ < sizeof(Header))
+            || std::memcmp(h.magic, SegmentMagic, sizeof(SegmentMagic))
+            || (h.version != SegmentVersion)
+            || (mappedSize_ != (sizeof(Header) + h.slotCount * sizeof(Slot)
+                                + h.dataLimit)))
+        {
+            // other instances may still use it, keep it as is
+            LOG(warn3) << "Shared cache segment " << name
+                       << " is incompatible, shared cache disabled; remove "
+                       "/dev/shm" << name << " to start over.";
+            ::munmap(base_, mappedSize_);
+            base_ = nullptr;
+        } else {
+            if (h.dataLimit != dataLimit) {
+                LOG(info3) << "Shared cache segment " << name
+                           << " has different size, using its "
+                           << (h.dataLimit >> 20) << " MB.";
+            }
+            LOG(info3) << "Using shared cache segment " << name << " ("
+                       << (h.dataSize >> 20) << " MB used).";
+        }
+    }
+
+    ::flock(fd, LOCK_UN);
+}
+
+void SharedCache::format()
+{
+    auto &h(header());
+
+    pthread_mutexattr_t attr;
+    ::pthread_mutexattr_init(&attr);
+    ::pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    ::pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+    ::pthread_mutex_init(&h.mutex, &attr);
+    ::pthread_mutexattr_destroy(&attr);
+
+    h.version = SegmentVersion;
+    h.slotCount = std::max<std::uint64_t>(options_.size << 6, 1024);
+    h.dataLimit = std::uint64_t(options_.size) << 20;
+    reset();
+
+    // magic goes last, half-formatted segment is incompatible
+    std::memcpy(h.magic, SegmentMagic, sizeof(SegmentMagic));
+}
+
+void SharedCache::reset()
+{
+    std::memset(slots(), 0, header().slotCount * sizeof(Slot));
+    header().dataSize = 0;
+}
+
+bool SharedCache::get(const std::string &key, std::string &value
+                      , std::time_t *expires)
+{
+    if (!enabled()) { return false; }
+
+    const auto hash(keyHash(key));
+    const auto now(std::time(nullptr));
+
+    Guard guard(*this);
+    if (!guard) {
+        ++misses_;
+        return false;
+    }
+
+    const auto &h(header());
+    const auto *s(slots());
+    for (std::size_t i(0); i < MaxProbe; ++i) {
+        const auto &slot(s[(hash + i) % h.slotCount]);
+        if (!slot.hash) { break; }
+        if (slot.hash != hash) { continue; }
+
+        if ((slot.expires <= now) || (slot.offset + slot.size > h.dataSize)
+            || (slot.size < sizeof(RecordHeader)))
+        {
+            break;
+        }
+
+        const auto *record(data() + slot.offset);
+        RecordHeader rh;
+        std::memcpy(&rh, record, sizeof(rh));
+        if ((rh.keySize != key.size())
+            || (recordSize(rh.keySize, rh.valueSize) != slot.size)
+            || std::memcmp(record + sizeof(rh), key.data(), key.size()))
+        {
+            // hash collision
+            break;
+        }
+
+        value.assign(record + sizeof(rh) + rh.keySize, rh.valueSize);
+        if (expires) { *expires = slot.expires; }
+        ++hits_;
+        return true;
+    }
+
+    ++misses_;
+    return false;
+}
+
+void SharedCache::put(const std::string &key, const void *value
+                      , std::size_t size, std::time_t expires)
+{
+    if (!enabled() || (expires <= std::time(nullptr))) { return; }
+
+    const auto hash(keyHash(key));
+    const auto rsize(recordSize(key.size(), size));
+
+    Guard guard(*this);
+    if (!guard) { return; }
+
+    auto &h(header());
+    if (rsize > (h.dataLimit / 4)) { return; }
+
+    if ((h.dataSize + rsize) > h.dataLimit) {
+        LOG(info2) << "Shared cache is full, starting over.";
+        reset();
+        ++resets_;
+    }
+
+    const auto offset(h.dataSize);
+    auto *record(data() + offset);
+    const RecordHeader rh{ key.size(), size };
+    std::memcpy(record, &rh, sizeof(rh));
+    std::memcpy(record + sizeof(rh), key.data(), key.size());
+    std::memcpy(record + sizeof(rh) + key.size(), value, size);
+
+    // pick first free, same or expired slot; fall back to home slot
+    const auto now(std::time(nullptr));
+    auto *s(slots());
+    auto *target(&s[hash % h.slotCount]);
+    for (std::size_t i(0); i < MaxProbe; ++i) {
+        auto &slot(s[(hash + i) % h.slotCount]);
+        if (!slot.hash || (slot.hash == hash) || (slot.expires <= now)) {
+            target = &slot;
+            break;
+        }
+    }
+
+    target->hash = hash;
+    target->offset = offset;
+    target->size = rsize;
+    target->expires = expires;
+    h.dataSize = offset + rsize;
+    ++stored_;
+}
+
+void SharedCache::stat(std::ostream &os, const std::string &prefix) const
+{
+    std::uint64_t used(0);
+    if (enabled()) {
+        Guard guard(const_cast<SharedCache&>(*this));
+        if (guard) { used = header().dataSize; }
+    }
+
+    os << prefix << "hits=" << hits_ << '\n'
+       << prefix << "misses=" << misses_ << '\n'
+       << prefix << "stored=" << stored_ << '\n'
+       << prefix << "resets=" << resets_ << '\n'
+       << prefix << "size=" << used << '\n';
+}
+
+void SharedCache::metrics(metrics::Writer &writer
+                          , const std::string &prefix) const
+{
+    writer.counter(prefix + "hits", "Entries found in shared cache."
+                   , hits_);
+    writer.counter(prefix + "misses", "Entries not found in shared cache."
+                   , misses_);
+    writer.counter(prefix + "stored", "Entries written to shared cache."
+                   , stored_);
+    writer.counter(prefix + "resets", "Shared cache resets (by this process)."
+                   , resets_);
+}
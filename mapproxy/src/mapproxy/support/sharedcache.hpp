@@ -0,0 +1,132 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef mapproxy_support_sharedcache_hpp_included_
+#define mapproxy_support_sharedcache_hpp_included_
+
+#include <pthread.h>
+
+#include <ctime>
+#include <atomic>
+#include <string>
+#include <cstdint>
+#include <ostream>
+
+#include "metrics.hpp"
+
+/** Host-wide cache in a named POSIX shared memory segment, shared by all
+ *  mapproxy instances (and their GDAL warpers) on one host that are
+ *  configured with the same segment name.
+ *
+ *  Values are opaque byte strings keyed by strings; layout follows the disk
+ *  cache: values are appended to a data area, an open-addressing hash table
+ *  maps key hashes to records. Records carry their keys, hash collisions are
+ *  detected on read. Once the data area is full the whole cache starts over.
+ *
+ *  Access is guarded by a single robust process-shared mutex held only for
+ *  copying in or out; a process dying while holding it makes the next owner
+ *  drop the (possibly torn) content.
+ *
+ *  First process creates and formats the segment; later processes use its
+ *  geometry even if configured with a different size. The segment outlives
+ *  the processes (it is never unlinked), i.e. the cache survives restarts.
+ */
+class SharedCache {
+public:
+    struct Options {
+        /** Segment name, the segment is /dev/shm/mapproxy-<name>.
+         */
+        std::string name;
+
+        /** Size of the data area (in MB, 0 = cache disabled).
+         */
+        std::size_t size;
+
+        Options() : name("default"), size(0) {}
+    };
+
+    SharedCache(const Options &options);
+    ~SharedCache();
+
+    SharedCache(const SharedCache&) = delete;
+    SharedCache& operator=(const SharedCache&) = delete;
+
+    bool enabled() const { return base_ != nullptr; }
+
+    /** Copies unexpired value into value. Returns false if not found. If
+     *  expires is given it receives expiration time of the record.
+     */
+    bool get(const std::string &key, std::string &value
+             , std::time_t *expires = nullptr);
+
+    /** Stores value. Values expiring in the past or bigger than quarter of
+     *  the data area are not stored.
+     */
+    void put(const std::string &key, const void *value, std::size_t size
+             , std::time_t expires);
+
+    void stat(std::ostream &os, const std::string &prefix) const;
+
+    /** Writes lock-free counters, metric names start with given prefix.
+     */
+    void metrics(metrics::Writer &writer, const std::string &prefix) const;
+
+    /** Segment header, at the very start of the segment; followed by slot
+     *  table and data area.
+     */
+    struct Header {
+        char magic[4];
+        std::uint32_t version;
+        std::uint64_t slotCount;
+        std::uint64_t dataLimit;
+        std::uint64_t dataSize;
+        pthread_mutex_t mutex;
+    };
+
+    struct Slot;
+
+private:
+    class Guard;
+
+    void open(int fd);
+    void format();
+    void reset();
+
+    Header& header() const;
+    Slot* slots() const;
+    char* data() const;
+
+    Options options_;
+    void *base_;
+    std::size_t mappedSize_;
+
+    std::atomic<std::uint64_t> hits_;
+    std::atomic<std::uint64_t> misses_;
+    std::atomic<std::uint64_t> stored_;
+    std::atomic<std::uint64_t> resets_;
+};
+
+#endif // mapproxy_support_sharedcache_hpp_included_
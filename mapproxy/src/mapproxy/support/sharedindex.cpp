@@ -0,0 +1,190 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <sys/stat.h>
+
+#include <map>
+#include <mutex>
+#include <cerrno>
+#include <system_error>
+#include <tuple>
+#include <sstream>
+
+#include <boost/filesystem.hpp>
+#include <boost/format.hpp>
+
+#include "dbglog/dbglog.hpp"
+
+#include "utility/path.hpp"
+
+#include "hash.hpp"
+#include "sharedindex.hpp"
+
+namespace fs = boost::filesystem;
+
+namespace sharedindex {
+
+namespace {
+
+void fileStamp(std::ostream &os, const fs::path &path)
+{
+    os << fs::absolute(path).string() << '@' << fs::last_write_time(path);
+}
+
+/** Removes shared files linked nowhere else.
+ */
+void cleanup(const fs::path &dir)
+{
+    boost::system::error_code ec;
+    for (fs::directory_iterator idir(dir, ec), edir; !ec && (idir != edir);
+         idir.increment(ec))
+    {
+        const auto &path(idir->path());
+        if (path.extension() != ".index") { continue; }
+        if (fs::hard_link_count(path, ec) == 1) {
+            LOG(info1) << "Removing unused shared tile index " << path << ".";
+            fs::remove(path, ec);
+        }
+    }
+}
+
+class Registry {
+public:
+    std::shared_ptr<const mmapped::TileIndex>
+    open(const fs::path &path, vts::Lod denseLods
+         , const mmapped::MapPolicy &policy);
+
+private:
+    typedef std::tuple<dev_t, ino_t, std::time_t, vts::Lod> Key;
+
+    std::mutex mutex_;
+    std::map<Key, std::weak_ptr<const mmapped::TileIndex>> indices_;
+};
+
+std::shared_ptr<const mmapped::TileIndex>
+Registry::open(const fs::path &path, vts::Lod denseLods
+               , const mmapped::MapPolicy &policy)
+{
+    struct ::stat st;
+    if (::stat(path.c_str(), &st) == -1) {
+        std::system_error e(errno, std::system_category());
+        LOG(err2) << "Cannot stat tile index " << path << ": <" << e.code()
+                  << ", " << e.what() << ">.";
+        throw e;
+    }
+
+    const Key key(st.st_dev, st.st_ino, st.st_mtime, denseLods);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto &slot(indices_[key]);
+    if (auto index = slot.lock()) { return index; }
+
+    for (auto iindices(indices_.begin()); iindices != indices_.end(); ) {
+        if (iindices->second.expired() && (&iindices->second != &slot)) {
+            iindices = indices_.erase(iindices);
+        } else {
+            ++iindices;
+        }
+    }
+
+    auto index(std::make_shared<const mmapped::TileIndex>
+               (path, denseLods, policy));
+    slot = index;
+    return index;
+}
+
+Registry registry;
+
+/** Serializes preparation: shared files are built, linked and cleaned up
+ *  by one preparing generator at a time.
+ */
+std::mutex prepareMutex;
+
+} // namespace
+
+fs::path directory(const fs::path &root)
+{
+    return root / ".shared" / "tileindex";
+}
+
+std::string key(const Resource &resource
+                , const boost::optional<fs::path> &tilesPath
+                , bool navtiles, const boost::optional<fs::path> &mask)
+{
+    std::ostringstream os;
+    os << "v" << mmapped::QTree::formatVersion
+       << ':' << resource.id.referenceFrame
+       << ':' << resource.lodRange << ':' << resource.tileRange
+       << ':' << navtiles << ':';
+    if (tilesPath) { fileStamp(os, *tilesPath); }
+    os << ':';
+    if (mask) { fileStamp(os, *mask); }
+
+    return str(boost::format("%016x") % stableHash(os.str()));
+}
+
+void prepare(const fs::path &dir, const std::string &key
+             , const Build &build, const fs::path &dst)
+{
+    std::lock_guard<std::mutex> lock(prepareMutex);
+
+    fs::create_directories(dir);
+    const auto shared(dir / (key + ".index"));
+
+    if (!fs::exists(shared)) {
+        vts::TileIndex index;
+        build(index);
+
+        const auto tmpPath(utility::addExtension(shared, ".tmp"));
+        mmapped::TileIndex::write(tmpPath, index);
+        fs::rename(tmpPath, shared);
+    } else {
+        LOG(info2) << "Using shared tile index " << shared << ".";
+    }
+
+    // link (or copy) next to destination and move into place
+    const auto tmpPath(utility::addExtension(dst, ".tmp"));
+    boost::system::error_code ec;
+    fs::remove(tmpPath, ec);
+    fs::create_hard_link(shared, tmpPath, ec);
+    if (ec) {
+        LOG(warn2) << "Cannot link shared tile index " << shared << " to "
+                   << dst << " (" << ec.message() << "), copying.";
+        fs::copy_file(shared, tmpPath);
+    }
+    fs::rename(tmpPath, dst);
+
+    cleanup(dir);
+}
+
+std::shared_ptr<const mmapped::TileIndex>
+open(const fs::path &path, vts::Lod denseLods
+     , const mmapped::MapPolicy &policy)
+{
+    return registry.open(path, denseLods, policy);
+}
+
+} // namespace sharedindex
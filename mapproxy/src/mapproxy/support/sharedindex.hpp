@@ -0,0 +1,83 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef mapproxy_support_sharedindex_hpp_included_
+#define mapproxy_support_sharedindex_hpp_included_
+
+#include <memory>
+#include <string>
+#include <functional>
+
+#include <boost/optional.hpp>
+#include <boost/filesystem/path.hpp>
+
+#include "vts-libs/vts/tileindex.hpp"
+
+#include "../resource.hpp"
+#include "mmapped/tileindex.hpp"
+
+/** Delivery indices shared between resources built from the same inputs,
+ *  e.g. several gdaldem or derived raster layers over one DEM.
+ *
+ *  Index is built once into a shared directory under a key derived from
+ *  its inputs and hard-linked as the resource's delivery index. Opened
+ *  indices are shared by inode, i.e. all resources linking the same file
+ *  use single mapping (and single set of dense arrays).
+ */
+namespace sharedindex {
+
+/** Directory of shared indices in given store root.
+ */
+boost::filesystem::path directory(const boost::filesystem::path &root);
+
+/** Key of index built by prepareTileIndex for given resource from given
+ *  tiling (if any) and mask (if any). Covers reference frame, lod and tile
+ *  ranges and paths and modification times of the files.
+ */
+std::string key(const Resource &resource
+                , const boost::optional<boost::filesystem::path> &tilesPath
+                , bool navtiles = false
+                , const boost::optional<boost::filesystem::path> &mask
+                = boost::none);
+
+typedef std::function<void(vts::TileIndex&)> Build;
+
+/** Makes delivery index of given key available at dst: built by build()
+ *  into dir unless already there, then hard-linked to dst (copied if
+ *  linking fails). Shared files no longer linked anywhere are removed.
+ */
+void prepare(const boost::filesystem::path &dir, const std::string &key
+             , const Build &build, const boost::filesystem::path &dst);
+
+/** Opens delivery index, shared with other users of the same file.
+ */
+std::shared_ptr<const mmapped::TileIndex>
+open(const boost::filesystem::path &path, vts::Lod denseLods = 0
+     , const mmapped::MapPolicy &policy = mmapped::MapPolicy());
+
+} // namespace sharedindex
+
+#endif // mapproxy_support_sharedindex_hpp_included_
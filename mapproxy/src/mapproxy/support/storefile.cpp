@@ -0,0 +1,126 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <fstream>
+
+#include <boost/noncopyable.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include "dbglog/dbglog.hpp"
+
+#include "utility/path.hpp"
+#include "utility/gzipper.hpp"
+
+#include "storefile.hpp"
+
+namespace fs = boost::filesystem;
+namespace bi = boost::interprocess;
+
+/** Read-only mapping of whole file.
+ */
+struct StoreFile::Mapping : boost::noncopyable {
+    Mapping(const fs::path &path)
+        : size(fs::file_size(path))
+    {
+        // empty file cannot be mapped
+        if (!size) { return; }
+        bi::file_mapping file(path.c_str(), bi::read_only);
+        bi::mapped_region(file, bi::read_only).swap(region);
+    }
+
+    const char* data() const {
+        return static_cast<const char*>(region.get_address());
+    }
+
+    std::size_t size;
+    bi::mapped_region region;
+};
+
+namespace {
+
+void writeFile(const fs::path &path, const char *data, std::size_t size
+               , bool gzip)
+{
+    const auto tmpPath(fs::unique_path(path.string() + ".%%%%%%%%.tmp"));
+
+    std::ofstream f;
+    f.exceptions(std::ios::badbit | std::ios::failbit);
+    f.open(tmpPath.string(), std::ios_base::out | std::ios_base::trunc
+           | std::ios_base::binary);
+    if (gzip) {
+        utility::Gzipper gzipper(f);
+        std::ostream &os(gzipper);
+        os.write(data, size);
+    } else {
+        f.write(data, size);
+    }
+    f.close();
+
+    fs::rename(tmpPath, path);
+}
+
+} // namespace
+
+StoreFile::StoreFile(const fs::path &path)
+    : plain_(std::make_shared<Mapping>(path))
+    , gzipped_(std::make_shared<Mapping>(gzPath(path)))
+{}
+
+void StoreFile::send(Sink &sink, const Sink::FileInfo &stat
+                     , bool acceptGzip) const
+{
+    auto sfi(stat);
+    sfi.addHeader("Vary", "Accept-Encoding");
+    if (acceptGzip) {
+        sfi.addHeader("Content-Encoding", "gzip");
+        sink.content(gzipped_->data(), gzipped_->size, sfi, gzipped_);
+    } else {
+        sink.content(plain_->data(), plain_->size, sfi, plain_);
+    }
+}
+
+fs::path StoreFile::gzPath(const fs::path &path)
+{
+    return utility::addExtension(path, ".gz");
+}
+
+void StoreFile::write(const fs::path &path, const char *data
+                      , std::size_t size)
+{
+    writeFile(gzPath(path), data, size, true);
+    writeFile(path, data, size, false);
+}
+
+void StoreFile::ensureGzipped(const fs::path &path)
+{
+    if (fs::exists(gzPath(path))) { return; }
+
+    LOG(info1) << "Creating gzipped copy of " << path << ".";
+    Mapping plain(path);
+    writeFile(gzPath(path), plain.data(), plain.size, true);
+}
@@ -0,0 +1,76 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef mapproxy_support_storefile_hpp_included_
+#define mapproxy_support_storefile_hpp_included_
+
+#include <memory>
+
+#include <boost/filesystem/path.hpp>
+
+#include "../sink.hpp"
+
+/** Output materialized in the resource store: plain data and their gzipped
+ *  copy (<path>.gz). Both are mapped into memory and sent to clients without
+ *  copying. Cheap to copy, mappings are shared.
+ */
+class StoreFile {
+public:
+    StoreFile() = default;
+
+    /** Maps existing store file and its gzipped copy.
+     */
+    explicit StoreFile(const boost::filesystem::path &path);
+
+    /** Sends plain or gzipped data to the client.
+     *  \param sink sink to send to
+     *  \param stat file info (size is ignored)
+     *  \param acceptGzip client accepts gzipped content
+     */
+    void send(Sink &sink, const Sink::FileInfo &stat, bool acceptGzip) const;
+
+    /** Stores data and their gzipped copy. Plain file is written last, i.e.
+     *  its existence implies existence of the gzipped copy.
+     */
+    static void write(const boost::filesystem::path &path
+                      , const char *data, std::size_t size);
+
+    /** Creates missing gzipped copy of existing plain file.
+     */
+    static void ensureGzipped(const boost::filesystem::path &path);
+
+    /** Path to gzipped copy.
+     */
+    static boost::filesystem::path gzPath(const boost::filesystem::path &path);
+
+private:
+    struct Mapping;
+
+    std::shared_ptr<const Mapping> plain_;
+    std::shared_ptr<const Mapping> gzipped_;
+};
+
+#endif // mapproxy_support_storefile_hpp_included_
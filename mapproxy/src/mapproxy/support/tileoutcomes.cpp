@@ -0,0 +1,213 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#include <boost/filesystem.hpp>
+
+#include "dbglog/dbglog.hpp"
+
+#include "tileoutcomes.hpp"
+
+namespace fs = boost::filesystem;
+
+namespace {
+
+const char LogMagic[4] = { 'M', 'P', 'T', 'O' };
+const std::uint32_t LogVersion(1);
+
+struct LogHeader {
+    char magic[4];
+    std::uint32_t version;
+    std::uint32_t tagSize;
+};
+
+struct LogRecord {
+    std::uint64_t tile;
+    std::uint32_t outcomes;
+    std::uint32_t reserved;
+};
+
+/** Deepest lod that fits into packed tile id.
+ */
+const vts::Lod MaxLod(29);
+
+/** Packs tile id into single number: 5 bits of lod and 29 bits of x and y.
+ */
+inline std::uint64_t pack(const vts::TileId &tileId)
+{
+    return ((std::uint64_t(tileId.lod) << 58)
+            | (std::uint64_t(tileId.x) << 29)
+            | std::uint64_t(tileId.y));
+}
+
+bool writeAll(int fd, const std::string &data)
+{
+    const auto *p(data.data());
+    auto size(data.size());
+    while (size) {
+        const auto written(::write(fd, p, size));
+        if (written < 0) {
+            if (errno == EINTR) { continue; }
+            return false;
+        }
+        p += written;
+        size -= written;
+    }
+    return true;
+}
+
+} // namespace
+
+TileOutcomes::TileOutcomes(const fs::path &path, const std::string &tag
+                           , std::size_t limit)
+    : path_(path), limit_(limit), fd_(-1)
+{
+    open(tag);
+}
+
+TileOutcomes::~TileOutcomes()
+{
+    if (fd_ >= 0) { ::close(fd_); }
+}
+
+void TileOutcomes::open(const std::string &tag)
+{
+    // load existing log
+    std::string data;
+    {
+        std::ifstream f(path_.string(), std::ios_base::binary);
+        data.assign(std::istreambuf_iterator<char>(f)
+                    , std::istreambuf_iterator<char>());
+    }
+
+    LogHeader header;
+    bool valid((data.size() >= sizeof(header)));
+    if (valid) {
+        std::memcpy(&header, data.data(), sizeof(header));
+        valid = (!std::memcmp(header.magic, LogMagic, sizeof(LogMagic))
+                 && (header.version == LogVersion)
+                 && (data.size() >= (sizeof(header) + header.tagSize))
+                 && !data.compare(sizeof(header), header.tagSize, tag));
+    }
+
+    fd_ = ::open(path_.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC
+                 , 0644);
+    if (fd_ < 0) {
+        LOG(warn2) << "Unable to open tile outcome log " << path_ << ": <"
+                   << std::strerror(errno) << ">; outcomes are not "
+                   "persisted.";
+        return;
+    }
+
+    if (valid) {
+        // torn record at the end (if any) is ignored
+        const auto end(data.size());
+        std::size_t pos(sizeof(header) + header.tagSize);
+        for (; (pos + sizeof(LogRecord)) <= end; pos += sizeof(LogRecord)) {
+            if (tiles_.size() >= limit_) { break; }
+            LogRecord record;
+            std::memcpy(&record, data.data() + pos, sizeof(record));
+            tiles_[record.tile] |= record.outcomes;
+        }
+
+        if (pos == end) {
+            LOG(info1) << "Loaded " << tiles_.size()
+                       << " tile outcomes from " << path_ << ".";
+            return;
+        }
+
+        // drop torn or unloaded tail
+        if (::ftruncate(fd_, pos) == 0) { return; }
+    }
+
+    // start from scratch
+    tiles_.clear();
+    std::memcpy(header.magic, LogMagic, sizeof(LogMagic));
+    header.version = LogVersion;
+    header.tagSize = tag.size();
+
+    std::string out(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.append(tag);
+    if ((::ftruncate(fd_, 0) == -1) || !writeAll(fd_, out)) {
+        LOG(warn2) << "Unable to initialize tile outcome log " << path_
+                   << ": <" << std::strerror(errno) << ">; outcomes are "
+                   "not persisted.";
+        ::close(fd_);
+        fd_ = -1;
+    }
+}
+
+bool TileOutcomes::has(const vts::TileId &tileId, Outcome outcome) const
+{
+    if (tileId.lod > MaxLod) { return false; }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto ftiles(tiles_.find(pack(tileId)));
+    return (ftiles != tiles_.end()) && (ftiles->second & outcome);
+}
+
+void TileOutcomes::put(const vts::TileId &tileId, Outcome outcome)
+{
+    if (tileId.lod > MaxLod) { return; }
+
+    const auto tile(pack(tileId));
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto ftiles(tiles_.find(tile));
+    if (ftiles == tiles_.end()) {
+        if (tiles_.size() >= limit_) { return; }
+        ftiles = tiles_.insert(std::make_pair(tile, 0u)).first;
+    } else if (ftiles->second & outcome) {
+        return;
+    }
+    ftiles->second |= outcome;
+
+    if (fd_ < 0) { return; }
+
+    const LogRecord record{ tile, outcome, 0 };
+    if (!writeAll(fd_, std::string(reinterpret_cast<const char*>(&record)
+                                   , sizeof(record))))
+    {
+        LOG(warn2) << "Unable to write to tile outcome log " << path_
+                   << ": <" << std::strerror(errno) << ">; outcomes are "
+                   "no longer persisted.";
+        ::close(fd_);
+        fd_ = -1;
+    }
+}
+
+std::size_t TileOutcomes::size() const
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    return tiles_.size();
+}
@@ -0,0 +1,86 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef mapproxy_support_tileoutcomes_hpp_included_
+#define mapproxy_support_tileoutcomes_hpp_included_
+
+#include <mutex>
+#include <memory>
+#include <string>
+#include <cstdint>
+#include <unordered_map>
+
+#include <boost/noncopyable.hpp>
+#include <boost/filesystem/path.hpp>
+
+#include "vts-libs/vts/basetypes.hpp"
+
+/** Outcomes of tile generation learned at runtime: tiles found to have no
+ *  valid data or to be fully valid, so that they can be answered without
+ *  warping next time.
+ *
+ *  Outcomes are kept in memory and appended to a log file in resource's
+ *  store directory. The log is bound to a tag (resource revision and
+ *  definition); on mismatch it starts from scratch. Bounded; outcomes over
+ *  the limit are not recorded. Thread safe.
+ */
+class TileOutcomes : boost::noncopyable {
+public:
+    typedef std::shared_ptr<TileOutcomes> pointer;
+
+    enum Outcome : std::uint32_t {
+        emptyImage = 0x1
+        , emptyMask = 0x2
+        , fullMask = 0x4
+    };
+
+    /** Opens (or creates) log at given path. Failures are only logged, the
+     *  outcomes are then kept in memory only.
+     */
+    TileOutcomes(const boost::filesystem::path &path, const std::string &tag
+                 , std::size_t limit = 1 << 22);
+    ~TileOutcomes();
+
+    bool has(const vts::TileId &tileId, Outcome outcome) const;
+
+    void put(const vts::TileId &tileId, Outcome outcome);
+
+    /** Number of tiles with known outcome.
+     */
+    std::size_t size() const;
+
+private:
+    void open(const std::string &tag);
+
+    const boost::filesystem::path path_;
+    const std::size_t limit_;
+
+    mutable std::mutex mutex_;
+    std::unordered_map<std::uint64_t, std::uint32_t> tiles_;
+    int fd_;
+};
+
+#endif // mapproxy_support_tileoutcomes_hpp_included_
@@ -0,0 +1,109 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <atomic>
+#include <sstream>
+#include <iomanip>
+
+#include "dbglog/dbglog.hpp"
+
+#include "profiler.hpp"
+#include "trace.hpp"
+
+std::uint64_t Trace::nextId()
+{
+    // seeded by startup time (in usec)
+    static std::atomic<std::uint64_t> counter
+        (std::chrono::duration_cast<std::chrono::microseconds>
+         (std::chrono::system_clock::now().time_since_epoch()).count());
+    return ++counter;
+}
+
+void Trace::record(const std::string &stage, std::uint64_t usec)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (auto &s : stages_) {
+        if (s.name == stage) {
+            s.usec += usec;
+            ++s.count;
+            return;
+        }
+    }
+    stages_.push_back({ stage, usec, 1 });
+}
+
+Trace::Scope::~Scope()
+{
+    if (!trace_) { return; }
+    trace_->record(stage_, std::chrono::duration_cast
+                   <std::chrono::microseconds>
+                   (Clock::now() - start_).count());
+}
+
+std::uint64_t Trace::elapsed() const
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>
+        (Clock::now() - start_).count();
+}
+
+std::string Trace::serverTiming() const
+{
+    std::ostringstream os;
+    os << std::fixed << std::setprecision(3);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (const auto &s : stages_) {
+        os << s.name << ";dur=" << (s.usec / 1000.0);
+        if (s.count > 1) { os << ";desc=\"" << s.count << "x\""; }
+        os << ", ";
+    }
+    os << "total;dur=" << (elapsed() / 1000.0);
+    return os.str();
+}
+
+void Trace::finish()
+{
+    const auto total(elapsed());
+
+    std::ostringstream os;
+    os << std::fixed << std::setprecision(3);
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (finished_) { return; }
+        finished_ = true;
+
+        if (!slowThreshold_ || (total < slowThreshold_ * 1000UL)) { return; }
+
+        for (const auto &s : stages_) {
+            os << ", " << s.name << ": " << (s.usec / 1000.0) << " ms";
+            if (s.count > 1) { os << " (" << s.count << "x)"; }
+        }
+    }
+
+    LOG(info3) << "Slow request <" << url_ << "> [trace "
+               << profiler::formatTraceId(id_) << "]: " << (total / 1000.0)
+               << " ms total" << os.str() << ".";
+}
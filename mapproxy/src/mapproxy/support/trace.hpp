@@ -0,0 +1,120 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef mapproxy_support_trace_hpp_included_
+#define mapproxy_support_trace_hpp_included_
+
+#include <mutex>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+/** Per-request trace of processing stages (parse, lookup, queue wait, GDAL
+ *  stages, encoding, ...). Repeated stages are summed up. Thread safe.
+ */
+class Trace {
+public:
+    typedef std::shared_ptr<Trace> pointer;
+    typedef std::chrono::steady_clock Clock;
+
+    /** \param url request URL (for logging)
+     *  \param reply send breakdown back in Server-Timing header
+     *  \param slowThreshold log requests slower than this (in ms, 0 = never)
+     */
+    Trace(const std::string &url, bool reply, unsigned int slowThreshold)
+        : id_(nextId()), url_(url), reply_(reply)
+        , slowThreshold_(slowThreshold), start_(Clock::now())
+        , finished_(false)
+    {}
+
+    /** Trace ID, unique within this process and unlikely to repeat across
+     *  restarts. Used to correlate slow request log with stack samples.
+     */
+    std::uint64_t id() const { return id_; }
+
+    /** Records duration (in microseconds) of given stage.
+     */
+    void record(const std::string &stage, std::uint64_t usec);
+
+    /** Records time of given stage from construction to destruction.
+     */
+    class Scope {
+    public:
+        Scope(const pointer &trace, const std::string &stage)
+            : trace_(trace), stage_(stage), start_(Clock::now())
+        {}
+
+        Scope(Scope &&o)
+            : trace_(std::move(o.trace_)), stage_(std::move(o.stage_))
+            , start_(o.start_)
+        {}
+
+        ~Scope();
+
+    private:
+        pointer trace_;
+        std::string stage_;
+        Clock::time_point start_;
+    };
+
+    /** Should Server-Timing be sent back?
+     */
+    bool reply() const { return reply_; }
+
+    /** Server-Timing header value (durations in milliseconds).
+     */
+    std::string serverTiming() const;
+
+    /** Marks request as finished: logs it if slow. Any subsequent call is
+     *  no-op.
+     */
+    void finish();
+
+private:
+    struct Stage {
+        std::string name;
+        std::uint64_t usec;
+        unsigned int count;
+    };
+
+    std::uint64_t elapsed() const;
+
+    static std::uint64_t nextId();
+
+    const std::uint64_t id_;
+    const std::string url_;
+    const bool reply_;
+    const unsigned int slowThreshold_;
+    const Clock::time_point start_;
+
+    mutable std::mutex mutex_;
+    std::vector<Stage> stages_;
+    bool finished_;
+};
+
+#endif // mapproxy_support_trace_hpp_included_
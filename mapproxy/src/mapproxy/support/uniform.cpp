@@ -0,0 +1,96 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cstring>
+
+#include "uniform.hpp"
+
+bool isUniform(const cv::Mat &image)
+{
+    if (image.empty()) { return false; }
+
+    const auto pixelSize(image.elemSize());
+    const auto rowSize(image.cols * pixelSize);
+    const auto *first(image.ptr<unsigned char>(0));
+
+    // first row: every pixel equals the first one
+    for (int x(1); x < image.cols; ++x) {
+        if (std::memcmp(first, first + x * pixelSize, pixelSize)) {
+            return false;
+        }
+    }
+
+    // other rows: equal to the first one
+    for (int y(1); y < image.rows; ++y) {
+        if (std::memcmp(first, image.ptr<unsigned char>(y), rowSize)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+UniformImage::UniformImage(const cv::Mat &image)
+    : rows(image.rows), cols(image.cols), type(image.type())
+    , color(cv::mean(image(cv::Rect(0, 0, 1, 1))))
+{}
+
+cv::Mat UniformImage::image() const
+{
+    return cv::Mat(rows, cols, type, color);
+}
+
+EncodedUniformCache::Data
+EncodedUniformCache::get(const std::string &key) const
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto fdata(data_.find(key));
+    if (fdata == data_.end()) { return {}; }
+    return fdata->second;
+}
+
+void EncodedUniformCache::put(const std::string &key, const Data &data)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (data_.size() >= limit_) { data_.clear(); }
+    data_[key] = data;
+}
+
+boost::optional<UniformImage>
+UniformTiles::get(const vts::TileId &tileId) const
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto ftiles(tiles_.find(tileId));
+    if (ftiles == tiles_.end()) { return boost::none; }
+    return ftiles->second;
+}
+
+void UniformTiles::put(const vts::TileId &tileId, const UniformImage &image)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (tiles_.size() >= limit_) { tiles_.clear(); }
+    tiles_.insert(std::make_pair(tileId, image));
+}
@@ -0,0 +1,97 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef mapproxy_support_uniform_hpp_included_
+#define mapproxy_support_uniform_hpp_included_
+
+#include <map>
+#include <mutex>
+#include <memory>
+#include <string>
+
+#include <boost/optional.hpp>
+
+#include <opencv2/core/core.hpp>
+
+#include "vts-libs/vts/basetypes.hpp"
+
+/** Checks whether all pixels of given image have the same value. Rows are
+ *  compared using memcmp (vectorized by the C library).
+ */
+bool isUniform(const cv::Mat &image);
+
+/** Description of uniform image.
+ */
+struct UniformImage {
+    int rows;
+    int cols;
+    int type;
+    cv::Scalar color;
+
+    UniformImage(const cv::Mat &image);
+
+    /** Recreates the image.
+     */
+    cv::Mat image() const;
+};
+
+/** Small cache of encoded uniform images, keyed by image, format and encoder
+ *  settings. Thread safe.
+ */
+class EncodedUniformCache {
+public:
+    typedef std::shared_ptr<const std::string> Data;
+
+    EncodedUniformCache(std::size_t limit) : limit_(limit) {}
+
+    Data get(const std::string &key) const;
+
+    void put(const std::string &key, const Data &data);
+
+private:
+    const std::size_t limit_;
+    mutable std::mutex mutex_;
+    std::map<std::string, Data> data_;
+};
+
+/** Remembers tiles that turned out to be uniform so they can be recreated
+ *  without warping. Bounded; forgets everything when full. Thread safe.
+ */
+class UniformTiles {
+public:
+    UniformTiles(std::size_t limit) : limit_(limit) {}
+
+    boost::optional<UniformImage> get(const vts::TileId &tileId) const;
+
+    void put(const vts::TileId &tileId, const UniformImage &image);
+
+private:
+    const std::size_t limit_;
+    mutable std::mutex mutex_;
+    std::map<vts::TileId, UniformImage> tiles_;
+};
+
+#endif // mapproxy_support_uniform_hpp_included_
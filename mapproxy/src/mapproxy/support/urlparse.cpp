@@ -0,0 +1,163 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <limits>
+#include <vector>
+#include <utility>
+#include <charconv>
+
+#include <boost/lexical_cast.hpp>
+
+#include "utility/enum-io.hpp"
+
+#include "urlparse.hpp"
+
+namespace vts = vtslibs::vts;
+
+namespace urlparse {
+
+namespace {
+
+template <typename T>
+const char* parseNumber(const char *b, const char *e, T &value
+                        , char terminator)
+{
+    // digits only, no sign or whitespace
+    if ((b == e) || (*b < '0') || (*b > '9')) { return nullptr; }
+    const auto res(std::from_chars(b, e, value));
+    if ((res.ec != std::errc()) || (res.ptr == e)
+        || (*res.ptr != terminator))
+    {
+        return nullptr;
+    }
+    return res.ptr + 1;
+}
+
+template <typename T>
+using Table = std::vector<std::pair<std::string, T>>;
+
+template <typename T>
+bool find(const Table<T> &table, std::string_view name, T &value)
+{
+    for (const auto &item : table) {
+        if (item.first == name) {
+            value = item.second;
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+Components split(std::string_view path)
+{
+    Components c;
+    c.size = 0;
+
+    const auto push([&](std::string_view item)
+    {
+        if (c.size < Components::Max) { c.items[c.size] = item; }
+        ++c.size;
+    });
+
+    std::size_t start(0);
+    for (;;) {
+        const auto slash(path.find('/', start));
+        if (slash == std::string_view::npos) {
+            push(path.substr(start));
+            return c;
+        }
+
+        push(path.substr(start, slash - start));
+
+        // compress separator run
+        start = path.find_first_not_of('/', slash);
+        if (start == std::string_view::npos) {
+            push(std::string_view());
+            return c;
+        }
+    }
+}
+
+const char* parseTileIdPrefix(vts::TileId &tileId, std::string_view filename)
+{
+    const char *p(filename.data());
+    const char *e(p + filename.size());
+
+    unsigned int lod;
+    vts::TileId tmp;
+    if (!(p = parseNumber(p, e, lod, '-'))) { return nullptr; }
+    if (!(p = parseNumber(p, e, tmp.x, '-'))) { return nullptr; }
+    if (!(p = parseNumber(p, e, tmp.y, '.'))) { return nullptr; }
+    if (lod > std::numeric_limits<vts::Lod>::max()) { return nullptr; }
+
+    tmp.lod = lod;
+    tileId = tmp;
+    return p;
+}
+
+bool generatorInterface(std::string_view name, GeneratorInterface &value)
+{
+    static const auto table([]()
+    {
+        Table<GeneratorInterface> table;
+        for (auto type : enumerationValues(GeneratorInterface::Type())) {
+            const GeneratorInterface gi(type);
+            table.emplace_back(boost::lexical_cast<std::string>(gi), gi);
+        }
+
+        // special interfaces (see operator<<(GeneratorInterface))
+        for (const GeneratorInterface gi
+            : { GeneratorInterface(GeneratorInterface::Type::surface
+                                   , GeneratorInterface::Interface::terrain)
+                , GeneratorInterface(GeneratorInterface::Type::tms
+                                     , GeneratorInterface::Interface::wmts) })
+        {
+            table.emplace_back(boost::lexical_cast<std::string>(gi), gi);
+        }
+        return table;
+    }());
+
+    return find(table, name, value);
+}
+
+bool rasterFormat(std::string_view ext, RasterFormat &value)
+{
+    static const auto table([]()
+    {
+        Table<RasterFormat> table;
+        for (auto format : enumerationValues(RasterFormat())) {
+            table.emplace_back(boost::lexical_cast<std::string>(format)
+                               , format);
+        }
+        return table;
+    }());
+
+    return find(table, ext, value);
+}
+
+} // namespace urlparse
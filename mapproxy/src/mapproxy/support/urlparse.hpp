@@ -0,0 +1,92 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef mapproxy_support_urlparse_hpp_included_
+#define mapproxy_support_urlparse_hpp_included_
+
+#include <array>
+#include <string>
+#include <cstddef>
+#include <string_view>
+
+#include "vts-libs/vts/basetypes.hpp"
+
+#include "../resource.hpp"
+
+/** Allocation-free parsing of request paths and tile file names.
+ *
+ *  Replacement of per-request string splitting and lexical casts on the hot
+ *  path. Reference implementations (boost split, vts::parseTileIdPrefix,
+ *  enum lexical casts) stay authoritative: everything not matched here is
+ *  handed over to them, see test/urlparse-bench for the equivalence check.
+ */
+namespace urlparse {
+
+/** Components of a path split at runs of '/'. Leading and trailing empty
+ *  components are kept, i.e. the result is the same as of
+ *  ba::split(..., ba::is_any_of("/"), ba::token_compress_on).
+ */
+struct Components {
+    static constexpr std::size_t Max = 8;
+
+    /** First Max components, views into the split path.
+     */
+    std::array<std::string_view, Max> items;
+
+    /** Total number of components (may be more than Max).
+     */
+    std::size_t size;
+
+    const std::string_view& operator[](std::size_t i) const {
+        return items[i];
+    }
+};
+
+Components split(std::string_view path);
+
+/** Parses "{lod}-{x}-{y}." prefix of filename. Returns pointer to
+ *  extension (after the dot) inside filename or nullptr on mismatch.
+ */
+const char* parseTileIdPrefix(vtslibs::vts::TileId &tileId
+                              , std::string_view filename);
+
+/** Precompiled lookup of generator interface path component. Returns false
+ *  if there is no exact match.
+ */
+bool generatorInterface(std::string_view name, GeneratorInterface &value);
+
+/** Precompiled lookup of raster format extension. Returns false if there
+ *  is no exact match.
+ */
+bool rasterFormat(std::string_view ext, RasterFormat &value);
+
+inline std::string asString(std::string_view value) {
+    return std::string(value.data(), value.size());
+}
+
+} // namespace urlparse
+
+#endif // mapproxy_support_urlparse_hpp_included_
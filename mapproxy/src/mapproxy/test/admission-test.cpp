@@ -0,0 +1,162 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** Behaviour tests of generator task admission control.
+ */
+
+#include <set>
+#include <vector>
+
+#include "dbglog/dbglog.hpp"
+
+// mapproxy stuff
+#include "mapproxy/admission.hpp"
+
+#include "testing.hpp"
+
+namespace {
+
+std::shared_ptr<AdmissionControl> admission(std::size_t maxInFlight
+                                            , std::size_t perResource = 0
+                                            , std::size_t lowPriority = 0)
+{
+    AdmissionControl::Options options;
+    options.maxInFlight = maxInFlight;
+    options.maxInFlightPerResource = perResource;
+    options.lowPriorityLimit = lowPriority;
+    return std::make_shared<AdmissionControl>(options);
+}
+
+} // namespace
+
+TEST_CASE(disabledByDefault)
+{
+    CHECK(!admission(0)->enabled());
+    CHECK(admission(1)->enabled());
+    CHECK(admission(0, 1)->enabled());
+    CHECK(admission(0, 0, 1)->enabled());
+}
+
+TEST_CASE(admittedUnderLimitOfOne)
+{
+    auto ac(admission(1));
+
+    // this is exactly what Core tests before it runs the task
+    auto ticket(ac->admit("rf/group-id", false));
+    CHECK(ticket);
+    CHECK(ac->inFlight() == 1);
+
+    // slot is held by the ticket, not released right away
+    CHECK(!ac->admit("rf/group-id", false));
+    CHECK(!ac->admit("rf/other", false));
+    CHECK(ac->inFlight() == 1);
+
+    ticket.reset();
+    CHECK(ac->inFlight() == 0);
+    CHECK(ac->admit("rf/other", false));
+}
+
+TEST_CASE(ticketCopiesHoldSingleSlot)
+{
+    auto ac(admission(2));
+    auto ticket(ac->admit("a", false));
+    CHECK(ticket);
+
+    // task lambdas copy the ticket around
+    std::vector<AdmissionControl::Ticket> copies(5, ticket);
+    ticket.reset();
+    CHECK(ac->inFlight() == 1);
+    copies.clear();
+    CHECK(ac->inFlight() == 0);
+}
+
+TEST_CASE(perResourceLimit)
+{
+    auto ac(admission(0, 2));
+    auto a1(ac->admit("a", false));
+    auto a2(ac->admit("a", false));
+    CHECK(a1 && a2);
+    CHECK(!ac->admit("a", false));
+
+    // other resources are not affected
+    auto b1(ac->admit("b", false));
+    CHECK(b1);
+
+    a1.reset();
+    CHECK(ac->admit("a", false));
+    CHECK(ac->inFlight() == 2);
+}
+
+TEST_CASE(lowPriorityShedFirst)
+{
+    auto ac(admission(3, 0, 1));
+    auto high(ac->admit("a", false));
+    CHECK(high);
+
+    // over low priority limit: low priority shed, high priority admitted
+    CHECK(!ac->admit("a", true));
+    auto high2(ac->admit("a", false));
+    CHECK(high2);
+
+    high.reset();
+    high2.reset();
+    auto low(ac->admit("a", true));
+    CHECK(low);
+}
+
+TEST_CASE(lowPriorityCappedByMaxInFlight)
+{
+    // low priority limit above global limit does not lift the global limit
+    auto ac(admission(1, 0, 4));
+    auto high(ac->admit("a", false));
+    CHECK(high);
+    CHECK(!ac->admit("a", true));
+    CHECK(ac->inFlight() == 1);
+
+    high.reset();
+    auto low(ac->admit("a", true));
+    CHECK(low);
+    CHECK(!ac->admit("b", false));
+}
+
+TEST_CASE(ticketOutlivesControl)
+{
+    auto ac(admission(1));
+    auto ticket(ac->admit("a", false));
+    CHECK(ticket);
+
+    // ticket keeps admission control alive until released
+    std::weak_ptr<AdmissionControl> weak(ac);
+    ac.reset();
+    CHECK(!weak.expired());
+    ticket.reset();
+    CHECK(weak.expired());
+}
+
+int main()
+{
+    return testing::run();
+}
@@ -0,0 +1,195 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** Behaviour tests of GDAL worker pool autoscaling: growth under queue
+ *  pressure, shrinking after idle period and clamping to pool bounds.
+ */
+
+#include <chrono>
+#include <thread>
+
+// mapproxy stuff
+#include "mapproxy/gdalsupport/autoscaler.hpp"
+
+#include "testing.hpp"
+
+namespace {
+
+typedef Autoscaler::Decision Decision;
+
+/** Bounds 2..4, no cooldown, immediate shrinking.
+ */
+Autoscaler::Options options()
+{
+    Autoscaler::Options o;
+    o.min = 2;
+    o.max = 4;
+    o.queueDepth = 2;
+    o.queueWait = 500;
+    o.idle = 0;
+    o.loadLimit = 0.9;
+    o.cooldown = 0;
+    return o;
+}
+
+Autoscaler::Sample sample(std::size_t workers, std::size_t queued = 0
+                          , std::size_t wait = 0, std::size_t idle = 0
+                          , double load = 0.5)
+{
+    Autoscaler::Sample s;
+    s.workers = workers;
+    s.queued = queued;
+    s.wait = wait;
+    s.idle = idle;
+    s.load = load;
+    return s;
+}
+
+/** Sample of pool converged to the current target.
+ */
+Autoscaler::Sample pressure(const Autoscaler &as)
+{
+    return sample(as.target(), 3 * as.target());
+}
+
+Autoscaler::Sample idle(const Autoscaler &as)
+{
+    return sample(as.target(), 0, 0, 1);
+}
+
+} // namespace
+
+TEST_CASE(initialTargetClamped)
+{
+    CHECK(Autoscaler(options(), 3).target() == 3);
+    CHECK(Autoscaler(options(), 8).target() == 4);
+    CHECK(Autoscaler(options(), 0).target() == 2);
+
+    // min 0 still keeps one worker
+    auto o(options());
+    o.min = 0;
+    CHECK(Autoscaler(o, 0).target() == 1);
+}
+
+TEST_CASE(disabledWithoutMax)
+{
+    auto o(options());
+    o.max = 0;
+    Autoscaler as(o, 8);
+    CHECK(!as.enabled());
+    CHECK(as.target() == 8);
+    CHECK(as.update(pressure(as)) == Decision::none);
+    CHECK(as.target() == 8);
+}
+
+TEST_CASE(growsUnderQueuePressure)
+{
+    Autoscaler as(options(), 2);
+
+    // queue depth at the limit is fine
+    CHECK(as.update(sample(2, 4)) == Decision::none);
+    CHECK(as.update(sample(2, 5)) == Decision::grow);
+    CHECK(as.target() == 3);
+
+    // oldest request waiting too long
+    CHECK(as.update(sample(3, 1, 500)) == Decision::none);
+    CHECK(as.update(sample(3, 1, 501)) == Decision::grow);
+    CHECK(as.target() == 4);
+}
+
+TEST_CASE(growthClampedToMax)
+{
+    Autoscaler as(options(), 2);
+    while (as.update(pressure(as)) == Decision::grow) {}
+    CHECK(as.target() == 4);
+    CHECK(as.update(pressure(as)) == Decision::none);
+    CHECK(as.target() == 4);
+}
+
+TEST_CASE(noGrowthWithoutCpuHeadroom)
+{
+    Autoscaler as(options(), 2);
+    CHECK(as.update(sample(2, 10, 0, 0, 0.95)) == Decision::none);
+    CHECK(as.target() == 2);
+    CHECK(as.update(sample(2, 10, 0, 0, 0.5)) == Decision::grow);
+}
+
+TEST_CASE(waitsForPoolToConverge)
+{
+    Autoscaler as(options(), 2);
+    CHECK(as.update(pressure(as)) == Decision::grow);
+
+    // third worker not running yet
+    CHECK(as.update(sample(2, 20)) == Decision::none);
+    CHECK(as.target() == 3);
+    CHECK(as.update(sample(3, 20)) == Decision::grow);
+}
+
+TEST_CASE(shrinksAfterIdleClampedToMin)
+{
+    Autoscaler as(options(), 4);
+    CHECK(as.update(idle(as)) == Decision::shrink);
+    CHECK(as.target() == 3);
+    CHECK(as.update(idle(as)) == Decision::shrink);
+    CHECK(as.target() == 2);
+    CHECK(as.update(idle(as)) == Decision::none);
+    CHECK(as.target() == 2);
+}
+
+TEST_CASE(shrinksOnlyAfterWholeIdlePeriod)
+{
+    auto o(options());
+    o.idle = 1;
+    Autoscaler as(o, 4);
+
+    CHECK(as.update(idle(as)) == Decision::none);
+    std::this_thread::sleep_for(std::chrono::milliseconds(600));
+
+    // busy sample interrupts idle period
+    CHECK(as.update(sample(4)) == Decision::none);
+    CHECK(as.update(idle(as)) == Decision::none);
+    std::this_thread::sleep_for(std::chrono::milliseconds(600));
+    CHECK(as.update(idle(as)) == Decision::none);
+    CHECK(as.target() == 4);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    CHECK(as.update(idle(as)) == Decision::shrink);
+    CHECK(as.target() == 3);
+}
+
+TEST_CASE(cooldownBetweenDecisions)
+{
+    auto o(options());
+    o.cooldown = 60;
+    Autoscaler as(o, 2);
+
+    CHECK(as.update(pressure(as)) == Decision::grow);
+    CHECK(as.update(pressure(as)) == Decision::none);
+    CHECK(as.update(idle(as)) == Decision::none);
+    CHECK(as.target() == 3);
+}
+
+int main() { return testing::run(); }
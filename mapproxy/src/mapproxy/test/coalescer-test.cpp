@@ -0,0 +1,384 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** Behaviour tests of warp request coalescing: followers share leader's
+ *  result and retry on their own when leader's failure is not theirs.
+ */
+
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <thread>
+#include <vector>
+#include <string>
+#include <stdexcept>
+#include <functional>
+
+#include "dbglog/dbglog.hpp"
+
+// mapproxy stuff
+#include "mapproxy/gdalsupport/coalescer.hpp"
+
+#include "testing.hpp"
+
+namespace {
+
+typedef Coalescer<int> IntCoalescer;
+typedef std::function<void()> Fail;
+
+const std::string Key("key");
+
+/** Leader of Key fails by given function (or yields 1 if there is none)
+ *  after all followers have joined. Each follower that does the work on
+ *  its own yields 2. Returns followers' results, errors as -1.
+ */
+std::vector<int> flight(int followers, const Fail &fail
+                        , std::atomic<int> &works)
+{
+    IntCoalescer coalescer;
+    std::promise<void> gate;
+    const auto opened(gate.get_future().share());
+    std::atomic<int> joined(0);
+
+    const auto wait([&](const std::shared_future<int> &future)
+    {
+        ++joined;
+        future.wait();
+    });
+
+    std::thread leader([&]()
+    {
+        try {
+            coalescer(Key, "", [&]() -> int
+            {
+                ++works;
+                opened.wait();
+                if (fail) { fail(); }
+                return 1;
+            }, wait, &followerRetries);
+        } catch (...) {}
+    });
+
+    while (!coalescer.size()) { std::this_thread::yield(); }
+
+    std::vector<int> results(followers);
+    std::vector<std::thread> pool;
+    for (int i(0); i < followers; ++i) {
+        pool.emplace_back([&, i]()
+        {
+            try {
+                results[i] = coalescer(Key, "", [&]() -> int
+                {
+                    ++works;
+                    return 2;
+                }, wait, &followerRetries);
+            } catch (...) {
+                results[i] = -1;
+            }
+        });
+    }
+
+    while (joined < followers) { std::this_thread::yield(); }
+    gate.set_value();
+
+    leader.join();
+    for (auto &thread : pool) { thread.join(); }
+    CHECK(!coalescer.size());
+    return results;
+}
+
+template <typename Error>
+bool retries(bool optimized)
+{
+    return followerRetries(std::make_exception_ptr(Error("error"))
+                           , optimized);
+}
+
+std::uint64_t nowUs()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>
+        (std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+} // namespace
+
+TEST_CASE(followersShareResult)
+{
+    std::atomic<int> works(0);
+    const auto results(flight(4, Fail(), works));
+    CHECK(works == 1);
+    for (const auto result : results) { CHECK(result == 1); }
+}
+
+TEST_CASE(leaderAbortRetried)
+{
+    std::atomic<int> works(0);
+    const auto results(flight(3, []() -> void
+    {
+        throw RequestAborted("leader's client gave up");
+    }, works));
+
+    // every follower did the work on its own
+    CHECK(works == 4);
+    for (const auto result : results) { CHECK(result == 2); }
+}
+
+TEST_CASE(leaderDeadlineRetried)
+{
+    std::atomic<int> works(0);
+    const auto results(flight(3, []() -> void
+    {
+        throw DeadlineExceeded("leader ran out of time");
+    }, works));
+
+    CHECK(works == 4);
+    for (const auto result : results) { CHECK(result == 2); }
+}
+
+TEST_CASE(leaderErrorShared)
+{
+    std::atomic<int> works(0);
+    const auto results(flight(3, []() -> void
+    {
+        throw std::runtime_error("broken dataset");
+    }, works));
+
+    CHECK(works == 1);
+    for (const auto result : results) { CHECK(result == -1); }
+}
+
+TEST_CASE(retryClassification)
+{
+    CHECK(retries<RequestAborted>(false));
+    CHECK(retries<DeadlineExceeded>(false));
+    CHECK(retries<EmptyImage>(true));
+    CHECK(!retries<EmptyImage>(false));
+    CHECK(!retries<NotFound>(true));
+    CHECK(!retries<std::runtime_error>(true));
+}
+
+TEST_CASE(alternateKeyJoined)
+{
+    IntCoalescer coalescer;
+    std::promise<void> gate;
+    const auto opened(gate.get_future().share());
+
+    std::thread leader([&]()
+    {
+        try {
+            coalescer("optimized", "", [&]() -> int
+            {
+                opened.wait();
+                throw EmptyImage("empty");
+            }, [](const std::shared_future<int>&) {}, &followerRetries);
+        } catch (const EmptyImage&) {}
+    });
+    while (!coalescer.size()) { std::this_thread::yield(); }
+
+    // follower of alternate key retries on empty optimized raster
+    bool alternated(false);
+    int result(0);
+    std::thread follower([&]()
+    {
+        result = coalescer(Key, "optimized", []() { return 2; }
+                           , [&](const std::shared_future<int> &future)
+        {
+            gate.set_value();
+            future.wait();
+        }, [&](const std::exception_ptr &error, bool alternate)
+        {
+            alternated = alternate;
+            return followerRetries(error, alternate);
+        });
+    });
+
+    leader.join();
+    follower.join();
+    CHECK(result == 2);
+    CHECK(alternated);
+    CHECK(!coalescer.size());
+}
+
+TEST_CASE(lateCallerLeads)
+{
+    IntCoalescer coalescer;
+    int works(0);
+    const auto work([&]() { return ++works; });
+    const auto wait([](const std::shared_future<int>&) {});
+
+    CHECK(coalescer(Key, "", work, wait, &followerRetries) == 1);
+    CHECK(coalescer(Key, "", work, wait, &followerRetries) == 2);
+    CHECK(!coalescer.size());
+}
+
+TEST_CASE(asyncFollowersShareResult)
+{
+    IntCoalescer coalescer;
+    IntCoalescer::Callback done;
+    int works(0);
+    const auto start([&](const IntCoalescer::Callback &callback)
+    {
+        ++works;
+        done = callback;
+    });
+
+    std::vector<int> results;
+    const auto collect([&](int result, const std::exception_ptr &error)
+    {
+        results.push_back(error ? -1 : result);
+    });
+
+    CHECK(!coalescer.async(Key, "", start, collect, &followerRetries));
+    CHECK(coalescer.async(Key, "", start, collect, &followerRetries));
+    CHECK(coalescer.async(Key, "", start, collect, &followerRetries));
+    CHECK(works == 1);
+    CHECK(results.empty());
+
+    // leader's completion is fanned out to every attached callback
+    done(1, {});
+    CHECK(results.size() == 3);
+    for (const auto result : results) { CHECK(result == 1); }
+    CHECK(!coalescer.size());
+}
+
+TEST_CASE(asyncLeaderAbortRetried)
+{
+    IntCoalescer coalescer;
+    std::vector<IntCoalescer::Callback> started;
+    const auto start([&](const IntCoalescer::Callback &callback)
+    {
+        started.push_back(callback);
+    });
+
+    std::vector<int> results;
+    const auto collect([&](int result, const std::exception_ptr &error)
+    {
+        results.push_back(error ? -1 : result);
+    });
+
+    coalescer.async(Key, "", start, collect, &followerRetries);
+    coalescer.async(Key, "", start, collect, &followerRetries);
+    started.front()
+        (0, std::make_exception_ptr(RequestAborted("client gave up")));
+
+    // leader gets its own error, follower has started the work on its own
+    CHECK(results.size() == 1);
+    CHECK(results.front() == -1);
+    CHECK(started.size() == 2);
+    started.back()(2, {});
+    CHECK(results.size() == 2);
+    CHECK(results.back() == 2);
+}
+
+TEST_CASE(asyncFollowerOfSyncLeader)
+{
+    IntCoalescer coalescer;
+    std::promise<void> gate;
+    const auto opened(gate.get_future().share());
+
+    std::thread leader([&]()
+    {
+        coalescer(Key, "", [&]() { opened.wait(); return 1; }
+                  , [](const std::shared_future<int>&) {}
+                  , &followerRetries);
+    });
+    while (!coalescer.size()) { std::this_thread::yield(); }
+
+    std::atomic<int> result(0);
+    int works(0);
+    CHECK(coalescer.async(Key, "", [&](const IntCoalescer::Callback&)
+    {
+        ++works;
+    }, [&](int value, const std::exception_ptr&)
+    {
+        result = value;
+    }, &followerRetries));
+
+    gate.set_value();
+    leader.join();
+    CHECK(result == 1);
+    CHECK(!works);
+}
+
+TEST_CASE(asyncStartFailureShared)
+{
+    IntCoalescer coalescer;
+    int errors(0);
+    const auto collect([&](int, const std::exception_ptr &error)
+    {
+        if (error) { ++errors; }
+    });
+
+    bool thrown(false);
+    try {
+        coalescer.async(Key, "", [&](const IntCoalescer::Callback&)
+        {
+            // follower attaches before leader's work fails to start
+            coalescer.async(Key, "", [](const IntCoalescer::Callback&) {}
+                            , collect, &followerRetries);
+            throw std::runtime_error("no memory");
+        }, collect, &followerRetries);
+    } catch (const std::runtime_error&) {
+        thrown = true;
+    }
+
+    CHECK(thrown);
+    CHECK(errors == 1);
+    CHECK(!coalescer.size());
+}
+
+TEST_CASE(followerGivesUp)
+{
+    std::promise<int> never;
+    const auto future(never.get_future().share());
+
+    std::atomic<bool> aborted(true);
+    bool thrown(false);
+    try {
+        follow(future, aborted, 0);
+    } catch (const RequestAborted&) {
+        thrown = true;
+    }
+    CHECK(thrown);
+
+    // own deadline passes while leader is still working
+    aborted = false;
+    thrown = false;
+    try {
+        follow(future, aborted, nowUs() + 30000);
+    } catch (const DeadlineExceeded&) {
+        thrown = true;
+    }
+    CHECK(thrown);
+
+    // ready result is returned regardless of the deadline
+    never.set_value(1);
+    follow(future, aborted, 1);
+    CHECK(future.get() == 1);
+}
+
+int main() { return testing::run(); }
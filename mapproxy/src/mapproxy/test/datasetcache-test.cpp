@@ -0,0 +1,230 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** Behaviour tests of the GDAL workers' LRU dataset cache.
+ */
+
+#include <vector>
+#include <string>
+
+#include <gdal_priv.h>
+#include <ogr_srs_api.h>
+
+#include "dbglog/dbglog.hpp"
+
+// mapproxy stuff
+#include "mapproxy/gdalsupport/datasetcache.hpp"
+
+#include "testing.hpp"
+
+namespace {
+
+/** Creates tiny GeoTIFF in GDAL's in-memory filesystem, returns its path.
+ */
+std::string dataset(const std::string &name)
+{
+    const auto path("/vsimem/datasetcache-test/" + name + ".tif");
+
+    auto *driver(GetGDALDriverManager()->GetDriverByName("GTiff"));
+    auto *ds(driver->Create(path.c_str(), 4, 4, 1, GDT_Byte, nullptr));
+    double gt[6] = { 0.0, 1.0, 0.0, 4.0, 0.0, -1.0 };
+    ds->SetGeoTransform(gt);
+    ds->SetProjection(SRS_WKT_WGS84_LAT_LONG);
+    delete ds;
+
+    return path;
+}
+
+/** Empty in-memory vector dataset.
+ */
+DatasetCache::VectorDataset vectorDataset()
+{
+    auto *driver(GetGDALDriverManager()->GetDriverByName("Memory"));
+    return DatasetCache::VectorDataset
+        (driver->Create("", 0, 0, 0, GDT_Unknown, nullptr)
+         , [](GDALDataset *ds) { delete ds; });
+}
+
+typedef std::vector<std::string> Paths;
+
+} // namespace
+
+TEST_CASE(leastRecentlyUsedEvicted)
+{
+    const auto a(dataset("a")), b(dataset("b")), c(dataset("c"));
+
+    Paths evicted;
+    DatasetCache cache(2, [&](const std::string &path)
+    {
+        evicted.push_back(path);
+    });
+
+    cache(a);
+    cache(b);
+    // a is used again, b becomes the least recently used one
+    cache(a);
+    cache(c);
+
+    // never evicted while serving a request
+    CHECK(cache.size() == 3);
+    cache.trim();
+    CHECK(cache.size() == 2);
+    CHECK((evicted == Paths{ b }));
+
+    const auto &stats(cache.stats());
+    CHECK(stats.hits == 1);
+    CHECK(stats.misses == 3);
+    CHECK(stats.evictions == 1);
+
+    // a survived
+    cache(a);
+    CHECK(stats.hits == 2);
+    CHECK(stats.misses == 3);
+}
+
+TEST_CASE(evictOneAtATime)
+{
+    const auto a(dataset("a")), b(dataset("b"));
+
+    Paths evicted;
+    DatasetCache cache(0, [&](const std::string &path)
+    {
+        evicted.push_back(path);
+    });
+
+    cache(a);
+    cache(b);
+
+    // unlimited cache keeps everything
+    cache.trim();
+    CHECK(cache.size() == 2);
+
+    CHECK(cache.evict());
+    CHECK(cache.evict());
+    CHECK(!cache.evict());
+    CHECK((evicted == Paths{ a, b }));
+    CHECK(cache.stats().evictions == 2);
+}
+
+TEST_CASE(blockQuotaClosesDataset)
+{
+    const auto a(dataset("a")), b(dataset("b"));
+
+    Paths evicted;
+    DatasetCache cache(0, [&](const std::string &path)
+    {
+        evicted.push_back(path);
+    }, 0, 100);
+
+    cache(a);
+    cache(b);
+
+    // a loads blocks over its quota, b finds all its blocks cached
+    CHECK(!cache.account(a, 60));
+    CHECK(!cache.account(a, 60));
+    CHECK(cache.account(b, 0));
+
+    cache.trim();
+    CHECK(cache.size() == 1);
+    CHECK((evicted == Paths{ a }));
+    CHECK(cache.stats().blockFlushes == 1);
+    CHECK(cache.stats().evictions == 0);
+
+    // reopened with clean account
+    cache(a);
+    cache.trim();
+    CHECK(cache.size() == 2);
+}
+
+TEST_CASE(failedOpenNotCached)
+{
+    DatasetCache cache(2);
+
+    bool thrown(false);
+    try {
+        cache("/vsimem/datasetcache-test/missing.tif");
+    } catch (const std::exception&) {
+        thrown = true;
+    }
+    CHECK(thrown);
+    CHECK(cache.size() == 0);
+    CHECK(cache.stats().misses == 1);
+
+    // nothing to evict
+    CHECK(!cache.evict());
+}
+
+TEST_CASE(vectorDatasetsLru)
+{
+    int opened(0);
+    const auto open([&]()
+    {
+        ++opened;
+        return vectorDataset();
+    });
+
+    DatasetCache cache(0, {}, 1);
+
+    const auto first(cache.vector("a", {}, open));
+    CHECK(cache.vector("a", {}, open) == first);
+    CHECK(opened == 1);
+
+    // different open options are a different dataset
+    cache.vector("a", { "OPTION=1" }, open);
+    CHECK(opened == 2);
+    CHECK(cache.vectorSize() == 1);
+
+    // first one has been evicted
+    CHECK(cache.vector("a", {}, open) != first);
+    CHECK(opened == 3);
+
+    const auto &stats(cache.stats());
+    CHECK(stats.vectorHits == 1);
+    CHECK(stats.vectorMisses == 3);
+    CHECK(stats.vectorEvictions == 2);
+}
+
+TEST_CASE(vectorCacheDisabled)
+{
+    int opened(0);
+    const auto open([&]()
+    {
+        ++opened;
+        return vectorDataset();
+    });
+
+    DatasetCache cache;
+    cache.vector("a", {}, open);
+    cache.vector("a", {}, open);
+    CHECK(opened == 2);
+    CHECK(cache.vectorSize() == 0);
+}
+
+int main()
+{
+    ::GDALAllRegister();
+    return testing::run();
+}
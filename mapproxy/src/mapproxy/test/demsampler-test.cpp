@@ -0,0 +1,160 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** Behaviour tests of the batched DEM sampler's interpolation kernel.
+ */
+
+#include <cmath>
+#include <vector>
+
+#include "dbglog/dbglog.hpp"
+
+// mapproxy stuff
+#include "mapproxy/gdalsupport/demsampler.hpp"
+
+#include "testing.hpp"
+
+namespace {
+
+const double Nodata(-1e10);
+
+/** Grid of given size with value(col, row) in each cell.
+ */
+template <typename Value>
+std::vector<double> makeGrid(int width, int height, const Value &value)
+{
+    std::vector<double> data(width * height);
+    for (int r(0); r < height; ++r) {
+        for (int c(0); c < width; ++c) { data[r * width + c] = value(c, r); }
+    }
+    return data;
+}
+
+DemSampler::Grid grid(const std::vector<double> &data, int width
+                      , int height)
+{
+    return { data.data(), width, height, std::size_t(width), Nodata };
+}
+
+bool near(double a, double b) { return std::abs(a - b) < 1e-9; }
+
+} // namespace
+
+TEST_CASE(planeInterpolatedExactly)
+{
+    const auto data(makeGrid(4, 3, [](int c, int r) {
+        return 10.0 + 2.0 * c - 3.0 * r;
+    }));
+
+    const std::vector<double> col{ 0.0, 0.5, 1.25, 2.75, 3.0 };
+    const std::vector<double> row{ 0.0, 0.5, 1.75, 0.25, 2.0 };
+    std::vector<double> z(col.size());
+
+    CHECK(!DemSampler::interpolate(grid(data, 4, 3), col.size()
+                                   , col.data(), row.data(), z.data()));
+    for (std::size_t i(0); i < z.size(); ++i) {
+        CHECK(near(z[i], 10.0 + 2.0 * col[i] - 3.0 * row[i]));
+    }
+}
+
+TEST_CASE(pointsClampedToGrid)
+{
+    const auto data(makeGrid(2, 2, [](int c, int r) {
+        return double(c + 2 * r);
+    }));
+
+    // half a pixel beyond the edge pixel centers
+    const std::vector<double> col{ -0.5, 1.5 };
+    const std::vector<double> row{ -0.5, 1.5 };
+    std::vector<double> z(col.size());
+
+    CHECK(!DemSampler::interpolate(grid(data, 2, 2), col.size()
+                                   , col.data(), row.data(), z.data()));
+    CHECK(near(z[0], 0.0));
+    CHECK(near(z[1], 3.0));
+}
+
+TEST_CASE(singlePixelGrid)
+{
+    const std::vector<double> data{ 42.0 };
+    const std::vector<double> col{ 0.0, 0.3 };
+    const std::vector<double> row{ 0.2, 0.0 };
+    std::vector<double> z(col.size());
+
+    CHECK(!DemSampler::interpolate(grid(data, 1, 1), col.size()
+                                   , col.data(), row.data(), z.data()));
+    CHECK(near(z[0], 42.0));
+    CHECK(near(z[1], 42.0));
+}
+
+TEST_CASE(nodataNeighboursLeftOut)
+{
+    // single valid corner next to three nodata ones
+    std::vector<double> data{ 5.0, Nodata, Nodata, Nodata };
+    const std::vector<double> col{ 0.5, 0.9 };
+    const std::vector<double> row{ 0.5, 0.1 };
+    std::vector<double> z(col.size());
+
+    CHECK(!DemSampler::interpolate(grid(data, 2, 2), col.size()
+                                   , col.data(), row.data(), z.data()));
+    CHECK(near(z[0], 5.0));
+    CHECK(near(z[1], 5.0));
+}
+
+TEST_CASE(noValidNeighbourIsMissing)
+{
+    std::vector<double> data{ 1.0, Nodata, Nodata
+                              , Nodata, Nodata, Nodata
+                              , Nodata, Nodata, 7.0 };
+    const std::vector<double> col{ 1.5, 0.0, 2.0 };
+    const std::vector<double> row{ 0.5, 0.0, 2.0 };
+    std::vector<double> z(col.size());
+
+    CHECK(DemSampler::interpolate(grid(data, 3, 3), col.size()
+                                  , col.data(), row.data(), z.data()) == 1);
+    CHECK(z[0] == Nodata);
+    CHECK(near(z[1], 1.0));
+    CHECK(near(z[2], 7.0));
+}
+
+TEST_CASE(strideHonoured)
+{
+    // 2x2 grid inside rows of 3 cells, third column is garbage
+    std::vector<double> data{ 0.0, 1.0, 99.0
+                              , 2.0, 3.0, 99.0 };
+    DemSampler::Grid g{ data.data(), 2, 2, 3, Nodata };
+
+    const std::vector<double> col{ 0.5, 1.0 };
+    const std::vector<double> row{ 0.5, 1.0 };
+    std::vector<double> z(col.size());
+
+    CHECK(!DemSampler::interpolate(g, col.size(), col.data(), row.data()
+                                   , z.data()));
+    CHECK(near(z[0], 1.5));
+    CHECK(near(z[1], 3.0));
+}
+
+int main() { return testing::run(); }
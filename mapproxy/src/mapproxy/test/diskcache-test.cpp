@@ -0,0 +1,206 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** Behaviour tests of the persistent disk cache: stored responses are read
+ *  back, the whole pack starts over once full and the cache directory has a
+ *  single owner at a time.
+ */
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include "dbglog/dbglog.hpp"
+
+// mapproxy stuff
+#include "mapproxy/diskcache.hpp"
+
+#include "testing.hpp"
+
+namespace fs = boost::filesystem;
+
+namespace {
+
+/** Temporary cache directory, removed with the instance.
+ */
+struct TmpDir {
+    fs::path path;
+
+    TmpDir()
+        : path(fs::temp_directory_path()
+               / fs::unique_path("diskcache-test-%%%%-%%%%"))
+    {}
+
+    ~TmpDir() {
+        boost::system::error_code ec;
+        fs::remove_all(path, ec);
+    }
+};
+
+DiskCache::Options options(const fs::path &path, std::size_t size = 1)
+{
+    DiskCache::Options o;
+    o.path = path;
+    o.size = size;
+    return o;
+}
+
+Sink::FileInfo stat(long maxAge = 3600)
+{
+    return Sink::FileInfo("image/png", -1, maxAge);
+}
+
+void put(DiskCache &cache, const std::string &key, const std::string &body)
+{
+    cache.put(key, body.data(), body.size(), stat());
+}
+
+/** Waits for asynchronous write (or for ownership) to show up.
+ */
+template <typename Predicate>
+bool eventually(Predicate predicate
+                , std::chrono::milliseconds timeout
+                = std::chrono::milliseconds(5000))
+{
+    const auto deadline(std::chrono::steady_clock::now() + timeout);
+    while (!predicate()) {
+        if (std::chrono::steady_clock::now() > deadline) { return false; }
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    return true;
+}
+
+bool has(DiskCache &cache, const std::string &key)
+{
+    return bool(cache.get(key));
+}
+
+} // namespace
+
+TEST_CASE(putGet)
+{
+    TmpDir tmp;
+    DiskCache cache(options(tmp.path));
+    CHECK(cache.enabled());
+    CHECK(cache.ready());
+    CHECK(!cache.get("a"));
+
+    put(cache, "a", "alpha");
+    CHECK(eventually([&]() { return has(cache, "a"); }));
+
+    const auto response(cache.get("a"));
+    CHECK(response->body() == "alpha");
+    CHECK(response->stat.contentType == "image/png");
+    CHECK(!cache.get("b"));
+}
+
+TEST_CASE(notCachedWithoutMaxAge)
+{
+    TmpDir tmp;
+    DiskCache cache(options(tmp.path));
+    cache.put("a", "x", 1, stat(0));
+    put(cache, "b", "y");
+
+    // writes are processed in order: once b is there, a was skipped
+    CHECK(eventually([&]() { return has(cache, "b"); }));
+    CHECK(!cache.get("a"));
+}
+
+TEST_CASE(survivesReopen)
+{
+    TmpDir tmp;
+    {
+        DiskCache cache(options(tmp.path));
+        put(cache, "a", "alpha");
+        CHECK(eventually([&]() { return has(cache, "a"); }));
+    }
+
+    DiskCache cache(options(tmp.path));
+    const auto response(cache.get("a"));
+    CHECK(response);
+    CHECK(response->body() == "alpha");
+}
+
+TEST_CASE(startsOverWhenFull)
+{
+    TmpDir tmp;
+    DiskCache cache(options(tmp.path, 1));
+
+    // five 200 KB bodies fit into 1 MB pack, the sixth one does not
+    std::vector<std::string> keys;
+    for (int i(0); i < 6; ++i) {
+        const auto key("k" + std::to_string(i));
+        put(cache, key, std::string(200 << 10, char('a' + i)));
+        CHECK(eventually([&]() { return has(cache, key); }));
+        keys.push_back(key);
+    }
+
+    // whole old generation is dropped at once
+    for (int i(0); i < 5; ++i) { CHECK(!cache.get(keys[i])); }
+    const auto last(cache.get(keys.back()));
+    CHECK(last);
+    CHECK(last->body() == std::string(200 << 10, 'f'));
+}
+
+TEST_CASE(tooLargeNotStored)
+{
+    TmpDir tmp;
+    DiskCache cache(options(tmp.path, 1));
+    put(cache, "big", std::string(2 << 20, 'x'));
+    put(cache, "small", "s");
+    CHECK(eventually([&]() { return has(cache, "small"); }));
+    CHECK(!cache.get("big"));
+}
+
+TEST_CASE(singleOwner)
+{
+    TmpDir tmp;
+    auto first(std::make_unique<DiskCache>(options(tmp.path)));
+    CHECK(first->ready());
+    put(*first, "a", "alpha");
+    CHECK(eventually([&]() { return has(*first, "a"); }));
+
+    // second instance contends for the directory lock: waits without cache
+    DiskCache second(options(tmp.path));
+    CHECK(second.enabled());
+    CHECK(!second.ready());
+    CHECK(!second.get("a"));
+    put(second, "b", "beta");
+
+    // takes over once the first one releases the directory
+    first.reset();
+    CHECK(eventually([&]() { return second.ready(); }));
+    const auto response(second.get("a"));
+    CHECK(response);
+    CHECK(response->body() == "alpha");
+    CHECK(!second.get("b"));
+}
+
+int main() { return testing::run(); }
@@ -0,0 +1,296 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** Behaviour tests of the GDAL warper dispatch policies: dataset affinity
+ *  with stealing, priority lanes and per-dataset concurrency caps.
+ */
+
+#include <map>
+#include <deque>
+#include <array>
+#include <memory>
+#include <cstdint>
+
+#include "dbglog/dbglog.hpp"
+
+// mapproxy stuff
+#include "mapproxy/gdalsupport/dispatch.hpp"
+
+#include "testing.hpp"
+
+namespace {
+
+/** Queued request; time is in milliseconds.
+ */
+struct Request {
+    std::size_t dataset;
+    int time;
+    int lane;
+
+    std::size_t affinity() const { return dataset; }
+    int enqueued() const { return time; }
+
+    typedef std::shared_ptr<Request> pointer;
+    typedef std::deque<pointer> Deque;
+};
+
+Request::pointer request(std::size_t dataset, int time = 0, int lane = 0)
+{
+    return std::make_shared<Request>(Request{ dataset, time, lane });
+}
+
+/** Dataset to worker.
+ */
+typedef std::map<std::size_t, int> Owners;
+
+struct Dispatch { unsigned int running; };
+typedef std::map<std::size_t, Dispatch> DispatchTable;
+
+const auto any([](const Request&) { return true; });
+
+const int StealDelay(100);
+
+/** Picks request for worker 1.
+ */
+template <typename Eligible>
+std::pair<Request::Deque::iterator, dispatch::Pick>
+pick(Request::Deque &queue, const Owners &owners, int now
+     , Eligible eligible)
+{
+    return dispatch::pick(queue.begin(), queue.end(), owners, 1, now
+                          , StealDelay, eligible);
+}
+
+std::pair<Request::Deque::iterator, dispatch::Pick>
+pick(Request::Deque &queue, const Owners &owners, int now = 0)
+{
+    return pick(queue, owners, now, any);
+}
+
+constexpr std::size_t Lanes(3);
+typedef std::array<bool, Lanes> Pending;
+typedef std::array<unsigned int, Lanes> Weights;
+typedef std::array<std::int64_t, Lanes> Credit;
+
+/** Serves given number of requests from pending lanes, returns number of
+ *  requests served per lane.
+ */
+std::array<int, Lanes> serve(const Pending &pending, const Weights &weights
+                             , Credit &credit, int count)
+{
+    std::array<int, Lanes> served{};
+    std::array<std::size_t, Lanes> order;
+    for (int i(0); i < count; ++i) {
+        const auto total(dispatch::laneOrder(pending, weights, credit
+                                             , order));
+        if (!pending[order[0]]) { break; }
+        credit[order[0]] -= total;
+        ++served[order[0]];
+    }
+    return served;
+}
+
+} // namespace
+
+TEST_CASE(ownDatasetWins)
+{
+    Request::Deque queue{ request(10), request(20), request(0) };
+    const Owners owners{ { 10, 1 } };
+
+    // older request for our dataset wins over newer free ones
+    const auto picked(pick(queue, owners));
+    CHECK(picked.second == dispatch::Pick::own);
+    CHECK(picked.first == queue.begin());
+}
+
+TEST_CASE(freeRequestsServedLifo)
+{
+    Request::Deque queue{ request(10), request(0), request(20) };
+    const Owners owners;
+
+    const auto picked(pick(queue, owners));
+    CHECK(picked.second == dispatch::Pick::free);
+    CHECK((*picked.first)->dataset == 20);
+}
+
+TEST_CASE(foreignDatasetLeftToItsWorker)
+{
+    // dataset 10 is open in worker 2
+    Request::Deque queue{ request(20), request(10, 50) };
+    const Owners owners{ { 10, 2 } };
+
+    // free request wins over foreign one even when it is older
+    auto picked(pick(queue, owners, 60));
+    CHECK(picked.second == dispatch::Pick::free);
+    CHECK((*picked.first)->dataset == 20);
+
+    // foreign request alone is not touched before the steal delay
+    queue.erase(picked.first);
+    picked = pick(queue, owners, 60);
+    CHECK(picked.second == dispatch::Pick::none);
+    CHECK(picked.first == queue.end());
+}
+
+TEST_CASE(stealAfterDelay)
+{
+    Request::Deque queue{ request(10, 0), request(30, 80) };
+    const Owners owners{ { 10, 2 }, { 30, 3 } };
+
+    CHECK(pick(queue, owners, StealDelay - 1).second
+          == dispatch::Pick::none);
+
+    // only the request waiting for long enough is stolen
+    const auto picked(pick(queue, owners, StealDelay));
+    CHECK(picked.second == dispatch::Pick::steal);
+    CHECK((*picked.first)->dataset == 10);
+
+    // own request still wins over stealing
+    queue.push_front(request(40));
+    const Owners own{ { 10, 2 }, { 30, 3 }, { 40, 1 } };
+    CHECK(pick(queue, own, 1000).second == dispatch::Pick::own);
+}
+
+TEST_CASE(ineligibleRequestsSkipped)
+{
+    Request::Deque queue{ request(10, 0, 0), request(10, 0, 1) };
+    const Owners owners{ { 10, 1 } };
+
+    const auto picked(pick(queue, owners, 0, [](const Request &r)
+    {
+        return r.lane == 0;
+    }));
+    CHECK(picked.second == dispatch::Pick::own);
+    CHECK(picked.first == queue.begin());
+
+    const auto last(dispatch::pickLast(queue.begin(), queue.end()
+                                       , [](const Request &r)
+    {
+        return r.lane == 0;
+    }));
+    CHECK(last == queue.begin());
+
+    CHECK(dispatch::pickLast(queue.begin(), queue.end()
+                             , [](const Request&) { return false; })
+          == queue.end());
+}
+
+TEST_CASE(concurrencyCap)
+{
+    const DispatchTable table{ { 10, { 2 } } };
+
+    CHECK(dispatch::capped(table, 10, 2));
+    CHECK(dispatch::capped(table, 10, 1));
+    CHECK(!dispatch::capped(table, 10, 3));
+    // no cap
+    CHECK(!dispatch::capped(table, 10, 0));
+    // not running anywhere
+    CHECK(!dispatch::capped(table, 20, 1));
+}
+
+TEST_CASE(cappedDatasetStaysQueued)
+{
+    // dataset 10 runs in 2 workers, capped to 2
+    const DispatchTable table{ { 10, { 2 } } };
+    Request::Deque queue{ request(20), request(10) };
+    const Owners owners{ { 10, 1 } };
+
+    int deferred(0);
+    const auto eligible([&](const Request &r) -> bool
+    {
+        if (!dispatch::capped(table, r.affinity(), 2)) { return true; }
+        ++deferred;
+        return false;
+    });
+
+    // other work is dispatched meanwhile, even our own dataset waits
+    const auto picked(pick(queue, owners, 0, eligible));
+    CHECK(picked.second == dispatch::Pick::free);
+    CHECK((*picked.first)->dataset == 20);
+    CHECK(deferred == 1);
+
+    queue.erase(picked.first);
+    CHECK(pick(queue, owners, 1000, eligible).second
+          == dispatch::Pick::none);
+}
+
+TEST_CASE(lanesServedByWeight)
+{
+    const Pending pending{ { true, true, true } };
+    const Weights weights{ { 4, 2, 1 } };
+    Credit credit{};
+
+    // smooth: every window of 7 requests follows the weights exactly
+    for (int round(0); round < 10; ++round) {
+        const auto served(serve(pending, weights, credit, 7));
+        CHECK(served[0] == 4);
+        CHECK(served[1] == 2);
+        CHECK(served[2] == 1);
+    }
+}
+
+TEST_CASE(zeroWeightStillServed)
+{
+    const Pending pending{ { true, true, false } };
+    const Weights weights{ { 0, 0, 5 } };
+    Credit credit{};
+
+    // weight is at least 1, idle lane is never picked
+    const auto served(serve(pending, weights, credit, 10));
+    CHECK(served[0] == 5);
+    CHECK(served[1] == 5);
+    CHECK(served[2] == 0);
+}
+
+TEST_CASE(idleLaneGainsNoCredit)
+{
+    const Weights weights{ { 1, 1, 1 } };
+    Credit credit{};
+
+    // lane 1 idle for a while
+    serve(Pending{ { true, false, false } }, weights, credit, 20);
+    CHECK(credit[1] == 0);
+    CHECK(credit[2] == 0);
+
+    // and does not monopolize the queue once it has work
+    const auto served(serve(Pending{ { true, true, false } }, weights
+                            , credit, 10));
+    CHECK(served[0] == 5);
+    CHECK(served[1] == 5);
+}
+
+TEST_CASE(nothingPending)
+{
+    const Pending pending{};
+    const Weights weights{ { 1, 2, 3 } };
+    Credit credit{ { 7, 8, 9 } };
+    std::array<std::size_t, Lanes> order;
+
+    CHECK(dispatch::laneOrder(pending, weights, credit, order) == 0);
+    CHECK(!pending[order[0]]);
+    CHECK((credit == Credit{ { 7, 8, 9 } }));
+}
+
+int main() { return testing::run(); }
@@ -0,0 +1,493 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** Encoder benchmark on a corpus of recorded raw tiles (PNG images dumped
+ *  by core.debug.dumpImages): every encoder setting is run over the whole
+ *  corpus and reported with encode time per tile, output size and PSNR/SSIM
+ *  of the decoded tile against the original.
+ *
+ *  Decoding uses OpenCV (formats it cannot decode are reported without
+ *  quality figures) except for KTX2 whose BC4/BC5 blocks are decoded here;
+ *  KTX2 is compared on the encoded channels only.
+ */
+
+#include <cmath>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <algorithm>
+
+#include <boost/format.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "dbglog/dbglog.hpp"
+
+#include "utility/buildsys.hpp"
+
+#include "service/cmdline.hpp"
+
+// mapproxy stuff
+#include "mapproxy/resource.hpp"
+#include "mapproxy/support/imgencode.hpp"
+
+namespace po = boost::program_options;
+namespace fs = boost::filesystem;
+
+class EncoderBench : public service::Cmdline {
+public:
+    EncoderBench()
+        : service::Cmdline("encoder-bench", BUILD_TARGET_VERSION)
+        , limit_(1000), iterations_(3)
+    {}
+
+private:
+    void configuration(po::options_description &cmdline
+                       , po::options_description &config
+                       , po::positional_options_description &pd);
+
+    void configure(const po::variables_map &vars);
+
+    bool help(std::ostream &out, const std::string &what) const;
+
+    int run();
+
+    fs::path corpus_;
+    std::vector<std::string> formats_;
+    std::size_t limit_;
+    int iterations_;
+};
+
+void EncoderBench::configuration(po::options_description &cmdline
+                                 , po::options_description &config
+                                 , po::positional_options_description &pd)
+{
+    cmdline.add_options()
+        ("corpus", po::value(&corpus_)->required()
+         , "Directory with recorded raw tiles (*.png).")
+        ("format", po::value(&formats_)
+         , "Benchmark only settings of this format (jpg, png, webp, ktx2, "
+         "avif, jxl), can be repeated. All by default.")
+        ("limit", po::value(&limit_)->default_value(limit_)->required()
+         , "Maximum number of tiles loaded from the corpus.")
+        ("iterations", po::value(&iterations_)
+         ->default_value(iterations_)->required()
+         , "Number of timed encodes of each tile.")
+        ;
+
+    pd.add("corpus", 1);
+    (void) config;
+}
+
+void EncoderBench::configure(const po::variables_map &vars)
+{
+    (void) vars;
+}
+
+bool EncoderBench::help(std::ostream &out, const std::string &what) const
+{
+    if (what.empty()) {
+        out << ("Encode time, size and quality of image encoder settings "
+                "on recorded tiles.\n");
+        return true;
+    }
+
+    return false;
+}
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+struct Setting {
+    std::string name;
+    RasterFormat format;
+    ImageEncoding encoding;
+};
+
+std::vector<Setting> settings()
+{
+    std::vector<Setting> out;
+    const auto add([&](const std::string &name, RasterFormat format
+                       , const std::function<void(ImageEncoding&)> &set)
+    {
+        Setting s{ name, format, {} };
+        set(s.encoding);
+        out.push_back(s);
+    });
+
+    for (int q : { 50, 75, 85, 95 }) {
+        add(str(boost::format("jpg q%d") % q), RasterFormat::jpg
+            , [&](ImageEncoding &e) { e.jpegQuality = q; });
+    }
+    for (int l : { 1, 3, 6, 9 }) {
+        add(str(boost::format("png l%d") % l), RasterFormat::png
+            , [&](ImageEncoding &e) { e.pngCompression = l; });
+    }
+
+    // lossless: quality is compression effort
+    for (auto qm : { std::make_pair(25, 0), std::make_pair(75, 4)
+                     , std::make_pair(100, 6) })
+    {
+        add(str(boost::format("webp lossless q%d m%d")
+                % qm.first % qm.second)
+            , RasterFormat::webp, [&](ImageEncoding &e) {
+                e.webpLossless = true;
+                e.webpQuality = qm.first;
+                e.webpEffort = qm.second;
+            });
+    }
+    // lossy, high qualities approach lossless output
+    for (auto qm : { std::make_pair(70, 4), std::make_pair(90, 4)
+                     , std::make_pair(95, 6) })
+    {
+        add(str(boost::format("webp q%d m%d") % qm.first % qm.second)
+            , RasterFormat::webp, [&](ImageEncoding &e) {
+                e.webpLossless = false;
+                e.webpQuality = qm.first;
+                e.webpEffort = qm.second;
+            });
+    }
+
+    add("ktx2", RasterFormat::ktx2, [](ImageEncoding&) {});
+
+    for (auto qs : { std::make_pair(40, 8), std::make_pair(60, 8)
+                     , std::make_pair(80, 6) })
+    {
+        add(str(boost::format("avif q%d s%d") % qs.first % qs.second)
+            , RasterFormat::avif, [&](ImageEncoding &e) {
+                e.avifQuality = qs.first;
+                e.avifSpeed = qs.second;
+            });
+    }
+    for (int q : { 75, 90 }) {
+        add(str(boost::format("jxl q%d e3") % q), RasterFormat::jxl
+            , [&](ImageEncoding &e) { e.jxlQuality = q; });
+    }
+
+    return out;
+}
+
+std::vector<cv::Mat> loadCorpus(const fs::path &dir, std::size_t limit)
+{
+    std::vector<fs::path> paths;
+    for (fs::directory_iterator i(dir), e; i != e; ++i) {
+        if (i->path().extension() == ".png") { paths.push_back(i->path()); }
+    }
+    std::sort(paths.begin(), paths.end());
+    if (paths.size() > limit) { paths.resize(limit); }
+
+    std::vector<cv::Mat> corpus;
+    for (const auto &path : paths) {
+        auto image(cv::imread(path.string(), cv::IMREAD_UNCHANGED));
+        if (image.empty() || (image.depth() != CV_8U)) {
+            LOG(warn3) << "Skipping " << path << ": not an 8-bit image.";
+            continue;
+        }
+        corpus.push_back(image);
+    }
+    return corpus;
+}
+
+/** Decodes BC4 block into 16 texels (same interpolation as the encoder).
+ */
+void decodeBc4(const unsigned char *block, unsigned char *texels)
+{
+    const int r0(block[0]), r1(block[1]);
+    std::uint64_t bits(0);
+    for (int i(0); i < 6; ++i) {
+        bits |= std::uint64_t(block[2 + i]) << (8 * i);
+    }
+
+    int levels[8] = { r0, r1, 0, 0, 0, 0, 0, 255 };
+    if (r0 > r1) {
+        for (int i(1); i < 7; ++i) {
+            levels[i + 1] = ((7 - i) * r0 + i * r1 + 3) / 7;
+        }
+    } else {
+        for (int i(1); i < 5; ++i) {
+            levels[i + 1] = ((5 - i) * r0 + i * r1 + 2) / 5;
+        }
+    }
+
+    for (int t(0); t < 16; ++t) { texels[t] = levels[(bits >> (3 * t)) & 7]; }
+}
+
+template <typename T>
+T get(const std::vector<unsigned char> &buf, std::size_t offset)
+{
+    T value(0);
+    for (std::size_t i(0); i < sizeof(T); ++i) {
+        value |= T(buf.at(offset + i)) << (8 * i);
+    }
+    return value;
+}
+
+/** Decodes single-level BC4/BC5 KTX2 texture into one or two planes (red,
+ *  green).
+ */
+std::vector<cv::Mat> decodeKtx2(const std::vector<unsigned char> &buf)
+{
+    const auto format(get<std::uint32_t>(buf, 12));
+    const int width(get<std::uint32_t>(buf, 20));
+    const int height(get<std::uint32_t>(buf, 24));
+    auto offset(get<std::uint64_t>(buf, 80));
+
+    const bool bc5(format == 141);
+    std::vector<cv::Mat> planes(bc5 ? 2 : 1);
+    for (auto &plane : planes) { plane.create(height, width, CV_8UC1); }
+
+    unsigned char texels[16];
+    for (int by(0); by < (height + 3) / 4; ++by) {
+        for (int bx(0); bx < (width + 3) / 4; ++bx) {
+            for (auto &plane : planes) {
+                if (offset + 8 > buf.size()) {
+                    LOGTHROW(err2, std::runtime_error)
+                        << "Truncated KTX2 data.";
+                }
+                decodeBc4(&buf[offset], texels);
+                offset += 8;
+                for (int y(0); y < 4; ++y) {
+                    const int row(by * 4 + y);
+                    if (row >= height) { break; }
+                    for (int x(0); x < 4; ++x) {
+                        const int col(bx * 4 + x);
+                        if (col >= width) { break; }
+                        plane.at<unsigned char>(row, col) = texels[y * 4 + x];
+                    }
+                }
+            }
+        }
+    }
+    return planes;
+}
+
+/** Splits original and decoded image into comparable planes. Returns false
+ *  if there is nothing to compare.
+ */
+bool comparablePlanes(const cv::Mat &original, RasterFormat format
+                      , const std::vector<unsigned char> &buf
+                      , std::vector<cv::Mat> &orig
+                      , std::vector<cv::Mat> &decoded)
+{
+    std::vector<cv::Mat> all;
+    cv::split(original, all);
+
+    if (format == RasterFormat::ktx2) {
+        decoded = decodeKtx2(buf);
+        // OpenCV stores BGR(A), red is channel 2
+        if (decoded.size() == 2) {
+            orig = { all[2], all[1] };
+        } else {
+            orig = { all[0] };
+        }
+        return true;
+    }
+
+    auto image(cv::imdecode(buf, cv::IMREAD_UNCHANGED));
+    if (image.empty() || (image.depth() != CV_8U)) { return false; }
+
+    if ((original.channels() == 1) && (image.channels() != 1)) {
+        cv::cvtColor(image, image, cv::COLOR_BGR2GRAY);
+    }
+    cv::split(image, decoded);
+
+    // drop alpha missing in one of them
+    const auto count(std::min(all.size(), decoded.size()));
+    orig.assign(all.begin(), all.begin() + count);
+    decoded.resize(count);
+    return count && (image.size() == original.size());
+}
+
+/** Sum of squared errors.
+ */
+double sse(const cv::Mat &a, const cv::Mat &b)
+{
+    const auto n(cv::norm(a, b, cv::NORM_L2));
+    return n * n;
+}
+
+/** Mean SSIM over 11x11 Gaussian windows (sigma 1.5).
+ */
+double ssim(const cv::Mat &a8, const cv::Mat &b8)
+{
+    const double C1(6.5025), C2(58.5225);
+
+    cv::Mat a, b;
+    a8.convertTo(a, CV_32F);
+    b8.convertTo(b, CV_32F);
+
+    const auto blur([](const cv::Mat &in) {
+        cv::Mat out;
+        cv::GaussianBlur(in, out, cv::Size(11, 11), 1.5);
+        return out;
+    });
+
+    const auto muA(blur(a)), muB(blur(b));
+    const cv::Mat muA2(muA.mul(muA)), muB2(muB.mul(muB))
+        , muAB(muA.mul(muB));
+    const cv::Mat sA2(blur(a.mul(a)) - muA2), sB2(blur(b.mul(b)) - muB2)
+        , sAB(blur(a.mul(b)) - muAB);
+
+    cv::Mat num((2 * muAB + C1).mul(2 * sAB + C2));
+    cv::Mat den((muA2 + muB2 + C1).mul(sA2 + sB2 + C2));
+    cv::Mat map;
+    cv::divide(num, den, map);
+    return cv::mean(map)[0];
+}
+
+struct Result {
+    std::size_t tiles = 0;
+    std::size_t failed = 0;
+    std::size_t compared = 0;
+    double encodeMs = 0.0;
+    double bytes = 0.0;
+    double pixels = 0.0;
+    double sse = 0.0;
+    double samples = 0.0;
+    double ssim = 0.0;
+    std::size_t ssimPlanes = 0;
+};
+
+Result bench(const Setting &setting, const std::vector<cv::Mat> &corpus
+             , int iterations)
+{
+    Result r;
+    for (const auto &image : corpus) {
+        try {
+            const auto start(Clock::now());
+            for (int i(1); i < iterations; ++i) {
+                encodeImage(image, setting.format, setting.encoding);
+            }
+            const auto &buf
+                (encodeImage(image, setting.format, setting.encoding));
+            const std::chrono::duration<double, std::milli>
+                elapsed(Clock::now() - start);
+
+            ++r.tiles;
+            r.encodeMs += elapsed.count() / std::max(iterations, 1);
+            r.bytes += buf.size();
+            r.pixels += double(image.cols) * image.rows;
+
+            std::vector<cv::Mat> orig, decoded;
+            if (!comparablePlanes(image, setting.format, buf, orig, decoded))
+            {
+                continue;
+            }
+
+            ++r.compared;
+            for (std::size_t p(0); p < orig.size(); ++p) {
+                r.sse += sse(orig[p], decoded[p]);
+                r.samples += double(orig[p].cols) * orig[p].rows;
+                r.ssim += ssim(orig[p], decoded[p]);
+                ++r.ssimPlanes;
+            }
+        } catch (const std::exception &e) {
+            // e.g. WebP of grayscale image
+            LOG(info1) << setting.name << ": " << e.what();
+            ++r.failed;
+        }
+    }
+    return r;
+}
+
+} // namespace
+
+int EncoderBench::run()
+{
+    const auto corpus(loadCorpus(corpus_, limit_));
+    if (corpus.empty()) {
+        LOG(err3) << "No tiles found in " << corpus_ << ".";
+        return EXIT_FAILURE;
+    }
+
+    std::cout << boost::format("%d tiles, %d timed encodes each\n\n")
+        % corpus.size() % iterations_;
+    std::cout << boost::format("%-24s %10s %10s %7s %8s %7s %s\n")
+        % "setting" % "ms/tile" % "bytes/tile" % "bpp" % "PSNR" % "SSIM"
+        % "notes";
+
+    for (const auto &setting : settings()) {
+        const auto format(boost::lexical_cast<std::string>(setting.format));
+        if (!formats_.empty()
+            && (std::find(formats_.begin(), formats_.end(), format)
+                == formats_.end()))
+        {
+            continue;
+        }
+        if (!encoderAvailable(setting.format)) {
+            std::cout << boost::format("%-24s not compiled in\n")
+                % setting.name;
+            continue;
+        }
+
+        const auto r(bench(setting, corpus, iterations_));
+
+        std::string notes;
+        if (r.failed) {
+            notes += str(boost::format("%d tiles unsupported ") % r.failed);
+        }
+        if (!r.tiles) {
+            std::cout << boost::format("%-24s %s\n") % setting.name % notes;
+            continue;
+        }
+
+        std::string psnr("n/a"), ssimStr("n/a");
+        if (r.compared) {
+            const double mse(r.sse / r.samples);
+            psnr = (mse > 0)
+                ? str(boost::format("%.2f") % (10 * std::log10
+                                                (255.0 * 255.0 / mse)))
+                : std::string("inf");
+            ssimStr = str(boost::format("%.4f") % (r.ssim / r.ssimPlanes));
+            if (r.compared < r.tiles) {
+                notes += str(boost::format("quality of %d tiles")
+                             % r.compared);
+            }
+        } else {
+            notes += "no decoder";
+        }
+
+        std::cout << boost::format("%-24s %10.3f %10.0f %7.3f %8s %7s %s\n")
+            % setting.name % (r.encodeMs / r.tiles) % (r.bytes / r.tiles)
+            % (8 * r.bytes / r.pixels) % psnr % ssimStr % notes;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[])
+{
+    return EncoderBench()(argc, argv);
+}
@@ -0,0 +1,153 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** Behaviour tests of generator-level request coalescing: waiters share
+ *  leader's response and are on their own when the leader has none.
+ */
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <string>
+
+#include "dbglog/dbglog.hpp"
+
+// mapproxy stuff
+#include "mapproxy/flights.hpp"
+
+#include "testing.hpp"
+
+namespace {
+
+typedef std::shared_ptr<std::string> Response;
+typedef Flights<std::string, Response, int> Board;
+
+Response response(const std::string &content)
+{
+    return std::make_shared<std::string>(content);
+}
+
+} // namespace
+
+TEST_CASE(waitersShareResponse)
+{
+    Board board;
+
+    const auto leader(board.join("tile", 1, "leader"));
+    CHECK(leader);
+    CHECK(leader->context == 1);
+    CHECK(!board.awaited(leader));
+
+    CHECK(!board.join("tile", 2, "first"));
+    CHECK(!board.join("tile", 3, "second"));
+    CHECK(board.awaited(leader));
+
+    board.respond(leader, response("content"));
+
+    const auto landed(board.land(leader));
+    CHECK((landed.first == std::vector<std::string>{ "first", "second" }));
+    CHECK(landed.second && (*landed.second == "content"));
+    CHECK(!board.size());
+}
+
+TEST_CASE(waitersOnTheirOwnWithoutResponse)
+{
+    Board board;
+
+    // leader failed (or streamed its file), nothing captured
+    const auto leader(board.join("tile", 1, "leader"));
+    CHECK(!board.join("tile", 1, "waiter"));
+
+    const auto landed(board.land(leader));
+    CHECK((landed.first == std::vector<std::string>{ "waiter" }));
+    CHECK(!landed.second);
+}
+
+TEST_CASE(lateRequestTakesOffAnew)
+{
+    Board board;
+
+    const auto first(board.join("tile", 1, "first"));
+    CHECK(!board.join("tile", 1, "waiter"));
+    CHECK(board.land(first).first.size() == 1);
+
+    // flight has landed, next request leads new one
+    const auto second(board.join("tile", 2, "second"));
+    CHECK(second);
+    CHECK(second != first);
+    CHECK(!board.join("tile", 2, "late"));
+
+    // landing old flight again neither answers anybody nor grounds the new
+    // one
+    CHECK(board.land(first).first.empty());
+    CHECK(board.size() == 1);
+    CHECK(board.awaited(second));
+
+    CHECK(board.land(second).first.size() == 1);
+    CHECK(!board.size());
+}
+
+TEST_CASE(keysFlyApart)
+{
+    Board board;
+
+    const auto a(board.join("a", 1, "a"));
+    const auto b(board.join("b", 2, "b"));
+    CHECK(a && b);
+    CHECK(board.size() == 2);
+
+    CHECK(!board.join("a", 1, "a2"));
+    CHECK(!board.awaited(b));
+    CHECK(board.land(b).first.empty());
+    CHECK(board.land(a).first.size() == 1);
+}
+
+TEST_CASE(concurrentRequestsHaveOneLeader)
+{
+    Board board;
+    const int requests(16);
+
+    std::atomic<int> leaders(0);
+    std::vector<Board::pointer> flights(requests);
+    std::vector<std::thread> pool;
+    for (int i(0); i < requests; ++i) {
+        pool.emplace_back([&, i]()
+        {
+            flights[i] = board.join("tile", i, std::to_string(i));
+            if (flights[i]) { ++leaders; }
+        });
+    }
+    for (auto &thread : pool) { thread.join(); }
+
+    CHECK(leaders == 1);
+    for (const auto &flight : flights) {
+        if (!flight) { continue; }
+        CHECK(int(board.land(flight).first.size()) == requests - 1);
+    }
+}
+
+int main() { return testing::run(); }
@@ -0,0 +1,499 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** Heightcoding benchmark on a corpus of recorded geodata tiles (MVT,
+ *  GeoPackage or anything else OGR opens) and DEMs, without warper,
+ *  daemon or HTTP stack: heightcode() from gdalsupport/operations is run
+ *  in-process for every combination of viewspec (first DEM only, all DEMs
+ *  stacked), clipping (off, clipped to tile extents) and output format.
+ *
+ *  Tile <name> may come with sidecar file <name>.hc with lines:
+ *      option NAME=VALUE             open option (e.g. @MVT_EXTENTS=...)
+ *      extents llx lly urx ury       tile extents in working SRS
+ *  Tiles without extents are not part of the clipping runs.
+ *
+ *  Reported stages are derived from runs differing in one aspect only:
+ *      read:      opening the tile and reading all its features by OGR
+ *      sample:    heightcoding without vertical adjustment minus read
+ *      adjust:    heightcoding with vertical adjustment minus the above
+ *      serialize: output after heightcoding (postprocess hook) until done
+ *  Every figure is the best of all iterations, summed over the corpus.
+ */
+
+#include <chrono>
+#include <vector>
+#include <string>
+#include <memory>
+#include <limits>
+#include <sstream>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <algorithm>
+
+#include <boost/format.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include <gdal_priv.h>
+#include <cpl_string.h>
+
+#include "dbglog/dbglog.hpp"
+
+#include "utility/buildsys.hpp"
+#include "utility/enum-io.hpp"
+#include "utility/streams.hpp"
+
+#include "service/cmdline.hpp"
+
+#include "gdal-drivers/register.hpp"
+
+// mapproxy stuff
+#include "mapproxy/error.hpp"
+#include "mapproxy/gdalsupport.hpp"
+#include "mapproxy/gdalsupport/types.hpp"
+#include "mapproxy/gdalsupport/datasetcache.hpp"
+#include "mapproxy/gdalsupport/operations.hpp"
+
+namespace po = boost::program_options;
+namespace fs = boost::filesystem;
+
+class HeightcodeBench : public service::Cmdline {
+public:
+    HeightcodeBench()
+        : service::Cmdline("heightcode-bench", BUILD_TARGET_VERSION)
+        , adjustVertical_(true), batchSampling_(false), limit_(1000)
+        , iterations_(3), arena_(256)
+    {}
+
+private:
+    void configuration(po::options_description &cmdline
+                       , po::options_description &config
+                       , po::positional_options_description &pd);
+
+    void configure(const po::variables_map &vars);
+
+    bool help(std::ostream &out, const std::string &what) const;
+
+    int run();
+
+    fs::path corpus_;
+    std::vector<std::string> dems_;
+    boost::optional<std::string> geoidGrid_;
+    boost::optional<geo::SrsDefinition> workingSrs_;
+    boost::optional<geo::SrsDefinition> outputSrs_;
+    bool adjustVertical_;
+    bool batchSampling_;
+    std::vector<std::string> layers_;
+    std::vector<std::string> formats_;
+    double resolution_;
+    std::size_t limit_;
+    int iterations_;
+    std::size_t arena_;
+};
+
+void HeightcodeBench::configuration(po::options_description &cmdline
+                                    , po::options_description &config
+                                    , po::positional_options_description &pd)
+{
+    cmdline.add_options()
+        ("corpus", po::value(&corpus_)->required()
+         , "Directory with recorded geodata tiles (*.mvt, *.pbf, *.gpkg, "
+         "*.geojson) and their optional *.hc sidecars.")
+        ("dem", po::value(&dems_)->required()
+         , "DEM dataset, can be repeated. Single-DEM viewspec uses the first "
+         "one, multi-DEM viewspec (run when more are given) all of them.")
+        ("geoidGrid", po::value<std::string>()
+         , "Geoid grid of the DEM stack.")
+        ("workingSrs", po::value<geo::SrsDefinition>()
+         , "Working SRS (i.e. SRS of tile extents), DEM SRS by default.")
+        ("outputSrs", po::value<geo::SrsDefinition>()
+         , "Output SRS; no vertical adjustment runs without it.")
+        ("adjustVertical", po::value(&adjustVertical_)
+         ->default_value(adjustVertical_)->required()
+         , "Measure vertical adjustment into output SRS.")
+        ("batchSampling", po::value(&batchSampling_)
+         ->default_value(batchSampling_)->required()
+         , "Sample DEM in batches (see DemSampler).")
+        ("layer", po::value(&layers_)
+         , "Heightcode only this layer, can be repeated. All by default.")
+        ("format", po::value(&formats_)
+         , "Benchmark only this output format, can be repeated. All by "
+         "default.")
+        ("resolution", po::value(&resolution_)->default_value(4096)
+         ->required(), "Resolution of geodataJson output.")
+        ("limit", po::value(&limit_)->default_value(limit_)->required()
+         , "Maximum number of tiles loaded from the corpus.")
+        ("iterations", po::value(&iterations_)
+         ->default_value(iterations_)->required()
+         , "Number of timed runs of each tile.")
+        ("arena", po::value(&arena_)->default_value(arena_)->required()
+         , "Size of memory arena (in MB) heightcoded output is written "
+         "into.")
+        ;
+
+    pd.add("corpus", 1);
+    (void) config;
+}
+
+void HeightcodeBench::configure(const po::variables_map &vars)
+{
+    if (vars.count("geoidGrid")) {
+        geoidGrid_ = vars["geoidGrid"].as<std::string>();
+    }
+    if (vars.count("workingSrs")) {
+        workingSrs_ = vars["workingSrs"].as<geo::SrsDefinition>();
+    }
+    if (vars.count("outputSrs")) {
+        outputSrs_ = vars["outputSrs"].as<geo::SrsDefinition>();
+    }
+    if (!outputSrs_) { adjustVertical_ = false; }
+}
+
+bool HeightcodeBench::help(std::ostream &out, const std::string &what) const
+{
+    if (what.empty()) {
+        out << ("Per-stage heightcoding time on recorded geodata tiles by "
+                "viewspec, clipping and output format.\n");
+        return true;
+    }
+
+    return false;
+}
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+struct Tile {
+    std::string path;
+    GdalWarper::OpenOptions options;
+    boost::optional<math::Extents2> extents;
+
+    typedef std::vector<Tile> list;
+};
+
+void loadSidecar(Tile &tile, const fs::path &path)
+{
+    utility::ifstreambuf f(path.string());
+    std::string line;
+    while (std::getline(f, line)) {
+        std::istringstream is(line);
+        std::string what;
+        if (!(is >> what)) { continue; }
+        if (what == "option") {
+            std::string option;
+            if (is >> option) { tile.options.push_back(option); }
+        } else if (what == "extents") {
+            math::Extents2 e;
+            if (is >> e.ll(0) >> e.ll(1) >> e.ur(0) >> e.ur(1)) {
+                tile.extents = e;
+            }
+        } else {
+            LOG(warn3) << "Unknown line <" << line << "> in " << path
+                       << ", ignored.";
+        }
+    }
+}
+
+Tile::list loadCorpus(const fs::path &dir, std::size_t limit)
+{
+    std::vector<fs::path> paths;
+    for (fs::directory_iterator i(dir), e; i != e; ++i) {
+        const auto ext(i->path().extension());
+        if ((ext == ".mvt") || (ext == ".pbf") || (ext == ".gpkg")
+            || (ext == ".geojson"))
+        {
+            paths.push_back(i->path());
+        }
+    }
+    std::sort(paths.begin(), paths.end());
+    if (paths.size() > limit) { paths.resize(limit); }
+
+    Tile::list corpus;
+    for (const auto &path : paths) {
+        Tile tile;
+        tile.path = path.string();
+        const auto sidecar(path.string() + ".hc");
+        if (fs::exists(sidecar)) { loadSidecar(tile, sidecar); }
+        corpus.push_back(tile);
+    }
+    return corpus;
+}
+
+/** Opens tile and reads all features of heightcoded layers. Returns number
+ *  of read features.
+ */
+std::size_t readTile(const Tile &tile, const std::vector<std::string> &layers)
+{
+    char **options(nullptr);
+    for (const auto &option : tile.options) {
+        options = ::CSLAddString(options, option.c_str());
+    }
+    std::unique_ptr< ::GDALDataset> ds
+        (static_cast< ::GDALDataset*>
+         (::GDALOpenEx(tile.path.c_str(), (GDAL_OF_VECTOR | GDAL_OF_READONLY)
+                       , nullptr, options, nullptr)));
+    ::CSLDestroy(options);
+    if (!ds) {
+        LOGTHROW(err2, std::runtime_error)
+            << "Cannot open vector dataset <" << tile.path << ">.";
+    }
+
+    std::size_t features(0);
+    for (int l(0), le(ds->GetLayerCount()); l < le; ++l) {
+        auto *layer(ds->GetLayer(l));
+        if (!layers.empty()
+            && (std::find(layers.begin(), layers.end(), layer->GetName())
+                == layers.end()))
+        {
+            continue;
+        }
+
+        layer->ResetReading();
+        while (auto *feature = layer->GetNextFeature()) {
+            ++features;
+            ::OGRFeature::DestroyFeature(feature);
+        }
+    }
+    return features;
+}
+
+/** Single benchmark case.
+ */
+struct Case {
+    std::string name;
+    DemDataset::list dems;
+    bool clip;
+    geo::VectorFormat format;
+};
+
+/** Best times (in microseconds) of single heightcoding run.
+ */
+struct Times {
+    /** Until end of heightcoding (postprocess hook) and until done.
+     */
+    std::uint64_t heightcoded;
+    std::uint64_t total;
+
+    std::size_t bytes;
+
+    Times()
+        : heightcoded(std::numeric_limits<std::uint64_t>::max())
+        , total(std::numeric_limits<std::uint64_t>::max()), bytes()
+    {}
+};
+
+std::uint64_t usec(const Clock::duration &d)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+}
+
+/** Runs heightcoding of tile iterations times, keeps best times. Returns
+ *  false if there is nothing to heightcode.
+ */
+bool heightcodeTile(DatasetCache &cache, ManagedBuffer &mb
+                    , const Tile &tile, const DemDataset::list &dems
+                    , GdalWarper::HeightcodeConfig config, int iterations
+                    , Times &times)
+{
+    Clock::time_point heightcoded;
+    config.postprocess = [&](geo::FeatureLayers&) -> void
+    {
+        heightcoded = Clock::now();
+    };
+
+    for (int i(0); i < iterations; ++i) {
+        const auto start(Clock::now());
+        GdalWarper::Heightcoded *hc(nullptr);
+        try {
+            hc = heightcode(cache, mb, tile.path, dems, config, boost::none
+                            , tile.options, {});
+        } catch (const EmptyGeoData&) {
+            return false;
+        }
+        const auto done(Clock::now());
+
+        times.heightcoded = std::min(times.heightcoded
+                                     , usec(heightcoded - start));
+        times.total = std::min(times.total, usec(done - start));
+        times.bytes = hc->size;
+        mb.deallocate(hc);
+    }
+    return true;
+}
+
+} // namespace
+
+int HeightcodeBench::run()
+{
+    const auto corpus(loadCorpus(corpus_, limit_));
+    if (corpus.empty()) {
+        LOG(err3) << "No tiles found in " << corpus_ << ".";
+        return EXIT_FAILURE;
+    }
+
+    ::GDALAllRegister();
+    gdal_drivers::registerAll();
+
+    // best read times of all tiles
+    std::vector<std::uint64_t> read(corpus.size()
+                                    , std::numeric_limits<std::uint64_t>
+                                    ::max());
+    std::size_t features(0);
+    for (std::size_t t(0); t < corpus.size(); ++t) {
+        for (int i(0); i < iterations_; ++i) {
+            const auto start(Clock::now());
+            const auto count(readTile(corpus[t], layers_));
+            if (!i) { features += count; }
+            read[t] = std::min(read[t], usec(Clock::now() - start));
+        }
+    }
+
+    // viewspecs
+    std::vector<std::pair<std::string, DemDataset::list>> viewspecs;
+    viewspecs.emplace_back("single", DemDataset::list
+                           { DemDataset(dems_.front(), geoidGrid_) });
+    if (dems_.size() > 1) {
+        DemDataset::list all;
+        for (const auto &dem : dems_) { all.emplace_back(dem); }
+        all.back().geoidGrid = geoidGrid_;
+        viewspecs.emplace_back("multi", all);
+    }
+
+    std::vector<Case> cases;
+    for (const auto format : enumerationValues(geo::VectorFormat())) {
+        const auto name(boost::lexical_cast<std::string>(format));
+        if (!formats_.empty()
+            && (std::find(formats_.begin(), formats_.end(), name)
+                == formats_.end()))
+        {
+            continue;
+        }
+        for (const auto &viewspec : viewspecs) {
+            for (const bool clip : { false, true }) {
+                cases.push_back
+                    ({ str(boost::format("%s %s%s") % name % viewspec.first
+                           % (clip ? " clip" : ""))
+                        , viewspec.second, clip, format });
+            }
+        }
+    }
+
+    std::vector<char> arena(arena_ << 20);
+    ManagedBuffer mb(bi::create_only, arena.data(), arena.size());
+
+    // DEMs stay open as in GDAL workers, tiles are opened by every run
+    DatasetCache cache;
+
+    std::cout << boost::format("%d tiles, %d timed runs each\n\n")
+        % corpus.size() % iterations_;
+    std::cout << boost::format("%-32s %6s %9s %9s %9s %9s %9s %10s\n")
+        % "case" % "tiles" % "read" % "sample" % "adjust" % "serialize"
+        % "total" % "bytes/tile";
+
+    for (const auto &c : cases) {
+        GdalWarper::HeightcodeConfig config;
+        config.workingSrs = workingSrs_;
+        config.batchSampling = batchSampling_;
+        if (!layers_.empty()) { config.layers = layers_; }
+        config.format = c.format;
+        if (c.format == geo::VectorFormat::geodataJson) {
+            createGeodataConfig(config.formatConfig).resolution
+                = resolution_;
+        }
+
+        std::uint64_t readSum(0), plain(0), adjusted(0), serialize(0)
+            , total(0);
+        std::size_t bytes(0), tiles(0);
+        try {
+            for (std::size_t t(0); t < corpus.size(); ++t) {
+                const auto &tile(corpus[t]);
+                if (c.clip) {
+                    if (!tile.extents) { continue; }
+                    config.clipWorkingExtents = *tile.extents;
+                }
+
+                // pass without vertical adjustment
+                Times p;
+                if (outputSrs_) {
+                    config.outputSrs = boost::in_place(*outputSrs_, false);
+                }
+                if (!heightcodeTile(cache, mb, tile, c.dems, config
+                                    , iterations_, p))
+                {
+                    continue;
+                }
+
+                // pass with vertical adjustment (if any)
+                Times a(p);
+                if (adjustVertical_) {
+                    a = Times();
+                    config.outputSrs = boost::in_place(*outputSrs_, true);
+                    heightcodeTile(cache, mb, tile, c.dems, config
+                                   , iterations_, a);
+                }
+
+                ++tiles;
+                readSum += read[t];
+                plain += p.heightcoded;
+                adjusted += a.heightcoded;
+                serialize += a.total - std::min(a.total, a.heightcoded);
+                total += a.total;
+                bytes += a.bytes;
+            }
+        } catch (const std::exception &e) {
+            std::cout << boost::format("%-32s failed: %s\n")
+                % c.name % e.what();
+            continue;
+        }
+
+        if (!tiles) {
+            std::cout << boost::format("%-32s no tiles\n") % c.name;
+            continue;
+        }
+
+        const auto ms([&](std::uint64_t value)
+        {
+            return value / 1e3 / tiles;
+        });
+        std::cout << boost::format("%-32s %6d %9.3f %9.3f %9.3f %9.3f %9.3f"
+                                   " %10d\n")
+            % c.name % tiles % ms(readSum)
+            % ms(plain - std::min(plain, readSum))
+            % ms(adjusted - std::min(adjusted, plain))
+            % ms(serialize) % ms(total) % (bytes / tiles);
+    }
+
+    std::cout << boost::format("\n(ms per tile; %d features in corpus)\n")
+        % features;
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[])
+{
+    return HeightcodeBench()(argc, argv);
+}
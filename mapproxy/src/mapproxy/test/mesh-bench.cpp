@@ -0,0 +1,268 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** Compares generic mesh simplification of a 128x128 grid with RTIN
+ *  triangulation on a synthetic terrain: faces per millisecond and maximum
+ *  vertical error against the full resolution terrain.
+ */
+
+#include <cmath>
+#include <chrono>
+#include <limits>
+#include <vector>
+#include <cstdlib>
+#include <iostream>
+
+#include <boost/format.hpp>
+
+#include "utility/buildsys.hpp"
+
+#include "service/cmdline.hpp"
+
+#include "geo/coordinates.hpp"
+
+#include "vts-libs/registry/po.hpp"
+#include "vts-libs/vts/nodeinfo.hpp"
+#include "vts-libs/vts/tileop.hpp"
+
+// mapproxy stuff
+#include "mapproxy/support/mesh.hpp"
+#include "mapproxy/support/rtin.hpp"
+
+namespace po = boost::program_options;
+
+namespace vts = vtslibs::vts;
+namespace vr = vtslibs::registry;
+
+class MeshBench : public service::Cmdline {
+public:
+    MeshBench()
+        : service::Cmdline("mesh-bench", BUILD_TARGET_VERSION)
+        , amplitude_(100.0), iterations_(10)
+    {}
+
+private:
+    void configuration(po::options_description &cmdline
+                       , po::options_description &config
+                       , po::positional_options_description &pd);
+
+    void configure(const po::variables_map &vars);
+
+    bool help(std::ostream &out, const std::string &what) const;
+
+    int run();
+
+    std::string referenceFrame_;
+    vts::TileId tileId_;
+    double amplitude_;
+    int iterations_;
+};
+
+void MeshBench::configuration(po::options_description &cmdline
+                              , po::options_description &config
+                              , po::positional_options_description &pd)
+{
+    vr::registryConfiguration(config, vr::defaultPath());
+
+    cmdline.add_options()
+        ("referenceFrame", po::value(&referenceFrame_)->required()
+         , "Reference frame.")
+        ("tileId", po::value(&tileId_)->required()
+         , "Tile to benchmark (lod-x-y).")
+        ("amplitude", po::value(&amplitude_)
+         ->default_value(amplitude_)->required()
+         , "Amplitude of synthetic terrain (meters).")
+        ("iterations", po::value(&iterations_)
+         ->default_value(iterations_)->required()
+         , "Number of iterations.")
+        ;
+
+    (void) pd;
+}
+
+void MeshBench::configure(const po::variables_map &vars)
+{
+    vr::registryConfigure(vars);
+}
+
+bool MeshBench::help(std::ostream &out, const std::string &what) const
+{
+    if (what.empty()) {
+        out << ("Benchmark of generic mesh simplification against RTIN "
+                "triangulation.\n");
+        return true;
+    }
+
+    return false;
+}
+
+namespace {
+
+const int Edges(128);
+
+template <typename F>
+double measure(int iterations, F f)
+{
+    const auto start(std::chrono::steady_clock::now());
+    for (int i(0); i < iterations; ++i) { f(); }
+    const std::chrono::duration<double, std::milli>
+        elapsed(std::chrono::steady_clock::now() - start);
+    return elapsed.count() / iterations;
+}
+
+/** Maximum vertical error of mesh (in local coordinates) against terrain
+ *  sampled at grid points.
+ */
+double verticalError(const geometry::Mesh &mesh
+                     , const vts::NodeInfo &nodeInfo
+                     , const std::vector<float> &heights)
+{
+    const auto extents(nodeInfo.extents());
+    const auto ts(math::size(extents));
+    const math::Size2f px(ts.width / Edges, ts.height / Edges);
+    const auto g2l(geo::geo2local(extents));
+
+    // grid point in local coordinates
+    const auto local([&](int i, int j)
+    {
+        return math::transform
+            (g2l, math::Point3(extents.ll(0) + i * px.width
+                               , extents.ur(1) - j * px.height, 0.0));
+    });
+    const auto origin(local(0, 0));
+
+    double error(0.0);
+    for (const auto &face : mesh.faces) {
+        const auto &a(mesh.vertices[face.a]);
+        const auto &b(mesh.vertices[face.b]);
+        const auto &c(mesh.vertices[face.c]);
+
+        // bounding box in grid coordinates
+        const auto gi([&](const math::Point3 &p) {
+            return (p(0) - origin(0)) / px.width; });
+        const auto gj([&](const math::Point3 &p) {
+            return (origin(1) - p(1)) / px.height; });
+
+        const int i0(std::max(0, int(std::floor(std::min({ gi(a), gi(b)
+                                                           , gi(c) })))));
+        const int i1(std::min(Edges, int(std::ceil(std::max({ gi(a), gi(b)
+                                                              , gi(c) })))));
+        const int j0(std::max(0, int(std::floor(std::min({ gj(a), gj(b)
+                                                           , gj(c) })))));
+        const int j1(std::min(Edges, int(std::ceil(std::max({ gj(a), gj(b)
+                                                              , gj(c) })))));
+
+        const double det((b(1) - c(1)) * (a(0) - c(0))
+                         + (c(0) - b(0)) * (a(1) - c(1)));
+        if (!det) { continue; }
+
+        for (int j(j0); j <= j1; ++j) {
+            for (int i(i0); i <= i1; ++i) {
+                const auto p(local(i, j));
+                const double l0(((b(1) - c(1)) * (p(0) - c(0))
+                                 + (c(0) - b(0)) * (p(1) - c(1))) / det);
+                const double l1(((c(1) - a(1)) * (p(0) - c(0))
+                                 + (a(0) - c(0)) * (p(1) - c(1))) / det);
+                const double l2(1.0 - l0 - l1);
+                if ((l0 < -1e-9) || (l1 < -1e-9) || (l2 < -1e-9)) {
+                    continue;
+                }
+
+                // local coordinates keep height untouched
+                const double z(l0 * a(2) + l1 * b(2) + l2 * c(2));
+                error = std::max
+                    (error, std::abs(z - heights[j * (Edges + 1) + i]));
+            }
+        }
+    }
+
+    return error;
+}
+
+} // namespace
+
+int MeshBench::run()
+{
+    const vts::NodeInfo nodeInfo
+        (vr::system.referenceFrames(referenceFrame_), tileId_);
+    const TileFacesCalculator tileFacesCalculator;
+
+    // synthetic terrain
+    std::vector<float> heights((Edges + 1) * (Edges + 1));
+    for (int j(0); j <= Edges; ++j) {
+        for (int i(0); i <= Edges; ++i) {
+            const double x(double(i) / Edges), y(double(j) / Edges);
+            heights[j * (Edges + 1) + i] = amplitude_
+                * (std::sin(7.0 * x) * std::cos(5.0 * y)
+                   + 0.3 * std::sin(23.0 * x + 17.0 * y));
+        }
+    }
+
+    const auto sampler([&](int i, int j, double &h) -> bool
+    {
+        h = heights[j * (Edges + 1) + i];
+        return true;
+    });
+
+    // generic path
+    geometry::Mesh simplified;
+    const auto simplifyMs(measure(iterations_, [&]() {
+        auto mesh(meshFromNode(nodeInfo, math::Size2(Edges, Edges)
+                               , sampler));
+        simplifyMesh(mesh.mesh, nodeInfo, tileFacesCalculator
+                     , boost::none);
+        simplified = mesh.mesh;
+    }));
+
+    // RTIN path, same face budget
+    const int faceCount(simplified.faces.size());
+    std::size_t rtinFaces(0);
+    float threshold(0.f);
+    const auto rtinMs(measure(iterations_, [&]() {
+        const Rtin rtin(heights, Edges + 1);
+        threshold = rtin.threshold(faceCount);
+        rtinFaces = rtin.triangulate(threshold).size();
+    }));
+
+    std::cout << boost::format
+        ("simplify: %d faces, %.3f ms/tile, %.1f faces/ms, "
+         "max vertical error %.3f m\n")
+        % simplified.faces.size() % simplifyMs
+        % (simplified.faces.size() / simplifyMs)
+        % verticalError(simplified, nodeInfo, heights);
+
+    std::cout << boost::format
+        ("rtin: %d faces, %.3f ms/tile, %.1f faces/ms, "
+         "max vertical error %.3f m\n")
+        % rtinFaces % rtinMs % (rtinFaces / rtinMs) % threshold;
+
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[])
+{
+    return MeshBench()(argc, argv);
+}
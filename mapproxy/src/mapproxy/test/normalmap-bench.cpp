@@ -0,0 +1,219 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** Compares fused normal map post-processing (exportNormals) with the
+ *  convertNormals -> encodeOct -> exportToBGR chain on a synthetic tile.
+ */
+
+#include <chrono>
+#include <random>
+#include <cstdlib>
+#include <iostream>
+
+#include <boost/format.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include <opencv2/core/core.hpp>
+
+#include "utility/buildsys.hpp"
+
+#include "service/cmdline.hpp"
+
+#include "geo/normalmap.hpp"
+
+#include "vts-libs/registry/po.hpp"
+#include "vts-libs/vts/nodeinfo.hpp"
+#include "vts-libs/vts/tileop.hpp"
+
+// mapproxy stuff
+#include "mapproxy/support/srs.hpp"
+#include "mapproxy/support/normalmap.hpp"
+
+namespace po = boost::program_options;
+
+namespace vts = vtslibs::vts;
+namespace vr = vtslibs::registry;
+
+class NormalMapBench : public service::Cmdline {
+public:
+    NormalMapBench()
+        : service::Cmdline("normalmap-bench", BUILD_TARGET_VERSION)
+        , size_(256), iterations_(100)
+    {}
+
+private:
+    void configuration(po::options_description &cmdline
+                       , po::options_description &config
+                       , po::positional_options_description &pd);
+
+    void configure(const po::variables_map &vars);
+
+    bool help(std::ostream &out, const std::string &what) const;
+
+    int run();
+
+    std::string referenceFrame_;
+    vts::TileId tileId_;
+    int size_;
+    int iterations_;
+};
+
+void NormalMapBench::configuration(po::options_description &cmdline
+                                   , po::options_description &config
+                                   , po::positional_options_description &pd)
+{
+    vr::registryConfiguration(config, vr::defaultPath());
+
+    cmdline.add_options()
+        ("referenceFrame", po::value(&referenceFrame_)->required()
+         , "Reference frame.")
+        ("tileId", po::value(&tileId_)->required()
+         , "Tile to benchmark (lod-x-y).")
+        ("size", po::value(&size_)->default_value(size_)->required()
+         , "Normal map size (pixels per side).")
+        ("iterations", po::value(&iterations_)
+         ->default_value(iterations_)->required()
+         , "Number of iterations.")
+        ;
+
+    (void) pd;
+}
+
+void NormalMapBench::configure(const po::variables_map &vars)
+{
+    vr::registryConfigure(vars);
+}
+
+bool NormalMapBench::help(std::ostream &out, const std::string &what) const
+{
+    if (what.empty()) {
+        out << ("Benchmark of fused normal map post-processing against the "
+                "three-pass chain.\n");
+        return true;
+    }
+
+    return false;
+}
+
+namespace {
+
+template <typename F>
+double measure(int iterations, F f)
+{
+    const auto start(std::chrono::steady_clock::now());
+    for (int i(0); i < iterations; ++i) { f(); }
+    const std::chrono::duration<double, std::milli>
+        elapsed(std::chrono::steady_clock::now() - start);
+    return elapsed.count() / iterations;
+}
+
+} // namespace
+
+int NormalMapBench::run()
+{
+    const vts::NodeInfo nodeInfo
+        (vr::system.referenceFrames(referenceFrame_), tileId_);
+    const auto conv(sds2phys(nodeInfo, boost::none));
+
+    auto [ll, lr, ul, ur] = physicalCorners(nodeInfo, boost::none);
+    const TangentialPlaneConvertor extraConv
+        (vr::system.srs(nodeInfo.referenceFrame().model.physicalSrs).srsDef
+         , 0.5 * (ul + ur - ll - lr));
+
+    // synthetic normals: random tilt up to ~45 degrees
+    cv::Mat normals(size_, size_, CV_32FC3);
+    {
+        std::mt19937 gen(42);
+        std::uniform_real_distribution<float> tilt(-1.f, 1.f);
+        for (int j(0); j < normals.rows; ++j) {
+            for (int i(0); i < normals.cols; ++i) {
+                cv::Vec3f n(tilt(gen), tilt(gen), 1.f);
+                normals.at<cv::Vec3f>(j, i) = n / cv::norm(n);
+            }
+        }
+    }
+
+    for (const bool optimize : { true, false }) {
+        cv::Mat chain, fused;
+
+        const auto chainMs(measure(iterations_, [&]() {
+            cv::Mat tmp(normals.clone());
+            geo::normalmap::convertNormals
+                (tmp, nodeInfo.extents(), conv.conv(), extraConv, optimize);
+            geo::normalmap::encodeOct(tmp);
+            chain = geo::normalmap::exportToBGR(tmp);
+        }));
+
+        const auto fusedMs(measure(iterations_, [&]() {
+            fused = exportNormals(normals, nodeInfo.extents(), conv
+                                  , extraConv
+                                  , (optimize ? NormalRotation::perTile
+                                     : NormalRotation::exact));
+        }));
+
+        double maxDiff(0.0);
+        if ((chain.size() == fused.size()) && (chain.type() == fused.type()))
+        {
+            maxDiff = cv::norm(chain, fused, cv::NORM_INF);
+        } else {
+            maxDiff = -1.0;
+        }
+
+        std::cout << boost::format
+            ("%s: chain %.3f ms/tile, fused %.3f ms/tile, speedup %.2fx, "
+             "max channel difference %s\n")
+            % (optimize ? "per-tile" : "exact") % chainMs % fusedMs
+            % (chainMs / fusedMs)
+            % ((maxDiff < 0) ? std::string("n/a (layout differs)")
+               : boost::lexical_cast<std::string>(maxDiff));
+    }
+
+    {
+        // interpolated grid against exact per-pixel rotation
+        cv::Mat exact, grid;
+        const auto exactMs(measure(iterations_, [&]() {
+            exact = exportNormals(normals, nodeInfo.extents(), conv
+                                  , extraConv, NormalRotation::exact);
+        }));
+        const auto gridMs(measure(iterations_, [&]() {
+            grid = exportNormals(normals, nodeInfo.extents(), conv
+                                 , extraConv, NormalRotation::grid);
+        }));
+
+        std::cout << boost::format
+            ("grid: exact %.3f ms/tile, grid %.3f ms/tile, speedup %.2fx, "
+             "max channel difference %s\n")
+            % exactMs % gridMs % (exactMs / gridMs)
+            % cv::norm(exact, grid, cv::NORM_INF);
+    }
+
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[])
+{
+    return NormalMapBench()(argc, argv);
+}
@@ -0,0 +1,192 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** Behaviour tests of the in-memory response cache: hits and misses,
+ *  expiration by max-age and least recently used eviction at the size
+ *  limit.
+ */
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <sstream>
+
+// mapproxy stuff
+#include "mapproxy/responsecache.hpp"
+
+#include "testing.hpp"
+
+namespace {
+
+/** Single shard, i.e. deterministic LRU order.
+ */
+ResponseCache::Options options(std::size_t size = 1)
+{
+    ResponseCache::Options o;
+    o.size = size;
+    o.shards = 1;
+    return o;
+}
+
+Sink::FileInfo stat(long maxAge = 3600)
+{
+    return Sink::FileInfo("image/png", -1, maxAge);
+}
+
+void put(ResponseCache &cache, const std::string &key
+         , const std::string &body)
+{
+    cache.put(key, body.data(), body.size(), stat());
+}
+
+std::string counter(const ResponseCache &cache, const std::string &name)
+{
+    std::ostringstream os;
+    cache.stat(os, "");
+    const auto s(os.str());
+    const auto start(s.find(name + "="));
+    if (start == std::string::npos) { return {}; }
+    const auto value(start + name.size() + 1);
+    return s.substr(value, s.find('\n', value) - value);
+}
+
+const std::size_t Kb(1 << 10);
+
+} // namespace
+
+TEST_CASE(hitAndMiss)
+{
+    ResponseCache cache(options());
+    CHECK(cache.enabled());
+
+    CHECK(!cache.get("a"));
+    put(cache, "a", "alpha");
+
+    const auto response(cache.get("a"));
+    CHECK(response);
+    CHECK(response->body() == "alpha");
+    CHECK(response->stat.contentType == "image/png");
+    CHECK(!cache.get("b"));
+
+    CHECK(counter(cache, "hits") == "1");
+    CHECK(counter(cache, "misses") == "2");
+    CHECK(counter(cache, "stored") == "1");
+
+    // contains() counts neither
+    CHECK(cache.contains("a"));
+    CHECK(!cache.contains("b"));
+    CHECK(counter(cache, "hits") == "1");
+    CHECK(counter(cache, "misses") == "2");
+}
+
+TEST_CASE(disabledWithoutSize)
+{
+    ResponseCache cache(options(0));
+    CHECK(!cache.enabled());
+    put(cache, "a", "alpha");
+    CHECK(!cache.get("a"));
+}
+
+TEST_CASE(notCachedWithoutMaxAge)
+{
+    ResponseCache cache(options());
+    cache.put("a", "x", 1, stat(0));
+    cache.put("b", "x", 1, stat(-1));
+    CHECK(!cache.get("a"));
+    CHECK(!cache.get("b"));
+}
+
+TEST_CASE(expires)
+{
+    ResponseCache cache(options());
+
+    auto response(std::make_shared<ResponseCache::Response>());
+    response->content = std::make_shared<std::string>("alpha");
+    response->stat = stat();
+    response->expires = (ResponseCache::Clock::now()
+                         + std::chrono::milliseconds(50));
+    cache.put("a", response);
+    CHECK(cache.get("a"));
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    CHECK(!cache.contains("a"));
+    CHECK(!cache.get("a"));
+
+    // expired entry is gone for good
+    CHECK(counter(cache, "entries") == "0");
+    CHECK(counter(cache, "size") == "0");
+}
+
+TEST_CASE(evictsLeastRecentlyUsed)
+{
+    ResponseCache cache(options(1));
+
+    // three 300 KB bodies fit into 1 MB, fourth one does not
+    put(cache, "a", std::string(300 * Kb, 'a'));
+    put(cache, "b", std::string(300 * Kb, 'b'));
+    put(cache, "c", std::string(300 * Kb, 'c'));
+
+    // touch a, b becomes least recently used
+    CHECK(cache.get("a"));
+    put(cache, "d", std::string(300 * Kb, 'd'));
+
+    CHECK(cache.contains("a"));
+    CHECK(!cache.contains("b"));
+    CHECK(cache.contains("c"));
+    CHECK(cache.contains("d"));
+    CHECK(counter(cache, "evicted") == "1");
+    CHECK(counter(cache, "size") == std::to_string(900 * Kb));
+}
+
+TEST_CASE(tooLargeNotCached)
+{
+    auto o(options(8));
+    o.maxEntrySize = 16;
+    ResponseCache cache(o);
+
+    put(cache, "big", std::string(17 * Kb, 'x'));
+    put(cache, "small", std::string(16 * Kb, 'x'));
+    CHECK(!cache.contains("big"));
+    CHECK(cache.contains("small"));
+}
+
+TEST_CASE(sharedBodyChargedOnce)
+{
+    ResponseCache cache(options(1));
+
+    put(cache, "a", std::string(600 * Kb, 'x'));
+    put(cache, "b", std::string(600 * Kb, 'x'));
+
+    const auto a(cache.get("a"));
+    const auto b(cache.get("b"));
+    CHECK(a && b);
+    CHECK(a->content == b->content);
+    CHECK(counter(cache, "evicted") == "0");
+    CHECK(counter(cache, "size") == std::to_string(600 * Kb));
+}
+
+int main() { return testing::run(); }
@@ -0,0 +1,205 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** Behaviour tests of the fair generator task scheduler.
+ */
+
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <stdexcept>
+
+#include <boost/asio/io_service.hpp>
+
+#include "dbglog/dbglog.hpp"
+
+// mapproxy stuff
+#include "mapproxy/scheduler.hpp"
+
+#include "testing.hpp"
+
+namespace asio = boost::asio;
+
+namespace {
+
+/** Runs io_service in given number of threads until it runs out of work.
+ */
+void runAll(asio::io_service &ios, unsigned int threads)
+{
+    std::vector<std::thread> pool;
+    for (unsigned int i(0); i < threads; ++i) {
+        pool.emplace_back([&ios]() { ios.run(); });
+    }
+    for (auto &thread : pool) { thread.join(); }
+}
+
+/** Counts served jobs per tenant among first `window` jobs.
+ */
+std::map<std::string, int> firstServed(const std::vector<std::string> &order
+                                       , std::size_t window)
+{
+    std::map<std::string, int> served;
+    for (std::size_t i(0); i < std::min(window, order.size()); ++i) {
+        ++served[order[i]];
+    }
+    return served;
+}
+
+} // namespace
+
+TEST_CASE(tenantsServedFairly)
+{
+    asio::io_service ios;
+    Scheduler scheduler(ios, 0);
+
+    std::vector<std::string> order;
+    const auto job([&](const std::string &tenant) {
+        return [&order, tenant]() { order.push_back(tenant); };
+    });
+
+    // heavy tenant floods the queue before light one posts anything
+    for (int i(0); i < 100; ++i) { scheduler.post("heavy", 1, job("heavy")); }
+    for (int i(0); i < 10; ++i) { scheduler.post("light", 1, job("light")); }
+
+    runAll(ios, 1);
+    CHECK(order.size() == 110);
+
+    // light tenant is not stuck behind the heavy one
+    auto served(firstServed(order, 20));
+    CHECK(served["light"] >= 9);
+}
+
+TEST_CASE(weightsRespected)
+{
+    asio::io_service ios;
+    Scheduler scheduler(ios, 0);
+
+    std::vector<std::string> order;
+    for (int i(0); i < 40; ++i) {
+        scheduler.post("a", 3, [&order]() { order.push_back("a"); });
+        scheduler.post("b", 1, [&order]() { order.push_back("b"); });
+    }
+
+    runAll(ios, 1);
+    CHECK(order.size() == 80);
+
+    auto served(firstServed(order, 40));
+    CHECK(served["a"] >= 28);
+    CHECK(served["a"] <= 32);
+}
+
+TEST_CASE(concurrencyCapHolds)
+{
+    asio::io_service ios;
+    Scheduler scheduler(ios, 1);
+
+    std::atomic<int> running(0), maxRunning(0), done(0);
+    for (int i(0); i < 16; ++i) {
+        scheduler.post("capped", 1, [&]()
+        {
+            const int now(++running);
+            int prev(maxRunning);
+            while ((now > prev)
+                   && !maxRunning.compare_exchange_weak(prev, now)) {}
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            --running;
+            ++done;
+        });
+    }
+
+    // pumps parked at the cap are reposted: everything runs
+    runAll(ios, 4);
+    CHECK(done == 16);
+    CHECK(maxRunning == 1);
+}
+
+TEST_CASE(postWhileRunning)
+{
+    asio::io_service ios;
+    Scheduler scheduler(ios, 2);
+
+    // running jobs post jobs of new tenants from other threads, i.e. the
+    // tenant map grows while running jobs' tenants are referenced
+    std::atomic<int> done(0);
+    const int Tenants(64), Depth(4);
+    std::function<void(int, int)> spawn;
+    spawn = [&](int tenant, int depth)
+    {
+        ++done;
+        if (!depth) { return; }
+        for (int i(0); i < 2; ++i) {
+            const int next(tenant * 2 + i + Tenants);
+            scheduler.post("t" + std::to_string(next), 1 + (next % 3)
+                           , [&spawn, next, depth]()
+                           {
+                               spawn(next, depth - 1);
+                           });
+        }
+    };
+
+    for (int t(0); t < Tenants; ++t) {
+        scheduler.post("t" + std::to_string(t), 1, [&spawn, t]()
+        {
+            spawn(t, Depth);
+        });
+    }
+
+    runAll(ios, 8);
+    CHECK(done == Tenants * ((1 << (Depth + 1)) - 1));
+}
+
+TEST_CASE(throwingJobReleasesSlot)
+{
+    asio::io_service ios;
+    Scheduler scheduler(ios, 1);
+
+    int done(0);
+    scheduler.post("a", 1, []() { throw std::runtime_error("boom"); });
+    scheduler.post("a", 1, [&done]() { ++done; });
+
+    int thrown(0);
+    for (;;) {
+        try {
+            ios.run();
+            break;
+        } catch (const std::runtime_error&) {
+            ++thrown;
+            ios.reset();
+        }
+    }
+
+    CHECK(thrown == 1);
+    CHECK(done == 1);
+}
+
+int main()
+{
+    return testing::run();
+}
@@ -0,0 +1,224 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** Behaviour tests of the host-wide shared memory cache: values stored by
+ *  one process are seen by others and a process dying with the segment
+ *  mutex held makes the next owner start over instead of deadlocking.
+ */
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include <ctime>
+#include <string>
+#include <sstream>
+#include <cstdlib>
+
+// mapproxy stuff
+#include "mapproxy/support/sharedcache.hpp"
+
+#include "testing.hpp"
+
+namespace {
+
+/** Uniquely named segment, unlinked with the instance.
+ */
+struct Segment {
+    SharedCache::Options options;
+
+    Segment(const std::string &name, std::size_t size = 1) {
+        options.name = "test-" + std::to_string(::getpid()) + "-" + name;
+        options.size = size;
+        unlink();
+    }
+
+    ~Segment() { unlink(); }
+
+    std::string path() const { return "/mapproxy-" + options.name; }
+
+    void unlink() const { ::shm_unlink(path().c_str()); }
+};
+
+std::time_t later() { return std::time(nullptr) + 3600; }
+
+void put(SharedCache &cache, const std::string &key
+         , const std::string &value, std::time_t expires = later())
+{
+    cache.put(key, value.data(), value.size(), expires);
+}
+
+bool has(SharedCache &cache, const std::string &key
+         , const std::string &expected)
+{
+    std::string value;
+    return cache.get(key, value) && (value == expected);
+}
+
+/** Runs function in child process, returns true if it exited with
+ *  success.
+ */
+template <typename Function>
+bool inChild(Function function)
+{
+    const auto pid(::fork());
+    if (!pid) { ::_exit(function() ? EXIT_SUCCESS : EXIT_FAILURE); }
+    if (pid < 0) { return false; }
+
+    int status(0);
+    if (::waitpid(pid, &status, 0) != pid) { return false; }
+    return WIFEXITED(status) && (WEXITSTATUS(status) == EXIT_SUCCESS);
+}
+
+std::string counter(const SharedCache &cache, const std::string &name)
+{
+    std::ostringstream os;
+    cache.stat(os, "");
+    const auto s(os.str());
+    const auto start(s.find(name + "="));
+    if (start == std::string::npos) { return {}; }
+    const auto value(start + name.size() + 1);
+    return s.substr(value, s.find('\n', value) - value);
+}
+
+} // namespace
+
+TEST_CASE(putGet)
+{
+    Segment segment("putget");
+    SharedCache cache(segment.options);
+    CHECK(cache.enabled());
+    CHECK(!has(cache, "a", "alpha"));
+
+    const auto expires(later());
+    put(cache, "a", "alpha", expires);
+    std::string value;
+    std::time_t stored(0);
+    CHECK(cache.get("a", value, &stored));
+    CHECK(value == "alpha");
+    CHECK(stored == expires);
+
+    // overwritten in place
+    put(cache, "a", "beta");
+    CHECK(has(cache, "a", "beta"));
+    CHECK(!has(cache, "b", "beta"));
+}
+
+TEST_CASE(disabledWithoutSize)
+{
+    Segment segment("disabled", 0);
+    SharedCache cache(segment.options);
+    CHECK(!cache.enabled());
+    put(cache, "a", "alpha");
+    CHECK(!has(cache, "a", "alpha"));
+}
+
+TEST_CASE(notStored)
+{
+    Segment segment("notstored");
+    SharedCache cache(segment.options);
+
+    // already expired
+    put(cache, "a", "alpha", std::time(nullptr) - 1);
+    CHECK(!has(cache, "a", "alpha"));
+
+    // bigger than quarter of the 1 MB data area
+    const std::string big(300 << 10, 'x');
+    put(cache, "big", big);
+    CHECK(!has(cache, "big", big));
+}
+
+TEST_CASE(startsOverWhenFull)
+{
+    Segment segment("full");
+    SharedCache cache(segment.options);
+
+    // five 200 KB values fit into 1 MB, the sixth one does not
+    for (int i(0); i < 6; ++i) {
+        put(cache, "k" + std::to_string(i)
+            , std::string(200 << 10, char('a' + i)));
+    }
+
+    CHECK(!has(cache, "k0", std::string(200 << 10, 'a')));
+    CHECK(has(cache, "k5", std::string(200 << 10, 'f')));
+    CHECK(counter(cache, "resets") == "1");
+}
+
+TEST_CASE(visibleAcrossProcesses)
+{
+    Segment segment("processes");
+    SharedCache cache(segment.options);
+    put(cache, "parent", "p");
+
+    // child sees parent's value and publishes its own one
+    CHECK(inChild([&]() -> bool {
+                SharedCache child(segment.options);
+                if (!has(child, "parent", "p")) { return false; }
+                put(child, "child", "c");
+                return true;
+            }));
+    CHECK(has(cache, "child", "c"));
+
+    // later process uses existing geometry, content included
+    SharedCache::Options other(segment.options);
+    other.size = 4;
+    SharedCache reopened(other);
+    CHECK(reopened.enabled());
+    CHECK(has(reopened, "child", "c"));
+}
+
+TEST_CASE(ownerDeathRecovered)
+{
+    Segment segment("ownerdead");
+    SharedCache cache(segment.options);
+    put(cache, "a", "alpha");
+
+    // child dies holding the segment mutex, i.e. in the middle of update
+    CHECK(inChild([&]() -> bool {
+                const int fd(::shm_open(segment.path().c_str(), O_RDWR, 0));
+                if (fd < 0) { return false; }
+                auto *base(::mmap(nullptr, sizeof(SharedCache::Header)
+                                  , PROT_READ | PROT_WRITE, MAP_SHARED
+                                  , fd, 0));
+                if (base == MAP_FAILED) { return false; }
+                auto &header(*static_cast<SharedCache::Header*>(base));
+                return !::pthread_mutex_lock(&header.mutex);
+            }));
+
+    // next owner drops possibly torn content and goes on
+    CHECK(!has(cache, "a", "alpha"));
+    CHECK(counter(cache, "resets") == "1");
+
+    put(cache, "b", "beta");
+    CHECK(has(cache, "b", "beta"));
+    CHECK(inChild([&]() -> bool {
+                SharedCache child(segment.options);
+                return has(child, "b", "beta");
+            }));
+}
+
+int main() { return testing::run(); }
@@ -0,0 +1,361 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** Surface tile pipeline benchmark on a fixed corpus of recorded tile DEMs,
+ *  stage by stage and without any GDAL worker: grid sampling (by the
+ *  batched DEM sampler's interpolation kernel), meshing, simplification,
+ *  skirt, coverage mask, VTS mesh conversion and encoding, and the normal map
+ *  chain.
+ *
+ *  Tile DEMs are single channel float TIFFs in the layout produced by
+ *  SurfaceDem::tileDem: 258x258 samples at pixel centers of the 256x256 tile
+ *  plus one pixel around it. Without any input a synthetic tile is used.
+ */
+
+#include <cmath>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <cstdlib>
+#include <sstream>
+#include <iostream>
+
+#include <boost/format.hpp>
+#include <boost/filesystem.hpp>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+
+#include "dbglog/dbglog.hpp"
+
+#include "utility/buildsys.hpp"
+
+#include "service/cmdline.hpp"
+
+#include "geo/normalmap.hpp"
+
+#include "vts-libs/registry/po.hpp"
+#include "vts-libs/vts/nodeinfo.hpp"
+#include "vts-libs/vts/tileop.hpp"
+#include "vts-libs/vts/mesh.hpp"
+
+// mapproxy stuff
+#include "mapproxy/support/mesh.hpp"
+#include "mapproxy/support/srs.hpp"
+#include "mapproxy/support/normalmap.hpp"
+#include "mapproxy/gdalsupport/demsampler.hpp"
+
+namespace po = boost::program_options;
+namespace fs = boost::filesystem;
+
+namespace vts = vtslibs::vts;
+namespace vr = vtslibs::registry;
+
+class SurfaceBench : public service::Cmdline {
+public:
+    SurfaceBench()
+        : service::Cmdline("surface-bench", BUILD_TARGET_VERSION)
+        , edges_(128), iterations_(10)
+    {}
+
+private:
+    void configuration(po::options_description &cmdline
+                       , po::options_description &config
+                       , po::positional_options_description &pd);
+
+    void configure(const po::variables_map &vars);
+
+    bool help(std::ostream &out, const std::string &what) const;
+
+    int run();
+
+    std::string referenceFrame_;
+    vts::TileId tileId_;
+    int edges_;
+    int iterations_;
+    std::vector<fs::path> dems_;
+};
+
+void SurfaceBench::configuration(po::options_description &cmdline
+                                 , po::options_description &config
+                                 , po::positional_options_description &pd)
+{
+    vr::registryConfiguration(config, vr::defaultPath());
+
+    cmdline.add_options()
+        ("referenceFrame", po::value(&referenceFrame_)->required()
+         , "Reference frame.")
+        ("tileId", po::value(&tileId_)->required()
+         , "Tile the corpus is georeferenced to (lod-x-y).")
+        ("edges", po::value(&edges_)->default_value(edges_)->required()
+         , "Mesh grid edges per side.")
+        ("iterations", po::value(&iterations_)
+         ->default_value(iterations_)->required()
+         , "Number of passes over the corpus.")
+        ("dem", po::value(&dems_)
+         , "Recorded tile DEM (float TIFF, 258x258), can be repeated.")
+        ;
+
+    pd.add("dem", -1);
+}
+
+void SurfaceBench::configure(const po::variables_map &vars)
+{
+    vr::registryConfigure(vars);
+}
+
+bool SurfaceBench::help(std::ostream &out, const std::string &what) const
+{
+    if (what.empty()) {
+        out << ("Stage by stage benchmark of the surface tile pipeline on "
+                "recorded tile DEMs.\n");
+        return true;
+    }
+
+    return false;
+}
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+/** Accumulated time of one pipeline stage.
+ */
+struct Stage {
+    const char *name;
+    std::chrono::duration<double, std::milli> elapsed;
+    std::size_t count;
+
+    Stage(const char *name) : name(name), elapsed(), count() {}
+
+    template <typename F>
+    auto operator()(F f) -> decltype(f()) {
+        const struct Scope {
+            Stage &stage;
+            Clock::time_point start;
+            ~Scope() {
+                stage.elapsed += Clock::now() - start;
+                ++stage.count;
+            }
+        } scope{ *this, Clock::now() };
+        return f();
+    }
+};
+
+cv::Mat loadDem(const fs::path &path)
+{
+    auto dem(cv::imread(path.string(), cv::IMREAD_UNCHANGED));
+    if (dem.empty() || (dem.channels() != 1)) {
+        LOGTHROW(err2, std::runtime_error)
+            << "Cannot load single channel DEM from " << path << ".";
+    }
+    if (dem.type() != CV_32FC1) { dem.convertTo(dem, CV_32FC1); }
+    return dem;
+}
+
+cv::Mat syntheticDem()
+{
+    cv::Mat dem(258, 258, CV_32FC1);
+    for (int j(0); j < dem.rows; ++j) {
+        for (int i(0); i < dem.cols; ++i) {
+            const double x(i / 257.0), y(j / 257.0);
+            dem.at<float>(j, i) = 100.0
+                * (std::sin(7.0 * x) * std::cos(5.0 * y)
+                   + 0.3 * std::sin(23.0 * x + 17.0 * y));
+        }
+    }
+    return dem;
+}
+
+/** Tile DEMs carry no nodata.
+ */
+const double Nodata(-1e10);
+
+/** Grid coordinates of mesh grid vertices in tile DEM, row by row (same
+ *  layout as the surface-dem generator's mesh grid).
+ */
+struct GridPoints {
+    std::vector<double> col;
+    std::vector<double> row;
+
+    GridPoints(const cv::Mat &dem, int edges) {
+        const double step(double(dem.cols - 2) / edges);
+        for (int j(0); j <= edges; ++j) {
+            for (int i(0); i <= edges; ++i) {
+                col.push_back(i * step + 0.5);
+                row.push_back(j * step + 0.5);
+            }
+        }
+    }
+
+    std::size_t size() const { return col.size(); }
+};
+
+} // namespace
+
+int SurfaceBench::run()
+{
+    const vts::NodeInfo nodeInfo
+        (vr::system.referenceFrames(referenceFrame_), tileId_);
+    const TileFacesCalculator tileFacesCalculator;
+
+    std::vector<cv::Mat> corpus;
+    for (const auto &path : dems_) { corpus.push_back(loadDem(path)); }
+    if (corpus.empty()) { corpus.push_back(syntheticDem()); }
+
+    const auto conv(sds2phys(nodeInfo, boost::none));
+    auto [ll, lr, ul, ur] = physicalCorners(nodeInfo, boost::none);
+    const TangentialPlaneConvertor extraConv
+        (vr::system.srs(nodeInfo.referenceFrame().model.physicalSrs).srsDef
+         , 0.5 * (ul + ur - ll - lr));
+
+    const auto es(math::size(nodeInfo.extents()));
+    const math::Size2f pixelSize(es.width / 256, es.height / 256);
+
+    geo::normalmap::Parameters params;
+    params.algorithm = geo::normalmap::Algorithm::zevenbergenThorne;
+    params.viewspaceRf = true; params.invertRelief = false;
+    params.zFactor = 1.0;
+
+    Stage grid("grid"), mesh("meshFromNode"), simplify("simplifyMesh")
+        , skirt("addSkirt"), coverage("meshCoverageMask")
+        , submesh("addSubMesh"), save("saveMeshProper")
+        , normals("demNormals"), native("nativeDemNormals")
+        , convert("convertNormals")
+        , oct("encodeOct"), bgr("exportToBGR"), fused("exportNormals");
+
+    std::size_t faces(0), bytes(0);
+
+    for (int it(0); it < iterations_; ++it) {
+        for (const auto &dem : corpus) {
+            cv::Mat dem64;
+            dem.convertTo(dem64, CV_64F);
+            const GridPoints points(dem, edges_);
+
+            // mesh chain
+            const auto heights(grid([&]() {
+                const DemSampler::Grid g{ dem64.ptr<double>(), dem64.cols
+                                          , dem64.rows, dem64.step1()
+                                          , Nodata };
+                std::vector<double> z(points.size());
+                DemSampler::interpolate(g, points.size(), points.col.data()
+                                        , points.row.data(), z.data());
+                return z;
+            }));
+            const int stride(edges_ + 1);
+
+            auto lm(mesh([&]() {
+                return meshFromNode
+                    (nodeInfo, math::Size2(edges_, edges_)
+                     , [&](int i, int j, double &h) -> bool
+                {
+                    h = heights[j * stride + i];
+                    return true;
+                });
+            }));
+
+            simplify([&]() {
+                simplifyMesh(lm.mesh, nodeInfo, tileFacesCalculator
+                             , boost::none);
+            });
+            faces += lm.mesh.faces.size();
+
+            skirt([&]() { addSkirt(lm.mesh, nodeInfo); });
+
+            vts::Mesh out(false);
+            coverage([&]() {
+                meshCoverageMask(out.coverageMask, lm, nodeInfo);
+            });
+
+            submesh([&]() {
+                addSubMesh(out, lm.mesh, nodeInfo, boost::none);
+            });
+
+            save([&]() {
+                std::ostringstream os;
+                vts::saveMeshProper(os, out);
+                bytes += os.tellp();
+            });
+
+            // normal map chain
+            imgproc::RasterMask flatMask
+                (dem64.cols, dem64.rows, imgproc::RasterMask::EMPTY);
+            imgproc::quadtree::RasterMask inversionMask
+                (dem64.cols, dem64.rows
+                 , imgproc::quadtree::RasterMask::EMPTY);
+
+            auto nm(normals([&]() {
+                return geo::normalmap::demNormals<double>
+                    (dem64, pixelSize, params, flatMask, inversionMask);
+            }));
+
+            cv::Mat nativeNm;
+            native([&]() {
+                return nativeDemNormals(dem, nativeNm, pixelSize, params
+                                        , flatMask, inversionMask);
+            });
+
+            cv::Mat tmp(nm.clone());
+            convert([&]() {
+                geo::normalmap::convertNormals
+                    (tmp, nodeInfo.extents(), conv.conv(), extraConv, true);
+            });
+            oct([&]() { geo::normalmap::encodeOct(tmp); });
+            bgr([&]() { return geo::normalmap::exportToBGR(tmp); });
+
+            fused([&]() {
+                return exportNormals(nm, nodeInfo.extents(), conv, extraConv
+                                     , NormalRotation::perTile);
+            });
+        }
+    }
+
+    std::cout << boost::format("%d tiles x %d passes, %.1f faces/tile, "
+                               "%.1f bytes/mesh\n")
+        % corpus.size() % iterations_
+        % (double(faces) / (corpus.size() * iterations_))
+        % (double(bytes) / (corpus.size() * iterations_));
+
+    double total(0.0);
+    for (const auto *stage : { &grid, &mesh, &simplify, &skirt, &coverage
+                 , &submesh, &save, &normals, &native, &convert, &oct
+                 , &bgr, &fused })
+    {
+        const auto ms(stage->elapsed.count() / stage->count);
+        if ((stage != &fused) && (stage != &native)) { total += ms; }
+        std::cout << boost::format("%-18s %9.3f ms/tile\n")
+            % stage->name % ms;
+    }
+    std::cout << boost::format("%-18s %9.3f ms/tile\n")
+        % "total (chained)" % total;
+
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[])
+{
+    return SurfaceBench()(argc, argv);
+}
@@ -0,0 +1,111 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef mapproxy_test_testing_hpp_included_
+#define mapproxy_test_testing_hpp_included_
+
+/** Minimal support for behaviour tests: every test program registers its
+ *  cases by TEST_CASE(name) and runs them all from main() by
+ *  testing::run(); a failed CHECK logs its location and fails the case,
+ *  runner returns EXIT_FAILURE if any case failed (i.e. ctest fails).
+ */
+
+#include <vector>
+#include <string>
+#include <sstream>
+#include <cstdlib>
+#include <exception>
+#include <functional>
+
+#include "dbglog/dbglog.hpp"
+
+namespace testing {
+
+struct Failure : std::exception {
+    std::string message;
+    Failure(const std::string &message) : message(message) {}
+    const char* what() const noexcept { return message.c_str(); }
+};
+
+struct Case {
+    std::string name;
+    std::function<void()> run;
+};
+
+inline std::vector<Case>& cases()
+{
+    static std::vector<Case> cases;
+    return cases;
+}
+
+struct Register {
+    Register(const std::string &name, std::function<void()> run) {
+        cases().push_back({ name, std::move(run) });
+    }
+};
+
+inline int run()
+{
+    int failed(0);
+    for (const auto &c : cases()) {
+        try {
+            c.run();
+            LOG(info4) << "[ OK ] " << c.name;
+        } catch (const std::exception &e) {
+            LOG(err4) << "[FAIL] " << c.name << ": " << e.what();
+            ++failed;
+        }
+    }
+
+    LOG(info4) << (cases().size() - failed) << "/" << cases().size()
+               << " test cases passed.";
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+} // namespace testing
+
+#define TEST_CASE_CAT2(a, b) a##b
+#define TEST_CASE_CAT(a, b) TEST_CASE_CAT2(a, b)
+
+/** Defines and registers test case.
+ */
+#define TEST_CASE(name)                                                 \
+    void TEST_CASE_CAT(testCase_, name)();                              \
+    namespace { testing::Register TEST_CASE_CAT(testRegister_, name)    \
+        (#name, &TEST_CASE_CAT(testCase_, name)); }                      \
+    void TEST_CASE_CAT(testCase_, name)()
+
+/** Fails current test case if condition does not hold.
+ */
+#define CHECK(cond) do {                                                \
+        if (!(cond)) {                                                  \
+            std::ostringstream os;                                      \
+            os << __FILE__ << ":" << __LINE__ << ": " << #cond;         \
+            throw testing::Failure(os.str());                           \
+        }                                                               \
+    } while (false)
+
+#endif // mapproxy_test_testing_hpp_included_
@@ -0,0 +1,259 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** Lookup latency of mmapped::TileIndex on a real delivery index (random,
+ *  Morton-ordered and metatile-block access). Round-trip check of the
+ *  on-disk formats lives in tileindex-test.
+ */
+
+#include <cmath>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <cstdlib>
+#include <iostream>
+
+#include <boost/format.hpp>
+#include <boost/filesystem.hpp>
+
+#include "dbglog/dbglog.hpp"
+
+#include "utility/buildsys.hpp"
+
+#include "service/cmdline.hpp"
+
+#include "vts-libs/vts/tileindex.hpp"
+#include "vts-libs/vts/tileop.hpp"
+
+// mapproxy stuff
+#include "mapproxy/support/mmapped/tileindex.hpp"
+
+namespace po = boost::program_options;
+namespace fs = boost::filesystem;
+
+namespace vts = vtslibs::vts;
+
+class TileIndexBench : public service::Cmdline {
+public:
+    TileIndexBench()
+        : service::Cmdline("tileindex-bench", BUILD_TARGET_VERSION)
+        , lookups_(1000000), metaBinaryOrder_(5), seed_(42)
+    {}
+
+private:
+    void configuration(po::options_description &cmdline
+                       , po::options_description &config
+                       , po::positional_options_description &pd);
+
+    void configure(const po::variables_map &vars);
+
+    bool help(std::ostream &out, const std::string &what) const;
+
+    int run();
+
+    void bench() const;
+
+    fs::path tileIndex_;
+    std::size_t lookups_;
+    unsigned int metaBinaryOrder_;
+    unsigned int seed_;
+};
+
+void TileIndexBench::configuration(po::options_description &cmdline
+                                   , po::options_description &config
+                                   , po::positional_options_description &pd)
+{
+    cmdline.add_options()
+        ("tileIndex", po::value(&tileIndex_)->required()
+         , "Mmapped tile index (e.g. delivery index) to benchmark.")
+        ("lookups", po::value(&lookups_)->default_value(lookups_)
+         ->required(), "Number of lookups per access pattern.")
+        ("metaBinaryOrder", po::value(&metaBinaryOrder_)
+         ->default_value(metaBinaryOrder_)->required()
+         , "Metatile binary order for metatile-block access.")
+        ("seed", po::value(&seed_)->default_value(seed_)->required()
+         , "Random seed.")
+        ;
+
+    pd.add("tileIndex", 1);
+
+    (void) config;
+}
+
+void TileIndexBench::configure(const po::variables_map &vars)
+{
+    (void) vars;
+}
+
+bool TileIndexBench::help(std::ostream &out, const std::string &what) const
+{
+    if (what.empty()) {
+        out << ("Benchmark of mmapped tile index.\n");
+        return true;
+    }
+
+    return false;
+}
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+template <typename F>
+double measure(std::size_t count, F f)
+{
+    const auto start(Clock::now());
+    f();
+    const std::chrono::duration<double, std::nano>
+        elapsed(Clock::now() - start);
+    return elapsed.count() / std::max(count, std::size_t(1));
+}
+
+/** Extracts even bits of Morton code.
+ */
+std::uint32_t compact(std::uint32_t v)
+{
+    v &= 0x55555555;
+    v = (v | (v >> 1)) & 0x33333333;
+    v = (v | (v >> 2)) & 0x0f0f0f0f;
+    v = (v | (v >> 4)) & 0x00ff00ff;
+    v = (v | (v >> 8)) & 0x0000ffff;
+    return v;
+}
+
+// keeps results alive
+volatile unsigned int sinkhole;
+
+} // namespace
+
+void TileIndexBench::bench() const
+{
+    const mmapped::TileIndex ti(tileIndex_);
+    if (!ti.lodCount()) {
+        std::cout << "Empty tile index.\n";
+        return;
+    }
+
+    const vts::Lod bottom(ti.lodCount() - 1);
+    std::mt19937 gen(seed_);
+
+    // random: uniform lod, uniform tile in lod
+    {
+        std::uniform_int_distribution<int> lodDist(0, bottom);
+        std::vector<vts::TileId> tiles;
+        tiles.reserve(lookups_);
+        for (std::size_t i(0); i < lookups_; ++i) {
+            const vts::Lod lod(lodDist(gen));
+            std::uniform_int_distribution<unsigned int>
+                dist(0, (1u << lod) - 1);
+            tiles.emplace_back(lod, dist(gen), dist(gen));
+        }
+
+        unsigned int acc(0);
+        const auto getNs(measure(tiles.size(), [&]() {
+            for (const auto &tileId : tiles) { acc += ti.get(tileId); }
+        }));
+        const auto subtreeNs(measure(tiles.size(), [&]() {
+            for (const auto &tileId : tiles) {
+                acc += ti.validSubtree(tileId);
+            }
+        }));
+        sinkhole = acc;
+
+        std::cout << boost::format("random: get %.1f ns, validSubtree "
+                                   "%.1f ns\n") % getNs % subtreeNs;
+    }
+
+    // morton: z-order walk of the bottom lod (first lookups_ tiles)
+    {
+        const std::uint64_t count
+            (std::min<std::uint64_t>(lookups_, std::uint64_t(1)
+                                     << (2 * std::min(bottom, vts::Lod(16)))));
+        unsigned int acc(0);
+        const auto getNs(measure(count, [&]() {
+            for (std::uint64_t m(0); m < count; ++m) {
+                acc += ti.get(vts::TileId(bottom, compact(std::uint32_t(m))
+                                         , compact(std::uint32_t(m >> 1))));
+            }
+        }));
+        sinkhole = acc;
+
+        std::cout << boost::format("morton (lod %d): get %.1f ns\n")
+            % bottom % getNs;
+    }
+
+    // metatile block: every tile of a metatile and its 4 children, as
+    // metatile generation does
+    {
+        const auto order(std::min(metaBinaryOrder_, unsigned(bottom)));
+        const unsigned int metaSize(1u << order);
+        const unsigned int perMeta(metaSize * metaSize);
+        const std::size_t metatiles
+            (std::max<std::size_t>(1, lookups_ / (5 * perMeta)));
+
+        std::uniform_int_distribution<int> lodDist(order, bottom);
+        std::vector<vts::TileId> metaIds;
+        for (std::size_t i(0); i < metatiles; ++i) {
+            const vts::Lod lod(lodDist(gen));
+            std::uniform_int_distribution<unsigned int>
+                dist(0, (1u << (lod - order)) - 1);
+            metaIds.emplace_back(lod, dist(gen) << order
+                                 , dist(gen) << order);
+        }
+
+        unsigned int acc(0);
+        const auto ns(measure(metatiles * perMeta * 5, [&]() {
+            for (const auto &metaId : metaIds) {
+                for (unsigned int j(0); j < metaSize; ++j) {
+                    for (unsigned int i(0); i < metaSize; ++i) {
+                        const vts::TileId tileId
+                            (metaId.lod, metaId.x + i, metaId.y + j);
+                        acc += ti.get(tileId);
+                        for (const auto &child : vts::children(tileId)) {
+                            acc += ti.validSubtree(child);
+                        }
+                    }
+                }
+            }
+        }));
+        sinkhole = acc;
+
+        std::cout << boost::format("metatile block (%dx%d): %.1f ns per "
+                                   "query, %.3f ms per metatile\n")
+            % metaSize % metaSize % ns % (ns * perMeta * 5 * 1e-6);
+    }
+}
+
+int TileIndexBench::run()
+{
+    bench();
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[])
+{
+    return TileIndexBench()(argc, argv);
+}
@@ -0,0 +1,179 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** Behaviour tests of mmapped tile index: randomized round-trip of
+ *  mmapped::TileIndex::write and the reader against vts::TileIndex in all
+ *  on-disk formats (incl. LOUDS encoded qtree v2).
+ */
+
+#include <random>
+#include <utility>
+
+#include <boost/filesystem.hpp>
+
+#include "dbglog/dbglog.hpp"
+
+#include "vts-libs/vts/tileindex.hpp"
+
+// mapproxy stuff
+#include "mapproxy/support/mmapped/tileindex.hpp"
+
+#include "testing.hpp"
+
+namespace fs = boost::filesystem;
+namespace vts = vtslibs::vts;
+
+namespace {
+
+/** Flags mmapped index can hold.
+ */
+const vts::TileIndex::Flag::value_type Values[] = {
+    vts::TileIndex::Flag::none
+    , vts::TileIndex::Flag::mesh
+    , vts::TileIndex::Flag::mesh | vts::TileIndex::Flag::watertight
+    , vts::TileIndex::Flag::mesh | vts::TileIndex::Flag::navtile
+    , (vts::TileIndex::Flag::mesh | vts::TileIndex::Flag::watertight
+       | vts::TileIndex::Flag::navtile)
+};
+
+/** Random index: random rectangles of random flags at each lod down to
+ *  bottom.
+ */
+vts::TileIndex randomIndex(std::mt19937 &gen, vts::Lod bottom)
+{
+    vts::TileIndex ti;
+    std::uniform_int_distribution<int> valueDist(0, 4);
+    for (vts::Lod lod(0); lod <= bottom; ++lod) {
+        const unsigned int size(1u << lod);
+        std::uniform_int_distribution<unsigned int> dist(0, size - 1);
+        std::uniform_int_distribution<int> countDist(0, 2 + lod * 2);
+        for (int r(countDist(gen)); r > 0; --r) {
+            auto x0(dist(gen)), x1(dist(gen));
+            auto y0(dist(gen)), y1(dist(gen));
+            if (x0 > x1) { std::swap(x0, x1); }
+            if (y0 > y1) { std::swap(y0, y1); }
+            ti.set(lod, vts::TileRange(x0, y0, x1, y1)
+                   , Values[valueDist(gen)]);
+        }
+    }
+    return ti;
+}
+
+/** Any tile in subtree of tileId (inclusive) down to bottom is set.
+ */
+bool validSubtree(const vts::TileIndex &ti, const vts::TileId &tileId
+                  , vts::Lod bottom)
+{
+    for (vts::Lod l(tileId.lod); l <= bottom; ++l) {
+        const auto shift(l - tileId.lod);
+        for (unsigned int y(tileId.y << shift), ey((tileId.y + 1) << shift);
+             y < ey; ++y)
+        {
+            for (unsigned int x(tileId.x << shift)
+                     , ex((tileId.x + 1) << shift);
+                 x < ex; ++x)
+            {
+                if (ti.get(vts::TileId(l, x, y))) { return true; }
+            }
+        }
+    }
+    return false;
+}
+
+/** Writes index in given format version, reads it back and checks every
+ *  tile down to bottom.
+ */
+void roundTrip(const vts::TileIndex &ti, vts::Lod bottom
+               , unsigned int version)
+{
+    const auto path(fs::temp_directory_path()
+                    / fs::unique_path("tileindex-test-%%%%-%%%%.mmti"));
+    mmapped::TileIndex::write(path, ti, version);
+
+    {
+        const mmapped::TileIndex mti(path);
+        for (vts::Lod lod(0); lod <= bottom; ++lod) {
+            const unsigned int size(1u << lod);
+            for (unsigned int y(0); y < size; ++y) {
+                for (unsigned int x(0); x < size; ++x) {
+                    const vts::TileId tileId(lod, x, y);
+                    CHECK(mti.get(tileId)
+                          == mmapped::TileFlag::value_type(ti.get(tileId)));
+                    CHECK(mti.validSubtree(tileId)
+                          == validSubtree(ti, tileId, bottom));
+                }
+            }
+        }
+    }
+
+    fs::remove(path);
+}
+
+void randomRoundTrips(unsigned int version)
+{
+    std::mt19937 gen(42);
+    std::uniform_int_distribution<int> lodDist(0, 7);
+    for (int round(0); round < 20; ++round) {
+        const vts::Lod bottom(lodDist(gen));
+        roundTrip(randomIndex(gen, bottom), bottom, version);
+    }
+}
+
+} // namespace
+
+TEST_CASE(randomRoundTripV1)
+{
+    randomRoundTrips(1);
+}
+
+TEST_CASE(randomRoundTripLouds)
+{
+    // qtree v2: LOUDS encoded tree
+    randomRoundTrips(2);
+}
+
+TEST_CASE(emptyIndexRoundTrip)
+{
+    for (unsigned int version(1); version <= mmapped::QTree::formatVersion;
+         ++version)
+    {
+        roundTrip(vts::TileIndex(), 3, version);
+    }
+}
+
+TEST_CASE(fullLodRoundTrip)
+{
+    // single full lod below empty ones
+    vts::TileIndex ti;
+    ti.set(5, vts::TileRange(0, 0, 31, 31), vts::TileIndex::Flag::mesh);
+    for (unsigned int version(1); version <= mmapped::QTree::formatVersion;
+         ++version)
+    {
+        roundTrip(ti, 6, version);
+    }
+}
+
+int main() { return testing::run(); }
@@ -0,0 +1,197 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** Parsing latency of urlparse fast paths and of their reference
+ *  implementations (boost split, vts::parseTileIdPrefix). Equivalence of
+ *  both is checked by urlparse-test.
+ */
+
+#include <chrono>
+#include <vector>
+#include <string>
+#include <cstdlib>
+#include <iostream>
+#include <algorithm>
+
+#include <boost/format.hpp>
+
+#include "dbglog/dbglog.hpp"
+
+#include "utility/buildsys.hpp"
+
+#include "service/cmdline.hpp"
+
+#include "vts-libs/vts/tileop.hpp"
+
+// mapproxy stuff
+#include "mapproxy/support/urlparse.hpp"
+
+#include "urlparse-inputs.hpp"
+
+namespace po = boost::program_options;
+
+namespace vts = vtslibs::vts;
+
+class UrlParseBench : public service::Cmdline {
+public:
+    UrlParseBench()
+        : service::Cmdline("urlparse-bench", BUILD_TARGET_VERSION)
+        , iterations_(1000000), seed_(42)
+    {}
+
+private:
+    void configuration(po::options_description &cmdline
+                       , po::options_description &config
+                       , po::positional_options_description &pd);
+
+    void configure(const po::variables_map &vars);
+
+    bool help(std::ostream &out, const std::string &what) const;
+
+    int run();
+
+    void bench() const;
+
+    std::size_t iterations_;
+    unsigned int seed_;
+};
+
+void UrlParseBench::configuration(po::options_description &cmdline
+                                  , po::options_description &config
+                                  , po::positional_options_description &pd)
+{
+    cmdline.add_options()
+        ("iterations", po::value(&iterations_)
+         ->default_value(iterations_)->required()
+         , "Number of parsed inputs per benchmark.")
+        ("seed", po::value(&seed_)->default_value(seed_)->required()
+         , "Random seed.")
+        ;
+
+    (void) config;
+    (void) pd;
+}
+
+void UrlParseBench::configure(const po::variables_map &vars)
+{
+    (void) vars;
+}
+
+bool UrlParseBench::help(std::ostream &out, const std::string &what) const
+{
+    if (what.empty()) {
+        out << ("Benchmark of request path parsing.\n");
+        return true;
+    }
+
+    return false;
+}
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+template <typename F>
+double measure(std::size_t count, F f)
+{
+    const auto start(Clock::now());
+    f();
+    const std::chrono::duration<double, std::nano>
+        elapsed(Clock::now() - start);
+    return elapsed.count() / std::max(count, std::size_t(1));
+}
+
+// keeps results alive
+volatile std::size_t sinkhole;
+
+} // namespace
+
+void UrlParseBench::bench() const
+{
+    using urlparse_inputs::referenceSplit;
+    urlparse_inputs::Inputs gen(seed_);
+
+    {
+        std::vector<std::string> paths;
+        paths.reserve(iterations_);
+        for (std::size_t i(0); i < iterations_; ++i) {
+            paths.push_back(gen.path());
+        }
+
+        std::size_t acc(0);
+        const auto fastNs(measure(paths.size(), [&]() {
+            for (const auto &path : paths) {
+                acc += urlparse::split(path).size;
+            }
+        }));
+        const auto referenceNs(measure(paths.size(), [&]() {
+            for (const auto &path : paths) {
+                acc += referenceSplit(path).size();
+            }
+        }));
+        sinkhole = acc;
+
+        std::cout << boost::format("split: fast %.1f ns, reference %.1f ns\n")
+            % fastNs % referenceNs;
+    }
+
+    {
+        std::vector<std::string> filenames;
+        filenames.reserve(iterations_);
+        for (std::size_t i(0); i < iterations_; ++i) {
+            filenames.push_back(gen.filename());
+        }
+
+        std::size_t acc(0);
+        const auto fastNs(measure(filenames.size(), [&]() {
+            vts::TileId tileId;
+            for (const auto &filename : filenames) {
+                acc += bool(urlparse::parseTileIdPrefix(tileId, filename));
+            }
+        }));
+        const auto referenceNs(measure(filenames.size(), [&]() {
+            vts::TileId tileId;
+            for (const auto &filename : filenames) {
+                acc += bool(vts::parseTileIdPrefix(tileId, filename));
+            }
+        }));
+        sinkhole = acc;
+
+        std::cout << boost::format("tileId: fast %.1f ns, reference "
+                                   "%.1f ns\n") % fastNs % referenceNs;
+    }
+}
+
+int UrlParseBench::run()
+{
+    bench();
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[])
+{
+    return UrlParseBench()(argc, argv);
+}
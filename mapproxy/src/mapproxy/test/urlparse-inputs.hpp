@@ -0,0 +1,118 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef mapproxy_test_urlparse_inputs_hpp_included_
+#define mapproxy_test_urlparse_inputs_hpp_included_
+
+/** Random request path pieces shared by urlparse test and benchmark.
+ */
+
+#include <random>
+#include <vector>
+#include <string>
+
+#include <boost/algorithm/string/split.hpp>
+#include <boost/algorithm/string/classification.hpp>
+
+namespace urlparse_inputs {
+
+/** Random input generator. Mixes well-formed and malformed pieces.
+ */
+class Inputs {
+public:
+    Inputs(unsigned int seed) : gen_(seed) {}
+
+    std::string path() {
+        static const std::vector<std::string> pieces = {
+            "", "melown2015", "tms", "surface", "geodata", "terrain", "wmts"
+            , "group", "id", "index.html", "mapConfig.json", "1-2-3.jpg"
+            , "tileset.conf"
+        };
+
+        std::string path;
+        const auto count(pick(9));
+        for (unsigned int i(0); i < count; ++i) {
+            if (pick(2)) { path.push_back('/'); }
+            if (!pick(4)) { path.push_back('/'); }
+            path.append(pieces[pick(pieces.size())]);
+        }
+        return path;
+    }
+
+    std::string filename() {
+        static const std::vector<std::string> numbers = {
+            "0", "1", "7", "21", "255", "0001", "-1", "+3", " 4", "x"
+            , "4294967295", "4294967296", "99999999999999999999", ""
+        };
+        static const std::vector<std::string> extensions = {
+            "jpg", "png", "mask", "meta", "bin", "json", "", "jpg.gz"
+        };
+
+        std::string filename;
+        filename.append(pick(5) ? std::to_string(pick(32))
+                        : numbers[pick(numbers.size())]);
+        filename.push_back(pick(8) ? '-' : '_');
+        filename.append(pick(5) ? std::to_string(pick(1 << 20))
+                        : numbers[pick(numbers.size())]);
+        filename.push_back(pick(8) ? '-' : '.');
+        filename.append(pick(5) ? std::to_string(pick(1 << 20))
+                        : numbers[pick(numbers.size())]);
+        if (pick(8)) { filename.push_back('.'); }
+        filename.append(extensions[pick(extensions.size())]);
+        return filename;
+    }
+
+    /** Picks one of names, occasionally with one character mangled.
+     */
+    std::string name(const std::vector<std::string> &names) {
+        auto name(names[pick(names.size())]);
+        if (!pick(8) && !name.empty()) {
+            name[pick(name.size())] ^= 0x20;
+        }
+        return name;
+    }
+
+private:
+    unsigned int pick(std::size_t limit) {
+        return std::uniform_int_distribution<std::size_t>(0, limit - 1)(gen_);
+    }
+
+    std::mt19937 gen_;
+};
+
+/** Reference implementation of urlparse::split.
+ */
+inline std::vector<std::string> referenceSplit(const std::string &path)
+{
+    namespace ba = boost::algorithm;
+    std::vector<std::string> components;
+    ba::split(components, path, ba::is_any_of("/"), ba::token_compress_on);
+    return components;
+}
+
+} // namespace urlparse_inputs
+
+#endif // mapproxy_test_urlparse_inputs_hpp_included_
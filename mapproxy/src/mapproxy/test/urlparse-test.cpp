@@ -0,0 +1,172 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** Behaviour tests of urlparse fast paths: randomized equivalence with
+ *  their reference implementations (boost split, vts::parseTileIdPrefix,
+ *  enum lexical casts). Fast path may decline an input (caller falls back
+ *  to the reference), it must never disagree with the reference.
+ */
+
+#include <vector>
+#include <string>
+#include <algorithm>
+
+#include <boost/lexical_cast.hpp>
+
+#include "dbglog/dbglog.hpp"
+
+#include "utility/enum-io.hpp"
+
+#include "vts-libs/vts/tileop.hpp"
+
+// mapproxy stuff
+#include "mapproxy/support/urlparse.hpp"
+
+#include "urlparse-inputs.hpp"
+#include "testing.hpp"
+
+namespace vts = vtslibs::vts;
+
+using urlparse_inputs::Inputs;
+using urlparse_inputs::referenceSplit;
+
+namespace {
+
+/** Random inputs per check.
+ */
+const std::size_t Checks(100000);
+
+template <typename E>
+void addNames(std::vector<std::string> &names)
+{
+    for (auto value : enumerationValues(E())) {
+        names.push_back(boost::lexical_cast<std::string>(value));
+    }
+}
+
+/** Fast lookup hit must equal lexical cast; hit on input rejected by
+ *  lexical cast is a failure. Returns number of failures.
+ */
+template <typename T, typename Lookup>
+std::size_t checkLookup(std::vector<std::string> names, Lookup lookup)
+{
+    names.push_back("");
+    names.push_back("unknown");
+
+    Inputs gen(42);
+    std::size_t failures(0);
+    for (std::size_t i(0); i < Checks; ++i) {
+        const auto name(gen.name(names));
+
+        T fast;
+        if (!lookup(name, fast)) { continue; }
+
+        T reference;
+        if (!(boost::conversion::try_lexical_convert(name, reference)
+              && (fast == reference)))
+        {
+            LOG(err2) << "Lookup of <" << name << "> differs.";
+            ++failures;
+        }
+    }
+    return failures;
+}
+
+} // namespace
+
+TEST_CASE(splitMatchesReference)
+{
+    Inputs gen(42);
+    std::size_t failures(0);
+    for (std::size_t i(0); i < Checks; ++i) {
+        const auto path(gen.path());
+        const auto fast(urlparse::split(path));
+        const auto reference(referenceSplit(path));
+
+        bool same(fast.size == reference.size());
+        for (std::size_t c(0), e(std::min(fast.size, fast.Max));
+             same && (c < e); ++c)
+        {
+            same = (fast[c] == reference[c]);
+        }
+
+        if (!same) {
+            LOG(err2) << "Split of <" << path << "> differs.";
+            ++failures;
+        }
+    }
+    CHECK(!failures);
+}
+
+TEST_CASE(tileIdPrefixMatchesReference)
+{
+    Inputs gen(42);
+    std::size_t failures(0);
+    for (std::size_t i(0); i < Checks; ++i) {
+        const auto filename(gen.filename());
+
+        vts::TileId fast;
+        const auto *fastExt(urlparse::parseTileIdPrefix(fast, filename));
+        if (!fastExt) { continue; }
+
+        vts::TileId reference;
+        const auto *referenceExt
+            (vts::parseTileIdPrefix(reference, filename));
+        if ((fastExt != referenceExt) || !(fast == reference)) {
+            LOG(err2) << "Tile id prefix of <" << filename << "> differs.";
+            ++failures;
+        }
+    }
+    CHECK(!failures);
+}
+
+TEST_CASE(interfaceLookupMatchesCast)
+{
+    std::vector<std::string> names;
+    addNames<GeneratorInterface::Type>(names);
+    names.push_back("terrain");
+    names.push_back("wmts");
+
+    CHECK(!checkLookup<GeneratorInterface>
+          (names, [](const std::string &name, GeneratorInterface &value)
+    {
+        return urlparse::generatorInterface(name, value);
+    }));
+}
+
+TEST_CASE(rasterFormatLookupMatchesCast)
+{
+    std::vector<std::string> names;
+    addNames<RasterFormat>(names);
+
+    CHECK(!checkLookup<RasterFormat>
+          (names, [](const std::string &name, RasterFormat &value)
+    {
+        return urlparse::rasterFormat(name, value);
+    }));
+}
+
+int main() { return testing::run(); }
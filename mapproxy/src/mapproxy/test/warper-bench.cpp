@@ -0,0 +1,423 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** Round-trip benchmark of the GDAL warper IPC without daemon or HTTP
+ *  stack: N client threads send trivial work requests (job), asynchronous
+ *  trivial work requests (async) and small warps of an in-memory dataset
+ *  (warp), one at a time per thread.
+ *
+ *  Work requests record when the worker picked them up and when it was
+ *  done, so that the round-trip splits into dispatch (client lock, queue,
+ *  worker wakeup) and return (result handover, client wakeup). Contention
+ *  on the warper mutex shows up in dispatch, missed notifications as
+ *  ~500 ms spikes in the tail of return.
+ */
+
+#include <mutex>
+#include <chrono>
+#include <atomic>
+#include <future>
+#include <thread>
+#include <vector>
+#include <string>
+#include <cstdlib>
+#include <iostream>
+#include <algorithm>
+
+#include <boost/format.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/algorithm/string/split.hpp>
+#include <boost/algorithm/string/classification.hpp>
+
+#include <gdal_priv.h>
+#include <ogr_spatialref.h>
+
+#include "dbglog/dbglog.hpp"
+
+#include "utility/buildsys.hpp"
+#include "utility/runnable.hpp"
+
+#include "service/cmdline.hpp"
+
+// mapproxy stuff
+#include "mapproxy/gdalsupport.hpp"
+#include "mapproxy/gdalsupport/workrequest.hpp"
+#include "mapproxy/gdalsupport/latency.hpp"
+
+namespace po = boost::program_options;
+namespace ba = boost::algorithm;
+
+class WarperBench : public service::Cmdline
+                  , public utility::Runnable
+{
+public:
+    WarperBench()
+        : service::Cmdline("warper-bench", BUILD_TARGET_VERSION)
+        , threads_("1,2,4,8"), modes_("job,async,warp")
+        , requests_(2000), size_(64), running_(true)
+    {
+        options_.processCount = 4;
+        options_.tmpRoot = "/tmp";
+        // distinct requests anyway, do not pay for the coalescing lookup
+        options_.coalesce = false;
+    }
+
+    bool isRunning() override { return running_; }
+    void stop() override { running_ = false; }
+
+private:
+    void configuration(po::options_description &cmdline
+                       , po::options_description &config
+                       , po::positional_options_description &pd);
+
+    void configure(const po::variables_map &vars);
+
+    bool help(std::ostream &out, const std::string &what) const;
+
+    int run();
+
+    GdalWarper::Options options_;
+    std::string threads_;
+    std::string modes_;
+    std::size_t requests_;
+    int size_;
+    std::atomic<bool> running_;
+};
+
+void WarperBench::configuration(po::options_description &cmdline
+                                , po::options_description &config
+                                , po::positional_options_description &pd)
+{
+    cmdline.add_options()
+        ("backend", po::value(&options_.backend)
+         ->default_value(options_.backend)->required()
+         , "Warper backend: process or threads.")
+        ("workers", po::value(&options_.processCount)
+         ->default_value(options_.processCount)->required()
+         , "Number of GDAL workers.")
+        ("affinity", po::value(&options_.affinity)
+         ->default_value(options_.affinity)->required()
+         , "Route requests to workers by dataset.")
+        ("threads", po::value(&threads_)->default_value(threads_)
+         ->required(), "Comma-separated numbers of client threads, one "
+         "round per number.")
+        ("modes", po::value(&modes_)->default_value(modes_)->required()
+         , "Comma-separated request kinds: job, async, warp.")
+        ("requests", po::value(&requests_)
+         ->default_value(requests_)->required()
+         , "Number of requests sent by each client thread per round.")
+        ("size", po::value(&size_)->default_value(size_)->required()
+         , "Width and height of warped raster.")
+        ;
+
+    (void) config;
+    (void) pd;
+}
+
+void WarperBench::configure(const po::variables_map &vars)
+{
+    (void) vars;
+    options_.autoscale.min = options_.autoscale.max = options_.processCount;
+}
+
+bool WarperBench::help(std::ostream &out, const std::string &what) const
+{
+    if (what.empty()) {
+        out << ("Round-trip latency and throughput of GDAL warper "
+                "requests.\n");
+        return true;
+    }
+
+    return false;
+}
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+/** Monotonic microseconds, comparable among processes (CLOCK_MONOTONIC).
+ */
+std::uint64_t now()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>
+        (Clock::now().time_since_epoch()).count();
+}
+
+/** Times recorded by the worker.
+ */
+struct WorkerTimes {
+    std::uint64_t picked;
+    std::uint64_t done;
+};
+
+/** Trivial work request: just records worker side times.
+ */
+class NopJob : public WorkRequest {
+public:
+    NopJob(const WorkRequestParams &p) : WorkRequest(p.sm), times_() {}
+
+    virtual void process(Mutex&, DatasetCache&) {
+        times_.picked = now();
+        times_.done = now();
+    }
+
+    virtual Response response(Lock&) {
+        return std::make_shared<WorkerTimes>(times_);
+    }
+
+    virtual void destroy() { sm().destroy_ptr(this); }
+
+private:
+    WorkerTimes times_;
+};
+
+NopJob* makeNopJob(const WorkRequestParams &params)
+{
+    return params.sm.construct<NopJob>(bi::anonymous_instance)(params);
+}
+
+const char *Dataset("/vsimem/warper-bench.tif");
+
+const geo::SrsDefinition Srs
+("+proj=merc +a=6378137 +b=6378137 +lat_ts=0.0 +lon_0=0.0 +x_0=0.0 "
+ "+y_0=0 +k=1.0 +units=m +nadgrids=@null +no_defs");
+
+const double HalfExtent(1e5);
+
+/** Creates 1024x1024 RGB dataset in GDAL's in-memory filesystem. Must be
+ *  called before warper starts its workers: forked processes inherit it.
+ */
+void createDataset()
+{
+    ::GDALAllRegister();
+
+    auto *driver(GetGDALDriverManager()->GetDriverByName("GTiff"));
+    if (!driver) {
+        LOGTHROW(err2, std::runtime_error) << "No GTiff driver.";
+    }
+
+    const int size(1024);
+    std::unique_ptr< ::GDALDataset> ds
+        (driver->Create(Dataset, size, size, 3, GDT_Byte, nullptr));
+    if (!ds) {
+        LOGTHROW(err2, std::runtime_error)
+            << "Cannot create dataset <" << Dataset << ">.";
+    }
+
+    double gt[6] = { -HalfExtent, 2 * HalfExtent / size, 0
+                     , HalfExtent, 0, -2 * HalfExtent / size };
+    ds->SetGeoTransform(gt);
+
+    OGRSpatialReference srs;
+    srs.importFromProj4(Srs.srs.c_str());
+    char *wkt(nullptr);
+    srs.exportToWkt(&wkt);
+    ds->SetProjection(wkt);
+    ::CPLFree(wkt);
+
+    std::vector<std::uint8_t> row(size);
+    for (int band(1); band <= 3; ++band) {
+        for (int j(0); j < size; ++j) {
+            for (int i(0); i < size; ++i) {
+                row[i] = std::uint8_t(i * band + j);
+            }
+            if (ds->GetRasterBand(band)->RasterIO
+                (GF_Write, 0, j, size, 1, row.data(), size, 1, GDT_Byte
+                 , 0, 0) != CE_None)
+            {
+                LOGTHROW(err2, std::runtime_error)
+                    << "Cannot write dataset <" << Dataset << ">.";
+            }
+        }
+    }
+}
+
+/** Latency histograms of one round.
+ */
+struct Latencies {
+    LatencyHistogram total;
+    LatencyHistogram dispatch;
+    LatencyHistogram back;
+    std::uint64_t max = 0;
+
+    Latencies& operator+=(const Latencies &other) {
+        total += other.total;
+        dispatch += other.dispatch;
+        back += other.back;
+        max = std::max(max, other.max);
+        return *this;
+    }
+
+    void record(std::uint64_t start, std::uint64_t end
+                , const WorkerTimes *times = nullptr)
+    {
+        total.record(end - start);
+        max = std::max(max, end - start);
+        if (!times) { return; }
+        dispatch.record(times->picked - start);
+        back.record(end - times->done);
+    }
+};
+
+void print(const std::string &name, const LatencyHistogram &h)
+{
+    if (!h.count()) { return; }
+    std::cout << boost::format("    %-9s p50 %9.3f  p90 %9.3f  p99 %9.3f"
+                               "  p99.9 %9.3f ms\n")
+        % name % (h.percentile(50) / 1e3) % (h.percentile(90) / 1e3)
+        % (h.percentile(99) / 1e3) % (h.percentile(99.9) / 1e3);
+}
+
+/** Sends count requests of given kind one after another.
+ */
+Latencies client(GdalWarper &warper, const std::string &mode
+                 , std::size_t count, int size, unsigned int seed)
+{
+    Latencies latencies;
+    Aborter aborter;
+
+    const double step(HalfExtent / 256);
+    for (std::size_t i(0); i < count; ++i) {
+        const auto start(now());
+        if (mode == "job") {
+            const auto response(warper.job(makeNopJob, aborter));
+            latencies.record(start, now(), static_cast<const WorkerTimes*>
+                             (response.get()));
+        } else if (mode == "async") {
+            std::promise<WorkResponse> promise;
+            warper.job(makeNopJob, aborter
+                       , [&promise](const WorkResponse &response
+                                    , const std::exception_ptr &error)
+            {
+                if (error) {
+                    promise.set_exception(error);
+                } else {
+                    promise.set_value(response);
+                }
+            });
+            const auto response(promise.get_future().get());
+            latencies.record(start, now(), static_cast<const WorkerTimes*>
+                             (response.get()));
+        } else {
+            // distinct tile every time
+            const auto n((seed * 7919 + i) % (256 * 256));
+            const math::Point2 origin(-HalfExtent + (n % 256) * step
+                                      , -HalfExtent + (n / 256) * step);
+            GdalWarper::RasterRequest req
+                (GdalWarper::RasterRequest::Operation::image, Dataset, Srs
+                 , math::Extents2(origin, origin + math::Point2
+                                  (HalfExtent, HalfExtent))
+                 , math::Size2(size, size));
+            warper.warp(req, aborter);
+            latencies.record(start, now());
+        }
+    }
+
+    return latencies;
+}
+
+} // namespace
+
+int WarperBench::run()
+{
+    std::vector<std::string> parts;
+    std::vector<unsigned int> threads;
+    ba::split(parts, threads_, ba::is_any_of(","), ba::token_compress_on);
+    for (const auto &part : parts) {
+        threads.push_back(boost::lexical_cast<unsigned int>(part));
+    }
+    std::vector<std::string> modes;
+    ba::split(modes, modes_, ba::is_any_of(","), ba::token_compress_on);
+
+    createDataset();
+
+    GdalWarper warper(options_, *this);
+
+    std::thread housekeeper([&]()
+    {
+        while (running_) {
+            warper.housekeeping();
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+    });
+
+    int status(EXIT_SUCCESS);
+    try {
+        // let all workers start and open the dataset
+        client(warper, "warp", 4 * options_.processCount, size_, 0);
+
+        for (const auto &mode : modes) {
+            if ((mode != "job") && (mode != "async") && (mode != "warp")) {
+                LOGTHROW(err2, std::runtime_error)
+                    << "Unknown mode <" << mode << ">.";
+            }
+
+            for (const auto count : threads) {
+                std::mutex mutex;
+                Latencies latencies;
+                std::vector<std::thread> clients;
+
+                const auto start(Clock::now());
+                for (unsigned int t(0); t < count; ++t) {
+                    clients.emplace_back([&, t]()
+                    {
+                        const auto l(client(warper, mode, requests_, size_
+                                            , t + 1));
+                        std::lock_guard<std::mutex> guard(mutex);
+                        latencies += l;
+                    });
+                }
+                for (auto &c : clients) { c.join(); }
+                const std::chrono::duration<double>
+                    elapsed(Clock::now() - start);
+
+                std::cout << boost::format("%-5s %3d threads: %10.1f req/s"
+                                           ", max %9.3f ms\n")
+                    % mode % count
+                    % (latencies.total.count() / elapsed.count())
+                    % (latencies.max / 1e3);
+                print("total", latencies.total);
+                print("dispatch", latencies.dispatch);
+                print("return", latencies.back);
+            }
+        }
+
+        // warper's own view: per-stage latencies, queue, workers
+        warper.stat(std::cout);
+    } catch (const std::exception &e) {
+        LOG(err3) << "Benchmark failed: <" << e.what() << ">.";
+        status = EXIT_FAILURE;
+    }
+
+    running_ = false;
+    housekeeper.join();
+    return status;
+}
+
+int main(int argc, char *argv[])
+{
+    return WarperBench()(argc, argv);
+}
@@ -28,6 +28,8 @@
 #include <utility>
 #include <functional>
 #include <map>
+#include <atomic>
+#include <chrono>
 #include <boost/regex.hpp>
 
 #include <boost/optional.hpp>
@@ -41,7 +43,6 @@
 #include "utility/tcpendpoint-io.hpp"
 #include "utility/buildsys.hpp"
 #include "utility/openmp.hpp"
-#include "utility/progress.hpp"
 #include "utility/path.hpp"
 #include "service/cmdline.hpp"
 
@@ -337,15 +338,22 @@ public:
 
     math::Extents2i blockTiles(const math::Point2i &pos) const;
 
+    /** Range of (local) blocks intersecting given extents, inclusive.
+     *  Returns invalid range if extents lie outside of tiling.
+     */
+    math::Extents2i blocksCovering(const math::Extents2 &extents) const;
+
     /** void Op(const math::Point2i &block, const math::Extents2 &extents
-     *          , const math::Point2i &tile)
+     *          , int index)
+     *
+     *  index: block index in row-major order of local blocks
      */
     template <typename Op> void forEachBlock(Op op) const {
         int total(area(blocks_));
 
-        utility::ts::Progress
-            progress("Processed blocks", total
-                     , utility::ts::Progress::Ratio(1, 1000));
+        std::atomic<int> done(0);
+        const int reportStep(std::max(1, total / 1000));
+        const auto start(std::chrono::steady_clock::now());
 
         UTILITY_OMP(parallel for schedule(dynamic))
         for (int bi = 0; bi < total; ++bi) {
@@ -355,13 +363,19 @@ public:
             {
                 TIDGuard tid(str(boost::format("Block [%d, %d]") % i % j));
                 math::Point2i block(i, j);
-                op(blockOrigin_ + block, blockExtents(block));
+                op(blockOrigin_ + block, blockExtents(block), bi);
             }
 
-            ++progress;
+            const auto d(++done);
+            if (!(d % reportStep) || (d == total)) {
+                reportProgress(d, total, start);
+            }
         }
     }
 
+    static void reportProgress(int done, int total
+                               , std::chrono::steady_clock::time_point start);
+
 private:
     math::Point2 origin_;
     math::Size2 block_;
@@ -437,6 +451,48 @@ math::Extents2 Tiling::blockExtents(const math::Point2i &pos) const
             , ul(0) + blockSize_.width, ul(1) };
 }
 
+math::Extents2i Tiling::blocksCovering(const math::Extents2 &extents) const
+{
+    auto index([](double value, double size, int origin) -> int
+    {
+        return int(std::floor(value / size)) - origin;
+    });
+
+    math::Extents2i range
+        (index(extents.ll(0) - origin_(0), blockSize_.width, blockOrigin_(0))
+         , index(origin_(1) - extents.ur(1), blockSize_.height
+                 , blockOrigin_(1))
+         , index(extents.ur(0) - origin_(0), blockSize_.width
+                 , blockOrigin_(0))
+         , index(origin_(1) - extents.ll(1), blockSize_.height
+                 , blockOrigin_(1)));
+
+    if ((range.ur(0) < 0) || (range.ur(1) < 0)
+        || (range.ll(0) >= blocks_.width) || (range.ll(1) >= blocks_.height))
+    {
+        return math::Extents2i(math::InvalidExtents{});
+    }
+
+    range.ll(0) = std::max(range.ll(0), 0);
+    range.ll(1) = std::max(range.ll(1), 0);
+    range.ur(0) = std::min(range.ur(0), blocks_.width - 1);
+    range.ur(1) = std::min(range.ur(1), blocks_.height - 1);
+    return range;
+}
+
+void Tiling::reportProgress(int done, int total
+                            , std::chrono::steady_clock::time_point start)
+{
+    const std::chrono::duration<double> elapsed
+        (std::chrono::steady_clock::now() - start);
+    const double eta(elapsed.count() * (total - done) / done);
+
+    LOG(info3)
+        << "Processed blocks: " << done << "/" << total
+        << str(boost::format(" (%.1f %%), elapsed %.0f s, ETA %.0f s.")
+               % (100.0 * done / total) % elapsed.count() % eta);
+}
+
 math::Extents2i Tiling::blockTiles(const math::Point2i &pos) const
 {
     math::Point2i ul(pos(0) * block_.width, pos(1) * block_.height);
@@ -464,6 +520,53 @@ math::Extents2 geometryExtents(const geo::Geometries &geometries)
     return e;
 }
 
+/** Splits multi-geometries and collections into their parts so that each
+ *  part is indexed only in blocks it really touches.
+ */
+geo::Geometries explode(const geo::Geometries &geometries)
+{
+    geo::Geometries parts;
+    for (const auto &g : geometries) {
+        auto *collection(dynamic_cast< ::OGRGeometryCollection*>(g.get()));
+        if (!collection) {
+            parts.push_back(g);
+            continue;
+        }
+
+        for (int i(0), e(collection->getNumGeometries()); i < e; ++i) {
+            parts.push_back
+                (geo::geometry(collection->getGeometryRef(i)->clone()));
+        }
+    }
+    return parts;
+}
+
+/** Geometries falling into each block (by envelope), indexed by block
+ *  index.
+ */
+typedef std::vector<std::vector<std::size_t>> BlockIndex;
+
+BlockIndex buildBlockIndex(const Tiling &tiling
+                           , const geo::Geometries &geometries)
+{
+    const auto &blocks(tiling.blocks());
+    BlockIndex index(math::area(blocks));
+
+    for (std::size_t gi(0); gi < geometries.size(); ++gi) {
+        const auto range
+            (tiling.blocksCovering(geometryExtents(geometries[gi])));
+        if (!math::valid(range)) { continue; }
+
+        for (int j(range.ll(1)); j <= range.ur(1); ++j) {
+            for (int i(range.ll(0)); i <= range.ur(0); ++i) {
+                index[j * blocks.width + i].push_back(gi);
+            }
+        }
+    }
+
+    return index;
+}
+
 void rasterizeBlock(const math::Point2i &block
                     , const math::Extents2 &extents
                     , imgproc::quadtree::RasterMask &mask
@@ -474,6 +577,9 @@ void rasterizeBlock(const math::Point2i &block
                     , const math::Size2 &blockSize
                     , const math::Size2 &tileSize)
 {
+    // no geometry touches this block
+    if (geometries.empty()) { return; }
+
     LOG(info2)
         << std::fixed << "Rasterizing block (" << block(0) << ", "
         << block(1) << ") (extents: " << extents
@@ -518,8 +624,7 @@ void rasterizeBlock(const math::Point2i &block
     if (emptyCount == geometries.size()) {
         return;
     } else if (full) {
-        UTILITY_OMP(critical)
-            mask.setQuad(blockId.lod, blockId.x, blockId.y);
+        mask.setQuad(blockId.lod, blockId.x, blockId.y);
         return;
     }
 
@@ -544,8 +649,7 @@ void rasterizeBlock(const math::Point2i &block
 
             if (nz == tileArea) {
                 // full
-                UTILITY_OMP(critical)
-                    mask.setQuad(tileId.lod, tileId.x, tileId.y);
+                mask.setQuad(tileId.lod, tileId.x, tileId.y);
                 continue;
             }
 
@@ -564,8 +668,7 @@ void rasterizeBlock(const math::Point2i &block
                     }
                 }
 
-                UTILITY_OMP(critical)
-                    mask.setSubtree(tileId.lod, tileId.x, tileId.y, m);
+                mask.setSubtree(tileId.lod, tileId.x, tileId.y, m);
             } else {
                 // less than half is set, start with empty and set pixels
                 imgproc::quadtree::RasterMask m
@@ -579,14 +682,12 @@ void rasterizeBlock(const math::Point2i &block
                     }
                 }
 
-                UTILITY_OMP(critical)
-                    mask.setSubtree(tileId.lod, tileId.x, tileId.y, m);
+                mask.setSubtree(tileId.lod, tileId.x, tileId.y, m);
             }
         }
     }
     const auto &cm(ds.cmask(true));
-    UTILITY_OMP(critical)
-        mask.setSubtree(blockId.lod, blockId.x, blockId.y, cm);
+    mask.setSubtree(blockId.lod, blockId.x, blockId.y, cm);
 }
 
 void RfMask::rasterize(imgproc::quadtree::RasterMask &mask
@@ -620,16 +721,37 @@ void RfMask::rasterize(imgproc::quadtree::RasterMask &mask
         (vts::lowestChild(node.nodeId()
                           , (lod_ - workBlock_ - node.nodeId().lod)));
 
+    // pre-filter geometries per block by their envelopes
+    const auto parts(explode(geometries));
+    const auto index(buildBlockIndex(tiling, parts));
+
+    LOG(info3) << "Indexed " << parts.size() << " geometry parts into "
+               << index.size() << " blocks.";
+
+    // every thread rasterizes into its own mask, masks are merged at the end
+    const auto maskSize(1 << (lod_ + tileSizeOrder_));
+    std::vector<imgproc::quadtree::RasterMask> masks;
+    for (int t(0), te(omp_get_max_threads()); t < te; ++t) {
+        masks.emplace_back(maskSize, maskSize
+                           , imgproc::quadtree::RasterMask::InitMode::EMPTY);
+    }
+
     tiling.forEachBlock([&](const math::Point2i &block
-                            , const math::Extents2 &extents)
+                            , const math::Extents2 &extents, int bi)
     {
         vts::TileId blockId(reference.lod, reference.x + block(0)
                             , reference.x + block(1));
         auto tileReference(vts::lowestChild(blockId, tileSizeOrder_));
 
-        rasterizeBlock(block, extents, mask, blockId, tileReference
-                       , srs, geometries, blockSize, tileSize_);
+        geo::Geometries candidates;
+        for (auto gi : index[bi]) { candidates.push_back(parts[gi]); }
+
+        rasterizeBlock(block, extents, masks[omp_get_thread_num()], blockId
+                       , tileReference, srs, candidates, blockSize
+                       , tileSize_);
     });
+
+    for (const auto &m : masks) { mask.merge(m); }
 }
 
 int RfMask::run()
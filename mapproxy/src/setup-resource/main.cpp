@@ -28,6 +28,10 @@
 #include <utility>
 #include <functional>
 #include <map>
+#include <mutex>
+#include <sstream>
+#include <atomic>
+#include <thread>
 #include <boost/regex.hpp>
 
 #include <boost/optional.hpp>
@@ -45,6 +49,7 @@
 #include "utility/format.hpp"
 #include "utility/md5.hpp"
 #include "utility/implicit-value.hpp"
+#include "utility/openmp.hpp"
 
 #include "service/cmdline.hpp"
 #include "service/ctrlclient.hpp"
@@ -58,15 +63,19 @@
 #include "vts-libs/vts/tileop.hpp"
 #include "vts-libs/vts/io.hpp"
 #include "vts-libs/vts/tileindex.hpp"
+#include "vts-libs/vts/nodeinfo.hpp"
 
 // mapproxy stuff
 #include "calipers/calipers.hpp"
+#include "calipers/io.hpp"
 #include "generatevrtwo/generatevrtwo.hpp"
 #include "generatevrtwo/io.hpp"
 #include "tiling/tiling.hpp"
 #include "mapproxy/resource.hpp"
 #include "mapproxy/definition.hpp"
 #include "mapproxy/mapproxy.hpp"
+#include "mapproxy/support/reprojected.hpp"
+#include "mapproxy/support/palette.hpp"
 
 namespace po = boost::program_options;
 namespace fs = boost::filesystem;
@@ -96,6 +105,11 @@ struct Config {
     vs::CreditIds credits;
     boost::optional<vts::Lod> bottomLod;
 
+    /** Build overview pyramids reprojected into SRSes of the reference
+     *  frame for tiles up to this LOD.
+     */
+    boost::optional<vts::Lod> reprojectMaxLod;
+
     vrtwo::Color::optional background;
 
     int autoCreditId;
@@ -106,6 +120,16 @@ struct Config {
 
     bool parallel = true;
 
+    /** Total number of threads shared by all datasets processed in
+     *  parallel (0 = number of available CPUs).
+     */
+    unsigned int threads = 0;
+
+    /** Number of datasets processed in parallel in batch mode
+     *  (0 = derived from number of threads and datasets).
+     */
+    unsigned int jobs = 0;
+
     struct {
         boost::optional<fs::path> datasetHome;
     } override;
@@ -135,8 +159,29 @@ private:
 
     int run();
 
-    std::string dataset_; // do not use fs::path since it needs quotes in case
-                          // of spaces in filename
+    enum class Status { created, skipped, failed };
+
+    struct Credits;
+
+    /** Sets up resource from single dataset. Runs all stages up to
+     *  writing resource definition; mapproxy is notified by caller.
+     */
+    Status setup(const std::string &dataset
+                 , const vr::ReferenceFrame &rf
+                 , const Config &config, Credits &credits
+                 , Resource::Id &resourceId) const;
+
+    bool notify(const Config &config
+                , const std::vector<Resource::Id> &resourceIds) const;
+
+    /** Input datasets. Do not use fs::path since it needs quotes in case
+     *  of spaces in filename.
+     */
+    std::vector<std::string> datasets_;
+
+    /** More than one dataset: batch mode.
+     */
+    bool batch_ = false;
 
     DatasetLink linkDataset_;
 
@@ -161,8 +206,14 @@ void SetupResource::configuration(po::options_description &cmdline
          , "Resource ID. Deduced from filename if not provided.")
         ("group", po::value(&resourceId_.group)
          , "Resource group ID. Deduced from filename if not provided.")
-        ("dataset", po::value(&dataset_)->required()
-         , "Path to input raster dataset.")
+        ("dataset", po::value(&datasets_)->multitoken()
+         , "Path to input raster dataset. Can be used multiple times to "
+         "set up multiple resources in one batch.")
+        ("batch", po::value<fs::path>()
+         , "Path to file with list of input raster datasets, one per line. "
+         "Empty lines and lines starting with # are ignored. Resource "
+         "IDs are deduced from filenames in batch mode; resources "
+         "that already exist are skipped.")
         ("linkDataset", utility::implicit_value
          (&linkDataset_, DatasetLink::absolute)
          ->default_value(DatasetLink::nolink)
@@ -202,6 +253,12 @@ void SetupResource::configuration(po::options_description &cmdline
          , "Desired bottom LOD. The actual bottom might be deeper in "
          "case of more detail dataset.")
 
+        ("reproject.maxLod", po::value<vts::Lod>()
+         , "Build overview pyramids of the dataset reprojected into SRS of "
+         "each reference frame subtree it lies in and aligned to its tile "
+         "grid; tiles up to this LOD are then warped from them without "
+         "reprojection.")
+
         ("override.datasetHome", po::value<fs::path>()
          , "Dataset home path override if the default is undesirable. "
          "Relative to --dataRoot. Use with caution.")
@@ -217,6 +274,16 @@ void SetupResource::configuration(po::options_description &cmdline
          , "Use OpenMP to parallelize work. Can be used "
          "to disable parallelism in various parts of dataset processing "
          "(currently only tiling).")
+
+        ("threads", po::value(&config_.threads)
+         ->default_value(config_.threads)
+         , "Thread budget shared by all datasets processed in parallel "
+         "(0 = number of available CPUs).")
+        ("jobs", po::value(&config_.jobs)
+         ->default_value(config_.jobs)
+         , "Number of datasets processed in parallel in batch mode. "
+         "Thread budget is split evenly among them. 0 = one job per "
+         "thread up to number of datasets.")
         ;
 
     config.add_options()
@@ -229,7 +296,7 @@ void SetupResource::configuration(po::options_description &cmdline
          , "Mapproxy control socket path/CTRL URI.")
         ;
 
-    pd.add("dataset", 1)
+    pd.add("dataset", -1)
         ;
 
     (void) pd;
@@ -265,6 +332,10 @@ void SetupResource::configure(const po::variables_map &vars)
         config_.background = vars["background"].as<vrtwo::Color>();
     }
 
+    if (vars.count("reproject.maxLod")) {
+        config_.reprojectMaxLod = vars["reproject.maxLod"].as<vts::Lod>();
+    }
+
     if (vars.count("override.datasetHome")) {
         config_.override.datasetHome = vars["override.datasetHome"]
             .as<fs::path>();
@@ -275,8 +346,51 @@ void SetupResource::configure(const po::variables_map &vars)
     config_.mapproxyDefinitionDir
         = fs::absolute(config_.mapproxyDefinitionDir);
 
-    // make dataset path absolute
-    dataset_ = fs::absolute(fs::path(dataset_)).string();
+    if (vars.count("batch")) {
+        const auto path(vars["batch"].as<fs::path>());
+        utility::ifstreambuf f(path.string());
+        f.exceptions(std::ios::badbit);
+        for (std::string line; std::getline(f, line); ) {
+            ba::trim(line);
+            if (line.empty() || (line[0] == '#')) { continue; }
+            datasets_.push_back(line);
+        }
+    }
+
+    if (datasets_.empty()) { throw po::required_option("dataset"); }
+    batch_ = (datasets_.size() > 1);
+
+    if (batch_) {
+        if (!resourceId_.id.empty()) {
+            throw po::validation_error
+                (po::validation_error::invalid_option_value, "id");
+        }
+        if (config_.override.datasetHome) {
+            throw po::validation_error
+                (po::validation_error::invalid_option_value
+                 , "override.datasetHome");
+        }
+    }
+
+    if (!config_.threads) {
+        config_.threads = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+
+    if (!config_.jobs) {
+        config_.jobs = config_.threads;
+    }
+    config_.jobs = std::max
+        (std::min(config_.jobs, unsigned(datasets_.size())), 1u);
+
+    // make dataset paths absolute
+    for (auto &dataset : datasets_) {
+        dataset = fs::absolute(fs::path(dataset)).string();
+    }
+
+    std::ostringstream datasets;
+    for (const auto &dataset : datasets_) {
+        datasets << "\n    " << dataset;
+    }
 
     LOG(info3, log_)
         << std::boolalpha
@@ -287,9 +401,12 @@ void SetupResource::configure(const po::variables_map &vars)
         << "\nreferenceFrame = " << resourceId_.referenceFrame
         << "\ncredits.firstNumericId = " << config_.autoCreditId
         << "\nbottomLod = " << config_.bottomLod
+        << "\nreproject.maxLod = " << config_.reprojectMaxLod
         << "\nbackground = " << config_.background
-        << "\ndataset = " << dataset_
+        << "\ndataset = " << datasets.str()
         << "\nlinkDataset = " << linkDataset_
+        << "\nthreads = " << config_.threads
+        << "\njobs = " << config_.jobs
         << "\n"
         ;
 }
@@ -310,18 +427,36 @@ bool SetupResource::help(std::ostream &out, const std::string &what) const
     return false;
 }
 
+/** Log line prefix is process-wide; it is left untouched when datasets are
+ *  processed in parallel and thread ID identifies the dataset instead.
+ */
+bool noLogLinePrefix(false);
+
 struct LogLinePrefix {
     LogLinePrefix(const std::string &prefix)
-        : old(dbglog::log_line_prefix())
+        : old(noLogLinePrefix ? "" : dbglog::log_line_prefix())
     {
-        dbglog::log_line_prefix(prefix);
+        if (!noLogLinePrefix) { dbglog::log_line_prefix(prefix); }
     }
 
-    ~LogLinePrefix() { dbglog::log_line_prefix(old); }
+    ~LogLinePrefix() {
+        if (!noLogLinePrefix) { dbglog::log_line_prefix(old); }
+    }
 
     std::string old;
 };
 
+struct TIDGuard {
+    TIDGuard(const std::string &id)
+        : old(dbglog::thread_id())
+    {
+        dbglog::thread_id(id);
+    }
+    ~TIDGuard() { dbglog::thread_id(old); }
+
+    const std::string old;
+};
+
 boost::optional<calipers::DatasetType>
 asDatasetType(const boost::optional<ResourceType> &type)
 {
@@ -592,6 +727,13 @@ void createVrtWO(const fs::path &srcPath
                  , const calipers::Measurement &cm
                  , const Config &setupConfig)
 {
+    // link to the vrtwo dataset is created only after successful generation
+    const auto datasetPath(root / name);
+    if (fs::exists(datasetPath)) {
+        LOG(info4) << "Reusing existing overviews " << datasetPath << ".";
+        return;
+    }
+
     vrtwo::Config config;
     config.resampling = resampling;
     config.overwrite = true;
@@ -612,7 +754,6 @@ void createVrtWO(const fs::path &srcPath
     vrtwo::generate(fs::absolute(srcPath), root / ovrPathLocal, config);
 
     // make a link to the vrtwo dataset
-    const auto datasetPath(root / name);
     fs::remove(datasetPath);
     fs::create_symlink(ovrPathLocal / "dataset", datasetPath);
 }
@@ -634,6 +775,29 @@ fs::path vrtWOPath(const calipers::Measurement &cm, const fs::path &rootDir)
     throw;
 }
 
+/** Resampling of ophoto overviews. Colour table indices of paletted
+ *  datasets cannot be interpolated: configured resampling other than
+ *  nearest or mode is ignored for them.
+ */
+geo::GeoDataset::Resampling ophotoResampling(const fs::path &dataset
+                                             , const Config &config)
+{
+    const auto resampling(config.tmsResampling ? *config.tmsResampling
+                          : geo::GeoDataset::Resampling::texture);
+    if ((resampling == geo::GeoDataset::Resampling::nearest)
+        || (resampling == geo::GeoDataset::Resampling::mode)
+        || !readPalette(dataset.string()))
+    {
+        return resampling;
+    }
+
+    if (config.tmsResampling) {
+        LOG(warn4) << "Resampling <" << resampling << "> ignored for "
+                   << "paletted dataset " << dataset << ", using mode.";
+    }
+    return geo::GeoDataset::Resampling::mode;
+}
+
 fs::path createVrtWO(const calipers::Measurement &cm
                      , const fs::path &datasetPath
                      , const fs::path &rootDir
@@ -674,8 +838,7 @@ fs::path createVrtWO(const calipers::Measurement &cm
         {
             LogLinePrefix linePrefix(" (ophoto)");
             createVrtWO(datasetPath, rootDir, "ophoto"
-                        , (config.tmsResampling ? *config.tmsResampling
-                           : geo::GeoDataset::Resampling::texture)
+                        , ophotoResampling(datasetPath, config)
                         , cm, config);
         }
         break;
@@ -689,11 +852,103 @@ fs::path createVrtWO(const calipers::Measurement &cm
     return vrtWOPath(cm, rootDir);
 }
 
+/** Builds overview pyramids of the vrtwo dataset reprojected into SRS of
+ *  each subtree the dataset lies in (see ReprojectedPyramids). Base level is
+ *  at twice the resolution of maxLod tiles, i.e. all tiles up to maxLod are
+ *  served by materialized overviews. Existing pyramids are reused.
+ */
+void createReprojected(const calipers::Measurement &cm
+                       , const vr::ReferenceFrame &rf
+                       , const fs::path &rootDir, const Config &setupConfig)
+{
+    const auto maxLod(*setupConfig.reprojectMaxLod);
+    const auto dataset(vrtWOPath(cm, rootDir));
+
+    // grid of each SRS: tile-aligned extents and pixel size
+    struct Grid {
+        math::Extents2 extents;
+        double pixel;
+
+        Grid() : extents(math::InvalidExtents{}), pixel() {}
+    };
+    std::map<std::string, Grid> grids;
+
+    for (const auto &node : cm.nodes) {
+        const auto range(vts::shiftRange
+                         (vts::LodTileRange(node.ranges.lodRange().min
+                                            , node.ranges.tileRange())
+                          , maxLod).range);
+
+        const vts::NodeInfo ll(rf, vts::tileId(maxLod, range.ll));
+        const vts::NodeInfo ur(rf, vts::tileId(maxLod, range.ur));
+        if (!ll.valid() || !ur.valid()) { continue; }
+
+        auto &grid(grids[node.srs]);
+        if (!grid.pixel) {
+            grid.pixel = math::size(ll.extents()).width / 512;
+        }
+        math::update(grid.extents, ll.extents());
+        math::update(grid.extents, ur.extents());
+    }
+
+    for (const auto &item : grids) {
+        const auto &srs(item.first);
+        const auto &grid(item.second);
+
+        const fs::path path
+            (ReprojectedPyramids::path(dataset.string(), srs));
+        if (fs::exists(path)) {
+            LOG(info4) << "Reusing existing reprojected pyramid "
+                       << path << ".";
+            continue;
+        }
+
+        const auto es(math::size(grid.extents));
+
+        vrtwo::Config config;
+        config.resampling = ((cm.datasetType == calipers::DatasetType::dem)
+                             ? geo::GeoDataset::Resampling::cubicspline
+                             : ophotoResampling(dataset, setupConfig));
+        config.overwrite = true;
+        config.background = setupConfig.background;
+        config.minOvrSize = math::Size2(256, 256);
+        config.grid = boost::in_place();
+        config.grid->srs = vr::system.srs(srs).srsDef;
+        config.grid->extents = grid.extents;
+        config.grid->size
+            = math::Size2(int(std::round(es.width / grid.pixel))
+                          , int(std::round(es.height / grid.pixel)));
+
+        config.createOptions
+            ("TILED", true)
+            ("COMPRESS", "DEFLATE")
+            ("PREDICTOR", "")
+            ("ZLEVEL", 9)
+            ;
+
+        LOG(info4) << "Generating overviews reprojected into <" << srs
+                   << ">.";
+        LogLinePrefix linePrefix(" (" + srs + ")");
+
+        const auto ovrPathLocal("vrtwo" / path.filename());
+
+        config.pathToOriginalDataset
+            = vrtwo::PathToOriginalDataset::relativeSymlink;
+        vrtwo::generate(fs::absolute(dataset), rootDir / ovrPathLocal
+                        , config);
+
+        // make a link to the vrtwo dataset
+        fs::remove(path);
+        fs::create_symlink(ovrPathLocal / "dataset", path);
+    }
+}
+
 void buildDefinition(resource::SurfaceDem &def, const calipers::Measurement &cm
                      , const fs::path &dataset, const Config &config)
 {
     def.dem.dataset = dataset.string();
     def.dem.geoidGrid = config.geoidGrid;
+    def.reprojectedMaxLod = config.reprojectMaxLod;
 
     def.introspection.position = cm.position;
 }
@@ -705,6 +960,7 @@ void buildDefinition(resource::TmsRaster &def, const calipers::Measurement&
     def.format = config.format;
     def.resampling = config.tmsResampling;
     def.transparent = config.transparent;
+    def.reprojectedMaxLod = config.reprojectMaxLod;
 }
 
 template <typename Definition>
@@ -767,75 +1023,106 @@ std::string md5sum(const fs::path &path)
     return md5.hash();
 }
 
-int SetupResource::run()
-{
-    // find reference frame
-    const auto *rf(vr::system.referenceFrames
-                   (resourceId_.referenceFrame, std::nothrow));
-    if (!rf) {
-        LOG(fatal)
-            << "There is no reference frame with ID <"
-            << resourceId_.referenceFrame << ">.";
-        return EXIT_FAILURE;
-    }
+/** Auto-generated credits, allocated once on first use.
+ */
+struct SetupResource::Credits {
+    Credits(const Config &config) : config(config) {}
 
-    // copy config and update; do not use config_ in this function from this
-    // point
-    auto config(config_);
-    if (!config.geoidGrid) {
-        // rf body default geoid requested
-        if (rf->body) {
-            const auto &body(vr::system.bodies(*rf->body));
-            config.geoidGrid = body.defaultGeoidGrid;
-        }
-    } else if (config.geoidGrid->empty()) {
-        // no geoid grid
-        config.geoidGrid = boost::none;
+    const vr::Credit::dict& get() {
+        std::call_once(once, [this]() {
+            credits = attributions2credits(config);
+        });
+        return credits;
     }
 
+    const Config &config;
+    std::once_flag once;
+    vr::Credit::dict credits;
+};
+
+SetupResource::Status
+SetupResource::setup(const std::string &dataset
+                     , const vr::ReferenceFrame &rf
+                     , const Config &config, Credits &credits
+                     , Resource::Id &resourceId) const
+{
     // open dataset
-    const auto ds(geo::GeoDataset::open(dataset_));
+    const auto ds(geo::GeoDataset::open(dataset));
 
     // 1) deduce resource ID
-    const auto resourceId(deduceResourceId(dataset_, resourceId_));
+    resourceId = deduceResourceId(dataset, resourceId_);
     LOG(info4) << "Using resource ID <" << resourceId << ">.";
 
-
     // 2) check resource existence in mapproxy
     LOG(info4) << "Checking for resource existence.";
     {
         Mapproxy mp(config.mapproxyCtrl);
-        if (!mp.supportsReferenceFrame(resourceId_.referenceFrame)) {
-            LOG(fatal)
-                << "Given reference frame is not supporte by mapproxy. "
-                "Please, check that mapproxy uses the same registry and "
-                "restart it.";
-            return EXIT_FAILURE;
-        }
-
         if (mp.has(resourceId)) {
+            if (batch_) {
+                LOG(info4)
+                    << "Resource " << resourceId << " already exists in "
+                    << "mapproxy configuration, skipping.";
+                return Status::skipped;
+            }
+
             LOG(fatal)
                 << "Resource " << resourceId << " already exists in mapproxy "
                 << "configuration. Please, use another id and/or group.";
-            return EXIT_FAILURE;
+            return Status::failed;
         }
     }
 
+    // dataset home; all stage results are stored there
+    const auto datasetFileName(fs::path(dataset).filename());
+
+    const auto datasetHome
+        (config.override.datasetHome.value_or
+         (utility::addExtension(datasetFileName
+                                , "." + md5sum(dataset))));
+
+    const auto rootDir(fs::absolute(datasetHome, config.mapproxyDataRoot));
+    const auto tmpRootDir(utility::addExtension(rootDir, ".tmp"));
+    const auto baseDatasetPath("original-dataset" / datasetFileName);
+    const auto datasetPath(rootDir / baseDatasetPath);
+
+    // stage results live in temporary root until dataset home is committed
+    const auto stagePath([&](const std::string &name) -> fs::path
+    {
+        if (fs::exists(rootDir)) { return rootDir / name; }
+        fs::create_directories(tmpRootDir);
+        return tmpRootDir / name;
+    });
+
     // 3) measure dataset
-    LOG(info4) << "Measuring dataset.";
+    const auto datasetType(asDatasetType(resourceType_));
+    const auto calipersPath
+        (stagePath(utility::format
+                   ("calipers.%s.%s", resourceId_.referenceFrame
+                    , (datasetType
+                       ? boost::lexical_cast<std::string>(*datasetType)
+                       : "auto"))));
 
     auto cm([&]() -> calipers::Measurement {
+        if (fs::exists(calipersPath)) {
+            LOG(info4) << "Reusing dataset measurement from "
+                       << calipersPath << ".";
+            return calipers::load(calipersPath);
+        }
+
+        LOG(info4) << "Measuring dataset.";
         LogLinePrefix linePrefix(" (calipers)");
         calipers::Config calipersConfig;
-        calipersConfig.datasetType = asDatasetType(resourceType_);
-        return calipers::measure(*rf, ds.descriptor(), calipersConfig);
+        calipersConfig.datasetType = datasetType;
+        auto cm(calipers::measure(rf, ds.descriptor(), calipersConfig));
+        if (!cm.nodes.empty()) { calipers::save(calipersPath, cm); }
+        return cm;
     }());
 
     if (cm.nodes.empty()) {
         LOG(fatal)
             << "Unable to set up a mapproxy resource <" << resourceId
-            << "> from " << dataset_ << ".";
-        return EXIT_FAILURE;
+            << "> from " << dataset << ".";
+        return Status::failed;
     }
 
     if (cm.xOverlap) {
@@ -850,25 +1137,12 @@ int SetupResource::run()
     }
 
     // 4) allocate attributions
-    const auto credits(attributions2credits(config));
+    const auto &autoCredits(credits.get());
 
     // 5) copy/symlink dataset
-    const auto datasetFileName(fs::path(dataset_).filename());
-
-    const auto datasetHome
-        (config_.override.datasetHome.value_or
-         (utility::addExtension(datasetFileName
-                                , "." + md5sum(dataset_))));
-
-    const auto rootDir(fs::absolute(datasetHome, config.mapproxyDataRoot));
-    const auto baseDatasetPath("original-dataset" / datasetFileName);
-    const auto datasetPath(rootDir / baseDatasetPath);
-
     const auto mainDataset([&]()
     {
         if (!fs::exists(rootDir)) {
-            const auto tmpRootDir(utility::addExtension(rootDir, ".tmp"));
-
             const auto tmpDatasetPath(tmpRootDir / baseDatasetPath);
 
             fs::create_directories(tmpDatasetPath.parent_path());
@@ -877,7 +1151,7 @@ int SetupResource::run()
 
             if (linkDataset_ != DatasetLink::nolink) {
                 LOG(info4) << "Symlinking dataset to destination.";
-                fs::path dst(dataset_);
+                fs::path dst(dataset);
 
                 if (linkDataset_ == DatasetLink::relative) {
                     // relativize already absolute path
@@ -890,13 +1164,13 @@ int SetupResource::run()
             } else {
                 // copy (overwrite)
                 LOG(info4) << "Copying dataset to destination.";
-                utility::copy_file(dataset_, tmpDatasetPath, true);
+                utility::copy_file(dataset, tmpDatasetPath, true);
                 LOG(info3)
-                    << "    cp -av " << dataset_ << " " << tmpDatasetPath;
+                    << "    cp -av " << dataset << " " << tmpDatasetPath;
                 ds.copyFiles(datasetPath);
             }
 
-            // 6) create vrtwo derived datasets
+            // 6) create vrtwo derived datasets; finished ones are reused
             createVrtWO(cm, tmpDatasetPath , tmpRootDir, config);
 
             // commit
@@ -908,16 +1182,26 @@ int SetupResource::run()
         return vrtWOPath(cm, rootDir);
     }());
 
+    // 6b) create overview pyramids reprojected into reference frame SRSes
+    if (config.reprojectMaxLod) {
+        createReprojected(cm, rf, rootDir, config);
+    }
+
     // 7) generate tiling information
-    LOG(info4) << "Generating tiling information.";
-    {
+    const auto tilingPath(rootDir / ("tiling." + resourceId_.referenceFrame));
+    if (fs::exists(tilingPath)) {
+        LOG(info4) << "Reusing tiling information from " << tilingPath << ".";
+    } else {
+        LOG(info4) << "Generating tiling information.";
         LogLinePrefix linePrefix(" (tiling)");
         tiling::Config tilingConfig;
-        tilingConfig.parallel = config_.parallel;
-        auto ti(tiling::generate(mainDataset, *rf, cm.lodRange
+        tilingConfig.parallel = config.parallel;
+        auto ti(tiling::generate(mainDataset, rf, cm.lodRange
                                  , cm.lodTileRanges(), tilingConfig));
 
-        ti.save(rootDir / ("tiling." + resourceId_.referenceFrame));
+        const auto tmpTilingPath(utility::addExtension(tilingPath, ".tmp"));
+        ti.save(tmpTilingPath);
+        fs::rename(tmpTilingPath, tilingPath);
     }
 
     // 8) generate mapproxy resource configuration
@@ -935,8 +1219,8 @@ int SetupResource::run()
              , datasetPath.filename());
 
         // add credits
-        addCredits(r, credits);
-        addCredits(r, config_.credits);
+        addCredits(r, autoCredits);
+        addCredits(r, config.credits);
 
         r.lodRange = cm.lodRange;
         r.tileRange = cm.tileRange;
@@ -946,7 +1230,10 @@ int SetupResource::run()
         fs::create_directories(resourceConfigPath.parent_path());
         save(resourceConfigPath, r);
 
-        // check whether there is a group include file
+        // check whether there is a group include file; datasets processed
+        // in parallel may share a group
+        static std::mutex groupMutex;
+        std::unique_lock<std::mutex> lock(groupMutex);
         const auto groupConfigPath
             (config.mapproxyDefinitionDir / (resourceId.group + ".json"));
         if (!fs::exists(groupConfigPath)) {
@@ -956,58 +1243,181 @@ int SetupResource::run()
         }
     }
 
-    // 9) notify mapproxy
+    return Status::created;
+}
+
+bool SetupResource::notify(const Config &config
+                           , const std::vector<Resource::Id> &resourceIds)
+    const
+{
     LOG(info4) << "Notifying mapproxy.";
+    Mapproxy mp(config.mapproxyCtrl);
+
+    const auto timestamp(mp.updateResources());
+    LOG(info4)
+        << "Mapproxy notified. Waiting for update confirmation.";
+
+    const auto waitForUpdate([&](int tries) -> bool
     {
-        Mapproxy mp(config.mapproxyCtrl);
+        for (; tries > 0; --tries) {
+            if (mp.updatedSince(timestamp)) { return true; }
+            usleep(500000);
+        }
 
-        const auto timestamp(mp.updateResources());
-        LOG(info4)
-            << "Mapproxy notified. Waiting for update confirmation.";
+        return false;
+    });
 
-        const auto waitForUpdate([&](int tries) -> bool
-        {
-            for (; tries > 0; --tries) {
-                if (mp.updatedSince(timestamp)) { return true; }
-                usleep(500000);
+    const auto ready([&](const Resource::Id &resourceId, int tries) -> bool
+    {
+        for (; tries > 0; --tries) {
+            if (mp.isReady(resourceId)) {
+                return true;
             }
+            usleep(500000);
+        }
 
-            return false;
-        });
+        return false;
+    });
+
+    if (!waitForUpdate(10)) {
+        LOG(err3) << "Mapproxy didn't update resources in time. "
+            "Check resource presence manually.";
+        return false;
+    }
+    LOG(info3) << "Mapproxy updated resources.";
+
+    bool ok(true);
+    for (const auto &resourceId : resourceIds) {
+        if (!ready(resourceId, 10)) {
+            LOG(err3) << "Resource <" << resourceId << "> has not been "
+                "made ready in time. Check resource presence manually.";
+            ok = false;
+            continue;
+        }
+
+        const auto url(mp.url(resourceId));
+
+        LOG(info4)
+            << "Resource <" << resourceId << "> is ready to serve "
+            << "at local URL <" << url << ">.";
+    }
+
+    return ok;
+}
 
-        const auto ready([&](int tries) -> bool
+int SetupResource::run()
+{
+    // find reference frame
+    const auto *rf(vr::system.referenceFrames
+                   (resourceId_.referenceFrame, std::nothrow));
+    if (!rf) {
+        LOG(fatal)
+            << "There is no reference frame with ID <"
+            << resourceId_.referenceFrame << ">.";
+        return EXIT_FAILURE;
+    }
+
+    // copy config and update; do not use config_ in this function from this
+    // point
+    auto config(config_);
+    if (!config.geoidGrid) {
+        // rf body default geoid requested
+        if (rf->body) {
+            const auto &body(vr::system.bodies(*rf->body));
+            config.geoidGrid = body.defaultGeoidGrid;
+        }
+    } else if (config.geoidGrid->empty()) {
+        // no geoid grid
+        config.geoidGrid = boost::none;
+    }
+
+    {
+        Mapproxy mp(config.mapproxyCtrl);
+        if (!mp.supportsReferenceFrame(resourceId_.referenceFrame)) {
+            LOG(fatal)
+                << "Given reference frame is not supporte by mapproxy. "
+                "Please, check that mapproxy uses the same registry and "
+                "restart it.";
+            return EXIT_FAILURE;
+        }
+    }
+
+    Credits credits(config);
+    std::vector<Status> statuses(datasets_.size(), Status::failed);
+    std::vector<Resource::Id> resourceIds(datasets_.size());
+
+    if (!batch_) {
+#ifdef _OPENMP
+        omp_set_num_threads(config.threads);
+#endif
+        statuses[0] = setup(datasets_[0], *rf, config, credits
+                            , resourceIds[0]);
+    } else {
+        LOG(info4) << "Setting up " << datasets_.size() << " datasets in "
+                   << config.jobs << " job(s) sharing " << config.threads
+                   << " thread(s).";
+
+        // log line prefix is process-wide, cannot be used by jobs
+        noLogLinePrefix = true;
+        std::atomic<std::size_t> next(0);
+
+        const auto worker([&]()
         {
-            for (; tries > 0; --tries) {
-                if (mp.isReady(resourceId)) {
-                    return true;
+#ifdef _OPENMP
+            // split thread budget among jobs
+            omp_set_num_threads(std::max(config.threads / config.jobs, 1u));
+#endif
+
+            for (;;) {
+                const auto i(next++);
+                if (i >= datasets_.size()) { return; }
+                const auto &dataset(datasets_[i]);
+                TIDGuard tg(fs::path(dataset).stem().string());
+
+                try {
+                    statuses[i] = setup(dataset, *rf, config, credits
+                                        , resourceIds[i]);
+                } catch (const std::exception &e) {
+                    LOG(err3) << "Failed to set up resource from "
+                              << dataset << ": <" << e.what() << ">.";
                 }
-                usleep(500000);
             }
-
-            return false;
         });
 
-        if (!waitForUpdate(10)) {
-            LOG(err3) << "Mapproxy didn't update resources in time. "
-                "Check resource presence manually.";
-            return EXIT_FAILURE;
+        std::vector<std::thread> pool;
+        for (unsigned int i(0); i < config.jobs; ++i) {
+            pool.emplace_back(worker);
         }
-        LOG(info3) << "Mapproxy updated resources.";
+        for (auto &thread : pool) { thread.join(); }
+    }
 
-        if (!ready(10)) {
-            LOG(err3) << "Resource has not been made ready in time. "
-                "Check resource presence manually.";
-            return EXIT_FAILURE;
+    std::vector<Resource::Id> created;
+    std::size_t failed(0);
+    for (std::size_t i(0); i < datasets_.size(); ++i) {
+        switch (statuses[i]) {
+        case Status::created: created.push_back(resourceIds[i]); break;
+        case Status::skipped: break;
+        case Status::failed:
+            if (batch_) {
+                LOG(err3) << "Dataset " << datasets_[i] << " failed.";
+            }
+            ++failed;
+            break;
         }
+    }
 
-        const auto url(mp.url(resourceId));
+    if (batch_) {
+        LOG(info4) << "Batch finished: " << created.size() << " created, "
+                   << (datasets_.size() - created.size() - failed)
+                   << " skipped, " << failed << " failed.";
+    }
 
-        LOG(info4)
-            << "Resource <" << resourceId << "> is ready to serve "
-            << "at local URL <" << url << ">.";
+    // 9) notify mapproxy
+    if (!created.empty() && !notify(config, created)) {
+        return EXIT_FAILURE;
     }
 
-    return EXIT_SUCCESS;
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
 }
 
 int main(int argc, char *argv[])
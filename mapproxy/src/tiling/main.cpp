@@ -40,6 +40,7 @@
 #include "utility/streams.hpp"
 #include "utility/buildsys.hpp"
 #include "utility/openmp.hpp"
+#include "utility/path.hpp"
 #include "service/cmdline.hpp"
 
 #include "geo/geodataset.hpp"
@@ -179,6 +180,10 @@ private:
     tiling::Config config_;
     fs::path dataset_;
 
+    /** Shard tile indices to merge (merge mode).
+     */
+    std::vector<fs::path> merge_;
+
     bool noexcept_;
 };
 
@@ -211,6 +216,30 @@ void Tiling::configuration(po::options_description &cmdline
          ->default_value(config_.forceWatertight)->implicit_value(true)
          , "Treats all partial tiles as watertight. Will lie about the holes "
            "in the dataset.")
+        ("shard", po::value<tiling::Shard>()
+         , "Process only given shard (\"index/count\", index is 0-based) "
+         "of work units.")
+        ("unitLod", po::value<int>()
+         , "LOD of work unit roots (defaults to lodRange.min). Work units "
+         "are distributed among shards and checkpointed as a whole.")
+        ("checkpoint", po::value(&config_.checkpoint)
+         , "Checkpoint directory. Partial result is saved there "
+         "periodically, run started with existing checkpoint resumes "
+         "from it. Removed once the output is saved.")
+        ("checkpointPeriod", po::value(&config_.checkpointPeriod)
+         ->default_value(config_.checkpointPeriod)
+         , "Checkpoint period in seconds.")
+        ("bottomUp", po::value(&config_.bottomUp)
+         ->default_value(config_.bottomUp)->implicit_value(true)
+         , "Bottom-up analysis: warp dataset only into tiles at leafLod, "
+         "derive coarser tiles from their children.")
+        ("leafLod", po::value<int>()
+         , "LOD of bottom-up analysis leaves, e.g. dataset's native "
+         "resolution (defaults to lodRange.max). Tiles below it are "
+         "analyzed top-down as usual.")
+        ("merge", po::value(&merge_)->multitoken()
+         , "Merge mode: merge given shard outputs into the output instead "
+         "of analyzing the dataset.")
 
         ("noexcept", "Do not catch exceptions, let the program crash.")
         ;
@@ -237,10 +266,37 @@ void Tiling::configure(const po::variables_map &vars)
         complexDataset = false;
     }
 
+    if (vars.count("shard")) {
+        config_.shard = vars["shard"].as<tiling::Shard>();
+    }
+    if (vars.count("unitLod")) {
+        const auto unitLod(vars["unitLod"].as<int>());
+        if (unitLod < 0) {
+            throw po::validation_error
+                (po::validation_error::invalid_option_value, "unitLod");
+        }
+        config_.unitLod = unitLod;
+    }
+    if (vars.count("leafLod")) {
+        const auto leafLod(vars["leafLod"].as<int>());
+        if (leafLod < 0) {
+            throw po::validation_error
+                (po::validation_error::invalid_option_value, "leafLod");
+        }
+        config_.leafLod = leafLod;
+    }
+
     if (vars.count("output")) {
         output_ = vars["output"].as<fs::path>();
     } else if (complexDataset) {
         output_ = input_ / ("tiling." + referenceFrame_);
+        if (config_.shard && merge_.empty()) {
+            // keep shard outputs apart
+            output_ = utility::addExtension
+                (output_, str(boost::format(".shard-%d-of-%d")
+                              % config_.shard->index
+                              % config_.shard->count));
+        }
     } else {
         throw po::required_option("output");
     }
@@ -255,6 +311,13 @@ void Tiling::configure(const po::variables_map &vars)
         << "\n\treferenceFrame = " << referenceFrame_
         << "\n\tlodRange = " << lodRange_
         << "\n\ttileRange = " << utility::join(tileRanges_, " ")
+        << "\n\tshard = "
+        << (config_.shard ? *config_.shard : tiling::Shard())
+        << "\n\tcheckpoint = " << config_.checkpoint
+        << "\n\tbottomUp = " << config_.bottomUp
+        << "\n\tleafLod = "
+        << (config_.leafLod ? int(*config_.leafLod) : int(lodRange_.max))
+        << "\n\tmerge = " << utility::join(merge_, " ")
         << "\n"
         ;
 }
@@ -292,6 +355,28 @@ bool Tiling::help(std::ostream &out, const std::string &what) const
                 "        one must explicitely use lodRange starting from zero \n"
                 "        and use --tileRange=0,0:0,0.\n"
                 "\n"
+                "    Shards and checkpoints:\n"
+                "        Work is split into units: subtrees rooted at\n"
+                "        --unitLod (lodRange.min by default). With\n"
+                "        --shard=i/n only every n-th unit is processed and\n"
+                "        the output gets .shard-i-of-n suffix by default.\n"
+                "        Shard outputs are combined by running the tool\n"
+                "        with the same input and reference frame and\n"
+                "        --merge shard-output...\n"
+                "\n"
+                "        With --checkpoint=dir the partial result is saved\n"
+                "        periodically; an interrupted run restarted with\n"
+                "        the same options resumes from the checkpoint.\n"
+                "\n"
+                "    Bottom-up analysis:\n"
+                "        With --bottomUp the dataset is warped only into\n"
+                "        tiles at --leafLod (lodRange.max by default) and\n"
+                "        below; a coarser tile has a mesh if any of its\n"
+                "        children has one and is watertight only if all\n"
+                "        of them are. Same source pixels are not read again\n"
+                "        at each LOD. Tiles above --unitLod whose subtree\n"
+                "        spans several shards are not marked watertight.\n"
+                "\n"
                 );
 
         return true;
@@ -302,6 +387,14 @@ bool Tiling::help(std::ostream &out, const std::string &what) const
 
 int Tiling::runImpl()
 {
+    if (!merge_.empty()) {
+        auto ti(tiling::merge(merge_));
+        LOG(info3) << "Saving merged tile index into " << output_ << ".";
+        ti.save(output_);
+        LOG(info3) << "Tile index saved.";
+        return EXIT_SUCCESS;
+    }
+
     auto rf(vr::system.referenceFrames(referenceFrame_));
 
     auto ds(geo::GeoDataset::open(dataset_));
@@ -314,6 +407,8 @@ int Tiling::runImpl()
     ti.save(output_);
     LOG(info3) << "Tile index saved.";
 
+    tiling::dropCheckpoint(config_);
+
     return EXIT_SUCCESS;
 }
 
@@ -28,6 +28,12 @@
 #include <utility>
 #include <functional>
 #include <map>
+#include <set>
+#include <mutex>
+#include <chrono>
+#include <memory>
+#include <fstream>
+#include <sstream>
 
 #include <boost/thread.hpp>
 #include <boost/format.hpp>
@@ -36,6 +42,7 @@
 
 #include "utility/streams.hpp"
 #include "utility/buildsys.hpp"
+#include "utility/path.hpp"
 #include "utility/openmp.hpp"
 #include "service/cmdline.hpp"
 
@@ -72,43 +79,298 @@ math::Extents2 extentsPlusHalfPixel(const math::Extents2 &extents
 
 typedef vts::TileIndex::Flag TiFlag;
 
+/** Data coverage of analyzed subtree, reduced from children in bottom-up
+ *  analysis.
+ */
+struct Coverage {
+    /** Some part of the subtree has valid data.
+     */
+    bool any;
+
+    /** Whole subtree is covered (where covered by the reference frame).
+     */
+    bool all;
+
+    Coverage(bool any, bool all) : any(any), all(all) {}
+
+    /** Covered area of analyzed tile.
+     */
+    static Coverage area(vts::NodeInfo::CoveredArea area) {
+        switch (area) {
+        case vts::NodeInfo::CoveredArea::whole: return { true, true };
+        case vts::NodeInfo::CoveredArea::some: return { true, false };
+        case vts::NodeInfo::CoveredArea::none: break;
+        }
+        return { false, false };
+    }
+
+    /** Nothing known about the subtree, i.e. no mesh and holes.
+     */
+    static Coverage unknown() { return { false, false }; }
+
+    /** Subtree outside of the reference frame's valid area: does not break
+     *  parent's watertightness.
+     */
+    static Coverage neutral() { return { false, true }; }
+
+    /** Coverage of already analyzed tile.
+     */
+    static Coverage flags(TiFlag::value_type flags) {
+        return { bool(flags & TiFlag::mesh)
+                , bool(flags & TiFlag::watertight) };
+    }
+
+    Coverage& operator+=(const Coverage &child) {
+        any = any || child.any;
+        all = all && child.all;
+        return *this;
+    }
+};
+
+/** Union of tile index flags. Used to merge indices of disjoint subtrees.
+ */
+TiFlag::value_type unionFlags(TiFlag::value_type o, TiFlag::value_type n)
+{
+    return o | n;
+}
+
+/** Checkpoint of a tiling run: partial tile index and list of finished work
+ *  units, stored in a directory.
+ *
+ *  Tile index is always written before the list of units, i.e. the stored
+ *  index contains at least all tiles of listed units.
+ */
+class Checkpoint {
+public:
+    typedef std::unique_ptr<Checkpoint> pointer;
+
+    Checkpoint(const fs::path &root, const std::string &signature
+               , int period)
+        : root_(root), signature_(signature), period_(period)
+        , last_(std::chrono::steady_clock::now())
+    {}
+
+    /** Loads stored checkpoint into ti. Returns false if there is none.
+     */
+    bool load(vts::TileIndex &ti);
+
+    /** Is given work unit already finished?
+     */
+    bool finished(const vts::TileId &unit) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return finished_.count(unit);
+    }
+
+    /** Marks work unit as finished. Returns true if checkpoint is due.
+     */
+    bool done(const vts::TileId &unit);
+
+    /** Returns finished work units.
+     */
+    std::set<vts::TileId> units() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return finished_;
+    }
+
+    /** Saves tile index and given finished units.
+     */
+    void save(const vts::TileIndex &ti, const std::set<vts::TileId> &units);
+
+    static void remove(const fs::path &root);
+
+private:
+    fs::path indexPath() const { return root_ / "tileindex"; }
+    fs::path unitsPath() const { return root_ / "units"; }
+
+    const fs::path root_;
+    const std::string signature_;
+    const std::chrono::seconds period_;
+
+    mutable std::mutex mutex_;
+    std::set<vts::TileId> finished_;
+    std::chrono::steady_clock::time_point last_;
+};
+
+bool Checkpoint::load(vts::TileIndex &ti)
+{
+    if (!fs::exists(unitsPath())) { return false; }
+
+    std::ifstream f(unitsPath().string());
+    std::string signature;
+    if (!std::getline(f, signature) || (signature != signature_)) {
+        LOGTHROW(err3, std::runtime_error)
+            << "Checkpoint in " << root_ << " was made by a run with "
+            "different configuration; remove it to start from scratch.";
+    }
+
+    int lod, x, y;
+    while (f >> lod >> x >> y) {
+        finished_.insert(vts::TileId(lod, x, y));
+    }
+    if (!f.eof()) {
+        LOGTHROW(err3, std::runtime_error)
+            << "Unable to read checkpoint units from " << unitsPath() << ".";
+    }
+
+    ti.load(indexPath());
+
+    LOG(info3) << "Resuming from checkpoint in " << root_ << " ("
+               << finished_.size() << " finished work units).";
+    return true;
+}
+
+bool Checkpoint::done(const vts::TileId &unit)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    finished_.insert(unit);
+
+    const auto now(std::chrono::steady_clock::now());
+    if ((now - last_) < period_) { return false; }
+    last_ = now;
+    return true;
+}
+
+void Checkpoint::save(const vts::TileIndex &ti
+                      , const std::set<vts::TileId> &units)
+{
+    fs::create_directories(root_);
+
+    // replace files atomically
+    const auto replace([](const fs::path &path
+                          , const std::function<void(const fs::path&)> &write)
+    {
+        const auto tmp(utility::addExtension(path, ".tmp"));
+        write(tmp);
+        fs::rename(tmp, path);
+    });
+
+    replace(indexPath(), [&](const fs::path &path) { ti.save(path); });
+
+    replace(unitsPath(), [&](const fs::path &path)
+    {
+        std::ofstream f(path.string());
+        f << signature_ << '\n';
+        for (const auto &unit : units) {
+            f << int(unit.lod) << ' ' << unit.x << ' ' << unit.y << '\n';
+        }
+        f.close();
+        if (!f) {
+            LOGTHROW(err3, std::runtime_error)
+                << "Unable to write checkpoint units to " << path << ".";
+        }
+    });
+
+    LOG(info3) << "Saved checkpoint (" << units.size()
+               << " finished work units) into " << root_ << ".";
+}
+
+void Checkpoint::remove(const fs::path &root)
+{
+    boost::system::error_code ec;
+    fs::remove_all(root, ec);
+}
+
 class TreeWalker {
 public:
     TreeWalker(vts::TileIndex &ti, const fs::path &dataset
                , const vts::NodeInfo &root
                , const vts::LodRange &lodRange
                , const vts::LodTileRange::list &tileRanges
-               , const Config &config);
+               , const Config &config
+               , Checkpoint *checkpoint);
 
 private:
-    void process(bool parentProductive
-                 , const vts::NodeInfo &node, double upscaling = 0.0);
+    /** Processes node; nodes at the work unit LOD are processed as whole
+     *  units. Nodes above leaf LOD are analyzed bottom-up. Returns node's
+     *  coverage.
+     */
+    Coverage process(bool parentProductive
+                     , const vts::NodeInfo &node, double upscaling = 0.0);
+
+    /** Top-down analysis: warps dataset into the node and descends into
+     *  its children unless the result says otherwise.
+     */
+    Coverage processNode(bool parentProductive
+                         , const vts::NodeInfo &node, double upscaling);
     void descend(const vts::NodeInfo &node, const vts::TileId &tileId
                  , double upscaling);
 
+    /** Bottom-up analysis: processes children first and derives node's
+     *  flags from theirs, no warp is done here.
+     */
+    Coverage analyzeNode(bool parentProductive, const vts::NodeInfo &node);
+
+    /** Processes node's children and reduces their coverage.
+     */
+    Coverage reduce(const vts::NodeInfo &node, const vts::TileId &tileId);
+
+    /** Does work unit belong to processed shard?
+     */
+    bool inShard(const vts::TileId &unit) const {
+        if (!config_.shard) { return true; }
+        // diagonal stripes spread neighbouring units over all shards
+        return (((unit.x + unit.y) % config_.shard->count)
+                == config_.shard->index);
+    }
+
     const geo::GeoDataset& dataset() {
         return gds_[omp_get_thread_num()];
     }
 
+    /** Tile index of current thread. Threads process disjoint subtrees;
+     *  the lock is contended only while a checkpoint is being written.
+     */
+    struct ThreadIndex {
+        std::mutex mutex;
+        vts::TileIndex ti;
+    };
+
+    template <typename ...Args>
+    void set(Args &&...args) {
+        auto &ti(*tis_[omp_get_thread_num()]);
+        std::lock_guard<std::mutex> lock(ti.mutex);
+        ti.ti.set(std::forward<Args>(args)...);
+    }
+
     void prepareDataset() {
         int count(omp_get_num_threads());
         LOG(info1) << "Building tile index with " << count << " threads.";
         gds_.reserve(count);
+        tis_.reserve(count);
         for (int i(0); i < count; ++i) {
             gds_.emplace_back(geo::GeoDataset::open(dataset_));
+            tis_.emplace_back(new ThreadIndex());
         }
     }
 
+    /** Marks work unit finished and saves checkpoint if due.
+     */
+    void unitDone(const vts::TileId &unit);
+
+    /** Merges per-thread tile indices into the output one.
+     */
+    void merge();
+
     void buildWorld(const vts::LodRange &lodRange
                     , const vts::LodTileRange::list &tileRanges);
 
     const fs::path dataset_;
     vts::TileIndex &ti_;
     vts::LodRange lodRange_;
+    vts::Lod unitLod_;
+
+    /** Nodes above this LOD are analyzed bottom-up (0 = top-down analysis
+     *  only).
+     */
+    vts::Lod leafLod_;
 
     std::vector<geo::GeoDataset> gds_;
+    std::vector<std::unique_ptr<ThreadIndex>> tis_;
     Config config_;
 
+    Checkpoint *checkpoint_;
+    std::mutex saving_;
+
     vts::TileIndex world_;
 };
 
@@ -117,9 +379,13 @@ TreeWalker::TreeWalker(vts::TileIndex &ti, const fs::path &dataset
                        , const vts::NodeInfo &root
                        , const vts::LodRange &lodRange
                        , const vts::LodTileRange::list &tileRanges
-                       , const Config &config)
+                       , const Config &config
+                       , Checkpoint *checkpoint)
     : dataset_(dataset), ti_(ti), lodRange_(lodRange)
-    , config_(config)
+    , unitLod_(config.unitLod ? *config.unitLod : lodRange.min)
+    , leafLod_(config.bottomUp
+               ? (config.leafLod ? *config.leafLod : lodRange.max) : 0)
+    , config_(config), checkpoint_(checkpoint)
 {
     buildWorld(lodRange, tileRanges);
 
@@ -134,6 +400,38 @@ TreeWalker::TreeWalker(vts::TileIndex &ti, const fs::path &dataset
         prepareDataset();
         process(false, root);
     }
+
+    merge();
+}
+
+void TreeWalker::merge()
+{
+    LOG(info1) << "Merging " << tis_.size() << " tile indices.";
+    for (const auto &ti : tis_) {
+        ti_.combine(ti->ti, unionFlags);
+    }
+    tis_.clear();
+}
+
+void TreeWalker::unitDone(const vts::TileId &unit)
+{
+    if (!checkpoint_ || !checkpoint_->done(unit)) { return; }
+
+    // single checkpoint at a time, others keep working
+    std::unique_lock<std::mutex> saving(saving_, std::try_to_lock);
+    if (!saving) { return; }
+
+    // units listed here are complete in thread indices
+    const auto units(checkpoint_->units());
+
+    // output index holds resumed checkpoint
+    vts::TileIndex ti(ti_);
+    for (const auto &tti : tis_) {
+        std::lock_guard<std::mutex> lock(tti->mutex);
+        ti.combine(tti->ti, unionFlags);
+    }
+
+    checkpoint_->save(ti, units);
 }
 
 void TreeWalker::buildWorld(const vts::LodRange &lodRange
@@ -184,8 +482,119 @@ void TreeWalker::descend(const vts::NodeInfo &node
     }
 }
 
-void TreeWalker::process(bool parentProductive
-                         , const vts::NodeInfo &node, double upscaling)
+Coverage TreeWalker::process(bool parentProductive
+                             , const vts::NodeInfo &node, double upscaling)
+{
+    const auto tileId(node.nodeId());
+
+    const auto run([&]() -> Coverage
+    {
+        if (tileId.lod < leafLod_) {
+            return analyzeNode(parentProductive, node);
+        }
+        return processNode(parentProductive, node, upscaling);
+    });
+
+    if (tileId.lod != unitLod_) { return run(); }
+
+    // work unit: whole subtree belongs to single shard and is checkpointed
+    // only once finished
+    if (!inShard(tileId)) {
+        // other shard's work
+        return Coverage::unknown();
+    }
+
+    if (checkpoint_ && checkpoint_->finished(tileId)) {
+        // resumed unit's root is in the output index already
+        return Coverage::flags(ti_.get(tileId));
+    }
+
+    auto coverage(Coverage::unknown());
+    if (config_.parallel) {
+        UTILITY_OMP(taskgroup)
+            coverage = run();
+    } else {
+        coverage = run();
+    }
+
+    unitDone(tileId);
+    return coverage;
+}
+
+Coverage TreeWalker::reduce(const vts::NodeInfo &node
+                            , const vts::TileId &tileId)
+{
+    const auto children(vts::children(tileId));
+    std::vector<Coverage> coverage(children.size(), Coverage::unknown());
+
+    // do not use const otherwise OpenMP makes it shared
+    bool parentProductive(node.productive());
+
+    for (std::size_t i(0); i < children.size(); ++i) {
+        auto childNode(node.child(children[i]));
+
+        if (config_.parallel) {
+            UTILITY_OMP(task shared(coverage))
+                coverage[i] = process(parentProductive, childNode);
+        } else {
+            coverage[i] = process(parentProductive, childNode);
+        }
+    }
+
+    if (config_.parallel) {
+        UTILITY_OMP(taskwait)
+    }
+
+    auto reduced(Coverage::neutral());
+    for (const auto &child : coverage) { reduced += child; }
+    return reduced;
+}
+
+Coverage TreeWalker::analyzeNode(bool parentProductive
+                                 , const vts::NodeInfo &node)
+{
+    const auto tileId(node.nodeId());
+
+    if (!node.valid()) {
+        // same as in top-down analysis: fake watertight subtree
+        if ((tileId.lod >= lodRange_.min) && parentProductive) {
+            set(vts::LodRange(tileId.lod, lodRange_.max)
+                , vts::tileRange(tileId)
+                , (TiFlag::mesh | TiFlag::watertight));
+        }
+        return Coverage::neutral();
+    }
+
+    const auto flags(world_.get(tileId));
+    if (!flags) {
+        // outside of defined world
+        return Coverage::unknown();
+    }
+
+    const auto coverage(reduce(node, tileId));
+
+    if (!node.productive() || !(flags & Flag::analyze)) {
+        return coverage;
+    }
+
+    if (!coverage.any) {
+        LOG(info2) << "Reduced tile " << tileId << " [empty].";
+        return coverage;
+    }
+
+    // coarser than leaves -> never upscaled
+    TiFlag::value_type tileFlags(TiFlag::mesh | TiFlag::navtile);
+    if (coverage.all) { tileFlags |= TiFlag::watertight; }
+    set(tileId, tileFlags);
+
+    LOG(info2) << "Reduced tile " << tileId
+               << (coverage.all ? " [watertight]." : " [partial].");
+    return coverage;
+}
+
+Coverage TreeWalker::processNode(bool parentProductive
+                                 , const vts::NodeInfo &node
+                                 , double upscaling)
 {
     struct TIDGuard {
         TIDGuard(const std::string &id)
@@ -201,17 +610,14 @@ void TreeWalker::process(bool parentProductive
     const auto tileId(node.nodeId());
     if ((tileId.lod > lodRange_.max)) {
         // outside of configured area
-        return;
+        return Coverage::neutral();
     }
 
     auto fullSubtree([&]()
     {
-        UTILITY_OMP(critical(tileIndex))
-        {
-            ti_.set(vts::LodRange(tileId.lod, lodRange_.max)
-                    , vts::tileRange(tileId)
-                    , (TiFlag::mesh | TiFlag::watertight));
-        }
+        set(vts::LodRange(tileId.lod, lodRange_.max)
+            , vts::tileRange(tileId)
+            , (TiFlag::mesh | TiFlag::watertight));
 
         return;
     });
@@ -235,13 +641,13 @@ void TreeWalker::process(bool parentProductive
                 << ", srs: " << node.srs()
                 << ") [fake watertight subtree in invalid part of a tree].";
         }
-        return;
+        return Coverage::neutral();
     }
 
     if (!node.productive()) {
         // unproductive node, immediate descend
         descend(node, tileId, upscaling);
-        return;
+        return Coverage::unknown();
     }
 
     LOG(info2) << "Processing tile " << tileId << ".";
@@ -261,9 +667,11 @@ void TreeWalker::process(bool parentProductive
     if (!flags) {
         // outside of defined world
         LOG(info1) << "outside of defined world";
-        return;
+        return Coverage::unknown();
     }
 
+    auto coverage(Coverage::unknown());
+
     if (flags & Flag::analyze) {
         // warp input dataset into tile
         const auto &ds(dataset());
@@ -319,7 +727,10 @@ void TreeWalker::process(bool parentProductive
             return res;
         });
 
-        switch (checkMask()) {
+        const auto covered(checkMask());
+        coverage = Coverage::area(covered);
+
+        switch (covered) {
         case vts::NodeInfo::CoveredArea::whole: {
             // fully covered by dataset and by reference frame definition
 
@@ -336,11 +747,10 @@ void TreeWalker::process(bool parentProductive
                     << " (extents: " << std::fixed << node.extents()
                     << ", srs: " << node.srs()
                     << ") [watertight subtree].";
-                return;
+                return coverage;
             }
 
-            UTILITY_OMP(critical(tileIndex))
-                ti_.set(tileId, (baseFlags | TiFlag::watertight));
+            set(tileId, (baseFlags | TiFlag::watertight));
             LOG(info3)
                 << "Processed tile " << tileId
                 << " (extents: " << std::fixed << node.extents()
@@ -351,8 +761,7 @@ void TreeWalker::process(bool parentProductive
 
         case vts::NodeInfo::CoveredArea::some: {
             // partially covered
-            UTILITY_OMP(critical(tileIndex))
-                ti_.set(tileId, baseFlags);
+            set(tileId, baseFlags);
             LOG(info3)
                 << "Processed tile " << tileId
                 << " (extents: " << std::fixed << node.extents()
@@ -368,7 +777,7 @@ void TreeWalker::process(bool parentProductive
                 << " (extents: " << std::fixed << node.extents()
                 << ", srs: " << node.srs()
                 << ") [empty].";
-            return;
+            return coverage;
         }
         }
 
@@ -385,6 +794,7 @@ void TreeWalker::process(bool parentProductive
     // descend to children
     descend(node, tileId, upscaling);
     // done
+    return coverage;
 }
 
 } // namespace
@@ -396,10 +806,62 @@ generate(const fs::path &dataset
          , const vtslibs::vts::LodTileRange::list &tileRanges
          , const Config &config)
 {
+    if (config.unitLod && (*config.unitLod > lodRange.max)) {
+        LOGTHROW(err3, std::runtime_error)
+            << "Work unit LOD " << int(*config.unitLod)
+            << " is outside of LOD range " << lodRange << ".";
+    }
+
+    if (config.bottomUp && config.leafLod
+        && !vts::in(*config.leafLod, lodRange))
+    {
+        LOGTHROW(err3, std::runtime_error)
+            << "Leaf LOD " << int(*config.leafLod)
+            << " is outside of LOD range " << lodRange << ".";
+    }
+
     vtslibs::vts::TileIndex ti;
+
+    Checkpoint::pointer checkpoint;
+    if (!config.checkpoint.empty()) {
+        // checkpoint is valid only for identical run
+        std::ostringstream os;
+        os << "mapproxy-tiling checkpoint: " << dataset
+           << " " << referenceFrame.id << " " << lodRange
+           << " " << utility::join(tileRanges, ",")
+           << " " << config.tileSampling << " " << config.forceWatertight
+           << " " << int(config.unitLod ? *config.unitLod : lodRange.min)
+           << " " << (config.shard ? *config.shard : Shard())
+           << " " << (config.bottomUp
+                      ? int(config.leafLod ? *config.leafLod : lodRange.max)
+                      : -1);
+
+        checkpoint.reset(new Checkpoint(config.checkpoint, os.str()
+                                        , config.checkpointPeriod));
+        checkpoint->load(ti);
+    }
+
     TreeWalker(ti, dataset, vts::NodeInfo(referenceFrame)
-               , lodRange, tileRanges, config);
+               , lodRange, tileRanges, config, checkpoint.get());
+    return ti;
+}
+
+vtslibs::vts::TileIndex merge(const std::vector<fs::path> &shards)
+{
+    vtslibs::vts::TileIndex ti;
+    for (const auto &shard : shards) {
+        LOG(info3) << "Merging shard tile index " << shard << ".";
+        vtslibs::vts::TileIndex sti;
+        sti.load(shard);
+        ti.combine(sti, unionFlags);
+    }
     return ti;
 }
 
+void dropCheckpoint(const Config &config)
+{
+    if (config.checkpoint.empty()) { return; }
+    Checkpoint::remove(config.checkpoint);
+}
+
 } // namespace tiling
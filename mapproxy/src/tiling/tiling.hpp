@@ -27,6 +27,11 @@
 #ifndef mapproxy_tiling_tiling_hpp_included_
 #define mapproxy_tiling_tiling_hpp_included_
 
+#include <vector>
+#include <istream>
+#include <ostream>
+
+#include <boost/optional.hpp>
 #include <boost/filesystem.hpp>
 
 #include "vts-libs/registry.hpp"
@@ -35,13 +40,56 @@
 
 namespace tiling {
 
+/** Part of the work done by single tiling run: run processes only work
+ *  units (subtrees rooted at Config::unitLod) of this shard.
+ */
+struct Shard {
+    unsigned int index;
+    unsigned int count;
+
+    Shard(unsigned int index = 0, unsigned int count = 1)
+        : index(index), count(count)
+    {}
+};
+
 struct Config {
     int tileSampling;
     bool parallel;
     bool forceWatertight;
 
+    /** Process only work units of this shard.
+     */
+    boost::optional<Shard> shard;
+
+    /** LOD of work unit roots. Defaults to lodRange.min.
+     */
+    boost::optional<vtslibs::vts::Lod> unitLod;
+
+    /** Checkpoint directory. Partial tile index and list of finished work
+     *  units are saved there periodically and a run started with existing
+     *  checkpoint resumes from it. Empty means no checkpointing.
+     */
+    boost::filesystem::path checkpoint;
+
+    /** Checkpoint period in seconds.
+     */
+    int checkpointPeriod;
+
+    /** Bottom-up analysis: dataset is warped only into tiles at leafLod
+     *  (and below, as usual); flags of their ancestors are derived from
+     *  children: a tile has a mesh if any child has one and is watertight
+     *  if all its children are.
+     */
+    bool bottomUp;
+
+    /** LOD of bottom-up analysis leaves (e.g. dataset's native
+     *  resolution). Defaults to lodRange.max.
+     */
+    boost::optional<vtslibs::vts::Lod> leafLod;
+
     Config()
         : tileSampling(128), parallel(true), forceWatertight(false)
+        , checkpointPeriod(600), bottomUp(false)
     {}
 };
 
@@ -52,6 +100,36 @@ generate(const boost::filesystem::path &dataset
          , const vtslibs::vts::LodTileRange::list &tileRanges
          , const Config &config);
 
+/** Merges tile indices generated by individual shards.
+ */
+vtslibs::vts::TileIndex
+merge(const std::vector<boost::filesystem::path> &shards);
+
+/** Removes checkpoint (if any) once the result is safely stored.
+ */
+void dropCheckpoint(const Config &config);
+
+template<typename CharT, typename Traits>
+inline std::basic_ostream<CharT, Traits>&
+operator<<(std::basic_ostream<CharT, Traits> &os, const Shard &shard)
+{
+    return os << shard.index << '/' << shard.count;
+}
+
+template<typename CharT, typename Traits>
+inline std::basic_istream<CharT, Traits>&
+operator>>(std::basic_istream<CharT, Traits> &is, Shard &shard)
+{
+    CharT sep;
+    is >> shard.index >> sep >> shard.count;
+    if (is && ((sep != '/') || !shard.count
+               || (shard.index >= shard.count)))
+    {
+        is.setstate(std::ios::failbit);
+    }
+    return is;
+}
+
 } // namespace tiling
 
 #endif // mapproxy_tiling_tiling_hpp_included_
@@ -0,0 +1,590 @@
+/**
+ * Copyright (c) 2026 Ondrej Prochazka
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** Load generator: replays access log or synthetic viewer flight against
+ *  running mapproxy and reports latency percentiles per resource and file
+ *  type.
+ */
+
+#include <map>
+#include <set>
+#include <cmath>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+#include <condition_variable>
+
+#include <boost/asio.hpp>
+#include <boost/format.hpp>
+#include <boost/optional.hpp>
+#include <boost/utility/in_place_factory.hpp>
+
+#include "dbglog/dbglog.hpp"
+
+#include "utility/buildsys.hpp"
+#include "utility/resourcefetcher.hpp"
+#include "service/cmdline.hpp"
+
+#include "http/http.hpp"
+#include "http/resourcefetcher.hpp"
+
+#include "vts-libs/registry/po.hpp"
+#include "vts-libs/vts/nodeinfo.hpp"
+#include "vts-libs/vts/tileop.hpp"
+
+namespace po = boost::program_options;
+namespace fs = boost::filesystem;
+namespace asio = boost::asio;
+
+namespace vts = vtslibs::vts;
+namespace vr = vtslibs::registry;
+
+class Replay : public service::Cmdline {
+public:
+    Replay()
+        : service::Cmdline("mapproxy-replay", BUILD_TARGET_VERSION)
+        , concurrency_(16), rate_(), repeat_(1), timeout_(30000)
+        , clientThreads_(4), frames_(100), fps_(), window_(4)
+        , lodRange_(0, 15)
+    {}
+
+private:
+    void configuration(po::options_description &cmdline
+                       , po::options_description &config
+                       , po::positional_options_description &pd);
+
+    void configure(const po::variables_map &vars);
+
+    bool help(std::ostream &out, const std::string &what) const;
+
+    int run();
+
+    /** Builds list of paths per frame to request.
+     */
+    std::vector<std::vector<std::string>> frames() const;
+
+    std::string url_;
+    fs::path log_;
+    std::size_t concurrency_;
+    double rate_;
+    int repeat_;
+    long timeout_;
+    unsigned int clientThreads_;
+    fs::path output_;
+    fs::path baseline_;
+
+    // synthetic flight
+    std::string flightResource_;
+    std::string referenceFrame_;
+    std::vector<std::string> flightFiles_;
+    int frames_;
+    double fps_;
+    int window_;
+    vts::LodRange lodRange_;
+};
+
+void Replay::configuration(po::options_description &cmdline
+                           , po::options_description &config
+                           , po::positional_options_description &pd)
+{
+    vr::registryConfiguration(config, vr::defaultPath());
+
+    cmdline.add_options()
+        ("url", po::value(&url_)->required()
+         , "Base URL of the server (e.g. http://localhost:3070).")
+        ("log", po::value(&log_)
+         , "Access log to replay. Request path is taken from quoted "
+         "\"GET path ...\" part or from the first token starting with "
+         "slash.")
+        ("concurrency", po::value(&concurrency_)
+         ->default_value(concurrency_)->required()
+         , "Maximum number of requests in flight.")
+        ("rate", po::value(&rate_)->default_value(rate_)->required()
+         , "Requests per second (0 = as fast as concurrency permits).")
+        ("repeat", po::value(&repeat_)->default_value(repeat_)->required()
+         , "Number of passes over the request list.")
+        ("timeout", po::value(&timeout_)->default_value(timeout_)
+         ->required(), "Request timeout (ms).")
+        ("clientThreads", po::value(&clientThreads_)
+         ->default_value(clientThreads_)->required()
+         , "Number of HTTP client threads.")
+        ("output", po::value(&output_)
+         , "Write report to this file (tab separated) for later "
+         "comparison.")
+        ("baseline", po::value(&baseline_)
+         , "Compare with report of previous run (see --output).")
+
+        ("flight.resource", po::value(&flightResource_)
+         , "Synthetic viewer flight: URL path of the resource (e.g. "
+         "/melown2015/surface/group/id) to fly over instead of "
+         "replaying log.")
+        ("flight.referenceFrame", po::value(&referenceFrame_)
+         , "Reference frame of the flight resource.")
+        ("flight.files", po::value(&flightFiles_)->multitoken()
+         , "Tile file suffixes requested for each visible tile "
+         "(default: bin). Suffix \"meta\" is requested per metatile.")
+        ("flight.frames", po::value(&frames_)
+         ->default_value(frames_)->required()
+         , "Number of flight frames.")
+        ("flight.fps", po::value(&fps_)->default_value(fps_)->required()
+         , "Frames per second (0 = next frame right after previous "
+         "one is sent).")
+        ("flight.window", po::value(&window_)
+         ->default_value(window_)->required()
+         , "Visible tiles per side at each lod.")
+        ("flight.lodRange", po::value(&lodRange_)
+         ->default_value(lodRange_)->required()
+         , "Lods the viewer descends through.")
+        ;
+
+    (void) pd;
+}
+
+void Replay::configure(const po::variables_map &vars)
+{
+    vr::registryConfigure(vars);
+
+    if (log_.empty() == flightResource_.empty()) {
+        throw po::validation_error
+            (po::validation_error::invalid_option_value, "log"
+             , "exactly one of --log and --flight.resource is required");
+    }
+
+    if (!flightResource_.empty() && referenceFrame_.empty()) {
+        throw po::required_option("flight.referenceFrame");
+    }
+
+    if (flightFiles_.empty()) { flightFiles_.push_back("bin"); }
+    if (!concurrency_) { concurrency_ = 1; }
+    while (!url_.empty() && (url_.back() == '/')) { url_.pop_back(); }
+}
+
+bool Replay::help(std::ostream &out, const std::string &what) const
+{
+    if (what.empty()) {
+        // program help
+        out << ("mapproxy load generator\n"
+                "\n"
+                "Replays access log or synthetic viewer flight against "
+                "running server and\nreports latency percentiles per "
+                "resource and file type.\n"
+                );
+
+        return true;
+    }
+
+    return false;
+}
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+/** Extracts request path from access log line, empty if none.
+ */
+std::string logPath(const std::string &line)
+{
+    for (const char *method : { "\"GET ", "\"HEAD " }) {
+        const auto start(line.find(method));
+        if (start == std::string::npos) { continue; }
+
+        const auto begin(start + std::strlen(method));
+        const auto end(line.find_first_of(" \"", begin));
+        return line.substr(begin, end - begin);
+    }
+
+    // first token starting with slash
+    std::istringstream is(line);
+    std::string token;
+    while (is >> token) {
+        if (!token.empty() && (token.front() == '/')) { return token; }
+    }
+
+    return {};
+}
+
+/** Statistics key: resource (path up to the file) and file type (filename
+ *  extension, query ignored).
+ */
+std::pair<std::string, std::string> statKey(const std::string &path)
+{
+    const auto clean(path.substr(0, path.find('?')));
+    const auto slash(clean.rfind('/'));
+    const auto resource((slash == std::string::npos)
+                        ? std::string() : clean.substr(0, slash));
+    const auto filename((slash == std::string::npos)
+                        ? clean : clean.substr(slash + 1));
+    const auto dot(filename.rfind('.'));
+    return { resource, ((dot == std::string::npos)
+                        ? std::string("-") : filename.substr(dot + 1)) };
+}
+
+struct Stat {
+    std::vector<double> durations;
+    std::size_t errors;
+    std::size_t bytes;
+
+    Stat() : errors(), bytes() {}
+};
+
+typedef std::map<std::pair<std::string, std::string>, Stat> Stats;
+
+/** Report line: p50, p99 and mean in ms.
+ */
+struct Summary {
+    std::size_t count;
+    std::size_t errors;
+    double p50;
+    double p99;
+    double mean;
+
+    Summary() : count(), errors(), p50(), p99(), mean() {}
+};
+
+typedef std::map<std::pair<std::string, std::string>, Summary> Summaries;
+
+double percentile(const std::vector<double> &sorted, double q)
+{
+    if (sorted.empty()) { return 0.0; }
+    const auto index(std::size_t(std::ceil(q * sorted.size())));
+    return sorted[std::min(std::max(index, std::size_t(1))
+                           , sorted.size()) - 1];
+}
+
+Summaries summarize(Stats &stats)
+{
+    Summaries summaries;
+    for (auto &item : stats) {
+        auto &d(item.second.durations);
+        std::sort(d.begin(), d.end());
+
+        auto &s(summaries[item.first]);
+        s.count = d.size();
+        s.errors = item.second.errors;
+        s.p50 = percentile(d, 0.5);
+        s.p99 = percentile(d, 0.99);
+        if (!d.empty()) {
+            double sum(0.0);
+            for (auto v : d) { sum += v; }
+            s.mean = sum / d.size();
+        }
+    }
+    return summaries;
+}
+
+void save(const fs::path &path, const Summaries &summaries)
+{
+    std::ofstream f(path.string());
+    f.exceptions(std::ios::badbit | std::ios::failbit);
+    for (const auto &item : summaries) {
+        const auto &s(item.second);
+        f << item.first.first << '\t' << item.first.second
+          << '\t' << s.count << '\t' << s.errors
+          << '\t' << s.p50 << '\t' << s.p99 << '\t' << s.mean << '\n';
+    }
+}
+
+Summaries load(const fs::path &path)
+{
+    std::ifstream f(path.string());
+    if (!f) {
+        LOGTHROW(err2, std::runtime_error)
+            << "Cannot open baseline " << path << ".";
+    }
+
+    Summaries summaries;
+    std::string line;
+    while (std::getline(f, line)) {
+        std::istringstream is(line);
+        std::string resource, type;
+        Summary s;
+        if (std::getline(is, resource, '\t') && std::getline(is, type, '\t')
+            && (is >> s.count >> s.errors >> s.p50 >> s.p99 >> s.mean))
+        {
+            summaries[{ resource, type }] = s;
+        }
+    }
+    return summaries;
+}
+
+/** Limits number of requests in flight.
+ */
+class InFlight {
+public:
+    InFlight(std::size_t limit) : limit_(limit), count_() {}
+
+    void acquire() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cond_.wait(lock, [this]() { return count_ < limit_; });
+        ++count_;
+    }
+
+    void release() {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            --count_;
+        }
+        cond_.notify_all();
+    }
+
+    void drain() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cond_.wait(lock, [this]() { return !count_; });
+    }
+
+private:
+    const std::size_t limit_;
+    std::size_t count_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+};
+
+} // namespace
+
+std::vector<std::vector<std::string>> Replay::frames() const
+{
+    std::vector<std::vector<std::string>> frames;
+
+    if (!log_.empty()) {
+        // whole log is one frame
+        std::ifstream f(log_.string());
+        if (!f) {
+            LOGTHROW(err2, std::runtime_error)
+                << "Cannot open access log " << log_ << ".";
+        }
+
+        frames.emplace_back();
+        std::string line;
+        while (std::getline(f, line)) {
+            auto path(logPath(line));
+            if (!path.empty()) { frames.back().push_back(std::move(path)); }
+        }
+        return frames;
+    }
+
+    const auto &rf(vr::system.referenceFrames(referenceFrame_));
+    const auto metaMask(~((1u << rf.metaBinaryOrder) - 1));
+
+    // viewer flies along the diagonal of the reference frame while going
+    // down and up the lod range; each frame requests a window of tiles
+    // around the viewer at every lod from the top down to the current one
+    for (int frame(0); frame < frames_; ++frame) {
+        const double t(frames_ > 1 ? double(frame) / (frames_ - 1) : 0.0);
+        const double depth(1.0 - std::abs(2.0 * t - 1.0));
+        const vts::Lod bottom
+            (lodRange_.min + std::lround(depth * (lodRange_.max
+                                                  - lodRange_.min)));
+
+        frames.emplace_back();
+        auto &paths(frames.back());
+        std::set<vts::TileId> metatiles;
+
+        for (vts::Lod lod(lodRange_.min); lod <= bottom; ++lod) {
+            const long tiles(1l << lod);
+            const long cx(std::lround(t * (tiles - 1)));
+            const long half(window_ / 2);
+
+            for (long y(std::max(0l, cx - half))
+                     , ey(std::min(tiles, cx - half + window_));
+                 y < ey; ++y)
+            {
+                for (long x(std::max(0l, cx - half))
+                         , ex(std::min(tiles, cx - half + window_));
+                     x < ex; ++x)
+                {
+                    const vts::TileId tileId(lod, x, y);
+                    if (!vts::NodeInfo(rf, tileId).valid()) { continue; }
+
+                    for (const auto &suffix : flightFiles_) {
+                        if (suffix == "meta") {
+                            const vts::TileId metaId
+                                (lod, x & metaMask, y & metaMask);
+                            if (!metatiles.insert(metaId).second) {
+                                continue;
+                            }
+                            paths.push_back
+                                (str(boost::format("%s/%s.meta")
+                                     % flightResource_ % metaId));
+                        } else {
+                            paths.push_back
+                                (str(boost::format("%s/%s.%s")
+                                     % flightResource_ % tileId % suffix));
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    return frames;
+}
+
+int Replay::run()
+{
+    const auto frameList(frames());
+
+    // client machinery, callbacks run in our own io service
+    asio::io_service ios;
+    boost::optional<asio::io_service::work> work(boost::in_place
+                                                 (std::ref(ios)));
+    std::vector<std::thread> workers;
+    for (unsigned int i(0); i < clientThreads_; ++i) {
+        workers.emplace_back([&ios]() { ios.run(); });
+    }
+
+    http::Http http;
+    http.startClient(clientThreads_);
+    http::ResourceFetcher fetcher(http.fetcher(), &ios);
+
+    typedef utility::ResourceFetcher::Query Query;
+    typedef utility::ResourceFetcher::MultiQuery MultiQuery;
+
+    Stats stats;
+    std::mutex statsMutex;
+    InFlight inFlight(concurrency_);
+
+    const auto interval
+        (rate_ > 0.0
+         ? std::chrono::duration_cast<Clock::duration>
+         (std::chrono::duration<double>(1.0 / rate_))
+         : Clock::duration());
+    const auto frameInterval
+        (fps_ > 0.0
+         ? std::chrono::duration_cast<Clock::duration>
+         (std::chrono::duration<double>(1.0 / fps_))
+         : Clock::duration());
+
+    std::size_t sent(0);
+    const auto start(Clock::now());
+    auto next(start);
+
+    for (int pass(0); pass < repeat_; ++pass) {
+        auto nextFrame(Clock::now());
+        for (const auto &paths : frameList) {
+            for (const auto &path : paths) {
+                if (interval.count()) {
+                    std::this_thread::sleep_until(next);
+                    next += interval;
+                }
+
+                inFlight.acquire();
+                ++sent;
+
+                const auto key(statKey(path));
+                const auto issued(Clock::now());
+                fetcher.perform(Query(url_ + path).reuse(false)
+                                .timeout(timeout_)
+                                , [&, key, issued](const MultiQuery &query)
+                {
+                    const std::chrono::duration<double, std::milli>
+                        elapsed(Clock::now() - issued);
+
+                    bool ok(true);
+                    std::size_t size(0);
+                    try {
+                        size = query.front().get().data.size();
+                    } catch (const std::exception&) {
+                        ok = false;
+                    }
+
+                    {
+                        std::unique_lock<std::mutex> lock(statsMutex);
+                        auto &stat(stats[key]);
+                        if (ok) {
+                            stat.durations.push_back(elapsed.count());
+                            stat.bytes += size;
+                        } else {
+                            ++stat.errors;
+                        }
+                    }
+
+                    inFlight.release();
+                });
+            }
+
+            if (frameInterval.count()) {
+                nextFrame += frameInterval;
+                std::this_thread::sleep_until(nextFrame);
+            }
+        }
+    }
+
+    inFlight.drain();
+    const std::chrono::duration<double>
+        total(Clock::now() - start);
+
+    work = boost::none;
+    for (auto &worker : workers) { worker.join(); }
+
+    const auto summaries(summarize(stats));
+    boost::optional<Summaries> baseline;
+    if (!baseline_.empty()) { baseline = load(baseline_); }
+
+    std::cout << boost::format("%d requests in %.2f s, %.1f requests/s\n")
+        % sent % total.count() % (sent / total.count());
+
+    for (const auto &item : summaries) {
+        const auto &s(item.second);
+        std::cout << boost::format
+            ("%s %s: %d ok, %d errors, p50 %.2f ms, p99 %.2f ms, "
+             "mean %.2f ms")
+            % item.first.first % item.first.second % s.count % s.errors
+            % s.p50 % s.p99 % s.mean;
+
+        if (baseline) {
+            auto fbaseline(baseline->find(item.first));
+            if ((fbaseline != baseline->end()) && fbaseline->second.p50
+                && fbaseline->second.p99)
+            {
+                std::cout << boost::format
+                    (" (baseline p50 %.2f ms %+.1f%%, p99 %.2f ms %+.1f%%)")
+                    % fbaseline->second.p50
+                    % (100.0 * (s.p50 / fbaseline->second.p50 - 1.0))
+                    % fbaseline->second.p99
+                    % (100.0 * (s.p99 / fbaseline->second.p99 - 1.0));
+            } else {
+                std::cout << " (not in baseline)";
+            }
+        }
+        std::cout << '\n';
+    }
+
+    if (!output_.empty()) { save(output_, summaries); }
+
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[])
+{
+    return Replay()(argc, argv);
+}
@@ -24,7 +24,20 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <exception>
+
+#include <boost/filesystem.hpp>
+
+#include "dbglog/dbglog.hpp"
+
 #include "utility/buildsys.hpp"
+#include "utility/streams.hpp"
+#include "utility/path.hpp"
 #include "service/cmdline.hpp"
 
 #include "mapproxy/support/mmapped/tileindex.hpp"
@@ -36,6 +49,8 @@ class TileIndex2MMappedTileIndex : public service::Cmdline {
 public:
     TileIndex2MMappedTileIndex()
         : service::Cmdline("mapproxy-ti2mmti", BUILD_TARGET_VERSION)
+        , version_(mmapped::QTree::formatVersion)
+        , threads_(1)
     {
     }
 
@@ -50,8 +65,17 @@ private:
 
     int run();
 
+    /** Serializes lod trees into separate section files in parallel and
+     *  concatenates them in lod order.
+     */
+    void convertParallel(const vts::TileIndex &ti
+                         , mmapped::TileIndex::Writer &writer
+                         , vts::Lod lodCount) const;
+
     fs::path input_;
     fs::path output_;
+    unsigned int version_;
+    unsigned int threads_;
 };
 
 void TileIndex2MMappedTileIndex
@@ -64,6 +88,14 @@ void TileIndex2MMappedTileIndex
          , "Path to input tile index.")
         ("output", po::value(&output_)->required()
          , "Path to output mmapped tile index.")
+        ("formatVersion", po::value(&version_)->default_value(version_)
+         , "Format version of output mmapped tile index: 1 (legacy, readable "
+         "by older mapproxy) or 2 (level-order bit vector).")
+        ("threads", po::value(&threads_)->default_value(threads_)
+         , "Number of threads serializing individual lods; 0 means "
+         "number of available CPUs. Each lod is written into its own "
+         "temporary section file next to the output and sections are "
+         "concatenated in lod order.")
         ;
 
     pd.add("input", 1)
@@ -74,6 +106,15 @@ void TileIndex2MMappedTileIndex
 
 void TileIndex2MMappedTileIndex::configure(const po::variables_map &vars)
 {
+    if ((version_ < 1) || (version_ > mmapped::QTree::formatVersion)) {
+        throw po::validation_error
+            (po::validation_error::invalid_option_value, "formatVersion");
+    }
+
+    if (!threads_) {
+        threads_ = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+
     (void) vars;
 }
 
@@ -92,11 +133,101 @@ bool TileIndex2MMappedTileIndex::help(std::ostream &out
     return false;
 }
 
+void TileIndex2MMappedTileIndex
+::convertParallel(const vts::TileIndex &ti
+                  , mmapped::TileIndex::Writer &writer
+                  , vts::Lod lodCount) const
+{
+    std::vector<fs::path> sections;
+    for (vts::Lod lod(0); lod < lodCount; ++lod) {
+        sections.push_back
+            (utility::addExtension
+             (output_, ".lod" + std::to_string(int(lod)) + ".tmp"));
+    }
+
+    struct Cleanup {
+        const std::vector<fs::path> &sections;
+        ~Cleanup() {
+            boost::system::error_code ec;
+            for (const auto &section : sections) { fs::remove(section, ec); }
+        }
+    } cleanup{sections};
+
+    std::atomic<unsigned int> next(0);
+    std::exception_ptr error;
+    std::mutex errorMutex;
+
+    const auto worker([&]()
+    {
+        for (;;) {
+            const vts::Lod lod(next++);
+            if ((lod >= lodCount) || error) { return; }
+
+            try {
+                utility::ofstreambuf f;
+                f.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+                f.open(sections[lod].string()
+                       , std::ifstream::out | std::ifstream::trunc);
+                if (const auto *tree = ti.tree(lod)) {
+                    mmapped::QTree::write(f, *tree, version_);
+                } else {
+                    mmapped::QTree::write(f, vts::QTree(lod), version_);
+                }
+                f.close();
+                LOG(info2) << "Serialized lod " << int(lod) << ".";
+            } catch (...) {
+                std::unique_lock<std::mutex> lock(errorMutex);
+                if (!error) { error = std::current_exception(); }
+                return;
+            }
+        }
+    });
+
+    std::vector<std::thread> pool;
+    for (unsigned int i(1); i < std::min(threads_, unsigned(lodCount)); ++i)
+    {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (auto &thread : pool) { thread.join(); }
+
+    if (error) { std::rethrow_exception(error); }
+
+    for (const auto &section : sections) {
+        utility::ifstreambuf f;
+        f.exceptions(std::ifstream::badbit);
+        f.open(section.string(), std::ifstream::in);
+        writer.append(f);
+        f.close();
+
+        // release disk space as soon as possible
+        fs::remove(section);
+    }
+}
+
 int TileIndex2MMappedTileIndex::run()
 {
+    // NB: vts::TileIndex can be loaded only as a whole; output is streamed
+    // lod by lod so no serialized copy of the whole index is held in memory
     vts::TileIndex ti;
     ti.load(input_);
-    mmapped::TileIndex::write(output_, ti);
+
+    const vts::Lod lodCount(ti.empty() ? 0 : ti.maxLod() + 1);
+    mmapped::TileIndex::Writer writer(output_, lodCount, version_);
+
+    if ((threads_ > 1) && (lodCount > 1)) {
+        convertParallel(ti, writer, lodCount);
+    } else {
+        for (vts::Lod lod(0); lod < lodCount; ++lod) {
+            if (const auto *tree = ti.tree(lod)) {
+                writer.write(*tree);
+            } else {
+                writer.write(vts::QTree(lod));
+            }
+        }
+    }
+
+    writer.commit();
     return EXIT_SUCCESS;
 }
 